@@ -5,6 +5,10 @@ namespace {
 class BilateralGrid : public Halide::Generator<BilateralGrid> {
 public:
     GeneratorParam<int>   s_sigma{"s_sigma", 8};
+    // On CUDA, splat the histogram into shared memory with atomic
+    // adds, and fuse the last two blurs. Set this to false to use the
+    // basic GPU schedule instead, e.g. to compare them.
+    GeneratorParam<bool>  shared_memory_schedule{"shared_memory_schedule", true};
 
     Input<Buffer<float>>  input{"input", 2};
     Input<float>          r_sigma{"r_sigma"};
@@ -77,6 +81,36 @@ public:
             blurx.estimate(z, 0, 12);
             blury.estimate(z, 0, 12);
             bilateral_grid.estimate(x, 0, 1536).estimate(y, 0, 2560);
+        } else if (get_target().has_feature(Target::CUDA) && shared_memory_schedule) {
+            Var xi("xi"), yi("yi"), zi("zi");
+
+            // Schedule blurz in 8x8 tiles of the grid, as in the
+            // basic GPU schedule below.
+            blurz.compute_root().reorder(c, z, x, y).gpu_tile(x, y, xi, yi, 8, 8);
+
+            // Compute the histograms of each tile in shared memory,
+            // but rather than a thread per grid cell looping over its
+            // pixels, use a thread per pixel of an 8x8 block in each
+            // of a row of cells, looping down the rows of cells.
+            // Neighboring threads then read neighboring pixels, and
+            // they splat into the shared histograms with atomic adds.
+            histogram.reorder(c, z, x, y).compute_at(blurz, x).gpu_threads(x, y);
+            histogram.update()
+                .atomic()
+                .reorder(c, y, r.x, r.y, x)
+                .gpu_threads(r.x, r.y, x)
+                .unroll(c);
+
+            // Compute blurx for each tile of blury in shared memory,
+            // rather than in a separate kernel.
+            blury.compute_root().reorder(c, x, y, z)
+                .reorder_storage(c, x, y, z).vectorize(c)
+                .gpu_tile(x, y, z, xi, yi, zi, 32, 8, 1, TailStrategy::RoundUp);
+            blurx.compute_at(blury, x).reorder(c, x, y, z)
+                .vectorize(c)
+                .gpu_threads(x, y);
+            bilateral_grid.compute_root().gpu_tile(x, y, xi, yi, 32, 8);
+            interpolated.compute_at(bilateral_grid, xi).vectorize(c);
         } else if (get_target().has_gpu_feature()) {
             Var xi("xi"), yi("yi"), zi("zi");
 
@@ -4,6 +4,9 @@
 
 #include "bilateral_grid.h"
 #include "bilateral_grid_auto_schedule.h"
+#ifdef COMPARE_BASIC_GPU_SCHEDULE
+#include "bilateral_grid_basic_gpu.h"
+#endif
 
 #include "halide_benchmark.h"
 #include "HalideBuffer.h"
@@ -42,6 +45,14 @@ int main(int argc, char **argv) {
     });
     printf("Auto-scheduled time: %gms\n", min_t_auto * 1e3);
 
+#ifdef COMPARE_BASIC_GPU_SCHEDULE
+    // The GPU schedule without shared memory atomics
+    double min_t_basic = benchmark(timing_iterations, 10, [&]() {
+        bilateral_grid_basic_gpu(input, r_sigma, output);
+    });
+    printf("Basic GPU schedule time: %gms\n", min_t_basic * 1e3);
+#endif
+
     convert_and_save_image(output, argv[2]);
 
     return 0;
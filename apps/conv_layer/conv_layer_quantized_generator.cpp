@@ -0,0 +1,118 @@
+#include "Halide.h"
+
+namespace {
+
+using namespace Halide;
+
+// An 8-bit quantized version of ConvolutionLayer. The input and
+// output are uint8 with a zero point, the filter is int8 with a zero
+// point of zero, and the products are accumulated in int32. Each
+// output channel is requantized with its own multiplier (the input
+// scale times the filter scale for that channel, divided by the
+// output scale), and clamped below at the output's zero point, which
+// is a fused ReLU.
+//
+// The channels are the innermost dimension of all the buffers, so the
+// sum over the input channels is a dot product of dense vectors, which
+// codegen turns into vpdpbusd with AVX512-VNNI, and into sdot with the
+// ARM dot product extension.
+class QuantizedConvolutionLayer : public Halide::Generator<QuantizedConvolutionLayer> {
+public:
+    GeneratorParam<int> input_channels{"input_channels", 32};
+    GeneratorParam<int> kernel_size{"kernel_size", 3};
+
+    Input<Buffer<uint8_t>> input{"input", 4};
+    Input<uint8_t> input_zero{"input_zero"};
+    Input<Buffer<int8_t>> filter{"filter", 4};
+    Input<Buffer<int32_t>> bias{"bias", 1};
+    Input<Buffer<float>> output_multiplier{"output_multiplier", 1};
+    Input<uint8_t> output_zero{"output_zero"};
+
+    Output<Buffer<uint8_t>> f_ReLU{"ReLU", 4};
+
+    void generate() {
+        /* THE ALGORITHM */
+
+        Var x("x"), y("y"), z("z"), n("n");
+
+        // Input channels, then the filter's x and y.
+        RDom r(0, input_channels, 0, kernel_size, 0, kernel_size);
+
+        // sdot takes two signed vectors, so on ARM the input is moved
+        // to int8 by subtracting 128, which is added back to the zero
+        // point. vpdpbusd takes an unsigned and a signed vector, so
+        // elsewhere it stays as it is.
+        const bool signed_input = get_target().arch == Target::ARM;
+        const int input_offset = signed_input ? 128 : 0;
+        auto in = [&](Expr c, Expr x, Expr y, Expr n) {
+            Expr v = input(c, x, y, n);
+            if (signed_input) {
+                v = cast<int8_t>(v ^ cast<uint8_t>(128));
+            }
+            return cast<int32_t>(v);
+        };
+
+        // The sum of (input - zero point) * filter is the sum of
+        // input * filter, less the zero point times the sum of the
+        // filter, which is the same for every output of a channel.
+        Func filter_sum("filter_sum");
+        filter_sum(z) = sum(cast<int32_t>(filter(r.x, r.y, r.z, z)));
+
+        Func f_conv("conv");
+        f_conv(z, x, y, n) = bias(z) - (cast<int32_t>(input_zero) - input_offset) * filter_sum(z);
+        f_conv(z, x, y, n) += in(r.x, x + r.y, y + r.z, n) * cast<int32_t>(filter(r.x, r.y, r.z, z));
+
+        Expr scaled = cast<int32_t>(round(cast<float>(f_conv(z, x, y, n)) * output_multiplier(z))) + output_zero;
+        f_ReLU(z, x, y, n) = cast<uint8_t>(clamp(scaled, cast<int32_t>(output_zero), 255));
+
+        input.dim(0).set_bounds(0, input_channels);
+        filter.dim(0).set_bounds(0, input_channels)
+            .dim(1).set_bounds(0, kernel_size)
+            .dim(2).set_bounds(0, kernel_size);
+
+        /* THE SCHEDULE */
+
+        if (auto_schedule) {
+            input.dim(1).set_bounds_estimate(0, 131);
+            input.dim(2).set_bounds_estimate(0, 131);
+            input.dim(3).set_bounds_estimate(0, 4);
+
+            filter.dim(3).set_bounds_estimate(0, 64);
+
+            bias.dim(0).set_bounds_estimate(0, 64);
+            output_multiplier.dim(0).set_bounds_estimate(0, 64);
+
+            f_ReLU.estimate(z, 0, 64)
+                .estimate(x, 0, 128)
+                .estimate(y, 0, 128)
+                .estimate(n, 0, 4);
+        } else {
+            // Each output is a dot product over the input channels,
+            // and the filter's x and y, which are unrolled. The
+            // dot products are done with atomic vectorization, which
+            // reduces the vector of products horizontally.
+            int vec_len = 32;
+            while (vec_len > 1 && input_channels % vec_len != 0) {
+                vec_len /= 2;
+            }
+            Var zo("zo"), zi("zi");
+            filter_sum.compute_root();
+            f_ReLU.split(z, zo, zi, 16)
+                .reorder(zi, x, zo, y, n)
+                .vectorize(zi)
+                .parallel(y);
+            f_conv.compute_at(f_ReLU, x)
+                .vectorize(z, 8);
+            f_conv.update()
+                .reorder(r.x, r.y, r.z, z)
+                .atomic()
+                .vectorize(r.x, vec_len)
+                .unroll(r.y)
+                .unroll(r.z);
+        }
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(QuantizedConvolutionLayer, conv_layer_quantized)
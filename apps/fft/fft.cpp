@@ -228,6 +228,60 @@ ComplexFunc dft8(ComplexFunc f, int sign, const string& prefix) {
     return F;
 }
 
+// Compute the DFT of an odd size R on the first dimension of f. Pairing up
+// x[n] and x[R - n] turns all of the twiddle factors into real constants:
+//
+//   X[k] = x[0] + sum_n (x[n] + x[R - n]) cos(2 pi k n / R)
+//          + j sign sum_n (x[n] - x[R - n]) sin(2 pi k n / R)
+//
+// where n ranges over [1, R / 2], and X[R - k] is the same with the sign of
+// the second sum flipped.
+ComplexFunc dft_odd(ComplexFunc f, int R, int sign, const string& prefix) {
+    assert(R % 2 == 1);
+    const int H = R / 2;
+
+    Type type = f.output_types()[0];
+
+    ComplexFunc F(prefix + "X" + std::to_string(R));
+    F(f.args()) = undef_z(type);
+
+    vector<ComplexFuncRef> x = get_func_refs(f, R);
+    vector<ComplexFuncRef> X = get_func_refs(F, R);
+    vector<ComplexFuncRef> T = get_func_refs(F, 4 * H, true);
+
+    // The sums and differences of the pairs of inputs.
+    for (int n = 1; n <= H; n++) {
+        T[2 * n - 2] = x[n] + x[R - n];
+        T[2 * n - 1] = x[n] - x[R - n];
+    }
+
+    // The real and imaginary (scaled by j*sign) parts of each pair of outputs.
+    for (int k = 1; k <= H; k++) {
+        ComplexExpr P = x[0];
+        ComplexExpr Q = T[1] * std::sin(2 * kPi * k / R);
+        P += T[0] * std::cos(2 * kPi * k / R);
+        for (int n = 2; n <= H; n++) {
+            float theta = 2 * kPi * ((k * n) % R) / R;
+            P += T[2 * n - 2] * std::cos(theta);
+            Q += T[2 * n - 1] * std::sin(theta);
+        }
+        T[2 * H + 2 * k - 2] = P;
+        T[2 * H + 2 * k - 1] = Q * j * sign;
+    }
+
+    ComplexExpr X0 = x[0];
+    for (int n = 1; n <= H; n++) {
+        X0 += T[2 * n - 2];
+    }
+    X[0] = X0;
+    for (int k = 1; k <= H; k++) {
+        X[k] = T[2 * H + 2 * k - 2] + T[2 * H + 2 * k - 1];
+        X[R - k] = T[2 * H + 2 * k - 2] - T[2 * H + 2 * k - 1];
+    }
+
+    return F;
+}
+
 // Compute the complex DFT of size N on dimension 0 of x.
 ComplexFunc dftN(ComplexFunc x, int N, int sign, const string& prefix) {
     vector<Var> args(x.args());
@@ -256,8 +310,11 @@ ComplexFunc dft1d_c2c(ComplexFunc x, int N, int sign,
     switch (N) {
     case 1: return x;
     case 2: return dft2(x, prefix);
+    case 3: return dft_odd(x, 3, sign, prefix);
     case 4: return dft4(x, sign, prefix);
+    case 5: return dft_odd(x, 5, sign, prefix);
     case 6: return dft6(x, sign, prefix);
+    case 7: return dft_odd(x, 7, sign, prefix);
     case 8: return dft8(x, sign, prefix);
     default: return dftN(x, N, sign, prefix);
     }
@@ -286,6 +343,17 @@ ComplexFunc twiddle_factors(int N, Expr gain, int sign,
     return W;
 }
 
+vector<int> radix_factor(int N);
+
+ComplexFunc fft_dim1_bluestein(ComplexFunc x,
+                               int N,
+                               int sign,
+                               int extent_0,
+                               Expr gain,
+                               bool parallel,
+                               const string& prefix,
+                               const Target& target);
+
 // Compute the N point DFT of dimension 1 (columns) of x using
 // radix R.
 ComplexFunc fft_dim1(ComplexFunc x,
@@ -299,6 +367,14 @@ ComplexFunc fft_dim1(ComplexFunc x,
                      TwiddleFactorSet* twiddle_cache) {
     int N = product(NR);
 
+    // We only have efficient DFTs for radices up to 8. The DFT of a larger
+    // radix is O(R^2), so use Bluestein's algorithm instead.
+    for (int R : NR) {
+        if (R > 8) {
+            return fft_dim1_bluestein(x, N, sign, extent_0, gain, parallel, prefix, target);
+        }
+    }
+
     vector<Var> args = x.args();
     Var n0(args[0]), n1(args[1]);
     args.erase(args.begin());
@@ -413,6 +489,86 @@ ComplexFunc fft_dim1(ComplexFunc x,
     return x;
 }
 
+// Compute the N point DFT of dimension 1 of x using Bluestein's algorithm,
+// for N with a prime factor too large to use as a radix. Using
+// nk = (n^2 + k^2 - (k - n)^2) / 2, the DFT can be written as a convolution:
+//
+//   X[k] = w[k] sum_n (x[n] w[n]) w*[k - n],  w[n] = expj(sign pi n^2 / N)
+//
+// The convolution is circular with a period of any M >= 2N - 1, so we can
+// compute it with FFTs of a power of two size M.
+ComplexFunc fft_dim1_bluestein(ComplexFunc x,
+                               int N,
+                               int sign,
+                               int extent_0,
+                               Expr gain,
+                               bool parallel,
+                               const string& prefix,
+                               const Target& target) {
+    int M = 1;
+    while (M < 2 * N - 1) {
+        M *= 2;
+    }
+    vector<int> RM = radix_factor(M);
+
+    vector<Var> args = x.args();
+    Var n0(args[0]), n1(args[1]);
+    args.erase(args.begin());
+    args.erase(args.begin());
+
+    // The chirp w. n^2 is reduced modulo 2N to keep the angle small.
+    ComplexFunc w(prefix + "chirp");
+    Var n("n");
+    w(n) = expj(sign * kPi * cast<float>((cast<int64_t>(n) * n) % (2 * N)) / N);
+    w.compute_root();
+
+    // The convolution kernel w*[m], for m in (-N, N), wrapped to [0, M), and
+    // its DFT. This doesn't depend on x, so it is only computed once.
+    ComplexFunc b(prefix + "bluestein_b");
+    Var u("u"), m("m");
+    Expr m_abs = min(m, M - m);
+    b(u, m) = select(m_abs < N, conj(w(m_abs)), ComplexExpr(0.0f, 0.0f));
+
+    TwiddleFactorSet forward_twiddles, inverse_twiddles;
+    ComplexFunc B = fft_dim1(b, RM, -1, 1, 1.0f, false,
+                             prefix + "bluestein_b_", target, &forward_twiddles);
+    B.compute_root();
+
+    // Multiply by the chirp, and zero pad to M points.
+    ComplexFunc a(prefix + "bluestein_a");
+    a(A({n0, n1}, args)) =
+        select(n1 < N, x(A({n0, min(n1, N - 1)}, args)) * w(min(n1, N - 1)),
+               ComplexExpr(0.0f, 0.0f));
+
+    // Convolve with the kernel.
+    ComplexFunc A_fwd = fft_dim1(a, RM, -1, extent_0, 1.0f, false,
+                                 prefix + "bluestein_fwd_", target, &forward_twiddles);
+    ComplexFunc AB(prefix + "bluestein_ab");
+    AB(A({n0, n1}, args)) = A_fwd(A({n0, n1}, args)) * B(Expr(0), n1);
+    ComplexFunc conv = fft_dim1(AB, RM, 1, extent_0, gain / M, false,
+                                prefix + "bluestein_inv_", target, &inverse_twiddles);
+
+    // Multiply by the chirp again to get the DFT.
+    ComplexFunc X(prefix + "bluestein_X_" + n1.name());
+    X(A({n0, n1}, args)) = conv(A({n0, n1}, args)) * w(n1);
+    X.bound(n1, 0, N);
+
+    // Schedule this like the other FFTs, computing each group of DFTs at
+    // once, so the callers can schedule the input and output the same way.
+    const int vector_width =
+        std::min(target.natural_vector_size<float>(), extent_0);
+    X.split(n0, group, n0, vector_width)
+        .reorder(n0, n1, group)
+        .vectorize(n0);
+    if (parallel) {
+        X.parallel(group);
+    }
+    conv.compute_at(X, group);
+    A_fwd.compute_at(conv, group);
+
+    return X;
+}
+
 // transpose the first two dimensions of x.
 template <typename FuncType>
 FuncType transpose(FuncType f) {
@@ -1017,7 +1173,7 @@ vector<int> radix_factor(int N) {
     }
 
     // Factor N into factors found in the 'radices' set.
-    static const int radices[] = { 8, 6, 4, 2 };
+    static const int radices[] = { 8, 6, 4, 2, 7, 5, 3 };
     vector<int> R;
     for (int r : radices) {
         while (N % r == 0) {
@@ -1026,7 +1182,9 @@ vector<int> radix_factor(int N) {
         }
     }
 
-    // If there are still factors left over, just include them as a radix.
+    // If there are still factors left over, just include them as a radix. They
+    // are primes greater than 7, so fft_dim1 uses Bluestein's algorithm for
+    // the whole transform.
     if (N != 1 || R.empty()) {
         R.push_back(N);
     }
@@ -1057,3 +1215,114 @@ Func fft2d_c2r(ComplexFunc c,
                const Fft2dDesc& desc) {
     return fft2d_c2r(c, radix_factor(N0), radix_factor(N1), target, desc);
 }
+
+ComplexFunc fft1d_c2c(ComplexFunc x,
+                      int N,
+                      int sign,
+                      const Target& target,
+                      const Fft2dDesc& desc) {
+    string prefix = desc.name.empty() ? "fft1d_" : desc.name + "_";
+
+    assert(x.dimensions() >= 2);
+    vector<Var> args = x.args();
+    Var n0 = args[0];
+    Var n1 = args[1];
+
+    // Get the innermost variable outside the FFT.
+    Var outer = Var::outermost();
+    if (args.size() > 2) {
+        outer = args[2];
+    }
+
+    // Cache of twiddle factors for this FFT.
+    TwiddleFactorSet twiddle_cache;
+
+    // fft_dim1 vectorizes the DFTs of dimension 1 across dimension 0, so
+    // transpose the input to put the batch in dimension 0.
+    ComplexFunc xT = transpose(x);
+
+    const int vector_width = target.natural_vector_size<float>();
+    ComplexFunc dftT = fft_dim1(xT,
+                                radix_factor(N),
+                                sign,
+                                vector_width,  // extent of dim 0
+                                desc.gain,
+                                desc.parallel,
+                                prefix,
+                                target,
+                                &twiddle_cache);
+
+    // transpose back.
+    ComplexFunc dft = transpose(dftT);
+
+    xT.compute_at(dftT, group).vectorize(n1, vector_width);
+    if (desc.schedule_input) {
+        x.compute_at(dftT, group);
+    }
+    dftT.compute_at(dft, outer);
+
+    dft.bound(n0, 0, N);
+
+    return dft;
+}
+
+FftPlanCache::FftPlanCache(const Target& target, const Fft2dDesc& desc)
+    : target(target), desc(desc) {}
+
+FftPlanCache::Plan &FftPlanCache::get_plan(Kind kind, int N0, int N1, int sign) {
+    auto key = std::make_tuple(kind, N0, N1, sign);
+    auto i = plans.find(key);
+    if (i != plans.end()) {
+        return i->second;
+    }
+
+    Var x("x"), y("y"), c("c");
+    Plan plan;
+    plan.input = ImageParam(Float(32), kind == Kind::R2C ? 2 : 3, "input");
+    Func output("output");
+    if (kind == Kind::C2R) {
+        ComplexFunc in;
+        in(x, y) = ComplexExpr(plan.input(x, y, 0), plan.input(x, y, 1));
+        Func real_result = fft2d_c2r(in, N0, N1, target, desc);
+        output(x, y) = real_result(x, y);
+        real_result.compute_at(output, Var::outermost());
+    } else {
+        ComplexFunc complex_result;
+        if (kind == Kind::R2C) {
+            Func in;
+            in(x, y) = plan.input(x, y);
+            complex_result = fft2d_r2c(in, N0, N1, target, desc);
+        } else {
+            ComplexFunc in;
+            in(x, y) = ComplexExpr(plan.input(x, y, 0), plan.input(x, y, 1));
+            complex_result = fft2d_c2c(in, N0, N1, sign, target, desc);
+        }
+        output(x, y, c) = select(c == 0,
+                                 re(complex_result(x, y)),
+                                 im(complex_result(x, y)));
+        output.bound(c, 0, 2).reorder(c, x, y).unroll(c);
+        complex_result.compute_at(output, Var::outermost());
+    }
+    plan.pipeline = Pipeline(output);
+    plan.pipeline.compile_jit(target);
+
+    return plans.emplace(key, plan).first->second;
+}
+
+void FftPlanCache::c2c(Buffer<float> in, int sign, Buffer<float> out) {
+    Plan &plan = get_plan(Kind::C2C, in.dim(0).extent(), in.dim(1).extent(), sign);
+    plan.input.set(in);
+    plan.pipeline.realize(out, target);
+}
+
+void FftPlanCache::r2c(Buffer<float> in, Buffer<float> out) {
+    Plan &plan = get_plan(Kind::R2C, in.dim(0).extent(), in.dim(1).extent(), -1);
+    plan.input.set(in);
+    plan.pipeline.realize(out, target);
+}
+
+void FftPlanCache::c2r(Buffer<float> in, Buffer<float> out) {
+    Plan &plan = get_plan(Kind::C2R, out.dim(0).extent(), out.dim(1).extent(), 1);
+    plan.input.set(in);
+    plan.pipeline.realize(out, target);
+}
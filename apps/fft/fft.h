@@ -3,6 +3,8 @@
 
 #include <algorithm>
 #include <limits>
+#include <map>
+#include <tuple>
 #include <vector>
 #include <string>
 
@@ -66,4 +68,48 @@ Halide::Func fft2d_c2r(ComplexFunc c, int N0, int N1,
                        const Halide::Target& target,
                        const Fft2dDesc& desc = Fft2dDesc());
 
+// Compute the N point complex DFT of dimension 0 of x, for each of the 1D
+// signals indexed by the remaining dimensions. The DFTs are vectorized across
+// dimension 1, which is rounded up to a multiple of the natural vector size of
+// the target, so x should be defined there too (e.g. with a boundary
+// condition). Like the 2D FFTs, N can be any size, and there is no
+// normalization.
+ComplexFunc fft1d_c2c(ComplexFunc x, int N, int sign,
+                      const Halide::Target& target,
+                      const Fft2dDesc& desc = Fft2dDesc());
+
+// A cache of JIT compiled 2D FFTs. Defining and compiling the pipeline for an
+// FFT is much more expensive than running it, so code that does many FFTs of
+// the same sizes should reuse this, which only does so the first time it sees
+// each size and kind of FFT. Complex buffers have the same layout as for the
+// fft generator, with the real and imaginary parts in dimension 2. This is not
+// thread safe.
+class FftPlanCache {
+public:
+    FftPlanCache(const Halide::Target& target, const Fft2dDesc& desc = Fft2dDesc());
+
+    // Compute the complex DFT of in, which has the size of the DFT.
+    void c2c(Halide::Buffer<float> in, int sign, Halide::Buffer<float> out);
+
+    // Compute the DFT of the real in, which has the size of the DFT.
+    void r2c(Halide::Buffer<float> in, Halide::Buffer<float> out);
+
+    // Compute the real inverse DFT of in. The real out has the size of the DFT.
+    void c2r(Halide::Buffer<float> in, Halide::Buffer<float> out);
+
+private:
+    enum class Kind { C2C, R2C, C2R };
+
+    struct Plan {
+        Halide::ImageParam input;
+        Halide::Pipeline pipeline;
+    };
+
+    Plan &get_plan(Kind kind, int N0, int N1, int sign);
+
+    Halide::Target target;
+    Fft2dDesc desc;
+    std::map<std::tuple<Kind, int, int, int>, Plan> plans;
+};
+
 #endif
@@ -130,6 +130,66 @@ int main(int argc, char **argv) {
         }
     }
 
+    // Check the 1D FFTs of some sizes that aren't powers of two against a
+    // direct DFT. The prime sizes use Bluestein's algorithm.
+    for (int N : {12, 15, 35, 11, 31}) {
+        // The batch should be a multiple of the vector width.
+        const int batch = 16;
+        Buffer<float> sig_re(N, batch), sig_im(N, batch);
+        for (int y = 0; y < batch; y++) {
+            for (int x = 0; x < N; x++) {
+                sig_re(x, y) = (float)rand()/(float)RAND_MAX;
+                sig_im(x, y) = (float)rand()/(float)RAND_MAX;
+            }
+        }
+        ComplexFunc sig;
+        sig(x, y) = ComplexExpr(sig_re(x, y), sig_im(x, y));
+        Realization dft = fft1d_c2c(sig, N, -1, target).realize(N, batch, target);
+        Buffer<float> dft_re = dft[0];
+        Buffer<float> dft_im = dft[1];
+        for (int y = 0; y < batch; y++) {
+            for (int k = 0; k < N; k++) {
+                double correct_re = 0, correct_im = 0;
+                for (int n = 0; n < N; n++) {
+                    double theta = -2 * M_PI * ((k * n) % N) / N;
+                    correct_re += sig_re(n, y) * cos(theta) - sig_im(n, y) * sin(theta);
+                    correct_im += sig_re(n, y) * sin(theta) + sig_im(n, y) * cos(theta);
+                }
+                if (fabs(dft_re(k, y) - correct_re) > 1e-4 * N ||
+                    fabs(dft_im(k, y) - correct_im) > 1e-4 * N) {
+                    printf("N = %d: dft(%d, %d) = (%f, %f) instead of (%f, %f)\n", N, k, y,
+                           dft_re(k, y), dft_im(k, y), correct_re, correct_im);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // Check that an odd sized forward and inverse FFT round trip. The second
+    // time through uses the pipelines compiled the first time.
+    {
+        const int N0 = 15, N1 = 13;
+        FftPlanCache plans(target);
+        Buffer<float> c_in(N0, N1, 2), c_dft(N0, N1, 2), c_out(N0, N1, 2);
+        for (int i = 0; i < 2; i++) {
+            c_in.for_each_value([](float &v) { v = (float)rand()/(float)RAND_MAX; });
+            plans.c2c(c_in, -1, c_dft);
+            plans.c2c(c_dft, 1, c_out);
+            for (int c = 0; c < 2; c++) {
+                for (int y = 0; y < N1; y++) {
+                    for (int x = 0; x < N0; x++) {
+                        float correct = c_in(x, y, c);
+                        float result = c_out(x, y, c) / (N0 * N1);
+                        if (fabs(result - correct) > 1e-5f) {
+                            printf("round trip(%d, %d, %d) = %f instead of %f\n", x, y, c, result, correct);
+                            return -1;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
     // For a description of the methodology used here, see
     // http://www.fftw.org/speed/method.html
 
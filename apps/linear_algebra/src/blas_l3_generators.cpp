@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 #include "Halide.h"
 
@@ -40,6 +41,19 @@ class GEMMGenerator :
         const int vec = natural_vector_size(a_.type());
         const int s = vec * 2;
 
+        // The micro-kernel keeps an s x nr block of the result in
+        // registers (2 x nr vectors), so nr is as many columns as
+        // there are registers for, leaving a few for the panels.
+        int nr = 4;
+        if (get_target().arch == Target::X86) {
+            nr = get_target().has_feature(Target::AVX512) ? 8 : 6;
+        } else if (get_target().arch == Target::ARM && get_target().bits == 64) {
+            nr = 8;
+        }
+        // The width of a block of micro-kernels, about as wide as it
+        // is tall.
+        const int nc = nr * std::max(1, s / nr);
+
         Input<Buffer<T>> *A_in = &A_;
         Input<Buffer<T>> *B_in = &B_;
 
@@ -51,11 +65,11 @@ class GEMMGenerator :
             std::swap(A_in, B_in);
         }
 
-        Var i, j, ii, ji, jii, iii, io, jo, t;
+        Var i, j, ii, ji, jii, iii, io, jo, t, k("k");
         Var ti[3], tj[3];
 
         // Swizzle A for better memory order in the inner loop.
-        Func A("A"), B("B"), Btmp("Btmp"), As("As"), Atmp("Atmp");
+        Func A("A"), B("B"), Btmp("Btmp"), Bs("Bs"), Bp("Bp"), As("As"), Atmp("Atmp");
         Atmp(i, j) = BoundaryConditions::constant_exterior(*A_in, cast<T>(0))(i, j);
 
         if (transpose_A) {
@@ -66,17 +80,22 @@ class GEMMGenerator :
 
         A(i, j) = As(i % s, j, i / s);
 
-        Btmp(i, j) = (*B_in)(i, j);
+        Btmp(i, j) = BoundaryConditions::constant_exterior(*B_in, cast<T>(0))(i, j);
         if (transpose_B) {
             B(i, j) = Btmp(j, i);
         } else {
             B(i, j) = Btmp(i, j);
         }
 
-        Var k("k");
+        // Pack B into panels nr columns wide, with the columns of a
+        // panel interleaved, so that the micro-kernel reads each
+        // panel contiguously, as it does the panels of A.
+        Bs(j, k, jo) = B(k, jo*nr + j);
+        Bp(k, j) = Bs(j % nr, k, j / nr);
+
         Func prod;
         // Express all the products we need to do a matrix multiply as a 3D Func.
-        prod(k, i, j) = A(i, k) * B(k, j);
+        prod(k, i, j) = A(i, k) * Bp(k, j);
 
         // Reduce the products along k.
         Func AB("AB");
@@ -94,16 +113,17 @@ class GEMMGenerator :
         // Do the part that makes it a 'general' matrix multiply.
         result_(i, j) = (a_ * ABt(i, j) + b_ * C_(i, j));
 
-        result_.tile(i, j, ti[1], tj[1], i, j, 2*s, 2*s, TailStrategy::GuardWithIf);
         if (transpose_AB) {
             result_
-                .tile(i, j, ii, ji, 4, s)
-                .tile(i, j, ti[0], tj[0], i, j, s/4, 1);
+                .tile(i, j, ti[1], tj[1], i, j, 2*nc, 2*s, TailStrategy::GuardWithIf)
+                .tile(i, j, ii, ji, nr, s)
+                .tile(i, j, ti[0], tj[0], i, j, nc/nr, 1);
 
         } else {
             result_
-                .tile(i, j, ii, ji, s, 4)
-                .tile(i, j, ti[0], tj[0], i, j, 1, s/4);
+                .tile(i, j, ti[1], tj[1], i, j, 2*s, 2*nc, TailStrategy::GuardWithIf)
+                .tile(i, j, ii, ji, s, nr)
+                .tile(i, j, ti[0], tj[0], i, j, 1, nc/nr);
         }
 
         // If we have enough work per task, parallelize over these tiles.
@@ -128,25 +148,24 @@ class GEMMGenerator :
         Atmp.compute_at(As, io)
             .vectorize(i).unroll(j);
 
+        // B is packed up front, like A. The panels are interleaved
+        // from columns of B, or from rows if B is transposed.
+        Bs.compute_root().bound(j, 0, nr);
         if (transpose_B) {
-            B.compute_at(result_, t)
-                .tile(i, j, ii, ji, 8, 8)
-                .vectorize(ii).unroll(ji);
-            Btmp.reorder_storage(j, i)
-                .compute_at(B, i)
-                .vectorize(i)
-                .unroll(j);
+            Bs.vectorize(j);
+        } else {
+            Bs.split(k, k, ii, vec).reorder(j, ii, k, jo).unroll(j).vectorize(ii);
         }
-
+        Bs.specialize(B_.width() >= 256 && B_.height() >= 256).parallel(jo, 4);
 
         AB.compute_at(result_, i)
-            .bound_extent(j, 4).unroll(j)
+            .bound_extent(j, nr).unroll(j)
             .bound_extent(i, s).vectorize(i)
             .update()
             .reorder(i, j, rv).unroll(j).unroll(rv, 2).vectorize(i);
         if (transpose_AB) {
             ABt.compute_at(result_, i)
-                .bound_extent(i, 4).unroll(i)
+                .bound_extent(i, nr).unroll(i)
                 .bound_extent(j, s).vectorize(j);
         }
 
@@ -158,7 +177,98 @@ class GEMMGenerator :
     }
 };
 
+// Generator class for batches of small gemm operations, on matrices
+// of a size fixed at compile time. The matrices of a batch are
+// column-major and densely packed, one after the other, so that each
+// is a 2D slice of a 3D buffer. The whole product of a pair of
+// matrices is computed in registers, with the loops fully unrolled,
+// and the batch is split into parallel tasks.
+template<class T>
+class BatchedGEMMGenerator :
+        public Generator<BatchedGEMMGenerator<T>> {
+  public:
+    typedef Generator<BatchedGEMMGenerator<T>> Base;
+    using Base::natural_vector_size;
+    template<typename T2> using Input = typename Base::template Input<T2>;
+    template<typename T2> using Output = typename Base::template Output<T2>;
+
+    GeneratorParam<int> size_ = {"size", 4};
+
+    // Standard ordering of parameters in GEMM functions.
+    Input<T>         a_ = {"a_", 1};
+    Input<Buffer<T>> A_ = {"A_", 3};
+    Input<Buffer<T>> B_ = {"B_", 3};
+    Input<T>         b_ = {"b_", 1};
+    Input<Buffer<T>> C_ = {"C_", 3};
+
+    Output<Buffer<T>> result_ = {"result", 3};
+
+    void generate() {
+        const int n = size_;
+
+        Var i("i"), j("j"), m("m");
+        RDom rv(0, n);
+
+        Func AB("AB");
+        AB(i, j, m) += A_(i, rv, m) * B_(rv, j, m);
+        result_(i, j, m) = a_ * AB(i, j, m) + b_ * C_(i, j, m);
+
+        // Vectorize down the columns, as far as a column allows.
+        int vec = natural_vector_size(a_.type());
+        while (vec > 1 && n % vec != 0) {
+            vec /= 2;
+        }
+
+        // Compute the result in blocks of columns small enough for
+        // their accumulators to stay in registers (about 12 vectors,
+        // which leaves room on every ISA with 16 or more).
+        int cols = std::max(1, 12 / (n / vec));
+        while (n % cols != 0) {
+            cols--;
+        }
+
+        // Give each task enough matrices to be worth the cost of the
+        // task.
+        const int per_task = std::max(1, 16384 / (n * n * n));
+
+        Var jo("jo"), ji("ji"), mo("mo"), mi("mi");
+        result_
+            .bound(i, 0, n).bound(j, 0, n)
+            .split(j, jo, ji, cols)
+            .reorder(i, ji, jo, m)
+            .split(m, mo, mi, per_task, TailStrategy::GuardWithIf)
+            .parallel(mo);
+        if (n / cols <= 4) {
+            result_.unroll(jo);
+        }
+
+        AB.compute_at(result_, jo)
+            .update()
+            .reorder(i, j, rv)
+            .unroll(rv);
+
+        if (vec > 1) {
+            result_.vectorize(i, vec);
+            AB.vectorize(i, vec);
+            AB.update().vectorize(i, vec);
+        }
+        result_.unroll(i).unroll(ji);
+        AB.unroll(i).unroll(j);
+        AB.update().unroll(i).unroll(j);
+
+        A_.dim(0).set_bounds(0, n).dim(1).set_bounds(0, n).set_stride(n);
+        B_.dim(0).set_bounds(0, n).dim(1).set_bounds(0, n).set_stride(n);
+        C_.dim(0).set_bounds(0, n).dim(1).set_bounds(0, n).set_stride(n);
+        result_.dim(0).set_bounds(0, n).dim(1).set_bounds(0, n).set_stride(n);
+        B_.dim(2).set_bounds(A_.dim(2).min(), A_.dim(2).extent());
+        C_.dim(2).set_bounds(A_.dim(2).min(), A_.dim(2).extent());
+        result_.dim(2).set_bounds(A_.dim(2).min(), A_.dim(2).extent());
+    }
+};
+
 }  // namespace
 
 HALIDE_REGISTER_GENERATOR(GEMMGenerator<float>, sgemm)
 HALIDE_REGISTER_GENERATOR(GEMMGenerator<double>, dgemm)
+HALIDE_REGISTER_GENERATOR(BatchedGEMMGenerator<float>, sgemm_batched)
+HALIDE_REGISTER_GENERATOR(BatchedGEMMGenerator<double>, dgemm_batched)
@@ -29,6 +29,12 @@ Buffer<T> init_matrix_buffer(const int M, const int N, T *A, const int lda) {
     return Buffer<T>(A, 2, shape);
 }
 
+template<typename T>
+Buffer<T> init_matrix_batch_buffer(const int N, const int batch_size, T *A) {
+    halide_dimension_t shape[] = {{0, N, 1}, {0, N, N}, {0, batch_size, N * N}};
+    return Buffer<T>(A, 3, shape);
+}
+
 }
 
 #ifdef __cplusplus
@@ -279,6 +285,37 @@ void hblas_dgemm(const enum HBLAS_ORDER Order, const enum HBLAS_TRANSPOSE TransA
     assert_no_error(halide_dgemm(tA, tB, alpha, buff_A, buff_B, beta, buff_C));
 }
 
+//////////////////
+// gemm_batched //
+//////////////////
+
+void hblas_sgemm_batched(const int N, const int batch_size, const float alpha,
+                         const float *A, const float *B, const float beta, float *C) {
+    auto buff_A = init_matrix_batch_buffer(N, batch_size, const_cast<float*>(A));
+    auto buff_B = init_matrix_batch_buffer(N, batch_size, const_cast<float*>(B));
+    auto buff_C = init_matrix_batch_buffer(N, batch_size, C);
+
+    if (halide_sgemm_batched(N, alpha, buff_A, buff_B, beta, buff_C) != 0) {
+        for (int i = 0; i < batch_size; i++) {
+            hblas_sgemm(HblasColMajor, HblasNoTrans, HblasNoTrans, N, N, N,
+                        alpha, A + i * N * N, N, B + i * N * N, N, beta, C + i * N * N, N);
+        }
+    }
+}
+
+void hblas_dgemm_batched(const int N, const int batch_size, const double alpha,
+                         const double *A, const double *B, const double beta, double *C) {
+    auto buff_A = init_matrix_batch_buffer(N, batch_size, const_cast<double*>(A));
+    auto buff_B = init_matrix_batch_buffer(N, batch_size, const_cast<double*>(B));
+    auto buff_C = init_matrix_batch_buffer(N, batch_size, C);
+
+    if (halide_dgemm_batched(N, alpha, buff_A, buff_B, beta, buff_C) != 0) {
+        for (int i = 0; i < batch_size; i++) {
+            hblas_dgemm(HblasColMajor, HblasNoTrans, HblasNoTrans, N, N, N,
+                        alpha, A + i * N * N, N, B + i * N * N, N, beta, C + i * N * N, N);
+        }
+    }
+}
 
 #ifdef __cplusplus
 }
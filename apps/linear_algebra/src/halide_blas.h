@@ -28,6 +28,14 @@
 #include "halide_dgemm_transB.h"
 #include "halide_sgemm_transAB.h"
 #include "halide_dgemm_transAB.h"
+#include "halide_sgemm_batched_4.h"
+#include "halide_sgemm_batched_8.h"
+#include "halide_sgemm_batched_16.h"
+#include "halide_sgemm_batched_32.h"
+#include "halide_dgemm_batched_4.h"
+#include "halide_dgemm_batched_8.h"
+#include "halide_dgemm_batched_16.h"
+#include "halide_dgemm_batched_32.h"
 
 inline int halide_scopy(halide_buffer_t *x, halide_buffer_t *y) {
     return halide_scopy_impl(0, x, nullptr, y);
@@ -103,6 +111,29 @@ inline int halide_dgemm(bool transA, bool transB, double a, halide_buffer_t *A,
     return -1;
 }
 
+// Batched gemm of N x N matrices, with A, B and C each a densely
+// packed batch of column-major matrices (an N x N x batch
+// buffer). Returns -1 if there's no kernel for N.
+inline int halide_sgemm_batched(int N, float a, halide_buffer_t *A, halide_buffer_t *B, float b, halide_buffer_t *C) {
+    switch (N) {
+    case 4: return halide_sgemm_batched_4(a, A, B, b, C, C);
+    case 8: return halide_sgemm_batched_8(a, A, B, b, C, C);
+    case 16: return halide_sgemm_batched_16(a, A, B, b, C, C);
+    case 32: return halide_sgemm_batched_32(a, A, B, b, C, C);
+    }
+    return -1;
+}
+
+inline int halide_dgemm_batched(int N, double a, halide_buffer_t *A, halide_buffer_t *B, double b, halide_buffer_t *C) {
+    switch (N) {
+    case 4: return halide_dgemm_batched_4(a, A, B, b, C, C);
+    case 8: return halide_dgemm_batched_8(a, A, B, b, C, C);
+    case 16: return halide_dgemm_batched_16(a, A, B, b, C, C);
+    case 32: return halide_dgemm_batched_32(a, A, B, b, C, C);
+    }
+    return -1;
+}
+
 enum HBLAS_ORDER {HblasRowMajor=101, HblasColMajor=102};
 enum HBLAS_TRANSPOSE {HblasNoTrans=111, HblasTrans=112, HblasConjTrans=113};
 enum HBLAS_UPLO {HblasUpper=121, HblasLower=122};
@@ -244,6 +275,19 @@ void hblas_dgemm(const enum HBLAS_ORDER Order, const enum HBLAS_TRANSPOSE TransA
                  const int lda, const double *B, const int ldb,
                  const double beta, double *C, const int ldc);
 
+/*
+ * Batched gemm of many small N x N matrices: C[i] = alpha * A[i] * B[i] +
+ * beta * C[i] for each of the batch_size matrices, which are
+ * column-major and densely packed one after the other, so that matrix
+ * i starts at element i * N * N. Sizes without a batched kernel are
+ * done one gemm at a time.
+ */
+void hblas_sgemm_batched(const int N, const int batch_size, const float alpha,
+                         const float *A, const float *B, const float beta, float *C);
+
+void hblas_dgemm_batched(const int N, const int batch_size, const double alpha,
+                         const double *A, const double *B, const double beta, double *C);
+
 #ifdef __cplusplus
 }
 #endif
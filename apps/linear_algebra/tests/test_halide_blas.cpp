@@ -111,6 +111,32 @@
         return compareMatrices(N, eC, aC);      \
     }
 
+#define BATCHED_GEMM_TEST(method, cblas_code, hblas_code)      \
+    bool test_##method(int N) {                                 \
+        const int batch_size = 100;                             \
+        Scalar alpha = random_scalar();                         \
+        Scalar beta = random_scalar();                          \
+        Matrix eA(random_matrix(N, batch_size));                \
+        Matrix eB(random_matrix(N, batch_size));                \
+        Matrix eC(random_matrix(N, batch_size));                \
+        Matrix aA(eA), aB(eB), aC(eC);                          \
+                                                                \
+        for (int i = 0; i < batch_size; i++) {                  \
+            Scalar *A = &(eA[i * N * N]);                       \
+            Scalar *B = &(eB[i * N * N]);                       \
+            Scalar *C = &(eC[i * N * N]);                       \
+            cblas_code;                                         \
+        }                                                       \
+                                                                \
+        {                                                       \
+            Scalar *A = &(aA[0]);                               \
+            Scalar *B = &(aB[0]);                               \
+            Scalar *C = &(aC[0]);                               \
+            hblas_code;                                         \
+        }                                                       \
+                                                                \
+        return compareMatrices(N, eC, aC, batch_size);          \
+    }
 
 template<class T>
 struct BLASTestBase {
@@ -136,9 +162,9 @@ struct BLASTestBase {
         return buff;
     }
 
-    Matrix random_matrix(int N) {
-        Matrix buff(N * N);
-        for (int i=0; i<N*N; ++i) {
+    Matrix random_matrix(int N, int batch_size = 1) {
+        Matrix buff(N * N * batch_size);
+        for (int i=0; i<N*N*batch_size; ++i) {
             buff[i] = random_scalar();
         }
         return buff;
@@ -182,12 +208,16 @@ struct BLASTestBase {
         return equal;
     }
 
-    bool compareMatrices(int N, const Matrix &A, const Matrix &B,
+    bool compareMatrices(int N, const Matrix &A, const Matrix &B, int batch_size = 1,
                          Scalar epsilon = 16 * std::numeric_limits<Scalar>::epsilon()) {
         bool equal = true;
-        for (int i = 0; i < N*N; ++i) {
+        for (int i = 0; i < N*N*batch_size; ++i) {
             if (!compareScalars(A[i], B[i], epsilon)) {
-                std::cerr << "Matrices differ at coords: (" << i%N << ", " << i/N << ")\n";
+                std::cerr << "Matrices differ at coords: (" << i%N << ", " << (i/N)%N << ")";
+                if (batch_size > 1) {
+                    std::cerr << " of matrix " << i/(N*N);
+                }
+                std::cerr << "\n";
                 equal = false;
                 break;
             }
@@ -212,6 +242,10 @@ struct BLASFloatTests : public BLASTestBase<float> {
         RUN_TEST(sgemm_transAB);
     }
 
+    void run_batched_tests(int N) {
+        RUN_TEST(sgemm_batched);
+    }
+
     L1_VECTOR_TEST(scopy, scopy(N, x, 1, y, 1))
     L1_VECTOR_TEST(sscal, sscal(N, alpha, y, 1))
     L1_VECTOR_TEST(saxpy, saxpy(N, alpha, x, 1, y, 1))
@@ -241,6 +275,9 @@ struct BLASFloatTests : public BLASTestBase<float> {
     L3_TEST(sgemm_transAB,
             cblas_sgemm(CblasColMajor, CblasTrans, CblasTrans, N, N, N, alpha, A, N, B, N, beta, C, N),
             hblas_sgemm(HblasColMajor, HblasTrans, HblasTrans, N, N, N, alpha, A, N, B, N, beta, C, N));
+    BATCHED_GEMM_TEST(sgemm_batched,
+            cblas_sgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, N, N, N, alpha, A, N, B, N, beta, C, N),
+            hblas_sgemm_batched(N, batch_size, alpha, A, B, beta, C));
 };
 
 struct BLASDoubleTests : public BLASTestBase<double> {
@@ -259,6 +296,10 @@ struct BLASDoubleTests : public BLASTestBase<double> {
         RUN_TEST(dgemm_transAB);
     }
 
+    void run_batched_tests(int N) {
+        RUN_TEST(dgemm_batched);
+    }
+
     L1_VECTOR_TEST(dcopy, dcopy(N, x, 1, y, 1))
     L1_VECTOR_TEST(dscal, dscal(N, alpha, y, 1))
     L1_VECTOR_TEST(daxpy, daxpy(N, alpha, x, 1, y, 1))
@@ -288,6 +329,9 @@ struct BLASDoubleTests : public BLASTestBase<double> {
     L3_TEST(dgemm_transAB,
             cblas_dgemm(CblasColMajor, CblasTrans, CblasTrans, N, N, N, alpha, A, N, B, N, beta, C, N),
             hblas_dgemm(HblasColMajor, HblasTrans, HblasTrans, N, N, N, alpha, A, N, B, N, beta, C, N));
+    BATCHED_GEMM_TEST(dgemm_batched,
+            cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, N, N, N, alpha, A, N, B, N, beta, C, N),
+            hblas_dgemm_batched(N, batch_size, alpha, A, B, beta, C));
 };
 
 int main(int argc, char *argv[]) {
@@ -308,4 +352,11 @@ int main(int argc, char *argv[]) {
         s.run_tests(size);
         d.run_tests(size);
     }
+
+    // The sizes with batched kernels, and one without.
+    for (int size : {4, 8, 16, 32, 12}) {
+        std::cout << "Testing batched halide_blas with N = " << size << ":\n";
+        s.run_batched_tests(size);
+        d.run_batched_tests(size);
+    }
 }
@@ -7,6 +7,10 @@ constexpr int maxJ = 20;
 class LocalLaplacian : public Halide::Generator<LocalLaplacian> {
 public:
     GeneratorParam<int>     pyramid_levels{"pyramid_levels", 8, 1, maxJ};
+    // On CUDA, fuse pairs of levels of the output pyramid into one
+    // kernel through shared memory. Set this to false to use the
+    // basic GPU schedule instead, e.g. to compare them.
+    GeneratorParam<bool>    shared_memory_schedule{"shared_memory_schedule", true};
 
     Input<Buffer<uint16_t>> input{"input", 3};
     Input<int>              levels{"levels"};
@@ -101,6 +105,36 @@ public:
             output.estimate(x, 0, 1536)
                 .estimate(y, 0, 2560)
                 .estimate(c, 0, 3);
+        } else if (get_target().has_feature(Target::CUDA) && shared_memory_schedule) {
+            // Like the basic gpu schedule below, with fewer kernels. A
+            // level of the output pyramid is only read by upsampling it
+            // into the next finer level, so rather than writing it to
+            // global memory in its own kernel, compute it in shared
+            // memory for each block of that level. Levels 0 and 1 are
+            // computed per block of the output, and level 3 per block
+            // of level 2. The coarser levels are too small to gain
+            // from it.
+            remap.compute_root();
+            Var xi, yi;
+            output.compute_root().gpu_tile(x, y, xi, yi, 16, 8);
+            for (int j = 0; j < J; j++) {
+                int blockw = 16, blockh = 8;
+                if (j > 3) {
+                    blockw = 2;
+                    blockh = 2;
+                }
+                if (j > 0) {
+                    inGPyramid[j].compute_root().gpu_tile(x, y, xi, yi, blockw, blockh);
+                    gPyramid[j].compute_root().reorder(k, x, y).gpu_tile(x, y, xi, yi, blockw, blockh);
+                }
+                if (j < 2) {
+                    outGPyramid[j].compute_at(output, x).gpu_threads(x, y);
+                } else if (j == 3) {
+                    outGPyramid[j].compute_at(outGPyramid[2], x).gpu_threads(x, y);
+                } else {
+                    outGPyramid[j].compute_root().gpu_tile(x, y, xi, yi, blockw, blockh);
+                }
+            }
         } else if (get_target().has_gpu_feature()) {
             // gpu schedule
             remap.compute_root();
@@ -5,6 +5,9 @@
 #ifndef NO_AUTO_SCHEDULE
 #include "local_laplacian_auto_schedule.h"
 #endif
+#ifdef COMPARE_BASIC_GPU_SCHEDULE
+#include "local_laplacian_basic_gpu.h"
+#endif
 
 #include "halide_benchmark.h"
 #include "HalideBuffer.h"
@@ -46,6 +49,14 @@ int main(int argc, char **argv) {
     printf("Auto-scheduled time: %gms\n", best_auto * 1e3);
     #endif
 
+    #ifdef COMPARE_BASIC_GPU_SCHEDULE
+    // The GPU schedule without fused levels
+    double best_basic = benchmark(timing, 1, [&]() {
+        local_laplacian_basic_gpu(input, levels, alpha/(levels-1), beta, output);
+    });
+    printf("Basic GPU schedule time: %gms\n", best_basic * 1e3);
+    #endif
+
     convert_and_save_image(output, argv[6]);
 
     return 0;
@@ -74,32 +74,65 @@ public:
     Var x, y, c, k;
 
     // Intermediate Funcs
-    Func as_float, clamped, resized_x, resized_y,
+    Func as_float, clamped, box, box_y, resized_x, resized_y,
         unnormalized_kernel_x, unnormalized_kernel_y,
         kernel_x, kernel_y,
         kernel_sum_x, kernel_sum_y;
 
+    // uint8 images are resized in fixed point. The kernels have
+    // weight_bits fractional bits, and the result of the first pass
+    // is stored as int16 with intermediate_bits fractional bits.
+    static const int weight_bits = 14;
+    static const int intermediate_bits = 6;
+
+    bool fixed_point() const {
+        return input.type() == UInt(8);
+    }
+
     void generate() {
 
         clamped = BoundaryConditions::repeat_edge(input,
                  {{input.dim(0).min(), input.dim(0).extent()},
                   {input.dim(1).min(), input.dim(1).extent()}});
 
+        // For large downscales, the kernels below would need
+        // O(1/scale_factor) taps. Instead, first average boxes of
+        // prefilter x prefilter pixels, which reads each input pixel
+        // once, so the rest of the downscale is by a factor of at
+        // most 2, with a few taps.
+        Expr prefilter = 1;
+        Func source = clamped;
+        if (!upsample) {
+            prefilter = max(1, cast<int>(floor(0.5f / scale_factor)));
+            RDom rb(0, prefilter);
+            Type sum_type = input.type().is_float() ? Float(32) : UInt(32);
+            box_y(x, y, c) = sum(cast(sum_type, clamped(x, y * prefilter + rb, c)));
+            Expr box_sum = sum(box_y(x * prefilter + rb, y, c));
+            Expr area = prefilter * prefilter;
+            if (input.type().is_float()) {
+                box(x, y, c) = box_sum / area;
+            } else {
+                box(x, y, c) = cast(input.type(), (box_sum + cast<uint32_t>(area / 2)) / cast<uint32_t>(area));
+            }
+            source = box;
+        }
+        Expr scale = scale_factor * prefilter;
+
         // Handle different types by just casting to float
-        as_float(x, y, c) = cast<float>(clamped(x, y, c));
+        as_float(x, y, c) = cast<float>(source(x, y, c));
 
         // For downscaling, widen the interpolation kernel to perform lowpass
         // filtering.
 
-        Expr kernel_scaling = upsample ? Expr(1.0f) : scale_factor;
+        Expr kernel_scaling = upsample ? Expr(1.0f) : scale;
 
         Expr kernel_radius = 0.5f * kernel_info[interpolation_type].taps / kernel_scaling;
 
         Expr kernel_taps = ceil(kernel_info[interpolation_type].taps / kernel_scaling);
 
         // source[xy] are the (non-integer) coordinates inside the source image
-        Expr sourcex = (x + 0.5f) / scale_factor - 0.5f;
-        Expr sourcey = (y + 0.5f) / scale_factor - 0.5f;
+        Expr sourcex = (x + 0.5f) / scale - 0.5f;
+        Expr sourcey = (y + 0.5f) / scale - 0.5f;
 
         // Initialize interpolation kernels. Since we allow an arbitrary
         // scaling factor, the filter coefficients are different for each x
@@ -116,14 +149,40 @@ public:
         kernel_sum_x(x) = sum(unnormalized_kernel_x(x, r));
         kernel_sum_y(y) = sum(unnormalized_kernel_y(y, r));
 
-        kernel_x(x, k) = unnormalized_kernel_x(x, k) / kernel_sum_x(x);
-        kernel_y(y, k) = unnormalized_kernel_y(y, k) / kernel_sum_y(y);
+        Expr normalized_x = unnormalized_kernel_x(x, k) / kernel_sum_x(x);
+        Expr normalized_y = unnormalized_kernel_y(y, k) / kernel_sum_y(y);
+        if (fixed_point()) {
+            kernel_x(x, k) = cast<int16_t>(round(normalized_x * (1 << weight_bits)));
+            kernel_y(y, k) = cast<int16_t>(round(normalized_y * (1 << weight_bits)));
+        } else {
+            kernel_x(x, k) = normalized_x;
+            kernel_y(y, k) = normalized_y;
+        }
 
         // Perform separable resizing. The resize in x vectorizes
         // poorly compared to the resize in y, so do it first if we're
         // upsampling, and do it second if we're downsampling.
         Func resized;
-        if (upsample) {
+        if (fixed_point()) {
+            // The first pass rounds away the fractional bits of the
+            // weights it doesn't keep. The second pass can't overflow,
+            // because the weights of each output sum to one.
+            auto first_pass = [&](Expr sum_of_products) {
+                const int shift = weight_bits - intermediate_bits;
+                Expr rounded = (sum_of_products + (1 << (shift - 1))) >> shift;
+                return cast<int16_t>(clamp(rounded, -32768, 32767));
+            };
+            auto widen = [](Expr e) { return cast<int32_t>(e); };
+            if (upsample) {
+                resized_x(x, y, c) = first_pass(sum(widen(kernel_x(x, r)) * widen(source(r + beginx, y, c))));
+                resized_y(x, y, c) = sum(widen(kernel_y(y, r)) * widen(resized_x(x, r + beginy, c)));
+                resized = resized_y;
+            } else {
+                resized_y(x, y, c) = first_pass(sum(widen(kernel_y(y, r)) * widen(source(x, r + beginy, c))));
+                resized_x(x, y, c) = sum(widen(kernel_x(x, r)) * widen(resized_y(r + beginx, y, c)));
+                resized = resized_x;
+            }
+        } else if (upsample) {
             resized_x(x, y, c) = sum(kernel_x(x, r) * as_float(r + beginx, y, c));
             resized_y(x, y, c) = sum(kernel_y(y, r) * resized_x(x, r + beginy, c));
             resized = resized_y;
@@ -133,7 +192,10 @@ public:
             resized = resized_x;
         }
 
-        if (input.type().is_float()) {
+        if (fixed_point()) {
+            const int shift = weight_bits + intermediate_bits;
+            output(x, y, c) = saturating_cast<uint8_t>((resized(x, y, c) + (1 << (shift - 1))) >> shift);
+        } else if (input.type().is_float()) {
             output(x, y, c) = clamp(resized(x, y, c), 0.0f, 1.0f);
         } else {
             output(x, y, c) = saturating_cast(input.type(), resized(x, y, c));
@@ -163,6 +225,9 @@ public:
             .compute_at(output, y)
             .reorder(k, y).vectorize(y, 8);
 
+        // The fixed point intermediates are int16, so they use
+        // vectors of twice as many lanes.
+        const int vec = fixed_point() ? 16 : 8;
         if (upsample) {
             output
                 .tile(x, y, xi, yi, 16, 64)
@@ -170,10 +235,12 @@ public:
                 .vectorize(xi);
             resized_x
                 .compute_at(output, x)
-                .vectorize(x, 8);
-            as_float
-                .compute_at(output, y)
-                .vectorize(x, 8);
+                .vectorize(x, vec);
+            if (!fixed_point()) {
+                as_float
+                    .compute_at(output, y)
+                    .vectorize(x, 8);
+            }
         } else {
             output
                 .tile(x, y, xi, yi, 32, 8)
@@ -181,9 +248,15 @@ public:
                 .vectorize(xi);
             resized_y
                 .compute_at(output, y)
-                .vectorize(x, 8);
+                .vectorize(x, vec);
             resized_x
                 .compute_at(output, xi);
+            box
+                .compute_at(output, y)
+                .vectorize(x, vec);
+            box_y
+                .compute_at(box, y)
+                .vectorize(x, vec);
         }
 
         // Allow the input and output to have arbitrary memory layout,
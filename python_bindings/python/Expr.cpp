@@ -109,5 +109,15 @@ void defineExpr() {
         .value("GLSL", h::DeviceAPI::GLSL)
         .export_values();
 
+    p::enum_<h::MemoryType>("MemoryType",
+                            "An enum describing different address spaces to be used with Func.store_in.")
+        .value("Auto", h::MemoryType::Auto)
+        .value("Heap", h::MemoryType::Heap)
+        .value("Stack", h::MemoryType::Stack)
+        .value("Register", h::MemoryType::Register)
+        .value("GPUShared", h::MemoryType::GPUShared)
+        .value("VTCM", h::MemoryType::VTCM)
+        .export_values();
+
     return;
 }
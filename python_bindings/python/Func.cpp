@@ -21,6 +21,21 @@
 namespace h = Halide;
 namespace p = boost::python;
 
+// Release the GIL for the lifetime of this object, so that other Python
+// threads can run while Halide compiles or runs a pipeline. Nothing
+// done while it's released may touch Python objects.
+class ScopedReleaseGIL {
+    PyThreadState *state;
+
+public:
+    ScopedReleaseGIL()
+        : state(PyEval_SaveThread()) {
+    }
+    ~ScopedReleaseGIL() {
+        PyEval_RestoreThread(state);
+    }
+};
+
 p::object realization_to_python_object(const h::Realization &r) {
     if (r.size() == 1) {
         return buffer_to_python_object(r[0]);
@@ -49,25 +64,34 @@ h::Realization python_object_to_realization(p::object obj) {
 
 template <typename... Args>
 p::object func_realize(h::Func &f, Args... args) {
-    return realization_to_python_object(f.realize(args...));
+    h::Realization r = [&]() {
+        ScopedReleaseGIL release;
+        return f.realize(args...);
+    }();
+    return realization_to_python_object(r);
 }
 
 template <typename... Args>
 void func_realize_into(h::Func &f, Args... args) {
+    ScopedReleaseGIL release;
     f.realize(args...);
 }
 
 template <typename... Args>
 void func_realize_tuple(h::Func &f, p::tuple obj, Args... args) {
-    f.realize(python_object_to_realization(obj), args...);
+    h::Realization r = python_object_to_realization(obj);
+    ScopedReleaseGIL release;
+    f.realize(r, args...);
 }
 
 void func_compile_jit0(h::Func &that) {
+    ScopedReleaseGIL release;
     that.compile_jit();
     return;
 }
 
 void func_compile_jit1(h::Func &that, const h::Target &target = h::get_target_from_environment()) {
+    ScopedReleaseGIL release;
     that.compile_jit(target);
     return;
 }
@@ -637,6 +661,10 @@ void defineFunc() {
                    p::return_internal_reference<1>(),
                    "Equivalent to Func.store_at, but schedules storage outside the outermost loop.");
 
+    func_class.def("store_in", &Func::store_in, p::args("self", "memory_type"),
+                   p::return_internal_reference<1>(),
+                   "Set the type of memory this Func should be stored in.");
+
     func_class.def("compute_inline", &Func::compute_inline, p::arg("self"),
                    p::return_internal_reference<1>(),
                    "Aggressively inline all uses of this function. This is the "
@@ -239,6 +239,40 @@ int buffer_extent(h::Buffer<T> &im, int d) {
 
 
 
+// The numpy type string for a Halide type, e.g. "<f4".
+std::string type_to_typestr(const h::Type &t) {
+    const uint16_t one = 1;
+    const bool little_endian = *(const uint8_t *)&one == 1;
+    std::string typestr = t.bytes() == 1 ? "|" : (little_endian ? "<" : ">");
+    typestr += t.is_float() ? 'f' : (t.is_uint() ? 'u' : 'i');
+    typestr += std::to_string(t.bytes());
+    return typestr;
+}
+
+// The numpy array interface, so that numpy.array(buffer, copy=False)
+// and numpy.asarray(buffer) are views of the buffer's data, with axis i
+// of the array being dimension i of the buffer (as for
+// buffer_to_ndarray). The array keeps the buffer alive.
+template <typename T>
+p::dict buffer_array_interface(h::Buffer<T> &that) {
+    if (that.data() == nullptr) {
+        throw std::invalid_argument("Can't view a Buffer with a null host pointer as an array");
+    }
+    that.copy_to_host();
+    p::list shape, strides;
+    for (int i = 0; i < that.dimensions(); i++) {
+        shape.append(that.dim(i).extent());
+        strides.append((int64_t)that.dim(i).stride() * (int64_t)sizeof(T));
+    }
+    p::dict interface;
+    interface["shape"] = p::tuple(shape);
+    interface["strides"] = p::tuple(strides);
+    interface["typestr"] = type_to_typestr(that.type());
+    interface["data"] = p::make_tuple((uintptr_t)that.data(), false);
+    interface["version"] = 3;
+    return interface;
+}
+
 template <typename T>
 void defineBuffer_impl(const std::string suffix, const h::Type type) {
     using h::Buffer;
@@ -285,6 +319,10 @@ void defineBuffer_impl(const std::string suffix, const h::Type type) {
     buffer_class
         .def("__repr__", buffer_repr<T>, p::arg("self"));
 
+    buffer_class
+        .add_property("__array_interface__", buffer_array_interface<T>,
+                      "The numpy array interface, which lets numpy view the buffer's data without copying it.");
+
     buffer_class
         .def("data", buffer_data<T>, p::arg("self"),
              p::return_value_policy<p::return_opaque_pointer>(),  // not sure this will do what we want
@@ -543,6 +581,78 @@ bn::ndarray buffer_to_ndarray(p::object buffer_object) {
 
 #endif
 
+// The Halide type of the elements of a Python buffer, from its struct
+// module format string.
+h::Type buffer_format_to_type(const char *format, Py_ssize_t itemsize) {
+    std::string f = format ? format : "B";
+    const uint16_t one = 1;
+    const bool little_endian = *(const uint8_t *)&one == 1;
+    if (f.size() == 2 && (f[0] == '@' || f[0] == '=' ||
+                          (f[0] == '<' && little_endian) ||
+                          ((f[0] == '>' || f[0] == '!') && !little_endian))) {
+        f = f.substr(1);
+    }
+    if (f.size() == 1) {
+        const int bits = (int)itemsize * 8;
+        switch (f[0]) {
+        case 'b': case 'h': case 'i': case 'l': case 'q':
+            if (bits <= 32) return h::Int(bits);
+            break;
+        case 'B': case 'H': case 'I': case 'L': case 'Q':
+            if (bits <= 32) return h::UInt(bits);
+            break;
+        case 'f':
+        case 'd':
+            return h::Float(bits);
+        }
+    }
+    throw std::invalid_argument("Buffer received an object whose elements have unsupported format \"" +
+                                std::string(format ? format : "") + "\"");
+    return h::Type();
+}
+
+void release_buffer_view(PyObject *capsule) {
+    Py_buffer *view = (Py_buffer *)PyCapsule_GetPointer(capsule, nullptr);
+    PyBuffer_Release(view);
+    delete view;
+}
+
+/// Will create a Halide::Buffer object pointing to the memory of any
+/// object supporting the Python buffer protocol (a numpy array, a
+/// bytearray, a memoryview, an array.array...), with axis i of the
+/// object as dimension i of the Buffer.
+p::object buffer_protocol_to_buffer(p::object obj) {
+    Py_buffer *view = new Py_buffer;
+    if (PyObject_GetBuffer(obj.ptr(), view, PyBUF_STRIDES | PyBUF_FORMAT | PyBUF_WRITABLE) != 0) {
+        // Read-only memory is still fine as an input.
+        PyErr_Clear();
+        if (PyObject_GetBuffer(obj.ptr(), view, PyBUF_STRIDES | PyBUF_FORMAT) != 0) {
+            delete view;
+            p::throw_error_already_set();
+        }
+    }
+    // The view must be held for as long as the Buffer uses the memory,
+    // so that e.g. a bytearray can't be resized under it. The capsule
+    // releases it when it goes away.
+    p::object capsule(p::handle<>(PyCapsule_New(view, nullptr, release_buffer_view)));
+
+    h::Type t = buffer_format_to_type(view->format, view->itemsize);
+    const int dims = view->ndim;
+    std::vector<halide_dimension_t> shape(dims);
+    for (int i = 0; i < dims; i++) {
+        if (view->strides[i] % view->itemsize != 0) {
+            throw std::invalid_argument("Buffer received an object with strides that aren't a multiple of its element size");
+        }
+        shape[i].min = 0;
+        shape[i].extent = (int32_t)view->shape[i];
+        shape[i].stride = (int32_t)(view->strides[i] / view->itemsize);
+    }
+
+    p::object result = buffer_to_python_object(h::Buffer<>(t, view->buf, dims, shape.data()));
+    result.attr("_buffer_view") = capsule;
+    return result;
+}
+
 struct BufferFactory {
 
     template <typename T, typename... Args>
@@ -609,7 +719,14 @@ void defineBuffer() {
     defineBuffer_impl<float>("_float32", h::Float(32));
     defineBuffer_impl<double>("_float64", h::Float(64));
 
-    // "Buffer" will look as a class, but instead it will be simply a factory method
+    // "Buffer" will look as a class, but instead it will be simply a factory method.
+    // Boost.Python tries the overloads defined last first, so this one,
+    // which accepts any object, goes first.
+    p::def("Buffer", &buffer_protocol_to_buffer,
+           p::args("obj"),
+           "Wrap the memory of an object supporting the buffer protocol (e.g. a numpy "
+           "array, bytearray or memoryview) in a Halide::Buffer, without copying it. "
+           "Axis i of the object is dimension i of the Buffer. The Buffer keeps the object alive.");
     p::def("Buffer", &BufferFactory::create_buffer0,
            p::args("type"),
            "Construct a zero-dimensional buffer of type T");
@@ -70,6 +70,7 @@ void defineTarget() {
         .value("OSX", Target::OS::OSX)
         .value("Android", Target::OS::Android)
         .value("IOS", Target::OS::IOS)
+        .value("WebAssemblyRuntime", Target::OS::WebAssemblyRuntime)
         .export_values();
 
     p::enum_<Target::Arch>("TargetArch",
@@ -80,6 +81,8 @@ void defineTarget() {
         .value("ARM", Target::Arch::ARM)
         .value("MIPS", Target::Arch::MIPS)
         .value("POWERPC", Target::Arch::POWERPC)
+        .value("WebAssembly", Target::Arch::WebAssembly)
+        .value("RISCV", Target::Arch::RISCV)
         .export_values();
 
     p::enum_<Target::Feature>("TargetFeature",
@@ -102,6 +105,8 @@ void defineTarget() {
 
         .value("VSX", Target::Feature::VSX)
         .value("POWER_ARCH_2_07", Target::Feature::POWER_ARCH_2_07)
+        .value("POWER_ARCH_3_00", Target::Feature::POWER_ARCH_3_00)
+        .value("POWER_ARCH_3_1", Target::Feature::POWER_ARCH_3_1)
 
         .value("CUDA", Target::Feature::CUDA)
         .value("CUDACapability30", Target::Feature::CUDACapability30)
@@ -116,6 +121,9 @@ void defineTarget() {
         .value("UserContext", Target::Feature::UserContext)
         .value("Matlab", Target::Feature::Matlab)
         .value("Metal", Target::Feature::Metal)
+        .value("TaskParallel", Target::Feature::TaskParallel)
+        .value("GPUKernelFusion", Target::Feature::GPUKernelFusion)
+        .value("SizeOptimized", Target::Feature::SizeOptimized)
         .value("FeatureEnd", Target::Feature::FeatureEnd)
 
         .export_values();
@@ -270,6 +270,45 @@ def test_image_to_ndarray():
 
     return
 
+def test_buffer_protocol():
+
+    import array
+
+    # A Buffer over an array.array shares its memory.
+    a0 = array.array('f', [0.0] * 12)
+    b0 = Buffer(a0)
+    assert b0.type() == Float(32)
+    assert b0.dimensions() == 1
+    assert b0.extent(0) == 12
+    b0[5] = 42.0
+    assert a0[5] == 42.0
+
+    # and so does a strided memoryview.
+    a1 = bytearray(range(16))
+    b1 = Buffer(memoryview(a1)[::2])
+    assert b1.type() == UInt(8)
+    assert b1.extent(0) == 8
+    assert b1.stride(0) == 2
+    assert b1(3) == 6
+
+    try:
+        import numpy
+    except ImportError:
+        print("Skipping numpy part of test_buffer_protocol")
+        return
+
+    # numpy can view a Buffer without copying it.
+    b2 = Buffer(Int(16), 20, 30)
+    b2[3, 4] = 7
+    a2 = numpy.asarray(b2)
+    assert a2.dtype == numpy.int16
+    assert a2.shape == (20, 30)
+    assert a2[3, 4] == 7
+    a2[5, 6] = 9
+    assert b2(5, 6) == 9
+
+    return
+
 def test_param_bug():
     "see https://github.com/rodrigob/Halide/issues/1"
 
@@ -297,6 +336,7 @@ if __name__ == "__main__":
     test_float_or_int()
     test_ndarray_to_image()
     test_image_to_ndarray()
+    test_buffer_protocol()
     test_types()
     test_operator_order()
     test_basics()
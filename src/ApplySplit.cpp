@@ -47,7 +47,8 @@ vector<ApplySplitResult> apply_split(const Split &split, bool is_update, string
         } else if (is_one(split.factor)) {
             // The split factor trivially divides the old extent,
             // but we know nothing new about the outer dimension.
-        } else if (tail == TailStrategy::GuardWithIf) {
+        } else if (tail == TailStrategy::GuardWithIf ||
+                   tail == TailStrategy::Predicate) {
             // It's an exact split but we failed to prove that the
             // extent divides the factor. Use predication.
 
@@ -57,7 +58,10 @@ vector<ApplySplitResult> apply_split(const Split &split, bool is_update, string
             // what it means for it to be limited by the if
             // statement's condition.
             Expr rebased = outer * split.factor + inner;
-            string rebased_var_name = prefix + split.old_var + ".rebased";
+            // The vectorizer recognizes a Predicate tail by the name
+            // of this var (see is_predicated_tail).
+            string rebased_var_name = prefix + split.old_var +
+                (tail == TailStrategy::Predicate ? ".predicated" : ".rebased");
             Expr rebased_var = Variable::make(Int(32), rebased_var_name);
 
             result.push_back(ApplySplitResult(
@@ -1,6 +1,8 @@
 #include "AssociativeOpsTable.h"
 #include "IRPrinter.h"
 
+#include <mutex>
+
 namespace Halide {
 namespace Internal {
 
@@ -112,6 +114,9 @@ struct TableKey {
 };
 
 static map<TableKey, vector<AssociativePattern>> pattern_tables;
+// Guards pattern_tables, which may be populated by several threads
+// lowering at once. Tables are never modified once populated.
+static std::mutex pattern_tables_mutex;
 
 #define declare_vars(t, index)                  \
     Expr x##index = Variable::make(t, "x" + std::to_string(index)); \
@@ -190,6 +195,14 @@ void populate_ops_table_double_general_sub(const vector<Type> &types, vector<Ass
 
 void populate_ops_table_double_general_select(const vector<Type> &types, vector<AssociativePattern> &table) {
     declare_vars_double(types);
+    // argmax/argmin written as a tuple_select, with the value last (as
+    // produced by Halide::argmax and Halide::argmin) or first. The first
+    // index at which the extremum is found wins ties. Elements solved
+    // for their own x have their comparison flipped by the solver.
+    table.push_back({{select(x1 < y1, y0, x0), select(x1 < y1, y1, x1)}, {zero_0, tmin_1}, true});
+    table.push_back({{select(y1 < x1, y0, x0), select(x1 > y1, y1, x1)}, {zero_0, tmax_1}, true});
+    table.push_back({{select(x0 < y0, y0, x0), select(x0 < y0, y1, x1)}, {tmin_0, zero_1}, true});
+    table.push_back({{select(x0 > y0, y0, x0), select(y0 < x0, y1, x1)}, {tmax_0, zero_1}, true});
 }
 
 void populate_ops_table_single_uint1_and(const vector<Type> &types, vector<AssociativePattern> &table) {
@@ -275,6 +288,7 @@ const vector<AssociativePattern> &get_ops_table_helper(const vector<Type> &types
     TableKey gen_key(ValType::All, root, dim);
     TableKey key(convert_halide_types_to_val_types(types), root, dim);
 
+    std::lock_guard<std::mutex> lock(pattern_tables_mutex);
     const auto &table_it = pattern_tables.find(key);
     if (table_it == pattern_tables.end()) { // Populate the table if we haven't done so previously
         vector<AssociativePattern> &table = pattern_tables[key];
@@ -154,6 +154,11 @@ bool associative_op_pattern_match(Expr e,
     return false;
 }
 
+// Return true if 'e' contains the subexpression 'sub'.
+bool contains_expr(const Expr &e, const Expr &sub) {
+    return !equal(substitute(sub, Variable::make(sub.type(), unique_name('t')), e), e);
+}
+
 // Return true if we are able to find a match in the table (i.e. the op can be
 // proven associative) and update 'assoc_op'.
 bool find_match(const vector<AssociativePattern> &table, const vector<string> &op_x_names,
@@ -201,16 +206,20 @@ bool find_match(const vector<AssociativePattern> &table, const vector<string> &o
 
             assoc_op.xs[index] = {op_x_names[index], x_parts[index]};
             assoc_op.ys[index] = {op_y_names[index], y_part};
-            replacement.push_back({y_part, Variable::make(y_part.type(), op_y_names[index])});
+            // Order of substitution matters: a y_part has to be substituted
+            // before any other y_part it contains, e.g. in the argmin case,
+            // _y_0 -> g(rx)[0] and _y_1 -> rx. If we substitute rx first,
+            // substitution of g(rx)[0] will fail. Insert it before the first
+            // replacement it contains.
+            auto pos = std::find_if(replacement.begin(), replacement.end(),
+                                    [&](const pair<Expr, Expr> &r) { return contains_expr(y_part, r.first); });
+            replacement.insert(pos, {y_part, Variable::make(y_part.type(), op_y_names[index])});
         }
         if (!matched) {
             continue;
         }
         for (size_t index = 0; index < exprs.size(); ++index) {
             Expr e = exprs[index];
-            // Order of substitution matters, e.g. in the argmin case, _y_0 -> g(rx)[0]
-            // and _y_1 -> rx. If we substitute the 2nd element rx first, substitution
-            // of g(rx)[0] will fail.
             for (const auto &iter : replacement) {
                 e = substitute(iter.first, iter.second, e);
             }
@@ -776,6 +785,19 @@ void associativity_test() {
                               {Replacement("y0", g_call_0), Replacement("y1", g_call_1)},
                               true)
                             );
+
+        // 1D argmax, as produced by Halide::argmax:
+        // f(x) = Tuple(select(f(x)[1] < g(r.x)[1], r.x, f(x)[0]), select(f(x)[1] < g(r.x)[1], g(r.x)[1], f(x)[1]))
+        check_associativity("f", {x}, {select(f_call_1 < g_call_1, rx, f_call_0), select(f_call_1 < g_call_1, g_call_1, f_call_1)},
+                            AssociativeOp(
+                              AssociativePattern(
+                                {select(xs[1] < ys[1], ys[0], xs[0]), select(xs[1] < ys[1], ys[1], xs[1])},
+                                {make_const(ts[0], 0), ts[1].min()},
+                                true),
+                              {Replacement("x0", f_call_0), Replacement("x1", f_call_1)},
+                              {Replacement("y0", rx), Replacement("y1", g_call_1)},
+                              true)
+                            );
     }
 
     {
@@ -0,0 +1,398 @@
+#include <set>
+
+#include "AsyncProducers.h"
+#include "ExprUsesVar.h"
+#include "FindCalls.h"
+#include "Function.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "InjectHostDevBufferCopies.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::set;
+using std::string;
+using std::vector;
+
+namespace {
+
+Stmt release_semaphore(Expr sema) {
+    return Evaluate::make(Call::make(Int(32), "halide_semaphore_release",
+                                     {sema, 1}, Call::Extern));
+}
+
+// Make sure that if one side of a fork exits early, because of an
+// error, the other side doesn't wait for it forever.
+Stmt unblock_semaphore_on_exit(Expr sema) {
+    return Evaluate::make(Call::make(Int(32), Call::register_destructor,
+                                     {Expr("halide_semaphore_unblock"), sema},
+                                     Call::Intrinsic));
+}
+
+// Strip a loop nest down to just the production of a Func, signalling
+// a semaphore after each realization. Everything that isn't needed to
+// produce the Func is left to the consumer's copy of the loop nest.
+class GenerateProducerBody : public IRMutator2 {
+    const string &func;
+    Expr sema;
+    const string &folding_sema;
+    const set<string> &inputs;
+
+    using IRMutator2::visit;
+
+    Stmt visit(const ProducerConsumer *op) override {
+        if (op->name == func) {
+            if (op->is_producer) {
+                Stmt body = Block::make(op->body, release_semaphore(sema));
+                return ProducerConsumer::make_produce(op->name, body);
+            } else {
+                return Evaluate::make(0);
+            }
+        }
+
+        user_assert(!op->is_producer || !inputs.count(op->name))
+            << "Func " << func << " is scheduled async, but it uses " << op->name
+            << ", which is computed within the loop nest " << func << " is stored in. "
+            << "Compute " << op->name << " within " << func
+            << ", or at or outside the loop level " << func << " is stored at.\n";
+
+        Stmt body = mutate(op->body);
+        if (op->is_producer || is_no_op(body)) {
+            return body;
+        }
+        return ProducerConsumer::make(op->name, op->is_producer, body);
+    }
+
+    Stmt visit(const Realize *op) override {
+        // Funcs that aren't inputs aren't touched by the producer.
+        return mutate(op->body);
+    }
+
+    Stmt visit(const Allocate *op) override {
+        Stmt body = mutate(op->body);
+        if (is_no_op(body)) {
+            return body;
+        }
+        return Allocate::make(op->name, op->type, op->memory_type, op->extents, op->condition, body,
+                              op->new_expr, op->free_function);
+    }
+
+    Stmt visit(const LetStmt *op) override {
+        if (!folding_sema.empty() && expr_uses_var(op->value, folding_sema)) {
+            // Waiting for the consumer to free up folded storage
+            // before producing more.
+            return op;
+        }
+        Stmt body = mutate(op->body);
+        if (is_no_op(body)) {
+            return body;
+        }
+        return LetStmt::make(op->name, op->value, body);
+    }
+
+    Stmt visit(const For *op) override {
+        Stmt body = mutate(op->body);
+        if (is_no_op(body)) {
+            return body;
+        }
+        return For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+    }
+
+    Stmt visit(const IfThenElse *op) override {
+        Stmt then_case = mutate(op->then_case);
+        Stmt else_case = op->else_case.defined() ? mutate(op->else_case) : Stmt();
+        if (is_no_op(then_case) && (!else_case.defined() || is_no_op(else_case))) {
+            return then_case;
+        }
+        return IfThenElse::make(op->condition, then_case, else_case);
+    }
+
+    Stmt visit(const Block *op) override {
+        Stmt first = mutate(op->first);
+        Stmt rest = mutate(op->rest);
+        if (is_no_op(first)) {
+            return rest;
+        } else if (is_no_op(rest)) {
+            return first;
+        }
+        return Block::make(first, rest);
+    }
+
+    // Everything else belongs to the consumer.
+    Stmt visit(const Provide *op) override {
+        return Evaluate::make(0);
+    }
+
+    Stmt visit(const Store *op) override {
+        return Evaluate::make(0);
+    }
+
+    Stmt visit(const Evaluate *op) override {
+        return Evaluate::make(0);
+    }
+
+    Stmt visit(const AssertStmt *op) override {
+        return Evaluate::make(0);
+    }
+
+    Stmt visit(const Prefetch *op) override {
+        return Evaluate::make(0);
+    }
+
+public:
+    GenerateProducerBody(const string &func, Expr sema, const string &folding_sema,
+                         const set<string> &inputs)
+        : func(func), sema(sema), folding_sema(folding_sema), inputs(inputs) {}
+};
+
+// Replace the production of a Func with waiting for the producer's
+// copy of the loop nest to signal that it's done.
+class GenerateConsumerBody : public IRMutator2 {
+    const string &func;
+    Expr sema;
+    const string &folding_sema;
+
+    using IRMutator2::visit;
+
+    Stmt visit(const ProducerConsumer *op) override {
+        if (op->name == func && op->is_producer) {
+            return call_extern_and_assert("halide_semaphore_acquire", {sema, 1});
+        }
+        return IRMutator2::visit(op);
+    }
+
+    Stmt visit(const LetStmt *op) override {
+        if (!folding_sema.empty() && expr_uses_var(op->value, folding_sema)) {
+            // The producer waits for folded storage, not us.
+            return Evaluate::make(0);
+        }
+        return IRMutator2::visit(op);
+    }
+
+public:
+    GenerateConsumerBody(const string &func, Expr sema, const string &folding_sema)
+        : func(func), sema(sema), folding_sema(folding_sema) {}
+};
+
+class ForkAsyncProducers : public IRMutator2 {
+    const map<string, Function> &env;
+
+    using IRMutator2::visit;
+
+    Stmt visit(const Realize *op) override {
+        Stmt body = mutate(op->body);
+
+        auto it = env.find(op->name);
+        if (it == env.end() || !it->second.schedule().async()) {
+            if (body.same_as(op->body)) {
+                return op;
+            }
+            return Realize::make(op->name, op->types, op->memory_type, op->bounds, op->condition, body);
+        }
+
+        const Function &f = it->second;
+        string sema_name = op->name + ".semaphore";
+        Expr sema = Variable::make(Handle(), sema_name);
+
+        // Storage folding leaves a semaphore counting free space in
+        // the fold, if the Func's storage was folded.
+        string folding_sema_name = op->name + ".folding_semaphore";
+        if (!stmt_uses_var(body, folding_sema_name)) {
+            folding_sema_name.clear();
+        }
+
+        set<string> inputs;
+        for (const auto &p : find_transitive_calls(f)) {
+            if (p.first != op->name) {
+                inputs.insert(p.first);
+            }
+        }
+
+        Stmt producer = GenerateProducerBody(op->name, sema, folding_sema_name, inputs).mutate(body);
+        producer = Block::make(unblock_semaphore_on_exit(sema), producer);
+
+        Stmt consumer = GenerateConsumerBody(op->name, sema, folding_sema_name).mutate(body);
+        if (!folding_sema_name.empty()) {
+            Expr folding_sema = Variable::make(Handle(), folding_sema_name);
+            consumer = Block::make(unblock_semaphore_on_exit(folding_sema), consumer);
+        }
+
+        string fork_name = op->name + ".__fork";
+        Expr fork_var = Variable::make(Int(32), fork_name);
+        Stmt fork = For::make(fork_name, 0, 2, ForType::Parallel, DeviceAPI::None,
+                              IfThenElse::make(fork_var == 0, producer, consumer));
+
+        Stmt init = Evaluate::make(Call::make(Int(32), "halide_semaphore_init",
+                                              {sema, 0}, Call::Extern));
+        // Room for a halide_semaphore_t.
+        body = Allocate::make(sema_name, UInt(64), MemoryType::Stack, {2}, const_true(), Block::make(init, fork));
+
+        return Realize::make(op->name, op->types, op->memory_type, op->bounds, op->condition, body);
+    }
+
+public:
+    ForkAsyncProducers(const map<string, Function> &env) : env(env) {}
+};
+
+// Does a Stmt or Expr refer to any of a set of Funcs, either by
+// calling them or through their buffers (e.g. as the input of an
+// extern stage)?
+class UsesFuncs : public IRGraphVisitor {
+    const set<string> &funcs;
+
+    using IRGraphVisitor::visit;
+
+    void visit(const Call *op) override {
+        if (op->call_type == Call::Halide && funcs.count(op->name)) {
+            result = true;
+        }
+        IRGraphVisitor::visit(op);
+    }
+
+    void visit(const Variable *op) override {
+        for (const string &f : funcs) {
+            if (starts_with(op->name, f + ".")) {
+                result = true;
+            }
+        }
+    }
+
+public:
+    bool result = false;
+    UsesFuncs(const set<string> &funcs) : funcs(funcs) {}
+};
+
+// Does a Stmt run entirely on the host?
+class RunsOnHost : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const For *op) override {
+        if ((op->device_api != DeviceAPI::None && op->device_api != DeviceAPI::Host) ||
+            op->for_type == ForType::GPUBlock ||
+            op->for_type == ForType::GPUThread ||
+            op->for_type == ForType::GPULane) {
+            result = false;
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    bool result = true;
+};
+
+// Run the productions of consecutive Funcs realized outside of any
+// loop that don't depend on each other as the tasks of a parallel
+// loop. Only the realizations are hoisted around the tasks, so the
+// consumers still run after all of the tasks are done.
+class ForkIndependentStages : public IRMutator2 {
+    using IRMutator2::visit;
+
+    Stmt visit(const For *op) override {
+        // Only stages at the root level are forked.
+        return op;
+    }
+
+    Stmt visit(const Realize *op) override {
+        // Find the chain of realizations of which this is the
+        // first, each of which is a production followed by the
+        // consumption of the rest of the chain.
+        vector<const Realize *> realizes;
+        vector<Stmt> produces;
+        Stmt rest = op;
+        while (const Realize *r = rest.as<Realize>()) {
+            const Block *block = r->body.as<Block>();
+            if (!block) {
+                break;
+            }
+            const ProducerConsumer *produce = block->first.as<ProducerConsumer>();
+            const ProducerConsumer *consume = block->rest.as<ProducerConsumer>();
+            if (!produce || !produce->is_producer || produce->name != r->name ||
+                !consume || consume->is_producer || consume->name != r->name) {
+                break;
+            }
+            realizes.push_back(r);
+            produces.push_back(mutate(block->first));
+            rest = consume->body;
+        }
+
+        if (realizes.size() < 2) {
+            return IRMutator2::visit(op);
+        }
+        rest = mutate(rest);
+
+        // Group the stages. A stage joins the group before it if it
+        // doesn't use any of the Funcs in it.
+        vector<vector<size_t>> groups;
+        set<string> group_funcs;
+        bool group_on_host = false;
+        for (size_t i = 0; i < realizes.size(); i++) {
+            const Realize *r = realizes[i];
+            RunsOnHost on_host;
+            produces[i].accept(&on_host);
+            UsesFuncs uses(group_funcs);
+            produces[i].accept(&uses);
+            r->condition.accept(&uses);
+            for (const Range &b : r->bounds) {
+                b.min.accept(&uses);
+                b.extent.accept(&uses);
+            }
+            if (!groups.empty() && group_on_host && on_host.result && !uses.result) {
+                groups.back().push_back(i);
+                group_funcs.insert(r->name);
+            } else {
+                groups.push_back({i});
+                group_funcs = {r->name};
+                group_on_host = on_host.result;
+            }
+        }
+
+        // Rebuild the chain from the inside out.
+        Stmt body = rest;
+        for (size_t g = groups.size(); g > 0; g--) {
+            const vector<size_t> &group = groups[g - 1];
+            for (size_t j = group.size(); j > 0; j--) {
+                body = ProducerConsumer::make_consume(realizes[group[j - 1]]->name, body);
+            }
+            Stmt produce;
+            if (group.size() == 1) {
+                produce = produces[group[0]];
+            } else {
+                string task_name = realizes[group[0]]->name + ".__tasks";
+                Expr task = Variable::make(Int(32), task_name);
+                for (size_t j = group.size(); j > 0; j--) {
+                    Stmt p = produces[group[j - 1]];
+                    produce = produce.defined() ? IfThenElse::make(task == (int)(j - 1), p, produce) : p;
+                }
+                debug(3) << "Running " << group.size() << " stages starting with "
+                         << realizes[group[0]]->name << " in parallel\n";
+                produce = For::make(task_name, 0, (int)group.size(), ForType::Parallel, DeviceAPI::None, produce);
+            }
+            body = Block::make(produce, body);
+            for (size_t j = group.size(); j > 0; j--) {
+                const Realize *r = realizes[group[j - 1]];
+                body = Realize::make(r->name, r->types, r->memory_type, r->bounds, r->condition, body);
+            }
+        }
+        return body;
+    }
+};
+
+}  // namespace
+
+Stmt fork_independent_stages(Stmt s) {
+    return ForkIndependentStages().mutate(s);
+}
+
+Stmt fork_async_producers(Stmt s, const map<string, Function> &env) {
+    for (const auto &p : env) {
+        if (p.second.schedule().async()) {
+            return ForkAsyncProducers(env).mutate(s);
+        }
+    }
+    return s;
+}
+
+}
+}
@@ -0,0 +1,34 @@
+#ifndef HALIDE_ASYNC_PRODUCERS_H
+#define HALIDE_ASYNC_PRODUCERS_H
+
+#include <map>
+
+#include "IR.h"
+
+/** \file
+ * Defines the lowering pass that runs Funcs scheduled async
+ * concurrently with their consumers.
+ */
+
+namespace Halide {
+namespace Internal {
+
+/** Split the realization of each Func scheduled async into two
+ * concurrently running copies of the loop nest at its store level:
+ * one that only produces the Func, and one that does everything
+ * else, with the production replaced by waiting on a semaphore. The
+ * two copies are the iterations of a parallel loop whose name ends
+ * in ".__fork", which codegen runs with halide_do_fork. */
+Stmt fork_async_producers(Stmt s, const std::map<std::string, Function> &env);
+
+/** Run the productions of consecutive Funcs realized outside of
+ * any loop that don't use each other concurrently, as the tasks of
+ * a parallel loop whose name ends in ".__tasks". Their consumers
+ * still wait for all of them. Used for the task_parallel target
+ * feature. */
+Stmt fork_independent_stages(Stmt s);
+
+}
+}
+
+#endif
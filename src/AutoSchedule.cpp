@@ -1,13 +1,30 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <regex>
+#include <thread>
+
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 #include "AutoSchedule.h"
 #include "AutoScheduleUtils.h"
+#include "Associativity.h"
 #include "ExprUsesVar.h"
 #include "FindCalls.h"
 #include "Func.h"
 #include "Inline.h"
 #include "IREquality.h"
+#include "OutputImageParam.h"
 #include "ParallelRVar.h"
 #include "RealizationOrder.h"
 #include "RegionCosts.h"
@@ -28,6 +45,26 @@ using std::make_pair;
 
 namespace {
 
+// Limits used when scheduling for GPU targets. Thread blocks have at most
+// 'gpu_max_threads' threads, and the intermediates of a group computed per
+// block must fit in the shared memory available to a block on every CUDA
+// device.
+const int gpu_warp_size = 32;
+const int gpu_max_threads = 256;
+const int gpu_shared_memory_size = 48 * 1024;
+
+// Memory limits of the Hexagon DSP, for targets that use HVX. Vector loads
+// and stores bypass the L1 cache, so the L2 is the only cache that the tiles
+// are sized for. In 128-byte mode, only two hardware threads can use the
+// vector units at once (four in 64-byte mode).
+const int hvx_l2_size = 512 * 1024;
+const int hvx_128_threads = 2;
+const int hvx_64_threads = 4;
+
+bool uses_hvx(const Target &t) {
+    return t.has_feature(Target::HVX_64) || t.has_feature(Target::HVX_128);
+}
+
 int string_to_int(const std::string &s) {
     std::istringstream iss(s);
     int i;
@@ -175,17 +212,39 @@ struct DependenceAnalysis {
             return prods < other.prods;
         }
     };
-    struct RegionsRequired {
-        DimBounds bounds;
-        // Regions required to compute 'bounds' given a particular
-        // RegionsRequiredQuery.
-        map<string, Box> regions;
-        RegionsRequired(const DimBounds &b, const map<string, Box> &r)
-            : bounds(b), regions(r) {}
+    // Orders DimBounds by the structure of their Exprs, rather than by their
+    // identity as Interval::operator== does, so that queries with bounds that
+    // are rebuilt for each query still hit the cache.
+    struct DimBoundsCompare {
+        bool operator()(const DimBounds &a, const DimBounds &b) const {
+            if (a.size() != b.size()) {
+                return a.size() < b.size();
+            }
+            IRDeepCompare compare;
+            for (auto ia = a.begin(), ib = b.begin(); ia != a.end(); ++ia, ++ib) {
+                if (ia->first != ib->first) {
+                    return ia->first < ib->first;
+                }
+                if (compare(ia->second.min, ib->second.min)) {
+                    return true;
+                } else if (compare(ib->second.min, ia->second.min)) {
+                    return false;
+                }
+                if (compare(ia->second.max, ib->second.max)) {
+                    return true;
+                } else if (compare(ib->second.max, ia->second.max)) {
+                    return false;
+                }
+            }
+            return false;
+        }
     };
     // Cache for bounds queries (bound queries with the same parameters are
-    // common during the grouping process).
-    map<RegionsRequiredQuery, vector<RegionsRequired>> regions_required_cache;
+    // common during the grouping process). It maps each query to the regions
+    // required for each of the bounds it has been asked for. Guarded by
+    // 'cache_mutex', since grouping choices are evaluated in parallel.
+    map<RegionsRequiredQuery, map<DimBounds, map<string, Box>, DimBoundsCompare>> regions_required_cache;
+    std::mutex cache_mutex;
 
     DependenceAnalysis(const map<string, Function> &env, const vector<string> &order,
                        const FuncValueBounds &func_val_bounds)
@@ -387,13 +446,14 @@ DependenceAnalysis::regions_required(Function f, int stage_num,
 
     // Check the cache if we've already computed this previously.
     RegionsRequiredQuery query(f.name(), stage_num, prods, only_regions_computed);
-    const auto &iter = regions_required_cache.find(query);
-    if (iter != regions_required_cache.end()) {
-        const auto &it = std::find_if(iter->second.begin(), iter->second.end(),
-            [&bounds](const RegionsRequired &r) { return (r.bounds == bounds); });
-        if (it != iter->second.end()) {
-            internal_assert((iter->first == query) && (it->bounds == bounds));
-            return it->regions;
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        const auto &iter = regions_required_cache.find(query);
+        if (iter != regions_required_cache.end()) {
+            const auto &it = iter->second.find(bounds);
+            if (it != iter->second.end()) {
+                return it->second;
+            }
         }
     }
 
@@ -574,7 +634,10 @@ DependenceAnalysis::regions_required(Function f, int stage_num,
         concrete_regions[f_reg.first] = concrete_box;
     }
 
-    regions_required_cache[query].push_back(RegionsRequired(bounds, concrete_regions));
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        regions_required_cache[query].emplace(bounds, concrete_regions);
+    }
     return concrete_regions;
 }
 
@@ -697,7 +760,7 @@ map<string, Box> get_pipeline_bounds(DependenceAnalysis &analysis,
         }
 
         set<string> prods;
-        for (const pair<string, Function> &fpair : analysis.env) {
+        for (const auto &fpair : analysis.env) {
             prods.insert(fpair.first);
         }
 
@@ -746,6 +809,22 @@ struct AutoSchedule {
     // function stages.
     map<string, map<int, set<string>>> used_vars;
 
+    // Statements that create and schedule intermediate Funcs of some
+    // functions (e.g. with rfactor). The intermediates aren't part of the
+    // pipeline, so these are printed after the schedule of the function
+    // they were created from.
+    map<string, vector<string>> intermediate_schedules;
+
+    // Statements that create and schedule specializations of some function
+    // stages. A specialization starts from a copy of the schedule of its stage
+    // at the time it is created, so these are printed before the schedule of
+    // the stage.
+    map<string, vector<string>> specialization_schedules;
+
+    // While a specialization of a stage is being scheduled, the directives
+    // applied to it are recorded here rather than in 'func_schedules'.
+    vector<string> *specialization = nullptr;
+
     AutoSchedule(const map<string, Function> &env, const vector<string> &order) : env(env) {
         for (size_t i = 0; i < order.size(); ++i) {
             realization_order.emplace(order[i], i);
@@ -810,6 +889,13 @@ struct AutoSchedule {
                 }
             }
 
+            const auto &spec_iter = sched.specialization_schedules.find(f.first);
+            if (spec_iter != sched.specialization_schedules.end()) {
+                for (const string &statement : spec_iter->second) {
+                    schedule_ss << "    " << statement << ";\n";
+                }
+            }
+
             for (const auto &s : f.second) {
                 internal_assert(!s.second.empty());
                 schedule_ss << "    " << fname;
@@ -822,6 +908,13 @@ struct AutoSchedule {
                 schedule_ss << ";\n";
             }
 
+            const auto &iter = sched.intermediate_schedules.find(f.first);
+            if (iter != sched.intermediate_schedules.end()) {
+                for (const string &statement : iter->second) {
+                    schedule_ss << "    " << statement << ";\n";
+                }
+            }
+
             schedule_ss << "}\n";
         }
 
@@ -838,6 +931,11 @@ struct AutoSchedule {
 
         used_vars[v[0]][stage_num].insert(vars.begin(), vars.end());
 
+        if (specialization) {
+            specialization->push_back(sched);
+            return;
+        }
+
         // If the previous schedule applied is the same as this one,
         // there is no need to re-apply the schedule
         auto &schedules = func_schedules[v[0]][stage_num];
@@ -851,6 +949,48 @@ struct AutoSchedule {
     }
 };
 
+// A model of the cost of computing a group of function stages, which the
+// partitioner uses to rank the grouping choices. 'cost' is the estimate of
+// the arithmetic and memory cost of the group and 'parallelism' is the
+// number of tiles of the group that can be computed in parallel.
+class CostModel {
+public:
+    virtual ~CostModel() {}
+    virtual Expr evaluate(const Cost &cost, const Expr &parallelism) const = 0;
+};
+
+// The default model, which ranks groupings by the sum of their arithmetic and
+// memory costs. The relative cost of the loads is given by the 'balance' of
+// the machine parameters.
+class OpCountCostModel : public CostModel {
+public:
+    Expr evaluate(const Cost &cost, const Expr &) const override {
+        return cost.arith + cost.memory;
+    }
+};
+
+// A model of the runtime (in picoseconds) of a group on a machine with the
+// calibrated costs in 'arch_params'. Only as much of the parallelism of the
+// group as the machine provides is useful.
+class CalibratedCostModel : public CostModel {
+    const MachineParams &arch_params;
+
+public:
+    CalibratedCostModel(const MachineParams &arch_params) : arch_params(arch_params) {
+        internal_assert(arch_params.arith_cost.defined() && arch_params.load_cost.defined());
+    }
+
+    Expr evaluate(const Cost &cost, const Expr &parallelism) const override {
+        Expr par = make_one(Int(64));
+        if (parallelism.defined()) {
+            par = max(min(parallelism, cast<int64_t>(arch_params.parallelism)), par);
+        }
+        Expr runtime = (cost.arith * cast<int64_t>(arch_params.arith_cost) +
+                        cost.memory * cast<int64_t>(arch_params.load_cost));
+        return runtime / par;
+    }
+};
+
 // Implement the grouping algorithm and the cost model for making the grouping
 // choices.
 struct Partitioner {
@@ -999,6 +1139,37 @@ struct Partitioner {
         }
     };
 
+    // A split of the tiles of a group into strips along one of the tiled
+    // dimensions of the group output, such that the members needed to compute
+    // a strip fit in one of the caches below the last level. The members are
+    // stored at the tiles, whose footprint is bounded by the last-level cache,
+    // and computed at the strips. The strips of a tile are computed in serial,
+    // so sliding window can reuse the values computed for the previous strip.
+    struct CacheStrip {
+        // The dimension of the output stage that is split. This is empty if
+        // the tiles are not split into strips.
+        string var;
+        // The extent of a strip along 'var'.
+        Expr size;
+        // The regions of the members that are allocated to compute a strip.
+        map<string, Box> alloc_regions;
+    };
+
+    // A specialization of the schedule of the pipeline for a class of runtime
+    // shapes of its outputs. The output stage of each group is specialized on
+    // 'condition', under which it is tiled with the tile sizes that are best
+    // for the estimates of the class.
+    struct ShapeSpecialization {
+        Expr condition;
+        // The string representation of 'condition'.
+        string condition_text;
+        // The best tile sizes of the output stage of each group, and the
+        // estimates of the extents of the dimensions of the output stage, for
+        // the estimates of the class.
+        map<FStage, map<string, Expr>> tile_sizes;
+        map<FStage, map<string, Expr>> estimates;
+    };
+
     // Configuration of a group and the corresponding analysis. A group is the
     // set of functions that are computed together in tiles and the group config
     // specifies at what granularity they are computed together ('tile_sizes').
@@ -1028,6 +1199,9 @@ struct Partitioner {
     // Map from the output stage of the group to the analysis of the group. The mapping
     // needs to be updated whenever the grouping changes.
     map<FStage, GroupAnalysis> group_costs;
+    // The specializations of the schedule for other classes of output shapes
+    // than the one given by the estimates of the outputs.
+    vector<ShapeSpecialization> specializations;
 
     // Levels that are targeted by the grouping algorithm. In the 'Inline' mode, the grouping
     // algorithm groups the functions by inlining the expression for the producer function
@@ -1041,6 +1215,11 @@ struct Partitioner {
     // Parameters of the machine model that is used for estimating the cost of each
     // group in the pipeline.
     const MachineParams &arch_params;
+    // The model used to rank the grouping choices.
+    const CostModel &cost_model;
+    // The target the schedule is generated for. On GPU targets, tiles of a
+    // group are thread blocks and group members are staged in shared memory.
+    const Target &target;
     // Dependency analysis of the pipeline. This support queries on regions
     // accessed and computed for producing some regions of some functions.
     DependenceAnalysis &dep_analysis;
@@ -1051,7 +1230,7 @@ struct Partitioner {
     const vector<Function> &outputs;
 
     Partitioner(const map<string, Box> &_pipeline_bounds, const MachineParams &_arch_params,
-                DependenceAnalysis &_dep_analysis, RegionCosts &_costs,
+                const CostModel &_cost_model, const Target &_target, DependenceAnalysis &_dep_analysis, RegionCosts &_costs,
                 const vector<Function> &_outputs, const set<string> &unbounded);
 
     void initialize_groups();
@@ -1070,6 +1249,13 @@ struct Partitioner {
     // parallelism that can be potentially exploited when computing that group.
     GroupAnalysis analyze_group(const Group &g, bool show_analysis);
 
+    // Find the largest strips of the tiles of group 'g' that fit in the
+    // innermost cache possible, given the regions of the members allocated to
+    // compute a tile ('tile_regions'). This doesn't split the tiles if they
+    // already fit in the cache, or if the machine parameters don't specify any
+    // cache below the last level.
+    CacheStrip find_cache_strip(const Group &g, const map<string, Box> &tile_regions);
+
     // For each group in the partition, return the regions of the producers
     // need to be allocated to compute a tile of the group's output.
     map<FStage, map<string, Box>> group_storage_bounds();
@@ -1078,6 +1264,19 @@ struct Partitioner {
     // required to compute a tile of the group's output.
     map<FStage, map<FStage, DimBounds>> group_loop_bounds();
 
+    // What the CPU and GPU schedules are both generated from: the bounds of
+    // each group, and the functions inlined into any group.
+    struct GroupSchedulingInfo {
+        map<FStage, map<FStage, DimBounds>> loop_bounds;
+        map<FStage, map<string, Box>> storage_bounds;
+        set<string> inlines;
+    };
+
+    // Gather the above. This must be called before any schedules are applied,
+    // as the bounds rely on the dimensions of the group outputs, which will be
+    // altered by modifying schedules.
+    GroupSchedulingInfo group_scheduling_info();
+
     // Partition the pipeline by iteratively merging groups until a fixpoint is
     // reached.
     void group(Partitioner::Level level);
@@ -1086,6 +1285,12 @@ struct Partitioner {
     // the highest estimated benefits.
     GroupConfig evaluate_choice(const GroupingChoice &group, Partitioner::Level level);
 
+    // Evaluate each of 'choices' as in \ref Partitioner::evaluate_choice. The
+    // evaluations are independent, so they are spread across the hardware
+    // threads of the host.
+    vector<GroupConfig> evaluate_choices(const vector<GroupingChoice> &choices,
+                                         Partitioner::Level level);
+
     // Pick the best choice among all the grouping options currently available. Uses
     // the cost model to estimate the benefit of each choice. This returns a vector of
     // choice and configuration pairs which describe the best grouping choice.
@@ -1112,7 +1317,8 @@ struct Partitioner {
     // estimated benefit and the estimated benefit.
     pair<map<string, Expr>, GroupAnalysis> find_best_tile_config(const Group &g);
 
-    // Estimate the benefit (arithmetic + memory) of 'new_grouping' over 'old_grouping'.
+    // Estimate the benefit of 'new_grouping' over 'old_grouping', as predicted by
+    // 'cost_model'.
     // Positive values indicates that 'new_grouping' may be preferrable over 'old_grouping'.
     // When 'ensure_parallelism' is set to true, this will return an undefined cost
     // if the estimated parallelism is smaller than the machine parameters.
@@ -1166,11 +1372,59 @@ struct Partitioner {
     // applies schedules for a group of function stages.
 
     void generate_group_cpu_schedule(const Group &g, const Target &t,
+                                     const map<FStage, DimBounds> &group_loop_bounds,
+                                     const map<string, Box> &group_storage_bounds,
+                                     const set<string> &inlines,
+                                     const CacheStrip &strip,
+                                     AutoSchedule &sched);
+
+    // Tile, reorder, vectorize and parallelize the output stage of group 'g'
+    // (with definition 'def') through 'f_handle', which is either the stage or
+    // one of its specializations. Exactly the dimensions in 'tile_sizes' are
+    // tiled: a dimension with a tile size of one is moved outside the tiles
+    // and the other ones are split. Return the innermost loop outside the
+    // tiles and the loop over the strips of a tile, if any (the names are
+    // empty if the stage isn't tiled or split into strips).
+    pair<VarOrRVar, VarOrRVar> tile_group_output(const Group &g, Stage f_handle, Definition def,
+                                                 const Target &t,
+                                                 const map<string, Box> &group_storage_bounds,
+                                                 const set<string> &inlines,
+                                                 const map<string, Expr> &tile_sizes,
+                                                 map<string, Expr> stg_estimates,
+                                                 const CacheStrip &strip,
+                                                 AutoSchedule &sched);
+
+    // Generate and apply schedules for all functions within a pipeline when
+    // targeting a GPU. This follows the same grouping structure as
+    // \ref Partitioner::generate_cpu_schedule, but each tile of a group is
+    // computed by a thread block: the output of the group is split into
+    // blocks and threads, and the group members are computed per block, such
+    // that they are staged in shared memory.
+    void generate_gpu_schedule(const Target &t, AutoSchedule &sched);
+
+    // Same as \ref Partitioner::generate_gpu_schedule, but this generates and
+    // applies schedules for a group of function stages.
+    void generate_group_gpu_schedule(const Group &g, const Target &t,
                                      const map<FStage, DimBounds> &group_loop_bounds,
                                      const map<string, Box> &group_storage_bounds,
                                      const set<string> &inlines,
                                      AutoSchedule &sched);
 
+    // Split the pure dimensions 'vars' of stage 'f_handle' by 'thread_extents'
+    // and distribute the inner loops over the GPU threads. The outer loops of
+    // the splits are run serially within each thread. Dimensions whose thread
+    // extent is 1 are left alone. Returns the outer loops of the splits.
+    vector<VarOrRVar> gpu_threads_stage(
+        const Group &g, Stage f_handle, int stage_num, Definition def,
+        bool is_group_output, const vector<string> &vars,
+        const vector<int> &thread_extents, map<string, Expr> &estimates,
+        vector<VarOrRVar> &thread_dims, AutoSchedule &sched);
+
+    // Reorder the dimensions of stage 'f_handle' to 'ordering', from
+    // innermost to outermost, and append the reorder schedule to 'sched'.
+    void reorder_stage(Stage f_handle, int stage_num, Definition def,
+                       const vector<VarOrRVar> &ordering, AutoSchedule &sched);
+
     // Split the dimension of stage 'f_handle' along 'v' into inner and outer
     // dimensions. Modify 'estimates' according to the split and append the split
     // schedule to 'sched'.
@@ -1179,6 +1433,21 @@ struct Partitioner {
         bool is_group_output, VarOrRVar v, const Expr &factor, string in_suffix,
         string out_suffix, map<string, Expr> &estimates, AutoSchedule &sched);
 
+    // Return true if the stages of group 'g' should be offloaded to the
+    // Hexagon DSP, i.e. if the target offloads to HVX and the group does no
+    // floating point arithmetic (which HVX can't vectorize).
+    bool offload_to_hexagon(const Group &g);
+
+    // If the output stage of group 'g' is an associative reduction with too
+    // little parallelism along its pure dimensions (or parallelizable RVars),
+    // and the group has no members other than inlined ones, split the
+    // reduction with rfactor into partial reductions that are computed in
+    // parallel, and vectorized if the operator is also commutative. Return
+    // true if the stage was rfactored, in which case the rest of the stage
+    // (the merge of the partial results) stays serial.
+    bool rfactor_stage(const Group &g, Stage f_handle, const Target &t,
+                       map<string, Expr> &estimates, AutoSchedule &sched);
+
     // Loop over the dimensions of function stage 'f_handle' starting from innermost
     // and vectorize the first pure dimension encountered.
     void vectorize_stage(
@@ -1239,7 +1508,7 @@ Cost Partitioner::get_pipeline_cost() {
     internal_assert(!group_costs.empty());
 
     Cost total_cost(0, 0);
-    for (const pair<FStage, Group> &g : groups) {
+    for (const auto &g : groups) {
         const GroupAnalysis &analysis = get_element(group_costs, g.first);
         if (!analysis.cost.defined()) {
             return Cost();
@@ -1258,7 +1527,7 @@ void Partitioner::disp_pipeline_costs() {
     debug(0) << "Pipeline costs:" << '\n';
     debug(0) << "===============" << '\n';
     debug(0) << "Group: (name) [arith cost, mem cost, parallelism]" << '\n';
-    for (const pair<FStage, Group> &g : groups) {
+    for (const auto &g : groups) {
         const GroupAnalysis &analysis = get_element(group_costs, g.first);
         if (!total_cost.arith.defined()) {
             continue;
@@ -1290,11 +1559,14 @@ void Partitioner::disp_pipeline_costs() {
 // algorithm operates.
 Partitioner::Partitioner(const map<string, Box> &_pipeline_bounds,
                          const MachineParams &_arch_params,
+                         const CostModel &_cost_model,
+                         const Target &_target,
                          DependenceAnalysis &_dep_analysis,
                          RegionCosts &_costs,
                          const vector<Function> &_outputs,
                          const set<string> &unbounded)
         : pipeline_bounds(_pipeline_bounds), arch_params(_arch_params),
+          cost_model(_cost_model), target(_target),
           dep_analysis(_dep_analysis), costs(_costs), outputs(_outputs) {
     // Place each stage of a function in its own group. Each stage is
     // a node in the pipeline graph. If a function is unbounded, then
@@ -1435,6 +1707,26 @@ Partitioner::choose_candidate_grouping(const vector<pair<string, string>> &cands
                                        Partitioner::Level level) {
     vector<pair<GroupingChoice, GroupConfig>> best_grouping;
     Expr best_benefit = make_zero(Int(64));
+
+    // Evaluate all the choices that are not in the grouping cache up front,
+    // so that they can be evaluated in parallel.
+    vector<GroupingChoice> uncached;
+    for (const auto &p : cands) {
+        const Function &prod_f = get_element(dep_analysis.env, p.first);
+        FStage prod(prod_f, prod_f.updates().size());
+        for (const FStage &c : get_element(children, prod)) {
+            GroupingChoice cand_choice(prod_f.name(), c);
+            if ((grouping_cache.find(cand_choice) == grouping_cache.end()) &&
+                (std::find(uncached.begin(), uncached.end(), cand_choice) == uncached.end())) {
+                uncached.push_back(cand_choice);
+            }
+        }
+    }
+    vector<GroupConfig> uncached_configs = evaluate_choices(uncached, level);
+    for (size_t i = 0; i < uncached.size(); i++) {
+        grouping_cache.emplace(uncached[i], uncached_configs[i]);
+    }
+
     for (const auto &p : cands) {
         // Compute the aggregate benefit of inlining into all the children.
         vector<pair<GroupingChoice, GroupConfig>> grouping;
@@ -1650,11 +1942,9 @@ Partitioner::find_best_tile_config(const Group &g) {
 void Partitioner::group(Partitioner::Level level) {
     bool fixpoint = false;
     while (!fixpoint) {
-        Cost pre_merge = get_pipeline_cost();
-
         fixpoint = true;
         vector<pair<string, string>> cand;
-        for (const pair<FStage, Group> &g : groups) {
+        for (const auto &g : groups) {
             bool is_output = false;
             for (const Function &f : outputs) {
                 if (g.first.func.name() == f.name()) {
@@ -1765,7 +2055,6 @@ void Partitioner::group(Partitioner::Level level) {
             }
         }
 
-        Cost post_merge = get_pipeline_cost();
         if (debug::debug_level() >= 3) {
             disp_pipeline_costs();
         }
@@ -1818,6 +2107,101 @@ DimBounds Partitioner::get_bounds_from_tile_sizes(const FStage &s,
     return bounds;
 }
 
+Partitioner::CacheStrip Partitioner::find_cache_strip(const Group &g,
+                                                      const map<string, Box> &tile_regions) {
+    CacheStrip strip;
+    if (arch_params.inner_cache_sizes.empty() || target.has_gpu_feature() ||
+        g.output.func.has_extern_definition()) {
+        return strip;
+    }
+
+    set<string> group_members;
+    for (const auto &stg : g.members) {
+        group_members.insert(stg.func.name());
+    }
+
+    // The bytes allocated for the members of the group that are computed
+    // at the tiles, or an undefined Expr if any region is unbounded.
+    auto footprint = [&](const map<string, Box> &regions) {
+        Expr size = make_zero(Int(64));
+        bool any_member = false;
+        for (const auto &reg : regions) {
+            if ((group_members.find(reg.first) != group_members.end()) &&
+                (reg.first != g.output.func.name()) &&
+                (g.inlined.find(reg.first) == g.inlined.end())) {
+                Expr reg_size = costs.region_size(reg.first, reg.second);
+                if (!reg_size.defined()) {
+                    return Expr();
+                }
+                size += reg_size;
+                any_member = true;
+            }
+        }
+        return any_member ? simplify(size) : Expr();
+    };
+
+    Expr tile_footprint = footprint(tile_regions);
+    const int64_t *tile_bytes = tile_footprint.defined() ? as_const_int(tile_footprint) : nullptr;
+    if (!tile_bytes) {
+        return strip;
+    }
+
+    // Split along the outermost tiled pure dimension of the output stage.
+    Definition def = get_stage_definition(g.output.func, g.output.stage_num);
+    const vector<Dim> &dims = def.schedule().dims();
+    DimBounds tile_bounds = get_bounds_from_tile_sizes(g.output, g.tile_sizes);
+    string var;
+    int64_t extent = 0;
+    for (int d = (int)dims.size() - 2; d >= 0; d--) {
+        if (dims[d].is_rvar() || (g.tile_sizes.find(dims[d].var) == g.tile_sizes.end())) {
+            continue;
+        }
+        const int64_t *e = as_const_int(simplify(get_extent(get_element(tile_bounds, dims[d].var))));
+        if (e && (*e > 1)) {
+            var = dims[d].var;
+            extent = *e;
+        }
+        break;
+    }
+    if (var.empty()) {
+        return strip;
+    }
+
+    for (const Expr &cache_size : arch_params.inner_cache_sizes) {
+        const int64_t *cache_bytes = as_const_int(cache_size);
+        if (!cache_bytes) {
+            continue;
+        }
+        if (*tile_bytes <= *cache_bytes) {
+            // The tile already fits in this cache.
+            return strip;
+        }
+
+        // The footprint grows roughly linearly with the extent of the strip,
+        // so start from the largest power of two that might fit, and halve it
+        // until the footprint (including any halo) does.
+        int64_t size = 1;
+        while ((size * 2 < extent) && (size * 2 * (*tile_bytes) <= (*cache_bytes) * extent)) {
+            size *= 2;
+        }
+        for (; size >= 1; size /= 2) {
+            DimBounds strip_bounds = tile_bounds;
+            strip_bounds[var] = Interval(0, make_const(Int(32), size - 1));
+            map<string, Box> strip_regions = dep_analysis.regions_required(
+                g.output.func, g.output.stage_num, strip_bounds, group_members,
+                false, &costs.input_estimates);
+            Expr strip_footprint = footprint(strip_regions);
+            if (strip_footprint.defined() && can_prove(strip_footprint <= make_const(Int(64), *cache_bytes))) {
+                strip.var = var;
+                strip.size = make_const(Int(32), size);
+                strip.alloc_regions = strip_regions;
+                return strip;
+            }
+        }
+    }
+    return strip;
+}
+
 Partitioner::GroupAnalysis Partitioner::analyze_group(const Group &g, bool show_analysis) {
     // Get the definition corresponding to the group output
     Definition def = get_stage_definition(g.output.func, g.output.stage_num);
@@ -1916,6 +2300,45 @@ Partitioner::GroupAnalysis Partitioner::analyze_group(const Group &g, bool show_
         }
     }
 
+    // On GPU targets, each tile is computed by a thread block and the group
+    // members are staged in shared memory. A grouping whose intermediates do
+    // not fit in shared memory cannot be realized.
+    //
+    // Loads from global memory (i.e. from buffers not staged in shared memory)
+    // are only coalesced if a warp loads consecutive elements along the
+    // innermost storage dimension. Tiles narrower than a warp along that
+    // dimension issue proportionally more memory transactions.
+    Expr coalescing_factor = make_one(Int(64));
+    if (target.has_gpu_feature() && !g.output.func.args().empty()) {
+        Expr shared_footprint = make_zero(Int(64));
+        for (const auto &reg : alloc_regions) {
+            if ((group_members.find(reg.first) != group_members.end()) &&
+                (reg.first != g.output.func.name())) {
+                Expr size = costs.region_size(reg.first, reg.second);
+                if (!size.defined()) {
+                    return GroupAnalysis();
+                }
+                shared_footprint += size;
+            }
+        }
+        if (can_prove(shared_footprint > gpu_shared_memory_size)) {
+            return GroupAnalysis();
+        }
+
+        const string &inner_var = g.output.func.args()[0];
+        Expr inner_extent;
+        const auto &iter = g.tile_sizes.find(inner_var);
+        if (iter != g.tile_sizes.end()) {
+            inner_extent = iter->second;
+        } else if (stg_bounds.find(inner_var) != stg_bounds.end()) {
+            inner_extent = get_extent(get_element(stg_bounds, inner_var));
+        }
+        if (inner_extent.defined() && can_prove(inner_extent < gpu_warp_size)) {
+            coalescing_factor = simplify(cast<int64_t>(
+                (gpu_warp_size + inner_extent - 1) / inner_extent));
+        }
+    }
+
     Cost group_cost(simplify(tile_cost.arith + out_cost.arith),
                     simplify(tile_cost.memory + out_cost.memory));
 
@@ -1975,6 +2398,10 @@ Partitioner::GroupAnalysis Partitioner::analyze_group(const Group &g, bool show_
     // TODO: Implement a better reuse model.
     bool model_reuse = false;
 
+    // If the tiles are split into strips that fit in a smaller cache, the
+    // loads from the members of the group only touch the footprint of a strip.
+    CacheStrip strip = find_cache_strip(g, alloc_regions);
+
     // Linear dropoff
     Expr load_slope = cast<float>(arch_params.balance) / arch_params.last_level_cache_size;
     for (const auto &f_load : group_load_costs) {
@@ -1992,7 +2419,12 @@ Partitioner::GroupAnalysis Partitioner::analyze_group(const Group &g, bool show_
         // the loads could be from any random locations of the allocated regions.
 
         if (!is_output && is_group_member) {
-            footprint = costs.region_size(f_load.first, alloc_reg);
+            const auto &iter = strip.alloc_regions.find(f_load.first);
+            if (iter != strip.alloc_regions.end()) {
+                footprint = costs.region_size(f_load.first, iter->second);
+            } else {
+                footprint = costs.region_size(f_load.first, alloc_reg);
+            }
         } else {
             Expr initial_footprint;
             const auto &f_load_pipeline_bounds = get_element(pipeline_bounds, f_load.first);
@@ -2031,6 +2463,9 @@ Partitioner::GroupAnalysis Partitioner::analyze_group(const Group &g, bool show_
         }
 
         Expr cost_factor = cast<int64_t>(min(1 + footprint * load_slope, arch_params.balance));
+        if (is_output || !is_group_member) {
+            cost_factor *= coalescing_factor;
+        }
         per_tile_cost.memory += cost_factor * f_load.second;
     }
 
@@ -2109,6 +2544,52 @@ void Partitioner::merge_groups(const GroupingChoice &choice, const GroupConfig &
     group_costs[child] = eval.analysis;
 }
 
+vector<Partitioner::GroupConfig>
+Partitioner::evaluate_choices(const vector<GroupingChoice> &choices,
+                              Partitioner::Level level) {
+    vector<GroupConfig> configs(choices.size());
+
+    // Keep the debug output of each evaluation together at high debug levels.
+    int num_threads = (debug::debug_level() >= 3) ? 1 : (int)std::thread::hardware_concurrency();
+    num_threads = std::min(std::max(num_threads, 1), (int)choices.size());
+    if (num_threads <= 1) {
+        for (size_t i = 0; i < choices.size(); i++) {
+            configs[i] = evaluate_choice(choices[i], level);
+        }
+        return configs;
+    }
+
+    // The evaluations only read the grouping state, and the caches of the
+    // dependence analysis and the region costs are guarded by mutexes.
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto worker = [&]() {
+        for (size_t i = next++; i < choices.size(); i = next++) {
+            try {
+                configs[i] = evaluate_choice(choices[i], level);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    };
+    vector<std::thread> threads;
+    for (int t = 1; t < num_threads; t++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return configs;
+}
+
 Partitioner::GroupConfig Partitioner::evaluate_choice(const GroupingChoice &choice,
                                                       Partitioner::Level level) {
     // Create a group that reflects the grouping choice and evaluate the cost
@@ -2187,8 +2668,8 @@ Expr Partitioner::estimate_benefit(const GroupAnalysis &old_grouping,
     if (no_redundant_work && !can_prove(arith_benefit >= 0)) {
         return Expr();
     }
-    Expr mem_benefit = old_grouping.cost.memory - new_grouping.cost.memory;
-    return simplify(mem_benefit + arith_benefit);
+    return simplify(cost_model.evaluate(old_grouping.cost, old_grouping.parallelism) -
+                    cost_model.evaluate(new_grouping.cost, new_grouping.parallelism));
 }
 
 Expr Partitioner::estimate_benefit(
@@ -2444,6 +2925,9 @@ pair<VarOrRVar, VarOrRVar> Partitioner::split_dim(
         case TailStrategy::ShiftInwards:
             oss << ", TailStrategy::ShiftInwards)";
             break;
+        case TailStrategy::Predicate:
+            oss << ", TailStrategy::Predicate)";
+            break;
         case TailStrategy::Auto:
             oss << ")";
             break;
@@ -2664,11 +3148,194 @@ public :
     }
 };
 
+// Visitor to find if an expression computes any floating point values.
+class FindFloats : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const FloatImm *op) {
+        found = true;
+    }
+
+    void visit(const Cast *op) {
+        found = found || op->type.is_float();
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Call *op) {
+        found = found || op->type.is_float();
+        IRVisitor::visit(op);
+    }
+public:
+    bool found = false;
+};
+
+bool Partitioner::offload_to_hexagon(const Group &g) {
+    if ((target.arch == Target::Hexagon) || !uses_hvx(target) ||
+        g.output.func.has_extern_definition()) {
+        return false;
+    }
+    FindFloats find;
+    for (const FStage &mem : g.members) {
+        Definition def = get_stage_definition(mem.func, mem.stage_num);
+        for (const Type &t : mem.func.output_types()) {
+            find.found = find.found || t.is_float();
+        }
+        def.accept(&find);
+        if (find.found) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Partitioner::rfactor_stage(const Group &g, Stage f_handle, const Target &t,
+                                map<string, Expr> &estimates, AutoSchedule &sched) {
+    Function g_out = g.output.func;
+    int stage_num = g.output.stage_num;
+    for (const FStage &mem : g.members) {
+        if ((mem.func.name() != g_out.name()) &&
+            (g.inlined.find(mem.func.name()) == g.inlined.end())) {
+            return false;
+        }
+    }
+
+    Definition def = get_stage_definition(g_out, stage_num);
+    const vector<Dim> &dims = def.schedule().dims();
+
+    // Find the innermost and outermost RVars, and the parallelism available
+    // along the pure dimensions.
+    string inner_rvar, outer_rvar;
+    Expr pure_par = make_one(Int(64));
+    for (int d = 0; d < (int)dims.size() - 1; d++) {
+        string var = get_base_name(dims[d].var);
+        if (dims[d].is_rvar()) {
+            if (can_parallelize_rvar(var, g_out.name(), def)) {
+                return false;
+            }
+            if (inner_rvar.empty()) {
+                inner_rvar = var;
+            }
+            outer_rvar = var;
+        } else {
+            const auto &iter = estimates.find(var);
+            if ((iter == estimates.end()) || !iter->second.defined()) {
+                return false;
+            }
+            pure_par *= iter->second;
+        }
+    }
+    const int64_t *par = as_const_int(simplify(pure_par));
+    const int64_t *machine_par = as_const_int(arch_params.parallelism);
+    if (outer_rvar.empty() || !par || !machine_par || (*par >= *machine_par)) {
+        return false;
+    }
+
+    AssociativeOp op = prove_associativity(g_out.name(), def.args(), def.values());
+    if (!op.associative()) {
+        return false;
+    }
+
+    const auto &outer_iter = estimates.find(outer_rvar);
+    const int64_t *outer_extent = (outer_iter == estimates.end()) ? nullptr :
+                                  as_const_int(outer_iter->second);
+    if (!outer_extent || (*outer_extent < 2)) {
+        return false;
+    }
+
+    // Split the outermost RVar into enough partial reductions to saturate
+    // the machine along with the pure dimensions.
+    int64_t tasks = (*machine_par + *par - 1) / *par;
+    VarOrRVar par_rvar(outer_rvar, true);
+    if (*outer_extent > tasks) {
+        Expr factor = make_const(Int(32), (*outer_extent + tasks - 1) / tasks);
+        pair<VarOrRVar, VarOrRVar> split =
+            split_dim(g, f_handle, stage_num, def, true, par_rvar, factor,
+                      "_i", "_o", estimates, sched);
+        par_rvar = split.second;
+        if (inner_rvar == outer_rvar) {
+            inner_rvar = split.first.name();
+        }
+    } else if (inner_rvar == outer_rvar) {
+        inner_rvar = "";
+    }
+
+    // If the operator is commutative, also make a vector of partial
+    // reductions out of the innermost RVar.
+    VarOrRVar vec_rvar("", true);
+    int vec_len = 0;
+    for (const Expr &value : def.values()) {
+        int lanes = t.natural_vector_size(value.type());
+        vec_len = (vec_len == 0) ? lanes : std::min(vec_len, lanes);
+    }
+    if (!inner_rvar.empty() && op.commutative() && (vec_len > 1)) {
+        const auto &iter = estimates.find(inner_rvar);
+        const int64_t *inner_extent = (iter == estimates.end()) ? nullptr :
+                                      as_const_int(iter->second);
+        if (inner_extent && (*inner_extent >= 2 * vec_len)) {
+            pair<VarOrRVar, VarOrRVar> split =
+                split_dim(g, f_handle, stage_num, def, true, VarOrRVar(inner_rvar, true),
+                          vec_len, "_i", "_o", estimates, sched);
+            vec_rvar = split.first;
+        }
+    }
+
+    string sanitized_g_out = get_sanitized_name(g_out.name());
+    VarOrRVar par_var(sanitized_g_out + "_par", false);
+    VarOrRVar vec_var(sanitized_g_out + "_vec", false);
+    vector<pair<RVar, Var>> preserved = {{par_rvar.rvar, par_var.var}};
+    string preserved_str = "{" + par_rvar.name() + ", " + par_var.name() + "}";
+    sched.internal_vars.emplace(par_var.name(), par_var);
+    if (!vec_rvar.name().empty()) {
+        preserved.push_back({vec_rvar.rvar, vec_var.var});
+        preserved_str += ", {" + vec_rvar.name() + ", " + vec_var.name() + "}";
+        sched.internal_vars.emplace(vec_var.name(), vec_var);
+    }
+
+    Func intm = f_handle.rfactor(preserved);
+    string intm_name = get_sanitized_name(intm.name());
+    vector<string> &statements = sched.intermediate_schedules[g_out.name()];
+    statements.push_back("Func " + intm_name + " = " + sanitized_g_out + ".update(" +
+                         std::to_string(stage_num - 1) + ").rfactor({" + preserved_str + "})");
+
+    intm.compute_root().parallel(par_var.var);
+    statements.push_back(intm_name + ".compute_root()\n        .parallel(" + par_var.name() + ")");
+
+    // The partial reductions are the outermost loop of the intermediate.
+    Stage intm_update = intm.update(0);
+    string intm_update_sched = intm_name + ".update(0)";
+    const vector<Dim> &intm_dims = intm.function().update(0).schedule().dims();
+    vector<VarOrRVar> ordering;
+    string var_order;
+    for (int d = 0; d < (int)intm_dims.size() - 1; d++) {
+        string var = get_base_name(intm_dims[d].var);
+        if (var != par_var.name()) {
+            ordering.push_back(VarOrRVar(var, intm_dims[d].is_rvar()));
+            var_order += var + ", ";
+        }
+    }
+    ordering.push_back(par_var);
+    var_order += par_var.name();
+    if (get_base_name(intm_dims[intm_dims.size() - 2].var) != par_var.name()) {
+        intm_update.reorder(ordering);
+        intm_update_sched += "\n        .reorder(" + var_order + ")";
+    }
+    if (!vec_rvar.name().empty()) {
+        intm_update.vectorize(vec_var.var);
+        intm_update_sched += "\n        .vectorize(" + vec_var.name() + ")";
+    }
+    intm_update.parallel(par_var.var);
+    intm_update_sched += "\n        .parallel(" + par_var.name() + ")";
+    statements.push_back(intm_update_sched);
+
+    return true;
+}
+
 void Partitioner::generate_group_cpu_schedule(
         const Group &g, const Target &t,
         const map<FStage, DimBounds> &group_loop_bounds,
         const map<string, Box> &group_storage_bounds,
         const set<string> &inlines,
+        const CacheStrip &strip,
         AutoSchedule &sched) {
     string out_f_name = g.output.func.name();
     Function g_out = g.output.func;
@@ -2701,76 +3368,287 @@ void Partitioner::generate_group_cpu_schedule(
         return;
     }
 
-    // Realize tiling and update the dimension estimates
-    vector<VarOrRVar> outer_dims;
-    vector<VarOrRVar> inner_dims;
-
-    // 'dims' will get modified since we are going to apply the schedules
-    // (e.g. tiling, reordering, etc.)
-    vector<Dim> &dims = def.schedule().dims();
-
-    // Keep track of the rvars
-    set<string> rvars;
-    for (int d = 0; d < (int)dims.size() - 1; d++) {
-        if (dims[d].is_rvar()) {
-            rvars.insert(get_base_name(dims[d].var));
-        }
+    // Stages offloaded to the Hexagon DSP are vectorized with HVX vectors,
+    // even if the host has different vector units.
+    Target vector_target = t;
+    bool hexagon = offload_to_hexagon(g);
+    if (hexagon) {
+        f_handle.hexagon();
+        sched.push_schedule(f_handle.name(), g.output.stage_num, "hexagon()", {});
+        vector_target.arch = Target::Hexagon;
     }
 
-    // Reorder the dimensions for better spatial locality (i.e. smallest stride
-    // is innermost). If we only have one dimension (excluding __outermost),
-    // there is nothing to reorder.
-    if (dims.size() > 2) {
-        map<string, Expr> strides =
-            analyze_spatial_locality(g.output, group_storage_bounds, inlines);
-        if (!strides.empty()) {
-            reorder_dims(f_handle, g.output.stage_num, def, strides, sched);
-        }
+    if ((g.output.stage_num > 0) && rfactor_stage(g, f_handle, vector_target, stg_estimates, sched)) {
+        return;
     }
 
-    vector<string> dim_vars(dims.size() - 1);
-    for (int d = 0; d < (int)dims.size() - 1; d++) {
-        dim_vars[d] = get_base_name(dims[d].var);
-    }
+    // Tile the dimensions whose extents are known to be larger than their
+    // tile sizes.
+    map<string, Expr> tile_sizes;
+    for (const auto &iter : g.tile_sizes) {
+        const auto &est = stg_estimates.find(iter.first);
+        if ((est != stg_estimates.end()) && est->second.defined() &&
+            can_prove(est->second > iter.second)) {
+            tile_sizes.emplace(iter.first, iter.second);
+        }
+    }
+
+    // Specialize the stage for the other classes of output shapes. The
+    // specializations tile the same dimensions as the stage, so that the
+    // members of the group are computed at the same loops in all of them, with
+    // the tile sizes that are best for their class (or the whole extent of a
+    // dimension if it isn't tiled for that class). They start from a copy of
+    // the schedule of the stage, so they are created before the stage is
+    // tiled. The tiles of a specialized stage aren't split into strips, which
+    // would also have to be the same in all the specializations.
+    bool specialized = false;
+    for (const ShapeSpecialization &spec : specializations) {
+        const auto &spec_tiles = spec.tile_sizes.find(g.output);
+        if (spec_tiles == spec.tile_sizes.end()) {
+            continue;
+        }
+        const map<string, Expr> &spec_estimates = get_element(spec.estimates, g.output);
 
-    // Apply tiling to output of the group
-    for (const auto &var : dim_vars) {
-        bool is_rvar = (rvars.find(var) != rvars.end());
-        VarOrRVar v(var, is_rvar);
+        bool same_loops = true;
+        map<string, Expr> spec_tile_sizes;
+        for (const auto &iter : tile_sizes) {
+            if (can_prove(iter.second == 1)) {
+                spec_tile_sizes.emplace(iter.first, iter.second);
+                continue;
+            }
+            const auto &est = spec_estimates.find(iter.first);
+            if ((est == spec_estimates.end()) || !est->second.defined()) {
+                spec_tile_sizes.emplace(iter.first, iter.second);
+                continue;
+            }
+            Expr size = est->second;
+            const auto &spec_size = spec_tiles->second.find(iter.first);
+            if ((spec_size != spec_tiles->second.end()) && !can_prove(spec_size->second == 1)) {
+                size = simplify(min(spec_size->second, size));
+            }
+            if (can_prove(size == 1)) {
+                // The dimension would be outside the tiles rather than split.
+                same_loops = false;
+                break;
+            }
+            spec_tile_sizes.emplace(iter.first, size);
+        }
+        bool same_tiles = true;
+        for (const auto &iter : spec_tile_sizes) {
+            same_tiles = same_tiles && can_prove(iter.second == get_element(tile_sizes, iter.first));
+        }
+        if (!same_loops || same_tiles) {
+            continue;
+        }
 
-        const auto &iter = g.tile_sizes.find(var);
-        if ((iter != g.tile_sizes.end()) &&
-            get_element(stg_estimates, var).defined() &&
-            can_prove(get_element(stg_estimates, var) > iter->second)) {
-            const Expr &tile_size = iter->second;
-            if (can_prove(tile_size == 1)) {
-                outer_dims.push_back(v);
-            } else {
-                pair<VarOrRVar, VarOrRVar> tile_vars =
-                    split_dim(g, f_handle, g.output.stage_num, def, true, v,
-                              tile_size, "_i", "_o", stg_estimates, sched);
+        Stage spec_handle = f_handle.specialize(spec.condition);
+        Definition spec_def = def.specializations().back().definition;
 
-                inner_dims.push_back(tile_vars.first);
-                outer_dims.push_back(tile_vars.second);
+        vector<string> spec_schedule;
+        if (hexagon) {
+            // The specialization inherits the device API of the stage, but the
+            // string representation of the stage is applied after it.
+            spec_schedule.push_back("hexagon()");
+        }
+        sched.specialization = &spec_schedule;
+        tile_group_output(g, spec_handle, spec_def, vector_target, group_storage_bounds,
+                          inlines, spec_tile_sizes, spec_estimates, CacheStrip(), sched);
+        sched.specialization = nullptr;
 
-                if (is_rvar) {
-                    rvars.erase(var);
-                    rvars.insert(tile_vars.first.name());
-                    rvars.insert(tile_vars.second.name());
-                }
-            }
-        } else {
-            inner_dims.push_back(v);
+        string statement = get_sanitized_name(g_out.name());
+        if (g.output.stage_num > 0) {
+            statement += ".update(" + std::to_string(g.output.stage_num - 1) + ")";
         }
+        statement += ".specialize(" + spec.condition_text + ")";
+        for (const string &s : spec_schedule) {
+            statement += "\n        ." + s;
+        }
+        sched.specialization_schedules[g_out.name()].push_back(statement);
+        specialized = true;
     }
 
-    // Reorder the tile dimensions
+    pair<VarOrRVar, VarOrRVar> loops =
+        tile_group_output(g, f_handle, def, vector_target, group_storage_bounds, inlines,
+                          tile_sizes, stg_estimates, specialized ? CacheStrip() : strip, sched);
+    const VarOrRVar &tile_inner_var = loops.first;
+    const VarOrRVar &strip_var = loops.second;
+
+    // The loops of the output stage, after it has been tiled.
+    const vector<Dim> &dims = def.schedule().dims();
+
+    for (const FStage &mem : g.members) {
+        // Skip member stages that have been inlined or stage that is the
+        // output stage of the group
+        if ((g.inlined.find(mem.func.name()) != g.inlined.end()) ||
+            (mem.func.name() == g_out.name())) {
+            continue;
+        }
+
+        // Get the definition corresponding to the stage
+        Definition mem_def = get_stage_definition(mem.func, mem.stage_num);
+
+        // Get the estimates for the dimensions of the member stage
+        map<string, Expr> mem_estimates =
+            bounds_to_estimates(get_element(group_loop_bounds, mem));
+
+        set<string> mem_rvars;
+        vector<Dim> &mem_dims = mem_def.schedule().dims();
+        for (int d = 0; d < (int)mem_dims.size() - 1; d++) {
+            if (mem_dims[d].is_rvar()) {
+                mem_rvars.insert(get_base_name(mem_dims[d].var));
+            }
+        }
+
+        // Get a function handle for scheduling the stage
+        Stage mem_handle = Stage(Func(mem.func));
+
+        if (mem.stage_num > 0) {
+            mem_handle = Func(mem.func).update(mem.stage_num - 1);
+        } else {
+            if (!tile_inner_var.name().empty()) {
+                string sanitized_g_out = get_sanitized_name(g_out.name());
+                if (!strip_var.name().empty()) {
+                    if (tile_inner_var.is_rvar) {
+                        Func(mem.func).store_at(Func(g_out), tile_inner_var.rvar);
+                    } else {
+                        Func(mem.func).store_at(Func(g_out), tile_inner_var.var);
+                    }
+                    Func(mem.func).compute_at(Func(g_out), strip_var.var);
+                    sched.push_schedule(mem_handle.name(), mem.stage_num,
+                                        "store_at(" + sanitized_g_out + ", " + tile_inner_var.name() + ")",
+                                        {sanitized_g_out, tile_inner_var.name()});
+                    sched.push_schedule(mem_handle.name(), mem.stage_num,
+                                        "compute_at(" + sanitized_g_out + ", " + strip_var.name() + ")",
+                                        {sanitized_g_out, strip_var.name()});
+                } else {
+                    if (tile_inner_var.is_rvar) {
+                        Func(mem.func).compute_at(Func(g_out), tile_inner_var.rvar);
+                    } else {
+                        Func(mem.func).compute_at(Func(g_out), tile_inner_var.var);
+                    }
+                    sched.push_schedule(mem_handle.name(), mem.stage_num,
+                                        "compute_at(" + sanitized_g_out + ", " + tile_inner_var.name() + ")",
+                                        {sanitized_g_out, tile_inner_var.name()});
+                }
+            } else {
+                user_warning << "Degenerate tiling. No dimensions are tiled" << '\n';
+                user_warning << "Computing \"" <<  mem.func.name() << "\" at root" << '\n';
+                Func(mem.func).compute_root();
+                sched.push_schedule(mem_handle.name(), mem.stage_num, "compute_root()", {});
+            }
+        }
+
+        // Reorder the dimensions for better spatial locality. If we only have
+        // one dimension (excluding __outermost), there is nothing to reorder.
+        if (dims.size() > 2) {
+            map<string, Expr> mem_strides =
+                analyze_spatial_locality(mem, group_storage_bounds, inlines);
+            if (!mem_strides.empty()) {
+                reorder_dims(mem_handle, mem.stage_num, mem_def, mem_strides, sched);
+            }
+        }
+
+        vectorize_stage(g, mem_handle, mem.stage_num, mem_def, mem.func, false,
+                        vector_target, mem_rvars, mem_estimates, sched);
+    }
+}
+
+pair<VarOrRVar, VarOrRVar> Partitioner::tile_group_output(
+        const Group &g, Stage f_handle, Definition def, const Target &t,
+        const map<string, Box> &group_storage_bounds,
+        const set<string> &inlines,
+        const map<string, Expr> &tile_sizes,
+        map<string, Expr> stg_estimates,
+        const CacheStrip &strip,
+        AutoSchedule &sched) {
+    Function g_out = g.output.func;
+
+    // Realize tiling and update the dimension estimates
+    vector<VarOrRVar> outer_dims;
+    vector<VarOrRVar> inner_dims;
+
+    // 'dims' will get modified since we are going to apply the schedules
+    // (e.g. tiling, reordering, etc.)
+    vector<Dim> &dims = def.schedule().dims();
+
+    // Keep track of the rvars
+    set<string> rvars;
+    for (int d = 0; d < (int)dims.size() - 1; d++) {
+        if (dims[d].is_rvar()) {
+            rvars.insert(get_base_name(dims[d].var));
+        }
+    }
+
+    // Reorder the dimensions for better spatial locality (i.e. smallest stride
+    // is innermost). If we only have one dimension (excluding __outermost),
+    // there is nothing to reorder.
+    if (dims.size() > 2) {
+        map<string, Expr> strides =
+            analyze_spatial_locality(g.output, group_storage_bounds, inlines);
+        if (!strides.empty()) {
+            reorder_dims(f_handle, g.output.stage_num, def, strides, sched);
+        }
+    }
+
+    vector<string> dim_vars(dims.size() - 1);
+    for (int d = 0; d < (int)dims.size() - 1; d++) {
+        dim_vars[d] = get_base_name(dims[d].var);
+    }
+
+    // Apply tiling to output of the group
+    for (const auto &var : dim_vars) {
+        bool is_rvar = (rvars.find(var) != rvars.end());
+        VarOrRVar v(var, is_rvar);
+
+        const auto &iter = tile_sizes.find(var);
+        if (iter != tile_sizes.end()) {
+            const Expr &tile_size = iter->second;
+            if (can_prove(tile_size == 1)) {
+                outer_dims.push_back(v);
+            } else {
+                pair<VarOrRVar, VarOrRVar> tile_vars =
+                    split_dim(g, f_handle, g.output.stage_num, def, true, v,
+                              tile_size, "_i", "_o", stg_estimates, sched);
+
+                inner_dims.push_back(tile_vars.first);
+                outer_dims.push_back(tile_vars.second);
+
+                if (is_rvar) {
+                    rvars.erase(var);
+                    rvars.insert(tile_vars.first.name());
+                    rvars.insert(tile_vars.second.name());
+                }
+            }
+        } else {
+            inner_dims.push_back(v);
+        }
+    }
+
+    // Split the tiles into strips, which are the outermost loop within a tile.
+    VarOrRVar strip_var("", false);
+    if (!outer_dims.empty() && !strip.var.empty()) {
+        for (auto &v : inner_dims) {
+            if ((v.name() == strip.var) || (v.name() == strip.var + "_i")) {
+                pair<VarOrRVar, VarOrRVar> strip_vars =
+                    split_dim(g, f_handle, g.output.stage_num, def, true, v,
+                              strip.size, "_i", "_o", stg_estimates, sched);
+                v = strip_vars.first;
+                strip_var = strip_vars.second;
+                break;
+            }
+        }
+    }
+
+    // Reorder the tile dimensions
     if (!outer_dims.empty()) {
 
         vector<VarOrRVar> ordering;
         for (const auto &v : inner_dims) {
             ordering.push_back(v);
         }
+        if (!strip_var.name().empty()) {
+            ordering.push_back(strip_var);
+        }
         for (const auto &v : outer_dims) {
             ordering.push_back(v);
         }
@@ -2827,6 +3705,11 @@ void Partitioner::generate_group_cpu_schedule(
                 break;
             }
 
+            if (var == strip_var.name()) {
+                // The strips of a tile share the storage of the members.
+                break;
+            }
+
             const auto &iter = stg_estimates.find(var);
             if ((iter != stg_estimates.end()) && iter->second.defined()) {
                 if (seq_var != "") {
@@ -2858,6 +3741,289 @@ void Partitioner::generate_group_cpu_schedule(
         bool is_rvar = (rvars.find(var_name) != rvars.end());
         tile_inner_var = VarOrRVar(var_name, is_rvar);
     }
+    return make_pair(tile_inner_var, strip_var);
+}
+
+Partitioner::GroupSchedulingInfo Partitioner::group_scheduling_info() {
+    GroupSchedulingInfo info;
+    info.loop_bounds = group_loop_bounds();
+    info.storage_bounds = group_storage_bounds();
+    // Mark all functions that are inlined.
+    for (const auto &g : groups) {
+        for (const string &inline_func : g.second.inlined) {
+            info.inlines.insert(inline_func);
+        }
+    }
+    return info;
+}
+
+void Partitioner::generate_cpu_schedule(const Target &t, AutoSchedule &sched) {
+    // Grab the group bounds early as they rely on the dimensions of the group
+    // outputs which will be altered by modifying schedules.
+    GroupSchedulingInfo info = group_scheduling_info();
+    map<FStage, CacheStrip> strips;
+    for (const auto &g : groups) {
+        strips[g.first] = find_cache_strip(g.second, get_element(info.storage_bounds, g.first));
+    }
+
+    // TODO: Inlining functions with update definitions has different
+    // behavior than pure functions. They may need to be computed above
+    // the innermost vector loop to avoid complications with varying
+    // extents across different vector lanes.
+    //
+    // Since the default schedule is compute inline, we don't need to
+    // explicitly call compute_inline() on the function.
+
+    // Realize schedule for each group in the pipeline.
+    for (const auto &g : groups) {
+        generate_group_cpu_schedule(g.second, t, get_element(info.loop_bounds, g.first),
+                                    get_element(info.storage_bounds, g.first), info.inlines,
+                                    get_element(strips, g.first), sched);
+    }
+}
+
+void Partitioner::reorder_stage(Stage f_handle, int stage_num, Definition def,
+                                const vector<VarOrRVar> &ordering, AutoSchedule &sched) {
+    const vector<Dim> &dims = def.schedule().dims();
+    internal_assert(ordering.size() == dims.size() - 1);
+    if (dims == ordering) {
+        return;
+    }
+
+    set<string> var_list;
+    string var_order;
+    for (size_t o = 0; o < ordering.size(); o++) {
+        var_order += (o == 0 ? "" : ", ") + ordering[o].name();
+        var_list.insert(ordering[o].name());
+    }
+    f_handle.reorder(ordering);
+    sched.push_schedule(f_handle.name(), stage_num, "reorder(" + var_order + ")", var_list);
+}
+
+vector<VarOrRVar> Partitioner::gpu_threads_stage(
+        const Group &g, Stage f_handle, int stage_num, Definition def,
+        bool is_group_output, const vector<string> &vars,
+        const vector<int> &thread_extents, map<string, Expr> &estimates,
+        vector<VarOrRVar> &thread_dims, AutoSchedule &sched) {
+    internal_assert(vars.size() <= thread_extents.size());
+    vector<VarOrRVar> serial_dims;
+    for (size_t i = 0; i < vars.size(); i++) {
+        if (thread_extents[i] <= 1) {
+            continue;
+        }
+        VarOrRVar v(vars[i], false);
+        if (can_prove(get_element(estimates, vars[i]) > thread_extents[i])) {
+            // Adjacent threads compute adjacent points, so that their
+            // accesses along the innermost dimension are coalesced.
+            pair<VarOrRVar, VarOrRVar> split_vars =
+                split_dim(g, f_handle, stage_num, def, is_group_output, v,
+                          thread_extents[i], "_t", "_s", estimates, sched);
+            thread_dims.push_back(split_vars.first);
+            serial_dims.push_back(split_vars.second);
+        } else {
+            thread_dims.push_back(v);
+        }
+    }
+    return serial_dims;
+}
+
+void Partitioner::generate_group_gpu_schedule(
+        const Group &g, const Target &t,
+        const map<FStage, DimBounds> &group_loop_bounds,
+        const map<string, Box> &group_storage_bounds,
+        const set<string> &inlines,
+        AutoSchedule &sched) {
+    Function g_out = g.output.func;
+
+    debug(3) << "\n================\n";
+    debug(3) << "Scheduling group for GPU:\n";
+    debug(3) << "================\n";
+    debug(3) << g;
+
+    // Get the definition corresponding to the stage
+    Definition def = get_stage_definition(g_out, g.output.stage_num);
+
+    // Get the estimates for stage bounds
+    DimBounds stg_bounds = get_bounds(g.output);
+    map<string, Expr> stg_estimates = bounds_to_estimates(stg_bounds);
+
+    Stage f_handle = Stage(Func(g_out));
+
+    // Get a function handle for scheduling the stage
+    if (g.output.stage_num > 0) {
+        int stage_num = g.output.stage_num;
+        f_handle = Func(g_out).update(stage_num - 1);
+    } else {
+        Func(g_out).compute_root();
+        sched.push_schedule(f_handle.name(), g.output.stage_num, "compute_root()", {});
+    }
+
+    if (g.output.func.has_extern_definition()) {
+        internal_assert(g.members.size() == 1);
+        return;
+    }
+
+    // 'dims' will get modified since we are going to apply the schedules
+    // (e.g. tiling, reordering, etc.)
+    vector<Dim> &dims = def.schedule().dims();
+
+    // Reorder the dimensions such that the smallest stride is innermost. The
+    // innermost pure dimension is distributed over the x dimension of the
+    // threads, which coalesces the accesses of a warp.
+    if (dims.size() > 2) {
+        map<string, Expr> strides =
+            analyze_spatial_locality(g.output, group_storage_bounds, inlines);
+        if (!strides.empty()) {
+            reorder_dims(f_handle, g.output.stage_num, def, strides, sched);
+        }
+    }
+
+    // The innermost (up to three) pure dimensions with known extents are
+    // distributed over the blocks. The innermost two of those are also
+    // distributed over the threads of each block.
+    vector<string> gpu_vars;
+    for (int d = 0; d < (int)dims.size() - 1 && gpu_vars.size() < 3; d++) {
+        string var = get_base_name(dims[d].var);
+        const auto &iter = stg_estimates.find(var);
+        if (dims[d].is_pure() && !dims[d].is_rvar() &&
+            (iter != stg_estimates.end()) && iter->second.defined()) {
+            gpu_vars.push_back(var);
+        }
+    }
+
+    if (gpu_vars.empty()) {
+        user_warning << "No dimensions of " << f_handle.name()
+                     << " can be distributed over the GPU" << '\n';
+        f_handle.gpu_single_thread();
+        sched.push_schedule(f_handle.name(), g.output.stage_num, "gpu_single_thread()", {});
+    }
+
+    // The extent of each dimension that is computed by a block: the tile size
+    // if the grouping tiled the dimension. Otherwise, each thread computes a
+    // single point along the dimension.
+    const int64_t *par = as_const_int(arch_params.parallelism);
+    int64_t min_blocks = 2 * (par ? *par : 1);
+    vector<int64_t> extents, tiles;
+    for (const auto &var : gpu_vars) {
+        const int64_t *est = as_const_int(simplify(get_element(stg_estimates, var)));
+        extents.push_back(est ? *est : -1);
+        const auto &iter = g.tile_sizes.find(var);
+        const int64_t *tile = (iter != g.tile_sizes.end()) ? as_const_int(iter->second) : nullptr;
+        tiles.push_back((tile && est && *tile < *est) ? *tile : -1);
+    }
+
+    // Choose the shape of the blocks. Use a power of two number of threads
+    // along each dimension, up to 'gpu_max_threads' per block, with as many
+    // as possible along the innermost dimension; then shrink the blocks
+    // towards a single warp while there are too few of them to keep all the
+    // multiprocessors of the GPU busy.
+    vector<int> thread_extents;
+    int block_threads = 1;
+    for (size_t i = 0; i < gpu_vars.size() && i < 2; i++) {
+        int64_t extent = tiles[i] > 0 ? tiles[i] : extents[i];
+        if (extent < 0) {
+            extent = gpu_max_threads;
+        }
+        int threads = 1;
+        while (threads * 2 <= extent && block_threads * threads * 2 <= gpu_max_threads) {
+            threads *= 2;
+        }
+        thread_extents.push_back(threads);
+        block_threads *= threads;
+    }
+    auto num_blocks = [&]() {
+        int64_t blocks = 1;
+        for (size_t i = 0; i < gpu_vars.size(); i++) {
+            int64_t block = tiles[i] > 0 ? tiles[i] : (i < 2 ? thread_extents[i] : 1);
+            if (extents[i] < 0) {
+                // Assume an unknown extent is large enough on its own.
+                return min_blocks;
+            }
+            blocks *= (extents[i] + block - 1) / block;
+        }
+        return blocks;
+    };
+    while (block_threads > gpu_warp_size && num_blocks() < min_blocks) {
+        int d = (thread_extents.size() > 1 && thread_extents[1] > 1) ? 1 : 0;
+        thread_extents[d] /= 2;
+        block_threads /= 2;
+    }
+
+    // Split the dimensions into blocks, threads, and the serial loops that
+    // each thread runs over the points of a tile it computes.
+    vector<VarOrRVar> block_dims, thread_dims, serial_dims;
+    for (size_t i = 0; i < gpu_vars.size(); i++) {
+        VarOrRVar v(gpu_vars[i], false);
+        int threads = i < thread_extents.size() ? thread_extents[i] : 1;
+        if (tiles[i] > 0) {
+            if (tiles[i] == 1) {
+                block_dims.push_back(v);
+                continue;
+            }
+            pair<VarOrRVar, VarOrRVar> tile_vars =
+                split_dim(g, f_handle, g.output.stage_num, def, true, v,
+                          (int)tiles[i], "_i", "_o", stg_estimates, sched);
+            block_dims.push_back(tile_vars.second);
+            vector<VarOrRVar> inner_serial =
+                gpu_threads_stage(g, f_handle, g.output.stage_num, def, true,
+                                  {tile_vars.first.name()}, {threads},
+                                  stg_estimates, thread_dims, sched);
+            serial_dims.insert(serial_dims.end(), inner_serial.begin(), inner_serial.end());
+            if (threads <= 1) {
+                serial_dims.push_back(tile_vars.first);
+            }
+        } else if (threads > 1) {
+            // The thread extent is at most the extent of the dimension, so
+            // the outer loop of the split always exists.
+            pair<VarOrRVar, VarOrRVar> split_vars =
+                split_dim(g, f_handle, g.output.stage_num, def, true, v,
+                          threads, "_i", "_o", stg_estimates, sched);
+            thread_dims.push_back(split_vars.first);
+            block_dims.push_back(split_vars.second);
+        } else {
+            block_dims.push_back(v);
+        }
+    }
+
+    // Reorder the loops such that the reductions and the serial loops are
+    // innermost, the threads are within the blocks, and the remaining
+    // dimensions are serial loops around the kernel.
+    if (!gpu_vars.empty()) {
+        set<string> gpu_dims;
+        for (const auto &dims_list : {serial_dims, thread_dims, block_dims}) {
+            for (const auto &v : dims_list) {
+                gpu_dims.insert(v.name());
+            }
+        }
+        vector<VarOrRVar> ordering, outer;
+        for (int d = 0; d < (int)dims.size() - 1; d++) {
+            string var = get_base_name(dims[d].var);
+            if (gpu_dims.count(var)) {
+                continue;
+            }
+            if (dims[d].is_rvar()) {
+                ordering.push_back(VarOrRVar(var, true));
+            } else {
+                outer.push_back(VarOrRVar(var, false));
+            }
+        }
+        ordering.insert(ordering.end(), serial_dims.begin(), serial_dims.end());
+        ordering.insert(ordering.end(), thread_dims.begin(), thread_dims.end());
+        ordering.insert(ordering.end(), block_dims.begin(), block_dims.end());
+        ordering.insert(ordering.end(), outer.begin(), outer.end());
+        reorder_stage(f_handle, g.output.stage_num, def, ordering, sched);
+
+        for (const auto &v : thread_dims) {
+            f_handle.gpu_threads(v);
+            sched.push_schedule(f_handle.name(), g.output.stage_num,
+                                "gpu_threads(" + v.name() + ")", {v.name()});
+        }
+        for (const auto &v : block_dims) {
+            f_handle.gpu_blocks(v);
+            sched.push_schedule(f_handle.name(), g.output.stage_num,
+                                "gpu_blocks(" + v.name() + ")", {v.name()});
+        }
+    }
 
     for (const FStage &mem : g.members) {
         // Skip member stages that have been inlined or stage that is the
@@ -2874,30 +4040,21 @@ void Partitioner::generate_group_cpu_schedule(
         map<string, Expr> mem_estimates =
             bounds_to_estimates(get_element(group_loop_bounds, mem));
 
-        set<string> mem_rvars;
-        vector<Dim> &mem_dims = mem_def.schedule().dims();
-        for (int d = 0; d < (int)mem_dims.size() - 1; d++) {
-            if (mem_dims[d].is_rvar()) {
-                mem_rvars.insert(get_base_name(mem_dims[d].var));
-            }
-        }
-
         // Get a function handle for scheduling the stage
         Stage mem_handle = Stage(Func(mem.func));
 
+        // Members are computed per block, i.e. at the innermost block loop of
+        // the group output. This places them in shared memory.
         if (mem.stage_num > 0) {
             mem_handle = Func(mem.func).update(mem.stage_num - 1);
         } else {
-            if (!outer_dims.empty()) {
-                if (tile_inner_var.is_rvar) {
-                    Func(mem.func).compute_at(Func(g_out), tile_inner_var.rvar);
-                } else {
-                    Func(mem.func).compute_at(Func(g_out), tile_inner_var.var);
-                }
+            if (!block_dims.empty()) {
+                const VarOrRVar &block_var = block_dims[0];
+                Func(mem.func).compute_at(Func(g_out), block_var.var);
                 string sanitized_g_out = get_sanitized_name(g_out.name());
                 sched.push_schedule(mem_handle.name(), mem.stage_num,
-                                    "compute_at(" + sanitized_g_out + ", " + tile_inner_var.name() + ")",
-                                    {sanitized_g_out, tile_inner_var.name()});
+                                    "compute_at(" + sanitized_g_out + ", " + block_var.name() + ")",
+                                    {sanitized_g_out, block_var.name()});
             } else {
                 user_warning << "Degenerate tiling. No dimensions are tiled" << '\n';
                 user_warning << "Computing \"" <<  mem.func.name() << "\" at root" << '\n';
@@ -2906,9 +4063,14 @@ void Partitioner::generate_group_cpu_schedule(
             }
         }
 
+        if (mem.func.has_extern_definition() || block_dims.empty()) {
+            continue;
+        }
+
         // Reorder the dimensions for better spatial locality. If we only have
         // one dimension (excluding __outermost), there is nothing to reorder.
-        if (dims.size() > 2) {
+        vector<Dim> &mem_dims = mem_def.schedule().dims();
+        if (mem_dims.size() > 2) {
             map<string, Expr> mem_strides =
                 analyze_spatial_locality(mem, group_storage_bounds, inlines);
             if (!mem_strides.empty()) {
@@ -2916,37 +4078,64 @@ void Partitioner::generate_group_cpu_schedule(
             }
         }
 
-        vectorize_stage(g, mem_handle, mem.stage_num, mem_def, mem.func, false,
-                        t, mem_rvars, mem_estimates, sched);
-    }
-}
+        // Distribute the innermost pure dimensions of the member over the
+        // threads of the block, using the same block shape as the output.
+        vector<string> mem_vars;
+        for (int d = 0; d < (int)mem_dims.size() - 1 && mem_vars.size() < thread_extents.size(); d++) {
+            string var = get_base_name(mem_dims[d].var);
+            const auto &iter = mem_estimates.find(var);
+            if (mem_dims[d].is_pure() && !mem_dims[d].is_rvar() &&
+                (iter != mem_estimates.end()) && iter->second.defined()) {
+                mem_vars.push_back(var);
+            }
+        }
 
-void Partitioner::generate_cpu_schedule(const Target &t, AutoSchedule &sched) {
-    // Grab the group bounds early as they rely on the dimensions of the group
-    // outputs which will be altered by modifying schedules.
-    map<FStage, map<FStage, DimBounds>> loop_bounds = group_loop_bounds();
-    map<FStage, map<string, Box>> storage_bounds = group_storage_bounds();
+        vector<VarOrRVar> mem_thread_dims;
+        vector<VarOrRVar> mem_serial_dims =
+            gpu_threads_stage(g, mem_handle, mem.stage_num, mem_def, false, mem_vars,
+                              thread_extents, mem_estimates, mem_thread_dims, sched);
+        if (mem_thread_dims.empty()) {
+            continue;
+        }
 
-    set<string> inlines;
-    // Mark all functions that are inlined.
-    for (const pair<FStage, Group> &g : groups) {
-        for (const string &inline_func : g.second.inlined) {
-            inlines.insert(inline_func);
+        set<string> mem_gpu_dims;
+        for (const auto &dims_list : {mem_serial_dims, mem_thread_dims}) {
+            for (const auto &v : dims_list) {
+                mem_gpu_dims.insert(v.name());
+            }
+        }
+        vector<VarOrRVar> ordering, outer;
+        for (int d = 0; d < (int)mem_dims.size() - 1; d++) {
+            string var = get_base_name(mem_dims[d].var);
+            if (mem_gpu_dims.count(var)) {
+                continue;
+            }
+            if (mem_dims[d].is_rvar()) {
+                ordering.push_back(VarOrRVar(var, true));
+            } else {
+                outer.push_back(VarOrRVar(var, false));
+            }
+        }
+        ordering.insert(ordering.end(), mem_serial_dims.begin(), mem_serial_dims.end());
+        ordering.insert(ordering.end(), mem_thread_dims.begin(), mem_thread_dims.end());
+        ordering.insert(ordering.end(), outer.begin(), outer.end());
+        reorder_stage(mem_handle, mem.stage_num, mem_def, ordering, sched);
+
+        for (const auto &v : mem_thread_dims) {
+            mem_handle.gpu_threads(v);
+            sched.push_schedule(mem_handle.name(), mem.stage_num,
+                                "gpu_threads(" + v.name() + ")", {v.name()});
         }
     }
+}
 
-    // TODO: Inlining functions with update definitions has different
-    // behavior than pure functions. They may need to be computed above
-    // the innermost vector loop to avoid complications with varying
-    // extents across different vector lanes.
-    //
-    // Since the default schedule is compute inline, we don't need to
-    // explicitly call compute_inline() on the function.
+void Partitioner::generate_gpu_schedule(const Target &t, AutoSchedule &sched) {
+    GroupSchedulingInfo info = group_scheduling_info();
 
     // Realize schedule for each group in the pipeline.
     for (const auto &g : groups) {
-        generate_group_cpu_schedule(g.second, t, get_element(loop_bounds, g.first),
-                                    get_element(storage_bounds, g.first), inlines, sched);
+        generate_group_gpu_schedule(g.second, t, get_element(info.loop_bounds, g.first),
+                                    get_element(info.storage_bounds, g.first), info.inlines, sched);
     }
 }
 
@@ -3319,13 +4508,159 @@ set<string> get_unbounded_functions(const map<string, Box> &pipeline_bounds,
     return unbounded;
 }
 
+// The number of points of the first output of a pipeline, given the extents
+// of the outputs.
+int64_t output_points(const OutputShape &shape) {
+    int64_t points = 1;
+    for (int extent : shape[0]) {
+        points *= extent;
+    }
+    return points;
+}
+
+// Find the specializations of the schedule of the groups in 'part' for the
+// classes of output shapes in 'shapes'. The classes, including the one given
+// by the estimates of the outputs (which is scheduled without specializing
+// it), are told apart by the number of points of the first output: each of
+// them covers the numbers of points that are closer to its own than to the
+// ones of the other classes, on a logarithmic scale. For each class, the best
+// tile sizes of the groups are found by analyzing the pipeline with the
+// estimates of the outputs replaced by the extents of the class.
+vector<Partitioner::ShapeSpecialization> get_shape_specializations(
+        const Partitioner &part, const vector<Function> &outputs,
+        const vector<OutputShape> &shapes, const map<string, Function> &env,
+        const vector<string> &order, const FuncValueBounds &func_val_bounds,
+        RegionCosts &costs, const set<string> &unbounded,
+        const MachineParams &arch_params, const CostModel &cost_model,
+        const Target &target) {
+    // The extents of the outputs given by their estimates.
+    OutputShape default_shape;
+    for (const Function &f : outputs) {
+        vector<int> extents;
+        for (const string &arg : f.args()) {
+            const int64_t *extent = nullptr;
+            for (const Bound &b : f.schedule().estimates()) {
+                if ((b.var == arg) && b.extent.defined()) {
+                    extent = as_const_int(b.extent);
+                }
+            }
+            user_assert(extent)
+                << "The estimate of dimension " << arg << " of output \"" << f.name()
+                << "\" must be a constant to specialize the schedule for other output shapes\n";
+            extents.push_back((int)*extent);
+        }
+        default_shape.push_back(extents);
+    }
+
+    vector<pair<int64_t, int>> classes = {{output_points(default_shape), -1}};
+    for (size_t i = 0; i < shapes.size(); i++) {
+        user_assert(shapes[i].size() == outputs.size())
+            << "Output shape " << i << " has extents for " << shapes[i].size()
+            << " outputs, but the pipeline has " << outputs.size() << "\n";
+        for (size_t j = 0; j < outputs.size(); j++) {
+            user_assert(shapes[i][j].size() == outputs[j].args().size())
+                << "Output shape " << i << " has " << shapes[i][j].size()
+                << " extents for output \"" << outputs[j].name() << "\", which has "
+                << outputs[j].args().size() << " dimensions\n";
+            for (int extent : shapes[i][j]) {
+                user_assert(extent > 0) << "Output shape " << i << " has an extent of " << extent << "\n";
+            }
+        }
+        classes.push_back({output_points(shapes[i]), (int)i});
+    }
+    std::sort(classes.begin(), classes.end());
+    for (size_t i = 1; i < classes.size(); i++) {
+        user_assert(classes[i].first != classes[i - 1].first)
+            << "The output shapes must have different numbers of points in the first output\n";
+    }
+
+    // The number of points of the first output, and its string representation.
+    const Function &first = outputs[0];
+    string buffer = get_sanitized_name(first.name()) +
+        ((first.outputs() == 1) ? ".output_buffer()" : ".output_buffers()[0]");
+    OutputImageParam out = Func(first).output_buffers()[0];
+    Expr points = 1;
+    string points_text;
+    for (int d = 0; d < out.dimensions(); d++) {
+        points = (d == 0) ? out.dim(d).extent() : points * out.dim(d).extent();
+        points_text += ((d == 0) ? "" : " * ") + buffer + ".dim(" + std::to_string(d) + ").extent()";
+    }
+
+    vector<Partitioner::ShapeSpecialization> result;
+    for (size_t c = 0; c < classes.size(); c++) {
+        if (classes[c].second < 0) {
+            continue;
+        }
+        const OutputShape &shape = shapes[classes[c].second];
+
+        Partitioner::ShapeSpecialization spec;
+        vector<string> conditions;
+        if (c > 0) {
+            int64_t lo = (int64_t)std::ceil(std::sqrt((double)classes[c - 1].first * classes[c].first));
+            spec.condition = (points >= make_const(points.type(), lo));
+            conditions.push_back(points_text + " >= " + std::to_string(lo));
+        }
+        if (c + 1 < classes.size()) {
+            int64_t hi = (int64_t)std::ceil(std::sqrt((double)classes[c].first * classes[c + 1].first));
+            Expr below = (points < make_const(points.type(), hi));
+            spec.condition = spec.condition.defined() ? (spec.condition && below) : below;
+            conditions.push_back(points_text + " < " + std::to_string(hi));
+        }
+        spec.condition_text = conditions[0];
+        for (size_t i = 1; i < conditions.size(); i++) {
+            spec.condition_text += " && " + conditions[i];
+        }
+
+        // Analyze the pipeline with the estimates of the outputs set to the
+        // extents of the class, and restore them afterwards.
+        vector<vector<Expr>> saved_extents;
+        for (size_t i = 0; i < outputs.size(); i++) {
+            Function f = outputs[i];
+            saved_extents.emplace_back();
+            for (Bound &b : f.schedule().estimates()) {
+                saved_extents.back().push_back(b.extent);
+                for (size_t d = 0; d < f.args().size(); d++) {
+                    if (f.args()[d] == b.var) {
+                        b.extent = shape[i][d];
+                    }
+                }
+            }
+        }
+
+        DependenceAnalysis dep_analysis(env, order, func_val_bounds);
+        map<string, Box> pipeline_bounds =
+            get_pipeline_bounds(dep_analysis, outputs, &costs.input_estimates);
+        Partitioner class_part(pipeline_bounds, arch_params, cost_model, target,
+                               dep_analysis, costs, outputs, unbounded);
+        class_part.groups = part.groups;
+        for (const auto &g : part.groups) {
+            spec.tile_sizes[g.first] = class_part.find_best_tile_config(g.second).first;
+            spec.estimates[g.first] = class_part.bounds_to_estimates(class_part.get_bounds(g.first));
+        }
+
+        for (size_t i = 0; i < outputs.size(); i++) {
+            Function f = outputs[i];
+            vector<Bound> &estimates = f.schedule().estimates();
+            for (size_t j = 0; j < estimates.size(); j++) {
+                estimates[j].extent = saved_extents[i][j];
+            }
+        }
+
+        debug(2) << "Specializing for output shape " << classes[c].second
+                 << " when " << spec.condition_text << "\n";
+        result.push_back(spec);
+    }
+    return result;
+}
+
 } // anonymous namespace
 
 // Generate schedules for all functions in the pipeline required to compute the
 // outputs. This applies the schedules and returns a string representation of
 // the schedules. The target architecture is specified by 'target'.
 string generate_schedules(const vector<Function> &outputs, const Target &target,
-                          const MachineParams &arch_params) {
+                          const MachineParams &arch_params,
+                          const vector<OutputShape> &shapes) {
     // Make an environment map which is used throughout the auto scheduling process.
     map<string, Function> env;
     for (Function f : outputs) {
@@ -3435,7 +4770,28 @@ string generate_schedules(const vector<Function> &outputs, const Target &target,
     set<string> unbounded = get_unbounded_functions(pipeline_bounds, env);
 
     debug(2) << "Initializing partitioner...\n";
-    Partitioner part(pipeline_bounds, arch_params, dep_analysis, costs, outputs, unbounded);
+    // On targets that use HVX, the pipeline (or most of it) runs on the
+    // Hexagon DSP, whose memory hierarchy and number of vector contexts are
+    // fixed.
+    MachineParams model_params = arch_params;
+    if (uses_hvx(target)) {
+        int hvx_threads = target.has_feature(Target::HVX_128) ? hvx_128_threads : hvx_64_threads;
+        model_params.parallelism = simplify(min(arch_params.parallelism, hvx_threads));
+        model_params.last_level_cache_size =
+            simplify(min(arch_params.last_level_cache_size, hvx_l2_size));
+        model_params.inner_cache_sizes.clear();
+    }
+
+    // Rank the groupings by their predicted runtime if the machine parameters
+    // have been calibrated.
+    std::unique_ptr<CostModel> cost_model;
+    if (model_params.arith_cost.defined() && model_params.load_cost.defined()) {
+        cost_model.reset(new CalibratedCostModel(model_params));
+    } else {
+        cost_model.reset(new OpCountCostModel());
+    }
+
+    Partitioner part(pipeline_bounds, model_params, *cost_model, target, dep_analysis, costs, outputs, unbounded);
 
     // Compute and display reuse
     /* TODO: Use the reuse estimates to reorder loops
@@ -3482,10 +4838,26 @@ string generate_schedules(const vector<Function> &outputs, const Target &target,
         part.disp_pipeline_graph();
     }
 
+    if (!shapes.empty()) {
+        if (target.has_gpu_feature()) {
+            user_warning << "The schedule is only specialized for other output shapes on CPUs\n";
+        } else {
+            debug(2) << "Computing the tilings for other output shapes...\n";
+            part.specializations =
+                get_shape_specializations(part, outputs, shapes, env, order, func_val_bounds,
+                                          costs, unbounded, model_params, *cost_model, target);
+        }
+    }
+
     debug(2) << "Initializing AutoSchedule...\n";
     AutoSchedule sched(env, full_order);
-    debug(2) << "Generating CPU schedule...\n";
-    part.generate_cpu_schedule(target, sched);
+    if (target.has_gpu_feature()) {
+        debug(2) << "Generating GPU schedule...\n";
+        part.generate_gpu_schedule(target, sched);
+    } else {
+        debug(2) << "Generating CPU schedule...\n";
+        part.generate_cpu_schedule(target, sched);
+    }
 
     std::ostringstream oss;
     oss << "// Target: " << target.to_string() << "\n";
@@ -3498,33 +4870,201 @@ string generate_schedules(const vector<Function> &outputs, const Target &target,
              << "*******************************\n" << sched_string << "\n\n";
 
     // TODO: Unify both inlining and grouping for fast mem
-    // TODO: GPU scheduling
-    // TODO: Hierarchical tiling
 
     return sched_string;
 }
 
+namespace {
+
+// The sizes (in bytes) of the data caches of the host, innermost first, or an
+// empty vector if they can't be determined.
+vector<int64_t> host_cache_sizes() {
+    vector<int64_t> result;
+    auto add = [&](int level, int64_t size) {
+        if (level < 1 || size <= 0) {
+            return;
+        }
+        if ((int)result.size() < level) {
+            result.resize(level, 0);
+        }
+        result[level - 1] = std::max(result[level - 1], size);
+    };
+#if defined(__linux__)
+    for (int i = 0; ; i++) {
+        string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(i) + "/";
+        std::ifstream size_file(dir + "size"), type_file(dir + "type"), level_file(dir + "level");
+        string size, type;
+        int level = 0;
+        if (!(size_file >> size) || !(type_file >> type) || !(level_file >> level)) {
+            break;
+        }
+        if (type == "Instruction") {
+            continue;
+        }
+        // The sizes are of the form "32K" or "8M".
+        std::istringstream iss(size);
+        int64_t bytes = 0;
+        char unit = 0;
+        iss >> bytes >> unit;
+        if (unit == 'K') {
+            bytes *= 1024;
+        } else if (unit == 'M') {
+            bytes *= 1024 * 1024;
+        } else if (unit == 'G') {
+            bytes *= 1024 * 1024 * 1024;
+        }
+        add(level, bytes);
+    }
+#elif defined(__APPLE__)
+    const char *names[] = {"hw.l1dcachesize", "hw.l2cachesize", "hw.l3cachesize"};
+    for (int level = 1; level <= 3; level++) {
+        int64_t size = 0;
+        size_t len = sizeof(size);
+        if (sysctlbyname(names[level - 1], &size, &len, nullptr, 0) == 0) {
+            add(level, size);
+        }
+    }
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+    // The deterministic cache parameters leaf of cpuid.
+    for (int i = 0; ; i++) {
+        int info[4];
+        __cpuidex(info, 4, i);
+        int type = info[0] & 0x1f;
+        if (type == 0) {
+            break;
+        }
+        if (type == 2) {
+            // Instruction cache
+            continue;
+        }
+        int level = (info[0] >> 5) & 0x7;
+        int64_t ways = ((info[1] >> 22) & 0x3ff) + 1;
+        int64_t partitions = ((info[1] >> 12) & 0x3ff) + 1;
+        int64_t line_size = (info[1] & 0xfff) + 1;
+        int64_t sets = (int64_t)(uint32_t)info[2] + 1;
+        add(level, ways * partitions * line_size * sets);
+    }
+#endif
+    // Drop the levels that weren't found.
+    result.erase(std::remove(result.begin(), result.end(), 0), result.end());
+    return result;
+}
+
+// Measure how much longer it takes to stream a float from memory than to do a
+// vector arithmetic operation on floats.
+int host_balance(int vector_width) {
+    using Clock = std::chrono::steady_clock;
+    auto seconds = [](Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    };
+
+    // Much larger than any cache.
+    const size_t n = 16 * 1024 * 1024;
+    vector<float> data(n, 1.0f);
+    float sum[8] = {0};
+    double load_time = std::numeric_limits<double>::infinity();
+    for (int trial = 0; trial < 3; trial++) {
+        auto start = Clock::now();
+        for (size_t i = 0; i < n; i += 8) {
+            for (int j = 0; j < 8; j++) {
+                sum[j] += data[i + j];
+            }
+        }
+        load_time = std::min(load_time, seconds(start) / n);
+    }
+
+    const int iters = 1024 * 1024;
+    float x[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    double op_time = std::numeric_limits<double>::infinity();
+    for (int trial = 0; trial < 3; trial++) {
+        auto start = Clock::now();
+        for (int i = 0; i < iters; i++) {
+            for (int j = 0; j < 8; j++) {
+                x[j] = x[j] * 0.9999f + 0.0001f;
+            }
+        }
+        // Two operations for each element, done one vector at a time.
+        op_time = std::min(op_time, seconds(start) / (iters * 8 * 2) / vector_width);
+    }
+
+    // Keep the results live.
+    volatile float sink = 0;
+    for (int j = 0; j < 8; j++) {
+        sink = sink + sum[j] + x[j];
+    }
+
+    if (!(op_time > 0) || !(load_time > 0)) {
+        return 0;
+    }
+    return std::max(1, (int)(load_time / op_time + 0.5));
+}
+
+}  // namespace
+
 }
 
 MachineParams MachineParams::generic() {
   return MachineParams(16, 16 * 1024 * 1024, 40);
 }
 
+MachineParams MachineParams::from_host() {
+    // Detecting the cache size is cheap, but measuring the balance takes a
+    // few tens of milliseconds, so do it once.
+    static MachineParams params = []() {
+        MachineParams result = generic();
+        int cores = (int)std::thread::hardware_concurrency();
+        if (cores > 0) {
+            result.parallelism = cores;
+        }
+        std::vector<int64_t> cache_sizes = Internal::host_cache_sizes();
+        if (!cache_sizes.empty()) {
+            for (int64_t size : cache_sizes) {
+                result.inner_cache_sizes.push_back((int32_t)std::min<int64_t>(size, INT32_MAX));
+            }
+            result.last_level_cache_size = result.inner_cache_sizes.back();
+            result.inner_cache_sizes.pop_back();
+        }
+        int balance = Internal::host_balance(get_host_target().natural_vector_size(Float(32)));
+        if (balance > 0) {
+            result.balance = balance;
+        }
+        return result;
+    }();
+    return params;
+}
+
 std::string MachineParams::to_string() const {
     internal_assert(parallelism.type().is_int() &&
                     last_level_cache_size.type().is_int() &&
                     balance.type().is_int());
     std::ostringstream o;
-    o << parallelism << "," << last_level_cache_size << "," << balance;
+    o << parallelism << ",";
+    for (const Expr &size : inner_cache_sizes) {
+        internal_assert(size.type().is_int());
+        o << size << "/";
+    }
+    o << last_level_cache_size << "," << balance;
+    if (arith_cost.defined() && load_cost.defined()) {
+        internal_assert(arith_cost.type().is_int() && load_cost.type().is_int());
+        o << "," << arith_cost << "," << load_cost;
+    }
     return o.str();
 }
 
 MachineParams::MachineParams(const std::string &s) {
     std::vector<std::string> v = Internal::split_string(s, ",");
-    user_assert(v.size() == 3) << "Unable to parse MachineParams: " << s;
+    user_assert(v.size() == 3 || v.size() == 5) << "Unable to parse MachineParams: " << s;
     parallelism = Internal::string_to_int(v[0]);
-    last_level_cache_size = Internal::string_to_int(v[1]);
+    std::vector<std::string> cache_sizes = Internal::split_string(v[1], "/");
+    for (size_t i = 0; i + 1 < cache_sizes.size(); i++) {
+        inner_cache_sizes.push_back(Internal::string_to_int(cache_sizes[i]));
+    }
+    last_level_cache_size = Internal::string_to_int(cache_sizes.back());
     balance = Internal::string_to_int(v[2]);
+    if (v.size() == 5) {
+        arith_cost = Internal::string_to_int(v[3]);
+        load_cost = Internal::string_to_int(v[4]);
+    }
 }
 
 }
@@ -14,37 +14,77 @@ namespace Halide {
 /** A struct representing the machine parameters to generate the auto-scheduled
  * code for. */
 struct MachineParams {
-    /** Maximum level of parallelism avalaible. */
+    /** Maximum level of parallelism avalaible. On GPU targets, this is
+     * the number of multiprocessors; the auto-scheduler aims for at
+     * least twice as many thread blocks. */
     Expr parallelism;
     /** Size of the last-level cache (in KB). */
     Expr last_level_cache_size;
+    /** Sizes of the smaller caches below the last level (in bytes),
+     * innermost first. If any are given, the auto-scheduler splits the
+     * tiles of a group into strips whose intermediates fit in the
+     * innermost cache possible: the group members are stored at the
+     * tiles, which bound their footprint in the last-level cache, and
+     * computed at the strips. */
+    std::vector<Expr> inner_cache_sizes;
     /** Indicates how much more expensive is the cost of a load compared to
      * the cost of an arithmetic operation at last level cache. */
     Expr balance;
+    /** Measured time (in picoseconds) of an arithmetic operation, and of
+     * loading a byte that is resident in the last-level cache. If both are
+     * defined, the auto-scheduler compares groupings by the runtime they
+     * predict, instead of by the sum of their arithmetic and memory
+     * costs. test/performance/auto_schedule_calibration.cpp fits them for
+     * the host machine. */
+    Expr arith_cost, load_cost;
 
     explicit MachineParams(int32_t parallelism, int32_t llc, int32_t balance)
         : parallelism(parallelism), last_level_cache_size(llc), balance(balance) {}
 
+    explicit MachineParams(int32_t parallelism, int32_t llc, int32_t balance,
+                           int32_t arith_cost, int32_t load_cost)
+        : parallelism(parallelism), last_level_cache_size(llc), balance(balance),
+          arith_cost(arith_cost), load_cost(load_cost) {}
+
     /** Default machine parameters for generic CPU architecture. */
     EXPORT static MachineParams generic();
 
-    /** Convert the MachineParams into canonical string form. */
+    /** Machine parameters for the host: the number of hardware threads,
+     * the sizes of the data caches (from sysfs, sysctl, or cpuid),
+     * and a balance measured by timing loads streamed from memory against
+     * vector arithmetic. Anything that can't be detected takes its
+     * generic() value. The measurement is done once per process. */
+    EXPORT static MachineParams from_host();
+
+    /** Convert the MachineParams into canonical string form. The
+     * inner cache sizes, if any, precede the last-level cache size in
+     * the second field, separated by '/' (e.g. "16,32768/262144/16777216,40").
+     * The calibrated costs, if any, are appended as two more fields. */
     EXPORT std::string to_string() const;
 
     /** Reconstruct a MachineParams from canonical string form. */
     EXPORT explicit MachineParams(const std::string &s);
 };
 
+/** Estimates of the extents of the outputs of a pipeline for one class of
+ * runtime shapes, with a list of extents for each output, in the order of
+ * the outputs and of their dimensions (e.g. {{3840, 2160}} for a pipeline
+ * with one two-dimensional output). The mins of the estimates given with
+ * Func::estimate are kept. */
+typedef std::vector<std::vector<int>> OutputShape;
+
 namespace Internal {
 
 /** Generate schedules for Funcs within a pipeline. The Funcs should not already
  * have specializations or schedules as the current auto-scheduler does not take
  * into account user-defined schedules or specializations. This applies the
  * schedules and returns a string representation of the schedules. The target
- * architecture is specified by 'target'. */
+ * architecture is specified by 'target'. The schedules of the group outputs
+ * are specialized for the classes of output shapes in 'shapes', if any. */
 EXPORT std::string generate_schedules(const std::vector<Function> &outputs,
                                       const Target &target,
-                                      const MachineParams &arch_params);
+                                      const MachineParams &arch_params,
+                                      const std::vector<OutputShape> &shapes = std::vector<OutputShape>());
 
 }
 }
@@ -0,0 +1,111 @@
+#include "BatchAsserts.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "IRVisitor.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::vector;
+
+namespace {
+
+// Check that an assert condition can be evaluated before the asserts
+// that precede it have passed. Those asserts may be what guarantees
+// a pointer is valid or a divisor is non-zero, so loads, impure calls
+// (which include reads of buffer fields) and division by anything
+// but a constant are ruled out.
+class SafeToHoist : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const Load *op) override {
+        result = false;
+    }
+
+    void visit(const Call *op) override {
+        if (!op->is_pure()) {
+            result = false;
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+    void visit(const Div *op) override {
+        if (!is_const(op->b)) {
+            result = false;
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+    void visit(const Mod *op) override {
+        if (!is_const(op->b)) {
+            result = false;
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+public:
+    bool result = true;
+};
+
+bool safe_to_hoist(const Expr &condition) {
+    SafeToHoist check;
+    condition.accept(&check);
+    return check.result;
+}
+
+class BatchAsserts : public IRMutator2 {
+    using IRMutator2::visit;
+
+    void flatten(const Stmt &s, vector<Stmt> &stmts) {
+        if (const Block *b = s.as<Block>()) {
+            flatten(b->first, stmts);
+            flatten(b->rest, stmts);
+        } else {
+            stmts.push_back(mutate(s));
+        }
+    }
+
+    Stmt visit(const Block *op) override {
+        vector<Stmt> stmts;
+        flatten(op, stmts);
+
+        vector<Stmt> result, run;
+        auto end_run = [&]() {
+            if (run.size() < 2) {
+                result.insert(result.end(), run.begin(), run.end());
+            } else {
+                Expr all_pass;
+                for (const Stmt &s : run) {
+                    Expr c = s.as<AssertStmt>()->condition;
+                    all_pass = all_pass.defined() ? all_pass && c : c;
+                }
+                result.push_back(IfThenElse::make(!all_pass, Block::make(run)));
+            }
+            run.clear();
+        };
+        for (const Stmt &s : stmts) {
+            const AssertStmt *a = s.as<AssertStmt>();
+            if (a && a->condition.type().is_scalar() && safe_to_hoist(a->condition)) {
+                run.push_back(s);
+            } else {
+                end_run();
+                result.push_back(s);
+            }
+        }
+        end_run();
+
+        return Block::make(result);
+    }
+};
+
+}  // namespace
+
+Stmt batch_asserts(const Stmt &s) {
+    return BatchAsserts().mutate(s);
+}
+
+}
+}
@@ -0,0 +1,25 @@
+#ifndef HALIDE_BATCH_ASSERTS_H
+#define HALIDE_BATCH_ASSERTS_H
+
+/** \file
+ * Defines the lowering pass that combines runs of assertions into a
+ * single branch.
+ */
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Replace each run of two or more consecutive AssertStmts whose
+ * conditions are cheap and safe to evaluate early with a single test
+ * of all of their conditions, guarding the original asserts, which
+ * then only run to report the failure. The checks of buffer and
+ * parameter arguments at the top of a pipeline are such a run, and
+ * each assert is otherwise its own conditional branch. */
+Stmt batch_asserts(const Stmt &s);
+
+}
+}
+
+#endif
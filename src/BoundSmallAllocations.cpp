@@ -1,5 +1,8 @@
+#include <limits>
+
 #include "BoundSmallAllocations.h"
 #include "Bounds.h"
+#include "CodeGen_Internal.h"
 #include "IRMutator.h"
 #include "Simplify.h"
 
@@ -36,7 +39,8 @@ class BoundSmallAllocations : public IRMutator {
         b.min = simplify(b.min);
         b.max = simplify(b.max);
         scope.push(op->name, b);
-        if (op->for_type == ForType::GPUThread) {
+        if (op->for_type == ForType::GPUThread ||
+            op->for_type == ForType::GPULane) {
             bool old_in_thread_loop = in_thread_loop;
             in_thread_loop = true;
             IRMutator::visit(op);
@@ -61,13 +65,25 @@ class BoundSmallAllocations : public IRMutator {
         // halide_malloc. For now we are very conservative, and only
         // round sizes up to a constant if they're smaller than that.
         Expr malloc_overhead = 128 / op->type.bytes();
+        // Allocations of a dynamic size that is bounded by something
+        // small enough for the stack (e.g. per-tile scratch of a tile
+        // size Param with a range) can be rounded up and go on the
+        // stack too, rather than going to halide_malloc every tile.
+        bool fits_on_stack = false;
+        const int64_t *const_bound = bound.defined() ? as_const_int(bound) : nullptr;
+        if (const_bound && *const_bound > 0 && *const_bound <= std::numeric_limits<int32_t>::max() &&
+            (op->memory_type == MemoryType::Auto || op->memory_type == MemoryType::Stack) &&
+            !op->new_expr.defined() && op->free_function.empty()) {
+            fits_on_stack = can_allocation_fit_on_stack(*const_bound * op->type.bytes());
+        }
         if (bound.defined() &&
             (in_thread_loop ||
+             fits_on_stack ||
              can_prove(bound <= malloc_overhead))) {
             user_assert(can_prove(bound <= Int(32).max()))
                 << "Allocation " << op->name << " has a size greater than 2^31: " << bound << "\n";
             bound = simplify(cast<int32_t>(bound));
-            stmt = Allocate::make(op->name, op->type, {bound}, op->condition,
+            stmt = Allocate::make(op->name, op->type, op->memory_type, {bound}, op->condition,
                                   mutate(op->body), op->new_expr, op->free_function);
             return;
         } else {
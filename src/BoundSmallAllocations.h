@@ -16,7 +16,8 @@ namespace Internal {
  * Use bounds analysis to attempt to bound the sizes of small
  * allocations. Inside GPU kernels this is necessary in order to
  * compile. On the CPU this is also useful, because it prevents malloc
- * calls for (provably) tiny allocations. */
+ * calls for allocations that are provably tiny, or provably small
+ * enough to go on the stack. */
 Stmt bound_small_allocations(const Stmt &s);
 
 }
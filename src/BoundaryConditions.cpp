@@ -210,6 +210,21 @@ Func mirror_interior(const Func &source,
     return bounded;
 }
 
+Func pad_once(Func bounded, LoopLevel at, int vector_width) {
+    user_assert(bounded.defined())
+        << "pad_once called with an undefined Func.\n";
+    user_assert(!bounded.has_update_definition())
+        << "pad_once called with Func " << bounded.name()
+        << ", which has update definitions. It should be a boundary condition Func.\n";
+
+    bounded.compute_at(at);
+    if (vector_width > 1 && bounded.dimensions() > 0) {
+        bounded.vectorize(bounded.args()[0], vector_width);
+    }
+
+    return bounded;
+}
+
 }
 
 }
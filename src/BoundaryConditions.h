@@ -260,6 +260,27 @@ inline NO_INLINE Func mirror_interior(const T &func_like, Bounds&&... bounds) {
 }
 // @}
 
+/** Compute a boundary condition Func, as returned by one of the
+ *  functions above, into a padded buffer at the given loop level of its
+ *  consumers, instead of inlining it into every access. The clamps or
+ *  selects of the boundary condition are evaluated once per element of
+ *  the padded region that the consumers require, by a pointwise copy
+ *  loop that loop partitioning splits into a plain copy of the interior
+ *  and cheap edges, and the consumers then read the buffer with no
+ *  boundary logic at all. This is usually much faster for stencils with
+ *  a large radius over small tiles, for which the loops of the
+ *  consumers can't be partitioned. If vector_width is greater than one,
+ *  the copy is vectorized by it along the innermost dimension. Returns
+ *  the boundary Func.
+ \code
+ Func clamped = BoundaryConditions::repeat_edge(input);
+ blur(x, y) = ... clamped(x + i, y + j) ...
+ blur.tile(x, y, xo, yo, xi, yi, 32, 32);
+ BoundaryConditions::pad_once(clamped, LoopLevel(blur, xo), 8);
+ \endcode
+ */
+EXPORT Func pad_once(Func bounded, LoopLevel at, int vector_width = 0);
+
 }
 
 }
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <unordered_map>
 
 #include "Bounds.h"
 #include "IRVisitor.h"
@@ -65,6 +66,16 @@ Interval find_constant_bounds(const Expr &e, const Scope<Interval> &scope) {
 }
 
 
+// The intervals of the Exprs already visited in some scope. Bounds
+// expressions are full of shared subexpressions, and without this
+// their bounds would be recomputed at every use, which is exponential
+// in the depth of the sharing. The Exprs are held so that their
+// addresses aren't reused while they're keys. Bounds computed with
+// const_bound set are kept separately.
+struct IntervalCache {
+    std::unordered_map<const IRNode *, std::pair<Expr, Interval>> intervals[2];
+};
+
 class Bounds : public IRVisitor {
 public:
     Interval interval;
@@ -75,10 +86,33 @@ public:
     // unbounded.
     bool const_bound;
 
-    Bounds(const Scope<Interval> *s, const FuncValueBounds &fb, bool const_bound) :
-        func_bounds(fb), const_bound(const_bound) {
+    // The intervals computed so far in the current scope. Entering
+    // a let starts a new cache, and leaving it goes back to the
+    // enclosing one, which is still valid.
+    IntervalCache *cache;
+
+    Bounds(const Scope<Interval> *s, const FuncValueBounds &fb, bool const_bound,
+           IntervalCache *c) :
+        func_bounds(fb), const_bound(const_bound), cache(c) {
         scope.set_containing_scope(s);
     }
+
+    // Compute the bounds of an Expr into interval.
+    void bounds_of(const Expr &e) {
+        if (e.as<IntImm>() || e.as<UIntImm>() || e.as<FloatImm>() || e.as<Variable>()) {
+            e.accept(this);
+            return;
+        }
+        auto &intervals = cache->intervals[const_bound ? 1 : 0];
+        auto iter = intervals.find(e.get());
+        if (iter != intervals.end()) {
+            interval = iter->second.second;
+            return;
+        }
+        e.accept(this);
+        intervals[e.get()] = {e, interval};
+    }
+
 private:
 
     // Compute the intrinsic bounds of a function.
@@ -124,7 +158,7 @@ private:
     }
 
     void visit(const Cast *op) {
-        op->value.accept(this);
+        bounds_of(op->value);
         Interval a = interval;
 
         if (a.is_single_point(op->value)) {
@@ -162,9 +196,9 @@ private:
             // Then try to strip off junk mins and maxes.
             bool old_constant_bound = const_bound;
             const_bound = true;
-            a.min.accept(this);
+            bounds_of(a.min);
             Expr lower_bound = interval.has_lower_bound() ? interval.min : Expr();
-            a.max.accept(this);
+            bounds_of(a.max);
             Expr upper_bound = interval.has_upper_bound() ? interval.max : Expr();
             const_bound = old_constant_bound;
 
@@ -237,9 +271,9 @@ private:
     }
 
     void visit(const Add *op) {
-        op->a.accept(this);
+        bounds_of(op->a);
         Interval a = interval;
-        op->b.accept(this);
+        bounds_of(op->b);
         Interval b = interval;
 
         if (a.is_single_point(op->a) && b.is_single_point(op->b)) {
@@ -276,9 +310,9 @@ private:
     }
 
     void visit(const Sub *op) {
-        op->a.accept(this);
+        bounds_of(op->a);
         Interval a = interval;
-        op->b.accept(this);
+        bounds_of(op->b);
         Interval b = interval;
 
         if (a.is_single_point(op->a) && b.is_single_point(op->b)) {
@@ -322,10 +356,10 @@ private:
     }
 
     void visit(const Mul *op) {
-        op->a.accept(this);
+        bounds_of(op->a);
         Interval a = interval;
 
-        op->b.accept(this);
+        bounds_of(op->b);
         Interval b = interval;
 
         // Move constants to the right
@@ -387,10 +421,10 @@ private:
     }
 
     void visit(const Div *op) {
-        op->a.accept(this);
+        bounds_of(op->a);
         Interval a = interval;
 
-        op->b.accept(this);
+        bounds_of(op->b);
         Interval b = interval;
 
         if (!b.is_bounded()) {
@@ -440,10 +474,10 @@ private:
     }
 
     void visit(const Mod *op) {
-        op->a.accept(this);
+        bounds_of(op->a);
         Interval a = interval;
 
-        op->b.accept(this);
+        bounds_of(op->b);
         if (!interval.is_bounded()) {
             // Uses interval produced by op->b which might be half bound.
             return;
@@ -480,10 +514,10 @@ private:
     }
 
     void visit(const Min *op) {
-        op->a.accept(this);
+        bounds_of(op->a);
         Interval a = interval;
 
-        op->b.accept(this);
+        bounds_of(op->b);
         Interval b = interval;
 
         if (a.is_single_point(op->a) && b.is_single_point(op->b)) {
@@ -496,10 +530,10 @@ private:
 
 
     void visit(const Max *op) {
-        op->a.accept(this);
+        bounds_of(op->a);
         Interval a = interval;
 
-        op->b.accept(this);
+        bounds_of(op->b);
         Interval b = interval;
 
         if (a.is_single_point(op->a) && b.is_single_point(op->b)) {
@@ -512,14 +546,14 @@ private:
 
     template<typename T1, typename T2>
     void visit_compare(const Expr &a_expr, const Expr &b_expr) {
-        a_expr.accept(this);
+        bounds_of(a_expr);
         if (!interval.is_bounded()) {
             bounds_of_type(Bool());
             return;
         }
         Interval a = interval;
 
-        b_expr.accept(this);
+        bounds_of(b_expr);
         if (!interval.is_bounded()) {
             bounds_of_type(Bool());
             return;
@@ -574,21 +608,21 @@ private:
     }
 
     void visit(const Select *op) {
-        op->true_value.accept(this);
+        bounds_of(op->true_value);
         if (!interval.is_bounded()) {
             // Uses interval produced by op->true_value which might be half bound.
             return;
         }
         Interval a = interval;
 
-        op->false_value.accept(this);
+        bounds_of(op->false_value);
         if (!interval.is_bounded()) {
             // Uses interval produced by op->false_value which might be half bound.
             return;
         }
         Interval b = interval;
 
-        op->condition.accept(this);
+        bounds_of(op->condition);
         Interval cond = interval;
 
         if (cond.is_single_point()) {
@@ -623,7 +657,7 @@ private:
     }
 
     void visit(const Load *op) {
-        op->index.accept(this);
+        bounds_of(op->index);
         if (!const_bound && interval.is_single_point() && is_one(op->predicate)) {
             // If the index is const and it is not a predicated load,
             // we can return the load of that index
@@ -644,11 +678,11 @@ private:
         Expr lane = op->base + var * op->stride;
         ScopedBinding<Interval> p(scope, var_name, Interval(make_const(var.type(), 0),
                                                         make_const(var.type(), op->lanes-1)));
-        lane.accept(this);
+        bounds_of(lane);
     }
 
     void visit(const Broadcast *op) {
-        op->value.accept(this);
+        bounds_of(op->value);
     }
 
     void visit(const Call *op) {
@@ -660,7 +694,7 @@ private:
         std::vector<Expr> new_args(op->args.size());
         bool const_args = true;
         for (size_t i = 0; i < op->args.size() && const_args; i++) {
-            op->args[i].accept(this);
+            bounds_of(op->args[i]);
             if (interval.is_single_point()) {
                 new_args[i] = interval.min;
             } else {
@@ -702,24 +736,35 @@ private:
         } else if (op->is_intrinsic(Call::likely) ||
                    op->is_intrinsic(Call::likely_if_innermost)) {
             assert(op->args.size() == 1);
-            op->args[0].accept(this);
+            bounds_of(op->args[0]);
+        } else if (op->is_intrinsic(Call::promise_clamped)) {
+            // Unlike a real clamp, the bounds of the value don't need
+            // to be considered, but they may still be tighter.
+            assert(op->args.size() == 3);
+            bounds_of(op->args[0]);
+            Interval value = interval;
+            bounds_of(op->args[1]);
+            Expr min = interval.min;
+            bounds_of(op->args[2]);
+            Expr max = interval.max;
+            interval = Interval::make_intersection(value, Interval(min, max));
         } else if (op->is_intrinsic(Call::return_second)) {
             assert(op->args.size() == 2);
-            op->args[1].accept(this);
+            bounds_of(op->args[1]);
         } else if (op->is_intrinsic(Call::if_then_else)) {
             assert(op->args.size() == 3);
             // Probably more conservative than necessary
             Expr equivalent_select = Select::make(op->args[0], op->args[1], op->args[2]);
-            equivalent_select.accept(this);
+            bounds_of(equivalent_select);
         } else if (op->is_intrinsic(Call::require)) {
             assert(op->args.size() == 3);
-            op->args[1].accept(this);
+            bounds_of(op->args[1]);
         } else if (op->is_intrinsic(Call::shift_left) ||
                    op->is_intrinsic(Call::shift_right) ||
                    op->is_intrinsic(Call::bitwise_and)) {
             Expr simplified = simplify(op);
             if (!equal(simplified, op)) {
-                simplified.accept(this);
+                bounds_of(simplified);
             } else {
                 // Just use the bounds of the type
                 bounds_of_type(t);
@@ -753,7 +798,7 @@ private:
                                 Call::make(Int(32), Call::buffer_get_max, op->args, Call::Extern));
         } else if (op->is_intrinsic(Call::memoize_expr)) {
             internal_assert(op->args.size() >= 1);
-            op->args[0].accept(this);
+            bounds_of(op->args[0]);
         } else if (op->call_type == Call::Halide) {
             bounds_of_func(op->name, op->value_index, op->type);
         } else {
@@ -763,7 +808,7 @@ private:
     }
 
     void visit(const Let *op) {
-        op->value.accept(this);
+        bounds_of(op->value);
         Interval val = interval;
 
         // We'll either substitute the values in directly, or pass
@@ -795,7 +840,11 @@ private:
 
         {
             ScopedBinding<Interval> p(scope, op->name, var);
-            op->body.accept(this);
+            IntervalCache body_cache;
+            IntervalCache *old_cache = cache;
+            cache = &body_cache;
+            bounds_of(op->body);
+            cache = old_cache;
         }
 
         if (interval.has_lower_bound()) {
@@ -820,12 +869,45 @@ private:
     void visit(const Shuffle *op) {
         Interval result = Interval::nothing();
         for (Expr i : op->vectors) {
-            i.accept(this);
+            bounds_of(i);
             result.include(interval);
         }
         interval = result;
     }
 
+    void visit(const VectorReduce *op) {
+        bounds_of(op->value);
+        int factor = op->value.type().lanes() / op->type.lanes();
+        switch (op->op) {
+        case VectorReduce::Add:
+            if (factor > 1) {
+                // Assume no overflow for float, int32, and int64
+                if (!op->type.is_float() && (!op->type.is_int() || op->type.bits() < 32)) {
+                    bounds_of_type(op->type);
+                    return;
+                }
+                if (interval.has_lower_bound()) {
+                    interval.min *= make_const(interval.min.type(), factor);
+                }
+                if (interval.has_upper_bound()) {
+                    interval.max *= make_const(interval.max.type(), factor);
+                }
+            }
+            break;
+        case VectorReduce::Mul:
+            if (factor > 1) {
+                bounds_of_type(op->type);
+            }
+            break;
+        case VectorReduce::Min:
+        case VectorReduce::Max:
+        case VectorReduce::And:
+        case VectorReduce::Or:
+            // The result is one of the lanes of the value.
+            break;
+        }
+    }
+
     void visit(const LetStmt *) {
         internal_error << "Bounds of statement\n";
     }
@@ -863,10 +945,13 @@ private:
     }
 };
 
-Interval bounds_of_expr_in_scope(Expr expr, const Scope<Interval> &scope, const FuncValueBounds &fb, bool const_bound) {
+namespace {
+
+Interval bounds_of_expr_in_scope(Expr expr, const Scope<Interval> &scope, const FuncValueBounds &fb,
+                                 bool const_bound, IntervalCache *cache) {
     //debug(3) << "computing bounds_of_expr_in_scope " << expr << "\n";
-    Bounds b(&scope, fb, const_bound);
-    expr.accept(&b);
+    Bounds b(&scope, fb, const_bound, cache);
+    b.bounds_of(expr);
     //debug(3) << "bounds_of_expr_in_scope " << expr << " = " << simplify(b.interval.min) << ", " << simplify(b.interval.max) << "\n";
     if (b.interval.has_lower_bound()) {
         internal_assert(b.interval.min.type().is_scalar())
@@ -881,6 +966,13 @@ Interval bounds_of_expr_in_scope(Expr expr, const Scope<Interval> &scope, const
     return b.interval;
 }
 
+}  // namespace
+
+Interval bounds_of_expr_in_scope(Expr expr, const Scope<Interval> &scope, const FuncValueBounds &fb, bool const_bound) {
+    IntervalCache cache;
+    return bounds_of_expr_in_scope(expr, scope, fb, const_bound, &cache);
+}
+
 Region region_union(const Region &a, const Region &b) {
     internal_assert(a.size() == b.size()) << "Mismatched dimensionality in region union\n";
     Region result;
@@ -1190,6 +1282,36 @@ private:
     map<string, int> vars_renaming;
     // Map variable name to all other vars which values depend on that variable.
     map<VarInstance, set<VarInstance>> children;
+    // The intervals already computed in each level of the scope. A
+    // binding invalidates the intervals computed outside of it, but
+    // they're good again once it's popped.
+    vector<IntervalCache> interval_caches = vector<IntervalCache>(1);
+
+    Interval bounds_of(const Expr &e) {
+        return bounds_of_expr_in_scope(e, scope, func_bounds, false, &interval_caches.back());
+    }
+
+    void push_scope(const string &name, const Interval &i) {
+        scope.push(name, i);
+        interval_caches.emplace_back();
+    }
+
+    void pop_scope(const string &name) {
+        interval_caches.pop_back();
+        scope.pop(name);
+    }
+
+    struct ScopedInterval {
+        BoxesTouched *self;
+        string name;
+        ScopedInterval(BoxesTouched *self, const string &name, const Interval &i) :
+            self(self), name(name) {
+            self->push_scope(name, i);
+        }
+        ~ScopedInterval() {
+            self->pop_scope(name);
+        }
+    };
 
     using IRGraphVisitor::visit;
 
@@ -1218,7 +1340,7 @@ private:
                 Box b(op->args.size());
                 b.used = const_true();
                 for (size_t i = 0; i < op->args.size(); i++) {
-                    b[i] = bounds_of_expr_in_scope(op->args[i], scope, func_bounds);
+                    b[i] = bounds_of(op->args[i]);
                 }
                 merge_boxes(boxes[op->name], b);
             }
@@ -1277,7 +1399,7 @@ private:
         if (consider_calls) {
             op->value.accept(this);
         }
-        Interval value_bounds = bounds_of_expr_in_scope(op->value, scope, func_bounds);
+        Interval value_bounds = bounds_of(op->value);
 
         bool fixed = value_bounds.min.same_as(value_bounds.max);
         value_bounds.min = simplify(value_bounds.min);
@@ -1285,14 +1407,14 @@ private:
 
         if (is_small_enough_to_substitute(value_bounds.min) &&
             (fixed || is_small_enough_to_substitute(value_bounds.max))) {
-            ScopedBinding<Interval> p(scope, op->name, value_bounds);
+            ScopedInterval p(this, op->name, value_bounds);
             op->body.accept(this);
         } else {
             string max_name = unique_name('t');
             string min_name = unique_name('t');
             {
-                ScopedBinding<Interval> p(scope, op->name, Interval(Variable::make(op->value.type(), min_name),
-                                                                Variable::make(op->value.type(), max_name)));
+                ScopedInterval p(this, op->name, Interval(Variable::make(op->value.type(), min_name),
+                                                          Variable::make(op->value.type(), max_name)));
                 op->body.accept(this);
             }
 
@@ -1385,7 +1507,7 @@ private:
     };
 
     void trim_scope_push(const string &name, const Interval &bound, vector<LetBound> &let_bounds) {
-        scope.push(name, bound);
+        push_scope(name, bound);
 
         for (const auto &v : children[get_var_instance(name)]) {
             string max_name = unique_name('t');
@@ -1417,7 +1539,7 @@ private:
                                                       expr_uses_var(box[i].max, l.min_name)))) {
                         internal_assert(let_stmts.contains(l.var));
                         const Expr &val = let_stmts.get(l.var);
-                        v_bound = bounds_of_expr_in_scope(val, scope, func_bounds);
+                        v_bound = bounds_of(val);
                         bool fixed = v_bound.min.same_as(v_bound.max);
                         v_bound.min = simplify(v_bound.min);
                         v_bound.max = fixed ? v_bound.min : simplify(v_bound.max);
@@ -1447,7 +1569,7 @@ private:
                 }
             }
         }
-        scope.pop(name);
+        pop_scope(name);
     }
 
     void visit(const IfThenElse *op) {
@@ -1498,7 +1620,7 @@ private:
                             likely_i.max = likely_if_innermost(i.max);
                         }
 
-                        Interval bi = bounds_of_expr_in_scope(b, scope, func_bounds);
+                        Interval bi = bounds_of(b);
                         if (bi.has_upper_bound()) {
                             if (lt) {
                                 i.max = min(likely_i.max, bi.max - 1);
@@ -1529,7 +1651,7 @@ private:
                             likely_i.max = likely_if_innermost(i.max);
                         }
 
-                        Interval ai = bounds_of_expr_in_scope(a, scope, func_bounds);
+                        Interval ai = bounds_of(a);
                         if (ai.has_upper_bound()) {
                             if (gt) {
                                 i.max = min(likely_i.max, ai.max - 1);
@@ -1616,20 +1738,20 @@ private:
         if (scope.contains(op->name + ".loop_min")) {
             min_val = scope.get(op->name + ".loop_min").min;
         } else {
-            min_val = bounds_of_expr_in_scope(op->min, scope, func_bounds).min;
+            min_val = bounds_of(op->min).min;
         }
 
         if (scope.contains(op->name + ".loop_max")) {
             max_val = scope.get(op->name + ".loop_max").max;
         } else {
-            max_val = bounds_of_expr_in_scope(op->extent, scope, func_bounds).max;
-            max_val += bounds_of_expr_in_scope(op->min, scope, func_bounds).max;
+            max_val = bounds_of(op->extent).max;
+            max_val += bounds_of(op->min).max;
             max_val -= 1;
         }
 
         push_var(op->name);
         {
-            ScopedBinding<Interval> p(scope, op->name, Interval(min_val, max_val));
+            ScopedInterval p(this, op->name, Interval(min_val, max_val));
             op->body.accept(this);
         }
         pop_var(op->name);
@@ -1640,7 +1762,7 @@ private:
             if (op->name == func || func.empty()) {
                 Box b(op->args.size());
                 for (size_t i = 0; i < op->args.size(); i++) {
-                    b[i] = bounds_of_expr_in_scope(op->args[i], scope, func_bounds);
+                    b[i] = bounds_of(op->args[i]);
                 }
                 merge_boxes(boxes[op->name], b);
             }
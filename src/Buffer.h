@@ -340,6 +340,7 @@ public:
     HALIDE_BUFFER_FORWARD_CONST(data)
     HALIDE_BUFFER_FORWARD_CONST(contains)
     HALIDE_BUFFER_FORWARD(crop)
+    HALIDE_BUFFER_FORWARD_CONST(cropped)
     HALIDE_BUFFER_FORWARD(slice)
     HALIDE_BUFFER_FORWARD_CONST(sliced)
     HALIDE_BUFFER_FORWARD(embed)
@@ -1,4 +1,5 @@
 #include <map>
+#include <unordered_map>
 
 #include "CSE.h"
 #include "IRMutator.h"
@@ -88,7 +89,9 @@ public:
     };
     vector<Entry> entries;
 
-    typedef map<ExprWithCompareCache, int> CacheType;
+    // The children of the Exprs in the numbering are themselves in
+    // the numbering, so they can be compared shallowly.
+    typedef std::unordered_map<Expr, int, ExprShallowHash, ExprShallowEqual> CacheType;
     CacheType numbering;
 
     map<Expr, int, ExprCompare> shallow_numbering;
@@ -96,19 +99,13 @@ public:
     Scope<int> let_substitutions;
     int number;
 
-    IRCompareCache cache;
-
-    GVN() : number(0), cache(8) {}
+    GVN() : number(0) {}
 
     Stmt mutate(const Stmt &s) override {
         internal_error << "Can't call GVN on a Stmt: " << s << "\n";
         return Stmt();
     }
 
-    ExprWithCompareCache with_cache(Expr e) {
-        return ExprWithCompareCache(e, &cache);
-    }
-
     Expr mutate(const Expr &e) override {
         // Early out if we've already seen this exact Expr.
         {
@@ -129,22 +126,13 @@ public:
             }
         }
 
-        // If e already has an entry, return that.
-        CacheType::iterator iter = numbering.find(with_cache(e));
-        if (iter != numbering.end()) {
-            number = iter->second;
-            shallow_numbering[e] = number;
-            internal_assert(entries[number].expr.type() == e.type());
-            return entries[number].expr;
-        }
-
         // Rebuild using things already in the numbering.
         Expr old_e = e;
         Expr new_e = IRMutator2::mutate(e);
 
-        // See if it's there in another form after being rebuilt
-        // (e.g. because it was a let variable).
-        iter = numbering.find(with_cache(new_e));
+        // If it has an entry once its children are in canonical form,
+        // return that.
+        CacheType::iterator iter = numbering.find(new_e);
         if (iter != numbering.end()) {
             number = iter->second;
             shallow_numbering[old_e] = number;
@@ -155,7 +143,7 @@ public:
         // Add it to the numbering.
         Entry entry = {new_e, 0};
         number = (int)entries.size();
-        numbering[with_cache(new_e)] = number;
+        numbering[new_e] = number;
         shallow_numbering[new_e] = number;
         entries.push_back(entry);
         internal_assert(new_e.type() == old_e.type());
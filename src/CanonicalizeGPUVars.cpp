@@ -37,7 +37,8 @@ class CountGPUBlocksThreads : public IRVisitor {
         if (starts_with(op->name, prefix)) {
             if (op->for_type == ForType::GPUBlock) {
                 nblocks++;
-            } else if (op->for_type == ForType::GPUThread) {
+            } else if (op->for_type == ForType::GPUThread ||
+                       op->for_type == ForType::GPULane) {
                 nthreads++;
             }
         }
@@ -115,7 +116,8 @@ class CanonicalizeGPUVars : public IRMutator2 {
         Stmt body = mutate(op->body);
 
         if ((op->for_type == ForType::GPUBlock) ||
-            (op->for_type == ForType::GPUThread)) {
+            (op->for_type == ForType::GPUThread) ||
+            (op->for_type == ForType::GPULane)) {
 
             vector<string> v = split_string(op->name, ".");
             internal_assert(v.size() > 2);
@@ -133,6 +135,12 @@ class CanonicalizeGPUVars : public IRMutator2 {
             } else if (op->for_type == ForType::GPUThread) {
                 name = gpu_name(v, get_thread_name(counter.nthreads));
                 debug(5) << "Replacing " << op->name << " with GPU thread name " << name << "\n";
+            } else if (op->for_type == ForType::GPULane) {
+                user_assert(counter.nthreads == 0)
+                    << "The loop over " << op->name << " is marked as gpu_lanes, "
+                    << "so it must be the innermost loop over GPU threads.\n";
+                name = gpu_name(v, get_thread_name(0));
+                debug(5) << "Replacing " << op->name << " with GPU lane name " << name << "\n";
             }
 
             if (name != op->name) {
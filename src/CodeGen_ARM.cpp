@@ -36,6 +36,14 @@ CodeGen_ARM::CodeGen_ARM(Target target) : CodeGen_Posix(target) {
         user_assert(llvm_AArch64_enabled) << "llvm build not configured with AArch64 target enabled.\n";
     }
 
+    #if LLVM_VERSION < 120
+    // Older LLVMs can't lower fixed-width vectors to SVE
+    // instructions, which would leave us with NEON code for vectors
+    // twice or four times too wide.
+    user_assert(!has_sve())
+        << "The sve_256 and sve_512 target features require Halide to be built with LLVM 12 or later.\n";
+    #endif
+
     // Generate the cast patterns that can take vector types.  We need
     // to iterate over all 64 and 128 bit integer types relevant for
     // neon.
@@ -427,10 +435,99 @@ void CodeGen_ARM::visit(const Div *op) {
     CodeGen_Posix::visit(op);
 }
 
+namespace {
+
+void collect_addends(const Expr &e, vector<Expr> &terms) {
+    if (const Add *add = e.as<Add>()) {
+        collect_addends(add->a, terms);
+        collect_addends(add->b, terms);
+    } else {
+        terms.push_back(e);
+    }
+}
+
+}  // namespace
+
 void CodeGen_ARM::visit(const Add *op) {
+    // Sums of four or more widening products of 8-bit values (e.g. an
+    // unrolled 8-bit convolution) can be done with udot and sdot by
+    // interleaving the factors, so that each group of four adjacent
+    // lanes holds the four products for one lane of the result.
+    const int lanes = op->type.lanes();
+    if (!neon_intrinsics_disabled() &&
+        target.has_feature(Target::ARMDotProd) &&
+        (op->type.is_int() || op->type.is_uint()) &&
+        op->type.bits() == 32 &&
+        (lanes == 2 || (lanes % 4 == 0 && lanes > 0))) {
+        vector<Expr> terms;
+        collect_addends(op, terms);
+
+        // Sort the terms into unsigned and signed 8-bit products, and
+        // everything else.
+        vector<pair<Expr, Expr>> products[2];
+        vector<Expr> product_terms[2], rest;
+        for (const Expr &t : terms) {
+            const Mul *mul = t.as<Mul>();
+            bool found = false;
+            for (int is_signed = 0; mul && !found && is_signed < 2; is_signed++) {
+                Type narrow = is_signed ? Int(8, lanes) : UInt(8, lanes);
+                Expr a = lossless_cast(narrow, mul->a);
+                Expr b = lossless_cast(narrow, mul->b);
+                if (a.defined() && b.defined()) {
+                    products[is_signed].push_back({a, b});
+                    product_terms[is_signed].push_back(t);
+                    found = true;
+                }
+            }
+            if (!found) {
+                rest.push_back(t);
+            }
+        }
+
+        if (products[0].size() >= 4 || products[1].size() >= 4) {
+            // Products that don't make up a whole group of four are
+            // added normally.
+            for (int is_signed = 0; is_signed < 2; is_signed++) {
+                while (products[is_signed].size() % 4) {
+                    rest.push_back(product_terms[is_signed].back());
+                    products[is_signed].pop_back();
+                    product_terms[is_signed].pop_back();
+                }
+            }
+
+            Expr acc;
+            for (const Expr &t : rest) {
+                acc = acc.defined() ? acc + t : t;
+            }
+            value = codegen(acc.defined() ? acc : make_zero(op->type));
+
+            for (int is_signed = 0; is_signed < 2; is_signed++) {
+                const vector<pair<Expr, Expr>> &p = products[is_signed];
+                for (size_t i = 0; i < p.size(); i += 4) {
+                    Expr a = Shuffle::make_interleave({p[i].first, p[i + 1].first,
+                                                       p[i + 2].first, p[i + 3].first});
+                    Expr b = Shuffle::make_interleave({p[i].second, p[i + 1].second,
+                                                       p[i + 2].second, p[i + 3].second});
+                    value = call_dot_product(is_signed, op->type, value, codegen(a), codegen(b));
+                }
+            }
+            return;
+        }
+    }
+
     CodeGen_Posix::visit(op);
 }
 
+Value *CodeGen_ARM::call_dot_product(bool is_signed, Type dot_t, Value *acc,
+                                     Value *a, Value *b) {
+    internal_assert(dot_t.lanes() == 2 || dot_t.lanes() % 4 == 0);
+    int intrin_lanes = (dot_t.lanes() % 4 == 0) ? 4 : 2;
+    string name = (target.bits == 32 ? "llvm.arm.neon." : "llvm.aarch64.neon.");
+    name += is_signed ? "sdot" : "udot";
+    name += (intrin_lanes == 4) ? ".v4i32.v16i8" : ".v2i32.v8i8";
+    return call_intrin(llvm_type_of(dot_t), intrin_lanes, name, {acc, a, b});
+}
+
 void CodeGen_ARM::visit(const Sub *op) {
     if (neon_intrinsics_disabled()) {
         CodeGen_Posix::visit(op);
@@ -617,12 +714,17 @@ void CodeGen_ARM::visit(const Max *op) {
 }
 
 void CodeGen_ARM::visit(const Store *op) {
-    // Predicated store
-    if (!is_one(op->predicate)) {
+    // Predicated store, or atomic store
+    if (!is_one(op->predicate) || emit_atomic_stores) {
         CodeGen_Posix::visit(op);
         return;
     }
 
+    if (use_sve_gather_scatter(op->index, false)) {
+        codegen_predicated_vector_store(op);
+        return;
+    }
+
     if (neon_intrinsics_disabled()) {
         CodeGen_Posix::visit(op);
         return;
@@ -800,6 +902,11 @@ void CodeGen_ARM::visit(const Load *op) {
         return;
     }
 
+    if (use_sve_gather_scatter(op->index, false)) {
+        codegen_predicated_vector_load(op);
+        return;
+    }
+
     if (neon_intrinsics_disabled()) {
         CodeGen_Posix::visit(op);
         return;
@@ -923,7 +1030,210 @@ void CodeGen_ARM::visit(const Load *op) {
     CodeGen_Posix::visit(op);
 }
 
+void CodeGen_ARM::codegen_vector_reduce(const VectorReduce *op, const Expr &init) {
+    if (neon_intrinsics_disabled()) {
+        CodeGen_Posix::codegen_vector_reduce(op, init);
+        return;
+    }
+
+    const int factor = op->value.type().lanes() / op->type.lanes();
+    const int lanes = op->type.lanes();
+    const Type elt = op->value.type().element_of();
+
+    // udot and sdot sum groups of four products of 8-bit values into
+    // each lane of an accumulator. Use them for the first step of
+    // any reduction by a multiple of four.
+    const int quads = op->value.type().lanes() / 4;
+    if (target.has_feature(Target::ARMDotProd) &&
+        op->op == VectorReduce::Add &&
+        factor % 4 == 0 &&
+        op->type.bits() == 32 &&
+        !op->type.is_float() &&
+        (quads == 2 || quads % 4 == 0)) {
+        for (bool is_signed : {false, true}) {
+            Type narrow = is_signed ? Int(8, quads * 4) : UInt(8, quads * 4);
+            Expr a, b;
+            if (const Mul *mul = op->value.as<Mul>()) {
+                a = lossless_cast(narrow, mul->a);
+                b = lossless_cast(narrow, mul->b);
+            } else {
+                // A sum of 8-bit values is a dot product with ones.
+                a = lossless_cast(narrow, op->value);
+                b = make_one(narrow);
+            }
+            if (!a.defined() || !b.defined()) {
+                continue;
+            }
+            Type dot_t = op->type.with_lanes(quads);
+            Expr acc = (init.defined() && quads == lanes) ? init : make_zero(dot_t);
+            value = call_dot_product(is_signed, dot_t, codegen(acc), codegen(a), codegen(b));
+            if (quads != lanes) {
+                // Reduce the rest of the way.
+                string dot_name = unique_name('t');
+                sym_push(dot_name, value);
+                Expr rest = VectorReduce::make(VectorReduce::Add, Variable::make(dot_t, dot_name), lanes);
+                if (init.defined()) {
+                    rest = Add::make(init, rest);
+                }
+                value = codegen(rest);
+                sym_pop(dot_name);
+            }
+            return;
+        }
+    }
+
+    // On aarch64, a full reduction of a native vector to a scalar
+    // is a single instruction.
+    const int total_bits = elt.bits() * op->value.type().lanes();
+    if (target.bits == 64 &&
+        lanes == 1 &&
+        (elt.is_int() || elt.is_uint()) &&
+        elt.bits() <= 32 &&
+        (total_bits == 64 || total_bits == 128) &&
+        (!init.defined() || op->op == VectorReduce::Add)) {
+        const char *reduction = nullptr;
+        switch (op->op) {
+        case VectorReduce::Add:
+            reduction = "addv";
+            break;
+        case VectorReduce::Min:
+            reduction = "minv";
+            break;
+        case VectorReduce::Max:
+            reduction = "maxv";
+            break;
+        default:
+            break;
+        }
+        if (reduction) {
+            Value *vec = codegen(op->value);
+            ostringstream name;
+            name << "llvm.aarch64.neon." << (elt.is_int() ? "s" : "u") << reduction
+                 << ".i32.v" << op->value.type().lanes() << "i" << elt.bits();
+            // The result is always 32 bits wide.
+            llvm::Type *i32_t = llvm::Type::getInt32Ty(*context);
+            llvm::Function *fn = module->getFunction(name.str());
+            if (!fn) {
+                FunctionType *func_t = FunctionType::get(i32_t, {vec->getType()}, false);
+                fn = llvm::Function::Create(func_t, llvm::Function::ExternalLinkage, name.str(), module.get());
+                fn->setCallingConv(CallingConv::C);
+            }
+            CallInst *call = builder->CreateCall(fn, {vec});
+            call->setDoesNotAccessMemory();
+            call->setDoesNotThrow();
+            value = builder->CreateTrunc(call, llvm_type_of(op->type));
+            if (init.defined()) {
+                value = builder->CreateAdd(codegen(init), value);
+            }
+            return;
+        }
+    }
+
+    CodeGen_Posix::codegen_vector_reduce(op, init);
+}
+
+bool CodeGen_ARM::use_sve_gather_scatter(const Expr &index, bool predicated) const {
+    if (!has_sve() || index.type().is_scalar() || index.as<Broadcast>()) {
+        return false;
+    }
+    // Dense vectors are better done with contiguous loads and
+    // stores. So are vectors with a small constant stride, unless
+    // they are predicated, in which case the alternative is to
+    // scalarize them.
+    if (const Ramp *ramp = index.as<Ramp>()) {
+        const IntImm *stride = ramp->stride.as<IntImm>();
+        int max_stride = predicated ? 1 : 4;
+        if (stride && stride->value >= -1 && stride->value <= max_stride) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Value *CodeGen_ARM::codegen_sve_gather_scatter_pointers(const string &name, Type t, const Expr &index) {
+    // A vector of pointers, from which LLVM selects the SVE gathers
+    // and scatters with vector offsets.
+    Value *base = codegen_buffer_pointer(name, t.element_of(), ConstantInt::get(i32_t, 0));
+    Value *offsets = codegen(index);
+    offsets = builder->CreateIntCast(offsets, VectorType::get(i64_t, index.type().lanes()), true);
+    return builder->CreateInBoundsGEP(base, offsets);
+}
+
+void CodeGen_ARM::codegen_predicated_vector_load(const Load *op) {
+    if (!use_sve_gather_scatter(op->index, !is_one(op->predicate))) {
+        CodeGen_Posix::codegen_predicated_vector_load(op);
+        return;
+    }
+    Value *ptrs = codegen_sve_gather_scatter_pointers(op->name, op->type, op->index);
+    Value *mask = is_one(op->predicate) ? nullptr : codegen(op->predicate);
+    Value *zero = Constant::getNullValue(llvm_type_of(op->type));
+    Instruction *load = builder->CreateMaskedGather(ptrs, op->type.bytes(), mask, zero);
+    add_tbaa_metadata(load, op->name, op->index);
+    value = load;
+}
+
+void CodeGen_ARM::codegen_predicated_vector_store(const Store *op) {
+    if (!use_sve_gather_scatter(op->index, !is_one(op->predicate))) {
+        CodeGen_Posix::codegen_predicated_vector_store(op);
+        return;
+    }
+    Type t = op->value.type();
+    Value *val = codegen(op->value);
+    Value *ptrs = codegen_sve_gather_scatter_pointers(op->name, t, op->index);
+    Value *mask = is_one(op->predicate) ? nullptr : codegen(op->predicate);
+    Instruction *store = builder->CreateMaskedScatter(val, ptrs, t.bytes(), mask);
+    add_tbaa_metadata(store, op->name, op->index);
+}
+
 void CodeGen_ARM::visit(const Call *op) {
+    if (op->is_intrinsic("dynamic_shuffle")) {
+        // A lookup into a table of up to 256 bytes on AArch64, or 32
+        // bytes on ARMv7 (see optimize_shuffles).
+        internal_assert(op->args.size() == 4 && op->type.bits() == 8);
+        const int64_t *max_index = as_const_int(op->args[3]);
+        internal_assert(max_index && *max_index < (target.bits == 64 ? 256 : 32));
+        Value *lut = codegen(op->args[0]);
+        Value *idx = codegen(op->args[1]);
+        int lanes = op->type.lanes();
+        // The lanes of the index and result, and the size of each
+        // register of the table.
+        int width = target.bits == 64 ? 16 : 8;
+        llvm::Type *vec_t = VectorType::get(i8_t, width);
+        int table_regs = (int)(*max_index / width) + 1;
+        vector<Value *> results;
+        for (int i = 0; i < lanes; i += width) {
+            Value *idx_i = slice_vector(idx, i, width);
+            Value *result = nullptr;
+            // tbl looks up at most four registers of the table at a
+            // time. tbx leaves the lanes whose indices are out of
+            // range alone, so continue with tbx for the rest of the
+            // table, with the indices moved down.
+            for (int j = 0; j < table_regs; j += 4) {
+                int n = std::min(4, table_regs - j);
+                vector<Value *> args;
+                if (result) {
+                    args.push_back(result);
+                }
+                for (int k = 0; k < n; k++) {
+                    args.push_back(slice_vector(lut, (j + k) * width, width));
+                }
+                Value *offset = ConstantVector::getSplat(width, ConstantInt::get(i8_t, j * width));
+                args.push_back(j == 0 ? idx_i : builder->CreateSub(idx_i, offset));
+                string name;
+                if (target.bits == 64) {
+                    name = std::string("llvm.aarch64.neon.") + (result ? "tbx" : "tbl") + std::to_string(n) + ".v16i8";
+                } else {
+                    internal_assert(!result);
+                    name = "llvm.arm.neon.vtbl" + std::to_string(n);
+                }
+                result = call_intrin(vec_t, width, name, args);
+            }
+            results.push_back(result);
+        }
+        value = slice_vector(concat_vectors(results), 0, lanes);
+        return;
+    }
+
     if (op->is_intrinsic(Call::abs) && op->type.is_uint()) {
         internal_assert(op->args.size() == 1);
         // If the arg is a subtract with narrowable args, we can use vabdl.
@@ -972,19 +1282,27 @@ string CodeGen_ARM::mcpu() const {
 }
 
 string CodeGen_ARM::mattrs() const {
+    string dot_prod = target.has_feature(Target::ARMDotProd) ? ",+dotprod" : "";
+    // The dot product instructions and SVE are ARMv8.2-a, and every
+    // core that has them also does arithmetic on float16 natively.
+    if (target.has_feature(Target::ARMDotProd) || has_sve()) {
+        dot_prod += ",+fullfp16";
+    }
     if (target.bits == 32) {
         if (target.has_feature(Target::ARMv7s)) {
-            return "+neon";
+            return "+neon" + dot_prod;
         } if (!target.has_feature(Target::NoNEON)) {
-            return "+neon";
+            return "+neon" + dot_prod;
         } else {
             return "-neon";
         }
     } else {
+        string sve = has_sve() ? ",+sve" : "";
         if (target.os == Target::IOS || target.os == Target::OSX) {
-            return "+reserve-x18";
+            return "+reserve-x18" + dot_prod + sve;
         } else {
-            return "";
+            string attrs = dot_prod + sve;
+            return attrs.empty() ? "" : attrs.substr(1);
         }
     }
 }
@@ -999,6 +1317,11 @@ bool CodeGen_ARM::use_soft_float_abi() const {
 }
 
 int CodeGen_ARM::native_vector_bits() const {
+    if (has_sve() && target.has_feature(Target::SVE_512)) {
+        return 512;
+    } else if (has_sve()) {
+        return 256;
+    }
     return 128;
 }
 
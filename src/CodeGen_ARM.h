@@ -36,6 +36,26 @@ protected:
     void visit(const Call *);
     // @}
 
+    /** Use dot product and across-vector instructions for
+     * horizontal reductions. */
+    void codegen_vector_reduce(const VectorReduce *, const Expr &init) override;
+
+    /** Add the dot products of each group of four adjacent 8-bit
+     * lanes of a and b to the 32-bit lanes of acc, using udot or
+     * sdot. dot_t must have 2 or a multiple of 4 lanes. */
+    llvm::Value *call_dot_product(bool is_signed, Type dot_t, llvm::Value *acc,
+                                  llvm::Value *a, llvm::Value *b);
+
+    /** Use SVE predicated loads and stores for vectors that aren't
+     * dense, and the native gathers and scatters for vectors that
+     * aren't strided by a small constant. */
+    // @{
+    void codegen_predicated_vector_load(const Load *) override;
+    void codegen_predicated_vector_store(const Store *) override;
+    bool use_sve_gather_scatter(const Expr &index, bool predicated) const;
+    llvm::Value *codegen_sve_gather_scatter_pointers(const std::string &name, Type t, const Expr &index);
+    // @}
+
     /** Various patterns to peephole match against */
     struct Pattern {
         std::string intrin32; ///< Name of the intrinsic for 32-bit arm
@@ -72,6 +92,11 @@ protected:
     bool neon_intrinsics_disabled() {
         return target.has_feature(Target::NoNEON);
     }
+
+    // Whether to use the scalable vector extension.
+    bool has_sve() const {
+        return target.bits == 64 && target.features_any_of({Target::SVE_256, Target::SVE_512});
+    }
 };
 
 }}
@@ -10,6 +10,7 @@
 #include "Lerp.h"
 #include "Simplify.h"
 #include "Deinterleave.h"
+#include "IRMutator.h"
 
 namespace Halide {
 namespace Internal {
@@ -187,6 +188,11 @@ public:
         IRGraphVisitor::visit(op);
     }
 
+    // Vector reductions are emitted as shuffles of narrower vectors.
+    void visit(const VectorReduce *op) {
+        include(lower_vector_reduce(op));
+    }
+
     void visit(const For *op) {
         for_types_used.insert(op->for_type);
         IRGraphVisitor::visit(op);
@@ -194,7 +200,8 @@ public:
 };
 
 CodeGen_C::CodeGen_C(ostream &s, Target t, OutputKind output_kind, const std::string &guard) :
-    IRPrinter(s), id("$$ BAD ID $$"), target(t), output_kind(output_kind), extern_c_open(false) {
+    IRPrinter(s), id("$$ BAD ID $$"), target(t), output_kind(output_kind), extern_c_open(false),
+    emit_atomic_stores(false) {
 
     if (is_header()) {
         // If it's a header, emit an include guard.
@@ -305,7 +312,12 @@ string type_to_c_type(Type type, bool include_space, bool c_plus_plus = true) {
     bool needs_space = true;
     ostringstream oss;
 
-    if (type.is_float()) {
+    if (type.is_bfloat()) {
+        // C has no bfloat type, so they are passed around as their
+        // bits (see EmulateBFloat16Math).
+        user_assert(type.is_scalar()) << "Can't represent a vector of bfloats in C: " << type << "\n";
+        oss << "uint16_t";
+    } else if (type.is_float()) {
         if (type.bits() == 32) {
             oss << "float";
         } else if (type.bits() == 64) {
@@ -471,7 +483,8 @@ public:
     }
 
     // gather
-    static Vec load(const void *base, const CppVector<int32_t, Lanes> &offset) {
+    template <typename OffsetVec>
+    static Vec load(const void *base, const OffsetVec &offset) {
         Vec r(empty);
         for (size_t i = 0; i < Lanes; i++) {
             r.elements[i] = ((const ElementType*)base)[offset[i]];
@@ -484,7 +497,8 @@ public:
     }
 
     // scatter
-    void store(void *base, const CppVector<int32_t, Lanes> &offset) const {
+    template <typename OffsetVec>
+    void store(void *base, const OffsetVec &offset) const {
         for (size_t i = 0; i < Lanes; i++) {
             ((ElementType*)base)[offset[i]] = elements[i];
         }
@@ -501,11 +515,11 @@ public:
         return r;
     }
 
-    template<size_t InputLanes>
-    static Vec concat(size_t count, const CppVector<ElementType, InputLanes> vecs[]) {
+    template <typename InputVec>
+    static Vec concat(size_t count, const InputVec vecs[]) {
         Vec r(empty);
         for (size_t i = 0; i < Lanes; i++) {
-            r.elements[i] = vecs[i / InputLanes][i % InputLanes];
+            r.elements[i] = vecs[i / InputVec::Lanes][i % InputVec::Lanes];
         }
         return r;
     }
@@ -869,7 +883,8 @@ public:
 
     // gather
     // TODO: could this be improved by taking advantage of native operator support?
-    static Vec load(const void *base, const NativeVector<int32_t, Lanes> &offset) {
+    template <typename OffsetVec>
+    static Vec load(const void *base, const OffsetVec &offset) {
         Vec r(empty);
         for (size_t i = 0; i < Lanes; i++) {
             r.native_vector[i] = ((const ElementType*)base)[offset[i]];
@@ -884,7 +899,8 @@ public:
 
     // scatter
     // TODO: could this be improved by taking advantage of native operator support?
-    void store(void *base, const NativeVector<int32_t, Lanes> &offset) const {
+    template <typename OffsetVec>
+    void store(void *base, const OffsetVec &offset) const {
         for (size_t i = 0; i < Lanes; i++) {
             ((ElementType*)base)[offset[i]] = native_vector[i];
         }
@@ -903,11 +919,11 @@ public:
     }
 
     // TODO: this should be improved by taking advantage of native operator support.
-    template<size_t InputLanes>
-    static Vec concat(size_t count, const NativeVector<ElementType, InputLanes> vecs[]) {
+    template <typename InputVec>
+    static Vec concat(size_t count, const InputVec vecs[]) {
         Vec r(empty);
         for (size_t i = 0; i < Lanes; i++) {
-            r.native_vector[i] = vecs[i / InputLanes][i % InputLanes];
+            r.native_vector[i] = vecs[i / InputVec::Lanes][i % InputVec::Lanes];
         }
         return r;
     }
@@ -1088,7 +1104,7 @@ public:
 #else
         Vec r(empty);
         for (size_t i = 0; i < Lanes; i++) {
-            r.native_vector[i] = static_cast<typename Vec::ElementType>(src.native_vector[i]);
+            r.native_vector[i] = static_cast<typename Vec::ElementType>(src[i]);
         }
         return r;
 #endif
@@ -1129,6 +1145,877 @@ private:
 };
 #endif  // __has_attribute(ext_vector_type) || __has_attribute(vector_size)
 
+)INLINE_CODE";
+
+        const char *simd_ops_decl = R"INLINE_CODE(
+#if HALIDE_CPP_ALWAYS_USE_CPP_VECTORS
+    #define halide_cpp_simd_vector_bytes 0
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #if defined(__SSE4_1__) || defined(__AVX__)
+        #include <smmintrin.h>
+        #define HALIDE_CPP_SIMD_SSE41 1
+    #endif
+    #if defined(__AVX2__)
+        #include <immintrin.h>
+    #endif
+    #define HALIDE_CPP_SIMD_SSE2 1
+    #define halide_cpp_simd_vector_bytes 16
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define HALIDE_CPP_SIMD_NEON 1
+    #define halide_cpp_simd_vector_bytes 16
+#else
+    #define halide_cpp_simd_vector_bytes 0
+#endif
+
+#if halide_cpp_simd_vector_bytes
+    #define halide_cpp_use_simd_vector(bytes) ((bytes) % halide_cpp_simd_vector_bytes == 0)
+#else
+    #define halide_cpp_use_simd_vector(bytes) (0)
+#endif
+
+#if halide_cpp_simd_vector_bytes
+
+// Maps an element type and lane count to the vector type chosen for
+// it below. SimdVectors use it to find their mask type.
+template <typename ElementType, size_t Lanes>
+struct halide_cpp_vector_of;
+
+// Registers are named by structs with a 'type' member, because some
+// compilers warn about using SIMD types as template arguments.
+struct halide_cpp_simd_register {
+    typedef halide_cpp_simd_register type;
+    uint8_t bytes[halide_cpp_simd_vector_bytes];
+};
+
+// The operations on one SIMD register of SimdVector, done one element
+// at a time. The specializations below replace these with intrinsics
+// where there are some. Masks are arrays of one byte per lane, which
+// is how the mask vector types store them.
+template <typename ElementType, typename RegisterName>
+struct halide_cpp_simd_generic_ops {
+    typedef typename RegisterName::type Register;
+    static const size_t Lanes = sizeof(Register) / sizeof(ElementType);
+    struct Elements {
+        ElementType e[sizeof(Register) / sizeof(ElementType)];
+    };
+
+    static Elements elements(const Register &r) {
+        Elements x;
+        memcpy(&x, &r, sizeof(r));
+        return x;
+    }
+
+    static Register reg(const Elements &x) {
+        Register r;
+        memcpy(&r, &x, sizeof(r));
+        return r;
+    }
+
+    static Register broadcast(const ElementType &v) {
+        Elements x;
+        for (size_t i = 0; i < Lanes; i++) {
+            x.e[i] = v;
+        }
+        return reg(x);
+    }
+
+#define HALIDE_CPP_SIMD_GENERIC_BINOP(name, op)                  \
+    static Register name(const Register &a, const Register &b) { \
+        Elements x = elements(a), y = elements(b);               \
+        for (size_t i = 0; i < Lanes; i++) {                     \
+            x.e[i] = x.e[i] op y.e[i];                           \
+        }                                                        \
+        return reg(x);                                           \
+    }
+    HALIDE_CPP_SIMD_GENERIC_BINOP(add, +)
+    HALIDE_CPP_SIMD_GENERIC_BINOP(sub, -)
+    HALIDE_CPP_SIMD_GENERIC_BINOP(mul, *)
+    HALIDE_CPP_SIMD_GENERIC_BINOP(div, /)
+    HALIDE_CPP_SIMD_GENERIC_BINOP(mod, %)
+    HALIDE_CPP_SIMD_GENERIC_BINOP(shl, <<)
+    HALIDE_CPP_SIMD_GENERIC_BINOP(shr, >>)
+    HALIDE_CPP_SIMD_GENERIC_BINOP(and_, &)
+    HALIDE_CPP_SIMD_GENERIC_BINOP(or_, |)
+    HALIDE_CPP_SIMD_GENERIC_BINOP(xor_, ^)
+#undef HALIDE_CPP_SIMD_GENERIC_BINOP
+
+    static Register not_(const Register &a) {
+        Elements x = elements(a);
+        for (size_t i = 0; i < Lanes; i++) {
+            x.e[i] = ~x.e[i];
+        }
+        return reg(x);
+    }
+
+    static Register min(const Register &a, const Register &b) {
+        Elements x = elements(a), y = elements(b);
+        for (size_t i = 0; i < Lanes; i++) {
+            x.e[i] = ::halide_cpp_min(x.e[i], y.e[i]);
+        }
+        return reg(x);
+    }
+
+    static Register max(const Register &a, const Register &b) {
+        Elements x = elements(a), y = elements(b);
+        for (size_t i = 0; i < Lanes; i++) {
+            x.e[i] = ::halide_cpp_max(x.e[i], y.e[i]);
+        }
+        return reg(x);
+    }
+
+#define HALIDE_CPP_SIMD_GENERIC_CMP(name, op)                               \
+    static void name(const Register &a, const Register &b, uint8_t *mask) { \
+        Elements x = elements(a), y = elements(b);                          \
+        for (size_t i = 0; i < Lanes; i++) {                                \
+            mask[i] = x.e[i] op y.e[i] ? 0xff : 0x00;                       \
+        }                                                                   \
+    }
+    HALIDE_CPP_SIMD_GENERIC_CMP(lt, <)
+    HALIDE_CPP_SIMD_GENERIC_CMP(le, <=)
+    HALIDE_CPP_SIMD_GENERIC_CMP(eq, ==)
+    HALIDE_CPP_SIMD_GENERIC_CMP(ne, !=)
+#undef HALIDE_CPP_SIMD_GENERIC_CMP
+
+    static Register select(const uint8_t *mask, const Register &t, const Register &f) {
+        Elements x = elements(t), y = elements(f);
+        for (size_t i = 0; i < Lanes; i++) {
+            x.e[i] = mask[i] ? x.e[i] : y.e[i];
+        }
+        return reg(x);
+    }
+};
+
+template <typename ElementType>
+struct halide_cpp_simd_ops : public halide_cpp_simd_generic_ops<ElementType, halide_cpp_simd_register> {
+    typedef halide_cpp_simd_register Register;
+};
+
+#endif  // halide_cpp_simd_vector_bytes
+)INLINE_CODE";
+
+        const char *sse2_ops_decl = R"INLINE_CODE(
+#if HALIDE_CPP_SIMD_SSE2
+
+struct halide_cpp_sse2_int_register {
+    typedef __m128i type;
+};
+
+// Convert a vector of lanes that are all ones or all zeros to one
+// byte per lane.
+inline void halide_cpp_sse2_mask_to_bytes_8(__m128i m, uint8_t *mask) {
+    _mm_storeu_si128((__m128i *)mask, m);
+}
+inline void halide_cpp_sse2_mask_to_bytes_16(__m128i m, uint8_t *mask) {
+    _mm_storel_epi64((__m128i *)mask, _mm_packs_epi16(m, m));
+}
+inline void halide_cpp_sse2_mask_to_bytes_32(__m128i m, uint8_t *mask) {
+    m = _mm_packs_epi32(m, m);
+    int32_t bytes = _mm_cvtsi128_si32(_mm_packs_epi16(m, m));
+    memcpy(mask, &bytes, sizeof(bytes));
+}
+inline void halide_cpp_sse2_mask_to_bytes_64(__m128i m, uint8_t *mask) {
+    int bits = _mm_movemask_pd(_mm_castsi128_pd(m));
+    mask[0] = (bits & 1) ? 0xff : 0x00;
+    mask[1] = (bits & 2) ? 0xff : 0x00;
+}
+
+// The reverse, for a mask of one byte per lane. The lanes that are
+// false are set, so that masks holding 1 rather than 0xff for true
+// still work.
+inline __m128i halide_cpp_sse2_false_lanes_8(const uint8_t *mask) {
+    return _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)mask), _mm_setzero_si128());
+}
+inline __m128i halide_cpp_sse2_false_lanes_16(const uint8_t *mask) {
+    __m128i m = _mm_loadl_epi64((const __m128i *)mask);
+    m = _mm_unpacklo_epi8(m, m);
+    return _mm_cmpeq_epi16(m, _mm_setzero_si128());
+}
+inline __m128i halide_cpp_sse2_false_lanes_32(const uint8_t *mask) {
+    int32_t bytes;
+    memcpy(&bytes, mask, sizeof(bytes));
+    __m128i m = _mm_cvtsi32_si128(bytes);
+    m = _mm_unpacklo_epi8(m, m);
+    m = _mm_unpacklo_epi16(m, m);
+    return _mm_cmpeq_epi32(m, _mm_setzero_si128());
+}
+inline __m128i halide_cpp_sse2_false_lanes_64(const uint8_t *mask) {
+    int lo = mask[0] ? 0 : -1, hi = mask[1] ? 0 : -1;
+    return _mm_set_epi32(hi, hi, lo, lo);
+}
+
+inline __m128i halide_cpp_sse2_blend(__m128i m, __m128i t, __m128i f) {
+    return _mm_or_si128(_mm_and_si128(m, t), _mm_andnot_si128(m, f));
+}
+
+// The operations shared by all integer types. SET1 is the suffix of
+// the broadcast intrinsic, which differs from the others for 64 bits.
+#define HALIDE_CPP_SSE2_INT_OPS(T, BITS, SUFFIX, SET1, SET1_T)                          \
+    static Register broadcast(const T &v) {                                             \
+        return _mm_set1_##SET1((SET1_T)v);                                              \
+    }                                                                                   \
+    static Register add(const Register &a, const Register &b) {                         \
+        return _mm_add_##SUFFIX(a, b);                                                  \
+    }                                                                                   \
+    static Register sub(const Register &a, const Register &b) {                         \
+        return _mm_sub_##SUFFIX(a, b);                                                  \
+    }                                                                                   \
+    static Register and_(const Register &a, const Register &b) {                        \
+        return _mm_and_si128(a, b);                                                     \
+    }                                                                                   \
+    static Register or_(const Register &a, const Register &b) {                         \
+        return _mm_or_si128(a, b);                                                      \
+    }                                                                                   \
+    static Register xor_(const Register &a, const Register &b) {                        \
+        return _mm_xor_si128(a, b);                                                     \
+    }                                                                                   \
+    static Register not_(const Register &a) {                                           \
+        return _mm_xor_si128(a, _mm_set1_epi32(-1));                                    \
+    }                                                                                   \
+    static Register select(const uint8_t *mask, const Register &t, const Register &f) { \
+        return halide_cpp_sse2_blend(halide_cpp_sse2_false_lanes_##BITS(mask), f, t);   \
+    }
+
+// Comparisons for the integer types SSE2 can compare. Unsigned values
+// are compared by flipping their sign bits (BIAS) first.
+#define HALIDE_CPP_SSE2_INT_CMP_OPS(BITS, SUFFIX, SET1_T, BIAS)                     \
+    static Register biased(const Register &a) {                                     \
+        return _mm_xor_si128(a, _mm_set1_##SUFFIX((SET1_T)(BIAS)));                 \
+    }                                                                               \
+    static Register lt_lanes(const Register &a, const Register &b) {                \
+        return _mm_cmpgt_##SUFFIX(biased(b), biased(a));                            \
+    }                                                                               \
+    static void lt(const Register &a, const Register &b, uint8_t *mask) {           \
+        halide_cpp_sse2_mask_to_bytes_##BITS(lt_lanes(a, b), mask);                 \
+    }                                                                               \
+    static void le(const Register &a, const Register &b, uint8_t *mask) {           \
+        halide_cpp_sse2_mask_to_bytes_##BITS(not_(lt_lanes(b, a)), mask);           \
+    }                                                                               \
+    static void eq(const Register &a, const Register &b, uint8_t *mask) {           \
+        halide_cpp_sse2_mask_to_bytes_##BITS(_mm_cmpeq_##SUFFIX(a, b), mask);       \
+    }                                                                               \
+    static void ne(const Register &a, const Register &b, uint8_t *mask) {           \
+        halide_cpp_sse2_mask_to_bytes_##BITS(not_(_mm_cmpeq_##SUFFIX(a, b)), mask); \
+    }
+
+// Min and max from the comparisons, for types without instructions
+// for them.
+#define HALIDE_CPP_SSE2_INT_MIN_MAX_FROM_CMP                    \
+    static Register min(const Register &a, const Register &b) { \
+        return halide_cpp_sse2_blend(lt_lanes(a, b), a, b);     \
+    }                                                           \
+    static Register max(const Register &a, const Register &b) { \
+        return halide_cpp_sse2_blend(lt_lanes(b, a), a, b);     \
+    }
+
+template <>
+struct halide_cpp_simd_ops<uint8_t> : public halide_cpp_simd_generic_ops<uint8_t, halide_cpp_sse2_int_register> {
+    HALIDE_CPP_SSE2_INT_OPS(uint8_t, 8, epi8, epi8, char)
+    HALIDE_CPP_SSE2_INT_CMP_OPS(8, epi8, char, 0x80)
+    static Register min(const Register &a, const Register &b) {
+        return _mm_min_epu8(a, b);
+    }
+    static Register max(const Register &a, const Register &b) {
+        return _mm_max_epu8(a, b);
+    }
+};
+
+template <>
+struct halide_cpp_simd_ops<int8_t> : public halide_cpp_simd_generic_ops<int8_t, halide_cpp_sse2_int_register> {
+    HALIDE_CPP_SSE2_INT_OPS(int8_t, 8, epi8, epi8, char)
+    HALIDE_CPP_SSE2_INT_CMP_OPS(8, epi8, char, 0)
+#if HALIDE_CPP_SIMD_SSE41
+    static Register min(const Register &a, const Register &b) {
+        return _mm_min_epi8(a, b);
+    }
+    static Register max(const Register &a, const Register &b) {
+        return _mm_max_epi8(a, b);
+    }
+#else
+    HALIDE_CPP_SSE2_INT_MIN_MAX_FROM_CMP
+#endif
+};
+
+template <>
+struct halide_cpp_simd_ops<uint16_t> : public halide_cpp_simd_generic_ops<uint16_t, halide_cpp_sse2_int_register> {
+    HALIDE_CPP_SSE2_INT_OPS(uint16_t, 16, epi16, epi16, short)
+    HALIDE_CPP_SSE2_INT_CMP_OPS(16, epi16, short, 0x8000)
+    static Register mul(const Register &a, const Register &b) {
+        return _mm_mullo_epi16(a, b);
+    }
+#if HALIDE_CPP_SIMD_SSE41
+    static Register min(const Register &a, const Register &b) {
+        return _mm_min_epu16(a, b);
+    }
+    static Register max(const Register &a, const Register &b) {
+        return _mm_max_epu16(a, b);
+    }
+#else
+    HALIDE_CPP_SSE2_INT_MIN_MAX_FROM_CMP
+#endif
+};
+
+template <>
+struct halide_cpp_simd_ops<int16_t> : public halide_cpp_simd_generic_ops<int16_t, halide_cpp_sse2_int_register> {
+    HALIDE_CPP_SSE2_INT_OPS(int16_t, 16, epi16, epi16, short)
+    HALIDE_CPP_SSE2_INT_CMP_OPS(16, epi16, short, 0)
+    static Register mul(const Register &a, const Register &b) {
+        return _mm_mullo_epi16(a, b);
+    }
+    static Register min(const Register &a, const Register &b) {
+        return _mm_min_epi16(a, b);
+    }
+    static Register max(const Register &a, const Register &b) {
+        return _mm_max_epi16(a, b);
+    }
+};
+
+template <>
+struct halide_cpp_simd_ops<uint32_t> : public halide_cpp_simd_generic_ops<uint32_t, halide_cpp_sse2_int_register> {
+    HALIDE_CPP_SSE2_INT_OPS(uint32_t, 32, epi32, epi32, int)
+    HALIDE_CPP_SSE2_INT_CMP_OPS(32, epi32, int, 0x80000000)
+#if HALIDE_CPP_SIMD_SSE41
+    static Register mul(const Register &a, const Register &b) {
+        return _mm_mullo_epi32(a, b);
+    }
+    static Register min(const Register &a, const Register &b) {
+        return _mm_min_epu32(a, b);
+    }
+    static Register max(const Register &a, const Register &b) {
+        return _mm_max_epu32(a, b);
+    }
+#else
+    HALIDE_CPP_SSE2_INT_MIN_MAX_FROM_CMP
+#endif
+#if defined(__AVX2__)
+    static Register shl(const Register &a, const Register &b) {
+        return _mm_sllv_epi32(a, b);
+    }
+    static Register shr(const Register &a, const Register &b) {
+        return _mm_srlv_epi32(a, b);
+    }
+#endif
+};
+
+template <>
+struct halide_cpp_simd_ops<int32_t> : public halide_cpp_simd_generic_ops<int32_t, halide_cpp_sse2_int_register> {
+    HALIDE_CPP_SSE2_INT_OPS(int32_t, 32, epi32, epi32, int)
+    HALIDE_CPP_SSE2_INT_CMP_OPS(32, epi32, int, 0)
+#if HALIDE_CPP_SIMD_SSE41
+    static Register mul(const Register &a, const Register &b) {
+        return _mm_mullo_epi32(a, b);
+    }
+    static Register min(const Register &a, const Register &b) {
+        return _mm_min_epi32(a, b);
+    }
+    static Register max(const Register &a, const Register &b) {
+        return _mm_max_epi32(a, b);
+    }
+#else
+    HALIDE_CPP_SSE2_INT_MIN_MAX_FROM_CMP
+#endif
+#if defined(__AVX2__)
+    static Register shl(const Register &a, const Register &b) {
+        return _mm_sllv_epi32(a, b);
+    }
+    static Register shr(const Register &a, const Register &b) {
+        return _mm_srav_epi32(a, b);
+    }
+#endif
+};
+
+template <>
+struct halide_cpp_simd_ops<uint64_t> : public halide_cpp_simd_generic_ops<uint64_t, halide_cpp_sse2_int_register> {
+    HALIDE_CPP_SSE2_INT_OPS(uint64_t, 64, epi64, epi64x, long long)
+#if defined(__AVX2__)
+    static Register shl(const Register &a, const Register &b) {
+        return _mm_sllv_epi64(a, b);
+    }
+    static Register shr(const Register &a, const Register &b) {
+        return _mm_srlv_epi64(a, b);
+    }
+#endif
+};
+
+template <>
+struct halide_cpp_simd_ops<int64_t> : public halide_cpp_simd_generic_ops<int64_t, halide_cpp_sse2_int_register> {
+    HALIDE_CPP_SSE2_INT_OPS(int64_t, 64, epi64, epi64x, long long)
+};
+
+#undef HALIDE_CPP_SSE2_INT_OPS
+#undef HALIDE_CPP_SSE2_INT_CMP_OPS
+#undef HALIDE_CPP_SSE2_INT_MIN_MAX_FROM_CMP
+
+#endif  // HALIDE_CPP_SIMD_SSE2
+)INLINE_CODE";
+
+        const char *sse2_float_ops_decl = R"INLINE_CODE(
+#if HALIDE_CPP_SIMD_SSE2
+
+struct halide_cpp_sse2_float_register {
+    typedef __m128 type;
+};
+
+struct halide_cpp_sse2_double_register {
+    typedef __m128d type;
+};
+
+// _mm_min_ps(a, b) and _mm_max_ps(a, b) are (a < b ? a : b) and
+// (a > b ? a : b), which matches halide_cpp_min and halide_cpp_max,
+// including for NaNs.
+#define HALIDE_CPP_SSE2_FLOAT_OPS(T, BITS, SUFFIX, TO_INT, FROM_INT)                    \
+    static Register broadcast(const T &v) {                                             \
+        return _mm_set1_##SUFFIX(v);                                                    \
+    }                                                                                   \
+    static Register add(const Register &a, const Register &b) {                         \
+        return _mm_add_##SUFFIX(a, b);                                                  \
+    }                                                                                   \
+    static Register sub(const Register &a, const Register &b) {                         \
+        return _mm_sub_##SUFFIX(a, b);                                                  \
+    }                                                                                   \
+    static Register mul(const Register &a, const Register &b) {                         \
+        return _mm_mul_##SUFFIX(a, b);                                                  \
+    }                                                                                   \
+    static Register div(const Register &a, const Register &b) {                         \
+        return _mm_div_##SUFFIX(a, b);                                                  \
+    }                                                                                   \
+    static Register min(const Register &a, const Register &b) {                         \
+        return _mm_min_##SUFFIX(a, b);                                                  \
+    }                                                                                   \
+    static Register max(const Register &a, const Register &b) {                         \
+        return _mm_max_##SUFFIX(a, b);                                                  \
+    }                                                                                   \
+    static void lt(const Register &a, const Register &b, uint8_t *mask) {               \
+        halide_cpp_sse2_mask_to_bytes_##BITS(TO_INT(_mm_cmplt_##SUFFIX(a, b)), mask);   \
+    }                                                                                   \
+    static void le(const Register &a, const Register &b, uint8_t *mask) {               \
+        halide_cpp_sse2_mask_to_bytes_##BITS(TO_INT(_mm_cmple_##SUFFIX(a, b)), mask);   \
+    }                                                                                   \
+    static void eq(const Register &a, const Register &b, uint8_t *mask) {               \
+        halide_cpp_sse2_mask_to_bytes_##BITS(TO_INT(_mm_cmpeq_##SUFFIX(a, b)), mask);   \
+    }                                                                                   \
+    static void ne(const Register &a, const Register &b, uint8_t *mask) {               \
+        halide_cpp_sse2_mask_to_bytes_##BITS(TO_INT(_mm_cmpneq_##SUFFIX(a, b)), mask);  \
+    }                                                                                   \
+    static Register select(const uint8_t *mask, const Register &t, const Register &f) { \
+        return FROM_INT(halide_cpp_sse2_blend(halide_cpp_sse2_false_lanes_##BITS(mask), \
+                                              TO_INT(f), TO_INT(t)));                   \
+    }
+
+template <>
+struct halide_cpp_simd_ops<float> : public halide_cpp_simd_generic_ops<float, halide_cpp_sse2_float_register> {
+    HALIDE_CPP_SSE2_FLOAT_OPS(float, 32, ps, _mm_castps_si128, _mm_castsi128_ps)
+};
+
+template <>
+struct halide_cpp_simd_ops<double> : public halide_cpp_simd_generic_ops<double, halide_cpp_sse2_double_register> {
+    HALIDE_CPP_SSE2_FLOAT_OPS(double, 64, pd, _mm_castpd_si128, _mm_castsi128_pd)
+};
+
+#undef HALIDE_CPP_SSE2_FLOAT_OPS
+
+#endif  // HALIDE_CPP_SIMD_SSE2
+)INLINE_CODE";
+
+        const char *neon_ops_decl = R"INLINE_CODE(
+#if HALIDE_CPP_SIMD_NEON
+
+#define HALIDE_CPP_NEON_REGISTER(R) \
+    struct halide_cpp_neon_##R {    \
+        typedef R type;             \
+    };
+HALIDE_CPP_NEON_REGISTER(uint8x16_t)
+HALIDE_CPP_NEON_REGISTER(int8x16_t)
+HALIDE_CPP_NEON_REGISTER(uint16x8_t)
+HALIDE_CPP_NEON_REGISTER(int16x8_t)
+HALIDE_CPP_NEON_REGISTER(uint32x4_t)
+HALIDE_CPP_NEON_REGISTER(int32x4_t)
+HALIDE_CPP_NEON_REGISTER(float32x4_t)
+#undef HALIDE_CPP_NEON_REGISTER
+
+// Convert a vector of lanes that are all ones or all zeros to one
+// byte per lane.
+inline void halide_cpp_neon_mask_to_bytes_8(uint8x16_t m, uint8_t *mask) {
+    vst1q_u8(mask, m);
+}
+inline void halide_cpp_neon_mask_to_bytes_16(uint16x8_t m, uint8_t *mask) {
+    vst1_u8(mask, vmovn_u16(m));
+}
+inline void halide_cpp_neon_mask_to_bytes_32(uint32x4_t m, uint8_t *mask) {
+    uint16x4_t h = vmovn_u32(m);
+    uint8_t bytes[8];
+    vst1_u8(bytes, vmovn_u16(vcombine_u16(h, h)));
+    memcpy(mask, bytes, 4);
+}
+
+// The reverse, for a mask of one byte per lane. The lanes that are
+// false are set, so that masks holding 1 rather than 0xff for true
+// still work.
+inline uint8x16_t halide_cpp_neon_false_lanes_8(const uint8_t *mask) {
+    return vceqq_u8(vld1q_u8(mask), vdupq_n_u8(0));
+}
+inline uint16x8_t halide_cpp_neon_false_lanes_16(const uint8_t *mask) {
+    return vceqq_u16(vmovl_u8(vld1_u8(mask)), vdupq_n_u16(0));
+}
+inline uint32x4_t halide_cpp_neon_false_lanes_32(const uint8_t *mask) {
+    uint8_t bytes[8] = {0};
+    memcpy(bytes, mask, 4);
+    uint16x4_t h = vget_low_u16(vmovl_u8(vld1_u8(bytes)));
+    return vceqq_u32(vmovl_u16(h), vdupq_n_u32(0));
+}
+
+// The operations shared by the 8-, 16- and 32-bit types. S is the
+// intrinsic suffix of the type, and U that of the unsigned type of the
+// same width, which is the type of comparison results. Min and max are
+// written as comparisons to match halide_cpp_min and halide_cpp_max.
+#define HALIDE_CPP_NEON_OPS(T, BITS, S, U)                                              \
+    static Register broadcast(const T &v) {                                             \
+        return vdupq_n_##S(v);                                                          \
+    }                                                                                   \
+    static Register add(const Register &a, const Register &b) {                         \
+        return vaddq_##S(a, b);                                                         \
+    }                                                                                   \
+    static Register sub(const Register &a, const Register &b) {                         \
+        return vsubq_##S(a, b);                                                         \
+    }                                                                                   \
+    static Register mul(const Register &a, const Register &b) {                         \
+        return vmulq_##S(a, b);                                                         \
+    }                                                                                   \
+    static Register min(const Register &a, const Register &b) {                         \
+        return vbslq_##S(vcltq_##S(a, b), a, b);                                        \
+    }                                                                                   \
+    static Register max(const Register &a, const Register &b) {                         \
+        return vbslq_##S(vcltq_##S(b, a), a, b);                                        \
+    }                                                                                   \
+    static void lt(const Register &a, const Register &b, uint8_t *mask) {               \
+        halide_cpp_neon_mask_to_bytes_##BITS(vcltq_##S(a, b), mask);                    \
+    }                                                                                   \
+    static void le(const Register &a, const Register &b, uint8_t *mask) {               \
+        halide_cpp_neon_mask_to_bytes_##BITS(vcleq_##S(a, b), mask);                    \
+    }                                                                                   \
+    static void eq(const Register &a, const Register &b, uint8_t *mask) {               \
+        halide_cpp_neon_mask_to_bytes_##BITS(vceqq_##S(a, b), mask);                    \
+    }                                                                                   \
+    static void ne(const Register &a, const Register &b, uint8_t *mask) {               \
+        halide_cpp_neon_mask_to_bytes_##BITS(vmvnq_##U(vceqq_##S(a, b)), mask);         \
+    }                                                                                   \
+    static Register select(const uint8_t *mask, const Register &t, const Register &f) { \
+        return vbslq_##S(halide_cpp_neon_false_lanes_##BITS(mask), f, t);               \
+    }
+
+// The unsigned types, for which I is the suffix of the signed type
+// of shift amounts.
+#define HALIDE_CPP_NEON_UNSIGNED_INT_OPS(S, I)                      \
+    static Register shl(const Register &a, const Register &b) {     \
+        return vshlq_##S(a, vreinterpretq_##I##_##S(b));            \
+    }                                                               \
+    static Register shr(const Register &a, const Register &b) {     \
+        return vshlq_##S(a, vnegq_##I(vreinterpretq_##I##_##S(b))); \
+    }                                                               \
+    static Register and_(const Register &a, const Register &b) {    \
+        return vandq_##S(a, b);                                     \
+    }                                                               \
+    static Register or_(const Register &a, const Register &b) {     \
+        return vorrq_##S(a, b);                                     \
+    }                                                               \
+    static Register xor_(const Register &a, const Register &b) {    \
+        return veorq_##S(a, b);                                     \
+    }                                                               \
+    static Register not_(const Register &a) {                       \
+        return vmvnq_##S(a);                                        \
+    }
+
+// vreinterpretq between a type and itself doesn't exist, so the signed
+// types get their own shifts.
+#define HALIDE_CPP_NEON_SIGNED_INT_OPS(S)                        \
+    static Register shl(const Register &a, const Register &b) {  \
+        return vshlq_##S(a, b);                                  \
+    }                                                            \
+    static Register shr(const Register &a, const Register &b) {  \
+        return vshlq_##S(a, vnegq_##S(b));                       \
+    }                                                            \
+    static Register and_(const Register &a, const Register &b) { \
+        return vandq_##S(a, b);                                  \
+    }                                                            \
+    static Register or_(const Register &a, const Register &b) {  \
+        return vorrq_##S(a, b);                                  \
+    }                                                            \
+    static Register xor_(const Register &a, const Register &b) { \
+        return veorq_##S(a, b);                                  \
+    }                                                            \
+    static Register not_(const Register &a) {                    \
+        return vmvnq_##S(a);                                     \
+    }
+
+template <>
+struct halide_cpp_simd_ops<uint8_t> : public halide_cpp_simd_generic_ops<uint8_t, halide_cpp_neon_uint8x16_t> {
+    HALIDE_CPP_NEON_OPS(uint8_t, 8, u8, u8)
+    HALIDE_CPP_NEON_UNSIGNED_INT_OPS(u8, s8)
+};
+
+template <>
+struct halide_cpp_simd_ops<int8_t> : public halide_cpp_simd_generic_ops<int8_t, halide_cpp_neon_int8x16_t> {
+    HALIDE_CPP_NEON_OPS(int8_t, 8, s8, u8)
+    HALIDE_CPP_NEON_SIGNED_INT_OPS(s8)
+};
+
+template <>
+struct halide_cpp_simd_ops<uint16_t> : public halide_cpp_simd_generic_ops<uint16_t, halide_cpp_neon_uint16x8_t> {
+    HALIDE_CPP_NEON_OPS(uint16_t, 16, u16, u16)
+    HALIDE_CPP_NEON_UNSIGNED_INT_OPS(u16, s16)
+};
+
+template <>
+struct halide_cpp_simd_ops<int16_t> : public halide_cpp_simd_generic_ops<int16_t, halide_cpp_neon_int16x8_t> {
+    HALIDE_CPP_NEON_OPS(int16_t, 16, s16, u16)
+    HALIDE_CPP_NEON_SIGNED_INT_OPS(s16)
+};
+
+template <>
+struct halide_cpp_simd_ops<uint32_t> : public halide_cpp_simd_generic_ops<uint32_t, halide_cpp_neon_uint32x4_t> {
+    HALIDE_CPP_NEON_OPS(uint32_t, 32, u32, u32)
+    HALIDE_CPP_NEON_UNSIGNED_INT_OPS(u32, s32)
+};
+
+template <>
+struct halide_cpp_simd_ops<int32_t> : public halide_cpp_simd_generic_ops<int32_t, halide_cpp_neon_int32x4_t> {
+    HALIDE_CPP_NEON_OPS(int32_t, 32, s32, u32)
+    HALIDE_CPP_NEON_SIGNED_INT_OPS(s32)
+};
+
+template <>
+struct halide_cpp_simd_ops<float> : public halide_cpp_simd_generic_ops<float, halide_cpp_neon_float32x4_t> {
+    HALIDE_CPP_NEON_OPS(float, 32, f32, u32)
+#if defined(__aarch64__)
+    static Register div(const Register &a, const Register &b) {
+        return vdivq_f32(a, b);
+    }
+#endif
+};
+
+#undef HALIDE_CPP_NEON_OPS
+#undef HALIDE_CPP_NEON_UNSIGNED_INT_OPS
+#undef HALIDE_CPP_NEON_SIGNED_INT_OPS
+
+#endif  // HALIDE_CPP_SIMD_NEON
+)INLINE_CODE";
+
+        const char *simd_vector_decl = R"INLINE_CODE(
+#if halide_cpp_simd_vector_bytes
+
+// A vector made of one or more SIMD registers, for vectors whose size
+// is a multiple of the register size. It has the same interface as
+// CppVector and NativeVector.
+template <typename ElementType_, size_t Lanes_>
+class SimdVector {
+public:
+    typedef ElementType_ ElementType;
+    static const size_t Lanes = Lanes_;
+    typedef SimdVector<ElementType, Lanes> Vec;
+    typedef typename halide_cpp_vector_of<uint8_t, Lanes>::type Mask;
+
+private:
+    typedef halide_cpp_simd_ops<ElementType> Ops;
+    typedef typename Ops::Register Register;
+    static const size_t RegisterLanes = sizeof(Register) / sizeof(ElementType);
+    static const size_t Registers = Lanes / RegisterLanes;
+
+public:
+    SimdVector &operator=(const Vec &src) {
+        for (size_t i = 0; i < Registers; i++) {
+            regs[i] = src.regs[i];
+        }
+        return *this;
+    }
+
+    /* not-explicit */ SimdVector(const Vec &src) {
+        for (size_t i = 0; i < Registers; i++) {
+            regs[i] = src.regs[i];
+        }
+    }
+
+    SimdVector() {
+        Register zero = Ops::broadcast(0);
+        for (size_t i = 0; i < Registers; i++) {
+            regs[i] = zero;
+        }
+    }
+
+    static Vec broadcast(const ElementType &v) {
+        Vec r(empty);
+        Register b = Ops::broadcast(v);
+        for (size_t i = 0; i < Registers; i++) {
+            r.regs[i] = b;
+        }
+        return r;
+    }
+
+    static Vec ramp(const ElementType &base, const ElementType &stride) {
+        ElementType e[Lanes];
+        for (size_t i = 0; i < Lanes; i++) {
+            e[i] = base + stride * i;
+        }
+        return load(e, 0);
+    }
+
+    static Vec load(const void *base, int32_t offset) {
+        Vec r(empty);
+        memcpy(&r.regs[0], ((const ElementType*)base + offset), sizeof(r.regs));
+        return r;
+    }
+
+    // gather
+    template <typename OffsetVec>
+    static Vec load(const void *base, const OffsetVec &offset) {
+        ElementType e[Lanes];
+        for (size_t i = 0; i < Lanes; i++) {
+            e[i] = ((const ElementType*)base)[offset[i]];
+        }
+        return load(e, 0);
+    }
+
+    void store(void *base, int32_t offset) const {
+        memcpy(((ElementType*)base + offset), &regs[0], sizeof(regs));
+    }
+
+    // scatter
+    template <typename OffsetVec>
+    void store(void *base, const OffsetVec &offset) const {
+        for (size_t i = 0; i < Lanes; i++) {
+            ((ElementType*)base)[offset[i]] = (*this)[i];
+        }
+    }
+
+    static Vec shuffle(const Vec &a, const int32_t indices[Lanes]) {
+        ElementType e[Lanes];
+        for (size_t i = 0; i < Lanes; i++) {
+            e[i] = indices[i] < 0 ? 0 : a[indices[i]];
+        }
+        return load(e, 0);
+    }
+
+    template <typename InputVec>
+    static Vec concat(size_t count, const InputVec vecs[]) {
+        ElementType e[Lanes];
+        for (size_t i = 0; i < Lanes; i++) {
+            e[i] = vecs[i / InputVec::Lanes][i % InputVec::Lanes];
+        }
+        return load(e, 0);
+    }
+
+    Vec replace(size_t i, const ElementType &b) const {
+        Vec r = *this;
+        memcpy((char *)&r.regs[0] + i * sizeof(ElementType), &b, sizeof(b));
+        return r;
+    }
+
+    ElementType operator[](size_t i) const {
+        ElementType e;
+        memcpy(&e, (const char *)&regs[0] + i * sizeof(ElementType), sizeof(e));
+        return e;
+    }
+
+    Vec operator~() const {
+        Vec r(empty);
+        for (size_t i = 0; i < Registers; i++) {
+            r.regs[i] = Ops::not_(regs[i]);
+        }
+        return r;
+    }
+
+#define HALIDE_CPP_SIMD_VECTOR_BINOP(op, name)                   \
+    friend Vec operator op(const Vec &a, const Vec &b) {         \
+        Vec r(empty);                                            \
+        for (size_t i = 0; i < Registers; i++) {                 \
+            r.regs[i] = Ops::name(a.regs[i], b.regs[i]);         \
+        }                                                        \
+        return r;                                                \
+    }                                                            \
+    friend Vec operator op(const Vec &a, const ElementType &b) { \
+        return a op broadcast(b);                                \
+    }                                                            \
+    friend Vec operator op(const ElementType &a, const Vec &b) { \
+        return broadcast(a) op b;                                \
+    }
+    HALIDE_CPP_SIMD_VECTOR_BINOP(+, add)
+    HALIDE_CPP_SIMD_VECTOR_BINOP(-, sub)
+    HALIDE_CPP_SIMD_VECTOR_BINOP(*, mul)
+    HALIDE_CPP_SIMD_VECTOR_BINOP(/, div)
+    HALIDE_CPP_SIMD_VECTOR_BINOP(%, mod)
+    HALIDE_CPP_SIMD_VECTOR_BINOP(<<, shl)
+    HALIDE_CPP_SIMD_VECTOR_BINOP(>>, shr)
+    HALIDE_CPP_SIMD_VECTOR_BINOP(&, and_)
+    HALIDE_CPP_SIMD_VECTOR_BINOP(|, or_)
+    HALIDE_CPP_SIMD_VECTOR_BINOP(^, xor_)
+#undef HALIDE_CPP_SIMD_VECTOR_BINOP
+
+// x and y are a and b, in the order the comparison takes them.
+#define HALIDE_CPP_SIMD_VECTOR_CMP(op, name, x, y)                     \
+    friend Mask operator op(const Vec &a, const Vec &b) {              \
+        uint8_t mask[Lanes];                                           \
+        for (size_t i = 0; i < Registers; i++) {                       \
+            Ops::name(x.regs[i], y.regs[i], mask + i * RegisterLanes); \
+        }                                                              \
+        return Mask::load(mask, 0);                                    \
+    }
+    HALIDE_CPP_SIMD_VECTOR_CMP(<, lt, a, b)
+    HALIDE_CPP_SIMD_VECTOR_CMP(<=, le, a, b)
+    HALIDE_CPP_SIMD_VECTOR_CMP(>, lt, b, a)
+    HALIDE_CPP_SIMD_VECTOR_CMP(>=, le, b, a)
+    HALIDE_CPP_SIMD_VECTOR_CMP(==, eq, a, b)
+    HALIDE_CPP_SIMD_VECTOR_CMP(!=, ne, a, b)
+#undef HALIDE_CPP_SIMD_VECTOR_CMP
+
+    static Vec select(const Mask &cond, const Vec &true_value, const Vec &false_value) {
+        uint8_t mask[Lanes];
+        cond.store(mask, 0);
+        Vec r(empty);
+        for (size_t i = 0; i < Registers; i++) {
+            r.regs[i] = Ops::select(mask + i * RegisterLanes, true_value.regs[i], false_value.regs[i]);
+        }
+        return r;
+    }
+
+    template <typename OtherVec>
+    static Vec convert_from(const OtherVec &src) {
+        #if __cplusplus >= 201103L
+        static_assert(Vec::Lanes == OtherVec::Lanes, "Lanes mismatch");
+        #endif
+        ElementType e[Lanes];
+        for (size_t i = 0; i < Lanes; i++) {
+            e[i] = static_cast<ElementType>(src[i]);
+        }
+        return load(e, 0);
+    }
+
+    static Vec max(const Vec &a, const Vec &b) {
+        Vec r(empty);
+        for (size_t i = 0; i < Registers; i++) {
+            r.regs[i] = Ops::max(a.regs[i], b.regs[i]);
+        }
+        return r;
+    }
+
+    static Vec min(const Vec &a, const Vec &b) {
+        Vec r(empty);
+        for (size_t i = 0; i < Registers; i++) {
+            r.regs[i] = Ops::min(a.regs[i], b.regs[i]);
+        }
+        return r;
+    }
+
+private:
+    template <typename, size_t> friend class SimdVector;
+
+    Register regs[Registers];
+
+    // Leave vector uninitialized for cases where we overwrite every entry
+    enum Empty { empty };
+    SimdVector(Empty) {}
+};
+
+#endif  // halide_cpp_simd_vector_bytes
 )INLINE_CODE";
 
         const char *vector_selection_decl = R"INLINE_CODE(
@@ -1152,12 +2039,34 @@ private:
 
 )INLINE_CODE";
 
-        stream << cpp_vector_decl << native_vector_decl << vector_selection_decl;
+        const bool use_simd = target.has_feature(Target::CSIMDIntrinsics);
 
-        for (const auto &t : vector_types) {
+        stream << cpp_vector_decl << native_vector_decl;
+        if (use_simd) {
+            stream << simd_ops_decl << sse2_ops_decl << sse2_float_ops_decl
+                   << neon_ops_decl << simd_vector_decl;
+        }
+        stream << vector_selection_decl;
+
+        // SimdVectors compare to a vector of uint8 with the same
+        // number of lanes, so make sure those all exist.
+        std::set<Type> types = vector_types;
+        if (use_simd) {
+            for (const auto &t : vector_types) {
+                types.insert(UInt(8, t.lanes()));
+            }
+        }
+
+        for (const auto &t : types) {
             string name = type_to_c_type(t, false, false);
             string scalar_name = type_to_c_type(t.element_of(), false, false);
-            stream << "#if halide_cpp_use_native_vector(" << scalar_name << ", " << t.lanes() << ")\n";
+            if (use_simd) {
+                stream << "#if halide_cpp_use_simd_vector(" << t.bytes() * t.lanes() << ")\n";
+                stream << "typedef SimdVector<" << scalar_name << ", " << t.lanes() << "> " << name << ";\n";
+                stream << "#elif halide_cpp_use_native_vector(" << scalar_name << ", " << t.lanes() << ")\n";
+            } else {
+                stream << "#if halide_cpp_use_native_vector(" << scalar_name << ", " << t.lanes() << ")\n";
+            }
             stream << "typedef NativeVector<" << scalar_name << ", " << t.lanes() << "> " << name << ";\n";
             // Useful for debugging which Vector implementation is being selected
             // stream << "#pragma message \"using NativeVector for " << t << "\"\n";
@@ -1167,6 +2076,17 @@ private:
             // stream << "#pragma message \"using CppVector for " << t << "\"\n";
             stream << "#endif\n";
         }
+
+        if (use_simd) {
+            stream << "#if halide_cpp_simd_vector_bytes\n";
+            for (const auto &t : types) {
+                string name = type_to_c_type(t, false, false);
+                string scalar_name = type_to_c_type(t.element_of(), false, false);
+                stream << "template<> struct halide_cpp_vector_of<" << scalar_name << ", " << t.lanes() << "> "
+                       << "{ typedef " << name << " type; };\n";
+            }
+            stream << "#endif  // halide_cpp_simd_vector_bytes\n";
+        }
     }
 }
 
@@ -1412,7 +2332,8 @@ void CodeGen_C::compile(const Module &input) {
         }
     }
     uses_gpu_for_loops = type_info.for_types_used.count(ForType::GPUBlock) ||
-                         type_info.for_types_used.count(ForType::GPUThread);
+                         type_info.for_types_used.count(ForType::GPUThread) ||
+                         type_info.for_types_used.count(ForType::GPULane);
 
     // Forward-declare all the types we need; this needs to happen before
     // we emit function prototypes, since those may need the types.
@@ -1889,6 +2810,9 @@ void CodeGen_C::visit(const FloatImm *op) {
         ostringstream oss;
         if (op->type.bits() == 64) {
             oss << "(double) ";
+        } else if (op->type.bits() == 16) {
+            // Only the GPU backends have a half type.
+            oss << "(half) ";
         }
         oss << "float_from_bits(" << u.as_uint << " /* " << u.as_float << " */)";
         print_assignment(op->type, oss.str());
@@ -1989,6 +2913,10 @@ void CodeGen_C::visit(const Call *op) {
         close_scope("if " + cond_id + " else");
 
         rhs << result_id;
+    } else if (op->is_intrinsic(Call::nontemporal)) {
+        // C has no portable way to ask for a non-temporal store.
+        internal_assert(op->args.size() == 1);
+        rhs << print_expr(op->args[0]);
     } else if (op->is_intrinsic(Call::require)) {
         internal_assert(op->args.size() == 3);
         if (op->args[0].type().is_vector()) {
@@ -2221,7 +3149,89 @@ void CodeGen_C::visit(const Load *op) {
     print_assignment(t, rhs.str());
 }
 
+namespace {
+// Replace the loads from a buffer within the value of an atomic
+// store. Stage::atomic ensures they're all of the site being stored
+// to.
+class ReplaceLoadsFrom : public IRMutator2 {
+    using IRMutator2::visit;
+
+    const string &buffer;
+    Expr replacement;
+
+    Expr visit(const Load *op) override {
+        if (op->name == buffer) {
+            return replacement;
+        }
+        return IRMutator2::visit(op);
+    }
+
+public:
+    ReplaceLoadsFrom(const string &b, Expr r) : buffer(b), replacement(r) {}
+};
+}
+
+void CodeGen_C::visit(const Atomic *op) {
+    internal_assert(!emit_atomic_stores) << "Nested atomic node for " << op->producer_name << "\n";
+    emit_atomic_stores = true;
+    op->body.accept(this);
+    emit_atomic_stores = false;
+}
+
+void CodeGen_C::visit_atomic_store(const Store *op) {
+    Type t = op->value.type();
+    internal_assert(!t.is_handle()) << "Atomic store of a handle to " << op->name << "\n";
+
+    if (t.is_vector()) {
+        // Lanes may collide, so do one at a time.
+        for (int i = 0; i < t.lanes(); i++) {
+            Stmt s = Store::make(op->name, extract_lane(op->value, i), extract_lane(op->index, i),
+                                 op->param, extract_lane(op->predicate, i));
+            s.accept(this);
+        }
+        return;
+    }
+
+    if (!is_one(op->predicate)) {
+        Stmt s = IfThenElse::make(op->predicate, Store::make(op->name, op->value, op->index,
+                                                             op->param, const_true()));
+        s.accept(this);
+        return;
+    }
+
+    // Compute the new value from the old one, and try to swap it in
+    // until no other thread got there first.
+    string type = print_type(t);
+    string id_index = print_expr(op->index);
+    string ptr_id = unique_name('_');
+    string old_id = unique_name('_');
+    do_indent();
+    stream << "// atomic store to " << print_name(op->name) << "\n";
+    open_scope();
+    do_indent();
+    stream << type << " *" << ptr_id << " = ((" << type << " *)" << print_name(op->name) << ") + " << id_index << ";\n";
+    do_indent();
+    stream << type << " " << old_id << " = *" << ptr_id << ";\n";
+    do_indent();
+    stream << "while (1)\n";
+    open_scope();
+    string id_value = print_expr(ReplaceLoadsFrom(op->name, Variable::make(t, old_id)).mutate(op->value));
+    string new_id = unique_name('_');
+    do_indent();
+    stream << type << " " << new_id << " = " << id_value << ";\n";
+    do_indent();
+    stream << "if (__atomic_compare_exchange(" << ptr_id << ", &" << old_id << ", &" << new_id
+           << ", false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;\n";
+    close_scope("");
+    close_scope("atomic store to " + print_name(op->name));
+}
+
 void CodeGen_C::visit(const Store *op) {
+    if (emit_atomic_stores) {
+        visit_atomic_store(op);
+        return;
+    }
+
     user_assert(is_one(op->predicate)) << "Predicated store is not supported by C backend.\n";
 
     Type t = op->value.type();
@@ -2369,7 +3379,17 @@ void CodeGen_C::visit(const ProducerConsumer *op) {
 }
 
 void CodeGen_C::visit(const For *op) {
-    if (op->for_type == ForType::Parallel) {
+    // Print the bounds first, so that any temporaries they need don't
+    // end up between the pragma and the loop it applies to.
+    string id_min = print_expr(op->min);
+    string id_extent = print_expr(op->extent);
+
+    if (op->for_type == ForType::Parallel && ends_with(op->name, ".__fork")) {
+        // The two halves of a fork (see AsyncProducers.cpp) may wait
+        // on each other, so they need a thread each.
+        do_indent();
+        stream << "#pragma omp parallel for num_threads(2)\n";
+    } else if (op->for_type == ForType::Parallel) {
         do_indent();
         stream << "#pragma omp parallel for\n";
     } else {
@@ -2377,9 +3397,6 @@ void CodeGen_C::visit(const For *op) {
             << "Can only emit serial or parallel for loops to C\n";
     }
 
-    string id_min = print_expr(op->min);
-    string id_extent = print_expr(op->extent);
-
     do_indent();
     stream << "for (int "
            << print_name(op->name)
@@ -2428,11 +3445,34 @@ void CodeGen_C::visit(const Allocate *op) {
     string op_name = print_name(op->name);
     string op_type = print_type(op->type, AppendSpace);
 
+    user_assert(op->memory_type != MemoryType::GPUShared)
+        << "Allocation " << op->name << " is scheduled to be stored in GPU shared memory, "
+        << "but isn't inside a GPU kernel.\n";
+    user_assert(op->memory_type != MemoryType::VTCM)
+        << "Allocation " << op->name << " is scheduled to be stored in VTCM, "
+        << "which the C backend does not support.\n";
+
+    // Registers aren't addressable, so the closest we can get is the stack.
+    bool force_stack = (op->memory_type == MemoryType::Stack ||
+                        op->memory_type == MemoryType::Register);
+    bool force_heap = (op->memory_type == MemoryType::Heap);
+
     // For sizes less than 8k, do a stack allocation
     bool on_stack = false;
     int32_t constant_size;
     string size_id;
-    if (op->new_expr.defined()) {
+    const Variable *reused = op->new_expr.as<Variable>();
+    if (reused && allocations.contains(reused->name)) {
+        // This reuses the memory of an enclosing allocation, which
+        // owns it, so like a stack allocation there's nothing to
+        // check or free.
+        Allocation alloc;
+        alloc.type = op->type;
+        allocations.push(op->name, alloc);
+        on_stack = true;
+        do_indent();
+        stream << op_type << "*" << op_name << " = " << print_name(reused->name) << ";\n";
+    } else if (op->new_expr.defined()) {
         Allocation alloc;
         alloc.type = op->type;
         allocations.push(op->name, alloc);
@@ -2448,11 +3488,15 @@ void CodeGen_C::visit(const Allocate *op) {
                            << op->name << " is constant but exceeds 2^31 - 1.\n";
             } else {
                 size_id = print_expr(Expr(static_cast<int32_t>(constant_size)));
-                if (can_allocation_fit_on_stack(stack_bytes)) {
+                if (force_stack || (!force_heap && can_allocation_fit_on_stack(stack_bytes))) {
                     on_stack = true;
                 }
             }
         } else {
+            user_assert(!force_stack)
+                << "Allocation " << op->name << " is scheduled to be stored in "
+                << op->memory_type << " memory, but its size isn't a known constant.\n";
+
             // Check that the allocation is not scalar (if it were scalar
             // it would have constant size).
             internal_assert(op->extents.size() > 0);
@@ -2577,6 +3621,10 @@ void CodeGen_C::visit(const Evaluate *op) {
     stream << "(void)" << id << ";\n";
 }
 
+void CodeGen_C::visit(const VectorReduce *op) {
+    id = print_expr(lower_vector_reduce(op));
+}
+
 void CodeGen_C::visit(const Shuffle *op) {
     internal_assert(op->vectors.size() >= 1);
     internal_assert(op->vectors[0].type().is_vector());
@@ -2628,9 +3676,9 @@ void CodeGen_C::test() {
     Stmt s = Store::make("buf", e, x, Parameter(), const_true());
     s = LetStmt::make("x", beta+1, s);
     s = Block::make(s, Free::make("tmp.stack"));
-    s = Allocate::make("tmp.stack", Int(32), {127}, const_true(), s);
+    s = Allocate::make("tmp.stack", Int(32), MemoryType::Stack, {127}, const_true(), s);
     s = Block::make(s, Free::make("tmp.heap"));
-    s = Allocate::make("tmp.heap", Int(32), {43, beta}, const_true(), s);
+    s = Allocate::make("tmp.heap", Int(32), MemoryType::Heap, {43, beta}, const_true(), s);
     Expr buf = Variable::make(Handle(), "buf.buffer");
     s = LetStmt::make("buf", Call::make(Handle(), Call::buffer_get_host, {buf}, Call::Extern), s);
 
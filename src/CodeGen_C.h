@@ -149,6 +149,14 @@ protected:
     /** True if at least one gpu-based for loop is used. */
     bool uses_gpu_for_loops;
 
+    /** True while inside an Atomic node, where stores must be done
+     * with compare-and-swap loops. */
+    bool emit_atomic_stores;
+
+    /** Emit a store that is safe against other threads updating the
+     * same site. */
+    void visit_atomic_store(const Store *);
+
     /** Track which handle types have been forward-declared already. */
     std::set<const halide_handle_cplusplus_type *> forward_declared;
 
@@ -201,6 +209,8 @@ protected:
     void visit(const Evaluate *);
     void visit(const Shuffle *);
     void visit(const Prefetch *);
+    void visit(const Atomic *);
+    void visit(const VectorReduce *);
 
     void visit_binop(Type t, Expr a, Expr b, const char *op);
 
@@ -417,7 +417,13 @@ void CodeGen_GPU_Host<CodeGen_CPU>::visit(const For *loop) {
                                     0,
                                     i));
 
-            builder->CreateStore(ConstantInt::get(i8_t, closure_args[i].is_buffer),
+            // Buffers the kernel only reads are marked with 2, so that
+            // runtimes that track the writes to buffers can skip them.
+            int is_buffer = 0;
+            if (closure_args[i].is_buffer) {
+                is_buffer = closure_args[i].write ? 1 : 2;
+            }
+            builder->CreateStore(ConstantInt::get(i8_t, is_buffer),
                                  builder->CreateConstGEP2_32(
                                     gpu_arg_is_buffer_arr_type,
                                     gpu_arg_is_buffer_arr,
@@ -1636,10 +1636,49 @@ void CodeGen_Hexagon::visit(const Cast *op) {
     CodeGen_Posix::visit(op);
 }
 
+namespace {
+
+// The name of the call appended to loop bodies that need to wait for
+// their scatters to finish before the next iteration.
+const char *scatter_release_name = "halide.hexagon.scatter_release";
+
+// Find the buffers a statement stores to at scattered vector
+// coordinates, and the buffers it loads from.
+class FindScattersAndLoads : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const Store *op) {
+        const Ramp *r = op->index.as<Ramp>();
+        if (op->index.type().is_vector() && !(r && is_one(r->stride))) {
+            scattered.insert(op->name);
+        }
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Load *op) {
+        loaded.insert(op->name);
+        IRVisitor::visit(op);
+    }
+
+public:
+    std::set<string> scattered, loaded;
+};
+
+}  // namespace
+
 void CodeGen_Hexagon::visit(const Call *op) {
     internal_assert(op->is_extern() || op->is_intrinsic())
         << "Can only codegen extern calls and intrinsics\n";
 
+    if (op->name == scatter_release_name) {
+        std::set<string> pending = pending_scatters;
+        for (const string &name : pending) {
+            scatter_release(name);
+        }
+        value = codegen(Expr(0));
+        return;
+    }
+
     // Map Halide functions to Hexagon intrinsics, plus a boolean
     // indicating if the intrinsic has signed variants or not.
     static std::map<string, std::pair<string, bool>> functions = {
@@ -1887,4 +1926,167 @@ void CodeGen_Hexagon::visit(const NE *op) {
     }
 }
 
+
+bool CodeGen_Hexagon::use_vtcm_scatter_gather(const string &name, Type t, const Expr &index, const Expr &predicate) {
+#if LLVM_VERSION >= 60
+    if (!target.features_any_of({Target::HVX_v65, Target::HVX_v66}) ||
+        !vtcm_allocations.contains(name) ||
+        !is_one(predicate)) {
+        return false;
+    }
+    if (t.bits() != 16 && t.bits() != 32) {
+        return false;
+    }
+    if (t.bits() * t.lanes() != native_vector_bits()) {
+        return false;
+    }
+    // The byte offsets of 16-bit gathers and scatters are 16 bits.
+    if (t.bits() == 16 && vtcm_allocations.get(name) > 0x10000) {
+        return false;
+    }
+    const Ramp *r = index.as<Ramp>();
+    return !(r && is_one(r->stride));
+#else
+    return false;
+#endif
+}
+
+void CodeGen_Hexagon::codegen_vtcm_operands(const string &name, Type t, const Expr &index,
+                                            Value *&base, Value *&region, Value *&offsets) {
+    base = codegen_buffer_pointer(name, t.element_of(), ConstantInt::get(i32_t, 0));
+    // The region is the allocation, not including the scratch space.
+    region = ConstantInt::get(i32_t, vtcm_allocations.get(name) - 1);
+    Type offset_type = t.bits() == 16 ? UInt(16, t.lanes()) : Int(32, t.lanes());
+    offsets = codegen(cast(offset_type, index * t.bytes()));
+}
+
+void CodeGen_Hexagon::scatter_release(const string &name) {
+    if (!pending_scatters.count(name)) {
+        return;
+    }
+    pending_scatters.erase(name);
+
+    llvm::Type *vector_ptr_t = llvm::VectorType::get(i32_t, native_vector_bits() / 32)->getPointerTo();
+    Value *base = builder->CreatePointerCast(sym_get(name), vector_ptr_t);
+    llvm::FunctionType *release_t = llvm::FunctionType::get(void_t, {vector_ptr_t}, false);
+    llvm::InlineAsm *release = llvm::InlineAsm::get(release_t, "vmem($0+#0):scatter_release", "r,~{memory}", true);
+    builder->CreateCall(release, {base});
+    // A load from the release address waits for the scatters to finish.
+    LoadInst *wait = builder->CreateAlignedLoad(base, native_vector_bits() / 8);
+    wait->setVolatile(true);
+}
+
+void CodeGen_Hexagon::visit(const Load *op) {
+    scatter_release(op->name);
+
+    if (!use_vtcm_scatter_gather(op->name, op->type, op->index, op->predicate)) {
+        CodeGen_Posix::visit(op);
+        return;
+    }
+
+#if LLVM_VERSION >= 60
+    bool is_128B = target.has_feature(Halide::Target::HVX_128);
+    Value *base, *region, *offsets;
+    codegen_vtcm_operands(op->name, op->type, op->index, base, region, offsets);
+
+    // The gather writes to the scratch vector after the allocation,
+    // which we then load the result from.
+    Value *scratch = builder->CreateInBoundsGEP(builder->CreatePointerCast(base, i8_t->getPointerTo()),
+                                                ConstantInt::get(i32_t, vtcm_allocations.get(op->name + ".scratch")));
+    Intrinsic::ID gather =
+        op->type.bits() == 16 ? IPICK(is_128B, Intrinsic::hexagon_V6_vgathermh) : IPICK(is_128B, Intrinsic::hexagon_V6_vgathermw);
+    call_intrin_cast(void_t, gather, {scratch, builder->CreatePtrToInt(base, i32_t), region, offsets});
+
+    llvm::Type *result_t = llvm_type_of(op->type);
+    LoadInst *load = builder->CreateAlignedLoad(builder->CreatePointerCast(scratch, result_t->getPointerTo()),
+                                                native_vector_bits() / 8);
+    value = load;
+#endif
+}
+
+void CodeGen_Hexagon::visit(const Store *op) {
+    if (!use_vtcm_scatter_gather(op->name, op->value.type(), op->index, op->predicate)) {
+        CodeGen_Posix::visit(op);
+        return;
+    }
+
+#if LLVM_VERSION >= 60
+    bool is_128B = target.has_feature(Halide::Target::HVX_128);
+    Value *val = codegen(op->value);
+    Value *base, *region, *offsets;
+    codegen_vtcm_operands(op->name, op->value.type(), op->index, base, region, offsets);
+
+    Intrinsic::ID scatter =
+        op->value.type().bits() == 16 ? IPICK(is_128B, Intrinsic::hexagon_V6_vscattermh) : IPICK(is_128B, Intrinsic::hexagon_V6_vscattermw);
+    call_intrin_cast(void_t, scatter, {builder->CreatePtrToInt(base, i32_t), region, offsets, val});
+    pending_scatters.insert(op->name);
+#endif
+}
+
+void CodeGen_Hexagon::visit(const Allocate *alloc) {
+    int32_t constant_elements = Allocate::constant_allocation_size(alloc->extents, alloc->name);
+    if (alloc->memory_type != MemoryType::VTCM || constant_elements <= 0 || alloc->new_expr.defined()) {
+        CodeGen_Posix::visit(alloc);
+        return;
+    }
+
+    // Add a vector of scratch space, aligned to the vector size, to
+    // the end of the allocation for gathers to write to.
+    int bytes = constant_elements * alloc->type.bytes();
+    int vector_bytes = native_vector_bits() / 8;
+    int scratch_offset = (bytes + vector_bytes - 1) / vector_bytes * vector_bytes;
+    int elements = (scratch_offset + vector_bytes + alloc->type.bytes() - 1) / alloc->type.bytes();
+
+    vtcm_allocations.push(alloc->name, bytes);
+    vtcm_allocations.push(alloc->name + ".scratch", scratch_offset);
+    CodeGen_Posix::visit(Allocate::make(alloc->name, alloc->type, alloc->memory_type, {elements},
+                                        alloc->condition, alloc->body, alloc->new_expr, alloc->free_function)
+                         .as<Allocate>());
+    vtcm_allocations.pop(alloc->name + ".scratch");
+    vtcm_allocations.pop(alloc->name);
+    pending_scatters.erase(alloc->name);
+}
+
+void CodeGen_Hexagon::visit(const For *op) {
+    if (!target.features_any_of({Target::HVX_v65, Target::HVX_v66})) {
+        CodeGen_Posix::visit(op);
+        return;
+    }
+
+    if (op->for_type == ForType::Parallel) {
+        // Other threads may read what we scattered, and may use the
+        // scratch space of allocations from outside the loop at the
+        // same time, so don't gather from or scatter to those.
+        std::set<string> pending = pending_scatters;
+        for (const string &name : pending) {
+            scatter_release(name);
+        }
+        Scope<int> outside;
+        outside.swap(vtcm_allocations);
+        CodeGen_Posix::visit(op);
+        outside.swap(vtcm_allocations);
+        return;
+    }
+
+    // If the loop body scatters to a VTCM allocation and loads from
+    // it, a later iteration may load what an earlier one scattered,
+    // so wait for the scatters at the end of each iteration.
+    FindScattersAndLoads finder;
+    op->body.accept(&finder);
+    bool needs_release = false;
+    for (const string &name : finder.scattered) {
+        if (vtcm_allocations.contains(name) && finder.loaded.count(name)) {
+            needs_release = true;
+        }
+    }
+    if (!needs_release) {
+        CodeGen_Posix::visit(op);
+        return;
+    }
+
+    Stmt release = Evaluate::make(Call::make(Int(32), scatter_release_name, {}, Call::Extern));
+    Stmt body = Block::make(op->body, release);
+    CodeGen_Posix::visit(For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body).as<For>());
+}
+
 }}
@@ -5,6 +5,8 @@
  * Defines the code-generator for producing Hexagon machine code
  */
 
+#include <set>
+
 #include "CodeGen_Posix.h"
 
 namespace Halide {
@@ -61,8 +63,33 @@ protected:
     void visit(const GT *);
     void visit(const EQ *);
     void visit(const Select *);
+    void visit(const Load *);
+    void visit(const Store *);
+    void visit(const Allocate *);
+    void visit(const For *);
     ///@}
 
+    /** The VTCM allocations in scope, and the offset in bytes of the
+     * vector of scratch space after each one, which gathers from it
+     * write to. */
+    Scope<int> vtcm_allocations;
+
+    /** VTCM allocations that have been scattered to since the last
+     * scatter release. */
+    std::set<std::string> pending_scatters;
+
+    /** Check if a vector load or store of type t at index of a buffer
+     * can use the HVX gather and scatter instructions. */
+    bool use_vtcm_scatter_gather(const std::string &name, Type t, const Expr &index, const Expr &predicate);
+
+    /** Get the address, size in bytes minus one, and byte offsets
+     * operands of a gather or scatter. */
+    void codegen_vtcm_operands(const std::string &name, Type t, const Expr &index,
+                               llvm::Value *&base, llvm::Value *&region, llvm::Value *&offsets);
+
+    /** Wait for the pending scatters to a VTCM allocation to finish. */
+    void scatter_release(const std::string &name);
+
     /** We ask for an extra vector on each allocation to enable fast
      * clamped ramp loads. */
     int allocation_padding(Type type) const {
@@ -3,6 +3,7 @@
 #include "IRMutator.h"
 #include "CSE.h"
 #include "Debug.h"
+#include "Util.h"
 
 namespace Halide {
 namespace Internal {
@@ -111,7 +112,12 @@ void unpack_closure(const Closure& closure,
 
 llvm::Type *llvm_type_of(LLVMContext *c, Halide::Type t) {
     if (t.lanes() == 1) {
-        if (t.is_float()) {
+        if (t.is_bfloat()) {
+            // There's no bfloat type in llvm. bfloats are moved
+            // around as their bits, and any arithmetic on them is
+            // done in float (see EmulateBFloat16Math).
+            return llvm::Type::getInt16Ty(*c);
+        } else if (t.is_float()) {
             switch (t.bits()) {
             case 16:
                 return llvm::Type::getHalfTy(*c);
@@ -151,6 +157,8 @@ bool function_takes_user_context(const std::string &name) {
         "halide_device_malloc",
         "halide_device_and_host_malloc",
         "halide_device_sync",
+        "halide_distributed_num_ranks",
+        "halide_distributed_rank",
         "halide_do_par_for",
         "halide_do_task",
         "halide_error",
@@ -159,8 +167,11 @@ bool function_takes_user_context(const std::string &name) {
         "halide_print",
         "halide_profiler_memory_allocate",
         "halide_profiler_memory_free",
+        "halide_profiler_memory_totals_update",
         "halide_profiler_pipeline_start",
         "halide_profiler_pipeline_end",
+        "halide_profiler_record_latency",
+        "halide_profiler_record_work",
         "halide_profiler_stack_peak_update",
         "halide_spawn_thread",
         "halide_device_release",
@@ -168,9 +179,15 @@ bool function_takes_user_context(const std::string &name) {
         "halide_trace",
         "halide_trace_helper",
         "halide_memoization_cache_lookup",
+        "halide_memoization_cache_lookup_with_hash",
         "halide_memoization_cache_store",
+        "halide_memoization_cache_store_with_priority",
         "halide_memoization_cache_release",
+        "halide_scratch_malloc",
+        "halide_scratch_free",
         "halide_cuda_run",
+        "halide_cuda_device_and_host_malloc_managed",
+        "halide_cuda_managed_prefetch",
         "halide_opencl_run",
         "halide_opengl_run",
         "halide_openglcompute_run",
@@ -270,6 +287,72 @@ Expr lower_euclidean_mod(Expr a, Expr b) {
     }
 }
 
+namespace {
+Expr vector_reduce_binop(VectorReduce::Operator op, Expr a, Expr b) {
+    switch (op) {
+    case VectorReduce::Add:
+        return Add::make(a, b);
+    case VectorReduce::Mul:
+        return Mul::make(a, b);
+    case VectorReduce::Min:
+        return Min::make(a, b);
+    case VectorReduce::Max:
+        return Max::make(a, b);
+    case VectorReduce::And:
+        return And::make(a, b);
+    case VectorReduce::Or:
+        return Or::make(a, b);
+    }
+    return Expr();
+}
+}
+
+Expr lower_vector_reduce(const VectorReduce *op, Expr init) {
+    Expr v = op->value;
+    const int output_lanes = op->type.lanes();
+    // Each step uses its input more than once, so name it.
+    vector<pair<string, Expr>> lets;
+    while (v.type().lanes() > output_lanes) {
+        if (!v.as<Variable>()) {
+            string name = unique_name('t');
+            lets.push_back({name, v});
+            v = Variable::make(v.type(), name);
+        }
+        const int lanes = v.type().lanes();
+        const int factor = lanes / output_lanes;
+        if (factor % 2 == 0) {
+            Expr a, b;
+            if (output_lanes == 1) {
+                // Fold the top half onto the bottom half, which is
+                // the pattern llvm recognizes as a horizontal
+                // reduction.
+                a = Shuffle::make_slice(v, 0, 1, lanes / 2);
+                b = Shuffle::make_slice(v, lanes / 2, 1, lanes / 2);
+            } else {
+                // Combine adjacent lanes, which keeps each group of
+                // lanes contiguous.
+                a = Shuffle::make_slice(v, 0, 2, lanes / 2);
+                b = Shuffle::make_slice(v, 1, 2, lanes / 2);
+            }
+            v = vector_reduce_binop(op->op, a, b);
+        } else {
+            // Peel off one lane of each group at a time.
+            Expr result = Shuffle::make_slice(v, 0, factor, output_lanes);
+            for (int i = 1; i < factor; i++) {
+                result = vector_reduce_binop(op->op, result, Shuffle::make_slice(v, i, factor, output_lanes));
+            }
+            v = result;
+        }
+    }
+    if (init.defined()) {
+        v = vector_reduce_binop(op->op, init, v);
+    }
+    for (size_t i = lets.size(); i > 0; i--) {
+        v = Let::make(lets[i - 1].first, lets[i - 1].second, v);
+    }
+    return v;
+}
+
 namespace {
 
 // This mutator rewrites predicated loads and stores as unpredicated
@@ -477,6 +560,84 @@ void set_function_attributes_for_target(llvm::Function *fn, Target t) {
     // inaccurate even for us.
     fn->addFnAttr("reciprocal-estimates", "none");
     #endif
+
+    if (t.has_feature(Target::SizeOptimized)) {
+        fn->addFnAttr(llvm::Attribute::OptimizeForSize);
+    }
+
+    #if LLVM_VERSION >= 120
+    // We generate fixed-width vectors. Tell LLVM the SVE vector
+    // length, so it can lower them to SVE instructions.
+    if (t.arch == Target::ARM && t.bits == 64) {
+        int vscale = 0;
+        if (t.has_feature(Target::SVE_512)) {
+            vscale = 512 / 128;
+        } else if (t.has_feature(Target::SVE_256)) {
+            vscale = 256 / 128;
+        }
+        if (vscale) {
+            fn->addFnAttr(llvm::Attribute::getWithVScaleRangeArgs(fn->getContext(), vscale, vscale));
+        }
+    }
+    #endif
+
+    #if LLVM_VERSION >= 130
+    // Likewise for the RISC-V V extension, where vscale is the
+    // vector length in units of 64 bits. We don't know the vector
+    // length, only that it's at least 128 bits, so we give LLVM a
+    // range, and the code runs correctly on any vector length.
+    if (t.arch == Target::RISCV) {
+        fn->addFnAttr(llvm::Attribute::getWithVScaleRangeArgs(fn->getContext(), 128 / 64, 65536 / 64));
+    }
+    #endif
+}
+
+int64_t count_llvm_instructions(const llvm::Module &module) {
+    int64_t count = 0;
+    for (const llvm::Function &f : module) {
+        for (const llvm::BasicBlock &b : f) {
+            count += b.size();
+        }
+    }
+    return count;
+}
+
+void write_code_size_report(const llvm::Module &module, const std::string &title,
+                            const std::vector<std::string> &function_names, std::ostream &out) {
+    std::map<std::string, int64_t> sizes;
+    int64_t runtime = 0, total = 0;
+    for (const llvm::Function &f : module) {
+        int64_t count = 0;
+        for (const llvm::BasicBlock &b : f) {
+            count += b.size();
+        }
+        if (count == 0) {
+            continue;
+        }
+        total += count;
+
+        // The closures of parallel loops are named par_for_<function
+        // they are in>_<loop>.
+        const std::string name = f.getName().str();
+        bool in_pipeline = false;
+        for (const std::string &fn : function_names) {
+            in_pipeline |= (name == fn ||
+                            (starts_with(name, "par_for_") &&
+                             name.find("par_for_" + fn + "_") != std::string::npos));
+        }
+        if (in_pipeline) {
+            sizes[name] += count;
+        } else {
+            runtime += count;
+        }
+    }
+
+    out << "Code size of " << title << ", in llvm instructions:\n";
+    for (const auto &s : sizes) {
+        out << "  " << s.first << ": " << s.second << "\n";
+    }
+    out << "  runtime: " << runtime << "\n"
+        << "  total: " << total << "\n";
 }
 
 }
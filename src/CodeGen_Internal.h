@@ -62,6 +62,12 @@ Expr lower_euclidean_div(Expr a, Expr b);
 Expr lower_euclidean_mod(Expr a, Expr b);
 ///@}
 
+/** Given a horizontal vector reduction, define it in terms of
+ * shuffles and ordinary vector operators, as a tree of pairwise
+ * reductions. If init is defined, it is combined with the result
+ * using the same operator. */
+Expr lower_vector_reduce(const VectorReduce *op, Expr init = Expr());
+
 /** Replace predicated loads/stores with unpredicated equivalents
  * inside branches. */
 Stmt unpredicate_loads_stores(Stmt s);
@@ -78,6 +84,16 @@ std::unique_ptr<llvm::TargetMachine> make_target_machine(const llvm::Module &mod
 /** Set the appropriate llvm Function attributes given a Target. */
 void set_function_attributes_for_target(llvm::Function *, Target);
 
+/** Count the instructions in an llvm::Module. */
+int64_t count_llvm_instructions(const llvm::Module &module);
+
+/** Write the number of llvm instructions in each of the given
+ * functions of an llvm::Module, with the closures of their parallel
+ * loops counted separately, and the rest of the module counted as
+ * the runtime. */
+void write_code_size_report(const llvm::Module &module, const std::string &title,
+                            const std::vector<std::string> &function_names, std::ostream &out);
+
 }}
 
 #endif
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <limits>
 #include <sstream>
@@ -12,18 +14,22 @@
 #include "Simplify.h"
 #include "JITModule.h"
 #include "CodeGen_Internal.h"
+#include "CompileTimeProfiling.h"
 #include "Lerp.h"
 #include "Util.h"
 #include "LLVM_Runtime_Linker.h"
 #include "MatlabWrapper.h"
 #include "IntegerDivisionTable.h"
 #include "CSE.h"
+#include "IRMutator.h"
 
 #include "CodeGen_X86.h"
 #include "CodeGen_GPU_Host.h"
 #include "CodeGen_ARM.h"
 #include "CodeGen_MIPS.h"
 #include "CodeGen_PowerPC.h"
+#include "CodeGen_WebAssembly.h"
+#include "CodeGen_RISCV.h"
 #include "CodeGen_Hexagon.h"
 
 #if !(__cplusplus > 199711L || _MSC_VER >= 1800)
@@ -125,6 +131,18 @@ using std::stack;
 #define InitializeHexagonAsmPrinter()   InitializeAsmPrinter(Hexagon)
 #endif
 
+#ifdef WITH_RISCV
+#define InitializeRISCVTarget()       InitializeTarget(RISCV)
+#define InitializeRISCVAsmParser()    InitializeAsmParser(RISCV)
+#define InitializeRISCVAsmPrinter()   InitializeAsmPrinter(RISCV)
+#endif
+
+#ifdef WITH_WEBASSEMBLY
+#define InitializeWebAssemblyTarget()       InitializeTarget(WebAssembly)
+#define InitializeWebAssemblyAsmParser()    InitializeAsmParser(WebAssembly)
+#define InitializeWebAssemblyAsmPrinter()   InitializeAsmPrinter(WebAssembly)
+#endif
+
 namespace {
 
 // Get the LLVM linkage corresponding to a Halide linkage type.
@@ -250,7 +268,11 @@ CodeGen_LLVM::CodeGen_LLVM(Target t) :
 
     min_f64(Float(64).min()),
     max_f64(Float(64).max()),
-    destructor_block(nullptr) {
+    emit_atomic_stores(false),
+    emitted_nontemporal_stores(false),
+    destructor_block(nullptr),
+    pgo_instrument(false),
+    pgo_branches(0) {
     initialize_llvm();
 }
 
@@ -298,6 +320,11 @@ CodeGen_LLVM *CodeGen_LLVM::new_for_target(const Target &target,
             return make_codegen<CodeGen_GPU_Host<CodeGen_PowerPC>>(target, context);
         }
 #endif
+#ifdef WITH_RISCV
+        if (target.arch == Target::RISCV) {
+            return make_codegen<CodeGen_GPU_Host<CodeGen_RISCV>>(target, context);
+        }
+#endif
 
         user_error << "Invalid target architecture for GPU backend: "
                    << target.to_string() << "\n";
@@ -313,6 +340,10 @@ CodeGen_LLVM *CodeGen_LLVM::new_for_target(const Target &target,
         return make_codegen<CodeGen_PowerPC>(target, context);
     } else if (target.arch == Target::Hexagon) {
         return make_codegen<CodeGen_Hexagon>(target, context);
+    } else if (target.arch == Target::WebAssembly) {
+        return make_codegen<CodeGen_WebAssembly>(target, context);
+    } else if (target.arch == Target::RISCV) {
+        return make_codegen<CodeGen_RISCV>(target, context);
     }
 
     user_error << "Unknown target architecture: "
@@ -321,12 +352,12 @@ CodeGen_LLVM *CodeGen_LLVM::new_for_target(const Target &target,
 }
 
 void CodeGen_LLVM::initialize_llvm() {
-    static std::mutex initialize_llvm_mutex;
-    std::lock_guard<std::mutex> lock(initialize_llvm_mutex);
-
-    // Initialize the targets we want to generate code for which are enabled
-    // in llvm configuration
-    if (!llvm_initialized) {
+    // Every compilation calls this, so after the first it shouldn't
+    // take a lock.
+    static std::once_flag initialize_llvm_once;
+    std::call_once(initialize_llvm_once, []() {
+        // Initialize the targets we want to generate code for which are enabled
+        // in llvm configuration
 
         // You can hack in command-line args to llvm with the
         // environment variable HL_LLVM_ARGS, e.g. HL_LLVM_ARGS="-print-after-all"
@@ -361,7 +392,7 @@ void CodeGen_LLVM::initialize_llvm() {
         #undef LLVM_ASM_PRINTER
 
         llvm_initialized = true;
-    }
+    });
 }
 
 void CodeGen_LLVM::init_context() {
@@ -402,16 +433,81 @@ void CodeGen_LLVM::init_context() {
     f64x4 = VectorType::get(f64_t, 4);
 }
 
+namespace {
+
+// Match the condition made by Stage::specialize_for_target_features,
+// before or after simplification.
+bool is_target_features_check(const Expr &condition, uint64_t *features) {
+    const Call *c = nullptr;
+    if (const NE *ne = condition.as<NE>()) {
+        if (is_zero(ne->b)) {
+            c = ne->a.as<Call>();
+        }
+    } else if (const Not *n = condition.as<Not>()) {
+        const EQ *eq = n->a.as<EQ>();
+        if (eq && is_zero(eq->b)) {
+            c = eq->a.as<Call>();
+        }
+    }
+    if (c && c->name == "halide_can_use_target_features" && c->args.size() == 1) {
+        if (const UIntImm *mask = c->args[0].as<UIntImm>()) {
+            *features = mask->value;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Collect the features of every target features specialization.
+class FindTargetFeaturesSpecializations : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const IfThenElse *op) {
+        uint64_t mask = 0;
+        if (is_target_features_check(op->condition, &mask)) {
+            features |= mask;
+        }
+        IRVisitor::visit(op);
+    }
+public:
+    uint64_t features = 0;
+};
+
+// Add the features in a mask of Target::Feature bits to a target.
+Target with_target_features(Target t, uint64_t features) {
+    for (int i = 0; i < std::min((int)Target::FeatureEnd, 64); i++) {
+        if (features & (((uint64_t)1) << i)) {
+            t.set_feature((Target::Feature)i);
+        }
+    }
+    return t;
+}
+
+}  // namespace
+
 void CodeGen_LLVM::init_module() {
     init_context();
 
+    // Loop nests specialized for target features may use the
+    // runtime's support code for those features too.
+    Target runtime_target = target;
+    if (input_module) {
+        FindTargetFeaturesSpecializations finder;
+        for (const auto &f : input_module->functions()) {
+            f.body.accept(&finder);
+        }
+        runtime_target = with_target_features(target, finder.features);
+    }
+
     // Start with a module containing the initial module for this target.
-    module = get_initial_module_for_target(target, context);
+    module = get_initial_module_for_target(runtime_target, context);
 }
 
 void CodeGen_LLVM::add_external_code(const Module &halide_module) {
     for (const ExternalCode &code_blob : halide_module.external_code()) {
         if (code_blob.is_for_cpu_target(get_target())) {
+            // The linker needs the whole runtime to resolve against.
+            materialize_used_runtime_functions(*module, true);
             add_bitcode_to_module(context, *module, code_blob.contents(), code_blob.name());
         }
     }
@@ -429,6 +525,8 @@ bool CodeGen_LLVM::llvm_AArch64_enabled = false;
 bool CodeGen_LLVM::llvm_NVPTX_enabled = false;
 bool CodeGen_LLVM::llvm_Mips_enabled = false;
 bool CodeGen_LLVM::llvm_PowerPC_enabled = false;
+bool CodeGen_LLVM::llvm_WebAssembly_enabled = false;
+bool CodeGen_LLVM::llvm_RISCV_enabled = false;
 
 namespace {
 
@@ -483,6 +581,17 @@ MangledNames get_mangled_names(const LoweredFunc &f, const Target &target) {
 std::unique_ptr<llvm::Module> CodeGen_LLVM::compile(const Module &input) {
     input_module = &input;
 
+    // The runtime can't write a profile from Hexagon, so code
+    // offloaded to it isn't instrumented.
+    pgo_instrument = target.has_feature(Target::PGOInstrument) && target.arch != Target::Hexagon;
+    pgo_counters.clear();
+    pgo_names.clear();
+    pgo_branches = 0;
+    load_pgo_profile();
+
+    CompileTimeProfiler profiler("codegen " + input.name());
+    profiler.phase("Generating llvm bitcode");
+
     init_module();
 
     debug(1) << "Target triple of initial module: " << module->getTargetTriple() << "\n";
@@ -526,14 +635,18 @@ std::unique_ptr<llvm::Module> CodeGen_LLVM::compile(const Module &input) {
     for (const auto &b : input.buffers()) {
         compile_buffer(b);
     }
+    vector<string> function_names;
     for (const auto &f : input.functions()) {
         const auto names = get_mangled_names(f, get_target());
+        function_names.push_back(names.extern_name);
 
         compile_func(f, names.simple_name, names.extern_name);
 
         // If the Func is externally visible, also create the argv wrapper and metadata.
         // (useful for calling from JIT and other machine interfaces).
         if (f.linkage == LoweredFunc::ExternalPlusMetadata) {
+            function_names.push_back(names.argv_name);
+            function_names.push_back(names.metadata_name);
             llvm::Function *wrapper = add_argv_wrapper(names.argv_name);
             llvm::Function *metadata_getter = embed_metadata_getter(names.metadata_name,
                 names.simple_name, f.args, input.get_metadata_name_map());
@@ -544,6 +657,10 @@ std::unique_ptr<llvm::Module> CodeGen_LLVM::compile(const Module &input) {
         }
     }
 
+    add_pgo_counters_writer();
+
+    materialize_used_runtime_functions(*module);
+
     debug(2) << module.get() << "\n";
 
     // Verify the module is ok
@@ -551,7 +668,16 @@ std::unique_ptr<llvm::Module> CodeGen_LLVM::compile(const Module &input) {
     debug(2) << "Done generating llvm bitcode\n";
 
     // Optimize
+    profiler.phase("Optimizing llvm bitcode", profiler.recording() ? count_llvm_instructions(*module) : 0);
     CodeGen_LLVM::optimize_module();
+    profiler.end(profiler.recording() ? count_llvm_instructions(*module) : 0);
+
+    // Append a report of the size of the code to a file, if asked to.
+    std::string code_size_report = get_env_variable("HL_CODE_SIZE_REPORT");
+    if (!code_size_report.empty()) {
+        std::ofstream out(code_size_report, std::ios::app);
+        write_code_size_report(*module, input.name() + " (" + target.to_string() + ")", function_names, out);
+    }
 
     input_module = nullptr;
 
@@ -1037,13 +1163,18 @@ void CodeGen_LLVM::optimize_module() {
 
     PassManagerBuilder b;
     b.OptLevel = 3;
+    // Optimizing for size stops llvm from unrolling and inlining
+    // aggressively. Its vectorizers stay on, because vectorized code
+    // is usually smaller too.
+    b.SizeLevel = target.has_feature(Target::SizeOptimized) ? 1 : 0;
 #if LLVM_VERSION >= 50
-    b.Inliner = createFunctionInliningPass(b.OptLevel, 0, false);
+    b.Inliner = createFunctionInliningPass(b.OptLevel, b.SizeLevel, false);
 #else
-    b.Inliner = createFunctionInliningPass(b.OptLevel, 0);
+    b.Inliner = createFunctionInliningPass(b.OptLevel, b.SizeLevel);
 #endif
     b.LoopVectorize = true;
     b.SLPVectorize = true;
+    b.DisableUnrollLoops = target.has_feature(Target::SizeOptimized);
 
 #if LLVM_VERSION >= 50
     if (TM) {
@@ -1187,6 +1318,18 @@ void CodeGen_LLVM::visit(const Variable *op) {
 }
 
 void CodeGen_LLVM::visit(const Add *op) {
+    // Fold additions into horizontal sums, so that the backends can
+    // use accumulating instructions.
+    const VectorReduce *red_a = op->a.as<VectorReduce>();
+    const VectorReduce *red_b = op->b.as<VectorReduce>();
+    if (red_a && red_a->op == VectorReduce::Add) {
+        codegen_vector_reduce(red_a, op->b);
+        return;
+    } else if (red_b && red_b->op == VectorReduce::Add) {
+        codegen_vector_reduce(red_b, op->a);
+        return;
+    }
+
     if (op->type.is_float()) {
         value = builder->CreateFAdd(codegen(op->a), codegen(op->b));
     } else if (op->type.is_int() && op->type.bits() >= 32) {
@@ -1709,6 +1852,34 @@ void CodeGen_LLVM::visit(const Load *op) {
             }
 
             value = shuffle_vectors(vec_a, vec_b, indices);
+        } else if (ramp && stride && stride->value >= 3 && stride->value <= 8 &&
+                   ramp->lanes >= stride->value) {
+            // Load stride vectors worth and then shuffle out the lanes
+            // we want. The last load is moved back to end at the last
+            // lane we want, so that we don't read beyond the end of
+            // the buffer.
+            int s = stride->value;
+            int lanes = ramp->lanes;
+            vector<Value *> vecs;
+            vector<int> offsets;
+            for (int j = 0; j < s; j++) {
+                int offset = j * lanes;
+                if (j == s - 1) {
+                    offset -= s - 1;
+                }
+                Expr index = Ramp::make(ramp->base + offset, make_one(ramp->base.type()), lanes);
+                Expr load = Load::make(op->type, op->name, index, op->image, op->param, op->predicate);
+                vecs.push_back(codegen(load));
+                offsets.push_back(offset);
+            }
+
+            vector<int> indices(lanes);
+            for (int i = 0; i < lanes; i++) {
+                int j = std::min(i * s / lanes, s - 1);
+                indices[i] = j * lanes + i * s - offsets[j];
+            }
+
+            value = shuffle_vectors(concat_vectors(vecs), indices);
         } else if (ramp && stride && stride->value == -1) {
             // Load the vector and then flip it in-place
             Expr flipped_base = ramp->base - ramp->lanes + 1;
@@ -2302,6 +2473,10 @@ void CodeGen_LLVM::visit(const Call *op) {
 
             value = phi;
         }
+    } else if (op->is_intrinsic(Call::nontemporal)) {
+        // The Store of this value handles the marker.
+        internal_assert(op->args.size() == 1);
+        value = codegen(op->args[0]);
     } else if (op->is_intrinsic(Call::require)) {
         internal_assert(op->args.size() == 3);
         Expr cond = op->args[0];
@@ -2675,10 +2850,40 @@ void CodeGen_LLVM::visit(const Call *op) {
         Expr e = Internal::halide_exp(op->args[0]);
         e.accept(this);
     } else if (op->call_type == Call::PureExtern &&
-               (op->name == "is_nan_f32" || op->name == "is_nan_f64")) {
+               (op->name == "is_nan_f16" || op->name == "is_nan_f32" || op->name == "is_nan_f64")) {
         internal_assert(op->args.size() == 1);
         Value *a = codegen(op->args[0]);
         value = builder->CreateFCmpUNO(a, a);
+    } else if (op->call_type == Call::PureExtern &&
+               op->type.element_of() == Float(16) &&
+               ends_with(op->name, "_f16")) {
+        // The operations with llvm intrinsics are done in half
+        // precision, which is native on targets with fp16 arithmetic
+        // (e.g. ARMv8.2 and CUDA sm_53 and up), and promoted to float
+        // by llvm elsewhere. The rest are done in float.
+        const std::string base = op->name.substr(0, op->name.size() - 4);
+        static const std::map<std::string, llvm::Intrinsic::ID> half_intrinsics = {
+            {"sqrt", Intrinsic::sqrt},
+            {"floor", Intrinsic::floor},
+            {"ceil", Intrinsic::ceil},
+            {"round", Intrinsic::nearbyint},
+            {"trunc", Intrinsic::trunc},
+        };
+        auto it = half_intrinsics.find(base);
+        if (it != half_intrinsics.end()) {
+            internal_assert(op->args.size() == 1);
+            Value *a = codegen(op->args[0]);
+            llvm::Function *fn = Intrinsic::getDeclaration(module.get(), it->second, {a->getType()});
+            value = builder->CreateCall(fn, {a});
+        } else {
+            Type float_t = Float(32, op->type.lanes());
+            std::vector<Expr> args;
+            for (const Expr &arg : op->args) {
+                args.push_back(cast(float_t, arg));
+            }
+            Expr e = Call::make(float_t, base + "_f32", args, Call::PureExtern);
+            value = codegen(cast(op->type, e));
+        }
     } else {
         // It's an extern call.
 
@@ -2827,6 +3032,145 @@ void CodeGen_LLVM::visit(const Prefetch *op) {
     internal_error << "Prefetch encountered during codegen\n";
 }
 
+namespace {
+
+// Find the loads from a buffer within the value of an atomic store,
+// optionally replacing them with something else. Stage::atomic
+// ensures they're all of the site being stored to.
+class ReplaceLoadsFrom : public IRMutator2 {
+    using IRMutator2::visit;
+
+    const string &buffer;
+    Expr replacement;
+
+    Expr visit(const Load *op) override {
+        if (op->name == buffer) {
+            found = true;
+            if (replacement.defined()) {
+                return replacement;
+            }
+        }
+        return IRMutator2::visit(op);
+    }
+
+public:
+    bool found = false;
+    ReplaceLoadsFrom(const string &b, Expr r) : buffer(b), replacement(r) {}
+};
+
+bool loads_from(const string &buffer, Expr e) {
+    ReplaceLoadsFrom finder(buffer, Expr());
+    finder.mutate(e);
+    return finder.found;
+}
+
+}
+
+void CodeGen_LLVM::visit(const Atomic *op) {
+    internal_assert(!emit_atomic_stores) << "Nested atomic node for " << op->producer_name << "\n";
+    emit_atomic_stores = true;
+    codegen(op->body);
+    emit_atomic_stores = false;
+}
+
+void CodeGen_LLVM::codegen_atomic_store(const Store *op) {
+    Type value_type = op->value.type();
+    internal_assert(!value_type.is_handle()) << "Atomic store of a handle to " << op->name << "\n";
+
+    if (value_type.is_vector()) {
+        // There are no vector atomics, and lanes may collide, so do
+        // one lane at a time.
+        for (int i = 0; i < value_type.lanes(); i++) {
+            Stmt s = Store::make(op->name, extract_lane(op->value, i), extract_lane(op->index, i),
+                                 op->param, extract_lane(op->predicate, i));
+            codegen_atomic_store(s.as<Store>());
+        }
+        return;
+    }
+
+    if (!is_one(op->predicate)) {
+        // Still atomic, as we're inside the Atomic node.
+        codegen(IfThenElse::make(op->predicate, Store::make(op->name, op->value, op->index,
+                                                            op->param, const_true())));
+        return;
+    }
+
+    Value *ptr = codegen_buffer_pointer(op->name, value_type, op->index);
+
+    // Use a native read-modify-write instruction if there is one for
+    // this operator.
+    if (value_type.is_int() || value_type.is_uint()) {
+        llvm::AtomicRMWInst::BinOp rmw_op = llvm::AtomicRMWInst::BAD_BINOP;
+        Expr operand;
+        if (const Add *add = op->value.as<Add>()) {
+            rmw_op = llvm::AtomicRMWInst::Add;
+            if (add->a.as<Load>() && add->a.as<Load>()->name == op->name) {
+                operand = add->b;
+            } else if (add->b.as<Load>() && add->b.as<Load>()->name == op->name) {
+                operand = add->a;
+            }
+        } else if (const Sub *sub = op->value.as<Sub>()) {
+            rmw_op = llvm::AtomicRMWInst::Sub;
+            if (sub->a.as<Load>() && sub->a.as<Load>()->name == op->name) {
+                operand = sub->b;
+            }
+        } else if (const Min *min = op->value.as<Min>()) {
+            rmw_op = value_type.is_int() ? llvm::AtomicRMWInst::Min : llvm::AtomicRMWInst::UMin;
+            if (min->a.as<Load>() && min->a.as<Load>()->name == op->name) {
+                operand = min->b;
+            } else if (min->b.as<Load>() && min->b.as<Load>()->name == op->name) {
+                operand = min->a;
+            }
+        } else if (const Max *max = op->value.as<Max>()) {
+            rmw_op = value_type.is_int() ? llvm::AtomicRMWInst::Max : llvm::AtomicRMWInst::UMax;
+            if (max->a.as<Load>() && max->a.as<Load>()->name == op->name) {
+                operand = max->b;
+            } else if (max->b.as<Load>() && max->b.as<Load>()->name == op->name) {
+                operand = max->a;
+            }
+        }
+
+        if (operand.defined() && !loads_from(op->name, operand)) {
+            Value *val = codegen(operand);
+            builder->CreateAtomicRMW(rmw_op, ptr, val, llvm::AtomicOrdering::Monotonic);
+            return;
+        }
+    }
+
+    // Otherwise, compute the new value from the old one and try to
+    // swap it in, until no other thread got there first. The swap is
+    // done on integers, which is all cmpxchg supports.
+    llvm::Type *int_type = llvm::Type::getIntNTy(*context, value_type.bits());
+    unsigned addr_space = ptr->getType()->getPointerAddressSpace();
+    Value *int_ptr = builder->CreatePointerCast(ptr, int_type->getPointerTo(addr_space));
+
+    Value *orig = builder->CreateAlignedLoad(int_ptr, value_type.bytes());
+    BasicBlock *pre_bb = builder->GetInsertBlock();
+    BasicBlock *loop_bb = BasicBlock::Create(*context, op->name + "_atomic_cas", function);
+    BasicBlock *after_bb = BasicBlock::Create(*context, op->name + "_atomic_cas_done", function);
+    builder->CreateBr(loop_bb);
+
+    builder->SetInsertPoint(loop_bb);
+    PHINode *old_int = builder->CreatePHI(int_type, 2);
+    old_int->addIncoming(orig, pre_bb);
+
+    string old_name = unique_name('t');
+    sym_push(old_name, builder->CreateBitCast(old_int, llvm_type_of(value_type)));
+    Expr new_value = ReplaceLoadsFrom(op->name, Variable::make(value_type, old_name)).mutate(op->value);
+    Value *new_int = builder->CreateBitCast(codegen(new_value), int_type);
+    sym_pop(old_name);
+
+    Value *cmpxchg = builder->CreateAtomicCmpXchg(int_ptr, old_int, new_int,
+                                                  llvm::AtomicOrdering::Monotonic,
+                                                  llvm::AtomicOrdering::Monotonic);
+    Value *current = builder->CreateExtractValue(cmpxchg, {0});
+    Value *success = builder->CreateExtractValue(cmpxchg, {1});
+    old_int->addIncoming(current, builder->GetInsertBlock());
+    builder->CreateCondBr(success, after_bb, loop_bb);
+
+    builder->SetInsertPoint(after_bb);
+}
+
 void CodeGen_LLVM::visit(const Let *op) {
     sym_push(op->name, codegen(op->value));
     if (op->value.type() == Int(32)) {
@@ -2949,7 +3293,24 @@ void CodeGen_LLVM::visit(const ProducerConsumer *op) {
     BasicBlock *produce = BasicBlock::Create(*context, name, function);
     builder->CreateBr(produce);
     builder->SetInsertPoint(produce);
-    codegen(op->body);
+    if (op->is_producer) {
+        bool old_emitted_nontemporal_stores = emitted_nontemporal_stores;
+        emitted_nontemporal_stores = false;
+        codegen(op->body);
+        codegen_nontemporal_store_fence();
+        emitted_nontemporal_stores = old_emitted_nontemporal_stores;
+    } else {
+        codegen(op->body);
+    }
+}
+
+void CodeGen_LLVM::codegen_nontemporal_store_fence() {
+    // Make the non-temporal stores visible to other threads before
+    // anything that follows, e.g. the consumer, or the completion of
+    // a parallel task.
+    if (emitted_nontemporal_stores) {
+        builder->CreateFence(llvm::AtomicOrdering::SequentiallyConsistent);
+    }
 }
 
 void CodeGen_LLVM::visit(const For *op) {
@@ -2959,6 +3320,28 @@ void CodeGen_LLVM::visit(const For *op) {
     if (op->for_type == ForType::Serial) {
         Value *max = builder->CreateNSWAdd(min, extent);
 
+        // Count the runs and iterations of the loop, and use the
+        // counts of the profile to weight the branches into and
+        // around it. LLVM estimates the trip count from the weights
+        // of the back-edge.
+        std::string pgo_name = pgo_counter_name(function->getName().str() + "." + op->name);
+        if (pgo_instrument) {
+            Value *zero = ConstantInt::get(i32_t, 0);
+            Value *iterations = builder->CreateSelect(builder->CreateICmpSGT(extent, zero), extent, zero);
+            pgo_count(pgo_name + ".runs", ConstantInt::get(i64_t, 1));
+            pgo_count(pgo_name + ".iterations", builder->CreateZExt(iterations, i64_t));
+        }
+        llvm::MDNode *enter_weights = very_likely_branch, *loop_weights = nullptr;
+        uint64_t runs = 0, iterations = 0;
+        if (pgo_profile_count(pgo_name + ".runs", &runs) &&
+            pgo_profile_count(pgo_name + ".iterations", &iterations) &&
+            runs > 0) {
+            if (iterations == 0) {
+                enter_weights = pgo_branch_weights(0, runs);
+            }
+            loop_weights = pgo_branch_weights(iterations > runs ? iterations - runs : 0, runs);
+        }
+
         BasicBlock *preheader_bb = builder->GetInsertBlock();
 
         // Make a new basic block for the loop
@@ -2968,7 +3351,7 @@ void CodeGen_LLVM::visit(const For *op) {
 
         // If min < max, fall through to the loop bb
         Value *enter_condition = builder->CreateICmpSLT(min, max);
-        builder->CreateCondBr(enter_condition, loop_bb, after_bb, very_likely_branch);
+        builder->CreateCondBr(enter_condition, loop_bb, after_bb, enter_weights);
         builder->SetInsertPoint(loop_bb);
 
         // Make our phi node.
@@ -2989,7 +3372,7 @@ void CodeGen_LLVM::visit(const For *op) {
 
         // Maybe exit the loop
         Value *end_condition = builder->CreateICmpNE(next_var, max);
-        builder->CreateCondBr(end_condition, loop_bb, after_bb);
+        builder->CreateCondBr(end_condition, loop_bb, after_bb, loop_weights);
 
         builder->SetInsertPoint(after_bb);
 
@@ -3023,6 +3406,13 @@ void CodeGen_LLVM::visit(const For *op) {
         function->addParamAttr(2, Attribute::NoAlias);
         #endif
         set_function_attributes_for_target(function, target);
+        // Inside a target features specialization, the loop body is
+        // compiled for the specialized target too.
+        for (const char *attr : {"target-cpu", "target-features"}) {
+            if (containing_function->hasFnAttribute(attr)) {
+                function->addFnAttr(containing_function->getFnAttribute(attr));
+            }
+        }
 
         // Make the initial basic block and jump the builder into the new function
         IRBuilderBase::InsertPoint call_site = builder->saveIP();
@@ -3062,25 +3452,42 @@ void CodeGen_LLVM::visit(const For *op) {
         unpack_closure(closure, symbol_table, closure_t, closure_handle, builder);
 
         // Generate the new function body
+        bool old_emitted_nontemporal_stores = emitted_nontemporal_stores;
+        emitted_nontemporal_stores = false;
         codegen(op->body);
+        codegen_nontemporal_store_fence();
+        emitted_nontemporal_stores = old_emitted_nontemporal_stores;
 
         // Return success
         return_with_error_code(ConstantInt::get(i32_t, 0));
 
         // Move the builder back to the main function and call do_par_for
         builder->restoreIP(call_site);
-        llvm::Function *do_par_for = module->getFunction("halide_do_par_for");
-        internal_assert(do_par_for) << "Could not find halide_do_par_for in initial module\n";
-        #if LLVM_VERSION < 50
-        do_par_for->setDoesNotAlias(5);
-        #else
-        do_par_for->addParamAttr(4, Attribute::NoAlias);
-        #endif
-        //do_par_for->setDoesNotCapture(5);
         ptr = builder->CreatePointerCast(ptr, i8_t->getPointerTo());
-        Value *args[] = {user_context, function, min, extent, ptr};
-        debug(4) << "Creating call to do_par_for\n";
-        Value *result = builder->CreateCall(do_par_for, args);
+        Value *result = nullptr;
+        if (ends_with(op->name, ".__fork")) {
+            // The two iterations of a fork (see AsyncProducers.cpp)
+            // need a thread each, because they wait on each other.
+            internal_assert(is_zero(op->min) && is_const(op->extent, 2))
+                << "A fork must have exactly two iterations, starting at zero\n";
+            llvm::Function *do_fork = module->getFunction("halide_do_fork");
+            internal_assert(do_fork) << "Could not find halide_do_fork in initial module\n";
+            Value *args[] = {user_context, function, ptr};
+            debug(4) << "Creating call to do_fork\n";
+            result = builder->CreateCall(do_fork, args);
+        } else {
+            llvm::Function *do_par_for = module->getFunction("halide_do_par_for");
+            internal_assert(do_par_for) << "Could not find halide_do_par_for in initial module\n";
+            #if LLVM_VERSION < 50
+            do_par_for->setDoesNotAlias(5);
+            #else
+            do_par_for->addParamAttr(4, Attribute::NoAlias);
+            #endif
+            //do_par_for->setDoesNotCapture(5);
+            Value *args[] = {user_context, function, min, extent, ptr};
+            debug(4) << "Creating call to do_par_for\n";
+            result = builder->CreateCall(do_par_for, args);
+        }
 
         debug(3) << "Leaving parallel for loop over " << op->name << "\n";
 
@@ -3101,6 +3508,11 @@ void CodeGen_LLVM::visit(const For *op) {
 }
 
 void CodeGen_LLVM::visit(const Store *op) {
+    if (emit_atomic_stores) {
+        codegen_atomic_store(op);
+        return;
+    }
+
     // Even on 32-bit systems, Handles are treated as 64-bit in
     // memory, so convert stores of handles to stores of uint64_ts.
     if (op->value.type().is_handle()) {
@@ -3118,6 +3530,10 @@ void CodeGen_LLVM::visit(const Store *op) {
     Halide::Type value_type = op->value.type();
     Value *val = codegen(op->value);
     bool is_external = (external_buffer.find(op->name) != external_buffer.end());
+    // Stores the schedule asked to bypass the caches (see
+    // inject_streaming_stores).
+    const Call *value_call = op->value.as<Call>();
+    bool nontemporal = value_call && value_call->is_intrinsic(Call::nontemporal);
     // Scalar
     if (value_type.is_scalar()) {
         Value *ptr = codegen_buffer_pointer(op->name, value_type, op->index);
@@ -3167,6 +3583,13 @@ void CodeGen_LLVM::visit(const Store *op) {
                 Value *vec_ptr = builder->CreatePointerCast(elt_ptr, slice_val->getType()->getPointerTo());
                 StoreInst *store = builder->CreateAlignedStore(slice_val, vec_ptr, alignment);
                 add_tbaa_metadata(store, op->name, slice_index);
+                // Non-temporal stores that aren't known to be aligned
+                // would be done as ordinary stores anyway.
+                if (nontemporal && alignment >= slice_lanes * value_type.bytes()) {
+                    llvm::Metadata *one = ConstantAsMetadata::get(ConstantInt::get(i32_t, 1));
+                    store->setMetadata(LLVMContext::MD_nontemporal, MDNode::get(*context, one));
+                    emitted_nontemporal_stores = true;
+                }
             }
         } else if (ramp) {
             Type ptr_type = value_type.element_of();
@@ -3223,17 +3646,134 @@ void CodeGen_LLVM::visit(const Provide *op) {
     internal_error << "Provide encountered during codegen\n";
 }
 
+namespace {
+
+// If a condition compares a scalar integer variable to a constant,
+// get them.
+bool is_switch_case(const Expr &condition, const Variable **var, int64_t *value) {
+    const EQ *eq = condition.as<EQ>();
+    if (!eq || !eq->a.type().is_scalar() || eq->a.type().is_bool() ||
+        !(eq->a.type().is_int() || eq->a.type().is_uint())) {
+        return false;
+    }
+    Expr a = eq->a, b = eq->b;
+    if (!a.as<Variable>()) {
+        std::swap(a, b);
+    }
+    *var = a.as<Variable>();
+    if (!*var) {
+        return false;
+    }
+    if (const int64_t *i = as_const_int(b)) {
+        *value = *i;
+        return true;
+    } else if (const uint64_t *u = as_const_uint(b)) {
+        *value = (int64_t)*u;
+        return true;
+    }
+    return false;
+}
+
+}  // namespace
+
+bool CodeGen_LLVM::codegen_switch(const IfThenElse *op) {
+    const Variable *var = nullptr;
+    vector<pair<int64_t, Stmt>> cases;
+    Stmt default_case = op;
+    while (const IfThenElse *branch = default_case.as<IfThenElse>()) {
+        const Variable *v = nullptr;
+        int64_t value = 0;
+        if (!is_switch_case(branch->condition, &v, &value) ||
+            (var && (v->name != var->name || v->type != var->type))) {
+            break;
+        }
+        var = v;
+        // If an earlier condition tested the same value, this branch
+        // is never taken.
+        bool seen = false;
+        for (const auto &c : cases) {
+            seen = seen || c.first == value;
+        }
+        if (!seen) {
+            cases.push_back({value, branch->then_case});
+        }
+        default_case = branch->else_case;
+    }
+
+    // Chains of up to three comparisons are just as fast as an if.
+    if (cases.size() <= 3) {
+        return false;
+    }
+
+    // Switches are numbered along with the ifs. Each case counts how
+    // often it's taken, as the two sides of an if do. Conditions
+    // wrapped in likely() aren't comparisons, so they stay ifs.
+    std::string pgo_name = pgo_counter_name(function->getName().str() + ".switch" + std::to_string(pgo_branches++));
+    vector<uint64_t> counts(cases.size() + 1);
+    bool have_counts = pgo_profile_count(pgo_name + ".default", &counts[0]);
+    for (size_t i = 0; i < cases.size(); i++) {
+        have_counts = have_counts && pgo_profile_count(pgo_name + ".case" + std::to_string(i), &counts[i + 1]);
+    }
+
+    BasicBlock *default_bb = BasicBlock::Create(*context, "switch_default", function);
+    BasicBlock *after_bb = BasicBlock::Create(*context, "switch_after", function);
+    llvm::IntegerType *t = llvm::cast<llvm::IntegerType>(llvm_type_of(var->type));
+    llvm::SwitchInst *sw = builder->CreateSwitch(codegen(var), default_bb, cases.size());
+    if (have_counts) {
+        sw->setMetadata(llvm::LLVMContext::MD_prof, pgo_branch_weights(counts));
+    }
+    for (size_t i = 0; i < cases.size(); i++) {
+        BasicBlock *case_bb = BasicBlock::Create(*context, "switch_case", function);
+        sw->addCase(ConstantInt::get(t, (uint64_t)cases[i].first, var->type.is_int()), case_bb);
+        builder->SetInsertPoint(case_bb);
+        pgo_count(pgo_name + ".case" + std::to_string(i), ConstantInt::get(i64_t, 1));
+        codegen(cases[i].second);
+        builder->CreateBr(after_bb);
+    }
+
+    builder->SetInsertPoint(default_bb);
+    pgo_count(pgo_name + ".default", ConstantInt::get(i64_t, 1));
+    if (default_case.defined()) {
+        codegen(default_case);
+    }
+    builder->CreateBr(after_bb);
+
+    builder->SetInsertPoint(after_bb);
+    return true;
+}
+
 void CodeGen_LLVM::visit(const IfThenElse *op) {
+    uint64_t features = 0;
+    if (is_target_features_check(op->condition, &features)) {
+        codegen_target_features_specialization(op, features);
+        return;
+    }
+
+    if (codegen_switch(op)) {
+        return;
+    }
+
+    // Branches are numbered in the order they are generated.
+    std::string pgo_name = pgo_counter_name(function->getName().str() + ".if" + std::to_string(pgo_branches++));
+    uint64_t then_count = 0, else_count = 0;
+    llvm::MDNode *weights = nullptr;
+    if (pgo_profile_count(pgo_name + ".then", &then_count) &&
+        pgo_profile_count(pgo_name + ".else", &else_count)) {
+        weights = pgo_branch_weights(then_count, else_count);
+    }
+
     BasicBlock *true_bb = BasicBlock::Create(*context, "true_bb", function);
     BasicBlock *false_bb = BasicBlock::Create(*context, "false_bb", function);
     BasicBlock *after_bb = BasicBlock::Create(*context, "after_bb", function);
-    builder->CreateCondBr(codegen(op->condition), true_bb, false_bb);
+    builder->CreateCondBr(codegen(op->condition), true_bb, false_bb, weights);
 
     builder->SetInsertPoint(true_bb);
+    pgo_count(pgo_name + ".then", ConstantInt::get(i64_t, 1));
     codegen(op->then_case);
     builder->CreateBr(after_bb);
 
     builder->SetInsertPoint(false_bb);
+    pgo_count(pgo_name + ".else", ConstantInt::get(i64_t, 1));
     if (op->else_case.defined()) {
         codegen(op->else_case);
     }
@@ -3242,6 +3782,230 @@ void CodeGen_LLVM::visit(const IfThenElse *op) {
     builder->SetInsertPoint(after_bb);
 }
 
+void CodeGen_LLVM::codegen_target_features_specialization(const IfThenElse *op, uint64_t features) {
+    Target specialized_target = with_target_features(target, features);
+    for (int i = 0; i < std::min((int)Target::FeatureEnd, 64); i++) {
+        if (features & (((uint64_t)1) << i)) {
+            user_assert(arch_of_runtime_detected_feature((Target::Feature)i) == target.arch)
+                << "Cannot specialize for target feature " << target_feature_name((Target::Feature)i)
+                << " on target " << target.to_string() << "\n";
+        }
+    }
+
+    if (specialized_target == target) {
+        // The target already has the features.
+        codegen(op->then_case);
+        return;
+    }
+
+    Stmt else_case = op->else_case.defined() ? op->else_case : Evaluate::make(0);
+
+    // The jit runtime can't check the cpu's features, but the cpu
+    // is the host, so we can check them now.
+    Expr condition = op->condition;
+    if (target.has_feature(Target::JIT)) {
+        Target host = get_host_target();
+        if (with_target_features(host, features) != host) {
+            codegen(else_case);
+            return;
+        }
+        condition = const_true();
+    }
+
+    debug(3) << "Entering specialization for target " << specialized_target.to_string() << "\n";
+
+    // Put everything the specialized case refers to in a closure, as
+    // for a parallel loop body.
+    Closure closure(op->then_case);
+    StructType *closure_t = build_closure_type(closure, buffer_t_type, context);
+    Value *ptr = create_alloca_at_entry(closure_t, 1);
+    pack_closure(closure_t, ptr, closure, symbol_table, buffer_t_type, builder);
+
+    // Make a new function for the specialized case, compiled for the
+    // specialized target. LLVM won't inline it into its caller, which
+    // lacks the features.
+    llvm::Type *voidPointerType = (llvm::Type *)(i8_t->getPointerTo());
+    llvm::Type *args_t[] = {voidPointerType, voidPointerType};
+    FunctionType *func_t = FunctionType::get(i32_t, args_t, false);
+    llvm::Function *containing_function = function;
+    function = llvm::Function::Create(func_t, llvm::Function::InternalLinkage,
+                                      containing_function->getName() + "_" + specialized_target.to_string(),
+                                      module.get());
+    set_function_attributes_for_target(function, specialized_target);
+
+    // Generate the function with the specialized target, so that the
+    // architecture-specific code generators use the features.
+    Target saved_target = target;
+    target = specialized_target;
+    if (!mcpu().empty()) {
+        function->addFnAttr("target-cpu", mcpu());
+    }
+    if (!mattrs().empty()) {
+        function->addFnAttr("target-features", mattrs());
+    }
+
+    BasicBlock *true_bb = BasicBlock::Create(*context, "specialized_bb", containing_function);
+    BasicBlock *false_bb = BasicBlock::Create(*context, "unspecialized_bb", containing_function);
+    BasicBlock *after_bb = BasicBlock::Create(*context, "after_bb", containing_function);
+    builder->CreateCondBr(codegen(condition), true_bb, false_bb);
+    builder->SetInsertPoint(true_bb);
+
+    IRBuilderBase::InsertPoint call_site = builder->saveIP();
+    BasicBlock *block = BasicBlock::Create(*context, "entry", function);
+    builder->SetInsertPoint(block);
+
+    Value *user_context = get_user_context();
+
+    BasicBlock *parent_destructor_block = destructor_block;
+    destructor_block = nullptr;
+
+    Scope<Value *> saved_symbol_table;
+    symbol_table.swap(saved_symbol_table);
+
+    llvm::Function::arg_iterator iter = function->arg_begin();
+    sym_push("__user_context", iterator_to_pointer(iter));
+    ++iter;
+    iter->setName("closure");
+    Value *closure_handle = builder->CreatePointerCast(iterator_to_pointer(iter),
+                                                       closure_t->getPointerTo());
+    unpack_closure(closure, symbol_table, closure_t, closure_handle, builder);
+
+    codegen(op->then_case);
+
+    return_with_error_code(ConstantInt::get(i32_t, 0));
+
+    // Move back to the containing function and call the specialized case.
+    target = saved_target;
+    builder->restoreIP(call_site);
+    ptr = builder->CreatePointerCast(ptr, i8_t->getPointerTo());
+    Value *args[] = {user_context, ptr};
+    Value *result = builder->CreateCall(function, args);
+
+    symbol_table.swap(saved_symbol_table);
+    function = containing_function;
+    destructor_block = parent_destructor_block;
+
+    Value *did_succeed = builder->CreateICmpEQ(result, ConstantInt::get(i32_t, 0));
+    create_assertion(did_succeed, Expr(), result);
+    builder->CreateBr(after_bb);
+
+    builder->SetInsertPoint(false_bb);
+    codegen(else_case);
+    builder->CreateBr(after_bb);
+
+    builder->SetInsertPoint(after_bb);
+
+    debug(3) << "Leaving specialization for target " << specialized_target.to_string() << "\n";
+}
+
+std::string CodeGen_LLVM::pgo_counter_name(const std::string &name) {
+    // The same loop may be generated more than once, e.g. in
+    // each case of a specialization.
+    int n = pgo_names[name]++;
+    return n == 0 ? name : name + "." + std::to_string(n);
+}
+
+void CodeGen_LLVM::pgo_count(const std::string &name, Value *amount) {
+    if (!pgo_instrument) {
+        return;
+    }
+    GlobalVariable *counter =
+        new GlobalVariable(*module, i64_t, false, GlobalValue::PrivateLinkage,
+                           ConstantInt::get(i64_t, 0), "pgo_counter");
+    pgo_counters.push_back({name, counter});
+    builder->CreateAtomicRMW(AtomicRMWInst::Add, counter, amount, llvm::AtomicOrdering::Monotonic);
+}
+
+bool CodeGen_LLVM::pgo_profile_count(const std::string &name, uint64_t *count) {
+    auto it = pgo_profile.find(name);
+    if (it == pgo_profile.end()) {
+        return false;
+    }
+    *count = it->second;
+    return true;
+}
+
+llvm::MDNode *CodeGen_LLVM::pgo_branch_weights(uint64_t taken, uint64_t not_taken) {
+    return pgo_branch_weights(vector<uint64_t>{taken, not_taken});
+}
+
+llvm::MDNode *CodeGen_LLVM::pgo_branch_weights(const vector<uint64_t> &counts) {
+    // Branch weights are 32-bit, so scale the counts down to fit.
+    uint64_t m = *std::max_element(counts.begin(), counts.end());
+    uint64_t scale = m / std::numeric_limits<uint32_t>::max() + 1;
+    vector<uint32_t> weights;
+    for (uint64_t c : counts) {
+        weights.push_back((uint32_t)(c / scale));
+    }
+    llvm::MDBuilder md_builder(*context);
+    return md_builder.createBranchWeights(weights);
+}
+
+void CodeGen_LLVM::load_pgo_profile() {
+    pgo_profile.clear();
+    std::string filename = get_env_variable("HL_PGO_PROFILE");
+    if (filename.empty()) {
+        return;
+    }
+    std::ifstream f(filename);
+    user_assert(f.good()) << "Could not open the profile " << filename << " named by HL_PGO_PROFILE\n";
+    // Each line is a counter name and its count. Names may appear
+    // more than once if the profile was appended to by several runs.
+    std::string name;
+    uint64_t count;
+    while (f >> name >> count) {
+        pgo_profile[name] += count;
+    }
+    debug(1) << "Read " << pgo_profile.size() << " counts from the profile " << filename << "\n";
+}
+
+void CodeGen_LLVM::add_pgo_counters_writer() {
+    if (pgo_counters.empty()) {
+        return;
+    }
+
+    // Make tables of the names and counters.
+    llvm::Type *i64_ptr_t = i64_t->getPointerTo();
+    std::vector<Constant *> names, counters;
+    for (const auto &c : pgo_counters) {
+        names.push_back(create_string_constant(c.first));
+        counters.push_back(c.second);
+    }
+    ArrayType *names_t = ArrayType::get(i8_t->getPointerTo(), names.size());
+    ArrayType *counters_t = ArrayType::get(i64_ptr_t, counters.size());
+    GlobalVariable *names_table =
+        new GlobalVariable(*module, names_t, true, GlobalValue::PrivateLinkage,
+                           ConstantArray::get(names_t, names), "pgo_counter_names");
+    GlobalVariable *counters_table =
+        new GlobalVariable(*module, counters_t, true, GlobalValue::PrivateLinkage,
+                           ConstantArray::get(counters_t, counters), "pgo_counters");
+
+    llvm::Function *write_counts = module->getFunction("halide_pgo_write_counts");
+    if (!write_counts) {
+        llvm::Type *args_t[] = {i8_t->getPointerTo(), i8_t->getPointerTo()->getPointerTo(), i64_ptr_t->getPointerTo(), i32_t};
+        FunctionType *write_counts_t = FunctionType::get(i32_t, args_t, false);
+        write_counts = llvm::Function::Create(write_counts_t, llvm::Function::ExternalLinkage,
+                                              "halide_pgo_write_counts", module.get());
+    }
+
+    // Write them at exit, from a destructor of the module.
+    FunctionType *writer_t = FunctionType::get(void_t, false);
+    llvm::Function *writer = llvm::Function::Create(writer_t, llvm::Function::InternalLinkage,
+                                                    "halide_pgo_write_counters", module.get());
+    IRBuilderBase::InsertPoint here = builder->saveIP();
+    builder->SetInsertPoint(BasicBlock::Create(*context, "entry", writer));
+    Value *args[] = {
+        ConstantPointerNull::get(i8_t->getPointerTo()),
+        builder->CreateConstInBoundsGEP2_32(names_t, names_table, 0, 0),
+        builder->CreateConstInBoundsGEP2_32(counters_t, counters_table, 0, 0),
+        ConstantInt::get(i32_t, (int)pgo_counters.size())
+    };
+    builder->CreateCall(write_counts, args);
+    builder->CreateRetVoid();
+    builder->restoreIP(here);
+    llvm::appendToGlobalDtors(*module, writer, 65535);
+}
+
 void CodeGen_LLVM::visit(const Evaluate *op) {
     codegen(op->value);
 
@@ -3249,6 +4013,14 @@ void CodeGen_LLVM::visit(const Evaluate *op) {
     value = nullptr;
 }
 
+void CodeGen_LLVM::visit(const VectorReduce *op) {
+    codegen_vector_reduce(op, Expr());
+}
+
+void CodeGen_LLVM::codegen_vector_reduce(const VectorReduce *op, const Expr &init) {
+    value = codegen(lower_vector_reduce(op, init));
+}
+
 void CodeGen_LLVM::visit(const Shuffle *op) {
     if (op->is_interleave()) {
         vector<Value *> vecs;
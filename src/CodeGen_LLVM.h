@@ -119,6 +119,8 @@ protected:
     static bool llvm_NVPTX_enabled;
     static bool llvm_Mips_enabled;
     static bool llvm_PowerPC_enabled;
+    static bool llvm_WebAssembly_enabled;
+    static bool llvm_RISCV_enabled;
 
     const Module *input_module;
     std::unique_ptr<llvm::Module> module;
@@ -344,8 +346,31 @@ protected:
     virtual void visit(const Evaluate *);
     virtual void visit(const Shuffle *);
     virtual void visit(const Prefetch *);
+    virtual void visit(const Atomic *);
+    virtual void visit(const VectorReduce *);
     // @}
 
+    /** Generate code for a horizontal vector reduction. If init is
+     * defined, it's combined with the result using the reduction's
+     * operator, which lets subclasses use accumulating instructions
+     * (e.g. dot products). The default implementation is a tree of
+     * shuffles and vector operations. */
+    virtual void codegen_vector_reduce(const VectorReduce *op, const Expr &init);
+
+    /** Generate code for an IfThenElse made by
+     * Stage::specialize_for_target_features. The specialized case is
+     * outlined into a function compiled with the target plus the
+     * given features (a mask of Target::Feature bits), which is
+     * called if the cpu has them. */
+    void codegen_target_features_specialization(const IfThenElse *op, uint64_t features);
+
+    /** Generate code for a chain of IfThenElse nodes that compare the
+     * same scalar integer variable against distinct constants, as
+     * made by specializing on the values of a Param, as a switch
+     * statement, which LLVM can lower to a jump table. Returns false
+     * (and generates nothing) if the chain is too short. */
+    bool codegen_switch(const IfThenElse *op);
+
     /** Generate code for an allocate node. It has no default
      * implementation - it must be handled in an architecture-specific
      * way. */
@@ -442,6 +467,31 @@ protected:
     /** Alignment info for Int(32) variables in scope. */
     Scope<ModulusRemainder> alignment_info;
 
+    /** Are we inside an Atomic node? If so, stores must be done with
+     * atomic read-modify-write operations. */
+    bool emit_atomic_stores;
+
+    /** Have any non-temporal stores been generated since the start of
+     * the current producer or parallel task? Non-temporal stores are
+     * weakly ordered, so these end with a fence. */
+    bool emitted_nontemporal_stores;
+
+    /** Emit a fence if any non-temporal stores have been generated
+     * since the start of the current producer or parallel task. */
+    void codegen_nontemporal_store_fence();
+
+    /** Generate an atomic read-modify-write of a Store inside an
+     * Atomic node. */
+    void codegen_atomic_store(const Store *op);
+
+    /** Generate code for a load or store with a predicate. The
+     * default implementation uses masked loads and stores for dense
+     * vectors, and scalarizes the rest. */
+    // @{
+    virtual void codegen_predicated_vector_load(const Load *op);
+    virtual void codegen_predicated_vector_store(const Store *op);
+    // @}
+
 private:
 
     /** All the values in scope at the current code location during
@@ -473,8 +523,43 @@ private:
 
     llvm::Value *codegen_dense_vector_load(const Load *load, llvm::Value *vpred = nullptr);
 
-    virtual void codegen_predicated_vector_load(const Load *op);
-    virtual void codegen_predicated_vector_store(const Store *op);
+    /** State for profile-guided optimization. With the PGOInstrument
+     * target feature, every branch and serial loop gets counters,
+     * which are written to a profile at exit. With HL_PGO_PROFILE set
+     * to the name of a profile, its counts weight the same branches
+     * and loops. Counters are named after the function and loop, or
+     * the number of the branch in the function, so the names are the
+     * same when the same pipeline is compiled again. */
+    // @{
+    bool pgo_instrument;
+    std::vector<std::pair<std::string, llvm::GlobalVariable *>> pgo_counters;
+    std::map<std::string, uint64_t> pgo_profile;
+    std::map<std::string, int> pgo_names;
+    int pgo_branches;
+    // @}
+
+    /** Make a name for a pgo counter, unique within the module. */
+    std::string pgo_counter_name(const std::string &name);
+
+    /** Add an amount to a pgo counter, if instrumenting. */
+    void pgo_count(const std::string &name, llvm::Value *amount);
+
+    /** Get the count for a name in the profile, returning false if
+     * there's no profile or it doesn't contain the name. */
+    bool pgo_profile_count(const std::string &name, uint64_t *count);
+
+    /** Make branch weights from profile counts, one per successor. */
+    // @{
+    llvm::MDNode *pgo_branch_weights(uint64_t taken, uint64_t not_taken);
+    llvm::MDNode *pgo_branch_weights(const std::vector<uint64_t> &counts);
+    // @}
+
+    /** Read the profile named by HL_PGO_PROFILE, if it is set. */
+    void load_pgo_profile();
+
+    /** Add a destructor to the module that writes the pgo counters
+     * to the profile. */
+    void add_pgo_counters_writer();
 };
 
 }
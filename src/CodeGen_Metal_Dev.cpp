@@ -302,6 +302,10 @@ void CodeGen_Metal_Dev::CodeGen_Metal_C::visit(const Load *op) {
     }
 }
 
+void CodeGen_Metal_Dev::CodeGen_Metal_C::visit(const Atomic *op) {
+    user_error << "Atomic updates of " << op->producer_name << " are not supported by the Metal backend.\n";
+}
+
 void CodeGen_Metal_Dev::CodeGen_Metal_C::visit(const Store *op) {
     user_assert(is_one(op->predicate)) << "Predicated store is not supported inside Metal kernel.\n";
 
@@ -622,6 +626,29 @@ void CodeGen_Metal_Dev::init_module() {
                << "#define tanh_f32 tanh \n"
                << "#define atanh_f32 atanh \n"
                << "#define fast_inverse_sqrt_f32 rsqrt \n"
+               // The math functions are overloaded for half.
+               << "#define sqrt_f16 sqrt \n"
+               << "#define sin_f16 sin \n"
+               << "#define cos_f16 cos \n"
+               << "#define exp_f16 exp \n"
+               << "#define log_f16 log \n"
+               << "#define abs_f16 fabs \n"
+               << "#define floor_f16 floor \n"
+               << "#define ceil_f16 ceil \n"
+               << "#define round_f16 round \n"
+               << "#define trunc_f16 trunc \n"
+               << "#define pow_f16 pow\n"
+               << "#define asin_f16 asin \n"
+               << "#define acos_f16 acos \n"
+               << "#define tan_f16 tan \n"
+               << "#define atan_f16 atan \n"
+               << "#define atan2_f16 atan2\n"
+               << "#define sinh_f16 sinh \n"
+               << "#define asinh_f16 asinh \n"
+               << "#define cosh_f16 cosh \n"
+               << "#define acosh_f16 acosh \n"
+               << "#define tanh_f16 tanh \n"
+               << "#define atanh_f16 atanh \n"
                << "#define halide_gpu_thread_barrier() \\\n" // Must to be a #define as barriers in an inline function don't work
                << "  (threadgroup_barrier(mem_flags::mem_threadgroup), 0)\n" // Halide only ever needs threadgroup (OpenCL "local") memory fences. (mem_threadgroup)
                << "}\n"; // close namespace
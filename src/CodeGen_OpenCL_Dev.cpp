@@ -4,6 +4,7 @@
 #include "CodeGen_OpenCL_Dev.h"
 #include "CodeGen_Internal.h"
 #include "Debug.h"
+#include "Deinterleave.h"
 #include "IROperator.h"
 #include "IRMutator.h"
 #include "EliminateBoolVectors.h"
@@ -114,8 +115,9 @@ string simt_intrinsic(const string &name) {
 void CodeGen_OpenCL_Dev::CodeGen_OpenCL_C::visit(const For *loop) {
     if (is_gpu_var(loop->name)) {
         internal_assert((loop->for_type == ForType::GPUBlock) ||
-                        (loop->for_type == ForType::GPUThread))
-            << "kernel loop must be either gpu block or gpu thread\n";
+                        (loop->for_type == ForType::GPUThread) ||
+                        (loop->for_type == ForType::GPULane))
+            << "kernel loop must be either gpu block, gpu thread, or gpu lane\n";
         internal_assert(is_zero(loop->min));
 
         do_indent();
@@ -286,7 +288,103 @@ void CodeGen_OpenCL_Dev::CodeGen_OpenCL_C::visit(const Load *op) {
     }
 }
 
+void CodeGen_OpenCL_Dev::CodeGen_OpenCL_C::visit(const Atomic *op) {
+    internal_assert(!emit_atomic_stores) << "Nested atomic node for " << op->producer_name << "\n";
+    emit_atomic_stores = true;
+    op->body.accept(this);
+    emit_atomic_stores = false;
+}
+
+namespace {
+
+class ReplaceLoadsFrom : public IRMutator2 {
+    using IRMutator2::visit;
+
+    const string &buffer;
+    Expr replacement;
+
+    Expr visit(const Load *op) override {
+        if (op->name == buffer) {
+            return replacement;
+        }
+        return IRMutator2::visit(op);
+    }
+
+public:
+    ReplaceLoadsFrom(const string &b, Expr r) : buffer(b), replacement(r) {}
+};
+
+}  // namespace
+
+void CodeGen_OpenCL_Dev::CodeGen_OpenCL_C::visit_atomic_store(const Store *op) {
+    Type t = op->value.type();
+
+    if (t.is_vector()) {
+        // Lanes may collide, so do one at a time.
+        for (int i = 0; i < t.lanes(); i++) {
+            Stmt s = Store::make(op->name, extract_lane(op->value, i), extract_lane(op->index, i),
+                                 op->param, extract_lane(op->predicate, i));
+            s.accept(this);
+        }
+        return;
+    }
+
+    if (!is_one(op->predicate)) {
+        Stmt s = IfThenElse::make(op->predicate, Store::make(op->name, op->value, op->index,
+                                                             op->param, const_true()));
+        s.accept(this);
+        return;
+    }
+
+    user_assert(t.bits() == 32 && !t.is_handle())
+        << "Atomic updates of " << op->name << " of type " << t
+        << " are not supported by the OpenCL backend, which only has 32-bit atomics.\n";
+
+    // Compute the new value from the old one, and try to swap its
+    // bits in until no other thread got there first.
+    string type = print_type(t);
+    string bits_type = t.is_int() ? "int" : "uint";
+    string space = get_memory_space(op->name);
+    string id_index = print_expr(op->index);
+    string ptr_id = unique_name('_');
+    string old_bits_id = unique_name('_');
+    do_indent();
+    stream << "// atomic store to " << print_name(op->name) << "\n";
+    open_scope();
+    do_indent();
+    stream << "volatile " << space << " " << bits_type << " *" << ptr_id
+           << " = ((volatile " << space << " " << bits_type << " *)"
+           << print_name(op->name) << ") + " << id_index << ";\n";
+    do_indent();
+    stream << bits_type << " " << old_bits_id << " = *" << ptr_id << ";\n";
+    do_indent();
+    stream << "while (1)\n";
+    open_scope();
+    string old_id = unique_name('_');
+    do_indent();
+    stream << type << " " << old_id << " = as_" << type << "(" << old_bits_id << ");\n";
+    string id_value = print_expr(ReplaceLoadsFrom(op->name, Variable::make(t, old_id)).mutate(op->value));
+    string new_bits_id = unique_name('_');
+    string prev_bits_id = unique_name('_');
+    do_indent();
+    stream << bits_type << " " << new_bits_id << " = as_" << bits_type << "(" << id_value << ");\n";
+    do_indent();
+    stream << bits_type << " " << prev_bits_id << " = atomic_cmpxchg("
+           << ptr_id << ", " << old_bits_id << ", " << new_bits_id << ");\n";
+    do_indent();
+    stream << "if (" << prev_bits_id << " == " << old_bits_id << ") break;\n";
+    do_indent();
+    stream << old_bits_id << " = " << prev_bits_id << ";\n";
+    close_scope("");
+    close_scope("atomic store to " + print_name(op->name));
+}
+
 void CodeGen_OpenCL_Dev::CodeGen_OpenCL_C::visit(const Store *op) {
+    if (emit_atomic_stores) {
+        visit_atomic_store(op);
+        return;
+    }
+
     user_assert(is_one(op->predicate)) << "Predicated store is not supported inside OpenCL kernel.\n";
 
     string id_value = print_expr(op->value);
@@ -394,6 +492,11 @@ void CodeGen_OpenCL_Dev::CodeGen_OpenCL_C::visit(const Allocate *op) {
         // Already handled
         op->body.accept(this);
     } else {
+        internal_assert(op->memory_type != MemoryType::GPUShared &&
+                        op->memory_type != MemoryType::Heap)
+            << "Allocation " << op->name << " inside OpenCL kernel should have been "
+            << "lifted into shared memory or rejected by fuse_gpu_thread_loops\n";
+
         open_scope();
 
         debug(2) << "Allocate " << op->name << " on device\n";
@@ -691,6 +794,24 @@ void CodeGen_OpenCL_Dev::init_module() {
     // __shared always has address space __local.
     src_stream << "#define __address_space___shared __local\n";
 
+    // Reductions across the lanes of a loop use subgroups where the
+    // device has them. Elsewhere the fallback path is taken, but the
+    // code that uses them must still compile.
+    src_stream << "#if defined(cl_khr_subgroups) || defined(__opencl_c_subgroups)\n"
+               << "#ifdef cl_khr_subgroups\n"
+               << "#pragma OPENCL EXTENSION cl_khr_subgroups : enable\n"
+               << "#endif\n"
+               << "inline int halide_cl_has_subgroups() { return 1; }\n"
+               << "#else\n"
+               << "inline int halide_cl_has_subgroups() { return 0; }\n"
+               << "#define get_sub_group_local_id() 0\n"
+               << "#define sub_group_reduce_add(x) (x)\n"
+               << "#define sub_group_reduce_min(x) (x)\n"
+               << "#define sub_group_reduce_max(x) (x)\n"
+               << "#define sub_group_all(x) (x)\n"
+               << "#define sub_group_any(x) (x)\n"
+               << "#endif\n";
+
     if (target.has_feature(Target::CLDoubles)) {
         src_stream << "#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n"
                    << "bool is_nan_f64(double x) {return x != x; }\n"
@@ -64,7 +64,12 @@ protected:
         void visit(const Call *op);
         void visit(const Load *op);
         void visit(const Store *op);
+        void visit(const Atomic *op);
         void visit(const Cast *op);
+
+        /** Emit a store that is safe against other threads updating
+         * the same site, with a compare-and-swap loop. */
+        void visit_atomic_store(const Store *op);
         void visit(const Select *op);
         void visit(const EQ *);
         void visit(const NE *);
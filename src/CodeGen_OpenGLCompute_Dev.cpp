@@ -112,6 +112,11 @@ void CodeGen_OpenGLCompute_Dev::CodeGen_OpenGLCompute_C::visit(const Cast *op) {
 
 void CodeGen_OpenGLCompute_Dev::CodeGen_OpenGLCompute_C::visit(const Call *op) {
     if (op->name == "halide_gpu_thread_barrier") {
+        // barrier() only synchronizes execution. Also make the
+        // writes to shared and buffer memory before it visible to
+        // the rest of the workgroup.
+        do_indent();
+        stream << "groupMemoryBarrier();\n";
         do_indent();
         stream << "barrier();\n";
     } else {
@@ -287,6 +287,10 @@ void CodeGen_GLSLBase::visit(const GE *op) {
     }
 }
 
+void CodeGen_GLSLBase::visit(const Atomic *op) {
+    user_error << "Atomic updates of " << op->producer_name << " are not supported by the GLSL backend.\n";
+}
+
 void CodeGen_GLSLBase::visit(const Shuffle *op) {
     // The halide Shuffle represents the llvm intrinisc
     // shufflevector, however, for GLSL its use is limited to swizzling
@@ -40,6 +40,58 @@ CodeGen_PTX_Dev::~CodeGen_PTX_Dev() {
     delete context;
 }
 
+namespace {
+
+// Finds the launch bounds and resource usage of a kernel: the
+// constant extents of the loops over threads, the register budget
+// injected by fuse_gpu_thread_loops, and the size of the shared
+// memory allocation.
+class ExtractKernelResources : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const For *op) override {
+        for (int i = 0; i < 3; i++) {
+            if (ends_with(op->name, thread_names[i])) {
+                const int64_t *extent = as_const_int(op->extent);
+                if (extent) {
+                    threads[i] = std::max(threads[i], (int)*extent);
+                } else {
+                    constant_threads = false;
+                }
+            }
+        }
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Call *op) override {
+        if (op->name == "halide.ptx.max_registers") {
+            const int64_t *budget = as_const_int(op->args[0]);
+            internal_assert(budget);
+            max_registers = (int)*budget;
+        }
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Allocate *op) override {
+        if (op->name == "__shared") {
+            const int64_t *size = op->extents.empty() ? nullptr : as_const_int(op->extents[0]);
+            if (size) {
+                shared_mem_bytes = (int)*size;
+            }
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    const char *thread_names[3] = {".__thread_id_x", ".__thread_id_y", ".__thread_id_z"};
+    int threads[3] = {1, 1, 1};
+    bool constant_threads = true;
+    int max_registers = 0;
+    int shared_mem_bytes = 0;
+};
+
+}  // namespace
+
 void CodeGen_PTX_Dev::add_kernel(Stmt stmt,
                                  const std::string &name,
                                  const std::vector<DeviceArgument> &args) {
@@ -128,6 +180,55 @@ void CodeGen_PTX_Dev::add_kernel(Stmt stmt,
 
     module->getOrInsertNamedMetadata("nvvm.annotations")->addOperand(md_node);
 
+    // Add the launch bounds, so that ptxas can allocate registers
+    // for the block size the kernel actually uses, and the register
+    // budget from the schedule, if any.
+    ExtractKernelResources resources;
+    stmt.accept(&resources);
+    vector<std::pair<string, int>> annotations;
+    if (resources.constant_threads) {
+        annotations.push_back({"maxntidx", resources.threads[0]});
+        annotations.push_back({"maxntidy", resources.threads[1]});
+        annotations.push_back({"maxntidz", resources.threads[2]});
+    }
+    if (resources.max_registers > 0) {
+        annotations.push_back({"maxnreg", resources.max_registers});
+    }
+    for (const auto &a : annotations) {
+        llvm::Metadata *md_args[] = {
+            llvm::ValueAsMetadata::get(function),
+            MDString::get(*context, a.first),
+            llvm::ValueAsMetadata::get(ConstantInt::get(i32_t, a.second))
+        };
+        module->getOrInsertNamedMetadata("nvvm.annotations")->addOperand(MDNode::get(*context, md_args));
+    }
+
+    // Estimate the occupancy. Every CUDA capability we target has 64K
+    // registers per multiprocessor, and at least 48K of shared memory
+    // per block.
+    if (resources.constant_threads) {
+        const int registers_per_sm = 64 * 1024;
+        const int shared_mem_per_sm = 48 * 1024;
+        int threads = resources.threads[0] * resources.threads[1] * resources.threads[2];
+        if (resources.max_registers > 0) {
+            int registers = resources.max_registers * threads;
+            if (registers > registers_per_sm) {
+                user_warning << "Kernel " << name << " has " << threads << " threads per block "
+                             << "and a budget of " << resources.max_registers
+                             << " registers per thread, which is more than the "
+                             << registers_per_sm << " registers of a multiprocessor. "
+                             << "It will fail to launch if it needs all of them.\n";
+            } else {
+                int blocks = registers_per_sm / registers;
+                if (resources.shared_mem_bytes > 0) {
+                    blocks = std::min(blocks, shared_mem_per_sm / resources.shared_mem_bytes);
+                }
+                debug(1) << "Kernel " << name << " can have at most " << blocks
+                         << " blocks of " << threads << " threads resident per multiprocessor\n";
+            }
+        }
+    }
+
 
     // Now verify the function is ok
     verifyFunction(*function);
@@ -194,6 +295,10 @@ void CodeGen_PTX_Dev::visit(const Allocate *alloc) {
         Value *shared_base = Constant::getNullValue(PointerType::get(i8_t, 3));
         sym_push(alloc->name, shared_base);
     } else {
+        internal_assert(alloc->memory_type != MemoryType::GPUShared &&
+                        alloc->memory_type != MemoryType::Heap)
+            << "Allocation " << alloc->name << " inside PTX kernel should have been "
+            << "lifted into shared memory or rejected by fuse_gpu_thread_loops\n";
 
         debug(2) << "Allocate " << alloc->name << " on device\n";
 
@@ -230,12 +335,139 @@ void CodeGen_PTX_Dev::visit(const AssertStmt *op) {
     codegen(IfThenElse::make(!op->condition, Evaluate::make(trap)));
 }
 
+void CodeGen_PTX_Dev::visit(const Call *op) {
+    if (op->name == "halide.ptx.max_registers") {
+        // The register budget of the kernel, injected by
+        // fuse_gpu_thread_loops. It was turned into an annotation in
+        // add_kernel.
+        value = ConstantInt::get(i32_t, 0);
+    } else if (op->name == "halide.ptx.wmma.m16n16k16.f32.f16") {
+        // A 16x16x16 matrix multiply-accumulate on the tensor cores,
+        // injected by lower_tensor_cores. The args are a load of the
+        // first element, the leading dimension, and whether the tile
+        // is row-major, for each of A, B, and C in turn. The C
+        // fragment is loaded, accumulated into, and stored back.
+        #if LLVM_VERSION >= 60
+        internal_assert(op->args.size() == 9);
+        vector<llvm::Value *> ptrs, ldms;
+        vector<bool> row_major;
+        for (int i = 0; i < 3; i++) {
+            const Load *load = op->args[i * 3].as<Load>();
+            internal_assert(load) << "Operand of wmma must be a load\n";
+            ptrs.push_back(codegen_buffer_pointer(load->name, load->type, load->index));
+            ldms.push_back(codegen(op->args[i * 3 + 1]));
+            row_major.push_back(is_one(op->args[i * 3 + 2]));
+        }
+
+        #if LLVM_VERSION >= 70
+        llvm::Intrinsic::ID load_a = (row_major[0] ?
+                                      Intrinsic::nvvm_wmma_m16n16k16_load_a_f16_row_stride :
+                                      Intrinsic::nvvm_wmma_m16n16k16_load_a_f16_col_stride);
+        llvm::Intrinsic::ID load_b = (row_major[1] ?
+                                      Intrinsic::nvvm_wmma_m16n16k16_load_b_f16_row_stride :
+                                      Intrinsic::nvvm_wmma_m16n16k16_load_b_f16_col_stride);
+        llvm::Intrinsic::ID load_c = (row_major[2] ?
+                                      Intrinsic::nvvm_wmma_m16n16k16_load_c_f32_row_stride :
+                                      Intrinsic::nvvm_wmma_m16n16k16_load_c_f32_col_stride);
+        llvm::Intrinsic::ID store_d = (row_major[2] ?
+                                       Intrinsic::nvvm_wmma_m16n16k16_store_d_f32_row_stride :
+                                       Intrinsic::nvvm_wmma_m16n16k16_store_d_f32_col_stride);
+        llvm::Intrinsic::ID mma;
+        if (row_major[0]) {
+            mma = (row_major[1] ?
+                   Intrinsic::nvvm_wmma_m16n16k16_mma_row_row_f32_f32 :
+                   Intrinsic::nvvm_wmma_m16n16k16_mma_row_col_f32_f32);
+        } else {
+            mma = (row_major[1] ?
+                   Intrinsic::nvvm_wmma_m16n16k16_mma_col_row_f32_f32 :
+                   Intrinsic::nvvm_wmma_m16n16k16_mma_col_col_f32_f32);
+        }
+        #else
+        // In LLVM 6, m16n16k16 is the only shape, and it isn't in the
+        // names. The loads and stores take generic pointers instead
+        // of being overloaded on the pointer type.
+        llvm::Intrinsic::ID load_a = (row_major[0] ?
+                                      Intrinsic::nvvm_wmma_load_a_f16_row_stride :
+                                      Intrinsic::nvvm_wmma_load_a_f16_col_stride);
+        llvm::Intrinsic::ID load_b = (row_major[1] ?
+                                      Intrinsic::nvvm_wmma_load_b_f16_row_stride :
+                                      Intrinsic::nvvm_wmma_load_b_f16_col_stride);
+        llvm::Intrinsic::ID load_c = (row_major[2] ?
+                                      Intrinsic::nvvm_wmma_load_c_f32_row_stride :
+                                      Intrinsic::nvvm_wmma_load_c_f32_col_stride);
+        llvm::Intrinsic::ID store_d = (row_major[2] ?
+                                       Intrinsic::nvvm_wmma_store_d_f32_row_stride :
+                                       Intrinsic::nvvm_wmma_store_d_f32_col_stride);
+        llvm::Intrinsic::ID mma;
+        if (row_major[0]) {
+            mma = (row_major[1] ?
+                   Intrinsic::nvvm_wmma_mma_sync_row_row_f32_f32 :
+                   Intrinsic::nvvm_wmma_mma_sync_row_col_f32_f32);
+        } else {
+            mma = (row_major[1] ?
+                   Intrinsic::nvvm_wmma_mma_sync_col_row_f32_f32 :
+                   Intrinsic::nvvm_wmma_mma_sync_col_col_f32_f32);
+        }
+        for (llvm::Value *&ptr : ptrs) {
+            ptr = builder->CreatePointerBitCastOrAddrSpaceCast(ptr, i8_t->getPointerTo());
+        }
+        #endif
+
+        auto wmma_declaration = [&](llvm::Intrinsic::ID id, int i) {
+            #if LLVM_VERSION >= 70
+            return Intrinsic::getDeclaration(module.get(), id, {ptrs[i]->getType()});
+            #else
+            return Intrinsic::getDeclaration(module.get(), id);
+            #endif
+        };
+
+        // Each lane holds eight elements of each fragment, returned
+        // as a struct.
+        auto load_fragment = [&](llvm::Intrinsic::ID id, int i) {
+            llvm::Value *frag = builder->CreateCall(wmma_declaration(id, i), {ptrs[i], ldms[i]});
+            vector<llvm::Value *> elems;
+            for (unsigned j = 0; j < 8; j++) {
+                elems.push_back(builder->CreateExtractValue(frag, {j}));
+            }
+            return elems;
+        };
+
+        vector<llvm::Value *> mma_args = load_fragment(load_a, 0);
+        vector<llvm::Value *> b_frag = load_fragment(load_b, 1);
+        vector<llvm::Value *> c_frag = load_fragment(load_c, 2);
+        mma_args.insert(mma_args.end(), b_frag.begin(), b_frag.end());
+        mma_args.insert(mma_args.end(), c_frag.begin(), c_frag.end());
+        llvm::Value *d = builder->CreateCall(Intrinsic::getDeclaration(module.get(), mma), mma_args);
+
+        vector<llvm::Value *> store_args = {ptrs[2]};
+        for (unsigned j = 0; j < 8; j++) {
+            store_args.push_back(builder->CreateExtractValue(d, {j}));
+        }
+        store_args.push_back(ldms[2]);
+        builder->CreateCall(wmma_declaration(store_d, 2), store_args);
+
+        value = ConstantInt::get(i32_t, 0);
+        #else
+        internal_error << "Tensor core instructions require LLVM 6 or later\n";
+        #endif
+    } else {
+        CodeGen_LLVM::visit(op);
+    }
+}
+
 string CodeGen_PTX_Dev::march() const {
     return "nvptx64";
 }
 
 string CodeGen_PTX_Dev::mcpu() const {
-    if (target.has_feature(Target::CUDACapability61)) {
+    // LLVM only knows sm_75 from LLVM 8 on. Before that, compile
+    // sm_75 for sm_70, which it runs.
+    if (LLVM_VERSION >= 80 && target.has_feature(Target::CUDACapability75)) {
+        return "sm_75";
+    } else if (target.features_any_of({Target::CUDACapability70,
+                                       Target::CUDACapability75})) {
+        return "sm_70";
+    } else if (target.has_feature(Target::CUDACapability61)) {
         return "sm_61";
     } else if (target.has_feature(Target::CUDACapability50)) {
         return "sm_50";
@@ -251,7 +483,13 @@ string CodeGen_PTX_Dev::mcpu() const {
 }
 
 string CodeGen_PTX_Dev::mattrs() const {
-    if (target.has_feature(Target::CUDACapability61)) {
+    if (LLVM_VERSION >= 80 && target.has_feature(Target::CUDACapability75)) {
+        return "+ptx63";
+    } else if (target.features_any_of({Target::CUDACapability70,
+                                       Target::CUDACapability75})) {
+        // Need ptx isa 6.0 for the wmma instructions.
+        return "+ptx60";
+    } else if (target.has_feature(Target::CUDACapability61)) {
         return "+ptx50";
     } else if (target.features_any_of({Target::CUDACapability32,
                                 Target::CUDACapability50})) {
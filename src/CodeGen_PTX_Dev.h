@@ -59,6 +59,7 @@ protected:
     void visit(const Allocate *);
     void visit(const Free *);
     void visit(const AssertStmt *);
+    void visit(const Call *);
     // @}
 
     std::string march() const;
@@ -79,9 +79,26 @@ int CodeGen_Posix::allocation_padding(Type type) const {
     return type.bytes();
 }
 
-CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &name, Type type,
+CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &name, Type type, MemoryType memory_type,
                                                            const std::vector<Expr> &extents, Expr condition,
                                                            Expr new_expr, std::string free_function) {
+    user_assert(memory_type != MemoryType::GPUShared)
+        << "Allocation " << name << " is scheduled to be stored in GPU shared memory, "
+        << "but isn't inside a GPU kernel.\n";
+
+    bool on_vtcm = (memory_type == MemoryType::VTCM);
+    user_assert(!on_vtcm ||
+                (target.arch == Target::Hexagon &&
+                 target.features_any_of({Target::HVX_v65, Target::HVX_v66})))
+        << "Allocation " << name << " is scheduled to be stored in VTCM, "
+        << "which requires Hexagon code with HVX v65 or later.\n";
+
+    // Registers aren't addressable, so the closest we can get on
+    // the CPU is the stack.
+    bool force_stack = (memory_type == MemoryType::Stack ||
+                        memory_type == MemoryType::Register);
+    bool force_heap = (memory_type == MemoryType::Heap || on_vtcm);
+
     Value *llvm_size = nullptr;
     int64_t stack_bytes = 0;
     int32_t constant_bytes = Allocate::constant_allocation_size(extents, name);
@@ -92,11 +109,14 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
         if (stack_bytes > target.maximum_buffer_size()) {
             const string str_max_size = target.has_large_buffers() ? "2^63 - 1" : "2^31 - 1";
             user_error << "Total size for allocation " << name << " is constant but exceeds " << str_max_size << ".";
-        } else if (!can_allocation_fit_on_stack(stack_bytes)) {
+        } else if (force_heap || (!force_stack && !can_allocation_fit_on_stack(stack_bytes))) {
             stack_bytes = 0;
             llvm_size = codegen(Expr(constant_bytes));
         }
     } else {
+        user_assert(!force_stack || new_expr.defined())
+            << "Allocation " << name << " is scheduled to be stored in "
+            << memory_type << " memory, but its size isn't a known constant.\n";
         llvm_size = codegen_allocation_size(name, type, extents);
     }
 
@@ -124,7 +144,7 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
     allocation.destructor_function = nullptr;
     allocation.name = name;
 
-    if (!new_expr.defined() && extents.empty()) {
+    if (!new_expr.defined() && extents.empty() && !force_heap) {
         // If it's a scalar allocation, don't try anything clever. We
         // want llvm to be able to promote it to a register.
         allocation.ptr = create_alloca_at_entry(llvm_type_of(type), 1, false, name);
@@ -171,13 +191,20 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
         }
         cur_stack_alloc_total += allocation.stack_bytes;
         debug(4) << "cur_stack_alloc_total += " << allocation.stack_bytes << " -> " << cur_stack_alloc_total << " for " << name << "\n";
+    } else if (new_expr.as<Variable>() && allocations.contains(new_expr.as<Variable>()->name)) {
+        // This reuses the memory of an enclosing allocation, which
+        // owns it. Loads and stores to the two must be treated as
+        // possibly aliasing.
+        allocation.ptr = codegen(new_expr);
+        allocation.name = allocations.get(new_expr.as<Variable>()->name).name;
     } else {
         if (new_expr.defined()) {
             allocation.ptr = codegen(new_expr);
         } else {
             // call malloc
-            llvm::Function *malloc_fn = module->getFunction("halide_malloc");
-            internal_assert(malloc_fn) << "Could not find halide_malloc in module\n";
+            const char *malloc_name = on_vtcm ? "halide_vtcm_malloc" : "halide_malloc";
+            llvm::Function *malloc_fn = module->getFunction(malloc_name);
+            internal_assert(malloc_fn) << "Could not find " << malloc_name << " in module\n";
             #if LLVM_VERSION < 50
             malloc_fn->setDoesNotAlias(0);
             #else
@@ -188,7 +215,7 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
             ++arg_iter;  // skip the user context *
             llvm_size = builder->CreateIntCast(llvm_size, arg_iter->getType(), false);
 
-            debug(4) << "Creating call to halide_malloc for allocation " << name
+            debug(4) << "Creating call to " << malloc_name << " for allocation " << name
                      << " of size " << type.bytes();
             for (Expr e : extents) {
                 debug(4) << " x " << e;
@@ -221,7 +248,7 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
 
         // Register a destructor for this allocation.
         if (free_function.empty()) {
-            free_function = "halide_free";
+            free_function = on_vtcm ? "halide_vtcm_free" : "halide_free";
         }
         llvm::Function *free_fn = module->getFunction(free_function);
         internal_assert(free_fn) << "Could not find " << free_function << " in module.\n";
@@ -246,8 +273,12 @@ void CodeGen_Posix::free_allocation(const std::string &name) {
         cur_stack_alloc_total -= alloc.stack_bytes;
         debug(4) << "cur_stack_alloc_total -= " << alloc.stack_bytes << " -> " << cur_stack_alloc_total << " for " << name << "\n";
     } else {
-        internal_assert(alloc.destructor);
-        trigger_destructor(alloc.destructor_function, alloc.destructor);
+        // An allocation that reuses the memory of an enclosing one
+        // has nothing to free.
+        internal_assert(alloc.destructor || alloc.name != name);
+        if (alloc.destructor) {
+            trigger_destructor(alloc.destructor_function, alloc.destructor);
+        }
     }
 
     allocations.pop(name);
@@ -268,7 +299,7 @@ void CodeGen_Posix::visit(const Allocate *alloc) {
                    << alloc->name << "\n";
     }
 
-    Allocation allocation = create_allocation(alloc->name, alloc->type,
+    Allocation allocation = create_allocation(alloc->name, alloc->type, alloc->memory_type,
                                               alloc->extents, alloc->condition,
                                               alloc->new_expr, alloc->free_function);
     sym_push(alloc->name, allocation.ptr);
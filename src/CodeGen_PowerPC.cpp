@@ -40,6 +40,18 @@ const char* CodeGen_PowerPC::altivec_int_type_name(const Type& t) {
     return nullptr;  // not a recognized int type.
 }
 
+bool CodeGen_PowerPC::arch_2_07() const {
+    return target.has_feature(Target::POWER_ARCH_2_07) || arch_3_00();
+}
+
+bool CodeGen_PowerPC::arch_3_00() const {
+    return target.has_feature(Target::POWER_ARCH_3_00) || arch_3_1();
+}
+
+bool CodeGen_PowerPC::arch_3_1() const {
+    return target.has_feature(Target::POWER_ARCH_3_1);
+}
+
 void CodeGen_PowerPC::visit(const Cast *op) {
     if (!op->type.is_vector()) {
         // We only have peephole optimizations for vectors in here.
@@ -128,14 +140,13 @@ void CodeGen_PowerPC::visit(const Min *op) {
         return;
     }
 
-    bool vsx = target.has_feature(Target::VSX);
-    bool arch_2_07 = target.has_feature(Target::POWER_ARCH_2_07);
+    bool vsx = target.has_feature(Target::VSX) || arch_3_00();
 
     const Type& element_type = op->type.element_of();
     const char* element_type_name = altivec_int_type_name(element_type);
 
     if (element_type_name != nullptr &&
-        (element_type.bits() < 64 || arch_2_07)) {
+        (element_type.bits() < 64 || arch_2_07())) {
         value = call_intrin(op->type, (128 / element_type.bits()),
                             std::string("llvm.ppc.altivec.vmin") + element_type_name,
                             {op->a, op->b});
@@ -154,14 +165,13 @@ void CodeGen_PowerPC::visit(const Max *op) {
         return;
     }
 
-    bool vsx = target.has_feature(Target::VSX);
-    bool arch_2_07 = target.has_feature(Target::POWER_ARCH_2_07);
+    bool vsx = target.has_feature(Target::VSX) || arch_3_00();
 
     const Type& element_type = op->type.element_of();
     const char* element_type_name = altivec_int_type_name(element_type);
 
     if (element_type_name != nullptr &&
-        (element_type.bits() < 64 || arch_2_07)) {
+        (element_type.bits() < 64 || arch_2_07())) {
         value = call_intrin(op->type, (128 / element_type.bits()),
                             std::string("llvm.ppc.altivec.vmax") + element_type_name,
                             {op->a, op->b});
@@ -174,11 +184,116 @@ void CodeGen_PowerPC::visit(const Max *op) {
     }
 }
 
+void CodeGen_PowerPC::visit(const Call *op) {
+    // POWER9 has absolute differences of unsigned integers. Signed
+    // integers are mapped to unsigned ones, preserving order, by
+    // flipping the sign bit.
+    if (op->is_intrinsic(Call::absd) && op->type.is_vector() && arch_3_00()) {
+        internal_assert(op->args.size() == 2);
+        Type t = op->args[0].type();
+        const char *intrin = nullptr;
+        if (!t.is_float()) {
+            switch (t.bits()) {
+            case 8: intrin = "llvm.ppc.altivec.vabsdub"; break;
+            case 16: intrin = "llvm.ppc.altivec.vabsduh"; break;
+            case 32: intrin = "llvm.ppc.altivec.vabsduw"; break;
+            }
+        }
+        if (intrin) {
+            Expr a = op->args[0], b = op->args[1];
+            if (t.is_int()) {
+                Type ut = t.with_code(Type::UInt);
+                Expr sign_bit = make_const(ut, ((uint64_t)1) << (t.bits() - 1));
+                a = reinterpret(ut, a) ^ sign_bit;
+                b = reinterpret(ut, b) ^ sign_bit;
+            }
+            value = call_intrin(op->type, 128 / t.bits(), intrin, {a, b});
+            return;
+        }
+    }
+
+    CodeGen_Posix::visit(op);
+}
+
+void CodeGen_PowerPC::codegen_vector_reduce(const VectorReduce *op, const Expr &init) {
+    // vmsum sums groups of four 8-bit or two 16-bit products into
+    // each lane of a 32-bit accumulator. Use it for the first step of
+    // a sum of widening products.
+    struct Pattern {
+        int factor;
+        Type a, b;
+        const char *intrin;
+    };
+    static const Pattern patterns[] = {
+        {4, UInt(8), UInt(8), "llvm.ppc.altivec.vmsumubm"},
+        {4, Int(8), UInt(8), "llvm.ppc.altivec.vmsummbm"},
+        {2, UInt(16), UInt(16), "llvm.ppc.altivec.vmsumuhm"},
+        {2, Int(16), Int(16), "llvm.ppc.altivec.vmsumshm"},
+    };
+
+    const int factor = op->value.type().lanes() / op->type.lanes();
+    const int lanes = op->type.lanes();
+    if (op->op == VectorReduce::Add &&
+        op->type.bits() == 32 &&
+        !op->type.is_float()) {
+        for (const Pattern &p : patterns) {
+            const int groups = op->value.type().lanes() / p.factor;
+            if (factor % p.factor != 0 || groups % 4 != 0) {
+                continue;
+            }
+            Type a_t = p.a.with_lanes(groups * p.factor);
+            Type b_t = p.b.with_lanes(groups * p.factor);
+            Expr a, b;
+            if (const Mul *mul = op->value.as<Mul>()) {
+                a = lossless_cast(a_t, mul->a);
+                b = lossless_cast(b_t, mul->b);
+                if (!a.defined() || !b.defined()) {
+                    a = lossless_cast(a_t, mul->b);
+                    b = lossless_cast(b_t, mul->a);
+                }
+            } else {
+                // A sum of narrow values is a sum of products with ones.
+                a = lossless_cast(a_t, op->value);
+                b = make_one(b_t);
+            }
+            if (!a.defined() || !b.defined()) {
+                continue;
+            }
+            Type sum_t = op->type.with_lanes(groups);
+            Expr acc = (init.defined() && groups == lanes) ? init : make_zero(sum_t);
+            value = call_intrin(llvm_type_of(sum_t), 4, p.intrin, {codegen(a), codegen(b), codegen(acc)});
+            if (groups != lanes) {
+                // Reduce the rest of the way.
+                string sum_name = unique_name('t');
+                sym_push(sum_name, value);
+                Expr rest = VectorReduce::make(VectorReduce::Add, Variable::make(sum_t, sum_name), lanes);
+                if (init.defined()) {
+                    rest = Add::make(init, rest);
+                }
+                value = codegen(rest);
+                sym_pop(sum_name);
+            }
+            return;
+        }
+    }
+
+    CodeGen_Posix::codegen_vector_reduce(op, init);
+}
+
 string CodeGen_PowerPC::mcpu() const {
     if (target.bits == 32) {
         return "ppc32";
     } else {
-        if (target.has_feature(Target::POWER_ARCH_2_07))
+        // LLVM only knows pwr10 from LLVM 12 on. Before that,
+        // power_arch_3_1 compiles for POWER9, which POWER10 runs.
+#if LLVM_VERSION >= 120
+        if (arch_3_1())
+            return "pwr10";
+        else
+#endif
+        if (arch_3_00())
+            return "pwr9";
+        else if (arch_2_07())
             return "pwr8";
         else if (target.has_feature(Target::VSX))
             return "pwr7";
@@ -195,11 +310,11 @@ string CodeGen_PowerPC::mattrs() const {
     features += "+altivec";
     separator = ",";
 
-    enable = target.has_feature(Target::VSX) ? "+" : "-";
+    enable = (target.has_feature(Target::VSX) || arch_3_00()) ? "+" : "-";
     features += separator + enable + "vsx";
     separator = ",";
 
-    enable = target.has_feature(Target::POWER_ARCH_2_07) ? "+" : "-";
+    enable = arch_2_07() ? "+" : "-";
     features += separator + enable + "power8-altivec";
     separator = ",";
 
@@ -209,6 +324,18 @@ string CodeGen_PowerPC::mattrs() const {
     features += separator + enable + "direct-move";
     separator = ",";
 
+    if (arch_3_00()) {
+        features += separator + "+power9-altivec,+power9-vector";
+    }
+
+#if LLVM_VERSION >= 120
+    if (arch_3_1()) {
+        // Nothing selects the MMA outer products yet (LLVM doesn't
+        // either), as the 512-bit accumulators have no Halide type.
+        features += separator + "+power10-vector,+mma,+paired-vector-memops";
+    }
+#endif
+
     return features;
 }
 
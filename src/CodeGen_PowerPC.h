@@ -33,11 +33,23 @@ protected:
     void visit(const Cast *);
     void visit(const Min *);
     void visit(const Max *);
+    void visit(const Call *);
     // @}
 
+    /** Use vmsum for sums of widening products. */
+    void codegen_vector_reduce(const VectorReduce *, const Expr &init) override;
+
     // Call an intrinsic as defined by a pattern. Dispatches to the
 private:
     static const char* altivec_int_type_name(const Type&);
+
+    /** Whether the target has at least the given ISA version. Each
+     * version implies the earlier ones. */
+    // @{
+    bool arch_2_07() const;
+    bool arch_3_00() const;
+    bool arch_3_1() const;
+    // @}
 };
 
 }}
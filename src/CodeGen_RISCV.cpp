@@ -0,0 +1,47 @@
+#include "CodeGen_RISCV.h"
+#include "Util.h"
+#include "LLVM_Headers.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::vector;
+using std::string;
+
+using namespace llvm;
+
+CodeGen_RISCV::CodeGen_RISCV(Target t) : CodeGen_Posix(t) {
+    #if !(WITH_RISCV)
+    user_error << "llvm build not configured with RISCV target enabled.\n";
+    #endif
+    user_assert(llvm_RISCV_enabled) << "llvm build not configured with RISCV target enabled.\n";
+    #if LLVM_VERSION < 130
+    // Older LLVMs have no V extension, and can't be told the range
+    // of vector lengths that lets them lower our fixed-width vectors
+    // to it.
+    user_error << "The RISC-V backend requires Halide to be built with LLVM 13 or later.\n";
+    #endif
+}
+
+string CodeGen_RISCV::mcpu() const {
+    return "";
+}
+
+string CodeGen_RISCV::mattrs() const {
+    // The general purpose extensions (RV64GC), plus the V extension.
+    return "+m,+a,+f,+d,+c,+v";
+}
+
+bool CodeGen_RISCV::use_soft_float_abi() const {
+    return false;
+}
+
+int CodeGen_RISCV::native_vector_bits() const {
+    // The V extension requires registers of at least 128 bits. We
+    // generate fixed-width vectors no wider than that, which run
+    // correctly on any vector length (see
+    // set_function_attributes_for_target).
+    return 128;
+}
+
+}}
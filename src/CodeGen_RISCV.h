@@ -0,0 +1,32 @@
+#ifndef HALIDE_CODEGEN_RISCV_H
+#define HALIDE_CODEGEN_RISCV_H
+
+/** \file
+ * Defines the code-generator for producing RISC-V machine code.
+ */
+
+#include "CodeGen_Posix.h"
+
+namespace Halide {
+namespace Internal {
+
+/** A code generator that emits RISC-V code from a given Halide stmt. */
+class CodeGen_RISCV : public CodeGen_Posix {
+public:
+    /** Create a RISC-V code generator. Vectors are lowered to
+     * instructions from the V extension. */
+    CodeGen_RISCV(Target);
+
+protected:
+
+    using CodeGen_Posix::visit;
+
+    std::string mcpu() const;
+    std::string mattrs() const;
+    bool use_soft_float_abi() const;
+    int native_vector_bits() const;
+};
+
+}}
+
+#endif
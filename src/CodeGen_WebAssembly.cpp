@@ -0,0 +1,47 @@
+#include "CodeGen_WebAssembly.h"
+#include "Util.h"
+#include "LLVM_Headers.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::vector;
+using std::string;
+
+using namespace llvm;
+
+CodeGen_WebAssembly::CodeGen_WebAssembly(Target t) : CodeGen_Posix(t) {
+    #if !(WITH_WEBASSEMBLY)
+    user_error << "llvm build not configured with WebAssembly target enabled.\n";
+    #endif
+    user_assert(llvm_WebAssembly_enabled) << "llvm build not configured with WebAssembly target enabled.\n";
+    #if LLVM_VERSION < 80
+    // The WebAssembly backend of older LLVMs is experimental and has
+    // no SIMD128.
+    user_error << "The WebAssembly backend requires Halide to be built with LLVM 8 or later.\n";
+    #endif
+    user_assert(target.bits == 32) << "Only wasm32 is supported.\n";
+}
+
+string CodeGen_WebAssembly::mcpu() const {
+    return "";
+}
+
+string CodeGen_WebAssembly::mattrs() const {
+    string attrs = "+simd128";
+    if (target.os == Target::Linux) {
+        // The thread pool needs shared memory and atomics.
+        attrs += ",+atomics,+bulk-memory";
+    }
+    return attrs;
+}
+
+bool CodeGen_WebAssembly::use_soft_float_abi() const {
+    return false;
+}
+
+int CodeGen_WebAssembly::native_vector_bits() const {
+    return 128;
+}
+
+}}
@@ -0,0 +1,35 @@
+#ifndef HALIDE_CODEGEN_WEBASSEMBLY_H
+#define HALIDE_CODEGEN_WEBASSEMBLY_H
+
+/** \file
+ * Defines the code-generator for producing WebAssembly machine code.
+ */
+
+#include "CodeGen_Posix.h"
+
+namespace Halide {
+namespace Internal {
+
+/** A code generator that emits WebAssembly code from a given Halide stmt. */
+class CodeGen_WebAssembly : public CodeGen_Posix {
+public:
+    /** Create a WebAssembly code generator. Vectors are lowered to
+     * SIMD128 instructions. Code for the WebAssemblyRuntime OS runs
+     * on a single thread; code for Linux (e.g. emscripten with
+     * pthreads, which are backed by Web Workers) uses shared memory
+     * and atomics so that it can use the thread pool. */
+    CodeGen_WebAssembly(Target);
+
+protected:
+
+    using CodeGen_Posix::visit;
+
+    std::string mcpu() const;
+    std::string mattrs() const;
+    bool use_soft_float_abi() const;
+    int native_vector_bits() const;
+};
+
+}}
+
+#endif
@@ -32,6 +32,13 @@ CodeGen_X86::CodeGen_X86(Target t) : CodeGen_Posix(t) {
 
 namespace {
 
+// Does the target have the AVX512-BW (byte and word) instructions?
+bool has_avx512bw(const Target &t) {
+    return t.features_any_of({Target::AVX512_Skylake,
+                              Target::AVX512_Cannonlake,
+                              Target::AVX512_Cascadelake});
+}
+
 // i32(i16_a)*i32(i16_b) +/- i32(i16_c)*i32(i16_d) can be done by
 // interleaving a, c, and b, d, and then using pmaddwd. We
 // recognize it here, and implement it in the initial module.
@@ -88,6 +95,118 @@ void CodeGen_X86::visit(const Sub *op) {
     }
 }
 
+void CodeGen_X86::codegen_vector_reduce(const VectorReduce *op, const Expr &init) {
+    const int factor = op->value.type().lanes() / op->type.lanes();
+    const int lanes = op->type.lanes();
+
+#if LLVM_VERSION >= 80
+    // AVX512-VNNI vpdpbusd sums groups of four products of unsigned
+    // and signed 8-bit values into each lane of an accumulator, and
+    // vpdpwssd does the same for pairs of products of 16-bit
+    // values. Use them for the first step of reductions by multiples
+    // of four or two.
+    if (target.has_feature(Target::AVX512_Cascadelake) &&
+        op->op == VectorReduce::Add &&
+        op->type.is_int() &&
+        op->type.bits() == 32) {
+        for (int group : {4, 2}) {
+            if (factor % group != 0) {
+                continue;
+            }
+            const int dot_lanes = op->value.type().lanes() / group;
+            Type a_t = (group == 4) ? UInt(8, dot_lanes * 4) : Int(16, dot_lanes * 2);
+            Type b_t = (group == 4) ? Int(8, dot_lanes * 4) : Int(16, dot_lanes * 2);
+            Expr a, b;
+            if (const Mul *mul = op->value.as<Mul>()) {
+                a = lossless_cast(a_t, mul->a);
+                b = lossless_cast(b_t, mul->b);
+                if (!a.defined() || !b.defined()) {
+                    a = lossless_cast(a_t, mul->b);
+                    b = lossless_cast(b_t, mul->a);
+                }
+            } else {
+                // A sum of narrow values is a dot product with ones.
+                a = lossless_cast(a_t, op->value);
+                b = make_one(b_t);
+                if (!a.defined()) {
+                    a = make_one(a_t);
+                    b = lossless_cast(b_t, op->value);
+                }
+            }
+            if (!a.defined() || !b.defined()) {
+                continue;
+            }
+            const bool fold_init = init.defined() && dot_lanes == lanes;
+            if (group == 2 && !fold_init) {
+                // Without an accumulator, pmaddwd is just as good.
+                break;
+            }
+            Type dot_t = op->type.with_lanes(dot_lanes);
+            Expr acc = fold_init ? init : make_zero(dot_t);
+            int intrin_lanes = (dot_lanes >= 16) ? 16 : (dot_lanes >= 8) ? 8 : 4;
+            string name = (group == 4) ? "llvm.x86.avx512.vpdpbusd." : "llvm.x86.avx512.vpdpwssd.";
+            name += std::to_string(intrin_lanes * 32);
+            value = call_intrin(dot_t, intrin_lanes, name,
+                                {acc, reinterpret(dot_t, a), reinterpret(dot_t, b)});
+            if (dot_lanes != lanes) {
+                // Reduce the rest of the way.
+                string dot_name = unique_name('t');
+                sym_push(dot_name, value);
+                Expr rest = VectorReduce::make(VectorReduce::Add, Variable::make(dot_t, dot_name), lanes);
+                if (init.defined()) {
+                    rest = Add::make(init, rest);
+                }
+                value = codegen(rest);
+                sym_pop(dot_name);
+            }
+            return;
+        }
+    }
+#endif
+
+    // pmaddwd sums adjacent pairs of products of 16-bit values. Use
+    // it for the first step of any reduction by an even factor.
+    const int pairs = op->value.type().lanes() / 2;
+    if (op->op == VectorReduce::Add &&
+        factor % 2 == 0 &&
+        op->type.is_int() &&
+        op->type.bits() == 32 &&
+        pairs >= 4) {
+        Type narrow = Int(16, pairs * 2);
+        Expr a, b;
+        if (const Mul *mul = op->value.as<Mul>()) {
+            a = lossless_cast(narrow, mul->a);
+            b = lossless_cast(narrow, mul->b);
+        } else {
+            // A sum of pairs of 16-bit values is a dot product with ones.
+            a = lossless_cast(narrow, op->value);
+            b = make_one(narrow);
+        }
+        if (a.defined() && b.defined()) {
+            string a_name = unique_name('t'), b_name = unique_name('t');
+            Expr a_var = Variable::make(narrow, a_name);
+            Expr b_var = Variable::make(narrow, b_name);
+            vector<Expr> args = {Shuffle::make_slice(a_var, 0, 2, pairs),
+                                 Shuffle::make_slice(b_var, 0, 2, pairs),
+                                 Shuffle::make_slice(a_var, 1, 2, pairs),
+                                 Shuffle::make_slice(b_var, 1, 2, pairs)};
+            Expr result = Call::make(Int(32, pairs), "pmaddwd", args, Call::Extern);
+            if (pairs != lanes) {
+                // Reduce the rest of the way.
+                result = VectorReduce::make(VectorReduce::Add, result, lanes);
+            }
+            if (init.defined()) {
+                result = Add::make(init, result);
+            }
+            result = Let::make(a_name, a, Let::make(b_name, b, result));
+            codegen(result);
+            return;
+        }
+    }
+
+    CodeGen_Posix::codegen_vector_reduce(op, init);
+}
+
 void CodeGen_X86::visit(const GT *op) {
     if (op->type.is_vector()) {
         // Non-native vector widths get legalized poorly by llvm. We
@@ -236,6 +355,14 @@ void CodeGen_X86::visit(const Cast *op) {
         {Target::FeatureEnd, true, UInt(16, 8), 0, "llvm.x86.sse2.psubus.w",
          u16(max(wild_i32x_ - wild_i32x_, 0))},
 
+#if LLVM_VERSION >= 60
+        // Only use the avx512 version if we have > 16 lanes
+        {Target::AVX512_Skylake, true, Int(16, 32), 17, "llvm.x86.avx512.pmulh.w.512",
+         i16((wild_i32x_ * wild_i32x_) / 65536)},
+        {Target::AVX512_Skylake, true, UInt(16, 32), 17, "llvm.x86.avx512.pmulhu.w.512",
+         u16((wild_u32x_ * wild_u32x_) / 65536)},
+#endif
+
         // Only use the avx2 version if we have > 8 lanes
         {Target::AVX2, true, Int(16, 16), 9, "llvm.x86.avx2.pmulh.w",
          i16((wild_i32x_ * wild_i32x_) / 65536)},
@@ -272,7 +399,10 @@ void CodeGen_X86::visit(const Cast *op) {
     for (size_t i = 0; i < sizeof(patterns)/sizeof(patterns[0]); i++) {
         const Pattern &pattern = patterns[i];
 
-        if (!target.has_feature(pattern.feature)) {
+        // AVX512_Skylake stands for any target with AVX512-BW.
+        if (pattern.feature == Target::AVX512_Skylake ?
+            !has_avx512bw(target) :
+            !target.has_feature(pattern.feature)) {
             continue;
         }
 
@@ -342,6 +472,58 @@ Expr CodeGen_X86::mulhi_shr(Expr a, Expr b, int shr) {
 }
 
 void CodeGen_X86::visit(const Call *op) {
+    if (op->is_intrinsic("dynamic_shuffle")) {
+        // A lookup into a table of up to 64 bytes (see
+        // optimize_shuffles). pshufb looks up 16 bytes of the table
+        // at a time, using the low 4 bits of each index. Look up each
+        // 16 bytes of the table in turn, and keep the lookups of the
+        // indices that fall within them.
+        internal_assert(op->args.size() == 4 && op->type.bits() == 8);
+        const int64_t *max_index = as_const_int(op->args[3]);
+        internal_assert(max_index && *max_index < 64);
+        Value *lut = codegen(op->args[0]);
+        Value *idx = codegen(op->args[1]);
+        llvm::Type *i8x16 = VectorType::get(i8_t, 16);
+        int lanes = op->type.lanes();
+        vector<Value *> results;
+        for (int i = 0; i < lanes; i += 16) {
+            Value *idx_i = slice_vector(idx, i, 16);
+            Value *result = nullptr;
+            for (int j = 0; j <= *max_index; j += 16) {
+                Value *lookup = call_intrin(i8x16, 16, "llvm.x86.ssse3.pshuf.b.128",
+                                            {slice_vector(lut, j, 16), idx_i});
+                if (result) {
+                    Value *in_slice = builder->CreateICmpUGE(idx_i, ConstantVector::getSplat(16, ConstantInt::get(i8_t, j)));
+                    result = builder->CreateSelect(in_slice, lookup, result);
+                } else {
+                    result = lookup;
+                }
+            }
+            results.push_back(result);
+        }
+        value = slice_vector(concat_vectors(results), 0, lanes);
+        return;
+    }
+
+#if LLVM_VERSION >= 60
+    if (op->call_type == Call::Extern && op->name == "pmaddwd" &&
+        op->type.lanes() % 8 == 0 &&
+        (has_avx512bw(target) || target.has_feature(Target::AVX2))) {
+        // Use the widest pmaddwd available instead of the 128-bit
+        // versions in x86.ll. The intrinsics take the pairs to multiply
+        // interleaved.
+        internal_assert(op->args.size() == 4);
+        Expr ac = Shuffle::make_interleave({op->args[0], op->args[2]});
+        Expr bd = Shuffle::make_interleave({op->args[1], op->args[3]});
+        if (has_avx512bw(target) && op->type.lanes() % 16 == 0) {
+            value = call_intrin(op->type, 16, "llvm.x86.avx512.pmaddw.d.512", {ac, bd});
+        } else {
+            value = call_intrin(op->type, 8, "llvm.x86.avx2.pmadd.wd", {ac, bd});
+        }
+        return;
+    }
+#endif
+
     constexpr bool need_workaround = LLVM_VERSION < 40;
     if (need_workaround && target.has_feature(Target::AVX2) &&
         op->is_intrinsic(Call::shift_left) &&
@@ -369,9 +551,15 @@ void CodeGen_X86::visit(const Call *op) {
 }
 
 string CodeGen_X86::mcpu() const {
+    // LLVM only knows cascadelake and AVX512-VNNI from LLVM 8 on.
+    // Before that, avx512_cascadelake compiles as avx512_skylake.
+    #if LLVM_VERSION >= 80
+    if (target.has_feature(Target::AVX512_Cascadelake)) return "cascadelake";
+    #endif
     #if LLVM_VERSION >= 40
     if (target.has_feature(Target::AVX512_Cannonlake)) return "cannonlake";
-    if (target.has_feature(Target::AVX512_Skylake)) return "skylake-avx512";
+    if (target.has_feature(Target::AVX512_Skylake) ||
+        target.has_feature(Target::AVX512_Cascadelake)) return "skylake-avx512";
     if (target.has_feature(Target::AVX512_KNL)) return "knl";
     #endif
     if (target.has_feature(Target::AVX2)) return "haswell";
@@ -401,19 +589,24 @@ string CodeGen_X86::mattrs() const {
     if (target.has_feature(Target::AVX512) ||
         target.has_feature(Target::AVX512_KNL) ||
         target.has_feature(Target::AVX512_Skylake) ||
-        target.has_feature(Target::AVX512_Cannonlake)) {
+        target.has_feature(Target::AVX512_Cannonlake) ||
+        target.has_feature(Target::AVX512_Cascadelake)) {
         features += separator + "+avx512f,+avx512cd";
         separator = ",";
         if (target.has_feature(Target::AVX512_KNL)) {
             features += ",+avx512pf,+avx512er";
         }
-        if (target.has_feature(Target::AVX512_Skylake) ||
-            target.has_feature(Target::AVX512_Cannonlake)) {
+        if (has_avx512bw(target)) {
             features += ",+avx512vl,+avx512bw,+avx512dq";
         }
         if (target.has_feature(Target::AVX512_Cannonlake)) {
             features += ",+avx512ifma,+avx512vbmi";
         }
+        #if LLVM_VERSION >= 80
+        if (target.has_feature(Target::AVX512_Cascadelake)) {
+            features += ",+avx512vnni";
+        }
+        #endif
     }
     #endif
     return features;
@@ -427,7 +620,8 @@ int CodeGen_X86::native_vector_bits() const {
     if (target.has_feature(Target::AVX512) ||
         target.has_feature(Target::AVX512_Skylake) ||
         target.has_feature(Target::AVX512_KNL) ||
-        target.has_feature(Target::AVX512_Cannonlake)) {
+        target.has_feature(Target::AVX512_Cannonlake) ||
+        target.has_feature(Target::AVX512_Cascadelake)) {
         return 512;
     } else if (target.has_feature(Target::AVX) ||
                target.has_feature(Target::AVX2)) {
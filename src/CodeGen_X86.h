@@ -47,6 +47,9 @@ protected:
     void visit(const NE *);
     void visit(const Select *);
     // @}
+
+    /** Use pmaddwd for pairwise sums of 16-bit products. */
+    void codegen_vector_reduce(const VectorReduce *, const Expr &init) override;
 };
 
 }}
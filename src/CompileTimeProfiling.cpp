@@ -0,0 +1,221 @@
+#include "CompileTimeProfiling.h"
+#include "Debug.h"
+#include "IRVisitor.h"
+
+#include <iomanip>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+namespace Halide {
+namespace Internal {
+
+namespace {
+
+struct PhaseRecord {
+    std::string profiler, phase;
+    double seconds;
+    int64_t ir_nodes;
+    int64_t peak_memory, peak_memory_increase;
+};
+
+struct CompileTimeProfile {
+    std::mutex mutex;
+    bool enabled = false;
+    std::vector<PhaseRecord> records;
+};
+
+CompileTimeProfile &compile_time_profile() {
+    static CompileTimeProfile *profile = new CompileTimeProfile;
+    return *profile;
+}
+
+// The peak resident memory of the compiler so far, in bytes, or
+// zero if we can't tell.
+int64_t peak_memory() {
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return (int64_t)usage.ru_maxrss;
+#else
+    return (int64_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+// Count the distinct nodes in some IR.
+class CountNodes : public IRGraphVisitor {
+    std::set<const IRNode *> seen;
+
+    using IRGraphVisitor::include;
+
+    void include(const Expr &e) override {
+        seen.insert(e.get());
+        IRGraphVisitor::include(e);
+    }
+
+    void include(const Stmt &s) override {
+        seen.insert(s.get());
+        IRGraphVisitor::include(s);
+    }
+
+public:
+    int64_t count(const Stmt &s) {
+        include(s);
+        return (int64_t)seen.size();
+    }
+};
+
+void write_json_string(std::ostream &out, const std::string &s) {
+    out << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out << '\\';
+        }
+        out << c;
+    }
+    out << '"';
+}
+
+}  // namespace
+
+void set_compile_time_profiling(bool enabled) {
+    CompileTimeProfile &p = compile_time_profile();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    p.enabled = enabled;
+}
+
+bool compile_time_profiling_enabled() {
+    CompileTimeProfile &p = compile_time_profile();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    return p.enabled;
+}
+
+void write_compile_time_report(std::ostream &out, bool json) {
+    CompileTimeProfile &p = compile_time_profile();
+    std::vector<PhaseRecord> records;
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        records.swap(p.records);
+    }
+
+    if (json) {
+        out << "[\n";
+        for (size_t i = 0; i < records.size(); i++) {
+            const PhaseRecord &r = records[i];
+            out << "  {\"profiler\": ";
+            write_json_string(out, r.profiler);
+            out << ", \"phase\": ";
+            write_json_string(out, r.phase);
+            out << ", \"seconds\": " << r.seconds
+                << ", \"ir_nodes\": " << r.ir_nodes
+                << ", \"peak_memory_bytes\": " << r.peak_memory
+                << ", \"peak_memory_increase_bytes\": " << r.peak_memory_increase
+                << "}" << (i + 1 < records.size() ? "," : "") << "\n";
+        }
+        out << "]\n";
+        return;
+    }
+
+    // A table per profiler, with its phases in order. An IR size of
+    // -1 means the phase didn't produce IR to measure.
+    std::string current;
+    double total = 0;
+    for (size_t i = 0; i <= records.size(); i++) {
+        if (i == records.size() || records[i].profiler != current) {
+            if (!current.empty()) {
+                out << "  total: " << std::fixed << std::setprecision(3) << total * 1000 << " ms\n\n";
+            }
+            if (i == records.size()) {
+                break;
+            }
+            current = records[i].profiler;
+            total = 0;
+            out << current << ":\n"
+                << "  " << std::left << std::setw(60) << "phase" << std::right
+                << std::setw(12) << "time (ms)"
+                << std::setw(12) << "IR nodes"
+                << std::setw(14) << "peak (MB)"
+                << std::setw(14) << "+peak (MB)" << "\n";
+        }
+        const PhaseRecord &r = records[i];
+        total += r.seconds;
+        out << "  " << std::left << std::setw(60) << r.phase << std::right
+            << std::fixed << std::setprecision(3)
+            << std::setw(12) << r.seconds * 1000
+            << std::setw(12) << r.ir_nodes
+            << std::setprecision(1)
+            << std::setw(14) << r.peak_memory / (1024.0 * 1024.0)
+            << std::setw(14) << r.peak_memory_increase / (1024.0 * 1024.0) << "\n";
+    }
+}
+
+CompileTimeProfiler::CompileTimeProfiler(const std::string &name)
+    : name(name), start_peak_memory(0), enabled(compile_time_profiling_enabled()) {
+}
+
+CompileTimeProfiler::~CompileTimeProfiler() {
+    end();
+}
+
+void CompileTimeProfiler::record(const Stmt &s, int64_t ir_nodes) {
+    if (!enabled || current_phase.empty()) {
+        return;
+    }
+    // Stop the clock first, so that the phase isn't charged for
+    // measuring its IR.
+    auto now = std::chrono::high_resolution_clock::now();
+    PhaseRecord r;
+    r.profiler = name;
+    r.phase = current_phase;
+    r.seconds = std::chrono::duration<double>(now - start).count();
+    r.ir_nodes = s.defined() ? CountNodes().count(s) : ir_nodes;
+    r.peak_memory = peak_memory();
+    r.peak_memory_increase = r.peak_memory - start_peak_memory;
+    debug(2) << "Compile time of " << name << ": " << current_phase << ": " << r.seconds << " s\n";
+
+    CompileTimeProfile &p = compile_time_profile();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    p.records.push_back(r);
+    current_phase.clear();
+}
+
+void CompileTimeProfiler::begin(const std::string &phase_name) {
+    current_phase = phase_name;
+    start_peak_memory = peak_memory();
+    start = std::chrono::high_resolution_clock::now();
+}
+
+void CompileTimeProfiler::phase(const std::string &phase_name, const Stmt &s) {
+    if (enabled) {
+        record(s, -1);
+        begin(phase_name);
+    }
+}
+
+void CompileTimeProfiler::phase(const std::string &phase_name, int64_t ir_nodes) {
+    if (enabled) {
+        record(Stmt(), ir_nodes);
+        begin(phase_name);
+    }
+}
+
+void CompileTimeProfiler::end(const Stmt &s) {
+    record(s, -1);
+}
+
+void CompileTimeProfiler::end(int64_t ir_nodes) {
+    record(Stmt(), ir_nodes);
+}
+
+}  // namespace Internal
+}  // namespace Halide
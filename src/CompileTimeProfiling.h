@@ -0,0 +1,74 @@
+#ifndef HALIDE_COMPILE_TIME_PROFILING_H
+#define HALIDE_COMPILE_TIME_PROFILING_H
+
+/** \file
+ * Defines a profiler for the compiler itself, which records how long
+ * each lowering pass and llvm phase takes, how large the IR is after
+ * it, and how much it raises the compiler's peak memory use. Turn it
+ * on with the -t flag of a generator, or with
+ * set_compile_time_profiling.
+ */
+
+#include <chrono>
+#include <ostream>
+#include <string>
+
+#include "Expr.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Turn compile time profiling on or off. It is off by default. */
+void set_compile_time_profiling(bool enabled);
+
+/** Is compile time profiling on? */
+bool compile_time_profiling_enabled();
+
+/** Write a report of the phases recorded so far, as a table or as
+ * JSON, and forget them. */
+void write_compile_time_report(std::ostream &out, bool json);
+
+/** Records a sequence of phases of compilation, e.g. the passes of
+ * lowering one pipeline. Does nothing unless compile time profiling
+ * is on. */
+class CompileTimeProfiler {
+    std::string name;
+    std::string current_phase;
+    std::chrono::high_resolution_clock::time_point start;
+    int64_t start_peak_memory;
+    bool enabled;
+
+    void record(const Stmt &s, int64_t ir_nodes);
+    void begin(const std::string &phase_name);
+
+public:
+    CompileTimeProfiler(const std::string &name);
+    ~CompileTimeProfiler();
+
+    /** Is this profiler recording? Useful to skip measuring the IR
+     * when it's not. */
+    bool recording() const {
+        return enabled;
+    }
+
+    /** End the current phase, if there is one, and start a new one.
+     * The Stmt is the IR the ending phase produced, which is
+     * measured for the report. Alternatively the size of the IR can
+     * be given directly, for IR that isn't a Stmt (e.g. the number
+     * of llvm instructions). */
+    // @{
+    void phase(const std::string &phase_name, const Stmt &s = Stmt());
+    void phase(const std::string &phase_name, int64_t ir_nodes);
+    // @}
+
+    /** End the current phase. */
+    // @{
+    void end(const Stmt &s = Stmt());
+    void end(int64_t ir_nodes);
+    // @}
+};
+
+}  // namespace Internal
+}  // namespace Halide
+
+#endif
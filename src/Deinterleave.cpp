@@ -1,5 +1,6 @@
 #include "Deinterleave.h"
 #include "Debug.h"
+#include "ExprUsesVar.h"
 #include "IRMutator.h"
 #include "IROperator.h"
 #include "IREquality.h"
@@ -295,6 +296,23 @@ private:
         }
     }
 
+    Expr visit(const VectorReduce *op) override {
+        if (op->type.is_scalar()) {
+            return op;
+        }
+        // Gather up the groups of input lanes that reduce to the
+        // output lanes we want.
+        int factor = op->value.type().lanes() / op->type.lanes();
+        std::vector<int> indices;
+        for (int i = 0; i < new_lanes; i++) {
+            int lane = i * lane_stride + starting_lane;
+            for (int j = 0; j < factor; j++) {
+                indices.push_back(lane * factor + j);
+            }
+        }
+        return VectorReduce::make(op->op, Shuffle::make({op->value}, indices), new_lanes);
+    }
+
     Expr visit(const Shuffle *op) override {
         if (op->is_interleave()) {
             internal_assert(starting_lane >= 0 && starting_lane < lane_stride);
@@ -370,6 +388,20 @@ Expr extract_mod3_lanes(Expr e, int lane, const Scope<int> &lets) {
     return simplify(e);
 }
 
+namespace {
+// Extract the lanes of a vector from the given lane on, with the
+// given stride between them.
+Expr extract_strided_lanes(Expr e, int lane, int stride, const Scope<int> &lets) {
+    internal_assert(e.type().lanes() % stride == 0);
+    Deinterleaver d(lets);
+    d.starting_lane = lane;
+    d.lane_stride = stride;
+    d.new_lanes = e.type().lanes() / stride;
+    e = d.mutate(e);
+    return simplify(e);
+}
+}
+
 Expr extract_lane(Expr e, int lane) {
     Scope<int> lets;
     Deinterleaver d(lets);
@@ -390,6 +422,11 @@ class Interleaver : public IRMutator2 {
     bool should_deinterleave;
     int num_lanes;
 
+    // The largest number of lanes in each group of a vector that we
+    // deinterleave. Codegen can load strided vectors with dense loads
+    // up to this stride.
+    static const int max_deinterleave_lanes = 8;
+
     Expr deinterleave_expr(Expr e) {
         if (e.type().lanes() <= num_lanes) {
             // Just scalarize
@@ -412,8 +449,14 @@ class Interleaver : public IRMutator2 {
             Expr bb = extract_odd_lanes(b, vector_lets);
             return Shuffle::make_interleave({aa, ba, ab, bb});
         } else {
-            // Give up and don't do anything clever for >4
-            return e;
+            // Deinterleave into one vector per lane of each group,
+            // which codegen loads with a shared set of dense loads.
+            internal_assert(num_lanes <= max_deinterleave_lanes);
+            std::vector<Expr> lanes;
+            for (int i = 0; i < num_lanes; i++) {
+                lanes.push_back(extract_strided_lanes(e, i, num_lanes, vector_lets));
+            }
+            return Shuffle::make_interleave(lanes);
         }
     }
 
@@ -468,7 +511,7 @@ class Interleaver : public IRMutator2 {
 
     Expr visit(const Mod *op) override {
         const Ramp *r = op->a.as<Ramp>();
-        for (int i = 2; i <= 4; ++i) {
+        for (int i = 2; i <= max_deinterleave_lanes; ++i) {
             if (r &&
                 is_const(op->b, i) &&
                 (r->type.lanes() % i) == 0) {
@@ -482,7 +525,7 @@ class Interleaver : public IRMutator2 {
 
     Expr visit(const Div *op) override {
         const Ramp *r = op->a.as<Ramp>();
-        for (int i = 2; i <= 4; ++i) {
+        for (int i = 2; i <= max_deinterleave_lanes; ++i) {
             if (r &&
                 is_const(op->b, i) &&
                 (r->type.lanes() % i) == 0) {
@@ -738,8 +781,215 @@ class Interleaver : public IRMutator2 {
     Interleaver() : should_deinterleave(false) {}
 };
 
+namespace {
+
+// Finds the strided vector loads in an expression that could be done
+// before it, which are the ones that aren't under a condition and don't
+// depend on a variable bound inside the expression.
+class FindStridedLoads : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+
+    Scope<int> lets;
+
+    void visit(const Let *op) override {
+        include(op->value);
+        ScopedBinding<int> bind(lets, op->name, 0);
+        include(op->body);
+    }
+
+    void visit(const Select *op) override {
+        include(op->condition);
+    }
+
+    void visit(const Call *op) override {
+        if (op->is_intrinsic(Call::if_then_else)) {
+            include(op->args[0]);
+        } else {
+            IRGraphVisitor::visit(op);
+        }
+    }
+
+    void visit(const Load *op) override {
+        IRGraphVisitor::visit(op);
+        const Ramp *ramp = op->index.as<Ramp>();
+        const int64_t *stride = ramp ? as_const_int(ramp->stride) : nullptr;
+        if (stride && *stride > 1 && *stride <= 16 &&
+            ramp->lanes * *stride <= 256 &&
+            is_one(op->predicate) &&
+            !expr_uses_vars(ramp->base, lets)) {
+            loads.push_back(op);
+        }
+    }
+
+public:
+    std::vector<const Load *> loads;
+};
+
+// Replaces loads by the exprs in a map.
+class ReplaceLoads : public IRMutator2 {
+    using IRMutator2::visit;
+
+    const std::map<const Load *, Expr> &replacements;
+
+    Expr visit(const Load *op) override {
+        auto it = replacements.find(op);
+        if (it != replacements.end()) {
+            return it->second;
+        }
+        return IRMutator2::visit(op);
+    }
+
+public:
+    ReplaceLoads(const std::map<const Load *, Expr> &r) : replacements(r) {}
+};
+
+// Strided vector loads from the same buffer with the same stride, whose
+// bases differ by less than the stride, together cover a dense range of
+// the buffer. In a sequence of stores, e.g. an unrolled transpose of a
+// block, we load that range once and slice the strided vectors out of
+// it, rather than loading each strided vector from overlapping dense
+// vectors.
+class StageStridedLoads : public IRMutator2 {
+    using IRMutator2::visit;
+
+    struct LoadGroup {
+        const Load *first;
+        int64_t stride;
+        int64_t min_offset, max_offset;
+        std::vector<pair<const Load *, int64_t>> loads;
+    };
+
+    Stmt stage(const std::vector<Stmt> &stores) {
+        std::set<std::string> stored;
+        FindStridedLoads finder;
+        for (const Stmt &s : stores) {
+            const Store *store = s.as<Store>();
+            stored.insert(store->name);
+            store->value.accept(&finder);
+        }
+
+        std::vector<LoadGroup> groups;
+        for (const Load *load : finder.loads) {
+            if (stored.count(load->name)) {
+                continue;
+            }
+            const Ramp *ramp = load->index.as<Ramp>();
+            int64_t stride = *as_const_int(ramp->stride);
+            bool grouped = false;
+            for (LoadGroup &g : groups) {
+                const Ramp *first = g.first->index.as<Ramp>();
+                if (g.first->name != load->name ||
+                    g.first->type != load->type ||
+                    g.stride != stride ||
+                    first->lanes != ramp->lanes) {
+                    continue;
+                }
+                Expr diff = simplify(ramp->base - first->base);
+                const int64_t *offset = as_const_int(diff);
+                if (offset &&
+                    std::max(g.max_offset, *offset) - std::min(g.min_offset, *offset) < stride) {
+                    g.min_offset = std::min(g.min_offset, *offset);
+                    g.max_offset = std::max(g.max_offset, *offset);
+                    g.loads.push_back({load, *offset});
+                    grouped = true;
+                    break;
+                }
+            }
+            if (!grouped) {
+                groups.push_back({load, stride, 0, 0, {{load, 0}}});
+            }
+        }
+
+        std::map<const Load *, Expr> replacements;
+        std::vector<pair<std::string, Expr>> dense_loads;
+        for (const LoadGroup &g : groups) {
+            // Only stage groups that cover the whole dense range, so that
+            // the dense load doesn't read beyond the strided ones.
+            if (g.loads.size() < 2 || g.max_offset - g.min_offset != g.stride - 1) {
+                continue;
+            }
+            const Ramp *first = g.first->index.as<Ramp>();
+            int lanes = first->lanes * (int)g.stride;
+            Expr base = simplify(first->base + (int)g.min_offset);
+            Expr index = Ramp::make(base, make_one(base.type()), lanes);
+            Expr dense = Load::make(g.first->type.with_lanes(lanes), g.first->name, index,
+                                    g.first->image, g.first->param, const_true(lanes));
+            std::string name = unique_name('t');
+            Expr var = Variable::make(dense.type(), name);
+            dense_loads.push_back({name, dense});
+            for (const auto &l : g.loads) {
+                replacements[l.first] = Shuffle::make_slice(var, (int)(l.second - g.min_offset),
+                                                            (int)g.stride, first->lanes);
+            }
+        }
+
+        std::vector<Stmt> result;
+        for (const Stmt &s : stores) {
+            if (replacements.empty()) {
+                result.push_back(s);
+            } else {
+                const Store *store = s.as<Store>();
+                Expr value = ReplaceLoads(replacements).mutate(store->value);
+                result.push_back(Store::make(store->name, value, store->index,
+                                             store->param, store->predicate));
+            }
+        }
+        Stmt stmt = Block::make(result);
+        while (!dense_loads.empty()) {
+            stmt = LetStmt::make(dense_loads.back().first, dense_loads.back().second, stmt);
+            dense_loads.pop_back();
+        }
+        return stmt;
+    }
+
+    Stmt visit(const For *op) override {
+        // GPU kernels are compiled by backends with a limited set of
+        // vector widths, so leave them alone.
+        if (op->device_api != DeviceAPI::None &&
+            op->device_api != DeviceAPI::Host &&
+            op->device_api != DeviceAPI::Hexagon) {
+            return op;
+        }
+        return IRMutator2::visit(op);
+    }
+
+    Stmt visit(const Store *op) override {
+        return stage({op});
+    }
+
+    Stmt visit(const Block *op) override {
+        std::vector<Stmt> stmts;
+        Stmt s = op;
+        while (const Block *b = s.as<Block>()) {
+            stmts.push_back(b->first);
+            s = b->rest;
+        }
+        stmts.push_back(s);
+
+        std::vector<Stmt> result, stores;
+        for (const Stmt &s : stmts) {
+            if (s.as<Store>()) {
+                stores.push_back(s);
+                continue;
+            }
+            if (!stores.empty()) {
+                result.push_back(stage(stores));
+                stores.clear();
+            }
+            result.push_back(mutate(s));
+        }
+        if (!stores.empty()) {
+            result.push_back(stage(stores));
+        }
+        return Block::make(result);
+    }
+};
+
+}  // namespace
+
 Stmt rewrite_interleavings(Stmt s) {
-    return Interleaver().mutate(s);
+    s = Interleaver().mutate(s);
+    return StageStridedLoads().mutate(s);
 }
 
 namespace {
@@ -60,6 +60,19 @@ Dimension Dimension::set_stride(Expr stride) {
     return *this;
 }
 
+Dimension Dimension::set_stride_multiple(int multiple) {
+    user_assert(multiple > 0)
+        << "The stride multiple of dimension " << d << " of " << param.name()
+        << " must be positive, not " << multiple << "\n";
+    user_assert(!param.stride_constraint(d).defined())
+        << "Can't set a stride multiple for dimension " << d << " of " << param.name()
+        << ", which already has the stride constraint " << param.stride_constraint(d) << "\n";
+    if (multiple > 1) {
+        param.set_stride_constraint(d, (stride() / multiple) * multiple);
+    }
+    return *this;
+}
+
 Dimension Dimension::set_bounds(Expr min, Expr extent) {
     return set_min(min).set_extent(extent);
 }
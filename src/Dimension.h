@@ -72,6 +72,23 @@ public:
      * generate better code. */
     EXPORT Dimension set_stride(Expr stride);
 
+    /** Promise that the stride in a given dimension is a multiple of
+     * the given number of elements. This is checked once on entry to
+     * the pipeline. Together with a min that is a multiple of the
+     * vector width and ImageParam::set_host_alignment, it lets the
+     * compiler prove that vector loads and stores in this dimension
+     * are aligned. For example:
+     \code
+     im.set_host_alignment(128);
+     im.dim(0).set_min(0);
+     im.dim(1).set_stride_multiple(128);
+     \endcode
+     * promises that every row of a uint8 image starts on a 128-byte
+     * boundary. This is equivalent to
+     * set_stride((stride()/multiple)*multiple), and can't be combined
+     * with another stride constraint in the same dimension. */
+    EXPORT Dimension set_stride_multiple(int multiple);
+
     /** Set the min and extent in one call. */
     EXPORT Dimension set_bounds(Expr min, Expr extent);
 
@@ -0,0 +1,180 @@
+#include "EmulateBFloat16Math.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+
+namespace Halide {
+namespace Internal {
+
+Expr bfloat16_bits_to_float(Expr bits) {
+    const int lanes = bits.type().lanes();
+    return reinterpret(Float(32, lanes), cast(UInt(32, lanes), std::move(bits)) << 16);
+}
+
+Expr float_to_bfloat16_bits(Expr f) {
+    const Type u32 = UInt(32, f.type().lanes());
+    Expr bits = reinterpret(u32, std::move(f));
+    // Round to nearest with ties going to even.
+    Expr rounded = (bits + (make_const(u32, 0x7fff) + ((bits >> 16) & make_const(u32, 1)))) >> 16;
+    // Rounding a NaN could carry into the exponent, or clear all of
+    // its mantissa, so NaNs are quieted instead.
+    Expr nan = (bits >> 16) | make_const(u32, 0x40);
+    Expr is_nan = (bits & make_const(u32, 0x7fffffff)) > make_const(u32, 0x7f800000);
+    return cast(UInt(16, u32.lanes()), select(is_nan, nan, rounded));
+}
+
+namespace {
+
+Type bits_type(const Type &t) {
+    return t.is_bfloat() ? UInt(16, t.lanes()) : t;
+}
+
+class EmulateBFloat16Math : public IRMutator2 {
+    using IRMutator2::visit;
+
+    Expr widen(const Expr &e) {
+        Expr m = mutate(e);
+        return e.type().is_bfloat() ? bfloat16_bits_to_float(m) : m;
+    }
+
+    Expr narrow(const Type &t, const Expr &e) {
+        return t.is_bfloat() ? float_to_bfloat16_bits(e) : e;
+    }
+
+    // Arithmetic and comparisons of bfloats are done in float.
+    template<typename T>
+    Expr visit_binary(const T *op) {
+        if (!op->a.type().is_bfloat()) {
+            return IRMutator2::visit(op);
+        }
+        return narrow(op->type, T::make(widen(op->a), widen(op->b)));
+    }
+
+    Expr visit(const Add *op) override { return visit_binary(op); }
+    Expr visit(const Sub *op) override { return visit_binary(op); }
+    Expr visit(const Mul *op) override { return visit_binary(op); }
+    Expr visit(const Div *op) override { return visit_binary(op); }
+    Expr visit(const Mod *op) override { return visit_binary(op); }
+    Expr visit(const Min *op) override { return visit_binary(op); }
+    Expr visit(const Max *op) override { return visit_binary(op); }
+    Expr visit(const EQ *op) override { return visit_binary(op); }
+    Expr visit(const NE *op) override { return visit_binary(op); }
+    Expr visit(const LT *op) override { return visit_binary(op); }
+    Expr visit(const LE *op) override { return visit_binary(op); }
+    Expr visit(const GT *op) override { return visit_binary(op); }
+    Expr visit(const GE *op) override { return visit_binary(op); }
+
+    Expr visit(const Cast *op) override {
+        const Type &from = op->value.type();
+        if (!from.is_bfloat() && !op->type.is_bfloat()) {
+            return IRMutator2::visit(op);
+        }
+        Expr value = widen(op->value);
+        if (op->type.is_bfloat()) {
+            return float_to_bfloat16_bits(cast(Float(32, op->type.lanes()), value));
+        } else {
+            return cast(op->type, value);
+        }
+    }
+
+    Expr visit(const FloatImm *op) override {
+        if (!op->type.is_bfloat()) {
+            return op;
+        }
+        return make_const(UInt(16), bfloat16_t(op->value).to_bits());
+    }
+
+    Expr visit(const Variable *op) override {
+        if (!op->type.is_bfloat()) {
+            return op;
+        }
+        return Variable::make(bits_type(op->type), op->name, op->image, op->param, op->reduction_domain);
+    }
+
+    Expr visit(const Load *op) override {
+        if (!op->type.is_bfloat()) {
+            return IRMutator2::visit(op);
+        }
+        return Load::make(bits_type(op->type), op->name, mutate(op->index),
+                          op->image, op->param, mutate(op->predicate));
+    }
+
+    Expr visit(const Ramp *op) override {
+        if (!op->type.is_bfloat()) {
+            return IRMutator2::visit(op);
+        }
+        return narrow(op->type, Ramp::make(widen(op->base), widen(op->stride), op->lanes));
+    }
+
+    Expr visit(const VectorReduce *op) override {
+        if (!op->type.is_bfloat()) {
+            return IRMutator2::visit(op);
+        }
+        return narrow(op->type, VectorReduce::make(op->op, widen(op->value), op->type.lanes()));
+    }
+
+    Expr visit(const Call *op) override {
+        bool uses_bfloat = op->type.is_bfloat();
+        for (const Expr &arg : op->args) {
+            uses_bfloat |= arg.type().is_bfloat();
+        }
+        if (!uses_bfloat) {
+            return IRMutator2::visit(op);
+        }
+
+        std::vector<Expr> args;
+        if (op->is_intrinsic(Call::reinterpret)) {
+            // Reinterpreting to or from a bfloat is a no-op on the
+            // bits.
+            Expr value = mutate(op->args[0]);
+            if (value.type() == bits_type(op->type)) {
+                return value;
+            }
+            return reinterpret(bits_type(op->type), value);
+        } else if (op->is_intrinsic(Call::abs) && op->args[0].type().is_bfloat()) {
+            Expr value = mutate(op->args[0]);
+            return value & make_const(value.type(), 0x7fff);
+        } else if (op->is_intrinsic(Call::likely) ||
+                   op->is_intrinsic(Call::likely_if_innermost) ||
+                   op->is_intrinsic(Call::return_second) ||
+                   op->is_intrinsic(Call::if_then_else) ||
+                   op->is_intrinsic(Call::require) ||
+                   op->is_intrinsic(Call::make_struct) ||
+                   op->is_intrinsic(Call::nontemporal)) {
+            // These just pass values through, so they work on the bits.
+            for (const Expr &arg : op->args) {
+                args.push_back(mutate(arg));
+            }
+            return Call::make(bits_type(op->type), op->name, args, op->call_type,
+                              op->func, op->value_index, op->image, op->param);
+        } else if (op->is_intrinsic(Call::lerp) || op->is_intrinsic(Call::absd)) {
+            for (const Expr &arg : op->args) {
+                args.push_back(widen(arg));
+            }
+            Type t = op->type.is_bfloat() ? Float(32, op->type.lanes()) : op->type;
+            return narrow(op->type, Call::make(t, op->name, args, op->call_type,
+                                               op->func, op->value_index, op->image, op->param));
+        }
+        user_error << "bfloat16 isn't supported by " << op->name << "\n";
+        return Expr();
+    }
+
+    Stmt visit(const Allocate *op) override {
+        Stmt s = IRMutator2::visit(op);
+        if (!op->type.is_bfloat()) {
+            return s;
+        }
+        op = s.as<Allocate>();
+        internal_assert(op);
+        return Allocate::make(op->name, bits_type(op->type), op->memory_type, op->extents,
+                              op->condition, op->body, op->new_expr, op->free_function);
+    }
+};
+
+}  // namespace
+
+Stmt emulate_bfloat16_math(const Stmt &s) {
+    return EmulateBFloat16Math().mutate(s);
+}
+
+}
+}
@@ -0,0 +1,32 @@
+#ifndef HALIDE_EMULATE_BFLOAT16_MATH_H
+#define HALIDE_EMULATE_BFLOAT16_MATH_H
+
+/** \file
+ * Defines the lowering pass that does bfloat16 arithmetic in float.
+ */
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Replace every bfloat16 value with its bits, as a uint16. Loads,
+ * stores, and the movement of values between vector lanes don't
+ * change, and arithmetic is done by widening the operands to float
+ * (a shift) and rounding the result back to bfloat16, to nearest with
+ * ties to even. None of the backends see a bfloat16 afterwards. Should
+ * be run after vectorization, so that the conversions are vectorized
+ * along with everything else. */
+Stmt emulate_bfloat16_math(const Stmt &s);
+
+/** Convert the bits of a bfloat16 to a float, and a float to the bits
+ * of the nearest bfloat16. */
+// @{
+Expr bfloat16_bits_to_float(Expr bits);
+Expr float_to_bfloat16_bits(Expr f);
+// @}
+
+}
+}
+
+#endif
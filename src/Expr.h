@@ -65,6 +65,8 @@ enum class IRNodeType {
     Evaluate,
     Shuffle,
     Prefetch,
+    Atomic,
+    VectorReduce,
 };
 
 /** The abstract base classes for a node in the Halide IR. */
@@ -78,6 +80,15 @@ struct IRNode {
     IRNode(IRNodeType t) : node_type(t) {}
     virtual ~IRNode() {}
 
+    /** IR nodes are created and destroyed at a high rate while
+     * lowering, so the memory of freed nodes is kept in a per-thread
+     * cache for each size, to be reused by the next node of that
+     * size. */
+    // @{
+    EXPORT static void *operator new(size_t size);
+    EXPORT static void operator delete(void *ptr, size_t size);
+    // @}
+
     /** These classes are all managed with intrusive reference
      * counting, so we also track a reference count. It's mutable
      * so that we can do reference counting even through const
@@ -236,7 +247,11 @@ struct FloatImm : public ExprNode<FloatImm> {
         node->type = t;
         switch (t.bits()) {
         case 16:
-            node->value = (double)((float16_t)value);
+            if (t.is_bfloat()) {
+                node->value = (double)((bfloat16_t)value);
+            } else {
+                node->value = (double)((float16_t)value);
+            }
             break;
         case 32:
             node->value = (float)value;
@@ -291,6 +306,7 @@ struct Expr : public Internal::IRHandle {
     EXPORT explicit Expr(uint32_t x)  : IRHandle(Internal::UIntImm::make(UInt(32), x)) {}
     EXPORT explicit Expr(uint64_t x)  : IRHandle(Internal::UIntImm::make(UInt(64), x)) {}
     EXPORT          Expr(float16_t x) : IRHandle(Internal::FloatImm::make(Float(16), (double)x)) {}
+    EXPORT          Expr(bfloat16_t x) : IRHandle(Internal::FloatImm::make(BFloat(16), (double)x)) {}
     EXPORT          Expr(float x)     : IRHandle(Internal::FloatImm::make(Float(32), x)) {}
     EXPORT explicit Expr(double x)    : IRHandle(Internal::FloatImm::make(Float(64), x)) {}
     // @}
@@ -338,17 +354,55 @@ const DeviceAPI all_device_apis[] = {DeviceAPI::None,
                                      DeviceAPI::Metal,
                                      DeviceAPI::Hexagon};
 
+/** An enum describing different address spaces to be used with
+ * Func::store_in. */
+enum class MemoryType {
+    /** Let Halide select a storage type automatically */
+    Auto,
+
+    /** Heap/global memory. Allocated using halide_malloc, or
+     * halide_device_malloc */
+    Heap,
+
+    /** Stack memory. Allocated using alloca. Requires a constant
+     * size. Corresponds to per-thread local memory on the GPU. If all
+     * accesses are at constant coordinates, may be promoted into the
+     * register file at the discretion of the register allocator. */
+    Stack,
+
+    /** Register memory. The allocation should be promoted into the
+     * register file. All stores must be at constant coordinates. May
+     * be promoted into the register file at the discretion of the
+     * register allocator. On the CPU this is equivalent to Stack. */
+    Register,
+
+    /** Allocation is stored in GPU shared memory. Also known as
+     * "local" in OpenCL, and "threadgroup" in metal. Can be shared
+     * across GPU threads within the same block. */
+    GPUShared,
+
+    /** Allocation is stored in Hexagon's vector tightly coupled
+     * memory (VTCM), allocated using halide_vtcm_malloc. Requires
+     * HVX v65 or later. Vector loads and stores at scattered
+     * coordinates of VTCM allocations of 16- or 32-bit values use
+     * the HVX gather and scatter instructions. */
+    VTCM,
+};
+
 namespace Internal {
 
 /** An enum describing a type of loop traversal. Used in schedules, and in
- * the For loop IR node. GPUBlock and GPUThread are implicitly parallel */
+ * the For loop IR node. GPUBlock, GPUThread, and GPULane are implicitly
+ * parallel. GPULane is a loop over the innermost GPU thread index whose
+ * iterations can communicate through warp shuffles. */
 enum class ForType {
     Serial,
     Parallel,
     Vectorized,
     Unrolled,
     GPUBlock,
-    GPUThread
+    GPUThread,
+    GPULane
 };
 
 
@@ -117,6 +117,57 @@ private:
 
 static_assert(sizeof(float16_t) == 2, "float16_t should occupy two bytes");
 
+/** Class that provides a type that implements brain floating point
+ *  (bfloat16) in software. A bfloat16 is the high 16 bits of a
+ *  float, so it has the same range as a float with 8 bits of
+ *  precision.
+ *
+ *  Like float16_t, this holds nothing but the raw bits, so it can be
+ *  used as the element type of a Buffer.
+ * */
+struct bfloat16_t {
+    /** Construct from a float, double, or int using
+     * round-to-nearest-ties-to-even. */
+    // @{
+    EXPORT explicit bfloat16_t(float value);
+    EXPORT explicit bfloat16_t(double value);
+    EXPORT explicit bfloat16_t(int value);
+    // @}
+
+    /** Construct a bfloat16_t with the bits initialised to 0. This
+     * represents positive zero. */
+    EXPORT bfloat16_t();
+
+    /** Cast to float or double, which are exact. */
+    // @{
+    EXPORT explicit operator float() const;
+    EXPORT explicit operator double() const;
+    // @}
+
+    EXPORT bfloat16_t(const bfloat16_t&) = default;
+    EXPORT bfloat16_t& operator=(const bfloat16_t&) = default;
+
+    /** Get a new bfloat16_t with the given raw bits. */
+    EXPORT static bfloat16_t make_from_bits(uint16_t bits);
+
+    /** Comparison operators */
+    // @{
+    EXPORT bool operator==(bfloat16_t rhs) const { return (float)*this == (float)rhs; }
+    EXPORT bool operator!=(bfloat16_t rhs) const { return !(*this == rhs); }
+    EXPORT bool operator<(bfloat16_t rhs) const { return (float)*this < (float)rhs; }
+    EXPORT bool operator>(bfloat16_t rhs) const { return (float)*this > (float)rhs; }
+    // @}
+
+    /** Returns the bits that represent this bfloat16_t. */
+    EXPORT uint16_t to_bits() const;
+
+private:
+    // The raw bits.
+    uint16_t data;
+};
+
+static_assert(sizeof(bfloat16_t) == 2, "bfloat16_t should occupy two bytes");
+
 }  // namespace Halide
 
 template<>
@@ -124,4 +175,9 @@ HALIDE_ALWAYS_INLINE halide_type_t halide_type_of<Halide::float16_t>() {
     return halide_type_t(halide_type_float, 16);
 }
 
+template<>
+HALIDE_ALWAYS_INLINE halide_type_t halide_type_of<Halide::bfloat16_t>() {
+    return halide_type_t(halide_type_bfloat, 16);
+}
+
 #endif
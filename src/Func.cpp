@@ -287,14 +287,18 @@ void Stage::set_dim_type(VarOrRVar var, ForType t) {
             // validate that this doesn't introduce a race condition.
             if (!dims[i].is_pure() && var.is_rvar &&
                 (t == ForType::Vectorized || t == ForType::Parallel ||
-                 t == ForType::GPUBlock || t == ForType::GPUThread)) {
-                user_assert(definition.schedule().allow_race_conditions())
+                 t == ForType::GPUBlock || t == ForType::GPUThread ||
+                 t == ForType::GPULane)) {
+                user_assert(definition.schedule().allow_race_conditions() ||
+                            definition.schedule().atomic())
                     << "In schedule for " << stage_name
                     << ", marking var " << var.name()
                     << " as parallel or vectorized may introduce a race"
                     << " condition resulting in incorrect output."
                     << " It is possible to override this error using"
-                    << " the allow_race_conditions() method. Use this"
+                    << " the allow_race_conditions() method, or, if"
+                    << " the update is a reduction, by making it atomic()"
+                    << " first. Use allow_race_conditions()"
                     << " with great caution, and only when you are willing"
                     << " to accept non-deterministic output, or you can prove"
                     << " that any race conditions in this code do not change"
@@ -890,6 +894,196 @@ Func Stage::rfactor(vector<pair<RVar, Var>> preserved) {
     return intm;
 }
 
+namespace {
+
+/** Replace the self-references in the update definition of a scan
+ * that load the previous point with loads of the point being
+ * updated. Self-references at any other site are reported in
+ * 'other_sites'. */
+class ReplacePreviousPoint : public IRMutator2 {
+    using IRMutator2::visit;
+
+    const string &func;
+    const vector<Expr> &prev_args, &args;
+
+    Expr visit(const Call *op) override {
+        Expr expr = IRMutator2::visit(op);
+        op = expr.as<Call>();
+        internal_assert(op);
+        if (op->call_type == Call::Halide && op->name == func) {
+            bool is_prev = op->args.size() == prev_args.size();
+            for (size_t i = 0; is_prev && i < prev_args.size(); i++) {
+                is_prev = can_prove(op->args[i] == prev_args[i]);
+            }
+            if (is_prev) {
+                return Call::make(op->type, op->name, args, op->call_type,
+                                  op->func, op->value_index, op->image, op->param);
+            }
+            other_sites = true;
+        }
+        return expr;
+    }
+
+public:
+    bool other_sites = false;
+    ReplacePreviousPoint(const string &func, const vector<Expr> &prev_args, const vector<Expr> &args)
+        : func(func), prev_args(prev_args), args(args) {}
+};
+
+}  // anonymous namespace
+
+Func Stage::scan(RVar r, Var u, Expr factor) {
+    user_assert(!definition.is_init()) << "scan() must be called on an update definition\n";
+
+    string func_name;
+    {
+        vector<std::string> tmp = split_string(stage_name, ".update(");
+        internal_assert(!tmp.empty() && !tmp[0].empty());
+        func_name = tmp[0];
+    }
+
+    vector<Expr> &args = definition.args();
+    vector<Expr> &values = definition.values();
+    const vector<ReductionVariable> &rvars = definition.schedule().rvars();
+
+    user_assert(rvars.size() == 1 && var_name_match(rvars[0].var, r.name()))
+        << "In schedule for " << stage_name
+        << ", can't perform scan() on " << r.name()
+        << " since it is not the only dimension of the reduction domain\n"
+        << dump_argument_list();
+    user_assert(is_one(simplify(definition.predicate())))
+        << "In schedule for " << stage_name
+        << ", can't perform scan() since the reduction domain has a predicate\n";
+    const ReductionVariable &rv = rvars[0];
+    Expr rvar = Variable::make(Int(32), rv.var);
+
+    // Find the argument that is the RVar. The others must be the pure
+    // Vars of the Func.
+    int scan_dim = -1;
+    vector<Var> other_vars;
+    for (size_t i = 0; i < args.size(); i++) {
+        const Variable *v = args[i].as<Variable>();
+        if (v && v->name == rv.var) {
+            user_assert(scan_dim == -1)
+                << "In schedule for " << stage_name
+                << ", can't perform scan() since " << r.name()
+                << " is used as more than one argument\n";
+            scan_dim = (int)i;
+        } else {
+            user_assert(v && i < dim_vars.size() && v->name == dim_vars[i].name())
+                << "In schedule for " << stage_name
+                << ", can't perform scan() since argument " << i
+                << " is neither " << r.name() << " nor a pure Var\n";
+            other_vars.push_back(dim_vars[i]);
+        }
+    }
+    user_assert(scan_dim != -1)
+        << "In schedule for " << stage_name
+        << ", can't perform scan() since " << r.name()
+        << " is not one of the arguments\n";
+
+    // Rewrite the loads of the previous point as loads of this point,
+    // so that the update looks like a reduction onto a single site,
+    // and check its operator is associative.
+    vector<Expr> prev_args = args;
+    prev_args[scan_dim] = rvar - 1;
+    ReplacePreviousPoint replacer(func_name, prev_args, args);
+    vector<Expr> replaced(values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        replaced[i] = replacer.mutate(values[i]);
+    }
+    user_assert(!replacer.other_sites)
+        << "In schedule for " << stage_name
+        << ", can't perform scan() since the update loads from " << func_name
+        << " at sites other than the previous point along " << r.name() << "\n";
+
+    const auto &prover_result = prove_associativity(func_name, args, replaced);
+    user_assert(prover_result.associative())
+        << "Failed to call scan() on " << stage_name
+        << " since it can't prove associativity of the operator\n";
+    internal_assert(prover_result.size() == values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        user_assert(!prover_result.xs[i].var.empty())
+            << "Failed to call scan() on " << stage_name
+            << " since the value at index " << i
+            << " doesn't depend on the value at the previous point\n";
+    }
+
+    // Combine two partial results with the operator.
+    auto combine = [&](const vector<Expr> &x, const vector<Expr> &y) {
+        map<string, Expr> replacements;
+        for (size_t i = 0; i < values.size(); i++) {
+            replacements.emplace(prover_result.xs[i].var, x[i]);
+            if (!prover_result.ys[i].var.empty()) {
+                replacements.emplace(prover_result.ys[i].var, y[i]);
+            }
+        }
+        vector<Expr> result(values.size());
+        for (size_t i = 0; i < values.size(); i++) {
+            result[i] = substitute(replacements, prover_result.pattern.ops[i]);
+        }
+        return result;
+    };
+
+    Func intm(func_name + "_scan");
+    auto intm_at = [&](Expr v, Expr block) {
+        vector<Expr> intm_args(other_vars.begin(), other_vars.end());
+        intm_args.push_back(v);
+        intm_args.push_back(block);
+        return intm_args;
+    };
+    auto load_intm = [&](Expr v, Expr block) {
+        vector<Expr> result(values.size());
+        for (size_t i = 0; i < values.size(); i++) {
+            result[i] = Call::make(intm.function(), intm_at(v, block), i);
+        }
+        return result;
+    };
+
+    Expr num_blocks = (rv.extent + factor - 1) / factor;
+
+    Var v;
+    vector<Var> init_args = other_vars;
+    init_args.push_back(v);
+    init_args.push_back(u);
+    intm(init_args) = Tuple(prover_result.pattern.identities);
+
+    // Scan each block.
+    RDom ri(0, factor, func_name + "_scan_ri");
+    ri.where(u * factor + ri < rv.extent);
+    {
+        vector<Expr> terms(values.size());
+        for (size_t i = 0; i < values.size(); i++) {
+            terms[i] = substitute(rv.var, rv.min + u * factor + ri, prover_result.ys[i].expr);
+        }
+        intm(intm_at(ri, u)) = Tuple(combine(load_intm(ri - 1, u), terms));
+    }
+
+    // Accumulate the totals of the blocks.
+    RDom rb(1, num_blocks - 1, func_name + "_scan_rb");
+    intm(intm_at(factor, rb)) = Tuple(combine(load_intm(factor, rb - 1),
+                                              load_intm(factor - 1, rb - 1)));
+
+    // Each point is now the value before the start of the domain,
+    // combined with the totals of the preceding blocks and the scan
+    // within its own block.
+    vector<Expr> start(values.size());
+    vector<Expr> start_args = args;
+    start_args[scan_dim] = rv.min - 1;
+    for (size_t i = 0; i < values.size(); i++) {
+        start[i] = Call::make(intm.output_types()[i], func_name,
+                              start_args, Call::CallType::Halide,
+                              FunctionPtr(), i);
+    }
+    Expr block = (rvar - rv.min) / factor;
+    Expr within = (rvar - rv.min) % factor;
+    vector<Expr> new_values = combine(combine(start, load_intm(factor, block)),
+                                      load_intm(within, block));
+    values.swap(new_values);
+
+    return intm;
+}
+
 void Stage::split(const string &old, const string &outer, const string &inner, Expr factor, bool exact, TailStrategy tail) {
     debug(4) << "In schedule for " << stage_name << ", split " << old << " into "
              << outer << " and " << inner << " with factor of " << factor << "\n";
@@ -937,6 +1131,10 @@ void Stage::split(const string &old, const string &outer, const string &inner, E
         // Select a tail strategy
         if (exact) {
             tail = TailStrategy::GuardWithIf;
+        } else if (definition.values().empty()) {
+            // It's an extern stage. The last call just gets a smaller
+            // tile, rather than recomputing some of the one before.
+            tail = TailStrategy::GuardWithIf;
         } else if (!definition.is_init()) {
             tail = TailStrategy::RoundUp;
         } else {
@@ -990,9 +1188,9 @@ void Stage::split(const string &old, const string &outer, const string &inner, E
     }
 
     if (exact) {
-        user_assert(tail == TailStrategy::GuardWithIf)
+        user_assert(tail == TailStrategy::GuardWithIf || tail == TailStrategy::Predicate)
             << "When splitting Var " << old_name
-            << " the tail strategy must be GuardWithIf or Auto. "
+            << " the tail strategy must be GuardWithIf, Predicate, or Auto. "
             << "Anything else may change the meaning of the algorithm\n";
     }
 
@@ -1127,6 +1325,21 @@ Stage Stage::specialize(Expr condition) {
     return Stage(s.definition, stage_name, dim_vars, func_schedule);
 }
 
+Stage Stage::specialize_for_target_features(const std::vector<Target::Feature> &features) {
+    user_assert(!features.empty())
+        << "Argument passed to specialize_for_target_features must not be empty.\n";
+    uint64_t mask = 0;
+    for (Target::Feature f : features) {
+        user_assert(Internal::arch_of_runtime_detected_feature(f) != Target::ArchUnknown)
+            << "In specialization of " << stage_name << ", the runtime cannot detect the target feature "
+            << Internal::target_feature_name(f) << ".\n";
+        mask |= ((uint64_t)1) << f;
+    }
+    Expr condition = Call::make(Int(32), "halide_can_use_target_features",
+                                {make_const(UInt(64), mask)}, Call::Extern) != 0;
+    return specialize(condition);
+}
+
 void Stage::specialize_fail(const std::string &message) {
     user_assert(!message.empty()) << "Argument passed to specialize_fail() must not be empty.\n";
     const vector<Specialization> &specializations = definition.specializations();
@@ -1367,6 +1580,55 @@ Stage &Stage::allow_race_conditions() {
     return *this;
 }
 
+Stage &Stage::atomic(bool override_associativity_test) {
+    user_assert(!definition.is_init())
+        << "In schedule for " << stage_name
+        << ", atomic() must be called on an update definition.\n";
+    user_assert(definition.values().size() == 1)
+        << "In schedule for " << stage_name
+        << ", can't make an update of a Tuple-valued Func atomic.\n";
+
+    if (!override_associativity_test) {
+        string func_name;
+        {
+            vector<std::string> tmp = split_string(stage_name, ".update(");
+            internal_assert(!tmp.empty() && !tmp[0].empty());
+            func_name = tmp[0];
+        }
+
+        const auto &prover_result = prove_associativity(func_name, definition.args(), definition.values());
+        user_assert(prover_result.associative() && prover_result.commutative())
+            << "In schedule for " << stage_name
+            << ", can't make the update atomic, since it can't prove that the operator "
+            << "is associative and commutative. If you're sure it's safe "
+            << "to reorder the updates, call atomic(true) to skip this check.\n";
+    }
+
+    definition.schedule().atomic() = true;
+    definition.schedule().override_atomic_associativity_test() = override_associativity_test;
+    return *this;
+}
+
+Stage &Stage::distribute(Var var) {
+    bool found = false;
+    for (const Dim &dim : definition.schedule().dims()) {
+        if (var_name_match(dim.var, var.name())) {
+            user_assert(dim.dim_type == Dim::PureVar)
+                << "In schedule for " << stage_name
+                << ", can't distribute " << var.name()
+                << ", because it is not a pure Var.\n";
+            definition.schedule().distributed() = dim.var;
+            found = true;
+        }
+    }
+    user_assert(found)
+        << "In schedule for " << stage_name
+        << ", could not find dimension " << var.name()
+        << " to distribute.\n"
+        << dump_argument_list();
+    return *this;
+}
+
 Stage &Stage::serial(VarOrRVar var) {
     set_dim_type(var, ForType::Serial);
     return *this;
@@ -1526,6 +1788,12 @@ Stage &Stage::gpu_threads(VarOrRVar tx, VarOrRVar ty, VarOrRVar tz, DeviceAPI de
     return *this;
 }
 
+Stage &Stage::gpu_lanes(VarOrRVar tx, DeviceAPI device_api) {
+    set_dim_device_api(tx, device_api);
+    set_dim_type(tx, ForType::GPULane);
+    return *this;
+}
+
 Stage &Stage::gpu_blocks(VarOrRVar bx, DeviceAPI device_api) {
     set_dim_device_api(bx, device_api);
     set_dim_type(bx, ForType::GPUBlock);
@@ -1926,9 +2194,43 @@ Func &Func::allow_race_conditions() {
     return *this;
 }
 
-Func &Func::memoize() {
+Func &Func::memoize(int eviction_priority) {
     invalidate_cache();
     func.schedule().memoized() = true;
+    func.schedule().memoize_eviction_priority() = eviction_priority;
+    return *this;
+}
+
+Func &Func::async() {
+    invalidate_cache();
+    func.schedule().async() = true;
+    return *this;
+}
+
+Func &Func::double_buffer() {
+    invalidate_cache();
+    func.schedule().double_buffer() = true;
+    return *this;
+}
+
+Func &Func::gpu_max_registers(int registers) {
+    user_assert(registers > 0 && registers <= 255)
+        << "Func " << name() << " can't use " << registers
+        << " registers per thread. The budget must be between 1 and 255.\n";
+    invalidate_cache();
+    func.schedule().gpu_max_registers() = registers;
+    return *this;
+}
+
+Func &Func::store_streaming() {
+    invalidate_cache();
+    func.schedule().store_streaming() = true;
+    return *this;
+}
+
+Func &Func::store_interleaved() {
+    invalidate_cache();
+    func.schedule().store_interleaved() = true;
     return *this;
 }
 
@@ -1937,6 +2239,11 @@ Stage Func::specialize(Expr c) {
     return Stage(func.definition(), name(), args(), func.schedule()).specialize(c);
 }
 
+Stage Func::specialize_for_target_features(const std::vector<Target::Feature> &features) {
+    invalidate_cache();
+    return Stage(func.definition(), name(), args(), func.schedule()).specialize_for_target_features(features);
+}
+
 void Func::specialize_fail(const std::string &message) {
     invalidate_cache();
     (void) Stage(func.definition(), name(), args(), func.schedule()).specialize_fail(message);
@@ -1954,6 +2261,12 @@ Func &Func::parallel(VarOrRVar var) {
     return *this;
 }
 
+Func &Func::distribute(Var var) {
+    invalidate_cache();
+    Stage(func.definition(), name(), args(), func.schedule()).distribute(var);
+    return *this;
+}
+
 Func &Func::vectorize(VarOrRVar var) {
     invalidate_cache();
     Stage(func.definition(), name(), args(), func.schedule()).vectorize(var);
@@ -2112,6 +2425,12 @@ Func &Func::gpu_blocks(VarOrRVar bx, VarOrRVar by, VarOrRVar bz, DeviceAPI devic
     return *this;
 }
 
+Func &Func::gpu_lanes(VarOrRVar tx, DeviceAPI device_api) {
+    invalidate_cache();
+    Stage(func.definition(), name(), args(), func.schedule()).gpu_lanes(tx, device_api);
+    return *this;
+}
+
 Func &Func::gpu_single_thread(DeviceAPI device_api) {
     invalidate_cache();
     Stage(func.definition(), name(), args(), func.schedule()).gpu_single_thread(device_api);
@@ -2336,6 +2655,21 @@ Func &Func::align_storage(Var dim, Expr alignment) {
     return *this;
 }
 
+Func &Func::tile_storage(Var dim, Expr factor) {
+    invalidate_cache();
+
+    vector<StorageDim> &dims = func.schedule().storage_dims();
+    for (size_t i = 0; i < dims.size(); i++) {
+        if (var_name_match(dims[i].var, dim.name())) {
+            dims[i].tile_factor = factor;
+            return *this;
+        }
+    }
+    user_error << "Could not find variable " << dim.name()
+               << " to tile the storage of.\n";
+    return *this;
+}
+
 Func &Func::fold_storage(Var dim, Expr factor, bool fold_forward) {
     invalidate_cache();
 
@@ -2375,6 +2709,16 @@ Func &Func::compute_root() {
     return compute_at(LoopLevel::root());
 }
 
+Func &Func::compute_with(LoopLevel loop_level) {
+    invalidate_cache();
+    func.schedule().fuse_level() = loop_level;
+    return *this;
+}
+
+Func &Func::compute_with(Func f, Var var) {
+    return compute_with(LoopLevel(f, var));
+}
+
 Func &Func::store_at(LoopLevel loop_level) {
     invalidate_cache();
     func.schedule().store_level() = loop_level;
@@ -2393,6 +2737,12 @@ Func &Func::store_root() {
     return store_at(LoopLevel::root());
 }
 
+Func &Func::store_in(MemoryType t) {
+    invalidate_cache();
+    func.schedule().memory_type() = t;
+    return *this;
+}
+
 Func &Func::compute_inline() {
     return compute_at(LoopLevel::inlined());
 }
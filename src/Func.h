@@ -171,6 +171,53 @@ public:
     EXPORT Func rfactor(RVar r, Var v);
     // @}
 
+    /** Calling scan() on an update definition that is a recurrence
+     * over a one-dimensional reduction domain, where each point
+     * combines the value at the previous point with some new term
+     * using an associative operator, rewrites it as a blocked scan
+     * that can be computed in parallel. For example, a cumulative
+     * sum:
+     \code
+     f(x) = 0;
+     f(r) = f(r - 1) + g(r);
+     \endcode
+     * is split into blocks of 'factor' points. The scan within each
+     * block, and the running total at the start of each block, are
+     * computed by a new intermediate Func, which is returned. The
+     * blocks are indexed by the new pure Var 'u'. Calling
+     * f.update(0).scan(r, u, 64) rewrites the pipeline above into:
+     \code
+     f_scan(v, u) = 0;
+     // Scan each block independently.
+     f_scan(ri, u) = f_scan(ri - 1, u) + g(ri + u * 64);
+     // Compute the total of all preceding blocks, stored just past
+     // the end of each block.
+     f_scan(64, rb) = f_scan(64, rb - 1) + f_scan(63, rb - 1);
+
+     f(x) = 0;
+     f(r) = (f(r.min - 1) + f_scan(64, r / 64)) + f_scan(r % 64, r / 64);
+     \endcode
+     * where ri iterates from 0 to 63 (and is predicated off past the
+     * end of the reduction domain), and rb from 1 to the number of
+     * blocks minus one. The first update of the intermediate is pure
+     * in u, and the update of f no longer has a loop-carried
+     * dependence, so both can be parallelized or vectorized. The
+     * intermediate should usually be computed at root, e.g.:
+     \code
+     Func intm = f.update(0).scan(r, u, 64);
+     intm.compute_root().update(0).parallel(u);
+     f.update(0).parallel(r, 64);
+     \endcode
+     * The remaining serial work is the second update of the
+     * intermediate, which is one step per block. The operator and its
+     * identity are inferred as for rfactor(). The operator must be
+     * associative, but need not be commutative. The other arguments
+     * of the update definition must be the pure Vars of the Func, and
+     * the reduction domain must not have a predicate. If any of this
+     * is not the case, this will throw an error.
+     */
+    EXPORT Func scan(RVar r, Var u, Expr factor);
+
     /** Scheduling calls that control how the domain of this stage is
      * traversed. See the documentation for Func for the meanings. */
     // @{
@@ -204,11 +251,13 @@ public:
 
     EXPORT Stage &rename(VarOrRVar old_name, VarOrRVar new_name);
     EXPORT Stage specialize(Expr condition);
+    EXPORT Stage specialize_for_target_features(const std::vector<Target::Feature> &features);
     EXPORT void specialize_fail(const std::string &message);
 
     EXPORT Stage &gpu_threads(VarOrRVar thread_x, DeviceAPI device_api = DeviceAPI::Default_GPU);
     EXPORT Stage &gpu_threads(VarOrRVar thread_x, VarOrRVar thread_y, DeviceAPI device_api = DeviceAPI::Default_GPU);
     EXPORT Stage &gpu_threads(VarOrRVar thread_x, VarOrRVar thread_y, VarOrRVar thread_z, DeviceAPI device_api = DeviceAPI::Default_GPU);
+    EXPORT Stage &gpu_lanes(VarOrRVar thread_x, DeviceAPI device_api = DeviceAPI::Default_GPU);
     EXPORT Stage &gpu_single_thread(DeviceAPI device_api = DeviceAPI::Default_GPU);
 
     EXPORT Stage &gpu_blocks(VarOrRVar block_x, DeviceAPI device_api = DeviceAPI::Default_GPU);
@@ -287,6 +336,49 @@ public:
 
     EXPORT Stage &allow_race_conditions();
 
+    /** Make the stores to the Func in this update definition atomic,
+     * so that the update is safe to parallelize or vectorize across
+     * RVars even when several iterations store to the same site, as
+     * in a histogram:
+     *
+     \code
+     RDom r(0, input.width(), 0, input.height());
+     hist(input(r.x, r.y)) += 1;
+     hist.update().atomic().parallel(r.y);
+     \endcode
+     *
+     * Call this before parallelizing the RVars. The update is lowered
+     * to hardware atomic read-modify-write operations where the
+     * target has them for the operator, and to a compare-and-swap
+     * loop otherwise. It must have a single value (not a Tuple), and
+     * be an associative and commutative operator of the old value of
+     * the Func and something that doesn't depend on it, so that the
+     * order the iterations happen in doesn't matter. Halide checks
+     * this unless override_associativity_test is true.
+     *
+     * Vectorizing an RVar that all the iterations of an atomic update
+     * share a site across, as in a sum or dot product, reduces each
+     * vector horizontally and updates the site once, using
+     * instructions like pmaddwd, udot, or vrmpy where possible:
+     *
+     \code
+     f() += cast<int>(a(r)) * b(r);
+     f.update().atomic().vectorize(r, 16);
+     \endcode
+     */
+    EXPORT Stage &atomic(bool override_associativity_test = false);
+
+    /** Split the loop over a pure Var of an output Func across the
+     * processes (e.g. MPI ranks) running the pipeline together. Each
+     * process only computes its own slice of the loop, as given by
+     * halide_distributed_rank and halide_distributed_num_ranks, and
+     * bounds inference works out the regions of the earlier stages
+     * it needs for that slice, including any halo, which it computes
+     * itself. The other parts of the output are left untouched, for
+     * the caller to gather. Distribute every stage of the output over
+     * the same Var, typically the outermost one. */
+    EXPORT Stage &distribute(Var var);
+
     EXPORT Stage &hexagon(VarOrRVar x = Var::outermost());
     EXPORT Stage &prefetch(const Func &f, VarOrRVar var, Expr offset = 1,
                            PrefetchBoundStrategy strategy = PrefetchBoundStrategy::GuardWithIf);
@@ -882,7 +974,12 @@ public:
      * 5, uint32_t = 6, int32_t = 7, uint64_t = 8, int64_t = 9. The
      * data follows the header, as a densely packed array of the given
      * size and the given type. If given the extension .tmp, this file
-     * format can be natively read by the program ImageStack. */
+     * format can be natively read by the program ImageStack.
+     *
+     * By default the file is written before the pipeline
+     * continues. See halide_set_debug_to_file_async to have the
+     * runtime copy the buffer and write it on a background thread
+     * instead. */
     EXPORT void debug_to_file(const std::string &filename);
 
     /** The name of this function, either given during construction,
@@ -940,7 +1037,24 @@ public:
     /** Add an extern definition for this Func. This lets you define a
      * Func that represents an external pipeline stage. You can, for
      * example, use it to wrap a call to an extern library such as
-     * fftw. */
+     * fftw.
+     *
+     * By default the extern function is called once, over the whole
+     * region required of the Func. If the extern function can compute
+     * any sub-region of its output, the pure definition can be split,
+     * reordered and parallelized like any other, using the Vars
+     * returned by args(). Each iteration of the loops outside the
+     * innermost split (or parallel) loop then makes its own call,
+     * with the output cropped to that tile:
+     *
+     \code
+     Func f;
+     f.define_extern("decode_rows", {input}, UInt(8), 2);
+     Var x = f.args()[0], y = f.args()[1], yo, yi;
+     f.split(y, yo, yi, 64).parallel(yo);
+     \endcode
+     *
+     * Each call is passed the inputs required by the whole stage. */
     // @{
     EXPORT void define_extern(const std::string &function_name,
                               const std::vector<ExternFuncArgument> &params,
@@ -1068,6 +1182,12 @@ public:
      g.in(f).compute_at(f, tiles)...
      \endcode
      *
+     * The wrapper can also change the layout of the staged data, e.g. to
+     * transpose the tiles with reorder_storage. Unrolled strided loads
+     * or stores of a tile that together cover it are done as dense
+     * vector loads or stores and shuffles, so a vectorized transpose of
+     * a small tile happens in registers.
+     *
      * Func::in() can also be used to compute pieces of a Func into a
      * smaller scratch buffer (perhaps on the GPU) and then copy them
      * into a larger output buffer one tile at a time. See
@@ -1200,6 +1320,10 @@ public:
     /** Mark a dimension to be traversed in parallel */
     EXPORT Func &parallel(VarOrRVar var);
 
+    /** Split a dimension of the pure definition across the ranks of
+     * a distributed pipeline. See \ref Stage::distribute */
+    EXPORT Func &distribute(Var var);
+
     /** Split a dimension by the given task_size, and the parallelize the
      * outer dimension. This creates parallel tasks that have size
      * task_size. After this call, var refers to the outer dimension of
@@ -1418,6 +1542,10 @@ public:
      }
      \endcode
      *
+     * Several specializations that compare the same integer Param to
+     * different constants (e.g. mode == 0, mode == 1, ...) are
+     * dispatched with a switch statement instead of a chain of ifs.
+     *
      * Specializations may in turn be specialized, which creates a
      * nested if statement in the generated code.
      *
@@ -1476,6 +1604,23 @@ public:
      */
     EXPORT Stage specialize(Expr condition);
 
+    /** Specialize a Func for CPUs that have the given ISA features,
+     * which the target need not have. The specialized version is
+     * compiled as a separate function using those features, and is
+     * selected at runtime with halide_can_use_target_features, so
+     * only this loop nest is duplicated rather than the whole
+     * pipeline as with compile_to_multitarget_static_library. The
+     * features must be ones the runtime can detect for the target's
+     * architecture (e.g. SSE41, AVX, AVX2, FMA, F16C and the AVX512
+     * variants on x86). For example:
+     \code
+     f.specialize_for_target_features({Target::AVX2, Target::FMA}).vectorize(x, 16);
+     f.vectorize(x, 4);
+     \endcode
+     * When jit-compiling, the choice is made at compile time using
+     * the host CPU. */
+    EXPORT Stage specialize_for_target_features(const std::vector<Target::Feature> &features);
+
     /** Add a specialization to a Func that always terminates execution
      * with a call to halide_error(). By itself, this is of limited use,
      * but can be useful to terminate chains of specialize() calls where
@@ -1530,6 +1675,25 @@ public:
     EXPORT Func &gpu_threads(VarOrRVar thread_x, VarOrRVar thread_y, VarOrRVar thread_z, DeviceAPI device_api = DeviceAPI::Default_GPU);
     // @}
 
+    /** The given dimension corresponds to the lanes in a GPU
+     * warp. It is the innermost GPU thread index, and must have a
+     * constant power-of-two extent no larger than the warp size
+     * that matches the extent of the other loops over thread_x in
+     * the same kernel. On CUDA targets with cuda_capability_30 or
+     * higher, an atomic update that reduces across the lanes into a
+     * single site is lowered to warp shuffles instead of one atomic
+     * operation per lane:
+     *
+     \code
+     RDom r(0, 32, 0, 64);
+     f(x) = 0;
+     f(x) += in(r.x, r.y, x);
+     f.update().atomic().gpu_blocks(x).gpu_lanes(r.x);
+     \endcode
+     *
+     * Elsewhere it behaves like \ref Func::gpu_threads. */
+    EXPORT Func &gpu_lanes(VarOrRVar thread_x, DeviceAPI device_api = DeviceAPI::Default_GPU);
+
     /** Tell Halide to run this stage using a single gpu thread and
      * block. This is not an efficient use of your GPU, but it can be
      * useful to avoid copy-back for intermediate update stages that
@@ -1713,6 +1877,26 @@ public:
      * aligned to multiples of 16, use foo.align_storage(x, 16). */
     EXPORT Func &align_storage(Var dim, Expr alignment);
 
+    /** Store realizations of this function in tiles that are the
+     * given number of elements wide along a particular dimension. The
+     * elements of each tile are stored contiguously, in the storage
+     * order of the dimensions, and the tiles are then laid out in the
+     * same order. Dimensions that aren't tiled have a tile size of
+     * one. The storage extent of dim is padded up to a multiple of
+     * the factor, which must be a positive integer constant.
+     *
+     * For example, to store a function foo(x, y) in 8x8 blocks, so
+     * that a consumer that walks down the columns touches far fewer
+     * cache lines and pages, use:
+     \code
+     foo.tile_storage(x, 8).tile_storage(y, 8);
+     \endcode
+     *
+     * The layout can't be described by the strides of a
+     * halide_buffer_t, so tiled storage can't be used for outputs, inputs
+     * to extern stages, or Funcs that are dumped with debug_to_file. */
+    EXPORT Func &tile_storage(Var dim, Expr factor);
+
     /** Store realizations of this function in a circular buffer of a
      * given extent. This is more efficient when the extent of the
      * circular buffer is a power of 2. If the fold factor is too
@@ -1862,11 +2046,153 @@ public:
      */
     EXPORT Func &compute_root();
 
+    /** Compute the pure definition of this Func in the same loop
+     * nest as the pure definition of f, sharing all the loops of f
+     * from var outwards. This is useful for Funcs that don't depend
+     * on each other, but read the same inputs, as it means the inputs
+     * are only streamed through cache once:
+     *
+     \code
+     Func gx, gy, out;
+     Var x, y;
+     gx(x, y) = in(x + 1, y) - in(x - 1, y);
+     gy(x, y) = in(x, y + 1) - in(x, y - 1);
+     out(x, y) = gx(x, y) * gy(x, y);
+
+     gx.compute_root();
+     gy.compute_root().compute_with(gx, y);
+     \endcode
+     *
+     * is equivalent to
+     *
+     \code
+     for (int y = 0; y < height; y++) {
+         for (int x = 0; x < width; x++) {
+             gx[y][x] = in[y][x + 1] - in[y][x - 1];
+         }
+         for (int x = 0; x < width; x++) {
+             gy[y][x] = in[y + 1][x] - in[y - 1][x];
+         }
+     }
+     \endcode
+     *
+     * The shared loops run over the union of the regions required of
+     * each Func, and each Func only computes the region it needs
+     * within them. The two Funcs must be computed and stored at the
+     * same loop level, must not call each other, and must have no
+     * update definitions, specializations, or memoization. The loops
+     * of the two Funcs are paired up from the outermost one inwards,
+     * and each pair must be serial or parallel in both. No other Func
+     * may be computed or stored at the shared loops. */
+    // @{
+    EXPORT Func &compute_with(Func f, Var var);
+    EXPORT Func &compute_with(LoopLevel loop_level);
+    // @}
+
     /** Use the halide_memoization_cache_... interface to store a
      *  computed version of this function across invocations of the
      *  Func.
+     *
+     *  The optional eviction_priority biases how long results stay in
+     *  the cache when it is full. The default cache weighs the time it
+     *  took to compute each entry against its size, and scales that
+     *  weight by 2^eviction_priority. Positive values keep expensive,
+     *  reusable results around longer; negative values make them
+     *  evicted sooner. It is clamped to [-32, 32].
      */
-    EXPORT Func &memoize();
+    EXPORT Func &memoize(int eviction_priority = 0);
+
+    /** Produce this Func on a separate thread from its consumer, so
+     * that the two run concurrently. Each realization of the Func
+     * (i.e. each iteration of the loop at its compute_at level) is
+     * handed over to the consumer through a semaphore, so the
+     * producer can run ahead of the consumer. This is most useful
+     * when the Func is computed inside a loop of its consumer and
+     * stored outside it, and when its production is slow in a way
+     * that doesn't use the whole machine, e.g. an extern stage doing
+     * I/O:
+     *
+     \code
+     Func in, out;
+     in.define_extern("read_rows", {}, UInt(8), 2);
+     out(x, y) = in(x, y) * 2;
+     in.compute_at(out, y).store_root().async();
+     \endcode
+     *
+     * Here the loop over y runs twice, concurrently: once producing
+     * rows of in, and once consuming them. If the storage of in is
+     * folded (see \ref Func::fold_storage), the fold is made large
+     * enough for the producer to run one realization ahead of the
+     * consumer, and the producer waits for the consumer to free up
+     * space before going further.
+     *
+     * Funcs that an async Func uses must be computed within it, or
+     * outside the loop nest at its store level. An async Func can't
+     * be inlined, be an output of the pipeline, or be fused with
+     * another Func using compute_with. */
+    EXPORT Func &async();
+
+    /** Double buffer the storage of a Func computed at a serial loop
+     * inside a GPU block, so that loading the tile for the next
+     * iteration of that loop overlaps with computing on the current
+     * one. This is most useful for Funcs staged in shared memory:
+     *
+     \code
+     Func A_tile = A.in(), B_tile = B.in();
+     C.update().gpu_tile(x, y, xi, yi, 16, 16).split(r, ro, ri, 16);
+     A_tile.compute_at(C, ro).store_at(C, x).gpu_threads(_0, _1).double_buffer();
+     B_tile.compute_at(C, ro).store_at(C, x).gpu_threads(_0, _1).double_buffer();
+     \endcode
+     *
+     * The storage is folded over the loop (see \ref
+     * Func::fold_storage) with room for two iterations, the first
+     * tile is produced ahead of the loop, and each iteration then
+     * produces the next tile before consuming its own, with a single
+     * thread barrier at the end of each iteration. The Func must be
+     * stored outside the loop it is computed at, which must be a
+     * serial loop outside of the loops over GPU threads. Funcs it
+     * uses must be computed within it, or outside that loop. */
+    EXPORT Func &double_buffer();
+
+    /** Limit the number of registers per thread the GPU kernels
+     * launched at this Func's gpu_blocks loops may use. By default
+     * the device compiler picks the register count that is best for
+     * a single thread, which for large blocks can leave too few
+     * blocks resident on each multiprocessor to hide memory latency,
+     * or can make the kernel fail to launch at all. Values the
+     * kernel needs beyond the budget are spilled to local
+     * memory. Currently only respected by the CUDA backend, which
+     * also records the (constant) block size of the kernel as launch
+     * bounds for the device compiler. */
+    EXPORT Func &gpu_max_registers(int registers);
+
+    /** Write the vector stores to this Func with non-temporal stores
+     * (e.g. movntdq on x86, stnp on ARM), which go around the caches
+     * instead of filling them with lines that will be evicted before
+     * they are read again. This is useful for large outputs and
+     * compute_root Funcs of bandwidth-bound pipelines that aren't
+     * consumed soon after they are produced, and harmful for Funcs
+     * that are, which would have to be read back from memory. Only
+     * dense vector stores that fill at least a cache line are
+     * affected, so the Func should be vectorized by at least 64
+     * bytes, with its rows aligned to 64 bytes. The Func can't be
+     * inlined. */
+    EXPORT Func &store_streaming();
+
+    /** Store the elements of this Func's Tuple values interleaved in
+     * one allocation, as an array of structs, rather than in one
+     * allocation per element. The elements of each site are then
+     * adjacent, so a stage that uses all of them, such as arithmetic
+     * on complex numbers or RGBA pixels, touches one cache line per
+     * access instead of one per element. Vectorized loads of all the
+     * elements become dense loads followed by a deinterleaving
+     * shuffle, and the stores of all of them become one interleaved
+     * store. Stages that use only one of the elements pay for loading
+     * all of them. All the elements must have the same type. The Func
+     * can't be an output, be defined by an extern stage or be an input
+     * to one, be dumped with debug_to_file, be memoized, or have tiled
+     * storage. Funcs with a single value are unaffected. */
+    EXPORT Func &store_interleaved();
 
 
     /** Allocate storage for this function within f's loop over
@@ -1978,6 +2304,16 @@ public:
      * outside the outermost loop. */
     EXPORT Func &store_root();
 
+    /** Set the type of memory this Func should be stored in. Controls
+     * whether allocations go on the stack or the heap on the CPU, and
+     * in global vs shared vs local on the GPU. See the documentation
+     * on MemoryType for more detail. Requesting storage the
+     * allocation can't be given (e.g. Stack for an allocation of
+     * unknown size, or GPUShared outside of a GPU kernel) is an
+     * error, rather than silently falling back to something
+     * else. */
+    EXPORT Func &store_in(MemoryType memory_type);
+
     /** Aggressively inline all uses of this function. This is the
      * default schedule, so you're unlikely to need to call this. For
      * a Func with an update definition, that means it gets computed
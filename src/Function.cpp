@@ -708,6 +708,17 @@ void Function::define_extern(const std::string &function_name,
         StorageDim sd {arg_names[i]};
         contents->func_schedule.storage_dims().push_back(sd);
     }
+
+    // The loop dims, so that the stage can be split into tiles, each
+    // computed by its own call to the extern function.
+    auto &dims = contents->init_def.schedule().dims();
+    dims.clear();
+    for (int i = 0; i < dimensionality; i++) {
+        Dim d = {arg_names[i], ForType::Serial, DeviceAPI::None, Dim::Type::PureVar};
+        dims.push_back(d);
+    }
+    Dim d = {Var::outermost().name(), ForType::Serial, DeviceAPI::None, Dim::Type::PureVar};
+    dims.push_back(d);
 }
 
 void Function::accept(IRVisitor *visitor) const {
@@ -900,6 +911,7 @@ void Function::lock_loop_levels() {
     auto &schedule = contents->func_schedule;
     schedule.compute_level().lock();
     schedule.store_level().lock();
+    schedule.fuse_level().lock();
     // If store_level is inlined, use the compute_level instead.
     // (Note that we deliberately do *not* do the same if store_level
     // is undefined.)
@@ -0,0 +1,311 @@
+#include "FuseGPUKernels.h"
+#include "CodeGen_GPU_Dev.h"
+#include "ExprUsesVar.h"
+#include "IREquality.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Simplify.h"
+#include "Substitute.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace {
+
+typedef vector<pair<string, Expr>> LetList;
+
+// Substitute a list of lets into an Expr, innermost first.
+Expr expand_lets(Expr e, const LetList &lets) {
+    for (size_t i = lets.size(); i > 0; i--) {
+        e = substitute(lets[i - 1].first, lets[i - 1].second, e);
+    }
+    return e;
+}
+
+Stmt wrap_lets(Stmt s, const LetList &lets) {
+    for (size_t i = lets.size(); i > 0; i--) {
+        s = LetStmt::make(lets[i - 1].first, lets[i - 1].second, s);
+    }
+    return s;
+}
+
+// The perfectly nested loops over GPU blocks and threads at the top
+// of the production of a Func.
+struct KernelNest {
+    // The lets before the first loop, and between the loops.
+    LetList outer_lets, inner_lets;
+    vector<const For *> loops;
+    Stmt body;
+};
+
+bool get_kernel_nest(Stmt s, KernelNest &nest) {
+    while (true) {
+        if (const LetStmt *let = s.as<LetStmt>()) {
+            LetList &lets = nest.loops.empty() ? nest.outer_lets : nest.inner_lets;
+            lets.push_back({let->name, let->value});
+            s = let->body;
+        } else if (const For *loop = s.as<For>()) {
+            if (!CodeGen_GPU_Dev::is_gpu_var(loop->name)) {
+                break;
+            }
+            nest.loops.push_back(loop);
+            s = loop->body;
+        } else {
+            break;
+        }
+    }
+    nest.body = s;
+    if (nest.loops.empty() || !CodeGen_GPU_Dev::is_gpu_block_var(nest.loops[0]->name)) {
+        return false;
+    }
+    // The loop bounds must not depend on the lets between the loops,
+    // which are moved inside them.
+    for (const For *loop : nest.loops) {
+        for (const auto &let : nest.inner_lets) {
+            if (expr_uses_var(loop->min, let.first) || expr_uses_var(loop->extent, let.first)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// The suffix (e.g. ".__block_id_x") that says which GPU dimension a
+// loop is over.
+string gpu_dimension(const string &name) {
+    return name.substr(name.rfind('.'));
+}
+
+// Find the indices of the loads and stores of a buffer, in terms of
+// the variables outside of the Stmt they're found in.
+class FindAccesses : public IRVisitor {
+    const string &buffer;
+    LetList lets;
+
+    using IRVisitor::visit;
+
+    void visit(const LetStmt *op) override {
+        op->value.accept(this);
+        lets.push_back({op->name, op->value});
+        op->body.accept(this);
+        lets.pop_back();
+    }
+
+    void visit(const Let *op) override {
+        op->value.accept(this);
+        lets.push_back({op->name, op->value});
+        op->body.accept(this);
+        lets.pop_back();
+    }
+
+    void visit(const Load *op) override {
+        if (op->name == buffer) {
+            loads.push_back(expand_lets(op->index, lets));
+        }
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Store *op) override {
+        if (op->name == buffer) {
+            stores.push_back(expand_lets(op->index, lets));
+        }
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Variable *op) override {
+        if (op->name == buffer || starts_with(op->name, buffer + ".")) {
+            other_uses = true;
+        }
+    }
+
+    void visit(const Call *op) override {
+        if (op->name == buffer) {
+            other_uses = true;
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    vector<Expr> loads, stores;
+    bool other_uses = false;
+
+    FindAccesses(const string &buffer, const LetList &lets) : buffer(buffer), lets(lets) {}
+};
+
+bool uses_buffer(const Expr &e, const string &buffer) {
+    FindAccesses accesses(buffer, LetList());
+    e.accept(&accesses);
+    return accesses.other_uses || !accesses.loads.empty();
+}
+
+bool provably_equal(Expr a, Expr b) {
+    a = simplify(a);
+    b = simplify(b);
+    return equal(a, b) || (a.type().is_scalar() && can_prove(a == b));
+}
+
+class FuseGPUKernels : public IRMutator2 {
+    using IRMutator2::visit;
+
+    // The lets around the current Stmt.
+    LetList lets;
+
+    // The production of the Func being fused into its consumer, and
+    // its kernel.
+    string func;
+    KernelNest producer;
+
+    Stmt visit(const For *op) override {
+        // Only root-level kernels are fused.
+        return op;
+    }
+
+    Stmt visit(const LetStmt *op) override {
+        lets.push_back({op->name, op->value});
+        Stmt body = mutate(op->body);
+        lets.pop_back();
+        if (body.same_as(op->body)) {
+            return op;
+        }
+        return LetStmt::make(op->name, op->value, body);
+    }
+
+    Stmt visit(const Block *op) override {
+        const ProducerConsumer *produce = op->first.as<ProducerConsumer>();
+        KernelNest nest;
+        if (produce && produce->is_producer && get_kernel_nest(produce->body, nest)) {
+            func = produce->name;
+            producer = nest;
+            size_t old_size = lets.size();
+            Stmt fused = fuse_into_consumer(op->rest);
+            lets.resize(old_size);
+            if (fused.defined()) {
+                debug(3) << "Fused the kernel of " << produce->name << " into its consumer\n";
+                // The consumer might itself be fused into the next
+                // kernel.
+                return mutate(fused);
+            }
+        }
+        return IRMutator2::visit(op);
+    }
+
+    // Find the next production after that of func, and fuse func's
+    // kernel into it. Returns an undefined Stmt if that isn't
+    // possible.
+    Stmt fuse_into_consumer(const Stmt &s) {
+        if (const LetStmt *let = s.as<LetStmt>()) {
+            if (uses_buffer(let->value, func)) {
+                return Stmt();
+            }
+            lets.push_back({let->name, let->value});
+            Stmt body = fuse_into_consumer(let->body);
+            return body.defined() ? LetStmt::make(let->name, let->value, body) : Stmt();
+        } else if (const Allocate *alloc = s.as<Allocate>()) {
+            for (const Expr &e : alloc->extents) {
+                if (uses_buffer(e, func)) {
+                    return Stmt();
+                }
+            }
+            if (uses_buffer(alloc->condition, func) ||
+                (alloc->new_expr.defined() && uses_buffer(alloc->new_expr, func))) {
+                return Stmt();
+            }
+            Stmt body = fuse_into_consumer(alloc->body);
+            return body.defined() ? Allocate::make(alloc->name, alloc->type, alloc->memory_type,
+                                                   alloc->extents, alloc->condition, body,
+                                                   alloc->new_expr, alloc->free_function) : Stmt();
+        } else if (const Block *block = s.as<Block>()) {
+            Stmt first = fuse_into_consumer(block->first);
+            return first.defined() ? Block::make(first, block->rest) : Stmt();
+        } else if (const ProducerConsumer *pc = s.as<ProducerConsumer>()) {
+            if (!pc->is_producer) {
+                Stmt body = fuse_into_consumer(pc->body);
+                return body.defined() ? ProducerConsumer::make_consume(pc->name, body) : Stmt();
+            }
+            KernelNest consumer;
+            if (!get_kernel_nest(pc->body, consumer)) {
+                return Stmt();
+            }
+            Stmt kernel = fuse_kernels(consumer);
+            return kernel.defined() ? ProducerConsumer::make_produce(pc->name, kernel) : Stmt();
+        }
+        return Stmt();
+    }
+
+    Stmt fuse_kernels(const KernelNest &consumer) {
+        if (producer.loops.size() != consumer.loops.size()) {
+            return Stmt();
+        }
+
+        // The producer's loop variables, in terms of the consumer's.
+        map<string, Expr> loop_vars;
+        for (size_t i = 0; i < producer.loops.size(); i++) {
+            const For *p = producer.loops[i];
+            const For *c = consumer.loops[i];
+            if (gpu_dimension(p->name) != gpu_dimension(c->name) ||
+                p->for_type != c->for_type || p->device_api != c->device_api) {
+                return Stmt();
+            }
+            Expr p_min = substitute(loop_vars, expand_lets(expand_lets(p->min, producer.outer_lets), lets));
+            Expr p_extent = substitute(loop_vars, expand_lets(expand_lets(p->extent, producer.outer_lets), lets));
+            Expr c_min = expand_lets(expand_lets(c->min, consumer.outer_lets), lets);
+            Expr c_extent = expand_lets(expand_lets(c->extent, consumer.outer_lets), lets);
+            if (!provably_equal(p_min, c_min) || !provably_equal(p_extent, c_extent)) {
+                return Stmt();
+            }
+            loop_vars[p->name] = Variable::make(Int(32), c->name);
+        }
+
+        // Each thread of the producer must store to the Func exactly
+        // once, and each thread of the consumer may only load it at
+        // the same site.
+        LetList producer_lets = producer.outer_lets;
+        producer_lets.insert(producer_lets.end(), producer.inner_lets.begin(), producer.inner_lets.end());
+        Stmt producer_body = substitute(loop_vars, wrap_lets(producer.body, producer_lets));
+        FindAccesses produced(func, lets);
+        producer_body.accept(&produced);
+        if (produced.stores.size() != 1 || !produced.loads.empty()) {
+            return Stmt();
+        }
+
+        LetList consumer_lets = consumer.outer_lets;
+        consumer_lets.insert(consumer_lets.end(), consumer.inner_lets.begin(), consumer.inner_lets.end());
+        Stmt consumer_body = wrap_lets(consumer.body, consumer_lets);
+        FindAccesses consumed(func, lets);
+        consumer_body.accept(&consumed);
+        if (consumed.other_uses || !consumed.stores.empty()) {
+            return Stmt();
+        }
+        for (const Expr &index : consumed.loads) {
+            if (!provably_equal(index, produced.stores[0])) {
+                return Stmt();
+            }
+        }
+
+        // Rebuild the consumer's kernel with the producer's body
+        // first. The lets are moved inside the loops.
+        Stmt body = Block::make(substitute(loop_vars, wrap_lets(producer.body, producer.inner_lets)),
+                                wrap_lets(consumer.body, consumer.inner_lets));
+        for (size_t i = consumer.loops.size(); i > 0; i--) {
+            const For *c = consumer.loops[i - 1];
+            body = For::make(c->name, c->min, c->extent, c->for_type, c->device_api, body);
+        }
+        body = wrap_lets(body, consumer.outer_lets);
+        body = wrap_lets(body, producer.outer_lets);
+        return body;
+    }
+};
+
+}  // namespace
+
+Stmt fuse_gpu_kernels(Stmt s) {
+    return FuseGPUKernels().mutate(s);
+}
+
+}
+}
@@ -0,0 +1,28 @@
+#ifndef HALIDE_FUSE_GPU_KERNELS_H
+#define HALIDE_FUSE_GPU_KERNELS_H
+
+/** \file
+ * Defines the lowering pass that merges the kernels of consecutive
+ * root-level GPU stages.
+ */
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Merge the loop nest over GPU blocks and threads that produces a
+ * Func into the loop nest of the next kernel, when the two have the
+ * same block and thread structure over the same bounds, and each
+ * thread of the second kernel only loads the Func at the site that
+ * the same thread of the first kernel stores to. The pipeline then
+ * launches one kernel instead of two, and each thread reads back what
+ * it just wrote. Used for the gpu_kernel_fusion target feature. Must
+ * run after a GPU API has been selected, and before the host <->
+ * device copies are injected. */
+Stmt fuse_gpu_kernels(Stmt s);
+
+}
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <cmath>
+#include <set>
 
 #include "FuseGPUThreadLoops.h"
 #include "CodeGen_GPU_Dev.h"
@@ -18,6 +19,7 @@ namespace Halide {
 namespace Internal {
 
 using std::map;
+using std::set;
 using std::vector;
 using std::string;
 using std::sort;
@@ -26,6 +28,20 @@ namespace {
 string thread_names[] = {"__thread_id_x", "__thread_id_y", "__thread_id_z", "__thread_id_w"};
 string block_names[] = {"__block_id_x", "__block_id_y", "__block_id_z", "__block_id_w"};
 string shared_mem_name = "__shared";
+
+// The production of the next iteration of a serial loop issued by
+// DoubleBufferGPUStaging. It runs in the same barrier stage as
+// whatever follows it, because it writes to the other half of the
+// double-buffered storage.
+bool is_double_buffer_prefetch(const Stmt &s) {
+    const LetStmt *let = s.as<LetStmt>();
+    return let && ends_with(let->name, ".__double_buffer_prefetch");
+}
+
+bool starts_with_double_buffer_prefetch(const Stmt &s) {
+    const Block *block = s.as<Block>();
+    return block && is_double_buffer_prefetch(block->first);
+}
 }
 
 class InjectThreadBarriers : public IRMutator2 {
@@ -41,11 +57,22 @@ class InjectThreadBarriers : public IRMutator2 {
             in_threads = true;
         }
 
-        return IRMutator2::visit(op);
+        Stmt stmt = IRMutator2::visit(op);
+        const For *loop = stmt.as<For>();
+        if (!in_threads && loop && !CodeGen_GPU_Dev::is_gpu_var(loop->name) &&
+            (!stmt.same_as(op) || starts_with_double_buffer_prefetch(loop->body))) {
+            // A serial loop at the block level with barriers inside
+            // it also needs one at the end of its body, so that the
+            // next iteration doesn't overwrite what slower threads
+            // are still reading.
+            Stmt body = Block::make(loop->body, barrier);
+            stmt = For::make(loop->name, loop->min, loop->extent, loop->for_type, loop->device_api, body);
+        }
+        return stmt;
     }
 
     Stmt visit(const Block *op) override {
-        if (!in_threads && op->rest.defined()) {
+        if (!in_threads && op->rest.defined() && !is_double_buffer_prefetch(op->first)) {
             Stmt first = mutate(op->first);
             Stmt rest = mutate(op->rest);
             return Block::make(Block::make(first, barrier), rest);
@@ -137,6 +164,16 @@ class NormalizeDimensionality : public IRMutator2 {
         if (depth != 0) {
             return mutate(s);
         }
+        if (is_double_buffer_prefetch(s)) {
+            // Keep the prefetch recognizable by the passes that
+            // follow.
+            const LetStmt *let = s.as<LetStmt>();
+            Stmt body = wrap(let->body);
+            if (is_no_op(body)) {
+                return body;
+            }
+            return LetStmt::make(let->name, let->value, body);
+        }
         max_depth = 0;
         s = mutate(s);
         if (is_no_op(s)) {
@@ -310,7 +347,7 @@ class ExtractSharedAllocations : public IRMutator2 {
     }
 
     Stmt visit(const Block *op) override {
-        if (!in_threads && op->rest.defined()) {
+        if (!in_threads && op->rest.defined() && !is_double_buffer_prefetch(op->first)) {
             Stmt first = mutate(op->first);
             barrier_stage++;
             Stmt rest = mutate(op->rest);
@@ -330,10 +367,28 @@ class ExtractSharedAllocations : public IRMutator2 {
         user_assert(!op->new_expr.defined()) << "Allocate node inside GPU kernel has custom new expression.\n" <<
             "(Memoization is not supported inside GPU kernels at present.)\n";
 
+        user_assert(op->memory_type != MemoryType::Heap)
+            << "Allocation " << op->name << " is inside a GPU kernel, "
+            << "so it can't be stored in Heap memory.\n";
+
         if (in_threads) {
+            user_assert(op->memory_type != MemoryType::GPUShared)
+                << "Allocation " << op->name << " is scheduled to be stored in GPU shared memory, "
+                << "but it's inside the loops over GPU threads. Store it at the level of the "
+                << "loops over GPU blocks instead.\n";
             return IRMutator2::visit(op);
         }
 
+        // Everything at the block level is computed by a single
+        // thread and then read by the others, so it has to go in
+        // shared memory.
+        user_assert(op->memory_type == MemoryType::Auto ||
+                    op->memory_type == MemoryType::GPUShared)
+            << "Allocation " << op->name << " is scheduled to be stored in "
+            << op->memory_type << " memory, but it's outside the loops over GPU threads, "
+            << "where only GPUShared storage is possible. Store it inside the loops over "
+            << "GPU threads instead.\n";
+
         shared.emplace(op->name, IntInterval(barrier_stage, barrier_stage));
         Stmt stmt = IRMutator2::visit(op);
         op = stmt.as<Allocate>();
@@ -522,10 +577,18 @@ public:
 
         if (device_api == DeviceAPI::OpenGLCompute) {
 
-            // Individual shared allocations.
+            // Individual shared allocations. GLSL shared arrays must
+            // have a size known at compile time, so use a constant
+            // upper bound on the size.
             for (SharedAllocation alloc : allocations) {
+                Expr size = find_constant_bound(simplify(alloc.size), Direction::Upper);
+                user_assert(size.defined() && is_const(size))
+                    << "Allocation " << alloc.name << " in shared memory has a size of "
+                    << alloc.size << ", which has no constant upper bound. "
+                    << "Shared memory on OpenGLCompute must have a constant size. "
+                    << "Consider using bound or bound_extent to constrain it.\n";
                 s = Allocate::make(shared_mem_name + "_" + alloc.name,
-                                   alloc.type, {alloc.size}, const_true(), s);
+                                   alloc.type, MemoryType::GPUShared, {size}, const_true(), s);
             }
         } else {
             // One big combined shared allocation.
@@ -551,7 +614,7 @@ public:
 
             // Add a dummy allocation at the end to get the total size
             Expr total_size = Variable::make(Int(32), "group_" + std::to_string(mem_allocs.size()-1) + ".shared_offset");
-            s = Allocate::make(shared_mem_name, UInt(8), {total_size}, const_true(), s);
+            s = Allocate::make(shared_mem_name, UInt(8), MemoryType::GPUShared, {total_size}, const_true(), s);
 
             // Define an offset for each allocation. The offsets are in
             // elements, not bytes, so that the stores and loads can use
@@ -568,7 +631,9 @@ public:
                 Expr offset = 0;
                 if (i > 0) {
                     offset = Variable::make(Int(32), "group_" + std::to_string(i-1) + ".shared_offset");
-                    int new_elem_size = mem_allocs[i].max_type_bytes;
+                    // Keep every group 32-byte aligned, which is what
+                    // the tensor core loads and stores need.
+                    int new_elem_size = std::max(mem_allocs[i].max_type_bytes, 32);
                     offset += (((mem_allocs[i-1].max_size_bytes + new_elem_size - 1)/new_elem_size)*new_elem_size);
                 }
                 s = LetStmt::make("group_" + std::to_string(i) + ".shared_offset", simplify(offset), s);
@@ -642,7 +707,239 @@ public:
 
 };
 
+// Find the double-buffered Funcs produced directly within a loop
+// body, outside of any inner loops.
+class FindDoubleBufferedProducers : public IRVisitor {
+    const set<string> &funcs;
+
+    using IRVisitor::visit;
+
+    void visit(const For *op) {
+    }
+
+    void visit(const ProducerConsumer *op) {
+        if (op->is_producer && funcs.count(op->name)) {
+            found.insert(op->name);
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+public:
+    set<string> found;
+    FindDoubleBufferedProducers(const set<string> &funcs) : funcs(funcs) {}
+};
+
+// Check if a Stmt loads from the storage of any of a set of Funcs.
+class LoadsFromFuncs : public IRVisitor {
+    const set<string> &funcs;
+
+    using IRVisitor::visit;
+
+    void visit(const Load *op) {
+        IRVisitor::visit(op);
+        for (const string &f : funcs) {
+            if (op->name == f || starts_with(op->name, f + ".")) {
+                result = f;
+            }
+        }
+    }
+
+public:
+    string result;
+    LoadsFromFuncs(const set<string> &funcs) : funcs(funcs) {}
+};
+
+// Strip a loop body down to just the production of some
+// double-buffered Funcs, recording the other Funcs produced along
+// the way.
+class ExtractDoubleBufferedProducers : public IRMutator2 {
+    const set<string> &funcs;
+
+    using IRMutator2::visit;
+
+    Stmt visit(const ProducerConsumer *op) override {
+        if (op->is_producer && funcs.count(op->name)) {
+            return op;
+        }
+        if (op->is_producer) {
+            others.insert(op->name);
+        }
+        Stmt body = mutate(op->body);
+        if (op->is_producer || is_no_op(body)) {
+            return body;
+        }
+        return ProducerConsumer::make(op->name, op->is_producer, body);
+    }
+
+    Stmt visit(const Allocate *op) override {
+        Stmt body = mutate(op->body);
+        if (is_no_op(body)) {
+            return body;
+        }
+        return Allocate::make(op->name, op->type, op->memory_type, op->extents, op->condition, body,
+                              op->new_expr, op->free_function);
+    }
+
+    Stmt visit(const LetStmt *op) override {
+        Stmt body = mutate(op->body);
+        if (is_no_op(body)) {
+            return body;
+        }
+        return LetStmt::make(op->name, op->value, body);
+    }
+
+    Stmt visit(const IfThenElse *op) override {
+        Stmt then_case = mutate(op->then_case);
+        Stmt else_case = op->else_case.defined() ? mutate(op->else_case) : Stmt();
+        if (is_no_op(then_case) && (!else_case.defined() || is_no_op(else_case))) {
+            return then_case;
+        }
+        return IfThenElse::make(op->condition, then_case, else_case);
+    }
+
+    Stmt visit(const Block *op) override {
+        Stmt first = mutate(op->first);
+        Stmt rest = mutate(op->rest);
+        if (is_no_op(first)) {
+            return rest;
+        } else if (is_no_op(rest)) {
+            return first;
+        }
+        return Block::make(first, rest);
+    }
+
+    // Everything else belongs to the consumer.
+    Stmt visit(const For *op) override {
+        return Evaluate::make(0);
+    }
+
+    Stmt visit(const Store *op) override {
+        return Evaluate::make(0);
+    }
+
+    Stmt visit(const Evaluate *op) override {
+        return Evaluate::make(0);
+    }
+
+    Stmt visit(const AssertStmt *op) override {
+        return Evaluate::make(0);
+    }
+
+    Stmt visit(const Prefetch *op) override {
+        return Evaluate::make(0);
+    }
+
+public:
+    set<string> others;
+    ExtractDoubleBufferedProducers(const set<string> &funcs) : funcs(funcs) {}
+};
+
+class RemoveDoubleBufferedProducers : public IRMutator2 {
+    const set<string> &funcs;
+
+    using IRMutator2::visit;
+
+    Stmt visit(const ProducerConsumer *op) override {
+        if (op->is_producer && funcs.count(op->name)) {
+            return Evaluate::make(0);
+        }
+        return IRMutator2::visit(op);
+    }
+
+public:
+    RemoveDoubleBufferedProducers(const set<string> &funcs) : funcs(funcs) {}
+};
+
+// Software-pipeline each serial loop inside a GPU block that
+// produces a double-buffered Func. The first iteration's production
+// is peeled off in front of the loop, and each iteration then
+// produces the next iteration's tile before consuming its own:
+//
+// produce f(min)
+// barrier
+// for v:
+//   if (v + 1 < min + extent) produce f(v + 1)
+//   consume f(v)
+//   barrier
+//
+// Storage folding has already given f room for two iterations, so
+// the two halves of the body don't touch the same storage, and only
+// need the one barrier at the end of each iteration, instead of one
+// between production and consumption.
+class DoubleBufferGPUStaging : public IRMutator2 {
+    const set<string> &funcs;
+    bool in_blocks = false, in_threads = false;
+
+    using IRMutator2::visit;
+
+    Stmt visit(const For *op) override {
+        if (CodeGen_GPU_Dev::is_gpu_thread_var(op->name)) {
+            ScopedValue<bool> old_in_threads(in_threads, true);
+            return IRMutator2::visit(op);
+        } else if (CodeGen_GPU_Dev::is_gpu_block_var(op->name)) {
+            ScopedValue<bool> old_in_blocks(in_blocks, true);
+            return IRMutator2::visit(op);
+        }
+
+        Stmt body = mutate(op->body);
+
+        FindDoubleBufferedProducers find(funcs);
+        if (in_blocks && !in_threads) {
+            body.accept(&find);
+        }
+
+        if (find.found.empty()) {
+            if (body.same_as(op->body)) {
+                return op;
+            }
+            return For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+        }
+
+        user_assert(op->for_type == ForType::Serial)
+            << "Func " << *find.found.begin() << " is scheduled double_buffer, "
+            << "so the loop it is computed at, " << op->name << ", must be serial.\n";
+
+        ExtractDoubleBufferedProducers extract(find.found);
+        Stmt producer = extract.mutate(body);
+
+        LoadsFromFuncs loads(extract.others);
+        producer.accept(&loads);
+        user_assert(loads.result.empty())
+            << "Func " << *find.found.begin() << " is scheduled double_buffer, but it uses "
+            << loads.result << ", which is computed within the loop over " << op->name
+            << ". Compute " << loads.result << " within the double-buffered Func, "
+            << "or outside the loop over " << op->name << ".\n";
+
+        Stmt consumer = RemoveDoubleBufferedProducers(find.found).mutate(body);
+
+        string next_name = op->name + ".__double_buffer_prefetch";
+        Expr next_var = Variable::make(Int(32), next_name);
+        Stmt prefetch = IfThenElse::make(likely(next_var < op->min + op->extent),
+                                         substitute(op->name, next_var, producer));
+        prefetch = LetStmt::make(next_name, Variable::make(Int(32), op->name) + 1, prefetch);
+
+        Stmt loop = For::make(op->name, op->min, op->extent, op->for_type, op->device_api,
+                              Block::make(prefetch, consumer));
+        Stmt prologue = IfThenElse::make(op->extent > 0, substitute(op->name, op->min, producer));
+        return Block::make(prologue, loop);
+    }
+
+    Stmt visit(const ProducerConsumer *op) override {
+        user_assert(!in_threads || !op->is_producer || !funcs.count(op->name))
+            << "Func " << op->name << " is scheduled double_buffer, so it must be "
+            << "computed at a serial loop outside of the loops over GPU threads.\n";
+        return IRMutator2::visit(op);
+    }
+
+public:
+    DoubleBufferGPUStaging(const set<string> &funcs) : funcs(funcs) {}
+};
+
 class FuseGPUThreadLoops : public IRMutator2 {
+    const set<string> &double_buffered;
+    const map<string, int> &register_budgets;
+
     using IRMutator2::visit;
 
     Stmt visit(const For *op) override {
@@ -658,10 +955,15 @@ class FuseGPUThreadLoops : public IRMutator2 {
             << "thread variables.\n";
 
         if (CodeGen_GPU_Dev::is_gpu_block_var(op->name)) {
+            Stmt loop = Stmt(op);
+            if (!double_buffered.empty()) {
+                loop = DoubleBufferGPUStaging(double_buffered).mutate(loop);
+                debug(3) << "Double-buffered staging:\n" << loop << "\n\n";
+            }
+
             // Do the analysis of thread block size and shared memory
             // usage.
             ExtractBlockSize block_size;
-            Stmt loop = Stmt(op);
             loop.accept(&block_size);
 
             ExtractSharedAllocations shared_mem(op->device_api);
@@ -670,11 +972,33 @@ class FuseGPUThreadLoops : public IRMutator2 {
             debug(3) << "Pulled out shared allocations:\n" << loop << "\n\n";
 
             // Mutate the inside of the kernel
-            return FuseGPUThreadLoopsSingleKernel(block_size, shared_mem).mutate(loop);
+            loop = FuseGPUThreadLoopsSingleKernel(block_size, shared_mem).mutate(loop);
+
+            // Tell the device codegen about the register budget of
+            // the Func the kernel is launched at.
+            if (op->device_api == DeviceAPI::CUDA) {
+                for (const auto &p : register_budgets) {
+                    if (starts_with(op->name, p.first + ".")) {
+                        const For *kernel = loop.as<For>();
+                        internal_assert(kernel);
+                        Expr budget = Call::make(Int(32), "halide.ptx.max_registers", {p.second}, Call::Extern);
+                        Stmt body = Block::make(Evaluate::make(budget), kernel->body);
+                        loop = For::make(kernel->name, kernel->min, kernel->extent,
+                                         kernel->for_type, kernel->device_api, body);
+                        break;
+                    }
+                }
+            }
+            return loop;
         } else {
             return IRMutator2::visit(op);
         }
     }
+
+public:
+    FuseGPUThreadLoops(const set<string> &double_buffered,
+                       const map<string, int> &register_budgets) :
+        double_buffered(double_buffered), register_budgets(register_budgets) {}
 };
 
 class ZeroGPULoopMins : public IRMutator2 {
@@ -746,10 +1070,20 @@ Stmt zero_gpu_loop_mins(Stmt s) {
     return ZeroGPULoopMins().mutate(s);
 }
 
-Stmt fuse_gpu_thread_loops(Stmt s) {
+Stmt fuse_gpu_thread_loops(Stmt s, const map<string, Function> &env) {
     ValidateGPULoopNesting validate;
     s.accept(&validate);
-    s = FuseGPUThreadLoops().mutate(s);
+    set<string> double_buffered;
+    map<string, int> register_budgets;
+    for (const auto &p : env) {
+        if (p.second.schedule().double_buffer()) {
+            double_buffered.insert(p.first);
+        }
+        if (p.second.schedule().gpu_max_registers() > 0) {
+            register_budgets[p.first] = p.second.schedule().gpu_max_registers();
+        }
+    }
+    s = FuseGPUThreadLoops(double_buffered, register_budgets).mutate(s);
     s = ZeroGPULoopMins().mutate(s);
     return s;
 }
@@ -6,6 +6,8 @@
  * threads to target CUDA, OpenCL, and Metal.
  */
 
+#include <map>
+
 #include "IR.h"
 
 namespace Halide {
@@ -19,8 +21,10 @@ Stmt zero_gpu_loop_mins(Stmt s);
  * indices into a single loop (with predication to turn off
  * threads). Also injects synchronization points as needed, and hoists
  * allocations at the block level out into a single shared memory
- * array. */
-Stmt fuse_gpu_thread_loops(Stmt s);
+ * array. Funcs in env scheduled double_buffer have their production
+ * for the next iteration of the serial loop they are computed at
+ * issued before the consumption of the current one. */
+Stmt fuse_gpu_thread_loops(Stmt s, const std::map<std::string, Function> &env);
 
 }
 }
@@ -1,9 +1,15 @@
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <fstream>
+#include <mutex>
 #include <set>
+#include <thread>
 
+#include "CompileTimeProfiling.h"
 #include "Generator.h"
 #include "Outputs.h"
+#include "ScheduleDatabase.h"
 #include "Simplify.h"
 
 namespace Halide {
@@ -631,6 +637,35 @@ GeneratorStub::GeneratorStub(const GeneratorContext &context,
     generator->call_generate();
 }
 
+void GeneratorStub::create_registered(const GeneratorContext &context,
+                                      const std::string &generator_name,
+                                      const std::map<std::string, std::string> &generator_params,
+                                      const std::map<std::string, std::vector<Internal::StubInput>> &inputs) {
+    internal_assert(!generator);
+    generator = GeneratorRegistry::create(generator_name, context);
+    generator->set_generator_and_schedule_param_values(generator_params);
+
+    // The GeneratorParams may change the inputs, so they're only
+    // known now.
+    std::vector<std::vector<StubInput>> ordered_inputs;
+    std::set<std::string> input_names;
+    for (const auto *in : generator->param_info().filter_inputs) {
+        auto it = inputs.find(in->name());
+        user_assert(it != inputs.end())
+            << "Generator " << generator_name << " needs a value for its input " << in->name() << "\n";
+        ordered_inputs.push_back(it->second);
+        input_names.insert(in->name());
+    }
+    for (const auto &it : inputs) {
+        user_assert(input_names.count(it.first))
+            << "Generator " << generator_name << " has no input named " << it.first << "\n";
+    }
+
+    generator->set_inputs_vector(ordered_inputs);
+    generator->call_generate();
+    generator->call_schedule();
+}
+
 void GeneratorStub::verify_same_funcs(const Func &a, const Func &b) {
     user_assert(a.function().get_contents().same_as(b.function().get_contents()))
         << "Expected Func " << a.name() << " and " << b.name() << " to match.\n";
@@ -653,7 +688,8 @@ const std::map<std::string, Type> &get_halide_type_enum_map() {
         {"uint16", UInt(16)},
         {"uint32", UInt(32)},
         {"float32", Float(32)},
-        {"float64", Float(64)}
+        {"float64", Float(64)},
+        {"bfloat16", BFloat(16)}
     };
     return halide_type_enum_map;
 }
@@ -664,6 +700,7 @@ std::string halide_type_to_c_source(const Type &t) {
         { halide_type_uint, "UInt" },
         { halide_type_float, "Float" },
         { halide_type_handle, "Handle" },
+        { halide_type_bfloat, "BFloat" },
     };
     std::ostringstream oss;
     oss << "Halide::" << m.at(t.code()) << "(" << t.bits() << + ")";
@@ -698,13 +735,24 @@ const std::map<std::string, LoopLevel> &get_halide_looplevel_enum_map() {
     return halide_looplevel_enum_map;
 }
 
-int generate_filter_main(int argc, char **argv, std::ostream &cerr) {
-    const char kUsage[] = "gengen [-g GENERATOR_NAME] [-f FUNCTION_NAME] [-o OUTPUT_DIR] [-r RUNTIME_NAME] [-e EMIT_OPTIONS] [-x EXTENSION_OPTIONS] [-n FILE_BASE_NAME] "
-                          "target=target-string[,target-string...] [generator_arg=value [...]]\n\n"
-                          "  -e  A comma separated list of files to emit. Accepted values are "
-                          "[assembly, bitcode, cpp, h, html, o, static_library, stmt, cpp_stub, schedule]. If omitted, default value is [static_library, h].\n"
-                          "  -x  A comma separated list of file extension pairs to substitute during file naming, "
-                          "in the form [.old=.new[,.old2=.new2]]\n";
+namespace {
+
+const char kUsage[] = "gengen [-g GENERATOR_NAME] [-f FUNCTION_NAME] [-o OUTPUT_DIR] [-r RUNTIME_NAME] [-e EMIT_OPTIONS] [-x EXTENSION_OPTIONS] [-n FILE_BASE_NAME] [-t COMPILE_TIME_REPORT] "
+                      "target=target-string[,target-string...] [generator_arg=value [...]]\n"
+                      "gengen -b BATCH_FILE [-j NUM_THREADS] [-t COMPILE_TIME_REPORT]\n\n"
+                      "  -e  A comma separated list of files to emit. Accepted values are "
+                      "[assembly, bitcode, cpp, h, html, o, static_library, stmt, cpp_stub, schedule]. If omitted, default value is [static_library, h].\n"
+                      "  -x  A comma separated list of file extension pairs to substitute during file naming, "
+                      "in the form [.old=.new[,.old2=.new2]]\n"
+                      "  -t  A file to write the time taken by each phase of compilation to, "
+                      "as JSON if its name ends in .json and as a table otherwise\n"
+                      "  -b  A file with the arguments of one build per line (lines starting with # are ignored), "
+                      "to do many builds in one process\n"
+                      "  -j  The number of builds of a batch to do at once. If omitted, the number of cores.\n";
+
+// Do one build. Builds in a batch can't have their own compile time
+// report, as the profiler is shared by the whole process.
+int generate_filter_main_inner(int argc, char **argv, std::ostream &cerr, bool in_batch) {
 
     std::map<std::string, std::string> flags_info = { { "-f", "" },
                                                       { "-g", "" },
@@ -712,6 +760,7 @@ int generate_filter_main(int argc, char **argv, std::ostream &cerr) {
                                                       { "-e", "" },
                                                       { "-n", "" },
                                                       { "-x", "" },
+                                                      { "-t", "" },
                                                       { "-r", "" }};
     std::map<std::string, std::string> generator_args;
 
@@ -840,6 +889,15 @@ int generate_filter_main(int argc, char **argv, std::ostream &cerr) {
         emit_options.substitutions[subst_pair[0]] = subst_pair[1];
     }
 
+    const std::string compile_time_report = flags_info["-t"];
+    if (!compile_time_report.empty()) {
+        if (in_batch) {
+            cerr << "-t must be given with -b, not in the batch file\n";
+            return 1;
+        }
+        set_compile_time_profiling(true);
+    }
+
     const auto target_string = generator_args["target"];
     auto target_strings = split_string(target_string, ",");
     std::vector<Target> targets;
@@ -847,6 +905,18 @@ int generate_filter_main(int argc, char **argv, std::ostream &cerr) {
         targets.push_back(Target(s));
     }
 
+    // When auto-scheduling for the host, tune the schedule for the host
+    // unless the machine parameters are given explicitly.
+    const auto auto_schedule_arg = generator_args.find("auto_schedule");
+    if (auto_schedule_arg != generator_args.end() && auto_schedule_arg->second == "true" &&
+        generator_args.find("machine_params") == generator_args.end() &&
+        !target_strings.empty() &&
+        std::all_of(target_strings.begin(), target_strings.end(), [](const std::string &s) {
+            return starts_with(s, "host");
+        })) {
+        generator_args["machine_params"] = MachineParams::from_host().to_string();
+    }
+
     if (!runtime_name.empty()) {
         if (targets.size() != 1) {
             cerr << "Only one target allowed here";
@@ -890,9 +960,150 @@ int generate_filter_main(int argc, char **argv, std::ostream &cerr) {
         }
     }
 
+    if (!compile_time_report.empty()) {
+        std::ofstream report(compile_time_report);
+        if (!report) {
+            cerr << "Could not open " << compile_time_report << " to write the compile time report\n";
+            return 1;
+        }
+        write_compile_time_report(report, ends_with(compile_time_report, ".json"));
+        set_compile_time_profiling(false);
+    }
+
     return 0;
 }
 
+// Do the builds listed in a batch file, several at once. Sharing the
+// process means llvm is initialized once, and the runtime modules are
+// only linked once per target.
+int generate_filter_batch(const std::string &batch_file, int num_threads,
+                          const std::string &compile_time_report, std::ostream &cerr) {
+    std::ifstream in(batch_file);
+    if (!in) {
+        cerr << "Could not open batch file " << batch_file << "\n";
+        return 1;
+    }
+    std::vector<std::vector<std::string>> builds;
+    std::vector<int> line_numbers;
+    std::string line;
+    for (int line_number = 1; std::getline(in, line); line_number++) {
+        std::istringstream words(line);
+        std::vector<std::string> args = {"gengen"};
+        std::string word;
+        while (words >> word) {
+            args.push_back(word);
+        }
+        if (args.size() == 1 || args[1][0] == '#') {
+            continue;
+        }
+        builds.push_back(args);
+        line_numbers.push_back(line_number);
+    }
+
+    if (!compile_time_report.empty()) {
+        set_compile_time_profiling(true);
+    }
+
+    if (num_threads <= 0) {
+        num_threads = (int)std::thread::hardware_concurrency();
+    }
+    num_threads = std::min(std::max(num_threads, 1), (int)builds.size());
+
+    // Keep the messages of each build together, and report them in
+    // the order of the batch file.
+    std::vector<std::ostringstream> messages(builds.size());
+    std::vector<int> results(builds.size(), 0);
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto worker = [&]() {
+        for (size_t i = next++; i < builds.size(); i = next++) {
+            std::vector<char *> argv;
+            for (std::string &arg : builds[i]) {
+                argv.push_back(&arg[0]);
+            }
+            try {
+                results[i] = generate_filter_main_inner((int)argv.size(), argv.data(), messages[i], true);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < num_threads; t++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &t : threads) {
+        t.join();
+    }
+
+    int result = 0;
+    for (size_t i = 0; i < builds.size(); i++) {
+        cerr << messages[i].str();
+        if (results[i] != 0) {
+            cerr << batch_file << ":" << line_numbers[i] << ": build failed\n";
+            result = 1;
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    if (!compile_time_report.empty()) {
+        std::ofstream report(compile_time_report);
+        if (!report) {
+            cerr << "Could not open " << compile_time_report << " to write the compile time report\n";
+            return 1;
+        }
+        write_compile_time_report(report, ends_with(compile_time_report, ".json"));
+        set_compile_time_profiling(false);
+    }
+
+    return result;
+}
+
+}  // namespace
+
+int generate_filter_main(int argc, char **argv, std::ostream &cerr) {
+    bool batch = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "-b") {
+            batch = true;
+        }
+    }
+    if (!batch) {
+        return generate_filter_main_inner(argc, argv, cerr, false);
+    }
+
+    std::map<std::string, std::string> flags_info = { { "-b", "" },
+                                                      { "-j", "" },
+                                                      { "-t", "" }};
+    for (int i = 1; i < argc; ++i) {
+        auto it = flags_info.find(argv[i]);
+        if (it == flags_info.end() || i + 1 >= argc) {
+            cerr << "Only -j and -t may be given with -b\n";
+            cerr << kUsage;
+            return 1;
+        }
+        it->second = argv[i + 1];
+        ++i;
+    }
+    int num_threads = 0;
+    if (!flags_info["-j"].empty()) {
+        std::istringstream j(flags_info["-j"]);
+        if (!(j >> num_threads) || num_threads < 1) {
+            cerr << "Bad number of threads: " << flags_info["-j"] << "\n";
+            cerr << kUsage;
+            return 1;
+        }
+    }
+    return generate_filter_batch(flags_info["-b"], num_threads, flags_info["-t"], cerr);
+}
+
 GeneratorParamBase::GeneratorParamBase(const std::string &name) : name(name) {
     ObjectInstanceRegistry::register_instance(this, 0, ObjectInstanceRegistry::GeneratorParam,
                                               this, nullptr);
@@ -1327,7 +1538,21 @@ Module GeneratorBase::build_module(const std::string &function_name,
     std::string auto_schedule_result;
     Pipeline pipeline = build_pipeline();
     if (get_auto_schedule()) {
-        auto_schedule_result = pipeline.auto_schedule(get_target(), get_machine_params());
+        // Use the schedule stored for this pipeline, if there is one.
+        std::string db_dir = get_env_variable("HL_SCHEDULE_DATABASE");
+        if (!db_dir.empty()) {
+            ScheduleDatabase db(db_dir);
+            std::string fingerprint = pipeline_fingerprint(pipeline, get_target());
+            auto_schedule_result = db.lookup(fingerprint);
+            if (!auto_schedule_result.empty()) {
+                apply_schedule(pipeline, auto_schedule_result);
+            } else {
+                auto_schedule_result = pipeline.auto_schedule(get_target(), get_machine_params());
+                db.store(fingerprint, auto_schedule_result);
+            }
+        } else {
+            auto_schedule_result = pipeline.auto_schedule(get_target(), get_machine_params());
+        }
     }
 
     // Special-case here: for certain legacy Generators, building the pipeline
@@ -193,7 +193,8 @@
  *  - 'machine_params' is only used if auto_schedule is true; it is ignored
  *    if auto_schedule is false. It provides details about the machine architecture
  *    being targeted which may be used to enhance the automatically-generated
- *    schedule.
+ *    schedule. When GenGen auto-schedules for a 'host' target and no
+ *    machine_params are given, it uses MachineParams::from_host().
  *
  * Generators are added to a global registry to simplify AOT build mechanics; this
  * is done by simply using the HALIDE_REGISTER_GENERATOR macro at global scope:
@@ -324,7 +325,9 @@ EXPORT std::string halide_type_to_c_type(const Type &t);
 
 /** generate_filter_main() is a convenient wrapper for GeneratorRegistry::create() +
  * compile_to_files(); it can be trivially wrapped by a "real" main() to produce a
- * command-line utility for ahead-of-time filter compilation. */
+ * command-line utility for ahead-of-time filter compilation. With -b it
+ * instead does each build listed in a file, several at once on worker
+ * threads, which saves starting a process per build. */
 EXPORT int generate_filter_main(int argc, char **argv, std::ostream &cerr);
 
 // select_type<> is to std::conditional as switch is to if:
@@ -1766,6 +1769,7 @@ public:
     HALIDE_FORWARD_METHOD(Func, compute_root)
     HALIDE_FORWARD_METHOD(Func, define_extern)
     HALIDE_FORWARD_METHOD_CONST(Func, defined)
+    HALIDE_FORWARD_METHOD(Func, distribute)
     HALIDE_FORWARD_METHOD(Func, estimate)
     HALIDE_FORWARD_METHOD(Func, fold_storage)
     HALIDE_FORWARD_METHOD(Func, fuse)
@@ -3118,6 +3122,14 @@ protected:
                   const std::map<std::string, std::string> &generator_params,
                   const std::vector<std::vector<Internal::StubInput>> &inputs);
 
+    // Create the Generator registered as generator_name, with its
+    // inputs given by name instead of in order, and apply both its
+    // generate() and its schedule().
+    EXPORT void create_registered(const GeneratorContext &context,
+                                  const std::string &generator_name,
+                                  const std::map<std::string, std::string> &generator_params,
+                                  const std::map<std::string, std::vector<Internal::StubInput>> &inputs);
+
     ScheduleParamBase &get_schedule_param(const std::string &n) const {
         return generator->find_schedule_param_by_name(n);
     }
@@ -3183,6 +3195,38 @@ private:
 
 }  // namespace Internal
 
+/** A stub for a Generator found by its registered name, for composing
+ * Generators that have no C++ stub header into one pipeline, e.g.:
+ * \code
+ *   NamedGeneratorStub denoise(this, "denoise", {{"input", {raw}}, {"strength", {strength}}});
+ *   Func denoised = denoise.output("output");
+ *   denoised.compute_at(output, yo);
+ * \endcode
+ * Inputs are given by name, and may be Funcs or Exprs of the caller,
+ * and GeneratorParams and ScheduleParams by name and value, as for
+ * the generator_params of a stub. The outputs are ordinary Funcs of
+ * the caller's pipeline, so no intermediate buffer is materialized at
+ * the boundary: they are inlined unless the caller schedules them,
+ * e.g. compute_at one of its own Funcs. The schedule() of the
+ * Generator has been applied to them and to its internal Funcs, and
+ * holds unless the caller overrides it. */
+class NamedGeneratorStub : public Internal::GeneratorStub {
+public:
+    NamedGeneratorStub(const GeneratorContext &context,
+                       const std::string &generator_name,
+                       const std::map<std::string, std::vector<Internal::StubInput>> &inputs,
+                       const std::map<std::string, std::string> &generator_params = {}) {
+        create_registered(context, generator_name, generator_params, inputs);
+    }
+
+    Func output(const std::string &name) const {
+        return get_output(name);
+    }
+
+    std::vector<Func> output_vector(const std::string &name) const {
+        return get_output_vector(name);
+    }
+};
 
 }  // namespace Halide
 
@@ -11,6 +11,7 @@
 #include "Scope.h"
 #include "Bounds.h"
 #include "Lerp.h"
+#include "OptimizeShuffles.h"
 #include <unordered_map>
 
 namespace Halide {
@@ -469,6 +470,56 @@ private:
         return Call::make(result_type, "halide.hexagon.add_4mpy" + suffix, {v01, c01}, Call::PureExtern);
     }
 
+    Expr visit(const VectorReduce *op) override {
+        // vrmpy sums groups of four products of 8-bit values. Use it
+        // for the first step of any reduction by a multiple of four.
+        const int factor = op->value.type().lanes() / op->type.lanes();
+        const int quads = op->value.type().lanes() / 4;
+        if (op->op == VectorReduce::Add &&
+            factor % 4 == 0 &&
+            op->type.bits() == 32 &&
+            !op->type.is_float()) {
+            Expr a, b;
+            string suffix;
+            if (const Mul *mul = op->value.as<Mul>()) {
+                if (op->type.is_uint()) {
+                    a = lossless_cast(UInt(8, quads * 4), mul->a);
+                    b = lossless_cast(UInt(8, quads * 4), mul->b);
+                    suffix = ".vub.vub";
+                } else {
+                    a = lossless_cast(Int(8, quads * 4), mul->a);
+                    b = lossless_cast(Int(8, quads * 4), mul->b);
+                    suffix = ".vb.vb";
+                    if (!a.defined() || !b.defined()) {
+                        a = lossless_cast(UInt(8, quads * 4), mul->a);
+                        b = lossless_cast(Int(8, quads * 4), mul->b);
+                        suffix = ".vub.vb";
+                    }
+                }
+            } else {
+                // A sum of 8-bit values is a dot product with ones,
+                // which we can pass as four bytes of a scalar.
+                a = lossless_cast(UInt(8, quads * 4), op->value);
+                if (op->type.is_uint()) {
+                    b = make_const(UInt(32), 0x01010101);
+                    suffix = ".vub.ub";
+                } else {
+                    b = make_const(Int(32), 0x01010101);
+                    suffix = ".vub.b";
+                }
+            }
+            if (a.defined() && b.defined()) {
+                Expr new_expr = halide_hexagon_add_4mpy(op->type.with_lanes(quads), suffix, a, b);
+                if (quads != op->type.lanes()) {
+                    // Reduce the rest of the way.
+                    new_expr = VectorReduce::make(VectorReduce::Add, new_expr, op->type.lanes());
+                }
+                return mutate(new_expr);
+            }
+        }
+        return IRMutator2::visit(op);
+    }
+
     Expr visit(const Add *op) override {
         // vmpa, vdmpy, and vrmpy instructions are hard to match with
         // patterns, do it manually here.
@@ -1375,7 +1426,7 @@ class EliminateInterleaves : public IRMutator2 {
         }
 
         if (!body.same_as(op->body) || !condition.same_as(op->condition)) {
-            return Allocate::make(op->name, op->type, op->extents, condition, body,
+            return Allocate::make(op->name, op->type, op->memory_type, op->extents, condition, body,
                                   op->new_expr, op->free_function);
         } else {
             return op;
@@ -1494,123 +1545,6 @@ class FuseInterleaves : public IRMutator2 {
     using IRMutator2::visit;
 };
 
-// Find an upper bound of bounds.max - bounds.min.
-Expr span_of_bounds(Interval bounds) {
-    internal_assert(bounds.is_bounded());
-
-    const Min *min_min = bounds.min.as<Min>();
-    const Max *min_max = bounds.min.as<Max>();
-    const Min *max_min = bounds.max.as<Min>();
-    const Max *max_max = bounds.max.as<Max>();
-    const Add *min_add = bounds.min.as<Add>();
-    const Add *max_add = bounds.max.as<Add>();
-    const Sub *min_sub = bounds.min.as<Sub>();
-    const Sub *max_sub = bounds.max.as<Sub>();
-
-    if (min_min && max_min && equal(min_min->b, max_min->b)) {
-        return span_of_bounds({min_min->a, max_min->a});
-    } else if (min_max && max_max && equal(min_max->b, max_max->b)) {
-        return span_of_bounds({min_max->a, max_max->a});
-    } else if (min_add && max_add && equal(min_add->b, max_add->b)) {
-        return span_of_bounds({min_add->a, max_add->a});
-    } else if (min_sub && max_sub && equal(min_sub->b, max_sub->b)) {
-        return span_of_bounds({min_sub->a, max_sub->a});
-    } else {
-        return bounds.max - bounds.min;
-    }
-}
-
-// Replace indirect loads with dynamic_shuffle intrinsics where
-// possible.
-class OptimizeShuffles : public IRMutator2 {
-    int lut_alignment;
-    Scope<Interval> bounds;
-    std::vector<std::pair<string, Expr>> lets;
-
-    using IRMutator2::visit;
-
-    template <typename NodeType, typename T>
-    NodeType visit_let(const T *op) {
-        // We only care about vector lets.
-        if (op->value.type().is_vector()) {
-            bounds.push(op->name, bounds_of_expr_in_scope(op->value, bounds));
-        }
-        NodeType node = IRMutator2::visit(op);
-        if (op->value.type().is_vector()) {
-            bounds.pop(op->name);
-        }
-        return node;
-    }
-
-    Expr visit(const Let *op) override {
-        lets.push_back({op->name, op->value});
-        Expr expr = visit_let<Expr>(op);
-        lets.pop_back();
-        return expr;
-    }
-    Stmt visit(const LetStmt *op) override { return visit_let<Stmt>(op); }
-
-    Expr visit(const Load *op) override {
-        if (!is_one(op->predicate)) {
-            // TODO(psuriana): We shouldn't mess with predicated load for now.
-            return IRMutator2::visit(op);
-        }
-        if (!op->type.is_vector() || op->index.as<Ramp>()) {
-            // Don't handle scalar or simple vector loads.
-            return IRMutator2::visit(op);
-        }
-
-        Expr index = mutate(op->index);
-        Interval unaligned_index_bounds = bounds_of_expr_in_scope(index, bounds);
-        if (unaligned_index_bounds.is_bounded()) {
-            // We want to try both the unaligned and aligned
-            // bounds. The unaligned bounds might fit in 256 elements,
-            // while the aligned bounds do not.
-            int align = lut_alignment / op->type.bytes();
-            Interval aligned_index_bounds = {
-                (unaligned_index_bounds.min / align) * align,
-                ((unaligned_index_bounds.max + align) / align) * align - 1
-            };
-
-            for (Interval index_bounds : {aligned_index_bounds, unaligned_index_bounds}) {
-                Expr index_span = span_of_bounds(index_bounds);
-                index_span = common_subexpression_elimination(index_span);
-                index_span = simplify(index_span);
-
-                if (can_prove(index_span < 256)) {
-                    // This is a lookup within an up to 256 element array. We
-                    // can use dynamic_shuffle for this.
-                    int const_extent = as_const_int(index_span) ? *as_const_int(index_span) + 1 : 256;
-                    Expr base = simplify(index_bounds.min);
-
-                    // Load all of the possible indices loaded from the
-                    // LUT. Note that for clamped ramps, this loads up to 1
-                    // vector past the max. CodeGen_Hexagon::allocation_padding
-                    // returns a native vector size to account for this.
-                    Expr lut = Load::make(op->type.with_lanes(const_extent), op->name,
-                                          Ramp::make(base, 1, const_extent),
-                                          op->image, op->param, const_true(const_extent));
-
-                    // We know the size of the LUT is not more than 256, so we
-                    // can safely cast the index to 8 bit, which
-                    // dynamic_shuffle requires.
-                    index = simplify(cast(UInt(8).with_lanes(op->type.lanes()), index - base));
-
-                    return Call::make(op->type, "dynamic_shuffle", {lut, index, 0, const_extent - 1}, Call::PureIntrinsic);
-                }
-            }
-        }
-        if (!index.same_as(op->index)) {
-            return Load::make(op->type, op->name, index, op->image, op->param, op->predicate);
-        } else {
-            return op;
-        }
-    }
-
-public:
-    OptimizeShuffles(int lut_alignment) : lut_alignment(lut_alignment) {}
-};
-
 // Attempt to generate vtmpy instructions. This requires that all lets
 // be substituted prior to running, and so must be an IRGraphMutator2.
 class VtmpyGenerator : public IRGraphMutator2 {
@@ -1811,7 +1745,7 @@ private:
 Stmt optimize_hexagon_shuffles(Stmt s, int lut_alignment) {
     // Replace indirect and other complicated loads with
     // dynamic_shuffle (vlut) calls.
-    return OptimizeShuffles(lut_alignment).mutate(s);
+    return optimize_shuffles(s, lut_alignment, 256);
 }
 
 Stmt vtmpy_generator(Stmt s) {
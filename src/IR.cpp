@@ -6,6 +6,99 @@
 namespace Halide {
 namespace Internal {
 
+namespace {
+
+// A cache of freed IR node memory, with a free list for each multiple
+// of 16 bytes up to 256, which covers all IR nodes. Each list holds a
+// bounded number of blocks so that freeing a large Stmt doesn't pin
+// its memory forever.
+class IRNodeCache {
+    static const size_t granularity = 16;
+    static const size_t size_classes = 16;
+    static const size_t max_cached = 4096;
+
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    FreeBlock *free_list[size_classes];
+    size_t cached[size_classes];
+
+public:
+    IRNodeCache() {
+        for (size_t i = 0; i < size_classes; i++) {
+            free_list[i] = nullptr;
+            cached[i] = 0;
+        }
+    }
+
+    ~IRNodeCache();
+
+    // The size of block that holds an object, or zero if it's too
+    // large to cache.
+    static size_t block_size(size_t size) {
+        size_t rounded = (size + granularity - 1) & ~(granularity - 1);
+        return rounded <= granularity * size_classes ? rounded : 0;
+    }
+
+    void *allocate(size_t block) {
+        size_t c = block / granularity - 1;
+        if (FreeBlock *b = free_list[c]) {
+            free_list[c] = b->next;
+            cached[c]--;
+            return b;
+        }
+        return ::operator new(block);
+    }
+
+    void release(void *ptr, size_t block) {
+        size_t c = block / granularity - 1;
+        if (cached[c] == max_cached) {
+            ::operator delete(ptr);
+            return;
+        }
+        FreeBlock *b = (FreeBlock *)ptr;
+        b->next = free_list[c];
+        free_list[c] = b;
+        cached[c]++;
+    }
+};
+
+// IR nodes may be freed on a thread after its cache has been
+// destroyed (e.g. by the destructors of globals), so we track that
+// in a trivially-destructible flag, which stays valid.
+thread_local bool ir_node_cache_destroyed = false;
+thread_local IRNodeCache ir_node_cache;
+
+IRNodeCache::~IRNodeCache() {
+    for (size_t i = 0; i < size_classes; i++) {
+        while (FreeBlock *b = free_list[i]) {
+            free_list[i] = b->next;
+            ::operator delete(b);
+        }
+    }
+    ir_node_cache_destroyed = true;
+}
+
+}  // namespace
+
+void *IRNode::operator new(size_t size) {
+    size_t block = IRNodeCache::block_size(size);
+    if (block == 0 || ir_node_cache_destroyed) {
+        return ::operator new(block ? block : size);
+    }
+    return ir_node_cache.allocate(block);
+}
+
+void IRNode::operator delete(void *ptr, size_t size) {
+    size_t block = IRNodeCache::block_size(size);
+    if (block == 0 || ir_node_cache_destroyed) {
+        ::operator delete(ptr);
+        return;
+    }
+    ir_node_cache.release(ptr, block);
+}
+
 Expr Cast::make(Type t, Expr v) {
     internal_assert(v.defined()) << "Cast of undefined\n";
     internal_assert(t.lanes() == v.type().lanes()) << "Cast may not change vector widths\n";
@@ -376,7 +469,8 @@ Stmt Provide::make(const std::string &name, const std::vector<Expr> &values, con
     return node;
 }
 
-Stmt Allocate::make(const std::string &name, Type type, const std::vector<Expr> &extents,
+Stmt Allocate::make(const std::string &name, Type type, MemoryType memory_type,
+                    const std::vector<Expr> &extents,
                     Expr condition, Stmt body,
                     Expr new_expr, const std::string &free_function) {
     for (size_t i = 0; i < extents.size(); i++) {
@@ -390,6 +484,7 @@ Stmt Allocate::make(const std::string &name, Type type, const std::vector<Expr>
     Allocate *node = new Allocate;
     node->name = name;
     node->type = type;
+    node->memory_type = memory_type;
     node->extents = extents;
     node->new_expr = std::move(new_expr);
     node->free_function = free_function;
@@ -439,7 +534,8 @@ Stmt Free::make(const std::string &name) {
     return node;
 }
 
-Stmt Realize::make(const std::string &name, const std::vector<Type> &types, const Region &bounds, Expr condition, Stmt body) {
+Stmt Realize::make(const std::string &name, const std::vector<Type> &types, MemoryType memory_type,
+                   const Region &bounds, Expr condition, Stmt body) {
     for (size_t i = 0; i < bounds.size(); i++) {
         internal_assert(bounds[i].min.defined()) << "Realize of undefined\n";
         internal_assert(bounds[i].extent.defined()) << "Realize of undefined\n";
@@ -454,6 +550,7 @@ Stmt Realize::make(const std::string &name, const std::vector<Type> &types, cons
     Realize *node = new Realize;
     node->name = name;
     node->types = types;
+    node->memory_type = memory_type;
     node->bounds = bounds;
     node->condition = std::move(condition);
     node->body = std::move(body);
@@ -477,6 +574,14 @@ Stmt Prefetch::make(const std::string &name, const std::vector<Type> &types, con
     return node;
 }
 
+Stmt Atomic::make(const std::string &producer_name, Stmt body) {
+    internal_assert(body.defined()) << "Atomic must have a body statement.\n";
+    Atomic *node = new Atomic;
+    node->producer_name = producer_name;
+    node->body = std::move(body);
+    return node;
+}
+
 Stmt Block::make(Stmt first, Stmt rest) {
     internal_assert(first.defined()) << "Block of undefined\n";
     internal_assert(rest.defined()) << "Block of undefined\n";
@@ -582,6 +687,24 @@ Expr Variable::make(Type type, const std::string &name, Buffer<> image, Paramete
     return node;
 }
 
+Expr VectorReduce::make(VectorReduce::Operator op,
+                         Expr vec,
+                         int lanes) {
+    internal_assert(vec.defined()) << "VectorReduce of undefined\n";
+    internal_assert(lanes > 0) << "VectorReduce to zero lanes\n";
+    internal_assert(vec.type().lanes() % lanes == 0)
+        << "Input lanes for VectorReduce must be a multiple of the output lanes\n";
+    if (op == VectorReduce::And || op == VectorReduce::Or) {
+        internal_assert(vec.type().is_bool()) << "VectorReduce of And or Or must be of a boolean vector\n";
+    }
+
+    VectorReduce *node = new VectorReduce;
+    node->type = vec.type().with_lanes(lanes);
+    node->op = op;
+    node->value = std::move(vec);
+    return node;
+}
+
 Expr Shuffle::make(const std::vector<Expr> &vectors,
                    const std::vector<int> &indices) {
     internal_assert(!vectors.empty()) << "Shuffle of zero vectors.\n";
@@ -762,6 +885,7 @@ template<> EXPORT void ExprNode<Ramp>::accept(IRVisitor *v) const { v->visit((co
 template<> EXPORT void ExprNode<Broadcast>::accept(IRVisitor *v) const { v->visit((const Broadcast *)this); }
 template<> EXPORT void ExprNode<Call>::accept(IRVisitor *v) const { v->visit((const Call *)this); }
 template<> EXPORT void ExprNode<Shuffle>::accept(IRVisitor *v) const { v->visit((const Shuffle *)this); }
+template<> EXPORT void ExprNode<VectorReduce>::accept(IRVisitor *v) const { v->visit((const VectorReduce *)this); }
 template<> EXPORT void ExprNode<Let>::accept(IRVisitor *v) const { v->visit((const Let *)this); }
 template<> EXPORT void StmtNode<LetStmt>::accept(IRVisitor *v) const { v->visit((const LetStmt *)this); }
 template<> EXPORT void StmtNode<AssertStmt>::accept(IRVisitor *v) const { v->visit((const AssertStmt *)this); }
@@ -776,6 +900,7 @@ template<> EXPORT void StmtNode<Block>::accept(IRVisitor *v) const { v->visit((c
 template<> EXPORT void StmtNode<IfThenElse>::accept(IRVisitor *v) const { v->visit((const IfThenElse *)this); }
 template<> EXPORT void StmtNode<Evaluate>::accept(IRVisitor *v) const { v->visit((const Evaluate *)this); }
 template<> EXPORT void StmtNode<Prefetch>::accept(IRVisitor *v) const { v->visit((const Prefetch *)this); }
+template<> EXPORT void StmtNode<Atomic>::accept(IRVisitor *v) const { v->visit((const Atomic *)this); }
 
 template<> EXPORT Expr ExprNode<IntImm>::mutate_expr(IRMutator2 *v) const { return v->visit((const IntImm *)this); }
 template<> EXPORT Expr ExprNode<UIntImm>::mutate_expr(IRMutator2 *v) const { return v->visit((const UIntImm *)this); }
@@ -805,6 +930,7 @@ template<> EXPORT Expr ExprNode<Ramp>::mutate_expr(IRMutator2 *v) const { return
 template<> EXPORT Expr ExprNode<Broadcast>::mutate_expr(IRMutator2 *v) const { return v->visit((const Broadcast *)this); }
 template<> EXPORT Expr ExprNode<Call>::mutate_expr(IRMutator2 *v) const { return v->visit((const Call *)this); }
 template<> EXPORT Expr ExprNode<Shuffle>::mutate_expr(IRMutator2 *v) const { return v->visit((const Shuffle *)this); }
+template<> EXPORT Expr ExprNode<VectorReduce>::mutate_expr(IRMutator2 *v) const { return v->visit((const VectorReduce *)this); }
 template<> EXPORT Expr ExprNode<Let>::mutate_expr(IRMutator2 *v) const { return v->visit((const Let *)this); }
 
 template<> EXPORT Stmt StmtNode<LetStmt>::mutate_stmt(IRMutator2 *v) const { return v->visit((const LetStmt *)this); }
@@ -820,6 +946,7 @@ template<> EXPORT Stmt StmtNode<Block>::mutate_stmt(IRMutator2 *v) const { retur
 template<> EXPORT Stmt StmtNode<IfThenElse>::mutate_stmt(IRMutator2 *v) const { return v->visit((const IfThenElse *)this); }
 template<> EXPORT Stmt StmtNode<Evaluate>::mutate_stmt(IRMutator2 *v) const { return v->visit((const Evaluate *)this); }
 template<> EXPORT Stmt StmtNode<Prefetch>::mutate_stmt(IRMutator2 *v) const { return v->visit((const Prefetch *)this); }
+template<> EXPORT Stmt StmtNode<Atomic>::mutate_stmt(IRMutator2 *v) const { return v->visit((const Atomic *)this); }
 
 
 Call::ConstString Call::debug_to_file = "debug_to_file";
@@ -834,6 +961,7 @@ Call::ConstString Call::abs = "abs";
 Call::ConstString Call::absd = "absd";
 Call::ConstString Call::lerp = "lerp";
 Call::ConstString Call::random = "random";
+Call::ConstString Call::random_philox = "random_philox";
 Call::ConstString Call::popcount = "popcount";
 Call::ConstString Call::count_leading_zeros = "count_leading_zeros";
 Call::ConstString Call::count_trailing_zeros = "count_trailing_zeros";
@@ -851,6 +979,7 @@ Call::ConstString Call::memoize_expr = "memoize_expr";
 Call::ConstString Call::alloca = "alloca";
 Call::ConstString Call::likely = "likely";
 Call::ConstString Call::likely_if_innermost = "likely_if_innermost";
+Call::ConstString Call::promise_clamped = "promise_clamped";
 Call::ConstString Call::register_destructor = "register_destructor";
 Call::ConstString Call::div_round_to_zero = "div_round_to_zero";
 Call::ConstString Call::mod_round_to_zero = "mod_round_to_zero";
@@ -864,6 +993,7 @@ Call::ConstString Call::select_mask = "select_mask";
 Call::ConstString Call::extract_mask_element = "extract_mask_element";
 Call::ConstString Call::require = "require";
 Call::ConstString Call::size_of_halide_buffer_t = "size_of_halide_buffer_t";
+Call::ConstString Call::nontemporal = "nontemporal";
 
 Call::ConstString Call::buffer_get_min = "_halide_buffer_get_min";
 Call::ConstString Call::buffer_get_extent = "_halide_buffer_get_extent";
@@ -342,6 +342,7 @@ struct Provide : public StmtNode<Provide> {
 struct Allocate : public StmtNode<Allocate> {
     std::string name;
     Type type;
+    MemoryType memory_type;
     std::vector<Expr> extents;
     Expr condition;
 
@@ -351,12 +352,15 @@ struct Allocate : public StmtNode<Allocate> {
     // guaranteed to be called. The free function signature must match
     // that of the code generator dependent free (typically
     // halide_free). If free_function is left empty, code generator
-    // default will be called.
+    // default will be called. If new_expr is just the name of an
+    // enclosing allocation, this allocation reuses that one's memory,
+    // and isn't freed separately.
     Expr new_expr;
     std::string free_function;
     Stmt body;
 
-    EXPORT static Stmt make(const std::string &name, Type type, const std::vector<Expr> &extents,
+    EXPORT static Stmt make(const std::string &name, Type type, MemoryType memory_type,
+                            const std::vector<Expr> &extents,
                             Expr condition, Stmt body,
                             Expr new_expr = Expr(), const std::string &free_function = std::string());
 
@@ -402,11 +406,13 @@ typedef std::vector<Range> Region;
 struct Realize : public StmtNode<Realize> {
     std::string name;
     std::vector<Type> types;
+    MemoryType memory_type;
     Region bounds;
     Expr condition;
     Stmt body;
 
-    EXPORT static Stmt make(const std::string &name, const std::vector<Type> &types, const Region &bounds, Expr condition, Stmt body);
+    EXPORT static Stmt make(const std::string &name, const std::vector<Type> &types, MemoryType memory_type,
+                            const Region &bounds, Expr condition, Stmt body);
 
     static const IRNodeType _node_type = IRNodeType::Realize;
 
@@ -482,6 +488,7 @@ struct Call : public ExprNode<Call> {
         absd,
         rewrite_buffer,
         random,
+        random_philox,
         lerp,
         popcount,
         count_leading_zeros,
@@ -500,6 +507,7 @@ struct Call : public ExprNode<Call> {
         alloca,
         likely,
         likely_if_innermost,
+        promise_clamped,
         register_destructor,
         div_round_to_zero,
         mod_round_to_zero,
@@ -512,7 +520,8 @@ struct Call : public ExprNode<Call> {
         select_mask,
         extract_mask_element,
         require,
-        size_of_halide_buffer_t;
+        size_of_halide_buffer_t,
+        nontemporal;
 
     // We also declare some symbolic names for some of the runtime
     // functions that we want to construct Call nodes to here to avoid
@@ -665,7 +674,8 @@ struct For : public StmtNode<For> {
     bool is_parallel() const {
         return (for_type == ForType::Parallel ||
                 for_type == ForType::GPUBlock ||
-                for_type == ForType::GPUThread);
+                for_type == ForType::GPUThread ||
+                for_type == ForType::GPULane);
     }
 
     static const IRNodeType _node_type = IRNodeType::For;
@@ -740,6 +750,45 @@ struct Prefetch : public StmtNode<Prefetch> {
     static const IRNodeType _node_type = IRNodeType::Prefetch;
 };
 
+/** Lock all the Store nodes in the body statement, so that each of
+ * them reads, modifies, and writes memory as one indivisible
+ * operation. The stores must be to the buffer of the Func
+ * 'producer_name', and their values must only load from it at the
+ * index being stored to. Used to implement Stage::atomic. */
+struct Atomic : public StmtNode<Atomic> {
+    std::string producer_name;
+    Stmt body;
+
+    EXPORT static Stmt make(const std::string &producer_name, Stmt body);
+
+    static const IRNodeType _node_type = IRNodeType::Atomic;
+};
+
+/** Horizontally reduce a vector to a vector with fewer lanes, using
+ * some associative binary operator. The reduction factor is the
+ * ratio of the input to output lanes, and each output lane is the
+ * reduction of a contiguous group of that many input lanes. Produced
+ * by vectorizing an RVar of an atomic update, and mapped by the
+ * backends to instructions like pmaddwd, udot, or vrmpy where they
+ * exist. */
+struct VectorReduce : public ExprNode<VectorReduce> {
+    typedef enum {
+        Add,
+        Mul,
+        Min,
+        Max,
+        And,
+        Or,
+    } Operator;
+
+    Expr value;
+    Operator op;
+
+    EXPORT static Expr make(Operator op, Expr vec, int lanes);
+
+    static const IRNodeType _node_type = IRNodeType::VectorReduce;
+};
+
 }
 }
 
@@ -90,6 +90,8 @@ private:
     void visit(const Evaluate *);
     void visit(const Shuffle *);
     void visit(const Prefetch *);
+    void visit(const Atomic *);
+    void visit(const VectorReduce *);
 };
 
 template<typename T>
@@ -389,6 +391,7 @@ void IRComparer::visit(const Allocate *op) {
     const Allocate *s = stmt.as<Allocate>();
 
     compare_names(s->name, op->name);
+    compare_scalar(s->memory_type, op->memory_type);
     compare_expr_vector(s->extents, op->extents);
     compare_stmt(s->body, op->body);
     compare_expr(s->condition, op->condition);
@@ -402,6 +405,7 @@ void IRComparer::visit(const Realize *op) {
     compare_names(s->name, op->name);
     compare_scalar(s->types.size(), op->types.size());
     compare_scalar(s->bounds.size(), op->bounds.size());
+    compare_scalar(s->memory_type, op->memory_type);
     for (size_t i = 0; (result == Equal) && (i < s->types.size()); i++) {
         compare_types(s->types[i], op->types[i]);
     }
@@ -462,6 +466,21 @@ void IRComparer::visit(const Prefetch *op) {
     }
 }
 
+void IRComparer::visit(const VectorReduce *op) {
+    const VectorReduce *e = expr.as<VectorReduce>();
+
+    compare_scalar(e->op, op->op);
+    // We've already compared types, so it's enough to compare the value
+    compare_expr(e->value, op->value);
+}
+
+void IRComparer::visit(const Atomic *op) {
+    const Atomic *s = stmt.as<Atomic>();
+
+    compare_names(s->producer_name, op->producer_name);
+    compare_stmt(s->body, op->body);
+}
+
 } // namespace
 
 
@@ -502,6 +521,259 @@ bool ExprWithCompareCache::operator<(const ExprWithCompareCache &other) const {
     return cmp.result == IRComparer::LessThan;
 }
 
+namespace {
+
+void hash_combine(size_t &h, size_t v) {
+    h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2);
+}
+
+size_t hash_type(Type t) {
+    size_t h = std::hash<int>()((int)t.code());
+    hash_combine(h, std::hash<int>()(t.bits()));
+    hash_combine(h, std::hash<int>()(t.lanes()));
+    hash_combine(h, std::hash<const void *>()(t.handle_type));
+    return h;
+}
+
+// Children that are compared by value rather than by identity.
+bool is_shallow_constant(const Expr &e) {
+    if (const Broadcast *b = e.as<Broadcast>()) {
+        return is_shallow_constant(b->value);
+    }
+    return e.as<IntImm>() || e.as<UIntImm>() || e.as<FloatImm>();
+}
+
+size_t hash_child(const Expr &e) {
+    if (e.defined() && is_shallow_constant(e)) {
+        return ExprShallowHash()(e);
+    }
+    return std::hash<const IRNode *>()(e.get());
+}
+
+bool equal_child(const Expr &a, const Expr &b) {
+    if (a.same_as(b)) {
+        return true;
+    }
+    return (a.defined() && b.defined() &&
+            is_shallow_constant(a) && is_shallow_constant(b) &&
+            ExprShallowEqual()(a, b));
+}
+
+bool equal_children(const vector<Expr> &a, const vector<Expr> &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (!equal_child(a[i], b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename T>
+size_t hash_binary_operator(const Expr &e) {
+    const T *op = e.as<T>();
+    size_t h = hash_child(op->a);
+    hash_combine(h, hash_child(op->b));
+    return h;
+}
+
+template<typename T>
+bool equal_binary_operator(const Expr &a, const Expr &b) {
+    const T *op_a = a.as<T>(), *op_b = b.as<T>();
+    return equal_child(op_a->a, op_b->a) && equal_child(op_a->b, op_b->b);
+}
+
+} // namespace
+
+size_t ExprShallowHash::operator()(const Expr &e) const {
+    size_t h = std::hash<int>()((int)e->node_type);
+    hash_combine(h, hash_type(e.type()));
+    switch (e->node_type) {
+    case IRNodeType::IntImm:
+        hash_combine(h, std::hash<int64_t>()(e.as<IntImm>()->value));
+        break;
+    case IRNodeType::UIntImm:
+        hash_combine(h, std::hash<uint64_t>()(e.as<UIntImm>()->value));
+        break;
+    case IRNodeType::FloatImm:
+        hash_combine(h, std::hash<double>()(e.as<FloatImm>()->value));
+        break;
+    case IRNodeType::StringImm:
+        hash_combine(h, std::hash<string>()(e.as<StringImm>()->value));
+        break;
+    case IRNodeType::Cast:
+        hash_combine(h, hash_child(e.as<Cast>()->value));
+        break;
+    case IRNodeType::Variable:
+        hash_combine(h, std::hash<string>()(e.as<Variable>()->name));
+        break;
+    case IRNodeType::Add: hash_combine(h, hash_binary_operator<Add>(e)); break;
+    case IRNodeType::Sub: hash_combine(h, hash_binary_operator<Sub>(e)); break;
+    case IRNodeType::Mul: hash_combine(h, hash_binary_operator<Mul>(e)); break;
+    case IRNodeType::Div: hash_combine(h, hash_binary_operator<Div>(e)); break;
+    case IRNodeType::Mod: hash_combine(h, hash_binary_operator<Mod>(e)); break;
+    case IRNodeType::Min: hash_combine(h, hash_binary_operator<Min>(e)); break;
+    case IRNodeType::Max: hash_combine(h, hash_binary_operator<Max>(e)); break;
+    case IRNodeType::EQ: hash_combine(h, hash_binary_operator<EQ>(e)); break;
+    case IRNodeType::NE: hash_combine(h, hash_binary_operator<NE>(e)); break;
+    case IRNodeType::LT: hash_combine(h, hash_binary_operator<LT>(e)); break;
+    case IRNodeType::LE: hash_combine(h, hash_binary_operator<LE>(e)); break;
+    case IRNodeType::GT: hash_combine(h, hash_binary_operator<GT>(e)); break;
+    case IRNodeType::GE: hash_combine(h, hash_binary_operator<GE>(e)); break;
+    case IRNodeType::And: hash_combine(h, hash_binary_operator<And>(e)); break;
+    case IRNodeType::Or: hash_combine(h, hash_binary_operator<Or>(e)); break;
+    case IRNodeType::Not:
+        hash_combine(h, hash_child(e.as<Not>()->a));
+        break;
+    case IRNodeType::Select: {
+        const Select *op = e.as<Select>();
+        hash_combine(h, hash_child(op->condition));
+        hash_combine(h, hash_child(op->true_value));
+        hash_combine(h, hash_child(op->false_value));
+        break;
+    }
+    case IRNodeType::Load: {
+        const Load *op = e.as<Load>();
+        hash_combine(h, std::hash<string>()(op->name));
+        hash_combine(h, hash_child(op->predicate));
+        hash_combine(h, hash_child(op->index));
+        break;
+    }
+    case IRNodeType::Ramp: {
+        const Ramp *op = e.as<Ramp>();
+        hash_combine(h, hash_child(op->base));
+        hash_combine(h, hash_child(op->stride));
+        break;
+    }
+    case IRNodeType::Broadcast:
+        hash_combine(h, hash_child(e.as<Broadcast>()->value));
+        break;
+    case IRNodeType::Call: {
+        const Call *op = e.as<Call>();
+        hash_combine(h, std::hash<string>()(op->name));
+        hash_combine(h, std::hash<int>()((int)op->call_type));
+        hash_combine(h, std::hash<int>()(op->value_index));
+        for (const Expr &arg : op->args) {
+            hash_combine(h, hash_child(arg));
+        }
+        break;
+    }
+    case IRNodeType::Let: {
+        const Let *op = e.as<Let>();
+        hash_combine(h, std::hash<string>()(op->name));
+        hash_combine(h, hash_child(op->value));
+        hash_combine(h, hash_child(op->body));
+        break;
+    }
+    case IRNodeType::Shuffle: {
+        const Shuffle *op = e.as<Shuffle>();
+        for (const Expr &v : op->vectors) {
+            hash_combine(h, hash_child(v));
+        }
+        for (int i : op->indices) {
+            hash_combine(h, std::hash<int>()(i));
+        }
+        break;
+    }
+    case IRNodeType::VectorReduce: {
+        const VectorReduce *op = e.as<VectorReduce>();
+        hash_combine(h, std::hash<int>()((int)op->op));
+        hash_combine(h, hash_child(op->value));
+        break;
+    }
+    default:
+        internal_error << "Unhandled Expr in ExprShallowHash: " << e << "\n";
+    }
+    return h;
+}
+
+bool ExprShallowEqual::operator()(const Expr &a, const Expr &b) const {
+    if (a.same_as(b)) {
+        return true;
+    }
+    if (a->node_type != b->node_type || a.type() != b.type()) {
+        return false;
+    }
+    switch (a->node_type) {
+    case IRNodeType::IntImm:
+        return a.as<IntImm>()->value == b.as<IntImm>()->value;
+    case IRNodeType::UIntImm:
+        return a.as<UIntImm>()->value == b.as<UIntImm>()->value;
+    case IRNodeType::FloatImm:
+        return a.as<FloatImm>()->value == b.as<FloatImm>()->value;
+    case IRNodeType::StringImm:
+        return a.as<StringImm>()->value == b.as<StringImm>()->value;
+    case IRNodeType::Cast:
+        return equal_child(a.as<Cast>()->value, b.as<Cast>()->value);
+    case IRNodeType::Variable:
+        return a.as<Variable>()->name == b.as<Variable>()->name;
+    case IRNodeType::Add: return equal_binary_operator<Add>(a, b);
+    case IRNodeType::Sub: return equal_binary_operator<Sub>(a, b);
+    case IRNodeType::Mul: return equal_binary_operator<Mul>(a, b);
+    case IRNodeType::Div: return equal_binary_operator<Div>(a, b);
+    case IRNodeType::Mod: return equal_binary_operator<Mod>(a, b);
+    case IRNodeType::Min: return equal_binary_operator<Min>(a, b);
+    case IRNodeType::Max: return equal_binary_operator<Max>(a, b);
+    case IRNodeType::EQ: return equal_binary_operator<EQ>(a, b);
+    case IRNodeType::NE: return equal_binary_operator<NE>(a, b);
+    case IRNodeType::LT: return equal_binary_operator<LT>(a, b);
+    case IRNodeType::LE: return equal_binary_operator<LE>(a, b);
+    case IRNodeType::GT: return equal_binary_operator<GT>(a, b);
+    case IRNodeType::GE: return equal_binary_operator<GE>(a, b);
+    case IRNodeType::And: return equal_binary_operator<And>(a, b);
+    case IRNodeType::Or: return equal_binary_operator<Or>(a, b);
+    case IRNodeType::Not:
+        return equal_child(a.as<Not>()->a, b.as<Not>()->a);
+    case IRNodeType::Select: {
+        const Select *op_a = a.as<Select>(), *op_b = b.as<Select>();
+        return (equal_child(op_a->condition, op_b->condition) &&
+                equal_child(op_a->true_value, op_b->true_value) &&
+                equal_child(op_a->false_value, op_b->false_value));
+    }
+    case IRNodeType::Load: {
+        const Load *op_a = a.as<Load>(), *op_b = b.as<Load>();
+        return (op_a->name == op_b->name &&
+                equal_child(op_a->predicate, op_b->predicate) &&
+                equal_child(op_a->index, op_b->index));
+    }
+    case IRNodeType::Ramp: {
+        const Ramp *op_a = a.as<Ramp>(), *op_b = b.as<Ramp>();
+        return (equal_child(op_a->base, op_b->base) &&
+                equal_child(op_a->stride, op_b->stride));
+    }
+    case IRNodeType::Broadcast:
+        return equal_child(a.as<Broadcast>()->value, b.as<Broadcast>()->value);
+    case IRNodeType::Call: {
+        const Call *op_a = a.as<Call>(), *op_b = b.as<Call>();
+        return (op_a->name == op_b->name &&
+                op_a->call_type == op_b->call_type &&
+                op_a->value_index == op_b->value_index &&
+                equal_children(op_a->args, op_b->args));
+    }
+    case IRNodeType::Let: {
+        const Let *op_a = a.as<Let>(), *op_b = b.as<Let>();
+        return (op_a->name == op_b->name &&
+                equal_child(op_a->value, op_b->value) &&
+                equal_child(op_a->body, op_b->body));
+    }
+    case IRNodeType::Shuffle: {
+        const Shuffle *op_a = a.as<Shuffle>(), *op_b = b.as<Shuffle>();
+        return (op_a->indices == op_b->indices &&
+                equal_children(op_a->vectors, op_b->vectors));
+    }
+    case IRNodeType::VectorReduce: {
+        const VectorReduce *op_a = a.as<VectorReduce>(), *op_b = b.as<VectorReduce>();
+        return (op_a->op == op_b->op &&
+                equal_child(op_a->value, op_b->value));
+    }
+    default:
+        internal_error << "Unhandled Expr in ExprShallowEqual: " << a << "\n";
+    }
+    return false;
+}
+
 // Testing code
 namespace {
 
@@ -101,6 +101,23 @@ struct ExprWithCompareCache {
     EXPORT bool operator<(const ExprWithCompareCache &other) const;
 };
 
+/** Hash and compare Exprs by their own fields, but by the identity
+ * of their children, without recursing. For Exprs whose children
+ * have been hash-consed (so that children that are equal by value
+ * are the same node), this is equality of value in constant time,
+ * which lets such Exprs be the keys of unordered containers. Constant
+ * children are compared by value, because they are usually rebuilt
+ * rather than shared. */
+// @{
+struct ExprShallowHash {
+    EXPORT size_t operator()(const Expr &e) const;
+};
+
+struct ExprShallowEqual {
+    EXPORT bool operator()(const Expr &a, const Expr &b) const;
+};
+// @}
+
 /** Compare IR nodes for equality of value. Traverses entire IR
  * tree. For equality of reference, use Expr::same_as. If you're
  * comparing non-CSE'd Exprs, use graph_equal, which is safe for nasty
@@ -283,7 +283,7 @@ void IRMutator::visit(const Allocate *op) {
         new_expr.same_as(op->new_expr)) {
         stmt = op;
     } else {
-        stmt = Allocate::make(op->name, op->type, new_extents, std::move(condition),
+        stmt = Allocate::make(op->name, op->type, op->memory_type, new_extents, std::move(condition),
                               std::move(body), std::move(new_expr), op->free_function);
     }
 }
@@ -306,7 +306,7 @@ void IRMutator::visit(const Realize *op) {
         condition.same_as(op->condition)) {
         stmt = op;
     } else {
-        stmt = Realize::make(op->name, op->types, new_bounds,
+        stmt = Realize::make(op->name, op->types, op->memory_type, new_bounds,
                              std::move(condition), std::move(body));
     }
 }
@@ -325,6 +325,15 @@ void IRMutator::visit(const Prefetch *op) {
     }
 }
 
+void IRMutator::visit(const Atomic *op) {
+    Stmt body = mutate(op->body);
+    if (body.same_as(op->body)) {
+        stmt = op;
+    } else {
+        stmt = Atomic::make(op->producer_name, std::move(body));
+    }
+}
+
 void IRMutator::visit(const Block *op) {
     Stmt first = mutate(op->first);
     Stmt rest = mutate(op->rest);
@@ -376,6 +385,15 @@ void IRMutator::visit(const Shuffle *op) {
     }
 }
 
+void IRMutator::visit(const VectorReduce *op) {
+    Expr value = mutate(op->value);
+    if (value.same_as(op->value)) {
+        expr = op;
+    } else {
+        expr = VectorReduce::make(op->op, std::move(value), op->type.lanes());
+    }
+}
+
 
 IRMutator2::~IRMutator2() {
 }
@@ -604,7 +622,7 @@ Stmt IRMutator2::visit(const Allocate *op) {
         new_expr.same_as(op->new_expr)) {
         return op;
     }
-    return Allocate::make(op->name, op->type, new_extents, std::move(condition),
+    return Allocate::make(op->name, op->type, op->memory_type, new_extents, std::move(condition),
                               std::move(body), std::move(new_expr), op->free_function);
 }
 
@@ -626,7 +644,7 @@ Stmt IRMutator2::visit(const Realize *op) {
         condition.same_as(op->condition)) {
         return op;
     }
-    return Realize::make(op->name, op->types, new_bounds,
+    return Realize::make(op->name, op->types, op->memory_type, new_bounds,
                              std::move(condition), std::move(body));
 }
 
@@ -643,6 +661,14 @@ Stmt IRMutator2::visit(const Prefetch *op) {
     return Prefetch::make(op->name, op->types, new_bounds, op->param);
 }
 
+Stmt IRMutator2::visit(const Atomic *op) {
+    Stmt body = mutate(op->body);
+    if (body.same_as(op->body)) {
+        return op;
+    }
+    return Atomic::make(op->producer_name, std::move(body));
+}
+
 Stmt IRMutator2::visit(const Block *op) {
     Stmt first = mutate(op->first);
     Stmt rest = mutate(op->rest);
@@ -690,6 +716,14 @@ Expr IRMutator2::visit(const Shuffle *op) {
     return Shuffle::make(new_vectors, op->indices);
 }
 
+Expr IRMutator2::visit(const VectorReduce *op) {
+    Expr value = mutate(op->value);
+    if (value.same_as(op->value)) {
+        return op;
+    }
+    return VectorReduce::make(op->op, std::move(value), op->type.lanes());
+}
+
 Stmt IRGraphMutator2::mutate(const Stmt &s) {
     auto iter = stmt_replacements.find(s);
     if (iter != stmt_replacements.end()) {
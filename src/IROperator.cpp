@@ -886,6 +886,25 @@ Expr memoize_tag_helper(Expr result, const std::vector<Expr> &cache_key_values)
 
 }  // namespace Internal
 
+Expr unsafe_promise_clamped(Expr value, Expr min_val, Expr max_val) {
+    user_assert(value.defined() && min_val.defined() && max_val.defined())
+        << "unsafe_promise_clamped of undefined Expr\n";
+    Expr n_min_val = lossless_cast(value.type(), min_val);
+    user_assert(n_min_val.defined())
+        << "Type mismatch in call to unsafe_promise_clamped. First argument ("
+        << value << ") has type " << value.type() << ", but second argument ("
+        << min_val << ") has type " << min_val.type() << ". Use an explicit cast.\n";
+    Expr n_max_val = lossless_cast(value.type(), max_val);
+    user_assert(n_max_val.defined())
+        << "Type mismatch in call to unsafe_promise_clamped. First argument ("
+        << value << ") has type " << value.type() << ", but third argument ("
+        << max_val << ") has type " << max_val.type() << ". Use an explicit cast.\n";
+    Type t = value.type();
+    return Internal::Call::make(t, Internal::Call::promise_clamped,
+                                {std::move(value), std::move(n_min_val), std::move(n_max_val)},
+                                Internal::Call::PureIntrinsic);
+}
+
 Expr saturating_cast(Type t, Expr e) {
     // For float to float, guarantee infinities are always pinned to range.
     if (t.is_float() && e.type().is_float()) {
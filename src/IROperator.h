@@ -96,6 +96,7 @@ inline Expr make_const(Type t, uint8_t val)   {return make_const(t, (uint64_t)va
 inline Expr make_const(Type t, bool val)      {return make_const(t, (uint64_t)val);}
 inline Expr make_const(Type t, float val)     {return make_const(t, (double)val);}
 inline Expr make_const(Type t, float16_t val) {return make_const(t, (double)val);}
+inline Expr make_const(Type t, bfloat16_t val) {return make_const(t, (double)val);}
 // @}
 
 /** Check if a constant value can be correctly represented as the given type. */
@@ -1242,6 +1243,8 @@ inline Expr floor(Expr x) {
         return Internal::Call::make(t, "floor_f64", {std::move(x)}, Internal::Call::PureExtern);
     } else if (t.element_of() == Float(16)) {
         return Internal::Call::make(t, "floor_f16", {std::move(x)}, Internal::Call::PureExtern);
+    } else if (t.is_bfloat()) {
+        return cast(t, floor(cast(Float(32, t.lanes()), std::move(x))));
     } else {
         t = t.with_code(Type::Float);
         return Internal::Call::make(t, "floor_f32", {cast(t, std::move(x))}, Internal::Call::PureExtern);
@@ -1259,6 +1262,8 @@ inline Expr ceil(Expr x) {
         return Internal::Call::make(t, "ceil_f64", {std::move(x)}, Internal::Call::PureExtern);
     } else if (x.type().element_of() == Float(16)) {
         return Internal::Call::make(t, "ceil_f16", {std::move(x)}, Internal::Call::PureExtern);
+    } else if (t.is_bfloat()) {
+        return cast(t, ceil(cast(Float(32, t.lanes()), std::move(x))));
     } else {
         t = t.with_code(Type::Float);
         return Internal::Call::make(t, "ceil_f32", {cast(t, std::move(x))}, Internal::Call::PureExtern);
@@ -1277,6 +1282,8 @@ inline Expr round(Expr x) {
         return Internal::Call::make(t, "round_f64", {std::move(x)}, Internal::Call::PureExtern);
     } else if (t.element_of() == Float(16)) {
         return Internal::Call::make(t, "round_f16", {std::move(x)}, Internal::Call::PureExtern);
+    } else if (t.is_bfloat()) {
+        return cast(t, round(cast(Float(32, t.lanes()), std::move(x))));
     } else {
         t = t.with_code(Type::Float);
         return Internal::Call::make(t, "round_f32", {cast(t, std::move(x))}, Internal::Call::PureExtern);
@@ -1293,6 +1300,8 @@ inline Expr trunc(Expr x) {
         return Internal::Call::make(t, "trunc_f64", {std::move(x)}, Internal::Call::PureExtern);
     } else if (t.element_of() == Float(16)) {
         return Internal::Call::make(t, "trunc_f16", {std::move(x)}, Internal::Call::PureExtern);
+    } else if (t.is_bfloat()) {
+        return cast(t, trunc(cast(Float(32, t.lanes()), std::move(x))));
     } else {
         t = t.with_code(Type::Float);
         return Internal::Call::make(t, "trunc_f32", {cast(t, std::move(x))}, Internal::Call::PureExtern);
@@ -1307,10 +1316,10 @@ inline Expr is_nan(Expr x) {
     Type t = Bool(x.type().lanes());
     if (x.type().element_of() == Float(64)) {
         return Internal::Call::make(t, "is_nan_f64", {std::move(x)}, Internal::Call::PureExtern);
-    } else if (x.type().element_of() == Float(64)) {
+    } else if (x.type().element_of() == Float(16)) {
         return Internal::Call::make(t, "is_nan_f16", {std::move(x)}, Internal::Call::PureExtern);
     } else {
-        Type ft = x.type().with_code(Type::Float);
+        Type ft = Float(32, x.type().lanes());
         return Internal::Call::make(t, "is_nan_f32", {cast(ft, std::move(x))}, Internal::Call::PureExtern);
     }
 }
@@ -1646,11 +1655,48 @@ inline Expr mod_round_to_zero(Expr x, Expr y) {
                                 Internal::Call::PureIntrinsic);
 }
 
+/** The pseudo-random number generators that random_float,
+ * random_uint and random_int can use. */
+enum class RandomGenerator {
+    /** A chain of cheap permutation polynomials, one per input
+     * (i.e. per dimension of the Func). Two 32-bit multiplies per
+     * input, and good enough for most image processing. */
+    Hash,
+
+    /** The Philox4x32-10 counter-based generator (Salmon et al.,
+     * "Parallel Random Numbers: As Easy as 1, 2, 3", SC 2011), with
+     * the pure variables as the counter and the seed and identity of
+     * the call as the key. It passes far stronger statistical tests
+     * than Hash. It costs ten rounds of two 32x32->64-bit multiplies
+     * regardless of the number of dimensions (up to four), all of
+     * which vectorize, and makes 128 random bits per evaluation, so
+     * random_uint64 costs no more than random_uint. */
+    Philox
+};
+
+namespace Internal {
+inline Expr make_random_call(Type t, Expr seed, int id, RandomGenerator generator, const char *caller) {
+    std::vector<Expr> args;
+    if (seed.defined()) {
+        user_assert(seed.type() == Int(32) || seed.type() == UInt(32))
+            << "The seed passed to " << caller << " must have type Int(32) or UInt(32), but instead is "
+            << seed << " of type " << seed.type() << "\n";
+        args.push_back(std::move(seed));
+    }
+    args.push_back(id);
+
+    // This is (surprisingly) pure - it's a fixed psuedo-random
+    // function of its inputs.
+    return Call::make(t, generator == RandomGenerator::Philox ? Call::random_philox : Call::random,
+                      args, Call::PureIntrinsic);
+}
+}
+
 /** Return a random variable representing a uniformly distributed
  * float in the half-open interval [0.0f, 1.0f). For random numbers of
  * other types, use lerp with a random float as the last parameter.
  *
- * Optionally takes a seed.
+ * Optionally takes a seed, and the generator to use.
  *
  * Note that:
  \code
@@ -1675,50 +1721,42 @@ inline Expr mod_round_to_zero(Expr x, Expr y) {
  *
  * This function vectorizes cleanly.
  */
-inline Expr random_float(Expr seed = Expr()) {
+inline Expr random_float(Expr seed = Expr(), RandomGenerator generator = RandomGenerator::Hash) {
     // Random floats get even IDs
     static std::atomic<int> counter;
     int id = (counter++)*2;
-
-    std::vector<Expr> args;
     if (seed.defined()) {
         user_assert(seed.type() == Int(32))
             << "The seed passed to random_float must have type Int(32), but instead is "
             << seed << " of type " << seed.type() << "\n";
-        args.push_back(std::move(seed));
     }
-    args.push_back(id);
-
-    // This is (surprisingly) pure - it's a fixed psuedo-random
-    // function of its inputs.
-    return Internal::Call::make(Float(32), Internal::Call::random,
-                                args, Internal::Call::PureIntrinsic);
+    return Internal::make_random_call(Float(32), std::move(seed), id, generator, "random_float");
 }
 
 /** Return a random variable representing a uniformly distributed
  * unsigned 32-bit integer. See \ref random_float. Vectorizes cleanly. */
-inline Expr random_uint(Expr seed = Expr()) {
+inline Expr random_uint(Expr seed = Expr(), RandomGenerator generator = RandomGenerator::Hash) {
     // Random ints get odd IDs
     static std::atomic<int> counter;
     int id = (counter++)*2 + 1;
-
-    std::vector<Expr> args;
-    if (seed.defined()) {
-        user_assert(seed.type() == Int(32) || seed.type() == UInt(32))
-            << "The seed passed to random_int must have type Int(32) or UInt(32), but instead is "
-            << seed << " of type " << seed.type() << "\n";
-        args.push_back(std::move(seed));
-    }
-    args.push_back(id);
-
-    return Internal::Call::make(UInt(32), Internal::Call::random,
-                                args, Internal::Call::PureIntrinsic);
+    return Internal::make_random_call(UInt(32), std::move(seed), id, generator, "random_int");
 }
 
 /** Return a random variable representing a uniformly distributed
  * 32-bit integer. See \ref random_float. Vectorizes cleanly. */
-inline Expr random_int(Expr seed = Expr()) {
-    return cast<int32_t>(random_uint(std::move(seed)));
+inline Expr random_int(Expr seed = Expr(), RandomGenerator generator = RandomGenerator::Hash) {
+    return cast<int32_t>(random_uint(std::move(seed), generator));
+}
+
+/** Return a random variable representing a uniformly distributed
+ * unsigned 64-bit integer. Always uses RandomGenerator::Philox. See
+ * \ref random_float. Vectorizes cleanly. */
+inline Expr random_uint64(Expr seed = Expr()) {
+    // These IDs overlap with random_uint's, but the Philox key also
+    // includes the type.
+    static std::atomic<int> counter;
+    int id = (counter++)*2 + 1;
+    return Internal::make_random_call(UInt(64), std::move(seed), id, RandomGenerator::Philox, "random_uint64");
 }
 
 // Secondary args to print can be Exprs or const char *
@@ -1896,6 +1934,15 @@ inline Expr likely_if_innermost(Expr e) {
                                 {std::move(e)}, Internal::Call::PureIntrinsic);
 }
 
+/** Promise that value is between min_val and max_val, without
+ * clamping it. Bounds inference uses the promise, so data-dependent
+ * accesses such as lookup tables and histograms indexed by the values
+ * of another Func don't require the whole range of the index's type,
+ * and no clamp appears in the generated code. If the promise is
+ * broken, the behavior is undefined (out-of-bounds accesses are
+ * likely). */
+EXPORT Expr unsafe_promise_clamped(Expr value, Expr min_val, Expr max_val);
+
 
 /** Cast an expression to the halide type corresponding to the C++
  * type T clamping to the minimum and maximum values of the result
@@ -1,4 +1,7 @@
+#include <cctype>
+#include <cstdio>
 #include <iostream>
+#include <map>
 #include <sstream>
 
 #include "IRPrinter.h"
@@ -25,6 +28,9 @@ ostream &operator<<(ostream &out, const Type &type) {
     case Type::Float:
         out << "float";
         break;
+    case Type::BFloat:
+        out << "bfloat";
+        break;
     case Type::Handle:
         if (type.handle_type) {
             out << "(" << type.handle_type->inner_name.name << " *)";
@@ -95,6 +101,30 @@ ostream &operator<<(ostream &out, const DeviceAPI &api) {
     return out;
 }
 
+ostream &operator<<(ostream &out, const MemoryType &t) {
+    switch (t) {
+    case MemoryType::Auto:
+        out << "Auto";
+        break;
+    case MemoryType::Heap:
+        out << "Heap";
+        break;
+    case MemoryType::Stack:
+        out << "Stack";
+        break;
+    case MemoryType::Register:
+        out << "Register";
+        break;
+    case MemoryType::GPUShared:
+        out << "GPUShared";
+        break;
+    case MemoryType::VTCM:
+        out << "VTCM";
+        break;
+    }
+    return out;
+}
+
 ostream &operator<<(ostream &stream, const LoopLevel &loop_level) {
     return stream << "loop_level("
         << (loop_level.defined() ? loop_level.to_string() : "undefined")
@@ -130,12 +160,12 @@ void IRPrinter::test() {
                                                          {string("y"), y, 3}, Call::Extern));
     Stmt block = Block::make(assertion, pipeline);
     Stmt let_stmt = LetStmt::make("y", 17, block);
-    Stmt allocate = Allocate::make("buf", f32, {1023}, const_true(), let_stmt);
+    Stmt allocate = Allocate::make("buf", f32, MemoryType::Stack, {1023}, const_true(), let_stmt);
 
     ostringstream source;
     source << allocate;
     std::string correct_source = \
-        "allocate buf[float32 * 1023]\n"
+        "allocate buf[float32 * 1023] in Stack\n"
         "let y = 17\n"
         "assert((y >= 3), halide_error_param_too_small_i64(\"y\", y, 3))\n"
         "produce buf {\n"
@@ -196,6 +226,33 @@ ostream &operator<<(ostream &out, const ForType &type) {
     case ForType::GPUThread:
         out << "gpu_thread";
         break;
+    case ForType::GPULane:
+        out << "gpu_lane";
+        break;
+    }
+    return out;
+}
+
+ostream &operator<<(ostream &out, const VectorReduce::Operator &op) {
+    switch (op) {
+    case VectorReduce::Add:
+        out << "Add";
+        break;
+    case VectorReduce::Mul:
+        out << "Mul";
+        break;
+    case VectorReduce::Min:
+        out << "Min";
+        break;
+    case VectorReduce::Max:
+        out << "Max";
+        break;
+    case VectorReduce::And:
+        out << "And";
+        break;
+    case VectorReduce::Or:
+        out << "Or";
+        break;
     }
     return out;
 }
@@ -256,6 +313,64 @@ std::ostream &operator<<(std::ostream &out, const LoweredFunc::LinkageType &type
     return out;
 }
 
+namespace {
+
+class PrintFloatImmsExactly : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+
+    void visit(const FloatImm *op) override {
+        char buf[64];
+        snprintf(buf, sizeof(buf), " %a", op->value);
+        stream << buf;
+    }
+
+public:
+    ostream &stream;
+    PrintFloatImmsExactly(ostream &stream) : stream(stream) {}
+};
+
+}  // namespace
+
+void print_float_imms_exactly(ostream &stream, const Stmt &s) {
+    PrintFloatImmsExactly printer(stream);
+    s.accept(&printer);
+}
+
+string renumber_unique_names(const string &text) {
+    std::map<string, int> renamed;
+    string result;
+    result.reserve(text.size());
+    size_t i = 0;
+    while (i < text.size()) {
+        if (!isalnum(text[i]) && text[i] != '_') {
+            result += text[i++];
+            continue;
+        }
+        size_t end = i;
+        while (end < text.size() && (isalnum(text[end]) || text[end] == '_')) {
+            end++;
+        }
+        string token = text.substr(i, end - i);
+        bool after_dollar = i > 0 && text[i - 1] == '$';
+        bool letter_and_digits = token.size() > 1 && isalpha(token[0]);
+        for (size_t j = 1; letter_and_digits && j < token.size(); j++) {
+            letter_and_digits = isdigit(token[j]);
+        }
+        if (after_dollar || letter_and_digits) {
+            string key = (after_dollar ? "$" : "") + token;
+            auto iter = renamed.find(key);
+            if (iter == renamed.end()) {
+                iter = renamed.emplace(key, (int)renamed.size()).first;
+            }
+            result += "#" + std::to_string(iter->second);
+        } else {
+            result += token;
+        }
+        i = end;
+    }
+    return result;
+}
+
 IRPrinter::IRPrinter(ostream &s) : stream(s), indent(0) {
     s.setf(std::ios::fixed, std::ios::floatfield);
 }
@@ -302,7 +417,7 @@ void IRPrinter::visit(const FloatImm *op) {
         stream << op->value << 'f';
         break;
     case 16:
-        stream << op->value << 'h';
+        stream << op->value << (op->type.is_bfloat() ? "bf" : "h");
         break;
     default:
         internal_error << "Bad bit-width for float: " << op->type << "\n";
@@ -621,6 +736,9 @@ void IRPrinter::visit(const Allocate *op) {
         print(op->extents[i]);
     }
     stream << "]";
+    if (op->memory_type != MemoryType::Auto) {
+        stream << " in " << op->memory_type;
+    }
     if (!is_one(op->condition)) {
         stream << " if ";
         print(op->condition);
@@ -653,6 +771,9 @@ void IRPrinter::visit(const Realize *op) {
         if (i < op->bounds.size() - 1) stream << ", ";
     }
     stream << ")";
+    if (op->memory_type != MemoryType::Auto) {
+        stream << " in " << op->memory_type;
+    }
     if (!is_one(op->condition)) {
         stream << " if ";
         print(op->condition);
@@ -681,6 +802,26 @@ void IRPrinter::visit(const Prefetch *op) {
     stream << ")\n";
 }
 
+void IRPrinter::visit(const VectorReduce *op) {
+    stream << "("
+           << op->type
+           << ")vector_reduce("
+           << op->op
+           << ", "
+           << op->value
+           << ")";
+}
+
+void IRPrinter::visit(const Atomic *op) {
+    do_indent();
+    stream << "atomic (" << op->producer_name << ") {\n";
+    indent += 2;
+    print(op->body);
+    indent -= 2;
+    do_indent();
+    stream << "}\n";
+}
+
 void IRPrinter::visit(const Block *op) {
     print(op->first);
     if (op->rest.defined()) print(op->rest);
@@ -36,6 +36,9 @@ EXPORT std::ostream &operator<<(std::ostream &stream, const Module &);
 /** Emit a halide device api type in a human readable form */
 EXPORT std::ostream &operator<<(std::ostream &stream, const DeviceAPI &);
 
+/** Emit a halide memory type in a human readable form */
+EXPORT std::ostream &operator<<(std::ostream &stream, const MemoryType &);
+
 /** Emit a halide LoopLevel in a human readable form */
 EXPORT std::ostream &operator<<(std::ostream &stream, const LoopLevel &);
 
@@ -60,9 +63,26 @@ EXPORT std::ostream &operator<<(std::ostream &stream, const Stmt &);
  * readable form */
 EXPORT std::ostream &operator<<(std::ostream &stream, const ForType &);
 
+/** Emit a horizontal vector reduction op in human-readable form. */
+EXPORT std::ostream &operator<<(std::ostream &stream, const VectorReduce::Operator &);
+
 /** Emit a halide name mangling value in a human readable format */
 EXPORT std::ostream &operator<<(std::ostream &stream, const NameMangling &);
 
+/** Emit the linkage of a lowered function in a human readable form */
+EXPORT std::ostream &operator<<(std::ostream &stream, const LoweredFunc::LinkageType &);
+
+/** Emit the float constants of a statement exactly, in hex and in the
+ * order they're visited. Printing a statement rounds them. */
+EXPORT void print_float_imms_exactly(std::ostream &stream, const Stmt &s);
+
+/** Number the names made by unique_name in some printed IR (a letter
+ * followed by digits, or anything after a '$') in order of first
+ * appearance. Those names come from global counters, so this makes
+ * two lowerings of the same code print the same, up to a consistent
+ * renaming of those names. */
+EXPORT std::string renumber_unique_names(const std::string &text);
+
 /** An IRVisitor that emits IR to the given output stream in a human
  * readable form. Can be subclassed if you want to modify the way in
  * which it prints.
@@ -140,6 +160,8 @@ protected:
     void visit(const Evaluate *);
     void visit(const Shuffle *);
     void visit(const Prefetch *);
+    void visit(const Atomic *);
+    void visit(const VectorReduce *);
 };
 }
 }
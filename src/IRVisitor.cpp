@@ -213,6 +213,10 @@ void IRVisitor::visit(const Prefetch *op) {
     }
 }
 
+void IRVisitor::visit(const Atomic *op) {
+    op->body.accept(this);
+}
+
 void IRVisitor::visit(const Block *op) {
     op->first.accept(this);
     if (op->rest.defined()) {
@@ -238,6 +242,10 @@ void IRVisitor::visit(const Shuffle *op) {
     }
 }
 
+void IRVisitor::visit(const VectorReduce *op) {
+    op->value.accept(this);
+}
+
 void IRGraphVisitor::include(const Expr &e) {
     if (!visited.count(e.get())) {
         visited.insert(e.get());
@@ -446,6 +454,10 @@ void IRGraphVisitor::visit(const Prefetch *op) {
     }
 }
 
+void IRGraphVisitor::visit(const Atomic *op) {
+    include(op->body);
+}
+
 void IRGraphVisitor::visit(const Block *op) {
     include(op->first);
     if (op->rest.defined()) include(op->rest);
@@ -469,5 +481,9 @@ void IRGraphVisitor::visit(const Shuffle *op) {
     }
 }
 
+void IRGraphVisitor::visit(const VectorReduce *op) {
+    include(op->value);
+}
+
 }
 }
@@ -69,6 +69,8 @@ protected:
     EXPORT virtual void visit(const Evaluate *);
     EXPORT virtual void visit(const Shuffle *);
     EXPORT virtual void visit(const Prefetch *);
+    EXPORT virtual void visit(const Atomic *);
+    EXPORT virtual void visit(const VectorReduce *);
 };
 
 /** A base class for algorithms that walk recursively over the IR
@@ -135,6 +137,8 @@ protected:
     EXPORT void visit(const Evaluate *) override;
     EXPORT void visit(const Shuffle *) override;
     EXPORT void visit(const Prefetch *) override;
+    EXPORT void visit(const Atomic *) override;
+    EXPORT void visit(const VectorReduce *) override;
     // @}
 };
 
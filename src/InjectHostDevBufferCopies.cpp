@@ -141,6 +141,11 @@ class InjectBufferCopiesForSingleBuffer : public IRMutator2 {
 
     bool is_external;
 
+    // Whether the buffer is a CUDA managed allocation, in which case
+    // copies become prefetches and it never needs a separate device
+    // allocation.
+    bool is_managed;
+
     enum FlagState {
         Unknown,
         False,
@@ -181,11 +186,25 @@ class InjectBufferCopiesForSingleBuffer : public IRMutator2 {
         return device_malloc;
     }
 
+    Stmt make_managed_prefetch(bool to_device) {
+        // Prefetch the whole buffer. The runtime takes a byte range,
+        // but the leaf stmts here have already been flattened.
+        return call_extern_and_assert("halide_cuda_managed_prefetch",
+                                      {buffer_var(), to_device ? 1 : 0,
+                                       make_zero(Int(64)), make_const(Int(64), -1)});
+    }
+
     Stmt make_copy_to_host() {
+        if (is_managed) {
+            return make_managed_prefetch(false);
+        }
         return call_extern_and_assert("halide_copy_to_host", {buffer_var()});
     }
 
     Stmt make_copy_to_device(DeviceAPI target_device_api) {
+        if (is_managed) {
+            return make_managed_prefetch(true);
+        }
         Expr device_interface = make_device_interface_call(target_device_api);
         return call_extern_and_assert("halide_copy_to_device", {buffer_var(), device_interface});
     }
@@ -228,6 +247,7 @@ class InjectBufferCopiesForSingleBuffer : public IRMutator2 {
 
         // Then figure out what to do
         bool needs_device_malloc = (touched_on_device &&
+                                    !is_managed &&
                                     (state.device_allocation_exists != True));
 
         bool needs_device_flip = (state.device_allocation_exists != False &&
@@ -395,11 +415,18 @@ class InjectBufferCopiesForSingleBuffer : public IRMutator2 {
     }
 
 public:
-    InjectBufferCopiesForSingleBuffer(const std::string &b, bool e) :
-        buffer(b), is_external(e) {
+    InjectBufferCopiesForSingleBuffer(const std::string &b, bool e, bool m = false) :
+        buffer(b), is_external(e), is_managed(m) {
         if (is_external) {
             // The state of the buffer is totally unknown, which is
             // the default constructor for this->state
+        } else if (is_managed) {
+            // A fresh managed allocation exists on the host and the
+            // device at once.
+            state.device_allocation_exists = True;
+            state.device_dirty = False;
+            state.host_dirty = False;
+            state.current_device = DeviceAPI::CUDA;
         } else {
             // This is a fresh allocation
             state.device_allocation_exists = False;
@@ -455,7 +482,7 @@ class InjectBufferCopies : public IRMutator2 {
 
                 // The allocate node is innermost
                 Expr host = Call::make(Handle(), Call::buffer_get_host, {buf}, Call::Extern);
-                body = Allocate::make(buffer, type, extents, condition, body,
+                body = Allocate::make(buffer, type, MemoryType::Heap, extents, condition, body,
                                       host, "halide_device_host_nop_free");
 
                 // Then the destructor
@@ -466,9 +493,14 @@ class InjectBufferCopies : public IRMutator2 {
                 body = Block::make(destructor, body);
 
                 // Then the device_and_host malloc
-                Expr device_interface = make_device_interface_call(device_api);
-                Stmt device_malloc = call_extern_and_assert("halide_device_and_host_malloc",
-                                                            {buf, device_interface});
+                Stmt device_malloc;
+                if (managed) {
+                    device_malloc = call_extern_and_assert("halide_cuda_device_and_host_malloc_managed", {buf});
+                } else {
+                    Expr device_interface = make_device_interface_call(device_api);
+                    device_malloc = call_extern_and_assert("halide_device_and_host_malloc",
+                                                           {buf, device_interface});
+                }
                 if (!is_one(condition)) {
                     device_malloc = IfThenElse::make(condition, device_malloc);
                 }
@@ -489,9 +521,10 @@ class InjectBufferCopies : public IRMutator2 {
         vector<Expr> extents;
         Expr condition;
         DeviceAPI device_api;
+        bool managed;
     public:
-        InjectCombinedAllocation(string b, Type t, vector<Expr> e, Expr c, DeviceAPI d) :
-            buffer(b), type(t), extents(e), condition(c), device_api(d) {}
+        InjectCombinedAllocation(string b, Type t, vector<Expr> e, Expr c, DeviceAPI d, bool m) :
+            buffer(b), type(t), extents(e), condition(c), device_api(d), managed(m) {}
     };
 
     class FreeAfterLastUse : public IRMutator2 {
@@ -523,24 +556,35 @@ class InjectBufferCopies : public IRMutator2 {
             return IRMutator2::visit(op);
         }
 
+        // Decide what type of allocation to make.
+        bool combined = touched_on_host && finder.devices_touched.size() == 2;
+        DeviceAPI touching_device = DeviceAPI::None;
+        if (combined) {
+            for (DeviceAPI d : finder.devices_touched) {
+                if (d != DeviceAPI::Host) {
+                    touching_device = d;
+                }
+            }
+        }
+
+        // Buffers shared by the host and CUDA kernels can be a single
+        // managed allocation, unless an extern stage might replace or
+        // flip the device allocation.
+        bool managed = (combined &&
+                        touching_device == DeviceAPI::CUDA &&
+                        !finder.touched_by_extern &&
+                        target.has_feature(Target::CUDAManagedMemory));
+
         Stmt body = mutate(op->body);
 
-        InjectBufferCopiesForSingleBuffer injector(op->name, false);
+        InjectBufferCopiesForSingleBuffer injector(op->name, false, managed);
         body = injector.mutate(body);
 
         string buffer_name = op->name + ".buffer";
         Expr buffer = Variable::make(Handle(), buffer_name);
 
-        // Device what type of allocation to make.
-
-        if (touched_on_host && finder.devices_touched.size() == 2) {
+        if (combined) {
             // Touched on a single device and the host. Use a combined allocation.
-            DeviceAPI touching_device = DeviceAPI::None;
-            for (DeviceAPI d : finder.devices_touched) {
-                if (d != DeviceAPI::Host) {
-                    touching_device = d;
-                }
-            }
 
             // Make a device_and_host_free stmt
             if (injector.last_use.defined()) {
@@ -549,7 +593,7 @@ class InjectBufferCopies : public IRMutator2 {
             }
 
             return InjectCombinedAllocation(op->name, op->type, op->extents,
-                                            op->condition, touching_device).mutate(body);
+                                            op->condition, touching_device, managed).mutate(body);
         } else {
             // Only touched on host but passed to an extern stage, or
             // only touched on device, or touched on multiple
@@ -576,7 +620,7 @@ class InjectBufferCopies : public IRMutator2 {
                 body = substitute(op->name, reinterpret(Handle(), make_zero(UInt(64))), body);
             }
 
-            return Allocate::make(op->name, op->type, op->extents, condition, body, op->new_expr, op->free_function);
+            return Allocate::make(op->name, op->type, op->memory_type, op->extents, condition, body, op->new_expr, op->free_function);
         }
     }
 
@@ -589,6 +633,10 @@ class InjectBufferCopies : public IRMutator2 {
             return IRMutator2::visit(op);
         }
     }
+
+    const Target &target;
+public:
+    InjectBufferCopies(const Target &t) : target(t) {}
 };
 
 // Find the site in the IR where we want to inject the copies/dirty
@@ -681,7 +729,7 @@ public:
 
 Stmt inject_host_dev_buffer_copies(Stmt s, const Target &t) {
     // Handle internal allocations
-    s = InjectBufferCopies().mutate(s);
+    s = InjectBufferCopies(t).mutate(s);
 
     // Handle inputs and outputs
     FindOutermostProduce outermost;
@@ -59,7 +59,10 @@ EXPORT Expr minimum(RDom, Expr, const std::string &s = "minimum");
 /** Returns an Expr or Tuple representing the coordinates of the point
  * in the RDom which minimizes or maximizes the expression. The
  * expression must refer to some RDom. Also returns the extreme value
- * of the expression as the last element of the tuple. */
+ * of the expression as the last element of the tuple. The update is
+ * recognized as associative, so it can be rfactored and the
+ * intermediate vectorized (the first point in the RDom at which the
+ * extremum occurs wins within each intermediate). */
 // @{
 EXPORT Tuple argmax(Expr, const std::string &s = "argmax");
 EXPORT Tuple argmin(Expr, const std::string &s = "argmin");
@@ -6,6 +6,7 @@
 #include "LLVM_Headers.h"
 #include "Error.h"
 
+#include <mutex>
 #include <string>
 #include <iostream>
 #include <sstream>
@@ -2162,11 +2163,16 @@ private:
 
 namespace {
 DebugSections *debug_sections = nullptr;
+
+// The heap object registry is updated as Generators are constructed
+// and destroyed, which can happen on several threads at once.
+std::mutex debug_sections_mutex;
 }
 
 std::string get_variable_name(const void *var, const std::string &expected_type) {
     if (!debug_sections) return "";
     if (!debug_sections->working) return "";
+    std::lock_guard<std::mutex> lock(debug_sections_mutex);
     std::string name = debug_sections->get_stack_variable_name(var, expected_type);
     if (name.empty()) {
         // Maybe it's a member of a heap object.
@@ -2183,12 +2189,14 @@ std::string get_variable_name(const void *var, const std::string &expected_type)
 std::string get_source_location() {
     if (!debug_sections) return "";
     if (!debug_sections->working) return "";
+    std::lock_guard<std::mutex> lock(debug_sections_mutex);
     return debug_sections->get_source_location();
 }
 
 void register_heap_object(const void *obj, size_t size, const void *helper) {
     if (!debug_sections) return;
     if (!debug_sections->working) return;
+    std::lock_guard<std::mutex> lock(debug_sections_mutex);
     if (!helper) return;
     debug_sections->register_heap_object(obj, size, helper);
 }
@@ -2196,6 +2204,7 @@ void register_heap_object(const void *obj, size_t size, const void *helper) {
 void deregister_heap_object(const void *obj, size_t size) {
     if (!debug_sections) return;
     if (!debug_sections->working) return;
+    std::lock_guard<std::mutex> lock(debug_sections_mutex);
     debug_sections->deregister_heap_object(obj, size);
 }
 
@@ -20,8 +20,12 @@ class RefCount {
     std::atomic<int> count;
 public:
     RefCount() : count(0) {}
-    int increment() {return ++count;} // Increment and return new value
-    int decrement() {return --count;} // Decrement and return new value
+    // Taking a new reference needs no ordering with other memory
+    // operations, because the thread taking it already holds one. Only
+    // dropping a reference must be ordered, so that the last one to
+    // drop sees every write to the object before destroying it.
+    int increment() {return count.fetch_add(1, std::memory_order_relaxed) + 1;} // Increment and return new value
+    int decrement() {return count.fetch_sub(1, std::memory_order_acq_rel) - 1;} // Decrement and return new value
     bool is_zero() const {return count == 0;}
 };
 
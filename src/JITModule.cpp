@@ -1,7 +1,10 @@
-#include <string>
-#include <stdint.h>
+#include <atomic>
+#include <iomanip>
 #include <mutex>
 #include <set>
+#include <sstream>
+#include <stdint.h>
+#include <string>
 
 #ifndef _WIN32
 #include <sys/mman.h>
@@ -15,6 +18,7 @@
 #include "LLVM_Output.h"
 #include "CodeGen_LLVM.h"
 #include "Pipeline.h"
+#include "Util.h"
 
 
 #if defined(_MSC_VER) && !defined(NOMINMAX)
@@ -133,6 +137,13 @@ public:
         }
     }
 
+    // Must outlive the execution engine.
+    std::unique_ptr<llvm::ObjectCache> object_cache;
+
+    // Precompiled objects to link in when the module is compiled. See
+    // JITModule::load.
+    std::vector<llvm::object::OwningBinary<llvm::object::ObjectFile>> objects;
+
     std::map<std::string, JITModule::Symbol> exports;
     llvm::LLVMContext context;
     ExecutionEngine *execution_engine;
@@ -160,7 +171,8 @@ JITModule::Symbol compile_and_get_function(ExecutionEngine &ee, const string &na
         internal_error << "Compiling " << name << " returned nullptr\n";
     }
 
-    JITModule::Symbol symbol(f, fn->getFunctionType());
+    // Functions from a precompiled object have no llvm type.
+    JITModule::Symbol symbol(f, fn ? fn->getFunctionType() : nullptr);
 
     debug(2) << "Function " << name << " is at " << f << "\n";
 
@@ -233,6 +245,91 @@ public:
     }
 };
 
+// An on-disk cache of compiled objects, used when HL_JIT_CACHE_DIR is
+// set. MCJIT asks it for the object of each module before running
+// code generation, and hands it the object afterwards if it had to
+// compile it. Modules are identified by a hash of their contents and
+// everything else that affects code generation (see
+// jit_cache_key). Only code generation is skipped on a hit; the
+// module must still be lowered and compiled to llvm IR to compute the
+// key.
+class JITDiskCache : public llvm::ObjectCache {
+    string dir;
+
+    string path_for(const llvm::Module *m) const {
+        return dir + "/" + m->getModuleIdentifier() + ".o";
+    }
+
+public:
+    JITDiskCache(const string &dir) : dir(dir) {}
+
+    void notifyObjectCompiled(const llvm::Module *m, llvm::MemoryBufferRef obj) override {
+        // Write to a temporary file and rename it into place, so that
+        // other processes never see a partial object.
+        llvm::sys::fs::create_directories(dir);
+        int fd;
+        llvm::SmallString<256> tmp_path;
+        if (llvm::sys::fs::createUniqueFile(dir + "/%%%%%%%%.tmp", fd, tmp_path)) {
+            debug(1) << "Could not create a file in the JIT cache directory " << dir << "\n";
+            return;
+        }
+        {
+            llvm::raw_fd_ostream out(fd, /* shouldClose */ true);
+            out.write(obj.getBufferStart(), obj.getBufferSize());
+        }
+        if (llvm::sys::fs::rename(tmp_path, path_for(m))) {
+            llvm::sys::fs::remove(tmp_path);
+        }
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *m) override {
+        llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buf = llvm::MemoryBuffer::getFile(path_for(m));
+        if (!buf) {
+            debug(2) << "JIT cache miss for " << path_for(m) << "\n";
+            return nullptr;
+        }
+        debug(1) << "JIT cache hit for " << path_for(m) << "\n";
+        return std::move(buf.get());
+    }
+};
+
+// The names of local values come from Halide's unique_name counters,
+// which depend on what else the process has compiled, so they are
+// erased before hashing. They don't affect the code generated.
+void strip_local_names(llvm::Module &m) {
+    for (llvm::Function &f : m) {
+        for (llvm::Argument &a : f.args()) {
+            a.setName("");
+        }
+        for (llvm::BasicBlock &b : f) {
+            b.setName("");
+            for (llvm::Instruction &i : b) {
+                if (!i.getType()->isVoidTy()) {
+                    i.setName("");
+                }
+            }
+        }
+    }
+}
+
+string jit_cache_key(const llvm::Module &m, const string &mcpu, const string &mattrs) {
+    string ir;
+    llvm::raw_string_ostream ir_stream(ir);
+    m.print(ir_stream, nullptr);
+    ir_stream << mcpu << "\n" << mattrs << "\n";
+#ifdef LLVM_VERSION_STRING
+    ir_stream << LLVM_VERSION_STRING << "\n";
+#endif
+    ir_stream << LLVM_VERSION << "\n";
+    ir_stream.flush();
+    std::ostringstream key;
+    key << std::hex << std::setfill('0')
+        << std::setw(16) << stable_hash(ir)
+        << std::setw(16) << stable_hash(ir, 0x84222325cbf29ce4ULL)
+        << "_" << std::setw(8) << ir.size();
+    return key.str();
+}
+
 }
 
 JITModule::JITModule() {
@@ -249,6 +346,49 @@ JITModule::JITModule(const Module &m, const LoweredFunc &fn,
     compile_module(std::move(llvm_module), fn.name, m.target(), deps_with_runtime);
 }
 
+JITModule JITModule::load(const std::string &filename, const std::string &function_name,
+                          const Target &target, const std::vector<JITModule> &dependencies) {
+    Target jit_target(target);
+    jit_target.set_feature(Target::JIT);
+
+    JITModule result;
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer = llvm::MemoryBuffer::getFile(filename);
+    user_assert(buffer) << "Could not read " << filename << ": " << buffer.getError().message() << "\n";
+
+    std::unique_ptr<llvm::Module> llvm_module;
+    const unsigned char *start = (const unsigned char *)(*buffer)->getBufferStart();
+    const unsigned char *end = (const unsigned char *)(*buffer)->getBufferEnd();
+    if (llvm::isBitcode(start, end)) {
+        debug(1) << "Loading bitcode " << filename << " into the jit\n";
+#if LLVM_VERSION >= 40
+        auto parsed = llvm::expectedToErrorOr(llvm::parseBitcodeFile((*buffer)->getMemBufferRef(), result.jit_module->context));
+#else
+        auto parsed = llvm::parseBitcodeFile((*buffer)->getMemBufferRef(), result.jit_module->context);
+#endif
+        user_assert(parsed) << "Could not parse bitcode " << filename << ": " << parsed.getError().message() << "\n";
+        llvm_module = std::move(*parsed);
+    } else {
+        debug(1) << "Loading object " << filename << " into the jit\n";
+        auto object = llvm::object::ObjectFile::createObjectFile((*buffer)->getMemBufferRef());
+        if (!object) {
+            std::string message = llvm::toString(object.takeError());
+            user_error << "Could not load object " << filename << ": " << message << "\n";
+        }
+        result.jit_module->objects.emplace_back(std::move(*object), std::move(*buffer));
+        // There's nothing to compile, but the execution engine needs
+        // a module, and the empty module for the target has the
+        // right triple, data layout, and target options.
+        llvm_module = compile_module_to_llvm_module(Module(function_name, jit_target), result.jit_module->context);
+    }
+
+    std::vector<JITModule> deps_with_runtime = dependencies;
+    std::vector<JITModule> shared_runtime = JITSharedRuntime::get(llvm_module.get(), jit_target);
+    deps_with_runtime.insert(deps_with_runtime.end(), shared_runtime.begin(), shared_runtime.end());
+    result.compile_module(std::move(llvm_module), function_name, jit_target, deps_with_runtime,
+                          {function_name + "_metadata"});
+    return result;
+}
+
 void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &function_name, const Target &target,
                                const std::vector<JITModule> &dependencies,
                                const std::vector<std::string> &requested_exports) {
@@ -269,6 +409,13 @@ void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &fu
     DataLayout initial_module_data_layout = m->getDataLayout();
     string module_name = m->getModuleIdentifier();
 
+    string cache_dir = get_env_variable("HL_JIT_CACHE_DIR");
+    if (!cache_dir.empty()) {
+        strip_local_names(*m);
+        m->setModuleIdentifier(jit_cache_key(*m, mcpu, mattrs));
+        jit_module->object_cache.reset(new JITDiskCache(cache_dir));
+    }
+
     llvm::EngineBuilder engine_builder((std::move(m)));
     engine_builder.setTargetOptions(options);
     engine_builder.setErrorStr(&error_string);
@@ -297,6 +444,15 @@ void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &fu
     if (!ee) std::cerr << error_string << "\n";
     internal_assert(ee) << "Couldn't create execution engine\n";
 
+    if (jit_module->object_cache) {
+        ee->setObjectCache(jit_module->object_cache.get());
+    }
+
+    for (auto &object : jit_module->objects) {
+        ee->addObjectFile(std::move(object));
+    }
+    jit_module->objects.clear();
+
     // Do any target-specific initialization
     std::vector<llvm::JITEventListener *> listeners;
 
@@ -630,6 +786,36 @@ JITModule &shared_runtimes(RuntimeKind k) {
     return m[k];
 }
 
+// Set once each shared runtime has been made, and cleared by
+// release_all. Compilations that find all the runtimes they need
+// already made don't take shared_runtimes_mutex.
+std::atomic<bool> shared_runtimes_ready[MaxRuntimeKind];
+
+// The shared runtimes a target needs: the main one, then one per
+// device API.
+std::vector<RuntimeKind> runtime_kinds_for_target(const Target &target) {
+    std::vector<RuntimeKind> kinds = {MainShared};
+    if (target.has_feature(Target::OpenCL)) {
+        kinds.push_back(OpenCL);
+    }
+    if (target.has_feature(Target::Metal)) {
+        kinds.push_back(Metal);
+    }
+    if (target.has_feature(Target::CUDA)) {
+        kinds.push_back(CUDA);
+    }
+    if (target.has_feature(Target::OpenGL)) {
+        kinds.push_back(OpenGL);
+    }
+    if (target.has_feature(Target::OpenGLCompute)) {
+        kinds.push_back(OpenGLCompute);
+    }
+    if (target.features_any_of({Target::HVX_64, Target::HVX_128})) {
+        kinds.push_back(Hexagon);
+    }
+    return kinds;
+}
+
 JITModule &make_module(llvm::Module *for_module, Target target,
                        RuntimeKind runtime_kind, const std::vector<JITModule> &deps,
                        bool create) {
@@ -755,6 +941,8 @@ JITModule &make_module(llvm::Module *for_module, Target target,
         uint64_t fun_addr = runtime.jit_module->execution_engine->getGlobalValueAddress("halide_jit_module_adjust_ref_count");
         internal_assert(fun_addr != 0);
         *(void (**)(void *arg, int32_t count))fun_addr = &adjust_module_ref_count;
+
+        shared_runtimes_ready[runtime_kind].store(true, std::memory_order_release);
     }
     return runtime;
 }
@@ -770,49 +958,29 @@ JITModule &make_module(llvm::Module *for_module, Target target,
  * JITSharedRuntime::release_all is called, the global state is reset
  * and any newly compiled Funcs will get a new runtime. */
 std::vector<JITModule> JITSharedRuntime::get(llvm::Module *for_module, const Target &target, bool create) {
-    std::lock_guard<std::mutex> lock(shared_runtimes_mutex);
-
+    std::vector<RuntimeKind> kinds = runtime_kinds_for_target(target);
     std::vector<JITModule> result;
 
-    JITModule m = make_module(for_module, target, MainShared, result, create);
-    if (m.compiled()) {
-        result.push_back(m);
+    // Once the runtimes have been made they don't change (until
+    // release_all, which mustn't run while anything is being
+    // compiled), so after warmup concurrent compilations find them
+    // without contending for the lock.
+    bool all_ready = true;
+    for (RuntimeKind k : kinds) {
+        all_ready = all_ready && shared_runtimes_ready[k].load(std::memory_order_acquire);
     }
-
-    // Add all requested GPU modules, each only depending on the main shared runtime.
-    std::vector<JITModule> gpu_modules;
-    if (target.has_feature(Target::OpenCL)) {
-        JITModule m = make_module(for_module, target, OpenCL, result, create);
-        if (m.compiled()) {
-            result.push_back(m);
-        }
-    }
-    if (target.has_feature(Target::Metal)) {
-        JITModule m = make_module(for_module, target, Metal, result, create);
-        if (m.compiled()) {
-            result.push_back(m);
-        }
-    }
-    if (target.has_feature(Target::CUDA)) {
-        JITModule m = make_module(for_module, target, CUDA, result, create);
-        if (m.compiled()) {
-            result.push_back(m);
-        }
-    }
-    if (target.has_feature(Target::OpenGL)) {
-        JITModule m = make_module(for_module, target, OpenGL, result, create);
-        if (m.compiled()) {
-            result.push_back(m);
-        }
-    }
-    if (target.has_feature(Target::OpenGLCompute)) {
-        JITModule m = make_module(for_module, target, OpenGLCompute, result, create);
-        if (m.compiled()) {
-            result.push_back(m);
+    if (all_ready) {
+        for (RuntimeKind k : kinds) {
+            result.push_back(shared_runtimes(k));
         }
+        return result;
     }
-    if (target.features_any_of({Target::HVX_64, Target::HVX_128})) {
-        JITModule m = make_module(for_module, target, Hexagon, result, create);
+
+    std::lock_guard<std::mutex> lock(shared_runtimes_mutex);
+
+    // Each GPU module only depends on the main shared runtime.
+    for (RuntimeKind k : kinds) {
+        JITModule m = make_module(for_module, target, k, result, create);
         if (m.compiled()) {
             result.push_back(m);
         }
@@ -837,6 +1005,7 @@ void JITSharedRuntime::release_all() {
     std::lock_guard<std::mutex> lock(shared_runtimes_mutex);
 
     for (int i = MaxRuntimeKind; i > 0; i--) {
+        shared_runtimes_ready[i - 1].store(false, std::memory_order_release);
         shared_runtimes((RuntimeKind)(i - 1)) = JITModule();
     }
 }
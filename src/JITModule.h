@@ -43,6 +43,22 @@ struct JITModule {
     EXPORT JITModule();
     EXPORT JITModule(const Module &m, const LoweredFunc &fn,
                      const std::vector<JITModule> &dependencies = std::vector<JITModule>());
+    /** Load a pipeline compiled ahead of time, as an object (with
+     * compile_to_object) or as bitcode (with compile_to_bitcode), into
+     * the jit. This links it with the shared jit runtime and the given
+     * dependencies, so none of llvm's code generation happens for an
+     * object. The exports are the pipeline's function_name, its argv
+     * wrapper, and its metadata getter. The pipeline should be
+     * compiled for the host with the no_runtime feature, so that it
+     * uses the shared runtime, and with user_context if it's called
+     * with a JITUserContext, so that the handlers of the call are
+     * used. Extern functions it calls are found in the dependencies,
+     * e.g. a JITModule made with add_extern_for_export, and then in
+     * the process. */
+    EXPORT static JITModule load(const std::string &filename, const std::string &function_name,
+                                 const Target &target,
+                                 const std::vector<JITModule> &dependencies = std::vector<JITModule>());
+
     /** The exports map of a JITModule contains all symbols which are
      * available to other JITModules which depend on this one. For
      * runtime modules, this is all of the symbols exported from the
@@ -7,6 +7,7 @@
 #include "Scope.h"
 #include "Simplify.h"
 #include "Substitute.h"
+#include "Util.h"
 
 namespace Halide {
 namespace Internal {
@@ -17,20 +18,115 @@ using std::vector;
 using std::pair;
 using std::set;
 
+// Calls that query the fields of a buffer that don't change after it
+// is created. The buffer is the first argument.
+bool is_buffer_query(const Call *op) {
+    return (op->is_intrinsic(Call::buffer_get_min) ||
+            op->is_intrinsic(Call::buffer_get_max) ||
+            op->is_intrinsic(Call::buffer_get_extent) ||
+            op->is_intrinsic(Call::buffer_get_stride) ||
+            op->is_intrinsic(Call::buffer_get_host) ||
+            op->is_intrinsic(Call::buffer_get_shape) ||
+            op->is_intrinsic(Call::buffer_get_type_code) ||
+            op->is_intrinsic(Call::buffer_get_type_bits) ||
+            op->is_intrinsic(Call::buffer_get_type_lanes));
+}
+
+// The name of the Func or buffer that a handle refers to.
+string buffer_name(const string &handle) {
+    if (ends_with(handle, ".buffer")) {
+        return handle.substr(0, handle.size() - 7);
+    }
+    return handle;
+}
+
+// Find the buffers a loop might write to. Anything that is stored to,
+// allocated inside the loop, or that has a handle to it defined or
+// used for anything other than querying its shape counts.
+class FindWrites : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const Store *op) {
+        written.insert(op->name);
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Allocate *op) {
+        written.insert(op->name);
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Variable *op) {
+        if (op->type.is_handle()) {
+            written.insert(buffer_name(op->name));
+        }
+    }
+
+    // A handle defined inside the loop, such as a host pointer, is
+    // distinct on each iteration.
+    void visit(const LetStmt *op) {
+        if (op->value.type().is_handle()) {
+            written.insert(buffer_name(op->name));
+        }
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Let *op) {
+        if (op->value.type().is_handle()) {
+            written.insert(buffer_name(op->name));
+        }
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Call *op) {
+        if (is_buffer_query(op)) {
+            for (size_t i = 1; i < op->args.size(); i++) {
+                op->args[i].accept(this);
+            }
+            return;
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    set<string> written;
+};
+
 // Is it safe to lift an Expr out of a loop (and potentially across a device boundary)
 class CanLift : public IRVisitor {
     using IRVisitor::visit;
 
     void visit(const Call *op) {
-        if (!op->is_pure()) {
+        if (is_buffer_query(op)) {
+            const Variable *buf = op->args[0].as<Variable>();
+            if (!lift_loads || !buf || written.count(buffer_name(buf->name))) {
+                result = false;
+            } else {
+                reads_memory = true;
+                IRVisitor::visit(op);
+            }
+        } else if (!op->is_pure()) {
             result = false;
+        } else if (op->is_intrinsic(Call::if_then_else)) {
+            // Only one side is evaluated, so neither is safe to load
+            // from unconditionally.
+            op->args[0].accept(this);
+            ScopedValue<bool> old_lift_loads(lift_loads, false);
+            for (size_t i = 1; i < op->args.size(); i++) {
+                op->args[i].accept(this);
+            }
         } else {
             IRVisitor::visit(op);
         }
     }
 
     void visit(const Load *op) {
-        result = false;
+        if (!lift_loads || written.count(op->name) || !is_one(op->predicate)) {
+            result = false;
+        } else {
+            reads_memory = true;
+            IRVisitor::visit(op);
+        }
     }
 
     void visit(const Variable *op) {
@@ -40,35 +136,57 @@ class CanLift : public IRVisitor {
     }
 
     const Scope<int> &varying;
+    const set<string> &written;
+    bool lift_loads;
 
 public:
     bool result {true};
+    bool reads_memory {false};
 
-    CanLift(const Scope<int> &v) : varying(v) {}
+    CanLift(const Scope<int> &v, const set<string> &w, bool lift_loads)
+        : varying(v), written(w), lift_loads(lift_loads) {}
 };
 
 // Lift pure loop invariants to the top level. Applied independently
-// to each loop.
+// to each loop. Loads from buffers the loop doesn't write to, and
+// queries of their shape, are lifted too if they're evaluated on
+// every iteration, in which case the caller must make sure the loop
+// runs at least once.
 class LiftLoopInvariants : public IRMutator2 {
     using IRMutator2::visit;
 
     Scope<int> varying;
 
+    // The buffers the loop might write to.
+    const set<string> &written;
+
+    // Whether to lift loads, and dense vector loads.
+    bool lift_loads, lift_vector_loads;
+
+    // The number of enclosing inner loops and conditionals. We can
+    // only lift loads that don't depend on them.
+    int conditional = 0;
+    bool entered_loop = false, seen_assert = false;
+
     bool can_lift(const Expr &e) {
-        CanLift check(varying);
+        CanLift check(varying, written, lift_loads && conditional == 0 && !seen_assert);
         e.accept(&check);
+        if (check.result && check.reads_memory) {
+            lifted_loads = true;
+        }
         return check.result;
     }
 
     bool should_lift(const Expr &e) {
-        if (!can_lift(e)) return false;
         if (e.as<Variable>()) return false;
         if (e.as<Broadcast>()) return false;
         if (is_const(e)) return false;
         // bool vectors are buggy enough in LLVM that lifting them is a bad idea.
         // (We just skip all vectors on the principle that we don't want them
-        // on the stack anyway.)
-        if (e.type().is_vector()) return false;
+        // on the stack anyway.) Loads of vectors are the exception, because
+        // lifting them frees up load ports in the inner loop.
+        if (e.type().is_vector() && !(lift_vector_loads && e.as<Load>())) return false;
+        if (!can_lift(e)) return false;
         return true;
     }
 
@@ -84,9 +202,50 @@ class LiftLoopInvariants : public IRMutator2 {
 
     Stmt visit(const For *op) override {
         ScopedBinding<int> p(varying, op->name, 0);
+        if (!entered_loop) {
+            // The loop we're lifting out of.
+            entered_loop = true;
+            return IRMutator2::visit(op);
+        }
+        Expr min = mutate(op->min);
+        Expr extent = mutate(op->extent);
+        Stmt body;
+        {
+            ScopedValue<int> c(conditional, conditional + 1);
+            body = mutate(op->body);
+        }
+        return For::make(op->name, min, extent, op->for_type, op->device_api, body);
+    }
+
+    Stmt visit(const IfThenElse *op) override {
+        Expr condition = mutate(op->condition);
+        ScopedValue<int> c(conditional, conditional + 1);
+        Stmt then_case = mutate(op->then_case);
+        Stmt else_case = mutate(op->else_case);
+        return IfThenElse::make(condition, then_case, else_case);
+    }
+
+    Expr visit(const Call *op) override {
+        if (op->is_intrinsic(Call::if_then_else)) {
+            vector<Expr> args(op->args.size());
+            args[0] = mutate(op->args[0]);
+            ScopedValue<int> c(conditional, conditional + 1);
+            for (size_t i = 1; i < op->args.size(); i++) {
+                args[i] = mutate(op->args[i]);
+            }
+            return Call::make(op->type, op->name, args, op->call_type,
+                              op->func, op->value_index, op->image, op->param);
+        }
         return IRMutator2::visit(op);
     }
 
+    Stmt visit(const AssertStmt *op) override {
+        // Loads after an assertion may depend on it succeeding.
+        Stmt s = IRMutator2::visit(op);
+        seen_assert = true;
+        return s;
+    }
+
 public:
 
     using IRMutator2::mutate;
@@ -109,6 +268,12 @@ public:
     }
 
     map<Expr, string, IRDeepCompare> lifted;
+
+    // Whether any of the lifted exprs read memory.
+    bool lifted_loads = false;
+
+    LiftLoopInvariants(const set<string> &written, bool lift_loads, bool lift_vector_loads)
+        : written(written), lift_loads(lift_loads), lift_vector_loads(lift_vector_loads) {}
 };
 
 class LICM : public IRMutator2 {
@@ -144,7 +309,8 @@ class LICM : public IRMutator2 {
         ScopedValue<bool> old_in_gpu_loop(in_gpu_loop);
         in_gpu_loop =
             (op->for_type == ForType::GPUBlock ||
-             op->for_type == ForType::GPUThread);
+             op->for_type == ForType::GPUThread ||
+             op->for_type == ForType::GPULane);
 
         if (old_in_gpu_loop && in_gpu_loop) {
             // Don't lift lets to in-between gpu blocks/threads
@@ -155,8 +321,18 @@ class LICM : public IRMutator2 {
             return IRMutator2::visit(op);
         } else {
 
+            // Loads aren't lifted out of device code, because the
+            // buffers might not be on the host.
+            bool lift_loads = (!in_gpu_loop &&
+                               (op->device_api == DeviceAPI::None ||
+                                op->device_api == DeviceAPI::Host));
+            FindWrites writes;
+            if (lift_loads) {
+                op->accept(&writes);
+            }
+
             // Lift invariants
-            LiftLoopInvariants lifter;
+            LiftLoopInvariants lifter(writes.written, lift_loads, op->for_type == ForType::Serial);
             Stmt new_stmt = lifter.mutate(op);
 
             // As an optimization to reduce register pressure, take
@@ -241,6 +417,12 @@ class LICM : public IRMutator2 {
                 lets.pop_back();
             }
 
+            // The lifted loads were only safe to do if the loop ran
+            // at least once.
+            if (lifter.lifted_loads && !can_prove(op->extent > 0)) {
+                new_stmt = IfThenElse::make(op->extent > 0, new_stmt);
+            }
+
             return new_stmt;
         }
     }
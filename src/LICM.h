@@ -13,7 +13,9 @@ namespace Internal {
 /** Hoist loop-invariants out of inner loops. This is especially
  * important in cases where LLVM would not do it for us
  * automatically. For example, it hoists loop invariants out of cuda
- * kernels. */
+ * kernels. Loads from buffers that a loop doesn't write to, and
+ * queries of buffer shapes, are also hoisted out of loops on the
+ * host if they happen on every iteration. */
 Stmt loop_invariant_code_motion(Stmt);
 
 }
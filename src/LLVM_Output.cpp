@@ -4,6 +4,8 @@
 #include "CodeGen_LLVM.h"
 #include "CodeGen_C.h"
 #include "CodeGen_Internal.h"
+#include "CompileTimeProfiling.h"
+#include "ThreadPool.h"
 
 #include <iostream>
 #include <fstream>
@@ -317,6 +319,9 @@ void emit_file(llvm::Module &module, Internal::LLVMOStream& out, llvm::TargetMac
     Internal::debug(1) << "emit_file.Compiling to native code...\n";
     Internal::debug(2) << "Target triple: " << module.getTargetTriple() << "\n";
 
+    Internal::CompileTimeProfiler profiler("llvm codegen " + module.getModuleIdentifier());
+    profiler.phase("Compiling to native code");
+
     // Get the target specific parser.
     auto target_machine = Internal::make_target_machine(module);
     internal_assert(target_machine.get()) << "Could not allocate target machine!\n";
@@ -363,6 +368,99 @@ void compile_llvm_module_to_object(llvm::Module &module, Internal::LLVMOStream&
     emit_file(module, out, llvm::TargetMachine::CGFT_ObjectFile);
 }
 
+namespace {
+
+std::unique_ptr<llvm::Module> parse_partition(const std::string &bitcode, llvm::LLVMContext &context) {
+    llvm::MemoryBufferRef buffer(bitcode, "partition");
+#if LLVM_VERSION >= 40
+    auto ret_val = llvm::expectedToErrorOr(llvm::parseBitcodeFile(buffer, context));
+#else
+    auto ret_val = llvm::parseBitcodeFile(buffer, context);
+#endif
+    internal_assert(ret_val) << "Could not parse module partition: " << ret_val.getError() << "\n";
+    return std::move(*ret_val);
+}
+
+std::string write_partition(const llvm::Module &module) {
+    std::string bitcode;
+    llvm::raw_string_ostream out(bitcode);
+    WriteBitcodeToFile(&module, out);
+    out.flush();
+    return bitcode;
+}
+
+// One pool, sized to the machine, generates the partitions of every
+// module, so modules compiled at once (such as the sub-targets of
+// compile_multitarget) share the cores instead of each using all of
+// them.
+Internal::ThreadPool<void> &codegen_thread_pool() {
+    static Internal::ThreadPool<void> pool;
+    return pool;
+}
+
+}
+
+int default_codegen_partitions() {
+    std::string threads = Internal::get_env_variable("HL_CODEGEN_THREADS");
+    if (!threads.empty()) {
+        return std::max(1, atoi(threads.c_str()));
+    }
+    // Keep debug output readable.
+    if (Internal::debug::debug_level() > 0) {
+        return 1;
+    }
+    return (int)Internal::ThreadPool<void>::num_processors_online();
+}
+
+void compile_llvm_module_to_objects(llvm::Module &module, int partitions,
+                                    const std::function<std::string(int)> &object_name) {
+    // There's no point in more partitions than functions to put in them.
+    int definitions = 0;
+    for (const llvm::Function &f : module) {
+        definitions += f.isDeclaration() ? 0 : 1;
+    }
+    partitions = std::min(partitions, definitions);
+
+    if (partitions <= 1) {
+        auto out = make_raw_fd_ostream(object_name(0));
+        compile_llvm_module_to_object(module, *out);
+        return;
+    }
+
+    // An LLVMContext may only be used by one thread at a time, so
+    // each partition is round-tripped through bitcode into a
+    // context of its own. Splitting consumes the module it is given,
+    // so split a copy made the same way. Locals stay in the partition
+    // of their users, so no symbols that weren't already visible
+    // escape the objects.
+    std::vector<std::string> parts;
+    {
+        llvm::LLVMContext split_context;
+        std::unique_ptr<llvm::Module> copy = parse_partition(write_partition(module), split_context);
+        llvm::SplitModule(std::move(copy), partitions,
+                          [&](std::unique_ptr<llvm::Module> part) {
+                              parts.push_back(write_partition(*part));
+                          },
+                          /* PreserveLocals */ true);
+    }
+    Internal::debug(1) << "Code-generating " << module.getModuleIdentifier()
+                       << " in " << parts.size() << " partitions\n";
+
+    std::vector<std::future<void>> futures;
+    for (size_t i = 0; i < parts.size(); i++) {
+        std::string name = object_name((int)i);
+        futures.push_back(codegen_thread_pool().async([&parts, i, name]() {
+            llvm::LLVMContext context;
+            std::unique_ptr<llvm::Module> part = parse_partition(parts[i], context);
+            auto out = make_raw_fd_ostream(name);
+            compile_llvm_module_to_object(*part, *out);
+        }));
+    }
+    for (auto &f : futures) {
+        f.get();
+    }
+}
+
 void compile_llvm_module_to_assembly(llvm::Module &module, Internal::LLVMOStream& out) {
     emit_file(module, out, llvm::TargetMachine::CGFT_AssemblyFile);
 }
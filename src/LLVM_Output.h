@@ -5,6 +5,7 @@
  *
  */
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -39,6 +40,19 @@ EXPORT void compile_llvm_module_to_object(llvm::Module &module, Internal::LLVMOS
 EXPORT void compile_llvm_module_to_assembly(llvm::Module &module, Internal::LLVMOStream& out);
 // @}
 
+/** Compile an LLVM module to objects, splitting it into up to
+ * partitions pieces which are code-generated in parallel. Together
+ * the objects define the same symbols as compile_llvm_module_to_object
+ * would, so they can be linked or archived in its place. The file for
+ * the i'th object is named by object_name(i). */
+EXPORT void compile_llvm_module_to_objects(llvm::Module &module, int partitions,
+                                           const std::function<std::string(int)> &object_name);
+
+/** The number of partitions to code-generate static libraries
+ * in. This is HL_CODEGEN_THREADS if set, else one with
+ * HL_DEBUG_CODEGEN set, else the number of cores. */
+EXPORT int default_codegen_partitions();
+
 /** Compile an LLVM module to LLVM targets (bitcode, LLVM assembly). */
 // @{
 EXPORT void compile_llvm_module_to_llvm_bitcode(llvm::Module &module, Internal::LLVMOStream& out);
@@ -1,6 +1,9 @@
 #include "LLVM_Runtime_Linker.h"
 #include "LLVM_Headers.h"
 
+#include <map>
+#include <mutex>
+
 namespace Halide {
 
 using std::string;
@@ -8,12 +11,18 @@ using std::vector;
 
 namespace {
 
-std::unique_ptr<llvm::Module> parse_bitcode_file(llvm::StringRef buf, llvm::LLVMContext *context, const char *id) {
+// Parse some bitcode. If lazy is set, the function bodies are only
+// read when they are materialized, and the buffer must outlive the
+// module.
+std::unique_ptr<llvm::Module> parse_bitcode_file(llvm::StringRef buf, llvm::LLVMContext *context, const char *id,
+                                                 bool lazy = false) {
 
     llvm::MemoryBufferRef bitcode_buffer = llvm::MemoryBufferRef(buf, id);
 
 #if LLVM_VERSION >= 40
     auto ret_val = llvm::expectedToErrorOr(
+        lazy ?
+        llvm::getLazyBitcodeModule(bitcode_buffer, *context) :
         llvm::parseBitcodeFile(bitcode_buffer, *context));
 #else
     auto ret_val = llvm::parseBitcodeFile(bitcode_buffer, *context);
@@ -82,7 +91,10 @@ DECLARE_CPP_INITMOD(can_use_target)
 DECLARE_CPP_INITMOD(cuda)
 DECLARE_CPP_INITMOD(destructors)
 DECLARE_CPP_INITMOD(device_interface)
+DECLARE_CPP_INITMOD(distributed)
 DECLARE_CPP_INITMOD(errors)
+DECLARE_CPP_INITMOD(fake_perf_counters)
+DECLARE_CPP_INITMOD(fake_shared_memory)
 DECLARE_CPP_INITMOD(fake_thread_pool)
 DECLARE_CPP_INITMOD(float16_t)
 DECLARE_CPP_INITMOD(gcd_thread_pool)
@@ -90,8 +102,11 @@ DECLARE_CPP_INITMOD(gpu_device_selection)
 DECLARE_CPP_INITMOD(hexagon_host)
 DECLARE_CPP_INITMOD(ios_io)
 DECLARE_CPP_INITMOD(linux_clock)
+DECLARE_CPP_INITMOD(linux_allocator)
 DECLARE_CPP_INITMOD(linux_host_cpu_count)
 DECLARE_CPP_INITMOD(linux_opengl_context)
+DECLARE_CPP_INITMOD(linux_perf_counters)
+DECLARE_CPP_INITMOD(linux_shared_memory)
 DECLARE_CPP_INITMOD(matlab)
 DECLARE_CPP_INITMOD(metadata)
 DECLARE_CPP_INITMOD(mingw_math)
@@ -107,7 +122,9 @@ DECLARE_CPP_INITMOD(osx_clock)
 DECLARE_CPP_INITMOD(osx_get_symbol)
 DECLARE_CPP_INITMOD(osx_host_cpu_count)
 DECLARE_CPP_INITMOD(osx_opengl_context)
+DECLARE_CPP_INITMOD(pgo)
 DECLARE_CPP_INITMOD(posix_allocator)
+DECLARE_CPP_INITMOD(posix_pool_allocator)
 DECLARE_CPP_INITMOD(posix_clock)
 DECLARE_CPP_INITMOD(posix_error_handler)
 DECLARE_CPP_INITMOD(posix_get_symbol)
@@ -123,6 +140,7 @@ DECLARE_CPP_INITMOD(qurt_hvx)
 DECLARE_CPP_INITMOD(qurt_init_fini)
 DECLARE_CPP_INITMOD(qurt_thread_pool)
 DECLARE_CPP_INITMOD(runtime_api)
+DECLARE_CPP_INITMOD(scratch_arena)
 DECLARE_CPP_INITMOD(ssp)
 DECLARE_CPP_INITMOD(thread_pool)
 DECLARE_CPP_INITMOD(to_string)
@@ -212,6 +230,20 @@ DECLARE_NO_INITMOD(powerpc)
 DECLARE_NO_INITMOD(powerpc_cpu_features)
 #endif  // WITH_POWERPC
 
+#ifdef WITH_RISCV
+DECLARE_LL_INITMOD(riscv)
+DECLARE_CPP_INITMOD(riscv_cpu_features)
+#else
+DECLARE_NO_INITMOD(riscv)
+DECLARE_NO_INITMOD(riscv_cpu_features)
+#endif  // WITH_RISCV
+
+#ifdef WITH_WEBASSEMBLY
+DECLARE_CPP_INITMOD(wasm_cpu_features)
+#else
+DECLARE_NO_INITMOD(wasm_cpu_features)
+#endif  // WITH_WEBASSEMBLY
+
 #ifdef WITH_HEXAGON
 DECLARE_LL_INITMOD(hvx_64)
 DECLARE_LL_INITMOD(hvx_128)
@@ -282,6 +314,14 @@ llvm::DataLayout get_data_layout_for_target(Target target) {
         return llvm::DataLayout(
             "e-m:e-p:32:32:32-a:0-n16:32-i64:64:64-i32:32:32-i16:16:16-i1:8:8"
             "-f32:32:32-f64:64:64-v32:32:32-v64:64:64-v512:512:512-v1024:1024:1024-v2048:2048:2048");
+    } else if (target.arch == Target::RISCV) {
+        if (target.bits == 32) {
+            return llvm::DataLayout("e-m:e-p:32:32-i64:64-n32-S128");
+        } else {
+            return llvm::DataLayout("e-m:e-p:64:64-i64:64-i128:128-n64-S128");
+        }
+    } else if (target.arch == Target::WebAssembly) {
+        return llvm::DataLayout("e-m:e-p:32:32-i64:64-n32:64-S128");
     } else {
         internal_error << "Bad target arch: " << target.arch << "\n";
         return llvm::DataLayout("unreachable");
@@ -393,6 +433,30 @@ llvm::Triple get_triple_for_target(const Target &target) {
         triple.setVendor(llvm::Triple::UnknownVendor);
         triple.setArch(llvm::Triple::hexagon);
         triple.setObjectFormat(llvm::Triple::ELF);
+    } else if (target.arch == Target::RISCV) {
+        #if (WITH_RISCV)
+        user_assert(target.os == Target::Linux) << "RISCV target is Linux-only.\n";
+        triple.setVendor(llvm::Triple::UnknownVendor);
+        triple.setOS(llvm::Triple::Linux);
+        triple.setEnvironment(llvm::Triple::GNU);
+        if (target.bits == 32) {
+            triple.setArch(llvm::Triple::riscv32);
+        } else {
+            user_assert(target.bits == 64) << "Target must be 32- or 64-bit.\n";
+            triple.setArch(llvm::Triple::riscv64);
+        }
+        #else
+        user_error << "RISCV llvm target not enabled in this build of Halide\n";
+        #endif
+    } else if (target.arch == Target::WebAssembly) {
+        #if (WITH_WEBASSEMBLY)
+        user_assert(target.bits == 32) << "Only wasm32 is supported.\n";
+        triple.setArch(llvm::Triple::wasm32);
+        triple.setVendor(llvm::Triple::UnknownVendor);
+        triple.setOS(llvm::Triple::UnknownOS);
+        #else
+        user_error << "WebAssembly llvm target not enabled in this build of Halide\n";
+        #endif
     } else {
         internal_error << "Bad target arch: " << target.arch << "\n";
     }
@@ -587,6 +651,31 @@ void add_underscores_to_posix_calls_on_windows(llvm::Module *m) {
     }
 }
 
+/** The linked initial modules, as bitcode, by target and module type. */
+struct InitialModuleCache {
+    std::mutex mutex;
+    std::map<std::string, std::string> bitcode;
+};
+
+InitialModuleCache &initial_module_cache() {
+    static InitialModuleCache *cache = new InitialModuleCache;
+    return *cache;
+}
+
+/** The module providing halide_malloc and halide_free on Posix-like
+ * and Windows targets. */
+std::unique_ptr<llvm::Module> get_initmod_allocator(llvm::LLVMContext *c, const Target &t, bool bits_64, bool debug) {
+    if (t.has_feature(Target::PoolAllocator)) {
+        return get_initmod_posix_pool_allocator(c, bits_64, debug);
+    } else if ((t.os == Target::Linux || t.os == Target::Android) &&
+               t.arch != Target::MIPS && t.arch != Target::WebAssembly) {
+        // Adds huge page support for large allocations.
+        return get_initmod_linux_allocator(c, bits_64, debug);
+    } else {
+        return get_initmod_posix_allocator(c, bits_64, debug);
+    }
+}
+
 /** Create an llvm module containing the support code for a given target. */
 std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVMContext *c, bool for_shared_jit_runtime, bool just_gpu) {
     enum InitialModuleType {
@@ -618,13 +707,33 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
     bool bits_64 = (t.bits == 64);
     bool debug = t.has_feature(Target::Debug);
 
+    // Linking the runtime is a large part of compiling a small
+    // pipeline, so each linked runtime is kept as bitcode, and only
+    // needs to be parsed into the context the next time the same
+    // target asks for it. Unless the whole runtime is going to be
+    // compiled, the function bodies are read lazily, and only the
+    // ones the pipeline uses are ever read (see
+    // materialize_used_runtime_functions). The cached bitcode is
+    // never replaced, so it outlives the lazy modules.
+    std::string cache_key = t.to_string() + ":" + std::to_string((int)module_type);
+    InitialModuleCache &cache = initial_module_cache();
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        auto it = cache.bitcode.find(cache_key);
+        if (it != cache.bitcode.end()) {
+            bool lazy = (module_type != ModuleJITShared && module_type != ModuleGPU);
+            return parse_bitcode_file(llvm::StringRef(it->second.data(), it->second.size()),
+                                      c, "initial_module", lazy);
+        }
+    }
+
     vector<std::unique_ptr<llvm::Module>> modules;
 
     if (module_type != ModuleGPU) {
         if (module_type != ModuleJITInlined && module_type != ModuleAOTNoRuntime) {
             // OS-dependent modules
             if (t.os == Target::Linux) {
-                modules.push_back(get_initmod_posix_allocator(c, bits_64, debug));
+                modules.push_back(get_initmod_allocator(c, t, bits_64, debug));
                 modules.push_back(get_initmod_posix_error_handler(c, bits_64, debug));
                 modules.push_back(get_initmod_posix_print(c, bits_64, debug));
                 if (t.arch == Target::X86) {
@@ -634,12 +743,14 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                 }
                 modules.push_back(get_initmod_posix_io(c, bits_64, debug));
                 modules.push_back(get_initmod_posix_tempfile(c, bits_64, debug));
+                // On WebAssembly (e.g. emscripten with pthreads), the
+                // threads below are Web Workers.
                 modules.push_back(get_initmod_linux_host_cpu_count(c, bits_64, debug));
                 modules.push_back(get_initmod_posix_threads(c, bits_64, debug));
                 modules.push_back(get_initmod_thread_pool(c, bits_64, debug));
                 modules.push_back(get_initmod_posix_get_symbol(c, bits_64, debug));
             } else if (t.os == Target::OSX) {
-                modules.push_back(get_initmod_posix_allocator(c, bits_64, debug));
+                modules.push_back(get_initmod_allocator(c, t, bits_64, debug));
                 modules.push_back(get_initmod_posix_error_handler(c, bits_64, debug));
                 modules.push_back(get_initmod_posix_print(c, bits_64, debug));
                 modules.push_back(get_initmod_osx_clock(c, bits_64, debug));
@@ -648,7 +759,7 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                 modules.push_back(get_initmod_gcd_thread_pool(c, bits_64, debug));
                 modules.push_back(get_initmod_osx_get_symbol(c, bits_64, debug));
             } else if (t.os == Target::Android) {
-                modules.push_back(get_initmod_posix_allocator(c, bits_64, debug));
+                modules.push_back(get_initmod_allocator(c, t, bits_64, debug));
                 modules.push_back(get_initmod_posix_error_handler(c, bits_64, debug));
                 modules.push_back(get_initmod_posix_print(c, bits_64, debug));
                 if (t.arch == Target::ARM) {
@@ -663,7 +774,7 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                 modules.push_back(get_initmod_thread_pool(c, bits_64, debug));
                 modules.push_back(get_initmod_posix_get_symbol(c, bits_64, debug));
             } else if (t.os == Target::Windows) {
-                modules.push_back(get_initmod_posix_allocator(c, bits_64, debug));
+                modules.push_back(get_initmod_allocator(c, t, bits_64, debug));
                 modules.push_back(get_initmod_posix_error_handler(c, bits_64, debug));
                 modules.push_back(get_initmod_posix_print(c, bits_64, debug));
                 modules.push_back(get_initmod_windows_clock(c, bits_64, debug));
@@ -676,7 +787,7 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                     modules.push_back(get_initmod_mingw_math(c, bits_64, debug));
                 }
             } else if (t.os == Target::IOS) {
-                modules.push_back(get_initmod_posix_allocator(c, bits_64, debug));
+                modules.push_back(get_initmod_allocator(c, t, bits_64, debug));
                 modules.push_back(get_initmod_posix_error_handler(c, bits_64, debug));
                 modules.push_back(get_initmod_posix_print(c, bits_64, debug));
                 modules.push_back(get_initmod_posix_clock(c, bits_64, debug));
@@ -697,6 +808,17 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                     modules.push_back(get_initmod_qurt_allocator(c, bits_64, debug));
                 }
                 modules.push_back(get_initmod_fake_thread_pool(c, bits_64, debug));
+            } else if (t.os == Target::WebAssemblyRuntime) {
+                // A minimal single-threaded runtime for a wasm
+                // module with no pthreads. The embedder provides
+                // malloc, free, write, and clock_gettime (e.g. via
+                // WASI or emscripten).
+                modules.push_back(get_initmod_posix_allocator(c, bits_64, debug));
+                modules.push_back(get_initmod_posix_error_handler(c, bits_64, debug));
+                modules.push_back(get_initmod_posix_print(c, bits_64, debug));
+                modules.push_back(get_initmod_posix_clock(c, bits_64, debug));
+                modules.push_back(get_initmod_posix_io(c, bits_64, debug));
+                modules.push_back(get_initmod_fake_thread_pool(c, bits_64, debug));
             }
         }
 
@@ -727,12 +849,23 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                 // though...).
                 modules.push_back(get_initmod_tracing(c, bits_64, debug));
                 modules.push_back(get_initmod_write_debug_image(c, bits_64, debug));
+                modules.push_back(get_initmod_pgo(c, bits_64, debug));
 
                 // TODO: Support this module in the Hexagon backend,
                 // currently generates assert at src/HexagonOffload.cpp:279
                 modules.push_back(get_initmod_cache(c, bits_64, debug));
+                if (t.os == Target::Linux && t.arch != Target::MIPS) {
+                    modules.push_back(get_initmod_linux_shared_memory(c, bits_64, debug));
+                } else {
+                    modules.push_back(get_initmod_fake_shared_memory(c, bits_64, debug));
+                }
             }
             modules.push_back(get_initmod_to_string(c, bits_64, debug));
+            modules.push_back(get_initmod_distributed(c, bits_64, debug));
+
+            if (t.has_feature(Target::PersistentScratch)) {
+                modules.push_back(get_initmod_scratch_arena(c, bits_64, debug));
+            }
 
             if (t.arch == Target::Hexagon ||
                 t.has_feature(Target::HVX_64) ||
@@ -749,9 +882,15 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
             modules.push_back(get_initmod_errors(c, bits_64, debug));
 
             if (t.arch != Target::MIPS && t.os != Target::NoOS &&
-                t.os != Target::QuRT) {
-                // MIPS doesn't support the atomics the profiler requires.
+                t.os != Target::QuRT && t.os != Target::WebAssemblyRuntime) {
+                // MIPS doesn't support the atomics the profiler requires,
+                // and the profiler needs a thread to sample from.
                 modules.push_back(get_initmod_profiler(c, bits_64, debug));
+                if (t.os == Target::Linux && t.arch == Target::X86) {
+                    modules.push_back(get_initmod_linux_perf_counters(c, bits_64, debug));
+                } else {
+                    modules.push_back(get_initmod_fake_perf_counters(c, bits_64, debug));
+                }
             }
 
             if (t.has_feature(Target::MSAN)) {
@@ -783,6 +922,9 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
             if (t.arch == Target::POWERPC) {
                 modules.push_back(get_initmod_powerpc_ll(c));
             }
+            if (t.arch == Target::RISCV) {
+                modules.push_back(get_initmod_riscv_ll(c));
+            }
             if (t.arch == Target::Hexagon) {
                 modules.push_back(get_initmod_qurt_hvx(c, bits_64, debug));
                 if (t.has_feature(Target::HVX_64)) {
@@ -799,7 +941,9 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
             if (t.has_feature(Target::AVX)) {
                 modules.push_back(get_initmod_x86_avx_ll(c));
             }
-            if (t.has_feature(Target::Profile)) {
+            if (t.has_feature(Target::Profile) ||
+                t.has_feature(Target::ProfileTimeline) ||
+                t.has_feature(Target::ProfileLightweight)) {
                 modules.push_back(get_initmod_profiler_inlined(c, bits_64, debug));
             }
         }
@@ -823,6 +967,12 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
             if (t.arch == Target::POWERPC) {
                 modules.push_back(get_initmod_powerpc_cpu_features(c, bits_64, debug));
             }
+            if (t.arch == Target::RISCV) {
+                modules.push_back(get_initmod_riscv_cpu_features(c, bits_64, debug));
+            }
+            if (t.arch == Target::WebAssembly) {
+                modules.push_back(get_initmod_wasm_cpu_features(c, bits_64, debug));
+            }
             if (t.arch == Target::Hexagon) {
                 modules.push_back(get_initmod_hexagon_cpu_features(c, bits_64, debug));
             }
@@ -915,6 +1065,16 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
         add_underscores_to_posix_calls_on_windows(modules[0].get());
     }
 
+    std::string bitcode;
+    {
+        llvm::raw_string_ostream out(bitcode);
+        llvm::WriteBitcodeToFile(modules[0].get(), out);
+    }
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        cache.bitcode.emplace(cache_key, std::move(bitcode));
+    }
+
     return std::move(modules[0]);
 }
 
@@ -927,7 +1087,9 @@ std::unique_ptr<llvm::Module> get_initial_module_for_ptx_device(Target target, l
 
     // This table is based on the guidance at:
     // http://docs.nvidia.com/cuda/libdevice-users-guide/basic-usage.html#linking-with-libdevice
-    if (target.has_feature(Target::CUDACapability35)) {
+    if (target.features_any_of({Target::CUDACapability35,
+                                Target::CUDACapability70,
+                                Target::CUDACapability75})) {
         module = get_initmod_ptx_compute_35_ll(c);
     } else if (target.features_any_of({Target::CUDACapability32,
                                        Target::CUDACapability50})) {
@@ -978,6 +1140,38 @@ std::unique_ptr<llvm::Module> get_initial_module_for_ptx_device(Target target, l
 }
 #endif
 
+void materialize_used_runtime_functions(llvm::Module &module, bool all) {
+#if LLVM_VERSION >= 40
+    // Read the functions that are kept even if unused, and then the
+    // ones used by anything read so far, until there are no more.
+    bool changed = !all;
+    while (changed) {
+        changed = false;
+        for (auto &f : module) {
+            if (f.isMaterializable() && (!f.isDiscardableIfUnused() || !f.use_empty())) {
+                if (llvm::Error err = f.materialize()) {
+                    internal_error << "Could not read runtime function " << (std::string)f.getName()
+                                   << ": " << llvm::toString(std::move(err)) << "\n";
+                }
+                changed = true;
+            }
+        }
+    }
+
+    // The rest are unused and would be stripped anyway, so just
+    // leave declarations of them.
+    for (auto &f : module) {
+        if (!all && f.isMaterializable()) {
+            f.deleteBody();
+        }
+    }
+
+    if (llvm::Error err = module.materializeAll()) {
+        internal_error << "Could not read runtime module: " << llvm::toString(std::move(err)) << "\n";
+    }
+#endif
+}
+
 void add_bitcode_to_module(llvm::LLVMContext *context, llvm::Module &module,
                            const std::vector<uint8_t> &bitcode, const std::string &name) {
     llvm::StringRef sb = llvm::StringRef((const char *)&bitcode[0], bitcode.size());
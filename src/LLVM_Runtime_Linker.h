@@ -26,6 +26,14 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target, llvm::LLVMCo
 /** Create an llvm module containing the support code for ptx device. */
 std::unique_ptr<llvm::Module> get_initial_module_for_ptx_device(Target, llvm::LLVMContext *c);
 
+/** The initial module for a target may have been read lazily. Read
+ * the bodies of the runtime functions that the module now uses, and
+ * drop the rest, or read all of them if all is set (e.g. before
+ * linking other code in). Does nothing if the module was read
+ * eagerly. Must be called before the module is verified or
+ * optimized. */
+void materialize_used_runtime_functions(llvm::Module &module, bool all = false);
+
 /** Link a block of llvm bitcode into an llvm module. */
 void add_bitcode_to_module(llvm::LLVMContext *context, llvm::Module &module,
                            const std::vector<uint8_t> &bitcode, const std::string &name);
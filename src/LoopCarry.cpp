@@ -192,6 +192,7 @@ class LoopCarryOverLoop : public IRMutator2 {
     const Scope<int> &in_consume;
 
     int max_carried_values;
+    bool vectors_only;
 
     using IRMutator2::visit;
 
@@ -222,6 +223,12 @@ class LoopCarryOverLoop : public IRMutator2 {
         return lift_carried_values_out_of_stmt(op);
     }
 
+    Stmt visit(const Atomic *op) override {
+        // Other threads may be writing to the buffer, so its values
+        // can't be carried across loop iterations.
+        return op;
+    }
+
     Stmt visit(const Block *op) override {
         vector<Stmt> v = block_to_vector(op);
 
@@ -267,6 +274,7 @@ class LoopCarryOverLoop : public IRMutator2 {
                          load->param.defined() ||
                          in_consume.contains(load->name));
             if (!safe) continue;
+            if (vectors_only && load->type.is_scalar()) continue;
 
             bool represented = false;
             for (vector<const Load *> &v : loads) {
@@ -482,8 +490,8 @@ class LoopCarryOverLoop : public IRMutator2 {
     }
 
 public:
-    LoopCarryOverLoop(const string &var, const Scope<int> &s, int max_carried_values)
-        : in_consume(s), max_carried_values(max_carried_values) {
+    LoopCarryOverLoop(const string &var, const Scope<int> &s, int max_carried_values, bool vectors_only)
+        : in_consume(s), max_carried_values(max_carried_values), vectors_only(vectors_only) {
         linear.push(var, 1);
     }
 
@@ -501,6 +509,7 @@ class LoopCarry : public IRMutator2 {
     using IRMutator2::visit;
 
     int max_carried_values;
+    bool vectors_only;
     Scope<int> in_consume;
 
     Stmt visit(const ProducerConsumer *op) override {
@@ -515,10 +524,15 @@ class LoopCarry : public IRMutator2 {
     }
 
     Stmt visit(const For *op) override {
-        if (op->for_type == ForType::Serial && !is_one(op->extent)) {
+        if (op->device_api != DeviceAPI::None &&
+            op->device_api != DeviceAPI::Host &&
+            op->device_api != DeviceAPI::Hexagon) {
+            // Leave GPU kernels alone.
+            return op;
+        } else if (op->for_type == ForType::Serial && !is_one(op->extent)) {
             Stmt stmt;
             Stmt body = mutate(op->body);
-            LoopCarryOverLoop carry(op->name, in_consume, max_carried_values);
+            LoopCarryOverLoop carry(op->name, in_consume, max_carried_values, vectors_only);
             body = carry.mutate(body);
             if (body.same_as(op->body)) {
                 stmt = op;
@@ -529,7 +543,7 @@ class LoopCarry : public IRMutator2 {
             // Inject the scratch buffer allocations.
             for (const auto &alloc : carry.allocs) {
                 stmt = Block::make(substitute(op->name, op->min, alloc.initial_stores), stmt);
-                stmt = Allocate::make(alloc.name, alloc.type, {alloc.size}, const_true(), stmt);
+                stmt = Allocate::make(alloc.name, alloc.type, MemoryType::Auto, {alloc.size}, const_true(), stmt);
             }
             if (!carry.allocs.empty()) {
                 stmt = IfThenElse::make(op->extent > 0, stmt);
@@ -541,17 +555,45 @@ class LoopCarry : public IRMutator2 {
     }
 
 public:
-    LoopCarry(int max_carried_values) : max_carried_values(max_carried_values) {}
+    LoopCarry(int max_carried_values, bool vectors_only)
+        : max_carried_values(max_carried_values), vectors_only(vectors_only) {}
 };
 
 }
 
 
 Stmt loop_carry(Stmt s, int max_carried_values) {
-    s = LoopCarry(max_carried_values).mutate(s);
+    s = LoopCarry(max_carried_values, false).mutate(s);
     return s;
 }
 
+Stmt loop_carry(Stmt s, const Target &t) {
+    int vector_registers = 0;
+    if (t.arch == Target::X86) {
+        if (t.has_feature(Target::AVX512)) {
+            vector_registers = 32;
+        } else {
+            vector_registers = t.bits == 64 ? 16 : 8;
+        }
+    } else if (t.arch == Target::ARM) {
+        vector_registers = t.bits == 64 ? 32 : 16;
+    }
+    if (vector_registers == 0 ||
+        t.features_any_of({Target::HVX_64, Target::HVX_128})) {
+        // Hexagon code is carried during codegen, after its loads
+        // have been aligned.
+        return s;
+    }
+    // Scalar loads hit in L1 and there are plenty of memory issue
+    // slots, so only carry whole vectors, and use at most half the
+    // vector registers for them, as on Hexagon.
+    Stmt carried = LoopCarry(vector_registers / 2, true).mutate(s);
+    if (carried.same_as(s)) {
+        return s;
+    }
+    return simplify(carried);
+}
+
 
 }
 }
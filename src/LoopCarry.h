@@ -2,6 +2,7 @@
 #define HALIDE_LOOP_CARRY_H
 
 #include "Expr.h"
+#include "Target.h"
 
 namespace Halide {
 namespace Internal {
@@ -10,10 +11,16 @@ namespace Internal {
  * induction variables instead of redoing the load. If the loads are
  * predicated, the predicates need to match. Can be an optimization or
  * pessimization depending on how good the L1 cache is on the architecture
- * and how many memory issue slots there are. Currently only intended
- * for Hexagon. */
+ * and how many memory issue slots there are. GPU kernels are left
+ * alone. */
 Stmt loop_carry(Stmt, int max_carried_values = 8);
 
+/** Carry vector loads across the iterations of inner loops on x86 and
+ * ARM, e.g. the rows of a vertical stencil, using at most half of the
+ * target's vector registers. Does nothing on other targets. Hexagon
+ * uses the version above during codegen instead. */
+Stmt loop_carry(Stmt, const Target &t);
+
 }
 }
 
@@ -0,0 +1,263 @@
+#include <map>
+
+#include "LoopInvariantDivision.h"
+#include "IREquality.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "IRVisitor.h"
+#include "Scope.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Find the deepest loop that defines one of the variables an
+// expression uses, or -1 if the expression reads memory. A load might
+// read something the loop writes, or only be safe where it's guarded
+// by a condition inside the loop, so it can't be moved out.
+class DeepestDefinition : public IRVisitor {
+    const Scope<int> &depth;
+
+    using IRVisitor::visit;
+
+    void visit(const Variable *op) override {
+        if (depth.contains(op->name) && result >= 0) {
+            result = std::max(result, depth.get(op->name));
+        }
+    }
+
+    void visit(const Let *op) override {
+        // Don't bother disentangling the scopes of lets inside the
+        // divisor.
+        result = -1;
+    }
+
+    void visit(const Load *op) override {
+        result = -1;
+    }
+
+public:
+    int result = 0;
+
+    DeepestDefinition(const Scope<int> &depth) : depth(depth) {}
+};
+
+// For an N-bit divisor d, with l = ceil(log2(d)):
+//   multiplier = floor(2^N * (2^l - d) / d) + 1
+//   shift1 = min(l, 1), shift2 = max(l - 1, 0)
+// Then for any N-bit unsigned x:
+//   q = mulhi(multiplier, x)
+//   x / d = (((x - q) >> shift1) + q) >> shift2
+// This is the same method as the tables in IntegerDivisionTable.cpp
+// use for unsigned division by constants, with the shifts split so
+// that it also works for d = 1. Signed division uses it on the
+// numerator with its bits flipped if negative, like signed division
+// by a constant does, and on the magnitude of the divisor.
+struct Magic {
+    Type type;
+    string divisor, multiplier, shift1, shift2, divisor_sign;
+};
+
+class HoistInvariantDivision : public IRMutator2 {
+    using IRMutator2::visit;
+
+    // The loops we're inside, outermost first. The lets for each one
+    // are wrapped around it once it's been mutated.
+    struct Loop {
+        vector<pair<string, Expr>> lets;
+        map<Expr, Magic, IRDeepCompare> magic;
+    };
+    vector<Loop> loops;
+
+    // The number of loops each variable in scope is defined inside.
+    Scope<int> depth;
+
+    // Get the multiplier and shifts for dividing by b, putting them
+    // outside the outermost loop b is invariant in. Returns nullptr
+    // if b isn't a loop-invariant divisor we can handle.
+    const Magic *find_magic(const Expr &b) {
+        Type t = b.type().element_of();
+        if (loops.empty() ||
+            !(t.is_int() || t.is_uint()) ||
+            !(t.bits() == 8 || t.bits() == 16 || t.bits() == 32)) {
+            return nullptr;
+        }
+        Expr d = b;
+        if (const Broadcast *broadcast = d.as<Broadcast>()) {
+            d = broadcast->value;
+        }
+        if (!d.type().is_scalar() || is_const(d) || !is_pure(d)) {
+            // Division by constants is handled better by codegen.
+            return nullptr;
+        }
+        DeepestDefinition deepest(depth);
+        d.accept(&deepest);
+        if (deepest.result < 0 || deepest.result >= (int)loops.size()) {
+            return nullptr;
+        }
+
+        Loop &loop = loops[deepest.result];
+        auto it = loop.magic.find(d);
+        if (it != loop.magic.end()) {
+            return &it->second;
+        }
+
+        const int bits = t.bits();
+        Type ut = t.with_code(Type::UInt);
+        string name = unique_name('d');
+        Magic magic;
+        magic.type = t;
+        magic.divisor = name;
+        magic.multiplier = name + ".multiplier";
+        magic.shift1 = name + ".shift1";
+        magic.shift2 = name + ".shift2";
+        loop.lets.push_back({magic.divisor, d});
+
+        Expr dv = Variable::make(t, magic.divisor);
+        Expr ad = dv;
+        if (t.is_int()) {
+            magic.divisor_sign = name + ".sign";
+            loop.lets.push_back({magic.divisor_sign, dv >> make_const(t, bits - 1)});
+            Expr sign = Variable::make(t, magic.divisor_sign);
+            ad = cast(ut, (dv ^ sign) - sign);
+        }
+        // Dividing by zero is undefined, but the preamble runs even
+        // if the loop doesn't, so it mustn't trap.
+        ad = max(ad, make_one(ut));
+
+        Expr l = bits - cast<int>(count_leading_zeros(ad - make_one(ut)));
+        Expr wide_d = cast<uint64_t>(ad);
+        Expr m = (((make_one(UInt(64)) << cast<uint64_t>(l)) - wide_d) << make_const(UInt(64), bits)) / wide_d;
+        loop.lets.push_back({magic.multiplier, cast(ut, m + make_one(UInt(64)))});
+        loop.lets.push_back({magic.shift1, cast(ut, min(l, 1))});
+        loop.lets.push_back({magic.shift2, cast(ut, max(l - 1, 0))});
+
+        return &(loop.magic[d] = magic);
+    }
+
+    // Divide x, which must be a variable or constant, using the given
+    // multiplier and shifts.
+    Expr divide(const Expr &x, const Magic &magic) {
+        Type t = x.type();
+        Type ut = t.with_code(Type::UInt);
+        Type wide = ut.with_bits(ut.bits() * 2);
+        int lanes = t.lanes();
+        auto scalar = [&](const string &n, Type type) {
+            Expr v = Variable::make(type.element_of(), n);
+            return lanes == 1 ? v : Broadcast::make(v, lanes);
+        };
+        Expr m = scalar(magic.multiplier, ut);
+        Expr shift1 = scalar(magic.shift1, ut);
+        Expr shift2 = scalar(magic.shift2, ut);
+
+        Expr num = x, sign;
+        if (t.is_int()) {
+            // Make an all-ones mask if the numerator is negative, and
+            // flip its bits if so.
+            sign = x >> make_const(t, t.bits() - 1);
+            num = cast(ut, x ^ sign);
+        }
+
+        // Multiply and keep the high half, average with the
+        // numerator, and do the final shift.
+        Expr q = cast(ut, (cast(wide, num) * cast(wide, m)) >> make_const(wide, ut.bits()));
+        q = (((num - q) >> shift1) + q) >> shift2;
+
+        if (t.is_int()) {
+            // Flip the bits back, and negate if the divisor was negative.
+            Expr divisor_sign = scalar(magic.divisor_sign, t);
+            q = cast(t, q) ^ sign;
+            q = (q ^ divisor_sign) - divisor_sign;
+        }
+        return q;
+    }
+
+    // Bind e to a name, unless it's cheap enough to use more than once.
+    template<typename Fn>
+    Expr with_value(const Expr &e, Fn &&fn) {
+        if (e.as<Variable>() || is_const(e)) {
+            return fn(e);
+        }
+        string name = unique_name('t');
+        return Let::make(name, e, fn(Variable::make(e.type(), name)));
+    }
+
+    Expr visit(const Div *op) override {
+        Expr a = mutate(op->a);
+        Expr b = mutate(op->b);
+        if (const Magic *magic = find_magic(b)) {
+            return with_value(a, [&](const Expr &x) { return divide(x, *magic); });
+        }
+        return Div::make(a, b);
+    }
+
+    Expr visit(const Mod *op) override {
+        Expr a = mutate(op->a);
+        Expr b = mutate(op->b);
+        if (const Magic *magic = find_magic(b)) {
+            // a % b = a - (a / b) * b, which for Euclidean division
+            // is always non-negative.
+            return with_value(a, [&](const Expr &x) {
+                Expr d = Variable::make(magic->type, magic->divisor);
+                if (x.type().is_vector()) {
+                    d = Broadcast::make(d, x.type().lanes());
+                }
+                return x - divide(x, *magic) * d;
+            });
+        }
+        return Mod::make(a, b);
+    }
+
+    Expr visit(const Let *op) override {
+        Expr value = mutate(op->value);
+        depth.push(op->name, (int)loops.size());
+        Expr body = mutate(op->body);
+        depth.pop(op->name);
+        return Let::make(op->name, value, body);
+    }
+
+    Stmt visit(const LetStmt *op) override {
+        Expr value = mutate(op->value);
+        depth.push(op->name, (int)loops.size());
+        Stmt body = mutate(op->body);
+        depth.pop(op->name);
+        return LetStmt::make(op->name, value, body);
+    }
+
+    Stmt visit(const For *op) override {
+        if (op->device_api != DeviceAPI::None && op->device_api != DeviceAPI::Host) {
+            // Leave device code to its own backend.
+            return op;
+        }
+        Expr min = mutate(op->min);
+        Expr extent = mutate(op->extent);
+
+        loops.emplace_back();
+        depth.push(op->name, (int)loops.size());
+        Stmt body = mutate(op->body);
+        depth.pop(op->name);
+
+        Stmt stmt = For::make(op->name, min, extent, op->for_type, op->device_api, body);
+        vector<pair<string, Expr>> lets = std::move(loops.back().lets);
+        loops.pop_back();
+        for (auto it = lets.rbegin(); it != lets.rend(); it++) {
+            stmt = LetStmt::make(it->first, it->second, stmt);
+        }
+        return stmt;
+    }
+};
+
+}  // namespace
+
+Stmt hoist_loop_invariant_divisions(Stmt s) {
+    return HoistInvariantDivision().mutate(s);
+}
+
+}  // namespace Internal
+}  // namespace Halide
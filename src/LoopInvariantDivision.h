@@ -0,0 +1,27 @@
+#ifndef HALIDE_LOOP_INVARIANT_DIVISION_H
+#define HALIDE_LOOP_INVARIANT_DIVISION_H
+
+/** \file
+ * Defines the lowering pass that replaces division by loop-invariant
+ * values with multiplies and shifts.
+ */
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Replace integer division and modulus by a value that isn't known
+ * at compile time, but doesn't change within a loop, with a
+ * multiply-keep-high-half and shifts. The multiplier and shifts are
+ * computed once per divisor, just outside the outermost loop the
+ * divisor is invariant in. Applies to 8, 16, and 32-bit scalars and
+ * vectors, on the CPU. Division by zero gives an undefined (but not
+ * trapping) result. Should be run after vectorization and the final
+ * simplification. */
+Stmt hoist_loop_invariant_divisions(Stmt s);
+
+}
+}
+
+#endif
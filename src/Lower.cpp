@@ -8,19 +8,25 @@
 #include "AddImageChecks.h"
 #include "AddParameterChecks.h"
 #include "AllocationBoundsInference.h"
+#include "AsyncProducers.h"
+#include "BatchAsserts.h"
 #include "Bounds.h"
 #include "BoundsInference.h"
 #include "BoundSmallAllocations.h"
 #include "CSE.h"
 #include "CanonicalizeGPUVars.h"
+#include "CompileTimeProfiling.h"
 #include "Debug.h"
 #include "DebugArguments.h"
 #include "DebugToFile.h"
 #include "Deinterleave.h"
+#include "ExprUsesVar.h"
 #include "EarlyFree.h"
+#include "EmulateBFloat16Math.h"
 #include "FindCalls.h"
 #include "Func.h"
 #include "Function.h"
+#include "FuseGPUKernels.h"
 #include "FuseGPUThreadLoops.h"
 #include "FuzzFloatStores.h"
 #include "HexagonOffload.h"
@@ -33,10 +39,16 @@
 #include "IRPrinter.h"
 #include "LICM.h"
 #include "LoopCarry.h"
+#include "LoopInvariantDivision.h"
+#include "LowerTensorCores.h"
+#include "LowerWarpShuffles.h"
 #include "Memoization.h"
+#include "OptimizeShuffles.h"
 #include "PartitionLoops.h"
+#include "PersistentScratch.h"
 #include "Prefetch.h"
 #include "Profiling.h"
+#include "PromoteAccumulators.h"
 #include "Qualify.h"
 #include "RealizationOrder.h"
 #include "RemoveDeadAllocations.h"
@@ -44,6 +56,7 @@
 #include "RemoveUndef.h"
 #include "ScheduleFunctions.h"
 #include "SelectGPUAPI.h"
+#include "ShareAllocations.h"
 #include "SkipStages.h"
 #include "SlidingWindow.h"
 #include "Simplify.h"
@@ -51,12 +64,15 @@
 #include "SplitTuples.h"
 #include "StorageFlattening.h"
 #include "StorageFolding.h"
+#include "StreamingStores.h"
 #include "Substitute.h"
 #include "Tracing.h"
+#include "TransposeStridedLoads.h"
 #include "TrimNoOps.h"
 #include "UnifyDuplicateLets.h"
 #include "UniquifyVariableNames.h"
 #include "UnpackBuffers.h"
+#include "UnsafePromises.h"
 #include "UnrollLoops.h"
 #include "VaryingAttributes.h"
 #include "VectorizeLoops.h"
@@ -74,7 +90,11 @@ using std::map;
 
 Module lower(const vector<Function> &output_funcs, const string &pipeline_name, const Target &t,
              const vector<Argument> &args, const Internal::LoweredFunc::LinkageType linkage_type,
-             const vector<IRMutator2 *> &custom_passes) {
+             const vector<IRMutator2 *> &custom_passes,
+             const map<Expr, Expr, IRDeepCompare> &known_specialization_conditions) {
+    CompileTimeProfiler profiler("lower " + pipeline_name);
+    profiler.phase("Copying and preparing the Funcs");
+
     std::vector<std::string> namespaces;
     std::string simple_pipeline_name = extract_namespaces(pipeline_name, namespaces);
 
@@ -112,18 +132,21 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
 
     // Try to simplify the RHS/LHS of a function definition by propagating its
     // specializations' conditions
-    simplify_specializations(env);
+    simplify_specializations(env, known_specialization_conditions);
 
+    profiler.phase("Creating initial loop nests");
     debug(1) << "Creating initial loop nests...\n";
     bool any_memoized = false;
     Stmt s = schedule_functions(outputs, order, env, t, any_memoized);
     debug(2) << "Lowering after creating initial loop nests:\n" << s << '\n';
 
+    profiler.phase("Canonicalizing GPU var names", s);
     debug(1) << "Canonicalizing GPU var names...\n";
     s = canonicalize_gpu_vars(s);
     debug(2) << "Lowering after canonicalizing GPU var names:\n" << s << '\n';
 
     if (any_memoized) {
+        profiler.phase("Injecting memoization", s);
         debug(1) << "Injecting memoization...\n";
         s = inject_memoization(s, env, pipeline_name, outputs);
         debug(2) << "Lowering after injecting memoization:\n" << s << '\n';
@@ -131,21 +154,25 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
         debug(1) << "Skipping injecting memoization...\n";
     }
 
+    profiler.phase("Injecting tracing", s);
     debug(1) << "Injecting tracing...\n";
     s = inject_tracing(s, pipeline_name, env, outputs, t);
     debug(2) << "Lowering after injecting tracing:\n" << s << '\n';
 
+    profiler.phase("Adding checks for parameters", s);
     debug(1) << "Adding checks for parameters\n";
     s = add_parameter_checks(s, t);
     debug(2) << "Lowering after injecting parameter checks:\n" << s << '\n';
 
     // Compute the maximum and minimum possible value of each
     // function. Used in later bounds inference passes.
+    profiler.phase("Computing bounds of each function's value", s);
     debug(1) << "Computing bounds of each function's value\n";
     FuncValueBounds func_bounds = compute_function_value_bounds(order, env);
 
     // The checks will be in terms of the symbols defined by bounds
     // inference.
+    profiler.phase("Adding checks for images", s);
     debug(1) << "Adding checks for images\n";
     s = add_image_checks(s, outputs, t, order, env, func_bounds);
     debug(2) << "Lowering after injecting image checks:\n" << s << '\n';
@@ -153,18 +180,30 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
     // This pass injects nested definitions of variable names, so we
     // can't simplify statements from here until we fix them up. (We
     // can still simplify Exprs).
+    profiler.phase("Performing computation bounds inference", s);
     debug(1) << "Performing computation bounds inference...\n";
     s = bounds_inference(s, outputs, order, env, func_bounds, t);
+    if (stmt_uses_var(s, "__distributed_rank")) {
+        // The slices of distributed loops, and so the regions of
+        // everything they use, depend on which rank this is.
+        s = LetStmt::make("__distributed_rank",
+                          Call::make(Int(32), "halide_distributed_rank", {}, Call::Extern), s);
+        s = LetStmt::make("__distributed_num_ranks",
+                          Call::make(Int(32), "halide_distributed_num_ranks", {}, Call::Extern), s);
+    }
     debug(2) << "Lowering after computation bounds inference:\n" << s << '\n';
 
+    profiler.phase("Performing sliding window optimization", s);
     debug(1) << "Performing sliding window optimization...\n";
     s = sliding_window(s, env);
     debug(2) << "Lowering after sliding window:\n" << s << '\n';
 
+    profiler.phase("Performing allocation bounds inference", s);
     debug(1) << "Performing allocation bounds inference...\n";
     s = allocation_bounds_inference(s, env, func_bounds);
     debug(2) << "Lowering after allocation bounds inference:\n" << s << '\n';
 
+    profiler.phase("Removing code that depends on undef values", s);
     debug(1) << "Removing code that depends on undef values...\n";
     s = remove_undef(s);
     debug(2) << "Lowering after removing code that depends on undef values:\n" << s << "\n\n";
@@ -172,43 +211,65 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
     // This uniquifies the variable names, so we're good to simplify
     // after this point. This lets later passes assume syntactic
     // equivalence means semantic equivalence.
+    profiler.phase("Uniquifying variable names", s);
     debug(1) << "Uniquifying variable names...\n";
     s = uniquify_variable_names(s);
     debug(2) << "Lowering after uniquifying variable names:\n" << s << "\n\n";
 
+    profiler.phase("Performing storage folding optimization", s);
     debug(1) << "Performing storage folding optimization...\n";
     s = storage_folding(s, env);
     debug(2) << "Lowering after storage folding:\n" << s << '\n';
 
+    profiler.phase("Injecting debug_to_file calls", s);
     debug(1) << "Injecting debug_to_file calls...\n";
     s = debug_to_file(s, outputs, env);
     debug(2) << "Lowering after injecting debug_to_file calls:\n" << s << '\n';
 
+    profiler.phase("Simplifying", s);
     debug(1) << "Simplifying...\n"; // without removing dead lets, because storage flattening needs the strides
     s = simplify(s, false);
     debug(2) << "Lowering after first simplification:\n" << s << "\n\n";
 
+    profiler.phase("Injecting prefetches", s);
     debug(1) << "Injecting prefetches...\n";
     s = inject_prefetch(s, env);
     debug(2) << "Lowering after injecting prefetches:\n" << s << "\n\n";
 
+    profiler.phase("Dynamically skipping stages", s);
     debug(1) << "Dynamically skipping stages...\n";
     s = skip_stages(s, order);
     debug(2) << "Lowering after dynamically skipping stages:\n" << s << "\n\n";
 
+    profiler.phase("Forking asynchronous producers", s);
+    debug(1) << "Forking asynchronous producers...\n";
+    s = fork_async_producers(s, env);
+    debug(2) << "Lowering after forking asynchronous producers:\n" << s << "\n\n";
+
+    if (t.has_feature(Target::TaskParallel)) {
+        profiler.phase("Forking independent stages", s);
+        debug(1) << "Forking independent stages...\n";
+        s = fork_independent_stages(s);
+        debug(2) << "Lowering after forking independent stages:\n" << s << "\n\n";
+    }
+
+    profiler.phase("Destructuring tuple-valued realizations", s);
     debug(1) << "Destructuring tuple-valued realizations...\n";
     s = split_tuples(s, env);
     debug(2) << "Lowering after destructuring tuple-valued realizations:\n" << s << "\n\n";
 
+    profiler.phase("Performing storage flattening", s);
     debug(1) << "Performing storage flattening...\n";
     s = storage_flattening(s, outputs, env, t);
     debug(2) << "Lowering after storage flattening:\n" << s << "\n\n";
 
+    profiler.phase("Unpacking buffer arguments", s);
     debug(1) << "Unpacking buffer arguments...\n";
     s = unpack_buffers(s);
     debug(2) << "Lowering after unpacking buffer arguments...\n" << s << "\n\n";
 
     if (any_memoized) {
+        profiler.phase("Rewriting memoized allocations", s);
         debug(1) << "Rewriting memoized allocations...\n";
         s = rewrite_memoized_allocations(s, env);
         debug(2) << "Lowering after rewriting memoized allocations:\n" << s << "\n\n";
@@ -220,94 +281,184 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
         t.has_feature(Target::OpenGLCompute) ||
         t.has_feature(Target::OpenGL) ||
         (t.arch != Target::Hexagon && (t.features_any_of({Target::HVX_64, Target::HVX_128})))) {
+        profiler.phase("Selecting a GPU API for GPU loops", s);
         debug(1) << "Selecting a GPU API for GPU loops...\n";
         s = select_gpu_api(s, t);
         debug(2) << "Lowering after selecting a GPU API:\n" << s << "\n\n";
 
+        if (t.has_feature(Target::GPUKernelFusion)) {
+            profiler.phase("Fusing GPU kernels", s);
+            debug(1) << "Fusing GPU kernels...\n";
+            s = fuse_gpu_kernels(s);
+            debug(2) << "Lowering after fusing GPU kernels:\n" << s << "\n\n";
+        }
+
+        profiler.phase("Injecting host <-> dev buffer copies", s);
         debug(1) << "Injecting host <-> dev buffer copies...\n";
         s = inject_host_dev_buffer_copies(s, t);
         debug(2) << "Lowering after injecting host <-> dev buffer copies:\n" << s << "\n\n";
 
+        profiler.phase("Selecting a GPU API for extern stages", s);
         debug(1) << "Selecting a GPU API for extern stages...\n";
         s = select_gpu_api(s, t);
         debug(2) << "Lowering after selecting a GPU API for extern stages:\n" << s << "\n\n";
     }
 
     if (t.has_feature(Target::OpenGL)) {
+        profiler.phase("Injecting OpenGL texture intrinsics", s);
         debug(1) << "Injecting OpenGL texture intrinsics...\n";
         s = inject_opengl_intrinsics(s);
         debug(2) << "Lowering after OpenGL intrinsics:\n" << s << "\n\n";
     }
 
+    if (t.has_feature(Target::CUDA)) {
+        profiler.phase("Injecting tensor core instructions", s);
+        debug(1) << "Injecting tensor core instructions...\n";
+        s = lower_tensor_cores(s, t);
+        debug(2) << "Lowering after injecting tensor core instructions:\n" << s << "\n\n";
+    }
+
+    if (t.has_feature(Target::CUDA) || t.has_feature(Target::OpenCL)) {
+        profiler.phase("Injecting warp shuffles", s);
+        debug(1) << "Injecting warp shuffles...\n";
+        s = lower_warp_shuffles(s, t);
+        debug(2) << "Lowering after injecting warp shuffles:\n" << s << "\n\n";
+    }
+
     if (t.has_gpu_feature() ||
         t.has_feature(Target::OpenGLCompute)) {
+        profiler.phase("Injecting per-block gpu synchronization", s);
         debug(1) << "Injecting per-block gpu synchronization...\n";
-        s = fuse_gpu_thread_loops(s);
+        s = fuse_gpu_thread_loops(s, env);
         debug(2) << "Lowering after injecting per-block gpu synchronization:\n" << s << "\n\n";
     }
 
+    profiler.phase("Simplifying", s);
     debug(1) << "Simplifying...\n";
     s = simplify(s);
     s = unify_duplicate_lets(s);
     s = remove_trivial_for_loops(s);
     debug(2) << "Lowering after second simplifcation:\n" << s << "\n\n";
 
+    if (t.has_feature(Target::AutoPrefetch)) {
+        profiler.phase("Injecting automatic prefetches", s);
+        debug(1) << "Injecting automatic prefetches...\n";
+        s = inject_auto_prefetch(s, t);
+        debug(2) << "Lowering after injecting automatic prefetches:\n" << s << "\n\n";
+    }
+
+    profiler.phase("Reduce prefetch dimension", s);
     debug(1) << "Reduce prefetch dimension...\n";
     s = reduce_prefetch_dimension(s, t);
     debug(2) << "Lowering after reduce prefetch dimension:\n" << s << "\n";
 
+    profiler.phase("Lowering unsafe promises", s);
+    debug(1) << "Lowering unsafe promises...\n";
+    s = lower_unsafe_promises(s);
+    debug(2) << "Lowering after lowering unsafe promises:\n" << s << "\n\n";
+
+    profiler.phase("Unrolling", s);
     debug(1) << "Unrolling...\n";
     s = unroll_loops(s);
     s = simplify(s);
     debug(2) << "Lowering after unrolling:\n" << s << "\n\n";
 
+    profiler.phase("Vectorizing", s);
     debug(1) << "Vectorizing...\n";
     s = vectorize_loops(s, t);
     s = simplify(s);
     debug(2) << "Lowering after vectorizing:\n" << s << "\n\n";
 
+    profiler.phase("Detecting vector interleavings", s);
     debug(1) << "Detecting vector interleavings...\n";
     s = rewrite_interleavings(s);
     s = simplify(s);
     debug(2) << "Lowering after rewriting vector interleavings:\n" << s << "\n\n";
 
+    profiler.phase("Transposing strided loads", s);
+    debug(1) << "Transposing strided loads...\n";
+    s = transpose_strided_loads(s);
+    s = simplify(s);
+    debug(2) << "Lowering after transposing strided loads:\n" << s << "\n\n";
+
+    profiler.phase("Promoting accumulators to registers", s);
+    debug(1) << "Promoting accumulators to registers...\n";
+    s = promote_accumulators(s);
+    s = simplify(s);
+    debug(2) << "Lowering after promoting accumulators to registers:\n" << s << "\n\n";
+
+    profiler.phase("Partitioning loops to simplify boundary conditions", s);
     debug(1) << "Partitioning loops to simplify boundary conditions...\n";
-    s = partition_loops(s);
+    s = partition_loops(s, t.has_feature(Target::SizeOptimized));
     s = simplify(s);
     debug(2) << "Lowering after partitioning loops:\n" << s << "\n\n";
 
+    profiler.phase("Trimming loops to the region over which they do something", s);
     debug(1) << "Trimming loops to the region over which they do something...\n";
     s = trim_no_ops(s);
     debug(2) << "Lowering after loop trimming:\n" << s << "\n\n";
 
+    profiler.phase("Injecting early frees", s);
     debug(1) << "Injecting early frees...\n";
     s = inject_early_frees(s);
     debug(2) << "Lowering after injecting early frees:\n" << s << "\n\n";
 
-    if (t.has_feature(Target::Profile)) {
+    if (t.has_feature(Target::Profile) ||
+        t.has_feature(Target::ProfileTimeline) ||
+        t.has_feature(Target::ProfileLightweight)) {
+        profiler.phase("Injecting profiling", s);
         debug(1) << "Injecting profiling...\n";
-        s = inject_profiling(s, pipeline_name);
+        s = inject_profiling(s, pipeline_name, t);
         debug(2) << "Lowering after injecting profiling:\n" << s << "\n\n";
     }
 
     if (t.has_feature(Target::FuzzFloatStores)) {
+        profiler.phase("Fuzzing floating point stores", s);
         debug(1) << "Fuzzing floating point stores...\n";
         s = fuzz_float_stores(s);
         debug(2) << "Lowering after fuzzing floating point stores:\n" << s << "\n\n";
     }
 
+    profiler.phase("Emulating bfloat16 math", s);
+    debug(1) << "Emulating bfloat16 math...\n";
+    s = emulate_bfloat16_math(s);
+    debug(2) << "Lowering after emulating bfloat16 math:\n" << s << "\n\n";
+
+    profiler.phase("Bounding small allocations", s);
     debug(1) << "Bounding small allocations...\n";
     s = bound_small_allocations(s);
     debug(2) << "Lowering after bounding small allocations:\n" << s << "\n\n";
 
+    if (t.has_feature(Target::ShareAllocations)) {
+        profiler.phase("Sharing memory between allocations", s);
+        debug(1) << "Sharing memory between allocations...\n";
+        s = share_allocations(s, t);
+        debug(2) << "Lowering after sharing memory between allocations:\n" << s << "\n\n";
+    }
+
+    if (t.has_feature(Target::PersistentScratch)) {
+        profiler.phase("Moving root allocations to persistent scratch", s);
+        debug(1) << "Moving root allocations to persistent scratch...\n";
+        s = use_persistent_scratch(s, pipeline_name);
+        debug(2) << "Lowering after moving root allocations to persistent scratch:\n" << s << "\n\n";
+    }
+
+    profiler.phase("Replacing lookups into small tables with shuffles", s);
+    debug(1) << "Replacing lookups into small tables with shuffles...\n";
+    s = optimize_shuffles(s, t);
+    debug(2) << "Lowering after replacing lookups into small tables with shuffles:\n" << s << "\n\n";
+
+    profiler.phase("Simplifying", s);
     debug(1) << "Simplifying...\n";
     s = common_subexpression_elimination(s);
 
     if (t.has_feature(Target::OpenGL)) {
+        profiler.phase("Detecting varying attributes", s);
         debug(1) << "Detecting varying attributes...\n";
         s = find_linear_expressions(s);
         debug(2) << "Lowering after detecting varying attributes:\n" << s << "\n\n";
 
+        profiler.phase("Moving varying attribute expressions out of the shader", s);
         debug(1) << "Moving varying attribute expressions out of the shader...\n";
         s = setup_gpu_vertex_buffer(s);
         debug(2) << "Lowering after removing varying attributes:\n" << s << "\n\n";
@@ -319,18 +470,43 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
     s = loop_invariant_code_motion(s);
     debug(1) << "Lowering after final simplification:\n" << s << "\n\n";
 
+    if (!t.has_feature(Target::NoAsserts)) {
+        profiler.phase("Batching assertions", s);
+        debug(1) << "Batching assertions...\n";
+        s = batch_asserts(s);
+        debug(2) << "Lowering after batching assertions:\n" << s << "\n\n";
+    }
+
+    profiler.phase("Hoisting loop-invariant divisions", s);
+    debug(1) << "Hoisting loop-invariant divisions...\n";
+    s = hoist_loop_invariant_divisions(s);
+    debug(2) << "Lowering after hoisting loop-invariant divisions:\n" << s << "\n\n";
+
+    profiler.phase("Carrying values across loop iterations", s);
+    debug(1) << "Carrying values across loop iterations...\n";
+    s = loop_carry(s, t);
+    debug(2) << "Lowering after carrying values across loop iterations:\n" << s << "\n\n";
+
+    profiler.phase("Marking streaming stores", s);
+    debug(1) << "Marking streaming stores...\n";
+    s = inject_streaming_stores(s, env);
+    debug(2) << "Lowering after marking streaming stores:\n" << s << "\n\n";
+
+    profiler.phase("Splitting off Hexagon offload", s);
     debug(1) << "Splitting off Hexagon offload...\n";
     s = inject_hexagon_rpc(s, t, result_module);
     debug(2) << "Lowering after splitting off Hexagon offload:\n" << s << '\n';
 
     if (!custom_passes.empty()) {
         for (size_t i = 0; i < custom_passes.size(); i++) {
+            profiler.phase("Running custom lowering pass " + std::to_string(i), s);
             debug(1) << "Running custom lowering pass " << i << "...\n";
             s = custom_passes[i]->mutate(s);
             debug(1) << "Lowering after custom pass " << i << ":\n" << s << "\n\n";
         }
     }
 
+    profiler.phase("Inferring arguments", s);
     vector<Argument> public_args = args;
     for (const auto &out : outputs) {
         for (Parameter buf : out.output_buffers()) {
@@ -413,6 +589,7 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
     }
 
     result_module.append(main_func);
+    profiler.end(main_func.body);
 
     // Append a wrapper for this pipeline that accepts old buffer_ts
     // and upgrades them. It will use the same name, so it will
@@ -8,9 +8,11 @@
  */
 
 #include <iterator>
+#include <map>
 
 #include "Argument.h"
 #include "IR.h"
+#include "IREquality.h"
 #include "Module.h"
 #include "Target.h"
 
@@ -25,10 +27,14 @@ class IRMutator2;
  * contain submodules for computation offloaded to another execution
  * engine or API as well as buffers that are used in the passed in
  * Stmt. Multiple LoweredFuncs are added to support legacy buffer_t
- * calling convention. */
+ * calling convention. Specialization conditions equal to a key of
+ * known_specialization_conditions are lowered as if they were its
+ * value. */
 EXPORT Module lower(const std::vector<Function> &output_funcs, const std::string &pipeline_name, const Target &t,
                     const std::vector<Argument> &args, const Internal::LoweredFunc::LinkageType linkage_type,
-                    const std::vector<IRMutator2 *> &custom_passes = std::vector<IRMutator2 *>());
+                    const std::vector<IRMutator2 *> &custom_passes = std::vector<IRMutator2 *>(),
+                    const std::map<Expr, Expr, IRDeepCompare> &known_specialization_conditions =
+                        std::map<Expr, Expr, IRDeepCompare>());
 
 /** Given a halide function with a schedule, create a statement that
  * evaluates it. Automatically pulls in all the functions f depends
@@ -0,0 +1,271 @@
+#include "LowerTensorCores.h"
+#include "CodeGen_GPU_Dev.h"
+#include "ExprUsesVar.h"
+#include "IREquality.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "ModulusRemainder.h"
+#include "Simplify.h"
+#include "Substitute.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace {
+
+// The shape of a wmma tile.
+const int tile_size = 16;
+
+// The operands of wmma loads and stores must be 32-byte aligned.
+const int alignment_bytes = 32;
+
+// An operand of the multiply-accumulate: a load at some base address
+// with unit stride along one of the two dimensions of the tile, and a
+// leading dimension (ldm) along the other.
+struct Operand {
+    Expr base;
+    Expr ldm;
+    // True if the unit stride is along the columns, i.e. the tile is
+    // stored row-major in the terms of the wmma api.
+    bool row_major;
+};
+
+class LowerTensorCores : public IRMutator2 {
+    bool in_kernel = false, in_threads = false;
+    Scope<ModulusRemainder> alignment_info;
+
+    using IRMutator2::visit;
+
+    bool is_aligned(Expr e, int factor) {
+        ModulusRemainder mr = modulus_remainder(e, alignment_info);
+        return mr.modulus % factor == 0 && mr.remainder % factor == 0;
+    }
+
+    // Work out the base and layout of the tile read by the load at
+    // index, which must be indexed by the vars row and col, and not
+    // by the var unused. The row of a tile is its first index in the
+    // wmma api.
+    bool match_operand(Expr index, Type t,
+                       const string &row, const string &col, const string &unused,
+                       const vector<const For *> &loops, Operand *result) {
+        if (expr_uses_var(index, unused)) {
+            return false;
+        }
+
+        Scope<int> loop_vars;
+        for (const For *f : loops) {
+            loop_vars.push(f->name, 0);
+        }
+        auto stride = [&](const string &v) {
+            Expr next = substitute(v, Variable::make(Int(32), v) + 1, index);
+            Expr s = simplify(next - index);
+            return expr_uses_vars(s, loop_vars) ? Expr() : s;
+        };
+        Expr row_stride = stride(row), col_stride = stride(col);
+        if (!row_stride.defined() || !col_stride.defined()) {
+            return false;
+        }
+
+        if (is_one(col_stride)) {
+            result->row_major = true;
+            result->ldm = row_stride;
+        } else if (is_one(row_stride)) {
+            result->row_major = false;
+            result->ldm = col_stride;
+        } else {
+            return false;
+        }
+
+        Expr base = index;
+        for (const For *f : loops) {
+            base = substitute(f->name, f->min, base);
+        }
+        result->base = simplify(base);
+
+        int elems = alignment_bytes / t.bytes();
+        // The leading dimension has to be a multiple of 16 bytes.
+        return (is_aligned(result->ldm, elems / 2) &&
+                is_aligned(result->base, elems));
+    }
+
+    // Match a perfect nest of three loops of extent 16 computing:
+    //
+    // C[c] = C[c] + float32(A[a]) * float32(B[b])
+    //
+    // and replace it with a call to a warp-wide multiply-accumulate
+    // on the tensor cores. Returns an undefined Stmt if the nest
+    // doesn't match.
+    Stmt lower_mma(const For *op) {
+        vector<const For *> loops;
+        vector<pair<string, Expr>> lets;
+        Stmt s = op;
+        while (true) {
+            if (const For *f = s.as<For>()) {
+                const int64_t *extent = as_const_int(f->extent);
+                if (loops.size() == 3 ||
+                    (f->for_type != ForType::Serial &&
+                     f->for_type != ForType::Unrolled) ||
+                    !extent || *extent != tile_size) {
+                    return Stmt();
+                }
+                loops.push_back(f);
+                s = f->body;
+            } else if (const LetStmt *let = s.as<LetStmt>()) {
+                lets.push_back({let->name, let->value});
+                s = let->body;
+            } else {
+                break;
+            }
+        }
+
+        const Store *store = s.as<Store>();
+        if (loops.size() != 3 || !store ||
+            store->value.type() != Float(32) ||
+            !is_one(store->predicate)) {
+            return Stmt();
+        }
+
+        Expr value = store->value, c_index = store->index;
+        for (size_t i = lets.size(); i > 0; i--) {
+            value = substitute(lets[i - 1].first, lets[i - 1].second, value);
+            c_index = substitute(lets[i - 1].first, lets[i - 1].second, c_index);
+        }
+
+        const Add *add = value.as<Add>();
+        if (!add) {
+            return Stmt();
+        }
+        Expr acc = add->a, prod = add->b;
+        if (!acc.as<Load>()) {
+            std::swap(acc, prod);
+        }
+        const Load *c = acc.as<Load>();
+        const Mul *mul = prod.as<Mul>();
+        if (!c || !mul ||
+            c->name != store->name ||
+            !equal(c->index, c_index)) {
+            return Stmt();
+        }
+
+        auto as_f16_load = [](const Expr &e) -> const Load * {
+            const Cast *cast = e.as<Cast>();
+            const Load *load = cast ? cast->value.as<Load>() : nullptr;
+            if (load && load->type == Float(16) && is_one(load->predicate)) {
+                return load;
+            }
+            return nullptr;
+        };
+        const Load *a = as_f16_load(mul->a), *b = as_f16_load(mul->b);
+        if (!a || !b || a->name == store->name || b->name == store->name) {
+            return Stmt();
+        }
+
+        // Work out which loop is which from the indices. The
+        // accumulator isn't indexed by k, A isn't indexed by x, and B
+        // isn't indexed by y. If the operands of the multiply are the
+        // other way around, this computes the transpose of C as the
+        // product of the transposes, which is just as good.
+        string x, y, k;
+        for (const For *f : loops) {
+            bool in_a = expr_uses_var(a->index, f->name);
+            bool in_b = expr_uses_var(b->index, f->name);
+            bool in_c = expr_uses_var(c->index, f->name);
+            if (in_a && in_b && !in_c) {
+                k = f->name;
+            } else if (in_b && in_c && !in_a) {
+                x = f->name;
+            } else if (in_a && in_c && !in_b) {
+                y = f->name;
+            }
+        }
+        if (x.empty() || y.empty() || k.empty()) {
+            return Stmt();
+        }
+
+        Operand a_op, b_op, c_op;
+        if (!match_operand(a->index, a->type, y, k, x, loops, &a_op) ||
+            !match_operand(b->index, b->type, k, x, y, loops, &b_op) ||
+            !match_operand(c->index, c->type, y, x, k, loops, &c_op)) {
+            debug(1) << "Not using tensor cores for loop over " << op->name
+                     << " because its operands aren't dense and aligned\n";
+            return Stmt();
+        }
+
+        vector<Expr> args;
+        const Load *loads[] = {a, b, c};
+        const Operand *operands[] = {&a_op, &b_op, &c_op};
+        for (int i = 0; i < 3; i++) {
+            // Pass each operand as a load of the first element of its
+            // tile, so that later passes rewrite the buffer it points
+            // into (e.g. into a slice of the shared memory
+            // allocation).
+            args.push_back(Load::make(loads[i]->type, loads[i]->name, operands[i]->base,
+                                      loads[i]->image, loads[i]->param, const_true()));
+            args.push_back(operands[i]->ldm);
+            args.push_back(operands[i]->row_major ? 1 : 0);
+        }
+
+        // The whole warp takes part in each wmma instruction. Each
+        // lane holds its own part of the fragments.
+        Stmt body = Evaluate::make(Call::make(Int(32), "halide.ptx.wmma.m16n16k16.f32.f16",
+                                              args, Call::Extern));
+        string lane = unique_name("wmma") + ".__thread_id_x";
+        return For::make(lane, 0, 32, ForType::GPULane, DeviceAPI::CUDA, body);
+    }
+
+    Stmt visit(const For *op) override {
+        if (!in_kernel && CodeGen_GPU_Dev::is_gpu_block_var(op->name)) {
+            ScopedValue<bool> old_in_kernel(in_kernel, true);
+            return IRMutator2::visit(op);
+        }
+
+        if (CodeGen_GPU_Dev::is_gpu_thread_var(op->name) ||
+            op->for_type == ForType::GPUThread ||
+            op->for_type == ForType::GPULane) {
+            ScopedValue<bool> old_in_threads(in_threads, true);
+            return IRMutator2::visit(op);
+        }
+
+        if (in_kernel && !in_threads) {
+            Stmt lowered = lower_mma(op);
+            if (lowered.defined()) {
+                debug(3) << "Lowered loop over " << op->name << " to tensor cores:\n" << lowered << "\n";
+                return lowered;
+            }
+        }
+
+        return IRMutator2::visit(op);
+    }
+
+    Stmt visit(const LetStmt *op) override {
+        if (op->value.type() == Int(32)) {
+            alignment_info.push(op->name, modulus_remainder(op->value, alignment_info));
+        }
+        Stmt stmt = IRMutator2::visit(op);
+        if (op->value.type() == Int(32)) {
+            alignment_info.pop(op->name);
+        }
+        return stmt;
+    }
+};
+
+}  // namespace
+
+Stmt lower_tensor_cores(Stmt s, const Target &t) {
+    #if LLVM_VERSION < 60
+    // The wmma intrinsics first appeared in LLVM 6.
+    return s;
+    #endif
+    if (!t.features_any_of({Target::CUDACapability70,
+                            Target::CUDACapability75})) {
+        return s;
+    }
+    return LowerTensorCores().mutate(s);
+}
+
+}
+}
@@ -0,0 +1,29 @@
+#ifndef HALIDE_LOWER_TENSOR_CORES_H
+#define HALIDE_LOWER_TENSOR_CORES_H
+
+/** \file
+ * Defines the lowering pass that maps 16x16x16 matrix
+ * multiply-accumulates onto CUDA tensor cores.
+ */
+
+#include "IR.h"
+#include "Target.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Find perfect nests of three serial loops of extent 16 at the block
+ * level of a CUDA kernel that compute C += A * B, where A and B are
+ * float16 and C is float32, and replace each of them with a single
+ * warp-wide wmma.mma.sync on the tensor cores. Each operand must be
+ * loaded with unit stride along one of its two dimensions, its base
+ * must be provably 32-byte aligned, and its stride along the other
+ * dimension must be a multiple of 16 bytes.
+ * Nests that don't match, and all nests on targets without tensor
+ * cores (before sm_70, or LLVM older than 8), are left alone. */
+Stmt lower_tensor_cores(Stmt s, const Target &t);
+
+}
+}
+
+#endif
@@ -0,0 +1,517 @@
+#include "LowerWarpShuffles.h"
+#include "CodeGen_GPU_Dev.h"
+#include "ExprUsesVar.h"
+#include "IREquality.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Simplify.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace {
+
+// The warp size on all CUDA devices.
+const int warp_size = 32;
+
+// Find the extents of the loops over each GPU thread index.
+class FindThreadExtents : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const For *op) {
+        if (CodeGen_GPU_Dev::is_gpu_thread_var(op->name)) {
+            extents.push_back({op->name.substr(op->name.rfind('.')), op->extent});
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    // The dimension (e.g. ".__thread_id_x") and extent of each loop.
+    vector<pair<string, Expr>> extents;
+};
+
+class LoadsFromBuffer : public IRVisitor {
+    const string &buffer;
+
+    using IRVisitor::visit;
+
+    void visit(const Load *op) {
+        IRVisitor::visit(op);
+        result = result || op->name == buffer;
+    }
+
+public:
+    bool result = false;
+    LoadsFromBuffer(const string &buffer) : buffer(buffer) {}
+};
+
+// Get the value of e from the lane offset lanes above this one,
+// within each group of width lanes. From sm_70 on, the lanes of a
+// warp may not run in lockstep, so the synchronizing form of shfl
+// is used, with every lane of the warp taking part.
+Expr shuffle_down(Expr e, int offset, int width, bool sync) {
+    // The segment mask and clamp operand of shfl.down.
+    int c = ((warp_size - width) << 8) | 0x1f;
+    string suffix = e.type() == Float(32) ? ".f32" : ".i32";
+    vector<Expr> args = {e.type() == Float(32) ? e : cast(Int(32), e), offset, c};
+    string name = "llvm.nvvm.shfl.down";
+    if (sync) {
+        args.insert(args.begin(), (int)0xffffffff);
+        name = "llvm.nvvm.shfl.sync.down";
+    }
+    Expr result = Call::make(args[sync ? 1 : 0].type(), name + suffix, args, Call::Extern);
+    return cast(e.type(), result);
+}
+
+Expr combine(VectorReduce::Operator op, Expr a, Expr b) {
+    switch (op) {
+    case VectorReduce::Add:
+        return Add::make(a, b);
+    case VectorReduce::Mul:
+        return Mul::make(a, b);
+    case VectorReduce::Min:
+        return Min::make(a, b);
+    case VectorReduce::Max:
+        return Max::make(a, b);
+    case VectorReduce::And:
+        return And::make(a, b);
+    case VectorReduce::Or:
+        return Or::make(a, b);
+    }
+    return Expr();
+}
+
+Expr identity(VectorReduce::Operator op, Type t) {
+    switch (op) {
+    case VectorReduce::Add:
+        return make_zero(t);
+    case VectorReduce::Mul:
+        return make_one(t);
+    case VectorReduce::Min:
+        return t.max();
+    case VectorReduce::Max:
+        return t.min();
+    case VectorReduce::And:
+        return const_true();
+    case VectorReduce::Or:
+        return const_false();
+    }
+    return Expr();
+}
+
+// A loop over lanes of the form:
+//
+// let ...
+// if (cond) atomic { f[index] = f[index] op value }
+//
+// where index doesn't depend on the lane.
+struct LaneReduction {
+    vector<const LetStmt *> lets;
+    Expr cond;
+    const Atomic *atomic = nullptr;
+    const Store *store = nullptr;
+    VectorReduce::Operator op = VectorReduce::Add;
+    // The old value of the site, and the value combined with it.
+    Expr a, b;
+    // The value is subtracted.
+    bool is_sub = false;
+};
+
+// Match the body of a loop over lanes against the form above. The
+// lets in the body that depend on anything in varying are added to it.
+bool match_lane_reduction(const For *loop, Scope<int> &varying, LaneReduction *r) {
+    Stmt s = loop->body;
+    while (const LetStmt *let = s.as<LetStmt>()) {
+        r->lets.push_back(let);
+        if (expr_uses_vars(let->value, varying)) {
+            varying.push(let->name, 0);
+        }
+        s = let->body;
+    }
+
+    if (const IfThenElse *if_op = s.as<IfThenElse>()) {
+        if (if_op->else_case.defined()) {
+            return false;
+        }
+        r->cond = if_op->condition;
+        s = if_op->then_case;
+    }
+
+    r->atomic = s.as<Atomic>();
+    if (!r->atomic) {
+        return false;
+    }
+    s = r->atomic->body;
+    if (const IfThenElse *if_op = s.as<IfThenElse>()) {
+        if (r->cond.defined() || if_op->else_case.defined()) {
+            return false;
+        }
+        r->cond = if_op->condition;
+        s = if_op->then_case;
+    }
+
+    const Store *store = s.as<Store>();
+    r->store = store;
+    if (!store ||
+        expr_uses_vars(store->index, varying) ||
+        expr_uses_vars(store->predicate, varying) ||
+        store->value.type().is_vector()) {
+        return false;
+    }
+
+    Expr a, b;
+    if (const Add *add = store->value.as<Add>()) {
+        a = add->a;
+        b = add->b;
+    } else if (const Sub *sub = store->value.as<Sub>()) {
+        // f - g0 - g1 ... == f - (g0 + g1 + ...)
+        a = sub->a;
+        b = sub->b;
+        r->is_sub = true;
+    } else if (const Mul *mul = store->value.as<Mul>()) {
+        r->op = VectorReduce::Mul;
+        a = mul->a;
+        b = mul->b;
+    } else if (const Min *min = store->value.as<Min>()) {
+        r->op = VectorReduce::Min;
+        a = min->a;
+        b = min->b;
+    } else if (const Max *max = store->value.as<Max>()) {
+        r->op = VectorReduce::Max;
+        a = max->a;
+        b = max->b;
+    } else if (const And *and_op = store->value.as<And>()) {
+        r->op = VectorReduce::And;
+        a = and_op->a;
+        b = and_op->b;
+    } else if (const Or *or_op = store->value.as<Or>()) {
+        r->op = VectorReduce::Or;
+        a = or_op->a;
+        b = or_op->b;
+    } else {
+        return false;
+    }
+
+    // One side must be the old value of the site being updated.
+    auto is_old_value = [&](const Expr &e) {
+        const Load *load = e.as<Load>();
+        return load && load->name == store->name && equal(load->index, store->index);
+    };
+    if (!r->is_sub && !is_old_value(a) && is_old_value(b)) {
+        std::swap(a, b);
+    }
+    LoadsFromBuffer loads(store->name);
+    b.accept(&loads);
+    if (!is_old_value(a) || loads.result) {
+        return false;
+    }
+    r->a = a;
+    r->b = b;
+    return true;
+}
+
+// Rewrite the body of a loop over lanes that matches the form
+// above into a tree of shuffles that combines the values of all the
+// lanes, followed by a single update of f by the first lane. Returns
+// an undefined Stmt if the loop doesn't match.
+Stmt lower_lane_reduction(const For *loop, int lanes, bool sync) {
+    Scope<int> varying;
+    varying.push(loop->name, 0);
+    LaneReduction r;
+    if (!match_lane_reduction(loop, varying, &r)) {
+        return Stmt();
+    }
+    const vector<const LetStmt *> &lets = r.lets;
+    const Atomic *atomic = r.atomic;
+    const Store *store = r.store;
+    VectorReduce::Operator reduce_op = r.op;
+    Expr a = r.a, b = r.b, cond = r.cond;
+    bool is_sub = r.is_sub;
+
+    // shfl moves 32 bits at a time.
+    Type t = b.type();
+    if (t.bits() > 32 || (t.is_float() && t.bits() != 32) || t.is_handle()) {
+        return Stmt();
+    }
+
+    // A condition that varies across the lanes only masks off their
+    // contributions. The shuffles themselves must run on every lane.
+    Expr any;
+    if (cond.defined() && expr_uses_vars(cond, varying)) {
+        b = select(cond, b, identity(reduce_op, t));
+        any = cond;
+        cond = Expr();
+    }
+
+    vector<pair<string, Expr>> steps;
+    string name = unique_name('t');
+    steps.push_back({name, b});
+    Expr partial = Variable::make(t, name);
+    string any_name;
+    Expr any_partial;
+    if (any.defined()) {
+        any_name = unique_name('t');
+        steps.push_back({any_name, any});
+        any_partial = Variable::make(Bool(), any_name);
+    }
+    for (int offset = lanes / 2; offset > 0; offset /= 2) {
+        name = unique_name('t');
+        steps.push_back({name, combine(reduce_op, partial, shuffle_down(partial, offset, lanes, sync))});
+        partial = Variable::make(t, name);
+        if (any.defined()) {
+            any_name = unique_name('t');
+            steps.push_back({any_name, any_partial || shuffle_down(any_partial, offset, lanes, sync)});
+            any_partial = Variable::make(Bool(), any_name);
+        }
+    }
+
+    Expr value = is_sub ? Sub::make(a, partial) : combine(reduce_op, a, partial);
+    Stmt result = Atomic::make(atomic->producer_name,
+                               Store::make(store->name, value, store->index, store->param, store->predicate));
+    Expr first_lane = Variable::make(Int(32), loop->name) == loop->min;
+    if (any.defined()) {
+        first_lane = first_lane && any_partial;
+    }
+    result = IfThenElse::make(first_lane, result);
+    for (size_t i = steps.size(); i > 0; i--) {
+        result = LetStmt::make(steps[i - 1].first, steps[i - 1].second, result);
+    }
+    if (cond.defined()) {
+        result = IfThenElse::make(cond, result);
+    }
+    for (size_t i = lets.size(); i > 0; i--) {
+        result = LetStmt::make(lets[i - 1]->name, lets[i - 1]->value, result);
+    }
+
+    return For::make(loop->name, loop->min, loop->extent, loop->for_type, loop->device_api, result);
+}
+
+// The same for OpenCL, using the reductions of the cl_khr_subgroups
+// extension. The size of a subgroup isn't known at compile time, and
+// a subgroup may span several lanes loops, so every thread of the
+// workgroup must be updating the same site, and nonuniform says what
+// varies across the workgroup. Each subgroup combines its values and
+// its first thread updates the site. The original loop is kept for
+// devices without subgroups.
+Stmt lower_subgroup_reduction(const For *loop, Scope<int> &nonuniform) {
+    ScopedBinding<int> bind(nonuniform, loop->name, 0);
+    LaneReduction r;
+    bool matched = match_lane_reduction(loop, nonuniform, &r);
+    for (const LetStmt *let : r.lets) {
+        // Only the lets that were bound by the match.
+        if (nonuniform.contains(let->name)) {
+            nonuniform.pop(let->name);
+        }
+    }
+    if (!matched) {
+        return Stmt();
+    }
+
+    Type t = r.b.type();
+    string op_name;
+    if (t.is_bool()) {
+        if (r.op == VectorReduce::And) {
+            op_name = "sub_group_all";
+        } else if (r.op == VectorReduce::Or) {
+            op_name = "sub_group_any";
+        }
+    } else if ((t.is_int() || t.is_uint()) || t == Float(32)) {
+        if (r.op == VectorReduce::Add) {
+            op_name = "sub_group_reduce_add";
+        } else if (r.op == VectorReduce::Min) {
+            op_name = "sub_group_reduce_min";
+        } else if (r.op == VectorReduce::Max) {
+            op_name = "sub_group_reduce_max";
+        }
+    }
+    if (op_name.empty()) {
+        return Stmt();
+    }
+
+    // The subgroup functions take 32 or 64-bit values, and bools as
+    // ints.
+    Type arg_type = t;
+    if (t.is_bool()) {
+        arg_type = Int(32);
+    } else if (t.bits() < 32) {
+        arg_type = t.with_bits(32);
+    }
+    auto reduce = [&](const string &name, Expr e) {
+        Expr result = Call::make(arg_type, name, {cast(arg_type, e)}, Call::Extern);
+        return t.is_bool() ? (result != 0) : cast(t, result);
+    };
+
+    // A condition that varies across the workgroup only masks off the
+    // contributions of some threads. The subgroup functions must be
+    // reached by every thread.
+    Expr b = r.b, cond = r.cond, any;
+    if (cond.defined() && expr_uses_vars(cond, nonuniform)) {
+        b = select(cond, b, identity(r.op, t));
+        any = cond;
+        cond = Expr();
+    }
+
+    string value_name = unique_name('t'), partial_name = unique_name('t');
+    Expr partial = Variable::make(t, partial_name);
+    Expr value = r.is_sub ? Sub::make(r.a, partial) : combine(r.op, r.a, partial);
+    Stmt result = Atomic::make(r.atomic->producer_name,
+                               Store::make(r.store->name, value, r.store->index,
+                                           r.store->param, r.store->predicate));
+    Expr first_thread = Call::make(Int(32), "get_sub_group_local_id", {}, Call::Extern) == 0;
+    string any_name;
+    if (any.defined()) {
+        any_name = unique_name('t');
+        first_thread = first_thread && Variable::make(Bool(), any_name);
+    }
+    result = IfThenElse::make(first_thread, result);
+    if (any.defined()) {
+        result = LetStmt::make(any_name, reduce("sub_group_any", any), result);
+    }
+    result = LetStmt::make(partial_name, reduce(op_name, Variable::make(t, value_name)), result);
+    result = LetStmt::make(value_name, b, result);
+    if (cond.defined()) {
+        result = IfThenElse::make(cond, result);
+    }
+    for (size_t i = r.lets.size(); i > 0; i--) {
+        result = LetStmt::make(r.lets[i - 1]->name, r.lets[i - 1]->value, result);
+    }
+
+    Expr has_subgroups = Call::make(Int(32), "halide_cl_has_subgroups", {}, Call::Extern) != 0;
+    result = IfThenElse::make(has_subgroups, result, loop->body);
+    return For::make(loop->name, loop->min, loop->extent, loop->for_type, loop->device_api, result);
+}
+
+class LowerWarpShuffles : public IRMutator2 {
+    const Target &target;
+    bool in_kernel = false;
+    vector<pair<string, Expr>> thread_extents;
+
+    // The variables that vary across the threads of a GPU block, and
+    // the number of enclosing conditionals and loops that not every
+    // thread of the block might take.
+    Scope<int> nonuniform;
+    int divergent = 0;
+
+    using IRMutator2::visit;
+
+    Stmt visit(const LetStmt *op) override {
+        if (in_kernel && expr_uses_vars(op->value, nonuniform)) {
+            ScopedBinding<int> bind(nonuniform, op->name, 0);
+            return IRMutator2::visit(op);
+        }
+        return IRMutator2::visit(op);
+    }
+
+    Stmt visit(const IfThenElse *op) override {
+        ScopedValue<int> old_divergent(divergent);
+        if (in_kernel && expr_uses_vars(op->condition, nonuniform)) {
+            divergent++;
+        }
+        return IRMutator2::visit(op);
+    }
+
+    // Every thread of a block must take part in a subgroup
+    // reduction, so the threads must not be predicated off by a
+    // larger loop over the same thread index elsewhere in the kernel.
+    bool threads_are_uniform() {
+        for (size_t i = 0; i < thread_extents.size(); i++) {
+            for (size_t j = 0; j < i; j++) {
+                if (thread_extents[i].first == thread_extents[j].first &&
+                    !can_prove(thread_extents[i].second == thread_extents[j].second)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    Stmt visit(const For *op) override {
+        if (!in_kernel && CodeGen_GPU_Dev::is_gpu_block_var(op->name)) {
+            FindThreadExtents find;
+            op->body.accept(&find);
+            ScopedValue<bool> old_in_kernel(in_kernel, true);
+            ScopedValue<vector<pair<string, Expr>>> old_extents(thread_extents, find.extents);
+            return IRMutator2::visit(op);
+        }
+
+        if (op->for_type != ForType::GPULane) {
+            ScopedValue<int> old_divergent(divergent);
+            bool is_thread = in_kernel && CodeGen_GPU_Dev::is_gpu_thread_var(op->name);
+            if (in_kernel && !is_thread &&
+                (expr_uses_vars(op->min, nonuniform) || expr_uses_vars(op->extent, nonuniform))) {
+                divergent++;
+            }
+            if (is_thread) {
+                ScopedBinding<int> bind(nonuniform, op->name, 0);
+                return IRMutator2::visit(op);
+            }
+            return IRMutator2::visit(op);
+        }
+
+        Stmt stmt = IRMutator2::visit(op);
+        op = stmt.as<For>();
+        internal_assert(op);
+
+        if (op->device_api == DeviceAPI::OpenCL) {
+            if (divergent == 0 && threads_are_uniform()) {
+                Stmt lowered = lower_subgroup_reduction(op, nonuniform);
+                if (lowered.defined()) {
+                    debug(3) << "Lowered loop over " << op->name << " to subgroup reductions:\n" << lowered << "\n";
+                    return lowered;
+                }
+            }
+            debug(1) << "Not lowering loop over " << op->name << " to subgroup reductions\n";
+            return stmt;
+        }
+
+        const int64_t *extent = as_const_int(simplify(op->extent));
+        bool sync = target.features_any_of({Target::CUDACapability70,
+                                            Target::CUDACapability75});
+        bool legal = (op->device_api == DeviceAPI::CUDA &&
+                      (sync || target.features_any_of({Target::CUDACapability30,
+                                                       Target::CUDACapability32,
+                                                       Target::CUDACapability35,
+                                                       Target::CUDACapability50,
+                                                       Target::CUDACapability61})) &&
+                      extent && *extent > 1 && *extent <= warp_size &&
+                      (*extent & (*extent - 1)) == 0);
+        // The synchronizing shuffles name every lane of the warp, so
+        // the warps must be full.
+        legal = legal && (!sync || *extent == warp_size);
+        // Every lane of a group must be running for the shuffles to
+        // be well-defined, so thread_x must not be predicated off by
+        // a wider loop elsewhere in the kernel.
+        for (size_t i = 0; legal && i < thread_extents.size(); i++) {
+            if (thread_extents[i].first == ".__thread_id_x") {
+                legal = can_prove(thread_extents[i].second == op->extent);
+            }
+        }
+        if (!legal) {
+            debug(1) << "Not lowering loop over " << op->name << " to warp shuffles\n";
+            return stmt;
+        }
+
+        Stmt lowered = lower_lane_reduction(op, (int)(*extent), sync);
+        if (lowered.defined()) {
+            debug(3) << "Lowered loop over " << op->name << " to warp shuffles:\n" << lowered << "\n";
+            return lowered;
+        }
+        return stmt;
+    }
+
+public:
+    LowerWarpShuffles(const Target &t) : target(t) {}
+};
+
+}  // namespace
+
+Stmt lower_warp_shuffles(Stmt s, const Target &t) {
+    return LowerWarpShuffles(t).mutate(s);
+}
+
+}
+}
@@ -0,0 +1,32 @@
+#ifndef HALIDE_LOWER_WARP_SHUFFLES_H
+#define HALIDE_LOWER_WARP_SHUFFLES_H
+
+/** \file
+ * Defines the lowering pass that turns reductions across the lanes of
+ * a GPU warp into warp shuffles or subgroup reductions.
+ */
+
+#include "IR.h"
+#include "Target.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Rewrite atomic updates inside loops marked gpu_lanes that reduce
+ * across the loop into a single site, so that the lanes combine their
+ * values with a tree of shfl.down instructions, and only the first
+ * lane updates the site. Loops for which this isn't legal (the
+ * extent isn't a constant power of two no larger than the warp size,
+ * the other loops over thread_x in the kernel have a different
+ * extent, or the target doesn't have shuffles) are left alone, and
+ * run as ordinary loops over GPU threads. From sm_70 on, the
+ * synchronizing shfl.sync.down is used, and the loop must cover the
+ * whole warp. On OpenCL, sites updated by every thread of a workgroup
+ * are reduced with the cl_khr_subgroups reductions instead, with the
+ * original loop as a fallback for devices without them. */
+Stmt lower_warp_shuffles(Stmt s, const Target &t);
+
+}
+}
+
+#endif
@@ -2,12 +2,14 @@
 #include "Error.h"
 #include "IRMutator.h"
 #include "IROperator.h"
+#include "IRPrinter.h"
 #include "Param.h"
 #include "Scope.h"
 #include "Util.h"
 #include "Var.h"
 
 #include <map>
+#include <sstream>
 
 namespace Halide {
 namespace Internal {
@@ -148,6 +150,8 @@ class KeyInfo {
     Expr key_size_expr;
     const std::string &top_level_name;
     const std::string &function_name;
+    int eviction_priority;
+    uint64_t pipeline_hash;
 
     size_t parameters_alignment() {
         int32_t max_alignment = 0;
@@ -181,9 +185,17 @@ class KeyInfo {
 // It was deleted as part of the address_of intrinsic cleanup).
 
 public:
-  KeyInfo(const Function &function, const std::string &name)
-        : top_level_name(name), function_name(function.name())
+  KeyInfo(const Function &function, const std::string &name, const std::string &pipeline_text)
+        : top_level_name(name), function_name(function.name()),
+          eviction_priority(function.schedule().memoize_eviction_priority())
     {
+        // The in-memory key identifies the function with a pointer and
+        // a counter, which don't survive a restart. The on-disk tier
+        // of the cache identifies it with this hash instead. The names
+        // made by unique_name differ from one lowering to the next, so
+        // they're renumbered, along with the function's own name.
+        pipeline_hash = stable_hash(renumber_unique_names(pipeline_text + "\n" + top_level_name + ":" + function_name));
+
         dependencies.visit_function(function);
         size_t size_so_far = 0;
         size_so_far += Handle().bytes() + 4;
@@ -275,8 +287,9 @@ public:
             }
         }
         args.push_back(Call::make(type_of<halide_buffer_t **>(), Call::make_struct, buffers, Call::Intrinsic));
+        args.push_back(make_const(UInt(64), pipeline_hash));
 
-        return Call::make(Int(32), "halide_memoization_cache_lookup", args, Call::Extern);
+        return Call::make(Int(32), "halide_memoization_cache_lookup_with_hash", args, Call::Extern);
     }
 
     // Returns a statement which will store the result of a computation under this key
@@ -296,9 +309,11 @@ public:
             }
         }
         args.push_back(Call::make(type_of<halide_buffer_t **>(), Call::make_struct, buffers, Call::Intrinsic));
+        args.push_back(eviction_priority);
+        args.push_back(make_const(UInt(64), pipeline_hash));
 
         // This is actually a void call. How to indicate that? Look at Extern_ stuff.
-        return Evaluate::make(Call::make(Int(32), "halide_memoization_cache_store", args, Call::Extern));
+        return Evaluate::make(Call::make(Int(32), "halide_memoization_cache_store_with_priority", args, Call::Extern));
     }
 };
 
@@ -310,10 +325,11 @@ public:
     const std::map<std::string, Function> &env;
     const std::string &top_level_name;
     const std::vector<Function> &outputs;
+    const std::string &pipeline_text;
 
   InjectMemoization(const std::map<std::string, Function> &e, const std::string &name,
-                    const std::vector<Function> &outputs) :
-    env(e), top_level_name(name), outputs(outputs) {}
+                    const std::vector<Function> &outputs, const std::string &pipeline_text) :
+    env(e), top_level_name(name), outputs(outputs), pipeline_text(pipeline_text) {}
 private:
 
     using IRMutator2::visit;
@@ -345,7 +361,7 @@ private:
 
             Stmt mutated_body = mutate(op->body);
 
-            KeyInfo key_info(f, top_level_name);
+            KeyInfo key_info(f, top_level_name, pipeline_text);
 
             std::string cache_key_name = op->name + ".cache_key";
             std::string cache_result_name = op->name + ".cache_result";
@@ -380,10 +396,10 @@ private:
 
             Stmt generate_key = Block::make(key_info.generate_key(cache_key_name), computed_bounds_let);
             Stmt cache_key_alloc =
-                Allocate::make(cache_key_name, UInt(8), {key_info.key_size()},
+                Allocate::make(cache_key_name, UInt(8), MemoryType::Auto, {key_info.key_size()},
                                const_true(), generate_key);
 
-            return Realize::make(op->name, op->types, op->bounds, op->condition, cache_key_alloc);
+            return Realize::make(op->name, op->types, op->memory_type, op->bounds, op->condition, cache_key_alloc);
         } else {
             return IRMutator2::visit(op);
         }
@@ -407,7 +423,7 @@ private:
                 return ProducerConsumer::make(op->name, op->is_producer, mutated_body);
             } else {
                 const Function f(iter->second);
-                KeyInfo key_info(f, top_level_name);
+                KeyInfo key_info(f, top_level_name, pipeline_text);
 
                 std::string cache_key_name = op->name + ".cache_key";
                 std::string computed_bounds_name = op->name + ".computed_bounds.buffer";
@@ -427,7 +443,15 @@ private:
 Stmt inject_memoization(Stmt s, const std::map<std::string, Function> &env,
                         const std::string &name,
                         const std::vector<Function> &outputs) {
-    InjectMemoization injector(env, name, outputs);
+    // Results persisted to disk by the cache must not be reused if
+    // the pipeline changes, so hash the whole pipeline as it stands
+    // before any caching code is injected. The printed IR rounds float
+    // constants, so print those exactly too.
+    std::ostringstream pipeline_text;
+    pipeline_text << s << "\nfloats:";
+    print_float_imms_exactly(pipeline_text, s);
+    const std::string text = pipeline_text.str();
+    InjectMemoization injector(env, name, outputs, text);
 
     return injector.mutate(s);
 }
@@ -504,7 +528,7 @@ private:
                 const Allocate *allocation = allocations[i - 1];
 
                 // Make the allocation node
-                body = Allocate::make(allocation->name, allocation->type, allocation->extents, allocation->condition, body,
+                body = Allocate::make(allocation->name, allocation->type, allocation->memory_type, allocation->extents, allocation->condition, body,
                                       Call::make(Handle(), Call::buffer_get_host,
                                                  { Variable::make(type_of<struct halide_buffer_t *>(), allocation->name + ".buffer") }, Call::Extern),
                                       "halide_memoization_cache_release");
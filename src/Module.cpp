@@ -1,5 +1,6 @@
 #include "Module.h"
 
+#include <algorithm>
 #include <array>
 #include <fstream>
 #include <future>
@@ -13,6 +14,7 @@
 #include "LLVM_Runtime_Linker.h"
 #include "IROperator.h"
 #include "Outputs.h"
+#include "StmtCosts.h"
 #include "StmtToHtml.h"
 #include "WrapExternStages.h"
 #include "ThreadPool.h"
@@ -94,10 +96,13 @@ Outputs add_suffixes(const Outputs &in, const std::string &suffix) {
     return out;
 }
 
+// The features that fit in the mask passed to
+// halide_can_use_target_features. The rest can't be tested at runtime.
+const int num_runtime_mask_features = std::min((int)Target::FeatureEnd, 64);
+
 uint64_t target_feature_mask(const Target &target) {
-    static_assert(sizeof(uint64_t)*8 >= Target::FeatureEnd, "Features will not fit in uint64_t");
     uint64_t feature_mask = 0;
-    for (int i = 0; i < Target::FeatureEnd; ++i) {
+    for (int i = 0; i < num_runtime_mask_features; ++i) {
         if (target.has_feature((Target::Feature) i)) {
             feature_mask |= ((uint64_t) 1) << i;
         }
@@ -350,14 +355,16 @@ void Module::compile(const Outputs &output_files) const {
             // no real-world code ever sets both object_name and static_library_name
             // at the same time, so there is no meaningful performance advantage
             // to be had.
+            //
+            // Large modules are split and code-generated on several
+            // threads, which gives one object per partition.
             TemporaryObjectFileDir temp_dir;
-            {
-                std::string object_name = temp_dir.add_temp_object_file(output_files.static_library_name, "", target());
+            compile_llvm_module_to_objects(*llvm_module, default_codegen_partitions(), [&](int i) {
+                std::string object_name = temp_dir.add_temp_object_file(output_files.static_library_name,
+                                                                         i ? "_" + std::to_string(i) : "", target());
                 debug(1) << "Module.compile(): temporary object_name " << object_name << "\n";
-                auto out = make_raw_fd_ostream(object_name);
-                compile_llvm_module_to_object(*llvm_module, *out);
-                out->flush();  // create_static_library() is happier if we do this
-            }
+                return object_name;
+            });
             debug(1) << "Module.compile(): static_library_name " << output_files.static_library_name << "\n";
             Target base_target(target().os, target().arch, target().bits);
             create_static_library(temp_dir.files(), base_target, output_files.static_library_name);
@@ -400,7 +407,7 @@ void Module::compile(const Outputs &output_files) const {
     if (!output_files.stmt_name.empty()) {
         debug(1) << "Module.compile(): stmt_name " << output_files.stmt_name << "\n";
         std::ofstream file(output_files.stmt_name);
-        file << *this;
+        Internal::print_with_costs(file, *this);
     }
     if (!output_files.stmt_html_name.empty()) {
         debug(1) << "Module.compile(): stmt_html_name " << output_files.stmt_html_name << "\n";
@@ -479,8 +486,12 @@ void compile_multitarget(const std::string &fn_name,
 
     TemporaryObjectFileDir temp_dir;
     std::vector<Expr> wrapper_args;
-    std::vector<LoweredArgument> base_target_args;
-    for (const Target &target : targets) {
+    // Each sub-target is lowered and compiled in a job of its own;
+    // the jobs fill these in with the arguments of each sub-function.
+    std::vector<std::vector<LoweredArgument>> sub_fn_args(targets.size());
+    std::vector<std::future<void>> sub_fn_futures;
+    for (size_t i = 0; i < targets.size(); i++) {
+        const Target &target = targets[i];
         // arch-bits-os must be identical across all targets.
         if (target.os != base_target.os ||
             target.arch != base_target.arch ||
@@ -502,6 +513,13 @@ void compile_multitarget(const std::string &fn_name,
                 break;
             }
         }
+        // So must the features the runtime can't test for.
+        for (int f = num_runtime_mask_features; f < Target::FeatureEnd; ++f) {
+            if (target.has_feature((Target::Feature)f) != base_target.has_feature((Target::Feature)f)) {
+                user_error << "All Targets must have feature " << Internal::target_feature_name((Target::Feature)f)
+                           << " set identically for compile_multitarget.\n";
+            }
+        }
 
         // Each sub-target has a function name that is the 'real' name plus a suffix
         // (which defaults to the target string but can be customized via the suffixes map)
@@ -520,18 +538,16 @@ void compile_multitarget(const std::string &fn_name,
             sub_fn_target = sub_fn_target.without_feature(Target::Matlab);
         }
 
-        Module sub_module = module_producer(sub_fn_name, sub_fn_target);
-        // Re-assign every time -- should be the same across all targets anyway,
-        // but base_target is always the last one we encounter.
-        base_target_args = sub_module.get_function_by_name(sub_fn_name).args;
-
         Outputs sub_out = add_suffixes(output_files, suffix);
         internal_assert(sub_out.object_name.empty());
         sub_out.object_name = temp_dir.add_temp_object_file(output_files.static_library_name, suffix, target);
-        futures.emplace_back(pool.async([](Module m, Outputs o) {
-            debug(1) << "compile_multitarget: compile_sub_target " << o.object_name << "\n";
-            m.compile(o);
-        }, std::move(sub_module), std::move(sub_out)));
+        std::vector<LoweredArgument> *args = &sub_fn_args[i];
+        sub_fn_futures.emplace_back(pool.async([&module_producer, sub_fn_name, sub_fn_target, sub_out, args]() {
+            debug(1) << "compile_multitarget: compile_sub_target " << sub_out.object_name << "\n";
+            Module m = module_producer(sub_fn_name, sub_fn_target);
+            *args = m.get_function_by_name(sub_fn_name).args;
+            m.compile(sub_out);
+        }));
 
         const uint64_t cur_target_mask = target_feature_mask(target);
         Expr can_use = (target == base_target) ?
@@ -554,12 +570,15 @@ void compile_multitarget(const std::string &fn_name,
         // We never want NoRuntime set here.
         runtime_features_mask &= ~(((uint64_t)(1)) << Target::NoRuntime);
         if (runtime_features_mask) {
-            for (int i = 0; i < Target::FeatureEnd; ++i) {
+            for (int i = 0; i < num_runtime_mask_features; ++i) {
                 if (runtime_features_mask & (((uint64_t) 1) << i)) {
                     runtime_target.set_feature((Target::Feature) i);
                 }
             }
         }
+        for (int i = num_runtime_mask_features; i < Target::FeatureEnd; ++i) {
+            runtime_target.set_feature((Target::Feature) i, base_target.has_feature((Target::Feature) i));
+        }
         Outputs runtime_out = Outputs().object(
             temp_dir.add_temp_object_file(output_files.static_library_name, "_runtime", runtime_target));
         futures.emplace_back(pool.async([](Target t, Outputs o) {
@@ -568,6 +587,13 @@ void compile_multitarget(const std::string &fn_name,
         }, std::move(runtime_target), std::move(runtime_out)));
     }
 
+    // The arguments should be the same across all targets anyway, but
+    // use those of the base target.
+    for (auto &f : sub_fn_futures) {
+        f.get();
+    }
+    const std::vector<LoweredArgument> &base_target_args = sub_fn_args.back();
+
     if (needs_wrapper) {
         Expr indirect_result = Call::make(Int(32), Call::call_cached_indirect_function, wrapper_args, Call::Intrinsic);
         std::string private_result_name = unique_name(fn_name + "_result");
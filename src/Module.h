@@ -158,6 +158,11 @@ EXPORT Outputs compile_standalone_runtime(const Outputs &output_files, Target t)
 
 typedef std::function<Module(const std::string &, const Target &)> ModuleProducer;
 
+/** Compile a pipeline for several targets into one static library,
+ * with a wrapper that selects between them at runtime. The
+ * module_producer is called once per target, concurrently on
+ * multiple threads unless HL_DEBUG_CODEGEN is set, so it must be
+ * safe to call that way. */
 EXPORT void compile_multitarget(const std::string &fn_name,
                                 const Outputs &output_files,
                                 const std::vector<Target> &targets,
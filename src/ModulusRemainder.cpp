@@ -61,6 +61,8 @@ public:
     void visit(const Evaluate *);
     void visit(const Shuffle *);
     void visit(const Prefetch *);
+    void visit(const Atomic *);
+    void visit(const VectorReduce *);
 };
 
 ModulusRemainder modulus_remainder(Expr e) {
@@ -449,5 +451,15 @@ void ComputeModulusRemainder::visit(const Prefetch *) {
     internal_assert(false) << "modulus_remainder of statement\n";
 }
 
+void ComputeModulusRemainder::visit(const VectorReduce *op) {
+    internal_assert(op->type.is_scalar()) << "modulus_remainder of vector\n";
+    modulus = 1;
+    remainder = 0;
+}
+
+void ComputeModulusRemainder::visit(const Atomic *) {
+    internal_assert(false) << "modulus_remainder of statement\n";
+}
+
 }
 }
@@ -295,6 +295,21 @@ class MonotonicVisitor : public IRVisitor {
             return;
         }
 
+        if (op->is_intrinsic(Call::promise_clamped)) {
+            // Like a clamp, this is only monotonic in the value if the
+            // bounds are constant.
+            op->args[1].accept(this);
+            Monotonic min = result;
+            op->args[2].accept(this);
+            Monotonic max = result;
+            if (min == Monotonic::Constant && max == Monotonic::Constant) {
+                op->args[0].accept(this);
+            } else {
+                result = Monotonic::Unknown;
+            }
+            return;
+        }
+
         for (size_t i = 0; i < op->args.size(); i++) {
             op->args[i].accept(this);
             if (result != Monotonic::Constant) {
@@ -382,6 +397,28 @@ class MonotonicVisitor : public IRVisitor {
         internal_error << "Monotonic of statement\n";
     }
 
+    void visit(const VectorReduce *op) {
+        op->value.accept(this);
+        switch (op->op) {
+        case VectorReduce::Add:
+        case VectorReduce::Min:
+        case VectorReduce::Max:
+            // These reductions are monotonic in the arg
+            break;
+        case VectorReduce::Mul:
+        case VectorReduce::And:
+        case VectorReduce::Or:
+            // These ones are not
+            if (result != Monotonic::Constant) {
+                result = Monotonic::Unknown;
+            }
+        }
+    }
+
+    void visit(const Atomic *op) {
+        internal_error << "Monotonic of statement\n";
+    }
+
 public:
     Monotonic result;
 
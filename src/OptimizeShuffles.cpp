@@ -0,0 +1,339 @@
+#include <algorithm>
+
+#include "OptimizeShuffles.h"
+#include "Bounds.h"
+#include "CSE.h"
+#include "ExprUsesVar.h"
+#include "IREquality.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Scope.h"
+#include "Simplify.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::set;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Find an upper bound of bounds.max - bounds.min.
+Expr span_of_bounds(Interval bounds) {
+    internal_assert(bounds.is_bounded());
+
+    const Min *min_min = bounds.min.as<Min>();
+    const Max *min_max = bounds.min.as<Max>();
+    const Min *max_min = bounds.max.as<Min>();
+    const Max *max_max = bounds.max.as<Max>();
+    const Add *min_add = bounds.min.as<Add>();
+    const Add *max_add = bounds.max.as<Add>();
+    const Sub *min_sub = bounds.min.as<Sub>();
+    const Sub *max_sub = bounds.max.as<Sub>();
+
+    if (min_min && max_min && equal(min_min->b, max_min->b)) {
+        return span_of_bounds({min_min->a, max_min->a});
+    } else if (min_max && max_max && equal(min_max->b, max_max->b)) {
+        return span_of_bounds({min_max->a, max_max->a});
+    } else if (min_add && max_add && equal(min_add->b, max_add->b)) {
+        return span_of_bounds({min_add->a, max_add->a});
+    } else if (min_sub && max_sub && equal(min_sub->b, max_sub->b)) {
+        return span_of_bounds({min_sub->a, max_sub->a});
+    } else {
+        return bounds.max - bounds.min;
+    }
+}
+
+// Replace indirect loads with dynamic_shuffle intrinsics where
+// possible.
+class OptimizeShuffles : public IRMutator2 {
+    int lut_alignment;
+    int max_lut_size;
+    int max_element_bits;
+    Scope<Interval> bounds;
+    vector<std::pair<string, Expr>> lets;
+
+    using IRMutator2::visit;
+
+    template <typename NodeType, typename T>
+    NodeType visit_let(const T *op) {
+        // We only care about vector lets.
+        if (op->value.type().is_vector()) {
+            bounds.push(op->name, bounds_of_expr_in_scope(op->value, bounds));
+        }
+        NodeType node = IRMutator2::visit(op);
+        if (op->value.type().is_vector()) {
+            bounds.pop(op->name);
+        }
+        return node;
+    }
+
+    Expr visit(const Let *op) override {
+        lets.push_back({op->name, op->value});
+        Expr expr = visit_let<Expr>(op);
+        lets.pop_back();
+        return expr;
+    }
+    Stmt visit(const LetStmt *op) override { return visit_let<Stmt>(op); }
+
+    Stmt visit(const For *op) override {
+        if (op->device_api != DeviceAPI::None &&
+            op->device_api != DeviceAPI::Host &&
+            op->device_api != DeviceAPI::Hexagon) {
+            // GPU kernels have no dynamic_shuffle.
+            return op;
+        }
+        return IRMutator2::visit(op);
+    }
+
+    Expr visit(const Load *op) override {
+        if (!is_one(op->predicate)) {
+            // TODO(psuriana): We shouldn't mess with predicated load for now.
+            return IRMutator2::visit(op);
+        }
+        if (!op->type.is_vector() || op->index.as<Ramp>()) {
+            // Don't handle scalar or simple vector loads.
+            return IRMutator2::visit(op);
+        }
+        if (max_element_bits > 0 && op->type.bits() > max_element_bits) {
+            return IRMutator2::visit(op);
+        }
+
+        Expr index = mutate(op->index);
+        Interval unaligned_index_bounds = bounds_of_expr_in_scope(index, bounds);
+        if (unaligned_index_bounds.is_bounded()) {
+            // We want to try both the unaligned and aligned
+            // bounds. The unaligned bounds might fit in the LUT,
+            // while the aligned bounds do not.
+            vector<Interval> candidate_bounds;
+            if (lut_alignment > 0) {
+                int align = std::max(1, lut_alignment / op->type.bytes());
+                candidate_bounds.push_back({
+                    (unaligned_index_bounds.min / align) * align,
+                    ((unaligned_index_bounds.max + align) / align) * align - 1
+                });
+            }
+            candidate_bounds.push_back(unaligned_index_bounds);
+
+            for (Interval index_bounds : candidate_bounds) {
+                Expr index_span = span_of_bounds(index_bounds);
+                index_span = common_subexpression_elimination(index_span);
+                index_span = simplify(index_span);
+
+                const int64_t *const_span = as_const_int(index_span);
+                if (!const_span && lut_alignment == 0) {
+                    // We'd have to load past the lanes that are used.
+                    continue;
+                }
+
+                if (can_prove(index_span < max_lut_size)) {
+                    // This is a lookup within a small array. We can
+                    // use dynamic_shuffle for this.
+                    int const_extent = const_span ? *const_span + 1 : max_lut_size;
+                    Expr base = simplify(index_bounds.min);
+
+                    // Load all of the possible indices loaded from the
+                    // LUT. Note that for clamped ramps, this loads up to 1
+                    // vector past the max. CodeGen_Hexagon::allocation_padding
+                    // returns a native vector size to account for this. With
+                    // no alignment, only the lanes that may be used are
+                    // loaded.
+                    Expr lut = Load::make(op->type.with_lanes(const_extent), op->name,
+                                          Ramp::make(base, 1, const_extent),
+                                          op->image, op->param, const_true(const_extent));
+
+                    // We know the size of the LUT is not more than 256, so we
+                    // can safely cast the index to 8 bit, which
+                    // dynamic_shuffle requires.
+                    index = simplify(cast(UInt(8).with_lanes(op->type.lanes()), index - base));
+
+                    return Call::make(op->type, "dynamic_shuffle", {lut, index, 0, const_extent - 1}, Call::PureIntrinsic);
+                }
+            }
+        }
+        if (!index.same_as(op->index)) {
+            return Load::make(op->type, op->name, index, op->image, op->param, op->predicate);
+        } else {
+            return op;
+        }
+    }
+
+public:
+    OptimizeShuffles(int lut_alignment, int max_lut_size, int max_element_bits)
+        : lut_alignment(lut_alignment), max_lut_size(max_lut_size), max_element_bits(max_element_bits) {}
+};
+
+// Find the buffers stored to or allocated in a loop body.
+class FindWrittenBuffers : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const Store *op) override {
+        result.insert(op->name);
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Allocate *op) override {
+        result.insert(op->name);
+        IRVisitor::visit(op);
+    }
+
+public:
+    set<string> result;
+};
+
+class ContainsLoop : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const For *op) override {
+        result = true;
+    }
+
+public:
+    bool result = false;
+};
+
+// Load the tables of the dynamic_shuffles in an innermost loop once,
+// before the loop, when they don't change over the loop.
+class HoistTables : public IRMutator2 {
+    using IRMutator2::visit;
+
+    bool in_innermost_loop = false;
+    // The number of enclosing conditionals within the loop. A table
+    // only loaded under one might not be safe to load before the loop.
+    int conditional = 0;
+    Scope<int> varying;
+    set<string> written;
+    vector<std::pair<string, Expr>> tables;
+
+    template<typename LetOrLetStmt>
+    auto visit_let(const LetOrLetStmt *op) -> decltype(op->body) {
+        if (!in_innermost_loop) {
+            return IRMutator2::visit(op);
+        }
+        ScopedBinding<int> bind(varying, op->name, 0);
+        return IRMutator2::visit(op);
+    }
+
+    Expr visit(const Let *op) override {
+        return visit_let(op);
+    }
+
+    Stmt visit(const LetStmt *op) override {
+        return visit_let(op);
+    }
+
+    Stmt visit(const IfThenElse *op) override {
+        Expr condition = mutate(op->condition);
+        ScopedValue<int> c(conditional, conditional + 1);
+        Stmt then_case = mutate(op->then_case);
+        Stmt else_case = mutate(op->else_case);
+        if (condition.same_as(op->condition) &&
+            then_case.same_as(op->then_case) &&
+            else_case.same_as(op->else_case)) {
+            return op;
+        }
+        return IfThenElse::make(condition, then_case, else_case);
+    }
+
+    Expr visit(const Call *op) override {
+        if (op->is_intrinsic(Call::if_then_else)) {
+            vector<Expr> args(op->args.size());
+            args[0] = mutate(op->args[0]);
+            ScopedValue<int> c(conditional, conditional + 1);
+            for (size_t i = 1; i < op->args.size(); i++) {
+                args[i] = mutate(op->args[i]);
+            }
+            return Call::make(op->type, op->name, args, op->call_type,
+                              op->func, op->value_index, op->image, op->param);
+        }
+
+        const Load *table = op->args.empty() ? nullptr : op->args[0].as<Load>();
+        if (!in_innermost_loop ||
+            conditional > 0 ||
+            !op->is_intrinsic("dynamic_shuffle") ||
+            !table ||
+            written.count(table->name) ||
+            !is_one(table->predicate) ||
+            expr_uses_vars(table->index, varying)) {
+            return IRMutator2::visit(op);
+        }
+
+        string name;
+        for (const auto &t : tables) {
+            if (equal(t.second, op->args[0])) {
+                name = t.first;
+            }
+        }
+        if (name.empty()) {
+            name = unique_name('t');
+            tables.push_back({name, op->args[0]});
+        }
+        vector<Expr> args = op->args;
+        args[0] = Variable::make(table->type, name);
+        args[1] = mutate(args[1]);
+        return Call::make(op->type, op->name, args, op->call_type);
+    }
+
+    Stmt visit(const For *op) override {
+        ContainsLoop contains_loop;
+        op->body.accept(&contains_loop);
+        if (contains_loop.result ||
+            (op->device_api != DeviceAPI::None && op->device_api != DeviceAPI::Host)) {
+            return IRMutator2::visit(op);
+        }
+
+        FindWrittenBuffers find_written;
+        op->body.accept(&find_written);
+        written.swap(find_written.result);
+        tables.clear();
+        in_innermost_loop = true;
+        Stmt body;
+        {
+            ScopedBinding<int> bind(varying, op->name, 0);
+            body = mutate(op->body);
+        }
+        in_innermost_loop = false;
+
+        if (tables.empty()) {
+            return op;
+        }
+        Stmt stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+        for (const auto &t : tables) {
+            stmt = LetStmt::make(t.first, t.second, stmt);
+        }
+        // Don't load the tables if the loop doesn't run.
+        return IfThenElse::make(op->extent > 0, stmt);
+    }
+};
+
+}  // namespace
+
+Stmt optimize_shuffles(Stmt s, int lut_alignment, int max_lut_size, int max_element_bits) {
+    internal_assert(max_lut_size <= 256) << "The indices of dynamic_shuffle are 8-bit\n";
+    return OptimizeShuffles(lut_alignment, max_lut_size, max_element_bits).mutate(s);
+}
+
+Stmt optimize_shuffles(Stmt s, const Target &t) {
+    int max_lut_size = 0;
+    if (t.arch == Target::X86 && t.has_feature(Target::SSE41)) {
+        // pshufb looks up 16 bytes at a time, and we select between
+        // the lookups into each 16 bytes of the table.
+        max_lut_size = 64;
+    } else if (t.arch == Target::ARM) {
+        // tbl and tbx look up 64 bytes at a time on AArch64, and vtbl
+        // looks up 32 bytes on ARMv7.
+        max_lut_size = t.bits == 64 ? 256 : 32;
+    }
+    if (max_lut_size == 0 || t.features_any_of({Target::HVX_64, Target::HVX_128})) {
+        return s;
+    }
+    Stmt shuffled = optimize_shuffles(s, 0, max_lut_size, 8);
+    if (shuffled.same_as(s)) {
+        return s;
+    }
+    return HoistTables().mutate(shuffled);
+}
+
+}
+}
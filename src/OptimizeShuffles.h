@@ -0,0 +1,34 @@
+#ifndef HALIDE_OPTIMIZE_SHUFFLES_H
+#define HALIDE_OPTIMIZE_SHUFFLES_H
+
+/** \file
+ * Defines a lowering pass that replaces lookups into small tables
+ * with in-register shuffles.
+ */
+
+#include "IR.h"
+#include "Target.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Replace vector loads whose indices are provably within a small
+ * range with a dense load of that range, and a dynamic_shuffle of it
+ * with 8-bit indices. The table loaded is at most max_lut_size
+ * elements, which must be at most 256. If lut_alignment is non-zero,
+ * the table may be rounded out to a multiple of that many bytes, and
+ * loaded past the end of the lanes used, so the buffers must be
+ * padded to allow it. Loads of elements wider than max_element_bits
+ * are left alone, unless it's zero. */
+Stmt optimize_shuffles(Stmt s, int lut_alignment, int max_lut_size, int max_element_bits = 0);
+
+/** Replace lookups of 8-bit elements into small tables with the
+ * table lookup instructions of x86 (pshufb) and ARM (tbl), and load
+ * the tables once before the innermost loop they're used in, if they
+ * don't change over it. Does nothing on other targets. */
+Stmt optimize_shuffles(Stmt s, const Target &t);
+
+}
+}
+
+#endif
@@ -157,7 +157,11 @@ bool Parameter::is_bound_before_lowering() const {
 Expr Parameter::scalar_expr() const {
     check_is_scalar();
     const Type t = type();
-    if (t.is_float()) {
+    if (t.is_bfloat()) {
+        switch (t.bits()) {
+        case 16: return Expr(scalar<bfloat16_t>());
+        }
+    } else if (t.is_float()) {
         switch (t.bits()) {
         case 16: return Expr(scalar<float16_t>());
         case 32: return Expr(scalar<float>());
@@ -193,6 +197,11 @@ Buffer<> Parameter::buffer() const {
     return contents->buffer;
 }
 
+halide_buffer_t *Parameter::raw_buffer() const {
+    check_is_buffer();
+    return contents->buffer.defined() ? contents->buffer.raw_buffer() : nullptr;
+}
+
 void Parameter::set_buffer(Buffer<> b) {
     check_is_buffer();
     if (b.defined()) {
@@ -105,6 +105,11 @@ public:
      * bound buffer. Only relevant when jitting */
     EXPORT Buffer<> buffer() const;
 
+    /** If the parameter is a buffer parameter, get the halide_buffer_t
+     * of its currently bound buffer, or null if it's unbound, without
+     * taking a reference to it. Only relevant when jitting */
+    EXPORT halide_buffer_t *raw_buffer() const;
+
     /** If the parameter is a buffer parameter, set its current
      * value. Only relevant when jitting */
     EXPORT void set_buffer(Buffer<> b);
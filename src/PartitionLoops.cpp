@@ -429,6 +429,11 @@ class PartitionLoops : public IRMutator2 {
 
     bool in_gpu_loop = false;
 
+    // Make one copy of the loop body for the edges instead of a
+    // prologue and an epilogue, and don't partition the loops inside
+    // it, to keep the code small.
+    bool size_optimized;
+
     Stmt visit(const For *op) override {
         Stmt stmt;
         Stmt body = op->body;
@@ -585,10 +590,32 @@ class PartitionLoops : public IRMutator2 {
 
         bool make_prologue = !equal(prologue, simpler_body);
         bool make_epilogue = !equal(epilogue, simpler_body);
+        bool same_prologue_and_epilogue = make_prologue && make_epilogue && equal(prologue, epilogue);
 
         // Recurse on the middle section.
         simpler_body = mutate(simpler_body);
 
+        if (size_optimized) {
+            // The edges share one copy of the original body, which is
+            // correct anywhere in the loop.
+            prologue = epilogue = body;
+            same_prologue_and_epilogue = make_prologue && make_epilogue;
+        } else {
+            // Recurse on the prologue and epilogue too, so that the inner
+            // loops of the edge iterations (e.g. the tiles along the edge
+            // of the image when the inner loops are over the pixels of a
+            // tile) get their own steady state, free of the conditions
+            // that only apply to the other dimensions.
+            if (make_prologue) {
+                prologue = mutate(prologue);
+            }
+            if (same_prologue_and_epilogue) {
+                epilogue = prologue;
+            } else if (make_epilogue) {
+                epilogue = mutate(epilogue);
+            }
+        }
+
         // Construct variables for the bounds of the simplified middle section
         Expr min_steady = op->min, max_steady = op->extent + op->min;
         Expr prologue_val, epilogue_val;
@@ -626,8 +653,9 @@ class PartitionLoops : public IRMutator2 {
             internal_assert(!expr_uses_var(epilogue_val, op->name));
         }
 
-        // Bust serial for loops up into three.
-        if (op->for_type == ForType::Serial) {
+        // Bust serial for loops up into three, unless that would
+        // duplicate the edge code.
+        if (op->for_type == ForType::Serial && !size_optimized) {
             stmt = For::make(op->name, min_steady, max_steady - min_steady,
                              op->for_type, op->device_api, simpler_body);
 
@@ -643,11 +671,12 @@ class PartitionLoops : public IRMutator2 {
             }
         } else {
             // We don't have task parallelism. So for parallel for
-            // loops just put an if-then-else in the loop body. It
-            // should branch-predict to the steady state pretty well.
+            // loops, and to keep the code small, just put an
+            // if-then-else in the loop body. It should branch-predict
+            // to the steady state pretty well.
             Expr loop_var = Variable::make(Int(32), op->name);
             stmt = simpler_body;
-            if (make_epilogue && make_prologue && equal(prologue, epilogue)) {
+            if (same_prologue_and_epilogue) {
                 stmt = IfThenElse::make(min_steady <= loop_var && loop_var < max_steady, stmt, prologue);
             } else {
                 if (make_epilogue) {
@@ -691,6 +720,9 @@ class PartitionLoops : public IRMutator2 {
 
         return stmt;
     }
+
+public:
+    PartitionLoops(bool size_optimized) : size_optimized(size_optimized) {}
 };
 
 class ExprContainsLoad : public IRVisitor {
@@ -803,7 +835,7 @@ class RenormalizeGPULoops : public IRMutator2 {
                 return IRMutator2::visit(op);
             } else {
                 Stmt inner = LetStmt::make(op->name, op->value, a->body);
-                inner = Allocate::make(a->name, a->type, a->extents, a->condition, inner);
+                inner = Allocate::make(a->name, a->type, a->memory_type, a->extents, a->condition, inner);
                 return mutate(inner);
             }
         } else {
@@ -838,7 +870,7 @@ class RenormalizeGPULoops : public IRMutator2 {
             allocate_a->name == "__shared" &&
             allocate_b->name == "__shared") {
             Stmt inner = IfThenElse::make(op->condition, allocate_a->body, allocate_b->body);
-            inner = Allocate::make(allocate_a->name, allocate_a->type, allocate_a->extents, allocate_a->condition, inner);
+            inner = Allocate::make(allocate_a->name, allocate_a->type, allocate_a->memory_type, allocate_a->extents, allocate_a->condition, inner);
             return mutate(inner);
         } else if (let_a && let_b && let_a->name == let_b->name) {
             string condition_name = unique_name('t');
@@ -986,11 +1018,11 @@ bool has_likely_tag(Expr e) {
     return h.result;
 }
 
-Stmt partition_loops(Stmt s) {
+Stmt partition_loops(Stmt s, bool size_optimized) {
     s = LowerLikelyIfInnermost().mutate(s);
     s = MarkClampedRampsAsLikely().mutate(s);
     s = ExpandSelects().mutate(s);
-    s = PartitionLoops().mutate(s);
+    s = PartitionLoops(size_optimized).mutate(s);
     s = RenormalizeGPULoops().mutate(s);
     s = RemoveLikelyTags().mutate(s);
     s = CollapseSelects().mutate(s);
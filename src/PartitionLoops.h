@@ -17,8 +17,11 @@ bool has_likely_tag(Expr e);
 
 /** Partitions loop bodies into a prologue, a steady state, and an
  * epilogue. Finds the steady state by hunting for use of clamped
- * ramps, or the 'likely' intrinsic. */
-EXPORT Stmt partition_loops(Stmt s);
+ * ramps, or the 'likely' intrinsic. If size_optimized is set, the
+ * prologue and epilogue instead share one copy of the original loop
+ * body, chosen by an if-then-else in the loop, so each partitioned
+ * loop only duplicates its body once. */
+EXPORT Stmt partition_loops(Stmt s, bool size_optimized = false);
 
 }
 }
@@ -0,0 +1,100 @@
+#include "PersistentScratch.h"
+#include "CodeGen_Internal.h"
+#include "ExprUsesVar.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Scope.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::string;
+
+namespace {
+
+class UsePersistentScratch : public IRMutator2 {
+    const string &pipeline_name;
+    bool in_device_loop = false;
+
+    // The variables that change across the iterations of the
+    // enclosing loops.
+    Scope<int> varying;
+
+    using IRMutator2::visit;
+
+    Stmt visit(const For *op) override {
+        // Allocations inside loops are realized many times per call,
+        // and concurrently inside parallel loops. The arena keeps a
+        // block for each concurrent use, but only those whose size is
+        // the same on every iteration can reuse them without growing.
+        bool old_in_device_loop = in_device_loop;
+        if (op->device_api != DeviceAPI::None && op->device_api != DeviceAPI::Host) {
+            in_device_loop = true;
+        }
+        varying.push(op->name, 0);
+        Stmt s = IRMutator2::visit(op);
+        varying.pop(op->name);
+        in_device_loop = old_in_device_loop;
+        return s;
+    }
+
+    Stmt visit(const LetStmt *op) override {
+        if (!expr_uses_vars(op->value, varying)) {
+            return IRMutator2::visit(op);
+        }
+        varying.push(op->name, 0);
+        Stmt s = IRMutator2::visit(op);
+        varying.pop(op->name);
+        return s;
+    }
+
+    Stmt visit(const Allocate *op) override {
+        if (in_device_loop || op->new_expr.defined() || op->extents.empty() ||
+            (op->memory_type != MemoryType::Auto && op->memory_type != MemoryType::Heap)) {
+            return IRMutator2::visit(op);
+        }
+
+        int32_t constant_bytes = op->constant_allocation_size() * op->type.bytes();
+        if (constant_bytes > 0 && can_allocation_fit_on_stack(constant_bytes)) {
+            // Codegen may well put this on the stack, which is
+            // cheaper than any arena.
+            return IRMutator2::visit(op);
+        }
+
+        // Match the size codegen computes for halide_malloc, including
+        // the padding for reading one element past the end.
+        Expr size = make_const(UInt(64), op->type.bytes());
+        for (const Expr &e : op->extents) {
+            size *= cast<uint64_t>(e);
+        }
+        size += make_const(UInt(64), op->type.bytes());
+        if (!is_one(op->condition)) {
+            size = select(op->condition, size, make_zero(UInt(64)));
+        }
+        if (expr_uses_vars(size, varying)) {
+            return IRMutator2::visit(op);
+        }
+
+        // The key names the allocation within this pipeline. The
+        // runtime distinguishes compiled instances of the same
+        // pipeline by the address of the string, not its contents.
+        Expr key = StringImm::make(pipeline_name + "." + op->name);
+        Expr new_expr = Call::make(Handle(), "halide_scratch_malloc", {key, size}, Call::Extern);
+
+        Stmt body = mutate(op->body);
+        return Allocate::make(op->name, op->type, op->memory_type, op->extents, op->condition, body,
+                              new_expr, "halide_scratch_free");
+    }
+
+public:
+    UsePersistentScratch(const string &pipeline_name) : pipeline_name(pipeline_name) {}
+};
+
+}  // namespace
+
+Stmt use_persistent_scratch(Stmt s, const string &pipeline_name) {
+    return UsePersistentScratch(pipeline_name).mutate(s);
+}
+
+}
+}
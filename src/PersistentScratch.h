@@ -0,0 +1,33 @@
+#ifndef HALIDE_PERSISTENT_SCRATCH_H
+#define HALIDE_PERSISTENT_SCRATCH_H
+
+/** \file
+ * Defines the lowering pass that keeps the heap allocations of
+ * root-level intermediates alive across pipeline invocations.
+ */
+
+#include <string>
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Rewrite heap allocations that occur outside of any loop, or
+ * inside loops (e.g. the tasks of a parallel loop) with a size that
+ * is the same on every iteration, to be served from the runtime's
+ * scratch arena (see halide_scratch_malloc), keyed by the pipeline
+ * and allocation names. A steady stream of calls with the same sizes
+ * then reuses the same memory instead of going through halide_malloc
+ * and halide_free each time, and the tasks of a parallel loop reuse
+ * about one block per worker thread. Allocations that already have a
+ * custom allocator, those small enough to go on the stack, and those
+ * inside GPU or other device loops are left alone. Used when
+ * the target has the persistent_scratch feature. Should be run after
+ * early frees have been injected. */
+Stmt use_persistent_scratch(Stmt s, const std::string &pipeline_name);
+
+}
+}
+
+#endif
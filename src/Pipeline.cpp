@@ -1,10 +1,18 @@
 #include <algorithm>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <sstream>
 
 #include "Pipeline.h"
 #include "Argument.h"
 #include "FindCalls.h"
 #include "Func.h"
 #include "InferArguments.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "IRPrinter.h"
+#include "ImageParam.h"
 #include "IRVisitor.h"
 #include "LLVM_Headers.h"
 #include "LLVM_Output.h"
@@ -12,6 +20,8 @@
 #include "Outputs.h"
 #include "PrintLoopNest.h"
 #include "RealizationOrder.h"
+#include "Simplify.h"
+#include "ThreadPool.h"
 
 using namespace Halide::Internal;
 
@@ -41,6 +51,111 @@ Outputs static_library_outputs(const string &filename_prefix, const Target &targ
     return outputs;
 }
 
+// A fingerprint of the code for a lowered module, for finding code
+// jit-compiled for an earlier lowering of the same pipeline. Lowering
+// the same pipeline twice doesn't give the same names, because the
+// names made by unique_name come from global counters, so those
+// names (a letter followed by digits, or anything after a '$') are
+// numbered in order of first appearance instead. Two modules with the
+// same fingerprint then differ at most by a consistent renaming of
+// those names. The printed IR rounds float constants and leaves out
+// the types of the arguments, so those are printed exactly after it.
+// Returns an empty string for modules that embed data the printed IR
+// doesn't capture.
+string jit_module_fingerprint(const Module &m) {
+    if (!m.buffers().empty() || !m.external_code().empty()) {
+        return "";
+    }
+
+    std::ostringstream printed;
+    printed << m;
+    for (const LoweredFunc &f : m.functions()) {
+        printed << "\n" << f.name << " args:";
+        for (const Argument &arg : f.args) {
+            printed << " " << arg.name << ":" << (int)arg.kind << ":"
+                    << arg.type << ":" << (int)arg.dimensions;
+        }
+        printed << "\n" << f.name << " floats:";
+        print_float_imms_exactly(printed, f.body);
+    }
+    return renumber_unique_names(printed.str());
+}
+
+// Whether a specialization condition depends only on the values of
+// scalar Params, and so is decided by the time realize is called.
+class DependsOnlyOnScalarParams : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+
+    void visit(const Variable *op) override {
+        result = result && op->param.defined() && !op->param.is_buffer();
+    }
+
+    void visit(const Call *op) override {
+        result = result && op->is_pure();
+        IRGraphVisitor::visit(op);
+    }
+
+public:
+    bool result = true;
+};
+
+bool depends_only_on_scalar_params(const Expr &condition) {
+    DependsOnlyOnScalarParams checker;
+    condition.accept(&checker);
+    return checker.result;
+}
+
+// Replace scalar Params with their current values.
+class SubstituteScalarParams : public IRMutator2 {
+    using IRMutator2::visit;
+
+    Expr visit(const Variable *op) override {
+        if (op->param.defined() && !op->param.is_buffer()) {
+            return op->param.scalar_expr();
+        }
+        return op;
+    }
+};
+
+// Call 'fn' on the specializations of all the Funcs the outputs
+// depend on that depend only on scalar Params, in a fixed order.
+void for_each_lazy_specialization(const vector<Function> &outputs,
+                                  const std::function<void(const Specialization &)> &fn) {
+    std::map<string, Function> env;
+    for (Function f : outputs) {
+        populate_environment(f, env);
+    }
+    std::function<void(Definition &)> visit_definition = [&](Definition &def) {
+        for (Specialization &s : def.specializations()) {
+            if (depends_only_on_scalar_params(s.condition)) {
+                fn(s);
+            }
+            visit_definition(s.definition);
+        }
+    };
+    for (auto &iter : env) {
+        Function f = iter.second;
+        if (!f.has_pure_definition()) {
+            continue;
+        }
+        visit_definition(f.definition());
+        for (size_t i = 0; i < f.updates().size(); i++) {
+            visit_definition(f.update(i));
+        }
+    }
+}
+
+// Which way each of the conditions goes for the current values of
+// the Params: 1 or 0, or -1 if it doesn't simplify to a constant.
+vector<int> evaluate_lazy_conditions(const vector<Expr> &conditions) {
+    vector<int> outcomes;
+    for (const Expr &c : conditions) {
+        Expr value = simplify(SubstituteScalarParams().mutate(c));
+        outcomes.push_back(is_one(value) ? 1 : (is_zero(value) ? 0 : -1));
+    }
+    return outcomes;
+}
+
 }  // namespace
 
 struct PipelineContents {
@@ -56,12 +171,54 @@ struct PipelineContents {
     JITModule jit_module;
     Target jit_target;
 
+    /** Code jit-compiled for recent lowerings of this pipeline,
+     * keyed by jit_module_fingerprint of the lowered module, most
+     * recent last. Changing the schedule and changing it back (as
+     * schedule-tuning tools do) then only needs lowering to find the
+     * old code again, rather than all of llvm's compilation. This
+     * survives invalidate_cache, because the key captures everything
+     * that changed. */
+    vector<std::pair<string, JITModule>> jit_module_cache;
+
+    /** A shape realize has been called with, and the code compiled
+     * for it once it got hot. See Pipeline::specialize_hot_shapes. */
+    struct ShapeSpecialization {
+        // The extents of the ImageParams, then of the outputs.
+        vector<int> extents;
+        int calls = 0;
+        std::future<JITModule> pending;
+        JITModule jit_module;
+    };
+    int hot_shape_threshold = 0;
+    int max_shape_specializations = 0;
+    vector<ShapeSpecialization> shape_specializations;
+
+    /** Compiles the specialized code in the background. Made the
+     * first time a shape gets hot. */
+    std::unique_ptr<ThreadPool<JITModule>> shape_compiler;
+
+    /** The specialization conditions that only depend on scalar
+     * Params, when compiling specializations lazily, and which way
+     * each went for the code in jit_module. See
+     * Pipeline::compile_specializations_lazily. */
+    bool lazy_specializations = false;
+    vector<Expr> lazy_conditions;
+    vector<int> lazy_outcomes;
+
+    /** Code jit-compiled for other outcomes of the lazy conditions,
+     * most recent last. */
+    vector<std::pair<vector<int>, JITModule>> lazy_variants;
+
     /** Clear all cached state */
     void invalidate_cache() {
         module = Module("", Target());
         jit_module = JITModule();
         jit_target = Target();
         inferred_args.clear();
+        shape_specializations.clear();
+        lazy_conditions.clear();
+        lazy_outcomes.clear();
+        lazy_variants.clear();
     }
 
     // The outputs
@@ -151,10 +308,16 @@ vector<Func> Pipeline::outputs() const {
 }
 
 string Pipeline::auto_schedule(const Target &target, const MachineParams &arch_params) {
+    return auto_schedule(target, arch_params, {});
+}
+
+string Pipeline::auto_schedule(const Target &target, const MachineParams &arch_params,
+                               const vector<OutputShape> &shapes) {
     user_assert(target.arch == Target::X86 || target.arch == Target::ARM ||
-                target.arch == Target::POWERPC || target.arch == Target::MIPS)
+                target.arch == Target::POWERPC || target.arch == Target::MIPS ||
+                target.arch == Target::WebAssembly || target.arch == Target::RISCV)
         << "Automatic scheduling is currently supported only on these architectures.";
-    return generate_schedules(contents->outputs, target, arch_params);
+    return generate_schedules(contents->outputs, target, arch_params, shapes);
 }
 
 Func Pipeline::get_func(size_t index) {
@@ -262,7 +425,12 @@ void Pipeline::compile_to_static_library(const string &filename_prefix,
 void Pipeline::compile_to_multitarget_static_library(const std::string &filename_prefix,
                                                      const std::vector<Argument> &args,
                                                      const std::vector<Target> &targets) {
-    auto module_producer = [this, &args](const std::string &name, const Target &target) -> Module {
+    // compile_multitarget may call this from several threads, but
+    // lowering updates the pipeline's state, so that part can't run
+    // concurrently. Code generation still overlaps.
+    std::mutex mutex;
+    auto module_producer = [this, &args, &mutex](const std::string &name, const Target &target) -> Module {
+        std::lock_guard<std::mutex> lock(mutex);
         return compile_to_module(args, name, target);
     };
     Outputs outputs = static_library_outputs(filename_prefix, targets.back());
@@ -323,6 +491,14 @@ Module Pipeline::compile_to_module(const vector<Argument> &args,
                                    const string &fn_name,
                                    const Target &target,
                                    const Internal::LoweredFunc::LinkageType linkage_type) {
+    return compile_to_module(args, fn_name, target, linkage_type, std::map<Expr, Expr, IRDeepCompare>());
+}
+
+Module Pipeline::compile_to_module(const vector<Argument> &args,
+                                   const string &fn_name,
+                                   const Target &target,
+                                   const Internal::LoweredFunc::LinkageType linkage_type,
+                                   const std::map<Expr, Expr, IRDeepCompare> &known_conditions) {
     user_assert(defined()) << "Can't compile undefined Pipeline.\n";
 
     for (Function f : contents->outputs) {
@@ -373,6 +549,8 @@ Module Pipeline::compile_to_module(const vector<Argument> &args,
     // Linkage is the same.
     same_compile = same_compile && old_module.functions().front().linkage == linkage_type;
     // The outputs of a Pipeline cannot change, so no need to test them.
+    // Nor were any specialization conditions known.
+    same_compile = same_compile && known_conditions.empty();
 
     if (same_compile) {
         // We can avoid relowering and just reuse the existing module.
@@ -383,7 +561,8 @@ Module Pipeline::compile_to_module(const vector<Argument> &args,
             custom_passes.push_back(p.pass);
         }
 
-        contents->module = lower(contents->outputs, new_fn_name, target, lowering_args, linkage_type, custom_passes);
+        contents->module = lower(contents->outputs, new_fn_name, target, lowering_args, linkage_type,
+                                 custom_passes, known_conditions);
     }
 
     return contents->module;
@@ -410,15 +589,52 @@ void *Pipeline::compile_jit(const Target &target_arg) {
 
     debug(2) << "jit-compiling for: " << target_arg.to_string() << "\n";
 
-    // If we're re-jitting for the same target, we can just keep the
-    // old jit module.
+    // When compiling specializations lazily, the code is for the way
+    // the lazy conditions go for the current values of the Params.
+    vector<int> lazy_outcomes;
+    if (contents->lazy_specializations) {
+        if (!contents->jit_module.compiled()) {
+            contents->lazy_conditions.clear();
+            for_each_lazy_specialization(contents->outputs, [&](const Specialization &s) {
+                contents->lazy_conditions.push_back(s.condition);
+            });
+        }
+        lazy_outcomes = evaluate_lazy_conditions(contents->lazy_conditions);
+    }
+
     if (contents->jit_target == target &&
         contents->jit_module.compiled()) {
-        debug(2) << "Reusing old jit module compiled for :\n" << contents->jit_target.to_string() << "\n";
-        return contents->jit_module.main_function();
+        // If we're re-jitting for the same target, we can just keep the
+        // old jit module.
+        if (lazy_outcomes == contents->lazy_outcomes) {
+            debug(2) << "Reusing old jit module compiled for :\n" << contents->jit_target.to_string() << "\n";
+            return contents->jit_module.main_function();
+        }
+
+        // Otherwise the lazy conditions went another way. Keep the
+        // current code for when they go back, and look for code
+        // compiled for this way.
+        auto &variants = contents->lazy_variants;
+        variants.push_back({contents->lazy_outcomes, contents->jit_module});
+        for (size_t i = 0; i < variants.size(); i++) {
+            if (variants[i].first == lazy_outcomes) {
+                debug(2) << "Switching to the jit module compiled for other specializations\n";
+                contents->jit_module = variants[i].second;
+                contents->lazy_outcomes = lazy_outcomes;
+                variants.erase(variants.begin() + i);
+                return contents->jit_module.main_function();
+            }
+        }
+        const size_t max_lazy_variants = 8;
+        if (variants.size() > max_lazy_variants) {
+            variants.erase(variants.begin());
+        }
+    } else {
+        contents->lazy_variants.clear();
     }
 
     contents->jit_target = target;
+    contents->shape_specializations.clear();
 
     // Infer an arguments vector
     infer_arguments();
@@ -435,10 +651,50 @@ void *Pipeline::compile_jit(const Target &target_arg) {
     // Come up with a name for the generated function
     string name = generate_function_name();
 
+    // Tell lowering which way the lazy conditions go, so that it
+    // prunes the specializations that aren't taken, as it does those
+    // with constant conditions. The Funcs themselves are left alone.
+    std::map<Expr, Expr, IRDeepCompare> known_conditions;
+    internal_assert(lazy_outcomes.size() == contents->lazy_conditions.size() ||
+                    !contents->lazy_specializations);
+    for (size_t i = 0; i < lazy_outcomes.size(); i++) {
+        if (lazy_outcomes[i] >= 0) {
+            known_conditions[contents->lazy_conditions[i]] = make_bool(lazy_outcomes[i] == 1);
+        }
+    }
+    contents->lazy_outcomes = lazy_outcomes;
+
     // Compile to a module and also compile any submodules.
-    Module module = compile_to_module(args, name, target).resolve_submodules();
+    Module module = compile_to_module(args, name, target,
+                                      LoweredFunc::ExternalPlusMetadata,
+                                      known_conditions).resolve_submodules();
     auto f = module.get_function_by_name(name);
 
+    // If an earlier lowering gave the same code, reuse what it
+    // compiled to. Code that calls extern pipelines isn't cached,
+    // because those may have been rescheduled since.
+    string fingerprint;
+    bool calls_extern_pipelines = false;
+    for (const auto &e : contents->jit_externs) {
+        calls_extern_pipelines |= e.second.pipeline().defined();
+    }
+    if (!calls_extern_pipelines) {
+        fingerprint = jit_module_fingerprint(module);
+    }
+    if (!fingerprint.empty()) {
+        auto &cache = contents->jit_module_cache;
+        for (size_t i = 0; i < cache.size(); i++) {
+            if (cache[i].first == fingerprint) {
+                debug(2) << "Reusing jit module compiled for an identical lowering\n";
+                std::pair<string, JITModule> entry = cache[i];
+                cache.erase(cache.begin() + i);
+                cache.push_back(entry);
+                contents->jit_module = entry.second;
+                return entry.second.main_function();
+            }
+        }
+    }
+
     std::map<std::string, JITExtern> lowered_externs = contents->jit_externs;
 
     // Compile to jit module
@@ -458,6 +714,15 @@ void *Pipeline::compile_jit(const Target &target_arg) {
 
     contents->jit_module = jit_module;
 
+    if (!fingerprint.empty()) {
+        const size_t max_cached_jit_modules = 8;
+        auto &cache = contents->jit_module_cache;
+        if (cache.size() == max_cached_jit_modules) {
+            cache.erase(cache.begin());
+        }
+        cache.push_back({fingerprint, jit_module});
+    }
+
     return jit_module.main_function();
 }
 
@@ -497,6 +762,8 @@ void Pipeline::set_custom_print(void (*cust_print)(void *, const char *)) {
 void Pipeline::set_jit_externs(const std::map<std::string, JITExtern> &externs) {
     user_assert(defined()) << "Pipeline is undefined\n";
     contents->jit_externs = externs;
+    // The cached code is linked against the old externs.
+    contents->jit_module_cache.clear();
     invalidate_cache();
 }
 
@@ -625,6 +892,38 @@ struct ErrorBuffer {
     }
 };
 
+// Set up the user context for a call to jitted code with the given
+// handlers. Returns whether there's a custom error handler; if not,
+// errors go to the error buffer.
+bool init_jit_call_context(JITUserContext &jit_context, ErrorBuffer &error_buffer,
+                           const JITHandlers &handlers) {
+    void *user_context = nullptr;
+    JITHandlers local_handlers = handlers;
+    bool custom_error_handler = true;
+    if (local_handlers.custom_error == nullptr) {
+        custom_error_handler = false;
+        local_handlers.custom_error = ErrorBuffer::handler;
+        user_context = &error_buffer;
+    }
+    JITSharedRuntime::init_jit_user_context(jit_context, user_context, local_handlers);
+    return custom_error_handler;
+}
+
+// Report an error returned by jitted code, unless a custom error
+// handler has already handled it.
+void report_jit_call_error(int exit_status, ErrorBuffer &error_buffer, bool custom_error_handler) {
+    if (exit_status && !custom_error_handler) {
+        std::string output = error_buffer.str();
+        if (output.empty()) {
+            output = ("The pipeline returned exit status " +
+                      std::to_string(exit_status) +
+                      " but halide_error was never called.\n");
+        }
+        halide_runtime_error << output;
+        error_buffer.end = 0;
+    }
+}
+
 struct JITFuncCallContext {
     ErrorBuffer error_buffer;
     JITUserContext jit_context;
@@ -633,16 +932,7 @@ struct JITFuncCallContext {
 
     JITFuncCallContext(const JITHandlers &handlers, Parameter &user_context_param)
         : user_context_param(user_context_param) {
-        void *user_context = nullptr;
-        JITHandlers local_handlers = handlers;
-        if (local_handlers.custom_error == nullptr) {
-            custom_error_handler = false;
-            local_handlers.custom_error = ErrorBuffer::handler;
-            user_context = &error_buffer;
-        } else {
-            custom_error_handler = true;
-        }
-        JITSharedRuntime::init_jit_user_context(jit_context, user_context, local_handlers);
+        custom_error_handler = init_jit_call_context(jit_context, error_buffer, handlers);
         user_context_param.set_scalar(&jit_context);
 
         debug(2) << "custom_print: " << (void *)jit_context.handlers.custom_print << '\n'
@@ -656,16 +946,7 @@ struct JITFuncCallContext {
 
     void report_if_error(int exit_status) {
         // Only report the errors if no custom error handler was installed
-        if (exit_status && !custom_error_handler) {
-            std::string output = error_buffer.str();
-            if (output.empty()) {
-                output = ("The pipeline returned exit status " +
-                          std::to_string(exit_status) +
-                          " but halide_error was never called.\n");
-            }
-            halide_runtime_error << output;
-            error_buffer.end = 0;
-        }
+        report_jit_call_error(exit_status, error_buffer, custom_error_handler);
     }
 
     void finalize(int exit_status) {
@@ -676,6 +957,58 @@ struct JITFuncCallContext {
 
 }  // namespace
 
+struct JITCallableContents {
+    JITModule module;
+
+    ErrorBuffer error_buffer;
+    JITUserContext jit_context;
+    bool custom_error_handler;
+
+    // What the user context argument points to.
+    void *user_context;
+
+    // The arguments to the argv function. Scalar Params point to
+    // their own storage, so only the ImageParams and outputs need
+    // filling in for each call.
+    vector<const void *> args;
+    vector<std::pair<size_t, Parameter>> image_params;
+    size_t first_output;
+
+    // The type and dimensionality of each output buffer.
+    vector<std::pair<Type, int>> outputs;
+
+    // Fill in the output buffers of a call.
+    template<typename T>
+    void set_outputs(const T &dst, vector<const void *> &call_args) const {
+        user_assert(dst.size() == outputs.size())
+            << "Realization contains wrong number of Images (" << dst.size()
+            << ") for calling pipeline with " << outputs.size()
+            << " outputs\n";
+        for (size_t i = 0; i < dst.size(); i++) {
+            user_assert(dst[i].type() == outputs[i].first &&
+                        dst[i].dimensions() == outputs[i].second &&
+                        dst[i].data() != nullptr)
+                << "Output buffer " << i << " doesn't have the type and dimensionality of the pipeline's output, or is unallocated\n";
+            call_args[first_output + i] = dst[i].raw_buffer();
+        }
+    }
+};
+
+namespace {
+
+// The closure of the parallel loop over a batch.
+struct BatchClosure {
+    int (*argv_function)(const void **);
+    vector<vector<const void *>> *args;
+};
+
+int run_batch_element(void *user_context, int i, uint8_t *closure) {
+    BatchClosure *c = (BatchClosure *)closure;
+    return c->argv_function(&((*c->args)[i][0]));
+}
+
+}  // namespace
+
 // Make a vector of void *'s to pass to the jit call using the
 // currently bound value for all of the params and image
 // params.
@@ -810,6 +1143,155 @@ Pipeline::make_externs_jit_module(const Target &target,
     return result;
 }
 
+void Pipeline::compile_specializations_lazily(bool lazy) {
+    user_assert(defined()) << "Pipeline is undefined\n";
+    if (contents->lazy_specializations != lazy) {
+        contents->invalidate_cache();
+        contents->lazy_specializations = lazy;
+    }
+}
+
+void Pipeline::specialize_hot_shapes(int threshold, int max_specializations) {
+    user_assert(defined()) << "Pipeline is undefined\n";
+    user_assert(threshold >= 0 && max_specializations >= 0)
+        << "specialize_hot_shapes needs a threshold and a number of specializations that aren't negative\n";
+    contents->hot_shape_threshold = threshold;
+    contents->max_shape_specializations = max_specializations;
+    contents->shape_specializations.clear();
+}
+
+JITModule::argv_wrapper Pipeline::shape_specialized_function(Realization dst) {
+    // The shape of a call is the extents of the ImageParams, then of
+    // the outputs.
+    vector<int> extents;
+    for (const InferredArgument &arg : contents->inferred_args) {
+        if (arg.param.defined() && arg.param.is_buffer()) {
+            Buffer<> buf = arg.param.buffer();
+            if (!buf.defined()) {
+                return nullptr;
+            }
+            for (int i = 0; i < buf.dimensions(); i++) {
+                extents.push_back(buf.dim(i).extent());
+            }
+        }
+    }
+    for (size_t i = 0; i < dst.size(); i++) {
+        for (int d = 0; d < dst[i].dimensions(); d++) {
+            extents.push_back(dst[i].dim(d).extent());
+        }
+    }
+
+    // Only a few shapes are counted. A new one replaces the coldest
+    // that hasn't been compiled.
+    const size_t max_tracked_shapes = 16;
+    auto &shapes = contents->shape_specializations;
+    PipelineContents::ShapeSpecialization *shape = nullptr;
+    int compiled = 0;
+    for (auto &s : shapes) {
+        if (s.extents == extents) {
+            shape = &s;
+        }
+        if (s.pending.valid() || s.jit_module.compiled()) {
+            compiled++;
+        }
+    }
+    if (!shape) {
+        if (shapes.size() < max_tracked_shapes) {
+            shapes.emplace_back();
+            shape = &shapes.back();
+        } else {
+            for (auto &s : shapes) {
+                if (!s.pending.valid() && !s.jit_module.compiled() &&
+                    (!shape || s.calls < shape->calls)) {
+                    shape = &s;
+                }
+            }
+            if (!shape) {
+                return nullptr;
+            }
+        }
+        shape->extents = extents;
+        shape->calls = 0;
+    }
+
+    if (shape->jit_module.compiled()) {
+        return shape->jit_module.argv_function();
+    }
+    if (shape->pending.valid()) {
+        if (shape->pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return nullptr;
+        }
+        debug(2) << "Switching to code compiled for a hot shape\n";
+        shape->jit_module = shape->pending.get();
+        return shape->jit_module.argv_function();
+    }
+    if (++shape->calls < contents->hot_shape_threshold ||
+        compiled >= contents->max_shape_specializations) {
+        return nullptr;
+    }
+
+    // The shape is hot. Lower the pipeline again with its extents
+    // bound as constants, through the same constraints as set_extent,
+    // so that bounds inference and everything after it sees them. The
+    // lowering reads the Parameters, so it happens here; llvm's
+    // compilation, which is most of the time, happens in the
+    // background, and the generic code is used until it's done.
+    debug(2) << "Specializing the jit-compiled code for a hot shape\n";
+    vector<std::pair<Parameter, int>> bound;
+    size_t next = 0;
+    auto bind = [&](Parameter p, int dims, bool constrain) {
+        for (int i = 0; i < dims; i++, next++) {
+            // Leave alone extents that are already constrained.
+            if (constrain && !p.extent_constraint(i).defined()) {
+                p.set_extent_constraint(i, extents[next]);
+                bound.push_back({p, i});
+            }
+        }
+    };
+    for (const InferredArgument &arg : contents->inferred_args) {
+        if (arg.param.defined() && arg.param.is_buffer()) {
+            bind(arg.param, arg.param.dimensions(), true);
+        }
+    }
+    for (Function f : contents->outputs) {
+        // The buffers of a Tuple-valued output take the constraints
+        // of the first one.
+        for (size_t i = 0; i < f.output_buffers().size(); i++) {
+            bind(f.output_buffers()[i], f.dimensions(), i == 0);
+        }
+    }
+    internal_assert(next == extents.size());
+
+    vector<Argument> args;
+    for (const InferredArgument &arg : contents->inferred_args) {
+        args.push_back(arg.arg);
+    }
+    vector<IRMutator2 *> custom_passes;
+    for (CustomLoweringPass p : contents->custom_lowering_passes) {
+        custom_passes.push_back(p.pass);
+    }
+    string name = generate_function_name();
+    Module module = lower(contents->outputs, name, contents->jit_target, args,
+                          LoweredFunc::ExternalPlusMetadata, custom_passes).resolve_submodules();
+
+    for (const auto &b : bound) {
+        Parameter p = b.first;
+        p.set_extent_constraint(b.second, Expr());
+    }
+
+    LoweredFunc f = module.get_function_by_name(name);
+    std::map<std::string, JITExtern> lowered_externs = contents->jit_externs;
+    vector<JITModule> externs = make_externs_jit_module(contents->jit_target, lowered_externs);
+
+    if (!contents->shape_compiler) {
+        contents->shape_compiler.reset(new ThreadPool<JITModule>(1));
+    }
+    shape->pending = contents->shape_compiler->async([module, f, externs]() {
+        return JITModule(module, f, externs);
+    });
+    return nullptr;
+}
+
 void Pipeline::realize(Realization dst, const Target &t) {
     Target target = t;
     user_assert(defined()) << "Can't realize an undefined Pipeline\n";
@@ -896,12 +1378,19 @@ void Pipeline::realize(Realization dst, const Target &t) {
     // halide_runtime_error, which either calls abort() or throws an
     // exception.
 
+    JITModule::argv_wrapper main_function = contents->jit_module.argv_function();
+    if (contents->hot_shape_threshold > 0) {
+        if (JITModule::argv_wrapper specialized = shape_specialized_function(dst)) {
+            main_function = specialized;
+        }
+    }
+
     debug(2) << "Calling jitted function\n";
-    int exit_status = contents->jit_module.argv_function()(&(args[0]));
+    int exit_status = main_function(&(args[0]));
     debug(2) << "Back from jitted function. Exit status was " << exit_status << "\n";
 
     // If we're profiling, report runtimes and reset profiler stats.
-    if (target.has_feature(Target::Profile)) {
+    if (target.has_feature(Target::Profile) || target.has_feature(Target::ProfileTimeline)) {
         JITModule::Symbol report_sym =
             contents->jit_module.find_symbol_by_name("halide_profiler_report");
         JITModule::Symbol reset_sym =
@@ -911,6 +1400,18 @@ void Pipeline::realize(Realization dst, const Target &t) {
             void (*report_fn_ptr)(void *) = (void (*)(void *))(report_sym.address);
             report_fn_ptr(uc);
 
+            // The reset below discards the timeline, so write it out
+            // first. The file holds the most recent realization.
+            std::string timeline_file = get_env_variable("HL_PROFILER_TIMELINE_FILE");
+            JITModule::Symbol dump_timeline_sym =
+                contents->jit_module.find_symbol_by_name("halide_profiler_dump_timeline");
+            if (target.has_feature(Target::ProfileTimeline) &&
+                !timeline_file.empty() && dump_timeline_sym.address) {
+                int (*dump_timeline_fn_ptr)(void *, const char *) =
+                    (int (*)(void *, const char *))(dump_timeline_sym.address);
+                dump_timeline_fn_ptr(uc, timeline_file.c_str());
+            }
+
             void (*reset_fn_ptr)() = (void (*)())(reset_sym.address);
             reset_fn_ptr();
         }
@@ -919,6 +1420,158 @@ void Pipeline::realize(Realization dst, const Target &t) {
     jit_context.finalize(exit_status);
 }
 
+JITCallable Pipeline::compile_to_jit_callable(const Target &t) {
+    user_assert(defined()) << "Can't compile an undefined Pipeline\n";
+    user_assert(!contents->lazy_specializations)
+        << "Can't make a JITCallable of a Pipeline that compiles its specializations lazily, "
+        << "because the callable doesn't check which specializations its calls take\n";
+
+    Target target = t;
+    if (target.os == Target::OSUnknown) {
+        target = contents->jit_module.compiled() ? contents->jit_target : get_jit_target_from_environment();
+    }
+    compile_jit(target);
+
+    JITCallable callable;
+    callable.contents = std::make_shared<JITCallableContents>();
+    JITCallableContents &c = *callable.contents;
+    c.module = contents->jit_module;
+    c.custom_error_handler = init_jit_call_context(c.jit_context, c.error_buffer, jit_handlers());
+    c.user_context = &c.jit_context;
+
+    for (const InferredArgument &arg : contents->inferred_args) {
+        if (arg.arg.name == contents->user_context_arg.arg.name) {
+            c.args.push_back(&c.user_context);
+        } else if (arg.param.defined() && arg.param.is_buffer()) {
+            c.image_params.push_back({c.args.size(), arg.param});
+            c.args.push_back(nullptr);
+        } else if (arg.param.defined()) {
+            c.args.push_back(arg.param.scalar_address());
+        } else {
+            internal_assert(arg.buffer.defined());
+            c.args.push_back(arg.buffer.raw_buffer());
+        }
+    }
+
+    c.first_output = c.args.size();
+    for (Function f : contents->outputs) {
+        for (Type type : f.output_types()) {
+            c.outputs.push_back({type, f.dimensions()});
+            c.args.push_back(nullptr);
+        }
+    }
+
+    return callable;
+}
+
+void JITCallable::operator()(Realization dst) {
+    user_assert(defined()) << "Can't call an undefined JITCallable\n";
+    JITCallableContents &c = *contents;
+
+    for (const auto &p : c.image_params) {
+        halide_buffer_t *buf = p.second.raw_buffer();
+        user_assert(buf) << "ImageParam " << p.second.name()
+                         << " is unbound. JITCallable doesn't infer input bounds.\n";
+        c.args[p.first] = buf;
+    }
+
+    c.set_outputs(dst, c.args);
+
+    int exit_status = c.module.argv_function()(&(c.args[0]));
+    report_jit_call_error(exit_status, c.error_buffer, c.custom_error_handler);
+}
+
+void JITCallable::operator()(const vector<BatchElement> &batch) {
+    user_assert(defined()) << "Can't call an undefined JITCallable\n";
+    JITCallableContents &c = *contents;
+
+    // Check the whole batch and lay out the arguments of each call
+    // before running any of them.
+    vector<vector<const void *>> args(batch.size(), c.args);
+    for (size_t i = 0; i < batch.size(); i++) {
+        const BatchElement &e = batch[i];
+        size_t found = 0;
+        for (const auto &p : c.image_params) {
+            const halide_buffer_t *buf;
+            auto it = e.inputs.find(p.second.name());
+            if (it != e.inputs.end()) {
+                buf = it->second.raw_buffer();
+                user_assert(buf && it->second.type() == p.second.type() &&
+                            it->second.dimensions() == p.second.dimensions())
+                    << "Buffer for ImageParam " << p.second.name() << " in element " << i
+                    << " of the batch doesn't have the type and dimensionality of the ImageParam\n";
+                found++;
+            } else {
+                buf = p.second.raw_buffer();
+                user_assert(buf) << "ImageParam " << p.second.name()
+                                 << " is unbound. JITCallable doesn't infer input bounds.\n";
+            }
+            args[i][p.first] = buf;
+        }
+        if (found != e.inputs.size()) {
+            for (const auto &in : e.inputs) {
+                bool is_image_param = false;
+                for (const auto &p : c.image_params) {
+                    is_image_param = is_image_param || p.second.name() == in.first;
+                }
+                user_assert(is_image_param)
+                    << "Element " << i << " of the batch has a buffer for " << in.first
+                    << ", which isn't an ImageParam of the pipeline\n";
+            }
+        }
+        c.set_outputs(e.outputs, args[i]);
+    }
+
+    if (batch.empty()) {
+        return;
+    }
+
+    BatchClosure closure = {c.module.argv_function(), &args};
+    int exit_status = 0;
+    if (batch.size() == 1 || !c.jit_context.handlers.custom_do_par_for) {
+        for (size_t i = 0; i < batch.size() && exit_status == 0; i++) {
+            exit_status = run_batch_element(c.user_context, (int)i, (uint8_t *)&closure);
+        }
+    } else {
+        exit_status = c.jit_context.handlers.custom_do_par_for(c.user_context, run_batch_element,
+                                                               0, (int)batch.size(), (uint8_t *)&closure);
+    }
+    report_jit_call_error(exit_status, c.error_buffer, c.custom_error_handler);
+}
+
+void JITCallable::operator()(const std::map<string, Buffer<>> &stacked_inputs, Realization dst) {
+    user_assert(dst.size() > 0 && dst[0].dimensions() > 0)
+        << "The outputs of a stacked batch must have a batch dimension\n";
+    const int batch_dim = dst[0].dimensions() - 1;
+    const int batch_size = dst[0].dim(batch_dim).extent();
+
+    auto check_stacked = [&](const Buffer<> &b, const string &name) {
+        user_assert(b.defined() && b.dimensions() > 0 &&
+                    b.dim(b.dimensions() - 1).extent() == batch_size)
+            << "The batch dimension of " << name << " doesn't have the extent (" << batch_size
+            << ") of the batch dimension of the first output\n";
+    };
+
+    vector<BatchElement> batch(batch_size);
+    for (int i = 0; i < batch_size; i++) {
+        for (size_t j = 0; j < dst.size(); j++) {
+            if (i == 0) {
+                check_stacked(dst[j], "output " + std::to_string(j));
+            }
+            int d = dst[j].dimensions() - 1;
+            batch[i].outputs.push_back(dst[j].sliced(d, dst[j].dim(d).min() + i));
+        }
+        for (const auto &in : stacked_inputs) {
+            if (i == 0) {
+                check_stacked(in.second, in.first);
+            }
+            int d = in.second.dimensions() - 1;
+            batch[i].inputs[in.first] = in.second.sliced(d, in.second.dim(d).min() + i);
+        }
+    }
+    (*this)(batch);
+}
+
 void Pipeline::infer_input_bounds(Realization dst) {
 
     Target target = get_jit_target_from_environment();
@@ -1009,6 +1662,164 @@ void Pipeline::infer_input_bounds(Realization dst) {
     }
 }
 
+vector<std::pair<int, int>> Pipeline::realize_incremental(Realization dst,
+                                                          const ImageParam &input,
+                                                          const vector<std::pair<int, int>> &dirty,
+                                                          const Target &t) {
+    user_assert(defined()) << "Can't realize an undefined Pipeline\n";
+    user_assert(input.defined() && (int)dirty.size() == input.dimensions())
+        << "The dirty region passed to realize_incremental must have one (min, extent) "
+        << "pair for each dimension of the input.\n";
+
+    typedef vector<std::pair<int, int>> Box;
+
+    // All of the outputs are recomputed over the same region.
+    Box region;
+    for (int i = 0; i < dst[0].dimensions(); i++) {
+        region.push_back({dst[0].dim(i).min(), dst[0].dim(i).extent()});
+    }
+    for (size_t i = 1; i < dst.size(); i++) {
+        bool same_shape = dst[i].dimensions() == (int)region.size();
+        for (int j = 0; same_shape && j < dst[i].dimensions(); j++) {
+            same_shape = (dst[i].dim(j).min() == region[j].first &&
+                          dst[i].dim(j).extent() == region[j].second);
+        }
+        user_assert(same_shape)
+            << "realize_incremental requires all of the Buffers in the Realization to have the same shape.\n";
+    }
+
+    for (const auto &d : dirty) {
+        if (d.second <= 0) {
+            return Box();
+        }
+    }
+
+    Target target = t;
+    if (target.os == Target::OSUnknown) {
+        if (contents->jit_module.compiled()) {
+            target = contents->jit_target;
+        } else {
+            target = get_jit_target_from_environment();
+        }
+    }
+
+    auto crop = [&](const Box &box) {
+        vector<Buffer<>> crops;
+        for (size_t i = 0; i < dst.size(); i++) {
+            crops.push_back(dst[i].cropped(box));
+        }
+        return crops;
+    };
+
+    // Find the region of input required to compute a region of the
+    // outputs, with a bounds query.
+    auto footprint = [&](const Box &box) {
+        vector<Buffer<>> crops = crop(box);
+        Realization r(crops);
+        vector<const void *> args = prepare_jit_call_arguments(r, target);
+
+        size_t input_index = 0;
+        while (input_index < contents->inferred_args.size() &&
+               contents->inferred_args[input_index].param.name() != input.name()) {
+            input_index++;
+        }
+        user_assert(input_index < contents->inferred_args.size())
+            << "realize_incremental: " << input.name() << " is not an input of this Pipeline.\n";
+
+        // Give the query buffer the shape of the real input, so that
+        // boundary conditions that depend on it are the same. The
+        // bounds query only reads it, so there's nothing to iterate.
+        Buffer<> bound = input.get();
+        user_assert(bound.defined())
+            << "realize_incremental: " << input.name() << " must be bound to a Buffer.\n";
+        Runtime::Buffer<> query(input.type(), nullptr, bound.dimensions(), bound.raw_buffer()->dim);
+        args[input_index] = query.raw_buffer();
+
+        JITFuncCallContext jit_context(jit_handlers(), contents->user_context_arg.param);
+        int exit_status = contents->jit_module.argv_function()(&(args[0]));
+        jit_context.report_if_error(exit_status);
+        jit_context.finalize(0);
+
+        Box result;
+        for (int i = 0; i < query.dimensions(); i++) {
+            result.push_back({query.dim(i).min(), query.dim(i).extent()});
+        }
+        return result;
+    };
+
+    // Whether a footprint reaches (i.e. isn't entirely before) the
+    // dirty region in every dimension, and whether it starts before
+    // its end.
+    auto reaches_dirty = [&](const Box &f) {
+        for (size_t i = 0; i < f.size(); i++) {
+            if (f[i].first + f[i].second <= dirty[i].first) {
+                return false;
+            }
+        }
+        return true;
+    };
+    auto starts_before_end = [&](const Box &f) {
+        for (size_t i = 0; i < f.size(); i++) {
+            if (f[i].first >= dirty[i].first + dirty[i].second) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    Box whole = footprint(region);
+    if (!reaches_dirty(whole) || !starts_before_end(whole)) {
+        return Box();
+    }
+
+    Box affected = region;
+    for (size_t d = 0; d < region.size(); d++) {
+        // The footprint of one slice of the output.
+        auto slice_footprint = [&](int x) {
+            Box slice = region;
+            slice[d] = {x, 1};
+            return footprint(slice);
+        };
+
+        const int first = region[d].first;
+        const int last = region[d].first + region[d].second - 1;
+
+        // The first slice whose footprint reaches the dirty region.
+        int lo = first, hi = last + 1;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (reaches_dirty(slice_footprint(mid))) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        const int first_affected = lo;
+
+        // The last slice whose footprint starts before its end.
+        lo = first - 1;
+        hi = last;
+        while (lo < hi) {
+            int mid = lo + (hi - lo + 1) / 2;
+            if (starts_before_end(slice_footprint(mid))) {
+                lo = mid;
+            } else {
+                hi = mid - 1;
+            }
+        }
+        const int last_affected = lo;
+
+        if (first_affected > last_affected) {
+            return Box();
+        }
+        affected[d] = {first_affected, last_affected - first_affected + 1};
+    }
+
+    vector<Buffer<>> crops = crop(affected);
+    realize(Realization(crops), target);
+    return affected;
+}
+
 void Pipeline::infer_input_bounds(int x_size, int y_size, int z_size, int w_size) {
     user_assert(defined()) << "Can't infer input bounds on an undefined Pipeline.\n";
 
@@ -7,10 +7,13 @@
  * pipeline.
  */
 
+#include <map>
+#include <memory>
 #include <vector>
 
 #include "AutoSchedule.h"
 #include "ExternalCode.h"
+#include "IREquality.h"
 #include "IntrusivePtr.h"
 #include "JITModule.h"
 #include "Module.h"
@@ -21,6 +24,7 @@ namespace Halide {
 
 struct Argument;
 class Func;
+class ImageParam;
 struct Outputs;
 struct PipelineContents;
 
@@ -52,6 +56,8 @@ struct CustomLoweringPass {
 };
 
 struct JITExtern;
+class JITCallable;
+struct JITCallableContents;
 
 /** A class representing a Halide pipeline. Constructed from the Func
  * or Funcs that it outputs. */
@@ -60,6 +66,7 @@ class Pipeline {
 
     std::vector<Argument> infer_arguments(Internal::Stmt body);
     std::vector<const void *> prepare_jit_call_arguments(Realization dst, const Target &target);
+    Internal::JITModule::argv_wrapper shape_specialized_function(Realization dst);
 
     static std::vector<Internal::JITModule> make_externs_jit_module(const Target &target,
                                                                     std::map<std::string, JITExtern> &externs_in_out);
@@ -85,6 +92,17 @@ public:
                                      const MachineParams &arch_params = MachineParams::generic());
     //@}
 
+    /** Generate a schedule for the pipeline that is fast for several
+     * classes of runtime shapes of its outputs. The estimates of the
+     * outputs are one class, and each of 'shapes' is another. The
+     * Funcs are grouped for the estimates of the outputs, and the
+     * group outputs are specialize()d on the number of points of the
+     * first output, to be tiled with the best tile sizes for the
+     * closest class. */
+    EXPORT std::string auto_schedule(const Target &target,
+                                     const MachineParams &arch_params,
+                                     const std::vector<OutputShape> &shapes);
+
     /** Return handle to the index-th Func within the pipeline based on the
      * realization order. */
     EXPORT Func get_func(size_t index);
@@ -376,6 +394,56 @@ public:
      * back from the GPU. */
     EXPORT void realize(Realization dst, const Target &target = Target());
 
+    /** Recompute only the part of a previous realization in dst that
+     * depends on a region of an input image that has changed since,
+     * such as a brush stroke in an image editor. dirty is the changed
+     * region of input, as a (min, extent) pair for each dimension.
+     * The outputs that depend on it are found by running bounds
+     * inference in reverse: in each dimension, a binary search finds
+     * the range of outputs whose footprint in input overlaps the
+     * dirty region. Only that part of dst is realized again. This
+     * assumes the footprint of an output moves monotonically with it
+     * in each dimension, as it does for stencils, resampling, and
+     * reductions over fixed domains. Intermediates that don't depend
+     * on input can be memoized to skip them too. Returns the region
+     * of dst that was recomputed, which is empty if none of it
+     * depends on the dirty region. */
+    EXPORT std::vector<std::pair<int, int>> realize_incremental(Realization dst,
+                                                                const ImageParam &input,
+                                                                const std::vector<std::pair<int, int>> &dirty,
+                                                                const Target &target = Target());
+
+    /** JIT-compile this Pipeline and work out how to call it once, for
+     * pipelines realized many times into small outputs, where the
+     * cost of realize's checks and setup matters. See JITCallable. */
+    EXPORT JITCallable compile_to_jit_callable(const Target &target = Target());
+
+    /** Only jit-compile the specializations that realize calls take.
+     * Specializations whose conditions depend on nothing but scalar
+     * Params are decided when realize is called, and the pipeline is
+     * compiled with just the branches they take, so a pipeline with
+     * many variants of which a process uses a few doesn't compile all
+     * of them. Calls that take the same branches as an earlier call
+     * reuse its code, for the most recent few ways they went; a new
+     * way compiles the pipeline again before the call runs. Other
+     * specializations are compiled as usual. A pipeline that compiles
+     * its specializations lazily can't be made into a JITCallable. */
+    EXPORT void compile_specializations_lazily(bool lazy = true);
+
+    /** Specialize the jit-compiled code for the shapes that realize
+     * sees most often. Code compiled for symbolic extents can't do
+     * what constant sizes allow, such as allocating intermediates on
+     * the stack, or vectorizing without a tail. Once realize has been
+     * called threshold times with the same extents of the outputs and
+     * of the ImageParams, the pipeline is compiled again in the
+     * background with those extents bound as constants, as if by
+     * set_extent, and calls of that shape use it once it's ready. At
+     * most max_specializations shapes are compiled; other shapes keep
+     * using the generic code. Mins and strides stay symbolic. A
+     * threshold of zero turns this off. Rescheduling, or realizing
+     * for another target, discards the specialized code. */
+    EXPORT void specialize_hot_shapes(int threshold = 8, int max_specializations = 4);
+
     /** For a given size of output, or a given set of output buffers,
      * determine the bounds required of all unbound ImageParams
      * referenced. Communicates the result by allocating new buffers
@@ -406,6 +474,84 @@ public:
 
 private:
     std::string generate_function_name() const;
+
+    /** Compile to a Module, lowering specialization conditions equal
+     * to a key of known_conditions as if they were its value. */
+    Module compile_to_module(const std::vector<Argument> &args,
+                             const std::string &fn_name,
+                             const Target &target,
+                             const Internal::LoweredFunc::LinkageType linkage_type,
+                             const std::map<Expr, Expr, Internal::IRDeepCompare> &known_conditions);
+};
+
+/** A jit-compiled Pipeline, ready to be called many times. The
+ * arguments are laid out once, when it is made, so a call only fills
+ * in the buffers of the ImageParams and the outputs and then runs the
+ * compiled code. Params are read at the time of the call, as with
+ * realize. Every call uses the custom handlers (error handler, custom
+ * allocator, etc.) that the Pipeline had when the JITCallable was
+ * made, and the JITCallable keeps working if the Pipeline is
+ * recompiled later. Unlike realize, it doesn't infer the bounds of
+ * unbound ImageParams, or print profiling reports. Calls to the same
+ * JITCallable must not run concurrently.
+ *
+ * Example usage:
+ \code
+ ImageParam in(UInt(8), 2);
+ Func f;
+ f(x, y) = in(x, y) * 2;
+ JITCallable c = Pipeline(f).compile_to_jit_callable();
+ Buffer<uint8_t> out(16, 16);
+ for (Buffer<uint8_t> &tile : tiles) {
+     in.set(tile);
+     c(out);
+     ...
+ }
+ \endcode
+ */
+class JITCallable {
+    std::shared_ptr<JITCallableContents> contents;
+
+    friend class Pipeline;
+
+public:
+    JITCallable() {}
+
+    /** Run the pipeline into an existing allocated buffer or buffers,
+     * as Pipeline::realize(Realization) does. */
+    EXPORT void operator()(Realization dst);
+
+    /** One call in a batch: the buffers of the ImageParams that vary
+     * across the batch, keyed by the name of the ImageParam, and the
+     * buffers to realize into. ImageParams not listed use the buffer
+     * they are bound to, which is shared by the whole batch. */
+    struct BatchElement {
+        std::map<std::string, Buffer<>> inputs;
+        std::vector<Buffer<>> outputs;
+    };
+
+    /** Run the pipeline once for each element of a batch, in a single
+     * call that checks the whole batch up front and then runs the
+     * elements as the tasks of one parallel loop on Halide's thread
+     * pool. This is for many small inputs (thumbnails, crops) that
+     * are each too small for the pipeline's own parallel loops to
+     * keep the machine busy; the elements' own parallel loops still
+     * run, nested within the batch. The elements must not share
+     * output buffers. */
+    EXPORT void operator()(const std::vector<BatchElement> &batch);
+
+    /** Run the pipeline over a batch stacked along an extra
+     * outermost dimension. Each buffer in stacked_inputs, keyed by
+     * the name of an ImageParam, and each buffer in dst, has one
+     * more dimension than the ImageParam or output, and element i of
+     * the batch is the slice at position i (relative to the min) of
+     * that last dimension. It must have the same extent in all of
+     * them. */
+    EXPORT void operator()(const std::map<std::string, Buffer<>> &stacked_inputs, Realization dst);
+
+    bool defined() const {
+        return contents != nullptr;
+    }
 };
 
 struct ExternSignature {
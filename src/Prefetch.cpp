@@ -5,9 +5,12 @@
 #include "Prefetch.h"
 #include "Bounds.h"
 #include "ExprUsesVar.h"
+#include "IREquality.h"
 #include "IRMutator.h"
+#include "IROperator.h"
 #include "Scope.h"
 #include "Simplify.h"
+#include "Substitute.h"
 #include "Util.h"
 
 namespace Halide {
@@ -411,6 +414,179 @@ public:
     SplitPrefetch(Expr bytes) : max_byte_size(bytes) {}
 };
 
+// Does an expression read memory, or call anything impure? If so, its
+// value at a future iteration can't be computed ahead of time.
+class ReadsMemory : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const Load *op) override {
+        result = true;
+    }
+
+    void visit(const Call *op) override {
+        if (!op->is_pure()) {
+            result = true;
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    bool result = false;
+};
+
+// Find the loads in the body of an inner loop that stride through
+// memory too far for the hardware prefetcher to follow, and the
+// address each will load a fixed number of iterations ahead.
+class FindStridedLoads : public IRVisitor {
+    using IRVisitor::visit;
+
+    const string &loop_var;
+    const Expr &ahead;
+
+    // The values of the lets in the loop body, in terms of variables
+    // defined outside of it and the loop variable.
+    map<string, Expr> lets;
+    // The mins of the loops within the loop body. Those are all
+    // vectorized or unrolled, so take the address of their first
+    // iteration.
+    map<string, Expr> inner_mins;
+    set<string> allocations;
+
+    template<typename LetOrLetStmt>
+    void visit_let(const LetOrLetStmt *op) {
+        op->value.accept(this);
+        lets[op->name] = substitute(lets, op->value);
+        op->body.accept(this);
+    }
+
+    void visit(const Let *op) override {
+        visit_let(op);
+    }
+
+    void visit(const LetStmt *op) override {
+        visit_let(op);
+    }
+
+    void visit(const For *op) override {
+        inner_mins[op->name] = substitute(lets, op->min);
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Allocate *op) override {
+        allocations.insert(op->name);
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Load *op) override {
+        IRVisitor::visit(op);
+        if (!op->type.is_scalar() || allocations.count(op->name)) {
+            return;
+        }
+        Expr index = substitute(inner_mins, substitute(lets, op->index));
+        ReadsMemory reads_memory;
+        index.accept(&reads_memory);
+        if (reads_memory.result || !expr_uses_var(index, loop_var)) {
+            return;
+        }
+
+        Expr loop_var_expr = Variable::make(Int(32), loop_var);
+        Expr stride = simplify(substitute(loop_var, loop_var_expr + 1, index) - index);
+        if (expr_uses_var(stride, loop_var)) {
+            return;
+        }
+        // Hardware prefetchers follow small constant strides well.
+        // Strides that aren't constant are the strides of the outer
+        // dimensions of buffers, e.g. when walking down a column.
+        const int64_t *const_stride = as_const_int(stride);
+        const int64_t min_stride_bytes = 2048;
+        if (const_stride && std::abs(*const_stride) * op->type.bytes() < min_stride_bytes) {
+            return;
+        }
+
+        Expr address = simplify(substitute(loop_var, loop_var_expr + ahead, index));
+        for (const auto &l : loads) {
+            if (l.first == op->name && equal(l.second.second, address)) {
+                return;
+            }
+        }
+        loads.push_back({op->name, {op->type, address}});
+    }
+
+public:
+    vector<std::pair<string, std::pair<Type, Expr>>> loads;
+
+    FindStridedLoads(const string &v, const Expr &ahead) : loop_var(v), ahead(ahead) {}
+};
+
+// Does a statement contain a loop that isn't vectorized or unrolled?
+class HasSerialLoops : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const For *op) override {
+        if (op->for_type != ForType::Vectorized && op->for_type != ForType::Unrolled) {
+            result = true;
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    bool result = false;
+};
+
+class InjectAutoPrefetch : public IRMutator2 {
+    using IRMutator2::visit;
+
+    // How many iterations ahead to prefetch.
+    const int distance = 8;
+    // The most loads to prefetch in one loop.
+    const size_t max_streams = 8;
+
+    Stmt visit(const For *op) override {
+        if (op->device_api != DeviceAPI::None && op->device_api != DeviceAPI::Host) {
+            return op;
+        } else if (op->for_type != ForType::Serial) {
+            return IRMutator2::visit(op);
+        }
+
+        HasSerialLoops has_serial_loops;
+        op->body.accept(&has_serial_loops);
+        if (has_serial_loops.result) {
+            return IRMutator2::visit(op);
+        }
+
+        // Prefetching further ahead than a short loop runs is
+        // wasted, so prefetch half way through those.
+        Expr ahead = distance;
+        const int64_t *trip_count = as_const_int(op->extent);
+        if (trip_count) {
+            if (*trip_count < 4) {
+                return op;
+            }
+            ahead = (int)std::min<int64_t>(distance, *trip_count / 2);
+        }
+
+        FindStridedLoads finder(op->name, ahead);
+        op->body.accept(&finder);
+        if (finder.loads.empty()) {
+            return op;
+        }
+
+        vector<Stmt> prefetches;
+        for (const auto &l : finder.loads) {
+            if (prefetches.size() == max_streams) {
+                break;
+            }
+            debug(3) << "Prefetching " << l.first << "[" << l.second.second << "]"
+                     << " in loop over " << op->name << "\n";
+            Expr base = Variable::make(Handle(), l.first);
+            Expr prefetch = Call::make(l.second.first, Call::prefetch, {base, l.second.second, 1, 1}, Call::Intrinsic);
+            prefetches.push_back(Evaluate::make(prefetch));
+        }
+        prefetches.push_back(op->body);
+        return For::make(op->name, op->min, op->extent, op->for_type, op->device_api, Block::make(prefetches));
+    }
+};
+
 } // anonymous namespace
 
 Stmt inject_prefetch(Stmt s, const map<string, Function> &env) {
@@ -419,6 +595,17 @@ Stmt inject_prefetch(Stmt s, const map<string, Function> &env) {
     return InjectPrefetch(env, finder.buffers).mutate(s);
 }
 
+Stmt inject_auto_prefetch(Stmt s, const Target &t) {
+    // Hexagon's prefetches fetch whole regions into L2, and are
+    // placed by the schedule.
+    if (!t.has_feature(Target::AutoPrefetch) ||
+        t.features_any_of({Target::HVX_64, Target::HVX_128}) ||
+        (t.arch != Target::X86 && t.arch != Target::ARM)) {
+        return s;
+    }
+    return InjectAutoPrefetch().mutate(s);
+}
+
 Stmt reduce_prefetch_dimension(Stmt stmt, const Target &t) {
     size_t max_dim = 0;
     Expr max_byte_size;
@@ -16,6 +16,14 @@ namespace Internal {
 
 Stmt inject_prefetch(Stmt s, const std::map<std::string, Function> &env);
 
+/** Prefetch the loads in inner serial loops whose addresses stride
+ * too far from one iteration to the next for the hardware prefetcher
+ * to follow, such as walking down a column of a buffer. Each is
+ * prefetched several iterations ahead, or half way through the loop
+ * if it's short. Used on x86 and ARM when the target has the
+ * auto_prefetch feature. */
+Stmt inject_auto_prefetch(Stmt s, const Target &t);
+
 /** Reduce a multi-dimensional prefetch into a prefetch of lower dimension
  * (max dimension of the prefetch is specified by target architecture).
  * This keeps the 'max_dim' innermost dimensions and adds loops for the rest
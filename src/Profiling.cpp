@@ -5,10 +5,13 @@
 
 #include "Profiling.h"
 #include "CodeGen_Internal.h"
+#include "ExprUsesVar.h"
+#include "runtime/HalideRuntime.h"
 #include "IRMutator.h"
 #include "IROperator.h"
 #include "Scope.h"
 #include "Simplify.h"
+#include "StmtCosts.h"
 #include "Substitute.h"
 #include "Util.h"
 
@@ -19,6 +22,206 @@ using std::map;
 using std::string;
 using std::vector;
 
+namespace {
+
+// Record that the current thread is computing the given func, for the
+// lightweight profiler. This call gets inlined and becomes a single
+// store to the thread's slot.
+Stmt set_thread_func(Expr func_id) {
+    Expr profiler_token = Variable::make(Int(32), "profiler_token");
+    Expr slot = Variable::make(Handle(), "profiler_thread_slot");
+    return Evaluate::make(Call::make(Int(32), "halide_profiler_set_thread_func",
+                                     {slot, profiler_token, func_id}, Call::Extern));
+}
+
+// Time the given statement, and record it in the latency histogram of
+// the given func, or of the pipeline if func_id is negative. The start
+// time is held in a variable with the given name.
+Stmt record_latency(Stmt s, int func_id, const string &start_name) {
+    Expr profiler_pipeline_state = Variable::make(Handle(), "profiler_pipeline_state");
+    Expr start = Variable::make(Int(64), start_name);
+    Expr now = Call::make(Int(64), "halide_current_time_ns", {}, Call::Extern);
+    Expr record = Call::make(Int(32), "halide_profiler_record_latency",
+                             {profiler_pipeline_state, func_id, start}, Call::Extern);
+    s = Block::make(s, Evaluate::make(record));
+    return LetStmt::make(start_name, now, s);
+}
+
+// Look up the current thread's slot for the lightweight profiler, and
+// release it when the enclosing function (the pipeline, or a task of
+// a parallel loop) returns, whether it succeeds or fails.
+Stmt thread_slot_scope(Stmt s) {
+    Expr profiler_state = Variable::make(Handle(), "profiler_state");
+    Expr slot = Variable::make(Handle(), "profiler_thread_slot");
+    Expr get_slot = Call::make(Handle(), "halide_profiler_get_thread_slot", {profiler_state}, Call::Extern);
+    Expr release_slot = Call::make(Int(32), Call::register_destructor,
+                                   {Expr("halide_profiler_release_thread_slot"), slot}, Call::Intrinsic);
+    s = Block::make(Evaluate::make(release_slot), s);
+    return LetStmt::make("profiler_thread_slot", get_slot, s);
+}
+
+// Count the ops and bytes accessed by the body of a produce node, for
+// the roofline report. The statically-known cost of each statement is
+// multiplied by the extents of the loops around it, and recorded with
+// a single call at the outermost point where all the loop extents
+// involved are known, which for most loop nests is the top of the
+// produce node. Nested produce nodes count themselves.
+class CountWork : public IRMutator2 {
+    using IRMutator2::visit;
+
+    int func_id;
+
+    // The ops and bytes of the statement just mutated, in terms of
+    // variables defined outside it.
+    Expr ops, bytes;
+
+    void set_cost(Expr o, Expr b) {
+        ops = std::move(o);
+        bytes = std::move(b);
+    }
+
+    void add_expr_cost(const Expr &e) {
+        if (e.defined()) {
+            LoopCost c = expr_cost(e);
+            ops = simplify(ops + c.arith);
+            bytes = simplify(bytes + c.bytes_loaded);
+        }
+    }
+
+    // Record the pending cost at the start of s, which is inside the
+    // scope of everything it uses.
+    Stmt flush(Stmt s) {
+        Expr o = simplify(ops), b = simplify(bytes);
+        set_cost(make_zero(Int(64)), make_zero(Int(64)));
+        if (is_zero(o) && is_zero(b)) {
+            return s;
+        }
+        Expr profiler_pipeline_state = Variable::make(Handle(), "profiler_pipeline_state");
+        Expr record = Call::make(Int(32), "halide_profiler_record_work",
+                                 {profiler_pipeline_state, func_id, cast<uint64_t>(o), cast<uint64_t>(b)},
+                                 Call::Extern);
+        return Block::make(Evaluate::make(record), s);
+    }
+
+    bool cost_uses_var(const string &name) {
+        return expr_uses_var(ops, name) || expr_uses_var(bytes, name);
+    }
+
+    Stmt visit(const Store *op) override {
+        set_cost(make_zero(Int(64)), make_const(Int(64), op->value.type().bytes() * op->value.type().lanes()));
+        add_expr_cost(op->value);
+        add_expr_cost(op->index);
+        add_expr_cost(op->predicate);
+        return op;
+    }
+
+    Stmt visit(const Evaluate *op) override {
+        set_cost(make_zero(Int(64)), make_zero(Int(64)));
+        const Call *call = op->value.as<Call>();
+        if (!call || !starts_with(call->name, "halide_profiler_")) {
+            add_expr_cost(op->value);
+        }
+        return op;
+    }
+
+    Stmt visit(const AssertStmt *op) override {
+        set_cost(make_zero(Int(64)), make_zero(Int(64)));
+        add_expr_cost(op->condition);
+        return op;
+    }
+
+    Stmt visit(const Block *op) override {
+        Stmt first = mutate(op->first);
+        Expr o = ops, b = bytes;
+        Stmt rest = mutate(op->rest);
+        set_cost(simplify(o + ops), simplify(b + bytes));
+        return Block::make(first, rest);
+    }
+
+    Stmt visit(const LetStmt *op) override {
+        Stmt body = mutate(op->body);
+        if (cost_uses_var(op->name)) {
+            body = flush(body);
+        }
+        add_expr_cost(op->value);
+        return LetStmt::make(op->name, op->value, body);
+    }
+
+    Stmt visit(const For *op) override {
+        if (op->device_api != DeviceAPI::None && op->device_api != DeviceAPI::Host) {
+            // Offloaded loops aren't timed here.
+            set_cost(make_zero(Int(64)), make_zero(Int(64)));
+            return op;
+        }
+        Stmt body = mutate(op->body);
+        if (cost_uses_var(op->name)) {
+            // The cost varies from one iteration to the next, so
+            // record it in each.
+            body = flush(body);
+        } else {
+            Expr extent = cast<int64_t>(op->extent);
+            set_cost(simplify(ops * extent), simplify(bytes * extent));
+        }
+        add_expr_cost(op->min);
+        add_expr_cost(op->extent);
+        return For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+    }
+
+    Stmt visit(const IfThenElse *op) override {
+        // Count the more expensive branch, rather than making the
+        // count depend on the condition, which would stop it from
+        // being hoisted out of loops.
+        Stmt then_case = mutate(op->then_case);
+        Expr o = ops, b = bytes;
+        Stmt else_case;
+        if (op->else_case.defined()) {
+            else_case = mutate(op->else_case);
+        } else {
+            set_cost(make_zero(Int(64)), make_zero(Int(64)));
+        }
+        set_cost(simplify(max(o, ops)), simplify(max(b, bytes)));
+        add_expr_cost(op->condition);
+        return IfThenElse::make(op->condition, then_case, else_case);
+    }
+
+    Stmt visit(const ProducerConsumer *op) override {
+        if (op->is_producer) {
+            // Counted as part of the inner Func.
+            set_cost(make_zero(Int(64)), make_zero(Int(64)));
+            return op;
+        }
+        return IRMutator2::visit(op);
+    }
+
+    Stmt visit(const Allocate *op) override {
+        Stmt body = mutate(op->body);
+        for (const Expr &e : op->extents) {
+            add_expr_cost(e);
+        }
+        return Allocate::make(op->name, op->type, op->memory_type, op->extents,
+                              op->condition, body, op->new_expr, op->free_function);
+    }
+
+    Stmt visit(const Free *op) override {
+        set_cost(make_zero(Int(64)), make_zero(Int(64)));
+        return op;
+    }
+
+    Stmt visit(const Prefetch *op) override {
+        set_cost(make_zero(Int(64)), make_zero(Int(64)));
+        return op;
+    }
+
+public:
+    CountWork(int func_id) : func_id(func_id) {}
+
+    Stmt count(const Stmt &s) {
+        return flush(mutate(s));
+    }
+};
+
+}  // namespace
+
 class InjectProfiling : public IRMutator2 {
 public:
     map<string, int> indices;   // maps from func name -> index in buffer.
@@ -27,9 +230,17 @@ public:
 
     string pipeline_name;
 
-    InjectProfiling(const string &pipeline_name) : pipeline_name(pipeline_name) {
+    bool timeline;
+
+    // In the lightweight mode, each thread records the func it is
+    // computing in its own slot, and nothing else is tracked.
+    bool lightweight;
+
+    InjectProfiling(const string &pipeline_name, bool timeline, bool lightweight)
+        : pipeline_name(pipeline_name), timeline(timeline), lightweight(lightweight) {
         indices["overhead"] = 0;
         stack.push_back(0);
+        profiling_memory = !lightweight;
     }
 
     map<int, uint64_t> func_stack_current; // map from func id -> current stack allocation
@@ -47,6 +258,22 @@ private:
 
     bool profiling_memory = true;
 
+    // Timeline events can only be recorded on the host.
+    bool in_offload = false;
+
+    // How many loops we are inside of. Only Funcs produced outside of
+    // all loops get a latency histogram, so the extra timer calls
+    // aren't made on every iteration of a compute_at Func.
+    int loop_depth = 0;
+
+    Stmt timeline_event(Expr func_id, halide_profiler_timeline_event_kind_t kind) {
+        Expr profiler_token = Variable::make(Int(32), "profiler_token");
+        Expr profiler_state = Variable::make(Handle(), "profiler_state");
+        return Evaluate::make(Call::make(Int(32), "halide_profiler_timeline_event",
+                                         {profiler_state, profiler_token + func_id, (int)kind},
+                                         Call::Extern));
+    }
+
     // Strip down the tuple name, e.g. f.0 into f
     string normalize_name(const string &name) {
         vector<string> v = split_string(name, ".");
@@ -140,7 +367,7 @@ private:
             new_expr.same_as(op->new_expr)) {
             stmt = op;
         } else {
-            stmt = Allocate::make(op->name, op->type, new_extents, condition, body, new_expr, op->free_function);
+            stmt = Allocate::make(op->name, op->type, op->memory_type, new_extents, condition, body, new_expr, op->free_function);
         }
 
         if (!is_zero(size) && !on_stack && profiling_memory) {
@@ -192,6 +419,12 @@ private:
             stack.push_back(idx);
             body = mutate(op->body);
             stack.pop_back();
+            if (!lightweight && !in_offload) {
+                body = CountWork(idx).count(body);
+                if (loop_depth == 0) {
+                    body = record_latency(body, idx, op->name + ".profiler_start_time");
+                }
+            }
         } else {
             body = mutate(op->body);
             // At the beginning of the consume step, set the current task
@@ -203,10 +436,17 @@ private:
         Expr profiler_state = Variable::make(Handle(), "profiler_state");
 
         // This call gets inlined and becomes a single store instruction.
-        Expr set_task = Call::make(Int(32), "halide_profiler_set_current_func",
-                                   {profiler_state, profiler_token, idx}, Call::Extern);
+        if (lightweight) {
+            body = Block::make(set_thread_func(idx), body);
+        } else {
+            Expr set_task = Call::make(Int(32), "halide_profiler_set_current_func",
+                                       {profiler_state, profiler_token, idx}, Call::Extern);
+            body = Block::make(Evaluate::make(set_task), body);
+        }
 
-        body = Block::make(Evaluate::make(set_task), body);
+        if (timeline && !in_offload) {
+            body = Block::make(timeline_event(idx, halide_profiler_timeline_func), body);
+        }
 
         return ProducerConsumer::make(op->name, op->is_producer, body);
     }
@@ -219,7 +459,7 @@ private:
         // threads outside the loop, and increment it inside the
         // body.
         bool update_active_threads = (op->device_api == DeviceAPI::Hexagon ||
-                                      op->is_parallel());
+                                      op->is_parallel()) && !lightweight;
 
         Expr state = Variable::make(Handle(), "profiler_state");
         Stmt incr_active_threads =
@@ -233,16 +473,33 @@ private:
             body = Block::make({incr_active_threads, body, decr_active_threads});
         }
 
+        // Mark the span of each task of a parallel loop, labelled
+        // with the enclosing Func.
+        if (timeline && !in_offload && op->is_parallel() &&
+            (op->device_api == DeviceAPI::None || op->device_api == DeviceAPI::Host)) {
+            body = Block::make({timeline_event(stack.back(), halide_profiler_timeline_task_begin),
+                                body,
+                                timeline_event(stack.back(), halide_profiler_timeline_task_end)});
+        }
+
+        loop_depth++;
+
         // We profile by storing a token to global memory, so don't enter GPU loops
-        if (op->device_api == DeviceAPI::Hexagon) {
+        if (op->device_api == DeviceAPI::Hexagon && lightweight) {
+            // There are no thread slots on the DSP.
+            body = op->body;
+        } else if (op->device_api == DeviceAPI::Hexagon) {
             // TODO: This is for all offload targets that support
             // limited internal profiling, which is currently just
             // hexagon. We don't support per-func stats remotely,
             // which means we can't do memory accounting.
             bool old_profiling_memory = profiling_memory;
+            bool old_in_offload = in_offload;
             profiling_memory = false;
+            in_offload = true;
             body = mutate(body);
             profiling_memory = old_profiling_memory;
+            in_offload = old_in_offload;
 
             // Get the profiler state pointer from scratch inside the
             // kernel. There will be a separate copy of the state on
@@ -253,10 +510,19 @@ private:
         } else if (op->device_api == DeviceAPI::None ||
                    op->device_api == DeviceAPI::Host) {
             body = mutate(body);
+            if (lightweight && op->is_parallel()) {
+                // Each task may run on a different thread, so it
+                // looks up its own slot, which is released when the
+                // task returns.
+                body = Block::make(set_thread_func(stack.back()), body);
+                body = thread_slot_scope(body);
+            }
         } else {
             body = op->body;
         }
 
+        loop_depth--;
+
         Stmt stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
 
         if (update_active_threads) {
@@ -266,8 +532,11 @@ private:
     }
 };
 
-Stmt inject_profiling(Stmt s, string pipeline_name) {
-    InjectProfiling profiling(pipeline_name);
+Stmt inject_profiling(Stmt s, string pipeline_name, const Target &t) {
+    bool timeline = t.has_feature(Target::ProfileTimeline);
+    bool lightweight = t.has_feature(Target::ProfileLightweight) &&
+        !t.has_feature(Target::Profile) && !timeline;
+    InjectProfiling profiling(pipeline_name, timeline, lightweight);
     s = profiling.mutate(s);
 
     int num_funcs = (int)(profiling.indices.size());
@@ -286,7 +555,7 @@ Stmt inject_profiling(Stmt s, string pipeline_name) {
     Expr stop_profiler = Call::make(Int(32), Call::register_destructor,
                                     {Expr("halide_profiler_pipeline_end"), get_state}, Call::Intrinsic);
 
-    bool no_stack_alloc = profiling.func_stack_peak.empty();
+    bool no_stack_alloc = profiling.func_stack_peak.empty() || lightweight;
     if (!no_stack_alloc) {
         Expr func_stack_peak_buf = Variable::make(Handle(), "profiling_func_stack_peak_buf");
 
@@ -303,7 +572,30 @@ Stmt inject_profiling(Stmt s, string pipeline_name) {
     Stmt decr_active_threads =
         Evaluate::make(Call::make(Int(32), "halide_profiler_decr_active_threads",
                                   {profiler_state}, Call::Extern));
-    s = Block::make({incr_active_threads, s, decr_active_threads});
+    s = record_latency(s, -1, "profiler_pipeline_start_time");
+
+    if (lightweight) {
+        s = Block::make(set_thread_func(0), s);
+        s = thread_slot_scope(s);
+    } else {
+        // The pipeline's allocation count and total are summed from
+        // its Funcs' at the end of each run.
+        Expr profiler_pipeline_state = Variable::make(Handle(), "profiler_pipeline_state");
+        Stmt update_memory_totals =
+            Evaluate::make(Call::make(Int(32), "halide_profiler_memory_totals_update",
+                                      {profiler_pipeline_state}, Call::Extern));
+        s = Block::make({incr_active_threads, s, update_memory_totals, decr_active_threads});
+    }
+
+    if (timeline) {
+        Stmt begin = Evaluate::make(Call::make(Int(32), "halide_profiler_timeline_event",
+                                               {profiler_state, profiler_token, (int)halide_profiler_timeline_pipeline_begin},
+                                               Call::Extern));
+        Stmt end = Evaluate::make(Call::make(Int(32), "halide_profiler_timeline_event",
+                                             {profiler_state, profiler_token, (int)halide_profiler_timeline_pipeline_end},
+                                             Call::Extern));
+        s = Block::make({begin, s, end});
+    }
 
     s = LetStmt::make("profiler_pipeline_state", get_pipeline_state, s);
     s = LetStmt::make("profiler_state", get_state, s);
@@ -320,7 +612,7 @@ Stmt inject_profiling(Stmt s, string pipeline_name) {
                                         i, Parameter(), const_true()), s);
         }
         s = Block::make(s, Free::make("profiling_func_stack_peak_buf"));
-        s = Allocate::make("profiling_func_stack_peak_buf", UInt(64), {num_funcs}, const_true(), s);
+        s = Allocate::make("profiling_func_stack_peak_buf", UInt(64), MemoryType::Auto, {num_funcs}, const_true(), s);
     }
 
     for (std::pair<string, int> p : profiling.indices) {
@@ -328,7 +620,7 @@ Stmt inject_profiling(Stmt s, string pipeline_name) {
     }
 
     s = Block::make(s, Free::make("profiling_func_names"));
-    s = Allocate::make("profiling_func_names", Handle(), {num_funcs}, const_true(), s);
+    s = Allocate::make("profiling_func_names", Handle(), MemoryType::Auto, {num_funcs}, const_true(), s);
     s = Block::make(Evaluate::make(stop_profiler), s);
 
     return s;
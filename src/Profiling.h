@@ -25,6 +25,7 @@
  */
 
 #include "IR.h"
+#include "Target.h"
 
 namespace Halide {
 namespace Internal {
@@ -33,10 +34,13 @@ namespace Internal {
  * high-resolution timing into the generated code (via spawning a
  * thread that acts as a sampling profiler); summaries of execution
  * times and counts will be logged at the end. Should be done before
- * storage flattening, but after all bounds inference.
- *
+ * storage flattening, but after all bounds inference. The
+ * profile_timeline target feature also records the start of each
+ * Func, parallel task and the pipeline itself on each thread, for
+ * halide_profiler_dump_timeline. The profile_lightweight feature
+ * instead only tracks which Func each thread is computing.
  */
-Stmt inject_profiling(Stmt, std::string);
+Stmt inject_profiling(Stmt, std::string, const Target &t);
 
 }
 }
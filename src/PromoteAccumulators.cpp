@@ -0,0 +1,303 @@
+#include "PromoteAccumulators.h"
+#include "CodeGen_GPU_Dev.h"
+#include "ExprUsesVar.h"
+#include "IREquality.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Scope.h"
+#include "Simplify.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::set;
+using std::string;
+using std::vector;
+
+namespace {
+
+// The distinct sites of a buffer accessed in a loop body.
+struct Sites {
+    vector<Expr> indices;
+    Type type;
+    Buffer<> image;
+    Parameter param;
+    bool stored = false;
+};
+
+// Finds the accesses to buffers in a loop body, the buffers that are
+// used in any other way, and the names that it defines.
+class FindAccesses : public IRVisitor {
+    using IRVisitor::visit;
+
+    const DeviceAPI device_api;
+    int in_other_closure = 0;
+
+    void record(const string &name, Type type, const Expr &index, const Expr &predicate,
+                const Buffer<> &image, const Parameter &param) {
+        if (!is_one(predicate) || in_other_closure) {
+            escaped.insert(name);
+            return;
+        }
+        Sites &s = sites[name];
+        if (s.indices.empty()) {
+            s.type = type.element_of();
+            s.image = image;
+            s.param = param;
+        } else if (s.type != type.element_of()) {
+            escaped.insert(name);
+        }
+        for (const Expr &i : s.indices) {
+            if (equal(i, index)) {
+                return;
+            }
+        }
+        s.indices.push_back(index);
+    }
+
+    void visit(const Load *op) override {
+        IRVisitor::visit(op);
+        record(op->name, op->type, op->index, op->predicate, op->image, op->param);
+    }
+
+    void visit(const Store *op) override {
+        IRVisitor::visit(op);
+        record(op->name, op->value.type(), op->index, op->predicate, Buffer<>(), op->param);
+        sites[op->name].stored = true;
+    }
+
+    void visit(const Variable *op) override {
+        // A buffer whose address, or halide_buffer_t, is used.
+        if (op->type.is_handle()) {
+            escaped.insert(op->name);
+            if (ends_with(op->name, ".buffer")) {
+                escaped.insert(op->name.substr(0, op->name.size() - 7));
+            }
+        }
+    }
+
+    void visit(const Let *op) override {
+        defined.push(op->name, 0);
+        IRVisitor::visit(op);
+    }
+
+    void visit(const LetStmt *op) override {
+        defined.push(op->name, 0);
+        IRVisitor::visit(op);
+    }
+
+    void visit(const For *op) override {
+        defined.push(op->name, 0);
+        if (op->for_type == ForType::Parallel ||
+            (op->device_api != device_api &&
+             (op->device_api != DeviceAPI::None || CodeGen_GPU_Dev::is_gpu_var(op->name)))) {
+            // The body runs in other threads, or on another device, so
+            // nothing it uses can be kept in registers here.
+            in_other_closure++;
+            IRVisitor::visit(op);
+            in_other_closure--;
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+    void visit(const Allocate *op) override {
+        escaped.insert(op->name);
+        IRVisitor::visit(op);
+    }
+
+public:
+    map<string, Sites> sites;
+    set<string> escaped;
+    Scope<int> defined;
+
+    FindAccesses(DeviceAPI d) : device_api(d) {}
+};
+
+// Whether an expression loads from any buffer.
+bool has_load(const Expr &e) {
+    class HasLoad : public IRVisitor {
+        using IRVisitor::visit;
+        void visit(const Load *op) override {
+            result = true;
+        }
+    public:
+        bool result = false;
+    } v;
+    e.accept(&v);
+    return v.result;
+}
+
+// Whether the sites at two indices of the same buffer can't overlap.
+bool disjoint(const Expr &a, const Expr &b) {
+    const Ramp *ra = a.as<Ramp>();
+    const Ramp *rb = b.as<Ramp>();
+    if (a.type().is_scalar() && b.type().is_scalar()) {
+        const int64_t *d = as_const_int(simplify(a - b));
+        return d && *d != 0;
+    } else if (ra && rb && ra->lanes == rb->lanes) {
+        const int64_t *sa = as_const_int(ra->stride);
+        const int64_t *sb = as_const_int(rb->stride);
+        const int64_t *d = as_const_int(simplify(ra->base - rb->base));
+        if (!sa || !sb || !d || *sa != *sb || *sa == 0) {
+            return false;
+        }
+        int64_t span = std::abs(*sa) * ra->lanes;
+        return std::abs(*d) >= span || (*d % *sa) != 0;
+    }
+    return false;
+}
+
+// Replaces the accesses to the promoted sites with accesses to their
+// registers.
+class ReplaceSites : public IRMutator2 {
+public:
+    // The buffer, the index, and the register of a promoted site.
+    struct Site {
+        string buffer;
+        Expr index;
+        string reg;
+    };
+
+private:
+    using IRMutator2::visit;
+
+    const vector<Site> &promoted;
+
+    const Site *find(const string &name, const Expr &index) {
+        for (const Site &s : promoted) {
+            if (s.buffer == name && equal(s.index, index)) {
+                return &s;
+            }
+        }
+        return nullptr;
+    }
+
+    Expr visit(const Load *op) override {
+        const Site *s = find(op->name, op->index);
+        if (s) {
+            return register_load(op->type, s->reg);
+        }
+        return IRMutator2::visit(op);
+    }
+
+    Stmt visit(const Store *op) override {
+        Expr value = mutate(op->value);
+        const Site *s = find(op->name, op->index);
+        if (s) {
+            return register_store(s->reg, value);
+        }
+        if (value.same_as(op->value)) {
+            return op;
+        }
+        return Store::make(op->name, value, op->index, op->param, op->predicate);
+    }
+
+public:
+    ReplaceSites(const vector<Site> &p) : promoted(p) {}
+
+    static Expr register_index(int lanes) {
+        if (lanes == 1) {
+            return 0;
+        }
+        return Ramp::make(0, 1, lanes);
+    }
+
+    static Expr register_load(Type t, const string &reg) {
+        return Load::make(t, reg, register_index(t.lanes()), Buffer<>(), Parameter(),
+                          const_true(t.lanes()));
+    }
+
+    static Stmt register_store(const string &reg, Expr value) {
+        int lanes = value.type().lanes();
+        return Store::make(reg, value, register_index(lanes), Parameter(), const_true(lanes));
+    }
+};
+
+class PromoteAccumulators : public IRMutator2 {
+    using IRMutator2::visit;
+
+    Stmt visit(const For *op) override {
+        Stmt stmt = IRMutator2::visit(op);
+        op = stmt.as<For>();
+        if (op == nullptr || op->for_type != ForType::Serial) {
+            return stmt;
+        }
+
+        FindAccesses accesses(op->device_api);
+        accesses.defined.push(op->name, 0);
+        op->body.accept(&accesses);
+
+        vector<ReplaceSites::Site> promoted;
+        vector<Stmt> loads, stores;
+        vector<Type> types;
+        for (const auto &p : accesses.sites) {
+            const string &name = p.first;
+            const Sites &sites = p.second;
+            if (!sites.stored || accesses.escaped.count(name) ||
+                accesses.defined.contains(name)) {
+                continue;
+            }
+            bool ok = true;
+            for (size_t i = 0; ok && i < sites.indices.size(); i++) {
+                // Each lane of a vector site must be a different element,
+                // so that the register holds the same values as the buffer.
+                const Expr &index = sites.indices[i];
+                const Ramp *ramp = index.as<Ramp>();
+                ok = (index.type().is_scalar() ||
+                      (ramp && is_const(ramp->stride) && !is_zero(ramp->stride)));
+                ok = ok && !expr_uses_vars(index, accesses.defined) && !has_load(index);
+                for (size_t j = 0; ok && j < i; j++) {
+                    ok = disjoint(sites.indices[i], sites.indices[j]);
+                }
+            }
+            if (!ok) {
+                continue;
+            }
+            for (const Expr &index : sites.indices) {
+                Type t = sites.type.with_lanes(index.type().lanes());
+                string reg = unique_name(name + ".accumulator");
+                promoted.push_back({name, index, reg});
+                types.push_back(t);
+                Expr value = Load::make(t, name, index, sites.image, sites.param,
+                                        const_true(t.lanes()));
+                loads.push_back(ReplaceSites::register_store(reg, value));
+                stores.push_back(Store::make(name, ReplaceSites::register_load(t, reg), index,
+                                             sites.param, const_true(t.lanes())));
+            }
+        }
+
+        if (promoted.empty()) {
+            return stmt;
+        }
+
+        debug(3) << "Promoting " << promoted.size() << " accumulators of loop " << op->name << "\n";
+
+        Stmt body = ReplaceSites(promoted).mutate(op->body);
+        Stmt loop = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+        vector<Stmt> stmts = loads;
+        stmts.push_back(loop);
+        stmts.insert(stmts.end(), stores.begin(), stores.end());
+        Stmt result = Block::make(stmts);
+        for (size_t i = promoted.size(); i > 0; i--) {
+            Type t = types[i - 1];
+            result = Allocate::make(promoted[i - 1].reg, t.element_of(), MemoryType::Register,
+                                    {t.lanes()}, const_true(), result);
+        }
+        // The sites may only be valid if the loop runs at all.
+        if (!is_positive_const(op->extent)) {
+            result = IfThenElse::make(op->extent > 0, result);
+        }
+        return result;
+    }
+};
+
+}  // namespace
+
+Stmt promote_accumulators(Stmt s) {
+    return PromoteAccumulators().mutate(s);
+}
+
+}
+}
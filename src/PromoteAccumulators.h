@@ -0,0 +1,27 @@
+#ifndef HALIDE_PROMOTE_ACCUMULATORS_H
+#define HALIDE_PROMOTE_ACCUMULATORS_H
+
+/** \file
+ * Defines the lowering pass that keeps the accumulators of a reduction
+ * in registers for the duration of the loop over its domain.
+ */
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Find serial loops that load and store some sites of a buffer whose
+ * indices don't depend on the loop, and no other sites of it, e.g. the
+ * loop over the RDom of an update computed at a tile. Those sites are
+ * loaded into register allocations before the loop, the loop updates
+ * the registers, and they are stored back once after it. This doesn't
+ * rely on LLVM proving that the buffer isn't aliased, which it often
+ * can't for vectorized or unrolled tiles. Must run after vectorization
+ * and unrolling. */
+Stmt promote_accumulators(Stmt s);
+
+}
+}
+
+#endif
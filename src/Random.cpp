@@ -85,21 +85,90 @@ Expr random_int(const vector<Expr> &e) {
     return result;
 }
 
-Expr random_float(const vector<Expr> &e) {
-    Expr result = random_int(e);
-    // Set the exponent to one, and fill the mantissa with 23 random bits.
+// The multipliers and key increments of Philox4x32.
+#define PHILOX_M0 0xD2511F53
+#define PHILOX_M1 0xCD9E8D57
+#define PHILOX_W0 0x9E3779B9
+#define PHILOX_W1 0xBB67AE85
+
+Expr random_philox(const vector<Expr> &counter, const vector<Expr> &key, int bits) {
+    internal_assert(counter.size() == 4 && key.size() == 2 && (bits == 32 || bits == 64));
+
+    // Each word is used more than once in the next round, so they all
+    // get names to stop the expression blowing up.
+    vector<std::pair<string, Expr>> lets;
+    auto bind = [&](Expr e) {
+        if (is_const(e) || e.as<Variable>()) {
+            return e;
+        }
+        string name = unique_name('R');
+        lets.push_back({name, e});
+        return Variable::make(e.type(), name);
+    };
+
+    Expr c[4], k[2];
+    for (int i = 0; i < 4; i++) {
+        internal_assert(counter[i].type() == UInt(32));
+        c[i] = bind(counter[i]);
+    }
+    for (int i = 0; i < 2; i++) {
+        internal_assert(key[i].type() == UInt(32));
+        k[i] = bind(key[i]);
+    }
+
+    const uint32_t m[2] = {PHILOX_M0, PHILOX_M1};
+    const uint32_t w[2] = {PHILOX_W0, PHILOX_W1};
+    for (uint32_t round = 0; round < 10; round++) {
+        // Multiply the even words by the constants, keeping both
+        // halves, and mix the high halves into the odd words along
+        // with the key for this round.
+        Expr p0 = bind(cast<uint64_t>(c[0]) * make_const(UInt(64), m[0]));
+        Expr p1 = bind(cast<uint64_t>(c[2]) * make_const(UInt(64), m[1]));
+        Expr k0 = k[0] + make_const(UInt(32), round * w[0]);
+        Expr k1 = k[1] + make_const(UInt(32), round * w[1]);
+        Expr c0 = (cast<uint32_t>(p1 >> 32) ^ c[1]) ^ k0;
+        Expr c1 = cast<uint32_t>(p1);
+        Expr c2 = (cast<uint32_t>(p0 >> 32) ^ c[3]) ^ k1;
+        Expr c3 = cast<uint32_t>(p0);
+        c[0] = bind(c0);
+        c[1] = bind(c1);
+        c[2] = bind(c2);
+        c[3] = bind(c3);
+    }
+
+    Expr result = c[0];
+    if (bits == 64) {
+        result = (cast<uint64_t>(c[1]) << 32) | cast<uint64_t>(c[0]);
+    }
+    for (auto it = lets.rbegin(); it != lets.rend(); it++) {
+        result = Let::make(it->first, it->second, result);
+    }
+    return result;
+}
+
+namespace {
+
+// Set the exponent to one, and fill the mantissa with 23 random bits.
+Expr uint_to_float(Expr result) {
     result = (127 << 23) | (cast<uint32_t>(result) >> 9);
     // The clamp is purely for the benefit of bounds inference.
     return clamp(reinterpret(Float(32), result) - 1.0f, 0.0f, 1.0f);
 }
 
+}
+
+Expr random_float(const vector<Expr> &e) {
+    return uint_to_float(random_int(e));
+}
+
 class LowerRandom : public IRMutator2 {
     using IRMutator2::visit;
 
     Expr visit(const Call *op) override {
         if (op->is_intrinsic(Call::random)) {
             vector<Expr> args = op->args;
-            args.insert(args.end(), extra_args.begin(), extra_args.end());
+            args.push_back(tag);
+            args.insert(args.end(), coordinates.begin(), coordinates.end());
             if (op->type == Float(32)) {
                 return random_float(args);
             } else if (op->type == Int(32)) {
@@ -110,18 +179,47 @@ class LowerRandom : public IRMutator2 {
                 internal_error << "The intrinsic random() returns an Int(32), UInt(32) or a Float(32).\n";
                 return Expr();
             }
+        } else if (op->is_intrinsic(Call::random_philox)) {
+            // The seed, the identity of the call and the type it
+            // returns are hashed into the key. The pure variables are
+            // the counter. Any beyond the fourth get hashed into the
+            // last word of it.
+            vector<Expr> key_args = op->args;
+            key_args.push_back(tag);
+            key_args.push_back(op->type.bits());
+            vector<Expr> key = {random_int(key_args), make_zero(UInt(32))};
+            vector<Expr> counter(4, make_zero(UInt(32)));
+            for (size_t i = 0; i < coordinates.size() && i < 4; i++) {
+                counter[i] = cast<uint32_t>(coordinates[i]);
+            }
+            if (coordinates.size() > 4) {
+                vector<Expr> rest(coordinates.begin() + 3, coordinates.end());
+                counter[3] = random_int(rest);
+            }
+            if (op->type == Float(32)) {
+                return uint_to_float(random_philox(counter, key, 32));
+            } else if (op->type == Int(32)) {
+                return cast<int32_t>(random_philox(counter, key, 32));
+            } else if (op->type == UInt(32)) {
+                return random_philox(counter, key, 32);
+            } else if (op->type == UInt(64)) {
+                return random_philox(counter, key, 64);
+            } else {
+                internal_error << "The intrinsic random_philox() returns an Int(32), UInt(32), UInt(64) or a Float(32).\n";
+                return Expr();
+            }
         } else {
             return IRMutator2::visit(op);
         }
     }
 
-    vector<Expr> extra_args;
+    Expr tag;
+    vector<Expr> coordinates;
 public:
-    LowerRandom(const vector<string> &free_vars, int tag) {
-        extra_args.push_back(tag);
+    LowerRandom(const vector<string> &free_vars, int tag) : tag(tag) {
         for (size_t i = 0; i < free_vars.size(); i++) {
             internal_assert(!free_vars[i].empty());
-            extra_args.push_back(Variable::make(Int(32), free_vars[i]));
+            coordinates.push_back(Variable::make(Int(32), free_vars[i]));
         }
     }
 };
@@ -20,8 +20,15 @@ Expr random_float(const std::vector<Expr> &);
  * be integers or unsigned integers). */
 Expr random_int(const std::vector<Expr> &);
 
+/** Return 32 or 64 random bits (a UInt(32) or UInt(64)) from the
+ * Philox4x32-10 counter-based generator: the first one or two words
+ * of the output block for the given counter, which must be four
+ * UInt(32)s, and key, which must be two UInt(32)s. */
+Expr random_philox(const std::vector<Expr> &counter, const std::vector<Expr> &key, int bits);
+
 /** Convert calls to random() to IR generated by random_float and
- * random_int. Tags all calls with the variables in free_vars, and the
+ * random_int, or by random_philox for calls to random_philox. Tags
+ * all calls with the variables in free_vars, and the
  * integer given as the last argument. */
 Expr lower_random(Expr e, const std::vector<std::string> &free_vars, int tag);
 
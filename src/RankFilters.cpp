@@ -0,0 +1,196 @@
+#include <cmath>
+
+#include "RankFilters.h"
+#include "CSE.h"
+#include "IROperator.h"
+#include "InlineReductions.h"
+
+namespace Halide {
+
+namespace RankFilters {
+
+using namespace Halide::Internal;
+
+namespace {
+
+void check_source(const Func &source, const char *filter) {
+    user_assert(source.defined() && source.dimensions() == 2 && source.outputs() == 1)
+        << filter << " needs a two dimensional Func with one output, but "
+        << source.name() << " has " << source.dimensions() << " dimensions and "
+        << source.outputs() << " outputs.\n";
+}
+
+// Apply the comparators of Batcher's odd-even merge sort to the
+// values. Sorting n values with this network is the same as sorting a
+// power of two of them with the extra ones at +infinity, in which case
+// the comparators that touch the extra ones do nothing, so they are
+// skipped. Only the values that the chosen rank depends on are ever
+// used, so the rest of the network goes away.
+void odd_even_merge_sort(std::vector<Expr> &v) {
+    const int n = (int)v.size();
+    for (int p = 1; p < n; p *= 2) {
+        for (int k = p; k >= 1; k /= 2) {
+            for (int j = k % p; j + k < n; j += 2 * k) {
+                for (int i = 0; i < std::min(k, n - j - k); i++) {
+                    if ((i + j) / (2 * p) == (i + j + k) / (2 * p)) {
+                        Expr a = v[i + j], b = v[i + j + k];
+                        v[i + j] = min(a, b);
+                        v[i + j + k] = max(a, b);
+                    }
+                }
+            }
+        }
+    }
+}
+
+}  // namespace
+
+Func sorting_network_rank_filter(const Func &source, int radius_x, int radius_y, int rank) {
+    check_source(source, "sorting_network_rank_filter");
+    user_assert(radius_x >= 0 && radius_y >= 0)
+        << "sorting_network_rank_filter of " << source.name() << " with a negative radius.\n";
+    const int n = (2 * radius_x + 1) * (2 * radius_y + 1);
+    user_assert(rank >= 0 && rank < n)
+        << "sorting_network_rank_filter of " << source.name() << " with rank " << rank
+        << ", which is not in [0, " << n - 1 << "].\n";
+
+    Var x("x"), y("y");
+    std::vector<Expr> values;
+    for (int dy = -radius_y; dy <= radius_y; dy++) {
+        for (int dx = -radius_x; dx <= radius_x; dx++) {
+            values.push_back(source(x + dx, y + dy));
+        }
+    }
+    odd_even_merge_sort(values);
+
+    // The network is a DAG with lots of sharing, which would be
+    // expanded into a tree by the passes that don't look for it.
+    Func result(unique_name("rank_filter"));
+    result(x, y) = common_subexpression_elimination(values[rank]);
+    return result;
+}
+
+Func histogram_rank_filter(const Func &source, int radius, Expr rank,
+                           int tile_width, int strip_height) {
+    check_source(source, "histogram_rank_filter");
+    user_assert(source.output_types()[0] == UInt(8))
+        << "histogram_rank_filter needs a uint8 Func, but " << source.name()
+        << " is " << source.output_types()[0] << ".\n";
+    user_assert(radius >= 0 && radius < 128)
+        << "histogram_rank_filter of " << source.name() << " with radius " << radius
+        << ", which is not in [0, 127].\n";
+    user_assert(tile_width >= 1 && strip_height >= 1)
+        << "histogram_rank_filter of " << source.name() << " with an empty tile.\n";
+
+    // The histograms count up to (2 * radius + 1)^2 values.
+    const Type count_t = UInt(16);
+    const int tw = tile_width, sh = strip_height;
+    const int diameter = 2 * radius + 1;
+    Var b("b"), x("x"), y("y"), i("i"), s("s"), j("j"), t("t");
+    auto in = [&](Expr x, Expr y) { return cast<int>(source(x, y)); };
+
+    // The histograms of the columns of the window, centered on row
+    // s * strip_height + i. The first row of each strip is counted,
+    // and each row after that adds one value to the bottom of the
+    // previous row's column and removes one from the top.
+    Func column(unique_name("rank_filter_columns"));
+    column(b, x, i, s) = make_zero(count_t);
+    RDom r_col(-radius, diameter);
+    column(in(x, s * sh + r_col), x, 0, s) += make_one(count_t);
+    RDom r_i(1, std::max(sh - 1, 1));
+    if (sh > 1) {
+        Expr row = s * sh + r_i;
+        column(b, x, r_i, s) = (column(b, x, r_i - 1, s) +
+                                cast(count_t, in(x, row + radius) == b) -
+                                cast(count_t, in(x, row - radius - 1) == b));
+    }
+    auto column_at = [&](Expr x, Expr y) { return column(b, x, y % sh, y / sh); };
+
+    // The histograms of the windows centered on column t * tile_width
+    // + j, built from the column histograms in the same way.
+    Func window(unique_name("rank_filter_windows"));
+    window(b, j, t, y) = make_zero(count_t);
+    RDom r_row(-radius, diameter);
+    window(b, 0, t, y) += column_at(t * tw + r_row, y);
+    RDom r_j(1, std::max(tw - 1, 1));
+    if (tw > 1) {
+        Expr col = t * tw + r_j;
+        window(b, r_j, t, y) = (window(b, r_j - 1, t, y) +
+                                column_at(col + radius, y) -
+                                column_at(col - radius - 1, y));
+    }
+
+    // The value of a given rank is the number of bins that hold no
+    // more than that many values in total.
+    Func cumulative(unique_name("rank_filter_cumulative"));
+    cumulative(b, j, t, y) = window(b, j, t, y);
+    RDom r_b(1, 255);
+    cumulative(r_b, j, t, y) += cumulative(r_b - 1, j, t, y);
+
+    Func result(unique_name("rank_filter"));
+    RDom r(0, 256);
+    result(x, y) = cast<uint8_t>(sum(select(cast<int>(cumulative(r, x % tw, x / tw, y)) <= rank, 1, 0)));
+
+    // Everything is computed per tile, so the memory used doesn't
+    // depend on the size of the image.
+    const int vec = 16;
+    Var xo("xo"), yo("yo"), xi("xi"), yi("yi");
+    result.tile(x, y, xo, yo, xi, yi, tw, sh)
+        .vectorize(xi, std::min(vec, tw))
+        .parallel(yo);
+
+    column.compute_at(result, xo)
+        .vectorize(b, vec);
+    if (sh > 1) {
+        column.update(1)
+            .reorder(b, x, r_i)
+            .vectorize(b, vec);
+    }
+
+    window.compute_at(result, yi)
+        .vectorize(b, vec);
+    window.update(0)
+        .reorder(b, r_row)
+        .vectorize(b, vec);
+    if (tw > 1) {
+        window.update(1)
+            .reorder(b, r_j)
+            .vectorize(b, vec);
+    }
+
+    cumulative.compute_at(result, yi)
+        .vectorize(b, vec);
+    cumulative.update()
+        .reorder(j, r_b)
+        .vectorize(j, std::min(vec, tw));
+
+    return result;
+}
+
+Func rank_filter(const Func &source, int radius, int rank) {
+    check_source(source, "rank_filter");
+    // Up to 7x7, the rank of one value is cheaper to find with a
+    // sorting network than by updating histograms of 256 bins.
+    if (radius <= 3 || source.output_types()[0] != UInt(8)) {
+        return sorting_network_rank_filter(source, radius, radius, rank);
+    } else {
+        return histogram_rank_filter(source, radius, rank);
+    }
+}
+
+Func median_filter(const Func &source, int radius) {
+    const int n = (2 * radius + 1) * (2 * radius + 1);
+    return rank_filter(source, radius, n / 2);
+}
+
+Func percentile_filter(const Func &source, int radius, float percentile) {
+    user_assert(percentile >= 0.0f && percentile <= 1.0f)
+        << "percentile_filter of " << source.name() << " with percentile " << percentile
+        << ", which is not in [0, 1].\n";
+    const int n = (2 * radius + 1) * (2 * radius + 1);
+    return rank_filter(source, radius, (int)std::lround(percentile * (n - 1)));
+}
+
+}
+
+}
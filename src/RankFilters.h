@@ -0,0 +1,71 @@
+#ifndef HALIDE_RANK_FILTERS_H
+#define HALIDE_RANK_FILTERS_H
+
+/** \file
+ * Median, percentile, and other rank filters of Halide::Funcs.
+ */
+
+#include "Func.h"
+#include "IR.h"
+
+namespace Halide {
+
+/** namespace to hold rank filters of two dimensional Funcs.
+ *
+ *  A rank filter replaces each value with one of the values in the
+ *  window around it, chosen by its rank: rank 0 is the minimum of the
+ *  window, the last rank is the maximum, and the middle rank is the
+ *  median. Windows are (2 * radius_x + 1) by (2 * radius_y + 1),
+ *  centered on the output coordinate, so the source must be defined
+ *  over the whole window of every output; wrap it in one of the
+ *  BoundaryConditions first if it is an image.
+ *
+ *  Small windows are filtered with a sorting network, which is a
+ *  fixed sequence of min and max operations that vectorizes well and
+ *  works for any type. Large windows of 8-bit values are filtered
+ *  with a sliding histogram (Perreault and Hebert, "Median Filtering
+ *  in Constant Time"), which does the same amount of work per value
+ *  no matter how large the window is.
+ */
+namespace RankFilters {
+
+/** Filter a two dimensional source with a sorting network. The rank
+ * must be between zero and the number of values in the window minus
+ * one. The result is not scheduled. The network grows a little faster
+ * than the area of the window, so this is a good choice up to about
+ * 7x7. */
+EXPORT Func sorting_network_rank_filter(const Func &source, int radius_x, int radius_y, int rank);
+
+/** Filter a two dimensional uint8 source with a square sliding
+ * histogram window. The rank may be a runtime parameter, but must be
+ * between zero and (2 * radius + 1)^2 - 1; the radius is at most 127.
+ *
+ * The result is computed in tiles of tile_width by strip_height. The
+ * histograms of the columns of each tile are updated row by row, and
+ * the histograms of the windows across each row of a tile, so the
+ * work per value is proportional to the number of histogram bins
+ * rather than to the area of the window; the only work that grows
+ * with the radius is starting the histograms at the edges of each
+ * tile. The returned Func is already scheduled, with the tiles
+ * vectorized and the strips of tiles in parallel. */
+EXPORT Func histogram_rank_filter(const Func &source, int radius, Expr rank,
+                                  int tile_width = 64, int strip_height = 16);
+
+/** Filter a two dimensional source with a square window, using a
+ * sorting network for small windows or sources of types other than
+ * uint8, and a sliding histogram otherwise. */
+EXPORT Func rank_filter(const Func &source, int radius, int rank);
+
+/** Median filter a two dimensional source with a square window. */
+EXPORT Func median_filter(const Func &source, int radius);
+
+/** Percentile filter a two dimensional source with a square window.
+ * A percentile of zero is the minimum of the window, and one is the
+ * maximum. */
+EXPORT Func percentile_filter(const Func &source, int radius, float percentile);
+
+}
+
+}
+
+#endif
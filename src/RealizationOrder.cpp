@@ -3,6 +3,7 @@
 
 #include "RealizationOrder.h"
 #include "FindCalls.h"
+#include "Function.h"
 
 namespace Halide {
 namespace Internal {
@@ -15,9 +16,22 @@ using std::pair;
 
 void realization_order_dfs(string current,
                            const vector<pair<string, vector<string>>> &graph,
+                           const map<string, string> &fused_parent,
+                           const map<string, vector<string>> &fused_children,
                            set<string> &visited,
                            set<string> &result_set,
                            vector<string> &order) {
+    // Funcs fused with another are realized together with it (see
+    // below), so visit the Func they're fused into instead.
+    const auto parent = fused_parent.find(current);
+    if (parent != fused_parent.end()) {
+        if (visited.find(parent->second) == visited.end()) {
+            realization_order_dfs(parent->second, graph, fused_parent, fused_children,
+                                  visited, result_set, order);
+        }
+        return;
+    }
+
     visited.insert(current);
 
     const auto iter = std::find_if(graph.begin(), graph.end(),
@@ -26,7 +40,8 @@ void realization_order_dfs(string current,
 
     for (const string &fn : iter->second) {
         if (visited.find(fn) == visited.end()) {
-            realization_order_dfs(fn, graph, visited, result_set, order);
+            realization_order_dfs(fn, graph, fused_parent, fused_children,
+                                  visited, result_set, order);
         } else if (fn != current) { // Self-loops are allowed in update stages
             internal_assert(result_set.find(fn) != result_set.end())
                 << "Stuck in a loop computing a realization order. "
@@ -36,6 +51,17 @@ void realization_order_dfs(string current,
 
     result_set.insert(current);
     order.push_back(current);
+
+    // The Funcs fused into this one come right after it, so nothing
+    // can be scheduled between them.
+    const auto children = fused_children.find(current);
+    if (children != fused_children.end()) {
+        for (const string &child : children->second) {
+            visited.insert(child);
+            result_set.insert(child);
+            order.push_back(child);
+        }
+    }
 }
 
 vector<string> realization_order(const vector<Function> &outputs,
@@ -55,13 +81,63 @@ vector<string> realization_order(const vector<Function> &outputs,
         graph.push_back({caller.first, s});
     }
 
+    // A Func scheduled compute_with another shares its loop nest, so
+    // the pair must be realized after the inputs of both, and before
+    // the consumers of either. Give the callees of each fused Func to
+    // the Func it is fused into, and visit that one in its place.
+    map<string, string> fused_parent;
+    map<string, vector<string>> fused_children;
+    for (const auto &child : env) {
+        const LoopLevel &fuse_level = child.second.schedule().fuse_level();
+        if (fuse_level.is_inlined()) {
+            continue;
+        }
+        user_assert(!fuse_level.is_root())
+            << "Func " << child.first << " is scheduled compute_with the root loop level, "
+            << "but must be scheduled compute_with a loop of another Func.\n";
+        const string &parent = fuse_level.func();
+        const auto parent_func = env.find(parent);
+        user_assert(parent_func != env.end())
+            << "Func " << child.first << " is scheduled compute_with " << parent
+            << ", which is not used in this pipeline.\n";
+        user_assert(parent != child.first)
+            << "Func " << child.first << " cannot be scheduled compute_with itself.\n";
+        user_assert(parent_func->second.schedule().fuse_level().is_inlined())
+            << "Func " << child.first << " is scheduled compute_with " << parent
+            << ", which is itself scheduled compute_with another Func. "
+            << "Schedule both compute_with the same Func instead.\n";
+        if (find_transitive_calls(child.second).count(parent) ||
+            find_transitive_calls(parent_func->second).count(child.first)) {
+            user_error << "Func " << child.first << " is scheduled compute_with " << parent
+                       << ", but one calls the other, so their loop nests can't be fused.\n";
+        }
+        fused_parent[child.first] = parent;
+        fused_children[parent].push_back(child.first);
+    }
+    for (auto &node : graph) {
+        const auto children = fused_children.find(node.first);
+        if (children == fused_children.end()) {
+            continue;
+        }
+        for (const string &child : children->second) {
+            const auto iter = std::find_if(graph.begin(), graph.end(),
+                [&child](const pair<string, vector<string>> &p) { return (p.first == child); });
+            for (const string &fn : iter->second) {
+                if (std::find(node.second.begin(), node.second.end(), fn) == node.second.end()) {
+                    node.second.push_back(fn);
+                }
+            }
+        }
+    }
+
     vector<string> order;
     set<string> result_set;
     set<string> visited;
 
     for (Function f : outputs) {
         if (visited.find(f.name()) == visited.end()) {
-            realization_order_dfs(f.name(), graph, visited, result_set, order);
+            realization_order_dfs(f.name(), graph, fused_parent, fused_children,
+                                  visited, result_set, order);
         }
     }
 
@@ -193,6 +193,9 @@ class ExprCost : public IRVisitor {
                        call->is_intrinsic(Call::count_leading_zeros) ||
                        call->is_intrinsic(Call::count_trailing_zeros)) {
                 cost.arith += 5;
+            } else if (call->is_intrinsic(Call::random_philox)) {
+                // Ten rounds of two multiplies and a few xors.
+                cost.arith += 60;
             } else if (call->is_intrinsic(Call::likely) ||
                        call->is_intrinsic(Call::likely_if_innermost)) {
                 // Likely does not result in actual operations.
@@ -431,6 +434,15 @@ Cost RegionCosts::region_cost(const map<string, Box> &regions, const set<string>
 map<string, Expr>
 RegionCosts::stage_detailed_load_costs(string func, int stage,
                                        const set<string> &inlines) {
+    StageInlines key(func, stage, inlines);
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        const auto &iter = inlined_stage_load_costs.find(key);
+        if (iter != inlined_stage_load_costs.end()) {
+            return iter->second;
+        }
+    }
+
     map<string, Expr> load_costs;
     Function curr_f = get_element(env, func);
     Definition def = get_stage_definition(curr_f, stage);
@@ -451,6 +463,10 @@ RegionCosts::stage_detailed_load_costs(string func, int stage,
         }
     }
 
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        inlined_stage_load_costs.emplace(key, load_costs);
+    }
     return load_costs;
 }
 
@@ -554,6 +570,15 @@ Cost RegionCosts::get_func_stage_cost(const Function &f, int stage, const set<st
         return Cost();
     }
 
+    StageInlines key(f.name(), stage, inlines);
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        const auto &iter = inlined_stage_cost.find(key);
+        if (iter != inlined_stage_cost.end()) {
+            return iter->second;
+        }
+    }
+
     Definition def = get_stage_definition(f, stage);
 
     Cost cost(0, 0);
@@ -585,6 +610,10 @@ Cost RegionCosts::get_func_stage_cost(const Function &f, int stage, const set<st
     }
 
     cost.simplify();
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        inlined_stage_cost.emplace(key, cost);
+    }
     return cost;
 }
 
@@ -7,8 +7,10 @@
  * computing some function regions.
  */
 
-#include <set>
 #include <limits>
+#include <mutex>
+#include <set>
+#include <tuple>
 
 #include "AutoScheduleUtils.h"
 #include "Interval.h"
@@ -51,6 +53,19 @@ struct RegionCosts {
      * in the pipeline. */
     Scope<Interval> input_estimates;
 
+    /** Caches of the cost and the detailed load costs of computing a value
+     * in a function stage, when some functions are inlined into it. They are
+     * keyed by the name of the function, the stage, and the names of the
+     * inlined functions. The grouping process asks for the same stages with
+     * the same inlined functions for each tile configuration it considers,
+     * and inlining and simplifying the definitions dominates the cost of the
+     * queries. Guarded by 'cache_mutex', since the auto-scheduler evaluates
+     * the grouping choices in parallel. */
+    typedef std::tuple<std::string, int, std::set<std::string>> StageInlines;
+    std::map<StageInlines, Cost> inlined_stage_cost;
+    std::map<StageInlines, std::map<std::string, Expr>> inlined_stage_load_costs;
+    std::mutex cache_mutex;
+
     /** Return the cost of producing a region (specified by 'bounds') of a
      * function stage (specified by 'func' and 'stage'). 'inlines' specifies
      * names of all the inlined functions. */
@@ -35,6 +35,16 @@ class RemoveDeadAllocations : public IRMutator2 {
         return IRMutator2::visit(op);
     }
 
+    Expr visit(const Variable *op) override {
+        // A direct reference to the allocation, e.g. a semaphore
+        // passed to the runtime.
+        if (allocs.contains(op->name)) {
+            allocs.pop(op->name);
+        }
+
+        return op;
+    }
+
     Stmt visit(const Store *op) override {
         if (allocs.contains(op->name)) {
             allocs.pop(op->name);
@@ -44,6 +54,11 @@ class RemoveDeadAllocations : public IRMutator2 {
     }
 
     Stmt visit(const Allocate *op) override {
+        if (op->new_expr.defined()) {
+            // e.g. the name of an enclosing allocation whose memory
+            // this one reuses.
+            mutate(op->new_expr);
+        }
         allocs.push(op->name, 1);
         Stmt body = mutate(op->body);
 
@@ -53,7 +68,7 @@ class RemoveDeadAllocations : public IRMutator2 {
         } else if (body.same_as(op->body)) {
             return op;
         } else {
-            return Allocate::make(op->name, op->type, op->extents, op->condition, body, op->new_expr, op->free_function);
+            return Allocate::make(op->name, op->type, op->memory_type, op->extents, op->condition, body, op->new_expr, op->free_function);
         }
     }
 
@@ -21,7 +21,8 @@ class RemoveTrivialForLoops : public IRMutator2 {
         if (is_one(for_loop->extent)) {
             if ((for_loop->for_type == ForType::Parallel) ||
                 (for_loop->for_type == ForType::GPUBlock) ||
-                (for_loop->for_type == ForType::GPUThread)) {
+                (for_loop->for_type == ForType::GPUThread) ||
+                (for_loop->for_type == ForType::GPULane)) {
                 std::cerr << "Warning: Parallel for loop over "
                           << for_loop->name << " has extent one. "
                           << "Can't do one piece of work in parallel.\n";
@@ -180,16 +180,26 @@ typedef std::map<FunctionPtr, FunctionPtr> DeepCopyMap;
 struct FuncScheduleContents {
     mutable RefCount ref_count;
 
-    LoopLevel store_level, compute_level;
+    LoopLevel store_level, compute_level, fuse_level;
     std::vector<StorageDim> storage_dims;
     std::vector<Bound> bounds;
     std::vector<Bound> estimates;
     std::map<std::string, Internal::FunctionPtr> wrappers;
     bool memoized;
+    int memoize_eviction_priority;
+    bool async;
+    bool double_buffer;
+    bool store_streaming;
+    bool store_interleaved;
+    MemoryType memory_type;
+    int gpu_max_registers;
 
     FuncScheduleContents() :
         store_level(LoopLevel::inlined()), compute_level(LoopLevel::inlined()),
-        memoized(false) {};
+        fuse_level(LoopLevel::inlined()),
+        memoized(false), memoize_eviction_priority(0), async(false),
+        double_buffer(false), store_streaming(false), store_interleaved(false),
+        memory_type(MemoryType::Auto), gpu_max_registers(0) {};
 
     // Pass an IRMutator2 through to all Exprs referenced in the FuncScheduleContents
     void mutate(IRMutator2 *mutator) {
@@ -246,8 +256,12 @@ struct StageScheduleContents {
     std::vector<PrefetchDirective> prefetches;
     bool touched;
     bool allow_race_conditions;
+    bool atomic;
+    bool override_atomic_associativity_test;
+    std::string distributed;
 
-    StageScheduleContents() : touched(false), allow_race_conditions(false) {};
+    StageScheduleContents() : touched(false), allow_race_conditions(false),
+                              atomic(false), override_atomic_associativity_test(false) {};
 
     // Pass an IRMutator2 through to all Exprs referenced in the StageScheduleContents
     void mutate(IRMutator2 *mutator) {
@@ -292,10 +306,18 @@ FuncSchedule FuncSchedule::deep_copy(
     FuncSchedule copy;
     copy.contents->store_level = contents->store_level;
     copy.contents->compute_level = contents->compute_level;
+    copy.contents->fuse_level = contents->fuse_level;
     copy.contents->storage_dims = contents->storage_dims;
     copy.contents->bounds = contents->bounds;
     copy.contents->estimates = contents->estimates;
     copy.contents->memoized = contents->memoized;
+    copy.contents->memoize_eviction_priority = contents->memoize_eviction_priority;
+    copy.contents->async = contents->async;
+    copy.contents->double_buffer = contents->double_buffer;
+    copy.contents->store_streaming = contents->store_streaming;
+    copy.contents->store_interleaved = contents->store_interleaved;
+    copy.contents->memory_type = contents->memory_type;
+    copy.contents->gpu_max_registers = contents->gpu_max_registers;
 
     // Deep-copy wrapper functions.
     for (const auto &iter : contents->wrappers) {
@@ -315,6 +337,62 @@ bool FuncSchedule::memoized() const {
     return contents->memoized;
 }
 
+bool &FuncSchedule::async() {
+    return contents->async;
+}
+
+bool FuncSchedule::async() const {
+    return contents->async;
+}
+
+bool &FuncSchedule::double_buffer() {
+    return contents->double_buffer;
+}
+
+bool FuncSchedule::double_buffer() const {
+    return contents->double_buffer;
+}
+
+int &FuncSchedule::gpu_max_registers() {
+    return contents->gpu_max_registers;
+}
+
+int FuncSchedule::gpu_max_registers() const {
+    return contents->gpu_max_registers;
+}
+
+bool &FuncSchedule::store_streaming() {
+    return contents->store_streaming;
+}
+
+bool FuncSchedule::store_streaming() const {
+    return contents->store_streaming;
+}
+
+bool &FuncSchedule::store_interleaved() {
+    return contents->store_interleaved;
+}
+
+bool FuncSchedule::store_interleaved() const {
+    return contents->store_interleaved;
+}
+
+MemoryType &FuncSchedule::memory_type() {
+    return contents->memory_type;
+}
+
+MemoryType FuncSchedule::memory_type() const {
+    return contents->memory_type;
+}
+
+int &FuncSchedule::memoize_eviction_priority() {
+    return contents->memoize_eviction_priority;
+}
+
+int FuncSchedule::memoize_eviction_priority() const {
+    return contents->memoize_eviction_priority;
+}
+
 std::vector<StorageDim> &FuncSchedule::storage_dims() {
     return contents->storage_dims;
 }
@@ -376,6 +454,14 @@ const LoopLevel &FuncSchedule::compute_level() const {
     return contents->compute_level;
 }
 
+LoopLevel &FuncSchedule::fuse_level() {
+    return contents->fuse_level;
+}
+
+const LoopLevel &FuncSchedule::fuse_level() const {
+    return contents->fuse_level;
+}
+
 void FuncSchedule::accept(IRVisitor *visitor) const {
     for (const Bound &b : bounds()) {
         if (b.min.defined()) {
@@ -425,6 +511,9 @@ StageSchedule StageSchedule::get_copy() const {
     copy.contents->prefetches = contents->prefetches;
     copy.contents->touched = contents->touched;
     copy.contents->allow_race_conditions = contents->allow_race_conditions;
+    copy.contents->atomic = contents->atomic;
+    copy.contents->override_atomic_associativity_test = contents->override_atomic_associativity_test;
+    copy.contents->distributed = contents->distributed;
     return copy;
 }
 
@@ -476,6 +565,30 @@ bool StageSchedule::allow_race_conditions() const {
     return contents->allow_race_conditions;
 }
 
+bool &StageSchedule::atomic() {
+    return contents->atomic;
+}
+
+bool StageSchedule::atomic() const {
+    return contents->atomic;
+}
+
+bool &StageSchedule::override_atomic_associativity_test() {
+    return contents->override_atomic_associativity_test;
+}
+
+bool StageSchedule::override_atomic_associativity_test() const {
+    return contents->override_atomic_associativity_test;
+}
+
+const std::string &StageSchedule::distributed() const {
+    return contents->distributed;
+}
+
+std::string &StageSchedule::distributed() {
+    return contents->distributed;
+}
+
 void StageSchedule::accept(IRVisitor *visitor) const {
     for (const ReductionVariable &r : rvars()) {
         if (r.min.defined()) {
@@ -63,6 +63,15 @@ enum class TailStrategy {
      * instead of a multiple of the split factor as with RoundUp. */
     ShiftInwards,
 
+    /** Like GuardWithIf, but when the inner loop is vectorized, the
+     * tail case is computed with masked loads and stores instead of
+     * being scalarized. Always legal. Pros: like GuardWithIf, but the
+     * tail stays vectorized. Cons: masked loads and stores are only
+     * fast on targets that have them (AVX-512, SVE, and HVX). Elsewhere
+     * LLVM emulates them a lane at a time, though the arithmetic in the
+     * tail is still vectorized. */
+    Predicate,
+
     /** For pure definitions use ShiftInwards. For pure vars in
      * update definitions use RoundUp. For RVars in update
      * definitions use GuardWithIf. */
@@ -263,7 +272,8 @@ struct Dim {
     bool is_parallel() const {
         return (for_type == ForType::Parallel ||
                 for_type == ForType::GPUBlock ||
-                for_type == ForType::GPUThread);
+                for_type == ForType::GPUThread ||
+                for_type == ForType::GPULane);
     }
 };
 
@@ -277,6 +287,7 @@ struct StorageDim {
     Expr alignment;
     Expr fold_factor;
     bool fold_forward;
+    Expr tile_factor;
 };
 
 struct PrefetchDirective {
@@ -321,6 +332,58 @@ public:
     bool memoized() const;
     // @}
 
+    /** The eviction priority hint passed to the memoization cache
+     * when storing results of this function. Only meaningful if the
+     * schedule is memoized. */
+    // @{
+    int &memoize_eviction_priority();
+    int memoize_eviction_priority() const;
+    // @}
+
+    /** This flag is set to true if the Func is computed in a separate
+     * thread from its consumers. See \ref Func::async */
+    // @{
+    bool &async();
+    bool async() const;
+    // @}
+
+    /** This flag is set to true if the storage of the Func is double
+     * buffered across iterations of the loop it is computed at inside
+     * a GPU block. See \ref Func::double_buffer */
+    // @{
+    bool &double_buffer();
+    bool double_buffer() const;
+    // @}
+
+    /** The maximum number of registers per thread that GPU kernels
+     * launched at this Func's gpu_blocks loops may use, or zero if
+     * the device compiler chooses. See \ref Func::gpu_max_registers */
+    // @{
+    int &gpu_max_registers();
+    int gpu_max_registers() const;
+    // @}
+
+    /** This flag is set to true if the vector stores to the Func
+     * should bypass the caches. See \ref Func::store_streaming */
+    // @{
+    bool &store_streaming();
+    bool store_streaming() const;
+    // @}
+
+    /** This flag is set to true if the elements of the Tuple values
+     * of the Func are stored interleaved in one allocation. See \ref
+     * Func::store_interleaved */
+    // @{
+    bool &store_interleaved();
+    bool store_interleaved() const;
+    // @}
+
+    /** The memory type (heap/stack/shared/etc) used to back this Func. */
+    // @{
+    MemoryType &memory_type();
+    MemoryType memory_type() const;
+    // @}
+
     /** The list and order of dimensions used to store this
      * function. The first dimension in the vector corresponds to the
      * innermost dimension for storage (i.e. which dimension is
@@ -369,6 +432,14 @@ public:
     LoopLevel &compute_level();
     // @}
 
+    /** The loop level of another Func at which the loop nest of this
+     * Func's pure definition is fused with that Func's, or inlined if
+     * it is not fused. See \ref Func::compute_with */
+    // @{
+    const LoopLevel &fuse_level() const;
+    LoopLevel &fuse_level();
+    // @}
+
     /** Pass an IRVisitor through to all Exprs referenced in the
      * Schedule. */
     void accept(IRVisitor *) const;
@@ -442,6 +513,27 @@ public:
     bool &allow_race_conditions();
     // @}
 
+    /** Should the stores to the Func in this stage be atomic? See
+     * \ref Stage::atomic */
+    // @{
+    bool atomic() const;
+    bool &atomic();
+    // @}
+
+    /** Was the check that an atomic update is associative and
+     * commutative switched off? */
+    // @{
+    bool override_atomic_associativity_test() const;
+    bool &override_atomic_associativity_test();
+    // @}
+
+    /** The dimension split across the ranks of a distributed
+     * pipeline, or empty. See \ref Stage::distribute */
+    // @{
+    const std::string &distributed() const;
+    std::string &distributed();
+    // @}
+
     /** Pass an IRVisitor through to all Exprs referenced in the
      * Schedule. */
     void accept(IRVisitor *) const;
@@ -0,0 +1,356 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <regex>
+#include <sstream>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "ScheduleDatabase.h"
+#include "FindCalls.h"
+#include "Func.h"
+#include "IRPrinter.h"
+#include "Util.h"
+
+namespace Halide {
+
+using std::map;
+using std::string;
+using std::vector;
+
+using namespace Internal;
+
+namespace {
+
+void print_definition(std::ostream &stream, const Definition &def) {
+    for (const Expr &e : def.args()) {
+        stream << e << ",";
+    }
+    stream << "=";
+    for (const Expr &e : def.values()) {
+        stream << e << ",";
+    }
+    for (const ReductionVariable &rv : def.schedule().rvars()) {
+        stream << "rvar " << rv.var << "(" << rv.min << ", " << rv.extent << ")";
+    }
+    if (def.predicate().defined()) {
+        stream << " if " << def.predicate();
+    }
+    stream << "\n";
+}
+
+TailStrategy parse_tail_strategy(const string &s) {
+    if (s == "TailStrategy::RoundUp") {
+        return TailStrategy::RoundUp;
+    } else if (s == "TailStrategy::GuardWithIf") {
+        return TailStrategy::GuardWithIf;
+    } else if (s == "TailStrategy::ShiftInwards") {
+        return TailStrategy::ShiftInwards;
+    } else if (s == "TailStrategy::Predicate") {
+        return TailStrategy::Predicate;
+    }
+    user_assert(s == "TailStrategy::Auto") << "Unknown tail strategy in schedule: " << s << "\n";
+    return TailStrategy::Auto;
+}
+
+int parse_int(const string &s) {
+    std::istringstream iss(s);
+    int i;
+    iss >> i;
+    user_assert(!iss.fail() && iss.get() == EOF) << "Unable to parse integer in schedule: " << s << "\n";
+    return i;
+}
+
+string trim(const string &s) {
+    size_t first = s.find_first_not_of(" \t\n\r");
+    if (first == string::npos) {
+        return "";
+    }
+    size_t last = s.find_last_not_of(" \t\n\r");
+    return s.substr(first, last - first + 1);
+}
+
+// Find the loop dimension called 'name' in a stage of 'f' (or in any
+// stage, if 'stage' is negative) to work out whether it is an RVar.
+VarOrRVar find_dim(const Function &f, int stage, const string &name) {
+    vector<const Definition *> defs;
+    if (stage < 0) {
+        // Any stage; the last one is the default for compute_at.
+        for (size_t i = f.updates().size(); i > 0; i--) {
+            defs.push_back(&f.updates()[i - 1]);
+        }
+        defs.push_back(&f.definition());
+    } else {
+        defs.push_back(stage == 0 ? &f.definition() : &f.updates()[stage - 1]);
+    }
+    for (const Definition *def : defs) {
+        for (const Dim &d : def->schedule().dims()) {
+            size_t dot = d.var.rfind('.');
+            string base = (dot == string::npos) ? d.var : d.var.substr(dot + 1);
+            if (base == name) {
+                return VarOrRVar(name, d.is_rvar());
+            }
+        }
+    }
+    return VarOrRVar(name, false);
+}
+
+void apply_directive(Func f, int stage, const string &directive,
+                     const vector<string> &args, const map<string, Func> &funcs) {
+    Function function = f.function();
+    Stage s = (stage == 0) ? Stage(f) : f.update(stage - 1);
+    auto dim = [&](size_t i) {
+        user_assert(i < args.size())
+            << "Too few arguments to " << directive << " in schedule of " << f.name() << "\n";
+        return find_dim(function, stage, args[i]);
+    };
+    auto dims = [&]() {
+        vector<VarOrRVar> result;
+        for (size_t i = 0; i < args.size(); i++) {
+            result.push_back(dim(i));
+        }
+        return result;
+    };
+
+    if (directive == "compute_root") {
+        user_assert(stage == 0) << "compute_root applies to the whole function " << f.name() << "\n";
+        f.compute_root();
+    } else if (directive == "compute_at" || directive == "store_at") {
+        user_assert(stage == 0 && args.size() == 2)
+            << "Malformed " << directive << " in schedule of " << f.name() << "\n";
+        auto parent = funcs.find(args[0]);
+        user_assert(parent != funcs.end())
+            << directive << " of " << f.name() << " refers to unknown function " << args[0] << "\n";
+        LoopLevel level(parent->second, find_dim(parent->second.function(), -1, args[1]));
+        if (directive == "compute_at") {
+            f.compute_at(level);
+        } else {
+            f.store_at(level);
+        }
+    } else if (directive == "split") {
+        user_assert(args.size() == 4 || args.size() == 5)
+            << "Malformed split in schedule of " << f.name() << "\n";
+        VarOrRVar old = dim(0);
+        VarOrRVar outer(args[1], old.is_rvar), inner(args[2], old.is_rvar);
+        TailStrategy tail = args.size() == 5 ? parse_tail_strategy(args[4]) : TailStrategy::Auto;
+        s.split(old, outer, inner, parse_int(args[3]), tail);
+    } else if (directive == "reorder") {
+        s.reorder(dims());
+    } else if (directive == "vectorize") {
+        if (args.size() == 2) {
+            s.vectorize(dim(0), parse_int(args[1]));
+        } else {
+            s.vectorize(dim(0));
+        }
+    } else if (directive == "unroll") {
+        if (args.size() == 2) {
+            s.unroll(dim(0), parse_int(args[1]));
+        } else {
+            s.unroll(dim(0));
+        }
+    } else if (directive == "parallel") {
+        s.parallel(dim(0));
+    } else if (directive == "gpu_threads" || directive == "gpu_blocks") {
+        vector<VarOrRVar> v = dims();
+        user_assert(!v.empty() && v.size() <= 3)
+            << "Malformed " << directive << " in schedule of " << f.name() << "\n";
+        bool threads = directive == "gpu_threads";
+        for (const VarOrRVar &d : v) {
+            if (threads) {
+                s.gpu_threads(d);
+            } else {
+                s.gpu_blocks(d);
+            }
+        }
+    } else if (directive == "gpu_single_thread") {
+        s.gpu_single_thread();
+    } else if (directive == "hexagon") {
+        if (args.empty()) {
+            s.hexagon();
+        } else {
+            s.hexagon(dim(0));
+        }
+    } else {
+        user_error << "Unsupported directive " << directive << " in schedule of " << f.name() << "\n";
+    }
+}
+
+}  // namespace
+
+string pipeline_fingerprint(Pipeline p, const Target &target) {
+    map<string, Function> env;
+    for (Func f : p.outputs()) {
+        map<string, Function> more_funcs = find_transitive_calls(f.function());
+        env.insert(more_funcs.begin(), more_funcs.end());
+    }
+
+    std::ostringstream stream;
+    stream << target.to_string() << "\n";
+    for (Func f : p.outputs()) {
+        stream << "output " << f.name() << "\n";
+    }
+    for (const auto &iter : env) {
+        const Function &f = iter.second;
+        stream << "func " << f.name() << "(";
+        for (const string &arg : f.args()) {
+            stream << arg << ",";
+        }
+        stream << ")";
+        for (const Type &t : f.output_types()) {
+            stream << " " << t;
+        }
+        stream << "\n";
+        if (f.has_extern_definition()) {
+            stream << "extern " << f.extern_function_name() << "\n";
+        } else {
+            print_definition(stream, f.definition());
+            for (const Definition &u : f.updates()) {
+                print_definition(stream, u);
+            }
+        }
+        for (const Bound &b : f.schedule().estimates()) {
+            stream << "estimate " << b.var << "(" << b.min << ", " << b.extent << ")\n";
+        }
+    }
+
+    string s = stream.str();
+    std::ostringstream key;
+    key << std::hex << std::setfill('0')
+        << std::setw(16) << stable_hash(s)
+        << std::setw(16) << stable_hash(s, 0x84222325cbf29ce4ULL);
+    return key.str();
+}
+
+void apply_schedule(Pipeline p, const string &schedule) {
+    // Drop the comments and the braces around the schedule of each
+    // function, and split the rest into statements.
+    string text;
+    for (const string &line : split_string(schedule, "\n")) {
+        string l = trim(line);
+        if (!starts_with(l, "//")) {
+            text += l + " ";
+        }
+    }
+    text.erase(std::remove(text.begin(), text.end(), '{'), text.end());
+    text.erase(std::remove(text.begin(), text.end(), '}'), text.end());
+
+    static const std::regex func_decl(R"(Func\s+(\w+)\s*=\s*pipeline\.get_func\((\d+)\))");
+    static const std::regex rfactor_decl(
+        R"(Func\s+(\w+)\s*=\s*(\w+)\s*\.\s*update\((\d+)\)\s*\.\s*rfactor\(([^()]*)\))");
+    static const std::regex call(R"(\.\s*(\w+)\s*\(([^()]*)\))");
+
+    map<string, Func> funcs;
+    for (const string &statement : split_string(text, ";")) {
+        string stmt = trim(statement);
+        std::smatch match;
+        if (stmt.empty() || starts_with(stmt, "Var ") || starts_with(stmt, "RVar ")) {
+            // The Vars and RVars are found by name in the stages
+            // they are used in.
+            continue;
+        } else if (std::regex_match(stmt, match, func_decl)) {
+            funcs[match[1]] = p.get_func(parse_int(match[2]));
+            continue;
+        } else if (std::regex_match(stmt, match, rfactor_decl)) {
+            // An intermediate created by rfactor. The braces around the
+            // pairs of RVars and Vars have been dropped.
+            auto f = funcs.find(match[2]);
+            user_assert(f != funcs.end())
+                << "rfactor of unknown function " << match[2] << "\n";
+            int stage = parse_int(match[3]) + 1;
+            vector<string> args;
+            for (const string &arg : split_string(match[4], ",")) {
+                if (!trim(arg).empty()) {
+                    args.push_back(trim(arg));
+                }
+            }
+            user_assert(!args.empty() && args.size() % 2 == 0)
+                << "Malformed rfactor in schedule: " << stmt << "\n";
+            vector<std::pair<RVar, Var>> preserved;
+            for (size_t i = 0; i < args.size(); i += 2) {
+                preserved.push_back({RVar(args[i]), Var(args[i + 1])});
+            }
+            funcs[match[1]] = f->second.update(stage - 1).rfactor(preserved);
+            continue;
+        }
+
+        // A chain of directives applied to a stage of a function.
+        user_assert(stmt.find(".specialize(") == string::npos)
+            << "Schedules with specializations can't be applied from their string "
+            << "representation: " << stmt << "\n";
+        size_t dot = stmt.find('.');
+        string name = trim(stmt.substr(0, dot));
+        auto f = funcs.find(name);
+        user_assert(dot != string::npos && f != funcs.end())
+            << "Unable to parse schedule statement: " << stmt << "\n";
+
+        int stage = 0;
+        string rest = stmt.substr(dot);
+        for (auto it = std::sregex_iterator(rest.begin(), rest.end(), call);
+             it != std::sregex_iterator(); ++it) {
+            string directive = (*it)[1];
+            vector<string> args;
+            for (const string &arg : split_string((*it)[2], ",")) {
+                if (!trim(arg).empty()) {
+                    args.push_back(trim(arg));
+                }
+            }
+            if (directive == "update") {
+                user_assert(args.size() == 1) << "Malformed update in schedule: " << stmt << "\n";
+                stage = parse_int(args[0]) + 1;
+            } else {
+                apply_directive(f->second, stage, directive, args, funcs);
+            }
+        }
+    }
+}
+
+ScheduleDatabase::ScheduleDatabase(const string &dir) : dir(dir) {}
+
+string ScheduleDatabase::path_for(const string &fingerprint) const {
+    return dir + "/" + fingerprint + ".schedule";
+}
+
+string ScheduleDatabase::lookup(const string &fingerprint) const {
+    std::ifstream file(path_for(fingerprint));
+    if (!file) {
+        debug(2) << "Schedule database miss for " << path_for(fingerprint) << "\n";
+        return "";
+    }
+    debug(1) << "Schedule database hit for " << path_for(fingerprint) << "\n";
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+void ScheduleDatabase::store(const string &fingerprint, const string &schedule) const {
+    #ifdef _WIN32
+    _mkdir(dir.c_str());
+    #else
+    mkdir(dir.c_str(), 0755);
+    #endif
+
+    // Write to a temporary file and rename it into place, so that other
+    // processes never see a partial entry.
+    string path = path_for(fingerprint);
+    string tmp_path = path + "." + unique_name('t') + ".tmp";
+    {
+        std::ofstream file(tmp_path);
+        user_assert(file) << "Could not write to the schedule database " << dir << "\n";
+        file << schedule;
+    }
+    #ifdef _WIN32
+    // rename doesn't replace an existing file on windows.
+    std::remove(path.c_str());
+    #endif
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+    }
+}
+
+}
@@ -0,0 +1,54 @@
+#ifndef HALIDE_SCHEDULE_DATABASE_H
+#define HALIDE_SCHEDULE_DATABASE_H
+
+/** \file
+ *
+ * Defines a database of schedules for pipelines, keyed by a structural
+ * hash of the algorithm being scheduled.
+ */
+
+#include "Pipeline.h"
+
+namespace Halide {
+
+/** Compute a structural hash of a pipeline and a target. It depends
+ * on the definitions of all the Funcs the pipeline calls and on the
+ * estimates of their bounds, but not on their schedules, so it must
+ * be computed before the pipeline is auto-scheduled (the
+ * auto-scheduler may inline trivial Funcs into their callers). Funcs,
+ * Vars and RDoms should have explicit names for the hash to be the
+ * same across programs that build the pipeline differently. */
+EXPORT std::string pipeline_fingerprint(Pipeline p, const Target &target);
+
+/** Apply a schedule of the form returned by Pipeline::auto_schedule
+ * to a pipeline that has no schedule yet. The pipeline must have the
+ * same algorithm as the one the schedule was generated for. Schedules
+ * specialized for several output shapes can't be applied. */
+EXPORT void apply_schedule(Pipeline p, const std::string &schedule);
+
+/** A database of schedules, stored as one file per pipeline
+ * fingerprint in a directory. When the environment variable
+ * HL_SCHEDULE_DATABASE names a directory, Generators that are
+ * auto-scheduled look up the schedule of their pipeline there and
+ * apply it without running the auto-scheduler. On a miss, they
+ * auto-schedule the pipeline and store the result. */
+class ScheduleDatabase {
+    std::string dir;
+
+    std::string path_for(const std::string &fingerprint) const;
+
+public:
+    EXPORT explicit ScheduleDatabase(const std::string &dir);
+
+    /** Get the schedule stored for a fingerprint. Returns an empty
+     * string if there is none. */
+    EXPORT std::string lookup(const std::string &fingerprint) const;
+
+    /** Store a schedule for a fingerprint, replacing any previous
+     * one. */
+    EXPORT void store(const std::string &fingerprint, const std::string &schedule) const;
+};
+
+}
+
+#endif
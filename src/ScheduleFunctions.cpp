@@ -1,4 +1,5 @@
 #include "ScheduleFunctions.h"
+#include "Bounds.h"
 #include "IROperator.h"
 #include "Simplify.h"
 #include "Substitute.h"
@@ -75,6 +76,9 @@ Stmt build_provide_loop_nest_helper(string func_name,
 
     // Make the (multi-dimensional multi-valued) store node.
     Stmt stmt = Provide::make(func_name, values, site);
+    if (stage_s.atomic()) {
+        stmt = Atomic::make(func_name, stmt);
+    }
 
     // A map of the dimensions for which we know the extent is a
     // multiple of some Expr. This can happen due to a bound, or
@@ -211,6 +215,18 @@ Stmt build_provide_loop_nest_helper(string func_name,
             const Dim &dim = stage_s.dims()[nest[i].dim_idx];
             Expr min = Variable::make(Int(32), nest[i].name + ".loop_min");
             Expr extent = Variable::make(Int(32), nest[i].name + ".loop_extent");
+            if (dim.var == stage_s.distributed()) {
+                // Only run over this rank's slice of the loop. If
+                // there are more ranks than iterations, the extra
+                // ranks redundantly run the last iteration, so that
+                // no slice is empty.
+                Expr rank = Variable::make(Int(32), "__distributed_rank");
+                Expr num_ranks = Variable::make(Int(32), "__distributed_num_ranks");
+                Expr slice = (extent + num_ranks - 1) / num_ranks;
+                Expr start = Min::make(rank * slice, extent - 1);
+                min = min + start;
+                extent = Min::make(slice, extent - start);
+            }
             stmt = For::make(nest[i].name, min, extent, dim.for_type, dim.device_api, stmt);
         }
     }
@@ -319,6 +335,131 @@ Stmt build_provide_loop_nest(string func_name,
     return stmt;
 }
 
+// The dimensions of an extern stage that are covered by each call to
+// the extern function: the innermost serial dims, up to the first one
+// that's parallel, the outer part of a split, or the dummy outermost
+// dim. Any dims from there outwards are loops around the call. If the
+// stage hasn't been split or given a non-serial loop, every dim is
+// covered, and the extern function is called once.
+set<string> extern_stage_covered_dims(Function f) {
+    internal_assert(f.has_extern_definition());
+    const string prefix = f.name() + ".s0.";
+    const StageSchedule &sched = f.definition().schedule();
+    set<string> split_outers;
+    for (const Split &split : sched.splits()) {
+        if (split.is_split()) {
+            split_outers.insert(split.outer);
+        } else if (split.is_fuse()) {
+            split_outers.insert(split.old_var);
+        }
+    }
+    set<string> covered;
+    for (const Dim &d : sched.dims()) {
+        if (d.for_type != ForType::Serial ||
+            split_outers.count(d.var) ||
+            d.var == Var::outermost().name()) {
+            break;
+        }
+        covered.insert(prefix + d.var);
+    }
+    return covered;
+}
+
+bool extern_stage_is_tiled(Function f) {
+    return f.has_extern_definition() &&
+        extern_stage_covered_dims(f).size() < f.args().size();
+}
+
+// Replace the loops over the covered dims of a tiled extern stage's
+// loop nest with a single call to the extern function over the tile
+// they cover. The call crops the output buffer to the region given by
+// the vars f.s0.<arg>.tile_min and f.s0.<arg>.tile_max, which this
+// defines from the bounds of the pure args over the covered loops.
+class InjectExternTiles : public IRMutator2 {
+    using IRMutator2::visit;
+
+    const set<string> &covered;
+    Stmt call;
+    string prefix;
+    vector<string> args;
+    Scope<Interval> scope;
+
+    Stmt visit(const For *op) override {
+        if (!covered.count(op->name)) {
+            return IRMutator2::visit(op);
+        }
+        Interval i(op->min, simplify(op->min + op->extent - 1));
+        ScopedBinding<Interval> bind(scope, op->name, i);
+        return mutate(op->body);
+    }
+
+    Stmt visit(const LetStmt *op) override {
+        if (!expr_uses_vars(op->value, scope)) {
+            return IRMutator2::visit(op);
+        }
+        // Lets of the covered vars are replaced by their bounds.
+        ScopedBinding<Interval> bind(scope, op->name, bounds_of_expr_in_scope(op->value, scope));
+        return mutate(op->body);
+    }
+
+    Stmt visit(const IfThenElse *op) override {
+        // The tail of a split guarded with an if is clamped away
+        // below instead.
+        if (!op->else_case.defined() && expr_uses_vars(op->condition, scope)) {
+            return mutate(op->then_case);
+        }
+        return IRMutator2::visit(op);
+    }
+
+    Stmt visit(const Provide *op) override {
+        Stmt s = call;
+        internal_assert(op->args.size() == args.size());
+        for (size_t i = 0; i < args.size(); i++) {
+            string var = prefix + args[i];
+            Interval b = bounds_of_expr_in_scope(op->args[i], scope);
+            user_assert(b.is_bounded())
+                << "Could not compute the region of each call to the extern stage over "
+                << var << "\n";
+            // Tiles may overhang the region being computed, so clamp them.
+            Expr min = Max::make(b.min, Variable::make(Int(32), var + ".min"));
+            Expr max = Min::make(b.max, Variable::make(Int(32), var + ".max"));
+            s = LetStmt::make(var + ".tile_max", simplify(max), s);
+            s = LetStmt::make(var + ".tile_min", simplify(min), s);
+        }
+        return s;
+    }
+
+public:
+    InjectExternTiles(const set<string> &covered, Stmt call, const string &prefix, const vector<string> &args)
+        : covered(covered), call(call), prefix(prefix), args(args) {}
+};
+
+Stmt build_extern_tile_loops(Function f, Stmt call) {
+    const string prefix = f.name() + ".s0.";
+    const StageSchedule &sched = f.definition().schedule();
+    set<string> covered = extern_stage_covered_dims(f);
+    for (const Dim &d : sched.dims()) {
+        user_assert(d.for_type == ForType::Serial ||
+                    d.for_type == ForType::Parallel ||
+                    d.for_type == ForType::Unrolled)
+            << "The loop over " << d.var << " of extern stage " << f.name()
+            << " is " << d.for_type << ". The loops around the calls to an extern"
+            << " function may only be serial, parallel, or unrolled.\n";
+        user_assert(d.device_api == DeviceAPI::None || d.device_api == DeviceAPI::Host)
+            << "The loops of extern stage " << f.name() << " can't run on a device.\n";
+    }
+
+    // Build the loop nest as if the stage were a pure definition of
+    // its args, then collapse the covered loops into the call.
+    vector<Expr> site;
+    for (const string &arg : f.args()) {
+        site.push_back(Variable::make(Int(32), prefix + arg));
+    }
+    Stmt nest = build_provide_loop_nest_helper(f.name(), prefix, f.args(), site, {make_zero(Int(32))},
+                                               {}, f.schedule(), sched, false);
+    return InjectExternTiles(covered, call, prefix, f.args()).mutate(nest);
+}
+
 // Turn a function into a loop nest that computes it. It will
 // refer to external vars of the form function_name.arg_name.min
 // and function_name.arg_name.extent to define the bounds over
@@ -437,7 +578,10 @@ Stmt build_produce(Function f, const Target &target) {
         // it's the output to the pipeline then it will similarly be
         // in the symbol table.
         vector<pair<Expr, Expr>> cropped_buffers;
-        if (f.schedule().store_level() == f.schedule().compute_level()) {
+        // If the stage is tiled, each call gets a crop of the output
+        // to its tile.
+        const bool tiled = extern_stage_is_tiled(f);
+        if (f.schedule().store_level() == f.schedule().compute_level() && !tiled) {
             for (int j = 0; j < f.outputs(); j++) {
                 string buf_name = f.name();
                 if (f.outputs() > 1) {
@@ -477,8 +621,8 @@ Stmt build_produce(Function f, const Target &target) {
                 internal_assert(f.dimensions() == (int)f.args().size());
                 for (const string arg : f.args()) {
                     string var = stage_name + arg;
-                    Expr min = Variable::make(Int(32), var + ".min");
-                    Expr max = Variable::make(Int(32), var + ".max");
+                    Expr min = Variable::make(Int(32), var + (tiled ? ".tile_min" : ".min"));
+                    Expr max = Variable::make(Int(32), var + (tiled ? ".tile_max" : ".max"));
                     mins.push_back(min);
                     extents.push_back(max - min + 1);
                 }
@@ -574,7 +718,7 @@ Stmt build_produce(Function f, const Target &target) {
             const char *fn = (cropped_buffers.size() == 1 ?
                               "_halide_buffer_retire_crop_after_extern_stage" :
                               "_halide_buffer_retire_crops_after_extern_stage");
-            check = Allocate::make(destructor_name, Handle(), {},
+            check = Allocate::make(destructor_name, Handle(), MemoryType::Auto, {},
                                    const_true(), check, cleanup_struct, fn);
         }
 
@@ -586,6 +730,10 @@ Stmt build_produce(Function f, const Target &target) {
             check = Block::make(annotate, check);
         }
 
+        if (tiled) {
+            return build_extern_tile_loops(f, check);
+        }
+
         // Add the dummy outermost loop.
         string outermost = f.name() + ".s0." + Var::outermost().name();
         check = For::make(outermost, 0, 1, ForType::Serial, DeviceAPI::None, check);
@@ -626,6 +774,121 @@ pair<Stmt, Stmt> build_production(Function func, const Target &target) {
     return { produce, merged_updates };
 }
 
+// The names of the loops of the pure definition of f that are fused
+// with another Func's, outermost first. Only meaningful once
+// validate_fused_group has checked the schedules involved.
+vector<string> fused_loop_names(Function f, size_t fused_dims) {
+    const vector<Dim> &dims = f.definition().schedule().dims();
+    internal_assert(fused_dims <= dims.size());
+    vector<string> names;
+    for (size_t i = dims.size(); i > dims.size() - fused_dims; i--) {
+        names.push_back(f.name() + ".s0." + dims[i-1].var);
+    }
+    return names;
+}
+
+// Replace the fused loops of a Func's loop nest with the loops they
+// are fused with. The Func the rest are fused into just loses its
+// loops, as the shared loops use its loop variables. The others get
+// a let defining each of their loop variables instead.
+class ReplaceFusedLoops : public IRMutator2 {
+    const map<string, string> &replacements;
+
+    using IRMutator2::visit;
+
+    Stmt visit(const For *op) override {
+        auto it = replacements.find(op->name);
+        if (it == replacements.end()) {
+            return IRMutator2::visit(op);
+        }
+        Stmt body = mutate(op->body);
+        if (it->second == op->name) {
+            return body;
+        }
+        return LetStmt::make(op->name, Variable::make(Int(32), it->second), body);
+    }
+
+public:
+    ReplaceFusedLoops(const map<string, string> &r) : replacements(r) {}
+};
+
+// Peel the lets defining the loop bounds off the top of a loop nest.
+Stmt peel_lets(Stmt s, vector<pair<string, Expr>> &lets) {
+    while (const LetStmt *let = s.as<LetStmt>()) {
+        lets.push_back({ let->name, let->value });
+        s = let->body;
+    }
+    return s;
+}
+
+// Build the loop nest computing the pure definition of parent
+// together with the pure definitions of the Funcs fused with it (see
+// Func::compute_with). The outermost fused_dims loops are shared, and
+// span the union of the loop bounds of every Func. Within them, the
+// body of each Func is guarded by its own loop bounds, so each one
+// computes exactly what it would have alone:
+//
+// for parent.s0.y in union of the y loops:
+//   if (parent.s0.y in parent's y loop) { rest of parent }
+//   produce child {
+//     let child.s0.y = parent.s0.y
+//     if (child.s0.y in child's y loop) { rest of child }
+//   }
+Stmt build_fused_produce(Function parent, const vector<Function> &children,
+                         size_t fused_dims, const Target &target) {
+    vector<string> loops = fused_loop_names(parent, fused_dims);
+
+    vector<pair<string, Expr>> lets;
+    vector<Stmt> bodies;
+    vector<Expr> union_min(fused_dims), union_max(fused_dims);
+    vector<Function> members = children;
+    members.insert(members.begin(), parent);
+    for (const Function &f : members) {
+        vector<string> own_loops = fused_loop_names(f, fused_dims);
+        map<string, string> replacements;
+        for (size_t i = 0; i < fused_dims; i++) {
+            replacements[own_loops[i]] = loops[i];
+        }
+
+        Stmt body = peel_lets(build_produce(f, target), lets);
+        body = ReplaceFusedLoops(replacements).mutate(body);
+
+        // Guard each bound separately, as that is the form bounds
+        // inference can use to trim the region touched. The
+        // outermost loop is the dummy loop over __outermost, which
+        // always has a single iteration.
+        for (size_t i = fused_dims; i > 0; i--) {
+            Expr loop_var = Variable::make(Int(32), loops[i-1]);
+            Expr loop_min = Variable::make(Int(32), own_loops[i-1] + ".loop_min");
+            Expr loop_max = Variable::make(Int(32), own_loops[i-1] + ".loop_max");
+            if (i > 1) {
+                body = IfThenElse::make(likely(loop_var <= loop_max), body);
+                body = IfThenElse::make(likely(loop_var >= loop_min), body);
+            }
+            union_min[i-1] = union_min[i-1].defined() ? min(union_min[i-1], loop_min) : loop_min;
+            union_max[i-1] = union_max[i-1].defined() ? max(union_max[i-1], loop_max) : loop_max;
+        }
+
+        if (!f.same_as(parent)) {
+            body = ProducerConsumer::make_produce(f.name(), body);
+        }
+        bodies.push_back(body);
+    }
+
+    Stmt stmt = Block::make(bodies);
+    const vector<Dim> &dims = parent.definition().schedule().dims();
+    for (size_t i = fused_dims; i > 0; i--) {
+        const Dim &dim = dims[dims.size() - i];
+        stmt = For::make(loops[i-1], union_min[i-1], (union_max[i-1] + 1) - union_min[i-1],
+                         dim.for_type, dim.device_api, stmt);
+    }
+
+    for (size_t i = lets.size(); i > 0; i--) {
+        stmt = LetStmt::make(lets[i-1].first, lets[i-1].second, stmt);
+    }
+    return stmt;
+}
+
 // A schedule may include explicit bounds on some dimension. This
 // injects assertions that check that those bounds are sufficiently
 // large to cover the inferred bounds required.
@@ -701,6 +964,12 @@ public:
     bool is_output, found_store_level, found_compute_level;
     const Target &target;
 
+    // The Funcs fused with func, which are realized along with it,
+    // and the number of loops they share with it.
+    vector<Function> fused;
+    vector<bool> fused_is_output;
+    size_t fused_dims = 0;
+
     InjectRealization(const Function &f, bool o, const Target &t) :
         func(f), is_output(o),
         found_store_level(false), found_compute_level(false),
@@ -710,8 +979,25 @@ private:
 
     string producing;
 
+    bool is_used_in_stmt(Stmt s) {
+        if (function_is_used_in_stmt(func, s) || is_output) {
+            return true;
+        }
+        for (size_t i = 0; i < fused.size(); i++) {
+            if (function_is_used_in_stmt(fused[i], s) || fused_is_output[i]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     Stmt build_pipeline(Stmt consumer) {
-        pair<Stmt, Stmt> realization = build_production(func, target);
+        pair<Stmt, Stmt> realization;
+        if (fused.empty()) {
+            realization = build_production(func, target);
+        } else {
+            realization.first = build_fused_produce(func, fused, fused_dims, target);
+        }
 
         Stmt producer;
         if (realization.first.defined() && realization.second.defined()) {
@@ -725,6 +1011,11 @@ private:
         producer = ProducerConsumer::make_produce(func.name(), producer);
 
         // Outputs don't have consume nodes
+        for (size_t i = fused.size(); i > 0; i--) {
+            if (!fused_is_output[i-1]) {
+                consumer = ProducerConsumer::make_consume(fused[i-1].name(), consumer);
+            }
+        }
         if (!is_output) {
             consumer = ProducerConsumer::make_consume(func.name(), consumer);
         }
@@ -738,7 +1029,7 @@ private:
         }
     }
 
-    Stmt build_realize(Stmt s) {
+    Stmt build_realize(Stmt s, const Function &func, bool is_output) {
         if (!is_output) {
             Region bounds;
             string name = func.name();
@@ -750,7 +1041,7 @@ private:
                 bounds.push_back(Range(min, extent));
             }
 
-            s = Realize::make(name, func.output_types(), bounds, const_true(), s);
+            s = Realize::make(name, func.output_types(), func.schedule().memory_type(), bounds, const_true(), s);
         }
 
         // This is also the point at which we inject explicit bounds
@@ -762,6 +1053,13 @@ private:
         }
     }
 
+    Stmt build_realize(Stmt s) {
+        for (size_t i = fused.size(); i > 0; i--) {
+            s = build_realize(s, fused[i-1], fused_is_output[i-1]);
+        }
+        return build_realize(s, func, is_output);
+    }
+
     using IRMutator2::visit;
 
     Stmt visit(const ProducerConsumer *op) override {
@@ -822,7 +1120,7 @@ private:
 
         if (compute_level.match(for_loop->name)) {
             debug(3) << "Found compute level\n";
-            if (function_is_used_in_stmt(func, body) || is_output) {
+            if (is_used_in_stmt(body)) {
                 body = build_pipeline(body);
             }
             found_compute_level = true;
@@ -833,7 +1131,7 @@ private:
             internal_assert(found_compute_level)
                 << "The compute loop level was not found within the store loop level!\n";
 
-            if (function_is_used_in_stmt(func, body) || is_output) {
+            if (is_used_in_stmt(body)) {
                 body = build_realize(body);
             }
 
@@ -1095,6 +1393,18 @@ bool validate_schedule(Function f, Stmt s, const Target &target, bool is_output,
         }
     }
 
+    // Only the outputs can be distributed. Each rank computes all of
+    // the earlier stages that its slice of the outputs needs.
+    if (!is_output) {
+        bool distributed = !f.definition().schedule().distributed().empty();
+        for (const Definition &r : f.updates()) {
+            distributed = distributed || !r.schedule().distributed().empty();
+        }
+        user_assert(!distributed)
+            << "Func " << f.name() << " is distributed, but it isn't an output "
+            << "of the pipeline. Only the outputs can be distributed.\n";
+    }
+
     // Emit a warning if only some of the steps have been scheduled.
     bool any_scheduled = f.definition().schedule().touched();
     for (const Definition &r : f.updates()) {
@@ -1144,6 +1454,78 @@ bool validate_schedule(Function f, Stmt s, const Target &target, bool is_output,
     LoopLevel store_at = f.schedule().store_level();
     LoopLevel compute_at = f.schedule().compute_level();
 
+    // Each call to a tiled extern stage gets its whole input, so
+    // nothing can be computed per tile.
+    for (const LoopLevel &l : {store_at, compute_at}) {
+        if (l.is_inlined() || l.is_root()) {
+            continue;
+        }
+        auto it = env.find(l.func());
+        user_assert(it == env.end() ||
+                    !it->second.has_extern_definition() ||
+                    l.var().name() == Var::outermost().name())
+            << "Func " << f.name() << " is scheduled at " << l.to_string()
+            << ", which is a loop of the extern stage " << l.func()
+            << ". Funcs can only be computed outside of an extern stage.\n";
+    }
+
+    if (f.schedule().async()) {
+        user_assert(!is_output)
+            << "Func " << f.name() << " is an output, so it can't be scheduled async.\n";
+        user_assert(!compute_at.is_inlined())
+            << "Func " << f.name() << " is scheduled async, so it can't be inlined.\n";
+        user_assert(f.schedule().fuse_level().is_inlined())
+            << "Func " << f.name() << " is scheduled async, so it can't be "
+            << "computed with another Func.\n";
+    }
+
+    if (f.schedule().double_buffer()) {
+        user_assert(!is_output)
+            << "Func " << f.name() << " is an output, so it can't be scheduled double_buffer.\n";
+        user_assert(!compute_at.is_inlined())
+            << "Func " << f.name() << " is scheduled double_buffer, so it can't be inlined.\n";
+        user_assert(!f.schedule().async())
+            << "Func " << f.name() << " can't be scheduled both async and double_buffer.\n";
+    }
+
+    user_assert(!f.schedule().store_streaming() || is_output || !compute_at.is_inlined())
+        << "Func " << f.name() << " is scheduled store_streaming, so it can't be inlined.\n";
+
+    if (f.schedule().store_interleaved() && f.outputs() > 1) {
+        user_assert(!is_output)
+            << "Func " << f.name() << " is an output, so its Tuple can't be stored interleaved.\n";
+        user_assert(!f.has_extern_definition())
+            << "Func " << f.name() << " is defined by an extern stage, so its Tuple can't be stored interleaved.\n";
+        for (Type t : f.output_types()) {
+            user_assert(t == f.output_types()[0])
+                << "Func " << f.name() << " is scheduled store_interleaved, but the elements of its "
+                << "Tuple have different types (" << f.output_types()[0] << " and " << t << ").\n";
+        }
+        user_assert(!f.schedule().memoized())
+            << "Func " << f.name() << " is memoized, so its Tuple can't be stored interleaved.\n";
+        user_assert(f.debug_file().empty())
+            << "Func " << f.name() << " is dumped with debug_to_file, so its Tuple can't be stored interleaved.\n";
+        for (const StorageDim &d : f.schedule().storage_dims()) {
+            user_assert(!d.tile_factor.defined())
+                << "Func " << f.name() << " has tiled storage, so its Tuple can't be stored interleaved.\n";
+        }
+        for (const auto &i : env) {
+            const Function &g = i.second;
+            if (!g.has_extern_definition()) {
+                continue;
+            }
+            for (const ExternFuncArgument &arg : g.extern_arguments()) {
+                user_assert(!arg.is_func() || Function(arg.func).name() != f.name())
+                    << "Func " << f.name() << " is an input to the extern stage "
+                    << g.name() << ", so its Tuple can't be stored interleaved.\n";
+            }
+        }
+    }
+
+    user_assert(!is_output || f.schedule().memory_type() == MemoryType::Auto)
+        << "Func " << f.name() << " is an output, so its storage is provided by the caller, "
+        << "and it can't be scheduled with store_in.\n";
+
     // Outputs must be compute_root and store_root. They're really
     // store_in_user_code, but store_root is close enough.
     if (is_output) {
@@ -1196,6 +1578,13 @@ bool validate_schedule(Function f, Stmt s, const Target &target, bool is_output,
     if (store_at_ok && compute_at_ok) {
         for (size_t i = store_idx + 1; i <= compute_idx; i++) {
             if (sites[i].is_parallel) {
+                // The async fork happens at the store level, so both
+                // halves would run every iteration of this loop at once.
+                user_assert(!f.schedule().async())
+                    << "Func " << f.name() << " is scheduled async, so there can't be "
+                    << "a parallel, vectorized, or GPU loop between its store_at and "
+                    << "compute_at levels, but " << sites[i].loop_level.to_string()
+                    << " lies between them.\n";
                 err << "Func \"" << f.name()
                     << "\" is stored outside the parallel loop over "
                     << sites[i].loop_level.to_string()
@@ -1205,6 +1594,12 @@ bool validate_schedule(Function f, Stmt s, const Target &target, bool is_output,
         }
     }
 
+    if (store_at_ok && compute_at_ok && f.schedule().double_buffer() && store_idx == compute_idx) {
+        err << "Func \"" << f.name() << "\" is scheduled double_buffer, "
+            << "so it must be stored outside the loop it is computed at.\n";
+        store_at_ok = compute_at_ok = false;
+    }
+
     if (!store_at_ok || !compute_at_ok) {
         err << "Func \"" << f.name() << "\" is computed at the following invalid location:\n"
             << "  " << schedule_to_source(f, store_at, compute_at) << "\n"
@@ -1246,6 +1641,89 @@ class RemoveLoopsOverOutermost : public IRMutator2 {
     }
 };
 
+// Check that the Funcs fused with parent (see Func::compute_with) can
+// be, throwing an error if not. Returns the number of loops they
+// share, counting the dummy loop over __outermost.
+size_t validate_fused_group(Function parent, const vector<Function> &children,
+                            const map<string, Function> &env) {
+    const FuncSchedule &ps = parent.schedule();
+    const vector<Dim> &dims = parent.definition().schedule().dims();
+
+    vector<Function> members = children;
+    members.insert(members.begin(), parent);
+    for (const Function &f : members) {
+        user_assert(!f.has_extern_definition() && f.updates().empty() &&
+                    f.definition().specializations().empty() && !f.schedule().memoized() &&
+                    !f.schedule().async())
+            << "Func " << f.name() << " cannot be computed with another Func, "
+            << "because only Funcs with a single pure definition, no specializations, "
+            << "and that are neither memoized nor async can be fused.\n";
+        user_assert(!f.schedule().compute_level().is_inlined())
+            << "Func " << f.name() << " is computed with another Func, "
+            << "so it cannot be inlined.\n";
+    }
+
+    for (const Function &child : children) {
+        user_assert(child.schedule().compute_level() == ps.compute_level() &&
+                    child.schedule().store_level() == ps.store_level())
+            << "Func " << child.name() << " is computed with " << parent.name()
+            << ", so they must be computed and stored at the same loop levels.\n";
+    }
+
+    // All the Funcs computed with parent name the same loop of it.
+    const LoopLevel &fuse_level = children[0].schedule().fuse_level();
+    for (const Function &child : children) {
+        user_assert(child.schedule().fuse_level() == fuse_level)
+            << "All Funcs computed with " << parent.name() << " must be computed "
+            << "with it at the same loop level.\n";
+    }
+
+    string var = fuse_level.var().name();
+    size_t fused_dims = 0;
+    for (size_t i = 0; i < dims.size(); i++) {
+        if (dims[i].var == var || ends_with(dims[i].var, "." + var)) {
+            fused_dims = dims.size() - i;
+            break;
+        }
+    }
+    user_assert(fused_dims > 0)
+        << "Can't compute with " << parent.name() << " at loop " << var
+        << ", because " << parent.name() << " has no such loop.\n";
+
+    for (const Function &child : children) {
+        const vector<Dim> &child_dims = child.definition().schedule().dims();
+        user_assert(child_dims.size() >= fused_dims)
+            << "Func " << child.name() << " is computed with " << parent.name()
+            << " at loop " << var << ", but has fewer loops than that to fuse.\n";
+        for (size_t i = 1; i <= fused_dims; i++) {
+            const Dim &p = dims[dims.size() - i];
+            const Dim &c = child_dims[child_dims.size() - i];
+            user_assert(p.for_type == c.for_type && p.device_api == c.device_api &&
+                        (p.for_type == ForType::Serial || p.for_type == ForType::Parallel))
+                << "Loop " << c.var << " of " << child.name() << " can't be fused with loop "
+                << p.var << " of " << parent.name() << ", because fused loops must both "
+                << "be serial or both be parallel, on the same device.\n";
+        }
+    }
+
+    // Nothing else may be computed or stored within the shared loops.
+    for (const Function &f : members) {
+        for (const string &loop : fused_loop_names(f, fused_dims)) {
+            if (ends_with(loop, "." + Var::outermost().name())) {
+                continue;
+            }
+            for (const auto &p : env) {
+                const FuncSchedule &s = p.second.schedule();
+                user_assert(!s.compute_level().match(loop) && !s.store_level().match(loop))
+                    << "Func " << p.first << " can't be computed or stored at loop "
+                    << loop << ", because that loop is fused with other Funcs.\n";
+            }
+        }
+    }
+
+    return fused_dims;
+}
+
 Stmt schedule_functions(const vector<Function> &outputs,
                         const vector<string> &order,
                         const map<string, Function> &env,
@@ -1257,13 +1735,70 @@ Stmt schedule_functions(const vector<Function> &outputs,
 
     any_memoized = false;
 
-    for (size_t i = order.size(); i > 0; i--) {
-        Function f = env.find(order[i-1])->second;
+    // The Funcs computed with each Func, in realization order.
+    map<string, vector<Function>> fused_children;
+    for (const string &name : order) {
+        Function f = env.find(name)->second;
+        const LoopLevel &fuse_level = f.schedule().fuse_level();
+        if (!fuse_level.is_inlined()) {
+            fused_children[fuse_level.func()].push_back(f);
+        }
+    }
 
+    auto is_output_func = [&](const Function &f) {
         bool is_output = false;
         for (Function o : outputs) {
             is_output |= o.same_as(f);
         }
+        return is_output;
+    };
+
+    set<string> done;
+    for (size_t i = order.size(); i > 0; i--) {
+        Function f = env.find(order[i-1])->second;
+        if (done.count(f.name())) {
+            continue;
+        }
+
+        const LoopLevel &fuse_level = f.schedule().fuse_level();
+        if (!fuse_level.is_inlined() || fused_children.count(f.name())) {
+            // A group of fused Funcs is realized all at once, when
+            // the last of them in realization order is reached.
+            Function parent = fuse_level.is_inlined() ? f : env.find(fuse_level.func())->second;
+            const vector<Function> &children = fused_children[parent.name()];
+            size_t fused_dims = validate_fused_group(parent, children, env);
+
+            bool parent_is_output = is_output_func(parent);
+            bool parent_necessary = validate_schedule(parent, s, target, parent_is_output, env);
+
+            InjectRealization injector(parent, parent_is_output, target);
+            injector.fused_dims = fused_dims;
+            for (const Function &child : children) {
+                bool is_output = is_output_func(child);
+                if (validate_schedule(child, s, target, is_output, env)) {
+                    user_assert(parent_necessary)
+                        << "Func " << child.name() << " is computed with " << parent.name()
+                        << ", but " << parent.name() << " is not used.\n";
+                    injector.fused.push_back(child);
+                    injector.fused_is_output.push_back(is_output);
+                }
+                done.insert(child.name());
+            }
+            done.insert(parent.name());
+
+            if (parent_necessary) {
+                debug(1) << "Injecting fused realization of " << parent.name() << '\n';
+                if (injector.fused.empty()) {
+                    injector.fused_dims = 0;
+                }
+                s = injector.mutate(s);
+                internal_assert(injector.found_store_level && injector.found_compute_level);
+            }
+            debug(2) << s << '\n';
+            continue;
+        }
+
+        bool is_output = is_output_func(f);
 
         bool necessary = validate_schedule(f, s, target, is_output, env);
 
@@ -2,8 +2,8 @@
 #define HALIDE_SCOPE_H
 
 #include <string>
-#include <map>
 #include <stack>
+#include <unordered_map>
 #include <utility>
 #include <iostream>
 
@@ -73,7 +73,12 @@ public:
 template<typename T>
 class Scope {
 private:
-    std::map<std::string, SmallStack<T>> table;
+    // Names in the IR are long and share long prefixes
+    // (e.g. f.s0.x.x_inner and f.s0.x.x_outer), which makes an
+    // ordered map spend most of its time comparing strings. Hashing
+    // a name touches each character once.
+    typedef std::unordered_map<std::string, SmallStack<T>> Table;
+    Table table;
 
     // Copying a scope object copies a large table full of strings and
     // stacks. Bad idea.
@@ -103,7 +108,7 @@ public:
 
     /** Retrieve the value referred to by a name */
     T get(const std::string &name) const {
-        typename std::map<std::string, SmallStack<T>>::const_iterator iter = table.find(name);
+        typename Table::const_iterator iter = table.find(name);
         if (iter == table.end() || iter->second.empty()) {
             if (containing_scope) {
                 return containing_scope->get(name);
@@ -116,7 +121,7 @@ public:
 
     /** Return a reference to an entry. Does not consider the containing scope. */
     T &ref(const std::string &name) {
-        typename std::map<std::string, SmallStack<T>>::iterator iter = table.find(name);
+        typename Table::iterator iter = table.find(name);
         if (iter == table.end() || iter->second.empty()) {
             internal_error << "Symbol '" << name << "' not found\n";
         }
@@ -125,7 +130,7 @@ public:
 
     /** Tests if a name is in scope */
     bool contains(const std::string &name) const {
-        typename std::map<std::string, SmallStack<T>>::const_iterator iter = table.find(name);
+        typename Table::const_iterator iter = table.find(name);
         if (iter == table.end() || iter->second.empty()) {
             if (containing_scope) {
                 return containing_scope->contains(name);
@@ -147,7 +152,7 @@ public:
      * was (or remove it entirely if there was nothing else of the
      * same name in an outer scope) */
     void pop(const std::string &name) {
-        typename std::map<std::string, SmallStack<T>>::iterator iter = table.find(name);
+        typename Table::iterator iter = table.find(name);
         internal_assert(iter != table.end()) << "Name not in symbol table: " << name << "\n";
         iter->second.pop();
         if (iter->second.empty()) {
@@ -155,11 +160,12 @@ public:
         }
     }
 
-    /** Iterate through the scope. Does not capture any containing scope. */
+    /** Iterate through the scope, in no particular order. Does not
+     * capture any containing scope. */
     class const_iterator {
-        typename std::map<std::string, SmallStack<T>>::const_iterator iter;
+        typename Table::const_iterator iter;
     public:
-        explicit const_iterator(const typename std::map<std::string, SmallStack<T>>::const_iterator &i) :
+        explicit const_iterator(const typename Table::const_iterator &i) :
             iter(i) {
         }
 
@@ -195,9 +201,9 @@ public:
     }
 
     class iterator {
-        typename std::map<std::string, SmallStack<T>>::iterator iter;
+        typename Table::iterator iter;
     public:
-        explicit iterator(typename std::map<std::string, SmallStack<T>>::iterator i) :
+        explicit iterator(typename Table::iterator i) :
             iter(i) {
         }
 
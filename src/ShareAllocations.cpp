@@ -0,0 +1,321 @@
+#include <map>
+#include <set>
+
+#include "ShareAllocations.h"
+#include "CodeGen_Internal.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "IRVisitor.h"
+#include "Simplify.h"
+#include "Substitute.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::set;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Can the size of an allocation be computed at the start of the run
+// of statements it's in, instead of at the Allocate node? The lets of
+// the run have already been substituted in, so it's enough that it
+// doesn't read memory, call anything impure, or refer to the
+// allocations of the run.
+class CanHoist : public IRGraphVisitor {
+    const set<string> &allocations;
+
+    using IRGraphVisitor::visit;
+
+    void visit(const Load *op) override {
+        result = false;
+    }
+
+    void visit(const Call *op) override {
+        if (!op->is_pure() && !starts_with(op->name, "_halide_buffer_get_")) {
+            result = false;
+        }
+        IRGraphVisitor::visit(op);
+    }
+
+    void visit(const Variable *op) override {
+        if (allocations.count(op->name)) {
+            result = false;
+        }
+    }
+
+public:
+    bool result = true;
+    CanHoist(const set<string> &allocations) : allocations(allocations) {}
+};
+
+// Is an allocation used in a way that depends on it having its own
+// memory? Its halide_buffer_t may be handed to the runtime, an extern
+// stage, or a device, and device code may have its own view of it.
+class NeedsOwnMemory : public IRGraphVisitor {
+    const string buffer_name;
+
+    using IRGraphVisitor::visit;
+
+    void visit(const Variable *op) override {
+        if (op->name == buffer_name) {
+            result = true;
+        }
+    }
+
+    void visit(const For *op) override {
+        if (op->device_api != DeviceAPI::None && op->device_api != DeviceAPI::Host) {
+            result = true;
+        }
+        IRGraphVisitor::visit(op);
+    }
+
+public:
+    bool result = false;
+    NeedsOwnMemory(const string &name) : buffer_name(name + ".buffer") {}
+};
+
+class ShareAllocations : public IRMutator2 {
+    using IRMutator2::visit;
+
+    // The lifetime of an allocation that could share memory, as the
+    // positions of the first and last statements of the run it lives
+    // across.
+    struct Lifetime {
+        const Allocate *op;
+        int start, end;
+        // The number of elements, computed at the start of the run.
+        Expr elements;
+    };
+
+    // The storage shared by allocations with disjoint lifetimes.
+    struct Slot {
+        Type type;
+        Expr elements;
+        int end;
+        vector<int> members;
+    };
+
+    // The state of the run being scanned.
+    struct Run {
+        vector<Lifetime> lifetimes;
+        map<string, int> lifetime_of;
+        set<string> allocations;
+        map<string, Expr> lets;
+        int position = 0;
+    };
+
+    bool is_candidate(const Allocate *op) const {
+        if ((op->memory_type != MemoryType::Auto && op->memory_type != MemoryType::Heap) ||
+            op->new_expr.defined() || !op->free_function.empty() ||
+            op->extents.empty() || !is_one(op->condition)) {
+            return false;
+        }
+        int32_t constant_size = op->constant_allocation_size();
+        if (constant_size > 0 &&
+            op->memory_type == MemoryType::Auto &&
+            can_allocation_fit_on_stack((int64_t)constant_size * op->type.bytes())) {
+            // Codegen already reuses stack allocations.
+            return false;
+        }
+        NeedsOwnMemory needs_own_memory(op->name);
+        op->body.accept(&needs_own_memory);
+        return !needs_own_memory.result;
+    }
+
+    // Walk the statements of a run in order, recording the lifetimes
+    // of the allocations.
+    void find_lifetimes(const Stmt &s, Run &run) {
+        if (const Allocate *op = s.as<Allocate>()) {
+            run.allocations.insert(op->name);
+            int index = -1;
+            if (is_candidate(op)) {
+                Expr elements = make_one(Int(64));
+                for (const Expr &e : op->extents) {
+                    elements *= cast<int64_t>(e);
+                }
+                elements = substitute(run.lets, elements);
+                CanHoist can_hoist(run.allocations);
+                elements.accept(&can_hoist);
+                if (can_hoist.result) {
+                    index = (int)run.lifetimes.size();
+                    run.lifetimes.push_back({op, run.position, -1, elements});
+                    run.lifetime_of[op->name] = index;
+                }
+            }
+            find_lifetimes(op->body, run);
+            if (index >= 0 && run.lifetimes[index].end < 0) {
+                // There's no early free, so it lives to the end of
+                // its Allocate node.
+                run.lifetimes[index].end = run.position - 1;
+            }
+        } else if (const Block *op = s.as<Block>()) {
+            find_lifetimes(op->first, run);
+            find_lifetimes(op->rest, run);
+        } else if (const LetStmt *op = s.as<LetStmt>()) {
+            run.lets[op->name] = substitute(run.lets, op->value);
+            find_lifetimes(op->body, run);
+        } else if (const ProducerConsumer *op = s.as<ProducerConsumer>()) {
+            find_lifetimes(op->body, run);
+        } else {
+            if (const Free *op = s.as<Free>()) {
+                auto it = run.lifetime_of.find(op->name);
+                if (it != run.lifetime_of.end() && run.lifetimes[it->second].end < 0) {
+                    run.lifetimes[it->second].end = run.position;
+                }
+            }
+            run.position++;
+        }
+    }
+
+    // Rebuild a run, carving the allocations that share a slot out
+    // of it, and freeing the slot along with its last member.
+    Stmt rewrite(const Stmt &s,
+                 const map<const Allocate *, string> &slot_of,
+                 const map<string, string> &last_member_of) {
+        if (const Allocate *op = s.as<Allocate>()) {
+            Stmt body = rewrite(op->body, slot_of, last_member_of);
+            auto it = slot_of.find(op);
+            if (it != slot_of.end()) {
+                return Allocate::make(op->name, op->type, op->memory_type, op->extents, op->condition, body,
+                                      Variable::make(Handle(), it->second));
+            } else if (body.same_as(op->body)) {
+                return s;
+            } else {
+                return Allocate::make(op->name, op->type, op->memory_type, op->extents, op->condition, body,
+                                      op->new_expr, op->free_function);
+            }
+        } else if (const Block *op = s.as<Block>()) {
+            Stmt first = rewrite(op->first, slot_of, last_member_of);
+            Stmt rest = rewrite(op->rest, slot_of, last_member_of);
+            if (first.same_as(op->first) && rest.same_as(op->rest)) {
+                return s;
+            }
+            return Block::make(first, rest);
+        } else if (const LetStmt *op = s.as<LetStmt>()) {
+            Stmt body = rewrite(op->body, slot_of, last_member_of);
+            if (body.same_as(op->body)) {
+                return s;
+            }
+            return LetStmt::make(op->name, op->value, body);
+        } else if (const ProducerConsumer *op = s.as<ProducerConsumer>()) {
+            Stmt body = rewrite(op->body, slot_of, last_member_of);
+            if (body.same_as(op->body)) {
+                return s;
+            }
+            return ProducerConsumer::make(op->name, op->is_producer, body);
+        } else if (const Free *op = s.as<Free>()) {
+            auto it = last_member_of.find(op->name);
+            if (it != last_member_of.end()) {
+                return Block::make(s, Free::make(it->second));
+            }
+            return s;
+        } else {
+            return mutate(s);
+        }
+    }
+
+    Stmt visit(const For *op) override {
+        if (op->device_api != DeviceAPI::None && op->device_api != DeviceAPI::Host) {
+            return op;
+        }
+        Stmt body = share_in_run(op->body);
+        if (body.same_as(op->body)) {
+            return op;
+        }
+        return For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+    }
+
+    Stmt visit(const IfThenElse *op) override {
+        Stmt then_case = share_in_run(op->then_case);
+        Stmt else_case = op->else_case.defined() ? share_in_run(op->else_case) : Stmt();
+        if (then_case.same_as(op->then_case) && else_case.same_as(op->else_case)) {
+            return op;
+        }
+        return IfThenElse::make(op->condition, then_case, else_case);
+    }
+
+public:
+    Stmt share_in_run(const Stmt &s) {
+        Run run;
+        find_lifetimes(s, run);
+
+        // Give each allocation the first slot of its type that is
+        // free by the time it starts. Lifetimes are in order of
+        // their starts, so this is the greedy coloring of the
+        // interval graph, which uses as few slots as there are
+        // allocations live at once.
+        vector<Slot> slots;
+        for (size_t i = 0; i < run.lifetimes.size(); i++) {
+            const Lifetime &l = run.lifetimes[i];
+            bool placed = false;
+            for (Slot &slot : slots) {
+                if (slot.type == l.op->type && slot.end < l.start) {
+                    slot.elements = max(slot.elements, l.elements);
+                    slot.end = l.end;
+                    slot.members.push_back((int)i);
+                    placed = true;
+                    break;
+                }
+            }
+            if (!placed) {
+                slots.push_back({l.op->type, l.elements, l.end, {(int)i}});
+            }
+        }
+
+        map<const Allocate *, string> slot_of;
+        map<string, string> last_member_of;
+        vector<std::pair<string, const Slot *>> shared;
+        for (const Slot &slot : slots) {
+            if (slot.members.size() < 2) {
+                continue;
+            }
+            string name = unique_name("shared_storage");
+            for (int m : slot.members) {
+                slot_of[run.lifetimes[m].op] = name;
+            }
+            last_member_of[run.lifetimes[slot.members.back()].op->name] = name;
+            shared.push_back({name, &slot});
+        }
+
+        Stmt result = rewrite(s, slot_of, last_member_of);
+        for (const auto &p : shared) {
+            // The shared storage has a single 32-bit extent, so check
+            // its size fits before narrowing it. The members' own size
+            // checks are gone with their Allocate nodes.
+            Type t = p.second->type;
+            Expr elements = simplify(p.second->elements);
+            int64_t max_bytes = 0x7fffffff;
+            Expr max_elements = make_const(Int(64), max_bytes / t.bytes());
+            Expr size_check = simplify(elements <= max_elements);
+            const int64_t *const_elements = as_const_int(elements);
+            user_assert(!const_elements || *const_elements <= max_bytes / t.bytes())
+                << "Total size for allocation " << p.first
+                << " is constant but exceeds 2^31 - 1.";
+            Expr extent = simplify(cast<int32_t>(elements));
+            result = Allocate::make(p.first, t, MemoryType::Auto, {extent}, const_true(), result);
+            if (!is_one(size_check)) {
+                Expr error = Call::make(Int(32), "halide_error_buffer_allocation_too_large",
+                                        {p.first, cast<uint64_t>(elements) * t.bytes(),
+                                         make_const(UInt(64), max_bytes)}, Call::Extern);
+                result = Block::make(AssertStmt::make(size_check, error), result);
+            }
+        }
+        return result;
+    }
+};
+
+}  // namespace
+
+Stmt share_allocations(Stmt s, const Target &t) {
+    if (t.has_large_buffers()) {
+        // The shared storage is sized with a 32-bit extent.
+        return s;
+    }
+    return ShareAllocations().share_in_run(s);
+}
+
+}
+}
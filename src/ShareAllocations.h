@@ -0,0 +1,32 @@
+#ifndef HALIDE_SHARE_ALLOCATIONS_H
+#define HALIDE_SHARE_ALLOCATIONS_H
+
+/** \file
+ * Defines the lowering pass that lets heap allocations with
+ * non-overlapping lifetimes share memory.
+ */
+
+#include "IR.h"
+#include "Target.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Find the lifetimes of the heap allocations in each straight-line
+ * run of statements (the body of each loop, and the top level), from
+ * their Allocate node to their Free, and give allocations of the same
+ * type whose lifetimes don't overlap the same storage. Each group of
+ * allocations gets a single allocation, big enough for the largest of
+ * them, made at the start of the run, and the allocations in the
+ * group are carved out of it in turn. A chain of compute_root stages
+ * then needs a few allocations instead of one per stage. Allocations
+ * whose size can't be computed at the start of the run, and those
+ * accessed through a halide_buffer_t, are left alone. Used when the
+ * target has the share_allocations feature. Should be run after early
+ * frees have been injected. */
+Stmt share_allocations(Stmt s, const Target &t);
+
+}
+}
+
+#endif
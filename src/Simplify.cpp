@@ -3,6 +3,7 @@
 #include <cmath>
 #include <limits>
 #include <stdio.h>
+#include <unordered_map>
 
 #include "Simplify.h"
 #include "IROperator.h"
@@ -158,8 +159,24 @@ public:
 
     }
 
+    Expr mutate(const Expr &e) override {
+        // Leaves are cheaper to simplify than to look up.
+        const bool memoize = !(e.as<IntImm>() || e.as<UIntImm>() || e.as<FloatImm>() ||
+                               e.as<StringImm>() || e.as<Variable>());
+        if (memoize) {
+            auto iter = memo.find(e.get());
+            if (iter != memo.end() &&
+                iter->second.context >= reuse_floor &&
+                context_active[iter->second.context]) {
+                if (iter->second.counted_uses) {
+                    CountUses(this).count(e);
+                }
+                return iter->second.simplified;
+            }
+        }
+
+        uint64_t old_uses_counted = uses_counted;
 #if LOG_EXPR_MUTATIONS
-    Expr mutate(const Expr &e) {
         const std::string spaces(debug_indent, ' ');
         debug(1) << spaces << "Simplifying Expr: " << e << "\n";
         debug_indent++;
@@ -170,9 +187,16 @@ public:
                 << spaces << "Before: " << e << "\n"
                 << spaces << "After:  " << new_e << "\n";
         }
+#else
+        Expr new_e = IRMutator2::mutate(e);
+#endif
+
+        if (memoize) {
+            MemoEntry entry = {e, new_e, context, uses_counted != old_uses_counted};
+            memo[e.get()] = entry;
+        }
         return new_e;
     }
-#endif
 
 #if LOG_STMT_MUTATIONS
     Stmt mutate(const Stmt &s) {
@@ -204,6 +228,94 @@ private:
     Scope<pair<int64_t, int64_t>> bounds_info;
     Scope<ModulusRemainder> alignment_info;
 
+    // The same Exprs recur many times in lowered code (e.g. after
+    // unrolling, or in the bounds of many loops), so we remember what
+    // each Expr simplified to. The result depends on the facts in the
+    // scopes above, which only grow on entering the body of a let or
+    // a loop. Each such body is a new context, and a remembered result
+    // may be reused in the context it was made in, or in any context
+    // nested inside it. A let or loop that rebinds a name that already
+    // has facts in scope makes those facts wrong for its body, so it
+    // starts a context that can't reuse results from outside it.
+    struct MemoEntry {
+        // The Expr simplified, held so that its address isn't reused.
+        Expr expr;
+        Expr simplified;
+        int context;
+        // Whether simplifying it counted uses of enclosing lets,
+        // which must then be counted again when it's reused.
+        bool counted_uses;
+    };
+    std::unordered_map<const IRNode *, MemoEntry> memo;
+    vector<bool> context_active = {true};
+    int context = 0;
+    // The oldest context whose results may be reused.
+    int reuse_floor = 0;
+    uint64_t uses_counted = 0;
+
+    struct SavedContext {
+        int context, reuse_floor;
+    };
+
+    // Enter the body of a let or loop that binds the given name. Must
+    // be called before any facts about the name are pushed.
+    SavedContext enter_context(const string &name) {
+        SavedContext old = {context, reuse_floor};
+        context = (int)context_active.size();
+        context_active.push_back(true);
+        if (var_info.contains(name) ||
+            bounds_info.contains(name) ||
+            alignment_info.contains(name)) {
+            reuse_floor = context;
+        }
+        return old;
+    }
+
+    void exit_context(const SavedContext &old) {
+        context_active[context] = false;
+        context = old.context;
+        reuse_floor = old.reuse_floor;
+    }
+
+    // Counts the uses of enclosing lets in an Expr the way
+    // simplifying it does.
+    class CountUses : public IRGraphVisitor {
+        Simplify *simplify;
+
+        using IRGraphVisitor::visit;
+
+        void visit(const Variable *op) override {
+            if (simplify->var_info.contains(op->name)) {
+                VarInfo &info = simplify->var_info.ref(op->name);
+                if (info.replacement.defined()) {
+                    info.new_uses++;
+                } else {
+                    info.old_uses++;
+                }
+                simplify->uses_counted++;
+            }
+        }
+
+        void visit(const Load *op) override {
+            simplify->found_buffer_reference(op->name);
+            IRGraphVisitor::visit(op);
+        }
+
+        void visit(const Call *op) override {
+            if (op->call_type == Call::Image || op->call_type == Call::Halide) {
+                simplify->found_buffer_reference(op->name, op->args.size());
+            }
+            IRGraphVisitor::visit(op);
+        }
+
+    public:
+        CountUses(Simplify *s) : simplify(s) {}
+
+        void count(const Expr &e) {
+            e.accept(this);
+        }
+    };
+
     // If we encounter a reference to a buffer (a Load, Store, Call,
     // or Provide), there's an implicit dependence on some associated
     // symbols.
@@ -212,16 +324,19 @@ private:
             string stride = name + ".stride." + std::to_string(i);
             if (var_info.contains(stride)) {
                 var_info.ref(stride).old_uses++;
+                uses_counted++;
             }
 
             string min = name + ".min." + std::to_string(i);
             if (var_info.contains(min)) {
                 var_info.ref(min).old_uses++;
+                uses_counted++;
             }
         }
 
         if (var_info.contains(name)) {
             var_info.ref(name).old_uses++;
+            uses_counted++;
         }
     }
 
@@ -535,11 +650,13 @@ private:
                 internal_assert(info.replacement.type() == op->type) << "Cannot replace variable " << op->name
                     << " of type " << op->type << " with expression of type " << info.replacement.type() << "\n";
                 info.new_uses++;
+                uses_counted++;
                 return info.replacement;
             } else {
                 // This expression was not something deemed
                 // substitutable - no replacement is defined.
                 info.old_uses++;
+                uses_counted++;
                 return op;
             }
         } else {
@@ -4970,6 +5087,7 @@ private:
         info.new_uses = 0;
         info.replacement = replacement;
 
+        SavedContext old_context = enter_context(op->name);
         var_info.push(op->name, info);
 
         // Before we enter the body, track the alignment info
@@ -5001,6 +5119,7 @@ private:
         }
 
         body = mutate(body);
+        exit_context(old_context);
 
         if (value_alignment_tracked) {
             alignment_info.pop(op->name);
@@ -5088,6 +5207,8 @@ private:
         Expr new_min = mutate(op->min);
         Expr new_extent = mutate(op->extent);
 
+        SavedContext old_context = enter_context(op->name);
+
         int64_t new_min_int, new_extent_int;
         bool bounds_tracked = false;
         if (const_int(new_min, &new_min_int) &&
@@ -5098,6 +5219,7 @@ private:
         }
 
         Stmt new_body = mutate(op->body);
+        exit_context(old_context);
 
         if (bounds_tracked) {
             bounds_info.pop(op->name);
@@ -5164,7 +5286,7 @@ private:
             equal(op->condition, body_if->condition)) {
             // We can move the allocation into the if body case. The
             // else case must not use it.
-            Stmt stmt = Allocate::make(op->name, op->type, new_extents,
+            Stmt stmt = Allocate::make(op->name, op->type, op->memory_type, new_extents,
                                   condition, body_if->then_case,
                                   new_expr, op->free_function);
             return IfThenElse::make(body_if->condition, stmt, body_if->else_case);
@@ -5174,7 +5296,7 @@ private:
                    new_expr.same_as(op->new_expr)) {
             return op;
         } else {
-            return Allocate::make(op->name, op->type, new_extents,
+            return Allocate::make(op->name, op->type, op->memory_type, new_extents,
                                   condition, body,
                                   new_expr, op->free_function);
         }
@@ -6875,6 +6997,31 @@ void simplify_test() {
     check(max(x * 4 + 63, y) - max(y - 3, x * 4), 3 - clamp(y - x * 4 + (-63), -60, 0));
     check(max(y - 3, x * 4) - max(y, x * 4 + 63), -63 - clamp(x * 4 - y + 3, -60, 0));
 
+    // The same Expr in the bodies of loops with different bounds must
+    // be simplified separately in each.
+    {
+        Expr e = min(x, 10);
+        Stmt store = Store::make("buf", e, x, Parameter(), const_true());
+        check(Block::make(For::make("x", 0, 5, ForType::Serial, DeviceAPI::None, store),
+                          For::make("x", 0, 20, ForType::Serial, DeviceAPI::None, store)),
+              Block::make(For::make("x", 0, 5, ForType::Serial, DeviceAPI::None,
+                                    Store::make("buf", x, x, Parameter(), const_true())),
+                          For::make("x", 0, 20, ForType::Serial, DeviceAPI::None, store)));
+
+        // Nor may a result be reused inside a nested loop or let that
+        // rebinds one of its free variables.
+        Stmt simplified = Store::make("buf", x, x, Parameter(), const_true());
+        check(For::make("x", 0, 5, ForType::Serial, DeviceAPI::None,
+                        Block::make(store, For::make("x", 0, 20, ForType::Serial, DeviceAPI::None, store))),
+              For::make("x", 0, 5, ForType::Serial, DeviceAPI::None,
+                        Block::make(simplified, For::make("x", 0, 20, ForType::Serial, DeviceAPI::None, store))));
+        Stmt store_zero = Store::make("buf", e, 0, Parameter(), const_true());
+        check(For::make("x", 0, 5, ForType::Serial, DeviceAPI::None,
+                        Block::make(store, LetStmt::make("x", 100, store_zero))),
+              For::make("x", 0, 5, ForType::Serial, DeviceAPI::None,
+                        Block::make(simplified, Store::make("buf", 10, 0, Parameter(), const_true()))));
+    }
+
     // Check that provably-true require() expressions are simplified away
     {
         Expr result(42);
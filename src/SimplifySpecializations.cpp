@@ -65,7 +65,8 @@ void simplify_using_fact(Expr fact, vector<Definition> &definitions) {
     }
 }
 
-vector<Definition> propagate_specialization_in_definition(Definition &def, const string &name) {
+vector<Definition> propagate_specialization_in_definition(Definition &def, const string &name,
+                                                          const map<Expr, Expr, IRDeepCompare> &known_conditions) {
     vector<Definition> result;
 
     result.push_back(def);
@@ -82,7 +83,8 @@ vector<Definition> propagate_specialization_in_definition(Definition &def, const
     bool seen_const_true = false;
     for (auto it = specializations.begin(); it != specializations.end(); /*no-increment*/) {
         Expr old_c = it->condition;
-        Expr c = simplify(it->condition);
+        auto known = known_conditions.find(old_c);
+        Expr c = simplify(known == known_conditions.end() ? old_c : known->second);
         // Go ahead and save the simplified condition now
         it->condition = c;
         if (is_zero(c) || seen_const_true) {
@@ -122,7 +124,7 @@ vector<Definition> propagate_specialization_in_definition(Definition &def, const
         const EQ *eq = c.as<EQ>();
         const Variable *var = eq ? eq->a.as<Variable>() : c.as<Variable>();
 
-        vector<Definition> s_result = propagate_specialization_in_definition(s_def, name);
+        vector<Definition> s_result = propagate_specialization_in_definition(s_def, name, known_conditions);
 
         if (var && eq) {
             // Then case
@@ -149,14 +151,31 @@ vector<Definition> propagate_specialization_in_definition(Definition &def, const
     return result;
 }
 
-}
 
+// Replace the known conditions among the specializations of an
+// update definition, which aren't otherwise propagated.
+void substitute_known_conditions(Definition &def, const map<Expr, Expr, IRDeepCompare> &known_conditions) {
+    for (Specialization &s : def.specializations()) {
+        auto known = known_conditions.find(s.condition);
+        if (known != known_conditions.end()) {
+            s.condition = known->second;
+        }
+        substitute_known_conditions(s.definition, known_conditions);
+    }
+}
 
+}
 
-void simplify_specializations(map<string, Function> &env) {
+void simplify_specializations(map<string, Function> &env,
+                              const map<Expr, Expr, IRDeepCompare> &known_conditions) {
     for (auto &iter : env) {
         Function &func = iter.second;
-        propagate_specialization_in_definition(func.definition(), func.name());
+        propagate_specialization_in_definition(func.definition(), func.name(), known_conditions);
+        if (!known_conditions.empty()) {
+            for (size_t i = 0; i < func.updates().size(); i++) {
+                substitute_known_conditions(func.update(i), known_conditions);
+            }
+        }
     }
 }
 
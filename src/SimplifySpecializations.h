@@ -10,13 +10,19 @@
 #include <map>
 
 #include "IR.h"
+#include "IREquality.h"
 
 namespace Halide {
 namespace Internal {
 
 /** Try to simplify the RHS/LHS of a function's definition based on its
- * specializations. */
-EXPORT void simplify_specializations(std::map<std::string, Function> &env);
+ * specializations. A specialization condition equal to one of the
+ * keys of known_conditions is first replaced with its value, so that
+ * callers who know which way some conditions go can prune the
+ * specializations that aren't taken without changing the Funcs. */
+EXPORT void simplify_specializations(std::map<std::string, Function> &env,
+                                     const std::map<Expr, Expr, IRDeepCompare> &known_conditions =
+                                         std::map<Expr, Expr, IRDeepCompare>());
 
 }
 }
@@ -1,4 +1,5 @@
 #include "SkipStages.h"
+#include "Bounds.h"
 #include "CSE.h"
 #include "Debug.h"
 #include "ExprUsesVar.h"
@@ -56,6 +57,14 @@ private:
     Scope<int> varying;
     Scope<int> in_pipeline;
 
+    // The bounds of the varying loop variables and lets, in terms of
+    // things that don't vary.
+    Scope<Interval> bounds;
+
+    // The most points at which we'll evaluate a varying condition
+    // to find out whether it holds anywhere in a tile.
+    static const int max_samples = 16;
+
     void visit(const Variable *op) {
         bool this_varies = varying.contains(op->name);
 
@@ -70,9 +79,20 @@ private:
         if (!is_one(op->extent) || min_varies) {
             should_pop = true;
             varying.push(op->name, 0);
+            Interval min_bounds = bounds_of_expr_in_scope(op->min, bounds);
+            Interval extent_bounds = bounds_of_expr_in_scope(op->extent, bounds);
+            Interval loop_bounds = Interval::everything();
+            if (min_bounds.has_lower_bound()) {
+                loop_bounds.min = min_bounds.min;
+            }
+            if (min_bounds.has_upper_bound() && extent_bounds.has_upper_bound()) {
+                loop_bounds.max = min_bounds.max + extent_bounds.max - 1;
+            }
+            bounds.push(op->name, loop_bounds);
         }
         op->body.accept(this);
         if (should_pop) {
+            bounds.pop(op->name);
             varying.pop(op->name);
             //internal_assert(!expr_uses_var(predicate, op->name));
         } else if (expr_uses_var(predicate, op->name)) {
@@ -89,9 +109,11 @@ private:
         varies |= old_varies;
         if (value_varies) {
             varying.push(name, 0);
+            bounds.push(name, bounds_of_expr_in_scope(value, bounds));
         }
         body.accept(this);
         if (value_varies) {
+            bounds.pop(name);
             varying.pop(name);
         }
         if (expr_uses_var(predicate, name)) {
@@ -172,6 +194,105 @@ private:
         }
     }
 
+    // Does an expression depend on anything that varies inside the
+    // realization?
+    bool expr_varies(const Expr &e) {
+        bool old_varies = varies;
+        Expr old_predicate = predicate;
+        varies = false;
+        e.accept(this);
+        bool result = varies;
+        varies = old_varies;
+        predicate = old_predicate;
+        return result;
+    }
+
+    // Find the arguments to calls in an expression that vary, such as
+    // the coordinates of a coarse mask.
+    class FindVaryingArgs : public IRVisitor {
+        using IRVisitor::visit;
+
+        void visit(const Call *op) {
+            if (op->call_type == Call::Halide || op->call_type == Call::Image) {
+                for (const Expr &arg : op->args) {
+                    if (!expr_uses_vars(arg, varying)) {
+                        continue;
+                    }
+                    bool seen = false;
+                    for (const Expr &a : args) {
+                        seen = seen || equal(a, arg);
+                    }
+                    if (!seen) {
+                        args.push_back(arg);
+                    }
+                }
+            }
+            IRVisitor::visit(op);
+        }
+
+        const Scope<int> &varying;
+
+    public:
+        vector<Expr> args;
+        FindVaryingArgs(const Scope<int> &varying) : varying(varying) {}
+    };
+
+    // A condition that varies inside the realization might still
+    // only depend on a few values of the arguments of the calls in it
+    // in each tile, e.g. if it reads a mask that is coarser than the
+    // tiles. If so, find whether it may be true or may be false
+    // anywhere in the tile by evaluating it at all of them.
+    bool bound_condition(const Expr &condition, Expr *may_be_true, Expr *may_be_false) {
+        FindVaryingArgs find(varying);
+        condition.accept(&find);
+        if (find.args.empty()) {
+            return false;
+        }
+
+        vector<Interval> arg_bounds;
+        vector<int> counts;
+        int total = 1;
+        for (const Expr &arg : find.args) {
+            Interval i = bounds_of_expr_in_scope(arg, bounds);
+            if (!i.is_bounded()) {
+                return false;
+            }
+            i.min = simplify(i.min);
+            i.max = simplify(i.max);
+            const int64_t *span = as_const_int(find_constant_bound(simplify(i.max - i.min), Direction::Upper));
+            if (!span || *span < 0 || *span >= max_samples) {
+                return false;
+            }
+            total *= (int)*span + 1;
+            if (total > max_samples) {
+                return false;
+            }
+            arg_bounds.push_back(i);
+            counts.push_back((int)*span + 1);
+        }
+
+        *may_be_true = const_false();
+        *may_be_false = const_false();
+        for (int n = 0; n < total; n++) {
+            Expr sample = condition;
+            int k = n;
+            for (size_t i = 0; i < find.args.size(); i++) {
+                // Don't go past the end of the range of the argument,
+                // in case the bound on the span wasn't tight.
+                Expr offset = make_const(arg_bounds[i].min.type(), k % counts[i]);
+                Expr value = min(arg_bounds[i].min + offset, arg_bounds[i].max);
+                sample = substitute(find.args[i], value, sample);
+                k /= counts[i];
+            }
+            if (expr_varies(sample)) {
+                return false;
+            }
+            *may_be_true = make_or(*may_be_true, sample);
+            *may_be_false = make_or(*may_be_false, make_not(sample));
+        }
+        return true;
+    }
+
     template<typename T>
     void visit_conditional(Expr condition, T true_case, T false_case) {
         Expr old_predicate = predicate;
@@ -190,7 +311,13 @@ private:
         condition.accept(this);
 
         predicate = make_or(predicate, old_predicate);
-        if (varies) {
+        Expr may_be_true, may_be_false;
+        if (varies &&
+            !(is_zero(true_predicate) && is_zero(false_predicate)) &&
+            bound_condition(condition, &may_be_true, &may_be_false)) {
+            predicate = make_or(predicate, make_or(make_and(may_be_true, true_predicate),
+                                                   make_and(may_be_false, false_predicate)));
+        } else if (varies) {
             predicate = make_or(predicate, make_or(true_predicate, false_predicate));
         } else {
             predicate = make_or(predicate, make_select(condition, true_predicate, false_predicate));
@@ -261,7 +388,7 @@ private:
 
     Expr visit(const Call *op) override {
 
-        if ((op->name == "halide_memoization_cache_lookup") &&
+        if ((op->name == "halide_memoization_cache_lookup_with_hash") &&
              memoize_call_uses_buffer(op)) {
             // We need to guard call to halide_memoization_cache_lookup to only
             // be executed if the corresponding buffer is allocated. We ignore
@@ -273,7 +400,7 @@ private:
             // the cache, so we perform the lookup instead of allocating a new one.
             return Call::make(op->type, Call::if_then_else,
                               {alloc_predicate, op, 0}, Call::PureIntrinsic);
-        } else if ((op->name == "halide_memoization_cache_store") &&
+        } else if ((op->name == "halide_memoization_cache_store_with_priority") &&
                     memoize_call_uses_buffer(op)) {
             // We need to wrap the halide_memoization_cache_store with the
             // compute_predicate, since the data to be written is only valid if
@@ -383,7 +510,7 @@ private:
 
                 debug(3) << "Done guarding computation for " << op->name << "\n";
 
-                return Realize::make(op->name, op->types, op->bounds,
+                return Realize::make(op->name, op->types, op->memory_type, op->bounds,
                                      alloc_predicate, body);
             } else {
                 return IRMutator2::visit(op);
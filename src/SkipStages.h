@@ -14,7 +14,11 @@ namespace Internal {
  * to check that tells us they won't be used. Does this by analyzing
  * all reads of each buffer allocated, and inferring some condition
  * that tells us if the reads occur. If the condition is non-trivial,
- * inject ifs that guard the production. */
+ * inject ifs that guard the production. A condition that varies
+ * within a stage's realization, but only through the arguments of a
+ * coarse lookup such as a per-tile mask, is evaluated at each value
+ * those arguments can take, so that stages computed per tile are
+ * skipped in the tiles that don't need them. */
 Stmt skip_stages(Stmt s, const std::vector<std::string> &order);
 
 }
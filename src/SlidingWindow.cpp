@@ -337,6 +337,61 @@ class SlidingWindowOnFunction : public IRMutator2 {
 
     using IRMutator2::visit;
 
+    // Parallel loops are split into about this many strips, which is
+    // enough to keep the threads of a typical machine busy...
+    const int target_strips = 64;
+    // ...but each strip runs at least this many iterations in order,
+    // so that sliding saves more than the warm-up of each strip costs.
+    const int min_strip_size = 16;
+    // Loops with fewer than this many strips' worth of iterations are
+    // left alone, as striping them would leave too few parallel tasks.
+    const int min_strips = 4;
+
+    // The iterations of a parallel loop may run in any order, so we
+    // can't slide over it directly. Instead, split it into strips,
+    // run the strips in parallel, and slide over the iterations
+    // within each strip. The first iteration of each strip computes
+    // the whole footprint, and the rest compute only what's new. The
+    // strips all still share the function's storage, and the values
+    // they compute where their footprints overlap are the same, as
+    // they would be without sliding.
+    Stmt slide_over_strips(const For *op, const Stmt &body) {
+        string strip_name = op->name + ".strip";
+        string strip_min_name = op->name + ".strip_min";
+        Expr strip = Variable::make(Int(32), strip_name);
+        Expr strip_min = Variable::make(Int(32), strip_min_name);
+
+        Stmt sliding_body = SlidingWindowOnFunctionAndLoop(func, op->name, strip_min).mutate(body);
+        if (sliding_body.same_as(body)) {
+            return Stmt();
+        }
+
+        Expr min_extent = min_strips * min_strip_size;
+        const int64_t *const_extent = as_const_int(op->extent);
+        if (const_extent && *const_extent < min_strips * min_strip_size) {
+            return Stmt();
+        }
+
+        debug(3) << "Sliding " << func.name() << " over strips of the parallel loop " << op->name << "\n";
+
+        string strip_size_name = op->name + ".strip_size";
+        Expr strip_size = Variable::make(Int(32), strip_size_name);
+        Expr strip_extent = min(strip_size, op->min + op->extent - strip_min);
+        Stmt s = For::make(op->name, strip_min, strip_extent, ForType::Serial, op->device_api, sliding_body);
+        s = LetStmt::make(strip_min_name, op->min + strip * strip_size, s);
+        Expr num_strips = (op->extent + (strip_size - 1)) / strip_size;
+        s = For::make(strip_name, 0, num_strips, ForType::Parallel, op->device_api, s);
+        s = LetStmt::make(strip_size_name,
+                          max(min_strip_size, (op->extent + (target_strips - 1)) / target_strips), s);
+
+        if (!const_extent) {
+            // Keep the plain parallel loop for short runtime extents.
+            Stmt unstripped = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+            s = IfThenElse::make(op->extent >= min_extent, s, unstripped);
+        }
+        return s;
+    }
+
     Stmt visit(const For *op) override {
         debug(3) << " Doing sliding window analysis over loop: " << op->name << "\n";
 
@@ -347,6 +402,11 @@ class SlidingWindowOnFunction : public IRMutator2 {
         if (op->for_type == ForType::Serial ||
             op->for_type == ForType::Unrolled) {
             new_body = SlidingWindowOnFunctionAndLoop(func, op->name, op->min).mutate(new_body);
+        } else if (op->for_type == ForType::Parallel) {
+            Stmt strips = slide_over_strips(op, new_body);
+            if (strips.defined()) {
+                return strips;
+            }
         }
 
         if (new_body.same_as(op->body)) {
@@ -394,7 +454,7 @@ class SlidingWindow : public IRMutator2 {
         if (new_body.same_as(op->body)) {
             return op;
         } else {
-            return Realize::make(op->name, op->types, op->bounds, op->condition, new_body);
+            return Realize::make(op->name, op->types, op->memory_type, op->bounds, op->condition, new_body);
         }
     }
 public:
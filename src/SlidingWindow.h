@@ -17,6 +17,8 @@ namespace Internal {
 /** Perform sliding window optimizations on a halide
  * statement. I.e. don't bother computing points in a function that
  * have provably already been computed by a previous iteration.
+ * Parallel loops are split into strips of iterations that run in
+ * parallel, and the iterations within each strip are slid over.
  */
 Stmt sliding_window(Stmt s, const std::map<std::string, Function> &env);
 
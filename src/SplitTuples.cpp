@@ -51,6 +51,18 @@ inline bool uses_extern_image(Stmt s) {
     return uses.result;
 }
 
+// Funcs scheduled store_interleaved keep a single realization, with
+// an extra innermost dimension that indexes the Tuple.
+bool is_interleaved(const Function &f) {
+    return f.outputs() > 1 && f.schedule().store_interleaved();
+}
+
+Region interleaved_bounds(const Function &f, const Region &bounds) {
+    Region result = {Range(0, f.outputs())};
+    result.insert(result.end(), bounds.begin(), bounds.end());
+    return result;
+}
+
 class SplitTuples : public IRMutator2 {
     using IRMutator2::visit;
 
@@ -58,11 +70,16 @@ class SplitTuples : public IRMutator2 {
 
     Stmt visit(const Realize *op) override {
         ScopedBinding<int> bind(realizations, op->name, 0);
-        if (op->types.size() > 1) {
+        auto it = env.find(op->name);
+        if (it != env.end() && is_interleaved(it->second)) {
+            Stmt body = mutate(op->body);
+            return Realize::make(op->name, {op->types[0]}, op->memory_type,
+                                 interleaved_bounds(it->second, op->bounds), op->condition, body);
+        } else if (op->types.size() > 1) {
             // Make a nested set of realize nodes for each tuple element
             Stmt body = mutate(op->body);
             for (int i = (int)op->types.size() - 1; i >= 0; i--) {
-                body = Realize::make(op->name + "." + std::to_string(i), {op->types[i]}, op->bounds, op->condition, body);
+                body = Realize::make(op->name + "." + std::to_string(i), {op->types[i]}, op->memory_type, op->bounds, op->condition, body);
             }
             return body;
         } else {
@@ -84,7 +101,11 @@ class SplitTuples : public IRMutator2 {
 
     Stmt visit(const Prefetch *op) override {
         Stmt stmt;
-        if (!op->param.defined() && (op->types.size() > 1)) {
+        auto it = env.find(op->name);
+        if (!op->param.defined() && it != env.end() && is_interleaved(it->second)) {
+            // All of the elements are in the same cache lines.
+            stmt = Prefetch::make(op->name, {op->types[0]}, interleaved_bounds(it->second, op->bounds));
+        } else if (!op->param.defined() && (op->types.size() > 1)) {
             // Split the prefetch from a multi-dimensional halide tuple to
             // prefetches of each tuple element. Keep only prefetches of
             // elements that are actually used in the loop body.
@@ -110,10 +131,12 @@ class SplitTuples : public IRMutator2 {
             internal_assert(it != env.end());
             Function f = it->second;
             string name = op->name;
-            if (f.outputs() > 1) {
+            vector<Expr> args;
+            if (is_interleaved(f)) {
+                args.push_back(op->value_index);
+            } else if (f.outputs() > 1) {
                 name += "." + std::to_string(op->value_index);
             }
-            vector<Expr> args;
             for (Expr e : op->args) {
                 args.push_back(mutate(e));
             }
@@ -176,7 +199,13 @@ class SplitTuples : public IRMutator2 {
                 lets.push_back({ var_name, val });
                 val = Variable::make(val.type(), var_name);
             }
-            provides.push_back(Provide::make(name, {val}, args));
+            if (is_interleaved(f)) {
+                vector<Expr> site = {(int)i};
+                site.insert(site.end(), args.begin(), args.end());
+                provides.push_back(Provide::make(op->name, {val}, site));
+            } else {
+                provides.push_back(Provide::make(name, {val}, args));
+            }
         }
 
         Stmt result = Block::make(provides);
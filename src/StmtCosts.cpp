@@ -0,0 +1,321 @@
+#include <algorithm>
+#include <sstream>
+
+#include "StmtCosts.h"
+#include "Bounds.h"
+#include "IRPrinter.h"
+#include "IROperator.h"
+#include "IRVisitor.h"
+#include "Simplify.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::string;
+
+namespace {
+
+// Add two costs, folding constants as we go so that most loop bodies
+// never build a symbolic sum.
+Expr add_cost(const Expr &a, const Expr &b) {
+    const int64_t *ca = as_const_int(a);
+    const int64_t *cb = as_const_int(b);
+    if (ca && cb) {
+        return make_const(Int(64), *ca + *cb);
+    }
+    return a + b;
+}
+
+Expr add_cost(const Expr &a, int64_t b) {
+    return add_cost(a, make_const(Int(64), b));
+}
+
+class ComputeCosts : public IRVisitor {
+    using IRVisitor::visit;
+
+    map<const For *, LoopCost> &loops;
+    map<const Allocate *, Expr> &allocations;
+
+    // The cost of the loop body we're in so far.
+    LoopCost current;
+
+    void note_type(Type t) {
+        current.vector_width = std::max(current.vector_width, t.lanes());
+    }
+
+    void count_op(Type t) {
+        current.arith = add_cost(current.arith, t.lanes());
+        note_type(t);
+    }
+
+    template<typename T>
+    void visit_op(const T *op) {
+        IRVisitor::visit(op);
+        count_op(op->type);
+    }
+
+    void visit(const Add *op) override { visit_op(op); }
+    void visit(const Sub *op) override { visit_op(op); }
+    void visit(const Mul *op) override { visit_op(op); }
+    void visit(const Div *op) override { visit_op(op); }
+    void visit(const Mod *op) override { visit_op(op); }
+    void visit(const Min *op) override { visit_op(op); }
+    void visit(const Max *op) override { visit_op(op); }
+    void visit(const EQ *op) override { visit_op(op); }
+    void visit(const NE *op) override { visit_op(op); }
+    void visit(const LT *op) override { visit_op(op); }
+    void visit(const LE *op) override { visit_op(op); }
+    void visit(const GT *op) override { visit_op(op); }
+    void visit(const GE *op) override { visit_op(op); }
+    void visit(const And *op) override { visit_op(op); }
+    void visit(const Or *op) override { visit_op(op); }
+    void visit(const Not *op) override { visit_op(op); }
+    void visit(const Select *op) override { visit_op(op); }
+    void visit(const Cast *op) override { visit_op(op); }
+    void visit(const VectorReduce *op) override { visit_op(op); }
+
+    // Ramps, broadcasts, and shuffles mostly fold into the operations
+    // that use them, so they only contribute to the vector width.
+    void visit(const Ramp *op) override {
+        IRVisitor::visit(op);
+        note_type(op->type);
+    }
+
+    void visit(const Broadcast *op) override {
+        IRVisitor::visit(op);
+        note_type(op->type);
+    }
+
+    void visit(const Shuffle *op) override {
+        IRVisitor::visit(op);
+        note_type(op->type);
+    }
+
+    void visit(const Call *op) override {
+        IRVisitor::visit(op);
+        if (op->is_intrinsic(Call::likely) ||
+            op->is_intrinsic(Call::likely_if_innermost) ||
+            op->is_intrinsic(Call::return_second) ||
+            op->is_intrinsic(Call::promise_clamped) ||
+            op->is_intrinsic(Call::reinterpret)) {
+            // These don't result in any operations.
+            note_type(op->type);
+        } else {
+            count_op(op->type);
+        }
+    }
+
+    void visit(const Load *op) override {
+        IRVisitor::visit(op);
+        current.bytes_loaded = add_cost(current.bytes_loaded, op->type.bytes() * op->type.lanes());
+        note_type(op->type);
+    }
+
+    void visit(const Store *op) override {
+        IRVisitor::visit(op);
+        Type t = op->value.type();
+        current.bytes_stored = add_cost(current.bytes_stored, t.bytes() * t.lanes());
+        note_type(t);
+    }
+
+    void visit(const For *op) override {
+        op->min.accept(this);
+        op->extent.accept(this);
+
+        LoopCost outer = current;
+        current = LoopCost();
+        current.arith = current.bytes_loaded = current.bytes_stored = make_zero(Int(64));
+        op->body.accept(this);
+        LoopCost &body = loops[op];
+        body.arith = simplify(current.arith);
+        body.bytes_loaded = simplify(current.bytes_loaded);
+        body.bytes_stored = simplify(current.bytes_stored);
+        body.vector_width = current.vector_width;
+        current = outer;
+
+        // Estimate the loop's total cost using the largest its extent
+        // could be, if we can bound it.
+        Expr extent = find_constant_bound(op->extent, Direction::Upper);
+        if (!extent.defined()) {
+            extent = op->extent;
+        }
+        extent = cast<int64_t>(extent);
+        current.arith = add_cost(current.arith, simplify(body.arith * extent));
+        current.bytes_loaded = add_cost(current.bytes_loaded, simplify(body.bytes_loaded * extent));
+        current.bytes_stored = add_cost(current.bytes_stored, simplify(body.bytes_stored * extent));
+        current.vector_width = std::max(current.vector_width, body.vector_width);
+    }
+
+    void visit(const IfThenElse *op) override {
+        op->condition.accept(this);
+
+        LoopCost before = current;
+        op->then_case.accept(this);
+        LoopCost then_cost = current;
+        current = before;
+        if (op->else_case.defined()) {
+            op->else_case.accept(this);
+        }
+
+        // Count the more expensive branch.
+        auto larger = [](const Expr &a, const Expr &b) {
+            const int64_t *ca = as_const_int(a);
+            const int64_t *cb = as_const_int(b);
+            if (ca && cb) {
+                return *ca > *cb ? a : b;
+            }
+            return max(a, b);
+        };
+        current.arith = larger(then_cost.arith, current.arith);
+        current.bytes_loaded = larger(then_cost.bytes_loaded, current.bytes_loaded);
+        current.bytes_stored = larger(then_cost.bytes_stored, current.bytes_stored);
+        current.vector_width = std::max(current.vector_width, then_cost.vector_width);
+    }
+
+    void visit(const Allocate *op) override {
+        Expr bytes = make_const(Int(64), op->type.bytes());
+        for (const Expr &e : op->extents) {
+            bytes *= cast<int64_t>(e);
+            e.accept(this);
+        }
+        allocations[op] = simplify(bytes);
+        op->condition.accept(this);
+        if (op->new_expr.defined()) {
+            op->new_expr.accept(this);
+        }
+        op->body.accept(this);
+    }
+
+public:
+    // The cost of everything visited outside of any loop.
+    LoopCost result() const {
+        LoopCost c = current;
+        c.arith = simplify(c.arith);
+        c.bytes_loaded = simplify(c.bytes_loaded);
+        c.bytes_stored = simplify(c.bytes_stored);
+        return c;
+    }
+
+    ComputeCosts(map<const For *, LoopCost> &loops,
+                 map<const Allocate *, Expr> &allocations)
+        : loops(loops), allocations(allocations) {
+        current.arith = current.bytes_loaded = current.bytes_stored = make_zero(Int(64));
+    }
+};
+
+// Print a cost without the type prefix on 64-bit constants.
+string cost_to_string(const Expr &e) {
+    std::ostringstream s;
+    if (const int64_t *c = as_const_int(e)) {
+        s << *c;
+    } else {
+        s << e;
+    }
+    return s.str();
+}
+
+// An IRPrinter that puts a comment describing the cost before each
+// loop and allocation.
+class CostPrinter : public IRPrinter {
+    const StmtCosts &costs;
+
+    using IRPrinter::visit;
+
+    void visit(const For *op) override {
+        do_indent();
+        stream << "// " << costs.describe(op) << "\n";
+        IRPrinter::visit(op);
+    }
+
+    void visit(const Allocate *op) override {
+        do_indent();
+        stream << "// " << costs.describe(op) << "\n";
+        IRPrinter::visit(op);
+    }
+
+public:
+    CostPrinter(std::ostream &stream, const StmtCosts &costs)
+        : IRPrinter(stream), costs(costs) {}
+};
+
+}  // namespace
+
+StmtCosts::StmtCosts(const Stmt &s) {
+    compute(s);
+}
+
+void StmtCosts::compute(const Stmt &s) {
+    ComputeCosts c(loops, allocations);
+    s.accept(&c);
+}
+
+const LoopCost *StmtCosts::loop_cost(const For *op) const {
+    auto it = loops.find(op);
+    return it == loops.end() ? nullptr : &it->second;
+}
+
+Expr StmtCosts::allocation_bytes(const Allocate *op) const {
+    auto it = allocations.find(op);
+    return it == allocations.end() ? Expr() : it->second;
+}
+
+string StmtCosts::describe(const For *op) const {
+    const LoopCost *cost = loop_cost(op);
+    if (!cost) {
+        return "";
+    }
+    std::ostringstream s;
+    s << "per iteration: arith " << cost_to_string(cost->arith)
+      << ", loaded " << cost_to_string(cost->bytes_loaded) << " B"
+      << ", stored " << cost_to_string(cost->bytes_stored) << " B";
+    const int64_t *arith = as_const_int(cost->arith);
+    const int64_t *loaded = as_const_int(cost->bytes_loaded);
+    const int64_t *stored = as_const_int(cost->bytes_stored);
+    if (arith && loaded && stored && *loaded + *stored > 0) {
+        s.precision(3);
+        s << ", ops/byte " << (double)*arith / (*loaded + *stored);
+    }
+    s << ", vector width " << cost->vector_width;
+    return s.str();
+}
+
+string StmtCosts::describe(const Allocate *op) const {
+    Expr bytes = allocation_bytes(op);
+    if (!bytes.defined()) {
+        return "";
+    }
+    return "allocates " + cost_to_string(bytes) + " B";
+}
+
+LoopCost expr_cost(const Expr &e) {
+    map<const For *, LoopCost> loops;
+    map<const Allocate *, Expr> allocations;
+    ComputeCosts c(loops, allocations);
+    e.accept(&c);
+    return c.result();
+}
+
+void print_with_costs(std::ostream &stream, const Module &m) {
+    stream << "Target = " << m.target().to_string() << "\n";
+    for (const auto &b : m.buffers()) {
+        stream << "buffer " << b.name() << " = {...}\n\n";
+    }
+    for (const auto &f : m.functions()) {
+        stream << f.linkage << " func " << f.name << " (";
+        for (size_t i = 0; i < f.args.size(); i++) {
+            stream << f.args[i].name;
+            if (i + 1 < f.args.size()) {
+                stream << ", ";
+            }
+        }
+        stream << ") {\n";
+        StmtCosts costs(f.body);
+        CostPrinter printer(stream, costs);
+        printer.print(f.body);
+        stream << "}\n\n";
+    }
+}
+
+}  // namespace Internal
+}  // namespace Halide
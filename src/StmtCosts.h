@@ -0,0 +1,74 @@
+#ifndef HALIDE_STMT_COSTS_H
+#define HALIDE_STMT_COSTS_H
+
+/** \file
+ * Defines static estimates of the memory traffic and arithmetic of the
+ * loops and allocations in a lowered Stmt.
+ */
+
+#include <map>
+#include <ostream>
+#include <string>
+
+#include "Module.h"
+
+namespace Halide {
+namespace Internal {
+
+/** The estimated cost of one iteration of a loop. Arithmetic counts
+ * one op per vector lane, and loads and stores count the bytes of all
+ * their lanes, so that ops per byte doesn't depend on the vector
+ * width. Loops inside the loop contribute their cost times their
+ * extent. Only the more expensive branch of an if statement is
+ * counted. */
+struct LoopCost {
+    Expr arith;
+    Expr bytes_loaded;
+    Expr bytes_stored;
+    /** The most lanes of any vector operation in the loop. */
+    int vector_width = 1;
+};
+
+/** Static estimates of the costs of the loops and allocations in a
+ * lowered Stmt, computed once and queried by node. The nodes must
+ * outlive the StmtCosts. */
+class StmtCosts {
+    std::map<const For *, LoopCost> loops;
+    std::map<const Allocate *, Expr> allocations;
+
+public:
+    StmtCosts() {}
+    EXPORT StmtCosts(const Stmt &s);
+
+    /** Add the costs of the loops and allocations in another Stmt. */
+    EXPORT void compute(const Stmt &s);
+
+    /** Get the cost of one iteration of a loop, or nullptr if it
+     * isn't in any of the Stmts analyzed. */
+    EXPORT const LoopCost *loop_cost(const For *op) const;
+
+    /** Get the number of bytes an allocation requests, or an undefined
+     * Expr if it isn't in any of the Stmts analyzed. */
+    EXPORT Expr allocation_bytes(const Allocate *op) const;
+
+    /** Describe the costs of a loop or allocation in one line, or
+     * return an empty string if it wasn't analyzed. */
+    // @{
+    EXPORT std::string describe(const For *op) const;
+    EXPORT std::string describe(const Allocate *op) const;
+    // @}
+};
+
+/** Estimate the cost of evaluating an expression once. Only the
+ * arithmetic, bytes loaded, and vector width of the result are set. */
+EXPORT LoopCost expr_cost(const Expr &e);
+
+/** Emit a module in the same form as operator<<, with a comment before
+ * each loop and allocation describing its estimated costs. This is
+ * what compile_to_lowered_stmt writes. */
+EXPORT void print_with_costs(std::ostream &stream, const Module &m);
+
+}  // namespace Internal
+}  // namespace Halide
+
+#endif
@@ -1,4 +1,5 @@
 #include "StmtToHtml.h"
+#include "StmtCosts.h"
 #include "IRVisitor.h"
 #include "IROperator.h"
 #include "Scope.h"
@@ -85,6 +86,12 @@ private:
         return close_tag("div") + "\n";
     }
 
+    // Estimates of the costs of the loops and allocations printed.
+    StmtCosts costs;
+    string cost_comment(const string &description) {
+        return description.empty() ? "" : " " + span("Comment", "// " + description);
+    }
+
     string open_line() { return "<p class=WrapLine>"; }
     string close_line() { return "</p>"; }
 
@@ -360,6 +367,8 @@ private:
             stream << keyword("gpu_block");
         } else if (op->for_type == ForType::GPUThread) {
             stream << keyword("gpu_thread");
+        } else if (op->for_type == ForType::GPULane) {
+            stream << keyword("gpu_lane");
         } else {
             internal_assert(false) << "Unknown for type: " << ((int)op->for_type) << "\n";
         }
@@ -369,6 +378,7 @@ private:
         stream << matched(")");
         stream << close_expand_button();
         stream << " " << matched("{");
+        stream << cost_comment(costs.describe(op));
         stream << open_div("ForBody Indent", id);
         print(op->body);
         stream << close_div();
@@ -441,6 +451,7 @@ private:
             stream << keyword("custom_delete") << "{ " << op->free_function << "(); ";
             stream << matched("}");
         }
+        stream << cost_comment(costs.describe(op));
 
         stream << open_div("AllocateBody");
         print(op->body);
@@ -496,6 +507,33 @@ private:
         stream << close_span();
     }
 
+    void visit(const VectorReduce *op) {
+        stream << open_span("VectorReduce");
+        stream << open_span("Type") << op->type << close_span();
+        stream << symbol("vector_reduce") << "(";
+        std::ostringstream op_name;
+        op_name << op->op;
+        stream << symbol(op_name.str()) << ", ";
+        print(op->value);
+        stream << ")";
+        stream << close_span();
+    }
+
+    void visit(const Atomic *op) {
+        stream << open_div("Atomic");
+        int id = unique_id();
+        stream << open_expand_button(id);
+        stream << keyword("atomic") << " ";
+        stream << var(op->producer_name);
+        stream << close_expand_button();
+        stream << " " << matched("{");
+        stream << open_div("AtomicBody Indent", id);
+        print(op->body);
+        stream << close_div();
+        stream << matched("}");
+        stream << close_div();
+    }
+
     // To avoid generating ridiculously deep DOMs, we flatten blocks here.
     void visit_block_stmt(Stmt stmt) {
         if (const Block *b = stmt.as<Block>()) {
@@ -599,6 +637,7 @@ public:
     }
 
     void print(const LoweredFunc &op) {
+        costs.compute(op.body);
         scope.push(op.name, unique_id());
         stream << open_div("Function");
 
@@ -626,6 +665,10 @@ public:
         scope.pop(op.name);
     }
 
+    void compute_costs(Stmt s) {
+        costs.compute(s);
+    }
+
     void print(const Buffer<> &op) {
         stream << open_div("Buffer<>");
         stream << keyword("buffer ") << var(op.name());
@@ -695,6 +738,7 @@ function toggle(id) { \n \
 
 void print_to_html(string filename, Stmt s) {
     StmtToHtml sth(filename);
+    sth.compute_costs(s);
     sth.print(s);
 }
 
@@ -21,6 +21,59 @@ using std::set;
 
 namespace {
 
+// The tile sizes of each dimension of a Func, in the order of its
+// arguments. Untiled dimensions have a tile size of one.
+vector<int> storage_tile_factors(const Function &f) {
+    vector<int> factors;
+    bool tiled = false;
+    for (const string &arg : f.args()) {
+        int factor = 1;
+        for (const StorageDim &d : f.schedule().storage_dims()) {
+            if (d.var == arg && d.tile_factor.defined()) {
+                const int64_t *c = as_const_int(d.tile_factor);
+                user_assert(c && *c > 0)
+                    << "The storage of " << f.name() << " is tiled along " << arg
+                    << " by " << d.tile_factor << ", which is not a positive integer constant.\n";
+                factor = (int)(*c);
+                tiled = tiled || factor > 1;
+            }
+        }
+        factors.push_back(factor);
+    }
+    if (!tiled) {
+        factors.clear();
+    }
+    return factors;
+}
+
+// Whether the Tuple elements of a Func are stored interleaved, in a
+// single realization with an extra innermost dimension (see
+// SplitTuples).
+bool is_interleaved(const Function &f) {
+    return f.outputs() > 1 && f.schedule().store_interleaved();
+}
+
+// The dimensions of the realization of a Func, from innermost to
+// outermost in storage.
+vector<int> realization_storage_order(const Function &f) {
+    vector<int> permutation;
+    const int offset = is_interleaved(f) ? 1 : 0;
+    if (offset) {
+        permutation.push_back(0);
+    }
+    const vector<StorageDim> &storage_dims = f.schedule().storage_dims();
+    const vector<string> &args = f.args();
+    for (size_t i = 0; i < storage_dims.size(); i++) {
+        for (size_t j = 0; j < args.size(); j++) {
+            if (args[j] == storage_dims[i].var) {
+                permutation.push_back((int)j + offset);
+            }
+        }
+        internal_assert(permutation.size() == i + 1 + offset);
+    }
+    return permutation;
+}
+
 class FlattenDimensions : public IRMutator2 {
 public:
     FlattenDimensions(const map<string, pair<Function, int>> &e,
@@ -30,6 +83,30 @@ public:
         for (auto &f : o) {
             outputs.insert(f.name());
         }
+        // Tiled storage can only be addressed by the code Halide
+        // generates, so it can't leak out into a halide_buffer_t
+        // that's used by something else.
+        for (const auto &i : env) {
+            const Function &f = i.second.first;
+            if (storage_tile_factors(f).empty()) {
+                continue;
+            }
+            user_assert(!outputs.count(f.name()))
+                << "Func " << f.name() << " is an output, so its storage can't be tiled.\n";
+            user_assert(f.debug_file().empty())
+                << "Func " << f.name() << " is dumped with debug_to_file, so its storage can't be tiled.\n";
+            for (const auto &j : env) {
+                const Function &g = j.second.first;
+                if (!g.has_extern_definition()) {
+                    continue;
+                }
+                for (const ExternFuncArgument &arg : g.extern_arguments()) {
+                    user_assert(!arg.is_func() || Function(arg.func).name() != f.name())
+                        << "Func " << f.name() << " is an input to the extern stage "
+                        << g.name() << ", so its storage can't be tiled.\n";
+                }
+            }
+        }
     }
     Scope<int> scope;
 private:
@@ -39,6 +116,12 @@ private:
     Scope<int> realizations, shader_scope_realizations;
     bool in_shader = false;
 
+    // The layout of the realizations with tiled storage.
+    struct TiledStorage {
+        vector<int> factors, inner_strides;
+    };
+    map<string, TiledStorage> tiled_storage;
+
     Expr make_shape_var(string name, string field, size_t dim,
                         const Buffer<> &buf, const Parameter &param) {
         ReductionDomain rdom;
@@ -65,18 +148,45 @@ private:
 
         Expr zero = target.has_large_buffers() ? make_zero(Int(64)) : 0;
 
+        const TiledStorage *tiles = nullptr;
+        if (internal) {
+            auto it = tiled_storage.find(name);
+            if (it != tiled_storage.end()) {
+                tiles = &(it->second);
+            }
+        }
+
         // We peel off constant offsets so that multiple stencil
-        // taps can share the same base address.
+        // taps can share the same base address. An offset along a
+        // tiled dimension may cross into the next tile, so those
+        // can't be peeled off.
         Expr constant_term = zero;
         for (size_t i = 0; i < args.size(); i++) {
             const Add *add = args[i].as<Add>();
-            if (add && is_const(add->b)) {
+            if (add && is_const(add->b) && !(tiles && tiles->factors[i] > 1)) {
                 constant_term += strides[i] * add->b;
                 args[i] = add->a;
             }
         }
 
-        if (internal) {
+        if (tiles) {
+            // f(x, y) -> f[(x-xmin)/xtile*xtilestride + (x-xmin)%xtile*xinnerstride + ...]
+            // The strides of the tiles replace the usual strides, and
+            // the position within each tile is added on.
+            for (size_t i = 0; i < args.size(); i++) {
+                Expr tile_stride = make_shape_var(name, "tile_stride", i, buf, param);
+                if (target.has_large_buffers()) {
+                    tile_stride = cast<int64_t>(tile_stride);
+                }
+                Expr coord = args[i] - mins[i];
+                int factor = tiles->factors[i];
+                if (factor > 1) {
+                    idx += (coord / factor) * tile_stride + (coord % factor) * tiles->inner_strides[i];
+                } else {
+                    idx += coord * tile_stride;
+                }
+            }
+        } else if (internal) {
             // f(x, y) -> f[(x-xmin)*xstride + (y-ymin)*ystride] This
             // strategy makes sense when we expect x to cancel with
             // something in xmin.  We use this for internal allocations.
@@ -113,6 +223,30 @@ private:
             shader_scope_realizations.push(op->name, 0);
         }
 
+        // Work out the layout within each tile of tiled storage
+        // before the loads and stores are flattened.
+        vector<int> tile_factors;
+        {
+            auto iter = env.find(op->name);
+            internal_assert(iter != env.end()) << "Realize node refers to function not in environment.\n";
+            const Function &f = iter->second.first;
+            tile_factors = storage_tile_factors(f);
+            if (!tile_factors.empty()) {
+                TiledStorage &tiles = tiled_storage[op->name];
+                tiles.factors = tile_factors;
+                tiles.inner_strides.resize(tile_factors.size());
+                int tile_size = 1;
+                for (const StorageDim &d : f.schedule().storage_dims()) {
+                    for (size_t j = 0; j < f.args().size(); j++) {
+                        if (f.args()[j] == d.var) {
+                            tiles.inner_strides[j] = tile_size;
+                            tile_size *= tile_factors[j];
+                        }
+                    }
+                }
+            }
+        }
+
         Stmt body = mutate(op->body);
 
         // Compute the size
@@ -139,21 +273,30 @@ private:
             auto iter = env.find(op->name);
             internal_assert(iter != env.end()) << "Realize node refers to function not in environment.\n";
             Function f = iter->second.first;
+            storage_permutation = realization_storage_order(f);
             const vector<StorageDim> &storage_dims = f.schedule().storage_dims();
             const vector<string> &args = f.args();
+            if (is_interleaved(f)) {
+                // The dimension that indexes the Tuple.
+                allocation_extents[0] = extents[0];
+            }
+            const int offset = is_interleaved(f) ? 1 : 0;
             for (size_t i = 0; i < storage_dims.size(); i++) {
                 for (size_t j = 0; j < args.size(); j++) {
                     if (args[j] == storage_dims[i].var) {
-                        storage_permutation.push_back((int)j);
+                        const int k = (int)j + offset;
                         Expr alignment = storage_dims[i].alignment;
                         if (alignment.defined()) {
-                            allocation_extents[j] = ((extents[j] + alignment - 1)/alignment)*alignment;
+                            allocation_extents[k] = ((extents[k] + alignment - 1)/alignment)*alignment;
                         } else {
-                            allocation_extents[j] = extents[j];
+                            allocation_extents[k] = extents[k];
+                        }
+                        if (!tile_factors.empty() && tile_factors[j] > 1) {
+                            int factor = tile_factors[j];
+                            allocation_extents[k] = ((allocation_extents[k] + factor - 1)/factor)*factor;
                         }
                     }
                 }
-                internal_assert(storage_permutation.size() == i+1);
             }
         }
 
@@ -191,7 +334,7 @@ private:
         stmt = LetStmt::make(op->name + ".buffer", builder.build(), stmt);
 
         // Make the allocation node
-        stmt = Allocate::make(op->name, op->types[0], allocation_extents, condition, stmt);
+        stmt = Allocate::make(op->name, op->types[0], op->memory_type, allocation_extents, condition, stmt);
 
         // Compute the strides
         for (int i = (int)op->bounds.size()-1; i > 0; i--) {
@@ -207,6 +350,34 @@ private:
             stmt = LetStmt::make(stride_name[innermost], 1, stmt);
         }
 
+        // With tiled storage, the strides above describe a dense
+        // allocation of the same size, so that the buffer_t has the
+        // right size for device allocations and copies. The stores
+        // and loads use the strides of the tiles instead, with the
+        // elements of each tile stored contiguously.
+        if (!tile_factors.empty()) {
+            int tile_size = 1;
+            for (int f : tile_factors) {
+                tile_size *= f;
+            }
+
+            vector<string> tile_stride_name(dims);
+            for (int i = 0; i < dims; i++) {
+                tile_stride_name[i] = op->name + ".tile_stride." + std::to_string(i);
+            }
+            for (int i = dims - 1; i > 0; i--) {
+                int prev_j = storage_permutation[i-1];
+                int j = storage_permutation[i];
+                Expr stride = (Variable::make(Int(32), tile_stride_name[prev_j]) *
+                               (allocation_extents[prev_j] / tile_factors[prev_j]));
+                stmt = LetStmt::make(tile_stride_name[j], stride, stmt);
+            }
+            if (dims > 0) {
+                stmt = LetStmt::make(tile_stride_name[storage_permutation[0]], tile_size, stmt);
+            }
+            tiled_storage.erase(op->name);
+        }
+
         // Assign the mins and extents stored
         for (size_t i = op->bounds.size(); i > 0; i--) {
             stmt = LetStmt::make(min_name[i-1], op->bounds[i-1].min, stmt);
@@ -323,20 +494,7 @@ private:
         if (iter != env.end()) {
             // Order the <min, extent> args based on the storage dims (i.e. innermost
             // dimension should be first in args)
-            vector<int> storage_permutation;
-            {
-                Function f = iter->second.first;
-                const vector<StorageDim> &storage_dims = f.schedule().storage_dims();
-                const vector<string> &args = f.args();
-                for (size_t i = 0; i < storage_dims.size(); i++) {
-                    for (size_t j = 0; j < args.size(); j++) {
-                        if (args[j] == storage_dims[i].var) {
-                            storage_permutation.push_back((int)j);
-                        }
-                    }
-                    internal_assert(storage_permutation.size() == i+1);
-                }
-            }
+            vector<int> storage_permutation = realization_storage_order(iter->second.first);
             internal_assert(storage_permutation.size() == op->bounds.size());
 
             for (size_t i = 0; i < op->bounds.size(); i++) {
@@ -373,7 +531,8 @@ private:
     Stmt visit(const For *op) override {
         bool old_in_shader = in_shader;
         if ((op->for_type == ForType::GPUBlock ||
-             op->for_type == ForType::GPUThread) &&
+             op->for_type == ForType::GPUThread ||
+             op->for_type == ForType::GPULane) &&
             op->device_api == DeviceAPI::GLSL) {
             in_shader = true;
         }
@@ -420,7 +579,7 @@ class PromoteToMemoryType : public IRMutator2 {
             for (Expr e : op->extents) {
                 extents.push_back(mutate(e));
             }
-            return Allocate::make(op->name, t, extents,
+            return Allocate::make(op->name, t, op->memory_type, extents,
                                   mutate(op->condition), mutate(op->body),
                                   mutate(op->new_expr), op->free_function);
         } else {
@@ -443,7 +602,9 @@ Stmt storage_flattening(Stmt s,
     // all point to the function foo.
     map<string, pair<Function, int>> tuple_env;
     for (auto p : env) {
-        if (p.second.outputs() > 1) {
+        if (is_interleaved(p.second)) {
+            tuple_env[p.first] = {p.second, 0};
+        } else if (p.second.outputs() > 1) {
             for (int i = 0; i < p.second.outputs(); i++) {
                 tuple_env[p.first + "." + std::to_string(i)] = {p.second, i};
             }
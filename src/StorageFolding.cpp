@@ -8,6 +8,7 @@
 #include "Debug.h"
 #include "Monotonic.h"
 #include "ExprUsesVar.h"
+#include "InjectHostDevBufferCopies.h"
 
 namespace Halide {
 namespace Internal {
@@ -293,6 +294,39 @@ public:
 
 
 
+// The producer of a Func scheduled async is allowed to start on one
+// more realization than the consumer has finished with, so that the
+// two can overlap. The fold is made big enough to hold that many.
+const int async_folding_semaphore_init = 2;
+
+// Make the producer of an async Func wait for the consumer to be done
+// with a realization before overwriting it with a new one, by way of
+// a semaphore counting free realizations in the fold.
+class InjectFoldingSemaphore : public IRMutator {
+    string func;
+    Expr sema;
+
+    using IRMutator::visit;
+
+    void visit(const ProducerConsumer *op) {
+        if (op->name == func) {
+            if (op->is_producer) {
+                stmt = Block::make(call_extern_and_assert("halide_semaphore_acquire", {sema, 1}), op);
+            } else {
+                Stmt release = Evaluate::make(Call::make(Int(32), "halide_semaphore_release",
+                                                         {sema, 1}, Call::Extern));
+                stmt = Block::make(op, release);
+            }
+        } else {
+            IRMutator::visit(op);
+        }
+    }
+
+public:
+    InjectFoldingSemaphore(string f, string s) :
+        func(f), sema(Variable::make(Handle(), s)) {}
+};
+
 // Attempt to fold the storage of a particular function in a statement
 class AttemptStorageFoldingOfFunction : public IRMutator {
     Function func;
@@ -317,6 +351,10 @@ class AttemptStorageFoldingOfFunction : public IRMutator {
             // by the threads as this loop counter varies
             // (i.e. there's no cross-talk between threads), then it's
             // safe to proceed.
+            for (int dim = 0; dim < func.dimensions(); dim++) {
+                give_up(dim, "it is used within the " + std::string(op->for_type == ForType::Parallel ? "parallel" : "non-serial") +
+                        " loop over " + op->name);
+            }
             stmt = op;
             return;
         }
@@ -362,6 +400,10 @@ class AttemptStorageFoldingOfFunction : public IRMutator {
 
             if (!min_monotonic_increasing && !max_monotonic_decreasing &&
                 explicit_factor.defined()) {
+                user_assert(!func.schedule().async() && !func.schedule().double_buffer())
+                    << "Can't fold the storage of " << func.name() << " over the loop "
+                    << op->name << ", because it's scheduled async or double_buffer, and its footprint "
+                    << "couldn't be proven to move monotonically across the loop.\n";
                 // If we didn't find a monotonic dimension, and we
                 // have an explicit fold factor, we need to
                 // dynamically check that the min/max do in fact
@@ -387,6 +429,17 @@ class AttemptStorageFoldingOfFunction : public IRMutator {
             // variable, and should depend on the loop variable.
             if (min_monotonic_increasing || max_monotonic_decreasing) {
                 Expr extent = simplify(max - min + 1);
+                if (func.schedule().async() || func.schedule().double_buffer()) {
+                    // The producer may be working on the next
+                    // iteration while the consumer is still reading
+                    // this one.
+                    Expr next_var = Variable::make(Int(32), op->name) + 1;
+                    if (min_monotonic_increasing) {
+                        extent = simplify(substitute(op->name, next_var, max) - min + 1);
+                    } else {
+                        extent = simplify(max - substitute(op->name, next_var, min) + 1);
+                    }
+                }
                 Expr factor;
                 if (explicit_factor.defined()) {
                     if (dynamic_footprint.empty()) {
@@ -416,6 +469,8 @@ class AttemptStorageFoldingOfFunction : public IRMutator {
                         debug(3) << "Not folding because extent not bounded by a constant not greater than " << max_fold << "\n"
                                  << "extent = " << extent << "\n"
                                  << "max extent = " << max_extent << "\n";
+                        give_up(dim, "its extent over the loop over " + op->name +
+                                " could not be bounded by a constant no greater than " + std::to_string(max_fold));
                     }
                 }
 
@@ -426,6 +481,19 @@ class AttemptStorageFoldingOfFunction : public IRMutator {
                     dims_folded.push_back(fold);
                     body = FoldStorageOfFunction(func.name(), (int)i - 1, factor, dynamic_footprint).mutate(body);
 
+                    if (func.schedule().async() || func.schedule().double_buffer()) {
+                        // Only fold one dimension. Had we continued
+                        // into an inner loop, the producer's next
+                        // realization could wrap around onto the
+                        // start of that loop's fold.
+                        if (func.schedule().async()) {
+                            folding_semaphore = func.name() + ".folding_semaphore";
+                            body = InjectFoldingSemaphore(func.name(), folding_semaphore).mutate(body);
+                        }
+                        stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+                        return;
+                    }
+
                     Expr next_var = Variable::make(Int(32), op->name) + 1;
                     Expr next_min = substitute(op->name, next_var, min);
                     if (can_prove(max < next_min)) {
@@ -433,7 +501,19 @@ class AttemptStorageFoldingOfFunction : public IRMutator {
                         // iterations, so we can continue to search
                         // for further folding opportinities
                         // recursively.
+                    } else if (dynamic_footprint.empty() && box_contains(provided, required)) {
+                        // The footprints of the iterations overlap,
+                        // but each iteration computes everything it
+                        // uses, so nothing is passed from one
+                        // iteration to the next through the folded
+                        // storage. We can also fold other dimensions,
+                        // e.g. over an inner loop over tiles, to get
+                        // a circular buffer the size of a tile.
                     } else if (!body.same_as(op->body)) {
+                        for (int d = 0; d < func.dimensions(); d++) {
+                            give_up(d, "values computed in one iteration of the loop over " + op->name +
+                                    " are used by later ones, so inner loops were not considered");
+                        }
                         stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
                         if (!dynamic_footprint.empty()) {
                             Expr init_val;
@@ -444,7 +524,7 @@ class AttemptStorageFoldingOfFunction : public IRMutator {
                             }
                             Stmt init_min = Store::make(dynamic_footprint, init_val, 0, Parameter(), const_true());
                             stmt = Block::make(init_min, stmt);
-                            stmt = Allocate::make(dynamic_footprint, Int(32), {}, const_true(), stmt);
+                            stmt = Allocate::make(dynamic_footprint, Int(32), MemoryType::Stack, {}, const_true(), stmt);
                         }
                         return;
                     } else {
@@ -456,6 +536,13 @@ class AttemptStorageFoldingOfFunction : public IRMutator {
                 debug(3) << "Not folding because loop min or max not monotonic in the loop variable\n"
                          << "min = " << min << "\n"
                          << "max = " << max << "\n";
+                if (expr_uses_var(min, op->name) || expr_uses_var(max, op->name)) {
+                    if (explicit_only) {
+                        give_up(dim, "it has more than one producer, so only folds requested with fold_storage are tried");
+                    } else {
+                        give_up(dim, "its footprint could not be proven to move monotonically over the loop over " + op->name);
+                    }
+                }
             }
         }
 
@@ -473,6 +560,10 @@ class AttemptStorageFoldingOfFunction : public IRMutator {
         }
     }
 
+    void give_up(int dim, const string &reason) {
+        why_not_folded[dim].push_back(reason);
+    }
+
 public:
     struct Fold {
         int dim;
@@ -480,6 +571,14 @@ public:
     };
     vector<Fold> dims_folded;
 
+    // For each dimension, the reasons it couldn't be folded over each
+    // loop it was considered for.
+    map<int, vector<string>> why_not_folded;
+
+    // The semaphore the producer of an async Func waits on for room
+    // in the fold, if its storage was folded.
+    string folding_semaphore;
+
     AttemptStorageFoldingOfFunction(Function f, bool explicit_only)
         : func(f), explicit_only(explicit_only) {}
 };
@@ -505,10 +604,37 @@ class StorageFolding : public IRMutator {
         debug(3) << "Attempting to fold " << op->name << "\n";
         body = folder.mutate(body);
 
+        // Explain why storage wasn't folded, as a warning if the
+        // schedule asked for it.
+        for (const auto &it : folder.why_not_folded) {
+            int d = it.first;
+            bool folded = false;
+            for (const auto &fold : folder.dims_folded) {
+                folded = folded || fold.dim == d;
+            }
+            if (folded) {
+                continue;
+            }
+            const StorageDim &storage_dim = func.schedule().storage_dims()[d];
+            std::ostringstream reasons;
+            for (const string &reason : it.second) {
+                reasons << "  " << reason << "\n";
+            }
+            if (storage_dim.fold_factor.defined()) {
+                user_warning << "Could not fold the storage of " << op->name
+                             << " along " << storage_dim.var << " as requested, because:\n"
+                             << reasons.str();
+            } else {
+                debug(1) << "Did not fold the storage of " << op->name
+                         << " along " << storage_dim.var << ", because:\n"
+                         << reasons.str();
+            }
+        }
+
         if (body.same_as(op->body)) {
             stmt = op;
         } else if (folder.dims_folded.empty()) {
-            stmt = Realize::make(op->name, op->types, op->bounds, op->condition, body);
+            stmt = Realize::make(op->name, op->types, op->memory_type, op->bounds, op->condition, body);
         } else {
             Region bounds = op->bounds;
 
@@ -521,7 +647,20 @@ class StorageFolding : public IRMutator {
                 bounds[d] = Range(0, f);
             }
 
-            stmt = Realize::make(op->name, op->types, bounds, op->condition, body);
+            stmt = Realize::make(op->name, op->types, op->memory_type, bounds, op->condition, body);
+
+            if (!folder.folding_semaphore.empty()) {
+                // The semaphore is shared by the producer and
+                // consumer once they're forked (see
+                // AsyncProducers.cpp), so it goes outside the
+                // realization.
+                Expr sema = Variable::make(Handle(), folder.folding_semaphore);
+                Stmt init = Evaluate::make(Call::make(Int(32), "halide_semaphore_init",
+                                                      {sema, async_folding_semaphore_init},
+                                                      Call::Extern));
+                stmt = Allocate::make(folder.folding_semaphore, UInt(64), MemoryType::Stack, {2}, const_true(),
+                                      Block::make(init, stmt));
+            }
         }
     }
 
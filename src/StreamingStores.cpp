@@ -0,0 +1,79 @@
+#include "StreamingStores.h"
+#include "Function.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::set;
+using std::string;
+
+namespace {
+
+// Non-temporal stores of less than a cache line have to be combined
+// with the rest of the line in memory, which is slower than an
+// ordinary store.
+const int cache_line_bytes = 64;
+
+class InjectStreamingStores : public IRMutator2 {
+    const set<string> &buffers;
+    bool in_device_loop = false;
+
+    using IRMutator2::visit;
+
+    Stmt visit(const For *op) override {
+        bool old_in_device_loop = in_device_loop;
+        if (op->device_api != DeviceAPI::None && op->device_api != DeviceAPI::Host) {
+            in_device_loop = true;
+        }
+        Stmt stmt = IRMutator2::visit(op);
+        in_device_loop = old_in_device_loop;
+        return stmt;
+    }
+
+    Stmt visit(const Store *op) override {
+        const Type &t = op->value.type();
+        const Ramp *ramp = op->index.as<Ramp>();
+        if (in_device_loop ||
+            !buffers.count(op->name) ||
+            !is_one(op->predicate) ||
+            !ramp || !is_one(ramp->stride) ||
+            t.is_handle() ||
+            t.bytes() * t.lanes() < cache_line_bytes) {
+            return op;
+        }
+        Expr value = Call::make(t, Call::nontemporal, {op->value}, Call::Intrinsic);
+        return Store::make(op->name, value, op->index, op->param, op->predicate);
+    }
+
+public:
+    InjectStreamingStores(const set<string> &buffers) : buffers(buffers) {}
+};
+
+}  // namespace
+
+Stmt inject_streaming_stores(Stmt s, const map<string, Function> &env) {
+    set<string> buffers;
+    for (const auto &p : env) {
+        const Function &f = p.second;
+        if (!f.schedule().store_streaming()) {
+            continue;
+        }
+        if (f.outputs() == 1) {
+            buffers.insert(f.name());
+        } else {
+            for (int i = 0; i < f.outputs(); i++) {
+                buffers.insert(f.name() + "." + std::to_string(i));
+            }
+        }
+    }
+    if (buffers.empty()) {
+        return s;
+    }
+    return InjectStreamingStores(buffers).mutate(s);
+}
+
+}
+}
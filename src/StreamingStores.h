@@ -0,0 +1,29 @@
+#ifndef HALIDE_STREAMING_STORES_H
+#define HALIDE_STREAMING_STORES_H
+
+/** \file
+ * Defines the lowering pass that marks the stores to Funcs scheduled
+ * store_streaming.
+ */
+
+#include <map>
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+class Function;
+
+/** Wrap the values of the dense vector stores to Funcs scheduled
+ * store_streaming in the nontemporal intrinsic, so that they are
+ * generated as non-temporal stores. Stores that fill less than a
+ * cache line, predicated stores, and stores outside of CPU loops are
+ * left alone. Should be run after vectorization, and after the last
+ * pass that moves or combines stores. */
+Stmt inject_streaming_stores(Stmt s, const std::map<std::string, Function> &env);
+
+}
+}
+
+#endif
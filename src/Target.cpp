@@ -9,12 +9,16 @@
 #include "LLVM_Headers.h"
 #include "Util.h"
 
-#if defined(__powerpc__) && defined(__linux__)
+#if (defined(__powerpc__) || defined(__aarch64__) || defined(__riscv)) && defined(__linux__)
 // This uses elf.h and must be included after "LLVM_Headers.h", which
 // uses llvm/support/Elf.h.
 #include <sys/auxv.h>
 #endif
 
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/prctl.h>
+#endif
+
 namespace Halide {
 
 using std::string;
@@ -72,9 +76,46 @@ Target calculate_host_target() {
     Target::Arch arch = Target::MIPS;
     return Target(os, arch, bits);
 #else
+#if defined(__riscv) && defined(__linux__)
+    Target::Arch arch = Target::RISCV;
+
+    const unsigned long hwcap_v = 1UL << ('V' - 'A');
+    const unsigned long hwcap = getauxval(AT_HWCAP);
+    user_assert(hwcap & hwcap_v)
+        << "The RISCV backend assumes the V extension. This machine does not appear to have it.\n";
+
+    return Target(os, arch, bits);
+#else
 #if defined(__arm__) || defined(__aarch64__)
     Target::Arch arch = Target::ARM;
-    return Target(os, arch, bits);
+
+    std::vector<Target::Feature> initial_features;
+#if defined(__aarch64__) && defined(__linux__)
+    const unsigned long hwcap_asimddp = 1UL << 20;
+    const unsigned long hwcap = getauxval(AT_HWCAP);
+    if (hwcap & hwcap_asimddp) {
+        initial_features.push_back(Target::ARMDotProd);
+    }
+#if LLVM_VERSION >= 120
+    // Only LLVM 12 and later can generate SVE code for us.
+    const unsigned long hwcap_sve = 1UL << 22;
+    if (hwcap & hwcap_sve) {
+        // The SVE vector length is up to the implementation. We
+        // compile for a fixed vector length, so use the one this
+        // thread is running with. 128-bit SVE is no wider than NEON,
+        // so we don't bother with it.
+        const int pr_sve_get_vl = 51;
+        int vl_bytes = prctl(pr_sve_get_vl) & 0xffff;
+        if (vl_bytes >= 64) {
+            initial_features.push_back(Target::SVE_512);
+        } else if (vl_bytes >= 32) {
+            initial_features.push_back(Target::SVE_256);
+        }
+    }
+#endif
+#endif
+
+    return Target(os, arch, bits, initial_features);
 #else
 #if defined(__powerpc__) && defined(__linux__)
     Target::Arch arch = Target::POWERPC;
@@ -84,6 +125,11 @@ Target calculate_host_target() {
     bool have_altivec = (hwcap & PPC_FEATURE_HAS_ALTIVEC) != 0;
     bool have_vsx     = (hwcap & PPC_FEATURE_HAS_VSX) != 0;
     bool arch_2_07    = (hwcap2 & PPC_FEATURE2_ARCH_2_07) != 0;
+    // Older headers don't define these.
+    const unsigned long hwcap2_arch_3_00 = 0x00800000;
+    const unsigned long hwcap2_arch_3_1  = 0x00040000;
+    bool arch_3_00    = (hwcap2 & hwcap2_arch_3_00) != 0;
+    bool arch_3_1     = (hwcap2 & hwcap2_arch_3_1) != 0;
 
     user_assert(have_altivec)
         << "The POWERPC backend assumes at least AltiVec support. This machine does not appear to have AltiVec.\n";
@@ -91,6 +137,8 @@ Target calculate_host_target() {
     std::vector<Target::Feature> initial_features;
     if (have_vsx)     initial_features.push_back(Target::VSX);
     if (arch_2_07)    initial_features.push_back(Target::POWER_ARCH_2_07);
+    if (arch_3_00)    initial_features.push_back(Target::POWER_ARCH_3_00);
+    if (arch_3_1)     initial_features.push_back(Target::POWER_ARCH_3_1);
 
     return Target(os, arch, bits, initial_features);
 #else
@@ -138,6 +186,7 @@ Target calculate_host_target() {
         const uint32_t avx512_knl = avx512 | avx512pf | avx512er;
         const uint32_t avx512_skylake = avx512 | avx512vl | avx512bw | avx512dq;
         const uint32_t avx512_cannonlake = avx512_skylake | avx512ifma; // Assume ifma => vbmi
+        const uint32_t avx512vnni = 1U << 11; // In ecx
         if ((info2[1] & avx2) == avx2) {
             initial_features.push_back(Target::AVX2);
         }
@@ -152,6 +201,10 @@ Target calculate_host_target() {
             if ((info2[1] & avx512_cannonlake) == avx512_cannonlake) {
                 initial_features.push_back(Target::AVX512_Cannonlake);
             }
+            if ((info2[1] & avx512_skylake) == avx512_skylake &&
+                (info2[2] & avx512vnni) == avx512vnni) {
+                initial_features.push_back(Target::AVX512_Cascadelake);
+            }
         }
     }
 #ifdef _WIN32
@@ -164,6 +217,7 @@ Target calculate_host_target() {
 #endif
 #endif
 #endif
+#endif
 }
 
 }  // namespace
@@ -188,6 +242,7 @@ const std::map<std::string, Target::OS> os_name_map = {
     {"ios", Target::IOS},
     {"qurt", Target::QuRT},
     {"noos", Target::NoOS},
+    {"wasmrt", Target::WebAssemblyRuntime},
 };
 
 bool lookup_os(const std::string &tok, Target::OS &result) {
@@ -206,6 +261,8 @@ const std::map<std::string, Target::Arch> arch_name_map = {
     {"mips", Target::MIPS},
     {"powerpc", Target::POWERPC},
     {"hexagon", Target::Hexagon},
+    {"wasm", Target::WebAssembly},
+    {"riscv", Target::RISCV},
 };
 
 bool lookup_arch(const std::string &tok, Target::Arch &result) {
@@ -238,6 +295,9 @@ const std::map<std::string, Target::Feature> feature_name_map = {
     {"cuda_capability_35", Target::CUDACapability35},
     {"cuda_capability_50", Target::CUDACapability50},
     {"cuda_capability_61", Target::CUDACapability61},
+    {"cuda_capability_70", Target::CUDACapability70},
+    {"cuda_capability_75", Target::CUDACapability75},
+    {"cuda_managed_memory", Target::CUDAManagedMemory},
     {"opencl", Target::OpenCL},
     {"cl_doubles", Target::CLDoubles},
     {"opengl", Target::OpenGL},
@@ -263,9 +323,26 @@ const std::map<std::string, Target::Feature> feature_name_map = {
     {"avx512_knl", Target::AVX512_KNL},
     {"avx512_skylake", Target::AVX512_Skylake},
     {"avx512_cannonlake", Target::AVX512_Cannonlake},
+    {"avx512_cascadelake", Target::AVX512_Cascadelake},
     {"trace_loads", Target::TraceLoads},
     {"trace_stores", Target::TraceStores},
     {"trace_realizations", Target::TraceRealizations},
+    {"pool_allocator", Target::PoolAllocator},
+    {"persistent_scratch", Target::PersistentScratch},
+    {"profile_timeline", Target::ProfileTimeline},
+    {"profile_lightweight", Target::ProfileLightweight},
+    {"arm_dot_prod", Target::ARMDotProd},
+    {"sve_256", Target::SVE_256},
+    {"sve_512", Target::SVE_512},
+    {"power_arch_3_00", Target::POWER_ARCH_3_00},
+    {"power_arch_3_1", Target::POWER_ARCH_3_1},
+    {"c_simd_intrinsics", Target::CSIMDIntrinsics},
+    {"pgo_instrument", Target::PGOInstrument},
+    {"share_allocations", Target::ShareAllocations},
+    {"auto_prefetch", Target::AutoPrefetch},
+    {"task_parallel", Target::TaskParallel},
+    {"gpu_kernel_fusion", Target::GPUKernelFusion},
+    {"size_optimized", Target::SizeOptimized},
 };
 
 bool lookup_feature(const std::string &tok, Target::Feature &result) {
@@ -490,6 +567,12 @@ bool Target::supported() const {
 #if !defined(WITH_HEXAGON)
     bad |= arch == Target::Hexagon;
 #endif
+#if !defined(WITH_RISCV)
+    bad |= arch == Target::RISCV;
+#endif
+#if !defined(WITH_WEBASSEMBLY)
+    bad |= arch == Target::WebAssembly;
+#endif
 #if !defined(WITH_PTX)
     bad |= has_feature(Target::CUDA);
 #endif
@@ -553,13 +636,53 @@ Target::Feature target_feature_for_device_api(DeviceAPI api) {
 
 namespace Internal {
 
+std::string target_feature_name(Target::Feature f) {
+    for (const auto &feature : feature_name_map) {
+        if (feature.second == f) {
+            return feature.first;
+        }
+    }
+    return "unknown";
+}
+
+Target::Arch arch_of_runtime_detected_feature(Target::Feature f) {
+    // These must match the known features of the cpu_features
+    // modules in the runtime.
+    switch (f) {
+    case Target::SSE41:
+    case Target::AVX:
+    case Target::F16C:
+    case Target::FMA:
+    case Target::AVX2:
+    case Target::AVX512:
+    case Target::AVX512_KNL:
+    case Target::AVX512_Skylake:
+    case Target::AVX512_Cannonlake:
+    case Target::AVX512_Cascadelake:
+        return Target::X86;
+    case Target::ARMDotProd:
+    case Target::SVE_256:
+    case Target::SVE_512:
+        return Target::ARM;
+    case Target::VSX:
+    case Target::POWER_ARCH_2_07:
+    case Target::POWER_ARCH_3_00:
+    case Target::POWER_ARCH_3_1:
+        return Target::POWERPC;
+    default:
+        return Target::ArchUnknown;
+    }
+}
+
 EXPORT void target_test() {
     Target t;
     for (const auto &feature : feature_name_map) {
         t.set_feature(feature.second);
     }
     for (int i = 0; i < (int)(Target::FeatureEnd); i++) {
-        if (i == halide_target_feature_unused_23) continue;
+        if (i == halide_target_feature_unused_23 ||
+            i == halide_target_feature_unused_62 ||
+            i == halide_target_feature_unused_63) continue;
         internal_assert(t.has_feature((Target::Feature)i)) << "Feature " << i << " not in feature_names_map.\n";
     }
     std::cout << "Target test passed" << std::endl;
@@ -22,12 +22,12 @@ struct Target {
     /** The operating system used by the target. Determines which
      * system calls to generate.
      * Corresponds to os_name_map in Target.cpp. */
-    enum OS {OSUnknown = 0, Linux, Windows, OSX, Android, IOS, QuRT, NoOS} os;
+    enum OS {OSUnknown = 0, Linux, Windows, OSX, Android, IOS, QuRT, NoOS, WebAssemblyRuntime} os;
 
     /** The architecture used by the target. Determines the
      * instruction set to use.
      * Corresponds to arch_name_map in Target.cpp. */
-    enum Arch {ArchUnknown = 0, X86, ARM, MIPS, Hexagon, POWERPC} arch;
+    enum Arch {ArchUnknown = 0, X86, ARM, MIPS, Hexagon, POWERPC, WebAssembly, RISCV} arch;
 
     /** The bit-width of the target machine. Must be 0 for unknown, or 32 or 64. */
     int bits;
@@ -57,6 +57,9 @@ struct Target {
         CUDACapability35 = halide_target_feature_cuda_capability35,
         CUDACapability50 = halide_target_feature_cuda_capability50,
         CUDACapability61 = halide_target_feature_cuda_capability61,
+        CUDACapability70 = halide_target_feature_cuda_capability70,
+        CUDACapability75 = halide_target_feature_cuda_capability75,
+        CUDAManagedMemory = halide_target_feature_cuda_managed_memory,
         OpenCL = halide_target_feature_opencl,
         CLDoubles = halide_target_feature_cl_doubles,
         OpenGL = halide_target_feature_opengl,
@@ -82,9 +85,26 @@ struct Target {
         AVX512_KNL = halide_target_feature_avx512_knl,
         AVX512_Skylake = halide_target_feature_avx512_skylake,
         AVX512_Cannonlake = halide_target_feature_avx512_cannonlake,
+        AVX512_Cascadelake = halide_target_feature_avx512_cascadelake,
         TraceLoads = halide_target_feature_trace_loads,
         TraceStores = halide_target_feature_trace_stores,
         TraceRealizations = halide_target_feature_trace_realizations,
+        PoolAllocator = halide_target_feature_pool_allocator,
+        PersistentScratch = halide_target_feature_persistent_scratch,
+        ProfileTimeline = halide_target_feature_profile_timeline,
+        ProfileLightweight = halide_target_feature_profile_lightweight,
+        ARMDotProd = halide_target_feature_arm_dot_prod,
+        SVE_256 = halide_target_feature_sve_256,
+        SVE_512 = halide_target_feature_sve_512,
+        POWER_ARCH_3_00 = halide_target_feature_power_arch_3_00,
+        POWER_ARCH_3_1 = halide_target_feature_power_arch_3_1,
+        CSIMDIntrinsics = halide_target_feature_c_simd_intrinsics,
+        PGOInstrument = halide_target_feature_pgo_instrument,
+        ShareAllocations = halide_target_feature_share_allocations,
+        AutoPrefetch = halide_target_feature_auto_prefetch,
+        TaskParallel = halide_target_feature_task_parallel,
+        GPUKernelFusion = halide_target_feature_gpu_kernel_fusion,
+        SizeOptimized = halide_target_feature_size_optimized,
         FeatureEnd = halide_target_feature_end
     };
     Target() : os(OSUnknown), arch(ArchUnknown), bits(0) {}
@@ -256,13 +276,15 @@ struct Target {
             }
         } else if (arch == Target::X86) {
             if (is_integer && (has_feature(Halide::Target::AVX512_Skylake) ||
-                               has_feature(Halide::Target::AVX512_Cannonlake))) {
-                // AVX512BW exists on Skylake and Cannonlake
+                               has_feature(Halide::Target::AVX512_Cannonlake) ||
+                               has_feature(Halide::Target::AVX512_Cascadelake))) {
+                // AVX512BW exists on Skylake, Cannonlake and Cascade Lake
                 return 64 / data_size;
             } else if (t.is_float() && (has_feature(Halide::Target::AVX512) ||
                                         has_feature(Halide::Target::AVX512_KNL) ||
                                         has_feature(Halide::Target::AVX512_Skylake) ||
-                                        has_feature(Halide::Target::AVX512_Cannonlake))) {
+                                        has_feature(Halide::Target::AVX512_Cannonlake) ||
+                                        has_feature(Halide::Target::AVX512_Cascadelake))) {
                 // AVX512F is on all AVX512 architectures
                 return 64 / data_size;
             } else if (has_feature(Halide::Target::AVX2)) {
@@ -276,6 +298,10 @@ struct Target {
                 // SSE was all 128-bit. We ignore MMX.
                 return 16 / data_size;
             }
+        } else if (arch == Target::ARM && has_feature(Halide::Target::SVE_512)) {
+            return 64 / data_size;
+        } else if (arch == Target::ARM && has_feature(Halide::Target::SVE_256)) {
+            return 32 / data_size;
         } else {
             // Assume 128-bit vectors on other targets.
             return 16 / data_size;
@@ -334,6 +360,14 @@ EXPORT Target::Feature target_feature_for_device_api(DeviceAPI api);
 
 namespace Internal {
 
+/** Return the name of a target feature, as used in target strings. */
+std::string target_feature_name(Target::Feature f);
+
+/** Return the architecture on which halide_can_use_target_features
+ * can detect the given feature at runtime, or Target::ArchUnknown if
+ * it can't be detected on any. */
+Target::Arch arch_of_runtime_detected_feature(Target::Feature f);
+
 EXPORT void target_test();
 
 }
@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include "TransposeStridedLoads.h"
+#include "ExprUsesVar.h"
+#include "IREquality.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Scope.h"
+#include "Simplify.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::pair;
+using std::set;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Larger blocks need more registers than the transpose saves.
+const int max_block_lanes = 16;
+
+// The strided loads in some statements that may be part of a block,
+// and the buffers the statements store to.
+class FindStridedLoads : public IRVisitor {
+    Scope<int> lets;
+
+    using IRVisitor::visit;
+
+    void visit(const Let *op) override {
+        op->value.accept(this);
+        lets.push(op->name, 0);
+        op->body.accept(this);
+        lets.pop(op->name);
+    }
+
+    void visit(const Load *op) override {
+        IRVisitor::visit(op);
+        const Ramp *ramp = op->index.as<Ramp>();
+        const int64_t *stride = ramp ? as_const_int(ramp->stride) : nullptr;
+        // Loads with small constant strides are deinterleaved
+        // instead, and loads that depend on lets inside the statements
+        // can't be hoisted out of them.
+        if (ramp && is_one(op->predicate) &&
+            ramp->lanes >= 2 && ramp->lanes <= max_block_lanes &&
+            (!stride || *stride >= ramp->lanes || *stride <= -ramp->lanes) &&
+            !expr_uses_vars(op->index, lets)) {
+            loads.push_back(op);
+        }
+    }
+
+    void visit(const Store *op) override {
+        IRVisitor::visit(op);
+        stored.insert(op->name);
+    }
+
+public:
+    vector<const Load *> loads;
+    set<string> stored;
+};
+
+class ReplaceLoads : public IRMutator2 {
+    const map<const Load *, Expr> &replacements;
+
+    using IRMutator2::visit;
+
+    Expr visit(const Load *op) override {
+        auto it = replacements.find(op);
+        if (it != replacements.end()) {
+            return it->second;
+        }
+        return IRMutator2::visit(op);
+    }
+
+public:
+    ReplaceLoads(const map<const Load *, Expr> &replacements) : replacements(replacements) {}
+};
+
+// Strided loads from the same buffer with the same stride, at constant
+// offsets from the base of the first one.
+struct LoadGroup {
+    const Load *first;
+    Expr stride;
+    map<int64_t, vector<const Load *>> by_offset;
+};
+
+class TransposeStridedLoads : public IRMutator2 {
+    bool in_device_loop = false;
+
+    using IRMutator2::visit;
+
+    Stmt visit(const For *op) override {
+        bool old_in_device_loop = in_device_loop;
+        if (op->device_api != DeviceAPI::None && op->device_api != DeviceAPI::Host) {
+            in_device_loop = true;
+        }
+        Stmt stmt = IRMutator2::visit(op);
+        in_device_loop = old_in_device_loop;
+        return stmt;
+    }
+
+    // Transpose the blocks of strided loads in a sequence of stores.
+    Stmt transpose_blocks(const vector<Stmt> &stores) {
+        Stmt result = Block::make(stores);
+        if (in_device_loop) {
+            return result;
+        }
+
+        FindStridedLoads finder;
+        result.accept(&finder);
+
+        vector<LoadGroup> groups;
+        for (const Load *load : finder.loads) {
+            if (finder.stored.count(load->name)) {
+                continue;
+            }
+            const Ramp *ramp = load->index.as<Ramp>();
+            bool found = false;
+            for (LoadGroup &g : groups) {
+                const Ramp *first = g.first->index.as<Ramp>();
+                if (g.first->name != load->name ||
+                    g.first->type != load->type ||
+                    !equal(g.stride, ramp->stride)) {
+                    continue;
+                }
+                Expr offset = simplify(ramp->base - first->base);
+                if (const int64_t *o = as_const_int(offset)) {
+                    g.by_offset[*o].push_back(load);
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                LoadGroup g;
+                g.first = load;
+                g.stride = ramp->stride;
+                g.by_offset[0].push_back(load);
+                groups.push_back(g);
+            }
+        }
+
+        // The lanes of the loads at n consecutive offsets are the rows of
+        // an n x n block.
+        map<const Load *, Expr> replacements;
+        vector<pair<string, Expr>> dense_loads;
+        for (const LoadGroup &g : groups) {
+            const Load *first = g.first;
+            const int lanes = first->type.lanes();
+            const Expr &first_base = first->index.as<Ramp>()->base;
+            auto it = g.by_offset.begin();
+            while (it != g.by_offset.end()) {
+                int64_t begin = it->first;
+                bool complete = true;
+                for (int64_t o = begin; o < begin + lanes; o++) {
+                    complete = complete && g.by_offset.count(o);
+                }
+                if (!complete) {
+                    it++;
+                    continue;
+                }
+
+                debug(3) << "Transposing a " << lanes << " x " << lanes
+                         << " block of loads from " << first->name << "\n";
+                vector<Expr> rows;
+                for (int j = 0; j < lanes; j++) {
+                    Expr base = simplify(first_base + make_const(first_base.type(), begin) + g.stride * j);
+                    Expr row = Load::make(first->type, first->name, Ramp::make(base, 1, lanes),
+                                          first->image, first->param, const_true(lanes));
+                    string name = unique_name('t');
+                    dense_loads.push_back({name, row});
+                    rows.push_back(Variable::make(first->type, name));
+                }
+                for (int k = 0; k < lanes; k++) {
+                    vector<int> indices;
+                    for (int j = 0; j < lanes; j++) {
+                        indices.push_back(j * lanes + k);
+                    }
+                    Expr column = Shuffle::make(rows, indices);
+                    for (const Load *load : g.by_offset.at(begin + k)) {
+                        replacements[load] = column;
+                    }
+                }
+                it = g.by_offset.find(begin + lanes - 1);
+                it++;
+            }
+        }
+
+        if (replacements.empty()) {
+            return result;
+        }
+        result = ReplaceLoads(replacements).mutate(result);
+        for (size_t i = dense_loads.size(); i > 0; i--) {
+            result = LetStmt::make(dense_loads[i - 1].first, dense_loads[i - 1].second, result);
+        }
+        return result;
+    }
+
+    Stmt visit(const Block *op) override {
+        vector<Stmt> stmts, stores;
+        Stmt s = op;
+        while (const Block *b = s.as<Block>()) {
+            stmts.push_back(b->first);
+            s = b->rest;
+        }
+        stmts.push_back(s);
+
+        vector<Stmt> result;
+        for (const Stmt &stmt : stmts) {
+            if (stmt.as<Store>()) {
+                stores.push_back(stmt);
+                continue;
+            }
+            if (!stores.empty()) {
+                result.push_back(transpose_blocks(stores));
+                stores.clear();
+            }
+            result.push_back(mutate(stmt));
+        }
+        if (!stores.empty()) {
+            result.push_back(transpose_blocks(stores));
+        }
+        return Block::make(result);
+    }
+
+    Stmt visit(const Store *op) override {
+        return transpose_blocks({op});
+    }
+};
+
+}  // namespace
+
+Stmt transpose_strided_loads(Stmt s) {
+    return TransposeStridedLoads().mutate(s);
+}
+
+}
+}
@@ -0,0 +1,27 @@
+#ifndef HALIDE_TRANSPOSE_STRIDED_LOADS_H
+#define HALIDE_TRANSPOSE_STRIDED_LOADS_H
+
+/** \file
+ * Defines the lowering pass that turns blocks of strided vector loads
+ * into dense loads and a transpose in registers.
+ */
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Vectorizing along a dimension that isn't innermost in storage, and
+ * unrolling along the one that is, e.g. to transpose or rotate a tile
+ * or apply a column filter, makes n strided loads of n lanes whose
+ * bases are consecutive. Together they read an n x n block of the
+ * buffer, which this pass loads with n dense vector loads instead and
+ * transposes with shuffles. The loads must be in the same sequence of
+ * stores, which must not store to the loaded buffer. Should be run
+ * after unrolling and vectorization. */
+Stmt transpose_strided_loads(Stmt s);
+
+}
+}
+
+#endif
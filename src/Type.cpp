@@ -33,7 +33,9 @@ Halide::Expr Type::max() const {
         return Internal::UIntImm::make(*this, max_uint(bits()));
     } else {
         internal_assert(is_float());
-        if (bits() == 16) {
+        if (is_bfloat()) {
+            return Internal::FloatImm::make(*this, std::numeric_limits<float>::infinity());
+        } else if (bits() == 16) {
             return Internal::FloatImm::make(*this, 65504.0);
         } else if (bits() == 32) {
             return Internal::FloatImm::make(*this, std::numeric_limits<float>::infinity());
@@ -57,7 +59,9 @@ Halide::Expr Type::min() const {
         return Internal::UIntImm::make(*this, 0);
     } else {
         internal_assert(is_float());
-        if (bits() == 16) {
+        if (is_bfloat()) {
+            return Internal::FloatImm::make(*this, -std::numeric_limits<float>::infinity());
+        } else if (bits() == 16) {
             return Internal::FloatImm::make(*this, -65504.0);
         } else if (bits() == 32) {
             return Internal::FloatImm::make(*this, -std::numeric_limits<float>::infinity());
@@ -106,8 +110,15 @@ bool Type::can_represent(Type other) const {
                 (other.is_uint() && other.bits() < bits()));
     } else if (is_uint()) {
         return other.is_uint() && other.bits() <= bits();
+    } else if (is_bfloat()) {
+        // bfloats have 8 bits of precision.
+        return (other.is_bfloat() ||
+                (other.is_int() && other.bits() <= 8) ||
+                (other.is_uint() && other.bits() <= 8));
     } else if (is_float()) {
-        return ((other.is_float() && other.bits() <= bits()) ||
+        // Anything a bfloat can represent, a float can too.
+        return ((other.is_float() && other.bits() <= bits() &&
+                 (bits() > 16 || !other.is_bfloat())) ||
                 (bits() == 64 && other.bits() <= 32) ||
                 (bits() == 32 && other.bits() <= 16));
     } else {
@@ -120,6 +131,8 @@ bool Type::can_represent(int64_t x) const {
         return x >= min_int(bits()) && x <= max_int(bits());
     } else if (is_uint()) {
         return x >= 0 && (uint64_t)x <= max_uint(bits());
+    } else if (is_bfloat()) {
+        return (int64_t)(float)(bfloat16_t)(float)x == x;
     } else if (is_float()) {
         switch (bits()) {
         case 16:
@@ -141,6 +154,8 @@ bool Type::can_represent(uint64_t x) const {
         return x <= (uint64_t)(max_int(bits()));
     } else if (is_uint()) {
         return x <= max_uint(bits());
+    } else if (is_bfloat()) {
+        return (uint64_t)(float)(bfloat16_t)(float)x == x;
     } else if (is_float()) {
         switch (bits()) {
         case 16:
@@ -164,6 +179,8 @@ bool Type::can_represent(double x) const {
     } else if (is_uint()) {
         uint64_t u = x;
         return (x >= 0) && (x <= max_uint(bits())) && (x == (double)u);
+    } else if (is_bfloat()) {
+        return (double)(bfloat16_t)x == x;
     } else if (is_float()) {
         switch (bits()) {
         case 16:
@@ -0,0 +1,24 @@
+#include "UnsafePromises.h"
+#include "IRMutator.h"
+
+namespace Halide {
+namespace Internal {
+
+class LowerUnsafePromises : public IRMutator2 {
+    using IRMutator2::visit;
+
+    Expr visit(const Call *op) override {
+        if (op->is_intrinsic(Call::promise_clamped)) {
+            return mutate(op->args[0]);
+        } else {
+            return IRMutator2::visit(op);
+        }
+    }
+};
+
+Stmt lower_unsafe_promises(Stmt s) {
+    return LowerUnsafePromises().mutate(s);
+}
+
+}
+}
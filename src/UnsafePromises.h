@@ -0,0 +1,21 @@
+#ifndef HALIDE_UNSAFE_PROMISES_H
+#define HALIDE_UNSAFE_PROMISES_H
+
+/** \file
+ * Defines the lowering pass that removes unsafe promises
+ */
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Replace each call to promise_clamped with its first argument. The
+ * promises have done their job once bounds inference and the passes
+ * that depend on it have run. */
+Stmt lower_unsafe_promises(Stmt s);
+
+}
+}
+
+#endif
@@ -426,5 +426,13 @@ bool mul_would_overflow(int bits, int64_t a, int64_t b) {
     }
 }
 
+uint64_t stable_hash(const std::string &s, uint64_t h) {
+    for (char c : s) {
+        h ^= (uint8_t)c;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
 }
 }
@@ -253,6 +253,11 @@ bool sub_would_overflow(int bits, int64_t a, int64_t b);
 bool mul_would_overflow(int bits, int64_t a, int64_t b);
 // @}
 
+/** A 64-bit FNV-1a hash of a string, continuing from the hash h.
+ * Unlike std::hash, it's the same across runs and compilers, so it
+ * can name things that persist on disk. */
+uint64_t stable_hash(const std::string &s, uint64_t h = 0xcbf29ce484222325ULL);
+
 /** Helper class for saving/restoring variable values on the stack, to allow
  * for early-exit that preserves correctness */
 template<typename T>
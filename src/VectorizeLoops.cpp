@@ -231,6 +231,20 @@ bool uses_gpu_vars(Expr s) {
     return uses.uses_gpu;
 }
 
+// Is this the condition guarding the tail of a split with
+// TailStrategy::Predicate? Those are always predicated if possible,
+// whatever the target.
+bool is_predicated_tail(Expr cond) {
+    if (const Call *c = cond.as<Call>()) {
+        if (c->is_intrinsic(Call::likely)) {
+            cond = c->args[0];
+        }
+    }
+    const LT *lt = cond.as<LT>();
+    const Variable *v = lt ? lt->a.as<Variable>() : nullptr;
+    return v && ends_with(v->name, ".predicated");
+}
+
 // Wrap a vectorized predicate around a Load/Store node.
 class PredicateLoadStore : public IRMutator2 {
     string var;
@@ -240,6 +254,9 @@ class PredicateLoadStore : public IRMutator2 {
     int lanes;
     bool valid;
     bool vectorized;
+    // Predicate loads and stores even if the target doesn't have
+    // masked loads and stores of this size.
+    bool always;
 
     using IRMutator2::visit;
 
@@ -248,10 +265,29 @@ class PredicateLoadStore : public IRMutator2 {
             internal_assert(target.features_any_of({Target::HVX_64, Target::HVX_128}))
                 << "We are inside a hexagon loop, but the target doesn't have hexagon's features\n";
             return true;
+        } else if (always) {
+            return true;
         } else if (target.arch == Target::X86) {
             // Should only attempt to predicate store/load if the lane size is
             // no less than 4
-            return (bit_size == 32) && (lanes >= 4);
+            if (lanes < 4) {
+                return false;
+            }
+            if (target.features_any_of({Target::AVX512_Skylake,
+                                        Target::AVX512_Cannonlake,
+                                        Target::AVX512_Cascadelake})) {
+                // AVX512BW has masked moves of 8- and 16-bit lanes too.
+                return bit_size == 8 || bit_size == 16 || bit_size == 32 || bit_size == 64;
+            } else if (target.features_any_of({Target::AVX512, Target::AVX512_KNL})) {
+                // AVX512F masks 32- and 64-bit lanes.
+                return bit_size == 32 || bit_size == 64;
+            }
+            return (bit_size == 32);
+        } else if (target.arch == Target::ARM && target.bits == 64 &&
+                   target.features_any_of({Target::SVE_256, Target::SVE_512})) {
+            // SVE predicates loads and stores of every lane size, and
+            // has gathers and scatters.
+            return bit_size == 8 || bit_size == 16 || bit_size == 32 || bit_size == 64;
         }
         // For other architecture, do not predicate vector load/store
         return false;
@@ -332,9 +368,9 @@ class PredicateLoadStore : public IRMutator2 {
     }
 
 public:
-    PredicateLoadStore(string v, Expr vpred, bool in_hexagon, const Target &t) :
+    PredicateLoadStore(string v, Expr vpred, bool in_hexagon, const Target &t, bool always = false) :
             var(v), vector_predicate(vpred), in_hexagon(in_hexagon), target(t),
-            lanes(vpred.type().lanes()), valid(true), vectorized(false) {
+            lanes(vpred.type().lanes()), valid(true), vectorized(false), always(always) {
         internal_assert(lanes > 1);
     }
 
@@ -343,6 +379,51 @@ public:
     }
 };
 
+// Does an expression load from a given buffer?
+class LoadsFromBuffer : public IRVisitor {
+    using IRVisitor::visit;
+
+    const string &buffer;
+
+    void visit(const Load *op) override {
+        if (op->name == buffer) {
+            result = true;
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    bool result = false;
+    LoadsFromBuffer(const string &b) : buffer(b) {}
+};
+
+bool loads_from_buffer(const string &buffer, Expr e) {
+    LoadsFromBuffer l(buffer);
+    e.accept(&l);
+    return l.result;
+}
+
+// Does a statement contain any vector stores?
+class HasVectorStore : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const Store *op) override {
+        if (op->index.type().is_vector()) {
+            result = true;
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    bool result = false;
+};
+
+bool has_vector_store(Stmt s) {
+    HasVectorStore h;
+    s.accept(&h);
+    return h.result;
+}
+
 // Substitutes a vector for a scalar var in a Stmt. Used on the
 // body of every vectorized loop.
 class VectorSubs : public IRMutator2 {
@@ -367,6 +448,13 @@ class VectorSubs : public IRMutator2 {
     // version of them if we scalarize inner code.
     vector<pair<string, Expr>> containing_lets;
 
+    // Are we inside an Atomic node? If so, stores to a single site
+    // may be horizontal reductions.
+    bool in_atomic = false;
+
+    // Could other threads be running this loop at the same time?
+    bool in_parallel;
+
     // Widen an expression to the given number of lanes.
     Expr widen(Expr e, int lanes) {
         if (e.type().lanes() == lanes) {
@@ -645,7 +733,121 @@ class VectorSubs : public IRMutator2 {
         }
     }
 
+    // Inside an atomic node, an associative update of a single site
+    // (e.g. a sum over the vectorized var) can be done by reducing
+    // the vector of new contributions horizontally, then updating the
+    // site once. Returns an undefined Stmt if the store isn't of this
+    // form.
+    Stmt reduce_horizontally(const Store *op) {
+        Expr index = mutate(op->index);
+        Expr predicate = mutate(op->predicate);
+        if (index.type().is_vector() || predicate.type().is_vector()) {
+            return Stmt();
+        }
+
+        VectorReduce::Operator reduce_op = VectorReduce::Add;
+        Expr a, b;
+        bool is_sub = false;
+        if (const Add *add = op->value.as<Add>()) {
+            a = add->a;
+            b = add->b;
+        } else if (const Sub *sub = op->value.as<Sub>()) {
+            // f - g0 - g1 ... == f - (g0 + g1 + ...)
+            a = sub->a;
+            b = sub->b;
+            is_sub = true;
+        } else if (const Mul *mul = op->value.as<Mul>()) {
+            reduce_op = VectorReduce::Mul;
+            a = mul->a;
+            b = mul->b;
+        } else if (const Min *min = op->value.as<Min>()) {
+            reduce_op = VectorReduce::Min;
+            a = min->a;
+            b = min->b;
+        } else if (const Max *max = op->value.as<Max>()) {
+            reduce_op = VectorReduce::Max;
+            a = max->a;
+            b = max->b;
+        } else if (const And *and_op = op->value.as<And>()) {
+            reduce_op = VectorReduce::And;
+            a = and_op->a;
+            b = and_op->b;
+        } else if (const Or *or_op = op->value.as<Or>()) {
+            reduce_op = VectorReduce::Or;
+            a = or_op->a;
+            b = or_op->b;
+        } else {
+            return Stmt();
+        }
+
+        // One side must be the old value of the site being updated.
+        auto is_old_value = [&](const Expr &e) {
+            const Load *load = e.as<Load>();
+            return load && load->name == op->name && equal(load->index, op->index);
+        };
+        if (!is_sub && !is_old_value(a) && is_old_value(b)) {
+            std::swap(a, b);
+        }
+        if (!is_old_value(a) || loads_from_buffer(op->name, b)) {
+            return Stmt();
+        }
+
+        Expr rest = mutate(b);
+        if (rest.type().is_scalar()) {
+            return Stmt();
+        }
+
+        Expr old_value = mutate(a);
+        Expr reduced = VectorReduce::make(reduce_op, rest, 1);
+        Expr value;
+        switch (reduce_op) {
+        case VectorReduce::Add:
+            value = is_sub ? Sub::make(old_value, reduced) : Add::make(old_value, reduced);
+            break;
+        case VectorReduce::Mul:
+            value = Mul::make(old_value, reduced);
+            break;
+        case VectorReduce::Min:
+            value = Min::make(old_value, reduced);
+            break;
+        case VectorReduce::Max:
+            value = Max::make(old_value, reduced);
+            break;
+        case VectorReduce::And:
+            value = And::make(old_value, reduced);
+            break;
+        case VectorReduce::Or:
+            value = Or::make(old_value, reduced);
+            break;
+        }
+        return Store::make(op->name, value, index, op->param, predicate);
+    }
+
+    Stmt visit(const Atomic *op) override {
+        bool old_in_atomic = in_atomic;
+        in_atomic = true;
+        Stmt body = mutate(op->body);
+        in_atomic = old_in_atomic;
+        if (body.same_as(op->body)) {
+            return op;
+        } else if (!in_parallel && !has_vector_store(body)) {
+            // Every store became a single update of a horizontal
+            // reduction, and nothing else can be touching the
+            // buffer, so there's no need for atomics.
+            return body;
+        } else {
+            return Atomic::make(op->producer_name, body);
+        }
+    }
+
     Stmt visit(const Store *op) override {
+        if (in_atomic) {
+            Stmt reduced = reduce_horizontally(op);
+            if (reduced.defined()) {
+                return reduced;
+            }
+        }
+
         Expr predicate = mutate(op->predicate);
         Expr value = mutate(op->value);
         Expr index = mutate(op->index);
@@ -679,14 +881,15 @@ class VectorSubs : public IRMutator2 {
             // SIMD lanes.
 
             bool vectorize_predicate = !uses_gpu_vars(cond);
+            bool always = is_predicated_tail(op->condition);
             Stmt predicated_stmt;
             if (vectorize_predicate) {
-                PredicateLoadStore p(var, cond, in_hexagon, target);
+                PredicateLoadStore p(var, cond, in_hexagon, target, always);
                 predicated_stmt = p.mutate(then_case);
                 vectorize_predicate = p.is_vectorized();
             }
             if (vectorize_predicate && else_case.defined()) {
-                PredicateLoadStore p(var, !cond, in_hexagon, target);
+                PredicateLoadStore p(var, !cond, in_hexagon, target, always);
                 predicated_stmt = Block::make(predicated_stmt, p.mutate(else_case));
                 vectorize_predicate = p.is_vectorized();
             }
@@ -845,7 +1048,7 @@ class VectorSubs : public IRMutator2 {
         // The variable itself could still exist inside an inner scalarized block.
         body = substitute(v, Variable::make(Int(32), var), body);
 
-        return Allocate::make(op->name, op->type, new_extents, op->condition, body, new_expr, op->free_function);
+        return Allocate::make(op->name, op->type, op->memory_type, new_extents, op->condition, body, new_expr, op->free_function);
     }
 
     Stmt scalarize(Stmt s) {
@@ -897,8 +1100,8 @@ class VectorSubs : public IRMutator2 {
     }
 
 public:
-    VectorSubs(string v, Expr r, bool in_hexagon, const Target &t) :
-            var(v), replacement(r), target(t), in_hexagon(in_hexagon) {
+    VectorSubs(string v, Expr r, bool in_hexagon, bool in_parallel, const Target &t) :
+            var(v), replacement(r), target(t), in_hexagon(in_hexagon), in_parallel(in_parallel) {
         widening_suffix = ".x" + std::to_string(replacement.type().lanes());
     }
 };
@@ -907,6 +1110,7 @@ public:
 class VectorizeLoops : public IRMutator2 {
     const Target &target;
     bool in_hexagon;
+    int parallel_loops = 0;
 
     using IRMutator2::visit;
 
@@ -929,9 +1133,15 @@ class VectorizeLoops : public IRMutator2 {
             // Replace the var with a ramp within the body
             Expr for_var = Variable::make(Int(32), for_loop->name);
             Expr replacement = Ramp::make(for_loop->min, 1, extent->value);
-            stmt = VectorSubs(for_loop->name, replacement, in_hexagon, target).mutate(for_loop->body);
+            stmt = VectorSubs(for_loop->name, replacement, in_hexagon, parallel_loops > 0, target).mutate(for_loop->body);
         } else {
+            bool parallel = (for_loop->for_type == ForType::Parallel ||
+                             for_loop->for_type == ForType::GPUBlock ||
+                             for_loop->for_type == ForType::GPUThread ||
+                             for_loop->for_type == ForType::GPULane);
+            parallel_loops += parallel ? 1 : 0;
             stmt = IRMutator2::visit(for_loop);
+            parallel_loops -= parallel ? 1 : 0;
         }
 
         if (for_loop->device_api == DeviceAPI::Hexagon) {
@@ -1021,22 +1021,22 @@ public:
             using MemType = uint8_t;
             auto &typed_dst = (Buffer<MemType, D> &)dst;
             auto &typed_src = (Buffer<const MemType, D> &)src;
-            typed_dst.for_each_value([&](MemType &dst, MemType src) {dst = src;}, typed_src);
+            typed_dst.copy_values_from(typed_src);
         } else if (type().bytes() == 2) {
             using MemType = uint16_t;
             auto &typed_dst = (Buffer<MemType, D> &)dst;
             auto &typed_src = (Buffer<const MemType, D> &)src;
-            typed_dst.for_each_value([&](MemType &dst, MemType src) {dst = src;}, typed_src);
+            typed_dst.copy_values_from(typed_src);
         } else if (type().bytes() == 4) {
             using MemType = uint32_t;
             auto &typed_dst = (Buffer<MemType, D> &)dst;
             auto &typed_src = (Buffer<const MemType, D> &)src;
-            typed_dst.for_each_value([&](MemType &dst, MemType src) {dst = src;}, typed_src);
+            typed_dst.copy_values_from(typed_src);
         } else if (type().bytes() == 8) {
             using MemType = uint64_t;
             auto &typed_dst = (Buffer<MemType, D> &)dst;
             auto &typed_src = (Buffer<const MemType, D> &)src;
-            typed_dst.for_each_value([&](MemType &dst, MemType src) {dst = src;}, typed_src);
+            typed_dst.copy_values_from(typed_src);
         } else {
             assert(false && "type().bytes() must be 1, 2, 4, or 8");
         }
@@ -1612,6 +1612,24 @@ public:
 
     void fill(not_void_T val) {
         set_host_dirty();
+        // If all the bytes of the value are the same (e.g. zero), fill
+        // each run of values that are contiguous in memory with a
+        // memset.
+        const uint8_t *bytes = (const uint8_t *)(&val);
+        bool bytes_are_equal = true;
+        for (size_t i = 1; i < sizeof(val); i++) {
+            bytes_are_equal &= bytes[i] == bytes[0];
+        }
+        if (bytes_are_equal) {
+            for_each_value_task_dim<1> *t =
+                (for_each_value_task_dim<1> *)HALIDE_ALLOCA((dimensions()+1) * sizeof(for_each_value_task_dim<1>));
+            if (for_each_value_prep(t)) {
+                const size_t run_bytes = t[0].extent * sizeof(val);
+                for_each_value_helper<false>([&](T &v) {memset(&v, bytes[0], run_bytes);},
+                                             dimensions() - 2, t + 1, begin());
+                return;
+            }
+        }
         for_each_value([=](T &v) {v = val;});
     }
 
@@ -1658,6 +1676,74 @@ private:
 
     void extract_strides(int d, int *strides) {}
 
+    // Set up the loop nest for for_each_value over this buffer and
+    // some others of the same shape: order the dimensions by stride,
+    // and flatten dimensions that are contiguous in all of the
+    // buffers. Returns whether the innermost dimension is dense in
+    // all of them.
+    template<int N, typename ...Args>
+    bool for_each_value_prep(for_each_value_task_dim<N> *t, Args... other_buffers) {
+        for (int i = 0; i <= dimensions(); i++) {
+            for (int j = 0; j < N; j++) {
+                t[i].stride[j] = 0;
+            }
+            t[i].extent = 1;
+        }
+
+        for (int i = 0; i < dimensions(); i++) {
+            extract_strides(i, t[i].stride, this, other_buffers...);
+            t[i].extent = dim(i).extent();
+            // Order the dimensions by stride, so that the traversal is cache-coherent.
+            for (int j = i; j > 0 && t[j].stride[0] < t[j-1].stride[0]; j--) {
+                std::swap(t[j], t[j-1]);
+            }
+        }
+
+        // flatten dimensions where possible to make a larger inner
+        // loop for autovectorization.
+        int d = dimensions();
+        for (int i = 1; i < d; i++) {
+            bool flat = true;
+            for (int j = 0; j < N; j++) {
+                flat = flat && t[i-1].stride[j] * t[i-1].extent == t[i].stride[j];
+            }
+            if (flat) {
+                t[i-1].extent *= t[i].extent;
+                for (int j = i; j < dimensions(); j++) {
+                    t[j] = t[j+1];
+                }
+                i--;
+                d--;
+            }
+        }
+
+        bool innermost_strides_are_one = false;
+        if (dimensions() > 0) {
+            innermost_strides_are_one = true;
+            for (int j = 0; j < N; j++) {
+                innermost_strides_are_one &= t[0].stride[j] == 1;
+            }
+        }
+        return innermost_strides_are_one;
+    }
+
+    // Copy the values of a buffer of the same shape and element
+    // type, using a memcpy for each run of values that is contiguous
+    // in both buffers. After flattening, that's a single memcpy if the
+    // buffers are both dense with the same layout.
+    void copy_values_from(const Buffer<const T, D> &src) {
+        for_each_value_task_dim<2> *t =
+            (for_each_value_task_dim<2> *)HALIDE_ALLOCA((dimensions()+1) * sizeof(for_each_value_task_dim<2>));
+        if (for_each_value_prep(t, &src)) {
+            const size_t run_bytes = t[0].extent * sizeof(T);
+            for_each_value_helper<false>([&](T &a, const T &b) {memcpy(&a, &b, run_bytes);},
+                                         dimensions() - 2, t + 1, begin(), src.begin());
+        } else {
+            for_each_value_helper<false>([&](T &a, T b) {a = b;},
+                                         dimensions() - 1, t, begin(), src.begin());
+        }
+    }
+
     // The template function that constructs the loop nest for for_each_value
     template<int d, bool innermost_strides_are_one, typename Fn, typename... Ptrs>
     static void for_each_value_helper(Fn &&f, const for_each_value_task_dim<sizeof...(Ptrs)> *t, Ptrs... ptrs) {
@@ -1711,47 +1797,7 @@ public:
     void for_each_value(Fn &&f, Args... other_buffers) {
         for_each_value_task_dim<N> *t =
             (for_each_value_task_dim<N> *)HALIDE_ALLOCA((dimensions()+1) * sizeof(for_each_value_task_dim<N>));
-        for (int i = 0; i <= dimensions(); i++) {
-            for (int j = 0; j < N; j++) {
-                t[i].stride[j] = 0;
-            }
-            t[i].extent = 1;
-        }
-
-        for (int i = 0; i < dimensions(); i++) {
-            extract_strides(i, t[i].stride, this, &other_buffers...);
-            t[i].extent = dim(i).extent();
-            // Order the dimensions by stride, so that the traversal is cache-coherent.
-            for (int j = i; j > 0 && t[j].stride[0] < t[j-1].stride[0]; j--) {
-                std::swap(t[j], t[j-1]);
-            }
-        }
-
-        // flatten dimensions where possible to make a larger inner
-        // loop for autovectorization.
-        int d = dimensions();
-        for (int i = 1; i < d; i++) {
-            bool flat = true;
-            for (int j = 0; j < N; j++) {
-                flat = flat && t[i-1].stride[j] * t[i-1].extent == t[i].stride[j];
-            }
-            if (flat) {
-                t[i-1].extent *= t[i].extent;
-                for (int j = i; j < dimensions(); j++) {
-                    t[j] = t[j+1];
-                }
-                i--;
-                d--;
-            }
-        }
-
-        bool innermost_strides_are_one = false;
-        if (dimensions() > 0) {
-            innermost_strides_are_one = true;
-            for (int j = 0; j < N; j++) {
-                innermost_strides_are_one &= t[0].stride[j] == 1;
-            }
-        }
+        bool innermost_strides_are_one = for_each_value_prep(t, &other_buffers...);
 
         if (innermost_strides_are_one) {
             for_each_value_helper<true>(f, dimensions() - 1, t, begin(), (other_buffers.begin())...);
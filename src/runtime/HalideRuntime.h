@@ -152,6 +152,36 @@ extern int halide_default_do_task(void *user_context, halide_task_t f, int idx,
                                   uint8_t *closure);
 // @}
 
+/** Counting semaphores, which a Func scheduled async (see
+ * Func::async) uses to hand each realization over to its consumer,
+ * and the consumer uses to tell the producer when folded storage is
+ * free again. They must be initialized with halide_semaphore_init,
+ * and need no cleanup. halide_semaphore_acquire blocks until the
+ * count is at least n, then decrements it. It returns zero on
+ * success, or an error code if it would wait forever, which happens
+ * when the thread pool has no threads. halide_semaphore_unblock
+ * raises the count so far that nothing waits on the semaphore again;
+ * it's called when either side of an async producer exits, so that a
+ * failure on one side doesn't leave the other waiting. */
+//@{
+struct halide_semaphore_t {
+    uint64_t _private[2];
+};
+extern int halide_semaphore_init(struct halide_semaphore_t *, int n);
+extern int halide_semaphore_release(struct halide_semaphore_t *, int n);
+extern int halide_semaphore_acquire(struct halide_semaphore_t *, int n);
+extern void halide_semaphore_unblock(void *user_context, struct halide_semaphore_t *);
+//@}
+
+/** Run tasks 0 and 1 of f concurrently, and return once both are
+ * done. Unlike with halide_do_par_for, each task is guaranteed its
+ * own thread, so the two may block on each other using
+ * semaphores. Task 1 runs on the calling thread. Used to run a Func
+ * scheduled async alongside its consumer. Returns zero if both
+ * tasks returned zero, otherwise the return value of one that
+ * failed. */
+extern int halide_do_fork(void *user_context, halide_task_t f, uint8_t *closure);
+
 struct halide_thread;
 
 /** Spawn a thread. Returns a handle to the thread for the purposes of
@@ -170,6 +200,11 @@ extern void halide_join_thread(struct halide_thread *);
  * n == 1 : use exactly one thread; this will always enforce serial execution
  * n > 1  : use a pool of exactly n threads.
  *
+ * There is no fixed upper limit on the size of the pool. Threads are
+ * spawned as needed, and reducing the number releases the surplus
+ * threads once they finish their current task, without needing a
+ * call to halide_shutdown_thread_pool.
+ *
  * Note that the default iOS and OSX behavior will treat n > 1 like n == 0;
  * that is, any positive value other than 1 will use a system-determined number
  * of threads.
@@ -180,6 +215,73 @@ extern void halide_join_thread(struct halide_thread *);
  */
 extern int halide_set_num_threads(int n);
 
+/** Independent thread pools. By default every call to the default
+ * halide_do_par_for runs on one global pool. Additional pools, each
+ * with their own worker threads, thread count and priority, can be
+ * created here. Which pool a pipeline invocation uses is decided by
+ * halide_get_thread_pool, which is passed the invocation's
+ * user_context, so that e.g. latency-critical and batch pipelines in
+ * one process don't compete for the same workers. Override
+ * halide_get_thread_pool (or use halide_set_custom_get_thread_pool)
+ * to bind a user_context to a pool. Returning NULL selects the
+ * default pool.
+ *
+ * priority is applied to each worker when it's spawned via
+ * halide_set_current_thread_priority; zero leaves the OS default.
+ * num_threads follows the same conventions as halide_set_num_threads.
+ * A pool must not be destroyed while work is running on it. Pools rely
+ * on zero-initialized mutexes being valid, like the default pool. */
+//@{
+struct halide_thread_pool;
+extern struct halide_thread_pool *halide_create_thread_pool(void *user_context, int num_threads, int priority);
+extern void halide_destroy_thread_pool(void *user_context, struct halide_thread_pool *pool);
+extern int halide_thread_pool_set_num_threads(struct halide_thread_pool *pool, int n);
+extern struct halide_thread_pool *halide_get_thread_pool(void *user_context);
+typedef struct halide_thread_pool *(*halide_get_thread_pool_t)(void *user_context);
+extern halide_get_thread_pool_t halide_set_custom_get_thread_pool(halide_get_thread_pool_t get_thread_pool);
+//@}
+
+/** Set how long idle threads in a pool (or the default pool, if pool
+ * is NULL) poll for more work before going to sleep, as a number of
+ * polls. Spinning lets a parallel loop that follows soon after the
+ * last one start without waiting for its workers to be woken, at the
+ * cost of burning some CPU while idle. Zero makes idle threads sleep
+ * immediately. If never set, the value is read from the
+ * environment variable HL_SPIN_COUNT when the pool starts, and
+ * otherwise defaults to a few tens of microseconds' worth. Returns the
+ * old value. Not supported where the runtime uses Grand Central
+ * Dispatch (OS X and iOS). */
+extern int halide_thread_pool_set_spin_count(struct halide_thread_pool *pool, int n);
+
+/** Adjust the scheduling priority of the calling thread. Uses
+ * nice-style units: negative values are more urgent, positive values
+ * less so, and zero is the default. Returns zero on success. Not all
+ * platforms support this, in which case it returns -1. */
+extern int halide_set_current_thread_priority(int priority);
+
+/** Opt in to NUMA-aware scheduling in the default thread pool. When
+ * enabled, worker threads are pinned to NUMA nodes in contiguous
+ * groups, the tasks of each parallel loop are split into contiguous
+ * ranges that line up with those groups, and idle workers steal from
+ * workers on their own node before crossing to another node. Storage
+ * written by a parallel producer is then first-touched by the node
+ * that goes on to consume the same range. Must be called before the
+ * thread pool starts (i.e. before the first parallel loop) to affect
+ * thread placement. The environment variable HL_NUMA=1 has the same
+ * effect. Returns the old setting.
+ */
+extern int halide_set_numa_aware(int enabled);
+
+/** Query and control the NUMA topology of the host. These are
+ * implemented per-platform alongside halide_host_cpu_count. On
+ * platforms without NUMA support, halide_numa_node_count returns 1
+ * and halide_bind_current_thread_to_numa_node does nothing and
+ * returns -1. */
+//@{
+extern int halide_numa_node_count();
+extern int halide_bind_current_thread_to_numa_node(int node);
+//@}
+
 /** Halide calls these functions to allocate and free memory. To
  * replace in AOT code, use the halide_set_custom_malloc and
  * halide_set_custom_free, or (on platforms that support weak
@@ -196,6 +298,13 @@ extern int halide_set_num_threads(int n);
  * alignment, which is safe for arm and x86. Additionally, it must be
  * safe to read at least 8 bytes before the start and beyond the
  * end.
+ *
+ * On Linux and Android, the default implementation can back large
+ * allocations with huge pages to reduce TLB misses. Set the
+ * environment variable HL_HUGE_PAGE_THRESHOLD_MB to the size in
+ * megabytes at and above which to do so, and optionally
+ * HL_HUGE_PAGE_MODE to "thp" (transparent huge pages, the default),
+ * "2mb" or "1gb" (hugetlbfs pages, which must have been reserved).
  */
 //@{
 extern void *halide_malloc(void *user_context, size_t x);
@@ -208,6 +317,73 @@ extern halide_malloc_t halide_set_custom_malloc(halide_malloc_t user_malloc);
 extern halide_free_t halide_set_custom_free(halide_free_t user_free);
 //@}
 
+/** When compiled with the pool_allocator target feature,
+ * halide_default_malloc rounds allocations up to a size class and
+ * halide_default_free keeps freed blocks on free lists for reuse,
+ * holding at most HL_POOL_ALLOCATOR_MAX_CACHED_MB megabytes (default
+ * 256). This returns all currently unused blocks to the system. It is
+ * only defined in runtimes with the pool_allocator feature.
+ */
+extern void halide_pool_allocator_release_unused(void *user_context);
+
+/** When compiled with the persistent_scratch target feature, heap
+ * allocations made outside of any loop (typically compute_root
+ * intermediates), and those inside loops whose size doesn't change
+ * across the iterations (e.g. the scratch of each task of a parallel
+ * loop), call halide_scratch_malloc and halide_scratch_free instead
+ * of halide_malloc and halide_free. These keep a block per allocation
+ * site in a scratch arena across calls, growing it when a call needs
+ * more, so a stream of calls with the same sizes does no heap
+ * allocation after the first. If a block is already in use, e.g. by
+ * another task of a parallel loop or a concurrent call of the
+ * pipeline, the site gets another one, so there ends up being about
+ * one block per worker thread. The key identifies the allocation site
+ * by address, so separately compiled instances of a pipeline never
+ * share blocks. Blocks are obtained with halide_malloc.
+ *
+ * Which arena a call uses is decided by halide_get_scratch_arena,
+ * which is passed the call's user_context. The default always returns
+ * one process-wide arena. Override it (or use
+ * halide_set_custom_get_scratch_arena) to give each pipeline instance
+ * or user_context its own arena, created with
+ * halide_create_scratch_arena. Returning NULL disables reuse for that
+ * call. An arena must not be destroyed while a pipeline is using it.
+ * halide_scratch_arena_release_unused frees the blocks of an arena
+ * (the default one if arena is NULL) that aren't currently in use.
+ * These are only defined in runtimes with the persistent_scratch
+ * feature. */
+//@{
+struct halide_scratch_arena_t;
+extern void *halide_scratch_malloc(void *user_context, const char *key, uint64_t size);
+extern void halide_scratch_free(void *user_context, void *ptr);
+extern struct halide_scratch_arena_t *halide_create_scratch_arena(void *user_context);
+extern void halide_destroy_scratch_arena(void *user_context, struct halide_scratch_arena_t *arena);
+extern void halide_scratch_arena_release_unused(void *user_context, struct halide_scratch_arena_t *arena);
+extern struct halide_scratch_arena_t *halide_get_scratch_arena(void *user_context);
+typedef struct halide_scratch_arena_t *(*halide_get_scratch_arena_t)(void *user_context);
+extern halide_get_scratch_arena_t halide_set_custom_get_scratch_arena(halide_get_scratch_arena_t get_scratch_arena);
+//@}
+
+/** Loops over Vars scheduled with Func::distribute are split across
+ * the processes (e.g. MPI ranks) taking part in the pipeline, each of
+ * which only computes its own slice of the output, along with
+ * whatever it needs of the earlier stages. halide_distributed_rank
+ * and halide_distributed_num_ranks are called once per pipeline
+ * invocation to find this process's slice. By default there is only
+ * one rank. Use halide_set_custom_distributed_transport to install
+ * one that asks the communication library, or override these
+ * functions. Passing NULL restores the default. */
+//@{
+struct halide_distributed_transport_t {
+    int (*rank)(void *user_context);
+    int (*num_ranks)(void *user_context);
+};
+extern int halide_distributed_rank(void *user_context);
+extern int halide_distributed_num_ranks(void *user_context);
+extern const struct halide_distributed_transport_t *
+halide_set_custom_distributed_transport(const struct halide_distributed_transport_t *transport);
+//@}
+
 /** Halide calls these functions to interact with the underlying
  * system runtime functions. To replace in AOT code on platforms that
  * support weak linking, define these functions yourself, or use
@@ -242,6 +418,30 @@ extern int32_t halide_debug_to_file(void *user_context, const char *filename,
                                     int32_t type_code,
                                     struct halide_buffer_t *buf);
 
+/** Make halide_debug_to_file copy the buffer and return, leaving the
+ * file to be written by a background thread. At most
+ * max_pending_bytes of copies may be waiting to be written; a dump
+ * that doesn't fit is written synchronously instead, as is every dump
+ * when max_pending_bytes is zero (the default, unless the
+ * HL_DEBUG_TO_FILE_ASYNC environment variable gives a limit in
+ * megabytes). Returns the old limit. */
+extern int64_t halide_set_debug_to_file_async(int64_t max_pending_bytes);
+
+/** Wait until every file queued by halide_debug_to_file has been
+ * written. Returns zero, or the error code of the first background
+ * write to fail since the last call. Called automatically at exit. */
+extern int halide_debug_to_file_wait(void *user_context);
+
+/** Called at exit by code compiled with the pgo_instrument target
+ * feature, to append the names and values of its counters to the
+ * profile, one per line. The profile is written to the file named
+ * by the environment variable HL_PGO_OUTPUT, or to halide.pgo in the
+ * working directory if it is not set. Compiling again with
+ * HL_PGO_PROFILE set to the name of the profile uses the counts to
+ * lay out branches and loops. */
+extern int halide_pgo_write_counts(void *user_context, const char *const *names,
+                                   uint64_t *const *counts, int num_counts);
+
 /** Types in the halide type system. They can be ints, unsigned ints,
  * or floats (of various bit-widths), or a handle (which is always 64-bits).
  * Note that the int/uint/float values do not imply a specific bit width
@@ -255,7 +455,8 @@ typedef enum halide_type_code_t
     halide_type_int = 0,   //!< signed integers
     halide_type_uint = 1,  //!< unsigned integers
     halide_type_float = 2, //!< floating point numbers
-    halide_type_handle = 3 //!< opaque pointer type (void *)
+    halide_type_handle = 3, //!< opaque pointer type (void *)
+    halide_type_bfloat = 4  //!< brain floating point numbers (float32 with the low 16 bits of the mantissa dropped)
 } halide_type_code_t;
 
 // Note that while __attribute__ can go before or after the declaration,
@@ -476,7 +677,13 @@ struct halide_trace_packet_t {
  * Halide checks the for existence of an environment variable called
  * HL_TRACE_FILE and opens that file. If HL_TRACE_FILE is not defined,
  * it outputs trace information to stdout in a human-readable
- * format. */
+ * format.
+ *
+ * Binary trace packets are buffered per thread, and written out when
+ * a buffer fills, at the end of each pipeline, and by
+ * halide_shutdown_trace. Packets from different threads may be
+ * interleaved out of order, but every packet is written after its
+ * parent, and packet ids are unique. */
 extern void halide_set_trace_file(int fd);
 
 /** Halide calls this to retrieve the file descriptor to write binary
@@ -491,6 +698,24 @@ extern int halide_get_trace_file(void *user_context);
  * (flushing the trace). Returns zero on success. */
 extern int halide_shutdown_trace();
 
+/** Switch binary tracing to a compact format, in which each buffer
+ * of trace packets is written as one block: the 32-bit word
+ * HALIDE_TRACE_COMPACT_MAGIC, the 32-bit byte count of the rest of
+ * the block, then a sequence of records. Packet ids, parent ids and
+ * coordinates are delta-encoded as varints, and each Func name is
+ * written only the first time it appears in a block. In addition,
+ * only one in every sample_period loads and stores is recorded; all
+ * other events are always recorded. A sample_period of zero switches
+ * back to the full format. When tracing to HL_TRACE_FILE, this can
+ * also be enabled by setting the environment variable
+ * HL_TRACE_COMPACT to the sample period. The trace tools in util/
+ * decode both formats. */
+extern void halide_set_trace_compact(int sample_period);
+
+/** The first word of a block of compact trace records. It's odd, so
+ * it can't be mistaken for the size of a full trace packet. */
+#define HALIDE_TRACE_COMPACT_MAGIC 0x43544801
+
 /** All Halide GPU or device backend implementations provide an
  * interface to be used with halide_device_malloc, etc. This is
  * accessed via the functions below.
@@ -594,6 +819,41 @@ extern int halide_device_crop(void *user_context,
 extern int halide_device_release_crop(void *user_context,
                                       struct halide_buffer_t *buf);
 
+/** Mark only a box of a buffer as dirty on the device (or, for
+ * halide_buffer_set_host_dirty_region, on the host), so that
+ * halide_copy_to_host (halide_copy_to_device) copies just that box
+ * rather than the whole buffer. The region is an array of
+ * buf->dimensions halide_dimension_t, of which only the mins and
+ * extents are used, or NULL for the whole buffer. Marking several
+ * regions dirty keeps their bounding box. Marking the whole buffer
+ * dirty or clean in any other way, e.g. with set_device_dirty(),
+ * forgets the region. Returns
+ * halide_error_code_host_and_device_dirty if the other side of the
+ * buffer is already dirty. */
+// @{
+extern int halide_buffer_set_device_dirty_region(void *user_context, struct halide_buffer_t *buf,
+                                                 const struct halide_dimension_t *region);
+extern int halide_buffer_set_host_dirty_region(void *user_context, struct halide_buffer_t *buf,
+                                               const struct halide_dimension_t *region);
+// @}
+
+/** Like halide_copy_to_host and halide_copy_to_device, but only copy
+ * the part of the dirty region that lies within the given region
+ * (which is laid out as for halide_buffer_set_device_dirty_region),
+ * for consumers that only need part of a buffer. The buffer stays
+ * dirty until all of its dirty region has been copied; copying a band
+ * along one edge of the dirty region shrinks it. The host must not
+ * write to a buffer that is still device dirty, even in regions that
+ * have been copied. Uses halide_device_crop, so falls back to copying
+ * the whole dirty region on device APIs that don't support cropping. */
+// @{
+extern int halide_copy_to_host_region(void *user_context, struct halide_buffer_t *buf,
+                                      const struct halide_dimension_t *region);
+extern int halide_copy_to_device_region(void *user_context, struct halide_buffer_t *buf,
+                                        const struct halide_device_interface_t *device_interface,
+                                        const struct halide_dimension_t *region);
+// @}
+
 /** Wait for current GPU operations to complete. Calling this explicitly
  * should rarely be necessary, except maybe for profiling. */
 extern int halide_device_sync(void *user_context, struct halide_buffer_t *buf);
@@ -636,6 +896,14 @@ extern int halide_device_free_legacy(void *user_context, struct buffer_t *buf);
  * device. Set this to -1 to use the last device. */
 extern void halide_set_gpu_device(int n);
 
+/** Selects which gpu device to use for calls made with a particular
+ * user_context, overriding halide_set_gpu_device. This lets several
+ * instances of a pipeline run on different devices at once. Set the
+ * device to -1 to remove the setting for that user_context. Returns
+ * non-zero if too many user_contexts have a device. Only used by the
+ * default implementation of halide_get_gpu_device. */
+extern int halide_set_gpu_device_for_user_context(void *user_context, int n);
+
 /** Halide calls this to get the desired halide gpu device
  * setting. Implement this yourself to use a different gpu device per
  * user_context. The default implementation returns the value set by
@@ -667,11 +935,30 @@ extern void halide_memoization_cache_set_size(int64_t size);
  * -1: Signals an error.
  *  0: Success and cache hit.
  *  1: Success and cache miss.
+ *
+ * Pipelines compiled by this version of Halide call
+ * halide_memoization_cache_lookup_with_hash instead. This is the same
+ * as calling it with a pipeline_hash of zero, and is kept for
+ * pipelines compiled by older versions.
  */
 extern int halide_memoization_cache_lookup(void *user_context, const uint8_t *cache_key, int32_t size,
                                            struct halide_buffer_t *realized_bounds,
                                            int32_t tuple_count, struct halide_buffer_t **tuple_buffers);
 
+/** As halide_memoization_cache_lookup, with a hash that identifies
+ * the pipeline and the memoized Func. The cache key begins with a
+ * pointer and an int32_t that identify the Func within the current
+ * process. pipeline_hash identifies the pipeline and Func in a way
+ * that is stable across processes, and is used together with the
+ * rest of the key by the optional on-disk tier (see
+ * halide_memoization_cache_set_disk_path) and the shared-memory
+ * tier. A pipeline_hash of zero means there is none, and such results
+ * are only cached within the current process. */
+extern int halide_memoization_cache_lookup_with_hash(void *user_context, const uint8_t *cache_key, int32_t size,
+                                                     struct halide_buffer_t *realized_bounds,
+                                                     int32_t tuple_count, struct halide_buffer_t **tuple_buffers,
+                                                     uint64_t pipeline_hash);
+
 /** Given a cache key for a memoized result, currently constructed
  *  from the Func name and top-level Func name plus the arguments of
  *  the computation, store the result in the cache for futre access by
@@ -685,12 +972,33 @@ extern int halide_memoization_cache_lookup(void *user_context, const uint8_t *ca
  *
  * If there is a memory allocation failure, the store does not store
  * the data into the cache.
+ *
+ * Pipelines compiled by this version of Halide call
+ * halide_memoization_cache_store_with_priority instead. This is the
+ * same as calling it with an eviction_priority and pipeline_hash of
+ * zero, and is kept for pipelines compiled by older versions.
  */
 extern int halide_memoization_cache_store(void *user_context, const uint8_t *cache_key, int32_t size,
                                           struct halide_buffer_t *realized_bounds,
                                           int32_t tuple_count,
                                           struct halide_buffer_t **tuple_buffers);
 
+/** As halide_memoization_cache_store, with an eviction priority and
+ * a pipeline hash. eviction_priority is the hint passed to
+ * Func::memoize. The default implementation evicts entries with the
+ * lowest value of (time to compute * 2^eviction_priority) / size
+ * first, aged so that entries which are never looked up again
+ * eventually go too (the GreedyDual-Size-Frequency policy). The
+ * compute time is measured from the cache miss in the lookup to this
+ * call. pipeline_hash is as for
+ * halide_memoization_cache_lookup_with_hash. */
+extern int halide_memoization_cache_store_with_priority(void *user_context, const uint8_t *cache_key, int32_t size,
+                                                        struct halide_buffer_t *realized_bounds,
+                                                        int32_t tuple_count,
+                                                        struct halide_buffer_t **tuple_buffers,
+                                                        int32_t eviction_priority,
+                                                        uint64_t pipeline_hash);
+
 /** If halide_memoization_cache_lookup succeeds,
  * halide_memoization_cache_release must be called to signal the
  * storage is no longer being used by the caller. It will be passed
@@ -708,6 +1016,87 @@ extern int halide_memoization_cache_store(void *user_context, const uint8_t *cac
   */
 extern void halide_memoization_cache_release(void *user_context, void *host);
 
+/** Enable the persistent on-disk tier of the default memoization
+ * cache, storing results as files in the given directory, which must
+ * already exist. Every result stored in the cache is also written to
+ * disk, and a cache miss first tries to reload the result from disk,
+ * so a restarted process can reuse the results of a previous run of
+ * the same pipeline. Results are only reused if the pipeline, the
+ * memoized Func, its cache key and its bounds all match. Nothing is
+ * ever deleted from the directory; clearing it is up to the
+ * user. Passing NULL disables the tier. If this is never called, the
+ * directory is taken from the environment variable
+ * HL_MEMOIZATION_CACHE_DIR, if set.
+ */
+extern void halide_memoization_cache_set_disk_path(const char *path);
+
+/** Enable the shared tier of the default memoization cache. Results
+ * are kept in the named POSIX shared memory segment, which is created
+ * with the given size in bytes if it doesn't already exist (zero means
+ * the size of the in-process cache). Every process on the host that
+ * names the same segment shares its results, and holds each of them
+ * only once. Results found there are returned without copying, and
+ * only results that don't fit in the segment are kept in this
+ * process's cache. It can also be enabled by setting
+ * HL_MEMOIZATION_CACHE_SHM to the name before the first lookup. Pass
+ * NULL to turn it off again. Must not be called while any pipeline is
+ * running or holds a cached result. Returns zero on success, or -1 if
+ * the segment couldn't be mapped, for instance because this platform
+ * doesn't support it or it was created with a different size. */
+extern int halide_memoization_cache_set_shared_memory(const char *name, int64_t size);
+
+/** Statistics gathered by the default memoization cache, either for
+ * one memoized Func, for one pipeline, or for the whole cache. */
+struct halide_memoization_cache_stats_t {
+    /** Lookups satisfied from memory. */
+    uint64_t hits;
+
+    /** Lookups that missed in memory but were reloaded from the
+     * on-disk tier. */
+    uint64_t disk_hits;
+
+    /** Lookups that missed in this process's cache but were found in
+     * the shared tier. */
+    uint64_t shared_hits;
+
+    /** Lookups that required the result to be computed. */
+    uint64_t misses;
+
+    /** Results stored into the cache after being computed. */
+    uint64_t stores;
+
+    /** Entries evicted to stay within the cache size or a quota. */
+    uint64_t evictions;
+
+    /** Bytes currently held in the cache. */
+    int64_t bytes;
+
+    /** The total time spent computing stored results. Divide by
+     * stores for the average recompute cost. */
+    int64_t total_compute_time_ns;
+};
+
+/** Get statistics from the default memoization cache. Pipelines are
+ * named by the name of the generated function (for JIT compilation,
+ * the name of the output Func), and Funcs by their names. If
+ * func_name is NULL, the statistics of all Funcs in the pipeline are
+ * summed, and if pipeline_name is NULL too, those of the whole
+ * cache. Returns -1 if nothing matching has used the cache. */
+extern int halide_memoization_cache_get_stats(const char *pipeline_name, const char *func_name,
+                                              struct halide_memoization_cache_stats_t *stats);
+
+/** Reset all the counters returned by
+ * halide_memoization_cache_get_stats, other than the byte counts. */
+extern void halide_memoization_cache_reset_stats();
+
+/** Limit the number of bytes the results of one pipeline may occupy
+ * in the default memoization cache. A pipeline over its quota has its
+ * own entries evicted, and while within its quota its entries are
+ * only evicted to make room for other pipelines when nothing else can
+ * be. The overall cache size limit still applies. A quota of zero
+ * removes the limit. May be set before the pipeline first runs. */
+extern int halide_memoization_cache_set_pipeline_quota(const char *pipeline_name, int64_t bytes);
+
 /** Free all memory and resources associated with the memoization cache.
  * Must be called at a time when no other threads are accessing the cache.
  */
@@ -1071,7 +1460,33 @@ typedef enum halide_target_feature_t {
     halide_target_feature_cuda_capability61 = 46,  ///< Enable CUDA compute capability 6.1 (Pascal)
     halide_target_feature_hvx_v65 = 47, ///< Enable Hexagon v65 architecture.
     halide_target_feature_hvx_v66 = 48, ///< Enable Hexagon v66 architecture.
-    halide_target_feature_end = 49, ///< A sentinel. Every target is considered to have this feature, and setting this feature does nothing.
+    halide_target_feature_pool_allocator = 49, ///< Use a pooling allocator for halide_default_malloc. See halide_pool_allocator_release_unused.
+    halide_target_feature_persistent_scratch = 50, ///< Keep the heap allocations of root-level Funcs, and of the tasks of parallel loops, in a scratch arena between calls. See halide_scratch_malloc.
+    halide_target_feature_profile_timeline = 51, ///< Like profile, and also record a per-thread timeline of Funcs and parallel tasks. See halide_profiler_dump_timeline.
+    halide_target_feature_profile_lightweight = 52, ///< A cheaper sampling profiler, which tracks the Func each thread is computing but not memory use. Meant to be left on. See halide_profiler_visit_pipelines.
+    halide_target_feature_arm_dot_prod = 53, ///< Enable the ARMv8.2-a dot product instructions (udot and sdot).
+    halide_target_feature_cuda_capability70 = 54, ///< Enable CUDA compute capability 7.0 (Volta)
+    halide_target_feature_cuda_capability75 = 55, ///< Enable CUDA compute capability 7.5 (Turing)
+    halide_target_feature_cuda_managed_memory = 56, ///< Use CUDA managed memory for allocations used on both the host and a CUDA device, and prefetch instead of copying. See halide_cuda_managed_prefetch.
+    halide_target_feature_avx512_cascadelake = 57, ///< Enable the AVX512 features supported by Cascade Lake Xeon processors. This includes all of the Skylake features, plus AVX512-VNNI. Halide built with LLVM older than 8 can't generate AVX512-VNNI, and compiles this as avx512_skylake.
+    halide_target_feature_sve_256 = 58, ///< Enable the ARM Scalable Vector Extension, assuming 256-bit vectors.
+    halide_target_feature_sve_512 = 59, ///< Enable the ARM Scalable Vector Extension, assuming 512-bit vectors.
+    halide_target_feature_power_arch_3_00 = 60, ///< Use POWER ISA 3.00 (POWER9) new instructions. Only relevant on POWERPC.
+    halide_target_feature_power_arch_3_1 = 61, ///< Use POWER ISA 3.1 (POWER10) new instructions, including MMA. Only relevant on POWERPC.
+    halide_target_feature_unused_62 = 62, ///< Unused. Kept for a feature that can be tested at runtime.
+    halide_target_feature_unused_63 = 63, ///< Unused. Kept for a feature that can be tested at runtime.
+    // Features from here on don't fit in the mask passed to
+    // halide_can_use_target_features, so they can only be chosen at
+    // compile time. Options that only change how code is generated,
+    // rather than what the hardware must support, go here.
+    halide_target_feature_c_simd_intrinsics = 64, ///< Use SIMD intrinsics for vectors in the C backend, where the C compiler supports them.
+    halide_target_feature_pgo_instrument = 65, ///< Count how often each branch is taken and each loop runs, and write the counts to a profile at exit. See halide_pgo_write_counts.
+    halide_target_feature_share_allocations = 66, ///< Let heap allocations with disjoint lifetimes (e.g. of a chain of compute_root Funcs) share memory.
+    halide_target_feature_auto_prefetch = 67, ///< Prefetch loads in inner loops that stride too far for the hardware prefetcher to follow.
+    halide_target_feature_task_parallel = 68, ///< Run independent compute_root Funcs concurrently on the thread pool.
+    halide_target_feature_gpu_kernel_fusion = 69, ///< Merge the kernels of consecutive root-level GPU stages that are pointwise in each other.
+    halide_target_feature_size_optimized = 70, ///< Trade speed for smaller code: fewer partitioned loop variants, and llvm optimizing for size.
+    halide_target_feature_end = 71, ///< A sentinel. Every target is considered to have this feature, and setting this feature does nothing.
 } halide_target_feature_t;
 
 /** This function is called internally by Halide in some situations to determine
@@ -1086,6 +1501,9 @@ typedef enum halide_target_feature_t {
  * In other words: a return value of 0 means "It is not safe to use code compiled with these features",
  * while a return value of 1 means "It is not obviously unsafe to use code compiled with these features".
  *
+ * Bit i of features is halide_target_feature_t i. Features 64 and up
+ * can't be tested.
+ *
  * The default implementation simply calls halide_default_can_use_target_features.
  */
 // @{
@@ -1140,7 +1558,12 @@ typedef struct halide_dimension_t {
 #endif
 
 typedef enum {halide_buffer_flag_host_dirty = 1,
-              halide_buffer_flag_device_dirty = 2} halide_buffer_flags;
+              halide_buffer_flag_device_dirty = 2,
+              /** Only part of the buffer is dirty. The runtime keeps the
+               * bounding box of the dirty region, and marking the whole
+               * buffer dirty (or clean) clears this flag. See
+               * halide_buffer_set_device_dirty_region. */
+              halide_buffer_flag_dirty_region = 4} halide_buffer_flags;
 
 /**
  * The raw representation of an image passed around by generated
@@ -1200,10 +1623,12 @@ typedef struct halide_buffer_t {
 
     HALIDE_ALWAYS_INLINE void set_host_dirty(bool v = true) {
         set_flag(halide_buffer_flag_host_dirty, v);
+        set_flag(halide_buffer_flag_dirty_region, false);
     }
 
     HALIDE_ALWAYS_INLINE void set_device_dirty(bool v = true) {
         set_flag(halide_buffer_flag_device_dirty, v);
+        set_flag(halide_buffer_flag_dirty_region, false);
     }
     // @}
 
@@ -1412,6 +1837,29 @@ struct halide_filter_metadata_t {
  * the -profile target flag, which runs a sampling profiler thread
  * alongside the pipeline. */
 
+/** Hardware performance counters that the profiler can bill to each
+ * Func. They are read on Linux x86 when the environment variable
+ * HL_PROFILER_COUNTERS is set to 1. Counts are from user space only,
+ * and are summed over the thread that started the profiler and the
+ * threads it created afterwards. */
+typedef enum halide_profiler_counter_t {
+    halide_profiler_counter_cycles = 0,       ///< CPU cycles
+    halide_profiler_counter_instructions = 1, ///< Instructions retired
+    halide_profiler_counter_cache_misses = 2, ///< Last level cache misses. Multiply by the line size for bytes moved to and from memory.
+    halide_profiler_counter_branch_misses = 3, ///< Mispredicted branches
+    halide_profiler_num_counters = 4
+} halide_profiler_counter_t;
+
+/** The profiler keeps histograms of how long each pipeline run and
+ * each realization of a Func takes. Bucket 0 counts latencies under
+ * 1024ns. Above that, each power of two is split into four buckets,
+ * so bucket 1 + 4 * (k - 10) + q counts latencies in
+ * [(4 + q) * 2^(k - 2), (5 + q) * 2^(k - 2)) ns. The last bucket also
+ * counts everything longer. */
+enum {
+    halide_profiler_latency_buckets = 128
+};
+
 /** Per-Func state tracked by the sampling profiler. */
 struct halide_profiler_func_stats {
     /** Total time taken evaluating this Func (in nanoseconds). */
@@ -1437,6 +1885,25 @@ struct halide_profiler_func_stats {
 
     /** The total number of memory allocation of this Func. */
     int num_allocs;
+
+    // The fields below were added later. They go at the end so that
+    // code that reads the fields above keeps working.
+
+    /** Hardware counter totals billed to this Func, indexed by
+     * halide_profiler_counter_t. Zero unless counters are enabled. */
+    uint64_t counters[halide_profiler_num_counters];
+
+    /** A histogram of the time taken by each realization of this
+     * Func. Only recorded for Funcs computed outside of all loops,
+     * such as outputs and compute_root Funcs, and not by the
+     * lightweight profiler. */
+    uint64_t latency_histogram[halide_profiler_latency_buckets];
+
+    /** Estimates of the arithmetic ops done, and the bytes loaded and
+     * stored, by this Func, from counts made at compile time scaled
+     * by the loop extents at run time. Not recorded by the
+     * lightweight profiler. */
+    uint64_t ops, bytes;
 };
 
 /** Per-pipeline state tracked by the sampling profiler. These exist
@@ -1451,7 +1918,12 @@ struct halide_profiler_pipeline_stats {
     /** The peak memory allocation of funcs in this pipeline. */
     uint64_t memory_peak;
 
-    /** The total memory allocation of funcs in this pipeline. */
+    /** The total memory allocation of funcs in this pipeline. Like
+     * num_allocs, this is summed over the funcs at the end of each run
+     * of the pipeline, so it doesn't include runs still in progress
+     * or that failed until the stats are read through
+     * halide_profiler_get_pipeline_state,
+     * halide_profiler_visit_pipelines, or halide_profiler_report. */
     uint64_t memory_total;
 
     /** The average number of thread pool worker threads doing useful
@@ -1480,8 +1952,20 @@ struct halide_profiler_pipeline_stats {
     /** The total number of samples taken inside of this pipeline. */
     int samples;
 
-    /** The total number of memory allocation of funcs in this pipeline. */
+    /** The total number of memory allocation of funcs in this
+     * pipeline. See memory_total. */
     int num_allocs;
+
+    // The fields below were added later. They go at the end so that
+    // code that reads the fields above keeps working.
+
+    /** Hardware counter totals billed to funcs in this pipeline,
+     * indexed by halide_profiler_counter_t. */
+    uint64_t counters[halide_profiler_num_counters];
+
+    /** A histogram of the time taken by each successful run of this
+     * pipeline. */
+    uint64_t latency_histogram[halide_profiler_latency_buckets];
 };
 
 /** The global state of the profiler. */
@@ -1543,9 +2027,74 @@ extern struct halide_profiler_pipeline_stats *halide_profiler_get_pipeline_state
 extern void halide_profiler_reset();
 
 /** Print out timing statistics for everything run since the last
- * reset. Also happens at process exit. */
+ * reset. Also happens at process exit. Funcs with estimated op and
+ * byte counts also report the GOP/s and GB/s achieved. If the
+ * environment variables HL_PROFILER_PEAK_GOPS and HL_PROFILER_PEAK_GBPS
+ * give the machine's peak arithmetic rate and memory bandwidth, they
+ * also report the roofline bound at their arithmetic intensity, which
+ * of the two peaks sets it, and the fraction of it achieved. */
 extern void halide_profiler_report(void *user_context);
 
+/** Estimate a percentile, from 0 to 100, of the latencies recorded
+ * in one of the profiler's histograms, in nanoseconds. Returns the
+ * upper bound of the bucket the percentile falls in, or zero if the
+ * histogram is empty. */
+extern uint64_t halide_profiler_latency_percentile(const uint64_t *histogram, float percentile);
+
+/** A function called on each pipeline's stats by
+ * halide_profiler_visit_pipelines. */
+typedef void (*halide_profiler_pipeline_visitor_t)(void *arg, const struct halide_profiler_pipeline_stats *stats);
+
+/** Call a visitor on the stats of each pipeline that has run, with
+ * the profiler's lock held, so that a long-running process can
+ * export them periodically. If reset is true, the time, sample, run
+ * and counter totals are zeroed after each visit, so each call sees
+ * what happened since the last. Memory stats are left as they are.
+ * For pipelines compiled with profile_lightweight, times are summed
+ * over all threads computing each Func. */
+extern void halide_profiler_visit_pipelines(halide_profiler_pipeline_visitor_t visitor, void *arg, bool reset);
+
+/** Get the slot in which the calling thread records the Func it is
+ * computing, for pipelines compiled with profile_lightweight. */
+extern int *halide_profiler_get_thread_slot(struct halide_profiler_state *s);
+
+/** Release a slot got with halide_profiler_get_thread_slot. The slot
+ * goes back to the Func it recorded when it was got, or to outside of
+ * Halide code if no other scope on the thread holds it. */
+extern void halide_profiler_release_thread_slot(void *user_context, void *slot);
+
+/** Kinds of event recorded in the profiler timeline. */
+enum halide_profiler_timeline_event_kind_t {
+    /// The thread started working on the Func given by the event's func id.
+    halide_profiler_timeline_func = 0,
+    /// A thread picked up a task of a parallel loop.
+    halide_profiler_timeline_task_begin = 1,
+    /// A thread finished a task of a parallel loop.
+    halide_profiler_timeline_task_end = 2,
+    /// A pipeline started. The func id is the pipeline's token.
+    halide_profiler_timeline_pipeline_begin = 3,
+    /// A pipeline finished.
+    halide_profiler_timeline_pipeline_end = 4
+};
+
+/** Record a timeline event for the calling thread. Called by
+ * pipelines compiled with the profile_timeline target feature. */
+extern int halide_profiler_timeline_event(struct halide_profiler_state *s, int func_id, int kind);
+
+/** Write the timeline recorded by pipelines compiled with the
+ * profile_timeline target feature to a file, in the Chrome
+ * trace-event JSON format, which chrome://tracing and
+ * ui.perfetto.dev can open. Each thread shows as a track, with
+ * nested spans for pipelines, parallel tasks, and the Funcs being
+ * computed. Returns zero on success. Do not call this while any
+ * pipeline is running. If the environment variable
+ * HL_PROFILER_TIMELINE_FILE is set, the timeline is also written
+ * there at process exit. */
+extern int halide_profiler_dump_timeline(void *user_context, const char *filename);
+
+/** Discard the recorded timeline. Also done by halide_profiler_reset. */
+extern void halide_profiler_reset_timeline();
+
 /// \name "Float16" functions
 /// These functions operate of bits (``uint16_t``) representing a half
 /// precision floating point number (IEEE-754 2008 binary16).
@@ -57,6 +57,51 @@ extern int halide_cuda_detach_device_ptr(void *user_context, struct halide_buffe
  */
 extern uintptr_t halide_cuda_get_device_ptr(void *user_context, struct halide_buffer_t *buf);
 
+/** Set the maximum number of bytes of device memory that
+ * halide_cuda_device_free keeps cached to reuse for later allocations,
+ * instead of freeing it (which synchronizes the device). Allocations
+ * are reused by allocations of the same size class on the same context
+ * and stream. The default is 256MB; setting it to zero disables the
+ * cache. If more memory than the new limit is cached, the unused
+ * allocations on the current context are released. */
+extern int halide_cuda_set_allocation_cache_size(void *user_context, size_t bytes);
+
+/** Free the device memory cached for reuse on the current context,
+ * after waiting for the device to finish the work that may use it. */
+extern int halide_cuda_release_unused_device_allocations(void *user_context);
+
+/** Make the default halide_cuda_get_stream give each user_context its
+ * own stream, instead of using the default stream for every call, so
+ * that calls with different user_contexts can overlap on the device.
+ * The streams are taken from a pool, and are created as needed. A
+ * user_context keeps its stream until halide_cuda_release_stream is
+ * called for it, so a user_context should be reused or released rather
+ * than made anew for each call. Work on these streams is still ordered
+ * with the work on the default stream. */
+extern int halide_cuda_set_stream_per_user_context(void *user_context, bool enable);
+
+/** Return the stream of a user_context to the pool used when
+ * halide_cuda_set_stream_per_user_context is enabled. Work already
+ * queued on the stream is not waited for; it is ordered before the
+ * work of the next user_context to use the stream. */
+extern int halide_cuda_release_stream(void *user_context);
+
+/** Allocate CUDA managed memory for a buffer, which is both its host
+ * and device allocation. Used for internal allocations of pipelines
+ * compiled with the cuda_managed_memory target feature. Falls back to
+ * halide_cuda_device_and_host_malloc if the driver doesn't support
+ * managed memory. Free it with halide_device_and_host_free. */
+extern int halide_cuda_device_and_host_malloc_managed(void *user_context, struct halide_buffer_t *buf);
+
+/** Prefetch the bytes [begin, end) of a managed buffer to the device
+ * (if to_device is non-zero) or to the host, in place of a copy. A
+ * negative end means the end of the buffer. Prefetching to the host
+ * waits for the device to finish using the buffer. Clears the host or
+ * device dirty bit, as the corresponding copy would. Buffers that are
+ * not managed are copied instead. */
+extern int halide_cuda_managed_prefetch(void *user_context, struct halide_buffer_t *buf,
+                                        int to_device, int64_t begin, int64_t end);
+
 #ifdef __cplusplus
 } // End extern "C"
 #endif
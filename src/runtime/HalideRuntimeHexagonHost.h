@@ -43,6 +43,18 @@ extern int halide_hexagon_detach_device_handle(void *user_context, struct halide
 extern void *halide_hexagon_get_device_handle(void *user_context, struct halide_buffer_t *buf);
 extern uint64_t halide_hexagon_get_device_size(void *user_context, struct halide_buffer_t *buf);
 
+/** Set the maximum number of bytes of ION memory that
+ * halide_hexagon_device_free keeps cached to reuse for later
+ * allocations, instead of freeing it. Cached allocations stay mapped
+ * and registered with FastRPC, so reusing one costs nothing, and are
+ * reused by allocations of the same size class. The default is 64MB;
+ * setting it to zero disables the cache. If more memory than the new
+ * limit is cached, the unused allocations are released. */
+extern int halide_hexagon_set_allocation_cache_size(void *user_context, size_t bytes);
+
+/** Free the ION memory cached for reuse. */
+extern int halide_hexagon_release_unused_device_allocations(void *user_context);
+
 /** Power HVX on and off. Calling a Halide pipeline will do this
  * automatically on each pipeline invocation; however, it costs a
  * small but possibly significant amount of time for short running
@@ -108,6 +120,39 @@ extern int halide_hexagon_set_performance_mode(void *user_context, halide_hexago
 extern int halide_hexagon_set_performance(void *user_context, halide_hexagon_power_t *perf);
 // @}
 
+/** Vote for a performance mode automatically around pipelines run on
+ * Hexagon. While mode is anything other than
+ * halide_hexagon_power_default, the clock and bus vote for mode is
+ * cast (and HVX powered on) before a pipeline runs, and only reset to
+ * the default once no pipeline has run for hold_ms milliseconds. This
+ * hysteresis avoids ramping the DSP down and back up between
+ * pipelines that run in quick succession, such as successive frames
+ * of a camera pipeline. A hold_ms of zero or less resets the vote as
+ * soon as each pipeline finishes. Pass halide_hexagon_power_default to
+ * turn automatic voting off. While it's on, it overrides
+ * halide_hexagon_set_performance_mode. */
+extern int halide_hexagon_set_auto_performance_mode(void *user_context, halide_hexagon_power_mode_t mode, int hold_ms);
+
+/** Batch calls to Hexagon pipelines. Between halide_hexagon_begin_batch
+ * and halide_hexagon_end_batch, pipelines offloaded to Hexagon are
+ * queued instead of run, and return immediately. Ending the batch
+ * sends the queued pipelines to Hexagon in as few remote calls as
+ * possible, amortizing the fixed cost of each call.
+ * halide_hexagon_end_batch waits for the pipelines to finish, while
+ * halide_hexagon_end_batch_async runs them from another thread, so
+ * the host can do other work until halide_hexagon_wait_batch is
+ * called. The outputs of queued pipelines are not valid until the
+ * batch completes, and all buffers passed to them must remain
+ * allocated until then, so pipelines that allocate their own Hexagon
+ * buffers should not be run in a batch. Only one batch can be open
+ * or in flight at a time. */
+// @{
+extern int halide_hexagon_begin_batch(void *user_context);
+extern int halide_hexagon_end_batch(void *user_context);
+extern int halide_hexagon_end_batch_async(void *user_context);
+extern int halide_hexagon_wait_batch(void *user_context);
+// @}
+
 /** These are forward declared here to allow clients to override the
  *  Halide Hexagon runtime. Do not call them. */
 // @{
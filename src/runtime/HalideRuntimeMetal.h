@@ -59,6 +59,14 @@ extern int halide_metal_detach_buffer(void *user_context, struct halide_buffer_t
  */
 extern uintptr_t halide_metal_get_buffer(void *user_context, struct halide_buffer_t *buf);
 
+/** Sub-allocate device buffers from an MTLHeap of this many bytes of shared
+ * memory, which is much cheaper than allocating each buffer from the
+ * device. Buffers that don't fit in the heap are allocated from the device.
+ * The default is zero, which disables the heap. Heaps require a version of
+ * Metal that tracks hazards on heap resources; on older versions, or
+ * devices without shared heaps, this has no effect. */
+extern int halide_metal_set_heap_size(void *user_context, size_t bytes);
+
 struct halide_metal_device;
 struct halide_metal_command_queue;
 
@@ -76,6 +84,13 @@ struct halide_metal_command_queue;
  *     halide_metal_detach_buffer.
  * - halide_device_release has been called on the interface returned from
  *     halide_metal_device_interface(). (This releases the programs on the context.)
+ *
+ * Kernel launches are batched into one command buffer, which takes its
+ * place in the queue when the first launch is encoded, and is committed
+ * when the host accesses a buffer, or after 64 launches. Code that
+ * shares the queue and waits for its own work should first call
+ * halide_metal_device_sync with a NULL buffer, so that Halide's work
+ * ahead of it on the queue is committed.
  */
 extern int halide_metal_acquire_context(void *user_context, struct halide_metal_device **device_ret,
                                         struct halide_metal_command_queue **queue_ret, bool create);
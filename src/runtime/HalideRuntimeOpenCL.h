@@ -86,6 +86,31 @@ extern int halide_opencl_detach_cl_mem(void *user_context, struct halide_buffer_
  */
 extern uintptr_t halide_opencl_get_cl_mem(void *user_context, struct halide_buffer_t *buf);
 
+/** Create device memory for a halide_buffer_t that is its host memory,
+ * using CL_MEM_USE_HOST_PTR, so that on devices that share memory with
+ * the host (e.g. most mobile GPUs) the copies between them are free.
+ * The host memory should be aligned to what the device requires for
+ * that, usually a page. The host may only access the memory after the
+ * buffer has been copied to the host, and until it is next copied to
+ * the device, or used by a kernel. The device field of the
+ * halide_buffer_t must be NULL when this routine is called. The device
+ * memory is released by halide_device_free, which leaves the host
+ * memory alone. Buffers allocated with halide_device_and_host_malloc
+ * get such memory for both already, with CL_MEM_ALLOC_HOST_PTR. */
+extern int halide_opencl_wrap_host_ptr(void *user_context, struct halide_buffer_t *buf);
+
+/** Set the maximum number of bytes of device memory that
+ * halide_opencl_device_free keeps cached to reuse for later
+ * allocations, instead of releasing it. Allocations are reused by
+ * allocations of the same size class on the same context. The default
+ * is 256MB; setting it to zero disables the cache. If more memory than
+ * the new limit is cached, the unused allocations on the current
+ * context are released. */
+extern int halide_opencl_set_allocation_cache_size(void *user_context, size_t bytes);
+
+/** Release the device memory cached for reuse on the current context. */
+extern int halide_opencl_release_unused_device_allocations(void *user_context);
+
 #ifdef __cplusplus
 } // End extern "C"
 #endif
@@ -20,6 +20,13 @@ extern int halide_qurt_hvx_unlock(void *user_context);
 extern void halide_qurt_hvx_unlock_as_destructor(void *user_context, void * /*obj*/);
 // @}
 
+/** Allocate and free Hexagon's vector tightly coupled memory
+ * (VTCM). Allocations scheduled with MemoryType::VTCM use these. */
+// @{
+extern void *halide_vtcm_malloc(void *user_context, size_t size);
+extern void halide_vtcm_free(void *user_context, void *ptr);
+// @}
+
 #ifdef __cplusplus
 } // End extern "C"
 #endif
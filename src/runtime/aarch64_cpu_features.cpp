@@ -1,11 +1,41 @@
 #include "HalideRuntime.h"
 
+#define AT_HWCAP    16
+
+#define HWCAP_ASIMDDP   (1 << 20)
+#define HWCAP_SVE       (1 << 22)
+
+#define PR_SVE_GET_VL   51
+
+// Only Linux and Android have getauxval. Elsewhere (e.g. iOS) it is
+// NULL, and no optional features are reported.
+extern "C" __attribute__((weak)) unsigned long int getauxval(unsigned long int);
+extern "C" __attribute__((weak)) int prctl(int, ...);
+
 namespace Halide { namespace Runtime { namespace Internal {
 
 WEAK CpuFeatures halide_get_cpu_features() {
-    // AArch64 has no CPU-specific Features.
-    const uint64_t known = 0;
-    const uint64_t available = 0;
+    const uint64_t known = ((1ULL << halide_target_feature_arm_dot_prod) |
+                            (1ULL << halide_target_feature_sve_256) |
+                            (1ULL << halide_target_feature_sve_512));
+    uint64_t available = 0;
+    if (getauxval != NULL) {
+        const unsigned long hwcap = getauxval(AT_HWCAP);
+        if (hwcap & HWCAP_ASIMDDP) {
+            available |= (1ULL << halide_target_feature_arm_dot_prod);
+        }
+        if ((hwcap & HWCAP_SVE) && prctl != NULL) {
+            // Code compiled for a vector length runs correctly on
+            // any longer one.
+            int vl_bytes = prctl(PR_SVE_GET_VL) & 0xffff;
+            if (vl_bytes >= 32) {
+                available |= (1ULL << halide_target_feature_sve_256);
+            }
+            if (vl_bytes >= 64) {
+                available |= (1ULL << halide_target_feature_sve_512);
+            }
+        }
+    }
     CpuFeatures features = {known, available};
     return features;
 }
@@ -0,0 +1,34 @@
+// Shared by the allocator modules. Implements the halide_malloc
+// hooks on top of a halide_default_malloc and halide_default_free
+// defined by the including module.
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+WEAK halide_malloc_t custom_malloc = halide_default_malloc;
+WEAK halide_free_t custom_free = halide_default_free;
+
+}}} // namespace Halide::Runtime::Internal
+
+extern "C" {
+
+WEAK halide_malloc_t halide_set_custom_malloc(halide_malloc_t user_malloc) {
+    halide_malloc_t result = custom_malloc;
+    custom_malloc = user_malloc;
+    return result;
+}
+
+WEAK halide_free_t halide_set_custom_free(halide_free_t user_free) {
+    halide_free_t result = custom_free;
+    custom_free = user_free;
+    return result;
+}
+
+WEAK void *halide_malloc(void *user_context, size_t x) {
+    return custom_malloc(user_context, x);
+}
+
+WEAK void halide_free(void *user_context, void *ptr) {
+    custom_free(user_context, ptr);
+}
+
+}
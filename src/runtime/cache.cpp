@@ -7,6 +7,13 @@ namespace Halide { namespace Runtime { namespace Internal {
 
 #define CACHE_DEBUGGING 0
 
+WEAK char to_hex_char(int val) {
+    if (val < 10) {
+        return '0' + val;
+    }
+    return 'A' + (val - 10);
+}
+
 #if CACHE_DEBUGGING
 WEAK void debug_print_buffer(void *user_context, const char *buf_name, const halide_buffer_t &buf) {
     debug(user_context) << buf_name << ": elem_size " << buf.type.bytes() << " dimensions " << buf.dimensions << ", ";
@@ -19,13 +26,6 @@ WEAK void debug_print_buffer(void *user_context, const char *buf_name, const hal
 
 }
 
-WEAK char to_hex_char(int val) {
-    if (val < 10) {
-        return '0' + val;
-    }
-    return 'A' + (val - 10);
-}
-
 WEAK void debug_print_key(void *user_context, const char *msg, const uint8_t *cache_key, int32_t key_size) {
     debug(user_context) << "Key for " << msg << "\n";
     char buf[1024];
@@ -65,16 +65,225 @@ WEAK bool buffer_has_shape(const halide_buffer_t *buf, const halide_dimension_t
     return true;
 }
 
+// Statistics are kept for each memoized Func and for each pipeline.
+// A Func is identified by the string the first word of its cache key
+// points to, which encodes the pipeline and Func names. Records are
+// never freed until the cache is cleaned up, so the lookup table can
+// be read without a lock.
+struct PipelineStats {
+    PipelineStats *next;
+    const char *name;
+    // Zero if the pipeline has no quota.
+    int64_t quota;
+    halide_memoization_cache_stats_t stats;
+};
+
+struct FuncStats {
+    const char *id;
+    const char *pipeline_name;
+    const char *func_name;
+    PipelineStats *pipeline;
+    halide_memoization_cache_stats_t stats;
+};
+
+#define CACHE_MAX_FUNC_STATS 1024
+
+WEAK halide_mutex cache_stats_lock;
+WEAK PipelineStats *pipeline_stats_list = NULL;
+WEAK FuncStats *func_stats_table[CACHE_MAX_FUNC_STATS];
+
+// Add to a counter in both a Func's and its pipeline's statistics.
+#define CACHE_STAT_ADD(fs, field, amount)                                   \
+    do {                                                                    \
+        if (fs) {                                                           \
+            __sync_add_and_fetch(&(fs)->stats.field, (amount));             \
+            __sync_add_and_fetch(&(fs)->pipeline->stats.field, (amount));   \
+        }                                                                   \
+    } while (0)
+
+WEAK char *copy_string(const char *str, size_t len) {
+    char *result = (char *)halide_malloc(NULL, len + 1);
+    if (result) {
+        memcpy(result, str, len);
+        result[len] = 0;
+    }
+    return result;
+}
+
+// Find or make the record for a pipeline. Must be called with
+// cache_stats_lock held.
+WEAK PipelineStats *find_pipeline_stats_already_locked(const char *name, size_t len) {
+    for (PipelineStats *p = pipeline_stats_list; p; p = p->next) {
+        if (strncmp(p->name, name, len) == 0 && p->name[len] == 0) {
+            return p;
+        }
+    }
+    PipelineStats *p = (PipelineStats *)halide_malloc(NULL, sizeof(PipelineStats));
+    if (!p) {
+        return NULL;
+    }
+    memset(p, 0, sizeof(PipelineStats));
+    p->name = copy_string(name, len);
+    if (!p->name) {
+        halide_free(NULL, p);
+        return NULL;
+    }
+    p->next = pipeline_stats_list;
+    pipeline_stats_list = p;
+    return p;
+}
+
+// Split an identity string of the form "<n>:<pipeline><m>:<func>".
+WEAK bool parse_func_identity(const char *id, const char **pipeline, size_t *pipeline_len,
+                              const char **func, size_t *func_len) {
+    const char *names[2];
+    size_t lens[2];
+    const char *p = id;
+    for (int i = 0; i < 2; i++) {
+        if (*p < '0' || *p > '9') {
+            return false;
+        }
+        lens[i] = atoi(p);
+        while (*p >= '0' && *p <= '9') p++;
+        if (*p != ':') {
+            return false;
+        }
+        p++;
+        names[i] = p;
+        for (size_t j = 0; j < lens[i]; j++) {
+            if (!*p++) {
+                return false;
+            }
+        }
+    }
+    *pipeline = names[0];
+    *pipeline_len = lens[0];
+    *func = names[1];
+    *func_len = lens[1];
+    return true;
+}
+
+WEAK FuncStats *make_func_stats(const char *id) {
+    const char *pipeline_name, *func_name;
+    size_t pipeline_len, func_len;
+    if (!parse_func_identity(id, &pipeline_name, &pipeline_len, &func_name, &func_len)) {
+        return NULL;
+    }
+    FuncStats *fs = (FuncStats *)halide_malloc(NULL, sizeof(FuncStats));
+    if (!fs) {
+        return NULL;
+    }
+    memset(fs, 0, sizeof(FuncStats));
+    fs->id = copy_string(id, strlen(id));
+    fs->func_name = copy_string(func_name, func_len);
+    {
+        ScopedMutexLock lock(&cache_stats_lock);
+        fs->pipeline = find_pipeline_stats_already_locked(pipeline_name, pipeline_len);
+    }
+    if (!fs->id || !fs->func_name || !fs->pipeline) {
+        halide_free(NULL, (void *)fs->id);
+        halide_free(NULL, (void *)fs->func_name);
+        halide_free(NULL, fs);
+        return NULL;
+    }
+    fs->pipeline_name = fs->pipeline->name;
+    return fs;
+}
+
+// Find or make the statistics record for the Func a cache key belongs
+// to. Returns NULL if statistics can't be kept for it.
+WEAK FuncStats *find_func_stats(const uint8_t *cache_key, int32_t size) {
+    if ((size_t)size < sizeof(const char *)) {
+        return NULL;
+    }
+    const char *id;
+    memcpy(&id, cache_key, sizeof(id));
+    uintptr_t h = (uintptr_t)id;
+    h ^= h >> 17;
+    for (int i = 0; i < CACHE_MAX_FUNC_STATS; i++) {
+        FuncStats **slot = &func_stats_table[(h + i) % CACHE_MAX_FUNC_STATS];
+        FuncStats *fs = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+        if (fs == NULL) {
+            FuncStats *new_fs = make_func_stats(id);
+            if (!new_fs) {
+                return NULL;
+            }
+            if (__atomic_compare_exchange_n(slot, &fs, new_fs, false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                return new_fs;
+            }
+            // Someone else filled the slot first. fs is now what they
+            // put there.
+            halide_free(NULL, (void *)new_fs->id);
+            halide_free(NULL, (void *)new_fs->func_name);
+            halide_free(NULL, new_fs);
+        }
+        // The address of the identity string can be reused by another
+        // Func if JIT code is freed, so compare the contents.
+        if (strcmp(fs->id, id) == 0) {
+            return fs;
+        }
+    }
+    return NULL;
+}
+
+// Whether an entry is protected from eviction to make room for other
+// pipelines, because its own pipeline is within its quota.
+WEAK bool entry_protected(const FuncStats *fs) {
+    if (!fs) {
+        return false;
+    }
+    int64_t quota = fs->pipeline->quota;
+    return quota > 0 && __atomic_load_n(&fs->pipeline->stats.bytes, __ATOMIC_RELAXED) <= quota;
+}
+
+WEAK void add_stats(halide_memoization_cache_stats_t *dst, const halide_memoization_cache_stats_t *src) {
+    dst->hits += __atomic_load_n(&src->hits, __ATOMIC_RELAXED);
+    dst->disk_hits += __atomic_load_n(&src->disk_hits, __ATOMIC_RELAXED);
+    dst->shared_hits += __atomic_load_n(&src->shared_hits, __ATOMIC_RELAXED);
+    dst->misses += __atomic_load_n(&src->misses, __ATOMIC_RELAXED);
+    dst->stores += __atomic_load_n(&src->stores, __ATOMIC_RELAXED);
+    dst->evictions += __atomic_load_n(&src->evictions, __ATOMIC_RELAXED);
+    dst->bytes += __atomic_load_n(&src->bytes, __ATOMIC_RELAXED);
+    dst->total_compute_time_ns += __atomic_load_n(&src->total_compute_time_ns, __ATOMIC_RELAXED);
+}
+
+// Reset everything but the byte count, which tracks what's currently
+// in the cache.
+WEAK void reset_stats(halide_memoization_cache_stats_t *stats) {
+    __atomic_store_n(&stats->hits, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->disk_hits, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->shared_hits, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->misses, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->stores, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->evictions, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->total_compute_time_ns, 0, __ATOMIC_RELAXED);
+}
+
 struct CacheEntry {
     CacheEntry *next;
-    CacheEntry *more_recent;
-    CacheEntry *less_recent;
     uint8_t *metadata_storage;
     size_t key_size;
     uint8_t *key;
-    uint32_t hash;
+    uint64_t hash;
     uint32_t in_use_count; // 0 if none returned from halide_cache_lookup
     uint32_t tuple_count;
+    // Total bytes of all the tuple buffers.
+    uint64_t size;
+    // Number of times this entry has been stored or looked up.
+    uint32_t use_count;
+    // Position in the shard's eviction heap, or -1 while the entry is
+    // in use and so can't be evicted.
+    int32_t heap_index;
+    // How much it's worth keeping this entry per byte it occupies on
+    // each use: the time it took to compute, scaled by the Func's
+    // eviction priority, divided by its size.
+    double weight;
+    // The GreedyDual-Size-Frequency value of this entry. The entry
+    // with the lowest value is evicted first.
+    double value;
+    // Where to count statistics about this entry. May be NULL.
+    FuncStats *stats;
     // The shape of the computed data. There may be more data allocated than this.
     int32_t dimensions;
     halide_dimension_t *computed_bounds;
@@ -82,7 +291,7 @@ struct CacheEntry {
     halide_buffer_t *buf;
 
     bool init(const uint8_t *cache_key, size_t cache_key_size,
-              uint32_t key_hash,
+              uint64_t key_hash,
               const halide_buffer_t *computed_bounds_buf,
               int32_t tuples, halide_buffer_t **tuple_buffers);
     void destroy();
@@ -92,7 +301,10 @@ struct CacheEntry {
 
 struct CacheBlockHeader {
     CacheEntry *entry;
-    uint32_t hash;
+    uint64_t hash;
+    // When the cache miss that allocated this block happened. Used to
+    // measure how long the entry took to compute.
+    int64_t miss_time;
 };
 
 // Each host block has extra space to store a header just before the
@@ -111,15 +323,19 @@ WEAK CacheBlockHeader *get_pointer_to_header(uint8_t * host) {
 }
 
 WEAK bool CacheEntry::init(const uint8_t *cache_key, size_t cache_key_size,
-                           uint32_t key_hash, const halide_buffer_t *computed_bounds_buf,
+                           uint64_t key_hash, const halide_buffer_t *computed_bounds_buf,
                            int32_t tuples, halide_buffer_t **tuple_buffers) {
     next = NULL;
-    more_recent = NULL;
-    less_recent = NULL;
     key_size = cache_key_size;
     hash = key_hash;
     in_use_count = 0;
     tuple_count = tuples;
+    size = 0;
+    use_count = 0;
+    heap_index = -1;
+    weight = 0;
+    value = 0;
+    stats = NULL;
     dimensions = computed_bounds_buf->dimensions;
 
     // Allocate all the necessary space (or die)
@@ -165,6 +381,7 @@ WEAK bool CacheEntry::init(const uint8_t *cache_key, size_t cache_key_size,
         for (int j = 0; j < dimensions; j++) {
             buf[i].dim[j] = tuple_buffers[i]->dim[j];
         }
+        size += buf[i].size_in_bytes();
     }
     return true;
 }
@@ -177,68 +394,317 @@ WEAK void CacheEntry::destroy() {
     halide_free(NULL, metadata_storage);
 }
 
-WEAK uint32_t djb_hash(const uint8_t *key, size_t key_size)  {
-    uint32_t h = 5381;
-    for (size_t i = 0; i < key_size; i++) {
-      h = (h << 5) + h + key[i];
-    }
+__attribute__((always_inline)) uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+__attribute__((always_inline)) uint64_t hash_mix64(uint64_t h) {
+    // The murmur3 64-bit finalizer.
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
     return h;
 }
 
-WEAK halide_mutex memoization_lock;
+// Hash a cache key. Keys are processed 32 bytes at a time in four
+// independent 64-bit lanes so that the main loop has no serial
+// dependence between words and can be vectorized, then the lanes
+// and any tail bytes are folded together and finalized. Much better
+// distributed than the old byte-at-a-time djb hash, which mattered
+// once the bucket index and shard are both taken from the hash.
+WEAK uint64_t cache_key_hash(const uint8_t *key, size_t key_size) {
+    const uint64_t k1 = 0x9e3779b185ebca87ULL;
+    const uint64_t k2 = 0xc2b2ae3d27d4eb4fULL;
+    uint64_t lanes[4] = {k1, k2, k1 ^ k2, k1 + k2};
+    size_t i = 0;
+    for (; i + 32 <= key_size; i += 32) {
+        for (int l = 0; l < 4; l++) {
+            uint64_t w;
+            memcpy(&w, key + i + l * 8, 8);
+            lanes[l] = rotl64(lanes[l] + w * k2, 31) * k1;
+        }
+    }
+    uint64_t h = (uint64_t)key_size * k1;
+    for (int l = 0; l < 4; l++) {
+        h = (h ^ hash_mix64(lanes[l])) * k2;
+    }
+    for (; i + 8 <= key_size; i += 8) {
+        uint64_t w;
+        memcpy(&w, key + i, 8);
+        h = rotl64(h ^ (w * k2), 27) * k1;
+    }
+    uint64_t tail = 0;
+    for (int shift = 0; i < key_size; i++, shift += 8) {
+        tail |= (uint64_t)key[i] << shift;
+    }
+    h = rotl64(h ^ (tail * k1), 23) * k2;
+    return hash_mix64(h);
+}
+
+// The cache is split into independently locked shards, chosen by the
+// top bits of the key hash. Each shard has its own hash table, which
+// starts small and doubles as entries are added.
+//
+// Eviction uses GreedyDual-Size-Frequency. Each entry has a value of
+// L + uses * cost * 2^priority / size, where cost is the time it took
+// to compute, priority is the hint given to Func::memoize, and L is a
+// global inflation value that is raised to the value of each entry
+// evicted. Entries that are expensive to recompute, small, or often
+// used survive longest, while L makes entries that are never used
+// again eventually go too. Each shard keeps the entries not currently
+// in use in a min-heap on value. There is one global size budget;
+// when it's exceeded, the lowest valued entry across all shards is
+// evicted.
+#define CACHE_NUM_SHARDS_LOG2 4
+#define CACHE_NUM_SHARDS (1 << CACHE_NUM_SHARDS_LOG2)
+#define CACHE_INITIAL_BUCKETS 16
+#define CACHE_MAX_EVICTION_PRIORITY 32
+
+struct CacheShard {
+    halide_mutex lock;
+    // A power of two. Zero until the shard is first used.
+    uint32_t num_buckets;
+    uint32_t num_entries;
+    CacheEntry **buckets;
+    // Min-heap on value of the entries that aren't in use. Always has
+    // room for every entry in the shard, so that releasing an entry
+    // can't fail.
+    CacheEntry **heap;
+    uint32_t heap_size;
+    uint32_t heap_capacity;
+    // Used until the table first grows, so that a shard never needs a
+    // heap allocation to become usable.
+    CacheEntry *initial_buckets[CACHE_INITIAL_BUCKETS];
+
+    void ensure_initialized() {
+        if (num_buckets == 0) {
+            num_buckets = CACHE_INITIAL_BUCKETS;
+            buckets = initial_buckets;
+        }
+    }
+
+    CacheEntry **bucket_for(uint64_t h) {
+        ensure_initialized();
+        return &buckets[h & (num_buckets - 1)];
+    }
+};
+
+WEAK CacheShard cache_shards[CACHE_NUM_SHARDS];
+
+WEAK __attribute__((always_inline)) CacheShard *shard_for(uint64_t h) {
+    return &cache_shards[h >> (64 - CACHE_NUM_SHARDS_LOG2)];
+}
 
-const size_t kHashTableSize = 256;
+// The GDSF inflation value L, stored as the bits of a double so it can
+// be accessed atomically from any shard. It only ever increases.
+WEAK uint64_t cache_inflation_bits = 0;
 
-WEAK CacheEntry *cache_entries[kHashTableSize];
+WEAK double cache_inflation() {
+    uint64_t bits = __atomic_load_n(&cache_inflation_bits, __ATOMIC_RELAXED);
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
 
-WEAK CacheEntry *most_recently_used = NULL;
-WEAK CacheEntry *least_recently_used = NULL;
+WEAK void raise_cache_inflation(double d) {
+    uint64_t new_bits;
+    memcpy(&new_bits, &d, sizeof(d));
+    uint64_t old_bits = __atomic_load_n(&cache_inflation_bits, __ATOMIC_RELAXED);
+    double old_d;
+    memcpy(&old_d, &old_bits, sizeof(old_d));
+    while (old_d < d &&
+           !__atomic_compare_exchange_n(&cache_inflation_bits, &old_bits, new_bits,
+                                        true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        memcpy(&old_d, &old_bits, sizeof(old_d));
+    }
+}
 
 const uint64_t kDefaultCacheSize = 1 << 20;
+// Read without any shard lock held, and so accessed atomically.
 WEAK int64_t max_cache_size = kDefaultCacheSize;
+// Summed over all shards, and so updated atomically.
 WEAK int64_t current_cache_size = 0;
 
+// Double the size of a shard's hash table once it's more than fully
+// loaded. Must be called with the shard lock held. If the allocation
+// fails we just carry on with longer chains.
+WEAK void maybe_grow_shard(CacheShard *shard) {
+    if (shard->num_entries <= shard->num_buckets) {
+        return;
+    }
+    uint32_t new_num_buckets = shard->num_buckets * 2;
+    CacheEntry **new_buckets =
+        (CacheEntry **)halide_malloc(NULL, new_num_buckets * sizeof(CacheEntry *));
+    if (!new_buckets) {
+        return;
+    }
+    memset(new_buckets, 0, new_num_buckets * sizeof(CacheEntry *));
+    for (uint32_t i = 0; i < shard->num_buckets; i++) {
+        CacheEntry *entry = shard->buckets[i];
+        while (entry != NULL) {
+            CacheEntry *next = entry->next;
+            CacheEntry **bucket = &new_buckets[entry->hash & (new_num_buckets - 1)];
+            entry->next = *bucket;
+            *bucket = entry;
+            entry = next;
+        }
+    }
+    if (shard->buckets != shard->initial_buckets) {
+        halide_free(NULL, shard->buckets);
+    }
+    shard->buckets = new_buckets;
+    shard->num_buckets = new_num_buckets;
+}
+
+// Make sure the eviction heap can hold n entries. Must be called with
+// the shard lock held.
+WEAK bool reserve_heap(CacheShard *shard, uint32_t n) {
+    if (n <= shard->heap_capacity) {
+        return true;
+    }
+    uint32_t new_capacity = shard->heap_capacity ? shard->heap_capacity * 2 : CACHE_INITIAL_BUCKETS;
+    while (new_capacity < n) {
+        new_capacity *= 2;
+    }
+    CacheEntry **new_heap = (CacheEntry **)halide_malloc(NULL, new_capacity * sizeof(CacheEntry *));
+    if (!new_heap) {
+        return false;
+    }
+    if (shard->heap) {
+        memcpy(new_heap, shard->heap, shard->heap_size * sizeof(CacheEntry *));
+        halide_free(NULL, shard->heap);
+    }
+    shard->heap = new_heap;
+    shard->heap_capacity = new_capacity;
+    return true;
+}
+
+WEAK void heap_place(CacheShard *shard, CacheEntry *entry, uint32_t i) {
+    shard->heap[i] = entry;
+    entry->heap_index = (int32_t)i;
+}
+
+WEAK void heap_sift_up(CacheShard *shard, uint32_t i) {
+    CacheEntry *entry = shard->heap[i];
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (shard->heap[parent]->value <= entry->value) {
+            break;
+        }
+        heap_place(shard, shard->heap[parent], i);
+        i = parent;
+    }
+    heap_place(shard, entry, i);
+}
+
+WEAK void heap_sift_down(CacheShard *shard, uint32_t i) {
+    CacheEntry *entry = shard->heap[i];
+    while (true) {
+        uint32_t child = 2 * i + 1;
+        if (child >= shard->heap_size) {
+            break;
+        }
+        if (child + 1 < shard->heap_size &&
+            shard->heap[child + 1]->value < shard->heap[child]->value) {
+            child++;
+        }
+        if (entry->value <= shard->heap[child]->value) {
+            break;
+        }
+        heap_place(shard, shard->heap[child], i);
+        i = child;
+    }
+    heap_place(shard, entry, i);
+}
+
+// Make an entry evictable. Must be called with the shard lock held.
+WEAK void heap_insert(CacheShard *shard, CacheEntry *entry) {
+    halide_assert(NULL, shard->heap_size < shard->heap_capacity);
+    uint32_t i = shard->heap_size++;
+    heap_place(shard, entry, i);
+    heap_sift_up(shard, i);
+}
+
+// Make an entry unevictable. Must be called with the shard lock held.
+WEAK void heap_remove(CacheShard *shard, CacheEntry *entry) {
+    halide_assert(NULL, entry->heap_index >= 0);
+    uint32_t i = (uint32_t)entry->heap_index;
+    entry->heap_index = -1;
+    shard->heap_size--;
+    if (i == shard->heap_size) {
+        return;
+    }
+    CacheEntry *last = shard->heap[shard->heap_size];
+    heap_place(shard, last, i);
+    heap_sift_up(shard, i);
+    heap_sift_down(shard, (uint32_t)last->heap_index);
+}
+
+// Compute the weight of a freshly stored entry.
+WEAK double entry_weight(int64_t cost_ns, int32_t eviction_priority, uint64_t size) {
+    if (eviction_priority > CACHE_MAX_EVICTION_PRIORITY) {
+        eviction_priority = CACHE_MAX_EVICTION_PRIORITY;
+    } else if (eviction_priority < -CACHE_MAX_EVICTION_PRIORITY) {
+        eviction_priority = -CACHE_MAX_EVICTION_PRIORITY;
+    }
+    double w = cost_ns > 0 ? (double)cost_ns : 1.0;
+    for (int32_t i = 0; i < eviction_priority; i++) {
+        w *= 2;
+    }
+    for (int32_t i = 0; i > eviction_priority; i--) {
+        w *= 0.5;
+    }
+    return w / (double)(size > 0 ? size : 1);
+}
+
+// Record a use of an entry by updating its value. The caller is about
+// to mark it as in use, so it must not be in the heap.
+WEAK void touch_entry(CacheEntry *entry) {
+    entry->use_count++;
+    entry->value = cache_inflation() + entry->use_count * entry->weight;
+}
+
 #if CACHE_DEBUGGING
-WEAK void validate_cache() {
-    print(NULL) << "validating cache, "
-                << "current size " << current_cache_size
-                << " of maximum " << max_cache_size << "\n";
-    int entries_in_hash_table = 0;
-    for (size_t i = 0; i < kHashTableSize; i++) {
-        CacheEntry *entry = cache_entries[i];
+WEAK void validate_shard(CacheShard *shard) {
+    if (shard->num_buckets == 0) {
+        return;
+    }
+    uint32_t entries_in_hash_table = 0;
+    uint32_t entries_not_in_use = 0;
+    for (uint32_t i = 0; i < shard->num_buckets; i++) {
+        CacheEntry *entry = shard->buckets[i];
         while (entry != NULL) {
             entries_in_hash_table++;
-            if (entry->more_recent == NULL && entry != most_recently_used) {
-                halide_print(NULL, "cache invalid case 1\n");
+            if (shard_for(entry->hash) != shard) {
+                halide_print(NULL, "cache invalid case 0\n");
                 __builtin_trap();
             }
-            if (entry->less_recent == NULL && entry != least_recently_used) {
-                halide_print(NULL, "cache invalid case 2\n");
+            if ((entry->in_use_count == 0) != (entry->heap_index >= 0)) {
+                halide_print(NULL, "cache invalid case 1\n");
                 __builtin_trap();
             }
+            if (entry->in_use_count == 0) {
+                entries_not_in_use++;
+                if (shard->heap[entry->heap_index] != entry) {
+                    halide_print(NULL, "cache invalid case 2\n");
+                    __builtin_trap();
+                }
+            }
             entry = entry->next;
         }
     }
-    int entries_from_mru = 0;
-    CacheEntry *mru_chain = most_recently_used;
-    while (mru_chain != NULL) {
-        entries_from_mru++;
-        mru_chain = mru_chain->less_recent;
-    }
-    int entries_from_lru = 0;
-    CacheEntry *lru_chain = least_recently_used;
-    while (lru_chain != NULL) {
-        entries_from_lru++;
-        lru_chain = lru_chain->more_recent;
-    }
-    print(NULL) << "hash entries " << entries_in_hash_table
-                << ", mru entries " << entries_from_mru
-                << ", lru entries " << entries_from_lru << "\n";
-    if (entries_in_hash_table != entries_from_mru) {
-        halide_print(NULL, "cache invalid case 3\n");
-        __builtin_trap();
+    for (uint32_t i = 1; i < shard->heap_size; i++) {
+        if (shard->heap[(i - 1) / 2]->value > shard->heap[i]->value) {
+            halide_print(NULL, "cache invalid case 3\n");
+            __builtin_trap();
+        }
     }
-    if (entries_in_hash_table != entries_from_lru) {
+    print(NULL) << "shard hash entries " << entries_in_hash_table
+                << ", evictable entries " << shard->heap_size << "\n";
+    if (entries_in_hash_table != shard->num_entries ||
+        entries_not_in_use != shard->heap_size) {
         halide_print(NULL, "cache invalid case 4\n");
         __builtin_trap();
     }
@@ -249,62 +715,876 @@ WEAK void validate_cache() {
 }
 #endif
 
-WEAK void prune_cache() {
+// Unlink an evictable entry from its shard and free it. Must be
+// called with the shard lock held.
+WEAK void evict_entry(CacheShard *shard, CacheEntry *entry) {
+    heap_remove(shard, entry);
+    raise_cache_inflation(entry->value);
+
+    // Remove from hash table
+    CacheEntry **prev_hash_entry = shard->bucket_for(entry->hash);
+    while (*prev_hash_entry != NULL && *prev_hash_entry != entry) {
+        prev_hash_entry = &(*prev_hash_entry)->next;
+    }
+    halide_assert(NULL, *prev_hash_entry != NULL);
+    *prev_hash_entry = entry->next;
+    shard->num_entries--;
+
+    // Decrease cache used amount.
+    __sync_sub_and_fetch(&current_cache_size, (int64_t)entry->size);
+    CACHE_STAT_ADD(entry->stats, bytes, -(int64_t)entry->size);
+    CACHE_STAT_ADD(entry->stats, evictions, 1);
+
+    // Deallocate the entry.
+    entry->destroy();
+    halide_free(NULL, entry);
+}
+
+// Find the lowest valued evictable entry in a shard, optionally only
+// from one pipeline, and optionally including entries protected by
+// their pipeline's quota. Must be called with the shard lock held.
+WEAK CacheEntry *find_victim(CacheShard *shard, PipelineStats *only, bool allow_protected) {
+    if (shard->heap_size == 0) {
+        return NULL;
+    }
+    if (!only && (allow_protected || !entry_protected(shard->heap[0]->stats))) {
+        // The common case.
+        return shard->heap[0];
+    }
+    CacheEntry *best = NULL;
+    for (uint32_t i = 0; i < shard->heap_size; i++) {
+        CacheEntry *entry = shard->heap[i];
+        bool eligible = only ? (entry->stats && entry->stats->pipeline == only)
+                             : !entry_protected(entry->stats);
+        if (eligible && (!best || entry->value < best->value)) {
+            best = entry;
+        }
+    }
+    return best;
+}
+
+// Evict the lowest valued entry across all shards that matches the
+// criteria of find_victim. Returns false if there are none. Must be
+// called with no shard lock held. Shards are only ever locked one at
+// a time, so this can't deadlock with concurrent lookups.
+WEAK bool evict_lowest(PipelineStats *only, bool allow_protected) {
+    int best_shard = -1;
+    double best_value = 0;
+    for (int i = 0; i < CACHE_NUM_SHARDS; i++) {
+        CacheShard *shard = &cache_shards[i];
+        ScopedMutexLock lock(&shard->lock);
+        CacheEntry *victim = find_victim(shard, only, allow_protected);
+        if (victim && (best_shard < 0 || victim->value < best_value)) {
+            best_shard = i;
+            best_value = victim->value;
+        }
+    }
+    if (best_shard < 0) {
+        return false;
+    }
+
+    CacheShard *shard = &cache_shards[best_shard];
+    ScopedMutexLock lock(&shard->lock);
+    // The shard may have changed since we looked, but evicting its
+    // current best victim is still a fine choice.
+    CacheEntry *victim = find_victim(shard, only, allow_protected);
+    if (victim) {
+        evict_entry(shard, victim);
+    }
 #if CACHE_DEBUGGING
-    validate_cache();
+    validate_shard(shard);
 #endif
-    CacheEntry *prune_candidate = least_recently_used;
-    while (current_cache_size > max_cache_size &&
-           prune_candidate != NULL) {
-        CacheEntry *more_recent = prune_candidate->more_recent;
-
-        if (prune_candidate->in_use_count == 0) {
-            uint32_t h = prune_candidate->hash;
-            uint32_t index = h % kHashTableSize;
-
-            // Remove from hash table
-            CacheEntry *prev_hash_entry = cache_entries[index];
-            if (prev_hash_entry == prune_candidate) {
-                cache_entries[index] = prune_candidate->next;
-            } else {
-                while (prev_hash_entry != NULL && prev_hash_entry->next != prune_candidate) {
-                    prev_hash_entry = prev_hash_entry->next;
-                }
-                halide_assert(NULL, prev_hash_entry != NULL);
-                prev_hash_entry->next = prune_candidate->next;
+    return true;
+}
+
+// Evict entries of a pipeline until it is back within its quota.
+WEAK void prune_pipeline(PipelineStats *p) {
+    while (p && p->quota > 0 &&
+           __atomic_load_n(&p->stats.bytes, __ATOMIC_RELAXED) > p->quota) {
+        if (!evict_lowest(p, true)) {
+            // Everything left is in use.
+            return;
+        }
+    }
+}
+
+// Evict entries until the cache is back within its budget. Entries of
+// pipelines within their quota are only evicted if nothing else can
+// be. Must be called with no shard lock held.
+WEAK void prune_cache() {
+    while (__atomic_load_n(&current_cache_size, __ATOMIC_RELAXED) >
+           __atomic_load_n(&max_cache_size, __ATOMIC_RELAXED)) {
+        if (!evict_lowest(NULL, false) && !evict_lowest(NULL, true)) {
+            // Everything left is in use.
+            return;
+        }
+    }
+}
+
+WEAK CacheEntry *find_entry(CacheShard *shard, uint64_t h, const uint8_t *cache_key, int32_t size,
+                            const halide_buffer_t *computed_bounds, int32_t tuple_count,
+                            halide_buffer_t **tuple_buffers) {
+    CacheEntry *entry = *shard->bucket_for(h);
+    while (entry != NULL) {
+        if (entry->hash == h && entry->key_size == (size_t)size &&
+            keys_equal(entry->key, cache_key, size) &&
+            buffer_has_shape(computed_bounds, entry->computed_bounds) &&
+            entry->tuple_count == (uint32_t)tuple_count) {
+
+            // Check all the tuple buffers have the same bounds (they should).
+            bool all_bounds_equal = true;
+            for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
+                all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
             }
 
-            // Remove from less recent chain.
-            if (least_recently_used == prune_candidate) {
-                least_recently_used = more_recent;
+            if (all_bounds_equal) {
+                return entry;
+            }
+        }
+        entry = entry->next;
+    }
+    return NULL;
+}
+
+// Add a freshly computed (or loaded) result to the cache, marked as in
+// use by the caller. Must be called with the shard lock held. Returns
+// false and leaves the buffers owned by the caller if the same result
+// is already cached or we run out of memory.
+WEAK bool insert_entry(void *user_context, CacheShard *shard, uint64_t h,
+                       const uint8_t *cache_key, int32_t size,
+                       const halide_buffer_t *computed_bounds,
+                       int32_t tuple_count, halide_buffer_t **tuple_buffers,
+                       int64_t cost, int32_t eviction_priority, FuncStats *stats) {
+    // Mark the buffers as having no cache entry, so that
+    // halide_memoization_cache_release frees them if we bail out.
+    for (int32_t i = 0; i < tuple_count; i++) {
+        get_pointer_to_header(tuple_buffers[i]->host)->entry = NULL;
+    }
+
+    CacheEntry *entry = find_entry(shard, h, cache_key, size, computed_bounds,
+                                   tuple_count, tuple_buffers);
+    if (entry != NULL) {
+        // Someone else stored the same result while we were
+        // computing ours.
+        for (int32_t i = 0; i < tuple_count; i++) {
+            halide_assert(user_context, entry->buf[i].host != tuple_buffers[i]->host);
+        }
+        return false;
+    }
+
+    CacheEntry *new_entry = (CacheEntry *)halide_malloc(NULL, sizeof(CacheEntry));
+    bool inited = false;
+    if (new_entry) {
+        inited = (reserve_heap(shard, shard->num_entries + 1) &&
+                  new_entry->init(cache_key, size, h, computed_bounds, tuple_count, tuple_buffers));
+    }
+    if (!inited) {
+        if (new_entry) {
+            halide_free(user_context, new_entry);
+        }
+        return false;
+    }
+
+    CacheEntry **bucket = shard->bucket_for(h);
+    new_entry->next = *bucket;
+    *bucket = new_entry;
+    shard->num_entries++;
+    new_entry->weight = entry_weight(cost, eviction_priority, new_entry->size);
+    new_entry->stats = stats;
+    touch_entry(new_entry);
+
+    // The caller holds it until it calls release, so it isn't
+    // evictable yet.
+    new_entry->in_use_count = tuple_count;
+
+    for (int32_t i = 0; i < tuple_count; i++) {
+        get_pointer_to_header(tuple_buffers[i]->host)->entry = new_entry;
+    }
+    __sync_add_and_fetch(&current_cache_size, (int64_t)new_entry->size);
+    CACHE_STAT_ADD(stats, bytes, (int64_t)new_entry->size);
+
+    maybe_grow_shard(shard);
+
+#if CACHE_DEBUGGING
+    validate_shard(shard);
+#endif
+    return true;
+}
+
+// The optional on-disk tier. Every result stored in the cache is also
+// written to its own file in a directory, named by a hash of the
+// pipeline hash, the stable part of the key and the computed bounds,
+// so that a restarted process can reload it on a miss instead of
+// recomputing it. The tier is off unless a directory is set with
+// halide_memoization_cache_set_disk_path or HL_MEMOIZATION_CACHE_DIR.
+#define CACHE_DISK_PATH_MAX 1024
+#define CACHE_DISK_MAGIC 0x434d4c48 // "HLMC"
+#define CACHE_DISK_VERSION 1
+
+WEAK halide_mutex cache_disk_lock;
+WEAK bool cache_disk_path_inited = false;
+WEAK char cache_disk_path[CACHE_DISK_PATH_MAX];
+
+struct CacheDiskHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t pipeline_hash;
+    uint32_t key_size;
+    int32_t dimensions;
+    int32_t tuple_count;
+    int32_t eviction_priority;
+    int64_t cost;
+    // Followed by the stable part of the key, the computed bounds,
+    // and then for each tuple element its type, its allocated shape,
+    // its size in bytes as a uint64_t, and its contents.
+};
+
+// The cache key starts with a pointer and a counter identifying the
+// Func within this process. Only the rest of it is meaningful across
+// processes.
+WEAK __attribute__((always_inline)) size_t stable_key_offset() {
+    return sizeof(void *) + sizeof(int32_t);
+}
+
+// Returns the directory of the disk tier, or NULL if it's disabled.
+WEAK const char *get_cache_disk_path() {
+    ScopedMutexLock lock(&cache_disk_lock);
+    if (!cache_disk_path_inited) {
+        const char *dir = getenv("HL_MEMOIZATION_CACHE_DIR");
+        cache_disk_path[0] = 0;
+        if (dir) {
+            strncpy(cache_disk_path, dir, CACHE_DISK_PATH_MAX - 1);
+            cache_disk_path[CACHE_DISK_PATH_MAX - 1] = 0;
+        }
+        cache_disk_path_inited = true;
+    }
+    return cache_disk_path[0] ? cache_disk_path : NULL;
+}
+
+// A hash of a result that's the same in every process: of the
+// pipeline hash, the stable part of the key and the computed bounds.
+WEAK uint64_t stable_result_hash(uint64_t pipeline_hash, const uint8_t *cache_key, int32_t size,
+                                 const halide_buffer_t *computed_bounds) {
+    uint64_t h = hash_mix64(pipeline_hash);
+    if ((size_t)size > stable_key_offset()) {
+        h ^= cache_key_hash(cache_key + stable_key_offset(), size - stable_key_offset());
+    }
+    return hash_mix64(h) ^ cache_key_hash((const uint8_t *)computed_bounds->dim,
+                                          computed_bounds->dimensions * sizeof(halide_dimension_t));
+}
+
+// Write the file name for a result into buf. Returns false if it
+// doesn't fit.
+WEAK bool cache_disk_file_name(char *buf, size_t buf_size, const char *dir, uint64_t pipeline_hash,
+                               const uint8_t *cache_key, int32_t size,
+                               const halide_buffer_t *computed_bounds) {
+    uint64_t h = stable_result_hash(pipeline_hash, cache_key, size, computed_bounds);
+    char *end = buf + buf_size;
+    char *dst = halide_string_to_string(buf, end, dir);
+    dst = halide_string_to_string(dst, end, "/");
+    for (int i = 60; i >= 0; i -= 4) {
+        char str[2] = {to_hex_char((int)(h >> i) & 0xf), 0};
+        dst = halide_string_to_string(dst, end, str);
+    }
+    dst = halide_string_to_string(dst, end, ".hmc");
+    return dst < end - 1;
+}
+
+WEAK bool read_exactly(void *f, void *dst, size_t bytes) {
+    return fread(dst, 1, bytes, f) == bytes;
+}
+
+WEAK bool write_exactly(void *f, const void *src, size_t bytes) {
+    return fwrite(src, 1, bytes, f) == bytes;
+}
+
+// Try to fill the freshly allocated tuple buffers from the disk
+// tier. On success, returns true and sets the recorded compute cost
+// and eviction priority of the result.
+WEAK bool load_from_disk(void *user_context, uint64_t pipeline_hash,
+                         const uint8_t *cache_key, int32_t size,
+                         const halide_buffer_t *computed_bounds,
+                         int32_t tuple_count, halide_buffer_t **tuple_buffers,
+                         int64_t *cost, int32_t *eviction_priority) {
+    const char *dir = get_cache_disk_path();
+    if (!dir || pipeline_hash == 0 || (size_t)size < stable_key_offset()) {
+        return false;
+    }
+    char path[CACHE_DISK_PATH_MAX + 32];
+    if (!cache_disk_file_name(path, sizeof(path), dir, pipeline_hash, cache_key, size, computed_bounds)) {
+        return false;
+    }
+    void *f = fopen(path, "rb");
+    if (!f) {
+        return false;
+    }
+
+    bool ok = false;
+    const uint32_t stable_size = size - stable_key_offset();
+    CacheDiskHeader header;
+    if (read_exactly(f, &header, sizeof(header)) &&
+        header.magic == CACHE_DISK_MAGIC &&
+        header.version == CACHE_DISK_VERSION &&
+        header.pipeline_hash == pipeline_hash &&
+        header.key_size == stable_size &&
+        header.dimensions == computed_bounds->dimensions &&
+        header.tuple_count == tuple_count) {
+        ok = true;
+        // Check the key and computed bounds a chunk at a time, to guard
+        // against hash collisions.
+        uint8_t chunk[256];
+        for (uint32_t done = 0; ok && done < stable_size; done += sizeof(chunk)) {
+            uint32_t n = stable_size - done < sizeof(chunk) ? stable_size - done : sizeof(chunk);
+            ok = (read_exactly(f, chunk, n) &&
+                  keys_equal(chunk, cache_key + stable_key_offset() + done, n));
+        }
+        halide_dimension_t dim;
+        for (int32_t d = 0; ok && d < header.dimensions; d++) {
+            ok = read_exactly(f, &dim, sizeof(dim)) && dim == computed_bounds->dim[d];
+        }
+        for (int32_t i = 0; ok && i < tuple_count; i++) {
+            halide_buffer_t *buf = tuple_buffers[i];
+            halide_type_t type;
+            uint64_t bytes = 0;
+            ok = read_exactly(f, &type, sizeof(type)) && type == buf->type;
+            for (int32_t d = 0; ok && d < header.dimensions; d++) {
+                ok = read_exactly(f, &dim, sizeof(dim)) && dim == buf->dim[d];
             }
-            if (more_recent != NULL) {
-                more_recent->less_recent = prune_candidate->less_recent;
+            ok = (ok &&
+                  read_exactly(f, &bytes, sizeof(bytes)) &&
+                  bytes == buf->size_in_bytes() &&
+                  read_exactly(f, buf->host, bytes));
+        }
+    }
+    fclose(f);
+
+    if (ok) {
+        *cost = header.cost;
+        *eviction_priority = header.eviction_priority;
+        debug(user_context) << "Loaded memoized result from " << path << "\n";
+    }
+    return ok;
+}
+
+// Write a result to the disk tier. It's written under a temporary name
+// and then renamed into place, so other processes never see a partial
+// file. Failures just mean the result isn't persisted.
+WEAK void store_to_disk(void *user_context, uint64_t pipeline_hash,
+                        const uint8_t *cache_key, int32_t size,
+                        const halide_buffer_t *computed_bounds,
+                        int32_t tuple_count, halide_buffer_t **tuple_buffers,
+                        int64_t cost, int32_t eviction_priority) {
+    const char *dir = get_cache_disk_path();
+    if (!dir || pipeline_hash == 0 || (size_t)size < stable_key_offset()) {
+        return;
+    }
+    for (int32_t i = 0; i < tuple_count; i++) {
+        // The host copy isn't current, so there's nothing we can write.
+        if (tuple_buffers[i]->device_dirty()) {
+            return;
+        }
+    }
+    char path[CACHE_DISK_PATH_MAX + 32];
+    if (!cache_disk_file_name(path, sizeof(path), dir, pipeline_hash, cache_key, size, computed_bounds)) {
+        return;
+    }
+    char tmp_path[CACHE_DISK_PATH_MAX + 64];
+    char *end = tmp_path + sizeof(tmp_path);
+    char *dst = halide_string_to_string(tmp_path, end, path);
+    dst = halide_string_to_string(dst, end, ".");
+    // Something unique to this store to keep concurrent writers apart.
+    dst = halide_uint64_to_string(dst, end, (uint64_t)tuple_buffers[0]->host ^ (uint64_t)halide_current_time_ns(user_context), 1);
+    dst = halide_string_to_string(dst, end, ".tmp");
+    if (dst >= end - 1) {
+        return;
+    }
+
+    void *f = fopen(tmp_path, "wb");
+    if (!f) {
+        return;
+    }
+    CacheDiskHeader header;
+    header.magic = CACHE_DISK_MAGIC;
+    header.version = CACHE_DISK_VERSION;
+    header.pipeline_hash = pipeline_hash;
+    header.key_size = size - stable_key_offset();
+    header.dimensions = computed_bounds->dimensions;
+    header.tuple_count = tuple_count;
+    header.eviction_priority = eviction_priority;
+    header.cost = cost;
+    bool ok = (write_exactly(f, &header, sizeof(header)) &&
+               write_exactly(f, cache_key + stable_key_offset(), header.key_size) &&
+               write_exactly(f, computed_bounds->dim, header.dimensions * sizeof(halide_dimension_t)));
+    for (int32_t i = 0; ok && i < tuple_count; i++) {
+        const halide_buffer_t *buf = tuple_buffers[i];
+        uint64_t bytes = buf->size_in_bytes();
+        ok = (write_exactly(f, &buf->type, sizeof(buf->type)) &&
+              write_exactly(f, buf->dim, header.dimensions * sizeof(halide_dimension_t)) &&
+              write_exactly(f, &bytes, sizeof(bytes)) &&
+              write_exactly(f, buf->host, bytes));
+    }
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp_path, path) != 0) {
+        remove(tmp_path);
+    }
+}
+
+// The optional shared tier. Results are stored in a named shared
+// memory segment that every process on the host using the same name
+// maps, so that they share hits and hold each result only once. When
+// the tier is on, a lookup that misses in this process's cache but
+// hits in the segment returns buffers pointing straight into it, and
+// stored results go into the segment instead of this process's
+// cache. Entries are refcounted by the buffers returned from lookups,
+// and when the segment is full the unreferenced entry with the lowest
+// GreedyDual-Size-Frequency value is evicted, as in the in-process
+// cache. Everything in the segment refers to everything else by its
+// offset from the start, as each process maps it at a different
+// address. The segment lock is dropped by the OS if the process
+// holding it dies, but results that a dead process was using stay
+// pinned until the segment is deleted. Only host memory is shared.
+// The tier is off unless a segment is named with
+// halide_memoization_cache_set_shared_memory or HL_MEMOIZATION_CACHE_SHM.
+#define CACHE_SHARED_MAGIC 0x534d4c48 // "HLMS"
+#define CACHE_SHARED_VERSION 1
+#define CACHE_SHARED_BUCKETS 4096
+// Blocks in the segment are aligned to at least halide_malloc's
+// alignment on every target. Each starts with a header padded to this.
+#define CACHE_SHARED_ALIGNMENT 128
+
+struct SharedCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;
+    // The GDSF inflation value of the segment.
+    double inflation;
+    // The first free block. The free list is kept in order of offset
+    // so that neighbors can be merged.
+    uint64_t free_list;
+    uint64_t buckets[CACHE_SHARED_BUCKETS];
+};
+
+struct SharedCacheBlock {
+    // Including the header.
+    uint64_t size;
+    uint64_t next_free;
+};
+
+struct SharedCacheEntry {
+    uint64_t next;
+    uint64_t hash;
+    uint64_t pipeline_hash;
+    // Total bytes of all the tuple elements.
+    uint64_t bytes;
+    double weight;
+    double value;
+    uint32_t use_count;
+    // The number of buffers returned by lookups, in any process, that
+    // haven't been released. The entry can't be evicted until it's 0.
+    uint32_t ref_count;
+    uint32_t key_size;
+    int32_t dimensions;
+    int32_t tuple_count;
+    int32_t padding;
+    // Followed by the computed bounds, the tuple records, the
+    // allocated shape of each tuple element, and the stable part of
+    // the key. Each element's contents are later in the same block,
+    // just after the offset of this entry.
+};
+
+struct SharedCacheTuple {
+    halide_type_t type;
+    uint32_t padding;
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+WEAK halide_mutex cache_shared_lock;
+WEAK bool cache_shared_inited = false;
+WEAK int cache_shared_handle = -1;
+WEAK size_t cache_shared_size = 0;
+WEAK SharedCacheHeader *cache_shared_segment = NULL;
+
+WEAK __attribute__((always_inline)) uint64_t shared_align_up(uint64_t x) {
+    return (x + CACHE_SHARED_ALIGNMENT - 1) & ~(uint64_t)(CACHE_SHARED_ALIGNMENT - 1);
+}
+
+WEAK __attribute__((always_inline)) uint8_t *shared_ptr(SharedCacheHeader *segment, uint64_t offset) {
+    return (uint8_t *)segment + offset;
+}
+
+WEAK __attribute__((always_inline)) uint64_t shared_offset(SharedCacheHeader *segment, const void *ptr) {
+    return (uint64_t)((const uint8_t *)ptr - (uint8_t *)segment);
+}
+
+WEAK __attribute__((always_inline)) SharedCacheBlock *shared_block(SharedCacheHeader *segment, uint64_t offset) {
+    return (SharedCacheBlock *)shared_ptr(segment, offset);
+}
+
+WEAK halide_dimension_t *shared_entry_bounds(SharedCacheEntry *entry) {
+    return (halide_dimension_t *)(entry + 1);
+}
+
+WEAK SharedCacheTuple *shared_entry_tuples(SharedCacheEntry *entry) {
+    return (SharedCacheTuple *)(shared_entry_bounds(entry) + entry->dimensions);
+}
+
+WEAK halide_dimension_t *shared_entry_shape(SharedCacheEntry *entry, int32_t i) {
+    halide_dimension_t *shapes = (halide_dimension_t *)(shared_entry_tuples(entry) + entry->tuple_count);
+    return shapes + i * entry->dimensions;
+}
+
+WEAK uint8_t *shared_entry_key(SharedCacheEntry *entry) {
+    return (uint8_t *)shared_entry_shape(entry, entry->tuple_count);
+}
+
+WEAK size_t shared_entry_metadata_bytes(int32_t dimensions, int32_t tuple_count, uint32_t key_size) {
+    return (sizeof(SharedCacheEntry) +
+            sizeof(halide_dimension_t) * dimensions * (tuple_count + 1) +
+            sizeof(SharedCacheTuple) * tuple_count +
+            key_size);
+}
+
+// Unmap the segment. Must be called with cache_shared_lock held.
+WEAK void detach_shared_segment_already_locked() {
+    if (cache_shared_handle >= 0) {
+        halide_shared_memory_close(cache_shared_handle, cache_shared_segment, cache_shared_size);
+    }
+    __atomic_store_n(&cache_shared_segment, (SharedCacheHeader *)NULL, __ATOMIC_RELEASE);
+    cache_shared_handle = -1;
+    cache_shared_size = 0;
+}
+
+// Map a segment, setting it up if we're the first to. Must be called
+// with cache_shared_lock held.
+WEAK bool attach_shared_segment_already_locked(const char *name, size_t size) {
+    int handle = halide_shared_memory_open(name);
+    if (handle < 0) {
+        return false;
+    }
+    SharedCacheHeader *segment = (SharedCacheHeader *)halide_shared_memory_map(handle, &size);
+    if (!segment) {
+        halide_shared_memory_close(handle, NULL, 0);
+        return false;
+    }
+    const uint64_t first_block = shared_align_up(sizeof(SharedCacheHeader));
+    bool ok = true;
+    halide_shared_memory_lock(handle);
+    if (segment->magic == 0) {
+        // A new segment, which is zero filled. Make the space after the
+        // header one big free block.
+        uint64_t usable = (size > first_block) ? ((size - first_block) & ~(uint64_t)(CACHE_SHARED_ALIGNMENT - 1)) : 0;
+        ok = usable >= 2 * CACHE_SHARED_ALIGNMENT;
+        if (ok) {
+            SharedCacheBlock *block = shared_block(segment, first_block);
+            block->size = usable;
+            block->next_free = 0;
+            segment->free_list = first_block;
+            segment->size = size;
+            segment->inflation = 0;
+            segment->version = CACHE_SHARED_VERSION;
+            segment->magic = CACHE_SHARED_MAGIC;
+        }
+    } else {
+        ok = (segment->magic == CACHE_SHARED_MAGIC &&
+              segment->version == CACHE_SHARED_VERSION &&
+              segment->size == size);
+    }
+    halide_shared_memory_unlock(handle);
+    if (!ok) {
+        halide_shared_memory_close(handle, segment, size);
+        return false;
+    }
+    cache_shared_handle = handle;
+    cache_shared_size = size;
+    __atomic_store_n(&cache_shared_segment, segment, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Holds both the in-process and the cross-process lock on the
+// segment, mapping it first if it's named in the environment. segment
+// is NULL if the tier is off.
+struct ScopedSharedCacheLock {
+    SharedCacheHeader *segment;
+
+    __attribute__((always_inline)) ScopedSharedCacheLock() {
+        halide_mutex_lock(&cache_shared_lock);
+        if (!cache_shared_inited) {
+            const char *name = getenv("HL_MEMOIZATION_CACHE_SHM");
+            if (name && *name) {
+                attach_shared_segment_already_locked(name, (size_t)__atomic_load_n(&max_cache_size, __ATOMIC_RELAXED));
             }
+            cache_shared_inited = true;
+        }
+        segment = cache_shared_segment;
+        if (segment) {
+            halide_shared_memory_lock(cache_shared_handle);
+        }
+    }
+
+    __attribute__((always_inline)) ~ScopedSharedCacheLock() {
+        if (segment) {
+            halide_shared_memory_unlock(cache_shared_handle);
+        }
+        halide_mutex_unlock(&cache_shared_lock);
+    }
+};
+
+// Allocate a block of at least the given size from the segment, and
+// return the offset of its contents, or zero if there's no room.
+WEAK uint64_t shared_malloc(SharedCacheHeader *segment, uint64_t bytes) {
+    uint64_t needed = shared_align_up(bytes + CACHE_SHARED_ALIGNMENT);
+    for (uint64_t *link = &segment->free_list; *link; link = &shared_block(segment, *link)->next_free) {
+        uint64_t offset = *link;
+        SharedCacheBlock *block = shared_block(segment, offset);
+        if (block->size < needed) {
+            continue;
+        }
+        if (block->size - needed >= 2 * CACHE_SHARED_ALIGNMENT) {
+            // Split off the rest as a new free block.
+            SharedCacheBlock *rest = shared_block(segment, offset + needed);
+            rest->size = block->size - needed;
+            rest->next_free = block->next_free;
+            block->size = needed;
+            *link = offset + needed;
+        } else {
+            *link = block->next_free;
+        }
+        block->next_free = 0;
+        return offset + CACHE_SHARED_ALIGNMENT;
+    }
+    return 0;
+}
 
-            // Remove from more recent chain.
-            if (most_recently_used == prune_candidate) {
-                most_recently_used = prune_candidate->less_recent;
+WEAK void shared_free(SharedCacheHeader *segment, uint64_t contents) {
+    uint64_t offset = contents - CACHE_SHARED_ALIGNMENT;
+    SharedCacheBlock *block = shared_block(segment, offset);
+    uint64_t prev = 0, next = segment->free_list;
+    while (next && next < offset) {
+        prev = next;
+        next = shared_block(segment, next)->next_free;
+    }
+    block->next_free = next;
+    if (next && offset + block->size == next) {
+        SharedCacheBlock *next_block = shared_block(segment, next);
+        block->size += next_block->size;
+        block->next_free = next_block->next_free;
+    }
+    if (!prev) {
+        segment->free_list = offset;
+    } else {
+        SharedCacheBlock *prev_block = shared_block(segment, prev);
+        if (prev + prev_block->size == offset) {
+            prev_block->size += block->size;
+            prev_block->next_free = block->next_free;
+        } else {
+            prev_block->next_free = offset;
+        }
+    }
+}
+
+WEAK SharedCacheEntry *find_shared_entry(SharedCacheHeader *segment, uint64_t h, uint64_t pipeline_hash,
+                                         const uint8_t *cache_key, int32_t size,
+                                         const halide_buffer_t *computed_bounds,
+                                         int32_t tuple_count, halide_buffer_t **tuple_buffers) {
+    const uint32_t stable_size = size - stable_key_offset();
+    uint64_t offset = segment->buckets[h % CACHE_SHARED_BUCKETS];
+    while (offset) {
+        SharedCacheEntry *entry = (SharedCacheEntry *)shared_ptr(segment, offset);
+        if (entry->hash == h &&
+            entry->pipeline_hash == pipeline_hash &&
+            entry->key_size == stable_size &&
+            entry->dimensions == computed_bounds->dimensions &&
+            entry->tuple_count == tuple_count &&
+            buffer_has_shape(computed_bounds, shared_entry_bounds(entry)) &&
+            keys_equal(shared_entry_key(entry), cache_key + stable_key_offset(), stable_size)) {
+            bool all_match = true;
+            for (int32_t i = 0; all_match && i < tuple_count; i++) {
+                all_match = (shared_entry_tuples(entry)[i].type == tuple_buffers[i]->type &&
+                             buffer_has_shape(tuple_buffers[i], shared_entry_shape(entry, i)));
             }
-            if (prune_candidate->less_recent != NULL) {
-                prune_candidate->less_recent = more_recent;
+            if (all_match) {
+                return entry;
             }
+        }
+        offset = entry->next;
+    }
+    return NULL;
+}
 
-            // Decrease cache used amount.
-            for (uint32_t i = 0; i < prune_candidate->tuple_count; i++) {
-                current_cache_size -= prune_candidate->buf[i].size_in_bytes();
+// Evict the unreferenced entry with the lowest value. Returns false if
+// there are none. Must be called with the segment locked.
+WEAK bool evict_shared_lowest(SharedCacheHeader *segment) {
+    uint64_t *victim_link = NULL;
+    SharedCacheEntry *victim = NULL;
+    for (int b = 0; b < CACHE_SHARED_BUCKETS; b++) {
+        for (uint64_t *link = &segment->buckets[b]; *link; ) {
+            SharedCacheEntry *entry = (SharedCacheEntry *)shared_ptr(segment, *link);
+            if (entry->ref_count == 0 && (!victim || entry->value < victim->value)) {
+                victim = entry;
+                victim_link = link;
             }
+            link = &entry->next;
+        }
+    }
+    if (!victim) {
+        return false;
+    }
+    if (victim->value > segment->inflation) {
+        segment->inflation = victim->value;
+    }
+    *victim_link = victim->next;
+    shared_free(segment, shared_offset(segment, victim));
+    return true;
+}
+
+// Try to satisfy a lookup from the shared tier. On success, the tuple
+// buffers point into the segment, and each must be released.
+WEAK bool lookup_shared(uint64_t pipeline_hash, const uint8_t *cache_key, int32_t size,
+                        const halide_buffer_t *computed_bounds,
+                        int32_t tuple_count, halide_buffer_t **tuple_buffers) {
+    if (pipeline_hash == 0 || (size_t)size < stable_key_offset()) {
+        return false;
+    }
+    uint64_t h = stable_result_hash(pipeline_hash, cache_key, size, computed_bounds);
+    ScopedSharedCacheLock lock;
+    SharedCacheHeader *segment = lock.segment;
+    if (!segment) {
+        return false;
+    }
+    SharedCacheEntry *entry = find_shared_entry(segment, h, pipeline_hash, cache_key, size,
+                                                computed_bounds, tuple_count, tuple_buffers);
+    if (!entry) {
+        return false;
+    }
+    entry->use_count++;
+    entry->value = segment->inflation + entry->use_count * entry->weight;
+    entry->ref_count += tuple_count;
+    for (int32_t i = 0; i < tuple_count; i++) {
+        halide_buffer_t *buf = tuple_buffers[i];
+        buf->host = shared_ptr(segment, shared_entry_tuples(entry)[i].offset);
+        buf->device = 0;
+        buf->device_interface = NULL;
+        buf->flags = 0;
+    }
+    return true;
+}
 
-            // Deallocate the entry.
-            prune_candidate->destroy();
-            halide_free(NULL, prune_candidate);
+// Copy a result into the shared tier. Returns true if the segment now
+// holds it, in which case the caller's copy isn't needed once it's
+// released. The contents are copied without holding the lock.
+WEAK bool store_to_shared(uint64_t pipeline_hash, const uint8_t *cache_key, int32_t size,
+                          const halide_buffer_t *computed_bounds,
+                          int32_t tuple_count, halide_buffer_t **tuple_buffers,
+                          int64_t cost, int32_t eviction_priority) {
+    if (pipeline_hash == 0 || (size_t)size < stable_key_offset()) {
+        return false;
+    }
+    for (int32_t i = 0; i < tuple_count; i++) {
+        if (tuple_buffers[i]->device_dirty()) {
+            return false;
         }
+    }
+    const uint32_t stable_size = size - stable_key_offset();
+    const int32_t dimensions = computed_bounds->dimensions;
+    uint64_t total = shared_entry_metadata_bytes(dimensions, tuple_count, stable_size);
+    uint64_t bytes = 0;
+    for (int32_t i = 0; i < tuple_count; i++) {
+        // Leave room for the entry offset just before the contents.
+        total = shared_align_up(total + sizeof(uint64_t)) + tuple_buffers[i]->size_in_bytes();
+        bytes += tuple_buffers[i]->size_in_bytes();
+    }
+    uint64_t h = stable_result_hash(pipeline_hash, cache_key, size, computed_bounds);
 
-        prune_candidate = more_recent;
+    SharedCacheHeader *segment;
+    SharedCacheEntry *entry;
+    {
+        ScopedSharedCacheLock lock;
+        segment = lock.segment;
+        if (!segment) {
+            return false;
+        }
+        if (find_shared_entry(segment, h, pipeline_hash, cache_key, size,
+                              computed_bounds, tuple_count, tuple_buffers)) {
+            return true;
+        }
+        uint64_t offset = shared_malloc(segment, total);
+        while (!offset && evict_shared_lowest(segment)) {
+            offset = shared_malloc(segment, total);
+        }
+        if (!offset) {
+            return false;
+        }
+        // The entry isn't in a bucket yet, so no one else can see it.
+        entry = (SharedCacheEntry *)shared_ptr(segment, offset);
     }
-#if CACHE_DEBUGGING
-    validate_cache();
-#endif
+
+    entry->next = 0;
+    entry->hash = h;
+    entry->pipeline_hash = pipeline_hash;
+    entry->bytes = bytes;
+    entry->weight = entry_weight(cost, eviction_priority, bytes);
+    entry->use_count = 1;
+    entry->ref_count = 0;
+    entry->key_size = stable_size;
+    entry->dimensions = dimensions;
+    entry->tuple_count = tuple_count;
+    entry->padding = 0;
+    for (int32_t d = 0; d < dimensions; d++) {
+        shared_entry_bounds(entry)[d] = computed_bounds->dim[d];
+    }
+    uint64_t entry_offset = shared_offset(segment, entry);
+    uint64_t contents = entry_offset + shared_entry_metadata_bytes(dimensions, tuple_count, stable_size);
+    for (int32_t i = 0; i < tuple_count; i++) {
+        const halide_buffer_t *buf = tuple_buffers[i];
+        SharedCacheTuple &tuple = shared_entry_tuples(entry)[i];
+        contents = shared_align_up(contents + sizeof(uint64_t));
+        tuple.type = buf->type;
+        tuple.padding = 0;
+        tuple.offset = contents;
+        tuple.bytes = buf->size_in_bytes();
+        for (int32_t d = 0; d < dimensions; d++) {
+            shared_entry_shape(entry, i)[d] = buf->dim[d];
+        }
+        memcpy(shared_ptr(segment, contents - sizeof(uint64_t)), &entry_offset, sizeof(uint64_t));
+        memcpy(shared_ptr(segment, contents), buf->host, tuple.bytes);
+        contents += tuple.bytes;
+    }
+    memcpy(shared_entry_key(entry), cache_key + stable_key_offset(), stable_size);
+
+    ScopedSharedCacheLock lock;
+    if (lock.segment != segment) {
+        // The segment was swapped out from under us.
+        return false;
+    }
+    if (find_shared_entry(segment, h, pipeline_hash, cache_key, size,
+                          computed_bounds, tuple_count, tuple_buffers)) {
+        // Another process stored the same result while we were copying.
+        shared_free(segment, entry_offset);
+        return true;
+    }
+    entry->value = segment->inflation + entry->weight;
+    uint64_t *bucket = &segment->buckets[h % CACHE_SHARED_BUCKETS];
+    entry->next = *bucket;
+    *bucket = entry_offset;
+    return true;
+}
+
+// Release a buffer returned by lookup_shared. Returns false if host
+// isn't in the segment.
+WEAK bool release_shared(void *user_context, void *host) {
+    SharedCacheHeader *segment = __atomic_load_n(&cache_shared_segment, __ATOMIC_ACQUIRE);
+    if (!segment || (uint8_t *)host < (uint8_t *)segment ||
+        (uint8_t *)host >= (uint8_t *)segment + cache_shared_size) {
+        return false;
+    }
+    ScopedSharedCacheLock lock;
+    uint64_t entry_offset;
+    memcpy(&entry_offset, (uint8_t *)host - sizeof(uint64_t), sizeof(uint64_t));
+    SharedCacheEntry *entry = (SharedCacheEntry *)shared_ptr(segment, entry_offset);
+    halide_assert(user_context, entry->ref_count > 0);
+    entry->ref_count--;
+    return true;
 }
 
 }}} // namespace Halide::Runtime::Internal
@@ -316,18 +1596,93 @@ WEAK void halide_memoization_cache_set_size(int64_t size) {
         size = kDefaultCacheSize;
     }
 
-    ScopedMutexLock lock(&memoization_lock);
-
-    max_cache_size = size;
+    __atomic_store_n(&max_cache_size, size, __ATOMIC_RELAXED);
     prune_cache();
 }
 
-WEAK int halide_memoization_cache_lookup(void *user_context, const uint8_t *cache_key, int32_t size,
-                                         halide_buffer_t *computed_bounds, int32_t tuple_count, halide_buffer_t **tuple_buffers) {
-    uint32_t h = djb_hash(cache_key, size);
-    uint32_t index = h % kHashTableSize;
+WEAK int halide_memoization_cache_set_pipeline_quota(const char *pipeline_name, int64_t bytes) {
+    PipelineStats *p;
+    {
+        ScopedMutexLock lock(&cache_stats_lock);
+        p = find_pipeline_stats_already_locked(pipeline_name, strlen(pipeline_name));
+    }
+    if (!p) {
+        return halide_error_code_out_of_memory;
+    }
+    p->quota = bytes > 0 ? bytes : 0;
+    prune_pipeline(p);
+    return 0;
+}
 
-    ScopedMutexLock lock(&memoization_lock);
+WEAK int halide_memoization_cache_get_stats(const char *pipeline_name, const char *func_name,
+                                            halide_memoization_cache_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    bool found = false;
+    if (func_name) {
+        // There may be several records for the same Func if it has
+        // been compiled more than once.
+        for (int i = 0; i < CACHE_MAX_FUNC_STATS; i++) {
+            FuncStats *fs = __atomic_load_n(&func_stats_table[i], __ATOMIC_ACQUIRE);
+            if (fs && strcmp(fs->func_name, func_name) == 0 &&
+                (!pipeline_name || strcmp(fs->pipeline_name, pipeline_name) == 0)) {
+                add_stats(stats, &fs->stats);
+                found = true;
+            }
+        }
+    } else {
+        ScopedMutexLock lock(&cache_stats_lock);
+        for (PipelineStats *p = pipeline_stats_list; p; p = p->next) {
+            if (!pipeline_name || strcmp(p->name, pipeline_name) == 0) {
+                add_stats(stats, &p->stats);
+                found = true;
+            }
+        }
+    }
+    return (found || !pipeline_name) ? 0 : -1;
+}
+
+WEAK void halide_memoization_cache_reset_stats() {
+    ScopedMutexLock lock(&cache_stats_lock);
+    for (PipelineStats *p = pipeline_stats_list; p; p = p->next) {
+        reset_stats(&p->stats);
+    }
+    for (int i = 0; i < CACHE_MAX_FUNC_STATS; i++) {
+        FuncStats *fs = __atomic_load_n(&func_stats_table[i], __ATOMIC_ACQUIRE);
+        if (fs) {
+            reset_stats(&fs->stats);
+        }
+    }
+}
+
+WEAK void halide_memoization_cache_set_disk_path(const char *path) {
+    ScopedMutexLock lock(&cache_disk_lock);
+    cache_disk_path[0] = 0;
+    if (path) {
+        strncpy(cache_disk_path, path, CACHE_DISK_PATH_MAX - 1);
+        cache_disk_path[CACHE_DISK_PATH_MAX - 1] = 0;
+    }
+    cache_disk_path_inited = true;
+}
+
+WEAK int halide_memoization_cache_set_shared_memory(const char *name, int64_t size) {
+    ScopedMutexLock lock(&cache_shared_lock);
+    detach_shared_segment_already_locked();
+    cache_shared_inited = true;
+    if (!name) {
+        return 0;
+    }
+    if (size <= 0) {
+        size = __atomic_load_n(&max_cache_size, __ATOMIC_RELAXED);
+    }
+    return attach_shared_segment_already_locked(name, (size_t)size) ? 0 : -1;
+}
+
+WEAK int halide_memoization_cache_lookup_with_hash(void *user_context, const uint8_t *cache_key, int32_t size,
+                                                   halide_buffer_t *computed_bounds, int32_t tuple_count,
+                                                   halide_buffer_t **tuple_buffers, uint64_t pipeline_hash) {
+    uint64_t h = cache_key_hash(cache_key, size);
+    CacheShard *shard = shard_for(h);
+    FuncStats *stats = find_func_stats(cache_key, size);
 
 #if CACHE_DEBUGGING
     debug_print_key(user_context, "halide_memoization_cache_lookup", cache_key, size);
@@ -342,52 +1697,37 @@ WEAK int halide_memoization_cache_lookup(void *user_context, const uint8_t *cach
     }
 #endif
 
-    CacheEntry *entry = cache_entries[index];
-    while (entry != NULL) {
-        if (entry->hash == h && entry->key_size == (size_t)size &&
-            keys_equal(entry->key, cache_key, size) &&
-            buffer_has_shape(computed_bounds, entry->computed_bounds) &&
-            entry->tuple_count == (uint32_t)tuple_count) {
+    {
+        ScopedMutexLock lock(&shard->lock);
 
-            // Check all the tuple buffers have the same bounds (they should).
-            bool all_bounds_equal = true;
-            for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
-                all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
+        CacheEntry *entry = find_entry(shard, h, cache_key, size, computed_bounds,
+                                       tuple_count, tuple_buffers);
+        if (entry != NULL) {
+            if (entry->in_use_count == 0) {
+                heap_remove(shard, entry);
             }
+            touch_entry(entry);
 
-            if (all_bounds_equal) {
-                if (entry != most_recently_used) {
-                    halide_assert(user_context, entry->more_recent != NULL);
-                    if (entry->less_recent != NULL) {
-                        entry->less_recent->more_recent = entry->more_recent;
-                    } else {
-                        halide_assert(user_context, least_recently_used == entry);
-                        least_recently_used = entry->more_recent;
-                    }
-                    halide_assert(user_context, entry->more_recent != NULL);
-                    entry->more_recent->less_recent = entry->less_recent;
-
-                    entry->more_recent = NULL;
-                    entry->less_recent = most_recently_used;
-                    if (most_recently_used != NULL) {
-                        most_recently_used->more_recent = entry;
-                    }
-                    most_recently_used = entry;
-                }
-
-                for (int32_t i = 0; i < tuple_count; i++) {
-                    halide_buffer_t *buf = tuple_buffers[i];
-                    *buf = entry->buf[i];
-                }
+            for (int32_t i = 0; i < tuple_count; i++) {
+                halide_buffer_t *buf = tuple_buffers[i];
+                *buf = entry->buf[i];
+            }
 
-                entry->in_use_count += tuple_count;
+            entry->in_use_count += tuple_count;
+            CACHE_STAT_ADD(stats, hits, 1);
 
-                return 0;
-            }
+            return 0;
         }
-        entry = entry->next;
     }
 
+    if (lookup_shared(pipeline_hash, cache_key, size, computed_bounds, tuple_count, tuple_buffers)) {
+        CACHE_STAT_ADD(stats, shared_hits, 1);
+        return 0;
+    }
+
+    // A miss. Allocate the storage for the caller to compute into
+    // without holding the lock.
+    int64_t miss_time = halide_current_time_ns(user_context);
     for (int32_t i = 0; i < tuple_count; i++) {
         halide_buffer_t *buf = tuple_buffers[i];
 
@@ -403,25 +1743,52 @@ WEAK int halide_memoization_cache_lookup(void *user_context, const uint8_t *cach
         CacheBlockHeader *header = get_pointer_to_header(buf->host);
         header->hash = h;
         header->entry = NULL;
+        header->miss_time = miss_time;
     }
 
-#if CACHE_DEBUGGING
-    validate_cache();
-#endif
+    int64_t cost;
+    int32_t eviction_priority;
+    if (load_from_disk(user_context, pipeline_hash, cache_key, size, computed_bounds,
+                       tuple_count, tuple_buffers, &cost, &eviction_priority)) {
+        if (!store_to_shared(pipeline_hash, cache_key, size, computed_bounds,
+                             tuple_count, tuple_buffers, cost, eviction_priority)) {
+            ScopedMutexLock lock(&shard->lock);
+            // If this fails, the caller still gets the loaded data, and
+            // release will free it.
+            insert_entry(user_context, shard, h, cache_key, size, computed_bounds,
+                         tuple_count, tuple_buffers, cost, eviction_priority, stats);
+        }
+        CACHE_STAT_ADD(stats, disk_hits, 1);
+        if (stats) {
+            prune_pipeline(stats->pipeline);
+        }
+        prune_cache();
+        return 0;
+    }
 
+    CACHE_STAT_ADD(stats, misses, 1);
     return 1;
 }
 
-WEAK int halide_memoization_cache_store(void *user_context, const uint8_t *cache_key, int32_t size,
-                                        halide_buffer_t *computed_bounds,
-                                        int32_t tuple_count, halide_buffer_t **tuple_buffers) {
-    debug(user_context) << "halide_memoization_cache_store\n";
-
-    uint32_t h = get_pointer_to_header(tuple_buffers[0]->host)->hash;
+WEAK int halide_memoization_cache_lookup(void *user_context, const uint8_t *cache_key, int32_t size,
+                                         halide_buffer_t *computed_bounds, int32_t tuple_count, halide_buffer_t **tuple_buffers) {
+    return halide_memoization_cache_lookup_with_hash(user_context, cache_key, size, computed_bounds,
+                                                     tuple_count, tuple_buffers, 0);
+}
 
-    uint32_t index = h % kHashTableSize;
+WEAK int halide_memoization_cache_store_with_priority(void *user_context, const uint8_t *cache_key, int32_t size,
+                                                      halide_buffer_t *computed_bounds,
+                                                      int32_t tuple_count, halide_buffer_t **tuple_buffers,
+                                                      int32_t eviction_priority, uint64_t pipeline_hash) {
+    debug(user_context) << "halide_memoization_cache_store\n";
 
-    ScopedMutexLock lock(&memoization_lock);
+    CacheBlockHeader *first_header = get_pointer_to_header(tuple_buffers[0]->host);
+    uint64_t h = first_header->hash;
+    int64_t cost = halide_current_time_ns(user_context) - first_header->miss_time;
+    CacheShard *shard = shard_for(h);
+    FuncStats *stats = find_func_stats(cache_key, size);
+    CACHE_STAT_ADD(stats, stores, 1);
+    CACHE_STAT_ADD(stats, total_compute_time_ns, cost);
 
 #if CACHE_DEBUGGING
     debug_print_key(user_context, "halide_memoization_cache_store", cache_key, size);
@@ -436,108 +1803,74 @@ WEAK int halide_memoization_cache_store(void *user_context, const uint8_t *cache
     }
 #endif
 
-    CacheEntry *entry = cache_entries[index];
-    while (entry != NULL) {
-        if (entry->hash == h && entry->key_size == (size_t)size &&
-            keys_equal(entry->key, cache_key, size) &&
-            buffer_has_shape(computed_bounds, entry->computed_bounds) &&
-            entry->tuple_count == (uint32_t)tuple_count) {
-
-            bool all_bounds_equal = true;
-            bool no_host_pointers_equal = true;
-            {
-                for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
-                    halide_buffer_t *buf = tuple_buffers[i];
-                    all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
-                    if (entry->buf[i].host == buf->host) {
-                        no_host_pointers_equal = false;
-                    }
-                }
-            }
-            if (all_bounds_equal) {
-                halide_assert(user_context, no_host_pointers_equal);
-                // This entry is still in use by the caller. Mark it as having no cache entry
-                // so halide_memoization_cache_release can free the buffer.
-                for (int32_t i = 0; i < tuple_count; i++) {
-                    get_pointer_to_header(tuple_buffers[i]->host)->entry = NULL;
-
-                }
-                return 0;
-            }
-        }
-        entry = entry->next;
-    }
-
-    uint64_t added_size = 0;
-    {
-        for (int32_t i = 0; i < tuple_count; i++) {
-            halide_buffer_t *buf = tuple_buffers[i];
-            added_size += buf->size_in_bytes();
-        }
-    }
-    current_cache_size += added_size;
-    prune_cache();
-
-    CacheEntry *new_entry = (CacheEntry *)halide_malloc(NULL, sizeof(CacheEntry));
-    bool inited = false;
-    if (new_entry) {
-        inited = new_entry->init(cache_key, size, h, computed_bounds, tuple_count, tuple_buffers);
+    // With the shared tier on, the result goes there instead, and the
+    // caller's copy is freed when it's released.
+    bool inserted = store_to_shared(pipeline_hash, cache_key, size, computed_bounds,
+                                    tuple_count, tuple_buffers, cost, eviction_priority);
+    if (!inserted) {
+        ScopedMutexLock lock(&shard->lock);
+        inserted = insert_entry(user_context, shard, h, cache_key, size, computed_bounds,
+                                tuple_count, tuple_buffers, cost, eviction_priority, stats);
     }
-    if (!inited) {
-        current_cache_size -= added_size;
-
-        // This entry is still in use by the caller. Mark it as having no cache entry
-        // so halide_memoization_cache_release can free the buffer.
-        for (int32_t i = 0; i < tuple_count; i++) {
-            get_pointer_to_header(tuple_buffers[i]->host)->entry = NULL;
-        }
 
-        if (new_entry) {
-            halide_free(user_context, new_entry);
-        }
-        return 0;
+    // The caller still holds the buffers, so they can't be evicted
+    // while we write them out.
+    if (inserted) {
+        store_to_disk(user_context, pipeline_hash, cache_key, size, computed_bounds,
+                      tuple_count, tuple_buffers, cost, eviction_priority);
     }
 
-    new_entry->next = cache_entries[index];
-    new_entry->less_recent = most_recently_used;
-    if (most_recently_used != NULL) {
-        most_recently_used->more_recent = new_entry;
-    }
-    most_recently_used = new_entry;
-    if (least_recently_used == NULL) {
-        least_recently_used = new_entry;
-    }
-    cache_entries[index] = new_entry;
-
-    new_entry->in_use_count = tuple_count;
-
-    for (int32_t i = 0; i < tuple_count; i++) {
-        get_pointer_to_header(tuple_buffers[i]->host)->entry = new_entry;
+    if (stats) {
+        prune_pipeline(stats->pipeline);
     }
+    prune_cache();
 
-#if CACHE_DEBUGGING
-    validate_cache();
-#endif
     debug(user_context) << "Exiting halide_memoization_cache_store\n";
 
     return 0;
 }
 
+WEAK int halide_memoization_cache_store(void *user_context, const uint8_t *cache_key, int32_t size,
+                                        halide_buffer_t *computed_bounds,
+                                        int32_t tuple_count, halide_buffer_t **tuple_buffers) {
+    return halide_memoization_cache_store_with_priority(user_context, cache_key, size, computed_bounds,
+                                                        tuple_count, tuple_buffers, 0, 0);
+}
+
 WEAK void halide_memoization_cache_release(void *user_context, void *host) {
-    CacheBlockHeader *header = get_pointer_to_header((uint8_t *)host);
     debug(user_context) << "halide_memoization_cache_release\n";
+    if (release_shared(user_context, host)) {
+        return;
+    }
+    CacheBlockHeader *header = get_pointer_to_header((uint8_t *)host);
     CacheEntry *entry = header->entry;
 
     if (entry == NULL) {
         halide_free(user_context, header);
     } else {
-        ScopedMutexLock lock(&memoization_lock);
-
-        halide_assert(user_context, entry->in_use_count > 0);
-        entry->in_use_count--;
+        CacheShard *shard = shard_for(header->hash);
+        bool now_evictable = false;
+        PipelineStats *pipeline = entry->stats ? entry->stats->pipeline : NULL;
+        {
+            ScopedMutexLock lock(&shard->lock);
+
+            halide_assert(user_context, entry->in_use_count > 0);
+            entry->in_use_count--;
+            if (entry->in_use_count == 0) {
+                heap_insert(shard, entry);
+                now_evictable = true;
+            }
 #if CACHE_DEBUGGING
-        validate_cache();
+            validate_shard(shard);
 #endif
+        }
+        // Entries that were in use may have kept the cache over
+        // budget or quota. Now that one is evictable, we can trim back
+        // down.
+        if (now_evictable) {
+            prune_pipeline(pipeline);
+            prune_cache();
+        }
     }
 
     debug(user_context) << "Exited halide_memoization_cache_release.\n";
@@ -545,20 +1878,55 @@ WEAK void halide_memoization_cache_release(void *user_context, void *host) {
 
 WEAK void halide_memoization_cache_cleanup() {
     debug(NULL) << "halide_memoization_cache_cleanup\n";
-    for (size_t i = 0; i < kHashTableSize; i++) {
-        CacheEntry *entry = cache_entries[i];
-        cache_entries[i] = NULL;
-        while (entry != NULL) {
-            CacheEntry *next = entry->next;
-            entry->destroy();
-            halide_free(NULL, entry);
-            entry = next;
+    for (int s = 0; s < CACHE_NUM_SHARDS; s++) {
+        CacheShard *shard = &cache_shards[s];
+        for (uint32_t i = 0; i < shard->num_buckets; i++) {
+            CacheEntry *entry = shard->buckets[i];
+            shard->buckets[i] = NULL;
+            while (entry != NULL) {
+                CacheEntry *next = entry->next;
+                entry->destroy();
+                halide_free(NULL, entry);
+                entry = next;
+            }
+        }
+        if (shard->buckets != NULL && shard->buckets != shard->initial_buckets) {
+            halide_free(NULL, shard->buckets);
+        }
+        if (shard->heap != NULL) {
+            halide_free(NULL, shard->heap);
         }
+        shard->buckets = NULL;
+        shard->num_buckets = 0;
+        shard->num_entries = 0;
+        shard->heap = NULL;
+        shard->heap_size = 0;
+        shard->heap_capacity = 0;
+        halide_mutex_destroy(&shard->lock);
     }
     current_cache_size = 0;
-    most_recently_used = NULL;
-    least_recently_used = NULL;
-    halide_mutex_destroy(&memoization_lock);
+    cache_inflation_bits = 0;
+
+    {
+        ScopedMutexLock lock(&cache_shared_lock);
+        detach_shared_segment_already_locked();
+        cache_shared_inited = false;
+    }
+
+    // Keep the pipeline records, as they hold the quotas, but forget
+    // the Funcs, whose identity strings may be about to go away.
+    for (int i = 0; i < CACHE_MAX_FUNC_STATS; i++) {
+        FuncStats *fs = func_stats_table[i];
+        if (fs) {
+            halide_free(NULL, (void *)fs->id);
+            halide_free(NULL, (void *)fs->func_name);
+            halide_free(NULL, fs);
+            func_stats_table[i] = NULL;
+        }
+    }
+    for (PipelineStats *p = pipeline_stats_list; p; p = p->next) {
+        p->stats.bytes = 0;
+    }
 }
 
 namespace {
@@ -1,6 +1,7 @@
 #include "HalideRuntimeCuda.h"
 #include "device_buffer_utils.h"
 #include "device_interface.h"
+#include "gpu_binary_cache.h"
 #include "printer.h"
 #include "mini_cuda.h"
 
@@ -74,11 +75,299 @@ extern WEAK halide_device_interface_t cuda_device_interface;
 WEAK const char *get_error_name(CUresult error);
 WEAK CUresult create_cuda_context(void *user_context, CUcontext *ctx);
 
-// A cuda context defined in this module with weak linkage
-CUcontext WEAK context = 0;
-// This spinlock protexts the above context variable.
+// The cuda contexts defined in this module with weak linkage, one for each
+// device that halide_get_gpu_device has selected. The first one is for the
+// default selection (-1), so several pipelines can run on different devices
+// at once if halide_get_gpu_device picks a device per user_context.
+const int max_cuda_devices = 16;
+CUcontext WEAK contexts[max_cuda_devices + 1];
+// This spinlock protexts the above context variables.
 volatile int WEAK context_lock = 0;
 
+// Return the index in 'contexts' of the context for the device selected for
+// 'user_context', or -1 if the device is out of range.
+WEAK int context_index(void *user_context) {
+    int device = halide_get_gpu_device(user_context);
+    if (device < -1 || device >= max_cuda_devices) {
+        return -1;
+    }
+    return device + 1;
+}
+
+// A stream of the pool used by the default halide_cuda_get_stream when
+// halide_cuda_set_stream_per_user_context is enabled. A stream belongs to
+// one user_context at a time, until halide_cuda_release_stream returns it
+// to the pool.
+struct pooled_stream {
+    CUcontext context;
+    CUstream stream;
+    void *user_context;
+    bool in_use;
+    pooled_stream *next;
+};
+
+WEAK pooled_stream *stream_pool = NULL;
+WEAK volatile int stream_pool_lock = 0;
+WEAK bool stream_per_user_context = false;
+
+// Get the stream of 'user_context' on 'ctx', which must be the current
+// context, taking an unused stream from the pool or creating one.
+WEAK CUresult get_pooled_stream(void *user_context, CUcontext ctx, CUstream *stream) {
+    CUresult err = CUDA_SUCCESS;
+    while (__sync_lock_test_and_set(&stream_pool_lock, 1)) { }
+    pooled_stream *unused = NULL;
+    pooled_stream *found = NULL;
+    for (pooled_stream *s = stream_pool; s; s = s->next) {
+        if (s->context != ctx) {
+            continue;
+        }
+        if (s->in_use && s->user_context == user_context) {
+            found = s;
+            break;
+        }
+        if (!s->in_use && unused == NULL) {
+            unused = s;
+        }
+    }
+    if (found == NULL && unused != NULL) {
+        found = unused;
+        found->user_context = user_context;
+        found->in_use = true;
+    }
+    if (found == NULL) {
+        found = (pooled_stream *)malloc(sizeof(pooled_stream));
+        if (found == NULL) {
+            err = CUDA_ERROR_OUT_OF_MEMORY;
+        } else {
+            // The streams are blocking, so that they still synchronize with
+            // the work other user_contexts do on the default stream.
+            err = cuStreamCreate(&found->stream, 0);
+            if (err != CUDA_SUCCESS) {
+                free(found);
+                found = NULL;
+            } else {
+                debug(user_context) << "    cuStreamCreate " << found->stream << "\n";
+                found->context = ctx;
+                found->user_context = user_context;
+                found->in_use = true;
+                found->next = stream_pool;
+                stream_pool = found;
+            }
+        }
+    }
+    if (found) {
+        *stream = found->stream;
+    }
+    __sync_lock_release(&stream_pool_lock);
+    return err;
+}
+
+// Destroy the pooled streams on 'ctx', which must be the current context.
+WEAK void destroy_pooled_streams(void *user_context, CUcontext ctx) {
+    while (__sync_lock_test_and_set(&stream_pool_lock, 1)) { }
+    pooled_stream **prev_ptr = &stream_pool;
+    while (*prev_ptr) {
+        pooled_stream *s = *prev_ptr;
+        if (s->context == ctx) {
+            debug(user_context) << "    cuStreamDestroy " << s->stream << "\n";
+            CUresult err = cuStreamDestroy(s->stream);
+            halide_assert(user_context, err == CUDA_SUCCESS || err == CUDA_ERROR_DEINITIALIZED);
+            *prev_ptr = s->next;
+            free(s);
+        } else {
+            prev_ptr = &s->next;
+        }
+    }
+    __sync_lock_release(&stream_pool_lock);
+}
+
+// The last writes to ranges of device memory, so that reading a buffer back
+// to the host, or synchronizing with it, only waits for the work that wrote
+// it, rather than for everything on its stream. A write is an event recorded
+// on the stream of the kernel or copy that does it. Only the most recent
+// writes on each context are kept, and they are all newer than the ones that
+// were dropped, so a buffer overlapping none of them falls back to
+// synchronizing with the stream.
+struct buffer_write {
+    CUdeviceptr begin, end;
+    CUevent event;
+    uint64_t seq;
+};
+
+#define MAX_BUFFER_WRITES 64
+
+struct buffer_write_log {
+    CUcontext context;
+    // The stream the copies to the host that wait for write events are
+    // done on. It is created when it is first needed.
+    CUstream readback_stream;
+    buffer_write writes[MAX_BUFFER_WRITES];
+    uint64_t last_seq;
+    buffer_write_log *next;
+};
+
+WEAK buffer_write_log *buffer_write_logs = NULL;
+WEAK volatile int buffer_write_log_lock = 0;
+
+WEAK bool buffer_write_events_supported() {
+    return cuEventCreate != NULL && cuEventRecord != NULL &&
+        cuEventDestroy_v2 != NULL && cuStreamWaitEvent != NULL &&
+        cuStreamCreate != NULL && cuStreamSynchronize != NULL;
+}
+
+// Get the range of device memory covered by 'buf'.
+WEAK void get_device_range(const halide_buffer_t *buf, CUdeviceptr *begin, CUdeviceptr *end) {
+    int64_t lo = 0, hi = 0;
+    for (int i = 0; i < buf->dimensions; i++) {
+        if (buf->dim[i].extent <= 0) {
+            *begin = *end = 0;
+            return;
+        }
+        int64_t span = (int64_t)(buf->dim[i].extent - 1) * buf->dim[i].stride;
+        if (span < 0) {
+            lo += span;
+        } else {
+            hi += span;
+        }
+    }
+    int64_t bytes = buf->type.bytes();
+    *begin = (CUdeviceptr)(buf->device + lo * bytes);
+    *end = (CUdeviceptr)(buf->device + (hi + 1) * bytes);
+}
+
+// Find the write log of 'ctx', creating it if 'create' is true. Must be
+// called with buffer_write_log_lock held.
+WEAK buffer_write_log *find_buffer_write_log(CUcontext ctx, bool create) {
+    for (buffer_write_log *log = buffer_write_logs; log; log = log->next) {
+        if (log->context == ctx) {
+            return log;
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+    buffer_write_log *log = (buffer_write_log *)malloc(sizeof(buffer_write_log));
+    if (log) {
+        memset(log, 0, sizeof(buffer_write_log));
+        log->context = ctx;
+        log->next = buffer_write_logs;
+        buffer_write_logs = log;
+    }
+    return log;
+}
+
+// Record that the work just enqueued on 'stream' on 'ctx', which must be the
+// current context, writes to the device memory of 'buf'.
+WEAK void record_buffer_write(void *user_context, CUcontext ctx, CUstream stream,
+                              const halide_buffer_t *buf) {
+    if (!buffer_write_events_supported()) {
+        return;
+    }
+    CUdeviceptr begin, end;
+    get_device_range(buf, &begin, &end);
+
+    while (__sync_lock_test_and_set(&buffer_write_log_lock, 1)) { }
+    buffer_write_log *log = find_buffer_write_log(ctx, true);
+    if (log) {
+        // Replace the oldest write.
+        buffer_write *w = &log->writes[log->last_seq % MAX_BUFFER_WRITES];
+        CUresult err = CUDA_SUCCESS;
+        if (w->event == NULL) {
+            err = cuEventCreate(&w->event, CU_EVENT_DISABLE_TIMING);
+            if (err != CUDA_SUCCESS) {
+                w->event = NULL;
+            }
+        }
+        if (err == CUDA_SUCCESS) {
+            err = cuEventRecord(w->event, stream);
+        }
+        if (err == CUDA_SUCCESS) {
+            w->begin = begin;
+            w->end = end;
+            w->seq = ++log->last_seq;
+        } else {
+            // An older write to the same memory must not be taken to be
+            // the last one, so forget them all.
+            debug(user_context) << "    Not recording the write to " << (void *)buf
+                                << ": " << get_error_name(err) << "\n";
+            for (int i = 0; i < MAX_BUFFER_WRITES; i++) {
+                log->writes[i].begin = log->writes[i].end = 0;
+            }
+        }
+    }
+    __sync_lock_release(&buffer_write_log_lock);
+}
+
+// Get a stream on 'ctx', which must be the current context, on which the work
+// enqueued next waits for the last recorded write to the device memory of
+// 'buf'. Returns false if none of the recorded writes overlap it, in which
+// case the caller must synchronize with the stream it was written on.
+WEAK bool get_readback_stream(void *user_context, CUcontext ctx, const halide_buffer_t *buf,
+                              CUstream *stream) {
+    if (!buffer_write_events_supported() || !buf->device) {
+        return false;
+    }
+    CUdeviceptr begin, end;
+    get_device_range(buf, &begin, &end);
+
+    bool found = false;
+    while (__sync_lock_test_and_set(&buffer_write_log_lock, 1)) { }
+    buffer_write_log *log = find_buffer_write_log(ctx, false);
+    const buffer_write *last = NULL;
+    for (int i = 0; log && i < MAX_BUFFER_WRITES; i++) {
+        const buffer_write *w = &log->writes[i];
+        if (w->begin < end && begin < w->end && (last == NULL || w->seq > last->seq)) {
+            last = w;
+        }
+    }
+    if (last && log->readback_stream == NULL) {
+        // The stream is non-blocking, so that it doesn't also wait for the
+        // work on the default stream.
+        if (cuStreamCreate(&log->readback_stream, CU_STREAM_NON_BLOCKING) == CUDA_SUCCESS) {
+            debug(user_context) << "    cuStreamCreate " << log->readback_stream << "\n";
+        } else {
+            log->readback_stream = NULL;
+        }
+    }
+    if (last && log->readback_stream) {
+        // The wait is for the event as it was recorded now, so its slot can
+        // be reused as soon as we release the lock.
+        debug(user_context) << "    cuStreamWaitEvent " << last->event << "\n";
+        found = cuStreamWaitEvent(log->readback_stream, last->event, 0) == CUDA_SUCCESS;
+        *stream = log->readback_stream;
+    }
+    __sync_lock_release(&buffer_write_log_lock);
+    return found;
+}
+
+// Destroy the write events and the readback stream of 'ctx', which must be
+// the current context.
+WEAK void destroy_buffer_write_log(void *user_context, CUcontext ctx) {
+    while (__sync_lock_test_and_set(&buffer_write_log_lock, 1)) { }
+    buffer_write_log **prev_ptr = &buffer_write_logs;
+    while (*prev_ptr) {
+        buffer_write_log *log = *prev_ptr;
+        if (log->context == ctx) {
+            for (int i = 0; i < MAX_BUFFER_WRITES; i++) {
+                if (log->writes[i].event) {
+                    CUresult err = cuEventDestroy_v2(log->writes[i].event);
+                    halide_assert(user_context, err == CUDA_SUCCESS || err == CUDA_ERROR_DEINITIALIZED);
+                }
+            }
+            if (log->readback_stream) {
+                debug(user_context) << "    cuStreamDestroy " << log->readback_stream << "\n";
+                CUresult err = cuStreamDestroy(log->readback_stream);
+                halide_assert(user_context, err == CUDA_SUCCESS || err == CUDA_ERROR_DEINITIALIZED);
+            }
+            *prev_ptr = log->next;
+            free(log);
+        } else {
+            prev_ptr = &log->next;
+        }
+    }
+    __sync_lock_release(&buffer_write_log_lock);
+}
+
 }}}} // namespace Halide::Runtime::Internal::Cuda
 
 using namespace Halide::Runtime::Internal;
@@ -101,10 +390,18 @@ WEAK int halide_cuda_acquire_context(void *user_context, CUcontext *ctx, bool cr
     halide_assert(user_context, ctx != NULL);
 
     // If the context has not been initialized, initialize it now.
-    halide_assert(user_context, &context != NULL);
+    halide_assert(user_context, &contexts[0] != NULL);
+
+    int index = context_index(user_context);
+    if (index < 0) {
+        error(user_context) << "CUDA: Device " << halide_get_gpu_device(user_context)
+                            << " is out of range\n";
+        return CUDA_ERROR_INVALID_DEVICE;
+    }
+    CUcontext *context = &contexts[index];
 
     CUcontext local_val;
-    __atomic_load(&context, &local_val, __ATOMIC_ACQUIRE);
+    __atomic_load(context, &local_val, __ATOMIC_ACQUIRE);
     if (local_val == NULL) {
         if (!create) {
             *ctx = NULL;
@@ -113,7 +410,7 @@ WEAK int halide_cuda_acquire_context(void *user_context, CUcontext *ctx, bool cr
 
         while (__sync_lock_test_and_set(&context_lock, 1)) { }
 
-        __atomic_load(&context, &local_val, __ATOMIC_ACQUIRE);
+        __atomic_load(context, &local_val, __ATOMIC_ACQUIRE);
         if (local_val == NULL) {
             CUresult error = create_cuda_context(user_context, &local_val);
             if (error != CUDA_SUCCESS) {
@@ -121,7 +418,7 @@ WEAK int halide_cuda_acquire_context(void *user_context, CUcontext *ctx, bool cr
                 return error;
             }
         }
-        __atomic_store(&context, &local_val, __ATOMIC_RELEASE);
+        __atomic_store(context, &local_val, __ATOMIC_RELEASE);
 
         __sync_lock_release(&context_lock);
     }
@@ -141,6 +438,31 @@ WEAK int halide_cuda_release_context(void *user_context) {
 // halide_cuda_acquire_context/halide_cuda_release_context pair, not this call.
 WEAK int halide_cuda_get_stream(void *user_context, CUcontext ctx, CUstream *stream) {
     *stream = 0;
+    if (stream_per_user_context && cuStreamCreate != NULL && cuStreamDestroy != NULL) {
+        CUresult err = get_pooled_stream(user_context, ctx, stream);
+        if (err != CUDA_SUCCESS) {
+            error(user_context) << "CUDA: cuStreamCreate failed: "
+                                << get_error_name(err);
+            return err;
+        }
+    }
+    return 0;
+}
+
+WEAK int halide_cuda_set_stream_per_user_context(void *user_context, bool enable) {
+    stream_per_user_context = enable;
+    return 0;
+}
+
+WEAK int halide_cuda_release_stream(void *user_context) {
+    while (__sync_lock_test_and_set(&stream_pool_lock, 1)) { }
+    for (pooled_stream *s = stream_pool; s; s = s->next) {
+        if (s->in_use && s->user_context == user_context) {
+            s->in_use = false;
+            s->user_context = NULL;
+        }
+    }
+    __sync_lock_release(&stream_pool_lock);
     return 0;
 }
 
@@ -197,9 +519,20 @@ public:
 // The registered_filters struct is not freed as it is pointed to by the
 // Halide generated code. The module_state structs are freed.
 
+// The kernels of a module that have been launched are cached in a list of
+// function_state structs, so that launching a kernel again doesn't need to
+// look it up. The list is only prepended to while the module is loaded, so
+// it can be read without a lock.
+struct function_state {
+    const char *entry_name;
+    CUfunction function;
+    function_state *next;
+};
+
 struct module_state {
     CUcontext context;
     CUmodule module;
+    function_state *functions;
     module_state *next;
 };
 
@@ -222,6 +555,45 @@ WEAK module_state *find_module_for_context(const registered_filters *filters, CU
     return NULL;
 }
 
+// Find the kernel for 'entry_name' in a loaded module. The entry names are
+// constant strings in the code generated for the kernels, so they are
+// compared by address.
+WEAK CUresult get_module_function(module_state *loaded_module, const char *entry_name, CUfunction *f) {
+    function_state *functions = __atomic_load_n(&loaded_module->functions, __ATOMIC_ACQUIRE);
+    for (function_state *fs = functions; fs != NULL; fs = fs->next) {
+        if (fs->entry_name == entry_name) {
+            *f = fs->function;
+            return CUDA_SUCCESS;
+        }
+    }
+
+    CUresult err = cuModuleGetFunction(f, loaded_module->module, entry_name);
+    if (err != CUDA_SUCCESS) {
+        return err;
+    }
+    function_state *fs = (function_state *)malloc(sizeof(function_state));
+    if (fs == NULL) {
+        // The kernel will just be looked up again next time.
+        return CUDA_SUCCESS;
+    }
+    fs->entry_name = entry_name;
+    fs->function = *f;
+    do {
+        fs->next = __atomic_load_n(&loaded_module->functions, __ATOMIC_ACQUIRE);
+    } while (!__sync_bool_compare_and_swap(&loaded_module->functions, fs->next, fs));
+    return CUDA_SUCCESS;
+}
+
+WEAK void free_module_functions(module_state *loaded_module) {
+    function_state *fs = loaded_module->functions;
+    while (fs != NULL) {
+        function_state *next = fs->next;
+        free(fs);
+        fs = next;
+    }
+    loaded_module->functions = NULL;
+}
+
 WEAK CUresult create_cuda_context(void *user_context, CUcontext *ctx) {
     // Initialize CUDA
     CUresult err = cuInit(0);
@@ -419,6 +791,185 @@ WEAK bool validate_device_pointer(void *user_context, halide_buffer_t* buf, size
 #endif
 }
 
+// Device allocations released by halide_cuda_device_free are kept here and
+// reused by later allocations of the same size class on the same context and
+// stream, since cuMemFree implicitly synchronizes the device. The work on a
+// stream runs in order, so an allocation can be reused on its stream as soon
+// as it is freed, even if kernels that use it are still running.
+struct cached_allocation {
+    CUcontext context;
+    CUstream stream;
+    CUdeviceptr ptr;
+    size_t size;
+    cached_allocation *next;
+};
+
+WEAK cached_allocation *allocation_cache = NULL;
+WEAK size_t allocation_cache_bytes = 0;
+// The device memory of allocations freed beyond this many cached bytes is
+// released.
+WEAK size_t allocation_cache_limit = 256 * 1024 * 1024;
+WEAK volatile int allocation_cache_lock = 0;
+
+// Round the size of an allocation up to its size class. The size classes are
+// spaced by a quarter of the next power of two, so a reused allocation is at
+// most 25% larger than requested.
+WEAK size_t allocation_size_class(size_t size) {
+    size_t pow2 = 512;
+    while (pow2 < size) {
+        pow2 *= 2;
+    }
+    size_t step = pow2 / 4;
+    return (size + step - 1) / step * step;
+}
+
+// Remove a cached allocation of 'size' bytes for 'stream' on 'ctx' from the
+// cache. Returns 0 if there is none.
+WEAK CUdeviceptr take_cached_allocation(CUcontext ctx, CUstream stream, size_t size) {
+    CUdeviceptr result = 0;
+    cached_allocation *found = NULL;
+    while (__sync_lock_test_and_set(&allocation_cache_lock, 1)) { }
+    for (cached_allocation **prev_ptr = &allocation_cache; *prev_ptr; prev_ptr = &(*prev_ptr)->next) {
+        cached_allocation *a = *prev_ptr;
+        if (a->context == ctx && a->stream == stream && a->size == size) {
+            *prev_ptr = a->next;
+            allocation_cache_bytes -= size;
+            found = a;
+            break;
+        }
+    }
+    __sync_lock_release(&allocation_cache_lock);
+    if (found) {
+        result = found->ptr;
+        free(found);
+    }
+    return result;
+}
+
+// Add an allocation to the cache. Returns false if the cache is full, in
+// which case the caller must free the allocation.
+WEAK bool cache_allocation(CUcontext ctx, CUstream stream, CUdeviceptr ptr, size_t size) {
+    cached_allocation *a = (cached_allocation *)malloc(sizeof(cached_allocation));
+    if (a == NULL) {
+        return false;
+    }
+    a->context = ctx;
+    a->stream = stream;
+    a->ptr = ptr;
+    a->size = size;
+    bool cached = false;
+    while (__sync_lock_test_and_set(&allocation_cache_lock, 1)) { }
+    if (allocation_cache_bytes + size <= allocation_cache_limit) {
+        a->next = allocation_cache;
+        allocation_cache = a;
+        allocation_cache_bytes += size;
+        cached = true;
+    }
+    __sync_lock_release(&allocation_cache_lock);
+    if (!cached) {
+        free(a);
+    }
+    return cached;
+}
+
+// Free the device memory of the cached allocations on 'ctx', which must be
+// the current context.
+WEAK int release_cached_allocations(void *user_context, CUcontext ctx) {
+    cached_allocation *to_free = NULL;
+    while (__sync_lock_test_and_set(&allocation_cache_lock, 1)) { }
+    cached_allocation **prev_ptr = &allocation_cache;
+    while (*prev_ptr) {
+        cached_allocation *a = *prev_ptr;
+        if (a->context == ctx) {
+            *prev_ptr = a->next;
+            allocation_cache_bytes -= a->size;
+            a->next = to_free;
+            to_free = a;
+        } else {
+            prev_ptr = &a->next;
+        }
+    }
+    __sync_lock_release(&allocation_cache_lock);
+
+    CUresult result = CUDA_SUCCESS;
+    while (to_free) {
+        cached_allocation *a = to_free;
+        to_free = a->next;
+        debug(user_context) << "    cuMemFree " << (void *)(a->ptr) << "\n";
+        CUresult err = cuMemFree(a->ptr);
+        if (err != CUDA_SUCCESS) {
+            result = err;
+        }
+        free(a);
+    }
+    return result;
+}
+
+// Get a cubin for 'ptx_src' for the device of the current context 'ctx',
+// from the on-disk kernel cache if it's there, or by compiling it and
+// storing it in the cache. Returns false if the cache is disabled or the
+// driver can't compile PTX to a cubin, in which case the caller should
+// load the PTX directly.
+WEAK bool get_cached_cubin(void *user_context, CUcontext ctx, const char *ptx_src, int size,
+                           unsigned int max_regs_per_thread, void **cubin, size_t *cubin_size) {
+    if (get_gpu_binary_cache_dir() == NULL ||
+        cuDriverGetVersion == NULL || cuCtxGetDevice == NULL ||
+        cuLinkCreate_v2 == NULL || cuLinkAddData_v2 == NULL ||
+        cuLinkComplete == NULL || cuLinkDestroy == NULL) {
+        return false;
+    }
+
+    CUdevice dev;
+    int driver_version = 0, cc_major = 0, cc_minor = 0;
+    char name[256];
+    if (cuCtxGetDevice(&dev) != CUDA_SUCCESS ||
+        cuDriverGetVersion(&driver_version) != CUDA_SUCCESS ||
+        cuDeviceGetName(name, sizeof(name), dev) != CUDA_SUCCESS ||
+        cuDeviceGetAttribute(&cc_major, CU_DEVICE_ATTRIBUTE_COMPUTE_CAPABILITY_MAJOR, dev) != CUDA_SUCCESS ||
+        cuDeviceGetAttribute(&cc_minor, CU_DEVICE_ATTRIBUTE_COMPUTE_CAPABILITY_MINOR, dev) != CUDA_SUCCESS) {
+        return false;
+    }
+    name[sizeof(name) - 1] = 0;
+
+    gpu_binary_key key;
+    key.source_hash = gpu_binary_hash(gpu_binary_hash_init, ptx_src, size);
+    key.source_hash = gpu_binary_hash(key.source_hash, &max_regs_per_thread, sizeof(max_regs_per_thread));
+    key.source_size = size;
+    key.device_hash = gpu_binary_hash(gpu_binary_hash_init, name);
+    key.device_hash = gpu_binary_hash(key.device_hash, &driver_version, sizeof(driver_version));
+    key.device_hash = gpu_binary_hash(key.device_hash, &cc_major, sizeof(cc_major));
+    key.device_hash = gpu_binary_hash(key.device_hash, &cc_minor, sizeof(cc_minor));
+
+    if (load_gpu_binary(user_context, "cuda_", key, cubin, cubin_size)) {
+        return true;
+    }
+
+    CUjit_option options[] = { CU_JIT_MAX_REGISTERS };
+    void *optionValues[] = { (void*)(uintptr_t) max_regs_per_thread };
+    CUlinkState link_state;
+    if (cuLinkCreate_v2(1, options, optionValues, &link_state) != CUDA_SUCCESS) {
+        return false;
+    }
+    bool ok = false;
+    void *linked = NULL;
+    size_t linked_size = 0;
+    debug(user_context) << "    cuLinkAddData " << (void *)ptx_src << ", " << size << "\n";
+    if (cuLinkAddData_v2(link_state, CU_JIT_INPUT_PTX, (void *)ptx_src, size, "halide", 0, NULL, NULL) == CUDA_SUCCESS &&
+        cuLinkComplete(link_state, &linked, &linked_size) == CUDA_SUCCESS) {
+        // The cubin belongs to the linker state, so copy it out before
+        // destroying it.
+        *cubin = malloc(linked_size);
+        if (*cubin) {
+            memcpy(*cubin, linked, linked_size);
+            *cubin_size = linked_size;
+            store_gpu_binary(user_context, "cuda_", key, *cubin, *cubin_size);
+            ok = true;
+        }
+    }
+    cuLinkDestroy(link_state);
+    return ok;
+}
+
 }}}} // namespace Halide::Runtime::Internal
 
 extern "C" {
@@ -470,7 +1021,15 @@ WEAK int halide_cuda_initialize_kernels(void *user_context, void **state_ptr, co
             max_regs_per_thread = atoi(regs);
         }
         void *optionValues[] = { (void*)(uintptr_t) max_regs_per_thread };
-        CUresult err = cuModuleLoadDataEx(&loaded_module->module, ptx_src, 1, options, optionValues);
+        CUresult err;
+        void *cubin = NULL;
+        size_t cubin_size = 0;
+        if (get_cached_cubin(user_context, ctx.context, ptx_src, size, max_regs_per_thread, &cubin, &cubin_size)) {
+            err = cuModuleLoadDataEx(&loaded_module->module, cubin, 0, NULL, NULL);
+            free(cubin);
+        } else {
+            err = cuModuleLoadDataEx(&loaded_module->module, ptx_src, 1, options, optionValues);
+        }
 
         if (err != CUDA_SUCCESS) {
             free(loaded_module);
@@ -481,6 +1040,7 @@ WEAK int halide_cuda_initialize_kernels(void *user_context, void **state_ptr, co
             debug(user_context) << (void *)(loaded_module->module) << "\n";
         }
         loaded_module->context = ctx.context;
+        loaded_module->functions = NULL;
         loaded_module->next = (*filters)->modules;
         (*filters)->modules = loaded_module;
     }
@@ -519,8 +1079,27 @@ WEAK int halide_cuda_device_free(void *user_context, halide_buffer_t* buf) {
 
     halide_assert(user_context, validate_device_pointer(user_context, buf));
 
-    debug(user_context) <<  "    cuMemFree " << (void *)(dev_ptr) << "\n";
-    CUresult err = cuMemFree(dev_ptr);
+    CUstream stream = NULL;
+    if (cuStreamSynchronize != NULL) {
+        int result = halide_cuda_get_stream(user_context, ctx.context, &stream);
+        if (result != 0) {
+            error(user_context) << "CUDA: In halide_cuda_device_free, halide_cuda_get_stream returned " << result << "\n";
+        }
+    }
+
+    CUresult err = CUDA_SUCCESS;
+    // Managed allocations (see halide_cuda_device_and_host_malloc_managed)
+    // are also the host allocation, and are never cached.
+    bool managed = buf->host == (uint8_t *)dev_ptr;
+    if (managed) {
+        buf->host = NULL;
+    }
+    if (!managed && cache_allocation(ctx.context, stream, dev_ptr, allocation_size_class(buf->size_in_bytes()))) {
+        debug(user_context) << "    caching device allocation " << (void *)(dev_ptr) << "\n";
+    } else {
+        debug(user_context) <<  "    cuMemFree " << (void *)(dev_ptr) << "\n";
+        err = cuMemFree(dev_ptr);
+    }
     // If cuMemFree fails, it isn't likely to succeed later, so just drop
     // the reference.
     buf->device_interface->impl->release_module();
@@ -539,70 +1118,87 @@ WEAK int halide_cuda_device_free(void *user_context, halide_buffer_t* buf) {
     return 0;
 }
 
-WEAK int halide_cuda_device_release(void *user_context) {
-    debug(user_context)
-        << "CUDA: halide_cuda_device_release (user_context: " <<  user_context << ")\n";
-
-    int err;
-    CUcontext ctx;
-    err = halide_cuda_acquire_context(user_context, &ctx, false);
+namespace {
+// Unload the modules and free the cached allocations of a context, and
+// destroy it if it was created by this module.
+WEAK void release_cuda_context(void *user_context, CUcontext ctx) {
+    // It's possible that this is being called from the destructor of
+    // a static variable, in which case the driver may already be
+    // shutting down.
+    int err = cuCtxPushCurrent(ctx);
     if (err != CUDA_SUCCESS) {
-        return err;
+        err = cuCtxSynchronize();
     }
+    halide_assert(user_context, err == CUDA_SUCCESS || err == CUDA_ERROR_DEINITIALIZED);
 
-    if (ctx) {
-        // It's possible that this is being called from the destructor of
-        // a static variable, in which case the driver may already be
-        // shutting down.
-        err = cuCtxPushCurrent(ctx);
-        if (err != CUDA_SUCCESS) {
-            err = cuCtxSynchronize();
-        }
-        halide_assert(user_context, err == CUDA_SUCCESS || err == CUDA_ERROR_DEINITIALIZED);
-
-        while (__sync_lock_test_and_set(&filters_list_lock, 1)) { }
-
-        // Unload the modules attached to this context. Note that the list
-        // nodes themselves are not freed, only the module objects are
-        // released. Subsequent calls to halide_init_kernels might re-create
-        // the program object using the same list node to store the module
-        // object.
-        registered_filters *filters = filters_list;
-        while (filters) {
-            module_state **prev_ptr = &filters->modules;
-            module_state *loaded_module = filters->modules;
-            while (loaded_module != NULL) {
-                if (loaded_module->context == ctx) {
-                    debug(user_context) << "    cuModuleUnload " << loaded_module->module << "\n";
-                    err = cuModuleUnload(loaded_module->module);
-                    halide_assert(user_context, err == CUDA_SUCCESS || err == CUDA_ERROR_DEINITIALIZED);
-                    *prev_ptr = loaded_module->next;
-                    free(loaded_module);
-                    loaded_module = *prev_ptr;
-                } else {
-                    loaded_module = loaded_module->next;
-                    prev_ptr = &loaded_module->next;
-                }
+    err = release_cached_allocations(user_context, ctx);
+    halide_assert(user_context, err == CUDA_SUCCESS || err == CUDA_ERROR_DEINITIALIZED);
+
+    destroy_pooled_streams(user_context, ctx);
+    destroy_buffer_write_log(user_context, ctx);
+
+    while (__sync_lock_test_and_set(&filters_list_lock, 1)) { }
+
+    // Unload the modules attached to this context. Note that the list
+    // nodes themselves are not freed, only the module objects are
+    // released. Subsequent calls to halide_init_kernels might re-create
+    // the program object using the same list node to store the module
+    // object.
+    registered_filters *filters = filters_list;
+    while (filters) {
+        module_state **prev_ptr = &filters->modules;
+        module_state *loaded_module = filters->modules;
+        while (loaded_module != NULL) {
+            if (loaded_module->context == ctx) {
+                debug(user_context) << "    cuModuleUnload " << loaded_module->module << "\n";
+                err = cuModuleUnload(loaded_module->module);
+                halide_assert(user_context, err == CUDA_SUCCESS || err == CUDA_ERROR_DEINITIALIZED);
+                *prev_ptr = loaded_module->next;
+                free_module_functions(loaded_module);
+                free(loaded_module);
+                loaded_module = *prev_ptr;
+            } else {
+                loaded_module = loaded_module->next;
+                prev_ptr = &loaded_module->next;
             }
-            filters = filters->next;
         }
+        filters = filters->next;
+    }
 
-        __sync_lock_release(&filters_list_lock);
+    __sync_lock_release(&filters_list_lock);
 
-        CUcontext old_ctx;
-        cuCtxPopCurrent(&old_ctx);
+    CUcontext old_ctx;
+    cuCtxPopCurrent(&old_ctx);
 
-        // Only destroy the context if we own it
+    // Only destroy the context if we own it
 
-        while (__sync_lock_test_and_set(&context_lock, 1)) { }
-        if (ctx == context) {
-            debug(user_context) << "    cuCtxDestroy " << context << "\n";
+    while (__sync_lock_test_and_set(&context_lock, 1)) { }
+    for (int i = 0; i <= max_cuda_devices; i++) {
+        if (ctx == contexts[i]) {
+            debug(user_context) << "    cuCtxDestroy " << contexts[i] << "\n";
             err = cuProfilerStop();
-            err = cuCtxDestroy(context);
+            err = cuCtxDestroy(contexts[i]);
             halide_assert(user_context, err == CUDA_SUCCESS || err == CUDA_ERROR_DEINITIALIZED);
-            context = NULL;
+            contexts[i] = NULL;
         }
-        __sync_lock_release(&context_lock);
+    }
+    __sync_lock_release(&context_lock);
+}
+}
+
+WEAK int halide_cuda_device_release(void *user_context) {
+    debug(user_context)
+        << "CUDA: halide_cuda_device_release (user_context: " <<  user_context << ")\n";
+
+    int err;
+    CUcontext ctx;
+    err = halide_cuda_acquire_context(user_context, &ctx, false);
+    if (err != CUDA_SUCCESS) {
+        return err;
+    }
+
+    if (ctx) {
+        release_cuda_context(user_context, ctx);
     }
 
     halide_cuda_release_context(user_context);
@@ -639,16 +1235,36 @@ WEAK int halide_cuda_device_malloc(void *user_context, halide_buffer_t *buf) {
     uint64_t t_before = halide_current_time_ns(user_context);
     #endif
 
-    CUdeviceptr p;
-    debug(user_context) << "    cuMemAlloc " << (uint64_t)size << " -> ";
-    CUresult err = cuMemAlloc(&p, size);
-    if (err != CUDA_SUCCESS) {
-        debug(user_context) << get_error_name(err) << "\n";
-        error(user_context) << "CUDA: cuMemAlloc failed: "
-                            << get_error_name(err);
-        return err;
+    CUstream stream = NULL;
+    if (cuStreamSynchronize != NULL) {
+        int result = halide_cuda_get_stream(user_context, ctx.context, &stream);
+        if (result != 0) {
+            error(user_context) << "CUDA: In halide_cuda_device_malloc, halide_cuda_get_stream returned " << result << "\n";
+        }
+    }
+
+    size = allocation_size_class(size);
+    CUdeviceptr p = take_cached_allocation(ctx.context, stream, size);
+    if (p) {
+        debug(user_context) << "    reusing cached device allocation " << (void *)p << "\n";
     } else {
-        debug(user_context) << (void *)p << "\n";
+        debug(user_context) << "    cuMemAlloc " << (uint64_t)size << " -> ";
+        CUresult err = cuMemAlloc(&p, size);
+        if (err == CUDA_ERROR_OUT_OF_MEMORY) {
+            // Give the cached allocations back to the driver and try again.
+            debug(user_context) << get_error_name(err) << "\n";
+            release_cached_allocations(user_context, ctx.context);
+            debug(user_context) << "    cuMemAlloc " << (uint64_t)size << " -> ";
+            err = cuMemAlloc(&p, size);
+        }
+        if (err != CUDA_SUCCESS) {
+            debug(user_context) << get_error_name(err) << "\n";
+            error(user_context) << "CUDA: cuMemAlloc failed: "
+                                << get_error_name(err);
+            return err;
+        } else {
+            debug(user_context) << (void *)p << "\n";
+        }
     }
     halide_assert(user_context, p);
     buf->device = p;
@@ -664,23 +1280,74 @@ WEAK int halide_cuda_device_malloc(void *user_context, halide_buffer_t *buf) {
 }
 
 namespace {
+// Get the context that owns some device memory, or NULL if it is not
+// known. This requires unified virtual addressing, so as for
+// validate_device_pointer we only try in 64-bit processes.
+WEAK CUcontext get_pointer_context(void *user_context, uint64_t dev_ptr) {
+#ifdef BITS_32
+    return NULL;
+#else
+    CUcontext ctx = NULL;
+    CUresult err = cuPointerGetAttribute(&ctx, CU_POINTER_ATTRIBUTE_CONTEXT, (CUdeviceptr)dev_ptr);
+    if (err != CUDA_SUCCESS) {
+        debug(user_context) << "    cuPointerGetAttribute for " << (void *)dev_ptr
+                            << " returned " << get_error_name(err) << "\n";
+        return NULL;
+    }
+    return ctx;
+#endif
+}
+
+// Let the current context, 'ctx', access the memory of 'peer', so that
+// copies between them go over the bus between the devices instead of
+// through host memory. Returns false if the devices can't do that, in
+// which case cuMemcpyPeer still works, by staging the copy itself.
+WEAK bool enable_peer_access(void *user_context, CUcontext ctx, CUcontext peer) {
+    if (peer == ctx) {
+        return true;
+    }
+    CUresult err = cuCtxEnablePeerAccess(peer, 0);
+    debug(user_context) << "    cuCtxEnablePeerAccess " << peer << " -> " << get_error_name(err) << "\n";
+    return err == CUDA_SUCCESS || err == CUDA_ERROR_PEER_ACCESS_ALREADY_ENABLED;
+}
+
+// The copies are asynchronous on 'stream' if 'async' is set. Copies to the
+// device from pageable host memory return once the host memory has been
+// staged, but copies from page-locked memory (e.g. allocated by
+// halide_cuda_device_and_host_malloc) overlap with the host code and with
+// other streams until the stream is synchronized. Copies between device
+// memory on different contexts are made with cuMemcpyPeer if 'src_ctx' and
+// 'dst_ctx' are set.
 WEAK int do_multidimensional_copy(void *user_context, const device_copy &c,
-                                  uint64_t src, uint64_t dst, int d, bool from_host, bool to_host) {
+                                  uint64_t src, uint64_t dst, int d, bool from_host, bool to_host,
+                                  bool async, CUstream stream,
+                                  CUcontext src_ctx = NULL, CUcontext dst_ctx = NULL) {
     if (d > MAX_COPY_DIMS) {
         error(user_context) << "Buffer has too many dimensions to copy to/from GPU\n";
         return -1;
     } else if (d == 0) {
         CUresult err = CUDA_SUCCESS;
-        const char *copy_name;
+        const char *copy_name = "cuMemcpy";
         debug(user_context) << "    from " << (from_host ? "host" : "device")
                             << " to " << (to_host ? "host" : "device") << ", "
                             << (void *)src << " -> " << (void *)dst << ", " << c.chunk_size << " bytes\n";
         if (!from_host && to_host) {
-            err = cuMemcpyDtoH((void *)dst, (CUdeviceptr)src, c.chunk_size);
+            copy_name = "cuMemcpyDtoH";
+            err = async ? cuMemcpyDtoHAsync((void *)dst, (CUdeviceptr)src, c.chunk_size, stream) :
+                           cuMemcpyDtoH((void *)dst, (CUdeviceptr)src, c.chunk_size);
         } else if (from_host && !to_host) {
-            err = cuMemcpyHtoD((CUdeviceptr)dst, (void *)src, c.chunk_size);
+            copy_name = "cuMemcpyHtoD";
+            err = async ? cuMemcpyHtoDAsync((CUdeviceptr)dst, (void *)src, c.chunk_size, stream) :
+                           cuMemcpyHtoD((CUdeviceptr)dst, (void *)src, c.chunk_size);
+        } else if (!from_host && !to_host && src_ctx && dst_ctx) {
+            copy_name = "cuMemcpyPeer";
+            err = async && cuMemcpyPeerAsync ?
+                cuMemcpyPeerAsync((CUdeviceptr)dst, dst_ctx, (CUdeviceptr)src, src_ctx, c.chunk_size, stream) :
+                cuMemcpyPeer((CUdeviceptr)dst, dst_ctx, (CUdeviceptr)src, src_ctx, c.chunk_size);
         } else if (!from_host && !to_host) {
-            err = cuMemcpyDtoD((CUdeviceptr)dst, (CUdeviceptr)src, c.chunk_size);
+            copy_name = "cuMemcpyDtoD";
+            err = async ? cuMemcpyDtoDAsync((CUdeviceptr)dst, (CUdeviceptr)src, c.chunk_size, stream) :
+                           cuMemcpyDtoD((CUdeviceptr)dst, (CUdeviceptr)src, c.chunk_size);
         } else if (dst != src) {
             // Could reach here if a user called directly into the
             // cuda API for a device->host copy on a source buffer
@@ -694,7 +1361,8 @@ WEAK int do_multidimensional_copy(void *user_context, const device_copy &c,
     } else {
         ssize_t src_off = 0, dst_off = 0;
         for (int i = 0; i < (int)c.extent[d-1]; i++) {
-            int err = do_multidimensional_copy(user_context, c, src + src_off, dst + dst_off, d - 1, from_host, to_host);
+            int err = do_multidimensional_copy(user_context, c, src + src_off, dst + dst_off, d - 1, from_host, to_host, async, stream,
+                                               src_ctx, dst_ctx);
             dst_off += c.dst_stride_bytes[d-1];
             src_off += c.src_stride_bytes[d-1];
             if (err) {
@@ -753,7 +1421,78 @@ WEAK int halide_cuda_buffer_copy(void *user_context, struct halide_buffer_t *src
         }
         #endif
 
-        err = do_multidimensional_copy(user_context, c, c.src + c.src_begin, c.dst, dst->dimensions, from_host, to_host);
+        // Copy on the stream the kernels are launched on, so that the copies
+        // are ordered with them and can overlap with the host code. We use
+        // whether cuStreamSynchronize was defined in the cuda driver library
+        // as a test for streams support in the cuda implementation.
+        bool async = cuStreamSynchronize != NULL;
+        CUstream stream = NULL;
+        if (async) {
+            int result = halide_cuda_get_stream(user_context, ctx.context, &stream);
+            if (result != 0) {
+                error(user_context) << "CUDA: In halide_cuda_buffer_copy, halide_cuda_get_stream returned " << result << "\n";
+            }
+        }
+
+        if (async && to_host && !from_host) {
+            // Only wait for the last write to the source, if we know it.
+            get_readback_stream(user_context, ctx.context, src, &stream);
+        }
+
+        // Device memory may belong to another context than the current
+        // one, e.g. if halide_cuda_acquire_context hands out a context
+        // per device. cuMemcpyDtoD can't copy between those, so use the
+        // peer copies, which go directly between the devices when they
+        // support it.
+        CUcontext src_ctx = NULL, dst_ctx = NULL;
+        bool peer_copy = false;
+        if (!from_host && !to_host && cuMemcpyPeer != NULL) {
+            src_ctx = get_pointer_context(user_context, c.src);
+            dst_ctx = get_pointer_context(user_context, c.dst);
+            peer_copy = src_ctx && dst_ctx && (src_ctx != ctx.context || dst_ctx != ctx.context);
+        }
+        if (peer_copy) {
+            if (cuCtxEnablePeerAccess != NULL) {
+                bool direct = (enable_peer_access(user_context, ctx.context, src_ctx) &&
+                               enable_peer_access(user_context, ctx.context, dst_ctx));
+                debug(user_context) << "    peer copy, " << (direct ? "direct" : "staged by the driver") << "\n";
+            }
+            if (src_ctx != ctx.context) {
+                // The writes to the source were ordered on a stream of
+                // its own context, which we can't wait for on ours.
+                CUresult sync_err = cuCtxPushCurrent(src_ctx);
+                if (sync_err == CUDA_SUCCESS) {
+                    sync_err = cuCtxSynchronize();
+                    CUcontext old;
+                    cuCtxPopCurrent(&old);
+                }
+                if (sync_err != CUDA_SUCCESS) {
+                    error(user_context) << "CUDA: cuCtxSynchronize failed: "
+                                        << get_error_name(sync_err);
+                    return sync_err;
+                }
+            }
+        } else {
+            src_ctx = dst_ctx = NULL;
+        }
+
+        err = do_multidimensional_copy(user_context, c, c.src + c.src_begin, c.dst, dst->dimensions, from_host, to_host, async, stream,
+                                       src_ctx, dst_ctx);
+
+        if (err == 0 && async && !to_host && !peer_copy) {
+            record_buffer_write(user_context, ctx.context, stream, dst);
+        }
+
+        if (err == 0 && async && (to_host || (peer_copy && dst_ctx != ctx.context))) {
+            // The host code reads the result as soon as we return, and
+            // so may the work on the context of the destination.
+            CUresult sync_err = cuStreamSynchronize(stream);
+            if (sync_err != CUDA_SUCCESS) {
+                error(user_context) << "CUDA: cuStreamSynchronize failed: "
+                                    << get_error_name(sync_err);
+                err = sync_err;
+            }
+        }
 
         #ifdef DEBUG_RUNTIME
         uint64_t t_after = halide_current_time_ns(user_context);
@@ -764,9 +1503,46 @@ WEAK int halide_cuda_buffer_copy(void *user_context, struct halide_buffer_t *src
     return err;
 }
 
+WEAK int halide_cuda_set_allocation_cache_size(void *user_context, size_t bytes) {
+    debug(user_context)
+        << "CUDA: halide_cuda_set_allocation_cache_size (user_context: " << user_context
+        << ", bytes: " << (uint64_t)bytes << ")\n";
+
+    while (__sync_lock_test_and_set(&allocation_cache_lock, 1)) { }
+    allocation_cache_limit = bytes;
+    bool over_limit = allocation_cache_bytes > allocation_cache_limit;
+    __sync_lock_release(&allocation_cache_lock);
+
+    if (over_limit) {
+        return halide_cuda_release_unused_device_allocations(user_context);
+    }
+    return 0;
+}
+
+WEAK int halide_cuda_release_unused_device_allocations(void *user_context) {
+    debug(user_context)
+        << "CUDA: halide_cuda_release_unused_device_allocations (user_context: " << user_context << ")\n";
+
+    Context ctx(user_context);
+    if (ctx.error != CUDA_SUCCESS) {
+        return ctx.error;
+    }
+
+    // Wait for the kernels that may still use the cached allocations.
+    CUresult err = cuCtxSynchronize();
+    if (err != CUDA_SUCCESS) {
+        error(user_context) << "CUDA: cuCtxSynchronize failed: "
+                            << get_error_name(err);
+        return err;
+    }
+    return release_cached_allocations(user_context, ctx.context);
+}
+
 WEAK int halide_cuda_device_crop(void *user_context, const struct halide_buffer_t *src,
                                  struct halide_buffer_t *dst) {
-    // Pointer arithmetic works fine.
+    // Pointer arithmetic works fine. A crop of an allocation taken from
+    // the cache shares it, and doesn't return it to the cache when it is
+    // released.
     int64_t offset = 0;
     for (int i = 0; i < src->dimensions; i++) {
         offset += (dst->dim[i].min - src->dim[i].min) * src->dim[i].stride;
@@ -790,8 +1566,9 @@ WEAK int halide_cuda_copy_to_host(void *user_context, halide_buffer_t* buf) {
     return halide_cuda_buffer_copy(user_context, buf, NULL, buf);
 }
 
-// Used to generate correct timings when tracing
-WEAK int halide_cuda_device_sync(void *user_context, struct halide_buffer_t *) {
+// Used to generate correct timings when tracing. Given a buffer, this only
+// waits for the last write to it, if that is known.
+WEAK int halide_cuda_device_sync(void *user_context, struct halide_buffer_t *buf) {
     debug(user_context)
         << "CUDA: halide_cuda_device_sync (user_context: " << user_context << ")\n";
 
@@ -805,7 +1582,10 @@ WEAK int halide_cuda_device_sync(void *user_context, struct halide_buffer_t *) {
     #endif
 
     CUresult err;
-    if (cuStreamSynchronize != NULL) {
+    CUstream readback_stream;
+    if (buf && get_readback_stream(user_context, ctx.context, buf, &readback_stream)) {
+        err = cuStreamSynchronize(readback_stream);
+    } else if (cuStreamSynchronize != NULL) {
         CUstream stream;
         int result = halide_cuda_get_stream(user_context, ctx.context, &stream);
         if (result != 0) {
@@ -869,7 +1649,7 @@ WEAK int halide_cuda_run(void *user_context,
     debug(user_context) << "Got module " << mod << "\n";
     halide_assert(user_context, mod);
     CUfunction f;
-    err = cuModuleGetFunction(&f, mod, entry_name);
+    err = get_module_function(loaded_module, entry_name, &f);
     debug(user_context) << "Got function " << f << "\n";
     if (err != CUDA_SUCCESS) {
         error(user_context) << "CUDA: cuModuleGetFunction failed: "
@@ -887,9 +1667,25 @@ WEAK int halide_cuda_run(void *user_context,
     }
 
     // We need storage for both the arg and the pointer to it if if
-    // has to be translated.
-    void** translated_args = (void **)malloc((num_args + 1) * sizeof(void *));
-    uint64_t *dev_handles = (uint64_t *)malloc(num_args * sizeof(uint64_t));
+    // has to be translated. Kernels are often small and launched many
+    // times, so this storage is on the stack unless there are a lot of
+    // args.
+    const size_t max_stack_args = 64;
+    void *stack_translated_args[max_stack_args + 1];
+    uint64_t stack_dev_handles[max_stack_args];
+    void **translated_args = stack_translated_args;
+    uint64_t *dev_handles = stack_dev_handles;
+    bool heap_args = num_args > max_stack_args;
+    if (heap_args) {
+        translated_args = (void **)malloc((num_args + 1) * sizeof(void *));
+        dev_handles = (uint64_t *)malloc(num_args * sizeof(uint64_t));
+        if (translated_args == NULL || dev_handles == NULL) {
+            free(dev_handles);
+            free(translated_args);
+            error(user_context) << "CUDA: Out of memory marshalling the args of " << entry_name << "\n";
+            return halide_error_code_out_of_memory;
+        }
+    }
     for (size_t i = 0; i <= num_args; i++) { // Get NULL at end.
         if (arg_is_buffer[i]) {
             halide_assert(user_context, arg_sizes[i] == sizeof(uint64_t));
@@ -919,15 +1715,48 @@ WEAK int halide_cuda_run(void *user_context,
                          stream,
                          translated_args,
                          NULL);
-    free(dev_handles);
-    free(translated_args);
-    if (err != CUDA_SUCCESS) {
+    if (heap_args) {
+        free(dev_handles);
+        free(translated_args);
+    }
+    if (err == CUDA_ERROR_LAUNCH_OUT_OF_RESOURCES && cuFuncGetAttribute != NULL) {
+        // The usual cause is a block that needs more registers than
+        // the multiprocessor has. Say how many it needs.
+        int regs = 0;
+        cuFuncGetAttribute(&regs, CU_FUNC_ATTRIBUTE_NUM_REGS, f);
+        int threads = threadsX * threadsY * threadsZ;
+        error(user_context) << "CUDA: cuLaunchKernel failed: "
+                            << get_error_name(err) << "\n"
+                            << "Kernel " << entry_name << " uses " << regs
+                            << " registers per thread, or " << regs * threads
+                            << " for a block of " << threads << " threads, and "
+                            << shared_mem_bytes << " bytes of shared memory. "
+                            << "Try using fewer threads per block, or limiting the "
+                            << "registers with Func::gpu_max_registers.";
+        return err;
+    } else if (err != CUDA_SUCCESS) {
         error(user_context) << "CUDA: cuLaunchKernel failed: "
                             << get_error_name(err);
         return err;
     }
 
+    // Buffers the kernel only reads are marked with 2. Code compiled before
+    // that marks all buffers with 1, as if the kernel wrote them.
+    for (size_t i = 0; i < num_args; i++) {
+        if (arg_is_buffer[i] == 1) {
+            record_buffer_write(user_context, ctx.context, stream, (halide_buffer_t *)args[i]);
+        }
+    }
+
     #ifdef DEBUG_RUNTIME
+    if (cuFuncGetAttribute != NULL) {
+        int regs = 0, local_bytes = 0;
+        cuFuncGetAttribute(&regs, CU_FUNC_ATTRIBUTE_NUM_REGS, f);
+        cuFuncGetAttribute(&local_bytes, CU_FUNC_ATTRIBUTE_LOCAL_SIZE_BYTES, f);
+        debug(user_context) << "    Registers per thread: " << regs
+                            << ", local memory per thread: " << local_bytes << " bytes\n";
+    }
+
     err = cuCtxSynchronize();
     if (err != CUDA_SUCCESS) {
         error(user_context) << "CUDA: cuCtxSynchronize failed: "
@@ -940,12 +1769,174 @@ WEAK int halide_cuda_run(void *user_context,
     return 0;
 }
 
+// The host memory of buffers allocated on both the host and the device is
+// page-locked, so that the copies between them are DMA transfers that
+// overlap with the kernels and the host code. The host memory must not be
+// modified while a copy from it to the device may be in flight, until the
+// device is synchronized.
 WEAK int halide_cuda_device_and_host_malloc(void *user_context, struct halide_buffer_t *buf) {
-    return halide_default_device_and_host_malloc(user_context, buf, &cuda_device_interface);
+    debug(user_context)
+        << "CUDA: halide_cuda_device_and_host_malloc (user_context: " << user_context
+        << ", buf: " << buf << ")\n";
+
+    size_t size = buf->size_in_bytes();
+    halide_assert(user_context, size != 0);
+    {
+        Context ctx(user_context);
+        if (ctx.error != CUDA_SUCCESS) {
+            return ctx.error;
+        }
+
+        void *host = NULL;
+        debug(user_context) << "    cuMemAllocHost " << (uint64_t)size << " -> ";
+        CUresult err = cuMemAllocHost(&host, size);
+        if (err != CUDA_SUCCESS) {
+            debug(user_context) << get_error_name(err) << "\n";
+            error(user_context) << "CUDA: cuMemAllocHost failed: "
+                                << get_error_name(err);
+            return err;
+        }
+        debug(user_context) << host << "\n";
+        buf->host = (uint8_t *)host;
+    }
+
+    int result = halide_device_malloc(user_context, buf, &cuda_device_interface);
+    if (result != 0) {
+        Context ctx(user_context);
+        cuMemFreeHost(buf->host);
+        buf->host = NULL;
+    }
+    return result;
+}
+
+WEAK int halide_cuda_device_and_host_malloc_managed(void *user_context, struct halide_buffer_t *buf) {
+    debug(user_context)
+        << "CUDA: halide_cuda_device_and_host_malloc_managed (user_context: " << user_context
+        << ", buf: " << buf << ")\n";
+
+    size_t size = buf->size_in_bytes();
+    halide_assert(user_context, size != 0);
+    halide_assert(user_context, buf->device == 0 && buf->host == NULL);
+
+    {
+        Context ctx(user_context);
+        if (ctx.error != CUDA_SUCCESS) {
+            return ctx.error;
+        }
+
+        if (cuMemAllocManaged != NULL) {
+            CUdeviceptr p = 0;
+            debug(user_context) << "    cuMemAllocManaged " << (uint64_t)size << " -> ";
+            CUresult err = cuMemAllocManaged(&p, size, 1 /* CU_MEM_ATTACH_GLOBAL */);
+            if (err != CUDA_SUCCESS) {
+                debug(user_context) << get_error_name(err) << "\n";
+                error(user_context) << "CUDA: cuMemAllocManaged failed: "
+                                    << get_error_name(err);
+                return err;
+            }
+            debug(user_context) << (void *)p << "\n";
+            buf->device = p;
+            buf->host = (uint8_t *)p;
+            buf->device_interface = &cuda_device_interface;
+            buf->device_interface->impl->use_module();
+            return 0;
+        }
+    }
+
+    // The driver doesn't support managed memory. Use separate host and
+    // device allocations, which halide_cuda_managed_prefetch copies
+    // between.
+    return halide_cuda_device_and_host_malloc(user_context, buf);
+}
+
+WEAK int halide_cuda_managed_prefetch(void *user_context, struct halide_buffer_t *buf,
+                                      int to_device, int64_t begin, int64_t end) {
+    debug(user_context)
+        << "CUDA: halide_cuda_managed_prefetch (user_context: " << user_context
+        << ", buf: " << buf << ", to_device: " << to_device
+        << ", bytes: [" << begin << ", " << end << "))\n";
+
+    if (buf->host != (uint8_t *)buf->device || buf->device == 0) {
+        // Not a managed allocation, so copy it instead.
+        if (to_device) {
+            return halide_copy_to_device(user_context, buf, &cuda_device_interface);
+        } else {
+            return halide_copy_to_host(user_context, buf);
+        }
+    }
+
+    Context ctx(user_context);
+    if (ctx.error != CUDA_SUCCESS) {
+        return ctx.error;
+    }
+
+    CUstream stream = NULL;
+    if (cuStreamSynchronize != NULL) {
+        int result = halide_cuda_get_stream(user_context, ctx.context, &stream);
+        if (result != 0) {
+            error(user_context) << "CUDA: In halide_cuda_managed_prefetch, halide_cuda_get_stream returned " << result << "\n";
+            return result;
+        }
+    }
+
+    int64_t size = buf->size_in_bytes();
+    if (begin < 0) {
+        begin = 0;
+    }
+    if (end < 0 || end > size) {
+        end = size;
+    }
+
+    // Prefetching is only a hint, so failures (e.g. on devices without
+    // concurrent managed access) are ignored.
+    CUdevice dev;
+    if (begin < end && cuMemPrefetchAsync != NULL &&
+        (!to_device || (cuCtxGetDevice != NULL && cuCtxGetDevice(&dev) == CUDA_SUCCESS))) {
+        CUdevice dst = to_device ? dev : -1 /* CU_DEVICE_CPU */;
+        CUresult err = cuMemPrefetchAsync(buf->device + begin, end - begin, dst, stream);
+        if (err != CUDA_SUCCESS) {
+            debug(user_context) << "    cuMemPrefetchAsync failed: " << get_error_name(err) << "\n";
+        }
+    }
+
+    if (to_device) {
+        buf->set_host_dirty(false);
+    } else {
+        // The host may only touch the memory once the kernels using it
+        // are done.
+        CUresult err = cuStreamSynchronize != NULL ? cuStreamSynchronize(stream) : cuCtxSynchronize();
+        if (err != CUDA_SUCCESS) {
+            error(user_context) << "CUDA: synchronization failed: "
+                                << get_error_name(err);
+            return err;
+        }
+        buf->set_device_dirty(false);
+    }
+    return 0;
 }
 
 WEAK int halide_cuda_device_and_host_free(void *user_context, struct halide_buffer_t *buf) {
-    return halide_default_device_and_host_free(user_context, buf, &cuda_device_interface);
+    debug(user_context)
+        << "CUDA: halide_cuda_device_and_host_free (user_context: " << user_context
+        << ", buf: " << buf << ")\n";
+
+    int result = halide_device_free(user_context, buf);
+    if (buf->host) {
+        Context ctx(user_context);
+        if (ctx.error != CUDA_SUCCESS) {
+            return ctx.error;
+        }
+        debug(user_context) << "    cuMemFreeHost " << (void *)buf->host << "\n";
+        CUresult err = cuMemFreeHost(buf->host);
+        buf->host = NULL;
+        if (err != CUDA_SUCCESS && result == 0) {
+            // We may be called as a destructor, so don't raise an error here.
+            result = err;
+        }
+    }
+    buf->set_host_dirty(false);
+    buf->set_device_dirty(false);
+    return result;
 }
 
 WEAK int halide_cuda_wrap_device_ptr(void *user_context, struct halide_buffer_t *buf, uint64_t device_ptr) {
@@ -994,6 +1985,14 @@ namespace {
 __attribute__((destructor))
 WEAK void halide_cuda_cleanup() {
     halide_cuda_device_release(NULL);
+    // Release the contexts of the devices other user_contexts selected.
+    for (int i = 0; i <= max_cuda_devices; i++) {
+        CUcontext ctx;
+        __atomic_load(&contexts[i], &ctx, __ATOMIC_ACQUIRE);
+        if (ctx) {
+            release_cuda_context(NULL, ctx);
+        }
+    }
 }
 }
 
@@ -36,6 +36,11 @@ CUDA_FN_3020(CUresult, cuMemcpyHtoD, cuMemcpyHtoD_v2, (CUdeviceptr dstDevice, co
 CUDA_FN_3020(CUresult, cuMemcpyDtoH, cuMemcpyDtoH_v2, (void *dstHost, CUdeviceptr srcDevice, size_t ByteCount));
 CUDA_FN_3020(CUresult, cuMemcpyDtoD, cuMemcpyDtoD_v2, (CUdeviceptr dstHost, CUdeviceptr srcDevice, size_t ByteCount));
 CUDA_FN_3020(CUresult, cuMemcpy3D, cuMemcpy3D_v2, (const CUDA_MEMCPY3D *pCopy));
+CUDA_FN_3020(CUresult, cuMemcpyHtoDAsync, cuMemcpyHtoDAsync_v2, (CUdeviceptr dstDevice, const void *srcHost, size_t ByteCount, CUstream hStream));
+CUDA_FN_3020(CUresult, cuMemcpyDtoHAsync, cuMemcpyDtoHAsync_v2, (void *dstHost, CUdeviceptr srcDevice, size_t ByteCount, CUstream hStream));
+CUDA_FN_3020(CUresult, cuMemcpyDtoDAsync, cuMemcpyDtoDAsync_v2, (CUdeviceptr dstDevice, CUdeviceptr srcDevice, size_t ByteCount, CUstream hStream));
+CUDA_FN_3020(CUresult, cuMemAllocHost, cuMemAllocHost_v2, (void **pp, size_t bytesize));
+CUDA_FN(CUresult, cuMemFreeHost, (void *p));
 CUDA_FN(CUresult, cuLaunchKernel, (CUfunction f,
                                    unsigned int gridDimX,
                                    unsigned int gridDimY,
@@ -55,6 +60,36 @@ CUDA_FN_4000(CUresult, cuCtxPopCurrent, cuCtxPopCurrent_v2, (CUcontext *pctx));
 CUDA_FN(CUresult, cuPointerGetAttribute, (void *result, int query, CUdeviceptr ptr));
 
 CUDA_FN_OPTIONAL(CUresult, cuStreamSynchronize, (CUstream hStream));
+CUDA_FN_OPTIONAL(CUresult, cuStreamCreate, (CUstream *phStream, unsigned int Flags));
+CUDA_FN_OPTIONAL(CUresult, cuStreamDestroy, (CUstream hStream));
+
+// Used to report register usage when a kernel fails to launch.
+CUDA_FN_OPTIONAL(CUresult, cuFuncGetAttribute, (int *pi, CUfunction_attribute attrib, CUfunction hfunc));
+
+// Used to compile PTX to a cubin that can be cached on disk.
+CUDA_FN_OPTIONAL(CUresult, cuDriverGetVersion, (int *driverVersion));
+CUDA_FN_OPTIONAL(CUresult, cuCtxGetDevice, (CUdevice *device));
+CUDA_FN_OPTIONAL(CUresult, cuLinkCreate_v2, (unsigned int numOptions, CUjit_option *options, void **optionValues, CUlinkState *stateOut));
+CUDA_FN_OPTIONAL(CUresult, cuLinkAddData_v2, (CUlinkState state, CUjitInputType type, void *data, size_t size, const char *name,
+                                              unsigned int numOptions, CUjit_option *options, void **optionValues));
+CUDA_FN_OPTIONAL(CUresult, cuLinkComplete, (CUlinkState state, void **cubinOut, size_t *sizeOut));
+CUDA_FN_OPTIONAL(CUresult, cuLinkDestroy, (CUlinkState state));
+
+// Used for managed memory (the cuda_managed_memory target feature).
+CUDA_FN_OPTIONAL(CUresult, cuMemAllocManaged, (CUdeviceptr *dptr, size_t bytesize, unsigned int flags));
+CUDA_FN_OPTIONAL(CUresult, cuMemPrefetchAsync, (CUdeviceptr devPtr, size_t count, CUdevice dstDevice, CUstream hStream));
+
+// Used for copies between device memory on different contexts.
+CUDA_FN_OPTIONAL(CUresult, cuCtxEnablePeerAccess, (CUcontext peerContext, unsigned int Flags));
+CUDA_FN_OPTIONAL(CUresult, cuMemcpyPeer, (CUdeviceptr dstDevice, CUcontext dstContext, CUdeviceptr srcDevice, CUcontext srcContext, size_t ByteCount));
+CUDA_FN_OPTIONAL(CUresult, cuMemcpyPeerAsync, (CUdeviceptr dstDevice, CUcontext dstContext, CUdeviceptr srcDevice, CUcontext srcContext, size_t ByteCount, CUstream hStream));
+
+// Used to synchronize with the last write to a buffer, rather than with
+// everything on the stream.
+CUDA_FN_OPTIONAL(CUresult, cuEventCreate, (CUevent *phEvent, unsigned int Flags));
+CUDA_FN_OPTIONAL(CUresult, cuEventRecord, (CUevent hEvent, CUstream hStream));
+CUDA_FN_OPTIONAL(CUresult, cuEventDestroy_v2, (CUevent hEvent));
+CUDA_FN_OPTIONAL(CUresult, cuStreamWaitEvent, (CUstream hStream, CUevent hEvent, unsigned int Flags));
 
 #undef CUDA_FN
 #undef CUDA_FN_OPTIONAL
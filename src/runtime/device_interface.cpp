@@ -26,7 +26,245 @@ struct device_handle_wrapper {
 // a copy internaly as well.
 WEAK halide_mutex device_copy_mutex;
 
-WEAK int copy_to_host_already_locked(void *user_context, struct halide_buffer_t *buf) {
+// The bounding boxes of the dirty regions of buffers that have
+// halide_buffer_flag_dirty_region set. An entry only means something
+// while its buffer has that flag set, so stale entries are harmless,
+// and a buffer with the flag set but no entry is treated as entirely
+// dirty. Protected by dirty_regions_lock rather than
+// device_copy_mutex, because buffers are freed without holding the
+// latter.
+#define MAX_DIRTY_REGIONS 64
+#define MAX_DIRTY_REGION_DIMS 16
+
+struct dirty_box {
+    int dimensions;
+    int32_t min[MAX_DIRTY_REGION_DIMS];
+    int32_t extent[MAX_DIRTY_REGION_DIMS];
+};
+
+struct dirty_region {
+    const halide_buffer_t *buf;
+    dirty_box box;
+};
+
+WEAK dirty_region dirty_regions[MAX_DIRTY_REGIONS];
+WEAK volatile int dirty_regions_lock = 0;
+
+WEAK void whole_dirty_box(const halide_buffer_t *buf, dirty_box *box) {
+    box->dimensions = buf->dimensions;
+    for (int i = 0; i < buf->dimensions && i < MAX_DIRTY_REGION_DIMS; i++) {
+        box->min[i] = buf->dim[i].min;
+        box->extent[i] = buf->dim[i].extent;
+    }
+}
+
+// Get the dirty region of a buffer. Returns false if the whole buffer
+// is dirty.
+WEAK bool get_dirty_box(const halide_buffer_t *buf, dirty_box *box) {
+    whole_dirty_box(buf, box);
+    if (!buf->get_flag(halide_buffer_flag_dirty_region)) {
+        return false;
+    }
+    bool found = false;
+    while (__sync_lock_test_and_set(&dirty_regions_lock, 1)) { }
+    for (int i = 0; i < MAX_DIRTY_REGIONS; i++) {
+        if (dirty_regions[i].buf == buf &&
+            dirty_regions[i].box.dimensions == buf->dimensions) {
+            *box = dirty_regions[i].box;
+            found = true;
+            break;
+        }
+    }
+    __sync_lock_release(&dirty_regions_lock);
+    return found;
+}
+
+// Record the dirty region of a buffer. Returns false if there is no
+// room, in which case the whole buffer must be treated as dirty.
+WEAK bool store_dirty_box(const halide_buffer_t *buf, const dirty_box &box) {
+    bool stored = false;
+    while (__sync_lock_test_and_set(&dirty_regions_lock, 1)) { }
+    int slot = -1;
+    for (int i = 0; i < MAX_DIRTY_REGIONS; i++) {
+        if (dirty_regions[i].buf == buf) {
+            slot = i;
+            break;
+        } else if (slot < 0 && dirty_regions[i].buf == NULL) {
+            slot = i;
+        }
+    }
+    if (slot >= 0) {
+        dirty_regions[slot].buf = buf;
+        dirty_regions[slot].box = box;
+        stored = true;
+    }
+    __sync_lock_release(&dirty_regions_lock);
+    return stored;
+}
+
+WEAK void forget_dirty_box(const halide_buffer_t *buf) {
+    while (__sync_lock_test_and_set(&dirty_regions_lock, 1)) { }
+    for (int i = 0; i < MAX_DIRTY_REGIONS; i++) {
+        if (dirty_regions[i].buf == buf) {
+            dirty_regions[i].buf = NULL;
+        }
+    }
+    __sync_lock_release(&dirty_regions_lock);
+}
+
+// Intersect a box with a region given as an array of
+// halide_dimension_t. Returns false if the result is empty.
+WEAK bool intersect_dirty_box(dirty_box *box, const halide_dimension_t *region) {
+    bool nonempty = true;
+    for (int i = 0; i < box->dimensions; i++) {
+        int32_t lo = max(box->min[i], region[i].min);
+        int32_t hi = min(box->min[i] + box->extent[i], region[i].min + region[i].extent);
+        box->min[i] = lo;
+        box->extent[i] = hi > lo ? hi - lo : 0;
+        nonempty = nonempty && hi > lo;
+    }
+    return nonempty;
+}
+
+WEAK bool dirty_box_contains(const dirty_box &outer, const dirty_box &inner) {
+    for (int i = 0; i < outer.dimensions; i++) {
+        if (inner.min[i] > outer.min[i] ||
+            inner.min[i] + inner.extent[i] < outer.min[i] + outer.extent[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Remove a box that has just been copied from the dirty region, which
+// it must lie within. The dirty region is only a box, so this only
+// shrinks it when the copied box spans all of it but one dimension, and
+// lies at one end of that dimension. Returns false if the dirty region
+// didn't change.
+WEAK bool shrink_dirty_box(dirty_box *dirty, const dirty_box &copied) {
+    int d = -1;
+    for (int i = 0; i < dirty->dimensions; i++) {
+        if (copied.min[i] != dirty->min[i] || copied.extent[i] != dirty->extent[i]) {
+            if (d >= 0) {
+                return false;
+            }
+            d = i;
+        }
+    }
+    if (d < 0) {
+        return false;
+    }
+    int32_t end = dirty->min[d] + dirty->extent[d];
+    if (copied.min[d] == dirty->min[d]) {
+        dirty->min[d] += copied.extent[d];
+        dirty->extent[d] = end - dirty->min[d];
+        return true;
+    } else if (copied.min[d] + copied.extent[d] == end) {
+        dirty->extent[d] = copied.min[d] - dirty->min[d];
+        return true;
+    }
+    return false;
+}
+
+// Copy a box of a buffer between the host and the device, via a
+// cropped view of its device allocation.
+WEAK int copy_dirty_box(void *user_context, struct halide_buffer_t *buf,
+                        const halide_device_interface_t *interface,
+                        bool to_host, const dirty_box &box) {
+    halide_dimension_t crop_dims[MAX_DIRTY_REGION_DIMS];
+    halide_buffer_t crop = *buf;
+    crop.dim = crop_dims;
+    crop.device = 0;
+    crop.device_interface = NULL;
+    crop.flags = 0;
+    int64_t offset = 0;
+    for (int i = 0; i < buf->dimensions; i++) {
+        crop_dims[i] = buf->dim[i];
+        crop_dims[i].min = box.min[i];
+        crop_dims[i].extent = box.extent[i];
+        offset += (int64_t)(box.min[i] - buf->dim[i].min) * buf->dim[i].stride;
+    }
+    crop.host = buf->host + offset * buf->type.bytes();
+
+    interface->impl->use_module();
+    int result = interface->impl->device_crop(user_context, buf, &crop);
+    if (result == 0) {
+        if (to_host) {
+            crop.set_device_dirty(true);
+            result = interface->impl->copy_to_host(user_context, &crop);
+            if (result == 0) {
+                halide_msan_annotate_buffer_is_initialized(user_context, &crop);
+            }
+        } else {
+            crop.set_host_dirty(true);
+            result = interface->impl->copy_to_device(user_context, &crop);
+        }
+        int release_result = interface->impl->device_release_crop(user_context, &crop);
+        if (result == 0) {
+            result = release_result;
+        }
+    }
+    interface->impl->release_module();
+    return result;
+}
+
+// Copy the part of the dirty region of a buffer that lies within
+// 'region' (or all of it, if region is NULL) to the host or the
+// device, and update the dirty state to match. The caller has checked
+// the buffer is dirty on the other side and has a device allocation.
+WEAK int copy_dirty_region_already_locked(void *user_context, struct halide_buffer_t *buf,
+                                          const halide_device_interface_t *interface,
+                                          bool to_host, const halide_dimension_t *region) {
+    dirty_box dirty;
+    bool partial = get_dirty_box(buf, &dirty);
+    dirty_box box = dirty;
+    if (region && !intersect_dirty_box(&box, region)) {
+        return 0;
+    }
+
+    bool whole = !partial && dirty_box_contains(box, dirty);
+    if (whole ||
+        buf->dimensions > MAX_DIRTY_REGION_DIMS ||
+        interface->impl->device_crop == halide_default_device_crop) {
+        // Nothing to gain, or no way to copy less than everything.
+        int result = to_host ?
+            interface->impl->copy_to_host(user_context, buf) :
+            interface->impl->copy_to_device(user_context, buf);
+        if (result == 0) {
+            if (to_host) {
+                buf->set_device_dirty(false);
+                halide_msan_annotate_buffer_is_initialized(user_context, buf);
+            } else {
+                buf->set_host_dirty(false);
+            }
+            forget_dirty_box(buf);
+        }
+        return result;
+    }
+
+    debug(user_context) << "copy_dirty_region_already_locked " << buf
+                        << (to_host ? " to host" : " to device") << "\n";
+    int result = copy_dirty_box(user_context, buf, interface, to_host, box);
+    if (result != 0) {
+        return result;
+    }
+
+    if (dirty_box_contains(box, dirty)) {
+        // All of the dirty region has been copied.
+        if (to_host) {
+            buf->set_device_dirty(false);
+        } else {
+            buf->set_host_dirty(false);
+        }
+        forget_dirty_box(buf);
+    } else if (shrink_dirty_box(&dirty, box) && store_dirty_box(buf, dirty)) {
+        buf->set_flag(halide_buffer_flag_dirty_region, true);
+    }
+    return 0;
+}
+
+WEAK int copy_to_host_already_locked(void *user_context, struct halide_buffer_t *buf,
+                                     const halide_dimension_t *region = NULL) {
     if (!buf->device_dirty()) {
         return 0;  // my, that was easy
     }
@@ -41,6 +279,14 @@ WEAK int copy_to_host_already_locked(void *user_context, struct halide_buffer_t
         debug(user_context) << "copy_to_host_already_locked " << buf << " interface is NULL\n";
         return halide_error_code_no_device_interface;
     }
+    if (region || buf->get_flag(halide_buffer_flag_dirty_region)) {
+        int result = copy_dirty_region_already_locked(user_context, buf, interface, true, region);
+        if (result != 0) {
+            debug(user_context) << "copy_to_host_already_locked " << buf << " copying the dirty region returned an error\n";
+            return halide_error_code_copy_to_host_failed;
+        }
+        return 0;
+    }
     int result = interface->impl->copy_to_host(user_context, buf);
     if (result != 0) {
         debug(user_context) << "copy_to_host_already_locked " << buf << " device copy_to_host returned an error\n";
@@ -123,7 +369,8 @@ WEAK int halide_copy_to_host(void *user_context, struct halide_buffer_t *buf) {
  * called directly; Halide handles copying to the device automatically. */
 WEAK int copy_to_device_already_locked(void *user_context,
                                        struct halide_buffer_t *buf,
-                                       const halide_device_interface_t *device_interface) {
+                                       const halide_device_interface_t *device_interface,
+                                       const halide_dimension_t *region = NULL) {
     int result = 0;
 
     result = debug_log_and_validate_buf(user_context, buf, "halide_copy_to_device");
@@ -151,6 +398,12 @@ WEAK int copy_to_device_already_locked(void *user_context,
                                 << " halide_copy_to_device call to halide_device_malloc failed\n";
             return result;
         }
+        // The new allocation needs all of the host data, not just
+        // the dirty region.
+        if (buf->get_flag(halide_buffer_flag_dirty_region)) {
+            buf->set_host_dirty(true);
+        }
+        region = NULL;
     }
 
     if (buf->host_dirty()) {
@@ -158,6 +411,13 @@ WEAK int copy_to_device_already_locked(void *user_context,
         if (buf->device_dirty()) {
             debug(user_context) << "halide_copy_to_device " << buf << " dev_dirty is true error\n";
             return halide_error_code_copy_to_device_failed;
+        } else if (region || buf->get_flag(halide_buffer_flag_dirty_region)) {
+            result = copy_dirty_region_already_locked(user_context, buf, device_interface, false, region);
+            if (result != 0) {
+                debug(user_context) << "halide_copy_to_device "
+                                    << buf << " copying the dirty region returned an error\n";
+                return halide_error_code_copy_to_device_failed;
+            }
         } else {
             result = device_interface->impl->copy_to_device(user_context, buf);
             if (result == 0) {
@@ -180,6 +440,97 @@ WEAK int halide_copy_to_device(void *user_context,
     return copy_to_device_already_locked(user_context, buf, device_interface);
 }
 
+WEAK int halide_copy_to_host_region(void *user_context, struct halide_buffer_t *buf,
+                                    const halide_dimension_t *region) {
+    ScopedMutexLock lock(&device_copy_mutex);
+
+    int result = debug_log_and_validate_buf(user_context, buf, "halide_copy_to_host_region");
+    if (result != 0) {
+        return result;
+    }
+
+    return copy_to_host_already_locked(user_context, buf, region);
+}
+
+WEAK int halide_copy_to_device_region(void *user_context, struct halide_buffer_t *buf,
+                                      const halide_device_interface_t *device_interface,
+                                      const halide_dimension_t *region) {
+    ScopedMutexLock lock(&device_copy_mutex);
+    return copy_to_device_already_locked(user_context, buf, device_interface, region);
+}
+
+}  // extern "C" linkage
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+WEAK int set_dirty_region(void *user_context, struct halide_buffer_t *buf,
+                          const halide_dimension_t *region, bool on_device) {
+    ScopedMutexLock lock(&device_copy_mutex);
+
+    int result = debug_log_and_validate_buf(user_context, buf,
+                                            on_device ?
+                                            "halide_buffer_set_device_dirty_region" :
+                                            "halide_buffer_set_host_dirty_region");
+    if (result != 0) {
+        return result;
+    }
+
+    halide_buffer_flags flag = on_device ? halide_buffer_flag_device_dirty : halide_buffer_flag_host_dirty;
+    halide_buffer_flags other_flag = on_device ? halide_buffer_flag_host_dirty : halide_buffer_flag_device_dirty;
+    if (buf->get_flag(other_flag)) {
+        return halide_error_host_and_device_dirty(user_context);
+    }
+
+    bool already_dirty = buf->get_flag(flag);
+    bool already_partial = already_dirty && buf->get_flag(halide_buffer_flag_dirty_region);
+    if (region == NULL ||
+        buf->dimensions > MAX_DIRTY_REGION_DIMS ||
+        (already_dirty && !already_partial)) {
+        // The whole buffer is dirty.
+        buf->set_flag(flag, true);
+        buf->set_flag(halide_buffer_flag_dirty_region, false);
+        return 0;
+    }
+
+    dirty_box box;
+    whole_dirty_box(buf, &box);
+    if (!intersect_dirty_box(&box, region)) {
+        return 0;
+    }
+
+    if (already_partial) {
+        dirty_box old;
+        if (!get_dirty_box(buf, &old)) {
+            // Lost track of it, so the whole buffer stays dirty.
+            return 0;
+        }
+        for (int i = 0; i < box.dimensions; i++) {
+            int32_t lo = min(box.min[i], old.min[i]);
+            int32_t hi = max(box.min[i] + box.extent[i], old.min[i] + old.extent[i]);
+            box.min[i] = lo;
+            box.extent[i] = hi - lo;
+        }
+    }
+
+    buf->set_flag(flag, true);
+    buf->set_flag(halide_buffer_flag_dirty_region, store_dirty_box(buf, box));
+    return 0;
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+extern "C" {
+
+WEAK int halide_buffer_set_device_dirty_region(void *user_context, struct halide_buffer_t *buf,
+                                               const halide_dimension_t *region) {
+    return set_dirty_region(user_context, buf, region, true);
+}
+
+WEAK int halide_buffer_set_host_dirty_region(void *user_context, struct halide_buffer_t *buf,
+                                             const halide_dimension_t *region) {
+    return set_dirty_region(user_context, buf, region, false);
+}
+
 /** Wait for current GPU operations to complete. Calling this explicitly
  * should rarely be necessary, except maybe for profiling. */
 WEAK int halide_device_sync(void *user_context, struct halide_buffer_t *buf) {
@@ -244,6 +595,7 @@ WEAK int halide_device_free(void *user_context, struct halide_buffer_t *buf) {
         device_interface->impl->use_module();
         result = device_interface->impl->device_free(user_context, buf);
         device_interface->impl->release_module();
+        forget_dirty_box(buf);
         halide_assert(user_context, buf->device == 0);
         if (result) {
             return halide_error_code_device_free_failed;
@@ -309,6 +661,7 @@ WEAK int halide_device_and_host_free(void *user_context, struct halide_buffer_t
         device_interface->impl->use_module();
         result = device_interface->impl->device_and_host_free(user_context, buf);
         device_interface->impl->release_module();
+        forget_dirty_box(buf);
         halide_assert(user_context, buf->device == 0);
         if (result) {
             return halide_error_code_device_free_failed;
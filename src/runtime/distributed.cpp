@@ -0,0 +1,46 @@
+#include "HalideRuntime.h"
+
+// The rank of this process and the number of processes taking part in
+// a distributed pipeline. Loops over Vars that are scheduled with
+// Func::distribute only run over this rank's slice. The default
+// transport is a world of just one rank, which makes the distributed
+// loops run in full.
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+WEAK int default_distributed_rank(void *user_context) {
+    return 0;
+}
+
+WEAK int default_distributed_num_ranks(void *user_context) {
+    return 1;
+}
+
+WEAK halide_distributed_transport_t default_distributed_transport = {
+    default_distributed_rank,
+    default_distributed_num_ranks
+};
+
+WEAK const halide_distributed_transport_t *custom_distributed_transport = &default_distributed_transport;
+
+}}} // namespace Halide::Runtime::Internal
+
+using namespace Halide::Runtime::Internal;
+
+extern "C" {
+
+WEAK int halide_distributed_rank(void *user_context) {
+    return custom_distributed_transport->rank(user_context);
+}
+
+WEAK int halide_distributed_num_ranks(void *user_context) {
+    return custom_distributed_transport->num_ranks(user_context);
+}
+
+WEAK const halide_distributed_transport_t *halide_set_custom_distributed_transport(const halide_distributed_transport_t *transport) {
+    const halide_distributed_transport_t *result = custom_distributed_transport;
+    custom_distributed_transport = transport ? transport : &default_distributed_transport;
+    return result;
+}
+
+}
@@ -0,0 +1,17 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+// Hardware performance counters for the profiler, on platforms where
+// we can't read them.
+
+extern "C" {
+
+WEAK int halide_perf_counters_open() {
+    return 0;
+}
+
+WEAK int halide_perf_counters_read(uint64_t *values) {
+    return 0;
+}
+
+}
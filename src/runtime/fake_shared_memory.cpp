@@ -0,0 +1,26 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+// Shared memory segments for the memoization cache, on platforms
+// where we don't support them. The shared tier is always off.
+
+extern "C" {
+
+WEAK int halide_shared_memory_open(const char *name) {
+    return -1;
+}
+
+WEAK void *halide_shared_memory_map(int handle, size_t *size) {
+    return NULL;
+}
+
+WEAK void halide_shared_memory_lock(int handle) {
+}
+
+WEAK void halide_shared_memory_unlock(int handle) {
+}
+
+WEAK void halide_shared_memory_close(int handle, void *base, size_t size) {
+}
+
+}
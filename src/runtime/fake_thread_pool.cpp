@@ -76,4 +76,40 @@ WEAK int halide_do_par_for(void *user_context, halide_task_t f,
   return (*custom_do_par_for)(user_context, f, min, size, closure);
 }
 
+// Without threads, a fork runs the producer (task 0) to completion
+// before the consumer. That works unless the producer has to wait for
+// the consumer, in which case acquiring the semaphore fails rather
+// than waiting forever.
+WEAK int halide_do_fork(void *user_context, halide_task_t f, uint8_t *closure) {
+    int result = halide_do_task(user_context, f, 0, closure);
+    if (result) {
+        return result;
+    }
+    return halide_do_task(user_context, f, 1, closure);
+}
+
+WEAK int halide_semaphore_init(halide_semaphore_t *sem, int n) {
+    sem->_private[0] = n;
+    return n;
+}
+
+WEAK int halide_semaphore_release(halide_semaphore_t *sem, int n) {
+    sem->_private[0] += n;
+    return (int)sem->_private[0];
+}
+
+WEAK int halide_semaphore_acquire(halide_semaphore_t *sem, int n) {
+    if ((int64_t)sem->_private[0] < n) {
+        halide_error(NULL, "Func::async needs a thread pool to run a producer ahead "
+                     "of a consumer that frees its folded storage.");
+        return halide_error_code_generic_error;
+    }
+    sem->_private[0] -= n;
+    return 0;
+}
+
+WEAK void halide_semaphore_unblock(void *user_context, halide_semaphore_t *sem) {
+    sem->_private[0] = 0x3fffffff;
+}
+
 }  // extern "C"
@@ -17,8 +17,11 @@ extern void dispatch_async_f(dispatch_queue_t queue, void *context, void (*work)
 
 typedef struct dispatch_semaphore_s *dispatch_semaphore_t;
 typedef uint64_t dispatch_time_t;
+#define DISPATCH_TIME_NOW (0ull)
 #define DISPATCH_TIME_FOREVER (~0ull)
 
+extern dispatch_time_t dispatch_time(dispatch_time_t when, int64_t delta);
+
 extern dispatch_semaphore_t dispatch_semaphore_create(long value);
 extern long dispatch_semaphore_wait(dispatch_semaphore_t dsema, dispatch_time_t timeout);
 extern long dispatch_semaphore_signal(dispatch_semaphore_t dsema);
@@ -89,6 +92,11 @@ WEAK void halide_do_gcd_task(void *job, size_t idx) {
                                     j->closure);
 }
 
+// Run the producer half of a halide_do_fork.
+WEAK void halide_do_gcd_fork_task(void *job) {
+    halide_do_gcd_task(job, 0);
+}
+
 }}}  // namespace Halide::Runtime::Internal
 
 extern "C" {
@@ -187,4 +195,102 @@ WEAK int halide_do_par_for(void *user_context, halide_task_t f,
   return (*custom_do_par_for)(user_context, f, min, size, closure);
 }
 
+// Spawned threads run on GCD's global queue, which adds threads when
+// the ones it has are blocked, so the producer always gets to run.
+WEAK int halide_do_fork(void *user_context, halide_task_t f, uint8_t *closure) {
+    halide_gcd_job job;
+    job.f = f;
+    job.user_context = user_context;
+    job.closure = closure;
+    job.min = 0;
+    job.exit_status = 0;
+
+    halide_thread *producer = halide_spawn_thread(halide_do_gcd_fork_task, &job);
+    int result = halide_do_task(user_context, f, 1, closure);
+    halide_join_thread(producer);
+    return job.exit_status ? job.exit_status : result;
+}
+
+}  // extern "C"
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// GCD has no condition variables, so threads waiting on a
+// halide_semaphore_t sleep on one of a fixed set of dispatch
+// semaphores, picked by address and created once. The first word of a
+// halide_semaphore_t is its count, and the second is the number of
+// threads waiting on it.
+#define GCD_SEMAPHORE_WAKEUPS 64
+
+WEAK dispatch_once_t semaphore_wakeups_once = 0;
+WEAK dispatch_semaphore_t semaphore_wakeups[GCD_SEMAPHORE_WAKEUPS];
+
+WEAK void init_semaphore_wakeups(void *) {
+    for (int i = 0; i < GCD_SEMAPHORE_WAKEUPS; i++) {
+        semaphore_wakeups[i] = dispatch_semaphore_create(0);
+    }
+}
+
+__attribute__((always_inline)) dispatch_semaphore_t semaphore_wakeup(halide_semaphore_t *sem) {
+    dispatch_once_f(&semaphore_wakeups_once, NULL, init_semaphore_wakeups);
+    return semaphore_wakeups[((uintptr_t)sem / sizeof(halide_semaphore_t)) % GCD_SEMAPHORE_WAKEUPS];
+}
+
+// Wake every thread waiting on sem. Unrelated semaphores can share a
+// wakeup, so a waiter may take a signal meant for another one; the
+// timeout in halide_semaphore_acquire bounds how long that can delay it.
+WEAK void wake_semaphore_waiters(halide_semaphore_t *sem) {
+    int waiters = __atomic_load_n((int *)sem->_private + 1, __ATOMIC_SEQ_CST);
+    if (waiters > 0) {
+        dispatch_semaphore_t wakeup = semaphore_wakeup(sem);
+        for (int i = 0; i < waiters; i++) {
+            dispatch_semaphore_signal(wakeup);
+        }
+    }
+}
+
+}}}  // namespace Halide::Runtime::Internal
+
+extern "C" {
+
+WEAK int halide_semaphore_init(halide_semaphore_t *sem, int n) {
+    __atomic_store_n((int *)sem->_private + 1, 0, __ATOMIC_RELAXED);
+    __atomic_store_n((int *)sem->_private, n, __ATOMIC_RELEASE);
+    return n;
+}
+
+WEAK int halide_semaphore_release(halide_semaphore_t *sem, int n) {
+    int result = __atomic_add_fetch((int *)sem->_private, n, __ATOMIC_SEQ_CST);
+    wake_semaphore_waiters(sem);
+    return result;
+}
+
+WEAK int halide_semaphore_acquire(halide_semaphore_t *sem, int n) {
+    int *count = (int *)sem->_private;
+    int *waiters = count + 1;
+    while (true) {
+        int old = __atomic_load_n(count, __ATOMIC_ACQUIRE);
+        if (old >= n) {
+            if (__atomic_compare_exchange_n(count, &old, old - n, true,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                return 0;
+            }
+            continue;
+        }
+        // Register as a waiter before checking the count again, so
+        // that a release either sees us or we see it.
+        __atomic_add_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(count, __ATOMIC_SEQ_CST) < n) {
+            dispatch_semaphore_wait(semaphore_wakeup(sem),
+                                    dispatch_time(DISPATCH_TIME_NOW, 1000000));
+        }
+        __atomic_sub_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+WEAK void halide_semaphore_unblock(void *user_context, halide_semaphore_t *sem) {
+    __atomic_store_n((int *)sem->_private, 0x3fffffff, __ATOMIC_SEQ_CST);
+    wake_semaphore_waiters(sem);
+}
+
 }
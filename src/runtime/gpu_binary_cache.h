@@ -0,0 +1,172 @@
+#ifndef HALIDE_RUNTIME_GPU_BINARY_CACHE_H
+#define HALIDE_RUNTIME_GPU_BINARY_CACHE_H
+
+#include "HalideRuntime.h"
+#include "printer.h"
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// An on-disk cache of the device binaries the GPU runtimes compile from
+// the kernel sources embedded in a pipeline (cubins from PTX, OpenCL
+// program binaries from OpenCL C), so that a process doesn't have to
+// compile them again when it starts. It's enabled by setting
+// HL_GPU_KERNEL_CACHE_DIR to an existing directory. Binaries are keyed
+// by a hash of the source and of the compile options, and by a hash of
+// the device and driver they were compiled for. Failures to read or
+// write the cache just mean the kernels are compiled as usual.
+
+struct gpu_binary_key {
+    uint64_t source_hash;
+    uint64_t source_size;
+    uint64_t device_hash;
+};
+
+#define GPU_BINARY_CACHE_DIR_MAX 1024
+WEAK char gpu_binary_cache_dir[GPU_BINARY_CACHE_DIR_MAX];
+WEAK bool gpu_binary_cache_dir_inited = false;
+WEAK volatile int gpu_binary_cache_lock = 0;
+
+const uint32_t GPU_BINARY_CACHE_MAGIC = 0x4348474b;  // "KGHC"
+const uint32_t GPU_BINARY_CACHE_VERSION = 1;
+
+struct gpu_binary_header {
+    uint32_t magic;
+    uint32_t version;
+    gpu_binary_key key;
+    uint64_t binary_size;
+};
+
+// FNV-1a, continuing from the hash 'h' (use gpu_binary_hash_init to start).
+const uint64_t gpu_binary_hash_init = 0xcbf29ce484222325ULL;
+WEAK uint64_t gpu_binary_hash(uint64_t h, const void *data, size_t size) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+WEAK uint64_t gpu_binary_hash(uint64_t h, const char *str) {
+    return gpu_binary_hash(h, str, strlen(str));
+}
+
+// Returns the cache directory, or NULL if the cache is disabled.
+WEAK const char *get_gpu_binary_cache_dir() {
+    while (__sync_lock_test_and_set(&gpu_binary_cache_lock, 1)) { }
+    if (!gpu_binary_cache_dir_inited) {
+        const char *dir = getenv("HL_GPU_KERNEL_CACHE_DIR");
+        gpu_binary_cache_dir[0] = 0;
+        if (dir) {
+            strncpy(gpu_binary_cache_dir, dir, GPU_BINARY_CACHE_DIR_MAX - 1);
+            gpu_binary_cache_dir[GPU_BINARY_CACHE_DIR_MAX - 1] = 0;
+        }
+        gpu_binary_cache_dir_inited = true;
+    }
+    __sync_lock_release(&gpu_binary_cache_lock);
+    return gpu_binary_cache_dir[0] ? gpu_binary_cache_dir : NULL;
+}
+
+// Write the file name of a binary into buf. Returns false if it doesn't
+// fit.
+WEAK bool gpu_binary_file_name(char *buf, size_t buf_size, const char *dir,
+                               const char *prefix, const gpu_binary_key &key) {
+    uint64_t h = gpu_binary_hash(gpu_binary_hash_init, &key, sizeof(key));
+    char *end = buf + buf_size;
+    char *dst = halide_string_to_string(buf, end, dir);
+    dst = halide_string_to_string(dst, end, "/");
+    dst = halide_string_to_string(dst, end, prefix);
+    for (int i = 60; i >= 0; i -= 4) {
+        char str[2] = {"0123456789abcdef"[(h >> i) & 0xf], 0};
+        dst = halide_string_to_string(dst, end, str);
+    }
+    dst = halide_string_to_string(dst, end, ".bin");
+    return dst < end - 1;
+}
+
+// Look up a binary in the cache. On success, returns true and a binary
+// allocated with malloc, which the caller must free.
+WEAK bool load_gpu_binary(void *user_context, const char *prefix, const gpu_binary_key &key,
+                          void **binary, size_t *binary_size) {
+    const char *dir = get_gpu_binary_cache_dir();
+    if (!dir) {
+        return false;
+    }
+    char path[GPU_BINARY_CACHE_DIR_MAX + 64];
+    if (!gpu_binary_file_name(path, sizeof(path), dir, prefix, key)) {
+        return false;
+    }
+    void *f = fopen(path, "rb");
+    if (!f) {
+        return false;
+    }
+
+    void *result = NULL;
+    gpu_binary_header header;
+    if (fread(&header, 1, sizeof(header), f) == sizeof(header) &&
+        header.magic == GPU_BINARY_CACHE_MAGIC &&
+        header.version == GPU_BINARY_CACHE_VERSION &&
+        header.key.source_hash == key.source_hash &&
+        header.key.source_size == key.source_size &&
+        header.key.device_hash == key.device_hash &&
+        header.binary_size > 0) {
+        result = malloc(header.binary_size);
+        if (result && fread(result, 1, header.binary_size, f) != header.binary_size) {
+            free(result);
+            result = NULL;
+        }
+    }
+    fclose(f);
+
+    if (result) {
+        debug(user_context) << "    Loaded GPU kernel binary from " << path << "\n";
+        *binary = result;
+        *binary_size = header.binary_size;
+    }
+    return result != NULL;
+}
+
+// Write a binary to the cache. It's written under a temporary name and
+// then renamed into place, so other processes never see a partial file.
+WEAK void store_gpu_binary(void *user_context, const char *prefix, const gpu_binary_key &key,
+                           const void *binary, size_t binary_size) {
+    const char *dir = get_gpu_binary_cache_dir();
+    if (!dir || binary_size == 0) {
+        return;
+    }
+    char path[GPU_BINARY_CACHE_DIR_MAX + 64];
+    if (!gpu_binary_file_name(path, sizeof(path), dir, prefix, key)) {
+        return;
+    }
+    char tmp_path[GPU_BINARY_CACHE_DIR_MAX + 96];
+    char *end = tmp_path + sizeof(tmp_path);
+    char *dst = halide_string_to_string(tmp_path, end, path);
+    dst = halide_string_to_string(dst, end, ".");
+    // Something unique to this store to keep concurrent writers apart.
+    dst = halide_uint64_to_string(dst, end, (uint64_t)binary ^ (uint64_t)halide_current_time_ns(user_context), 1);
+    dst = halide_string_to_string(dst, end, ".tmp");
+    if (dst >= end - 1) {
+        return;
+    }
+
+    void *f = fopen(tmp_path, "wb");
+    if (!f) {
+        return;
+    }
+    gpu_binary_header header;
+    header.magic = GPU_BINARY_CACHE_MAGIC;
+    header.version = GPU_BINARY_CACHE_VERSION;
+    header.key = key;
+    header.binary_size = binary_size;
+    bool ok = (fwrite(&header, 1, sizeof(header), f) == sizeof(header) &&
+               fwrite(binary, 1, binary_size, f) == binary_size);
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp_path, path) != 0) {
+        remove(tmp_path);
+    } else {
+        debug(user_context) << "    Stored GPU kernel binary to " << path << "\n";
+    }
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+#endif // HALIDE_RUNTIME_GPU_BINARY_CACHE_H
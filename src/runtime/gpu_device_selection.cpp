@@ -8,6 +8,16 @@ WEAK int halide_gpu_device = 0;
 WEAK int halide_gpu_device_lock = 0;
 WEAK bool halide_gpu_device_initialized = false;
 
+// Devices selected for particular user_contexts, so that several instances
+// of a pipeline can run on different devices at the same time.
+const int max_user_context_devices = 16;
+struct user_context_device {
+    void *user_context;
+    int device;
+};
+WEAK user_context_device user_context_devices[max_user_context_devices];
+WEAK int user_context_device_count = 0;
+
 }}} // namespace Halide::Runtime::Internal
 
 extern int atoi(const char *);
@@ -19,8 +29,37 @@ WEAK void halide_set_gpu_device(int d) {
     halide_gpu_device = d;
     halide_gpu_device_initialized = true;
 }
+WEAK int halide_set_gpu_device_for_user_context(void *user_context, int d) {
+    ScopedSpinLock lock(&halide_gpu_device_lock);
+    for (int i = 0; i < user_context_device_count; i++) {
+        if (user_context_devices[i].user_context == user_context) {
+            if (d == -1) {
+                user_context_devices[i] = user_context_devices[--user_context_device_count];
+            } else {
+                user_context_devices[i].device = d;
+            }
+            return 0;
+        }
+    }
+    if (d == -1) {
+        return 0;
+    }
+    if (user_context_device_count == max_user_context_devices) {
+        return -1;
+    }
+    user_context_devices[user_context_device_count].user_context = user_context;
+    user_context_devices[user_context_device_count].device = d;
+    user_context_device_count++;
+    return 0;
+}
+
 WEAK int halide_get_gpu_device(void *user_context) {
     ScopedSpinLock lock(&halide_gpu_device_lock);
+    for (int i = 0; i < user_context_device_count; i++) {
+        if (user_context_devices[i].user_context == user_context) {
+            return user_context_devices[i].device;
+        }
+    }
     if (!halide_gpu_device_initialized) {
         const char *var = getenv("HL_GPU_DEVICE");
         if (var) {
@@ -29,6 +29,9 @@ typedef int (*remote_get_symbol_fn)(halide_hexagon_handle_t, const char*, int, h
 typedef int (*remote_run_fn)(halide_hexagon_handle_t, int,
                              const remote_buffer*, int, const remote_buffer*, int,
                              remote_buffer*, int);
+typedef int (*remote_run_batch_fn)(const halide_hexagon_handle_t*, int, const int*, int,
+                                   const remote_buffer*, int, remote_buffer*, int,
+                                   const uint64_t*, int);
 typedef int (*remote_release_library_fn)(halide_hexagon_handle_t);
 typedef int (*remote_poll_log_fn)(char *, int, int *);
 typedef void (*remote_poll_profiler_state_fn)(int *, int *);
@@ -43,6 +46,7 @@ typedef void (*host_free_fn)(void *);
 WEAK remote_load_library_fn remote_load_library = NULL;
 WEAK remote_get_symbol_fn remote_get_symbol = NULL;
 WEAK remote_run_fn remote_run = NULL;
+WEAK remote_run_batch_fn remote_run_batch = NULL;
 WEAK remote_release_library_fn remote_release_library = NULL;
 WEAK remote_poll_log_fn remote_poll_log = NULL;
 WEAK remote_poll_profiler_state_fn remote_poll_profiler_state = NULL;
@@ -143,6 +147,9 @@ WEAK int init_hexagon_runtime(void *user_context) {
     get_symbol(user_context, host_lib, "halide_hexagon_remote_poll_log", remote_poll_log, /* required */ false);
     get_symbol(user_context, host_lib, "halide_hexagon_remote_poll_profiler_state", remote_poll_profiler_state, /* required */ false);
 
+    // If this is unavailable, batches are run one pipeline at a time.
+    get_symbol(user_context, host_lib, "halide_hexagon_remote_run_batch", remote_run_batch, /* required */ false);
+
     // If these are unavailable, then the runtime always powers HVX on and so these are not necessary.
     get_symbol(user_context, host_lib, "halide_hexagon_remote_power_hvx_on", remote_power_hvx_on, /* required */ false);
     get_symbol(user_context, host_lib, "halide_hexagon_remote_power_hvx_off", remote_power_hvx_off, /* required */ false);
@@ -165,6 +172,281 @@ struct module_state {
 WEAK module_state *state_list = NULL;
 WEAK halide_hexagon_handle_t shared_runtime = 0;
 
+// Automatic performance votes. While a mode is set with
+// halide_hexagon_set_auto_performance_mode, we vote for it (and power
+// HVX on) before running a pipeline, but only drop the vote once no
+// pipeline has run for the hold time, so that pipelines that run in
+// quick succession don't repeatedly ramp the clocks down and back up.
+// The vote is dropped by a thread that sleeps out the hold time, and
+// that only exists while the vote is held and nothing is running.
+// All of this is protected by power_vote_lock.
+WEAK halide_mutex power_vote_lock = { { 0 } };
+WEAK halide_hexagon_power_mode_t auto_power_mode = halide_hexagon_power_default;
+WEAK int auto_power_hold_ms = 0;
+WEAK bool power_voted = false;
+WEAK bool power_voted_hvx = false;
+WEAK int power_vote_runs = 0;
+WEAK uint64_t power_vote_last_end = 0;
+WEAK halide_thread *power_vote_thread = NULL;
+WEAK bool power_vote_thread_running = false;
+
+// Vote for the automatic mode. Must be called with power_vote_lock held.
+WEAK void cast_power_vote_already_locked(void *user_context) {
+    if (!power_voted_hvx && remote_power_hvx_on) {
+        power_voted_hvx = remote_power_hvx_on() == 0;
+    }
+    if (remote_set_performance_mode) {
+        debug(user_context) << "    remote_set_performance_mode(" << auto_power_mode << ") -> ";
+        int result = remote_set_performance_mode(auto_power_mode);
+        debug(user_context) << "        " << result << "\n";
+    }
+    power_voted = true;
+}
+
+// Return to the default performance state. Must be called with
+// power_vote_lock held.
+WEAK void drop_power_vote_already_locked(void *user_context) {
+    if (!power_voted) return;
+    if (remote_set_performance_mode) {
+        debug(user_context) << "    remote_set_performance_mode(default) -> ";
+        int result = remote_set_performance_mode(halide_hexagon_power_default);
+        debug(user_context) << "        " << result << "\n";
+    }
+    if (power_voted_hvx && remote_power_hvx_off) {
+        remote_power_hvx_off();
+    }
+    power_voted_hvx = false;
+    power_voted = false;
+}
+
+WEAK void power_vote_hold_thread(void *) {
+    while (true) {
+        int sleep_ms;
+        {
+            ScopedMutexLock lock(&power_vote_lock);
+            if (!power_voted || power_vote_runs > 0) {
+                // Either the vote is gone, or a pipeline is running,
+                // and the next to finish will start the hold again.
+                power_vote_thread_running = false;
+                return;
+            }
+            uint64_t idle_ns = halide_current_time_ns(NULL) - power_vote_last_end;
+            int idle_ms = (int)(idle_ns / 1000000);
+            if (idle_ms >= auto_power_hold_ms) {
+                drop_power_vote_already_locked(NULL);
+                power_vote_thread_running = false;
+                return;
+            }
+            sleep_ms = auto_power_hold_ms - idle_ms;
+        }
+        halide_sleep_ms(NULL, sleep_ms);
+    }
+}
+
+// Called before running pipelines on Hexagon. Returns whether the run
+// counts towards the automatic vote, and so must be passed to
+// end_power_vote.
+WEAK bool begin_power_vote(void *user_context) {
+    ScopedMutexLock lock(&power_vote_lock);
+    if (auto_power_mode == halide_hexagon_power_default) {
+        return false;
+    }
+    power_vote_runs++;
+    if (!power_voted) {
+        cast_power_vote_already_locked(user_context);
+    }
+    return true;
+}
+
+WEAK void end_power_vote(void *user_context, bool counted) {
+    if (!counted) return;
+    halide_thread *finished_thread = NULL;
+    {
+        ScopedMutexLock lock(&power_vote_lock);
+        power_vote_runs--;
+        power_vote_last_end = halide_current_time_ns(user_context);
+        if (power_vote_runs > 0 || power_vote_thread_running) {
+            return;
+        }
+        if (auto_power_mode == halide_hexagon_power_default || auto_power_hold_ms <= 0) {
+            drop_power_vote_already_locked(user_context);
+            return;
+        }
+        // Any previous hold thread has exited, but still needs joining.
+        finished_thread = power_vote_thread;
+        power_vote_thread_running = true;
+        power_vote_thread = halide_spawn_thread(power_vote_hold_thread, NULL);
+    }
+    if (finished_thread) {
+        halide_join_thread(finished_thread);
+    }
+}
+
+// Drop the vote and wait for the hold thread to exit.
+WEAK void release_power_vote(void *user_context) {
+    halide_thread *thread;
+    {
+        ScopedMutexLock lock(&power_vote_lock);
+        drop_power_vote_already_locked(user_context);
+        thread = power_vote_thread;
+        power_vote_thread = NULL;
+    }
+    if (thread) {
+        halide_join_thread(thread);
+    }
+}
+
+// A call to halide_hexagon_run queued while a batch is open. The
+// mapped arguments (input buffers, output buffers, then scalars)
+// follow this struct in the same allocation, and then the values of
+// the scalars, because the caller's scalars don't outlive the call.
+struct queued_run {
+    halide_hexagon_handle_t module;
+    halide_hexagon_handle_t function;
+    int input_buffer_count;
+    int output_buffer_count;
+    int input_scalar_count;
+    queued_run *next;
+
+    remote_buffer *args() {
+        return (remote_buffer *)(this + 1);
+    }
+    uint64_t *scalar_values() {
+        return (uint64_t *)(args() + input_buffer_count + output_buffer_count + input_scalar_count);
+    }
+};
+
+// The state of batching, protected by thread_lock.
+WEAK bool batch_open = false;
+WEAK queued_run *batch_head = NULL;
+WEAK queued_run *batch_tail = NULL;
+
+// The runs being sent by halide_hexagon_end_batch_async, and the
+// thread sending them.
+WEAK queued_run *async_batch = NULL;
+WEAK halide_thread *async_batch_thread = NULL;
+WEAK int async_batch_result = 0;
+
+// FastRPC limits the number of buffers in one call, so large batches
+// are sent in several calls.
+const int max_batch_buffers = 128;
+
+WEAK void free_queued(queued_run *runs) {
+    while (runs) {
+        queued_run *next = runs->next;
+        free(runs);
+        runs = next;
+    }
+}
+
+// Run a list of queued runs, and free them.
+WEAK int run_queued(void *user_context, queued_run *runs) {
+    int result = 0;
+    bool voted = begin_power_vote(user_context);
+    while (runs && result == 0) {
+        if (!remote_run_batch) {
+            remote_buffer *args = runs->args();
+            debug(user_context) << "    halide_hexagon_remote_run -> ";
+            result = remote_run(runs->module, runs->function,
+                                args, runs->input_buffer_count,
+                                args + runs->input_buffer_count, runs->output_buffer_count,
+                                args + runs->input_buffer_count + runs->output_buffer_count,
+                                runs->input_scalar_count);
+            poll_log(user_context);
+            debug(user_context) << "        " << result << "\n";
+            queued_run *next = runs->next;
+            free(runs);
+            runs = next;
+            continue;
+        }
+
+        // Find how many runs fit in one remote call. Always send at
+        // least one, even if it exceeds the limit by itself.
+        int function_count = 0;
+        int input_buffer_count = 0;
+        int output_buffer_count = 0;
+        int input_scalar_count = 0;
+        for (queued_run *r = runs; r; r = r->next) {
+            int buffers = input_buffer_count + output_buffer_count + r->input_buffer_count + r->output_buffer_count;
+            if (function_count > 0 && buffers > max_batch_buffers) break;
+            function_count++;
+            input_buffer_count += r->input_buffer_count;
+            output_buffer_count += r->output_buffer_count;
+            input_scalar_count += r->input_scalar_count;
+        }
+
+        // Gather the arguments of those runs.
+        size_t size = function_count * (sizeof(halide_hexagon_handle_t) + 3 * sizeof(int)) +
+                      (input_buffer_count + output_buffer_count) * sizeof(remote_buffer) +
+                      input_scalar_count * sizeof(uint64_t);
+        void *storage = malloc(size);
+        if (!storage) {
+            error(user_context) << "Hexagon: Out of memory running batch\n";
+            result = halide_error_code_out_of_memory;
+            break;
+        }
+        remote_buffer *input_buffers = (remote_buffer *)storage;
+        remote_buffer *output_buffers = input_buffers + input_buffer_count;
+        uint64_t *scalars = (uint64_t *)(output_buffers + output_buffer_count);
+        halide_hexagon_handle_t *functions = (halide_hexagon_handle_t *)(scalars + input_scalar_count);
+        int *arg_counts = (int *)(functions + function_count);
+
+        remote_buffer *next_input = input_buffers;
+        remote_buffer *next_output = output_buffers;
+        uint64_t *next_scalar = scalars;
+        for (int i = 0; i < function_count; i++) {
+            queued_run *r = runs;
+            remote_buffer *args = r->args();
+            memcpy(next_input, args, r->input_buffer_count * sizeof(remote_buffer));
+            memcpy(next_output, args + r->input_buffer_count, r->output_buffer_count * sizeof(remote_buffer));
+            memcpy(next_scalar, r->scalar_values(), r->input_scalar_count * sizeof(uint64_t));
+            next_input += r->input_buffer_count;
+            next_output += r->output_buffer_count;
+            next_scalar += r->input_scalar_count;
+            functions[i] = r->function;
+            arg_counts[i * 3 + 0] = r->input_buffer_count;
+            arg_counts[i * 3 + 1] = r->output_buffer_count;
+            arg_counts[i * 3 + 2] = r->input_scalar_count;
+            runs = r->next;
+            free(r);
+        }
+
+        debug(user_context) << "    halide_hexagon_remote_run_batch (" << function_count << " pipelines) -> ";
+        result = remote_run_batch(functions, function_count,
+                                  arg_counts, function_count * 3,
+                                  input_buffers, input_buffer_count,
+                                  output_buffers, output_buffer_count,
+                                  scalars, input_scalar_count);
+        poll_log(user_context);
+        debug(user_context) << "        " << result << "\n";
+        free(storage);
+    }
+
+    end_power_vote(user_context, voted);
+
+    // If a run failed, drop the rest.
+    free_queued(runs);
+
+    if (result != 0) {
+        error(user_context) << "Hexagon pipeline failed.\n";
+    }
+    return result;
+}
+
+WEAK void run_async_batch(void *) {
+    async_batch_result = run_queued(NULL, async_batch);
+    async_batch = NULL;
+}
+
+// Take the queued runs, and close the batch.
+WEAK queued_run *close_batch() {
+    ScopedMutexLock lock(&thread_lock);
+    queued_run *runs = batch_head;
+    batch_head = batch_tail = NULL;
+    batch_open = false;
+    return runs;
+}
+
 }}}}  // namespace Halide::Runtime::Internal::Hexagon
 
 using namespace Halide::Runtime::Internal;
@@ -354,6 +636,49 @@ WEAK int halide_hexagon_run(void *user_context,
                                            input_scalars);
     if (input_scalar_count < 0) return input_scalar_count;
 
+    {
+        ScopedMutexLock lock(&thread_lock);
+        if (batch_open) {
+            // Copy the mapped arguments and the scalar values, and
+            // queue the run until the batch ends.
+            int mapped_count = input_buffer_count + output_buffer_count + input_scalar_count;
+            queued_run *run = (queued_run *)malloc(sizeof(queued_run) +
+                                                   mapped_count * sizeof(remote_buffer) +
+                                                   input_scalar_count * sizeof(uint64_t));
+            if (!run) {
+                error(user_context) << "Hexagon: Out of memory queueing pipeline\n";
+                return halide_error_code_out_of_memory;
+            }
+            run->module = module;
+            run->function = *function;
+            run->input_buffer_count = input_buffer_count;
+            run->output_buffer_count = output_buffer_count;
+            run->input_scalar_count = input_scalar_count;
+            run->next = NULL;
+            memcpy(run->args(), mapped_buffers, mapped_count * sizeof(remote_buffer));
+            remote_buffer *scalars = run->args() + input_buffer_count + output_buffer_count;
+            uint64_t *values = run->scalar_values();
+            for (int i = 0; i < input_scalar_count; i++) {
+                if (scalars[i].dataLen > (int)sizeof(uint64_t)) {
+                    free(run);
+                    error(user_context) << "Hexagon: Scalar argument " << i << " is too large to queue\n";
+                    return -1;
+                }
+                values[i] = 0;
+                memcpy(&values[i], scalars[i].data, scalars[i].dataLen);
+                scalars[i].data = (unsigned char *)&values[i];
+            }
+            if (batch_tail) {
+                batch_tail->next = run;
+            } else {
+                batch_head = run;
+            }
+            batch_tail = run;
+            debug(user_context) << "    queued in batch\n";
+            return 0;
+        }
+    }
+
     #ifdef DEBUG_RUNTIME
     uint64_t t_before = halide_current_time_ns(user_context);
     #endif
@@ -367,6 +692,7 @@ WEAK int halide_hexagon_run(void *user_context,
     }
 
     // Call the pipeline on the device side.
+    bool voted = begin_power_vote(user_context);
     debug(user_context) << "    halide_hexagon_remote_run -> ";
     result = remote_run(module, *function,
                         input_buffers, input_buffer_count,
@@ -374,6 +700,7 @@ WEAK int halide_hexagon_run(void *user_context,
                         input_scalars, input_scalar_count);
     poll_log(user_context);
     debug(user_context) << "        " << result << "\n";
+    end_power_vote(user_context, voted);
     if (result != 0) {
         error(user_context) << "Hexagon pipeline failed.\n";
         return result;
@@ -389,10 +716,71 @@ WEAK int halide_hexagon_run(void *user_context,
     return result != 0 ? -1 : 0;
 }
 
+WEAK int halide_hexagon_begin_batch(void *user_context) {
+    debug(user_context)
+        << "Hexagon: halide_hexagon_begin_batch (user_context: " <<  user_context << ")\n";
+
+    // Only one batch can be in flight at a time.
+    int result = halide_hexagon_wait_batch(user_context);
+    if (result != 0) return result;
+
+    ScopedMutexLock lock(&thread_lock);
+    if (batch_open) {
+        error(user_context) << "Hexagon: halide_hexagon_begin_batch called while a batch is already open\n";
+        return -1;
+    }
+    batch_open = true;
+    return 0;
+}
+
+WEAK int halide_hexagon_end_batch(void *user_context) {
+    debug(user_context)
+        << "Hexagon: halide_hexagon_end_batch (user_context: " <<  user_context << ")\n";
+
+    queued_run *runs = close_batch();
+    if (!runs) return 0;
+    int result = init_hexagon_runtime(user_context);
+    if (result != 0) return result;
+    return run_queued(user_context, runs);
+}
+
+WEAK int halide_hexagon_end_batch_async(void *user_context) {
+    debug(user_context)
+        << "Hexagon: halide_hexagon_end_batch_async (user_context: " <<  user_context << ")\n";
+
+    queued_run *runs = close_batch();
+    if (!runs) return 0;
+    int result = init_hexagon_runtime(user_context);
+    if (result != 0) return result;
+    async_batch = runs;
+    async_batch_result = 0;
+    async_batch_thread = halide_spawn_thread(run_async_batch, NULL);
+    return 0;
+}
+
+WEAK int halide_hexagon_wait_batch(void *user_context) {
+    if (!async_batch_thread) return 0;
+    debug(user_context)
+        << "Hexagon: halide_hexagon_wait_batch (user_context: " <<  user_context << ")\n";
+    halide_join_thread(async_batch_thread);
+    async_batch_thread = NULL;
+    return async_batch_result;
+}
+
 WEAK int halide_hexagon_device_release(void *user_context) {
     debug(user_context)
         << "Hexagon: halide_hexagon_device_release (user_context: " <<  user_context << ")\n";
 
+    // Queued pipelines can't run after their modules are released.
+    if (halide_hexagon_wait_batch(user_context) != 0) {
+        error(user_context) << "Hexagon: batch failed before release\n";
+    }
+    free_queued(close_batch());
+
+    release_power_vote(user_context);
+
+    halide_hexagon_release_unused_device_allocations(user_context);
+
     ScopedMutexLock lock(&thread_lock);
 
     // Release all of the remote side modules.
@@ -431,6 +819,128 @@ WEAK int halide_hexagon_device_release(void *user_context) {
 // arguments than simply mapping the pages.
 static const int min_ion_allocation_size = 4096;
 
+namespace {
+
+// ION allocations released by halide_hexagon_device_free are kept
+// here, still mapped and registered with FastRPC, and reused by later
+// allocations of the same size class. This avoids the cost of
+// allocating and mapping ION memory for every buffer of pipelines
+// that run repeatedly on buffers of the same sizes.
+struct cached_ion_allocation {
+    void *ion;
+    size_t size;
+    cached_ion_allocation *next;
+};
+
+WEAK halide_mutex ion_cache_lock = { { 0 } };
+WEAK cached_ion_allocation *ion_cache = NULL;
+WEAK size_t ion_cache_bytes = 0;
+// The ION allocations freed beyond this many cached bytes are released.
+WEAK size_t ion_cache_limit = 64 * 1024 * 1024;
+
+// Round the size of an ION allocation up to its size class. The size
+// classes are spaced by a quarter of the next power of two, so a
+// reused allocation is at most 25% larger than requested.
+WEAK size_t ion_size_class(size_t size) {
+    size_t pow2 = min_ion_allocation_size;
+    while (pow2 < size) {
+        pow2 *= 2;
+    }
+    size_t step = pow2 / 4;
+    return (size + step - 1) / step * step;
+}
+
+// Remove a cached allocation of 'size' bytes from the cache. Returns
+// NULL if there is none.
+WEAK void *take_cached_ion_allocation(size_t size) {
+    cached_ion_allocation *found = NULL;
+    {
+        ScopedMutexLock lock(&ion_cache_lock);
+        for (cached_ion_allocation **prev_ptr = &ion_cache; *prev_ptr; prev_ptr = &(*prev_ptr)->next) {
+            cached_ion_allocation *a = *prev_ptr;
+            if (a->size == size) {
+                *prev_ptr = a->next;
+                ion_cache_bytes -= size;
+                found = a;
+                break;
+            }
+        }
+    }
+    void *result = NULL;
+    if (found) {
+        result = found->ion;
+        free(found);
+    }
+    return result;
+}
+
+// Add an allocation to the cache. Returns false if the cache is full,
+// in which case the caller must free the allocation.
+WEAK bool cache_ion_allocation(void *ion, size_t size) {
+    cached_ion_allocation *a = (cached_ion_allocation *)malloc(sizeof(cached_ion_allocation));
+    if (a == NULL) {
+        return false;
+    }
+    a->ion = ion;
+    a->size = size;
+    bool cached = false;
+    {
+        ScopedMutexLock lock(&ion_cache_lock);
+        if (ion_cache_bytes + size <= ion_cache_limit) {
+            a->next = ion_cache;
+            ion_cache = a;
+            ion_cache_bytes += size;
+            cached = true;
+        }
+    }
+    if (!cached) {
+        free(a);
+    }
+    return cached;
+}
+
+}  // namespace
+
+WEAK int halide_hexagon_set_allocation_cache_size(void *user_context, size_t bytes) {
+    debug(user_context)
+        << "Hexagon: halide_hexagon_set_allocation_cache_size (user_context: " << user_context
+        << ", bytes: " << (uint64_t)bytes << ")\n";
+
+    bool over_limit;
+    {
+        ScopedMutexLock lock(&ion_cache_lock);
+        ion_cache_limit = bytes;
+        over_limit = ion_cache_bytes > ion_cache_limit;
+    }
+
+    if (over_limit) {
+        return halide_hexagon_release_unused_device_allocations(user_context);
+    }
+    return 0;
+}
+
+WEAK int halide_hexagon_release_unused_device_allocations(void *user_context) {
+    debug(user_context)
+        << "Hexagon: halide_hexagon_release_unused_device_allocations (user_context: " << user_context << ")\n";
+
+    cached_ion_allocation *to_free;
+    {
+        ScopedMutexLock lock(&ion_cache_lock);
+        to_free = ion_cache;
+        ion_cache = NULL;
+        ion_cache_bytes = 0;
+    }
+
+    while (to_free) {
+        cached_ion_allocation *a = to_free;
+        to_free = a->next;
+        debug(user_context) << "    host_free ion=" << a->ion << "\n";
+        host_free(a->ion);
+        free(a);
+    }
+    return 0;
+}
+
 WEAK int halide_hexagon_device_malloc(void *user_context, halide_buffer_t *buf) {
     int result = init_hexagon_runtime(user_context);
     if (result != 0) return result;
@@ -464,12 +974,18 @@ WEAK int halide_hexagon_device_malloc(void *user_context, halide_buffer_t *buf)
 
     void *ion;
     if (size >= min_ion_allocation_size) {
-        debug(user_context) << "    host_malloc len=" << (uint64_t)size << " -> ";
-        ion = host_malloc(size);
-        debug(user_context) << "        " << ion << "\n";
-        if (!ion) {
-            error(user_context) << "host_malloc failed\n";
-            return -1;
+        size = ion_size_class(size);
+        ion = take_cached_ion_allocation(size);
+        if (ion) {
+            debug(user_context) << "    reusing cached ion=" << ion << "\n";
+        } else {
+            debug(user_context) << "    host_malloc len=" << (uint64_t)size << " -> ";
+            ion = host_malloc(size);
+            debug(user_context) << "        " << ion << "\n";
+            if (!ion) {
+                error(user_context) << "host_malloc failed\n";
+                return -1;
+            }
         }
     } else {
         debug(user_context) << "    halide_malloc size=" << (uint64_t)size << " -> ";
@@ -519,8 +1035,12 @@ WEAK int halide_hexagon_device_free(void *user_context, halide_buffer_t* buf) {
     void *ion = halide_hexagon_get_device_handle(user_context, buf);
     halide_hexagon_detach_device_handle(user_context, buf);
     if (size >= min_ion_allocation_size) {
-        debug(user_context) << "    host_free ion=" << ion << "\n";
-        host_free(ion);
+        if (cache_ion_allocation(ion, size)) {
+            debug(user_context) << "    cached ion=" << ion << "\n";
+        } else {
+            debug(user_context) << "    host_free ion=" << ion << "\n";
+            host_free(ion);
+        }
     } else {
         debug(user_context) << "    halide_free ion=" << ion << "\n";
         halide_free(user_context, ion);
@@ -785,6 +1305,27 @@ WEAK int halide_hexagon_set_performance(void *user_context, halide_hexagon_power
     return 0;
 }
 
+WEAK int halide_hexagon_set_auto_performance_mode(void *user_context, halide_hexagon_power_mode_t mode, int hold_ms) {
+    int result = init_hexagon_runtime(user_context);
+    if (result != 0) return result;
+
+    debug(user_context) << "halide_hexagon_set_auto_performance_mode (mode: " << mode
+                        << ", hold_ms: " << hold_ms << ")\n";
+    ScopedMutexLock lock(&power_vote_lock);
+    bool changed = mode != auto_power_mode;
+    auto_power_mode = mode;
+    auto_power_hold_ms = hold_ms;
+    if (power_voted && changed) {
+        if (mode == halide_hexagon_power_default || power_vote_runs == 0) {
+            // The next pipeline to run will vote for the new mode.
+            drop_power_vote_already_locked(user_context);
+        } else {
+            cast_power_vote_already_locked(user_context);
+        }
+    }
+    return 0;
+}
+
 WEAK const halide_device_interface_t *halide_hexagon_device_interface() {
     return &hexagon_device_interface;
 }
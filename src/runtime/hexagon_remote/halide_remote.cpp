@@ -330,6 +330,54 @@ int halide_hexagon_remote_run_v2(handle_t module_ptr, handle_t function,
     return result;
 }
 
+int halide_hexagon_remote_run_batch(const handle_t *functionsPtrs, int functionsLen,
+                                    const int *arg_countsPtrs, int arg_countsLen,
+                                    const buffer *input_buffersPtrs, int input_buffersLen,
+                                    buffer *output_buffersPtrs, int output_buffersLen,
+                                    const scalar_t *scalarsPtrs, int scalarsLen) {
+    if (arg_countsLen != functionsLen * 3) {
+        return -1;
+    }
+
+    // Keep HVX powered on across all of the pipelines.
+    int result = halide_hexagon_remote_power_hvx_on();
+    if (result != 0) {
+        return result;
+    }
+
+    for (int i = 0; i < functionsLen; i++) {
+        int input_buffer_count = arg_countsPtrs[i * 3 + 0];
+        int output_buffer_count = arg_countsPtrs[i * 3 + 1];
+        int scalar_count = arg_countsPtrs[i * 3 + 2];
+        if (input_buffer_count > input_buffersLen ||
+            output_buffer_count > output_buffersLen ||
+            scalar_count > scalarsLen) {
+            result = -1;
+            break;
+        }
+
+        // The module is unused by run_v2.
+        result = halide_hexagon_remote_run_v2(0, functionsPtrs[i],
+                                              input_buffersPtrs, input_buffer_count,
+                                              output_buffersPtrs, output_buffer_count,
+                                              scalarsPtrs, scalar_count);
+        if (result != 0) {
+            break;
+        }
+
+        input_buffersPtrs += input_buffer_count;
+        input_buffersLen -= input_buffer_count;
+        output_buffersPtrs += output_buffer_count;
+        output_buffersLen -= output_buffer_count;
+        scalarsPtrs += scalar_count;
+        scalarsLen -= scalar_count;
+    }
+
+    halide_hexagon_remote_power_hvx_off();
+
+    return result;
+}
+
 int halide_hexagon_remote_release_library(handle_t module_ptr) {
     if (use_dlopenbuf()) {
         dlclose(reinterpret_cast<void*>(module_ptr));
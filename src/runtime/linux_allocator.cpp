@@ -0,0 +1,159 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+// The posix_allocator, plus optional huge page backing for large
+// allocations. Large pipelines with buffers of hundreds of MB can
+// spend a lot of time on TLB misses with 4KB pages. Setting
+// HL_HUGE_PAGE_THRESHOLD_MB makes allocations at least that large go
+// straight to mmap instead of malloc, with the mapping either
+// advised to use transparent huge pages or backed by hugetlbfs,
+// depending on HL_HUGE_PAGE_MODE:
+//
+// -- "thp" (the default) uses madvise(MADV_HUGEPAGE) on a 2MB aligned
+//    anonymous mapping.
+// -- "2mb" and "1gb" map hugetlbfs pages of that size with
+//    MAP_HUGETLB, which requires pages to have been reserved (see
+//    /proc/sys/vm/nr_hugepages). If that fails we fall back to "thp".
+
+extern "C" {
+
+extern void *malloc(size_t);
+extern void free(void *);
+extern void *mmap(void *addr, size_t length, int prot, int flags, int fd, long offset);
+extern int munmap(void *addr, size_t length);
+extern int madvise(void *addr, size_t length, int advice);
+
+}
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// These are the values for x86 and ARM. MIPS differs, so it uses
+// posix_allocator instead.
+#define HUGE_PAGE_PROT_READ_WRITE 0x3
+#define HUGE_PAGE_MAP_PRIVATE 0x02
+#define HUGE_PAGE_MAP_ANONYMOUS 0x20
+#define HUGE_PAGE_MAP_HUGETLB 0x40000
+#define HUGE_PAGE_MAP_HUGE_SHIFT 26
+#define HUGE_PAGE_MADV_HUGEPAGE 14
+#define HUGE_PAGE_MAP_FAILED ((void *)-1)
+
+#define HUGE_PAGE_2MB ((size_t)1 << 21)
+#define HUGE_PAGE_1GB ((size_t)1 << 30)
+
+enum HugePageMode {
+    HugePageModeUnknown = 0,
+    HugePageModeDisabled,
+    HugePageModeTHP,
+    HugePageMode2MB,
+    HugePageMode1GB
+};
+
+WEAK int huge_page_mode = HugePageModeUnknown;
+WEAK size_t huge_page_threshold = 0;
+
+WEAK void read_huge_page_settings() {
+    if (__atomic_load_n(&huge_page_mode, __ATOMIC_ACQUIRE) != HugePageModeUnknown) {
+        return;
+    }
+    int mode = HugePageModeDisabled;
+    const char *threshold_str = getenv("HL_HUGE_PAGE_THRESHOLD_MB");
+    int threshold_mb = threshold_str ? atoi(threshold_str) : 0;
+    if (threshold_mb > 0) {
+        huge_page_threshold = (size_t)threshold_mb << 20;
+        mode = HugePageModeTHP;
+        const char *mode_str = getenv("HL_HUGE_PAGE_MODE");
+        if (mode_str && strncmp(mode_str, "2mb", 4) == 0) {
+            mode = HugePageMode2MB;
+        } else if (mode_str && strncmp(mode_str, "1gb", 4) == 0) {
+            mode = HugePageMode1GB;
+        }
+    }
+    __atomic_store_n(&huge_page_mode, mode, __ATOMIC_RELEASE);
+}
+
+// Returns the base of a mapping of at least length bytes whose start
+// is aligned to the page size used, or NULL. map_length is set to the
+// length to pass to munmap.
+WEAK void *map_huge_pages(size_t length, size_t *map_length) {
+    const int flags = HUGE_PAGE_MAP_PRIVATE | HUGE_PAGE_MAP_ANONYMOUS;
+
+    int mode = huge_page_mode;
+    if (mode == HugePageMode2MB || mode == HugePageMode1GB) {
+        size_t page = mode == HugePageMode1GB ? HUGE_PAGE_1GB : HUGE_PAGE_2MB;
+        int log2_page = mode == HugePageMode1GB ? 30 : 21;
+        size_t len = (length + page - 1) & ~(page - 1);
+        void *base = mmap(NULL, len, HUGE_PAGE_PROT_READ_WRITE,
+                          flags | HUGE_PAGE_MAP_HUGETLB | (log2_page << HUGE_PAGE_MAP_HUGE_SHIFT), -1, 0);
+        if (base != HUGE_PAGE_MAP_FAILED) {
+            *map_length = len;
+            return base;
+        }
+    }
+
+    // Transparent huge pages. Over-allocate by a page so we can align
+    // the usable region to a huge page boundary, which the kernel
+    // needs to back it with huge pages.
+    size_t len = ((length + HUGE_PAGE_2MB - 1) & ~(HUGE_PAGE_2MB - 1)) + HUGE_PAGE_2MB;
+    void *base = mmap(NULL, len, HUGE_PAGE_PROT_READ_WRITE, flags, -1, 0);
+    if (base == HUGE_PAGE_MAP_FAILED) {
+        return NULL;
+    }
+    size_t aligned = ((size_t)base + HUGE_PAGE_2MB - 1) & ~(HUGE_PAGE_2MB - 1);
+    size_t head = aligned - (size_t)base;
+    if (head) {
+        munmap(base, head);
+    }
+    len -= head;
+    // Failure here just means we get small pages.
+    madvise((void *)aligned, len, HUGE_PAGE_MADV_HUGEPAGE);
+    *map_length = len;
+    return (void *)aligned;
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+extern "C" {
+
+WEAK void *halide_default_malloc(void *user_context, size_t x) {
+    const size_t alignment = halide_malloc_alignment();
+
+    read_huge_page_settings();
+    if (huge_page_mode != HugePageModeDisabled && x >= huge_page_threshold) {
+        // The first alignment bytes of the mapping hold the mapping
+        // base, tagged in its low bit, and length. Allow reading a
+        // word past the end, as halide_malloc promises.
+        size_t map_length = 0;
+        void *base = map_huge_pages(alignment + x + sizeof(void *), &map_length);
+        if (base != NULL) {
+            void *ptr = (uint8_t *)base + alignment;
+            ((size_t *)ptr)[-1] = (size_t)base | 1;
+            ((size_t *)ptr)[-2] = map_length;
+            return ptr;
+        }
+        // Fall back to malloc.
+    }
+
+    // Allocate enough space for aligning the pointer we return.
+    void *orig = malloc(x + alignment);
+    if (orig == NULL) {
+        // Will result in a failed assertion and a call to halide_error
+        return NULL;
+    }
+    // We want to store the original pointer prior to the pointer we return.
+    void *ptr = (void *)(((size_t)orig + alignment + sizeof(void*) - 1) & ~(alignment - 1));
+    ((void **)ptr)[-1] = orig;
+    return ptr;
+}
+
+WEAK void halide_default_free(void *user_context, void *ptr) {
+    size_t orig = ((size_t *)ptr)[-1];
+    if (orig & 1) {
+        munmap((void *)(orig & ~(size_t)1), ((size_t *)ptr)[-2]);
+    } else {
+        free((void *)orig);
+    }
+}
+
+}
+
+#include "allocator_common.h"
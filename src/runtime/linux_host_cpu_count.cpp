@@ -3,9 +3,91 @@
 extern "C" {
 
 extern long sysconf(int);
+extern int sched_setaffinity(int pid, size_t cpusetsize, const void *mask);
 
 WEAK int halide_host_cpu_count() {
     return sysconf(84);
 }
 
+}  // extern "C"
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// Enough for 1024 logical cpus, which matches glibc's cpu_set_t.
+#define NUMA_MAX_CPUS 1024
+struct numa_cpu_mask {
+    uint64_t bits[NUMA_MAX_CPUS / 64];
+};
+
+// Read a small sysfs file into buf as a nul-terminated string.
+WEAK bool read_sysfs_file(const char *path, char *buf, size_t size) {
+    void *f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    size_t n = fread(buf, 1, size - 1, f);
+    fclose(f);
+    buf[n] = 0;
+    return n > 0;
+}
+
+// Parse a sysfs cpu/node list such as "0-23,48-71" into a mask.
+// Returns one more than the highest entry in the list.
+WEAK int parse_sysfs_list(const char *str, numa_cpu_mask *mask) {
+    int highest = 0;
+    const char *p = str;
+    while (*p >= '0' && *p <= '9') {
+        int first = atoi(p);
+        while (*p >= '0' && *p <= '9') p++;
+        int last = first;
+        if (*p == '-') {
+            p++;
+            last = atoi(p);
+            while (*p >= '0' && *p <= '9') p++;
+        }
+        for (int i = first; i <= last && i < NUMA_MAX_CPUS; i++) {
+            if (mask) {
+                mask->bits[i / 64] |= (uint64_t)1 << (i % 64);
+            }
+            highest = max(highest, i + 1);
+        }
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return highest;
+}
+
+}}}  // namespace Halide::Runtime::Internal
+
+extern "C" {
+
+WEAK int halide_numa_node_count() {
+    char buf[256];
+    if (!read_sysfs_file("/sys/devices/system/node/online", buf, sizeof(buf))) {
+        return 1;
+    }
+    int nodes = parse_sysfs_list(buf, NULL);
+    return nodes > 0 ? nodes : 1;
 }
+
+WEAK int halide_bind_current_thread_to_numa_node(int node) {
+    char path[64];
+    char *dst = halide_string_to_string(path, path + sizeof(path), "/sys/devices/system/node/node");
+    dst = halide_int64_to_string(dst, path + sizeof(path), node, 1);
+    halide_string_to_string(dst, path + sizeof(path), "/cpulist");
+
+    char buf[1024];
+    if (!read_sysfs_file(path, buf, sizeof(buf))) {
+        return -1;
+    }
+    numa_cpu_mask mask;
+    memset(&mask, 0, sizeof(mask));
+    if (parse_sysfs_list(buf, &mask) == 0) {
+        return -1;
+    }
+    // pid 0 means the calling thread.
+    return sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+}  // extern "C"
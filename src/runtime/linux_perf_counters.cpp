@@ -0,0 +1,115 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+// Hardware performance counters for the profiler, read with
+// perf_event_open. The counters are opened by the thread that starts
+// the profiler and inherited by the threads it creates after that,
+// which includes the thread pool workers if it was the first to run a
+// parallel pipeline. The kernel sums the counts over all of them.
+// Only user-space events are counted, which most kernels allow
+// without privileges.
+
+extern "C" {
+
+// The syscall number for perf_event_open varies across platforms:
+// -- i386 is 336
+// -- x64 is 298
+
+#ifndef SYS_PERF_EVENT_OPEN
+
+#ifdef BITS_64
+#define SYS_PERF_EVENT_OPEN 298
+#endif
+
+#ifdef BITS_32
+#define SYS_PERF_EVENT_OPEN 336
+#endif
+
+#endif
+
+extern int syscall(int num, ...);
+extern long read(int fd, void *buf, size_t count);
+
+}
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// The first version of struct perf_event_attr, which later kernels
+// still accept.
+struct perf_event_attr_ver0 {
+    uint32_t type;
+    uint32_t size;
+    uint64_t config;
+    uint64_t sample_period;
+    uint64_t sample_type;
+    uint64_t read_format;
+    uint64_t flags;
+    uint32_t wakeup_events;
+    uint32_t bp_type;
+    uint64_t config1;
+};
+
+#define PERF_TYPE_HARDWARE 0
+#define PERF_COUNT_HW_CPU_CYCLES 0
+#define PERF_COUNT_HW_INSTRUCTIONS 1
+#define PERF_COUNT_HW_CACHE_MISSES 3
+#define PERF_COUNT_HW_BRANCH_MISSES 5
+
+#define PERF_ATTR_FLAG_INHERIT (1 << 1)
+#define PERF_ATTR_FLAG_EXCLUDE_KERNEL (1 << 5)
+#define PERF_ATTR_FLAG_EXCLUDE_HV (1 << 6)
+
+// Indexed by halide_profiler_counter_t.
+WEAK int perf_counter_fds[halide_profiler_num_counters];
+WEAK bool perf_counters_opened = false;
+
+WEAK int open_perf_counter(uint64_t config) {
+    perf_event_attr_ver0 attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.flags = PERF_ATTR_FLAG_INHERIT | PERF_ATTR_FLAG_EXCLUDE_KERNEL | PERF_ATTR_FLAG_EXCLUDE_HV;
+    // This thread, any cpu, no group, no flags.
+    return syscall(SYS_PERF_EVENT_OPEN, &attr, 0, -1, -1, 0);
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+extern "C" {
+
+WEAK int halide_perf_counters_open() {
+    if (!perf_counters_opened) {
+        const uint64_t configs[halide_profiler_num_counters] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES
+        };
+        for (int i = 0; i < halide_profiler_num_counters; i++) {
+            perf_counter_fds[i] = open_perf_counter(configs[i]);
+        }
+        perf_counters_opened = true;
+    }
+    for (int i = 0; i < halide_profiler_num_counters; i++) {
+        if (perf_counter_fds[i] >= 0) {
+            return halide_profiler_num_counters;
+        }
+    }
+    return 0;
+}
+
+WEAK int halide_perf_counters_read(uint64_t *values) {
+    if (!perf_counters_opened) {
+        return 0;
+    }
+    for (int i = 0; i < halide_profiler_num_counters; i++) {
+        values[i] = 0;
+        if (perf_counter_fds[i] >= 0) {
+            read(perf_counter_fds[i], &values[i], sizeof(uint64_t));
+        }
+    }
+    return halide_profiler_num_counters;
+}
+
+}
@@ -0,0 +1,92 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+// Shared memory segments for the memoization cache. A segment is a
+// file in /dev/shm, which is what shm_open would give us without
+// needing librt, mapped MAP_SHARED by every process that opens it.
+// The cross-process lock is a flock on the file, so the kernel drops
+// it if the process holding it crashes.
+
+extern "C" {
+
+extern int open(const char *path, int flags, ...);
+extern int close(int fd);
+extern long lseek(int fd, long offset, int whence);
+extern int ftruncate(int fd, long length);
+extern int flock(int fd, int operation);
+extern void *mmap(void *addr, size_t length, int prot, int flags, int fd, long offset);
+extern int munmap(void *addr, size_t length);
+
+}
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// These are the values for x86 and ARM. MIPS differs, so it uses
+// fake_shared_memory instead.
+#define SHARED_MEMORY_O_RDWR 02
+#define SHARED_MEMORY_O_CREAT 0100
+#define SHARED_MEMORY_O_CLOEXEC 02000000
+#define SHARED_MEMORY_SEEK_END 2
+#define SHARED_MEMORY_LOCK_EX 2
+#define SHARED_MEMORY_LOCK_UN 8
+#define SHARED_MEMORY_PROT_READ_WRITE 0x3
+#define SHARED_MEMORY_MAP_SHARED 0x01
+#define SHARED_MEMORY_MAP_FAILED ((void *)-1)
+
+}}} // namespace Halide::Runtime::Internal
+
+using namespace Halide::Runtime::Internal;
+
+extern "C" {
+
+WEAK int halide_shared_memory_open(const char *name) {
+    char path[256];
+    char *end = path + sizeof(path);
+    while (*name == '/') {
+        name++;
+    }
+    char *dst = halide_string_to_string(path, end, "/dev/shm/");
+    dst = halide_string_to_string(dst, end, name);
+    if (!*name || dst >= end - 1) {
+        return -1;
+    }
+    return open(path, SHARED_MEMORY_O_RDWR | SHARED_MEMORY_O_CREAT | SHARED_MEMORY_O_CLOEXEC, 0600);
+}
+
+WEAK void *halide_shared_memory_map(int handle, size_t *size) {
+    // Hold the lock so that only one of several processes opening a
+    // new segment sets its size.
+    flock(handle, SHARED_MEMORY_LOCK_EX);
+    long existing = lseek(handle, 0, SHARED_MEMORY_SEEK_END);
+    bool ok = existing >= 0;
+    if (ok && existing == 0) {
+        ok = ftruncate(handle, (long)*size) == 0;
+    } else if (ok) {
+        *size = (size_t)existing;
+    }
+    flock(handle, SHARED_MEMORY_LOCK_UN);
+    if (!ok) {
+        return NULL;
+    }
+    void *base = mmap(NULL, *size, SHARED_MEMORY_PROT_READ_WRITE, SHARED_MEMORY_MAP_SHARED, handle, 0);
+    return base == SHARED_MEMORY_MAP_FAILED ? NULL : base;
+}
+
+WEAK void halide_shared_memory_lock(int handle) {
+    flock(handle, SHARED_MEMORY_LOCK_EX);
+}
+
+WEAK void halide_shared_memory_unlock(int handle) {
+    flock(handle, SHARED_MEMORY_LOCK_UN);
+}
+
+WEAK void halide_shared_memory_close(int handle, void *base, size_t size) {
+    if (base) {
+        munmap(base, size);
+    }
+    if (handle >= 0) {
+        close(handle);
+    }
+}
+
+}
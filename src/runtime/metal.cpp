@@ -25,6 +25,7 @@ struct mtl_compute_pipeline_state;
 struct mtl_library;
 struct mtl_function;
 struct mtl_compile_options;
+struct mtl_heap;
 
 WEAK mtl_buffer *new_buffer(mtl_device *device, size_t length) {
     typedef mtl_buffer *(*new_buffer_method)(objc_id device, objc_sel sel, size_t length, size_t options);
@@ -33,6 +34,46 @@ WEAK mtl_buffer *new_buffer(mtl_device *device, size_t length) {
                      length, 0  /* MTLResourceCPUCacheModeDefaultCache | MTLResourceStorageModeShared */);
 }
 
+WEAK bool responds_to_selector(objc_id obj, const char *selector) {
+    typedef bool (*responds_to_selector_method)(objc_id obj, objc_sel sel_1, objc_sel sel_2);
+    responds_to_selector_method method = (responds_to_selector_method)&objc_msgSend;
+    return (*method)(obj, sel_getUid("respondsToSelector:"), sel_getUid(selector));
+}
+
+// Create a heap of shared memory to sub-allocate buffers from. Returns NULL
+// if the device doesn't support it. Resources of heaps aren't tracked for
+// hazards by default, so we require a version of Metal that can turn that
+// on, as the kernels rely on Metal to order their accesses.
+WEAK mtl_heap *new_heap(mtl_device *device, size_t size) {
+    objc_id descriptor_class = objc_getClass("MTLHeapDescriptor");
+    if (descriptor_class == NULL || !responds_to_selector(device, "newHeapWithDescriptor:")) {
+        return NULL;
+    }
+    objc_id descriptor = objc_msgSend(objc_msgSend(descriptor_class, sel_getUid("alloc")), sel_getUid("init"));
+    if (!responds_to_selector(descriptor, "setHazardTrackingMode:")) {
+        release_ns_object(descriptor);
+        return NULL;
+    }
+    typedef void (*set_size_method)(objc_id descriptor, objc_sel sel, size_t value);
+    set_size_method set_value = (set_size_method)&objc_msgSend;
+    (*set_value)(descriptor, sel_getUid("setSize:"), size);
+    (*set_value)(descriptor, sel_getUid("setStorageMode:"), 0 /* MTLStorageModeShared */);
+    (*set_value)(descriptor, sel_getUid("setHazardTrackingMode:"), 2 /* MTLHazardTrackingModeTracked */);
+    typedef mtl_heap *(*new_heap_method)(objc_id device, objc_sel sel, objc_id descriptor);
+    new_heap_method method = (new_heap_method)&objc_msgSend;
+    mtl_heap *result = (*method)(device, sel_getUid("newHeapWithDescriptor:"), descriptor);
+    release_ns_object(descriptor);
+    return result;
+}
+
+// Returns NULL if the heap doesn't have enough free space.
+WEAK mtl_buffer *new_buffer_from_heap(mtl_heap *heap, size_t length) {
+    typedef mtl_buffer *(*new_buffer_method)(objc_id heap, objc_sel sel, size_t length, size_t options);
+    new_buffer_method method = (new_buffer_method)&objc_msgSend;
+    return (*method)(heap, sel_getUid("newBufferWithLength:options:"),
+                     length, 0  /* MTLResourceCPUCacheModeDefaultCache | MTLResourceStorageModeShared */);
+}
+
 WEAK mtl_command_queue *new_command_queue(mtl_device *device) {
     return (mtl_command_queue *)objc_msgSend(device, sel_getUid("newCommandQueue"));
 }
@@ -210,6 +251,23 @@ struct module_state {
 };
 WEAK module_state *state_list = NULL;
 
+// The command buffer that kernel launches are encoded into, which isn't
+// committed until the host needs results (or too many launches are
+// pending), so that the launches of a pipeline share a command buffer.
+// Protected by thread_lock, like the device and queue.
+WEAK mtl_command_buffer *pending_command_buffer = NULL;
+WEAK mtl_command_queue *pending_command_queue = NULL;
+WEAK int pending_dispatches = 0;
+const int max_pending_dispatches = 64;
+
+// The heap device allocations are made from when heap_size is non-zero (see
+// halide_metal_set_heap_size). Allocations that don't fit in it are made
+// from the device.
+WEAK mtl_heap *heap = NULL;
+WEAK mtl_device *heap_device = NULL;
+WEAK size_t heap_size = 0;
+WEAK bool heap_unsupported = false;
+
 // API Capabilities.  If more capabilities need to be checked,
 // this can be refactored to something more robust/general.
 WEAK bool metal_api_supports_set_bytes;
@@ -337,6 +395,67 @@ WEAK command_buffer_completed_handler_block_literal command_buffer_completed_han
     &command_buffer_completed_handler_descriptor
 };
 
+// Commit the pending command buffer, if any. The caller must hold the
+// context.
+WEAK void flush_pending_command_buffer(void *user_context) {
+    if (pending_command_buffer) {
+        debug(user_context) << "Metal - Committing command buffer with " << pending_dispatches << " dispatches\n";
+        commit_command_buffer(pending_command_buffer);
+        release_ns_object(pending_command_buffer);
+        pending_command_buffer = NULL;
+        pending_command_queue = NULL;
+        pending_dispatches = 0;
+    }
+}
+
+// Get the command buffer to encode a kernel launch into on 'queue'. The
+// caller must hold the context.
+WEAK mtl_command_buffer *get_pending_command_buffer(void *user_context, mtl_command_queue *queue) {
+    if (pending_command_buffer && pending_command_queue != queue) {
+        flush_pending_command_buffer(user_context);
+    }
+    if (pending_command_buffer == NULL) {
+        // The command buffer is autoreleased, and must outlive the
+        // autorelease pool of this call.
+        mtl_command_buffer *command_buffer = new_command_buffer(queue);
+        if (command_buffer == NULL) {
+            return NULL;
+        }
+        retain_ns_object(command_buffer);
+        // Reserve its place in the queue now, so it runs before work
+        // enqueued after this launch.
+        objc_msgSend(command_buffer, sel_getUid("enqueue"));
+        add_command_buffer_completed_handler(command_buffer, &command_buffer_completed_handler_block);
+        pending_command_buffer = command_buffer;
+        pending_command_queue = queue;
+    }
+    return pending_command_buffer;
+}
+
+// Allocate a buffer from the heap, creating it if necessary. Returns NULL
+// if the heap is disabled, unsupported, or full. The caller must hold the
+// context.
+WEAK mtl_buffer *new_buffer_from_heap(void *user_context, mtl_device *device, size_t length) {
+    if (heap_size == 0 || heap_unsupported || length > heap_size) {
+        return NULL;
+    }
+    if (heap && heap_device != device) {
+        release_ns_object(heap);
+        heap = NULL;
+    }
+    if (heap == NULL) {
+        debug(user_context) << "Metal - Allocating: new_heap " << (uint64_t)heap_size << "\n";
+        heap = new_heap(device, heap_size);
+        if (heap == NULL) {
+            debug(user_context) << "Metal - Heaps are not supported\n";
+            heap_unsupported = true;
+            return NULL;
+        }
+        heap_device = device;
+    }
+    return new_buffer_from_heap(heap, length);
+}
+
 }}}} // namespace Halide::Runtime::Internal::Metal
 
 using namespace Halide::Runtime::Internal::Metal;
@@ -372,7 +491,12 @@ WEAK int halide_metal_device_malloc(void *user_context, halide_buffer_t* buf) {
         return metal_context.error;
     }
 
-    mtl_buffer *metal_buf = new_buffer(metal_context.device, size);
+    mtl_buffer *metal_buf = new_buffer_from_heap(user_context, metal_context.device, size);
+    if (metal_buf == 0) {
+        metal_buf = new_buffer(metal_context.device, size);
+    } else {
+        debug(user_context) << "    allocated from heap " << heap << "\n";
+    }
     if (metal_buf == 0) {
         error(user_context) << "Metal: Failed to allocate buffer of size " << (int64_t)size << ".\n";
         return -1;
@@ -465,7 +589,9 @@ WEAK int halide_metal_initialize_kernels(void *user_context, void **state_ptr, c
 
 namespace {
 
-inline void halide_metal_device_sync_internal(mtl_command_queue *queue, struct halide_buffer_t *buffer) {
+inline void halide_metal_device_sync_internal(void *user_context, mtl_command_queue *queue, struct halide_buffer_t *buffer) {
+    // The sync command buffer runs after the pending one on the queue.
+    flush_pending_command_buffer(user_context);
     mtl_command_buffer *sync_command_buffer = new_command_buffer(queue);
     if (buffer != NULL) {
         mtl_buffer *metal_buffer = (mtl_buffer *)buffer->device;
@@ -491,7 +617,7 @@ WEAK int halide_metal_device_sync(void *user_context, struct halide_buffer_t *bu
         return metal_context.error;
     }
 
-    halide_metal_device_sync_internal(metal_context.queue, buffer);
+    halide_metal_device_sync_internal(user_context, metal_context.queue, buffer);
 
     #ifdef DEBUG_RUNTIME
     uint64_t t_after = halide_current_time_ns(user_context);
@@ -513,7 +639,7 @@ WEAK int halide_metal_device_release(void *user_context) {
     }
 
     if (device) {
-        halide_metal_device_sync_internal(queue, NULL);
+        halide_metal_device_sync_internal(user_context, queue, NULL);
 
         // Unload the modules attached to this device. Note that the list
         // nodes themselves are not freed, only the program objects are
@@ -530,6 +656,13 @@ WEAK int halide_metal_device_release(void *user_context) {
             state = state->next;
         }
 
+        if (heap) {
+            debug(user_context) << "Metal - Releasing: new_heap " << heap << "\n";
+            release_ns_object(heap);
+            heap = NULL;
+            heap_device = NULL;
+        }
+
         // Release the device itself, if we created it.
         if (acquired_device == device) {
             debug(user_context) <<  "Metal - Releasing: new_command_queue " << queue << "\n";
@@ -559,6 +692,11 @@ WEAK int halide_metal_copy_to_device(void *user_context, halide_buffer_t* buffer
 
     halide_assert(user_context, buffer->host && buffer->device);
 
+    // Kernels that haven't run yet may still read the buffer.
+    if (pending_command_buffer) {
+        halide_metal_device_sync_internal(user_context, metal_context.queue, NULL);
+    }
+
     device_copy c = make_host_to_device_copy(buffer);
     mtl_buffer *metal_buffer = (mtl_buffer *)c.dst;
     c.dst = (uint64_t)buffer_contents(metal_buffer);
@@ -577,7 +715,7 @@ WEAK int halide_metal_copy_to_device(void *user_context, halide_buffer_t* buffer
         total_extent.length = total_size;
         did_modify_range(metal_buffer, total_extent);
     }
-    halide_metal_device_sync_internal(metal_context.queue, buffer);
+    halide_metal_device_sync_internal(user_context, metal_context.queue, buffer);
 
     #ifdef DEBUG_RUNTIME
     uint64_t t_after = halide_current_time_ns(user_context);
@@ -598,7 +736,7 @@ WEAK int halide_metal_copy_to_host(void *user_context, halide_buffer_t* buffer)
         return metal_context.error;
     }
 
-    halide_metal_device_sync_internal(metal_context.queue, buffer);
+    halide_metal_device_sync_internal(user_context, metal_context.queue, buffer);
 
     halide_assert(user_context, buffer->host && buffer->device);
     halide_assert(user_context, buffer->dimensions <= MAX_COPY_DIMS);
@@ -641,7 +779,7 @@ WEAK int halide_metal_run(void *user_context,
         return metal_context.error;
     }
 
-    mtl_command_buffer *command_buffer = new_command_buffer(metal_context.queue);
+    mtl_command_buffer *command_buffer = get_pending_command_buffer(user_context, metal_context.queue);
     if (command_buffer == 0) {
         error(user_context) << "Metal: Could not allocate command buffer.\n";
         return -1;
@@ -756,9 +894,12 @@ WEAK int halide_metal_run(void *user_context,
                           threadsX, threadsY, threadsZ);
     end_encoding(encoder);
 
-    add_command_buffer_completed_handler(command_buffer, &command_buffer_completed_handler_block);
-
-    commit_command_buffer(command_buffer);
+    // The command buffer is committed when the host next needs the results,
+    // but don't let the device idle behind too many launches.
+    pending_dispatches++;
+    if (pending_dispatches >= max_pending_dispatches) {
+        flush_pending_command_buffer(user_context);
+    }
 
     release_ns_object(pipeline_state);
     release_ns_object(function);
@@ -771,6 +912,22 @@ WEAK int halide_metal_run(void *user_context,
     return 0;
 }
 
+WEAK int halide_metal_set_heap_size(void *user_context, size_t bytes) {
+    MetalContextHolder metal_context(user_context, false);
+    if (metal_context.error != 0) {
+        return metal_context.error;
+    }
+
+    if (bytes != heap_size && heap) {
+        // Buffers already allocated from the heap keep it alive.
+        release_ns_object(heap);
+        heap = NULL;
+        heap_device = NULL;
+    }
+    heap_size = bytes;
+    return 0;
+}
+
 WEAK int halide_metal_device_and_host_malloc(void *user_context, struct halide_buffer_t *buffer) {
     debug(user_context) << "halide_metal_device_and_host_malloc called.\n";
     int result = halide_metal_device_malloc(user_context, buffer);
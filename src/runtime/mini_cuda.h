@@ -22,6 +22,7 @@ typedef struct CUfunc_st *CUfunction;                     /**< CUDA function */
 typedef struct CUstream_st *CUstream;                     /**< CUDA stream */
 typedef struct CUevent_st *CUevent;                       /**< CUDA event */
 typedef struct CUarray_st* CUarray;
+typedef struct CUlinkState_st *CUlinkState;               /**< CUDA linker state */
 
 typedef enum CUjit_option_enum {
     CU_JIT_MAX_REGISTERS = 0,
@@ -37,6 +38,14 @@ typedef enum CUjit_option_enum {
     CU_JIT_FALLBACK_STRATEGY = 10
 } CUjit_option;
 
+typedef enum CUjitInputType_enum {
+    CU_JIT_INPUT_CUBIN = 0,
+    CU_JIT_INPUT_PTX = 1,
+    CU_JIT_INPUT_FATBINARY = 2,
+    CU_JIT_INPUT_OBJECT = 3,
+    CU_JIT_INPUT_LIBRARY = 4
+} CUjitInputType;
+
 typedef enum {
     CUDA_SUCCESS                              = 0,
     CUDA_ERROR_INVALID_VALUE                  = 1,
@@ -189,6 +198,15 @@ typedef enum {
     CU_DEVICE_ATTRIBUTE_MAX
 } CUdevice_attribute;
 
+typedef enum {
+    CU_FUNC_ATTRIBUTE_MAX_THREADS_PER_BLOCK = 0,                /**< Maximum number of threads per block the function can be launched with */
+    CU_FUNC_ATTRIBUTE_SHARED_SIZE_BYTES = 1,                    /**< Size in bytes of statically-allocated shared memory */
+    CU_FUNC_ATTRIBUTE_CONST_SIZE_BYTES = 2,                     /**< Size in bytes of user-allocated constant memory */
+    CU_FUNC_ATTRIBUTE_LOCAL_SIZE_BYTES = 3,                     /**< Size in bytes of local memory used by each thread */
+    CU_FUNC_ATTRIBUTE_NUM_REGS = 4,                             /**< Number of registers used by each thread */
+    CU_FUNC_ATTRIBUTE_MAX
+} CUfunction_attribute;
+
 typedef enum CUmemorytype_enum {
     CU_MEMORYTYPE_HOST = 0x01,
     CU_MEMORYTYPE_DEVICE = 0x02,
@@ -227,6 +245,8 @@ typedef struct CUDA_MEMCPY3D_st {
 } CUDA_MEMCPY3D;
 
 #define CU_POINTER_ATTRIBUTE_CONTEXT 1
+#define CU_STREAM_NON_BLOCKING 0x1
+#define CU_EVENT_DISABLE_TIMING 0x2
 
 }}}}
 
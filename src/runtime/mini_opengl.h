@@ -202,6 +202,7 @@ typedef void (*PFNDRAWBUFFERS)(GLsizei n, const GLenum *bufs);
 
 #define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
 #define GL_BUFFER_UPDATE_BARRIER_BIT      0x00000200
+#define GL_SHADER_STORAGE_BARRIER_BIT     0x00002000
 #define GL_ALL_BARRIER_BITS               0xFFFFFFFF
 
 typedef unsigned int  GLbitfield;
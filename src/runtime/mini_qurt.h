@@ -183,6 +183,7 @@ extern int qurt_thread_create (qurt_thread_t *thread_id, qurt_thread_attr_t *att
    QURT_EOK -- Thread successfully joined with valid status value.
  */
 extern int qurt_thread_join(unsigned int tid, int *status);
+extern qurt_thread_t qurt_thread_get_id(void);
 
 /** QuRT mutex type.
 
@@ -223,6 +224,7 @@ extern void qurt_mutex_unlock(qurt_mutex_t *lock); /* unlock */
 extern void qurt_cond_init(qurt_cond_t *cond);
 extern void qurt_cond_destroy(qurt_cond_t *cond);
 extern void qurt_cond_broadcast(qurt_cond_t *cond);
+extern void qurt_cond_signal(qurt_cond_t *cond);
 extern void qurt_cond_wait(qurt_cond_t *cond, qurt_mutex_t *mutex);
 
 typedef enum {
@@ -233,5 +235,9 @@ typedef enum {
 extern int qurt_hvx_lock(qurt_hvx_mode_t lock_mode);
 extern int qurt_hvx_unlock(void);
 extern int qurt_hvx_get_mode(void);
+// Not available in older versions of QuRT, so check it's non-NULL.
+// The low byte is the number of 64 byte contexts, and the next byte
+// the number of 128 byte contexts.
+extern int qurt_hvx_get_units(void) __attribute__((weak));
 
 }
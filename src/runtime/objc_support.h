@@ -28,6 +28,10 @@ WEAK void release_ns_object(objc_id obj) {
     objc_msgSend(obj, sel_getUid("release"));
 }
 
+WEAK void retain_ns_object(objc_id obj) {
+    objc_msgSend(obj, sel_getUid("retain"));
+}
+
 WEAK objc_id wrap_string_as_ns_string(const char *string, size_t length) {
     typedef objc_id (*init_with_bytes_no_copy_method)(objc_id ns_string, objc_sel sel, const char *string, size_t length, size_t encoding, uint8_t freeWhenDone);
     objc_id ns_string = objc_msgSend(objc_getClass("NSString"), sel_getUid("alloc"));
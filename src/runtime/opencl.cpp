@@ -2,6 +2,7 @@
 #include "scoped_spin_lock.h"
 #include "device_buffer_utils.h"
 #include "device_interface.h"
+#include "gpu_binary_cache.h"
 #include "printer.h"
 
 #include "mini_cl.h"
@@ -214,6 +215,257 @@ struct module_state {
 };
 WEAK module_state *state_list = NULL;
 
+// A device allocation that was freed, and can be reused by a later
+// allocation of the same size class on the same context. Reusing
+// allocations avoids the cost of clCreateBuffer, which can take
+// milliseconds on mobile GPUs. The command queue is in order, so it is
+// safe to reuse an allocation that queued kernels may still use.
+struct cached_allocation {
+    cl_context context;
+    cl_mem mem;
+    size_t size;
+    cached_allocation *next;
+};
+
+WEAK cached_allocation *allocation_cache = NULL;
+WEAK size_t allocation_cache_bytes = 0;
+// The device memory of allocations freed beyond this many cached bytes is
+// released.
+WEAK size_t allocation_cache_limit = 256 * 1024 * 1024;
+WEAK volatile int allocation_cache_lock = 0;
+
+// Round the size of an allocation up to its size class. The size classes are
+// spaced by a quarter of the next power of two, so a reused allocation is at
+// most 25% larger than requested.
+WEAK size_t allocation_size_class(size_t size) {
+    size_t pow2 = 512;
+    while (pow2 < size) {
+        pow2 *= 2;
+    }
+    size_t step = pow2 / 4;
+    return (size + step - 1) / step * step;
+}
+
+// Remove a cached allocation of 'size' bytes on 'ctx' from the cache.
+// Returns NULL if there is none.
+WEAK cl_mem take_cached_allocation(cl_context ctx, size_t size) {
+    cl_mem result = NULL;
+    cached_allocation *found = NULL;
+    while (__sync_lock_test_and_set(&allocation_cache_lock, 1)) { }
+    for (cached_allocation **prev_ptr = &allocation_cache; *prev_ptr; prev_ptr = &(*prev_ptr)->next) {
+        cached_allocation *a = *prev_ptr;
+        if (a->context == ctx && a->size == size) {
+            *prev_ptr = a->next;
+            allocation_cache_bytes -= size;
+            found = a;
+            break;
+        }
+    }
+    __sync_lock_release(&allocation_cache_lock);
+    if (found) {
+        result = found->mem;
+        free(found);
+    }
+    return result;
+}
+
+// Add an allocation made by halide_opencl_device_malloc to the cache.
+// Returns false if it can't be cached, in which case the caller must
+// release it. Sub-buffers, and buffers from elsewhere (e.g. wrapped with
+// halide_opencl_wrap_cl_mem) whose size isn't a size class, aren't cached.
+WEAK bool cache_allocation(cl_context ctx, cl_mem mem) {
+    size_t size = 0;
+    cl_mem parent = NULL;
+    if (clGetMemObjectInfo(mem, CL_MEM_SIZE, sizeof(size), &size, NULL) != CL_SUCCESS ||
+        clGetMemObjectInfo(mem, CL_MEM_ASSOCIATED_MEMOBJECT, sizeof(parent), &parent, NULL) != CL_SUCCESS ||
+        parent != NULL || size != allocation_size_class(size)) {
+        return false;
+    }
+
+    cached_allocation *a = (cached_allocation *)malloc(sizeof(cached_allocation));
+    if (a == NULL) {
+        return false;
+    }
+    a->context = ctx;
+    a->mem = mem;
+    a->size = size;
+    bool cached = false;
+    while (__sync_lock_test_and_set(&allocation_cache_lock, 1)) { }
+    if (allocation_cache_bytes + size <= allocation_cache_limit) {
+        a->next = allocation_cache;
+        allocation_cache = a;
+        allocation_cache_bytes += size;
+        cached = true;
+    }
+    __sync_lock_release(&allocation_cache_lock);
+    if (!cached) {
+        free(a);
+    }
+    return cached;
+}
+
+// Release the cached allocations on 'ctx'.
+WEAK cl_int release_cached_allocations(void *user_context, cl_context ctx) {
+    cached_allocation *to_free = NULL;
+    while (__sync_lock_test_and_set(&allocation_cache_lock, 1)) { }
+    cached_allocation **prev_ptr = &allocation_cache;
+    while (*prev_ptr) {
+        cached_allocation *a = *prev_ptr;
+        if (a->context == ctx) {
+            *prev_ptr = a->next;
+            allocation_cache_bytes -= a->size;
+            a->next = to_free;
+            to_free = a;
+        } else {
+            prev_ptr = &a->next;
+        }
+    }
+    __sync_lock_release(&allocation_cache_lock);
+
+    cl_int result = CL_SUCCESS;
+    while (to_free) {
+        cached_allocation *a = to_free;
+        to_free = a->next;
+        debug(user_context) << "    clReleaseMemObject " << (void *)a->mem << "\n";
+        cl_int err = clReleaseMemObject(a->mem);
+        if (err != CL_SUCCESS) {
+            result = err;
+        }
+        free(a);
+    }
+    return result;
+}
+
+// Device memory that is also the host memory of a buffer, allocated by
+// halide_opencl_device_and_host_malloc with CL_MEM_ALLOC_HOST_PTR or wrapped
+// around host memory by halide_opencl_wrap_host_ptr with
+// CL_MEM_USE_HOST_PTR. On devices that share memory with the host, the
+// copies between host and device are then replaced by mapping the memory
+// for the host and unmapping it for the device, which cost nothing. The
+// host may only access the memory while it is mapped, and the kernels only
+// while it is not.
+struct zero_copy_allocation {
+    cl_mem mem;
+    uint8_t *host;
+    size_t size;
+    bool mapped;
+    zero_copy_allocation *next;
+};
+
+WEAK zero_copy_allocation *zero_copy_allocations = NULL;
+WEAK volatile int zero_copy_allocations_lock = 0;
+
+// The allocations are only added and removed by the allocating and freeing
+// routines, which must not race with other uses of the same buffer, so an
+// entry found here stays valid while its buffer is in use.
+WEAK zero_copy_allocation *find_zero_copy_allocation(uint64_t device) {
+    zero_copy_allocation *result = NULL;
+    if (device == 0) {
+        return result;
+    }
+    ScopedSpinLock lock(&zero_copy_allocations_lock);
+    for (zero_copy_allocation *a = zero_copy_allocations; a; a = a->next) {
+        if ((uint64_t)a->mem == device) {
+            result = a;
+            break;
+        }
+    }
+    return result;
+}
+
+// Map 'mem' for the host, which must be the current use of 'host'. Returns
+// the mapped pointer, or NULL on failure.
+WEAK uint8_t *map_for_host(void *user_context, cl_command_queue q, cl_mem mem, size_t size) {
+    cl_int err = CL_SUCCESS;
+    debug(user_context) << "    clEnqueueMapBuffer " << (void *)mem << " -> ";
+    void *p = clEnqueueMapBuffer(q, mem, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, size,
+                                 0, NULL, NULL, &err);
+    if (err != CL_SUCCESS || p == NULL) {
+        debug(user_context) << get_opencl_error_name(err) << "\n";
+        error(user_context) << "CL: clEnqueueMapBuffer failed: " << get_opencl_error_name(err);
+        return NULL;
+    }
+    debug(user_context) << p << "\n";
+    return (uint8_t *)p;
+}
+
+// Make a zero-copy allocation visible to the host or to the device.
+WEAK int set_zero_copy_mapped(void *user_context, cl_command_queue q, zero_copy_allocation *a, bool mapped) {
+    if (a->mapped == mapped) {
+        return 0;
+    }
+    if (mapped) {
+        uint8_t *p = map_for_host(user_context, q, a->mem, a->size);
+        if (p == NULL) {
+            return halide_error_code_copy_to_host_failed;
+        }
+        if (p != a->host) {
+            // The host memory of the buffer must not move. Memory from
+            // CL_MEM_USE_HOST_PTR is always mapped to the same address, and
+            // so is CL_MEM_ALLOC_HOST_PTR memory on the devices we know of.
+            clEnqueueUnmapMemObject(q, a->mem, p, 0, NULL, NULL);
+            error(user_context) << "CL: clEnqueueMapBuffer mapped " << (void *)a->mem
+                                << " to " << (void *)p << " instead of " << (void *)a->host;
+            return halide_error_code_copy_to_host_failed;
+        }
+    } else {
+        debug(user_context) << "    clEnqueueUnmapMemObject " << (void *)a->mem << "\n";
+        cl_int err = clEnqueueUnmapMemObject(q, a->mem, a->host, 0, NULL, NULL);
+        if (err != CL_SUCCESS) {
+            error(user_context) << "CL: clEnqueueUnmapMemObject failed: " << get_opencl_error_name(err);
+            return halide_error_code_copy_to_device_failed;
+        }
+    }
+    a->mapped = mapped;
+    return 0;
+}
+
+// Make a zero-copy allocation of 'mem', which is mapped at 'host', for 'buf'.
+WEAK int add_zero_copy_allocation(void *user_context, halide_buffer_t *buf, cl_mem mem, uint8_t *host) {
+    zero_copy_allocation *a = (zero_copy_allocation *)malloc(sizeof(zero_copy_allocation));
+    if (a == NULL) {
+        return halide_error_code_out_of_memory;
+    }
+    a->mem = mem;
+    a->host = host;
+    a->size = buf->size_in_bytes();
+    a->mapped = true;
+    {
+        ScopedSpinLock lock(&zero_copy_allocations_lock);
+        a->next = zero_copy_allocations;
+        zero_copy_allocations = a;
+    }
+    buf->host = host;
+    buf->device = (uint64_t)mem;
+    buf->device_interface = &opencl_device_interface;
+    buf->device_interface->impl->use_module();
+    return 0;
+}
+
+// Forget the zero-copy allocation of 'mem', if it is one, unmapping it so
+// that it can be released. Returns false if it isn't one.
+WEAK bool remove_zero_copy_allocation(void *user_context, cl_command_queue q, cl_mem mem) {
+    zero_copy_allocation *found = NULL;
+    {
+        ScopedSpinLock lock(&zero_copy_allocations_lock);
+        for (zero_copy_allocation **prev_ptr = &zero_copy_allocations; *prev_ptr; prev_ptr = &(*prev_ptr)->next) {
+            if ((*prev_ptr)->mem == mem) {
+                found = *prev_ptr;
+                *prev_ptr = found->next;
+                break;
+            }
+        }
+    }
+    if (found == NULL) {
+        return false;
+    }
+    if (found->mapped) {
+        clEnqueueUnmapMemObject(q, mem, found->host, 0, NULL, NULL);
+    }
+    free(found);
+    return true;
+}
+
 WEAK bool validate_device_pointer(void *user_context, halide_buffer_t* buf, size_t size=0) {
     if (buf->device == 0) {
         return true;
@@ -455,6 +707,89 @@ WEAK int create_opencl_context(void *user_context, cl_context *ctx, cl_command_q
     return err;
 }
 
+// Compute the key of the program built from 'src' with 'options' for the
+// device 'dev' in the on-disk kernel cache. Returns false if the cache is
+// disabled.
+WEAK bool get_program_binary_key(void *user_context, cl_device_id dev, const char *src,
+                                 const char *options, gpu_binary_key *key) {
+    if (get_gpu_binary_cache_dir() == NULL) {
+        return false;
+    }
+
+    char name[256], device_version[256], driver_version[256];
+    cl_device_info params[] = { CL_DEVICE_NAME, CL_DEVICE_VERSION, CL_DRIVER_VERSION };
+    char *values[] = { name, device_version, driver_version };
+    uint64_t device_hash = gpu_binary_hash_init;
+    for (int i = 0; i < 3; i++) {
+        if (clGetDeviceInfo(dev, params[i], sizeof(name), values[i], NULL) != CL_SUCCESS) {
+            return false;
+        }
+        values[i][sizeof(name) - 1] = 0;
+        device_hash = gpu_binary_hash(device_hash, values[i]);
+        device_hash = gpu_binary_hash(device_hash, "\n");
+    }
+
+    size_t size = strlen(src);
+    key->source_hash = gpu_binary_hash(gpu_binary_hash(gpu_binary_hash_init, src, size), options);
+    key->source_size = size;
+    key->device_hash = device_hash;
+    return true;
+}
+
+// Create and build a program from a binary in the on-disk kernel
+// cache. Returns NULL if there is none, or if it can't be built.
+WEAK cl_program load_cached_program(void *user_context, cl_context context, cl_device_id dev,
+                                    const gpu_binary_key &key) {
+    void *binary = NULL;
+    size_t binary_size = 0;
+    if (!load_gpu_binary(user_context, "opencl_", key, &binary, &binary_size)) {
+        return NULL;
+    }
+
+    cl_int err, binary_status;
+    const unsigned char *binaries[] = { (const unsigned char *)binary };
+    debug(user_context) << "    clCreateProgramWithBinary -> ";
+    cl_program program = clCreateProgramWithBinary(context, 1, &dev, &binary_size, binaries,
+                                                   &binary_status, &err);
+    free(binary);
+    if (err != CL_SUCCESS || binary_status != CL_SUCCESS) {
+        debug(user_context) << get_opencl_error_name(err != CL_SUCCESS ? err : binary_status) << "\n";
+        if (err == CL_SUCCESS) {
+            clReleaseProgram(program);
+        }
+        return NULL;
+    }
+    debug(user_context) << (void *)program << "\n";
+
+    err = clBuildProgram(program, 1, &dev, NULL, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        debug(user_context) << "    clBuildProgram of cached binary failed: "
+                            << get_opencl_error_name(err) << "\n";
+        clReleaseProgram(program);
+        return NULL;
+    }
+    return program;
+}
+
+// Store the binary of a program built for a single device in the on-disk
+// kernel cache.
+WEAK void store_program_binary(void *user_context, cl_program program, const gpu_binary_key &key) {
+    size_t binary_size = 0;
+    if (clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(binary_size), &binary_size, NULL) != CL_SUCCESS ||
+        binary_size == 0) {
+        return;
+    }
+    unsigned char *binary = (unsigned char *)malloc(binary_size);
+    if (binary == NULL) {
+        return;
+    }
+    unsigned char *binaries[] = { binary };
+    if (clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(binaries), binaries, NULL) == CL_SUCCESS) {
+        store_gpu_binary(user_context, "opencl_", key, binary, binary_size);
+    }
+    free(binary);
+}
+
 }}}} // namespace Halide::Runtime::Internal::OpenCL
 
 extern "C" {
@@ -483,8 +818,16 @@ WEAK int halide_opencl_device_free(void *user_context, halide_buffer_t* buf) {
     #endif
 
     halide_assert(user_context, validate_device_pointer(user_context, buf));
-    debug(user_context) << "    clReleaseMemObject " << (void *)dev_ptr << "\n";
-    cl_int result = clReleaseMemObject((cl_mem)dev_ptr);
+    cl_int result = CL_SUCCESS;
+    // Zero-copy allocations share their memory with the host allocation,
+    // so they are never cached.
+    bool zero_copy = remove_zero_copy_allocation(user_context, ctx.cmd_queue, dev_ptr);
+    if (!zero_copy && cache_allocation(ctx.context, dev_ptr)) {
+        debug(user_context) << "    caching device allocation " << (void *)dev_ptr << "\n";
+    } else {
+        debug(user_context) << "    clReleaseMemObject " << (void *)dev_ptr << "\n";
+        result = clReleaseMemObject(dev_ptr);
+    }
     // If clReleaseMemObject fails, it is unlikely to succeed in a later call, so
     // we just end our reference to it regardless.
     buf->device = 0;
@@ -571,41 +914,56 @@ WEAK int halide_opencl_initialize_kernels(void *user_context, void **state_ptr,
         options << "-D MAX_CONSTANT_BUFFER_SIZE=" << max_constant_buffer_size
                 << " -D MAX_CONSTANT_ARGS=" << max_constant_args;
 
-        const char * sources[] = { src };
-        debug(user_context) << "    clCreateProgramWithSource -> ";
-        cl_program program = clCreateProgramWithSource(ctx.context, 1, &sources[0], NULL, &err );
-        if (err != CL_SUCCESS) {
-            debug(user_context) << get_opencl_error_name(err) << "\n";
-            error(user_context) << "CL: clCreateProgramWithSource failed: "
-                                << get_opencl_error_name(err);
-            return err;
-        } else {
-            debug(user_context) << (void *)program << "\n";
+        // Use the binary from the on-disk kernel cache if there is one.
+        gpu_binary_key key;
+        bool use_binary_cache = get_program_binary_key(user_context, dev, src, options.str(), &key);
+        cl_program program = NULL;
+        if (use_binary_cache) {
+            program = load_cached_program(user_context, ctx.context, dev, key);
         }
-        (*state)->program = program;
+        if (program) {
+            (*state)->program = program;
+        } else {
+            const char * sources[] = { src };
+            debug(user_context) << "    clCreateProgramWithSource -> ";
+            program = clCreateProgramWithSource(ctx.context, 1, &sources[0], NULL, &err );
+            if (err != CL_SUCCESS) {
+                debug(user_context) << get_opencl_error_name(err) << "\n";
+                error(user_context) << "CL: clCreateProgramWithSource failed: "
+                                    << get_opencl_error_name(err);
+                return err;
+            } else {
+                debug(user_context) << (void *)program << "\n";
+            }
+            (*state)->program = program;
 
-        debug(user_context) << "    clBuildProgram " << (void *)program
-                            << " " << options.str() << "\n";
-        err = clBuildProgram(program, 1, devices, options.str(), NULL, NULL );
-        if (err != CL_SUCCESS) {
+            debug(user_context) << "    clBuildProgram " << (void *)program
+                                << " " << options.str() << "\n";
+            err = clBuildProgram(program, 1, devices, options.str(), NULL, NULL );
+            if (err != CL_SUCCESS) {
 
-            // Allocate an appropriately sized buffer for the build log.
-            char buffer[8192];
-
-            // Get build log
-            if (clGetProgramBuildInfo(program, dev,
-                                      CL_PROGRAM_BUILD_LOG,
-                                      sizeof(buffer), buffer,
-                                      NULL) == CL_SUCCESS) {
-                error(user_context) << "CL: clBuildProgram failed: "
-                                    << get_opencl_error_name(err)
-                                    << "\nBuild Log:\n"
-                                    << buffer << "\n";
-            } else {
-                error(user_context) << "clGetProgramBuildInfo failed";
+                // Allocate an appropriately sized buffer for the build log.
+                char buffer[8192];
+
+                // Get build log
+                if (clGetProgramBuildInfo(program, dev,
+                                          CL_PROGRAM_BUILD_LOG,
+                                          sizeof(buffer), buffer,
+                                          NULL) == CL_SUCCESS) {
+                    error(user_context) << "CL: clBuildProgram failed: "
+                                        << get_opencl_error_name(err)
+                                        << "\nBuild Log:\n"
+                                        << buffer << "\n";
+                } else {
+                    error(user_context) << "clGetProgramBuildInfo failed";
+                }
+
+                return err;
             }
 
-            return err;
+            if (use_binary_cache) {
+                store_program_binary(user_context, program, key);
+            }
         }
     }
 
@@ -661,6 +1019,9 @@ WEAK int halide_opencl_device_release(void *user_context) {
         err = clFinish(q);
         halide_assert(user_context, err == CL_SUCCESS);
 
+        err = release_cached_allocations(user_context, ctx);
+        halide_assert(user_context, err == CL_SUCCESS);
+
         // Unload the modules attached to this context. Note that the list
         // nodes themselves are not freed, only the program objects are
         // released. Subsequent calls to halide_init_kernels might re-create
@@ -724,16 +1085,29 @@ WEAK int halide_opencl_device_malloc(void *user_context, halide_buffer_t* buf) {
     uint64_t t_before = halide_current_time_ns(user_context);
     #endif
 
-    cl_int err;
-    debug(user_context) << "    clCreateBuffer -> " << (int)size << " ";
-    cl_mem dev_ptr = clCreateBuffer(ctx.context, CL_MEM_READ_WRITE, size, NULL, &err);
-    if (err != CL_SUCCESS || dev_ptr == 0) {
-        debug(user_context) << get_opencl_error_name(err) << "\n";
-        error(user_context) << "CL: clCreateBuffer failed: "
-                            << get_opencl_error_name(err);
-        return err;
+    size = allocation_size_class(size);
+    cl_mem dev_ptr = take_cached_allocation(ctx.context, size);
+    if (dev_ptr) {
+        debug(user_context) << "    reusing cached device allocation " << (void *)dev_ptr << "\n";
     } else {
-        debug(user_context) << (void *)dev_ptr << "\n";
+        cl_int err;
+        debug(user_context) << "    clCreateBuffer -> " << (int)size << " ";
+        dev_ptr = clCreateBuffer(ctx.context, CL_MEM_READ_WRITE, size, NULL, &err);
+        if (err == CL_MEM_OBJECT_ALLOCATION_FAILURE || err == CL_OUT_OF_RESOURCES) {
+            // Give the cached allocations back to the driver and try again.
+            debug(user_context) << get_opencl_error_name(err) << "\n";
+            release_cached_allocations(user_context, ctx.context);
+            debug(user_context) << "    clCreateBuffer -> " << (int)size << " ";
+            dev_ptr = clCreateBuffer(ctx.context, CL_MEM_READ_WRITE, size, NULL, &err);
+        }
+        if (err != CL_SUCCESS || dev_ptr == 0) {
+            debug(user_context) << get_opencl_error_name(err) << "\n";
+            error(user_context) << "CL: clCreateBuffer failed: "
+                                << get_opencl_error_name(err);
+            return err;
+        } else {
+            debug(user_context) << (void *)dev_ptr << "\n";
+        }
     }
 
     buf->device = (uint64_t)dev_ptr;
@@ -832,6 +1206,27 @@ WEAK int halide_opencl_buffer_copy(void *user_context, struct halide_buffer_t *s
     halide_assert(user_context, from_host || src->device);
     halide_assert(user_context, to_host || dst->device);
 
+    // Copies between the host and device memory of a zero-copy
+    // allocation just hand the memory over.
+    zero_copy_allocation *zero_copy = NULL;
+    if (src == dst && from_host != to_host) {
+        zero_copy = find_zero_copy_allocation(dst->device);
+        if (zero_copy && zero_copy->host != dst->host) {
+            zero_copy = NULL;
+        }
+    }
+    if (zero_copy) {
+        ClContext ctx(user_context);
+        if (ctx.error != CL_SUCCESS) {
+            return ctx.error;
+        }
+        debug(user_context)
+            << "CL: halide_opencl_buffer_copy (user_context: " << user_context
+            << ", buf: " << dst << ") of zero-copy memory to the "
+            << (to_host ? "host" : "device") << "\n";
+        return set_zero_copy_mapped(user_context, ctx.cmd_queue, zero_copy, to_host);
+    }
+
     device_copy c = make_buffer_copy(src, from_host, dst, to_host);
 
     int err = 0;
@@ -859,8 +1254,12 @@ WEAK int halide_opencl_buffer_copy(void *user_context, struct halide_buffer_t *s
 
         // The reads/writes above are all non-blocking, so empty the command
         // queue before we proceed so that other host code won't write
-        // to the buffer while the above writes are still running.
-        clFinish(ctx.cmd_queue);
+        // to the buffer while the above writes are still running. Copies
+        // between device buffers are ordered with the kernels by the
+        // command queue, so they don't need to wait.
+        if (from_host || to_host) {
+            clFinish(ctx.cmd_queue);
+        }
 
         #ifdef DEBUG_RUNTIME
         uint64_t t_after = halide_current_time_ns(user_context);
@@ -946,6 +1345,16 @@ WEAK int halide_opencl_run(void *user_context,
         if (arg_is_buffer[i]) {
             halide_assert(user_context, arg_sizes[i] == sizeof(uint64_t));
             uint64_t opencl_handle = ((halide_buffer_t *)this_arg)->device;
+            // Zero-copy memory that wasn't copied to the device since the
+            // host last used it is still mapped.
+            zero_copy_allocation *zero_copy = find_zero_copy_allocation(opencl_handle);
+            if (zero_copy) {
+                int result = set_zero_copy_mapped(user_context, ctx.cmd_queue, zero_copy, false);
+                if (result != 0) {
+                    clReleaseKernel(f);
+                    return result;
+                }
+            }
             debug(user_context) << "Mapped dev handle is: " << (void *)opencl_handle << "\n";
             // In 32-bit mode, opencl only wants the bottom 32 bits of
             // the handle, so use sizeof(void *) instead of
@@ -1007,12 +1416,110 @@ WEAK int halide_opencl_run(void *user_context,
     return 0;
 }
 
+// The host memory of buffers allocated on both the host and the device is
+// allocated by OpenCL with CL_MEM_ALLOC_HOST_PTR, which devices that share
+// memory with the host make the same memory as the device allocation.
 WEAK int halide_opencl_device_and_host_malloc(void *user_context, struct halide_buffer_t *buf) {
-    return halide_default_device_and_host_malloc(user_context, buf, &opencl_device_interface);
+    debug(user_context)
+        << "CL: halide_opencl_device_and_host_malloc (user_context: " << user_context
+        << ", buf: " << buf << ")\n";
+
+    size_t size = buf->size_in_bytes();
+    halide_assert(user_context, size != 0);
+    halide_assert(user_context, buf->device == 0 && buf->host == NULL);
+    for (int i = 0; i < buf->dimensions; i++) {
+        halide_assert(user_context, buf->dim[i].stride >= 0);
+    }
+
+    ClContext ctx(user_context);
+    if (ctx.error != CL_SUCCESS) {
+        return ctx.error;
+    }
+
+    cl_int err = CL_SUCCESS;
+    debug(user_context) << "    clCreateBuffer (CL_MEM_ALLOC_HOST_PTR) -> " << (int)size << " ";
+    cl_mem mem = clCreateBuffer(ctx.context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, size, NULL, &err);
+    if (err != CL_SUCCESS || mem == 0) {
+        // Fall back to separate host and device allocations.
+        debug(user_context) << get_opencl_error_name(err) << "\n";
+        return halide_default_device_and_host_malloc(user_context, buf, &opencl_device_interface);
+    }
+    debug(user_context) << (void *)mem << "\n";
+
+    uint8_t *host = map_for_host(user_context, ctx.cmd_queue, mem, size);
+    int result = host ? add_zero_copy_allocation(user_context, buf, mem, host) : halide_error_code_out_of_memory;
+    if (result != 0) {
+        if (host) {
+            clEnqueueUnmapMemObject(ctx.cmd_queue, mem, host, 0, NULL, NULL);
+        }
+        clReleaseMemObject(mem);
+    }
+    return result;
 }
 
 WEAK int halide_opencl_device_and_host_free(void *user_context, struct halide_buffer_t *buf) {
-    return halide_default_device_and_host_free(user_context, buf, &opencl_device_interface);
+    debug(user_context)
+        << "CL: halide_opencl_device_and_host_free (user_context: " << user_context
+        << ", buf: " << buf << ")\n";
+
+    zero_copy_allocation *zero_copy = find_zero_copy_allocation(buf->device);
+    if (zero_copy == NULL || zero_copy->host != buf->host) {
+        return halide_default_device_and_host_free(user_context, buf, &opencl_device_interface);
+    }
+    // The host memory is released with the device memory.
+    int result = halide_device_free(user_context, buf);
+    buf->host = NULL;
+    buf->set_host_dirty(false);
+    buf->set_device_dirty(false);
+    return result;
+}
+
+WEAK int halide_opencl_wrap_host_ptr(void *user_context, struct halide_buffer_t *buf) {
+    debug(user_context)
+        << "CL: halide_opencl_wrap_host_ptr (user_context: " << user_context
+        << ", buf: " << buf << ")\n";
+
+    halide_assert(user_context, buf->device == 0 && buf->host != NULL);
+    if (buf->device != 0 || buf->host == NULL) {
+        return -2;
+    }
+    for (int i = 0; i < buf->dimensions; i++) {
+        halide_assert(user_context, buf->dim[i].stride >= 0);
+    }
+
+    ClContext ctx(user_context);
+    if (ctx.error != CL_SUCCESS) {
+        return ctx.error;
+    }
+
+    size_t size = buf->size_in_bytes();
+    cl_int err = CL_SUCCESS;
+    debug(user_context) << "    clCreateBuffer (CL_MEM_USE_HOST_PTR) " << (void *)buf->host << " -> ";
+    cl_mem mem = clCreateBuffer(ctx.context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, size, buf->host, &err);
+    if (err != CL_SUCCESS || mem == 0) {
+        debug(user_context) << get_opencl_error_name(err) << "\n";
+        error(user_context) << "CL: clCreateBuffer failed: " << get_opencl_error_name(err);
+        return err;
+    }
+    debug(user_context) << (void *)mem << "\n";
+
+    // Map the memory back to the host, which still owns it until the
+    // buffer is copied to the device.
+    uint8_t *host = map_for_host(user_context, ctx.cmd_queue, mem, size);
+    int result = halide_error_code_copy_to_host_failed;
+    if (host == buf->host) {
+        result = add_zero_copy_allocation(user_context, buf, mem, host);
+    } else if (host) {
+        error(user_context) << "CL: clEnqueueMapBuffer mapped " << (void *)mem
+                            << " to " << (void *)host << " instead of " << (void *)buf->host;
+    }
+    if (result != 0) {
+        if (host) {
+            clEnqueueUnmapMemObject(ctx.cmd_queue, mem, host, 0, NULL, NULL);
+        }
+        clReleaseMemObject(mem);
+    }
+    return result;
 }
 
 WEAK int halide_opencl_wrap_cl_mem(void *user_context, struct halide_buffer_t *buf, uint64_t mem) {
@@ -1053,6 +1560,33 @@ WEAK uintptr_t halide_opencl_get_cl_mem(void *user_context, halide_buffer_t *buf
     return (uintptr_t)buf->device;
 }
 
+WEAK int halide_opencl_set_allocation_cache_size(void *user_context, size_t bytes) {
+    debug(user_context)
+        << "CL: halide_opencl_set_allocation_cache_size (user_context: " << user_context
+        << ", bytes: " << (uint64_t)bytes << ")\n";
+
+    while (__sync_lock_test_and_set(&allocation_cache_lock, 1)) { }
+    allocation_cache_limit = bytes;
+    bool over_limit = allocation_cache_bytes > allocation_cache_limit;
+    __sync_lock_release(&allocation_cache_lock);
+
+    if (over_limit) {
+        return halide_opencl_release_unused_device_allocations(user_context);
+    }
+    return 0;
+}
+
+WEAK int halide_opencl_release_unused_device_allocations(void *user_context) {
+    debug(user_context)
+        << "CL: halide_opencl_release_unused_device_allocations (user_context: " << user_context << ")\n";
+
+    ClContext ctx(user_context);
+    if (ctx.error != CL_SUCCESS) {
+        return ctx.error;
+    }
+    return release_cached_allocations(user_context, ctx.context);
+}
+
 WEAK int halide_opencl_device_crop(void *user_context,
                                     const struct halide_buffer_t *src,
                                     struct halide_buffer_t *dst) {
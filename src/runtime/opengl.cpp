@@ -170,6 +170,21 @@ struct ModuleState {
     ModuleState *next;
 };
 
+// A texture allocated by the runtime. Freed textures are kept for
+// reuse by later allocations of the same size and format, since
+// creating textures is slow on many drivers, and multi-stage
+// pipelines allocate the same intermediates every time they run.
+struct TextureInfo {
+    GLuint id;
+    GLint width, height;
+    GLint internal_format, format, type;
+    bool in_use;
+    TextureInfo *next;
+};
+
+// The most freed textures to keep for reuse.
+WEAK int max_free_textures = 8;
+
 
 // All persistent state maintained by the runtime.
 struct GlobalState {
@@ -188,6 +203,10 @@ struct GlobalState {
 
     // Various objects shared by all filter kernels
     GLuint framebuffer_id;
+    // The texture attached to framebuffer_id, or zero if unknown.
+    GLuint framebuffer_texture;
+    // The textures allocated by the runtime, most recently freed first.
+    TextureInfo *textures;
     GLuint vertex_array_object;
     GLuint vertex_buffer;
     GLuint element_buffer;
@@ -211,6 +230,112 @@ WEAK bool GlobalState::CheckAndReportError(void *user_context, const char *locat
 
 WEAK GlobalState global_state;
 
+// Take a free texture of the given size and format from the pool, or
+// return zero if there isn't one.
+WEAK GLuint take_free_texture(GLint width, GLint height,
+                              GLint internal_format, GLint format, GLint type) {
+    for (TextureInfo *t = global_state.textures; t; t = t->next) {
+        if (!t->in_use &&
+            t->width == width && t->height == height &&
+            t->internal_format == internal_format &&
+            t->format == format && t->type == type) {
+            t->in_use = true;
+            return t->id;
+        }
+    }
+    return 0;
+}
+
+// Delete a texture, forgetting it if it's attached to the framebuffer.
+WEAK void delete_texture(GLuint tex) {
+    if (global_state.framebuffer_texture == tex) {
+        global_state.framebuffer_texture = 0;
+    }
+    global_state.DeleteTextures(1, &tex);
+}
+
+// Return a texture to the pool, and delete the least recently freed
+// textures beyond max_free_textures. Returns false if the texture
+// wasn't allocated by the runtime.
+WEAK bool return_texture_to_pool(GLuint tex) {
+    TextureInfo **prev = &global_state.textures;
+    TextureInfo *t = global_state.textures;
+    while (t && t->id != tex) {
+        prev = &t->next;
+        t = t->next;
+    }
+    if (!t || !t->in_use) {
+        return false;
+    }
+
+    // Move it to the front of the list.
+    t->in_use = false;
+    *prev = t->next;
+    t->next = global_state.textures;
+    global_state.textures = t;
+
+    int free_textures = 0;
+    prev = &global_state.textures;
+    while ((t = *prev)) {
+        if (!t->in_use && ++free_textures > max_free_textures) {
+            delete_texture(t->id);
+            *prev = t->next;
+            free(t);
+        } else {
+            prev = &t->next;
+        }
+    }
+    return true;
+}
+
+// Forget all the textures in the pool, deleting the free ones if the
+// context is still valid.
+WEAK void release_texture_pool(bool delete_free_textures) {
+    TextureInfo *t = global_state.textures;
+    while (t) {
+        TextureInfo *next = t->next;
+        if (delete_free_textures && !t->in_use) {
+            delete_texture(t->id);
+        }
+        free(t);
+        t = next;
+    }
+    global_state.textures = NULL;
+}
+
+// Attach a texture to the framebuffer used for rendering to and
+// reading back textures. Multi-stage pipelines mostly attach the same
+// few textures over and over, and checking the framebuffer is
+// complete can stall the driver, so both are skipped if the texture
+// is already attached.
+WEAK int bind_framebuffer_texture(void *user_context, GLuint tex) {
+    global_state.BindFramebuffer(GL_FRAMEBUFFER, global_state.framebuffer_id);
+    if (global_state.CheckAndReportError(user_context, "bind_framebuffer_texture BindFramebuffer")) {
+        return 1;
+    }
+    if (global_state.framebuffer_texture == tex) {
+        return 0;
+    }
+
+    global_state.framebuffer_texture = 0;
+    global_state.FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
+    if (global_state.CheckAndReportError(user_context, "bind_framebuffer_texture FramebufferTexture2D")) {
+        return 1;
+    }
+    GLenum status = global_state.CheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (global_state.CheckAndReportError(user_context, "bind_framebuffer_texture CheckFramebufferStatus")) {
+        return 1;
+    }
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        error(user_context)
+            << "Setting up GL framebuffer " << global_state.framebuffer_id
+            << " failed (" << status << ")";
+        return 1;
+    }
+    global_state.framebuffer_texture = tex;
+    return 0;
+}
+
 // Saves & restores OpenGL state
 class GLStateSaver {
     public:
@@ -554,6 +679,8 @@ WEAK void GlobalState::init() {
     major_version = 2;
     minor_version = 0;
     framebuffer_id = 0;
+    framebuffer_texture = 0;
+    textures = NULL;
     vertex_array_object = vertex_buffer = element_buffer = 0;
     have_vertex_array_objects = false;
     have_texture_rg = false;
@@ -741,6 +868,7 @@ WEAK int halide_opengl_device_release(void *user_context) {
 
     debug(user_context) << "halide_opengl_release\n";
     global_state.DeleteFramebuffers(1, &global_state.framebuffer_id);
+    release_texture_pool(true);
 
     ModuleState *mod = state_list;
     while (mod) {
@@ -916,29 +1044,9 @@ WEAK int halide_opengl_device_malloc(void *user_context, halide_buffer_t *buf) {
             return 1;
         }
 
-        // Generate texture ID
-        global_state.GenTextures(1, &tex);
-        if (global_state.CheckAndReportError(user_context, "halide_opengl_device_malloc GenTextures")) {
-            global_state.DeleteTextures(1, &tex);
-            return 1;
-        }
-
-        // Set parameters for this texture: no interpolation and clamp to edges.
-        global_state.BindTexture(GL_TEXTURE_2D, tex);
-        global_state.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        global_state.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        global_state.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        global_state.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        if (global_state.CheckAndReportError(user_context, "halide_opengl_device_malloc binding texture")) {
-            global_state.DeleteTextures(1, &tex);
-            return 1;
-        }
-
-        // Create empty texture here and fill it with glTexSubImage2D later.
         GLint internal_format, format, type;
         if (!get_texture_format(user_context, buf, &internal_format, &format, &type)) {
             error(user_context) << "Invalid texture format";
-            global_state.DeleteTextures(1, &tex);
             return 1;
         }
 
@@ -948,20 +1056,64 @@ WEAK int halide_opengl_device_malloc(void *user_context, halide_buffer_t *buf) {
             return 1;
         }
 
-        global_state.TexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, type, NULL);
-        if (global_state.CheckAndReportError(user_context, "halide_opengl_device_malloc TexImage2D")) {
-            global_state.DeleteTextures(1, &tex);
-            return 1;
+        // Reuse a free texture if there's one of the right size and
+        // format. Its contents are undefined, like a new one's.
+        tex = take_free_texture(width, height, internal_format, format, type);
+        if (tex) {
+            debug(user_context) << "Reusing texture " << tex
+                                << " of size " << width << " x " << height << "\n";
+        } else {
+            // Generate texture ID
+            global_state.GenTextures(1, &tex);
+            if (global_state.CheckAndReportError(user_context, "halide_opengl_device_malloc GenTextures")) {
+                global_state.DeleteTextures(1, &tex);
+                return 1;
+            }
+
+            // Set parameters for this texture: no interpolation and clamp to edges.
+            global_state.BindTexture(GL_TEXTURE_2D, tex);
+            global_state.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            global_state.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            global_state.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            global_state.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            if (global_state.CheckAndReportError(user_context, "halide_opengl_device_malloc binding texture")) {
+                global_state.DeleteTextures(1, &tex);
+                return 1;
+            }
+
+            // Create empty texture here and fill it with glTexSubImage2D later.
+            global_state.TexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, type, NULL);
+            if (global_state.CheckAndReportError(user_context, "halide_opengl_device_malloc TexImage2D")) {
+                global_state.DeleteTextures(1, &tex);
+                return 1;
+            }
+
+            TextureInfo *info = (TextureInfo *)malloc(sizeof(TextureInfo));
+            if (!info) {
+                error(user_context) << "halide_opengl_device_malloc: malloc failed\n";
+                global_state.DeleteTextures(1, &tex);
+                return 1;
+            }
+            info->id = tex;
+            info->width = width;
+            info->height = height;
+            info->internal_format = internal_format;
+            info->format = format;
+            info->type = type;
+            info->in_use = true;
+            info->next = global_state.textures;
+            global_state.textures = info;
+
+            debug(user_context) << "Allocated texture " << tex
+                                << " of size " << width << " x " << height << "\n";
+
+            global_state.BindTexture(GL_TEXTURE_2D, 0);
         }
 
         buf->device = tex;
         buf->device_interface = &opengl_device_interface;
         buf->device_interface->impl->use_module();
         halide_allocated = true;
-        debug(user_context) << "Allocated texture " << tex
-                            << " of size " << width << " x " << height << "\n";
-
-        global_state.BindTexture(GL_TEXTURE_2D, 0);
     }
 
     return 0;
@@ -982,8 +1134,12 @@ WEAK int halide_opengl_device_free(void *user_context, halide_buffer_t *buf) {
     GLuint tex = (handle == HALIDE_OPENGL_RENDER_TARGET) ? 0 : (GLuint)handle;
 
     int result = 0;
-    debug(user_context) << "halide_opengl_device_free: Deleting texture " << tex << "\n";
-    global_state.DeleteTextures(1, &tex);
+    if (tex != 0 && return_texture_to_pool(tex)) {
+        debug(user_context) << "halide_opengl_device_free: Returning texture " << tex << " to the pool\n";
+    } else {
+        debug(user_context) << "halide_opengl_device_free: Deleting texture " << tex << "\n";
+        delete_texture(tex);
+    }
     if (global_state.CheckAndReportError(user_context, "halide_opengl_device_free DeleteTextures")) {
         result = 1;
         // do not return: we want to zero out the interface and
@@ -1180,24 +1336,19 @@ WEAK int halide_opengl_copy_to_host(void *user_context, halide_buffer_t *buf) {
     if (handle != HALIDE_OPENGL_RENDER_TARGET) {
         GLuint tex = (GLuint)handle;
         debug(user_context) << "halide_copy_to_host: texture " << tex << "\n";
-        global_state.BindFramebuffer(GL_FRAMEBUFFER, global_state.framebuffer_id);
-        if (global_state.CheckAndReportError(user_context, "copy_to_host BindFramebuffer")) {
-            return 1;
-        }
-        global_state.FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
-        if (global_state.CheckAndReportError(user_context, "copy_to_host FramebufferTexture2D")) {
+        if (bind_framebuffer_texture(user_context, tex)) {
             return 1;
         }
     } else {
         debug(user_context) << "halide_copy_to_host: HALIDE_OPENGL_RENDER_TARGET\n";
-    }
 
-    // Check that framebuffer is set up correctly
-    GLenum status = global_state.CheckFramebufferStatus(GL_FRAMEBUFFER);
-    if (status != GL_FRAMEBUFFER_COMPLETE) {
-        error(user_context)
-            << "Setting up GL framebuffer " << global_state.framebuffer_id << " failed " << status;
-        return 1;
+        // Check that framebuffer is set up correctly
+        GLenum status = global_state.CheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            error(user_context)
+                << "Setting up GL framebuffer " << global_state.framebuffer_id << " failed " << status;
+            return 1;
+        }
     }
 
     // The only format/type pairs guaranteed to be readable in GLES2 are GL_RGBA+GL_UNSIGNED_BYTE,
@@ -1550,10 +1701,6 @@ WEAK int halide_opengl_run(void *user_context,
     GLint output_min[2] = { 0, 0 };
     GLint output_extent[2] = { 0, 0 };
 
-    if (bind_render_targets) {
-        global_state.BindFramebuffer(GL_FRAMEBUFFER, global_state.framebuffer_id);
-    }
-
     global_state.Disable(GL_CULL_FACE);
     global_state.Disable(GL_DEPTH_TEST);
 
@@ -1584,10 +1731,7 @@ WEAK int halide_opengl_run(void *user_context,
         if (bind_render_targets) {
             debug(user_context)
                 << "Output texture " << num_output_textures << ": " << tex << "\n";
-            global_state.FramebufferTexture2D(GL_FRAMEBUFFER,
-                                    GL_COLOR_ATTACHMENT0 + num_output_textures,
-                                    GL_TEXTURE_2D, tex, 0);
-            if (global_state.CheckAndReportError(user_context, "halide_opengl_run FramebufferTexture2D")) {
+            if (bind_framebuffer_texture(user_context, tex)) {
                 return 1;
             }
         }
@@ -1625,21 +1769,6 @@ WEAK int halide_opengl_run(void *user_context,
         }
     }
 
-    if (bind_render_targets) {
-        // Check that framebuffer is set up correctly
-        GLenum status = global_state.CheckFramebufferStatus(GL_FRAMEBUFFER);
-        if (global_state.CheckAndReportError(user_context, "halide_opengl_run CheckFramebufferStatus")) {
-            return 1;
-        }
-        if (status != GL_FRAMEBUFFER_COMPLETE) {
-            error(user_context)
-                << "Setting up GL framebuffer " << global_state.framebuffer_id
-                << " failed (" << status << ")";
-            // TODO: cleanup
-            return 1;
-        }
-    }
-
     // Set vertex attributes
     GLint loc = global_state.GetUniformLocation(kernel->program_id, "output_extent");
     global_state.Uniform2iv(loc, 1, output_extent);
@@ -1965,6 +2094,8 @@ WEAK void halide_opengl_context_lost(void *user_context) {
         mod->kernel->program_id = 0;
     }
 
+    // The textures went with the context.
+    release_texture_pool(false);
     global_state.init();
     return;
 }
@@ -391,6 +391,11 @@ WEAK int halide_openglcompute_copy_to_host(void *user_context, halide_buffer_t *
                         << ", the_buffer:" << the_buffer
                         << ", size=" << (unsigned)size << ")\n";
 
+    // Make the writes of any kernels still in flight visible to the
+    // mapping below.
+    global_state.MemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    if (global_state.CheckAndReportError(user_context, "oglc: MemoryBarrier")) { return 1; }
+
     global_state.BindBuffer(GL_ARRAY_BUFFER, the_buffer);
     if (global_state.CheckAndReportError(user_context, "oglc: BindBuffer")) { return 1; }
 
@@ -494,7 +499,10 @@ WEAK int halide_openglcompute_run(void *user_context, void *state_ptr,
     if (global_state.CheckAndReportError(user_context, "halide_openglcompute_run DispatchCompute")) {
         return -1;
     }
-    global_state.MemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    // Don't wait for the kernel to finish. Later kernels that read
+    // the buffers it writes are ordered after it by this barrier, and
+    // copies to the host wait on it themselves.
+    global_state.MemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
     if (global_state.CheckAndReportError(user_context, "halide_openglcompute_run MemoryBarrier")) {
         return -1;
     }
@@ -8,4 +8,13 @@ WEAK int halide_host_cpu_count() {
     return sysconf(58);
 }
 
+// NUMA placement is not supported on this platform.
+WEAK int halide_numa_node_count() {
+    return 1;
+}
+
+WEAK int halide_bind_current_thread_to_numa_node(int node) {
+    return -1;
+}
+
 }
@@ -0,0 +1,50 @@
+#include "HalideRuntime.h"
+#include "printer.h"
+#include "scoped_mutex_lock.h"
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// Serializes writes to the profile from different modules.
+WEAK halide_mutex pgo_lock = { { 0 } };
+
+}}}  // namespace Halide::Runtime::Internal
+
+extern "C" {
+
+WEAK int halide_pgo_write_counts(void *user_context, const char *const *names,
+                                 uint64_t *const *counts, int num_counts) {
+    Halide::Runtime::Internal::ScopedMutexLock lock(&Halide::Runtime::Internal::pgo_lock);
+
+    const char *filename = getenv("HL_PGO_OUTPUT");
+    if (!filename || !*filename) {
+        filename = "halide.pgo";
+    }
+
+    // Append, so that the counts of several modules and runs add up
+    // when the profile is read.
+    void *f = fopen(filename, "a");
+    if (!f) {
+        error(user_context) << "Could not open " << filename << " to write the profile\n";
+        return halide_error_code_debug_to_file_failed;
+    }
+
+    char line[1024];
+    char *end = line + sizeof(line) - 1;
+    int result = 0;
+    for (int i = 0; i < num_counts; i++) {
+        char *dst = halide_string_to_string(line, end, names[i]);
+        dst = halide_string_to_string(dst, end, " ");
+        dst = halide_uint64_to_string(dst, end, *counts[i], 1);
+        dst = halide_string_to_string(dst, end, "\n");
+        size_t len = dst - line;
+        if (fwrite(line, 1, len, f) != len) {
+            error(user_context) << "Could not write the profile to " << filename << "\n";
+            result = halide_error_code_debug_to_file_failed;
+            break;
+        }
+    }
+    fclose(f);
+    return result;
+}
+
+}
@@ -0,0 +1,178 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+// An alternative to posix_allocator, selected by the pool_allocator
+// target feature. Allocations are rounded up to one of a set of size
+// classes, and freed blocks are kept on per-class free lists for reuse
+// instead of being returned to libc, up to a bounded total. This
+// avoids malloc/free traffic and allocator lock contention for
+// pipelines that allocate per-tile scratch inside parallel loops.
+
+extern "C" {
+
+extern void *malloc(size_t);
+extern void free(void *);
+
+}
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// Four size classes per power of two, from 64 bytes up to 16MB.
+// Larger allocations go straight to libc.
+#define POOL_MIN_CLASS_LOG2 6
+#define POOL_MAX_CLASS_LOG2 24
+#define POOL_NUM_CLASSES (1 + (POOL_MAX_CLASS_LOG2 - POOL_MIN_CLASS_LOG2) * 4)
+#define POOL_LARGE_CLASS ((size_t)-1)
+
+// Free lists are striped to keep threads from contending on them.
+// Threads are mapped to stripes by their stack (see current_stack_key).
+#define POOL_NUM_STRIPES 64
+
+// The default bound on the total bytes held in free lists. Can be
+// overridden with HL_POOL_ALLOCATOR_MAX_CACHED_MB.
+#define POOL_DEFAULT_MAX_CACHED_MB 256
+
+struct pool_stripe {
+    halide_mutex lock;
+    void *free_lists[POOL_NUM_CLASSES];
+    // Pad to a cache line so stripes don't false-share.
+    uint8_t padding[64];
+};
+
+WEAK pool_stripe pool_stripes[POOL_NUM_STRIPES];
+WEAK int64_t pool_cached_bytes = 0;
+WEAK int64_t pool_max_cached_bytes = -1;
+
+WEAK __attribute__((always_inline)) int highest_bit(size_t x) {
+    return 63 - __builtin_clzll((unsigned long long)x);
+}
+
+WEAK __attribute__((always_inline)) size_t pool_size_class(size_t size) {
+    if (size <= ((size_t)1 << POOL_MIN_CLASS_LOG2)) {
+        return 0;
+    }
+    if (size > ((size_t)1 << POOL_MAX_CLASS_LOG2)) {
+        return POOL_LARGE_CLASS;
+    }
+    // size is in (2^k, 2^(k+1)], split into quarters.
+    int k = highest_bit(size - 1);
+    size_t quarter = ((size - 1) >> (k - 2)) & 3;
+    return 1 + (k - POOL_MIN_CLASS_LOG2) * 4 + quarter;
+}
+
+WEAK __attribute__((always_inline)) size_t pool_class_bytes(size_t c) {
+    if (c == 0) {
+        return (size_t)1 << POOL_MIN_CLASS_LOG2;
+    }
+    int k = (int)((c - 1) / 4) + POOL_MIN_CLASS_LOG2;
+    size_t quarter = (c - 1) % 4;
+    return ((size_t)1 << k) + (quarter + 1) * ((size_t)1 << (k - 2));
+}
+
+WEAK pool_stripe *current_pool_stripe() {
+    return &pool_stripes[stack_key_hash(current_stack_key(16)) >> 58];
+}
+
+WEAK int64_t get_pool_max_cached_bytes() {
+    int64_t m = __atomic_load_n(&pool_max_cached_bytes, __ATOMIC_RELAXED);
+    if (m < 0) {
+        const char *str = getenv("HL_POOL_ALLOCATOR_MAX_CACHED_MB");
+        int64_t mb = str ? atoi(str) : POOL_DEFAULT_MAX_CACHED_MB;
+        m = (mb > 0 ? mb : 0) << 20;
+        __atomic_store_n(&pool_max_cached_bytes, m, __ATOMIC_RELAXED);
+    }
+    return m;
+}
+
+// Each block stores the pointer libc gave us and its size class in the
+// two words before the pointer we return.
+WEAK void *pool_allocate_from_libc(size_t bytes, size_t c) {
+    const size_t alignment = halide_malloc_alignment();
+    void *orig = malloc(bytes + alignment + 2 * sizeof(void *));
+    if (orig == NULL) {
+        // Will result in a failed assertion and a call to halide_error
+        return NULL;
+    }
+    void *ptr = (void *)(((size_t)orig + alignment + 2 * sizeof(void *) - 1) & ~(alignment - 1));
+    ((void **)ptr)[-1] = orig;
+    ((size_t *)ptr)[-2] = c;
+    return ptr;
+}
+
+WEAK void pool_release_stripe(pool_stripe *stripe) {
+    halide_mutex_lock(&stripe->lock);
+    for (int c = 0; c < POOL_NUM_CLASSES; c++) {
+        void *ptr = stripe->free_lists[c];
+        stripe->free_lists[c] = NULL;
+        while (ptr) {
+            void *next = *(void **)ptr;
+            free(((void **)ptr)[-1]);
+            __sync_sub_and_fetch(&pool_cached_bytes, (int64_t)pool_class_bytes(c));
+            ptr = next;
+        }
+    }
+    halide_mutex_unlock(&stripe->lock);
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+extern "C" {
+
+WEAK void *halide_default_malloc(void *user_context, size_t x) {
+    size_t c = pool_size_class(x);
+    if (c == POOL_LARGE_CLASS) {
+        return pool_allocate_from_libc(x, c);
+    }
+
+    pool_stripe *stripe = current_pool_stripe();
+    halide_mutex_lock(&stripe->lock);
+    void *ptr = stripe->free_lists[c];
+    if (ptr) {
+        stripe->free_lists[c] = *(void **)ptr;
+    }
+    halide_mutex_unlock(&stripe->lock);
+
+    if (ptr) {
+        __sync_sub_and_fetch(&pool_cached_bytes, (int64_t)pool_class_bytes(c));
+        return ptr;
+    }
+    return pool_allocate_from_libc(pool_class_bytes(c), c);
+}
+
+WEAK void halide_default_free(void *user_context, void *ptr) {
+    size_t c = ((size_t *)ptr)[-2];
+    if (c != POOL_LARGE_CLASS) {
+        int64_t bytes = (int64_t)pool_class_bytes(c);
+        if (__sync_add_and_fetch(&pool_cached_bytes, bytes) <= get_pool_max_cached_bytes()) {
+            pool_stripe *stripe = current_pool_stripe();
+            halide_mutex_lock(&stripe->lock);
+            *(void **)ptr = stripe->free_lists[c];
+            stripe->free_lists[c] = ptr;
+            halide_mutex_unlock(&stripe->lock);
+            return;
+        }
+        __sync_sub_and_fetch(&pool_cached_bytes, bytes);
+    }
+    free(((void **)ptr)[-1]);
+}
+
+WEAK void halide_pool_allocator_release_unused(void *user_context) {
+    for (int i = 0; i < POOL_NUM_STRIPES; i++) {
+        pool_release_stripe(&pool_stripes[i]);
+    }
+}
+
+}
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+namespace {
+__attribute__((destructor))
+WEAK void halide_pool_allocator_cleanup() {
+    halide_pool_allocator_release_unused(NULL);
+}
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+#include "allocator_common.h"
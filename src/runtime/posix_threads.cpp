@@ -20,14 +20,17 @@ typedef long pthread_t;
 extern int pthread_create(pthread_t *, const void * attr,
                           void *(*start_routine)(void *), void * arg);
 extern int pthread_join(pthread_t thread, void **retval);
+extern pthread_t pthread_self();
 extern int pthread_cond_init(halide_cond *cond, const void *attr);
 extern int pthread_cond_wait(halide_cond *cond, halide_mutex *mutex);
 extern int pthread_cond_broadcast(halide_cond *cond);
+extern int pthread_cond_signal(halide_cond *cond);
 extern int pthread_cond_destroy(halide_cond *cond);
 extern int pthread_mutex_init(halide_mutex *mutex, const void *attr);
 extern int pthread_mutex_lock(halide_mutex *mutex);
 extern int pthread_mutex_unlock(halide_mutex *mutex);
 extern int pthread_mutex_destroy(halide_mutex *mutex);
+extern int setpriority(int which, int who, int prio);
 
 } // extern "C"
 
@@ -87,8 +90,22 @@ WEAK void halide_cond_broadcast(struct halide_cond *cond) {
     pthread_cond_broadcast(cond);
 }
 
+WEAK void halide_cond_signal(struct halide_cond *cond) {
+    pthread_cond_signal(cond);
+}
+
 WEAK void halide_cond_wait(struct halide_cond *cond, struct halide_mutex *mutex) {
     pthread_cond_wait(cond, mutex);
 }
 
+WEAK uintptr_t halide_current_thread_id() {
+    return (uintptr_t)pthread_self();
+}
+
+WEAK int halide_set_current_thread_priority(int priority) {
+    // On Linux, the nice value is per-thread, and who == 0 means the
+    // calling thread. (PRIO_PROCESS == 0)
+    return setpriority(0, 0, priority);
+}
+
 } // extern "C"
@@ -6,6 +6,8 @@
 #define PPC_FEATURE_HAS_VSX     0x00000080
 
 #define PPC_FEATURE2_ARCH_2_07     0x80000000
+#define PPC_FEATURE2_ARCH_3_00     0x00800000
+#define PPC_FEATURE2_ARCH_3_1      0x00040000
 
 extern "C" unsigned long int getauxval(unsigned long int);
 
@@ -16,7 +18,9 @@ WEAK CpuFeatures halide_get_cpu_features() {
     const unsigned long hwcap2 = getauxval(AT_HWCAP2);
 
     const uint64_t known = (1ULL << halide_target_feature_vsx) |
-                           (1ULL << halide_target_feature_power_arch_2_07);
+                           (1ULL << halide_target_feature_power_arch_2_07) |
+                           (1ULL << halide_target_feature_power_arch_3_00) |
+                           (1ULL << halide_target_feature_power_arch_3_1);
     uint64_t available = 0;
     if (hwcap & PPC_FEATURE_HAS_VSX) {
         available |= (1ULL << halide_target_feature_vsx);
@@ -24,6 +28,12 @@ WEAK CpuFeatures halide_get_cpu_features() {
     if (hwcap2 & PPC_FEATURE2_ARCH_2_07) {
         available |= (1ULL << halide_target_feature_power_arch_2_07);
     }
+    if (hwcap2 & PPC_FEATURE2_ARCH_3_00) {
+        available |= (1ULL << halide_target_feature_power_arch_3_00);
+    }
+    if (hwcap2 & PPC_FEATURE2_ARCH_3_1) {
+        available |= (1ULL << halide_target_feature_power_arch_3_1);
+    }
     CpuFeatures features = {known, available};
     return features;
 }
@@ -16,6 +16,65 @@ WEAK halide_profiler_state *halide_profiler_get_state() {
 
 namespace Halide { namespace Runtime { namespace Internal {
 
+// The number of hardware counters read by the profiler thread. Zero
+// unless HL_PROFILER_COUNTERS is set and they could be opened.
+WEAK int profiler_num_counters = 0;
+
+// Per-thread state, in a table keyed by megabyte-sized regions of
+// stack (see current_stack_key). Entries are claimed by the first
+// thread to look them up, and never freed: an entry belongs to a
+// region of stack rather than to a thread, so a new thread whose stack
+// is where an exited one's was reuses its entry. Returns NULL if the
+// table is full.
+template<typename T>
+WEAK T *find_thread_entry(T *table, int size) {
+    uintptr_t key = current_stack_key(20);
+    uint64_t h = stack_key_hash(key);
+    for (int i = 0; i < size; i++) {
+        T *t = &table[(h + i) % size];
+        uintptr_t k = __atomic_load_n(&t->key, __ATOMIC_ACQUIRE);
+        if (k == 0) {
+            k = __sync_val_compare_and_swap(&t->key, 0, key);
+            if (k == 0) {
+                return t;
+            }
+        }
+        if (k == key) {
+            return t;
+        }
+    }
+    return NULL;
+}
+
+// The func each thread is computing, for the lightweight profiler.
+#define PROFILER_MAX_THREADS 256
+
+// How many nested slot scopes restore the func of the scope around
+// them. A task run inline by a thread waiting on a parallel loop gets
+// a scope within the one it interrupted.
+#define PROFILER_SLOT_SAVED_FUNCS 11
+
+// A slot is outside_of_halide whenever no scope holds it, so the slots
+// of exited threads are never billed.
+struct profiler_thread_slot {
+    // First, so that the func pointer handed to the pipeline is also
+    // a pointer to the slot.
+    int func;
+    // The number of scopes holding the slot, and the funcs to restore
+    // when each one but the outermost is released.
+    int depth;
+    int saved[PROFILER_SLOT_SAVED_FUNCS];
+    uintptr_t key;
+    // Pad to a cache line so threads don't false-share.
+    uint8_t padding[64 - sizeof(uintptr_t) - (2 + PROFILER_SLOT_SAVED_FUNCS) * sizeof(int)];
+};
+
+WEAK profiler_thread_slot profiler_thread_slots[PROFILER_MAX_THREADS];
+// Used by threads that don't fit in the table. Never sampled, and
+// shared, so scopes aren't tracked for it.
+WEAK profiler_thread_slot profiler_overflow_slot;
+WEAK int profiler_thread_slots_used = 0;
+
 WEAK halide_profiler_pipeline_stats *find_or_create_pipeline(const char *pipeline_name, int num_funcs, const uint64_t *func_names) {
     halide_profiler_state *s = halide_profiler_get_state();
 
@@ -45,6 +104,10 @@ WEAK halide_profiler_pipeline_stats *find_or_create_pipeline(const char *pipelin
     p->num_allocs = 0;
     p->active_threads_numerator = 0;
     p->active_threads_denominator = 0;
+    for (int c = 0; c < halide_profiler_num_counters; c++) {
+        p->counters[c] = 0;
+    }
+    memset(p->latency_histogram, 0, sizeof(p->latency_histogram));
     p->funcs = (halide_profiler_func_stats *)malloc(num_funcs * sizeof(halide_profiler_func_stats));
     if (!p->funcs) {
         free(p);
@@ -60,13 +123,42 @@ WEAK halide_profiler_pipeline_stats *find_or_create_pipeline(const char *pipelin
         p->funcs[i].stack_peak = 0;
         p->funcs[i].active_threads_numerator = 0;
         p->funcs[i].active_threads_denominator = 0;
+        for (int c = 0; c < halide_profiler_num_counters; c++) {
+            p->funcs[i].counters[c] = 0;
+        }
+        memset(p->funcs[i].latency_histogram, 0, sizeof(p->funcs[i].latency_histogram));
+        p->funcs[i].ops = 0;
+        p->funcs[i].bytes = 0;
     }
     s->first_free_id += num_funcs;
     s->pipelines = p;
     return p;
 }
 
-WEAK void bill_func(halide_profiler_state *s, int func_id, uint64_t time, int active_threads) {
+// See the description of the buckets in HalideRuntime.h.
+#define LATENCY_MIN_LOG2 10
+
+WEAK int latency_bucket(uint64_t t) {
+    if (t < ((uint64_t)1 << LATENCY_MIN_LOG2)) {
+        return 0;
+    }
+    int k = 63 - __builtin_clzll((unsigned long long)t);
+    int quarter = (int)(t >> (k - 2)) & 3;
+    int b = 1 + (k - LATENCY_MIN_LOG2) * 4 + quarter;
+    return b < halide_profiler_latency_buckets ? b : halide_profiler_latency_buckets - 1;
+}
+
+WEAK uint64_t latency_bucket_upper_bound(int b) {
+    if (b == 0) {
+        return (uint64_t)1 << LATENCY_MIN_LOG2;
+    }
+    int k = (b - 1) / 4 + LATENCY_MIN_LOG2;
+    uint64_t quarter = (b - 1) % 4;
+    return (5 + quarter) << (k - 2);
+}
+
+WEAK void bill_func(halide_profiler_state *s, int func_id, uint64_t time, int active_threads,
+                    const uint64_t *counters) {
     halide_profiler_pipeline_stats *p_prev = NULL;
     for (halide_profiler_pipeline_stats *p = s->pipelines; p;
          p = (halide_profiler_pipeline_stats *)(p->next)) {
@@ -85,6 +177,10 @@ WEAK void bill_func(halide_profiler_state *s, int func_id, uint64_t time, int ac
             p->samples++;
             p->active_threads_numerator += active_threads;
             p->active_threads_denominator += 1;
+            for (int c = 0; counters && c < profiler_num_counters; c++) {
+                f->counters[c] += counters[c];
+                p->counters[c] += counters[c];
+            }
             return;
         }
         p_prev = p;
@@ -92,6 +188,23 @@ WEAK void bill_func(halide_profiler_state *s, int func_id, uint64_t time, int ac
     // Someone must have called reset_state while a kernel was running. Do nothing.
 }
 
+// Bill the time since the last sample to the func each thread is
+// computing, for the lightweight profiler. The pipeline times are
+// then summed over threads.
+WEAK void bill_thread_slots(halide_profiler_state *s, uint64_t time) {
+    int funcs[PROFILER_MAX_THREADS];
+    int active = 0;
+    for (int i = 0; i < PROFILER_MAX_THREADS; i++) {
+        int func = __atomic_load_n(&profiler_thread_slots[i].func, __ATOMIC_RELAXED);
+        if (profiler_thread_slots[i].key && func >= 0) {
+            funcs[active++] = func;
+        }
+    }
+    for (int i = 0; i < active; i++) {
+        bill_func(s, funcs[i], time, active, NULL);
+    }
+}
+
 WEAK void sampling_profiler_thread(void *) {
     halide_profiler_state *s = halide_profiler_get_state();
 
@@ -102,6 +215,10 @@ WEAK void sampling_profiler_thread(void *) {
 
         uint64_t t1 = halide_current_time_ns(NULL);
         uint64_t t = t1;
+        uint64_t counters[halide_profiler_num_counters];
+        if (profiler_num_counters) {
+            halide_perf_counters_read(counters);
+        }
         while (1) {
             int func, active_threads;
             if (s->get_remote_profiler_state) {
@@ -113,12 +230,25 @@ WEAK void sampling_profiler_thread(void *) {
                 active_threads = s->active_threads;
             }
             uint64_t t_now = halide_current_time_ns(NULL);
+            // Likewise for the hardware counters.
+            uint64_t counter_deltas[halide_profiler_num_counters];
+            if (profiler_num_counters) {
+                uint64_t counters_now[halide_profiler_num_counters];
+                halide_perf_counters_read(counters_now);
+                for (int c = 0; c < halide_profiler_num_counters; c++) {
+                    counter_deltas[c] = counters_now[c] - counters[c];
+                    counters[c] = counters_now[c];
+                }
+            }
             if (func == halide_profiler_please_stop) {
                 break;
             } else if (func >= 0) {
                 // Assume all time since I was last awake is due to
                 // the currently running func.
-                bill_func(s, func, t_now - t, active_threads);
+                bill_func(s, func, t_now - t, active_threads, counter_deltas);
+            }
+            if (__atomic_load_n(&profiler_thread_slots_used, __ATOMIC_RELAXED)) {
+                bill_thread_slots(s, t_now - t);
             }
             t = t_now;
 
@@ -135,13 +265,250 @@ WEAK void sampling_profiler_thread(void *) {
     halide_mutex_unlock(&s->lock);
 }
 
+// The timeline recorded by the profile_timeline target feature. Each
+// thread records to its own track, found with find_thread_entry. Each
+// track has a spin lock in case two threads do share one, and events
+// are appended to fixed-size chunks.
+#define TIMELINE_MAX_THREADS 256
+#define TIMELINE_CHUNK_EVENTS 4096
+// About a million events, or 16MB, per thread. Events past this are
+// counted and dropped.
+#define TIMELINE_MAX_CHUNKS_PER_THREAD 256
+// How deeply spans can nest when exporting.
+#define TIMELINE_MAX_DEPTH 64
+
+struct timeline_event {
+    uint64_t time;
+    int32_t func_id;
+    int32_t kind;
+};
+
+struct timeline_chunk {
+    timeline_chunk *next;
+    int count;
+    timeline_event events[TIMELINE_CHUNK_EVENTS];
+};
+
+struct timeline_thread {
+    uintptr_t key;
+    volatile int lock;
+    timeline_chunk *head, *tail;
+    int num_chunks;
+    uint64_t dropped;
+};
+
+WEAK timeline_thread timeline_threads[TIMELINE_MAX_THREADS];
+WEAK uint64_t timeline_dropped_events = 0;
+
+WEAK timeline_thread *current_timeline_thread() {
+    return find_thread_entry(timeline_threads, TIMELINE_MAX_THREADS);
+}
+
+WEAK void record_timeline_event(uint64_t time, int func_id, int kind) {
+    timeline_thread *t = current_timeline_thread();
+    if (t == NULL) {
+        __sync_add_and_fetch(&timeline_dropped_events, 1);
+        return;
+    }
+    while (__sync_lock_test_and_set(&t->lock, 1)) {
+    }
+    timeline_chunk *c = t->tail;
+    if (c == NULL || c->count == TIMELINE_CHUNK_EVENTS) {
+        c = NULL;
+        if (t->num_chunks < TIMELINE_MAX_CHUNKS_PER_THREAD) {
+            c = (timeline_chunk *)malloc(sizeof(timeline_chunk));
+        }
+        if (c == NULL) {
+            t->dropped++;
+            __sync_lock_release(&t->lock);
+            return;
+        }
+        c->next = NULL;
+        c->count = 0;
+        if (t->tail) {
+            t->tail->next = c;
+        } else {
+            t->head = c;
+        }
+        t->tail = c;
+        t->num_chunks++;
+    }
+    timeline_event *e = c->events + c->count++;
+    e->time = time;
+    e->func_id = func_id;
+    e->kind = kind;
+    __sync_lock_release(&t->lock);
+}
+
+// Find the name of a func id, or of a pipeline token when is_pipeline
+// is set.
+WEAK const char *timeline_name(halide_profiler_state *s, int func_id, bool is_pipeline) {
+    for (halide_profiler_pipeline_stats *p = s->pipelines; p;
+         p = (halide_profiler_pipeline_stats *)(p->next)) {
+        if (func_id >= p->first_func_id && func_id < p->first_func_id + p->num_funcs) {
+            return is_pipeline ? p->name : p->funcs[func_id - p->first_func_id].name;
+        }
+    }
+    return "<unknown>";
+}
+
+// Spans open on a thread while exporting its events. A frame is a
+// pipeline or a parallel task, with at most one func span open in it.
+struct timeline_frame {
+    int kind;
+    bool func_open;
+};
+
+struct timeline_writer {
+    void *file;
+    bool first;
+    bool ok;
+
+    void write(const char *str, size_t len) {
+        if (ok && fwrite(str, 1, len, file) != len) {
+            ok = false;
+        }
+    }
+
+    void event(void *user_context, const char *name, const char *category,
+               bool begin, uint64_t time, int tid) {
+        char buf[512];
+        Printer<StringStreamPrinter, sizeof(buf)> sstr(user_context, buf);
+        if (!first) {
+            sstr << ",\n";
+        }
+        first = false;
+        // Timestamps are in microseconds.
+        sstr << "{\"ph\":\"" << (begin ? "B" : "E") << "\",\"ts\":" << time / 1000 << ".";
+        uint64_t frac = time % 1000;
+        if (frac < 100) sstr << "0";
+        if (frac < 10) sstr << "0";
+        sstr << frac << ",\"pid\":0,\"tid\":" << tid;
+        if (begin) {
+            sstr << ",\"cat\":\"" << category << "\",\"name\":\"" << name << "\"";
+        }
+        sstr << "}";
+        write(sstr.str(), sstr.size());
+    }
+};
+
+WEAK void export_timeline_thread(void *user_context, halide_profiler_state *s,
+                                 timeline_writer *w, timeline_thread *t, int tid) {
+    timeline_frame frames[TIMELINE_MAX_DEPTH];
+    int depth = 0;
+    uint64_t last_time = 0;
+    for (timeline_chunk *c = t->head; c; c = c->next) {
+        for (int i = 0; i < c->count; i++) {
+            const timeline_event &e = c->events[i];
+            last_time = e.time;
+            switch (e.kind) {
+            case halide_profiler_timeline_func:
+                if (depth == 0) {
+                    break;
+                }
+                if (frames[depth - 1].func_open) {
+                    w->event(user_context, NULL, NULL, false, e.time, tid);
+                }
+                w->event(user_context, timeline_name(s, e.func_id, false), "func", true, e.time, tid);
+                frames[depth - 1].func_open = true;
+                break;
+            case halide_profiler_timeline_task_begin:
+            case halide_profiler_timeline_pipeline_begin: {
+                if (depth == TIMELINE_MAX_DEPTH) {
+                    break;
+                }
+                bool is_pipeline = e.kind == halide_profiler_timeline_pipeline_begin;
+                w->event(user_context, timeline_name(s, e.func_id, is_pipeline),
+                         is_pipeline ? "pipeline" : "task", true, e.time, tid);
+                frames[depth].kind = e.kind;
+                frames[depth].func_open = false;
+                depth++;
+                break;
+            }
+            case halide_profiler_timeline_task_end:
+            case halide_profiler_timeline_pipeline_end: {
+                // Only close a frame of the matching kind, in case a
+                // thread's events were split across tracks.
+                int begin_kind = e.kind == halide_profiler_timeline_task_end ?
+                    halide_profiler_timeline_task_begin : halide_profiler_timeline_pipeline_begin;
+                if (depth == 0 || frames[depth - 1].kind != begin_kind) {
+                    break;
+                }
+                depth--;
+                if (frames[depth].func_open) {
+                    w->event(user_context, NULL, NULL, false, e.time, tid);
+                }
+                w->event(user_context, NULL, NULL, false, e.time, tid);
+                break;
+            }
+            }
+        }
+    }
+    // Close anything left open, e.g. by a pipeline that failed.
+    while (depth > 0) {
+        depth--;
+        if (frames[depth].func_open) {
+            w->event(user_context, NULL, NULL, false, last_time, tid);
+        }
+        w->event(user_context, NULL, NULL, false, last_time, tid);
+    }
+}
+
+WEAK int dump_timeline_unlocked(void *user_context, halide_profiler_state *s, const char *filename) {
+    void *file = fopen(filename, "w");
+    if (!file) {
+        error(user_context) << "Could not open profiler timeline file " << filename << "\n";
+        return -1;
+    }
+    timeline_writer w = {file, true, true};
+    const char *header = "{\"traceEvents\":[\n";
+    w.write(header, strlen(header));
+    uint64_t dropped = timeline_dropped_events;
+    int tid = 0;
+    for (int i = 0; i < TIMELINE_MAX_THREADS; i++) {
+        timeline_thread *t = &timeline_threads[i];
+        if (t->head) {
+            export_timeline_thread(user_context, s, &w, t, tid++);
+        }
+        dropped += t->dropped;
+    }
+    const char *footer = "\n],\"displayTimeUnit\":\"ns\"}\n";
+    w.write(footer, strlen(footer));
+    fclose(file);
+    if (!w.ok) {
+        error(user_context) << "Could not write profiler timeline file " << filename << "\n";
+        return -1;
+    }
+    if (dropped) {
+        print(user_context) << "Profiler timeline dropped " << dropped << " events\n";
+    }
+    return 0;
+}
+
+WEAK void reset_timeline() {
+    for (int i = 0; i < TIMELINE_MAX_THREADS; i++) {
+        timeline_thread *t = &timeline_threads[i];
+        while (t->head) {
+            timeline_chunk *c = t->head;
+            t->head = c->next;
+            free(c);
+        }
+        t->tail = NULL;
+        t->num_chunks = 0;
+        t->dropped = 0;
+    }
+    timeline_dropped_events = 0;
+}
+
 }}}
 
 namespace {
 
 template <typename T>
 void sync_compare_max_and_swap(T *ptr, T val) {
-    T old_val = *ptr;
+    // The peak rarely changes once a pipeline has warmed up, so check
+    // it with a plain load before trying to swap.
+    T old_val = __atomic_load_n(ptr, __ATOMIC_RELAXED);
     while (val > old_val) {
         T temp = old_val;
         old_val = __sync_val_compare_and_swap(ptr, old_val, val);
@@ -151,6 +518,22 @@ void sync_compare_max_and_swap(T *ptr, T val) {
     }
 }
 
+// Fill in the pipeline-wide allocation count and total from its
+// Funcs. Called at the end of each run of the pipeline, and before the
+// stats are read. Runs that end at the same time may race to do this,
+// but the sums only grow until the stats are reset, so the largest one
+// is the most recent.
+void merge_memory_totals(halide_profiler_pipeline_stats *p) {
+    int num_allocs = 0;
+    uint64_t memory_total = 0;
+    for (int i = 0; i < p->num_funcs; i++) {
+        num_allocs += __atomic_load_n(&p->funcs[i].num_allocs, __ATOMIC_RELAXED);
+        memory_total += __atomic_load_n(&p->funcs[i].memory_total, __ATOMIC_RELAXED);
+    }
+    sync_compare_max_and_swap(&p->num_allocs, num_allocs);
+    sync_compare_max_and_swap(&p->memory_total, memory_total);
+}
+
 }
 
 extern "C" {
@@ -165,6 +548,7 @@ WEAK halide_profiler_pipeline_stats *halide_profiler_get_pipeline_state(const ch
         // The same pipeline will deliver the same global constant
         // string, so they can be compared by pointer.
         if (p->name == pipeline_name) {
+            merge_memory_totals(p);
             return p;
         }
     }
@@ -182,6 +566,12 @@ WEAK int halide_profiler_pipeline_start(void *user_context,
 
     if (!s->started) {
         halide_start_clock(user_context);
+        // Counters are opened on this thread so that the thread pool
+        // it starts inherits them.
+        const char *counters_str = getenv("HL_PROFILER_COUNTERS");
+        if (counters_str && atoi(counters_str) > 0) {
+            profiler_num_counters = halide_perf_counters_open();
+        }
         halide_spawn_thread(sampling_profiler_thread, NULL);
         s->started = true;
     }
@@ -206,7 +596,7 @@ WEAK void halide_profiler_stack_peak_update(void *user_context,
     // Note: Update to the counter is done without grabbing the state's lock to
     // reduce lock contention. One potential issue is that other call that frees the
     // pipeline and function stats structs may be running in parallel. However, the
-    // current desctructor (called on profiler shutdown) does not free the structs
+    // current destructor (called on profiler shutdown) does not free the structs
     // unless user specifically calls halide_profiler_reset().
 
     // Update per-func memory stats
@@ -237,12 +627,15 @@ WEAK void halide_profiler_memory_allocate(void *user_context,
     // Note: Update to the counter is done without grabbing the state's lock to
     // reduce lock contention. One potential issue is that other call that frees the
     // pipeline and function stats structs may be running in parallel. However, the
-    // current desctructor (called on profiler shutdown) does not free the structs
+    // current destructor (called on profiler shutdown) does not free the structs
     // unless user specifically calls halide_profiler_reset().
 
-    // Update per-pipeline memory stats
-    __sync_add_and_fetch(&p_stats->num_allocs, 1);
-    __sync_add_and_fetch(&p_stats->memory_total, incr);
+    // Update per-pipeline memory stats. Only the current usage needs
+    // to be shared by all the Funcs in the pipeline, to track the
+    // peak. The allocation count and total are summed over the Funcs
+    // at the end of each run of the pipeline (see
+    // halide_profiler_memory_totals_update), so that threads
+    // allocating for different Funcs don't contend for them.
     uint64_t p_mem_current = __sync_add_and_fetch(&p_stats->memory_current, incr);
     sync_compare_max_and_swap(&p_stats->memory_peak, p_mem_current);
 
@@ -253,6 +646,69 @@ WEAK void halide_profiler_memory_allocate(void *user_context,
     sync_compare_max_and_swap(&f_stats->memory_peak, f_mem_current);
 }
 
+WEAK void halide_profiler_memory_totals_update(void *user_context, void *pipeline_state) {
+    halide_profiler_pipeline_stats *p_stats = (halide_profiler_pipeline_stats *) pipeline_state;
+    halide_assert(user_context, p_stats != NULL);
+
+    // Like the counters it sums, this runs without grabbing the
+    // state's lock.
+    merge_memory_totals(p_stats);
+}
+
+WEAK void halide_profiler_record_latency(void *user_context,
+                                        void *pipeline_state,
+                                        int func_id,
+                                        int64_t start_ns) {
+    halide_profiler_pipeline_stats *p_stats = (halide_profiler_pipeline_stats *) pipeline_state;
+    halide_assert(user_context, p_stats != NULL);
+    halide_assert(user_context, func_id < p_stats->num_funcs);
+
+    // As with the memory stats, the histograms are updated without
+    // grabbing the state's lock.
+    uint64_t *histogram = func_id < 0 ? p_stats->latency_histogram : p_stats->funcs[func_id].latency_histogram;
+    int64_t t = halide_current_time_ns(user_context) - start_ns;
+    __sync_add_and_fetch(&histogram[latency_bucket(t)], 1);
+}
+
+WEAK void halide_profiler_record_work(void *user_context,
+                                     void *pipeline_state,
+                                     int func_id,
+                                     uint64_t ops,
+                                     uint64_t bytes) {
+    halide_profiler_pipeline_stats *p_stats = (halide_profiler_pipeline_stats *) pipeline_state;
+    halide_assert(user_context, p_stats != NULL);
+    halide_assert(user_context, func_id >= 0);
+    halide_assert(user_context, func_id < p_stats->num_funcs);
+
+    // As with the memory stats, the counts are updated without
+    // grabbing the state's lock.
+    halide_profiler_func_stats *f_stats = &p_stats->funcs[func_id];
+    __sync_add_and_fetch(&f_stats->ops, ops);
+    __sync_add_and_fetch(&f_stats->bytes, bytes);
+}
+
+WEAK uint64_t halide_profiler_latency_percentile(const uint64_t *histogram, float percentile) {
+    uint64_t total = 0;
+    for (int b = 0; b < halide_profiler_latency_buckets; b++) {
+        total += histogram[b];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    // The rank of the percentile, counting from one.
+    uint64_t rank = (uint64_t)(total * (percentile / 100.0f));
+    if (rank < 1) rank = 1;
+    if (rank > total) rank = total;
+    uint64_t seen = 0;
+    for (int b = 0; b < halide_profiler_latency_buckets; b++) {
+        seen += histogram[b];
+        if (seen >= rank) {
+            return latency_bucket_upper_bound(b);
+        }
+    }
+    return latency_bucket_upper_bound(halide_profiler_latency_buckets - 1);
+}
+
 WEAK void halide_profiler_memory_free(void *user_context,
                                       void *pipeline_state,
                                       int func_id,
@@ -283,6 +739,71 @@ WEAK void halide_profiler_memory_free(void *user_context,
     __sync_sub_and_fetch(&f_stats->memory_current, decr);
 }
 
+}
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// Summarize hardware counters billed over the given time: instructions
+// per cycle, misses per thousand instructions, and the memory
+// bandwidth implied by the cache misses, assuming 64 byte lines.
+template<typename P>
+WEAK void report_counters(P &sstr, const uint64_t *counters, uint64_t time) {
+    uint64_t cycles = counters[halide_profiler_counter_cycles];
+    uint64_t instructions = counters[halide_profiler_counter_instructions];
+    float kilo_instructions = instructions / 1000.0f + 1e-10f;
+    sstr << " ipc: " << (float)instructions / cycles
+         << "  cache misses/kinst: " << counters[halide_profiler_counter_cache_misses] / kilo_instructions
+         << "  branch misses/kinst: " << counters[halide_profiler_counter_branch_misses] / kilo_instructions
+         << "  bandwidth: " << (counters[halide_profiler_counter_cache_misses] * 64.0f) / (time + 1e-10f) << " GB/s";
+}
+
+// Print the median and 99th percentile of a latency histogram, if it
+// has any entries.
+template<typename P>
+WEAK void report_latency(P &sstr, const uint64_t *histogram) {
+    uint64_t p50 = halide_profiler_latency_percentile(histogram, 50);
+    if (p50 == 0) {
+        return;
+    }
+    uint64_t p99 = halide_profiler_latency_percentile(histogram, 99);
+    sstr << " p50: " << p50 / 1000000.0f << "ms"
+         << " p99: " << p99 / 1000000.0f << "ms";
+}
+
+// Print the rate of ops and memory traffic achieved in the given time,
+// and, if the machine's peaks are given by HL_PROFILER_PEAK_GOPS and
+// HL_PROFILER_PEAK_GBPS, which of them bounds it.
+template<typename P>
+WEAK void report_roofline(P &sstr, uint64_t ops, uint64_t bytes, uint64_t time) {
+    if (time == 0 || (ops == 0 && bytes == 0)) {
+        return;
+    }
+    // Ops per nanosecond are billions of ops per second.
+    float gops = ops / (float)time;
+    float gbps = bytes / (float)time;
+    float intensity = ops / (bytes + 1e-10f);
+    sstr << " GOP/s: " << gops
+         << "  GB/s: " << gbps
+         << "  ops/byte: " << intensity;
+
+    const char *peak_gops_str = getenv("HL_PROFILER_PEAK_GOPS");
+    const char *peak_gbps_str = getenv("HL_PROFILER_PEAK_GBPS");
+    int peak_gops = peak_gops_str ? atoi(peak_gops_str) : 0;
+    int peak_gbps = peak_gbps_str ? atoi(peak_gbps_str) : 0;
+    if (peak_gops > 0 && peak_gbps > 0) {
+        float memory_roof = intensity * peak_gbps;
+        bool memory_bound = memory_roof < peak_gops;
+        float roof = memory_bound ? memory_roof : peak_gops;
+        sstr << "  roofline: " << roof << " GOP/s "
+             << (memory_bound ? "(memory-bound)" : "(compute-bound)")
+             << "  achieved: " << (int)(100 * gops / roof) << "%";
+    }
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+extern "C" {
+
 WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_state *s) {
 
     char line_buf[1024];
@@ -292,6 +813,7 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
          p = (halide_profiler_pipeline_stats *)(p->next)) {
         float t = p->time / 1000000.0f;
         if (!p->runs) continue;
+        merge_memory_totals(p);
         sstr.clear();
         int alloc_avg = 0;
         if (p->num_allocs != 0) {
@@ -309,6 +831,24 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
         }
         sstr << " heap allocations: " << p->num_allocs
              << "  peak heap usage: " << p->memory_peak << " bytes\n";
+        if (halide_profiler_latency_percentile(p->latency_histogram, 50)) {
+            sstr << " latency:";
+            report_latency(sstr, p->latency_histogram);
+            sstr << "\n";
+        }
+        if (p->counters[halide_profiler_counter_cycles]) {
+            report_counters(sstr, p->counters, p->time);
+            sstr << "\n";
+        }
+        uint64_t ops = 0, bytes = 0;
+        for (int i = 0; i < p->num_funcs; i++) {
+            ops += p->funcs[i].ops;
+            bytes += p->funcs[i].bytes;
+        }
+        if (ops || bytes) {
+            report_roofline(sstr, ops, bytes, p->time);
+            sstr << "\n";
+        }
         halide_print(user_context, sstr.str());
 
         bool print_f_states = p->time || p->memory_total;
@@ -377,6 +917,15 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
                 if (fs->stack_peak > 0) {
                     sstr << " stack: " << fs->stack_peak;
                 }
+                report_latency(sstr, fs->latency_histogram);
+                if (fs->counters[halide_profiler_counter_cycles]) {
+                    sstr << "\n   ";
+                    report_counters(sstr, fs->counters, fs->time);
+                }
+                if (fs->time && (fs->ops || fs->bytes)) {
+                    sstr << "\n   ";
+                    report_roofline(sstr, fs->ops, fs->bytes, fs->time);
+                }
                 sstr << "\n";
 
                 halide_print(user_context, sstr.str());
@@ -391,6 +940,87 @@ WEAK void halide_profiler_report(void *user_context) {
     halide_profiler_report_unlocked(user_context, s);
 }
 
+WEAK int *halide_profiler_get_thread_slot(halide_profiler_state *s) {
+    profiler_thread_slot *slot = find_thread_entry(profiler_thread_slots, PROFILER_MAX_THREADS);
+    if (slot == NULL) {
+        return &profiler_overflow_slot.func;
+    }
+    if (!__atomic_load_n(&profiler_thread_slots_used, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&profiler_thread_slots_used, 1, __ATOMIC_RELAXED);
+    }
+    // Only the thread owning the slot touches depth and saved.
+    if (slot->depth > 0 && slot->depth <= PROFILER_SLOT_SAVED_FUNCS) {
+        slot->saved[slot->depth - 1] = slot->func;
+    }
+    slot->depth++;
+    return &slot->func;
+}
+
+WEAK void halide_profiler_release_thread_slot(void *user_context, void *slot_arg) {
+    profiler_thread_slot *slot = (profiler_thread_slot *)slot_arg;
+    if (slot == &profiler_overflow_slot) {
+        return;
+    }
+    slot->depth--;
+    int func = (int)halide_profiler_outside_of_halide;
+    if (slot->depth > 0) {
+        // Scopes nested too deeply to save a func leave the innermost
+        // one's until an outer scope is released.
+        func = slot->depth <= PROFILER_SLOT_SAVED_FUNCS ? slot->saved[slot->depth - 1] : slot->func;
+    }
+    __atomic_store_n(&slot->func, func, __ATOMIC_RELAXED);
+}
+
+WEAK void halide_profiler_visit_pipelines(halide_profiler_pipeline_visitor_t visitor, void *arg, bool reset) {
+    halide_profiler_state *s = halide_profiler_get_state();
+    ScopedMutexLock lock(&s->lock);
+    for (halide_profiler_pipeline_stats *p = s->pipelines; p;
+         p = (halide_profiler_pipeline_stats *)(p->next)) {
+        merge_memory_totals(p);
+        visitor(arg, p);
+        if (reset) {
+            p->time = 0;
+            p->samples = 0;
+            p->runs = 0;
+            p->active_threads_numerator = 0;
+            p->active_threads_denominator = 0;
+            for (int c = 0; c < halide_profiler_num_counters; c++) {
+                p->counters[c] = 0;
+            }
+            memset(p->latency_histogram, 0, sizeof(p->latency_histogram));
+            for (int i = 0; i < p->num_funcs; i++) {
+                halide_profiler_func_stats *f = p->funcs + i;
+                f->time = 0;
+                f->active_threads_numerator = 0;
+                f->active_threads_denominator = 0;
+                for (int c = 0; c < halide_profiler_num_counters; c++) {
+                    f->counters[c] = 0;
+                }
+                memset(f->latency_histogram, 0, sizeof(f->latency_histogram));
+                f->ops = 0;
+                f->bytes = 0;
+            }
+        }
+    }
+}
+
+WEAK int halide_profiler_timeline_event(halide_profiler_state *s, int func_id, int kind) {
+    record_timeline_event(halide_current_time_ns(NULL), func_id, kind);
+    return 0;
+}
+
+WEAK int halide_profiler_dump_timeline(void *user_context, const char *filename) {
+    halide_profiler_state *s = halide_profiler_get_state();
+    ScopedMutexLock lock(&s->lock);
+    return dump_timeline_unlocked(user_context, s, filename);
+}
+
+WEAK void halide_profiler_reset_timeline() {
+    halide_profiler_state *s = halide_profiler_get_state();
+    ScopedMutexLock lock(&s->lock);
+    reset_timeline();
+}
+
 
 WEAK void halide_profiler_reset() {
     // WARNING: Do not call this method while any other halide
@@ -408,6 +1038,8 @@ WEAK void halide_profiler_reset() {
         free(p);
     }
     s->first_free_id = 0;
+    // The timeline refers to func ids, which are now meaningless.
+    reset_timeline();
 }
 
 namespace {
@@ -426,6 +1058,11 @@ WEAK void halide_profiler_shutdown() {
     // down the thread.
     halide_profiler_report_unlocked(NULL, s);
 
+    const char *timeline_file = getenv("HL_PROFILER_TIMELINE_FILE");
+    if (timeline_file && *timeline_file) {
+        dump_timeline_unlocked(NULL, s, timeline_file);
+    }
+
     // Leak the memory. Not all implementations of ScopedMutexLock may
     // be safe to use at static destruction time (windows).
     // halide_profiler_reset();
@@ -1,10 +1,15 @@
 #include "HalideRuntime.h"
+#include "HalideRuntimeQurt.h"
 
 extern "C" {
 
 extern void *malloc(size_t);
 extern void free(void *);
 
+// From HAP_vtcm_mgr.h in the Hexagon SDK.
+extern void *HAP_request_VTCM(unsigned int size, unsigned int single_page_flag);
+extern int HAP_release_VTCM(void *pVA);
+
 }
 
 namespace Halide { namespace Runtime { namespace Internal {
@@ -119,4 +124,14 @@ WEAK void halide_free(void *user_context, void *ptr) {
     halide_default_free(user_context, ptr);
 }
 
+// Scatters and gathers must stay within one page of VTCM, so ask for a
+// single page.
+WEAK void *halide_vtcm_malloc(void *user_context, size_t size) {
+    return HAP_request_VTCM(size, 1);
+}
+
+WEAK void halide_vtcm_free(void *user_context, void *ptr) {
+    HAP_release_VTCM(ptr);
+}
+
 }
@@ -18,6 +18,20 @@ int halide_host_cpu_count() {
     return 4;
 }
 
+// NUMA placement is not supported on this platform.
+WEAK int halide_numa_node_count() {
+    return 1;
+}
+
+WEAK int halide_bind_current_thread_to_numa_node(int node) {
+    return -1;
+}
+
+// Worker priorities are fixed when the thread is spawned on Hexagon.
+WEAK int halide_set_current_thread_priority(int priority) {
+    return -1;
+}
+
 namespace {
 struct spawned_thread {
     void (*f)(void *);
@@ -81,10 +95,83 @@ WEAK void halide_cond_broadcast(struct halide_cond *cond) {
     qurt_cond_broadcast((qurt_cond_t *)cond);
 }
 
+WEAK void halide_cond_signal(struct halide_cond *cond) {
+    qurt_cond_signal((qurt_cond_t *)cond);
+}
+
 WEAK void halide_cond_wait(struct halide_cond *cond, struct halide_mutex *mutex) {
     qurt_cond_wait((qurt_cond_t *)cond, (qurt_mutex_t *)mutex);
 }
 
+WEAK uintptr_t halide_current_thread_id() {
+    return (uintptr_t)qurt_thread_get_id();
+}
+
+namespace {
+
+// Locking and unlocking an HVX context for every task is expensive,
+// so a thread that runs a task with HVX keeps its context locked for
+// the next one, and only unlocks it when it goes to sleep waiting for
+// work, or when it needs a different mode. These are those locks,
+// indexed by thread. Each entry is only ever touched by its own
+// thread, once claimed.
+#define MAX_HVX_THREADS 32
+struct persistent_hvx_lock {
+    qurt_thread_t thread;
+    // The mode locked, or -1.
+    int mode;
+};
+WEAK persistent_hvx_lock persistent_hvx_locks[MAX_HVX_THREADS];
+
+// The calling thread's entry, or NULL if the table is full.
+WEAK persistent_hvx_lock *my_persistent_hvx_lock() {
+    qurt_thread_t me = qurt_thread_get_id();
+    for (int i = 0; i < MAX_HVX_THREADS; i++) {
+        persistent_hvx_lock *l = &persistent_hvx_locks[i];
+        qurt_thread_t owner = __atomic_load_n(&l->thread, __ATOMIC_ACQUIRE);
+        if (owner == me) {
+            return l;
+        }
+        if (owner == 0) {
+            l->mode = -1;
+            if (__atomic_compare_exchange_n(&l->thread, &owner, me, false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                return l;
+            }
+            if (owner == me) {
+                return l;
+            }
+        }
+    }
+    return NULL;
+}
+
+// Drop the calling thread's persistent HVX lock, if it has one. This
+// never blocks, so it's safe with the work queue lock held.
+WEAK void release_persistent_hvx_lock() {
+    persistent_hvx_lock *l = my_persistent_hvx_lock();
+    if (l && l->mode != -1) {
+        qurt_hvx_unlock();
+        l->mode = -1;
+    }
+}
+
+// The number of HVX contexts available in a mode. Older versions of
+// QuRT can't tell us, so assume an 820, with two 128 byte or four 64
+// byte contexts.
+WEAK int hvx_contexts(int mode) {
+    int units = qurt_hvx_get_units ? qurt_hvx_get_units() : 0;
+    int n = (mode == QURT_HVX_MODE_128B) ? ((units >> 8) & 0xff) : (units & 0xff);
+    if (n <= 0) {
+        n = (mode == QURT_HVX_MODE_128B) ? 2 : 4;
+    }
+    return n;
+}
+
+}
+
+#define THREAD_POOL_BEFORE_SLEEP() release_persistent_hvx_lock()
+
 #include "thread_pool_common.h"
 
 namespace {
@@ -120,10 +207,14 @@ WEAK int halide_do_par_for(void *user_context,
 
     wrapped_closure c = {closure, qurt_hvx_get_mode()};
 
-    // Set the desired number of threads based on the current HVX
-    // mode.
-    int old_num_threads =
-        halide_set_num_threads((c.hvx_mode == QURT_HVX_MODE_128B) ? 2 : 4);
+    // Set the desired number of threads to the number of HVX contexts
+    // in the current mode, so that every thread that's working can
+    // hold one. The surplus threads just sleep when there are fewer,
+    // so that we don't tear down and respawn workers on every call.
+    int desired_threads = hvx_contexts(c.hvx_mode == QURT_HVX_MODE_128B ? QURT_HVX_MODE_128B : QURT_HVX_MODE_64B);
+    halide_mutex_lock(&work_queue.mutex);
+    int old_num_threads = set_num_threads_already_locked(&work_queue, desired_threads, false);
+    halide_mutex_unlock(&work_queue.mutex);
     // We're about to acquire the thread-pool lock, so we must drop
     // the hvx context lock, even though we'll likely reacquire it
     // immediately to do some work on this thread.
@@ -143,15 +234,36 @@ WEAK int halide_do_par_for(void *user_context,
             c.hvx_mode = -1;
         }
     }
+    // If we're a task with a persistent lock, we just dropped it, but
+    // it should still be persistent once we take it back.
+    persistent_hvx_lock *l = my_persistent_hvx_lock();
+    bool was_persistent = false;
+    if (l && l->mode != -1) {
+        was_persistent = true;
+        l->mode = -1;
+    }
+
     int ret = halide_default_do_par_for(user_context, task, min, size, (uint8_t *)&c);
 
-    if (c.hvx_mode != -1) {
+    // We may have picked up a persistent lock running tasks
+    // ourselves. Reuse it if it's in the right mode.
+    if (l && l->mode != -1 && l->mode != c.hvx_mode) {
+        qurt_hvx_unlock();
+        l->mode = -1;
+    }
+    if (c.hvx_mode != -1 && !(l && l->mode == c.hvx_mode)) {
         qurt_hvx_lock((qurt_hvx_mode_t)c.hvx_mode);
     }
+    if (l) {
+        // The lock now belongs to the caller again.
+        l->mode = was_persistent ? c.hvx_mode : -1;
+    }
 
     // Set the desired number of threads back to what it was, in case
     // we're a 128 job and we were sharing the machine with a 64 job.
-    halide_set_num_threads(old_num_threads);
+    halide_mutex_lock(&work_queue.mutex);
+    set_num_threads_already_locked(&work_queue, old_num_threads, false);
+    halide_mutex_unlock(&work_queue.mutex);
     return ret;
 }
 
@@ -163,13 +275,23 @@ WEAK int halide_do_task(void *user_context, halide_task_t f,
     // acquire the hvx context lock (if needed) to run some code.
 
     if (c->hvx_mode != -1) {
-        qurt_hvx_lock((qurt_hvx_mode_t)c->hvx_mode);
-        int ret = f(user_context, idx, c->closure);
-        qurt_hvx_unlock();
-        return ret;
-    } else {
-        return f(user_context, idx, c->closure);
+        persistent_hvx_lock *l = my_persistent_hvx_lock();
+        if (!l) {
+            qurt_hvx_lock((qurt_hvx_mode_t)c->hvx_mode);
+            int ret = f(user_context, idx, c->closure);
+            qurt_hvx_unlock();
+            return ret;
+        }
+        // Keep the context locked after the task, for the next one.
+        if (l->mode != c->hvx_mode) {
+            if (l->mode != -1) {
+                qurt_hvx_unlock();
+            }
+            qurt_hvx_lock((qurt_hvx_mode_t)c->hvx_mode);
+            l->mode = c->hvx_mode;
+        }
     }
+    return f(user_context, idx, c->closure);
 }
 namespace {
 __attribute__((destructor))
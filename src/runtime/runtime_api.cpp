@@ -15,7 +15,10 @@
 // cat src/runtime/runtime_internal.h src/runtime/HalideRuntime*.h | grep "^[^ ][^(]*halide_[^ ]*(" | grep -v '#define' | sed "s/[^(]*halide/halide/" | sed "s/(.*//" | sed "s/^h/    \(void *)\&h/" | sed "s/$/,/" | sort | uniq
 
 extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
+    (void *)&halide_bind_current_thread_to_numa_node,
     (void *)&halide_buffer_copy,
+    (void *)&halide_buffer_set_device_dirty_region,
+    (void *)&halide_buffer_set_host_dirty_region,
     (void *)&halide_buffer_to_string,
     (void *)&halide_can_use_target_features,
     (void *)&halide_cond_broadcast,
@@ -24,18 +27,31 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_cond_wait,
     (void *)&halide_copy_to_device,
     (void *)&halide_copy_to_device_legacy,
+    (void *)&halide_copy_to_device_region,
     (void *)&halide_copy_to_host,
     (void *)&halide_copy_to_host_legacy,
+    (void *)&halide_copy_to_host_region,
+    (void *)&halide_create_scratch_arena,
     (void *)&halide_create_temp_file,
+    (void *)&halide_create_thread_pool,
     (void *)&halide_cuda_detach_device_ptr,
+    (void *)&halide_cuda_device_and_host_malloc_managed,
     (void *)&halide_cuda_device_interface,
     (void *)&halide_cuda_get_device_ptr,
     (void *)&halide_cuda_initialize_kernels,
+    (void *)&halide_cuda_managed_prefetch,
+    (void *)&halide_cuda_release_stream,
+    (void *)&halide_cuda_release_unused_device_allocations,
     (void *)&halide_cuda_run,
+    (void *)&halide_cuda_set_allocation_cache_size,
+    (void *)&halide_cuda_set_stream_per_user_context,
     (void *)&halide_cuda_wrap_device_ptr,
     (void *)&halide_current_time_ns,
     (void *)&halide_debug_to_file,
+    (void *)&halide_debug_to_file_wait,
     (void *)&halide_default_can_use_target_features,
+    (void *)&halide_destroy_scratch_arena,
+    (void *)&halide_destroy_thread_pool,
     (void *)&halide_device_and_host_free,
     (void *)&halide_device_and_host_free_as_destructor,
     (void *)&halide_device_and_host_malloc,
@@ -48,6 +64,9 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_device_release,
     (void *)&halide_device_sync,
     (void *)&halide_device_sync_legacy,
+    (void *)&halide_distributed_num_ranks,
+    (void *)&halide_distributed_rank,
+    (void *)&halide_do_fork,
     (void *)&halide_do_par_for,
     (void *)&halide_do_task,
     (void *)&halide_double_to_string,
@@ -86,20 +105,29 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_get_cpu_features,
     (void *)&halide_get_gpu_device,
     (void *)&halide_get_library_symbol,
+    (void *)&halide_get_scratch_arena,
     (void *)&halide_get_symbol,
+    (void *)&halide_get_thread_pool,
     (void *)&halide_get_trace_file,
+    (void *)&halide_hexagon_begin_batch,
     (void *)&halide_hexagon_detach_device_handle,
     (void *)&halide_hexagon_device_interface,
     (void *)&halide_hexagon_device_release,
+    (void *)&halide_hexagon_end_batch,
+    (void *)&halide_hexagon_end_batch_async,
     (void *)&halide_hexagon_get_device_handle,
     (void *)&halide_hexagon_get_device_size,
     (void *)&halide_hexagon_initialize_kernels,
     (void *)&halide_hexagon_power_hvx_off,
     (void *)&halide_hexagon_power_hvx_off_as_destructor,
     (void *)&halide_hexagon_power_hvx_on,
+    (void *)&halide_hexagon_release_unused_device_allocations,
     (void *)&halide_hexagon_run,
+    (void *)&halide_hexagon_set_allocation_cache_size,
+    (void *)&halide_hexagon_set_auto_performance_mode,
     (void *)&halide_hexagon_set_performance,
     (void *)&halide_hexagon_set_performance_mode,
+    (void *)&halide_hexagon_wait_batch,
     (void *)&halide_hexagon_wrap_device_handle,
     (void *)&halide_int64_to_string,
     (void *)&halide_join_thread,
@@ -107,10 +135,17 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_malloc,
     (void *)&halide_matlab_call_pipeline,
     (void *)&halide_memoization_cache_cleanup,
+    (void *)&halide_memoization_cache_get_stats,
     (void *)&halide_memoization_cache_lookup,
+    (void *)&halide_memoization_cache_lookup_with_hash,
     (void *)&halide_memoization_cache_release,
+    (void *)&halide_memoization_cache_reset_stats,
+    (void *)&halide_memoization_cache_set_disk_path,
+    (void *)&halide_memoization_cache_set_pipeline_quota,
+    (void *)&halide_memoization_cache_set_shared_memory,
     (void *)&halide_memoization_cache_set_size,
     (void *)&halide_memoization_cache_store,
+    (void *)&halide_memoization_cache_store_with_priority,
     (void *)&halide_metal_acquire_context,
     (void *)&halide_metal_detach_buffer,
     (void *)&halide_metal_device_interface,
@@ -118,6 +153,7 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_metal_initialize_kernels,
     (void *)&halide_metal_release_context,
     (void *)&halide_metal_run,
+    (void *)&halide_metal_set_heap_size,
     (void *)&halide_metal_wrap_buffer,
     (void *)&halide_msan_annotate_buffer_is_initialized,
     (void *)&halide_msan_annotate_buffer_is_initialized_as_destructor,
@@ -125,16 +161,20 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_mutex_destroy,
     (void *)&halide_mutex_lock,
     (void *)&halide_mutex_unlock,
+    (void *)&halide_numa_node_count,
     (void *)&halide_opencl_detach_cl_mem,
     (void *)&halide_opencl_device_interface,
     (void *)&halide_opencl_get_cl_mem,
     (void *)&halide_opencl_get_device_type,
     (void *)&halide_opencl_get_platform_name,
     (void *)&halide_opencl_initialize_kernels,
+    (void *)&halide_opencl_release_unused_device_allocations,
     (void *)&halide_opencl_run,
+    (void *)&halide_opencl_set_allocation_cache_size,
     (void *)&halide_opencl_set_device_type,
     (void *)&halide_opencl_set_platform_name,
     (void *)&halide_opencl_wrap_cl_mem,
+    (void *)&halide_opencl_wrap_host_ptr,
     (void *)&halide_opengl_context_lost,
     (void *)&halide_opengl_create_context,
     (void *)&halide_opengl_detach_texture,
@@ -149,32 +189,59 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_openglcompute_initialize_kernels,
     (void *)&halide_openglcompute_run,
     (void *)&halide_pointer_to_string,
+    (void *)&halide_pool_allocator_release_unused,
+    (void *)&halide_pgo_write_counts,
     (void *)&halide_print,
+    (void *)&halide_profiler_dump_timeline,
     (void *)&halide_profiler_get_pipeline_state,
     (void *)&halide_profiler_get_state,
+    (void *)&halide_profiler_get_thread_slot,
+    (void *)&halide_profiler_latency_percentile,
     (void *)&halide_profiler_memory_allocate,
     (void *)&halide_profiler_memory_free,
+    (void *)&halide_profiler_memory_totals_update,
     (void *)&halide_profiler_pipeline_start,
+    (void *)&halide_profiler_record_latency,
+    (void *)&halide_profiler_record_work,
+    (void *)&halide_profiler_release_thread_slot,
     (void *)&halide_profiler_report,
     (void *)&halide_profiler_reset,
+    (void *)&halide_profiler_reset_timeline,
     (void *)&halide_profiler_stack_peak_update,
+    (void *)&halide_profiler_timeline_event,
+    (void *)&halide_profiler_visit_pipelines,
     (void *)&halide_qurt_hvx_lock,
     (void *)&halide_qurt_hvx_unlock,
     (void *)&halide_qurt_hvx_unlock_as_destructor,
     (void *)&halide_release_jit_module,
+    (void *)&halide_scratch_arena_release_unused,
+    (void *)&halide_scratch_free,
+    (void *)&halide_scratch_malloc,
+    (void *)&halide_semaphore_acquire,
+    (void *)&halide_semaphore_init,
+    (void *)&halide_semaphore_release,
+    (void *)&halide_semaphore_unblock,
+    (void *)&halide_set_current_thread_priority,
     (void *)&halide_set_custom_can_use_target_features,
     (void *)&halide_set_custom_do_par_for,
     (void *)&halide_set_custom_do_task,
+    (void *)&halide_set_custom_distributed_transport,
     (void *)&halide_set_custom_free,
     (void *)&halide_set_custom_get_library_symbol,
+    (void *)&halide_set_custom_get_scratch_arena,
     (void *)&halide_set_custom_get_symbol,
+    (void *)&halide_set_custom_get_thread_pool,
     (void *)&halide_set_custom_load_library,
     (void *)&halide_set_custom_malloc,
     (void *)&halide_set_custom_print,
     (void *)&halide_set_custom_trace,
+    (void *)&halide_set_debug_to_file_async,
     (void *)&halide_set_error_handler,
     (void *)&halide_set_gpu_device,
+    (void *)&halide_set_gpu_device_for_user_context,
     (void *)&halide_set_num_threads,
+    (void *)&halide_set_numa_aware,
+    (void *)&halide_set_trace_compact,
     (void *)&halide_set_trace_file,
     (void *)&halide_shutdown_thread_pool,
     (void *)&halide_shutdown_trace,
@@ -182,6 +249,8 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_spawn_thread,
     (void *)&halide_start_clock,
     (void *)&halide_string_to_string,
+    (void *)&halide_thread_pool_set_num_threads,
+    (void *)&halide_thread_pool_set_spin_count,
     (void *)&halide_trace,
     (void *)&halide_trace_helper,
     (void *)&halide_uint64_to_string,
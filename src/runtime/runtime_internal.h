@@ -78,8 +78,10 @@ int fileno(void *);
 int fclose(void *);
 int close(int);
 size_t fwrite(const void *, size_t, size_t, void *);
+size_t fread(void *, size_t, size_t, void *);
 ssize_t write(int fd, const void *buf, size_t bytes);
 int remove(const char *pathname);
+int rename(const char *oldpath, const char *newpath);
 int ioctl(int fd, unsigned long request, ...);
 void exit(int);
 void abort();
@@ -130,12 +132,42 @@ WEAK void halide_profiler_memory_free(void *user_context,
                                       void *pipeline_state,
                                       int func_id,
                                       uint64_t decr);
+WEAK void halide_profiler_memory_totals_update(void *user_context,
+                                              void *pipeline_state);
+WEAK void halide_profiler_record_latency(void *user_context,
+                                        void *pipeline_state,
+                                        int func_id,
+                                        int64_t start_ns);
+WEAK void halide_profiler_record_work(void *user_context,
+                                     void *pipeline_state,
+                                     int func_id,
+                                     uint64_t ops,
+                                     uint64_t bytes);
 WEAK int halide_profiler_pipeline_start(void *user_context,
                                         const char *pipeline_name,
                                         int num_funcs,
                                         const uint64_t *func_names);
 WEAK int halide_host_cpu_count();
 
+// Hardware performance counters for the profiler, indexed by
+// halide_profiler_counter_t. Both return the number of counters, or
+// zero if they are unavailable.
+WEAK int halide_perf_counters_open();
+WEAK int halide_perf_counters_read(uint64_t *values);
+
+// Named shared memory segments for the memoization cache's shared
+// tier. open returns a handle, or -1 if segments aren't supported. map
+// maps the whole segment, creating it with *size bytes if it doesn't
+// exist yet, and sets *size to its actual size. A new segment is zero
+// filled. lock and unlock take an exclusive lock on the segment that
+// excludes other processes (but not other threads of this one), and
+// is dropped if the process holding it dies.
+WEAK int halide_shared_memory_open(const char *name);
+WEAK void *halide_shared_memory_map(int handle, size_t *size);
+WEAK void halide_shared_memory_lock(int handle);
+WEAK void halide_shared_memory_unlock(int handle);
+WEAK void halide_shared_memory_close(int handle, void *base, size_t size);
+
 WEAK int halide_device_and_host_malloc(void *user_context, struct halide_buffer_t *buf,
                                        const struct halide_device_interface_t *device_interface);
 WEAK int halide_device_and_host_free(void *user_context, struct halide_buffer_t *buf);
@@ -156,8 +188,12 @@ struct halide_cond {
 WEAK void halide_cond_init(struct halide_cond *cond);
 WEAK void halide_cond_destroy(struct halide_cond *cond);
 WEAK void halide_cond_broadcast(struct halide_cond *cond);
+WEAK void halide_cond_signal(struct halide_cond *cond);
 WEAK void halide_cond_wait(struct halide_cond *cond, struct halide_mutex *mutex);
 
+// An identifier for the calling thread, unique among running threads.
+WEAK uintptr_t halide_current_thread_id();
+
 WEAK int halide_trace_helper(void *user_context,
                              const char *func,
                              void *value, int *coords,
@@ -219,6 +255,24 @@ __attribute__((always_inline)) T reinterpret(const U &x) {
 
 extern WEAK __attribute__((always_inline)) int halide_malloc_alignment();
 
+// There's no portable thread-local storage in the runtime, so
+// per-thread state is found by the address of the calling thread's
+// stack, which differs between threads and is fixed for each. This
+// returns a nonzero key for the aligned region of 2^log2_region_size
+// bytes of stack that holds the caller's frame. Regions should be big
+// enough that a thread doesn't usually change regions as its stack
+// grows.
+WEAK __attribute__((always_inline)) uintptr_t current_stack_key(int log2_region_size) {
+    int local;
+    return ((uintptr_t)&local >> log2_region_size) + 1;
+}
+
+// A well-mixed hash of a stack key. Use its top k bits to pick one of
+// 2^k stripes.
+WEAK __attribute__((always_inline)) uint64_t stack_key_hash(uintptr_t key) {
+    return (uint64_t)key * 0x9e3779b97f4a7c15ULL;
+}
+
 }}}
 
 using namespace Halide::Runtime::Internal;
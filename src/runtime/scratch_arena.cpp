@@ -0,0 +1,207 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+#include "scoped_mutex_lock.h"
+
+// Storage for the heap allocations of root-level Funcs, kept across
+// pipeline invocations. Linked in with the persistent_scratch target
+// feature, which makes lowering route those allocations through
+// halide_scratch_malloc/halide_scratch_free.
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// One block per allocation site, or more for sites that are in use
+// concurrently, e.g. inside parallel loops, where there ends up being
+// about one per worker thread. The key is the address of a string
+// constant in the compiled pipeline, which is unique to each site in
+// each compiled instance of a pipeline.
+struct ScratchSlot {
+    ScratchSlot *next;
+    const char *key;
+    void *block;
+    uint64_t capacity;
+    bool in_use;
+};
+
+}}} // namespace Halide::Runtime::Internal
+
+struct halide_scratch_arena_t {
+    halide_mutex lock;
+    Halide::Runtime::Internal::ScratchSlot *slots;
+};
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+WEAK halide_scratch_arena_t default_scratch_arena;
+
+WEAK halide_scratch_arena_t *default_get_scratch_arena(void *user_context) {
+    return &default_scratch_arena;
+}
+
+WEAK halide_get_scratch_arena_t custom_get_scratch_arena = default_get_scratch_arena;
+
+// Every pointer handed out is preceded by a header recording which
+// slot it belongs to, or NULL if it came from the halide_malloc
+// fallback. The header is a full alignment unit so the pointer keeps
+// halide_malloc's alignment.
+WEAK __attribute__((always_inline)) size_t scratch_header_size() {
+    return halide_malloc_alignment();
+}
+
+WEAK void *scratch_allocate(void *user_context, ScratchSlot *slot, uint64_t size) {
+    uint8_t *base = (uint8_t *)halide_malloc(user_context, scratch_header_size() + size);
+    if (base == NULL) {
+        return NULL;
+    }
+    void *ptr = base + scratch_header_size();
+    ((ScratchSlot **)ptr)[-1] = slot;
+    return ptr;
+}
+
+WEAK void scratch_deallocate(void *user_context, void *ptr) {
+    halide_free(user_context, (uint8_t *)ptr - scratch_header_size());
+}
+
+// Find a slot for a site that isn't in use, preferring one with a block
+// big enough, or create one. Must be called with the arena lock held.
+WEAK ScratchSlot *find_or_create_slot(void *user_context, halide_scratch_arena_t *arena, const char *key,
+                                      uint64_t size) {
+    ScratchSlot *free_slot = NULL;
+    for (ScratchSlot *slot = arena->slots; slot != NULL; slot = slot->next) {
+        if (slot->key == key && !__atomic_load_n(&slot->in_use, __ATOMIC_ACQUIRE)) {
+            if (slot->capacity >= size) {
+                return slot;
+            }
+            free_slot = slot;
+        }
+    }
+    if (free_slot) {
+        return free_slot;
+    }
+    ScratchSlot *slot = (ScratchSlot *)halide_malloc(user_context, sizeof(ScratchSlot));
+    if (slot == NULL) {
+        return NULL;
+    }
+    slot->key = key;
+    slot->block = NULL;
+    slot->capacity = 0;
+    slot->in_use = false;
+    slot->next = arena->slots;
+    arena->slots = slot;
+    return slot;
+}
+
+// Free the blocks of an arena, and the slots too if free_slots is
+// set. Blocks in use are left alone.
+WEAK void release_scratch_arena(void *user_context, halide_scratch_arena_t *arena, bool free_slots) {
+    ScopedMutexLock lock(&arena->lock);
+    ScratchSlot **prev = &arena->slots;
+    while (*prev) {
+        ScratchSlot *slot = *prev;
+        if (__atomic_load_n(&slot->in_use, __ATOMIC_ACQUIRE)) {
+            prev = &slot->next;
+            continue;
+        }
+        if (slot->block) {
+            scratch_deallocate(user_context, slot->block);
+            slot->block = NULL;
+            slot->capacity = 0;
+        }
+        if (free_slots) {
+            *prev = slot->next;
+            halide_free(user_context, slot);
+        } else {
+            prev = &slot->next;
+        }
+    }
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+extern "C" {
+
+WEAK void *halide_scratch_malloc(void *user_context, const char *key, uint64_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+
+    halide_scratch_arena_t *arena = halide_get_scratch_arena(user_context);
+    if (arena != NULL) {
+        ScopedMutexLock lock(&arena->lock);
+        ScratchSlot *slot = find_or_create_slot(user_context, arena, key, size);
+        if (slot != NULL) {
+            if (slot->capacity < size) {
+                if (slot->block) {
+                    scratch_deallocate(user_context, slot->block);
+                }
+                slot->block = scratch_allocate(user_context, slot, size);
+                slot->capacity = slot->block ? size : 0;
+            }
+            if (slot->block) {
+                slot->in_use = true;
+                return slot->block;
+            }
+        }
+    }
+
+    // No arena, or we're out of memory for a slot.
+    return scratch_allocate(user_context, NULL, size);
+}
+
+WEAK void halide_scratch_free(void *user_context, void *ptr) {
+    ScratchSlot *slot = ((ScratchSlot **)ptr)[-1];
+    if (slot == NULL) {
+        scratch_deallocate(user_context, ptr);
+        return;
+    }
+    // The slot must be released under the lock of the arena that owns
+    // it, but we don't know which arena that is, so the flag is
+    // written atomically instead. Lookups under the arena lock see
+    // either value safely.
+    __atomic_store_n(&slot->in_use, false, __ATOMIC_RELEASE);
+}
+
+WEAK halide_scratch_arena_t *halide_create_scratch_arena(void *user_context) {
+    halide_scratch_arena_t *arena = (halide_scratch_arena_t *)halide_malloc(user_context, sizeof(halide_scratch_arena_t));
+    if (arena != NULL) {
+        memset(arena, 0, sizeof(halide_scratch_arena_t));
+    }
+    return arena;
+}
+
+WEAK void halide_destroy_scratch_arena(void *user_context, halide_scratch_arena_t *arena) {
+    if (arena == NULL) {
+        return;
+    }
+    release_scratch_arena(user_context, arena, true);
+    halide_assert(user_context, arena->slots == NULL);
+    if (arena != &default_scratch_arena) {
+        halide_free(user_context, arena);
+    }
+}
+
+WEAK void halide_scratch_arena_release_unused(void *user_context, halide_scratch_arena_t *arena) {
+    release_scratch_arena(user_context, arena ? arena : &default_scratch_arena, false);
+}
+
+WEAK halide_scratch_arena_t *halide_get_scratch_arena(void *user_context) {
+    return (*custom_get_scratch_arena)(user_context);
+}
+
+WEAK halide_get_scratch_arena_t halide_set_custom_get_scratch_arena(halide_get_scratch_arena_t f) {
+    halide_get_scratch_arena_t result = custom_get_scratch_arena;
+    custom_get_scratch_arena = f;
+    return result;
+}
+
+}
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+namespace {
+__attribute__((destructor))
+WEAK void halide_scratch_arena_cleanup() {
+    release_scratch_arena(NULL, &default_scratch_arena, true);
+}
+}
+
+}}} // namespace Halide::Runtime::Internal
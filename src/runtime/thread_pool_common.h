@@ -1,19 +1,93 @@
+// A platform can define THREAD_POOL_BEFORE_SLEEP before including
+// this file to run something on a pool thread, with the work queue
+// lock held, just before the thread sleeps waiting for work and
+// before a worker exits. It's for dropping per-thread resources held
+// across tasks, so it must not block.
+#ifndef THREAD_POOL_BEFORE_SLEEP
+#define THREAD_POOL_BEFORE_SLEEP()
+#endif
 
 namespace Halide { namespace Runtime { namespace Internal {
 
+// Each job's iteration space is divided into a handful of contiguous
+// slices, one per participating worker. A worker claims tasks from the
+// front of its own slice, and when that runs dry it steals the back
+// half of a randomly chosen victim's slice. All of this happens with
+// atomic compare-and-swap on the slice, so claiming a task never takes
+// the work queue mutex. The mutex is only held to find a job to work
+// on, to go to sleep, and to report completion.
+#define MAX_JOB_SLICES 64
+struct job_slice {
+    // The low 32 bits hold the next unclaimed task, the high 32 bits
+    // hold one past the last task in the slice. Both are offsets from
+    // the job's min. Padded out to a cache line so that workers
+    // popping from neighbouring slices don't contend.
+    uint64_t range;
+    uint64_t padding[7];
+};
+
 struct work {
     work *next_job;
+    // The job whose task called halide_do_par_for to make this one,
+    // if it's running on the same pool. Jobs form a tree this way;
+    // a parent can't finish before its children do.
+    work *parent;
     int (*f)(void *, int, uint8_t *);
     void *user_context;
-    int next, max;
+    int min, size;
     uint8_t *closure;
+    // Changed with the work queue lock held, but read without it by an
+    // owner spinning until its job is done.
     int active_workers;
     int exit_status;
-    bool running() { return next < max || active_workers > 0; }
+    int num_slices;
+    // The number of NUMA nodes the slices are spread across. Slices
+    // are assigned to nodes in contiguous groups.
+    int numa_nodes;
+    // On the stack of the thread that made the job, like the job.
+    job_slice *slices;
+
+    bool tasks_remaining() {
+        for (int i = 0; i < num_slices; i++) {
+            uint64_t r = __atomic_load_n(&slices[i].range, __ATOMIC_ACQUIRE);
+            if ((uint32_t)r < (uint32_t)(r >> 32)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    bool running() { return active_workers > 0 || tasks_remaining(); }
+    int node_of_slice(int s) { return (s * numa_nodes) / num_slices; }
+};
+
+// Bookkeeping for one worker thread. Workers are numbered by slot,
+// starting at 1, in the order they were spawned.
+struct work_queue_t;
+struct worker_thread_state {
+    halide_thread *handle;
+    work_queue_t *queue;
+    int slot;
+    // Set when the pool shrinks below this worker's slot. The worker
+    // finishes what it's doing, then leaves and sets exited.
+    bool retire, exited;
+    worker_thread_state *next_retired;
 };
 
-// The work queue and thread pool is weak, so one big work queue is shared by all halide functions
-#define MAX_THREADS 64
+// A record, on the stack of a thread running tasks from a job, of
+// which job that is, so that a parallel loop called from inside one
+// of the tasks can find its parent.
+struct running_job_t {
+    uintptr_t thread_id;
+    work *job;
+    running_job_t *next;
+};
+
+// The default work queue and thread pool is weak, so one big work
+// queue is shared by all halide functions. Additional, independent
+// pools can be created with halide_create_thread_pool and selected
+// per-call via halide_get_thread_pool. There's no fixed limit on the
+// size of a pool; MAX_THREADS just guards against absurd requests.
+#define MAX_THREADS 4096
 struct work_queue_t {
     // all fields are protected by this mutex.
     halide_mutex mutex;
@@ -21,6 +95,9 @@ struct work_queue_t {
     // Singly linked list for job stack
     work *jobs;
 
+    // What each thread running tasks is working on, innermost first.
+    running_job_t *running_jobs;
+
     // Worker threads are divided into an 'A' team and a 'B' team. The
     // B team sleeps on the wakeup_b_team condition variable. The A
     // team does work. Threads transition to the B team if they wake
@@ -29,25 +106,65 @@ struct work_queue_t {
     // a_team_size < target_a_team_size.
     int a_team_size, target_a_team_size;
 
-    // Broadcast when a job completes.
+    // Broadcast when a job completes, if an owner is asleep.
     halide_cond wakeup_owners;
 
-    // Broadcast whenever items are added to the work queue.
+    // Signalled when items are added to the work queue, once for each
+    // sleeping worker the new job can use.
     halide_cond wakeup_a_team;
 
-    // May also be broadcast when items are added to the work queue if
+    // May also be signalled when items are added to the work queue if
     // more threads are required than are currently in the A team.
     halide_cond wakeup_b_team;
 
-    // Keep track of threads so they can be joined at shutdown
-    halide_thread *threads[MAX_THREADS];
+    // The number of threads asleep on each of the above.
+    int owners_sleeping, a_team_sleeping, b_team_sleeping;
+
+    // Idle threads poll for new work for a while with the lock
+    // released before they go to sleep, because waking a sleeping
+    // thread costs more than a short parallel loop takes to run. This
+    // is the number of polls. Unless spin_count_chosen is set, it's
+    // picked from HL_SPIN_COUNT when the pool starts.
+    int spin_count;
+    bool spin_count_chosen;
+
+    // The number of workers (not owners) currently spinning. They'll
+    // find a new job without being woken.
+    int workers_spinning;
+
+    // Incremented with the lock held every time a job is pushed, and
+    // polled without the lock by spinning threads.
+    int jobs_pushed;
+
+    // Keep track of threads so they can be joined at shutdown. This
+    // array grows as needed.
+    worker_thread_state **threads;
+    int threads_capacity;
 
     // The number threads created
     int threads_created;
 
+    // Workers that have been asked to leave because the pool shrank,
+    // but that have not been joined yet.
+    worker_thread_state *retired;
+
     // The desired number threads doing work.
     int desired_num_threads;
 
+    // Whether to place threads and tasks in a NUMA-aware way. Zero
+    // means the choice is made by HL_NUMA when the pool starts,
+    // positive means on, negative means off.
+    int numa_mode;
+
+    // The number of NUMA nodes worker threads are spread across. One
+    // unless NUMA-aware mode is on.
+    int numa_nodes;
+
+    // The scheduling priority workers are given when spawned, in the
+    // units of halide_set_current_thread_priority. Zero leaves the
+    // OS default.
+    int priority;
+
     // Global flags indicating the threadpool should shut down, and
     // whether the thread pool has been initialized.
     bool shutdown, initialized;
@@ -59,6 +176,14 @@ struct work_queue_t {
 };
 WEAK work_queue_t work_queue;
 
+// Choose which pool a call runs on. The default always picks the
+// global work queue.
+WEAK halide_thread_pool *default_get_thread_pool(void *user_context) {
+    return NULL;
+}
+
+WEAK halide_get_thread_pool_t custom_get_thread_pool = default_get_thread_pool;
+
 WEAK int clamp_num_threads(int desired_num_threads) {
     if (desired_num_threads > MAX_THREADS) {
         desired_num_threads = MAX_THREADS;
@@ -83,76 +208,571 @@ WEAK int default_desired_num_threads() {
     return desired_num_threads;
 }
 
-WEAK void worker_thread_already_locked(work *owned_job) {
+// Pack and unpack the [next, end) pair stored in a job slice.
+__attribute__((always_inline)) uint64_t make_slice_range(uint32_t next, uint32_t end) {
+    return ((uint64_t)end << 32) | next;
+}
+
+__attribute__((always_inline)) uint32_t slice_next(uint64_t r) {
+    return (uint32_t)r;
+}
+
+__attribute__((always_inline)) uint32_t slice_end(uint64_t r) {
+    return (uint32_t)(r >> 32);
+}
+
+// Claim the task at the front of a slice. Returns false if the slice
+// is empty.
+WEAK bool pop_task(job_slice *slice, uint32_t *task) {
+    uint64_t r = __atomic_load_n(&slice->range, __ATOMIC_ACQUIRE);
+    while (slice_next(r) < slice_end(r)) {
+        uint64_t claimed = make_slice_range(slice_next(r) + 1, slice_end(r));
+        if (__atomic_compare_exchange_n(&slice->range, &r, claimed, true,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            *task = slice_next(r);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Steal the back half of a slice. On success [*begin, *end) is now
+// owned by the caller.
+WEAK bool steal_tasks(job_slice *slice, uint32_t *begin, uint32_t *end) {
+    uint64_t r = __atomic_load_n(&slice->range, __ATOMIC_ACQUIRE);
+    while (slice_next(r) < slice_end(r)) {
+        uint32_t remaining = slice_end(r) - slice_next(r);
+        uint32_t mid = slice_end(r) - (remaining + 1) / 2;
+        uint64_t left = make_slice_range(slice_next(r), mid);
+        if (__atomic_compare_exchange_n(&slice->range, &r, left, true,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            *begin = mid;
+            *end = slice_end(r);
+            return true;
+        }
+    }
+    return false;
+}
+
+// A cheap per-worker pseudo-random number generator for picking
+// victims (xorshift32).
+__attribute__((always_inline)) uint32_t next_random(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// Run tasks from a job until none are left to claim or steal. Called
+// without the work queue lock held, by a thread that has already
+// registered itself as an active worker on the job.
+WEAK void run_job_tasks(work *job, int slot) {
+    job_slice *home = &job->slices[slot % job->num_slices];
+    uint32_t rng = (uint32_t)slot * 0x9e3779b9u + 1;
+    while (true) {
+        uint32_t task;
+        if (pop_task(home, &task)) {
+            int result = halide_do_task(job->user_context, job->f, job->min + (int)task,
+                                        job->closure);
+            // If this task failed, set the exit status on the job.
+            if (result) {
+                __atomic_store_n(&job->exit_status, result, __ATOMIC_RELEASE);
+            }
+            continue;
+        }
+
+        // Our slice is empty. Try to steal from the others, starting
+        // at a random victim. With more than one NUMA node, try the
+        // slices on our own node before going further afield.
+        uint32_t begin = 0, end = 0;
+        bool stolen = false;
+        int home_node = job->node_of_slice(slot % job->num_slices);
+        int start = (int)(next_random(&rng) % (uint32_t)job->num_slices);
+        for (int pass = (job->numa_nodes > 1) ? 0 : 1; pass < 2 && !stolen; pass++) {
+            for (int i = 0; i < job->num_slices && !stolen; i++) {
+                int v = (start + i) % job->num_slices;
+                job_slice *victim = &job->slices[v];
+                if (victim != home && (pass == 1 || job->node_of_slice(v) == home_node)) {
+                    stolen = steal_tasks(victim, &begin, &end);
+                }
+            }
+        }
+        if (!stolen) {
+            return;
+        }
+
+        // Publish the stolen range in our own slice so that it can in
+        // turn be stolen from. If someone else refilled our slice in
+        // the meantime, just run the stolen range ourselves.
+        uint64_t expected = __atomic_load_n(&home->range, __ATOMIC_ACQUIRE);
+        if (slice_next(expected) >= slice_end(expected) &&
+            __atomic_compare_exchange_n(&home->range, &expected, make_slice_range(begin, end),
+                                        false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+        for (uint32_t t = begin; t < end; t++) {
+            int result = halide_do_task(job->user_context, job->f, job->min + (int)t,
+                                        job->closure);
+            if (result) {
+                __atomic_store_n(&job->exit_status, result, __ATOMIC_RELEASE);
+            }
+        }
+    }
+}
+
+// Remove jobs with nothing left to claim from the job stack. They may
+// still have tasks in flight; their owners wait on active_workers.
+WEAK void prune_finished_jobs(work_queue_t *q) {
+    work **prev = &q->jobs;
+    while (*prev) {
+        if (!(*prev)->tasks_remaining()) {
+            *prev = (*prev)->next_job;
+        } else {
+            prev = &((*prev)->next_job);
+        }
+    }
+}
+
+// The job the calling thread is running a task from, if any. Must be
+// called with the lock held.
+WEAK work *current_job_already_locked(work_queue_t *q) {
+    uintptr_t id = halide_current_thread_id();
+    for (running_job_t *r = q->running_jobs; r; r = r->next) {
+        if (r->thread_id == id) {
+            return r->job;
+        }
+    }
+    return NULL;
+}
+
+WEAK bool is_descendant(work *job, work *ancestor) {
+    for (; job; job = job->parent) {
+        if (job == ancestor) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Pick a job to work on. Workers take the most recently pushed job,
+// which is usually the most deeply nested one. An owner waiting for
+// its job to finish only helps with that job and its children, so it
+// can't get stuck inside unrelated work while its caller waits on it.
+WEAK work *next_job_already_locked(work_queue_t *q, work *owned_job) {
+    work *job = q->jobs;
+    if (owned_job) {
+        while (job && !is_descendant(job, owned_job)) {
+            job = job->next_job;
+        }
+    }
+    return job;
+}
+
+// The number of threads that could start on a new job right away.
+WEAK int idle_threads_already_locked(work_queue_t *q) {
+    int b_team = q->desired_num_threads - q->a_team_size;
+    if (b_team > q->b_team_sleeping) b_team = q->b_team_sleeping;
+    if (b_team < 0) b_team = 0;
+    return q->a_team_sleeping + q->workers_spinning + b_team;
+}
+
+// Worker slots are mapped to NUMA nodes in contiguous groups, so that
+// they line up with the way each job's slices are assigned to nodes.
+WEAK int numa_node_of_slot(work_queue_t *q, int slot) {
+    int n = q->desired_num_threads;
+    if (q->numa_nodes <= 1 || n <= 0) {
+        return 0;
+    }
+    return ((slot % n) * q->numa_nodes) / n;
+}
+
+// The number of polls an idle thread makes before sleeping, unless
+// the pool is told otherwise. On the order of tens of microseconds.
+#define DEFAULT_SPIN_COUNT 10000
+
+// Release the lock and poll until a job is pushed, the pool is shut
+// down or shrunk out from under me, or my own job finishes, giving up
+// after q->spin_count polls. Called with the lock held, and returns
+// with it held again. The caller should then look for work again
+// before deciding to sleep.
+WEAK void spin_for_work_already_locked(work_queue_t *q, work *owned_job, worker_thread_state *me) {
+    int polls = q->spin_count;
+    int seen = q->jobs_pushed;
+    if (!owned_job) {
+        q->workers_spinning++;
+    }
+    halide_mutex_unlock(&q->mutex);
+    for (int i = 0; i < polls; i++) {
+        if (__atomic_load_n(&q->jobs_pushed, __ATOMIC_ACQUIRE) != seen ||
+            __atomic_load_n(&q->shutdown, __ATOMIC_ACQUIRE) ||
+            (me && __atomic_load_n(&me->retire, __ATOMIC_ACQUIRE)) ||
+            (owned_job && __atomic_load_n(&owned_job->active_workers, __ATOMIC_ACQUIRE) == 0)) {
+            break;
+        }
+    }
+    halide_mutex_lock(&q->mutex);
+    if (!owned_job) {
+        q->workers_spinning--;
+    }
+}
+
+WEAK void worker_thread_already_locked(work_queue_t *q, work *owned_job, worker_thread_state *me, int slot) {
     // If I'm a job owner, then I was the thread that called
     // do_par_for, and I should only stay in this function until my
     // job is complete. If I'm a lowly worker thread, I should stay in
-    // this function as long as the work queue is running.
+    // this function as long as the work queue is running and the pool
+    // still wants me.
+    bool spun = false;
+    uintptr_t thread_id = halide_current_thread_id();
     while (owned_job != NULL ? owned_job->running()
-           : work_queue.running()) {
+           : (q->running() && !me->retire)) {
+
+        prune_finished_jobs(q);
 
-        if (work_queue.jobs == NULL) {
+        work *job = next_job_already_locked(q, owned_job);
+        if (job == NULL) {
+            bool extra = !owned_job && q->a_team_size > q->target_a_team_size;
+            if (!spun && !extra && q->spin_count > 0) {
+                // There are no jobs pending, but one may be along
+                // shortly. Poll for it before going to sleep.
+                spin_for_work_already_locked(q, owned_job, me);
+                spun = true;
+                continue;
+            }
+            spun = false;
             if (owned_job) {
-                // There are no jobs pending. Wait for the last worker
-                // to signal that the job is finished.
-                halide_cond_wait(&work_queue.wakeup_owners, &work_queue.mutex);
-            } else if (work_queue.a_team_size <= work_queue.target_a_team_size) {
+                // There's nothing left to claim in my job or its
+                // children. Wait for the last worker to signal that
+                // the job is finished, or for a child to be pushed.
+                THREAD_POOL_BEFORE_SLEEP();
+                q->owners_sleeping++;
+                halide_cond_wait(&q->wakeup_owners, &q->mutex);
+                q->owners_sleeping--;
+            } else if (!extra) {
                 // There are no jobs pending. Wait until more jobs are enqueued.
-                halide_cond_wait(&work_queue.wakeup_a_team, &work_queue.mutex);
+                THREAD_POOL_BEFORE_SLEEP();
+                q->a_team_sleeping++;
+                halide_cond_wait(&q->wakeup_a_team, &q->mutex);
+                q->a_team_sleeping--;
             } else {
                 // There are no jobs pending, and there are too many
                 // threads in the A team. Transition to the B team
                 // until the wakeup_b_team condition is fired.
-                work_queue.a_team_size--;
-                halide_cond_wait(&work_queue.wakeup_b_team, &work_queue.mutex);
-                work_queue.a_team_size++;
+                THREAD_POOL_BEFORE_SLEEP();
+                q->a_team_size--;
+                q->b_team_sleeping++;
+                halide_cond_wait(&q->wakeup_b_team, &q->mutex);
+                q->b_team_sleeping--;
+                q->a_team_size++;
             }
         } else {
-            // Grab the next job.
-            work *job = work_queue.jobs;
-
-            // Claim a task from it.
-            work myjob = *job;
-            job->next++;
-
-            // If there were no more tasks pending for this job,
-            // remove it from the stack.
-            if (job->next == job->max) {
-                work_queue.jobs = job->next_job;
-            }
+            spun = false;
 
             // Increment the active_worker count so that other threads
             // are aware that this job is still in progress even
-            // though there are no outstanding tasks for it.
-            job->active_workers++;
+            // though there may be no outstanding tasks for it.
+            __atomic_add_fetch(&job->active_workers, 1, __ATOMIC_RELEASE);
 
-            // Release the lock and do the task.
-            halide_mutex_unlock(&work_queue.mutex);
-            int result = halide_do_task(myjob.user_context, myjob.f, myjob.next,
-                                        myjob.closure);
-            halide_mutex_lock(&work_queue.mutex);
+            // Note what I'm doing, so that any parallel loops the tasks
+            // call become children of this job.
+            running_job_t record = {thread_id, job, q->running_jobs};
+            q->running_jobs = &record;
 
-            // If this task failed, set the exit status on the job.
-            if (result) {
-                job->exit_status = result;
+            // Release the lock and claim tasks until the job runs dry.
+            halide_mutex_unlock(&q->mutex);
+            run_job_tasks(job, slot);
+            halide_mutex_lock(&q->mutex);
+
+            running_job_t **prev = &q->running_jobs;
+            while (*prev != &record) {
+                prev = &((*prev)->next);
             }
+            *prev = record.next;
 
             // We are no longer active on this job
-            job->active_workers--;
+            __atomic_sub_fetch(&job->active_workers, 1, __ATOMIC_RELEASE);
 
             // If the job is done and I'm not the owner of it, wake up
-            // the owner.
-            if (!job->running() && job != owned_job) {
-                halide_cond_broadcast(&work_queue.wakeup_owners);
+            // the owner, unless it's still spinning and will notice
+            // by itself.
+            if (!job->running() && job != owned_job && q->owners_sleeping) {
+                halide_cond_broadcast(&q->wakeup_owners);
             }
         }
     }
 }
 
-WEAK void worker_thread(void *) {
-    halide_mutex_lock(&work_queue.mutex);
-    worker_thread_already_locked(NULL);
-    halide_mutex_unlock(&work_queue.mutex);
+WEAK void worker_thread(void *arg) {
+    worker_thread_state *me = (worker_thread_state *)arg;
+    work_queue_t *q = me->queue;
+    halide_mutex_lock(&q->mutex);
+    if (q->numa_nodes > 1) {
+        halide_bind_current_thread_to_numa_node(numa_node_of_slot(q, me->slot));
+    }
+    if (q->priority) {
+        halide_set_current_thread_priority(q->priority);
+    }
+    worker_thread_already_locked(q, NULL, me, me->slot);
+    THREAD_POOL_BEFORE_SLEEP();
+    if (me->retire) {
+        // We're leaving the A team for good.
+        q->a_team_size--;
+        me->exited = true;
+    }
+    halide_mutex_unlock(&q->mutex);
+}
+
+// Join any retired workers that have finished. Must be called with
+// the lock held. Workers set exited just before releasing the lock
+// for the last time, so joining them here can't deadlock.
+WEAK void reap_retired_workers_already_locked(work_queue_t *q) {
+    worker_thread_state **prev = &q->retired;
+    while (*prev) {
+        worker_thread_state *t = *prev;
+        if (t->exited) {
+            *prev = t->next_retired;
+            halide_join_thread(t->handle);
+            free(t);
+        } else {
+            prev = &(t->next_retired);
+        }
+    }
+}
+
+// Spawn a new worker in the next free slot. Must be called with the
+// lock held. Returns false on allocation failure.
+WEAK bool spawn_worker_already_locked(work_queue_t *q) {
+    if (q->threads_created == q->threads_capacity) {
+        int new_capacity = q->threads_capacity ? q->threads_capacity * 2 : 16;
+        worker_thread_state **new_threads =
+            (worker_thread_state **)malloc(new_capacity * sizeof(worker_thread_state *));
+        if (!new_threads) {
+            return false;
+        }
+        if (q->threads) {
+            memcpy(new_threads, q->threads,
+                   q->threads_created * sizeof(worker_thread_state *));
+            free(q->threads);
+        }
+        q->threads = new_threads;
+        q->threads_capacity = new_capacity;
+    }
+    worker_thread_state *t = (worker_thread_state *)malloc(sizeof(worker_thread_state));
+    if (!t) {
+        return false;
+    }
+    // Worker slots start at 1. Slot 0 is shared by job owners.
+    t->queue = q;
+    t->slot = q->threads_created + 1;
+    t->retire = false;
+    t->exited = false;
+    t->next_retired = NULL;
+    q->threads[q->threads_created++] = t;
+    q->a_team_size++;
+    t->handle = halide_spawn_thread(worker_thread, t);
+    return true;
+}
+
+// Change the desired number of threads. If release_excess is set and
+// the pool is now bigger than needed, the surplus workers are asked
+// to leave once they finish their current task, and are joined
+// lazily. Otherwise surplus workers just sleep on the B team. Must
+// be called with the lock held. Returns the old value.
+WEAK int set_num_threads_already_locked(work_queue_t *q, int n, bool release_excess) {
+    if (n == 0) {
+        n = default_desired_num_threads();
+    }
+    int old = q->desired_num_threads;
+    q->desired_num_threads = clamp_num_threads(n);
+    if (release_excess && q->initialized) {
+        bool any_retired = false;
+        while (q->threads_created > q->desired_num_threads - 1) {
+            worker_thread_state *t = q->threads[--q->threads_created];
+            t->retire = true;
+            t->next_retired = q->retired;
+            q->retired = t;
+            any_retired = true;
+        }
+        if (any_retired) {
+            // Wake up the retirees wherever they're sleeping so they
+            // notice they should go.
+            halide_cond_broadcast(&q->wakeup_a_team);
+            halide_cond_broadcast(&q->wakeup_b_team);
+        }
+        reap_retired_workers_already_locked(q);
+    }
+    return old;
+}
+
+// Stop and join all the workers of a pool, and return it to its
+// zero-initialized state.
+WEAK void shutdown_work_queue(work_queue_t *q) {
+    if (!q->initialized) return;
+
+    // Wake everyone up and tell them the party's over and it's time
+    // to go home
+    halide_mutex_lock(&q->mutex);
+    q->shutdown = true;
+    halide_cond_broadcast(&q->wakeup_owners);
+    halide_cond_broadcast(&q->wakeup_a_team);
+    halide_cond_broadcast(&q->wakeup_b_team);
+    halide_mutex_unlock(&q->mutex);
+
+    // Wait until they leave, including any retirees that haven't
+    // been joined yet.
+    for (int i = 0; i < q->threads_created; i++) {
+        halide_join_thread(q->threads[i]->handle);
+        free(q->threads[i]);
+    }
+    while (q->retired) {
+        worker_thread_state *t = q->retired;
+        q->retired = t->next_retired;
+        halide_join_thread(t->handle);
+        free(t);
+    }
+    free(q->threads);
+    q->threads = NULL;
+    q->threads_capacity = 0;
+    q->threads_created = 0;
+
+    // Tidy up
+    halide_mutex_destroy(&q->mutex);
+    halide_cond_destroy(&q->wakeup_owners);
+    halide_cond_destroy(&q->wakeup_a_team);
+    halide_cond_destroy(&q->wakeup_b_team);
+    q->initialized = false;
+}
+
+// Semaphores keep their count in the first word. Waiting happens on
+// one condition variable shared by all semaphores, which is fine for
+// the handful of semaphore operations per tile that async producers
+// do. The count is only ever raised with semaphore_lock held, so a
+// waiter that checks it under the lock can't miss a wakeup.
+WEAK halide_mutex semaphore_lock;
+WEAK halide_cond semaphore_cond;
+WEAK bool semaphore_cond_initialized = false;
+
+// The count halide_semaphore_unblock sets. Big enough that nothing
+// that's still running can acquire all of it.
+#define SEMAPHORE_UNBLOCKED 0x3fffffff
+
+__attribute__((always_inline)) int *semaphore_count(halide_semaphore_t *sem) {
+    return (int *)(&sem->_private[0]);
+}
+
+// Decrement the count by n if it's at least n. Doesn't need the lock.
+WEAK bool semaphore_try_acquire(halide_semaphore_t *sem, int n) {
+    int *count = semaphore_count(sem);
+    int old = __atomic_load_n(count, __ATOMIC_ACQUIRE);
+    while (old >= n) {
+        if (__atomic_compare_exchange_n(count, &old, old - n, true,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+WEAK void semaphore_init_cond_already_locked() {
+    if (!semaphore_cond_initialized) {
+        halide_cond_init(&semaphore_cond);
+        semaphore_cond_initialized = true;
+    }
+}
+
+// Each halide_do_fork hands one of its tasks to a dedicated helper
+// thread, rather than to the work queue, so that the task can't end
+// up queued behind its partner while the partner waits for it on a
+// semaphore. Helpers are spawned on demand, and go back to sleep
+// between forks until the thread pool shuts down.
+struct fork_task {
+    fork_task *next;
+    halide_task_t f;
+    void *user_context;
+    uint8_t *closure;
+    int result;
+    bool done;
+};
+
+struct fork_helper {
+    fork_helper *next;
+    halide_thread *handle;
+};
+
+struct fork_state_t {
+    // All fields are protected by this mutex.
+    halide_mutex mutex;
+
+    // Broadcast when a task is queued, and when shutting down.
+    halide_cond wakeup_helpers;
+
+    // Broadcast when a task completes.
+    halide_cond task_done;
+
+    // Tasks waiting for a helper.
+    fork_task *pending;
+    int num_pending;
+
+    // The number of helpers that will pick up a pending task without
+    // another one being spawned.
+    int num_free;
+
+    fork_helper *helpers;
+    bool initialized, shutdown;
+};
+WEAK fork_state_t fork_state;
+
+WEAK void fork_helper_thread(void *arg) {
+    fork_state_t *fs = &fork_state;
+    halide_mutex_lock(&fs->mutex);
+    while (true) {
+        while (!fs->pending && !fs->shutdown) {
+            THREAD_POOL_BEFORE_SLEEP();
+            halide_cond_wait(&fs->wakeup_helpers, &fs->mutex);
+        }
+        if (!fs->pending) {
+            THREAD_POOL_BEFORE_SLEEP();
+            break;
+        }
+        fork_task *task = fs->pending;
+        fs->pending = task->next;
+        fs->num_pending--;
+        fs->num_free--;
+        halide_mutex_unlock(&fs->mutex);
+        int result = halide_do_task(task->user_context, task->f, 0, task->closure);
+        halide_mutex_lock(&fs->mutex);
+        task->result = result;
+        task->done = true;
+        fs->num_free++;
+        halide_cond_broadcast(&fs->task_done);
+    }
+    halide_mutex_unlock(&fs->mutex);
+}
+
+WEAK void shutdown_fork_helpers() {
+    fork_state_t *fs = &fork_state;
+    if (!fs->initialized) return;
+
+    halide_mutex_lock(&fs->mutex);
+    fs->shutdown = true;
+    halide_cond_broadcast(&fs->wakeup_helpers);
+    halide_mutex_unlock(&fs->mutex);
+
+    while (fs->helpers) {
+        fork_helper *h = fs->helpers;
+        fs->helpers = h->next;
+        halide_join_thread(h->handle);
+        free(h);
+    }
+
+    halide_mutex_destroy(&fs->mutex);
+    halide_cond_destroy(&fs->wakeup_helpers);
+    halide_cond_destroy(&fs->task_done);
+    fs->num_free = 0;
+    fs->shutdown = false;
+    fs->initialized = false;
 }
 
 }}}  // namespace Halide::Runtime::Internal
@@ -173,86 +793,259 @@ WEAK int halide_default_do_par_for(void *user_context, halide_task_t f,
         return 0;
     }
 
+    // Run on whichever pool this call has been bound to.
+    work_queue_t *q = (work_queue_t *)halide_get_thread_pool(user_context);
+    if (!q) {
+        q = &work_queue;
+    }
+
     // Grab the lock. If it hasn't been initialized yet, then the
-    // field will be zero-initialized because it's a static global.
-    halide_mutex_lock(&work_queue.mutex);
+    // field will be zero-initialized because it's a static global
+    // (or was memset by halide_create_thread_pool).
+    halide_mutex_lock(&q->mutex);
+
+    if (!q->initialized) {
+        q->shutdown = false;
+        halide_cond_init(&q->wakeup_owners);
+        halide_cond_init(&q->wakeup_a_team);
+        halide_cond_init(&q->wakeup_b_team);
+        q->jobs = NULL;
+        q->running_jobs = NULL;
+        q->owners_sleeping = 0;
+        q->a_team_sleeping = 0;
+        q->b_team_sleeping = 0;
+        q->workers_spinning = 0;
 
-    if (!work_queue.initialized) {
-        work_queue.shutdown = false;
-        halide_cond_init(&work_queue.wakeup_owners);
-        halide_cond_init(&work_queue.wakeup_a_team);
-        halide_cond_init(&work_queue.wakeup_b_team);
-        work_queue.jobs = NULL;
+        if (!q->spin_count_chosen) {
+            char *spin_str = getenv("HL_SPIN_COUNT");
+            q->spin_count = spin_str ? atoi(spin_str) : DEFAULT_SPIN_COUNT;
+            q->spin_count_chosen = true;
+        }
 
         // Compute the desired number of threads to use. Other code
         // can also mess with this value, but only when the work queue
         // is locked.
-        if (!work_queue.desired_num_threads) {
-            work_queue.desired_num_threads = default_desired_num_threads();
+        if (!q->desired_num_threads) {
+            q->desired_num_threads = default_desired_num_threads();
         }
-        work_queue.desired_num_threads = clamp_num_threads(work_queue.desired_num_threads);
-        work_queue.threads_created = 0;
+        q->desired_num_threads = clamp_num_threads(q->desired_num_threads);
+        q->threads_created = 0;
+        q->retired = NULL;
 
-        // Everyone starts on the a team.
-        work_queue.a_team_size = work_queue.desired_num_threads;
+        if (q->numa_mode == 0) {
+            char *numa_str = getenv("HL_NUMA");
+            q->numa_mode = (numa_str && atoi(numa_str)) ? 1 : -1;
+        }
+        q->numa_nodes = 1;
+        if (q->numa_mode > 0) {
+            q->numa_nodes = halide_numa_node_count();
+            if (q->numa_nodes < 1) {
+                q->numa_nodes = 1;
+            }
+        }
 
-        work_queue.initialized = true;
+        // Everyone starts on the a team. For now that's just us;
+        // workers join it as they're spawned.
+        q->a_team_size = 1;
+
+        q->initialized = true;
     }
 
-    while (work_queue.threads_created < work_queue.desired_num_threads - 1) {
-        // We might need to make some new threads, if work_queue.desired_num_threads has
+    while (q->threads_created < q->desired_num_threads - 1) {
+        // We might need to make some new threads, if q->desired_num_threads has
         // increased.
-        work_queue.threads[work_queue.threads_created++] =
-            halide_spawn_thread(worker_thread, NULL);
+        if (!spawn_worker_already_locked(q)) {
+            break;
+        }
+    }
+
+    // Tidy up after any workers that left because the pool shrank.
+    if (q->retired) {
+        reap_retired_workers_already_locked(q);
+    }
+
+    // A loop called from inside a task of another job on this pool is
+    // nested. If nobody is free to help with it, every thread is
+    // already busy with its ancestors, so pushing it would only make
+    // the threads fight over it. Just run it here instead.
+    work *parent = current_job_already_locked(q);
+    if (parent && idle_threads_already_locked(q) == 0) {
+        halide_mutex_unlock(&q->mutex);
+        int exit_status = 0;
+        for (int i = 0; i < size; i++) {
+            int result = halide_do_task(user_context, f, min + i, closure);
+            if (result) {
+                exit_status = result;
+            }
+        }
+        return exit_status;
     }
 
     // Make the job.
     work job;
     job.f = f;               // The job should call this function. It takes an index and a closure.
     job.user_context = user_context;
-    job.next = min;          // Start at this index.
-    job.max  = min + size;   // Keep going until one less than this index.
+    job.min = min;           // Start at this index.
+    job.size = size;         // Do this many tasks.
     job.closure = closure;   // Use this closure.
     job.exit_status = 0;     // The job hasn't failed yet
     job.active_workers = 0;  // Nobody is working on this yet
+    job.parent = parent;
+
+    // Split the tasks into one contiguous slice per thread that could
+    // work on them. Only make as many slices as the job can use, as
+    // every parallel loop puts them on its stack, and align them to a
+    // cache line.
+    int num_slices = q->desired_num_threads;
+    if (num_slices > MAX_JOB_SLICES) num_slices = MAX_JOB_SLICES;
+    if (num_slices > size) num_slices = size;
+    void *slice_storage = __builtin_alloca(num_slices * sizeof(job_slice) + 63);
+    job.slices = (job_slice *)(((uintptr_t)slice_storage + 63) & ~(uintptr_t)63);
+    job.num_slices = num_slices;
+    job.numa_nodes = q->numa_nodes < num_slices ? q->numa_nodes : num_slices;
+    for (int i = 0; i < job.num_slices; i++) {
+        uint32_t begin = (uint32_t)(((int64_t)size * i) / job.num_slices);
+        uint32_t end = (uint32_t)(((int64_t)size * (i + 1)) / job.num_slices);
+        job.slices[i].range = make_slice_range(begin, end);
+    }
 
-    if (!work_queue.jobs && size < work_queue.desired_num_threads) {
+    if (!q->jobs && size < q->desired_num_threads) {
         // If there's no nested parallelism happening and there are
         // fewer tasks to do than threads, then set the target A team
         // size so that some threads will put themselves to sleep
         // until a larger job arrives.
-        work_queue.target_a_team_size = size;
+        q->target_a_team_size = size;
     } else {
         // Otherwise the target A team size is
         // desired_num_threads. This may still be less than
         // threads_created if desired_num_threads has been reduced by
         // other code.
-        work_queue.target_a_team_size = work_queue.desired_num_threads;
+        q->target_a_team_size = q->desired_num_threads;
     }
 
     // Push the job onto the stack.
-    job.next_job = work_queue.jobs;
-    work_queue.jobs = &job;
+    job.next_job = q->jobs;
+    q->jobs = &job;
+    __atomic_add_fetch(&q->jobs_pushed, 1, __ATOMIC_RELEASE);
 
-    // Wake up our A team.
-    halide_cond_broadcast(&work_queue.wakeup_a_team);
+    // The owners of this job's ancestors can help with it. Spinning
+    // ones will notice it by themselves.
+    if (parent && q->owners_sleeping) {
+        halide_cond_broadcast(&q->wakeup_owners);
+    }
+
+    // Wake up only as many of our A team as the job can use. I take a
+    // slice myself, and any spinning workers will find the job
+    // without being woken. The owner does every task nobody else
+    // claims, so waking too few threads can't stall the job.
+    int wanted = job.num_slices - 1 - q->workers_spinning;
+    for (int i = 0; i < q->a_team_sleeping && wanted > 0; i++, wanted--) {
+        halide_cond_signal(&q->wakeup_a_team);
+    }
 
     // If there are fewer threads than we would like on the a team,
-    // wake up the b team too.
-    if (work_queue.target_a_team_size > work_queue.a_team_size) {
-        halide_cond_broadcast(&work_queue.wakeup_b_team);
+    // wake up some of the b team too.
+    for (int i = 0; i < q->b_team_sleeping && wanted > 0 &&
+                    i < q->target_a_team_size - q->a_team_size;
+         i++, wanted--) {
+        halide_cond_signal(&q->wakeup_b_team);
     }
 
-    // Do some work myself.
-    worker_thread_already_locked(&job);
+    // Do some work myself. The owner starts on the first slice.
+    worker_thread_already_locked(q, &job, NULL, 0);
 
-    halide_mutex_unlock(&work_queue.mutex);
+    halide_mutex_unlock(&q->mutex);
 
     // Return zero if the job succeeded, otherwise return the exit
     // status of one of the failing jobs (whichever one failed last).
     return job.exit_status;
 }
 
+WEAK int halide_semaphore_init(halide_semaphore_t *sem, int n) {
+    __atomic_store_n(semaphore_count(sem), n, __ATOMIC_RELEASE);
+    return n;
+}
+
+WEAK int halide_semaphore_release(halide_semaphore_t *sem, int n) {
+    halide_mutex_lock(&semaphore_lock);
+    int result = __atomic_add_fetch(semaphore_count(sem), n, __ATOMIC_ACQ_REL);
+    semaphore_init_cond_already_locked();
+    halide_cond_broadcast(&semaphore_cond);
+    halide_mutex_unlock(&semaphore_lock);
+    return result;
+}
+
+WEAK int halide_semaphore_acquire(halide_semaphore_t *sem, int n) {
+    // Try without the lock first. Nothing waits on a decrement, so
+    // this can't cause a missed wakeup.
+    if (semaphore_try_acquire(sem, n)) {
+        return 0;
+    }
+    halide_mutex_lock(&semaphore_lock);
+    semaphore_init_cond_already_locked();
+    while (!semaphore_try_acquire(sem, n)) {
+        halide_cond_wait(&semaphore_cond, &semaphore_lock);
+    }
+    halide_mutex_unlock(&semaphore_lock);
+    return 0;
+}
+
+WEAK void halide_semaphore_unblock(void *user_context, halide_semaphore_t *sem) {
+    halide_mutex_lock(&semaphore_lock);
+    __atomic_store_n(semaphore_count(sem), SEMAPHORE_UNBLOCKED, __ATOMIC_RELEASE);
+    semaphore_init_cond_already_locked();
+    halide_cond_broadcast(&semaphore_cond);
+    halide_mutex_unlock(&semaphore_lock);
+}
+
+WEAK int halide_do_fork(void *user_context, halide_task_t f, uint8_t *closure) {
+    fork_state_t *fs = &fork_state;
+
+    fork_task task;
+    task.f = f;
+    task.user_context = user_context;
+    task.closure = closure;
+    task.result = 0;
+    task.done = false;
+
+    halide_mutex_lock(&fs->mutex);
+    if (!fs->initialized) {
+        halide_cond_init(&fs->wakeup_helpers);
+        halide_cond_init(&fs->task_done);
+        fs->initialized = true;
+    }
+    task.next = fs->pending;
+    fs->pending = &task;
+    fs->num_pending++;
+    if (fs->num_pending > fs->num_free) {
+        fork_helper *h = (fork_helper *)malloc(sizeof(fork_helper));
+        if (!h) {
+            fs->pending = task.next;
+            fs->num_pending--;
+            halide_mutex_unlock(&fs->mutex);
+            halide_error(user_context, "halide_do_fork: out of memory.");
+            return -1;
+        }
+        fs->num_free++;
+        h->next = fs->helpers;
+        fs->helpers = h;
+        h->handle = halide_spawn_thread(fork_helper_thread, NULL);
+    }
+    halide_cond_broadcast(&fs->wakeup_helpers);
+    halide_mutex_unlock(&fs->mutex);
+
+    // Run the other task ourselves.
+    int result = halide_do_task(user_context, f, 1, closure);
+
+    halide_mutex_lock(&fs->mutex);
+    while (!task.done) {
+        halide_cond_wait(&fs->task_done, &fs->mutex);
+    }
+    halide_mutex_unlock(&fs->mutex);
+
+    return task.result ? task.result : result;
+}
+
 WEAK int halide_set_num_threads(int n) {
     if (n < 0) {
         halide_error(NULL, "halide_set_num_threads: must be >= 0.");
@@ -260,39 +1053,88 @@ WEAK int halide_set_num_threads(int n) {
     // Don't make this an atomic swap - we don't want to be changing
     // the desired number of threads while another thread is in the
     // middle of a sequence of non-atomic operations.
-    halide_mutex_lock(&work_queue.mutex);
-    if (n == 0) {
-        n = default_desired_num_threads();
+    work_queue_t *q = &work_queue;
+    halide_mutex_lock(&q->mutex);
+    // Shrinking the pool releases the surplus threads.
+    int old = set_num_threads_already_locked(q, n, true);
+    halide_mutex_unlock(&q->mutex);
+    return old;
+}
+
+WEAK int halide_thread_pool_set_spin_count(halide_thread_pool *pool, int n) {
+    work_queue_t *q = pool ? (work_queue_t *)pool : &work_queue;
+    if (n < 0) {
+        halide_error(NULL, "halide_thread_pool_set_spin_count: must be >= 0.");
+        n = 0;
     }
-    int old = work_queue.desired_num_threads;
-    work_queue.desired_num_threads = clamp_num_threads(n);
-    halide_mutex_unlock(&work_queue.mutex);
+    halide_mutex_lock(&q->mutex);
+    int old = q->spin_count_chosen ? q->spin_count : DEFAULT_SPIN_COUNT;
+    q->spin_count = n;
+    q->spin_count_chosen = true;
+    halide_mutex_unlock(&q->mutex);
+    return old;
+}
+
+WEAK int halide_set_numa_aware(int enabled) {
+    work_queue_t *q = &work_queue;
+    halide_mutex_lock(&q->mutex);
+    int old = q->numa_mode > 0;
+    q->numa_mode = enabled ? 1 : -1;
+    halide_mutex_unlock(&q->mutex);
     return old;
 }
 
 WEAK void halide_shutdown_thread_pool() {
-    if (!work_queue.initialized) return;
+    shutdown_work_queue(&work_queue);
+    shutdown_fork_helpers();
+}
 
-    // Wake everyone up and tell them the party's over and it's time
-    // to go home
-    halide_mutex_lock(&work_queue.mutex);
-    work_queue.shutdown = true;
-    halide_cond_broadcast(&work_queue.wakeup_owners);
-    halide_cond_broadcast(&work_queue.wakeup_a_team);
-    halide_cond_broadcast(&work_queue.wakeup_b_team);
-    halide_mutex_unlock(&work_queue.mutex);
+WEAK halide_thread_pool *halide_create_thread_pool(void *user_context, int num_threads, int priority) {
+    if (num_threads < 0) {
+        halide_error(user_context, "halide_create_thread_pool: num_threads must be >= 0.");
+        return NULL;
+    }
+    work_queue_t *q = (work_queue_t *)malloc(sizeof(work_queue_t));
+    if (!q) {
+        halide_error(user_context, "halide_create_thread_pool: out of memory.");
+        return NULL;
+    }
+    // Like the global pool, a zero-initialized pool is ready to use
+    // and starts its threads on the first parallel loop.
+    memset(q, 0, sizeof(work_queue_t));
+    q->desired_num_threads = num_threads;
+    q->priority = priority;
+    return (halide_thread_pool *)q;
+}
 
-    // Wait until they leave
-    for (int i = 0; i < work_queue.threads_created; i++) {
-        halide_join_thread(work_queue.threads[i]);
+WEAK void halide_destroy_thread_pool(void *user_context, halide_thread_pool *pool) {
+    work_queue_t *q = (work_queue_t *)pool;
+    if (!q || q == &work_queue) {
+        return;
     }
+    shutdown_work_queue(q);
+    free(q);
+}
 
-    // Tidy up
-    halide_mutex_destroy(&work_queue.mutex);
-    halide_cond_destroy(&work_queue.wakeup_owners);
-    halide_cond_destroy(&work_queue.wakeup_a_team);
-    halide_cond_destroy(&work_queue.wakeup_b_team);
-    work_queue.initialized = false;
+WEAK int halide_thread_pool_set_num_threads(halide_thread_pool *pool, int n) {
+    work_queue_t *q = pool ? (work_queue_t *)pool : &work_queue;
+    if (n < 0) {
+        halide_error(NULL, "halide_thread_pool_set_num_threads: must be >= 0.");
+    }
+    halide_mutex_lock(&q->mutex);
+    int old = set_num_threads_already_locked(q, n, true);
+    halide_mutex_unlock(&q->mutex);
+    return old;
+}
+
+WEAK halide_get_thread_pool_t halide_set_custom_get_thread_pool(halide_get_thread_pool_t f) {
+    halide_get_thread_pool_t result = custom_get_thread_pool;
+    custom_get_thread_pool = f;
+    return result;
+}
+
+WEAK halide_thread_pool *halide_get_thread_pool(void *user_context) {
+    return (*custom_get_thread_pool)(user_context);
 }
 
 }
@@ -14,7 +14,8 @@ namespace Halide { namespace Runtime { namespace Internal {
 // equivalent to a reader-writer lock, but in my case the "readers"
 // will actually be writing simultaneously to the trace buffer, so
 // that's a bad name. We use the __sync primitives used elsewhere in
-// the runtime for atomic work. They are well supported by clang.
+// the runtime for atomic work. They are well supported by clang. A
+// zero-initialized lock is unlocked.
 class SharedExclusiveSpinLock {
     volatile uint32_t lock;
 
@@ -64,72 +65,410 @@ public:
     __attribute__((always_inline)) void release_exclusive() {
         __sync_fetch_and_and(&lock, ~exclusive_held_mask);
     }
+};
+
+// Trace packets are written into per-thread buffers, so that tracing
+// a parallel pipeline doesn't have every worker contending on one
+// buffer. Threads are mapped to stripes by their stack (see
+// current_stack_key). Threads that collide on a stripe share its
+// buffer via the SharedExclusiveSpinLock. There
+// must be no more stripes than bits in trace_stripes_with_parents.
+#define TRACE_NUM_STRIPES 32
+
+const static int buffer_size = 256 * 1024;
+
+// Bound on the number of buffers in existence, full or empty. Writers
+// that need a fresh buffer when there are this many help write out
+// full ones until one is free.
+const static int max_trace_buffers = 4 * TRACE_NUM_STRIPES;
+
+// State for the compact format (see halide_set_trace_compact), which
+// is reset at the start of each buffer so that every block written
+// can be decoded on its own.
+#define TRACE_COMPACT_MAX_FUNCS 64
+#define TRACE_COMPACT_MAX_COORDS 64
+#define TRACE_COMPACT_HEADER_BYTES 8
+
+struct TraceCompactState {
+    int32_t prev_id;
+    int32_t num_coords;
+    int32_t num_funcs;
+    int32_t coords[TRACE_COMPACT_MAX_COORDS];
+    const char *funcs[TRACE_COMPACT_MAX_FUNCS];
+};
+
+struct TraceBuffer {
+    TraceBuffer *next;
+    int fd;
+    uint32_t size;
+    bool compact;
+    TraceCompactState state;
+    uint8_t buf[buffer_size];
+};
+
+WEAK bool trace_compact = false;
+WEAK uint32_t trace_sample_period = 1;
+
+WEAK __attribute__((always_inline)) uint8_t *put_varint(uint8_t *dst, uint32_t x) {
+    while (x >= 0x80) {
+        *dst++ = (uint8_t)(x | 0x80);
+        x >>= 7;
+    }
+    *dst++ = (uint8_t)x;
+    return dst;
+}
+
+// Map signed values to unsigned ones so that small deltas of either
+// sign become short varints.
+WEAK __attribute__((always_inline)) uint32_t zigzag(int32_t x) {
+    return ((uint32_t)x << 1) ^ (uint32_t)(x >> 31);
+}
+
+// Encode an event into dst, which must have room for
+// compact_record_bound(e) bytes. Returns the end of the record.
+WEAK uint8_t *encode_compact_record(TraceCompactState *state, uint8_t *dst,
+                                    const halide_trace_event_t *e, int32_t id) {
+    *dst++ = (uint8_t)(e->event | (e->value ? 0x10 : 0));
+
+    // Func names are matched by content, as the same name can arrive
+    // from more than one pointer. Comparing the pointers first makes
+    // the common case cheap.
+    int f = 0;
+    while (f < state->num_funcs &&
+           state->funcs[f] != e->func &&
+           strcmp(state->funcs[f], e->func) != 0) {
+        f++;
+    }
+    dst = put_varint(dst, f);
+    if (f == state->num_funcs) {
+        size_t len = strlen(e->func) + 1;
+        memcpy(dst, e->func, len);
+        dst += len;
+        if (state->num_funcs < TRACE_COMPACT_MAX_FUNCS) {
+            state->funcs[state->num_funcs++] = e->func;
+        }
+    }
+
+    dst = put_varint(dst, zigzag(id - state->prev_id));
+    state->prev_id = id;
+    dst = put_varint(dst, zigzag(id - e->parent_id));
+    dst = put_varint(dst, e->value_index);
+    *dst++ = e->type.code;
+    *dst++ = e->type.bits;
+    dst = put_varint(dst, e->type.lanes);
+    dst = put_varint(dst, e->dimensions);
+
+    // Coordinates are deltas against the previous record in the block.
+    for (int i = 0; i < e->dimensions; i++) {
+        int32_t prev = i < state->num_coords ? state->coords[i] : 0;
+        int32_t c = e->coordinates ? e->coordinates[i] : 0;
+        dst = put_varint(dst, zigzag(c - prev));
+        if (i < TRACE_COMPACT_MAX_COORDS) {
+            state->coords[i] = c;
+        }
+    }
+    state->num_coords = e->dimensions < TRACE_COMPACT_MAX_COORDS ? e->dimensions : TRACE_COMPACT_MAX_COORDS;
+
+    if (e->value) {
+        size_t value_bytes = e->type.lanes * e->type.bytes();
+        memcpy(dst, e->value, value_bytes);
+        dst += value_bytes;
+    }
+    return dst;
+}
+
+WEAK __attribute__((always_inline)) uint32_t compact_record_bound(const halide_trace_event_t *e) {
+    return 64 + strlen(e->func) + 5 * e->dimensions + e->type.lanes * e->type.bytes();
+}
+
+// Full buffers are queued in the order they were sealed and written
+// out in that order by whichever thread is the current writer. That
+// keeps writers from stalling each other on the file, and guarantees
+// that a packet reaches the file after any packet that was in a buffer
+// sealed before it. We rely on that to keep parents ahead of their
+// children (see halide_default_trace).
+class TraceQueue {
+    halide_mutex lock;
+    TraceBuffer *head, *tail;
+    TraceBuffer *free_list;
+    int num_buffers;
+    // Nonzero while some thread is writing out queued buffers.
+    int writing;
+    // Set if a write failed, to be reported on the next flush.
+    bool failed;
+
+    TraceBuffer *pop() {
+        halide_mutex_lock(&lock);
+        TraceBuffer *b = head;
+        if (b) {
+            head = b->next;
+            if (!head) {
+                tail = NULL;
+            }
+        }
+        halide_mutex_unlock(&lock);
+        return b;
+    }
+
+    bool empty() {
+        return __atomic_load_n(&head, __ATOMIC_ACQUIRE) == NULL;
+    }
+
+public:
+    // Returns an empty buffer that will be written to the given fd,
+    // in the compact format if it's enabled.
+    TraceBuffer *get_free_buffer(int fd) {
+        while (1) {
+            halide_mutex_lock(&lock);
+            TraceBuffer *b = free_list;
+            if (b) {
+                free_list = b->next;
+            } else if (num_buffers < max_trace_buffers) {
+                b = (TraceBuffer *)malloc(sizeof(TraceBuffer));
+                if (b) {
+                    num_buffers++;
+                }
+            }
+            halide_mutex_unlock(&lock);
+            if (b) {
+                b->next = NULL;
+                b->fd = fd;
+                b->size = 0;
+                b->compact = trace_compact;
+                if (b->compact) {
+                    memset(&b->state, 0, sizeof(b->state));
+                }
+                return b;
+            }
+            // Everything is full. Help write them out.
+            drain();
+        }
+    }
+
+    void push(TraceBuffer *b) {
+        halide_mutex_lock(&lock);
+        b->next = NULL;
+        if (tail) {
+            tail->next = b;
+        } else {
+            head = b;
+        }
+        tail = b;
+        halide_mutex_unlock(&lock);
+    }
+
+    // If no other thread is doing so, write out all queued buffers.
+    void drain() {
+        while (!empty() && __sync_bool_compare_and_swap(&writing, 0, 1)) {
+            while (TraceBuffer *b = pop()) {
+                if (b->size && b->size != (uint32_t)write(b->fd, b->buf, b->size)) {
+                    failed = true;
+                }
+                halide_mutex_lock(&lock);
+                b->next = free_list;
+                free_list = b;
+                halide_mutex_unlock(&lock);
+            }
+            __sync_lock_release(&writing);
+            // Something may have been pushed after our last pop but
+            // before we released the writer role, so check again.
+        }
+    }
+
+    // Write out all queued buffers, waiting for any other writer to
+    // finish. Returns false if any write since the last call failed.
+    bool drain_all() {
+        do {
+            drain();
+        } while (!empty() || __atomic_load_n(&writing, __ATOMIC_ACQUIRE));
+        bool ok = !failed;
+        failed = false;
+        return ok;
+    }
 
-    SharedExclusiveSpinLock() : lock(0) {}
+    // Release the memory of all empty buffers.
+    void release_free_buffers() {
+        halide_mutex_lock(&lock);
+        while (free_list) {
+            TraceBuffer *b = free_list;
+            free_list = b->next;
+            free(b);
+            num_buffers--;
+        }
+        halide_mutex_unlock(&lock);
+    }
 };
 
-const static int buffer_size = 1024 * 1024;
+WEAK TraceQueue trace_queue;
+
+// Packet ids are handed out to stripes in blocks of this many, so
+// that every packet doesn't touch one global counter.
+#define TRACE_ID_BLOCK_SIZE 1024
+
+WEAK uint32_t trace_next_id_block = 1;
 
-class TraceBuffer {
+// Bit i is set while stripe i holds a buffered packet that other
+// threads may write children of. Those must come after it in the
+// file, so the stripe is queued before any other stripe writes.
+WEAK uint32_t trace_stripes_with_parents = 0;
+
+class TraceStripe {
     SharedExclusiveSpinLock lock;
     uint32_t cursor;
-    uint8_t buf[buffer_size];
+    TraceBuffer *buffer;
+    // The stripe's current block of packet ids.
+    volatile int id_lock;
+    uint32_t next_id_in_block, end_of_block;
+    // Pad to a cache line so stripes don't false-share.
+    uint8_t padding[64];
+
+    // Counts loads and stores for sampling in the compact format.
+    uint32_t sample_count;
+
+    // Where the first record goes in a fresh buffer. Compact buffers
+    // start with a block header.
+    __attribute__((always_inline)) static uint32_t start_of(TraceBuffer *b) {
+        return b && b->compact ? TRACE_COMPACT_HEADER_BYTES : 0;
+    }
+
+    // Set the buffer's size from the cursor, and queue it to be
+    // written out.
+    __attribute__((always_inline)) void queue_buffer() {
+        buffer->size = cursor;
+        if (buffer->compact) {
+            uint32_t header[2] = {HALIDE_TRACE_COMPACT_MAGIC, cursor - TRACE_COMPACT_HEADER_BYTES};
+            memcpy(buffer->buf, header, sizeof(header));
+        }
+        trace_queue.push(buffer);
+    }
 
     // Attempt to atomically acquire space in the buffer to write a
-    // packet. Returns NULL if the buffer was full.
-    __attribute__((always_inline)) halide_trace_packet_t *try_acquire_packet(void *user_context, uint32_t size) {
+    // packet for the given fd. Returns NULL if there isn't a suitable
+    // buffer or it's full, and returns the buffer seen in seen.
+    __attribute__((always_inline)) halide_trace_packet_t *try_acquire_packet(void *user_context, int fd, uint32_t size, TraceBuffer **seen) {
         lock.acquire_shared();
         halide_assert(user_context, size <= buffer_size);
-        uint32_t my_cursor = __sync_fetch_and_add(&cursor, size);
-        if (my_cursor + size > sizeof(buf)) {
+        TraceBuffer *b = buffer;
+        *seen = b;
+        if (b && b->fd == fd && !b->compact) {
+            uint32_t my_cursor = __sync_fetch_and_add(&cursor, size);
+            if (my_cursor + size <= sizeof(b->buf)) {
+                return (halide_trace_packet_t *)(b->buf + my_cursor);
+            }
             __sync_fetch_and_sub(&cursor, size);
-            lock.release_shared();
-            return NULL;
-        } else {
-            return (halide_trace_packet_t *)(buf + my_cursor);
         }
+        lock.release_shared();
+        return NULL;
     }
 
 public:
+    __attribute__((always_inline)) int32_t next_id() {
+        ScopedSpinLock l(&id_lock);
+        if (next_id_in_block == end_of_block) {
+            next_id_in_block = __sync_fetch_and_add(&trace_next_id_block, TRACE_ID_BLOCK_SIZE);
+            end_of_block = next_id_in_block + TRACE_ID_BLOCK_SIZE;
+        }
+        return (int32_t)(next_id_in_block++);
+    }
+
+    // Wait for all writers to finish with their packets, and if the
+    // buffer is still the one the caller saw, queue it to be written
+    // out and replace it with an empty one for fd.
+    void seal(TraceBuffer *seen, int fd) {
+        lock.acquire_exclusive();
+        if (buffer == seen) {
+            if (buffer) {
+                queue_buffer();
+            }
+            buffer = trace_queue.get_free_buffer(fd);
+            cursor = start_of(buffer);
+        }
+        lock.release_exclusive();
+    }
 
-    // Wait for all writers to finish with their packets, stall any
-    // new writers, and flush the buffer to the fd.
-    __attribute__((always_inline)) void flush(void *user_context, int fd) {
+    // Queue whatever is in the buffer to be written out. If close is
+    // set the stripe is left without a buffer, otherwise it gets an
+    // empty one for the same fd.
+    void flush(int stripe_index, bool close) {
         lock.acquire_exclusive();
-        bool success = true;
-        if (cursor) {
-            success = (cursor == (uint32_t)write(fd, buf, cursor));
-            cursor = 0;
+        __sync_fetch_and_and(&trace_stripes_with_parents, ~(1u << stripe_index));
+        if (buffer && (close || cursor > start_of(buffer))) {
+            int fd = buffer->fd;
+            queue_buffer();
+            buffer = close ? NULL : trace_queue.get_free_buffer(fd);
+            cursor = start_of(buffer);
         }
         lock.release_exclusive();
-        halide_assert(user_context, success && "Could not write to trace file");
     }
 
-    // Acquire and return a packet's worth of space in the trace
-    // buffer, flushing the trace buffer to the given fd to make space
-    // if necessary. The region acquired is protected from other
-    // threads writing or reading to it, so it must be released before
-    // a flush can occur.
+    // Acquire and return a packet's worth of space in the stripe's
+    // buffer, queuing the buffer to be written out to make space if
+    // necessary. The region acquired is protected from other threads
+    // writing or reading to it, so it must be released before the
+    // buffer can be sealed.
     __attribute__((always_inline)) halide_trace_packet_t *acquire_packet(void *user_context, int fd, uint32_t size) {
         halide_trace_packet_t *packet = NULL;
-        while (!(packet = try_acquire_packet(user_context, size))) {
-            // Couldn't acquire space to write a packet. Flush and try again.
-            flush(user_context, fd);
+        TraceBuffer *seen = NULL;
+        while (!(packet = try_acquire_packet(user_context, fd, size, &seen))) {
+            // Couldn't acquire space to write a packet. Swap in a
+            // fresh buffer, write out any full ones, and try again.
+            seal(seen, fd);
+            trace_queue.drain();
         }
         return packet;
     }
 
-    // Release a packet, allowing it to be written out with flush
+    // Returns true if a load or store should be dropped from a
+    // compact trace.
+    __attribute__((always_inline)) bool skip_sample() {
+        uint32_t period = trace_sample_period;
+        return period > 1 && (__sync_fetch_and_add(&sample_count, 1) % period) != 0;
+    }
+
+    // Append an event to the stripe's buffer in the compact format.
+    // The encoder state is shared by all threads on the stripe, so
+    // this takes the lock exclusively.
+    void write_compact(void *user_context, int fd, const halide_trace_event_t *e, int32_t id) {
+        uint32_t bound = compact_record_bound(e);
+        halide_assert(user_context, bound + TRACE_COMPACT_HEADER_BYTES <= buffer_size);
+        while (1) {
+            lock.acquire_exclusive();
+            TraceBuffer *b = buffer;
+            if (b && b->fd == fd && b->compact && cursor + bound <= sizeof(b->buf)) {
+                uint8_t *end = encode_compact_record(&b->state, b->buf + cursor, e, id);
+                cursor = (uint32_t)(end - b->buf);
+                lock.release_exclusive();
+                return;
+            }
+            lock.release_exclusive();
+            seal(b, fd);
+            trace_queue.drain();
+        }
+    }
+
+    // Release a packet, allowing it to be written out
     __attribute__((always_inline)) void release_packet(halide_trace_packet_t *) {
         // Need a memory barrier to guarantee all the writes are done.
         __sync_synchronize();
         lock.release_shared();
     }
-
-    TraceBuffer() : cursor(0) {}
 };
 
-WEAK TraceBuffer *halide_trace_buffer = NULL;
+WEAK TraceStripe trace_stripes[TRACE_NUM_STRIPES];
+
+WEAK __attribute__((always_inline)) int current_trace_stripe() {
+    return (int)(stack_key_hash(current_stack_key(16)) >> 59);
+}
+
+// Queue the contents of every stripe and write them out, closing the
+// stripes' buffers if close is set. Returns false if a write failed.
+WEAK bool flush_all_trace_stripes(bool close) {
+    for (int i = 0; i < TRACE_NUM_STRIPES; i++) {
+        trace_stripes[i].flush(i, close);
+    }
+    return trace_queue.drain_all();
+}
+
 WEAK int halide_trace_file = -1; // -1 indicates uninitialized
 WEAK int halide_trace_file_lock = 0;
 WEAK bool halide_trace_file_initialized = false;
@@ -140,51 +479,82 @@ WEAK void *halide_trace_file_internally_opened = NULL;
 extern "C" {
 
 WEAK int32_t halide_default_trace(void *user_context, const halide_trace_event_t *e) {
-    static int32_t ids = 1;
-
-    int32_t my_id = __sync_fetch_and_add(&ids, 1);
+    int stripe_index = current_trace_stripe();
+    TraceStripe *stripe = &trace_stripes[stripe_index];
+    int32_t my_id = stripe->next_id();
 
     // If we're dumping to a file, use a binary format
     int fd = halide_get_trace_file(user_context);
     if (fd > 0) {
-        // Compute the total packet size
-        uint32_t value_bytes = (uint32_t)(e->type.lanes * e->type.bytes());
-        uint32_t header_bytes = (uint32_t)sizeof(halide_trace_packet_t);
-        uint32_t coords_bytes = e->dimensions * (uint32_t)sizeof(int32_t);
-        uint32_t name_bytes = strlen(e->func) + 1;
-        uint32_t total_size_without_padding = header_bytes + value_bytes + coords_bytes + name_bytes;
-        uint32_t total_size = (total_size_without_padding + 3) & ~3;
-
-        // Claim some space to write to in the trace buffer
-        halide_trace_packet_t *packet = halide_trace_buffer->acquire_packet(user_context, fd, total_size);
-
-        if (total_size > 4096) {
-            print(NULL) << total_size << "\n";
+        // This event may be the child of a packet buffered on another
+        // stripe. Queue those stripes first so that parents stay
+        // ahead of their children in the file.
+        uint32_t my_bit = 1u << stripe_index;
+        uint32_t others = __atomic_load_n(&trace_stripes_with_parents, __ATOMIC_ACQUIRE) & ~my_bit;
+        while (others) {
+            int i = __builtin_ctz(others);
+            trace_stripes[i].flush(i, false);
+            others &= others - 1;
         }
 
-        // Write a packet into it
-        packet->size = total_size;
-        packet->id = my_id;
-        packet->type = e->type;
-        packet->event = e->event;
-        packet->parent_id = e->parent_id;
-        packet->value_index = e->value_index;
-        packet->dimensions = e->dimensions;
-        if (e->coordinates) {
-            memcpy((void *)packet->coordinates(), e->coordinates, coords_bytes);
-        }
-        if (e->value) {
-            memcpy((void *)packet->value(), e->value, value_bytes);
-        }
-        memcpy((void *)packet->func(), e->func, name_bytes);
+        if (trace_compact) {
+            // Only loads and stores are sampled, so the structure of
+            // the trace stays intact.
+            bool is_access = e->event == halide_trace_load || e->event == halide_trace_store;
+            if (!is_access || !stripe->skip_sample()) {
+                stripe->write_compact(user_context, fd, e, my_id);
+            }
+        } else {
+            // Compute the total packet size
+            uint32_t value_bytes = (uint32_t)(e->type.lanes * e->type.bytes());
+            uint32_t header_bytes = (uint32_t)sizeof(halide_trace_packet_t);
+            uint32_t coords_bytes = e->dimensions * (uint32_t)sizeof(int32_t);
+            uint32_t name_bytes = strlen(e->func) + 1;
+            uint32_t total_size_without_padding = header_bytes + value_bytes + coords_bytes + name_bytes;
+            uint32_t total_size = (total_size_without_padding + 3) & ~3;
+
+            // Claim some space to write to in this thread's trace buffer
+            halide_trace_packet_t *packet = stripe->acquire_packet(user_context, fd, total_size);
+
+            if (total_size > 4096) {
+                print(NULL) << total_size << "\n";
+            }
+
+            // Write a packet into it
+            packet->size = total_size;
+            packet->id = my_id;
+            packet->type = e->type;
+            packet->event = e->event;
+            packet->parent_id = e->parent_id;
+            packet->value_index = e->value_index;
+            packet->dimensions = e->dimensions;
+            if (e->coordinates) {
+                memcpy((void *)packet->coordinates(), e->coordinates, coords_bytes);
+            }
+            if (e->value) {
+                memcpy((void *)packet->value(), e->value, value_bytes);
+            }
+            memcpy((void *)packet->func(), e->func, name_bytes);
 
-        // Release it
-        halide_trace_buffer->release_packet(packet);
+            // Release it
+            stripe->release_packet(packet);
+        }
 
-        // We should also flush the trace buffer if we hit an event
-        // that might be the end of the trace.
         if (e->event == halide_trace_end_pipeline) {
-            halide_trace_buffer->flush(user_context, fd);
+            // We should also flush all the trace buffers if we hit an
+            // event that might be the end of the trace.
+            bool success = flush_all_trace_stripes(false);
+            halide_assert(user_context, success && "Could not write to trace file");
+        } else if (e->event == halide_trace_begin_pipeline ||
+                   e->event == halide_trace_begin_realization ||
+                   e->event == halide_trace_produce ||
+                   e->event == halide_trace_consume) {
+            // Other threads may write children of this event to
+            // their own buffers. Rather than queue ours now, mark the
+            // stripe so that they queue it first if they do.
+            if (!(__atomic_load_n(&trace_stripes_with_parents, __ATOMIC_RELAXED) & my_bit)) {
+                __sync_fetch_and_or(&trace_stripes_with_parents, my_bit);
+            }
         }
 
     } else {
@@ -310,6 +680,11 @@ WEAK void halide_set_trace_file(int fd) {
     halide_trace_file = fd;
 }
 
+WEAK void halide_set_trace_compact(int sample_period) {
+    trace_sample_period = sample_period > 1 ? sample_period : 1;
+    trace_compact = sample_period > 0;
+}
+
 extern int errno;
 
 WEAK int halide_get_trace_file(void *user_context) {
@@ -321,8 +696,9 @@ WEAK int halide_get_trace_file(void *user_context) {
             halide_assert(user_context, file && "Failed to open trace file\n");
             halide_set_trace_file(fileno(file));
             halide_trace_file_internally_opened = file;
-            if (!halide_trace_buffer) {
-                halide_trace_buffer = (TraceBuffer *)malloc(sizeof(TraceBuffer));
+            const char *compact = getenv("HL_TRACE_COMPACT");
+            if (compact) {
+                halide_set_trace_compact(atoi(compact));
             }
         } else {
             halide_set_trace_file(0);
@@ -336,17 +712,17 @@ WEAK int32_t halide_trace(void *user_context, const halide_trace_event_t *e) {
 }
 
 WEAK int halide_shutdown_trace() {
+    // Write out anything still buffered, whoever opened the file.
+    bool success = flush_all_trace_stripes(true);
+    trace_queue.release_free_buffers();
     if (halide_trace_file_internally_opened) {
         int ret = fclose(halide_trace_file_internally_opened);
         halide_trace_file = 0;
         halide_trace_file_initialized = false;
         halide_trace_file_internally_opened = NULL;
-        if (halide_trace_buffer) {
-            free(halide_trace_buffer);
-        }
-        return ret;
+        return success ? ret : -1;
     } else {
-        return 0;
+        return success ? 0 : -1;
     }
 }
 
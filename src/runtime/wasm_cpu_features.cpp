@@ -0,0 +1,15 @@
+#include "HalideRuntime.h"
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+WEAK CpuFeatures halide_get_cpu_features() {
+    // WebAssembly has no CPU-specific Features. SIMD128 is part of
+    // the target, and a module that uses it fails to validate on an
+    // engine without it.
+    const uint64_t known = 0;
+    const uint64_t available = 0;
+    CpuFeatures features = {known, available};
+    return features;
+}
+
+}}} // namespace Halide::Runtime::Internal
@@ -20,6 +20,7 @@ typedef struct {
 extern WIN32API Thread CreateThread(void *, size_t, void *(*fn)(void *), void *, int32_t, int32_t *);
 extern WIN32API void InitializeConditionVariable(ConditionVariable *);
 extern WIN32API void WakeAllConditionVariable(ConditionVariable *);
+extern WIN32API void WakeConditionVariable(ConditionVariable *);
 extern WIN32API void SleepConditionVariableCS(ConditionVariable *, CriticalSection *, int);
 extern WIN32API void InitializeCriticalSection(CriticalSection *);
 extern WIN32API void DeleteCriticalSection(CriticalSection *);
@@ -27,6 +28,9 @@ extern WIN32API void EnterCriticalSection(CriticalSection *);
 extern WIN32API void LeaveCriticalSection(CriticalSection *);
 extern WIN32API int32_t WaitForSingleObject(Thread, int32_t timeout);
 extern WIN32API bool InitOnceExecuteOnce(InitOnce *, bool WIN32API (*f)(InitOnce *, void *, void **), void *, void **);
+extern WIN32API Thread GetCurrentThread();
+extern WIN32API int32_t GetCurrentThreadId();
+extern WIN32API bool SetThreadPriority(Thread, int);
 
 } // extern "C"
 
@@ -106,12 +110,21 @@ WEAK void halide_cond_broadcast(struct halide_cond *cond_arg) {
     WakeAllConditionVariable(cond);
 }
 
+WEAK void halide_cond_signal(struct halide_cond *cond_arg) {
+    ConditionVariable *cond = (ConditionVariable *)cond_arg;
+    WakeConditionVariable(cond);
+}
+
 WEAK void halide_cond_wait(struct halide_cond *cond_arg, struct halide_mutex *mutex_arg) {
     ConditionVariable *cond = (ConditionVariable *)cond_arg;
     windows_mutex *mutex = (windows_mutex *)mutex_arg;
     SleepConditionVariableCS(cond, &mutex->critical_section, -1);
 }
 
+WEAK uintptr_t halide_current_thread_id() {
+    return (uintptr_t)(uint32_t)GetCurrentThreadId();
+}
+
 WEAK int halide_host_cpu_count() {
     // Apparently a standard windows environment variable
     char *num_cores = getenv("NUMBER_OF_PROCESSORS");
@@ -122,4 +135,29 @@ WEAK int halide_host_cpu_count() {
     }
 }
 
+WEAK int halide_set_current_thread_priority(int priority) {
+    // Map nice-style values onto the coarser Windows priority levels
+    // (THREAD_PRIORITY_HIGHEST = 2 ... THREAD_PRIORITY_LOWEST = -2).
+    int p = 0;
+    if (priority <= -10) {
+        p = 2;
+    } else if (priority < 0) {
+        p = 1;
+    } else if (priority >= 10) {
+        p = -2;
+    } else if (priority > 0) {
+        p = -1;
+    }
+    return SetThreadPriority(GetCurrentThread(), p) ? 0 : -1;
+}
+
+// NUMA placement is not supported on this platform.
+WEAK int halide_numa_node_count() {
+    return 1;
+}
+
+WEAK int halide_bind_current_thread_to_numa_node(int node) {
+    return -1;
+}
+
 } // extern "C"
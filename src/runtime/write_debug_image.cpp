@@ -1,4 +1,5 @@
 #include "HalideRuntime.h"
+#include "scoped_mutex_lock.h"
 
 // We support three formats, tiff, mat, and tmp.
 //
@@ -118,18 +119,9 @@ struct ScopedFile {
     }
 };
 
-}}} // namespace Halide::Runtime::Internal
-
-WEAK extern "C" int32_t halide_debug_to_file(void *user_context, const char *filename,
-                                             int32_t type_code, struct halide_buffer_t *buf) {
-
-    if (buf->dimensions > 4) {
-        halide_error(user_context, "Can't debug_to_file a Func with more than four dimensions\n");
-        return -1;
-    }
-
-    halide_copy_to_host(user_context, buf);
-
+// Write a buffer that's already on the host to a file.
+WEAK int32_t write_debug_image(void *user_context, const char *filename,
+                               int32_t type_code, const halide_buffer_t *buf) {
     ScopedFile f(filename, "wb");
     if (!f.open()) return -2;
 
@@ -355,3 +347,234 @@ WEAK extern "C" int32_t halide_debug_to_file(void *user_context, const char *fil
 
     return 0;
 }
+
+// When writing asynchronously, halide_debug_to_file copies the buffer
+// into one of these, and a background thread writes it out. The
+// filename and the densely packed contents are allocated along with
+// it.
+struct debug_to_file_job {
+    debug_to_file_job *next;
+    char *filename;
+    int32_t type_code;
+    size_t size;
+    halide_buffer_t buf;
+    halide_dimension_t dim[4];
+};
+
+struct debug_to_file_state {
+    halide_mutex lock;
+    debug_to_file_job *head, *tail;
+    // The writer thread, if one has been spawned and not yet
+    // joined. It exits once the queue is empty, so nothing sits idle
+    // (or spins, on platforms without condition variables) between
+    // dumps.
+    halide_thread *writer;
+    bool writer_running;
+    bool initialized;
+    int64_t max_pending_bytes, pending_bytes;
+    int32_t error;
+};
+
+WEAK debug_to_file_state debug_to_file_async_state;
+
+WEAK void debug_to_file_writer(void *) {
+    debug_to_file_state *s = &debug_to_file_async_state;
+    while (true) {
+        debug_to_file_job *job;
+        {
+            ScopedMutexLock lock(&s->lock);
+            job = s->head;
+            if (!job) {
+                s->writer_running = false;
+                return;
+            }
+            s->head = job->next;
+            if (!s->head) {
+                s->tail = NULL;
+            }
+        }
+        int32_t result = write_debug_image(NULL, job->filename, job->type_code, &job->buf);
+        size_t size = job->size;
+        free(job);
+        ScopedMutexLock lock(&s->lock);
+        s->pending_bytes -= size;
+        if (result && !s->error) {
+            s->error = result;
+        }
+    }
+}
+
+// Must be called with the lock held.
+WEAK void debug_to_file_init_already_locked() {
+    debug_to_file_state *s = &debug_to_file_async_state;
+    if (!s->initialized) {
+        // HL_DEBUG_TO_FILE_ASYNC is the number of megabytes of
+        // copies that may wait to be written.
+        const char *limit = getenv("HL_DEBUG_TO_FILE_ASYNC");
+        if (limit) {
+            s->max_pending_bytes = (int64_t)atoi(limit) << 20;
+        }
+        s->initialized = true;
+    }
+}
+
+// Copy the buffer and queue it to be written by the background
+// thread. Returns false if it should be written synchronously
+// instead.
+WEAK bool debug_to_file_enqueue(const char *filename, int32_t type_code,
+                                const halide_buffer_t *buf) {
+    debug_to_file_state *s = &debug_to_file_async_state;
+    const size_t bytes_per_element = buf->type.bytes();
+    size_t elts = 1;
+    for (int i = 0; i < buf->dimensions; i++) {
+        elts *= buf->dim[i].extent;
+    }
+    const size_t name_size = strlen(filename) + 1;
+    // The contents go first, so that they're aligned.
+    const size_t payload_bytes = (elts * bytes_per_element + 7) & ~7;
+    const size_t size = payload_bytes + sizeof(debug_to_file_job) + name_size;
+
+    {
+        ScopedMutexLock lock(&s->lock);
+        debug_to_file_init_already_locked();
+        if (s->pending_bytes + (int64_t)size > s->max_pending_bytes) {
+            return false;
+        }
+        s->pending_bytes += size;
+    }
+
+    uint8_t *mem = (uint8_t *)malloc(size);
+    if (!mem) {
+        ScopedMutexLock lock(&s->lock);
+        s->pending_bytes -= size;
+        return false;
+    }
+    debug_to_file_job *job = (debug_to_file_job *)(mem + payload_bytes);
+    job->next = NULL;
+    job->filename = (char *)(job + 1);
+    memcpy(job->filename, filename, name_size);
+    job->type_code = type_code;
+    job->size = size;
+    job->buf = *buf;
+    job->buf.host = mem;
+    job->buf.device = 0;
+    job->buf.device_interface = NULL;
+    job->buf.flags = 0;
+    job->buf.dim = job->dim;
+
+    // Pack the contents densely, keeping the mins.
+    halide_dimension_t shape[4];
+    int stride = 1;
+    for (int i = 0; i < 4; i++) {
+        if (i < buf->dimensions) {
+            shape[i] = buf->dim[i];
+            job->dim[i] = buf->dim[i];
+            job->dim[i].stride = stride;
+            stride *= shape[i].extent;
+        } else {
+            shape[i].min = 0;
+            shape[i].extent = 1;
+            shape[i].stride = 0;
+        }
+    }
+    uint8_t *dst = mem;
+    for (int32_t i3 = shape[3].min; i3 < shape[3].min + shape[3].extent; i3++) {
+        for (int32_t i2 = shape[2].min; i2 < shape[2].min + shape[2].extent; i2++) {
+            for (int32_t i1 = shape[1].min; i1 < shape[1].min + shape[1].extent; i1++) {
+                int idx[] = {shape[0].min, i1, i2, i3};
+                const uint8_t *src = buf->address_of(idx);
+                if (shape[0].stride == 1) {
+                    memcpy(dst, src, shape[0].extent * bytes_per_element);
+                    dst += shape[0].extent * bytes_per_element;
+                } else {
+                    for (int32_t i0 = 0; i0 < shape[0].extent; i0++) {
+                        memcpy(dst, src, bytes_per_element);
+                        src += shape[0].stride * bytes_per_element;
+                        dst += bytes_per_element;
+                    }
+                }
+            }
+        }
+    }
+
+    ScopedMutexLock lock(&s->lock);
+    if (!s->writer_running) {
+        if (s->writer) {
+            // The last writer has finished, or is about to.
+            halide_join_thread(s->writer);
+        }
+        s->writer = halide_spawn_thread(debug_to_file_writer, NULL);
+        if (!s->writer) {
+            s->pending_bytes -= size;
+            free(mem);
+            return false;
+        }
+        s->writer_running = true;
+    }
+    if (s->tail) {
+        s->tail->next = job;
+    } else {
+        s->head = job;
+    }
+    s->tail = job;
+    return true;
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+extern "C" {
+
+WEAK int32_t halide_debug_to_file(void *user_context, const char *filename,
+                                  int32_t type_code, struct halide_buffer_t *buf) {
+
+    if (buf->dimensions > 4) {
+        halide_error(user_context, "Can't debug_to_file a Func with more than four dimensions\n");
+        return -1;
+    }
+
+    halide_copy_to_host(user_context, buf);
+
+    if (debug_to_file_enqueue(filename, type_code, buf)) {
+        return 0;
+    }
+    return write_debug_image(user_context, filename, type_code, buf);
+}
+
+WEAK int64_t halide_set_debug_to_file_async(int64_t max_pending_bytes) {
+    debug_to_file_state *s = &debug_to_file_async_state;
+    ScopedMutexLock lock(&s->lock);
+    debug_to_file_init_already_locked();
+    int64_t old = s->max_pending_bytes;
+    s->max_pending_bytes = max_pending_bytes;
+    return old;
+}
+
+WEAK int halide_debug_to_file_wait(void *user_context) {
+    debug_to_file_state *s = &debug_to_file_async_state;
+    while (true) {
+        halide_thread *writer;
+        {
+            ScopedMutexLock lock(&s->lock);
+            writer = s->writer;
+            s->writer = NULL;
+            if (!writer) {
+                int32_t error = s->error;
+                s->error = 0;
+                return error;
+            }
+        }
+        // Anything queued while this waits either goes to this
+        // writer, or spawns another, which the next iteration waits
+        // for.
+        halide_join_thread(writer);
+    }
+}
+
+}
+
+namespace {
+__attribute__((destructor))
+WEAK void halide_debug_to_file_shutdown() {
+    halide_debug_to_file_wait(NULL);
+}
+}
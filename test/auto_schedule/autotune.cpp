@@ -0,0 +1,81 @@
+#include "Halide.h"
+#include "halide_autotune.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+int main(int argc, char **argv) {
+    int W = 1024;
+    int H = 1024;
+
+    Buffer<float> input(W + 2, H + 2);
+    for (int y = 0; y < input.height(); y++) {
+        for (int x = 0; x < input.width(); x++) {
+            input(x, y) = rand() & 0xfff;
+        }
+    }
+
+    Var x("x"), y("y");
+    auto make_pipeline = [&]() {
+        Func blur_x("blur_x"), blur_y("blur_y");
+        blur_x(x, y) = (input(x, y) + input(x + 1, y) + input(x + 2, y)) / 3;
+        blur_y(x, y) = (blur_x(x, y) + blur_x(x, y + 1) + blur_x(x, y + 2)) / 3;
+
+        // Provide estimates on the pipeline output
+        blur_y.estimate(x, 0, W).estimate(y, 0, H);
+        return Pipeline(blur_y);
+    };
+
+    Buffer<float> out(W, H);
+    auto run = [&](Pipeline p) {
+        p.realize(out);
+        out.device_sync();
+    };
+
+    Target target = get_jit_target_from_environment();
+
+    AutotuneConfig config;
+    config.generations = 2;
+    config.population = 3;
+    config.benchmark_config.min_time = 0.01;
+    AutotuneResult result = autotune(make_pipeline, run, target, config);
+
+    printf("Best of %d schedules: %f ms with MachineParams %s\n",
+           result.schedules_measured, result.wall_time * 1e3,
+           result.params.to_string().c_str());
+    printf("%s\n", result.schedule.c_str());
+
+    if (result.schedules_measured < 1 || result.schedule.empty()) {
+        printf("The search didn't measure any schedules\n");
+        return -1;
+    }
+
+    // The best MachineParams reproduce the best schedule.
+    Pipeline p = make_pipeline();
+    std::string schedule = p.auto_schedule(target, result.params);
+    if (schedule != result.schedule) {
+        printf("Auto-scheduling with the best MachineParams gave a different schedule:\n%s\n",
+               schedule.c_str());
+        return -1;
+    }
+
+    run(p);
+    out.copy_to_host();
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            float bx[3];
+            for (int i = 0; i < 3; i++) {
+                bx[i] = (input(x, y + i) + input(x + 1, y + i) + input(x + 2, y + i)) / 3;
+            }
+            float correct = (bx[0] + bx[1] + bx[2]) / 3;
+            if (std::abs(out(x, y) - correct) > 0.01f) {
+                printf("out(%d, %d) = %f instead of %f\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    int W = 2048;
+    int H = 2048;
+    const int stages = 4;
+
+    Buffer<float> input(W + 2 * stages, H + 2 * stages);
+    for (int y = 0; y < input.height(); y++) {
+        for (int x = 0; x < input.width(); x++) {
+            input(x, y) = rand() & 0xfff;
+        }
+    }
+
+    // A deep stencil pipeline, whose intermediates for a tile don't fit in
+    // the smaller caches.
+    Var x("x"), y("y");
+    std::vector<Func> blur(stages + 1);
+    blur[0](x, y) = input(x, y);
+    for (int s = 1; s <= stages; s++) {
+        Func bx("blur_x_" + std::to_string(s));
+        bx(x, y) = (blur[s - 1](x, y) + blur[s - 1](x + 1, y) + blur[s - 1](x + 2, y)) / 3;
+        blur[s] = Func("blur_y_" + std::to_string(s));
+        blur[s](x, y) = (bx(x, y) + bx(x, y + 1) + bx(x, y + 2)) / 3;
+    }
+    Func out = blur[stages];
+
+    // Provide estimates on the pipeline output
+    out.estimate(x, 0, W).estimate(y, 0, H);
+
+    // Auto-schedule the pipeline for a machine with 32KB of L1 and 256KB of L2
+    Target target = get_jit_target_from_environment();
+    MachineParams params = MachineParams::generic();
+    params.inner_cache_sizes = {32 * 1024, 256 * 1024};
+    Pipeline p(out);
+    std::string schedule = p.auto_schedule(target, params);
+    printf("%s\n", schedule.c_str());
+
+    if (schedule.find("// MachineParams: " + params.to_string() + "\n") == std::string::npos ||
+        MachineParams(params.to_string()).to_string() != params.to_string()) {
+        printf("The MachineParams don't round-trip through their string form\n");
+        return -1;
+    }
+
+    if (!target.has_gpu_feature() && schedule.find("store_at") == std::string::npos) {
+        printf("The members of the groups should have been computed in strips of the tiles\n");
+        return -1;
+    }
+
+    // Inspect the schedule
+    out.print_loop_nest();
+
+    // Run the schedule
+    Buffer<float> result = p.realize(W, H);
+
+    // Compute the reference with the default schedule
+    std::vector<Buffer<float>> ref(stages + 1);
+    ref[0] = input;
+    for (int s = 1; s <= stages; s++) {
+        int w = W + 2 * (stages - s), h = H + 2 * (stages - s);
+        Buffer<float> bx(w, h + 2);
+        ref[s] = Buffer<float>(w, h);
+        for (int yy = 0; yy < h + 2; yy++) {
+            for (int xx = 0; xx < w; xx++) {
+                bx(xx, yy) = (ref[s - 1](xx, yy) + ref[s - 1](xx + 1, yy) + ref[s - 1](xx + 2, yy)) / 3;
+            }
+        }
+        for (int yy = 0; yy < h; yy++) {
+            for (int xx = 0; xx < w; xx++) {
+                ref[s](xx, yy) = (bx(xx, yy) + bx(xx, yy + 1) + bx(xx, yy + 2)) / 3;
+            }
+        }
+    }
+
+    for (int yy = 0; yy < H; yy++) {
+        for (int xx = 0; xx < W; xx++) {
+            float correct = ref[stages](xx, yy);
+            if (std::abs(result(xx, yy) - correct) > 0.01f) {
+                printf("out(%d, %d) = %f instead of %f\n", xx, yy, result(xx, yy), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
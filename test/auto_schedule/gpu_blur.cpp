@@ -0,0 +1,60 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (!target.has_gpu_feature()) {
+        printf("Not running test because no gpu target enabled\n");
+        return 0;
+    }
+
+    int W = 1536;
+    int H = 1024;
+    Buffer<float> input(W + 2, H + 2);
+
+    for (int y = 0; y < input.height(); y++) {
+        for (int x = 0; x < input.width(); x++) {
+            input(x, y) = rand() & 0xfff;
+        }
+    }
+
+    // A separable blur, where the vertical pass should be grouped with the
+    // horizontal one and staged in shared memory.
+    Var x("x"), y("y");
+    Func blur_x("blur_x"), blur_y("blur_y");
+    blur_x(x, y) = (input(x, y) + input(x + 1, y) + input(x + 2, y)) / 3;
+    blur_y(x, y) = (blur_x(x, y) + blur_x(x, y + 1) + blur_x(x, y + 2)) / 3;
+
+    // Provide estimates on the pipeline output
+    blur_y.estimate(x, 0, W).estimate(y, 0, H);
+
+    // Auto-schedule the pipeline
+    Pipeline p(blur_y);
+    p.auto_schedule(target);
+
+    // Inspect the schedule
+    blur_y.print_loop_nest();
+
+    // Run the schedule
+    Buffer<float> out = p.realize(W, H);
+    out.copy_to_host();
+
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            float bx[3];
+            for (int i = 0; i < 3; i++) {
+                bx[i] = (input(x, y + i) + input(x + 1, y + i) + input(x + 2, y + i)) / 3;
+            }
+            float correct = (bx[0] + bx[1] + bx[2]) / 3;
+            if (std::abs(out(x, y) - correct) > 0.01f) {
+                printf("out(%d, %d) = %f instead of %f\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
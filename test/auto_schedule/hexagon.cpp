@@ -0,0 +1,55 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    // Only the schedules are generated, so this doesn't need a Hexagon
+    // device.
+    Target target("arm-64-android-hvx_128");
+
+    ImageParam input(UInt(8), 2, "input");
+    input.dim(0).set_bounds_estimate(0, 1920);
+    input.dim(1).set_bounds_estimate(0, 1080);
+
+    Var x("x"), y("y");
+
+    // An integer blur, which should be offloaded and vectorized with
+    // 128-byte HVX vectors.
+    {
+        Func in = BoundaryConditions::repeat_edge(input);
+        Func blur_x("blur_x"), blur_y("blur_y");
+        blur_x(x, y) = (cast<uint16_t>(in(x - 1, y)) + in(x, y) + in(x + 1, y));
+        blur_y(x, y) = cast<uint8_t>((blur_x(x, y - 1) + blur_x(x, y) + blur_x(x, y + 1)) / 9);
+        blur_y.estimate(x, 0, 1920).estimate(y, 0, 1080);
+
+        std::string schedule = Pipeline(blur_y).auto_schedule(target);
+        printf("%s\n", schedule.c_str());
+        if (schedule.find("hexagon()") == std::string::npos) {
+            printf("The integer pipeline should have been offloaded to Hexagon\n");
+            return -1;
+        }
+        if (schedule.find("_vi, 128)") == std::string::npos) {
+            printf("The integer pipeline should have been vectorized with HVX vectors\n");
+            return -1;
+        }
+    }
+
+    // A floating point pipeline, which HVX can't vectorize, stays on the host.
+    {
+        Func in = BoundaryConditions::repeat_edge(input);
+        Func scaled("scaled");
+        scaled(x, y) = sqrt(cast<float>(in(x, y))) * 0.5f;
+        scaled.estimate(x, 0, 1920).estimate(y, 0, 1080);
+
+        std::string schedule = Pipeline(scaled).auto_schedule(target);
+        printf("%s\n", schedule.c_str());
+        if (schedule.find("hexagon()") != std::string::npos) {
+            printf("The floating point pipeline shouldn't have been offloaded to Hexagon\n");
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
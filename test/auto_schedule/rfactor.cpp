@@ -0,0 +1,70 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    const int N = 1 << 22;
+    Buffer<int> input(N, 4);
+    for (int y = 0; y < input.height(); y++) {
+        for (int x = 0; x < input.width(); x++) {
+            input(x, y) = (rand() & 0xff) - 128;
+        }
+    }
+
+    // Reductions with little or no parallelism along their pure dimensions,
+    // which should be split into parallel partial reductions.
+    Var x("x");
+    RDom r(0, N, "r");
+
+    Func total("total");
+    total() = 0;
+    total() += input(r, 0) * 2 + 1;
+
+    Func peak("peak");
+    peak(x) = std::numeric_limits<int>::min();
+    peak(x) = max(peak(x), input(r, x));
+
+    // Provide estimates on the pipeline outputs
+    peak.estimate(x, 0, 4);
+
+    Target target = get_jit_target_from_environment();
+    Pipeline p_total(total), p_peak(peak);
+    std::string schedule = p_total.auto_schedule(target) + p_peak.auto_schedule(target);
+    printf("%s\n", schedule.c_str());
+
+    if (!target.has_gpu_feature() && schedule.find("rfactor") == std::string::npos) {
+        printf("The reductions should have been rfactored\n");
+        return -1;
+    }
+
+    // Inspect the schedule
+    total.print_loop_nest();
+    peak.print_loop_nest();
+
+    // Run the schedule
+    Buffer<int> total_out = p_total.realize();
+    Buffer<int> peak_out = p_peak.realize(4);
+
+    int correct_total = 0;
+    for (int i = 0; i < N; i++) {
+        correct_total += input(i, 0) * 2 + 1;
+    }
+    if (total_out() != correct_total) {
+        printf("total = %d instead of %d\n", total_out(), correct_total);
+        return -1;
+    }
+    for (int y = 0; y < 4; y++) {
+        int correct_peak = std::numeric_limits<int>::min();
+        for (int i = 0; i < N; i++) {
+            correct_peak = std::max(correct_peak, input(i, y));
+        }
+        if (peak_out(y) != correct_peak) {
+            printf("peak(%d) = %d instead of %d\n", y, peak_out(y), correct_peak);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
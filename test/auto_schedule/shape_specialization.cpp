@@ -0,0 +1,61 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    int W = 1920;
+    int H = 1080;
+
+    Buffer<float> input(W + 2, H + 2);
+    for (int y = 0; y < input.height(); y++) {
+        for (int x = 0; x < input.width(); x++) {
+            input(x, y) = rand() & 0xfff;
+        }
+    }
+
+    Var x("x"), y("y");
+    Func blur_x("blur_x"), blur_y("blur_y");
+    blur_x(x, y) = (input(x, y) + input(x + 1, y) + input(x + 2, y)) / 3;
+    blur_y(x, y) = (blur_x(x, y) + blur_x(x, y + 1) + blur_x(x, y + 2)) / 3;
+
+    // Provide estimates on the pipeline output, for full frames, and
+    // schedule it for thumbnails as well.
+    blur_y.estimate(x, 0, W).estimate(y, 0, H);
+
+    Target target = get_jit_target_from_environment();
+    Pipeline p(blur_y);
+    std::string schedule = p.auto_schedule(target, MachineParams::generic(), {{{16, 16}}});
+    printf("%s\n", schedule.c_str());
+
+    if (!target.has_gpu_feature() &&
+        schedule.find(".specialize(blur_y.output_buffer().dim(0).extent()") == std::string::npos) {
+        printf("The schedule should have been specialized for thumbnails\n");
+        return -1;
+    }
+
+    // Inspect the schedule
+    blur_y.print_loop_nest();
+
+    // Run the schedule on both classes of shapes
+    for (int size : {16, 1024}) {
+        int w = size * W / 1024, h = size * H / 1024;
+        Buffer<float> out = p.realize(w, h);
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                float bx[3];
+                for (int i = 0; i < 3; i++) {
+                    bx[i] = (input(x, y + i) + input(x + 1, y + i) + input(x + 2, y + i)) / 3;
+                }
+                float correct = (bx[0] + bx[1] + bx[2]) / 3;
+                if (std::abs(out(x, y) - correct) > 0.01f) {
+                    printf("out(%d, %d) = %f instead of %f\n", x, y, out(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "Halide.h"
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+
+using namespace Halide;
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+// The last scanline the producer has started, and whether the consumer
+// ever gave up waiting for the producer to get ahead of it.
+std::atomic<int> rows_started(-1);
+std::atomic<bool> timed_out(false);
+
+extern "C" DLLEXPORT int start_row(int y) {
+    int old = rows_started.load();
+    while (old < y && !rows_started.compare_exchange_weak(old, y)) {
+    }
+    return y;
+}
+HalideExtern_1(int, start_row, int);
+
+// Wait until the producer has started scanline y. Unless the producer
+// runs concurrently with the consumer, it can't get ahead of it.
+extern "C" DLLEXPORT int wait_for_row(int y) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (rows_started.load() < y) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            timed_out = true;
+            break;
+        }
+        std::this_thread::yield();
+    }
+    return 0;
+}
+HalideExtern_1(int, wait_for_row, int);
+
+int check(const Buffer<int> &out, int (*correct)(int, int)) {
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            if (out(x, y) != correct(x, y)) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct(x, y));
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Var x, y;
+
+    {
+        // A producer computed per scanline of its consumer, running
+        // concurrently with it.
+        Func f, g;
+        f(x, y) = x + y;
+        g(x, y) = f(x, y) * 2;
+
+        f.compute_at(g, y).store_root().async();
+
+        Buffer<int> out = g.realize(64, 64);
+        if (check(out, [](int x, int y) { return (x + y) * 2; }) != 0) {
+            return -1;
+        }
+    }
+
+    {
+        // A sliding window over folded storage. The producer can
+        // only run one scanline ahead of the consumer.
+        Func f, g;
+        f(x, y) = x * y;
+        g(x, y) = f(x, y - 1) + f(x, y) + f(x, y + 1);
+
+        f.compute_at(g, y).store_root().fold_storage(y, 4).async();
+
+        Buffer<int> out = g.realize(64, 64);
+        if (check(out, [](int x, int y) { return x * (y - 1) + x * y + x * (y + 1); }) != 0) {
+            return -1;
+        }
+    }
+
+    {
+        // An async producer in a parallel loop, with its own input.
+        Func h, f, g;
+        Var yo, yi;
+        h(x, y) = x - y;
+        f(x, y) = h(x, y) + 1;
+        g(x, y) = f(x, y) + f(x + 1, y);
+
+        g.split(y, yo, yi, 8).parallel(yo);
+        h.compute_at(f, y);
+        f.compute_at(g, yi).store_at(g, yo).async();
+
+        Buffer<int> out = g.realize(64, 64);
+        if (check(out, [](int x, int y) { return (x - y + 1) + (x + 1 - y + 1); }) != 0) {
+            return -1;
+        }
+    }
+
+    {
+        // Check that the producer really does run ahead of the
+        // consumer: each scanline of the consumer waits for the
+        // producer to start the one after next.
+        Func f, g;
+        f(x, y) = start_row(y) + x;
+        g(x, y) = f(x, y) + wait_for_row(min(y + 2, 63));
+
+        f.compute_at(g, y).store_root().async();
+
+        Buffer<int> out = g.realize(64, 64);
+        if (check(out, [](int x, int y) { return x + y; }) != 0) {
+            return -1;
+        }
+        if (timed_out) {
+            printf("The async producer never got ahead of its consumer\n");
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
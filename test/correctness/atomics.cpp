@@ -0,0 +1,92 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    const int W = 256, H = 256, bins = 64;
+
+    Buffer<uint8_t> im(W, H);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            im(x, y) = (uint8_t)((x * 17 + y * 31 + (x * y) % 7) % bins);
+        }
+    }
+
+    int correct_hist[bins] = {0};
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            correct_hist[im(x, y)]++;
+        }
+    }
+
+    Var x;
+    RDom r(0, W, 0, H);
+
+    {
+        // An integer histogram, computed in parallel over rows of the
+        // input. This uses a native atomic add.
+        Func hist;
+        hist(x) = 0;
+        hist(clamp(cast<int>(im(r.x, r.y)), 0, bins - 1)) += 1;
+
+        hist.update().atomic().parallel(r.y);
+
+        Buffer<int> out = hist.realize(bins);
+        for (int i = 0; i < bins; i++) {
+            if (out(i) != correct_hist[i]) {
+                printf("hist(%d) = %d instead of %d\n", i, out(i), correct_hist[i]);
+                return -1;
+            }
+        }
+    }
+
+    {
+        // The same histogram in floating point. There are no native
+        // atomic floating-point adds, so this uses a compare-and-swap
+        // loop. The counts are small enough to be exact.
+        Func hist;
+        hist(x) = 0.0f;
+        hist(clamp(cast<int>(im(r.x, r.y)), 0, bins - 1)) += 1.0f;
+
+        hist.update().atomic().parallel(r.y);
+
+        Buffer<float> out = hist.realize(bins);
+        for (int i = 0; i < bins; i++) {
+            if (out(i) != (float)correct_hist[i]) {
+                printf("float hist(%d) = %f instead of %d\n", i, out(i), correct_hist[i]);
+                return -1;
+            }
+        }
+    }
+
+    {
+        // A vectorized scatter with a max reduction. Lanes of the
+        // vector may collide, and are done one at a time.
+        Func m;
+        m(x) = 0;
+        m(clamp(cast<int>(im(r.x, r.y)), 0, bins - 1)) = max(m(clamp(cast<int>(im(r.x, r.y)), 0, bins - 1)),
+                                                             r.x + r.y);
+
+        RVar rxo, rxi;
+        m.update().atomic().split(r.x, rxo, rxi, 8).vectorize(rxi).parallel(r.y);
+
+        int correct_max[bins] = {0};
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                correct_max[im(x, y)] = std::max(correct_max[im(x, y)], x + y);
+            }
+        }
+
+        Buffer<int> out = m.realize(bins);
+        for (int i = 0; i < bins; i++) {
+            if (out(i) != correct_max[i]) {
+                printf("max(%d) = %d instead of %d\n", i, out(i), correct_max[i]);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
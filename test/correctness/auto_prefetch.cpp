@@ -0,0 +1,75 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Count the prefetches in the lowered code.
+int prefetches = 0;
+class CountPrefetches : public IRMutator2 {
+    using IRMutator2::visit;
+
+    Expr visit(const Call *op) override {
+        if (op->is_intrinsic(Call::prefetch)) {
+            prefetches++;
+        }
+        return IRMutator2::visit(op);
+    }
+};
+
+bool run(bool auto_prefetch, const Buffer<float> &input) {
+    Var x, y, xi;
+    Func transpose, unit_stride;
+
+    // The inner loop of the transpose walks down a column of the
+    // input, which the hardware prefetcher doesn't follow.
+    transpose(x, y) = input(y, x);
+    transpose.split(x, x, xi, 8).vectorize(xi);
+
+    Target t = get_jit_target_from_environment();
+    if (auto_prefetch) {
+        t.set_feature(Target::AutoPrefetch);
+    }
+
+    prefetches = 0;
+    transpose.add_custom_lowering_pass(new CountPrefetches);
+    Buffer<float> out = transpose.realize(input.height(), input.width(), t);
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            if (out(x, y) != input(y, x)) {
+                printf("out(%d, %d) = %f instead of %f\n", x, y, out(x, y), input(y, x));
+                return false;
+            }
+        }
+    }
+
+    bool expect_prefetches = auto_prefetch && (t.arch == Target::X86 || t.arch == Target::ARM);
+    if ((prefetches > 0) != expect_prefetches) {
+        printf("%d prefetches with auto_prefetch %s\n", prefetches, auto_prefetch ? "on" : "off");
+        return false;
+    }
+
+    // Walking along rows needs no prefetches.
+    Var x2, y2;
+    unit_stride(x2, y2) = input(x2, y2) * 2;
+    prefetches = 0;
+    unit_stride.add_custom_lowering_pass(new CountPrefetches);
+    unit_stride.realize(input.width(), input.height(), t);
+    if (prefetches > 0) {
+        printf("%d prefetches of a unit-stride load\n", prefetches);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    Buffer<float> input(256, 256);
+    input.for_each_element([&](int x, int y) { input(x, y) = x + y * 256; });
+
+    if (!run(false, input) || !run(true, input)) {
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <string>
+
+using namespace Halide;
+
+std::string last_error;
+void my_error(void *ctx, const char *msg) {
+    last_error = msg;
+}
+
+int main(int argc, char **argv) {
+    // The checks of the arguments are tested in one branch, but a
+    // failure should still report the particular check that failed.
+    ImageParam in(Int(32), 2);
+    Param<int> scale;
+    scale.set_range(1, 8);
+    Var x, y;
+    Func f;
+    f(x, y) = in(x, y) * scale;
+    in.dim(0).set_stride(1);
+    f.set_error_handler(&my_error);
+
+    Buffer<int> input(64, 64);
+    input.fill(3);
+    in.set(input);
+    scale.set(2);
+
+    Buffer<int> out = f.realize(64, 64);
+    if (!last_error.empty() || out(10, 10) != 6) {
+        printf("Valid call failed: %s\n", last_error.c_str());
+        return -1;
+    }
+
+    struct {
+        int width, height, scale;
+        const char *expected;
+    } failures[] = {
+        // Each argument is checked, in turn.
+        {32, 64, 2, "is accessed at 63, which is beyond the max (31) in dimension 0"},
+        {64, 32, 2, "is accessed at 63, which is beyond the max (31) in dimension 1"},
+        {64, 64, 9, "but must be at most 8"},
+    };
+    for (auto &fail : failures) {
+        Buffer<int> small(fail.width, fail.height);
+        in.set(small);
+        scale.set(fail.scale);
+        last_error.clear();
+        f.realize(64, 64);
+        if (last_error.find(fail.expected) == std::string::npos) {
+            printf("Expected an error containing \"%s\", got \"%s\"\n",
+                   fail.expected, last_error.c_str());
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
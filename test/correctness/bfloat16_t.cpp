@@ -0,0 +1,78 @@
+#include "Halide.h"
+#include <cmath>
+#include <stdio.h>
+
+using namespace Halide;
+
+// bfloat16 arithmetic is done in float and rounded back to bfloat16,
+// so it should match doing the same thing on the host.
+int main(int argc, char **argv) {
+    // Conversions round to nearest, with ties to even.
+    if (bfloat16_t(1.0f).to_bits() != 0x3f80 ||
+        bfloat16_t(1.00390625f).to_bits() != 0x3f80 ||
+        bfloat16_t(1.01171875f).to_bits() != 0x3f82 ||
+        (float)bfloat16_t::make_from_bits(0xc040) != -3.0f ||
+        !std::isnan((float)bfloat16_t(NAN))) {
+        printf("Conversions to and from bfloat16 are wrong\n");
+        return -1;
+    }
+
+    const int N = 1024;
+    Buffer<bfloat16_t> a(N), b(N), c(N);
+    for (int i = 0; i < N; i++) {
+        a(i) = bfloat16_t((i - N / 2) / 7.0f);
+        b(i) = bfloat16_t(1.0f + (i % 13) / 3.0f);
+        c(i) = bfloat16_t(i * 1000.0f);
+    }
+
+    Var x;
+    Func f;
+    Expr ax = a(x), bx = b(x), cx = c(x);
+    f(x) = Tuple(std::vector<Expr>{ax * bx + cx,
+                                   max(ax, bx) - bfloat16_t(0.25f),
+                                   select(ax < bx, ax, cx),
+                                   cast<float>(ax) / cast<float>(bx),
+                                   cast<int>(cx),
+                                   cast(BFloat(16), x * 3 + 1)});
+    f.vectorize(x, 16);
+    Realization r = f.realize(N);
+    Buffer<bfloat16_t> madd = r[0], maxed = r[1], selected = r[2], from_int = r[5];
+    Buffer<float> divided = r[3];
+    Buffer<int> to_int = r[4];
+
+    for (int i = 0; i < N; i++) {
+        float fa = (float)a(i), fb = (float)b(i), fc = (float)c(i);
+        // a * b is rounded to bfloat16 before c is added.
+        bfloat16_t correct_madd((float)bfloat16_t(fa * fb) + fc);
+        bfloat16_t correct_max((float)bfloat16_t(std::max(fa, fb)) - 0.25f);
+        bfloat16_t correct_select = fa < fb ? a(i) : c(i);
+        bfloat16_t correct_from_int((float)(i * 3 + 1));
+        if (madd(i) != correct_madd) {
+            printf("a * b + c at %d: %f instead of %f\n", i, (float)madd(i), (float)correct_madd);
+            return -1;
+        }
+        if (maxed(i) != correct_max) {
+            printf("max(a, b) - 0.25 at %d: %f instead of %f\n", i, (float)maxed(i), (float)correct_max);
+            return -1;
+        }
+        if (selected(i) != correct_select) {
+            printf("select(a < b, a, c) at %d: %f instead of %f\n", i, (float)selected(i), (float)correct_select);
+            return -1;
+        }
+        if (divided(i) != fa / fb) {
+            printf("a / b at %d: %f instead of %f\n", i, divided(i), fa / fb);
+            return -1;
+        }
+        if (to_int(i) != (int)fc) {
+            printf("int(c) at %d: %d instead of %d\n", i, to_int(i), (int)fc);
+            return -1;
+        }
+        if (from_int(i) != correct_from_int) {
+            printf("bfloat16(3x + 1) at %d: %f instead of %f\n", i, (float)from_int(i), (float)correct_from_int);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+// A 7x7 box filter over small tiles of a boundary condition, which
+// is either inlined or padded once per tile.
+Buffer<int> blur(Func bounded, bool pad, const Target &t) {
+    Var x("x"), y("y"), xo("xo"), yo("yo"), xi("xi"), yi("yi");
+    RDom r(-3, 7, -3, 7);
+    Func f("f");
+    f(x, y) = sum(bounded(x + r.x, y + r.y));
+    f.tile(x, y, xo, yo, xi, yi, 16, 16).vectorize(xi, 8);
+    if (pad) {
+        BoundaryConditions::pad_once(bounded, LoopLevel(f, xo), 8);
+    }
+    Buffer<int> out(50, 40);
+    out.set_min(-10, -10);
+    f.realize(out, t);
+    return out;
+}
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment();
+
+    Buffer<int> input(37, 29);
+    for (int y = 0; y < input.height(); y++) {
+        for (int x = 0; x < input.width(); x++) {
+            input(x, y) = (x * 13 + y * 7) % 23;
+        }
+    }
+
+    for (int i = 0; i < 3; i++) {
+        Buffer<int> results[2];
+        for (int pad = 0; pad < 2; pad++) {
+            Func bounded;
+            if (i == 0) {
+                bounded = BoundaryConditions::repeat_edge(input);
+            } else if (i == 1) {
+                bounded = BoundaryConditions::mirror_image(input);
+            } else {
+                bounded = BoundaryConditions::constant_exterior(input, 5);
+            }
+            results[pad] = blur(bounded, pad != 0, t);
+        }
+
+        for (int y = results[0].dim(1).min(); y <= results[0].dim(1).max(); y++) {
+            for (int x = results[0].dim(0).min(); x <= results[0].dim(0).max(); x++) {
+                if (results[0](x, y) != results[1](x, y)) {
+                    printf("Boundary condition %d: padded result(%d, %d) = %d instead of %d\n",
+                           i, x, y, results[1](x, y), results[0](x, y));
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
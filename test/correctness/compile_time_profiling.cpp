@@ -0,0 +1,36 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <sstream>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Func f, g;
+    Var x, y;
+    f(x, y) = x + y;
+    g(x, y) = f(x, y) * 2 + f(x + 1, y);
+    f.compute_root().vectorize(x, 8);
+    g.vectorize(x, 8).parallel(y);
+
+    Internal::set_compile_time_profiling(true);
+    g.compile_jit();
+    Internal::set_compile_time_profiling(false);
+
+    std::ostringstream table, json;
+    Internal::write_compile_time_report(table, false);
+    if (table.str().find("Vectorizing") == std::string::npos ||
+        table.str().find("Optimizing llvm bitcode") == std::string::npos) {
+        printf("Missing phases in the compile time report:\n%s\n", table.str().c_str());
+        return -1;
+    }
+
+    // The report is cleared once written.
+    Internal::write_compile_time_report(json, true);
+    if (json.str() != "[\n]\n") {
+        printf("The compile time report was not cleared:\n%s\n", json.str().c_str());
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
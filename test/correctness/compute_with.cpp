@@ -0,0 +1,97 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int num_interleavings = 0;
+int last_producer = -1;
+
+// Count how often consecutive stores switch between the two Funcs,
+// which only happens many times if their loop nests are fused.
+int my_trace(void *user_context, const halide_trace_event_t *e) {
+    if (e->event == halide_trace_store) {
+        int id = e->func[0] == 'a' ? 0 : 1;
+        if (last_producer != -1 && id != last_producer) {
+            num_interleavings++;
+        }
+        last_producer = id;
+    }
+    return 0;
+}
+
+int check(const Buffer<int> &out, int dx, int dy) {
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            int correct = (x + y * 2) * 3 + (x + dx) * (y + dy);
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Var x("x"), y("y"), yo("yo"), yi("yi");
+
+    {
+        // Two Funcs with the same shape fused at y.
+        Func a("a"), b("b"), out("out");
+        a(x, y) = (x + y * 2) * 3;
+        b(x, y) = x * y;
+        out(x, y) = a(x, y) + b(x, y);
+
+        a.compute_root().trace_stores();
+        b.compute_root().trace_stores();
+        b.compute_with(a, y);
+
+        out.set_custom_trace(&my_trace);
+        Buffer<int> result = out.realize(32, 16);
+        if (check(result, 0, 0) != 0) {
+            return -1;
+        }
+        if (num_interleavings < 16) {
+            printf("The loops over y were not fused: %d interleavings\n", num_interleavings);
+            return -1;
+        }
+    }
+
+    {
+        // Funcs with different required regions, and loops split
+        // the same way, fused at the outer loop.
+        Func a("a"), b("b"), out("out");
+        a(x, y) = (x + y * 2) * 3;
+        b(x, y) = x * y;
+        out(x, y) = a(x, y) + b(x + 3, y + 5);
+
+        a.compute_root().split(y, yo, yi, 4);
+        b.compute_root().split(y, yo, yi, 4);
+        b.compute_with(a, yo);
+
+        Buffer<int> result = out.realize(37, 19);
+        if (check(result, 3, 5) != 0) {
+            return -1;
+        }
+    }
+
+    {
+        // Fusing parallel loops.
+        Func a("a"), b("b"), out("out");
+        a(x, y) = (x + y * 2) * 3;
+        b(x, y) = x * y;
+        out(x, y) = a(x, y) + b(x, y);
+
+        a.compute_root().parallel(y);
+        b.compute_root().parallel(y);
+        b.compute_with(a, y);
+
+        Buffer<int> result = out.realize(64, 64);
+        if (check(result, 0, 0) != 0) {
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
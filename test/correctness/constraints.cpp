@@ -78,6 +78,45 @@ int main(int argc, char **argv) {
 
     Internal::assert_file_exists(assembly_file);
 
+    // Promise that the rows of an input start on aligned boundaries.
+    ImageParam rows(UInt(8), 2);
+    rows.set_host_alignment(16);
+    rows.dim(0).set_min(0);
+    rows.dim(1).set_stride_multiple(16);
+    Func k;
+    k(x, y) = rows(x, y) + 1;
+    k.vectorize(x, 16);
+    k.set_error_handler(my_error_handler);
+
+    Buffer<uint8_t> aligned_rows(48, 10), unaligned_rows(40, 10);
+    aligned_rows.fill(3);
+    unaligned_rows.fill(3);
+
+    rows.set(aligned_rows);
+    error_occurred = false;
+    Buffer<uint8_t> k_out = k.realize(32, 10);
+    if (error_occurred) {
+        printf("Error incorrectly raised for a stride that is a multiple of 16\n");
+        return -1;
+    }
+    for (int yy = 0; yy < 10; yy++) {
+        for (int xx = 0; xx < 32; xx++) {
+            if (k_out(xx, yy) != 4) {
+                printf("k(%d, %d) = %d instead of 4\n", xx, yy, k_out(xx, yy));
+                return -1;
+            }
+        }
+    }
+
+    // A stride of 40 is not a multiple of 16.
+    rows.set(unaligned_rows);
+    error_occurred = false;
+    k.realize(32, 10);
+    if (!error_occurred) {
+        printf("Error incorrectly not raised for a stride that is not a multiple of 16\n");
+        return -1;
+    }
+
     printf("Success!\n");
     return 0;
 }
@@ -0,0 +1,84 @@
+#include "Halide.h"
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <stdio.h>
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+using namespace Halide;
+
+std::atomic<int> calls;
+std::mutex tiles_lock;
+std::set<std::pair<int, int>> tiles;
+
+// Computes out(x, y) = in(x, y) * 2 + y over whatever region it's given.
+extern "C" DLLEXPORT int double_plus_y(halide_buffer_t *in, halide_buffer_t *out) {
+    if (in->is_bounds_query()) {
+        for (int i = 0; i < 2; i++) {
+            in->dim[i].min = out->dim[i].min;
+            in->dim[i].extent = out->dim[i].extent;
+        }
+        return 0;
+    }
+    calls++;
+    {
+        std::lock_guard<std::mutex> lock(tiles_lock);
+        tiles.insert({out->dim[1].min, out->dim[1].extent});
+    }
+    Runtime::Buffer<int> src(*in), dst(*out);
+    dst.for_each_element([&](int x, int y) { dst(x, y) = src(x, y) * 2 + y; });
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Var x("x"), y("y");
+    Func input("input");
+    input(x, y) = x + y * 10;
+    input.compute_root();
+
+    for (bool parallel : {false, true}) {
+        Func f("f");
+        f.define_extern("double_plus_y", {input}, Int(32), 2);
+        Var fy = f.args()[1], yo, yi;
+        f.compute_root().split(fy, yo, yi, 16);
+        if (parallel) {
+            f.parallel(yo);
+        }
+
+        Func g("g");
+        g(x, y) = f(x, y) + 1;
+
+        calls = 0;
+        tiles.clear();
+        // 100 isn't a multiple of the tile size.
+        Buffer<int> out = g.realize(37, 100);
+        for (int j = 0; j < out.height(); j++) {
+            for (int i = 0; i < out.width(); i++) {
+                int correct = (i + j * 10) * 2 + j + 1;
+                if (out(i, j) != correct) {
+                    printf("out(%d, %d) = %d instead of %d\n", i, j, out(i, j), correct);
+                    return -1;
+                }
+            }
+        }
+
+        // One call per band of 16 rows, with a short final band.
+        if (calls != 7 || tiles.size() != 7 ||
+            *tiles.begin() != std::make_pair(0, 16) ||
+            *tiles.rbegin() != std::make_pair(96, 4)) {
+            printf("Unexpected tiles: %d calls\n", (int)calls);
+            for (auto t : tiles) {
+                printf("  [%d, %d)\n", t.first, t.first + t.second);
+            }
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "Halide.h"
+#include <cmath>
+#include <stdio.h>
+
+using namespace Halide;
+
+// Arithmetic and math functions on float16, which are done natively
+// on targets with fp16 arithmetic, and promoted to float elsewhere.
+int main(int argc, char **argv) {
+    const int N = 1024;
+    Buffer<float16_t> a(N), b(N);
+    for (int i = 0; i < N; i++) {
+        a(i) = float16_t((i - N / 2) / 37.0f);
+        b(i) = float16_t(1.0f + (i % 17) / 16.0f);
+    }
+
+    Var x;
+    Func f;
+    Expr ax = a(x), bx = b(x);
+    f(x) = Tuple(std::vector<Expr>{ax * bx + float16_t(0.5f),
+                                   ax / bx,
+                                   sqrt(bx),
+                                   floor(ax),
+                                   ceil(ax),
+                                   round(ax),
+                                   trunc(ax),
+                                   exp(ax / float16_t(8.0f)),
+                                   sin(ax)});
+    f.vectorize(x, 16);
+    Realization r = f.realize(N);
+
+    // One ulp of float16, relative to the magnitude of the result.
+    auto close = [](float16_t h, float correct, float ulps) {
+        float tolerance = ulps * std::max(std::abs(correct), 1e-3f) / 1024.0f;
+        return std::abs((float)h - correct) <= tolerance;
+    };
+
+    const char *names[] = {"a * b + 0.5", "a / b", "sqrt(b)", "floor(a)", "ceil(a)",
+                           "round(a)", "trunc(a)", "exp(a / 8)", "sin(a)"};
+    for (int i = 0; i < N; i++) {
+        float fa = (float)a(i), fb = (float)b(i);
+        float correct[] = {fa * fb + 0.5f,
+                           fa / fb,
+                           std::sqrt(fb),
+                           std::floor(fa),
+                           std::ceil(fa),
+                           std::nearbyint(fa),
+                           std::trunc(fa),
+                           std::exp(fa / 8),
+                           std::sin(fa)};
+        // The arithmetic may be rounded once or twice, and exp and
+        // sin are computed in float and then rounded. The rest are
+        // exact.
+        float ulps[] = {2, 1, 1, 0, 0, 0, 0, 2, 2};
+        for (int j = 0; j < 9; j++) {
+            Buffer<float16_t> out = r[j];
+            if (!close(out(i), correct[j], ulps[j])) {
+                printf("%s at %d: %f instead of %f\n", names[j], i, (float)out(i), correct[j]);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
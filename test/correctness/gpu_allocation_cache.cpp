@@ -0,0 +1,75 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <string.h>
+
+#include "test/common/gpu_object_lifetime_tracker.h"
+
+using namespace Halide;
+
+Internal::GpuObjectLifetimeTracker tracker;
+int allocations = 0;
+
+void halide_print(void *user_context, const char *str) {
+    if (strstr(str, "cuMemAlloc") || strstr(str, "clCreateBuffer")) {
+        allocations++;
+    }
+    tracker.record_gpu_debug(str);
+}
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (!target.has_feature(Target::CUDA) && !target.has_feature(Target::OpenCL)) {
+        printf("Not running test because neither cuda nor opencl is enabled\n");
+        return 0;
+    }
+
+    Internal::JITHandlers handlers;
+    handlers.custom_print = halide_print;
+    Internal::JITSharedRuntime::set_default_handlers(handlers);
+
+    // We need debug output to count the device allocations.
+    target.set_feature(Target::Debug);
+
+    // A sequence of stages on the device, whose intermediate buffers are
+    // freed as soon as they are no longer needed.
+    Var x, xi;
+    const int stage_count = 6;
+    Func f[stage_count];
+    f[0](x) = x;
+    for (int i = 1; i < stage_count; i++) {
+        f[i](x) = f[i - 1](x) + 1;
+    }
+    for (int i = 0; i < stage_count; i++) {
+        f[i].compute_root().gpu_tile(x, xi, 32);
+    }
+    Func output = f[stage_count - 1];
+    output.set_custom_print(halide_print);
+
+    for (int iter = 0; iter < 4; iter++) {
+        int before = allocations;
+        Buffer<int> result = output.realize(1000, target);
+        result.copy_to_host();
+        for (int i = 0; i < 1000; i++) {
+            if (result(i) != i + stage_count - 1) {
+                printf("result(%d) = %d instead of %d\n", i, result(i), i + stage_count - 1);
+                return -1;
+            }
+        }
+        if (iter > 0 && allocations != before) {
+            printf("Iteration %d allocated %d device buffers instead of reusing the freed ones\n",
+                   iter, allocations - before);
+            return -1;
+        }
+    }
+
+    // Releasing the runtime frees the cached allocations.
+    Internal::JITSharedRuntime::release_all();
+
+    int ret = tracker.validate_gpu_object_lifetime(true /* allow_globals */, false /* allow_none */, 1 /* max_globals */);
+    if (ret != 0) {
+        return ret;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+// The CUDA runtime waits for the last kernel that wrote a buffer before
+// copying it back to the host, rather than for everything on the stream.
+// Check that it waits for the right kernel.
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment();
+    if (!t.has_feature(Target::CUDA)) {
+        printf("Not running test because cuda not enabled\n");
+        return 0;
+    }
+
+    const int W = 256, H = 128;
+    Var x, y, xi, yi;
+
+    // A slow kernel writes one buffer, and then a fast one writes
+    // another, which is copied back first.
+    Func slow("slow"), fast("fast");
+    RDom r(0, 200);
+    slow(x, y) = sum(sqrt(sqrt(cast<float>(x + y + r))));
+    fast(x, y) = cast<float>(x * 2 + y);
+    slow.compute_root().gpu_tile(x, y, xi, yi, 16, 16);
+    fast.compute_root().gpu_tile(x, y, xi, yi, 16, 16);
+    Pipeline p({slow, fast});
+
+    Buffer<float> slow_out(W, H), fast_out(W, H);
+    p.realize({slow_out, fast_out}, t);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            float correct_fast = x * 2 + y;
+            if (fast_out(x, y) != correct_fast) {
+                printf("fast(%d, %d) = %f instead of %f\n", x, y, fast_out(x, y), correct_fast);
+                return -1;
+            }
+            float correct_slow = 0.0f;
+            for (int i = 0; i < 200; i++) {
+                correct_slow += sqrtf(sqrtf((float)(x + y + i)));
+            }
+            if (std::abs(slow_out(x, y) - correct_slow) > 0.01f * correct_slow + 0.01f) {
+                printf("slow(%d, %d) = %f instead of %f\n", x, y, slow_out(x, y), correct_slow);
+                return -1;
+            }
+        }
+    }
+
+    // Two kernels write the same buffer, the second one only part of
+    // it. The copy to the host must wait for the second.
+    Func g("g");
+    RDom box(16, 32, 8, 64);
+    g(x, y) = x + y;
+    g(box.x, box.y) = -1;
+    g.gpu_tile(x, y, xi, yi, 16, 16);
+    g.update().gpu_tile(box.x, box.y, xi, yi, 16, 16);
+
+    for (int i = 0; i < 3; i++) {
+        Buffer<int> out = g.realize(W, H, t);
+        if (out.device_sync() != 0) {
+            printf("device_sync failed\n");
+            return -1;
+        }
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                bool in_box = x >= 16 && x < 48 && y >= 8 && y < 72;
+                int correct = in_box ? -1 : x + y;
+                if (out(x, y) != correct) {
+                    printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+const int W = 64, H = 64;
+
+// Check each row of the host memory of buf is either a or b,
+// depending on whether it lies in [min_row, max_row).
+int check_rows(Buffer<int> &buf, int min_row, int max_row, int a, int b, const char *what) {
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            int correct = (y >= min_row && y < max_row) ? a : b;
+            if (buf(x, y) != correct) {
+                printf("%s: buf(%d, %d) = %d instead of %d\n", what, x, y, buf(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+void set_host(Buffer<int> &buf, int val) {
+    buf.for_each_value([=](int &v) { v = val; });
+}
+
+int main(int argc, char **argv) {
+    Target t(get_jit_target_from_environment());
+    DeviceAPI api;
+    if (t.has_feature(Target::CUDA)) {
+        api = DeviceAPI::CUDA;
+    } else if (t.has_feature(Target::OpenCL)) {
+        api = DeviceAPI::OpenCL;
+    } else {
+        printf("Not running test because neither cuda nor opencl is enabled\n");
+        return 0;
+    }
+    const halide_device_interface_t *interface = get_device_interface_for_device_api(api, t);
+
+    Buffer<int> buf(W, H);
+    halide_buffer_t *raw = buf.raw_buffer();
+
+    // Put zeros on the device, and then ones on the host without
+    // marking it dirty, so we can see what gets copied.
+    set_host(buf, 0);
+    buf.set_host_dirty();
+    if (halide_copy_to_device(nullptr, raw, interface) != 0) {
+        printf("halide_copy_to_device failed\n");
+        return -1;
+    }
+    set_host(buf, 1);
+
+    // Only the dirty rows should be copied to the host.
+    halide_dimension_t rows[] = {{0, W, 1}, {10, 10, W}};
+    if (halide_buffer_set_device_dirty_region(nullptr, raw, rows) != 0 ||
+        halide_copy_to_host(nullptr, raw) != 0) {
+        printf("copying a dirty region to the host failed\n");
+        return -1;
+    }
+    if (buf.device_dirty() ||
+        check_rows(buf, 10, 20, 0, 1, "dirty region to host")) {
+        return -1;
+    }
+
+    // Copy the whole buffer back in two bands.
+    set_host(buf, 1);
+    if (halide_buffer_set_device_dirty_region(nullptr, raw, nullptr) != 0) {
+        printf("halide_buffer_set_device_dirty_region failed\n");
+        return -1;
+    }
+    halide_dimension_t top[] = {{0, W, 1}, {0, 16, W}};
+    if (halide_copy_to_host_region(nullptr, raw, top) != 0) {
+        printf("halide_copy_to_host_region failed\n");
+        return -1;
+    }
+    if (!buf.device_dirty() ||
+        check_rows(buf, 0, 16, 0, 1, "first band to host")) {
+        return -1;
+    }
+    // The remaining dirty region is the rest of the rows, so copying it
+    // doesn't touch the first band.
+    set_host(buf, 2);
+    if (halide_copy_to_host(nullptr, raw) != 0) {
+        printf("halide_copy_to_host failed\n");
+        return -1;
+    }
+    if (buf.device_dirty() ||
+        check_rows(buf, 0, 16, 2, 0, "second band to host")) {
+        return -1;
+    }
+
+    // Only the dirty rows should be copied to the device.
+    set_host(buf, 5);
+    halide_dimension_t more_rows[] = {{0, W, 1}, {30, 10, W}};
+    if (halide_buffer_set_host_dirty_region(nullptr, raw, more_rows) != 0 ||
+        halide_copy_to_device(nullptr, raw, interface) != 0) {
+        printf("copying a dirty region to the device failed\n");
+        return -1;
+    }
+    set_host(buf, 7);
+    buf.set_device_dirty();
+    if (halide_copy_to_host(nullptr, raw) != 0) {
+        printf("halide_copy_to_host failed\n");
+        return -1;
+    }
+    if (check_rows(buf, 30, 40, 5, 0, "dirty region to device")) {
+        return -1;
+    }
+
+    buf.device_free();
+
+    printf("Success!\n");
+    return 0;
+}
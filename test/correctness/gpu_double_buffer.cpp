@@ -0,0 +1,58 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    if (!get_jit_target_from_environment().has_gpu_feature()) {
+        printf("Not running test because no gpu target enabled\n");
+        return 0;
+    }
+
+    const int N = 64;
+    Buffer<int> a(N, N), b(N, N);
+    for (int y = 0; y < N; y++) {
+        for (int x = 0; x < N; x++) {
+            a(x, y) = (x * 3 + y * 7) % 13 - 6;
+            b(x, y) = (x * 5 + y * 11) % 17 - 8;
+        }
+    }
+
+    // A matrix multiply that stages tiles of both inputs in shared
+    // memory. Loading the next tiles overlaps with multiplying the
+    // current ones.
+    Func A, B, C;
+    Var x, y, xi, yi;
+    RVar ro, ri;
+    RDom r(0, N);
+
+    A(x, y) = a(x, y);
+    B(x, y) = b(x, y);
+    C(x, y) = 0;
+    C(x, y) += A(r, y) * B(x, r);
+
+    C.gpu_tile(x, y, xi, yi, 16, 16);
+    C.update()
+        .gpu_tile(x, y, xi, yi, 16, 16)
+        .split(r, ro, ri, 16)
+        .reorder(ri, xi, yi, ro, x, y);
+    A.compute_at(C, ro).store_at(C, x).gpu_threads(x, y).double_buffer();
+    B.compute_at(C, ro).store_at(C, x).gpu_threads(x, y).double_buffer();
+
+    Buffer<int> out = C.realize(N, N);
+    for (int y = 0; y < N; y++) {
+        for (int x = 0; x < N; x++) {
+            int correct = 0;
+            for (int k = 0; k < N; k++) {
+                correct += a(k, y) * b(x, k);
+            }
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
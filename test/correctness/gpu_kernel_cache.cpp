@@ -0,0 +1,75 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Halide;
+
+int loads = 0, stores = 0;
+
+void halide_print(void *user_context, const char *str) {
+    if (strstr(str, "Loaded GPU kernel binary")) {
+        loads++;
+    }
+    if (strstr(str, "Stored GPU kernel binary")) {
+        stores++;
+    }
+}
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (!target.has_feature(Target::CUDA) && !target.has_feature(Target::OpenCL)) {
+        printf("Not running test because neither cuda nor opencl is enabled\n");
+        return 0;
+    }
+
+#ifdef _WIN32
+    printf("Skipping test on windows\n");
+    return 0;
+#else
+    char dir[] = "/tmp/halide_gpu_kernel_cache_XXXXXX";
+    if (!mkdtemp(dir)) {
+        printf("Could not create a temporary directory\n");
+        return -1;
+    }
+    setenv("HL_GPU_KERNEL_CACHE_DIR", dir, 1);
+
+    Internal::JITHandlers handlers;
+    handlers.custom_print = halide_print;
+    Internal::JITSharedRuntime::set_default_handlers(handlers);
+
+    // We need debug output to see the cache being used.
+    target.set_feature(Target::Debug);
+
+    for (int iter = 0; iter < 2; iter++) {
+        Func f;
+        Var x, xi;
+        f(x) = x * 2 + 1;
+        f.gpu_tile(x, xi, 32);
+        f.set_custom_print(halide_print);
+
+        Buffer<int> result = f.realize(1000, target);
+        result.copy_to_host();
+        for (int i = 0; i < 1000; i++) {
+            if (result(i) != i * 2 + 1) {
+                printf("result(%d) = %d instead of %d\n", i, result(i), i * 2 + 1);
+                return -1;
+            }
+        }
+
+        // Start again with a new runtime, as a new process would, so
+        // that the kernels are compiled again on the second iteration.
+        result = Buffer<int>();
+        Internal::JITSharedRuntime::release_all();
+    }
+
+    if (stores != 1 || loads != 1) {
+        printf("The kernels were stored %d times and loaded %d times instead of once each\n",
+               stores, loads);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+#endif
+}
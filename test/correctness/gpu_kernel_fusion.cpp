@@ -0,0 +1,114 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Counts the GPU kernels launched by a pipeline.
+class CountKernels : public IRMutator2 {
+public:
+    int count = 0;
+
+    Stmt mutate(const Stmt &s) override {
+        struct Counter : public IRVisitor {
+            int count = 0;
+            bool in_kernel = false;
+            using IRVisitor::visit;
+            void visit(const For *op) override {
+                if (!in_kernel && CodeGen_GPU_Dev::is_gpu_var(op->name)) {
+                    count++;
+                    in_kernel = true;
+                    IRVisitor::visit(op);
+                    in_kernel = false;
+                } else {
+                    IRVisitor::visit(op);
+                }
+            }
+        } counter;
+        s.accept(&counter);
+        count = counter.count;
+        return s;
+    }
+};
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment();
+    if (!t.has_gpu_feature()) {
+        printf("Not running test because no gpu target enabled\n");
+        return 0;
+    }
+
+    const int W = 256, H = 128;
+    Buffer<float> in(W, H);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            in(x, y) = (float)((x * 7 + y * 13) % 37);
+        }
+    }
+
+    Var x, y, xi, yi;
+
+    // Three pointwise stages with identical GPU schedules are all
+    // computed by a single kernel.
+    {
+        Func f("f"), g("g"), h("h");
+        f(x, y) = in(x, y) * 2.0f;
+        g(x, y) = f(x, y) + 1.0f;
+        h(x, y) = g(x, y) * g(x, y);
+        f.compute_root().gpu_tile(x, y, xi, yi, 16, 16);
+        g.compute_root().gpu_tile(x, y, xi, yi, 16, 16);
+        h.gpu_tile(x, y, xi, yi, 16, 16);
+
+        CountKernels *counter = new CountKernels;
+        h.add_custom_lowering_pass(counter);
+        Buffer<float> out = h.realize(W, H, t.with_feature(Target::GPUKernelFusion));
+
+        if (counter->count != 1) {
+            printf("There were %d kernels instead of 1\n", counter->count);
+            return -1;
+        }
+
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                float g_val = in(x, y) * 2.0f + 1.0f;
+                float correct = g_val * g_val;
+                if (out(x, y) != correct) {
+                    printf("out(%d, %d) = %f instead of %f\n", x, y, out(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // A consumer that reads its producer at a neighboring site needs
+    // values computed by other threads, so the kernels stay separate.
+    {
+        Func f("f"), g("g");
+        f(x, y) = in(x, y) * 2.0f;
+        g(x, y) = f(x, y) + f(min(x + 1, W - 1), y);
+        f.compute_root().gpu_tile(x, y, xi, yi, 16, 16);
+        g.gpu_tile(x, y, xi, yi, 16, 16);
+
+        CountKernels *counter = new CountKernels;
+        g.add_custom_lowering_pass(counter);
+        Buffer<float> out = g.realize(W, H, t.with_feature(Target::GPUKernelFusion));
+
+        if (counter->count != 2) {
+            printf("There were %d kernels instead of 2\n", counter->count);
+            return -1;
+        }
+
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                float correct = in(x, y) * 2.0f + in(std::min(x + 1, W - 1), y) * 2.0f;
+                if (out(x, y) != correct) {
+                    printf("out(%d, %d) = %f instead of %f\n", x, y, out(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    if (!get_jit_target_from_environment().has_gpu_feature()) {
+        printf("Not running test because no gpu target enabled\n");
+        return 0;
+    }
+
+    const int W = 256, H = 64;
+    Buffer<int> in(W, H);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            in(x, y) = (x * 17 + y * 31) % 101 - 50;
+        }
+    }
+
+    Var y;
+    RDom r(0, 32, 0, W / 32);
+    Expr value = in(r.x + r.y * 32, y);
+
+    {
+        // The sum of each row. The lanes of each warp add up their
+        // values with shuffles, and one atomic add per warp updates
+        // the row.
+        Func sum;
+        sum(y) = 0;
+        sum(y) += value;
+        sum.update().atomic().gpu_blocks(y).gpu_lanes(r.x);
+
+        Buffer<int> out = sum.realize(H);
+        for (int j = 0; j < H; j++) {
+            int correct = 0;
+            for (int i = 0; i < W; i++) {
+                correct += in(i, j);
+            }
+            if (out(j) != correct) {
+                printf("sum(%d) = %d instead of %d\n", j, out(j), correct);
+                return -1;
+            }
+        }
+    }
+
+    {
+        // The maximum of each row, over only some of the lanes.
+        Func m;
+        RDom rw(0, 32, 0, W / 32);
+        rw.where(rw.x % 3 != 0);
+        m(y) = -1000;
+        m(y) = max(m(y), in(rw.x + rw.y * 32, y));
+        m.update().atomic().gpu_blocks(y).gpu_lanes(rw.x);
+
+        Buffer<int> out = m.realize(H);
+        for (int j = 0; j < H; j++) {
+            int correct = -1000;
+            for (int i = 0; i < W; i++) {
+                if ((i % 32) % 3 != 0) {
+                    correct = std::max(correct, in(i, j));
+                }
+            }
+            if (out(j) != correct) {
+                printf("max(%d) = %d instead of %d\n", j, out(j), correct);
+                return -1;
+            }
+        }
+    }
+
+    {
+        // A floating point sum, which has no native atomic add on
+        // some backends, so the update is a compare-and-swap loop.
+        Func fsum;
+        fsum(y) = 0.0f;
+        fsum(y) += cast<float>(value) * 0.5f;
+        fsum.update().atomic().gpu_blocks(y).gpu_lanes(r.x);
+
+        Buffer<float> out = fsum.realize(H);
+        for (int j = 0; j < H; j++) {
+            float correct = 0;
+            for (int i = 0; i < W; i++) {
+                correct += in(i, j) * 0.5f;
+            }
+            if (std::abs(out(j) - correct) > 0.01f) {
+                printf("fsum(%d) = %f instead of %f\n", j, out(j), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,44 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Target t(get_jit_target_from_environment());
+    if (!t.has_feature(Target::CUDA)) {
+        printf("Not running test because cuda not enabled\n");
+        return 0;
+    }
+    t.set_feature(Target::CUDAManagedMemory);
+
+    // A pipeline whose intermediates go back and forth between the host
+    // and the GPU, so they are allocated as managed memory, and are
+    // prefetched rather than copied.
+    Func f, g, h, out;
+    Var x, y, xi, yi;
+    f(x, y) = x + y;
+    g(x, y) = f(x, y) * 2 + f(x + 1, y);
+    h(x, y) = g(x, y) - 3;
+    out(x, y) = h(x, y) + h(x, y + 1);
+
+    f.compute_root();
+    g.compute_root().gpu_tile(x, y, xi, yi, 16, 16);
+    h.compute_root();
+    out.gpu_tile(x, y, xi, yi, 16, 16);
+
+    Buffer<int> result = out.realize(256, 256, t);
+    result.copy_to_host();
+    for (int y = 0; y < 256; y++) {
+        for (int x = 0; x < 256; x++) {
+            int h0 = (x + y) * 2 + (x + 1 + y) - 3;
+            int h1 = (x + y + 1) * 2 + (x + y + 2) - 3;
+            if (result(x, y) != h0 + h1) {
+                printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), h0 + h1);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,40 @@
+#include "Halide.h"
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Var x, y, xi, yi;
+
+    // A kernel with a register budget. The launch bounds and the
+    // budget should be passed on to ptxas. This only compiles the
+    // pipeline, so it doesn't need a gpu.
+    Func f("f");
+    f(x, y) = sqrt(cast<float>(x * y));
+    f.gpu_tile(x, y, xi, yi, 16, 8).gpu_max_registers(32);
+
+    Target t = get_host_target().with_feature(Target::CUDA);
+    std::string assembly_file = Internal::get_test_tmp_dir() + "gpu_max_registers.ll";
+    Internal::ensure_no_file_exists(assembly_file);
+    f.compile_to_llvm_assembly(assembly_file, {}, "f", t);
+    Internal::assert_file_exists(assembly_file);
+
+    std::ifstream assembly(assembly_file.c_str());
+    std::stringstream contents;
+    contents << assembly.rdbuf();
+    if (contents.str().find(".maxntid 16, 8, 1") == std::string::npos) {
+        printf("The kernel doesn't have the launch bounds of its block size\n");
+        return -1;
+    }
+    if (contents.str().find(".maxnreg 32") == std::string::npos) {
+        printf("The kernel doesn't have the register budget\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <string.h>
+
+using namespace Halide;
+
+int copies = 0;
+
+void halide_print(void *user_context, const char *str) {
+    if (strstr(str, "from host to device") || strstr(str, "from device to host")) {
+        copies++;
+    }
+}
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (!target.has_feature(Target::OpenCL)) {
+        printf("Not running test because opencl is not enabled\n");
+        return 0;
+    }
+
+    Internal::JITHandlers handlers;
+    handlers.custom_print = halide_print;
+    Internal::JITSharedRuntime::set_default_handlers(handlers);
+
+    // We need debug output to count the copies.
+    target.set_feature(Target::Debug);
+    const halide_device_interface_t *opencl = get_device_interface_for_device_api(DeviceAPI::OpenCL, target);
+
+    // Buffers allocated on both the host and the device hand their memory
+    // over instead of copying it.
+    Buffer<int> in(Runtime::Buffer<int>(nullptr, 1000));
+    Buffer<int> out(Runtime::Buffer<int>(nullptr, 1000));
+    if (in.get()->device_and_host_malloc(opencl) != 0 ||
+        out.get()->device_and_host_malloc(opencl) != 0) {
+        printf("device_and_host_malloc failed\n");
+        return -1;
+    }
+
+    Var x, xi;
+    Func f;
+    f(x) = in(x) * 2 + 1;
+    f.gpu_tile(x, xi, 32);
+    f.set_custom_print(halide_print);
+
+    for (int iter = 0; iter < 3; iter++) {
+        for (int i = 0; i < 1000; i++) {
+            in(i) = i + iter;
+        }
+        in.set_host_dirty();
+        f.realize(out, target);
+        out.copy_to_host();
+        for (int i = 0; i < 1000; i++) {
+            int correct = (i + iter) * 2 + 1;
+            if (out(i) != correct) {
+                printf("out(%d) = %d instead of %d\n", i, out(i), correct);
+                return -1;
+            }
+        }
+    }
+
+    if (copies != 0) {
+        printf("There were %d copies between the host and the device\n", copies);
+        return -1;
+    }
+
+    in.get()->device_and_host_free(opencl);
+    out.get()->device_and_host_free(opencl);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Target t(get_jit_target_from_environment());
+    if (!t.has_feature(Target::CUDA)) {
+        printf("Not running test because cuda not enabled\n");
+        return 0;
+    }
+
+    const int W = 256, H = 256;
+    const halide_device_interface_t *cuda = get_device_interface_for_device_api(DeviceAPI::CUDA, t);
+
+    // An input allocated on both the host and the device, whose host
+    // memory is page-locked so that it is copied asynchronously.
+    Buffer<float> frame(Runtime::Buffer<float>(nullptr, W, H));
+    if (frame.get()->device_and_host_malloc(cuda) != 0 || frame.data() == nullptr) {
+        printf("device_and_host_malloc failed\n");
+        return -1;
+    }
+
+    {
+        Func f;
+        Var x, y, xi, yi;
+        f(x, y) = frame(x, y) * 2.0f;
+        f.gpu_tile(x, y, xi, yi, 16, 16);
+
+        for (int i = 0; i < 4; i++) {
+            // Upload a new frame, which the pipeline reads after its copy
+            // to the device on the same stream.
+            for (int y = 0; y < H; y++) {
+                for (int x = 0; x < W; x++) {
+                    frame(x, y) = x + y * W + i;
+                }
+            }
+            frame.set_host_dirty();
+
+            Buffer<float> out = f.realize(W, H, t);
+            for (int y = 0; y < H; y++) {
+                for (int x = 0; x < W; x++) {
+                    float correct = 2.0f * (x + y * W + i);
+                    if (out(x, y) != correct) {
+                        printf("Frame %d: out(%d, %d) = %f instead of %f\n",
+                               i, x, y, out(x, y), correct);
+                        return -1;
+                    }
+                }
+            }
+
+            // Wait for the copy of the frame to finish before overwriting it.
+            frame.device_sync();
+        }
+    }
+
+    if (frame.get()->device_and_host_free(cuda) != 0) {
+        printf("device_and_host_free failed\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
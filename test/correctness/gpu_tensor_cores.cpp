@@ -0,0 +1,69 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment();
+    if (!t.has_feature(Target::CUDA) ||
+        !t.features_any_of({Target::CUDACapability70, Target::CUDACapability75})) {
+        printf("Not running test because no cuda target with tensor cores enabled\n");
+        return 0;
+    }
+
+    const int N = 64;
+    Buffer<float16_t> a(N, N), b(N, N);
+    for (int y = 0; y < N; y++) {
+        for (int x = 0; x < N; x++) {
+            // Small integers, so that the products and sums are exact.
+            a(x, y) = float16_t((x * 3 + y * 7) % 9 - 4);
+            b(x, y) = float16_t((x * 5 + y * 11) % 7 - 3);
+        }
+    }
+
+    // A matrix multiply in which each 16x16x16 block of the update is
+    // done by the tensor cores. The constraints on the buffers let
+    // the tiles be proven aligned.
+    ImageParam A(Float(16), 2), B(Float(16), 2);
+    Func C;
+    Var x, y, xi, yi;
+    RVar ro, ri;
+    RDom r(0, N);
+
+    C(x, y) = 0.0f;
+    C(x, y) += cast<float>(A(r, y)) * cast<float>(B(x, r));
+
+    for (ImageParam p : {A, B}) {
+        p.dim(0).set_min(0);
+        p.dim(1).set_min(0).set_stride(N);
+    }
+    C.output_buffer().dim(0).set_min(0);
+    C.output_buffer().dim(1).set_min(0).set_stride(N);
+    C.bound(x, 0, N).bound(y, 0, N);
+
+    C.gpu_tile(x, y, xi, yi, 16, 16);
+    C.update()
+        .tile(x, y, xi, yi, 16, 16)
+        .split(r, ro, ri, 16)
+        .reorder(ri, xi, yi, ro, x, y)
+        .gpu_blocks(x, y);
+
+    A.set(a);
+    B.set(b);
+    Buffer<float> out = C.realize(N, N);
+    for (int y = 0; y < N; y++) {
+        for (int x = 0; x < N; x++) {
+            float correct = 0.0f;
+            for (int k = 0; k < N; k++) {
+                correct += (float)a(k, y) * (float)b(x, k);
+            }
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %f instead of %f\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -66,6 +66,34 @@ int main(int argc, char **argv) {
         check_equal(a_window, b_window);
     }
 
+    {
+        // Check copying between buffers with the same layout, which
+        // copies contiguous runs of values at once, and filling
+        // crops with values that are and aren't a repeated byte.
+        Buffer<int> a(64, 48, 3), b(64, 48, 3);
+        b.fill([&](int x, int y, int c) {
+            return x + 100 * y + 10000 * c;
+        });
+        a.copy_from(b);
+        check_equal(a, b);
+
+        Buffer<int> a_window = a.cropped(0, 10, 20).cropped(2, 1, 1);
+        a_window.fill(0);
+        a.cropped(0, 40, 10).fill(0x01020304);
+        a.for_each_element([&](int x, int y, int c) {
+            int correct = b(x, y, c);
+            if (x >= 10 && x < 30 && c == 1) {
+                correct = 0;
+            } else if (x >= 40 && x < 50) {
+                correct = 0x01020304;
+            }
+            if (a(x, y, c) != correct) {
+                printf("a(%d, %d, %d) = %d instead of %d\n", x, y, c, a(x, y, c), correct);
+                abort();
+            }
+        });
+    }
+
     {
         // Check make a Buffer from a Buffer of a different type
         Buffer<float, 2> a(100, 80);
@@ -0,0 +1,39 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    // The allocator reads its settings once, so set them before the
+    // shared runtime is (re)created.
+    static char threshold[] = "HL_HUGE_PAGE_THRESHOLD_MB=1";
+    putenv(threshold);
+    Internal::JITSharedRuntime::release_all();
+
+    // A large root-level intermediate goes through the huge page
+    // path, and a small per-row one doesn't.
+    Var x, y;
+    Func f, g, h;
+    f(x, y) = x + y * 2;
+    g(x, y) = f(x, y) * 2;
+    h(x, y) = f(x, y) + g(x, y) + g(x + 1, y);
+    f.compute_root();
+    g.compute_at(h, y);
+
+    for (int iter = 0; iter < 3; iter++) {
+        Buffer<int> out = h.realize(2048, 1024);
+        for (int j = 0; j < out.height(); j++) {
+            for (int i = 0; i < out.width(); i++) {
+                int correct = (i + j * 2) * 3 + (i + 1 + j * 2) * 2;
+                if (out(i, j) != correct) {
+                    printf("out(%d, %d) = %d instead of %d\n", i, j, out(i, j), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
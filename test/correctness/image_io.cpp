@@ -181,7 +181,7 @@ void do_test() {
     luma_buf.copy_from(color_buf);
     luma_buf.slice(2, 0);
 
-    std::vector<std::string> formats = {"ppm","pgm","tmp","mat"};
+    std::vector<std::string> formats = {"ppm","pgm","tmp","mat","htensor"};
 #ifndef HALIDE_NO_JPEG
     formats.push_back("jpg");
 #endif
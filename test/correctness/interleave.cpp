@@ -411,6 +411,36 @@ int main(int argc, char **argv) {
         check_interleave_count(trans2, 1);
     }
 
+    {
+        // Test deinterleaving loads of packed data with up to 8
+        // channels, e.g. packed RGB to planar. The input is exactly
+        // the size needed, so the loads must not run off the end of
+        // it.
+        for (int channels = 2; channels <= 8; channels++) {
+            const int W = 64;
+            Buffer<uint8_t> packed(channels * W);
+            for (int i = 0; i < channels * W; i++) {
+                packed(i) = (uint8_t)(i * 7 + 3);
+            }
+
+            Func planar;
+            planar(x, y) = packed(x * channels + y) * 2;
+            planar.bound(y, 0, channels).reorder(y, x).unroll(y).vectorize(x, 16);
+
+            Buffer<uint8_t> result = planar.realize(W, channels);
+            for (int y = 0; y < channels; y++) {
+                for (int x = 0; x < W; x++) {
+                    uint8_t correct = (uint8_t)(packed(x * channels + y) * 2);
+                    if (result(x, y) != correct) {
+                        printf("planar(%d, %d) = %d instead of %d with %d channels\n",
+                               x, y, result(x, y), correct, channels);
+                        return -1;
+                    }
+                }
+            }
+        }
+    }
+
     printf("Success!\n");
     return 0;
 }
@@ -0,0 +1,92 @@
+#include "Halide.h"
+#include <cmath>
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Records the names of the allocations.
+class FindAllocations : public IRMutator2 {
+public:
+    std::vector<std::string> names;
+
+    Stmt mutate(const Stmt &s) override {
+        names.clear();
+        struct Finder : public IRVisitor {
+            std::vector<std::string> &names;
+            using IRVisitor::visit;
+            void visit(const Allocate *op) override {
+                names.push_back(op->name);
+                IRVisitor::visit(op);
+            }
+            Finder(std::vector<std::string> &n) : names(n) {}
+        } finder(names);
+        s.accept(&finder);
+        return s;
+    }
+};
+
+int main(int argc, char **argv) {
+    const int N = 256;
+    Buffer<float> re(N), im(N);
+    for (int i = 0; i < N; i++) {
+        re(i) = (i % 17) / 4.0f - 2.0f;
+        im(i) = (i % 11) / 3.0f - 1.5f;
+    }
+
+    for (int interleaved = 0; interleaved < 2; interleaved++) {
+        // Square some complex numbers, add a shifted copy (an update
+        // that reads the Tuple while it writes it), and take the
+        // magnitude.
+        Var x;
+        Func z, sq, mag;
+        z(x) = Tuple(re(x), im(x));
+        sq(x) = Tuple(z(x)[0] * z(x)[0] - z(x)[1] * z(x)[1], 2 * z(x)[0] * z(x)[1]);
+        sq(x) = Tuple(sq(x)[0] + z(x + 1)[1], sq(x)[1] - z(x + 1)[0]);
+        mag(x) = sqrt(sq(x)[0] * sq(x)[0] + sq(x)[1] * sq(x)[1]);
+
+        z.compute_root().vectorize(x, 8);
+        sq.compute_root().vectorize(x, 8);
+        sq.update().vectorize(x, 8);
+        mag.vectorize(x, 8);
+        if (interleaved) {
+            z.store_interleaved();
+            sq.store_interleaved();
+        }
+
+        FindAllocations *find = new FindAllocations;
+        mag.add_custom_lowering_pass(find);
+        Buffer<float> out = mag.realize(N - 1);
+
+        for (int i = 0; i < N - 1; i++) {
+            float a = re(i), b = im(i);
+            float s0 = a * a - b * b + im(i + 1);
+            float s1 = 2 * a * b - re(i + 1);
+            float correct = std::sqrt(s0 * s0 + s1 * s1);
+            if (std::abs(out(i) - correct) > 1e-4f * std::max(1.0f, correct)) {
+                printf("out(%d) = %f instead of %f\n", i, out(i), correct);
+                return -1;
+            }
+        }
+
+        // Stored interleaved, each Tuple is a single allocation.
+        bool found_elements = false;
+        for (const std::string &name : find->names) {
+            found_elements |= ends_with(name, ".0") || ends_with(name, ".1");
+        }
+        if (interleaved && (found_elements || find->names.size() != 2)) {
+            printf("The Tuples weren't each stored in one allocation:\n");
+            for (const std::string &name : find->names) {
+                printf("  %s\n", name.c_str());
+            }
+            return -1;
+        }
+        if (!interleaved && !found_elements) {
+            printf("The Tuples weren't split into elements\n");
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    ImageParam in(Int(32), 2);
+    Param<int> offset;
+    Var x, y;
+    Func f;
+    f(x, y) = in(x, y) * 2 + offset;
+    f.vectorize(x, 4);
+
+    JITCallable callable = Pipeline(f).compile_to_jit_callable();
+
+    Buffer<int> input_a(16, 16), input_b(16, 16), out(16, 16);
+    input_a.for_each_element([&](int x, int y) { input_a(x, y) = x + y; });
+    input_b.for_each_element([&](int x, int y) { input_b(x, y) = x * y; });
+
+    // Change the inputs and the Params between calls, as for a
+    // sequence of tiles.
+    for (int i = 0; i < 100; i++) {
+        Buffer<int> &input = (i % 2) ? input_b : input_a;
+        in.set(input);
+        offset.set(i);
+        callable(out);
+        for (int y = 0; y < 16; y++) {
+            for (int x = 0; x < 16; x++) {
+                int correct = input(x, y) * 2 + i;
+                if (out(x, y) != correct) {
+                    printf("out(%d, %d) = %d instead of %d on call %d\n",
+                           x, y, out(x, y), correct, i);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // The results should match realize.
+    Buffer<int> realized = f.realize(16, 16);
+    for (int y = 0; y < 16; y++) {
+        for (int x = 0; x < 16; x++) {
+            if (realized(x, y) != out(x, y)) {
+                printf("realize gave %d at (%d, %d) but the JITCallable gave %d\n",
+                       realized(x, y), x, y, out(x, y));
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
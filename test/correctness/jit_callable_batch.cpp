@@ -0,0 +1,66 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    ImageParam in(Int(32), 2), weights(Int(32), 1);
+    Var x, y;
+    Func f;
+    f(x, y) = in(x, y) * weights(x);
+    f.parallel(y);
+
+    JITCallable callable = Pipeline(f).compile_to_jit_callable();
+
+    // The weights are shared by the whole batch.
+    Buffer<int> w(8);
+    w.for_each_element([&](int x) { w(x) = x + 1; });
+    weights.set(w);
+
+    // A batch of small images, stacked along a third dimension.
+    const int batch_size = 32;
+    Buffer<int> inputs(8, 8, batch_size), outputs(8, 8, batch_size);
+    inputs.for_each_element([&](int x, int y, int b) { inputs(x, y, b) = x + y * 8 + b * 64; });
+    outputs.fill(0);
+
+    callable({{in.name(), inputs}}, outputs);
+    for (int b = 0; b < batch_size; b++) {
+        for (int y = 0; y < 8; y++) {
+            for (int x = 0; x < 8; x++) {
+                int correct = inputs(x, y, b) * w(x);
+                if (outputs(x, y, b) != correct) {
+                    printf("outputs(%d, %d, %d) = %d instead of %d\n",
+                           x, y, b, outputs(x, y, b), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // The same batch as separate buffers, of different sizes.
+    std::vector<JITCallable::BatchElement> batch(batch_size);
+    for (int b = 0; b < batch_size; b++) {
+        Buffer<int> input(8, b + 1), output(8, b + 1);
+        input.for_each_element([&](int x, int y) { input(x, y) = x - y + b; });
+        batch[b].inputs[in.name()] = input;
+        batch[b].outputs.push_back(output);
+    }
+    callable(batch);
+    for (int b = 0; b < batch_size; b++) {
+        Buffer<int> input = batch[b].inputs[in.name()];
+        Buffer<int> output = batch[b].outputs[0];
+        for (int y = 0; y < output.height(); y++) {
+            for (int x = 0; x < 8; x++) {
+                int correct = input(x, y) * w(x);
+                if (output(x, y) != correct) {
+                    printf("Element %d of the batch: output(%d, %d) = %d instead of %d\n",
+                           b, x, y, output(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
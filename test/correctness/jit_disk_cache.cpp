@@ -0,0 +1,98 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+using namespace Halide;
+
+// Returns the number of objects in the cache directory, or -1 if we
+// can't tell.
+int count_objects(const std::string &dir) {
+#ifdef _WIN32
+    return -1;
+#else
+    DIR *d = opendir(dir.c_str());
+    if (!d) return 0;
+    int count = 0;
+    while (dirent *e = readdir(d)) {
+        std::string name = e->d_name;
+        if (name.size() > 2 && name.substr(name.size() - 2) == ".o") {
+            count++;
+        }
+    }
+    closedir(d);
+    return count;
+#endif
+}
+
+static std::string dir = Internal::dir_make_temp();
+
+// Delete the cache directory and everything the cache put in it.
+void remove_cache_dir() {
+#ifndef _WIN32
+    if (DIR *d = opendir(dir.c_str())) {
+        while (dirent *e = readdir(d)) {
+            std::string name = e->d_name;
+            if (name != "." && name != "..") {
+                Internal::file_unlink(dir + "/" + name);
+            }
+        }
+        closedir(d);
+    }
+    Internal::dir_rmdir(dir);
+#endif
+}
+
+// Build the same pipeline each time, with explicit names, as a
+// restarted process would.
+bool run_pipeline() {
+    Var x("x"), y("y");
+    Func f("f"), g("g");
+    f(x, y) = x * 2 + y;
+    g(x, y) = f(x, y) + f(x + 1, y);
+    f.compute_root();
+    g.vectorize(x, 8).parallel(y);
+
+    Buffer<int> out = g.realize(64, 64);
+    for (int y = 0; y < 64; y++) {
+        for (int x = 0; x < 64; x++) {
+            int correct = (x * 2 + y) + ((x + 1) * 2 + y);
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    atexit(remove_cache_dir);
+    static std::string env = "HL_JIT_CACHE_DIR=" + dir;
+    putenv(&env[0]);
+    Internal::JITSharedRuntime::release_all();
+
+    if (!run_pipeline()) return -1;
+    int cold = count_objects(dir);
+    if (cold == 0) {
+        printf("Nothing was written to the cache\n");
+        return -1;
+    }
+
+    // Throw away the shared runtime and compile the same pipeline
+    // again, as a restart would. Both should come from the cache.
+    Internal::JITSharedRuntime::release_all();
+
+    if (!run_pipeline()) return -1;
+    int warm = count_objects(dir);
+    if (warm != cold) {
+        printf("Expected %d objects in the cache, but there are %d\n", cold, warm);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Counts the lowerings of the pipeline, and the loop nests over x in
+// the most recent one.
+class CountLoopNests : public IRMutator2 {
+public:
+    int lowerings = 0, loop_nests = 0;
+
+    Stmt mutate(const Stmt &s) override {
+        struct Counter : public IRVisitor {
+            int count = 0;
+            using IRVisitor::visit;
+            void visit(const For *op) override {
+                if (op->name.find(".s0.x") != std::string::npos) {
+                    count++;
+                }
+                IRVisitor::visit(op);
+            }
+        } counter;
+        s.accept(&counter);
+        lowerings++;
+        loop_nests = counter.count;
+        return s;
+    }
+};
+
+bool check(const Buffer<int> &out, int mode) {
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            int correct = x * 3 + y * mode;
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d for mode %d\n", x, y, out(x, y), correct, mode);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    Var x, y;
+    Param<int> mode;
+    Func f("f");
+    f(x, y) = x * 3 + y * mode;
+    for (int i = 0; i < 4; i++) {
+        f.specialize(mode == i).vectorize(x, 4 << i);
+    }
+
+    Pipeline p(f);
+    CountLoopNests *counter = new CountLoopNests;
+    p.add_custom_lowering_pass(counter);
+    p.compile_specializations_lazily();
+
+    Buffer<int> out(64, 8);
+
+    // Only the specialization that's taken is compiled.
+    mode.set(1);
+    p.realize(out);
+    if (!check(out, 1)) return -1;
+    if (counter->lowerings != 1 || counter->loop_nests != 1) {
+        printf("After the first call, there were %d lowerings with %d loop nests instead of one with one\n",
+               counter->lowerings, counter->loop_nests);
+        return -1;
+    }
+
+    // The Func's own specializations are left alone.
+    const std::vector<Specialization> &specializations = f.function().definition().specializations();
+    for (int i = 0; i < 4; i++) {
+        if (!equal(specializations[i].condition, mode == i)) {
+            printf("Compiling lazily changed the condition of specialization %d\n", i);
+            return -1;
+        }
+    }
+
+    // Calls that take the same specialization reuse the code.
+    p.realize(out);
+    if (!check(out, 1)) return -1;
+
+    // Another specialization compiles the pipeline again, and so does
+    // the default schedule.
+    mode.set(2);
+    p.realize(out);
+    if (!check(out, 2)) return -1;
+    mode.set(7);
+    p.realize(out);
+    if (!check(out, 7)) return -1;
+    if (counter->lowerings != 3 || counter->loop_nests != 1) {
+        printf("After three modes, there were %d lowerings with %d loop nests instead of three with one\n",
+               counter->lowerings, counter->loop_nests);
+        return -1;
+    }
+
+    // Going back to an earlier specialization reuses its code.
+    mode.set(1);
+    p.realize(out);
+    if (!check(out, 1)) return -1;
+    mode.set(2);
+    p.realize(out);
+    if (!check(out, 2)) return -1;
+    if (counter->lowerings != 3) {
+        printf("Going back to earlier modes lowered the pipeline again\n");
+        return -1;
+    }
+
+    // Without lazy compilation, all the variants are compiled.
+    p.compile_specializations_lazily(false);
+    mode.set(3);
+    p.realize(out);
+    if (!check(out, 3)) return -1;
+    if (counter->lowerings != 4 || counter->loop_nests != 5) {
+        printf("Compiling eagerly gave %d lowerings with %d loop nests instead of four with five\n",
+               counter->lowerings, counter->loop_nests);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include "Halide.h"
+#include <stdio.h>
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+// The pipeline calls scale_value, which the loaded code finds in a
+// dependency, under a different name from the C function.
+extern "C" DLLEXPORT int scale_value_impl(int x) {
+    return x * 3;
+}
+HalideExtern_1(int, scale_value, int);
+
+int main(int argc, char **argv) {
+    ImageParam input(Int(32), 1);
+    Param<int> offset;
+    Var x;
+    Func f;
+    f(x) = scale_value(input(x)) + offset;
+    f.vectorize(x, 4);
+
+    Target target = get_host_target().with_feature(Target::NoRuntime);
+    std::vector<Argument> args = {input, offset};
+
+    std::string object_file = get_test_tmp_dir() + "jit_load_object.o";
+    std::string bitcode_file = get_test_tmp_dir() + "jit_load_object.bc";
+    ensure_no_file_exists(object_file);
+    ensure_no_file_exists(bitcode_file);
+    f.compile_to_object(object_file, args, "loaded_pipeline", target);
+    f.compile_to_bitcode(bitcode_file, args, "loaded_pipeline", target);
+
+    JITModule externs;
+    externs.add_extern_for_export("scale_value", ExternCFunction(scale_value_impl));
+
+    for (const std::string &file : {object_file, bitcode_file}) {
+        JITModule loaded = JITModule::load(file, "loaded_pipeline", target, {externs});
+        if (!loaded.argv_function()) {
+            printf("%s has no argv wrapper\n", file.c_str());
+            return -1;
+        }
+
+        Buffer<int> in(64), out(64);
+        for (int i = 0; i < 64; i++) {
+            in(i) = i - 20;
+        }
+        int offset_value = 7;
+        const void *call_args[] = {in.raw_buffer(), &offset_value, out.raw_buffer()};
+        int result = loaded.argv_function()(call_args);
+        if (result != 0) {
+            printf("Calling the pipeline loaded from %s returned %d\n", file.c_str(), result);
+            return -1;
+        }
+        for (int i = 0; i < 64; i++) {
+            int correct = (i - 20) * 3 + 7;
+            if (out(i) != correct) {
+                printf("out(%d) = %d instead of %d, loading %s\n", i, out(i), correct, file.c_str());
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
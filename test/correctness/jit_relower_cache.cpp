@@ -0,0 +1,90 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int f_stores = 0;
+
+int my_trace(void *user_context, const halide_trace_event_t *ev) {
+    if (ev->event == halide_trace_store && std::string(ev->func) == "f") {
+        f_stores++;
+    }
+    return 0;
+}
+
+bool check(Pipeline p, bool f_is_root) {
+    f_stores = 0;
+    Buffer<int> out = p.realize(16, 16);
+    for (int y = 0; y < 16; y++) {
+        for (int x = 0; x < 16; x++) {
+            int correct = (x + y) * 2 + (x + 1 + y) * 2;
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return false;
+            }
+        }
+    }
+    // Code compiled for an earlier schedule may be reused only if
+    // lowering gives the same code, so the stores to f must match
+    // the current schedule.
+    if ((f_stores > 0) != f_is_root) {
+        printf("%d stores to f with f %s\n", f_stores, f_is_root ? "compute_root" : "inlined");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    Var x("x"), y("y");
+    Func f("f"), g("g");
+    f(x, y) = (x + y) * 2;
+    g(x, y) = f(x, y) + f(x + 1, y);
+    f.trace_stores();
+
+    Pipeline p(g);
+    p.set_custom_trace(&my_trace);
+
+    // Switch the schedule of f back and forth, as a schedule-tuning
+    // tool would.
+    for (int i = 0; i < 3; i++) {
+        f.compute_root();
+        p.invalidate_cache();
+        if (!check(p, true)) {
+            return -1;
+        }
+        f.compute_inline();
+        p.invalidate_cache();
+        if (!check(p, false)) {
+            return -1;
+        }
+    }
+
+    // Two lowerings that differ only in a float constant too close to
+    // another for the printed IR to tell them apart must not share
+    // code. Each specialization of h is lowered with the other taken
+    // out, which leaves just the constant.
+    {
+        const float a = 1.0f + 1.0f / (1 << 23), b = 1.0f + 1.0f / (1 << 22);
+        Param<int> mode;
+        Func h("h");
+        h(x) = x * select(mode == 0, a, select(mode == 1, b, 1.0f));
+        h.specialize(mode == 0);
+        h.specialize(mode == 1);
+        Pipeline q(h);
+        q.compile_specializations_lazily();
+        for (int m = 0; m < 2; m++) {
+            mode.set(m);
+            Buffer<float> out = q.realize(8);
+            for (int i = 0; i < 8; i++) {
+                float correct = i * (m == 0 ? a : b);
+                if (out(i) != correct) {
+                    printf("out(%d) = %.9g instead of %.9g for mode %d\n", i, out(i), correct, m);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include "Halide.h"
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+// How many times the code from each lowering of the pipeline has run.
+int runs[8] = {0};
+extern "C" DLLEXPORT int record_run(int lowering) {
+    runs[lowering]++;
+    return 0;
+}
+
+// Whether the loop over x in each lowering has a constant extent.
+bool constant_extent[8] = {false};
+
+class FindLoopExtent : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const For *op) override {
+        if (ends_with(op->name, ".s0.x")) {
+            constant = is_const(op->extent);
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    bool constant = false;
+};
+
+// Makes the code from each lowering record that it ran.
+class TagLowering : public IRMutator2 {
+    int lowerings = 0;
+
+public:
+    Stmt mutate(const Stmt &s) override {
+        int lowering = lowerings++;
+        FindLoopExtent finder;
+        s.accept(&finder);
+        constant_extent[lowering] = finder.constant;
+        Expr call = Call::make(Int(32), "record_run", {lowering}, Call::Extern);
+        return Block::make(Evaluate::make(call), s);
+    }
+
+    int count() const {
+        return lowerings;
+    }
+};
+
+bool check(const Buffer<int> &out, int offset) {
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            int correct = x * 3 + y + offset;
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    Var x, y;
+    Param<int> offset;
+    Func f;
+    f(x, y) = x * 3 + y + offset;
+
+    Pipeline p(f);
+    TagLowering *tag = new TagLowering;
+    p.add_custom_lowering_pass(tag);
+    const int threshold = 4;
+    p.specialize_hot_shapes(threshold, 1);
+
+    // A shape that's only seen a few times uses the generic code.
+    Buffer<int> cold(20, 3);
+    for (int i = 0; i < threshold - 1; i++) {
+        offset.set(i);
+        p.realize(cold);
+        if (!check(cold, i)) return -1;
+    }
+    if (tag->count() != 1) {
+        printf("The pipeline was lowered %d times instead of once\n", tag->count());
+        return -1;
+    }
+
+    // A hot shape is lowered again with its extents as constants, and
+    // used once it's compiled.
+    Buffer<int> hot(37, 5);
+    for (int i = 0; i < threshold; i++) {
+        offset.set(i);
+        p.realize(hot);
+        if (!check(hot, i)) return -1;
+    }
+    if (tag->count() != 2) {
+        printf("The hot shape wasn't specialized\n");
+        return -1;
+    }
+    if (constant_extent[0] || !constant_extent[1]) {
+        printf("Only the specialized lowering should have a constant loop extent\n");
+        return -1;
+    }
+
+    for (int i = 0; runs[1] == 0; i++) {
+        if (i == 10000) {
+            printf("The specialized code was never used\n");
+            return -1;
+        }
+        offset.set(i);
+        p.realize(hot);
+        if (!check(hot, i)) return -1;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // Once a shape runs the specialized code, it keeps doing so, and
+    // other shapes still run the generic code.
+    int generic_runs = runs[0], specialized_runs = runs[1];
+    p.realize(hot);
+    p.realize(cold);
+    if (runs[0] != generic_runs + 1 || runs[1] != specialized_runs + 1) {
+        printf("The wrong code ran for the hot and cold shapes\n");
+        return -1;
+    }
+
+    // Only one shape may be specialized, so another hot shape isn't.
+    Buffer<int> other(8, 8);
+    for (int i = 0; i < threshold * 2; i++) {
+        offset.set(i);
+        p.realize(other);
+        if (!check(other, i)) return -1;
+    }
+    if (tag->count() != 2) {
+        printf("More shapes were specialized than were allowed\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
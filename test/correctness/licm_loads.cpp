@@ -0,0 +1,111 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Counts the loads from a buffer inside the innermost loops.
+class CountInnerLoads : public IRMutator2 {
+public:
+    std::string name;
+    int count = 0;
+
+    CountInnerLoads(const std::string &name) : name(name) {}
+
+    Stmt mutate(const Stmt &s) override {
+        struct Counter : public IRVisitor {
+            const std::string &name;
+            int count = 0, loops = 0;
+            using IRVisitor::visit;
+            void visit(const For *op) override {
+                loops++;
+                IRVisitor::visit(op);
+                loops--;
+            }
+            void visit(const Load *op) override {
+                // The pipelines below have two loops. An accumulator
+                // may be kept in a register for the inner loop.
+                bool from_buffer = (op->name == name ||
+                                    starts_with(op->name, name + ".accumulator"));
+                if (from_buffer && loops > 1) {
+                    count++;
+                }
+                IRVisitor::visit(op);
+            }
+            Counter(const std::string &name) : name(name) {}
+        } counter(name);
+        s.accept(&counter);
+        count = counter.count;
+        return s;
+    }
+};
+
+int main(int argc, char **argv) {
+    const int W = 67, H = 16;
+    Buffer<int> in(W, H), k(H);
+    for (int y = 0; y < H; y++) {
+        k(y) = y * 3 - 7;
+        for (int x = 0; x < W; x++) {
+            in(x, y) = x + y * 5;
+        }
+    }
+
+    Var x, y;
+
+    // A load from a buffer that's constant over the inner loop
+    // should be lifted out of it.
+    {
+        Func f("f");
+        f(x, y) = in(x, y) * k(y);
+        f.vectorize(x, 8);
+
+        CountInnerLoads *counter = new CountInnerLoads(k.name());
+        f.add_custom_lowering_pass(counter);
+        Buffer<int> out = f.realize(W, H);
+
+        if (counter->count != 0) {
+            printf("There were %d loads from k in the inner loop\n", counter->count);
+            return -1;
+        }
+
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                if (out(x, y) != in(x, y) * k(y)) {
+                    printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), in(x, y) * k(y));
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // A load from a buffer that's written in the loop must stay there.
+    {
+        Func g("g");
+        RDom r(0, W);
+        g(y) = 0;
+        g(y) = g(y) + in(r, y) * g(y) + 1;
+
+        CountInnerLoads *counter = new CountInnerLoads("g");
+        g.add_custom_lowering_pass(counter);
+        Buffer<int> out = g.realize(H);
+
+        if (counter->count == 0) {
+            printf("The load from g was lifted out of a loop that stores to it\n");
+            return -1;
+        }
+
+        for (int y = 0; y < H; y++) {
+            int correct = 0;
+            for (int x = 0; x < W; x++) {
+                correct = correct + in(x, y) * correct + 1;
+            }
+            if (out(y) != correct) {
+                printf("out(%d) = %d instead of %d\n", y, out(y), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
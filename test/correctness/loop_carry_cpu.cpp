@@ -0,0 +1,74 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Count the loads of the input done by each iteration of the
+// innermost loops.
+int max_input_loads = 0;
+class CountInnerLoads : public IRMutator2 {
+    using IRMutator2::visit;
+
+    int loads = 0;
+    bool innermost = false;
+
+    Stmt visit(const For *op) override {
+        loads = 0;
+        innermost = true;
+        Stmt s = IRMutator2::visit(op);
+        if (innermost) {
+            max_input_loads = std::max(max_input_loads, loads);
+        }
+        innermost = false;
+        return s;
+    }
+
+    Expr visit(const Load *op) override {
+        if (op->name == "input") {
+            loads++;
+        }
+        return IRMutator2::visit(op);
+    }
+};
+
+int main(int argc, char **argv) {
+    ImageParam input(Int(32), 2, "input");
+    Var x, y;
+
+    // A vertical stencil that walks down columns of vectors. Each row
+    // of the input is used by three iterations of the loop over y.
+    Func f;
+    f(x, y) = input(x, y - 1) + 2 * input(x, y) + input(x, y + 1);
+    f.reorder(y, x).vectorize(x, 8);
+    f.add_custom_lowering_pass(new CountInnerLoads);
+
+    Buffer<int> in(64, 66);
+    in.set_min(0, -1);
+    in.for_each_element([&](int x, int y) { in(x, y) = x * 3 + y * y; });
+    input.set(in);
+
+    Target t = get_jit_target_from_environment();
+    Buffer<int> out = f.realize(64, 64, t);
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            int correct = in(x, y - 1) + 2 * in(x, y) + in(x, y + 1);
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+
+    // On CPUs, the rows loaded on one iteration should be carried in
+    // registers to the next, leaving one load per iteration.
+    bool cpu = (t.arch == Target::X86 || t.arch == Target::ARM) &&
+               !t.features_any_of({Target::HVX_64, Target::HVX_128});
+    if (cpu && max_input_loads != 1) {
+        printf("%d loads of the input per iteration instead of 1\n", max_input_loads);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include "Halide.h"
+#include <limits>
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Counts the divisions by values that aren't constant inside loops.
+class CountDivisions : public IRMutator2 {
+public:
+    int count = 0;
+
+    Stmt mutate(const Stmt &s) override {
+        struct Counter : public IRVisitor {
+            int loops = 0, count = 0;
+            using IRVisitor::visit;
+            void visit(const For *op) override {
+                loops++;
+                IRVisitor::visit(op);
+                loops--;
+            }
+            void visit(const Div *op) override {
+                count += loops && !is_const(op->b);
+                IRVisitor::visit(op);
+            }
+            void visit(const Mod *op) override {
+                count += loops && !is_const(op->b);
+                IRVisitor::visit(op);
+            }
+        } counter;
+        s.accept(&counter);
+        count = counter.count;
+        return s;
+    }
+};
+
+// Euclidean division and modulus, which is what Halide does.
+int64_t euclidean_div(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    int64_t r = a - q * b;
+    if (r < 0) {
+        q += b < 0 ? 1 : -1;
+    }
+    return q;
+}
+
+template<typename T>
+bool test(const char *type_name, const std::vector<int64_t> &divisors) {
+    const int N = 1024;
+    Buffer<T> in(N);
+    for (int i = 0; i < N; i++) {
+        // Cover the whole range of the type, including its extremes.
+        in(i) = (T)(i * 1234567 + (i & 1 ? -i : i));
+    }
+    in(0) = std::numeric_limits<T>::min();
+    in(1) = std::numeric_limits<T>::max();
+
+    Param<T> p;
+    Var x;
+    for (int vector_width : {1, 16}) {
+        Func f;
+        f(x) = Tuple(in(x) / p, in(x) % p);
+        if (vector_width > 1) {
+            f.vectorize(x, vector_width);
+        }
+        CountDivisions *counter = new CountDivisions;
+        f.add_custom_lowering_pass(counter);
+        f.compile_jit();
+        if (counter->count) {
+            printf("%d divisions by a parameter were left in loops\n", counter->count);
+            return false;
+        }
+
+        for (int64_t d : divisors) {
+            if ((int64_t)(T)d != d) continue;
+            p.set((T)d);
+            Realization r = f.realize(N);
+            Buffer<T> div = r[0], mod = r[1];
+            for (int i = 0; i < N; i++) {
+                int64_t a = in(i);
+                int64_t q = euclidean_div(a, d);
+                // Dividing the smallest value by -1 overflows.
+                if ((int64_t)(T)q != q) continue;
+                T correct_div = (T)q;
+                T correct_mod = (T)(a - q * d);
+                if (div(i) != correct_div || mod(i) != correct_mod) {
+                    printf("%lld / %lld = %lld, %lld %% %lld = %lld, instead of %lld and %lld "
+                           "(type %s, vector width %d)\n",
+                           (long long)a, (long long)d, (long long)div(i),
+                           (long long)a, (long long)d, (long long)mod(i),
+                           (long long)correct_div, (long long)correct_mod,
+                           type_name, vector_width);
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    std::vector<int64_t> divisors = {1, 2, 3, 7, 10, 64, 100, 127, 128, 255, 256, 1000,
+                                     12345, 32767, 32768, 65535, 65536, 1000003,
+                                     0x7fffffff, 0x80000000LL, 0xffffffffLL,
+                                     -1, -2, -3, -7, -100, -128, -32768, -1000003,
+                                     -0x7fffffff, -0x80000000LL};
+
+    if (!test<uint8_t>("uint8_t", divisors) ||
+        !test<int8_t>("int8_t", divisors) ||
+        !test<uint16_t>("uint16_t", divisors) ||
+        !test<int16_t>("int16_t", divisors) ||
+        !test<uint32_t>("uint32_t", divisors) ||
+        !test<int32_t>("int32_t", divisors)) {
+        return -1;
+    }
+
+    {
+        // The divisor is loaded from the buffer the loop writes, so it
+        // can't be moved out of the loop. The first iteration changes
+        // it from 2 to 1.
+        const int N = 64;
+        Func f;
+        Var x;
+        RDom r(0, N);
+        f(x) = x + 2;
+        f(r) = f(r) / f(0);
+        Buffer<int> out = f.realize(N);
+        for (int i = 0; i < N; i++) {
+            int correct = i == 0 ? 1 : i + 2;
+            if (out(i) != correct) {
+                printf("out(%d) = %d instead of %d\n", i, out(i), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+int shuffles = 0;
+
+class CountShuffles : public IRMutator2 {
+    using IRMutator2::visit;
+
+    Expr visit(const Call *op) override {
+        if (op->is_intrinsic("dynamic_shuffle")) {
+            shuffles++;
+        }
+        return IRMutator2::visit(op);
+    }
+};
+
+bool test(int lut_size, int vector_width) {
+    ImageParam in(UInt(8), 1);
+    Var x;
+    Func lut, f;
+    lut(x) = cast<uint8_t>(x * 37 + 5);
+    lut.compute_root();
+    f(x) = lut(clamp(cast<int>(in(x)), 0, lut_size - 1));
+    f.vectorize(x, vector_width);
+
+    const int size = 1024;
+    Buffer<uint8_t> input(size);
+    for (int i = 0; i < size; i++) {
+        input(i) = (uint8_t)((i * 7) % (lut_size + 3));
+    }
+    in.set(input);
+
+    shuffles = 0;
+    f.add_custom_lowering_pass(new CountShuffles);
+    Buffer<uint8_t> out = f.realize(size);
+
+    for (int i = 0; i < size; i++) {
+        int idx = std::min((int)input(i), lut_size - 1);
+        uint8_t correct = (uint8_t)(idx * 37 + 5);
+        if (out(i) != correct) {
+            printf("out(%d) = %d instead of %d with a %d-entry table\n",
+                   i, out(i), correct, lut_size);
+            return false;
+        }
+    }
+
+    Target t = get_jit_target_from_environment();
+    bool expect_shuffles =
+        (t.arch == Target::X86 && t.has_feature(Target::SSE41) && lut_size <= 64) ||
+        (t.arch == Target::ARM && lut_size <= (t.bits == 64 ? 256 : 32));
+    if (expect_shuffles && shuffles == 0) {
+        printf("The lookups into a %d-entry table weren't turned into shuffles\n", lut_size);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    for (int lut_size : {16, 32, 64, 200}) {
+        for (int vector_width : {16, 32}) {
+            if (!test(lut_size, vector_width)) {
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -455,6 +455,52 @@ int main(int argc, char **argv) {
         Internal::JITSharedRuntime::memoization_cache_set_size(0);
     }
 
+    for (int priority : {0, 16}) {
+        // Test that a result with a high eviction priority survives a
+        // stream of results that overflow the cache, even though it is
+        // the least recently used entry. Every result is the same size
+        // and the cache size is pinned, so only the priority differs
+        // between the two runs. Without it, the result is evicted.
+        call_count = 0;
+        Func expensive;
+        expensive.define_extern("count_calls", {}, UInt(8), 2);
+        expensive.compute_root().memoize(priority);
+
+        Func kept;
+        Var x, y;
+        kept(x, y) = expensive(x, y);
+
+        Param<float> val;
+        call_count_with_arg = 0;
+        Func cheap;
+        cheap.define_extern("count_calls_with_arg", {cast<uint8_t>(val)}, UInt(8), 2);
+        cheap.compute_root().memoize();
+
+        Func stream;
+        stream(x, y) = cheap(x, y);
+
+        Internal::JITSharedRuntime::memoization_cache_set_size(300000);
+
+        Buffer<uint8_t> out1 = kept.realize(128, 128);
+        for (int v = 0; v < 50; v++) {
+            val.set((float)v);
+            Buffer<uint8_t> out2 = stream.realize(128, 128);
+            assert(out2(0, 0) == v);
+        }
+        assert(call_count_with_arg == 50);
+
+        out1 = kept.realize(128, 128);
+        for (int32_t i = 0; i < 128; i++) {
+            for (int32_t j = 0; j < 128; j++) {
+                assert(out1(i, j) == 42);
+            }
+        }
+        assert(call_count == (priority > 0 ? 1 : 2));
+
+        // Return cache size to default.
+        Internal::JITSharedRuntime::memoization_cache_set_size(0);
+    }
+
     {
         // Test parallel cache access
         Param<float> val;
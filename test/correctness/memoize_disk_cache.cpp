@@ -0,0 +1,146 @@
+#include "Halide.h"
+#include <cmath>
+#include <stdio.h>
+
+using namespace Halide;
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+int call_count = 0;
+
+extern "C" DLLEXPORT int count_calls_with_arg(uint8_t val, halide_buffer_t *out) {
+    if (!out->is_bounds_query()) {
+        call_count++;
+        Halide::Runtime::Buffer<uint8_t>(*out).fill(val);
+    }
+    return 0;
+}
+
+int float_calls = 0;
+
+extern "C" DLLEXPORT float count_float_calls(float x) {
+    float_calls++;
+    return x;
+}
+HalideExtern_1(float, count_float_calls, float);
+
+// A pipeline with a memoized stage that depends on a float constant,
+// and with the default names, which differ each time it's built.
+Func make_float_pipeline(float k) {
+    Var x, y;
+    Func f;
+    f(x, y) = count_float_calls(cast<float>(x + y) * k);
+    f.compute_root().memoize();
+
+    Func g;
+    g(x, y) = f(x, y);
+    return g;
+}
+
+// Realize the float pipeline and return how many times its memoized
+// stage was computed, or -1 if the output is wrong.
+int run_float_pipeline(float k) {
+    float_calls = 0;
+    Buffer<float> out = make_float_pipeline(k).realize(16, 16);
+    for (int y = 0; y < 16; y++) {
+        for (int x = 0; x < 16; x++) {
+            if (out(x, y) != (float)(x + y) * k) {
+                printf("out(%d, %d) = %a instead of %a\n", x, y, out(x, y), (float)(x + y) * k);
+                return -1;
+            }
+        }
+    }
+    return float_calls;
+}
+
+// Build the same pipeline each time, with explicit names, as a
+// restarted process would.
+Func make_pipeline(Param<uint8_t> val) {
+    Var x("x"), y("y");
+    Func count_calls("count_calls");
+    count_calls.define_extern("count_calls_with_arg", {val}, UInt(8), 2);
+    count_calls.compute_root().memoize();
+
+    Func g("g");
+    g(x, y) = count_calls(x, y) + cast<uint8_t>(x);
+    return g;
+}
+
+bool check(Func g, uint8_t v) {
+    Buffer<uint8_t> out = g.realize(64, 64);
+    for (int y = 0; y < 64; y++) {
+        for (int x = 0; x < 64; x++) {
+            if (out(x, y) != (uint8_t)(v + x)) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), (uint8_t)(v + x));
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    static std::string env = "HL_MEMOIZATION_CACHE_DIR=" + Internal::dir_make_temp();
+    putenv(&env[0]);
+    Internal::JITSharedRuntime::release_all();
+
+    Param<uint8_t> val("val");
+    val.set(17);
+
+    {
+        Func g = make_pipeline(val);
+        if (!check(g, 17)) return -1;
+        if (call_count != 1) {
+            printf("Expected one call on a cold cache but saw %d\n", call_count);
+            return -1;
+        }
+    }
+
+    // Throw away the in-memory cache, as a restart would.
+    Internal::JITSharedRuntime::release_all();
+
+    {
+        Func g = make_pipeline(val);
+        if (!check(g, 17)) return -1;
+        if (call_count != 1) {
+            printf("Result wasn't reloaded from disk: saw %d calls\n", call_count);
+            return -1;
+        }
+
+        // A different key must still be computed.
+        val.set(42);
+        if (!check(g, 42)) return -1;
+        if (call_count != 2) {
+            printf("Expected a second call for a new key but saw %d\n", call_count);
+            return -1;
+        }
+    }
+
+    {
+        // The key doesn't depend on the names made by unique_name, so
+        // rebuilding the same pipeline reloads it...
+        const float k = 1.1f;
+        if (run_float_pipeline(k) <= 0) return -1;
+        Internal::JITSharedRuntime::release_all();
+        int calls = run_float_pipeline(k);
+        if (calls != 0) {
+            printf("Rebuilt pipeline wasn't reloaded from disk: saw %d calls\n", calls);
+            return -1;
+        }
+
+        // ...but it does depend on float constants that print the same.
+        Internal::JITSharedRuntime::release_all();
+        calls = run_float_pipeline(std::nextafter(k, 2.0f));
+        if (calls <= 0) {
+            printf("Pipeline with a constant one ulp away was reloaded from disk\n");
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
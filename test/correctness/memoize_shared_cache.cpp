@@ -0,0 +1,105 @@
+#include "Halide.h"
+#include <stdio.h>
+
+#ifdef __linux__
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace Halide;
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+int call_count = 0;
+
+extern "C" DLLEXPORT int count_calls_with_arg(uint8_t val, halide_buffer_t *out) {
+    if (!out->is_bounds_query()) {
+        call_count++;
+        Halide::Runtime::Buffer<uint8_t>(*out).fill(val);
+    }
+    return 0;
+}
+
+bool check(Func g, uint8_t v) {
+    Buffer<uint8_t> out = g.realize(64, 64);
+    for (int y = 0; y < 64; y++) {
+        for (int x = 0; x < 64; x++) {
+            if (out(x, y) != (uint8_t)(v + x)) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), (uint8_t)(v + x));
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+#ifndef __linux__
+    printf("Not running test because shared memory segments are only supported on Linux\n");
+    return 0;
+#else
+    if (get_jit_target_from_environment().os != Target::Linux) {
+        printf("Not running test because shared memory segments are only supported on Linux\n");
+        return 0;
+    }
+
+    std::string segment = "halide_memoize_shared_cache_" + std::to_string((int)getpid());
+    static std::string env = "HL_MEMOIZATION_CACHE_SHM=" + segment;
+    putenv(&env[0]);
+    Internal::JITSharedRuntime::release_all();
+
+    Param<uint8_t> val("val");
+    val.set(17);
+
+    Var x("x"), y("y");
+    Func count_calls("count_calls");
+    count_calls.define_extern("count_calls_with_arg", {val}, UInt(8), 2);
+    count_calls.compute_root().memoize();
+
+    Func g("g");
+    g(x, y) = count_calls(x, y) + cast<uint8_t>(x);
+    g.compile_jit();
+
+    // Compute the result in another process.
+    pid_t pid = fork();
+    if (pid == 0) {
+        bool ok = check(g, 17) && call_count == 1;
+        _exit(ok ? 0 : 1);
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) != pid ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("The child process failed to compute the result\n");
+        unlink(("/dev/shm/" + segment).c_str());
+        return -1;
+    }
+
+    // This process should find it in the segment.
+    bool ok = check(g, 17);
+    if (ok && call_count != 0) {
+        printf("Result wasn't shared between processes: saw %d calls\n", call_count);
+        ok = false;
+    }
+
+    // A different key must still be computed, and then hit.
+    val.set(42);
+    ok = ok && check(g, 42) && check(g, 42);
+    if (ok && call_count != 1) {
+        printf("Expected one call for a new key but saw %d\n", call_count);
+        ok = false;
+    }
+
+    Internal::JITSharedRuntime::release_all();
+    unlink(("/dev/shm/" + segment).c_str());
+    if (!ok) {
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+#endif
+}
@@ -0,0 +1,110 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+class BlurX : public Generator<BlurX> {
+public:
+    Input<Func> input{"input", Int(32), 2};
+    Input<int> offset{"offset", 0};
+    Output<Func> output{"output", Int(32), 2};
+
+    void generate() {
+        output(x, y) = input(x - 1, y) + input(x, y) + input(x + 1, y) + offset;
+    }
+
+    void schedule() {
+        output.vectorize(x, 4);
+    }
+
+private:
+    Var x{"x"}, y{"y"};
+};
+
+HALIDE_REGISTER_GENERATOR(BlurX, named_stub_blur_x)
+
+// Checks where the intermediate from the Generator is allocated, and
+// whether its stores are vectorized.
+class CheckIntermediate : public IRMutator2 {
+public:
+    std::string name;
+    bool allocated_in_loop = false, vectorized = false;
+
+    Stmt mutate(const Stmt &s) override {
+        struct Checker : public IRVisitor {
+            const std::string &name;
+            int loop_depth = 0;
+            bool allocated_in_loop = false, vectorized = false;
+            using IRVisitor::visit;
+            void visit(const For *op) override {
+                loop_depth++;
+                IRVisitor::visit(op);
+                loop_depth--;
+            }
+            void visit(const Allocate *op) override {
+                if (op->name == name && loop_depth > 0) {
+                    allocated_in_loop = true;
+                }
+                IRVisitor::visit(op);
+            }
+            void visit(const Store *op) override {
+                if (op->name == name && op->index.as<Ramp>()) {
+                    vectorized = true;
+                }
+                IRVisitor::visit(op);
+            }
+            Checker(const std::string &name) : name(name) {}
+        } checker(name);
+        s.accept(&checker);
+        allocated_in_loop = checker.allocated_in_loop;
+        vectorized = checker.vectorized;
+        return s;
+    }
+};
+
+int main(int argc, char **argv) {
+    GeneratorContext context(get_jit_target_from_environment());
+
+    Var x, y, yo, yi;
+    Func in("in");
+    in(x, y) = x + y * 10;
+
+    // Call the Generator by its registered name, and fuse its output
+    // into the caller's loop nest.
+    NamedGeneratorStub blur_x(context, "named_stub_blur_x", {{"input", {in}}, {"offset", {Expr(5)}}});
+    Func bx = blur_x.output("output");
+
+    Func out("out");
+    out(x, y) = bx(x, y - 1) + bx(x, y + 1);
+    out.split(y, yo, yi, 8);
+    bx.compute_at(out, yo);
+
+    CheckIntermediate *checker = new CheckIntermediate;
+    checker->name = bx.name();
+    out.add_custom_lowering_pass(checker);
+
+    Buffer<int> result = out.realize(64, 64);
+    for (int y = 0; y < result.height(); y++) {
+        for (int x = 0; x < result.width(); x++) {
+            auto blurred = [](int x, int y) { return (x - 1 + y * 10) + (x + y * 10) + (x + 1 + y * 10) + 5; };
+            int correct = blurred(x, y - 1) + blurred(x, y + 1);
+            if (result(x, y) != correct) {
+                printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                return -1;
+            }
+        }
+    }
+
+    if (!checker->allocated_in_loop) {
+        printf("The output of the Generator was not computed inside the caller's loops\n");
+        return -1;
+    }
+    if (!checker->vectorized) {
+        printf("The schedule of the Generator was not applied\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
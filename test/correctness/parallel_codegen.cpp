@@ -0,0 +1,79 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Halide;
+
+// Count the objects in an archive, skipping the symbol table and the
+// table of long names. Returns -1 if it isn't an archive.
+int count_archive_objects(const std::string &filename) {
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f) {
+        return -1;
+    }
+    char magic[8];
+    if (fread(magic, 1, 8, f) != 8 || memcmp(magic, "!<arch>\n", 8)) {
+        fclose(f);
+        return -1;
+    }
+    int objects = 0;
+    char header[60];
+    while (fread(header, 1, 60, f) == 60) {
+        std::string name(header, 16);
+        long size = atol(std::string(header + 48, 10).c_str());
+        if (name.compare(0, 2, "/ ") && name.compare(0, 3, "// ") &&
+            name.compare(0, 9, "__.SYMDEF")) {
+            objects++;
+        }
+        fseek(f, size + (size & 1), SEEK_CUR);
+    }
+    fclose(f);
+    return objects;
+}
+
+// Compile a pipeline with many parallel loops, each of which becomes a
+// function of its own, with the given number of codegen threads, and
+// return how many objects the static library has.
+int compile_with_threads(const std::string &dir, const char *threads) {
+    static std::string env;
+    env = std::string("HL_CODEGEN_THREADS=") + threads;
+    putenv(&env[0]);
+
+    Var x, y;
+    std::vector<Func> f(8);
+    f[0](x, y) = x + y;
+    for (size_t i = 1; i < f.size(); i++) {
+        f[i](x, y) = f[i - 1](x, y) * 3 + f[i - 1](x + 1, y);
+        f[i].compute_root().parallel(y);
+    }
+
+    Target t = get_host_target().with_feature(Target::NoRuntime);
+    std::string prefix = dir + "/parallel_codegen_" + threads;
+    f.back().compile_to_static_library(prefix, {}, "parallel_codegen", t);
+
+    int objects = count_archive_objects(prefix + (t.os == Target::Windows ? ".lib" : ".a"));
+    Internal::file_unlink(prefix + (t.os == Target::Windows ? ".lib" : ".a"));
+    Internal::file_unlink(prefix + ".h");
+    return objects;
+}
+
+int main(int argc, char **argv) {
+    std::string dir = Internal::dir_make_temp();
+
+    int serial = compile_with_threads(dir, "1");
+    int parallel = compile_with_threads(dir, "4");
+    Internal::dir_rmdir(dir);
+
+    if (serial != 1) {
+        printf("Expected one object with one codegen thread, got %d\n", serial);
+        return -1;
+    }
+    if (parallel <= 1 || parallel > 4) {
+        printf("Expected two to four objects with four codegen threads, got %d\n", parallel);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
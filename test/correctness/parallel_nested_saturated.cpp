@@ -0,0 +1,66 @@
+#include "Halide.h"
+#include <atomic>
+#include <stdio.h>
+
+using namespace Halide;
+
+std::atomic<int> task_count;
+
+int my_do_task(void *user_context, int (*f)(void *, int, uint8_t *), int idx, uint8_t *closure) {
+    task_count++;
+    return f(user_context, idx, closure);
+}
+
+int main(int argc, char **argv) {
+    // Nested parallel loops with many more outer iterations than
+    // threads, so that the inner loops mostly find the pool
+    // saturated, and uneven costs, so that some find it idle. Either
+    // way, every inner task must run exactly once.
+    Var x, y, z;
+    Func f;
+    RDom r(0, 32);
+    f(x, y, z) = 0;
+    f(x, y, z) += select((y + z) % 5 == 0, r * x, 0) + y * z;
+    f.compute_root().parallel(z).parallel(y);
+    f.update().parallel(z).parallel(y);
+
+    Func g;
+    g(x, y, z) = f(x, y, z) + 1;
+
+    const int W = 8, H = 16, D = 100;
+
+    for (int threads : {1, 2, 8}) {
+        static char buf[32];
+        snprintf(buf, sizeof(buf), "HL_NUM_THREADS=%d", threads);
+        putenv(buf);
+        Halide::Internal::JITSharedRuntime::release_all();
+
+        g.set_custom_do_task(my_do_task);
+        g.compile_jit();
+        task_count = 0;
+        Buffer<int> out = g.realize(W, H, D);
+
+        for (int k = 0; k < D; k++) {
+            for (int j = 0; j < H; j++) {
+                for (int i = 0; i < W; i++) {
+                    int correct = ((j + k) % 5 == 0 ? i * (31 * 32 / 2) : 0) + j * k + 1;
+                    if (out(i, j, k) != correct) {
+                        printf("out(%d, %d, %d) = %d instead of %d\n", i, j, k, out(i, j, k), correct);
+                        return -1;
+                    }
+                }
+            }
+        }
+
+        // Each definition runs one task per slice, and one per row of
+        // each slice. Running the inner loops inline doesn't skip
+        // halide_do_task.
+        if (task_count != 2 * (D + D * H)) {
+            printf("Expected %d tasks with %d threads but saw %d\n", 2 * (D + D * H), threads, (int)task_count);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <algorithm>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    const int N = 1000;
+
+    Buffer<int> in(N);
+    for (int i = 0; i < N; i++) {
+        in(i) = (i * 37) % 101 - 50;
+    }
+
+    {
+        // A cumulative sum over a domain that doesn't start at zero
+        // and isn't a multiple of the block size.
+        Func f;
+        Var x, u;
+        RDom r(3, N - 3);
+        f(x) = 7;
+        f(r) = f(r - 1) + in(r);
+
+        Func intm = f.update(0).scan(r, u, 64);
+        intm.compute_root().update(0).parallel(u);
+        f.update(0).parallel(r, 16);
+
+        Buffer<int> out = f.realize(N);
+        int correct = 7;
+        for (int i = 0; i < N; i++) {
+            if (i >= 3) {
+                correct += in(i);
+            }
+            if (out(i) != correct) {
+                printf("cumsum(%d) = %d instead of %d\n", i, out(i), correct);
+                return -1;
+            }
+        }
+    }
+
+    {
+        // A running maximum down each column of an image.
+        Buffer<int> im(64, N);
+        for (int y = 0; y < N; y++) {
+            for (int x = 0; x < 64; x++) {
+                im(x, y) = (x * 13 + y * 7) % 1009;
+            }
+        }
+
+        Func f;
+        Var x, y, u;
+        RDom r(1, N - 1);
+        f(x, y) = im(x, y);
+        f(x, r) = max(f(x, r - 1), im(x, r));
+
+        Func intm = f.update(0).scan(r, u, 32);
+        intm.compute_root().update(0).vectorize(x, 8).parallel(u);
+        f.update(0).vectorize(x, 8).parallel(r, 8);
+
+        Buffer<int> out = f.realize(64, N);
+        for (int x = 0; x < 64; x++) {
+            int correct = im(x, 0);
+            for (int y = 0; y < N; y++) {
+                correct = std::max(correct, im(x, y));
+                if (out(x, y) != correct) {
+                    printf("running max(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <atomic>
+
+using namespace Halide;
+
+std::atomic<int> task_count;
+
+int my_do_task(void *user_context, int (*f)(void *, int, uint8_t *), int idx, uint8_t *closure) {
+    task_count++;
+    return f(user_context, idx, closure);
+}
+
+int main(int argc, char **argv) {
+    // Tasks with very uneven costs, so that idle workers have to steal
+    // from busy ones. Every task must still run exactly once.
+    Var x, y;
+    Func f;
+    RDom r(0, 64);
+    f(x, y) = 0;
+    f(x, y) += select(y % 7 == 0, r * x, 0);
+    f.compute_root().parallel(y);
+    f.update().parallel(y);
+
+    Func g;
+    g(x, y) = f(x, y) + 1;
+
+    const int W = 17, H = 1000;
+
+    for (int threads : {1, 3, 8}) {
+        static char buf[32];
+        snprintf(buf, sizeof(buf), "HL_NUM_THREADS=%d", threads);
+        putenv(buf);
+        Halide::Internal::JITSharedRuntime::release_all();
+
+        g.set_custom_do_task(my_do_task);
+        g.compile_jit();
+        task_count = 0;
+        Buffer<int> out = g.realize(W, H);
+
+        for (int j = 0; j < H; j++) {
+            for (int i = 0; i < W; i++) {
+                int correct = (j % 7 == 0) ? i * (63 * 64 / 2) + 1 : 1;
+                if (out(i, j) != correct) {
+                    printf("out(%d, %d) = %d instead of %d\n", i, j, out(i, j), correct);
+                    return -1;
+                }
+            }
+        }
+
+        // One task per row for the pure definition and one per row for
+        // the update.
+        if (task_count != 2 * H) {
+            printf("Expected %d tasks with %d threads but saw %d\n", 2 * H, threads, (int)task_count);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -1,7 +1,23 @@
 #include "Halide.h"
 #include <stdio.h>
 using namespace Halide;
+using namespace Halide::Internal;
 
+// Count the loops over tile columns inside each loop over tile rows in
+// the lowered code.
+std::vector<int> xo_loops_per_yo_loop;
+class CountTileLoops : public IRMutator2 {
+    using IRMutator2::visit;
+
+    Stmt visit(const For *op) override {
+        if (ends_with(op->name, ".yo")) {
+            xo_loops_per_yo_loop.push_back(0);
+        } else if (ends_with(op->name, ".xo") && !xo_loops_per_yo_loop.empty()) {
+            xo_loops_per_yo_loop.back()++;
+        }
+        return IRMutator2::visit(op);
+    }
+};
 
 int main(int argc, char *argv[]) {
     Buffer<uint8_t> input(1024, 1024, 3);
@@ -47,6 +63,50 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    // Partition the loops over the tiles of a 2D stencil, and the
+    // loops within the tiles along the edges of the image.
+    {
+        Func blur("blur");
+        Var xo("xo"), yo("yo"), xi("xi"), yi("yi");
+        Func in = Halide::BoundaryConditions::repeat_edge(input);
+        blur(x, y) = (in(x - 2, y - 2, 0) + in(x + 2, y - 2, 0) +
+                      in(x - 2, y + 2, 0) + in(x + 2, y + 2, 0));
+        blur.tile(x, y, xo, yo, xi, yi, 48, 24).vectorize(xi, 8);
+        blur.add_custom_lowering_pass(new CountTileLoops);
+
+        Buffer<uint8_t> out = blur.realize(1024, 1024);
+
+        // The loop over tile rows should be split into a prologue, a
+        // steady state, and an epilogue, and the loop over tile columns
+        // should be split the same way in each of them.
+        if (xo_loops_per_yo_loop.size() != 3) {
+            printf("Expected the loop over tile rows to be split in 3, not %d\n",
+                   (int)xo_loops_per_yo_loop.size());
+            return -1;
+        }
+        for (size_t i = 0; i < xo_loops_per_yo_loop.size(); i++) {
+            if (xo_loops_per_yo_loop[i] != 3) {
+                printf("Expected the loop over tile columns in section %d of the loop over tile rows "
+                       "to be split in 3, not %d\n", (int)i, xo_loops_per_yo_loop[i]);
+                return -1;
+            }
+        }
+
+        for (int y = 0; y < out.height(); y++) {
+            for (int x = 0; x < out.width(); x++) {
+                auto clamped = [&](int x, int y) {
+                    return input(std::min(std::max(x, 0), 1023), std::min(std::max(y, 0), 1023), 0);
+                };
+                uint8_t correct = (clamped(x - 2, y - 2) + clamped(x + 2, y - 2) +
+                                   clamped(x - 2, y + 2) + clamped(x + 2, y + 2));
+                if (out(x, y) != correct) {
+                    printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
     printf("Success!\n");
     return 0;
 }
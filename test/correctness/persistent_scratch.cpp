@@ -0,0 +1,110 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+void *last_input_host = nullptr;
+int mallocs = 0;
+
+void *counting_malloc(void *user_context, size_t size) {
+    __sync_fetch_and_add(&mallocs, 1);
+    void *orig = malloc(size + 32);
+    void *ptr = (void *)((((size_t)orig + 32) >> 5) << 5);
+    ((void **)ptr)[-1] = orig;
+    return ptr;
+}
+
+void counting_free(void *user_context, void *ptr) {
+    free(((void **)ptr)[-1]);
+}
+
+// Copies its input to its output, and records where the input lives.
+extern "C" DLLEXPORT int copy_and_record(halide_buffer_t *in, halide_buffer_t *out) {
+    if (in->is_bounds_query()) {
+        for (int i = 0; i < 2; i++) {
+            in->dim[i].min = out->dim[i].min;
+            in->dim[i].extent = out->dim[i].extent;
+        }
+        return 0;
+    }
+    last_input_host = in->host;
+    Halide::Runtime::Buffer<int>(*out).copy_from(Halide::Runtime::Buffer<int>(*in));
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    // The shared runtime is built for the first target used, so make
+    // sure this one has the scratch arena.
+    Internal::JITSharedRuntime::release_all();
+    Target t = get_jit_target_from_environment().with_feature(Target::PersistentScratch);
+
+    Var x, y;
+    Func f, g;
+    f(x, y) = x * 3 + y;
+    f.compute_root();
+    g.define_extern("copy_and_record", {f}, Int(32), 2);
+    g.compile_jit(t);
+
+    void *first_host = nullptr;
+    for (int size : {256, 256, 128, 256, 64}) {
+        Buffer<int> out(size, size);
+        g.realize(out, t);
+        for (int j = 0; j < out.height(); j++) {
+            for (int i = 0; i < out.width(); i++) {
+                if (out(i, j) != i * 3 + j) {
+                    printf("out(%d, %d) = %d instead of %d\n", i, j, out(i, j), i * 3 + j);
+                    return -1;
+                }
+            }
+        }
+
+        // Every call after the first, none of which needs more than
+        // the first, should get the same block for f.
+        if (first_host == nullptr) {
+            first_host = last_input_host;
+        } else if (last_input_host != first_host) {
+            printf("Storage for f was not reused: %p vs %p\n", last_input_host, first_host);
+            return -1;
+        }
+    }
+
+    {
+        // Each task of a parallel loop allocates the same amount of
+        // scratch, which the worker threads reuse across tasks.
+        Func h, k;
+        h(x, y) = x * 3 + y;
+        k(x, y) = h(x, y) + h(x + 1, y);
+        h.compute_at(k, y);
+        k.parallel(y);
+        k.set_custom_allocator(counting_malloc, counting_free);
+        k.compile_jit(t);
+
+        const int rows = 256;
+        for (int iter = 0; iter < 4; iter++) {
+            Buffer<int> out = k.realize(1024, rows, t);
+            for (int j = 0; j < out.height(); j++) {
+                for (int i = 0; i < out.width(); i++) {
+                    int correct = i * 6 + 3 + j * 2;
+                    if (out(i, j) != correct) {
+                        printf("out(%d, %d) = %d instead of %d\n", i, j, out(i, j), correct);
+                        return -1;
+                    }
+                }
+            }
+        }
+
+        if (mallocs >= rows) {
+            printf("%d calls to halide_malloc for %d tasks of a parallel loop\n", mallocs, 4 * rows);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
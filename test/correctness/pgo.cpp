@@ -0,0 +1,74 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+
+// A pipeline with a specialization and some branches to count.
+Func make_pipeline(Param<int> &p) {
+    Func f, g;
+    Var x;
+    f(x) = select(x % 3 == 0, x * 2, x - 1);
+    g(x) = f(x) + p;
+    f.compute_root();
+    g.specialize(p > 10).vectorize(x, 8);
+    return g;
+}
+
+int check(const Buffer<int> &out, int p) {
+    for (int i = 0; i < out.width(); i++) {
+        int correct = (i % 3 == 0 ? i * 2 : i - 1) + p;
+        if (out(i) != correct) {
+            printf("out(%d) = %d instead of %d\n", i, out(i), correct);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("Skipping test on windows\n");
+    return 0;
+#else
+    std::string profile = Internal::get_test_tmp_dir() + "pgo_test.pgo";
+    Internal::ensure_no_file_exists(profile);
+    setenv("HL_PGO_OUTPUT", profile.c_str(), 1);
+
+    // Run an instrumented pipeline. The profile is written when the
+    // compiled code is freed.
+    {
+        Param<int> p;
+        Func g = make_pipeline(p);
+        Target t = get_jit_target_from_environment().with_feature(Target::PGOInstrument);
+        for (int i = 0; i < 4; i++) {
+            p.set(i * 5);
+            Buffer<int> out = g.realize(100, t);
+            if (check(out, i * 5)) {
+                return -1;
+            }
+        }
+    }
+
+    Internal::assert_file_exists(profile);
+
+    // Compile again using the profile.
+    setenv("HL_PGO_PROFILE", profile.c_str(), 1);
+    {
+        Param<int> p;
+        Func g = make_pipeline(p);
+        p.set(17);
+        Buffer<int> out = g.realize(100);
+        if (check(out, 17)) {
+            return -1;
+        }
+    }
+    unsetenv("HL_PGO_PROFILE");
+
+    printf("Success!\n");
+    return 0;
+#endif
+}
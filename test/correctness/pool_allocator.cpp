@@ -0,0 +1,41 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    // The shared runtime is built for the first target used, so make
+    // sure this one has the pool allocator.
+    Internal::JITSharedRuntime::release_all();
+    Target t = get_jit_target_from_environment().with_feature(Target::PoolAllocator);
+
+    // Per-tile scratch allocations of varying size inside a parallel
+    // loop, which all go through halide_malloc and halide_free.
+    Param<int> tile_size;
+    Var x, y, xo, yo, xi, yi;
+    Func f, g;
+    f(x, y) = x * 3 + y;
+    g(x, y) = f(x, y) + f(x + 1, y + 1);
+    g.tile(x, y, xo, yo, xi, yi, tile_size, tile_size).parallel(yo);
+    f.compute_at(g, xo);
+    g.compile_jit(t);
+
+    for (int size : {4, 13, 64, 200, 8}) {
+        tile_size.set(size);
+        for (int iter = 0; iter < 3; iter++) {
+            Buffer<int> out = g.realize(500, 300, t);
+            for (int j = 0; j < out.height(); j++) {
+                for (int i = 0; i < out.width(); i++) {
+                    int correct = (i * 3 + j) + ((i + 1) * 3 + j + 1);
+                    if (out(i, j) != correct) {
+                        printf("out(%d, %d) = %d instead of %d\n", i, j, out(i, j), correct);
+                        return -1;
+                    }
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
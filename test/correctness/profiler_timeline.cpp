@@ -0,0 +1,75 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+using namespace Halide;
+
+void my_print(void *, const char *) {
+    // Silence the profiler report.
+}
+
+int count_occurrences(const std::string &str, const std::string &pattern) {
+    int count = 0;
+    for (size_t pos = str.find(pattern); pos != std::string::npos; pos = str.find(pattern, pos + 1)) {
+        count++;
+    }
+    return count;
+}
+
+int main(int argc, char **argv) {
+    static std::string timeline_file = Internal::file_make_temp("profiler_timeline", ".json");
+    static std::string env = "HL_PROFILER_TIMELINE_FILE=" + timeline_file;
+    putenv(&env[0]);
+
+    Var x("x"), y("y");
+    Func f("f"), g("g");
+    f(x, y) = x + y;
+    g(x, y) = f(x, y) + f(x + 1, y);
+    f.compute_root().parallel(y);
+    g.parallel(y);
+    g.set_custom_print(&my_print);
+
+    Target t = get_jit_target_from_environment().with_feature(Target::ProfileTimeline);
+    Buffer<int> out = g.realize(256, 64, t);
+
+    std::ifstream in(timeline_file);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    std::string json = contents.str();
+    Internal::file_unlink(timeline_file);
+
+    if (json.find("{\"traceEvents\":[") != 0) {
+        printf("Timeline doesn't look like Chrome trace JSON:\n%s\n", json.c_str());
+        return -1;
+    }
+
+    int begins = count_occurrences(json, "\"ph\":\"B\"");
+    int ends = count_occurrences(json, "\"ph\":\"E\"");
+    if (begins == 0 || begins != ends) {
+        printf("Unbalanced timeline: %d begin and %d end events\n", begins, ends);
+        return -1;
+    }
+
+    // One realization of the pipeline, at least one task of each
+    // parallel loop, and a span for each Func.
+    if (count_occurrences(json, "\"cat\":\"pipeline\"") != 1) {
+        printf("Expected one pipeline span:\n%s\n", json.c_str());
+        return -1;
+    }
+    if (count_occurrences(json, "\"cat\":\"task\",\"name\":\"f\"") < 1 ||
+        count_occurrences(json, "\"cat\":\"task\",\"name\":\"g\"") < 1) {
+        printf("Missing parallel task spans:\n%s\n", json.c_str());
+        return -1;
+    }
+    if (count_occurrences(json, "\"cat\":\"func\",\"name\":\"f\"") < 1 ||
+        count_occurrences(json, "\"cat\":\"func\",\"name\":\"g\"") < 1) {
+        printf("Missing func spans:\n%s\n", json.c_str());
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
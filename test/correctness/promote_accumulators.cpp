@@ -0,0 +1,115 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Counts the stores to a buffer inside a loop.
+class CountStoresInLoop : public IRMutator2 {
+public:
+    std::string buffer, loop;
+    int count = 0;
+
+    CountStoresInLoop(const std::string &b, const std::string &l) : buffer(b), loop(l) {}
+
+    Stmt mutate(const Stmt &s) override {
+        struct Counter : public IRVisitor {
+            const CountStoresInLoop &parent;
+            int count = 0, in_loop = 0;
+            using IRVisitor::visit;
+            void visit(const For *op) override {
+                bool is_loop = ends_with(op->name, parent.loop);
+                in_loop += is_loop;
+                IRVisitor::visit(op);
+                in_loop -= is_loop;
+            }
+            void visit(const Store *op) override {
+                if (in_loop && op->name == parent.buffer) {
+                    count++;
+                }
+                IRVisitor::visit(op);
+            }
+            Counter(const CountStoresInLoop &p) : parent(p) {}
+        } counter(*this);
+        s.accept(&counter);
+        count = counter.count;
+        return s;
+    }
+};
+
+int main(int argc, char **argv) {
+    const int N = 64, K = 48;
+    Buffer<float> A(K, N), B(N, K);
+    for (int y = 0; y < N; y++) {
+        for (int x = 0; x < K; x++) {
+            A(x, y) = (float)((x + 2 * y) % 7) - 3.0f;
+            B(y, x) = (float)((3 * x + y) % 5) - 2.0f;
+        }
+    }
+
+    {
+        // A matrix multiply that accumulates 8x4 tiles of the output,
+        // vectorized and unrolled.
+        Var x("x"), y("y"), xi("xi"), yi("yi");
+        RDom r(0, K, "r");
+        Func prod("prod"), out("out");
+        prod(x, y) = 0.0f;
+        prod(x, y) += A(r, y) * B(x, r);
+        out(x, y) = prod(x, y);
+
+        out.tile(x, y, xi, yi, 8, 4).vectorize(xi).unroll(yi);
+        prod.compute_at(out, x).vectorize(x).unroll(y);
+        prod.update().reorder(x, y, r).vectorize(x).unroll(y);
+
+        CountStoresInLoop *counter = new CountStoresInLoop("prod", "r$x");
+        out.add_custom_lowering_pass(counter);
+        Buffer<float> result = out.realize(N, N);
+
+        if (counter->count != 0) {
+            printf("There were %d stores to the accumulators in the reduction loop\n", counter->count);
+            return -1;
+        }
+
+        for (int y = 0; y < N; y++) {
+            for (int x = 0; x < N; x++) {
+                float correct = 0.0f;
+                for (int k = 0; k < K; k++) {
+                    correct += A(k, y) * B(x, k);
+                }
+                if (result(x, y) != correct) {
+                    printf("result(%d, %d) = %f instead of %f\n", x, y, result(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    {
+        // A reduction whose extent is a parameter, which may be zero,
+        // into the root output.
+        Param<int> extent;
+        Var x("x");
+        RDom r(0, extent, "r");
+        Func f("f");
+        f(x) = cast<float>(x);
+        f(x) += A(r, x);
+
+        for (int e : {0, 5}) {
+            extent.set(e);
+            Buffer<float> result = f.realize(N);
+            for (int x = 0; x < N; x++) {
+                float correct = (float)x;
+                for (int k = 0; k < e; k++) {
+                    correct += A(k, x);
+                }
+                if (result(x) != correct) {
+                    printf("f(%d) = %f instead of %f\n", x, result(x), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// A reference Philox4x32-10.
+void philox(uint32_t c[4], const uint32_t key[2]) {
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; round++) {
+        uint64_t p0 = (uint64_t)c[0] * 0xD2511F53;
+        uint64_t p1 = (uint64_t)c[2] * 0xCD9E8D57;
+        uint32_t c0 = (uint32_t)(p1 >> 32) ^ c[1] ^ k0;
+        uint32_t c2 = (uint32_t)(p0 >> 32) ^ c[3] ^ k1;
+        c[0] = c0;
+        c[1] = (uint32_t)p1;
+        c[2] = c2;
+        c[3] = (uint32_t)p0;
+        k0 += 0x9E3779B9;
+        k1 += 0xBB67AE85;
+    }
+}
+
+std::vector<Expr> u32s(const std::vector<uint32_t> &v) {
+    std::vector<Expr> result;
+    for (uint32_t i : v) {
+        result.push_back(make_const(UInt(32), i));
+    }
+    return result;
+}
+
+int main(int argc, char **argv) {
+    Var x, y;
+
+    // Known answers, from the Random123 test vectors.
+    {
+        struct {
+            std::vector<uint32_t> counter, key;
+            uint64_t result;
+        } tests[] = {
+            {{0, 0, 0, 0}, {0, 0}, 0xe169c58d6627e8d5ULL},
+            {{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff}, 0x41c83b0e408f276dULL},
+            {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0}, 0x94fdccebd16cfe09ULL},
+        };
+        for (const auto &test : tests) {
+            Func f;
+            f() = random_philox(u32s(test.counter), u32s(test.key), 64);
+            Buffer<uint64_t> out = f.realize();
+            if (out() != test.result) {
+                printf("Philox gave %llx instead of %llx\n",
+                       (unsigned long long)out(), (unsigned long long)test.result);
+                return -1;
+            }
+        }
+    }
+
+    // The vectorized generator matches the reference.
+    {
+        const uint32_t key[2] = {12345, 678};
+        Func f;
+        f(x, y) = random_philox({cast<uint32_t>(x), cast<uint32_t>(y), make_zero(UInt(32)), make_zero(UInt(32))},
+                                u32s({key[0], key[1]}), 64);
+        f.vectorize(x, 8);
+        Buffer<uint64_t> out = f.realize(64, 16);
+        for (int j = 0; j < 16; j++) {
+            for (int i = 0; i < 64; i++) {
+                uint32_t c[4] = {(uint32_t)i, (uint32_t)j, 0, 0};
+                philox(c, key);
+                uint64_t correct = ((uint64_t)c[1] << 32) | c[0];
+                if (out(i, j) != correct) {
+                    printf("out(%d, %d) = %llx instead of %llx\n", i, j,
+                           (unsigned long long)out(i, j), (unsigned long long)correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    const double tol = 0.01;
+
+    // Random floats from Philox have the right statistics, and don't
+    // depend on the schedule.
+    {
+        Func f;
+        f(x, y) = random_float(Expr(), RandomGenerator::Philox);
+        Buffer<float> scalar = f.realize(1024, 1024);
+        f.vectorize(x, 16).parallel(y);
+        Buffer<float> vectorized = f.realize(1024, 1024);
+
+        double sum = 0, sum_sq = 0, sum_dx = 0;
+        for (int j = 0; j < 1024; j++) {
+            for (int i = 0; i < 1024; i++) {
+                float v = vectorized(i, j);
+                if (v != scalar(i, j) || v < 0.0f || v >= 1.0f) {
+                    printf("Bad random float at %d, %d: %f %f\n", i, j, v, scalar(i, j));
+                    return -1;
+                }
+                sum += v;
+                sum_sq += v * v;
+                if (i > 0) {
+                    double dx = v - vectorized(i - 1, j);
+                    sum_dx += dx * dx;
+                }
+            }
+        }
+        double n = 1024 * 1024;
+        double mean = sum / n;
+        double variance = sum_sq / n - mean * mean;
+        double variance_dx = sum_dx / (n - 1024);
+        if (fabs(mean - 0.5) > tol || fabs(variance - 1.0 / 12) > tol || fabs(variance_dx - 1.0 / 6) > tol) {
+            printf("Bad statistics: mean %f, variance %f, variance of dx %f\n", mean, variance, variance_dx);
+            return -1;
+        }
+    }
+
+    // All 64 bits of random_uint64 are random, and the same seed gives
+    // the same values, while different seeds and different calls don't.
+    {
+        Param<int> seed;
+        Expr r1 = random_uint64(seed), r2 = random_uint64(seed);
+        Func f;
+        f(x, y) = Tuple(r1, r2);
+        f.vectorize(x, 4);
+
+        seed.set(3);
+        Realization a = f.realize(256, 256);
+        Realization b = f.realize(256, 256);
+        seed.set(4);
+        Realization c = f.realize(256, 256);
+        Buffer<uint64_t> a1 = a[0], a2 = a[1], b1 = b[0], c1 = c[0];
+
+        int bit_counts[64] = {0};
+        int same_calls = 0, same_seeds = 0;
+        for (int j = 0; j < 256; j++) {
+            for (int i = 0; i < 256; i++) {
+                if (a1(i, j) != b1(i, j)) {
+                    printf("The same seed gave different values at %d, %d\n", i, j);
+                    return -1;
+                }
+                same_calls += a1(i, j) == a2(i, j);
+                same_seeds += a1(i, j) == c1(i, j);
+                for (int bit = 0; bit < 64; bit++) {
+                    bit_counts[bit] += (a1(i, j) >> bit) & 1;
+                }
+            }
+        }
+        if (same_calls || same_seeds) {
+            printf("Independent random variables were equal %d and %d times\n", same_calls, same_seeds);
+            return -1;
+        }
+        for (int bit = 0; bit < 64; bit++) {
+            if (fabs(bit_counts[bit] / (256.0 * 256) - 0.5) > tol) {
+                printf("Bit %d was set %d times out of %d\n", bit, bit_counts[bit], 256 * 256);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include "Halide.h"
+#include <algorithm>
+#include <stdio.h>
+
+using namespace Halide;
+
+template<typename T>
+int check(const Buffer<T> &in, const Buffer<T> &out, int radius_x, int radius_y, int rank, const char *name) {
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            std::vector<T> window;
+            for (int dy = -radius_y; dy <= radius_y; dy++) {
+                for (int dx = -radius_x; dx <= radius_x; dx++) {
+                    int cx = std::min(std::max(x + dx, 0), in.width() - 1);
+                    int cy = std::min(std::max(y + dy, 0), in.height() - 1);
+                    window.push_back(in(cx, cy));
+                }
+            }
+            std::sort(window.begin(), window.end());
+            if (out(x, y) != window[rank]) {
+                printf("%s with radius %d x %d and rank %d: out(%d, %d) = %f instead of %f\n",
+                       name, radius_x, radius_y, rank, x, y,
+                       (double)out(x, y), (double)window[rank]);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const int W = 150, H = 77;
+    Buffer<uint8_t> in(W, H);
+    Buffer<float> in_f(W, H);
+    srand(0);
+    // Few enough distinct values that there are plenty of ties.
+    in.for_each_element([&](int x, int y) { in(x, y) = (uint8_t)(rand() % 64 + (x + y) % 128); });
+    in_f.for_each_element([&](int x, int y) { in_f(x, y) = (rand() % 1000) / 10.0f; });
+
+    Func clamped = BoundaryConditions::repeat_edge(in);
+    Func clamped_f = BoundaryConditions::repeat_edge(in_f);
+
+    // Sorting networks, including a rectangular window.
+    struct {
+        int radius_x, radius_y;
+    } windows[] = {{1, 1}, {2, 1}, {2, 2}};
+    for (auto w : windows) {
+        const int n = (2 * w.radius_x + 1) * (2 * w.radius_y + 1);
+        for (int rank : {0, n / 3, n / 2, n - 1}) {
+            Func f = RankFilters::sorting_network_rank_filter(clamped_f, w.radius_x, w.radius_y, rank);
+            f.vectorize(f.args()[0], 8);
+            Buffer<float> out = f.realize(W, H);
+            if (check(in_f, out, w.radius_x, w.radius_y, rank, "sorting_network_rank_filter")) {
+                return -1;
+            }
+        }
+    }
+
+    // Sliding histograms, with tiles that don't divide the output.
+    for (int radius : {0, 1, 4, 9}) {
+        const int n = (2 * radius + 1) * (2 * radius + 1);
+        for (int rank : {0, n / 2, n - 1}) {
+            Func f = RankFilters::histogram_rank_filter(clamped, radius, rank, 32, 8);
+            Buffer<uint8_t> out = f.realize(W, H);
+            if (check(in, out, radius, radius, rank, "histogram_rank_filter")) {
+                return -1;
+            }
+        }
+    }
+
+    {
+        const int radius = 3, n = 49;
+        Param<int> rank;
+        Func f = RankFilters::histogram_rank_filter(clamped, radius, rank, 16, 4);
+        for (int r = 0; r < n; r += 7) {
+            rank.set(r);
+            Buffer<uint8_t> out = f.realize(W, H);
+            if (check(in, out, radius, radius, r, "histogram_rank_filter with a rank parameter")) {
+                return -1;
+            }
+        }
+    }
+
+    // The median of a large window goes through the histogram.
+    Buffer<uint8_t> out = RankFilters::median_filter(clamped, 6).realize(W, H);
+    if (check(in, out, 6, 6, 13 * 13 / 2, "median_filter")) {
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
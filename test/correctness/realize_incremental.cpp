@@ -0,0 +1,80 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    const int W = 64, H = 48;
+    const int sentinel = -12345;
+
+    ImageParam in(Int(32), 2);
+    Var x, y;
+
+    // A 3x3 blur, and then a 2x downsample of it.
+    Func clamped = BoundaryConditions::repeat_edge(in);
+    Func blur_x, blur;
+    blur_x(x, y) = clamped(x - 1, y) + clamped(x, y) + clamped(x + 1, y);
+    blur(x, y) = blur_x(x, y - 1) + blur_x(x, y) + blur_x(x, y + 1);
+    blur_x.compute_root();
+    blur.compute_root();
+    Func down;
+    down(x, y) = blur(2 * x, 2 * y);
+
+    Pipeline p(down);
+
+    Buffer<int> input(W, H);
+    input.for_each_element([&](int x, int y) { input(x, y) = x * 3 + y * 7; });
+    in.set(input);
+
+    Buffer<int> output(W / 2, H / 2);
+    p.realize(output);
+
+    // Change a small region of the input, then fill the output with a
+    // sentinel, so we can check what got recomputed.
+    const int x0 = 20, y0 = 10, w = 4, h = 3;
+    for (int y = y0; y < y0 + h; y++) {
+        for (int x = x0; x < x0 + w; x++) {
+            input(x, y) = 1000 + x - y;
+        }
+    }
+    output.fill(sentinel);
+
+    auto region = p.realize_incremental(output, in, {{x0, w}, {y0, h}});
+
+    // The blur widens the dirty region by one in each direction, and
+    // the downsample halves it.
+    auto correct_region = [](int min, int extent) {
+        int lo = (min - 1 + 1) / 2;
+        int hi = (min + extent) / 2;
+        return std::make_pair(lo, hi - lo + 1);
+    };
+    if (region.size() != 2 ||
+        region[0] != correct_region(x0, w) ||
+        region[1] != correct_region(y0, h)) {
+        printf("Recomputed the wrong region\n");
+        return -1;
+    }
+
+    Buffer<int> correct = p.realize(W / 2, H / 2);
+    for (int y = 0; y < H / 2; y++) {
+        for (int x = 0; x < W / 2; x++) {
+            bool recomputed = (x >= region[0].first && x < region[0].first + region[0].second &&
+                               y >= region[1].first && y < region[1].first + region[1].second);
+            int expected = recomputed ? correct(x, y) : sentinel;
+            if (output(x, y) != expected) {
+                printf("output(%d, %d) = %d instead of %d\n", x, y, output(x, y), expected);
+                return -1;
+            }
+        }
+    }
+
+    // A change outside the footprint of the output recomputes nothing.
+    region = p.realize_incremental(output, in, {{W + 10, 4}, {0, 4}});
+    if (!region.empty()) {
+        printf("Recomputed a region that doesn't depend on the change\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
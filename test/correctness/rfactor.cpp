@@ -864,6 +864,50 @@ int argmin_rfactor_test() {
     return 0;
 }
 
+// An argmax/argmin written the way Halide::argmax and Halide::argmin
+// write it: the index first and the value last.
+int inline_argmax_rfactor_test(bool is_max) {
+    Func f("f"), g("g");
+    Var x("x"), y("y"), u("u");
+
+    // The values are distinct, so the extremum is unique.
+    f(x, y) = ((x + y * 64) * 997) % 2048;
+    f.compute_root();
+
+    RDom r(0, 64, 0, 32);
+    Expr value = f(r.x, r.y);
+    g() = Tuple(0, 0, is_max ? Int(32).min() : Int(32).max());
+    Expr better = is_max ? value > g()[2] : value < g()[2];
+    g() = tuple_select(better, Tuple(r.x, r.y, value), g());
+
+    RVar rxo("rxo"), rxi("rxi");
+    g.update(0).split(r.x, rxo, rxi, 8);
+    Func intm = g.update(0).rfactor(rxi, u);
+    intm.compute_root().vectorize(u, 8);
+    intm.update(0).vectorize(u, 8);
+
+    Realization rn = g.realize();
+    Buffer<int> im_x(rn[0]), im_y(rn[1]), im_value(rn[2]);
+
+    int correct_x = 0, correct_y = 0, correct_value = is_max ? -1 : 2048;
+    for (int j = 0; j < 32; j++) {
+        for (int i = 0; i < 64; i++) {
+            int v = ((i + j * 64) * 997) % 2048;
+            if (is_max ? v > correct_value : v < correct_value) {
+                correct_x = i;
+                correct_y = j;
+                correct_value = v;
+            }
+        }
+    }
+    if (im_x() != correct_x || im_y() != correct_y || im_value() != correct_value) {
+        printf("%s was (%d, %d, %d) instead of (%d, %d, %d)\n", is_max ? "argmax" : "argmin",
+               im_x(), im_y(), im_value(), correct_x, correct_y, correct_value);
+        return -1;
+    }
+    return 0;
+}
+
 int allocation_bound_test_trace(void *user_context, const halide_trace_event_t *e) {
     // The schedule implies that f will be stored from 0 to 1
     if (e->event == 2 && std::string(e->func) == "f") {
@@ -1192,6 +1236,16 @@ int main(int argc, char **argv) {
         return -1;
     }
 
+    printf("Running inline argmax rfactor test\n");
+    if (inline_argmax_rfactor_test(true) != 0) {
+        return -1;
+    }
+
+    printf("Running inline argmin rfactor test\n");
+    if (inline_argmax_rfactor_test(false) != 0) {
+        return -1;
+    }
+
     printf("Success!\n");
     return 0;
 }
@@ -0,0 +1,85 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+// Build the same pipeline each time, with explicit names, as a
+// restarted process would.
+Pipeline make_pipeline(Buffer<float> input, int radius) {
+    Var x("x"), y("y");
+    Func blur_x("blur_x"), blur_y("blur_y");
+    Expr bx = 0.0f, by = 0.0f;
+    for (int i = 0; i <= 2 * radius; i++) {
+        bx += input(x + i, y);
+        by += blur_x(x, y + i);
+    }
+    blur_x(x, y) = bx;
+    blur_y(x, y) = by;
+    blur_y.estimate(x, 0, 256).estimate(y, 0, 256);
+    return Pipeline(blur_y);
+}
+
+int main(int argc, char **argv) {
+    Target target = get_host_target();
+
+    Buffer<float> input(256 + 4, 256 + 4);
+    for (int y = 0; y < input.height(); y++) {
+        for (int x = 0; x < input.width(); x++) {
+            input(x, y) = (x * 7 + y * 13) % 17;
+        }
+    }
+
+    Pipeline p1 = make_pipeline(input, 1);
+    std::string fingerprint = pipeline_fingerprint(p1, target);
+    if (pipeline_fingerprint(make_pipeline(input, 1), target) != fingerprint) {
+        printf("The same pipeline has a different fingerprint\n");
+        return -1;
+    }
+    if (pipeline_fingerprint(make_pipeline(input, 2), target) == fingerprint) {
+        printf("A different pipeline has the same fingerprint\n");
+        return -1;
+    }
+
+    std::string dir = Internal::dir_make_temp();
+    ScheduleDatabase db(dir);
+    if (!db.lookup(fingerprint).empty()) {
+        printf("Found a schedule in an empty database\n");
+        return -1;
+    }
+
+    std::string schedule = p1.auto_schedule(target);
+    db.store(fingerprint, schedule);
+    Buffer<float> out1 = p1.realize(256, 256, target);
+
+    // Schedule a new instance of the pipeline from the database.
+    Pipeline p2 = make_pipeline(input, 1);
+    std::string stored = db.lookup(pipeline_fingerprint(p2, target));
+    if (stored != schedule) {
+        printf("The stored schedule doesn't match:\n%s\n", stored.c_str());
+        return -1;
+    }
+    apply_schedule(p2, stored);
+    Buffer<float> out2 = p2.realize(256, 256, target);
+
+    for (int y = 0; y < 256; y++) {
+        for (int x = 0; x < 256; x++) {
+            float correct = 0.0f;
+            for (int j = 0; j < 3; j++) {
+                for (int i = 0; i < 3; i++) {
+                    correct += input(x + i, y + j);
+                }
+            }
+            if (out1(x, y) != correct || out2(x, y) != correct) {
+                printf("out(%d, %d) = %f and %f instead of %f\n",
+                       x, y, out1(x, y), out2(x, y), correct);
+                return -1;
+            }
+        }
+    }
+
+    Internal::file_unlink(dir + "/" + fingerprint + ".schedule");
+    Internal::dir_rmdir(dir);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Halide;
+
+int mallocs = 0;
+size_t live_bytes = 0, peak_bytes = 0;
+
+void *my_malloc(void *user_context, size_t x) {
+    mallocs++;
+    live_bytes += x;
+    if (live_bytes > peak_bytes) {
+        peak_bytes = live_bytes;
+    }
+    void *orig = malloc(x + 256);
+    void *ptr = (void *)((((size_t)orig + 256) >> 7) << 7);
+    ((void **)ptr)[-1] = orig;
+    ((size_t *)ptr)[-2] = x;
+    return ptr;
+}
+
+void my_free(void *user_context, void *ptr) {
+    live_bytes -= ((size_t *)ptr)[-2];
+    free(((void **)ptr)[-1]);
+}
+
+bool run(bool share, int *num_mallocs, size_t *peak) {
+    // A chain of compute_root stages, each a stencil of the last.
+    const int stages = 10;
+    Var x;
+    std::vector<Func> f(stages);
+    f[0](x) = x;
+    for (int i = 1; i < stages; i++) {
+        f[i](x) = f[i - 1](x - 1) + f[i - 1](x + 1);
+        f[i].compute_root();
+    }
+    Func out;
+    out(x) = f[stages - 1](x);
+    out.set_custom_allocator(my_malloc, my_free);
+
+    Target t = get_jit_target_from_environment();
+    if (share) {
+        t.set_feature(Target::ShareAllocations);
+    }
+
+    mallocs = 0;
+    live_bytes = peak_bytes = 0;
+    Buffer<int> result = out.realize(100000, t);
+    for (int i = 0; i < result.width(); i++) {
+        // Each stage doubles the sum of its inputs.
+        int correct = i << (stages - 1);
+        if (result(i) != correct) {
+            printf("result(%d) = %d instead of %d\n", i, result(i), correct);
+            return false;
+        }
+    }
+    *num_mallocs = mallocs;
+    *peak = peak_bytes;
+    return true;
+}
+
+bool error_occurred = false;
+void my_error(void *user_context, const char *msg) {
+    printf("Expected: %s\n", msg);
+    error_occurred = true;
+}
+
+// The same chain of stages, but each one has more than 2^31 - 1
+// elements, so the shared storage would be too large.
+bool too_large_is_caught() {
+    const int stages = 4;
+    Var x, y;
+    Param<int> rows;
+    std::vector<Func> f(stages);
+    f[0](x, y) = x + y;
+    for (int i = 1; i < stages; i++) {
+        f[i](x, y) = f[i - 1](x, y) + 1;
+        f[i].compute_root();
+    }
+    Func out;
+    out(x) = f[stages - 1](x, 0) + f[stages - 1](x, rows);
+    out.set_custom_allocator(my_malloc, my_free);
+    out.set_error_handler(my_error);
+
+    Target t = get_jit_target_from_environment().with_feature(Target::ShareAllocations);
+    rows.set(1 << 16);
+    error_occurred = false;
+    mallocs = 0;
+    out.realize(1 << 16, t);
+    if (!error_occurred) {
+        printf("There should have been an error for storage of 2^32 elements\n");
+        return false;
+    }
+    // The size check comes before the shared storage is allocated.
+    if (mallocs > 1) {
+        printf("%d allocations made before the size check failed\n", mallocs);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    int separate_mallocs, shared_mallocs;
+    size_t separate_peak, shared_peak;
+    if (!run(false, &separate_mallocs, &separate_peak) ||
+        !run(true, &shared_mallocs, &shared_peak)) {
+        return -1;
+    }
+
+    // Each stage is freed once the next one is done, so two blocks of
+    // memory suffice for the whole chain.
+    if (shared_mallocs > 2 || shared_mallocs >= separate_mallocs) {
+        printf("%d allocations when sharing memory, and %d without\n",
+               shared_mallocs, separate_mallocs);
+        return -1;
+    }
+
+    // Sharing shouldn't use more memory at once.
+    if (shared_peak > separate_peak + 1024) {
+        printf("Peak memory use of %d bytes when sharing memory, and %d without\n",
+               (int)shared_peak, (int)separate_peak);
+        return -1;
+    }
+
+    if (get_jit_target_from_environment().bits == 64 && !too_large_is_caught()) {
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -53,6 +53,7 @@ struct Test {
     bool use_avx512_skylake{false};
     bool use_avx{false};
     bool use_power_arch_2_07{false};
+    bool use_power_arch_3_00{false};
     bool use_sse41{false};
     bool use_sse42{false};
     bool use_ssse3{false};
@@ -85,7 +86,9 @@ struct Test {
             .with_feature(Target::NoRuntime);
         use_avx512_knl = target.has_feature(Target::AVX512_KNL);
         use_avx512_cannonlake = target.has_feature(Target::AVX512_Cannonlake);
-        use_avx512_skylake = use_avx512_cannonlake || target.has_feature(Target::AVX512_Skylake);
+        use_avx512_skylake = (use_avx512_cannonlake ||
+                              target.has_feature(Target::AVX512_Skylake) ||
+                              target.has_feature(Target::AVX512_Cascadelake));
         use_avx512 = use_avx512_knl || use_avx512_skylake || use_avx512_cannonlake || target.has_feature(Target::AVX512);
         use_avx2 = use_avx512 || target.has_feature(Target::AVX2);
         use_avx = use_avx2 || target.has_feature(Target::AVX);
@@ -99,7 +102,9 @@ struct Test {
         use_sse42 = use_avx;
 
         use_vsx = target.has_feature(Target::VSX);
-        use_power_arch_2_07 = target.has_feature(Target::POWER_ARCH_2_07);
+        use_power_arch_3_00 = target.features_any_of({Target::POWER_ARCH_3_00, Target::POWER_ARCH_3_1});
+        use_power_arch_2_07 = target.has_feature(Target::POWER_ARCH_2_07) || use_power_arch_3_00;
+        use_vsx = use_vsx || use_power_arch_3_00;
 
         // We are going to call realize, i.e. we are going to JIT code.
         // Not all platforms support JITting. One indirect yet quick
@@ -1429,6 +1434,30 @@ struct Test {
         // Interleave or deinterleave two vectors. Given that we use
         // interleaving loads and stores, it's hard to hit this op with
         // halide.
+
+        if (target.has_feature(Target::ARMDotProd)) {
+            // UDOT/SDOT X  -       Dot Product
+            // Sums of four widening 8-bit products.
+            Expr u8_4 = in_u8(x+48), u8_5 = in_u8(x+64), u8_6 = in_u8(x+80);
+            Expr i8_4 = in_i8(x+48), i8_5 = in_i8(x+64), i8_6 = in_i8(x+80);
+            for (int w = 1; w <= 2; w++) {
+                check(arm32 ? "vudot.u8" : "udot", 4*w,
+                      u32(u8_1) * u8_2 + u32(u8_3) * 7 + u32(u8_4) * u8_5 + u32(u8_6) * 9);
+                check(arm32 ? "vsdot.s8" : "sdot", 4*w,
+                      i32(i8_1) * i8_2 + i32(i8_3) * -7 + i32(i8_4) * i8_5 + i32(i8_6) * 9);
+            }
+        }
+
+        #if LLVM_VERSION >= 120
+        if (!arm32 && target.features_any_of({Target::SVE_256, Target::SVE_512})) {
+            // LD1W/LD1D X  -       Gather load with vector offsets
+            int w = target.has_feature(Target::SVE_512) ? 16 : 8;
+            check("ld1w", w, in_f32(x*5));
+            check("ld1w", w, in_i32(x*7));
+            check("ld1d", w/2, in_f64(x*5));
+            check("ld1d", w/2, in_u64(x*9));
+        }
+        #endif
     }
 
     void check_hvx_all() {
@@ -2030,6 +2059,20 @@ check("v*.w += vrmpy(v*.b,v*.b)", hvx_width, i32_1 + i32(i8_1)*i8_1 + i32(i8_2)*
             check("vminfp", 4*w, min(f32_1, f32_2));
         }
 
+        // Vector Integer Multiply-Sum Instructions.
+        // Sums of four widening 8-bit or two widening 16-bit products.
+        {
+            Expr u8_4 = in_u8(x+48), i8_4 = in_i8(x+48);
+            for (int w = 1; w <= 2; w++) {
+                check("vmsumubm", 4*w,
+                      u32(u8_1) * u8_2 + u32(u8_3) * 7 + u32(u8_4) * u8_1 + u32(u8_2) * 9);
+                check("vmsummbm", 4*w,
+                      i32(i8_1) * u8_2 + i32(i8_3) * 7 + i32(i8_4) * u8_1 + i32(i8_2) * 9);
+                check("vmsumuhm", 4*w, u32(u16_1) * u16_2 + u32(u16_3) * 5);
+                check("vmsumshm", 4*w, i32(i16_1) * i16_2 + i32(i16_3) * -5);
+            }
+        }
+
         // Check these if target supports VSX.
         if (use_vsx) {
             for (int w = 1; w <= 4; w++) {
@@ -2058,6 +2101,17 @@ check("v*.w += vrmpy(v*.b,v*.b)", hvx_width, i32_1 + i32(i8_1)*i8_1 + i32(i8_2)*
                 check("vminud",  2*w, min(u64_1, u64_2));
             }
         }
+
+        // Check these if target supports POWER ISA 3.00 and above.
+        if (use_power_arch_3_00) {
+            for (int w = 1; w <= 4; w++) {
+                check("vabsdub", 16*w, absd(u8_1, u8_2));
+                check("vabsduh",  8*w, absd(u16_1, u16_2));
+                check("vabsduw",  4*w, absd(u32_1, u32_2));
+                check("vabsdub", 16*w, absd(i8_1, i8_2));
+                check("vabsduw",  4*w, absd(i32_1, i32_2));
+            }
+        }
     }
 
     bool test_all() {
@@ -0,0 +1,42 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+// A boundary condition that loop partitioning would normally split
+// into a prologue, steady state, and epilogue.
+Buffer<int> blur(const Buffer<int> &input, const Target &t) {
+    Var x("x"), y("y");
+    Func bounded = BoundaryConditions::repeat_edge(input);
+    Func f("f");
+    f(x, y) = bounded(x - 1, y) + bounded(x, y) * 2 + bounded(x + 1, y + 1);
+    f.vectorize(x, 8).parallel(y);
+    return f.realize(input.width() + 7, input.height() + 3, t);
+}
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment();
+
+    Buffer<int> input(35, 19);
+    for (int y = 0; y < input.height(); y++) {
+        for (int x = 0; x < input.width(); x++) {
+            input(x, y) = (x * 17 + y * 5) % 31;
+        }
+    }
+
+    Buffer<int> fast = blur(input, t);
+    Buffer<int> small = blur(input, t.with_feature(Target::SizeOptimized));
+
+    for (int y = 0; y < fast.height(); y++) {
+        for (int x = 0; x < fast.width(); x++) {
+            if (fast(x, y) != small(x, y)) {
+                printf("size_optimized result(%d, %d) = %d instead of %d\n",
+                       x, y, small(x, y), fast(x, y));
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+int call_count = 0;
+extern "C" DLLEXPORT int call_counter(int x) {
+    call_count++;
+    return x;
+}
+HalideExtern_1(int, call_counter, int);
+
+int main(int argc, char **argv) {
+    const int W = 128, H = 64, tile = 16;
+
+    // A mask with one entry per tile, with only a few tiles active.
+    Buffer<uint8_t> mask(W / tile, H / tile);
+    mask.fill(0);
+    mask(1, 0) = 1;
+    mask(3, 2) = 1;
+    mask(7, 3) = 1;
+    const int active_tiles = 3;
+
+    Var x, y, xo, yo, xi, yi;
+
+    // An expensive stage that's only needed in the active tiles,
+    // computed per tile. It should only be computed in the tiles
+    // where the mask is set.
+    Func g("g"), f("f");
+    g(x, y) = call_counter(x + y);
+    f(x, y) = select(mask(x / tile, y / tile) != 0, g(x, y), -1);
+    f.tile(x, y, xo, yo, xi, yi, tile, tile);
+    g.compute_at(f, xo);
+
+    Buffer<int> out = f.realize(W, H);
+
+    if (call_count != active_tiles * tile * tile) {
+        printf("g was evaluated %d times instead of %d\n", call_count, active_tiles * tile * tile);
+        return -1;
+    }
+
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            int correct = mask(x / tile, y / tile) ? x + y : -1;
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
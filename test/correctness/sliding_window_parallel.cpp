@@ -0,0 +1,82 @@
+#include <atomic>
+#include <stdio.h>
+#include "Halide.h"
+
+using namespace Halide;
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+std::atomic<int> count;
+extern "C" DLLEXPORT int call_counter(int x, int y) {
+    count++;
+    return x + y;
+}
+HalideExtern_2(int, call_counter, int, int);
+
+// Realize g with its rows in parallel, and return how many times f was
+// called, or -1 if the output is wrong.
+int run(int width, int height) {
+    Var x, y;
+    Func f, g;
+
+    f(x, y) = call_counter(x, y);
+    g(x, y) = f(x, y - 1) + f(x, y) + f(x, y + 1);
+
+    f.store_root().compute_at(g, y);
+    g.parallel(y);
+
+    count = 0;
+    Buffer<int> im = g.realize(width, height);
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int correct = 3 * (x + y);
+            if (im(x, y) != correct) {
+                printf("im(%d, %d) = %d instead of %d\n", x, y, im(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    return count;
+}
+
+int main(int argc, char **argv) {
+    {
+        // Without sliding, each row of g computes three rows of f. With
+        // sliding in strips, only the first row of each strip does.
+        const int width = 10, height = 100;
+        int calls = run(width, height);
+        int without_sliding = 3 * width * height;
+        if (calls < 0) {
+            return -1;
+        }
+        if (calls >= without_sliding / 2) {
+            printf("f was called %d times. Without sliding it's called %d times\n",
+                   calls, without_sliding);
+            return -1;
+        }
+    }
+
+    {
+        // A parallel loop this short isn't split into strips, so it
+        // keeps one task per row and f isn't slid over it.
+        const int width = 10, height = 8;
+        int calls = run(width, height);
+        int without_sliding = 3 * width * height;
+        if (calls < 0) {
+            return -1;
+        }
+        if (calls != without_sliding) {
+            printf("f was called %d times over a short parallel loop instead of %d times\n",
+                   calls, without_sliding);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Target host = get_host_target();
+    if (host.arch != Target::X86) {
+        printf("Not running test because host is not x86.\n");
+        return 0;
+    }
+
+    ImageParam in(UInt(16), 1);
+    Var x;
+
+    Func f, g;
+    f(x) = in(x) * 3 + (in(x + 1) >> 2);
+    g(x) = f(x) + f(x + 2);
+
+    // Only the loop nest over f gets a version for AVX2.
+    f.compute_root().specialize_for_target_features({Target::AVX2, Target::FMA}).vectorize(x, 16);
+    f.vectorize(x, 8);
+    g.vectorize(x, 8);
+
+    Buffer<uint16_t> input(1100);
+    for (int i = 0; i < input.width(); i++) {
+        input(i) = (uint16_t)(i * 17 + 43);
+    }
+    in.set(input);
+
+    // Compile for a target without the features, so that the
+    // specialized loop nest is compiled separately if the host has
+    // them.
+    Target t = host.without_feature(Target::AVX2).without_feature(Target::FMA)
+        .without_feature(Target::AVX512).without_feature(Target::AVX512_KNL)
+        .without_feature(Target::AVX512_Skylake).without_feature(Target::AVX512_Cannonlake)
+        .without_feature(Target::AVX512_Cascadelake).with_feature(Target::JIT);
+
+    Buffer<uint16_t> out = g.realize(1024, t);
+
+    for (int i = 0; i < out.width(); i++) {
+        uint16_t f0 = (uint16_t)(input(i) * 3 + (input(i + 1) >> 2));
+        uint16_t f2 = (uint16_t)(input(i + 2) * 3 + (input(i + 3) >> 2));
+        uint16_t correct = (uint16_t)(f0 + f2);
+        if (out(i) != correct) {
+            printf("out(%d) = %d instead of %d\n", i, out(i), correct);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
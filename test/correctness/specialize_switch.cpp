@@ -0,0 +1,52 @@
+#include "Halide.h"
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Var x;
+    Param<int> mode("mode");
+
+    // Specialize on several values of a Param. The specializations
+    // should be dispatched with a switch statement.
+    Func f("f");
+    f(x) = x * mode + 1;
+    f.specialize(mode == 0);
+    f.specialize(mode == 1).vectorize(x, 4);
+    f.specialize(mode == 2).vectorize(x, 8);
+    f.specialize(mode == 3).unroll(x, 2);
+    f.specialize(mode == 5);
+
+    std::string assembly_file = Internal::get_test_tmp_dir() + "specialize_switch.ll";
+    Internal::ensure_no_file_exists(assembly_file);
+    f.compile_to_llvm_assembly(assembly_file, {mode}, "f");
+    Internal::assert_file_exists(assembly_file);
+
+    std::ifstream assembly(assembly_file.c_str());
+    std::stringstream contents;
+    contents << assembly.rdbuf();
+    if (contents.str().find("switch i32") == std::string::npos) {
+        printf("The specializations weren't dispatched with a switch statement\n");
+        return -1;
+    }
+
+    // The specializations and the general case all give the right
+    // answer.
+    for (int m = -1; m < 7; m++) {
+        mode.set(m);
+        Buffer<int> out = f.realize(64);
+        for (int i = 0; i < 64; i++) {
+            if (out(i) != i * m + 1) {
+                printf("out(%d) = %d instead of %d with mode %d\n", i, out(i), i * m + 1, m);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
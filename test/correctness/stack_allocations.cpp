@@ -34,6 +34,30 @@ int main(int argc, char **argv) {
 
     h.realize(10, 10);
 
+    // Per-tile scratch of a dynamic size which is bounded by the
+    // range of a Param should go on the stack too.
+    Func f2, g2;
+    Param<int> tile_size;
+    tile_size.set_range(1, 16);
+    f2(x, y) = x + y;
+    g2(x, y) = f2(x - 1, y + 1) * f2(x + 1, y - 1);
+    Var xo, yo;
+    g2.tile(x, y, xo, yo, xi, yi, tile_size, tile_size);
+    f2.compute_at(g2, xo);
+    g2.set_custom_allocator(&my_malloc, &my_free);
+
+    tile_size.set(8);
+    Buffer<int> out = g2.realize(32, 32);
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            int correct = (x + y) * (x + y);
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+
     printf("Success!\n");
     return 0;
 }
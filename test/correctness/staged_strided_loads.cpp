@@ -0,0 +1,106 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Counts the strided vector loads from a buffer.
+class CountStridedLoads : public IRMutator2 {
+public:
+    std::string name;
+    int count = 0;
+
+    CountStridedLoads(const std::string &n) : name(n) {}
+
+    Stmt mutate(const Stmt &s) override {
+        struct Counter : public IRVisitor {
+            const std::string &name;
+            int count = 0;
+            using IRVisitor::visit;
+            void visit(const Load *op) override {
+                const Ramp *ramp = op->index.as<Ramp>();
+                if (op->name == name && ramp && !is_one(ramp->stride)) {
+                    count++;
+                }
+                IRVisitor::visit(op);
+            }
+            Counter(const std::string &n) : name(n) {}
+        } counter(name);
+        s.accept(&counter);
+        count = counter.count;
+        return s;
+    }
+};
+
+int main(int argc, char **argv) {
+    Var x, y, xi, yi;
+
+    {
+        // An unrolled transpose of 8x8 blocks loads the columns of each
+        // block with strided loads, which together cover the block.
+        Func input("input"), block("block"), block_transpose("block_transpose"), output("output");
+        input(x, y) = cast<uint16_t>(x * 3 + y);
+        input.compute_root();
+
+        block(x, y) = input(x, y);
+        block_transpose(x, y) = block(y, x);
+        output(x, y) = block_transpose(x, y);
+
+        output.tile(x, y, xi, yi, 8, 8).vectorize(xi).unroll(yi);
+        block.compute_at(output, x).vectorize(x).unroll(y);
+        block_transpose.compute_at(output, x).vectorize(x).unroll(y);
+
+        CountStridedLoads *counter = new CountStridedLoads("block");
+        output.add_custom_lowering_pass(counter);
+        Buffer<uint16_t> out = output.realize(64, 64);
+
+        if (counter->count != 0) {
+            printf("There were %d strided loads from the block\n", counter->count);
+            return -1;
+        }
+
+        for (int y = 0; y < 64; y++) {
+            for (int x = 0; x < 64; x++) {
+                uint16_t correct = y * 3 + x;
+                if (out(x, y) != correct) {
+                    printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    {
+        // Summing the channels of interleaved rgb data.
+        Buffer<uint8_t> rgb(3 * 64);
+        for (int i = 0; i < 3 * 64; i++) {
+            rgb(i) = (uint8_t)(i * 7);
+        }
+
+        Func sum("sum");
+        sum(x) = (cast<uint16_t>(rgb(3 * x)) +
+                  cast<uint16_t>(rgb(3 * x + 1)) +
+                  cast<uint16_t>(rgb(3 * x + 2)));
+        sum.vectorize(x, 8);
+
+        CountStridedLoads *counter = new CountStridedLoads(rgb.name());
+        sum.add_custom_lowering_pass(counter);
+        Buffer<uint16_t> out = sum.realize(64);
+
+        if (counter->count != 0) {
+            printf("There were %d strided loads from the rgb data\n", counter->count);
+            return -1;
+        }
+
+        for (int x = 0; x < 64; x++) {
+            uint16_t correct = rgb(3 * x) + rgb(3 * x + 1) + rgb(3 * x + 2);
+            if (out(x) != correct) {
+                printf("sum(%d) = %d instead of %d\n", x, out(x), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include "Halide.h"
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Finds the cost of the loop around f's vectors, and the size of g.
+class CheckCosts : public IRMutator2 {
+public:
+    LoopCost inner;
+    Expr allocation;
+    std::string description;
+
+    Stmt mutate(const Stmt &s) override {
+        StmtCosts costs(s);
+        struct Finder : public IRVisitor {
+            const StmtCosts &costs;
+            CheckCosts *self;
+            using IRVisitor::visit;
+            void visit(const For *op) override {
+                if (ends_with(op->name, "f.s0.x.xo.xi")) {
+                    self->inner = *costs.loop_cost(op);
+                    self->description = costs.describe(op);
+                }
+                IRVisitor::visit(op);
+            }
+            void visit(const Allocate *op) override {
+                if (op->name == "g") {
+                    self->allocation = costs.allocation_bytes(op);
+                }
+                IRVisitor::visit(op);
+            }
+            Finder(const StmtCosts &costs, CheckCosts *self) : costs(costs), self(self) {}
+        } finder(costs, this);
+        s.accept(&finder);
+        return s;
+    }
+};
+
+int main(int argc, char **argv) {
+    ImageParam in(UInt(8), 1);
+    Func g("g"), f("f");
+    Var x, xo, xi;
+    g(x) = in(x) * 2;
+    f(x) = cast<uint16_t>(g(x)) + g(x + 1);
+    f.split(x, xo, x, 16).vectorize(x);
+    f.split(xo, xo, xi, 64);
+    g.compute_at(f, xo).vectorize(x, 16);
+
+    CheckCosts *checker = new CheckCosts;
+    f.add_custom_lowering_pass(checker);
+    f.compile_jit();
+
+    // Each iteration of the loop around f's vectors loads two vectors
+    // of 16 bytes from g and stores one of 16 uint16s.
+    const int64_t *loaded = as_const_int(checker->inner.bytes_loaded);
+    const int64_t *stored = as_const_int(checker->inner.bytes_stored);
+    const int64_t *arith = as_const_int(checker->inner.arith);
+    if (!loaded || *loaded != 32 || !stored || *stored != 32 || !arith || *arith < 32 ||
+        checker->inner.vector_width != 16) {
+        printf("Unexpected costs for the loop around f's vectors: %s\n", checker->description.c_str());
+        return -1;
+    }
+
+    // g is allocated per iteration of xo, and covers at least
+    // 64 * 16 + 1 values.
+    const int64_t *bytes = as_const_int(checker->allocation);
+    if (!checker->allocation.defined() || (bytes && *bytes < 64 * 16 + 1)) {
+        std::ostringstream s;
+        s << checker->allocation;
+        printf("Unexpected size for g: %s\n", s.str().c_str());
+        return -1;
+    }
+
+    // The text output includes the estimates.
+    std::string result_file = get_test_tmp_dir() + "stmt_costs.stmt";
+    ensure_no_file_exists(result_file);
+    f.compile_to_lowered_stmt(result_file, {in});
+    assert_file_exists(result_file);
+    std::ifstream file(result_file);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    if (contents.str().find("// per iteration: arith ") == std::string::npos ||
+        contents.str().find("// allocates ") == std::string::npos) {
+        printf("Cost estimates are missing from %s\n", result_file.c_str());
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -495,6 +495,40 @@ int main(int argc, char **argv) {
         realize_and_expect_error(h, 64, 7);
     }
 
+    {
+        custom_malloc_size = 0;
+        Func f, g;
+        Var xo, yo, xi, yi;
+
+        f(x, y) = x + y;
+        g(x, y) = f(x - 1, y - 1) + f(x + 1, y + 1);
+        g.tile(x, y, xo, yo, xi, yi, 16, 16);
+        f.store_root().compute_at(g, xo);
+
+        // Should be able to fold storage in both x and y, into a
+        // circular buffer the size of a tile of f.
+
+        g.set_custom_allocator(my_malloc, my_free);
+
+        Buffer<int> im = g.realize(96, 96);
+
+        size_t expected_size = 32*32*sizeof(int) + sizeof(int);
+        if (custom_malloc_size == 0 || custom_malloc_size > expected_size) {
+            printf("Scratch space allocated was %d instead of %d\n", (int)custom_malloc_size, (int)expected_size);
+            return -1;
+        }
+
+        for (int y = 0; y < im.height(); y++) {
+            for (int x = 0; x < im.width(); x++) {
+                int correct = 2 * (x + y);
+                if (im(x, y) != correct) {
+                    printf("im(%d, %d) = %d instead of %d\n", x, y, im(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
     printf("Success!\n");
     return 0;
 }
@@ -0,0 +1,74 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int malloc_count = 0;
+
+void *my_malloc(void *user_context, size_t x) {
+    malloc_count++;
+    void *orig = malloc(x+32);
+    void *ptr = (void *)((((size_t)orig + 32) >> 5) << 5);
+    ((void **)ptr)[-1] = orig;
+    return ptr;
+}
+
+void my_free(void *user_context, void *ptr) {
+    free(((void**)ptr)[-1]);
+}
+
+int main(int argc, char **argv) {
+    Var x, y;
+
+    {
+        // A small allocation would go on the stack by default. Force
+        // it onto the heap.
+        Func f, g;
+        f(x) = x;
+        g(x) = f(x) + f(x + 1);
+        f.compute_root().store_in(MemoryType::Heap);
+
+        g.set_custom_allocator(&my_malloc, &my_free);
+        malloc_count = 0;
+        Buffer<int> out = g.realize(16);
+        if (malloc_count != 1) {
+            printf("There should have been one heap allocation, instead of %d\n", malloc_count);
+            return -1;
+        }
+        for (int i = 0; i < 16; i++) {
+            if (out(i) != i * 2 + 1) {
+                printf("out(%d) = %d instead of %d\n", i, out(i), i * 2 + 1);
+                return -1;
+            }
+        }
+    }
+
+    {
+        // A large allocation would go on the heap by default. Force
+        // it onto the stack.
+        Func f, g;
+        f(x, y) = x + y;
+        g(x, y) = f(x, y) * 2;
+        f.compute_at(g, y).bound_extent(x, 8192).store_in(MemoryType::Stack);
+        g.bound(x, 0, 8192);
+
+        g.set_custom_allocator(&my_malloc, &my_free);
+        malloc_count = 0;
+        Buffer<int> out = g.realize(8192, 4);
+        if (malloc_count != 0) {
+            printf("There should have been no heap allocations, instead of %d\n", malloc_count);
+            return -1;
+        }
+        for (int j = 0; j < 4; j++) {
+            for (int i = 0; i < 8192; i++) {
+                if (out(i, j) != (i + j) * 2) {
+                    printf("out(%d, %d) = %d instead of %d\n", i, j, out(i, j), (i + j) * 2);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
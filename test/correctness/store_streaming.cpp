@@ -0,0 +1,53 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+int streaming_stores = 0;
+
+class CountStreamingStores : public IRMutator2 {
+    using IRMutator2::visit;
+
+    Expr visit(const Call *op) override {
+        if (op->is_intrinsic(Call::nontemporal)) {
+            streaming_stores++;
+        }
+        return IRMutator2::visit(op);
+    }
+};
+
+int main(int argc, char **argv) {
+    Var x, y;
+    Func f, g, h;
+    f(x, y) = x + y * 3;
+    g(x, y) = f(x, y) * 2 + f(x + 1, y);
+    h(x, y) = g(x, y) - x;
+
+    // Compute_root stages and an output, all streamed.
+    f.compute_root().vectorize(x, 16).parallel(y).store_streaming();
+    g.compute_root().vectorize(x, 16).parallel(y).store_streaming();
+    h.vectorize(x, 16).store_streaming();
+    // Vectors of 16 ints fill a cache line.
+    h.add_custom_lowering_pass(new CountStreamingStores);
+
+    const int W = 1024, H = 256;
+    Buffer<int> out = h.realize(W, H);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            int correct = (x + y * 3) * 2 + (x + 1 + y * 3) - x;
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+
+    if (streaming_stores == 0) {
+        printf("None of the stores were marked as streaming\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
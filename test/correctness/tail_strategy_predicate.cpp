@@ -0,0 +1,99 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Counts the predicated vector stores and the scalar stores to a Func.
+class CountStores : public IRMutator2 {
+public:
+    std::string name;
+    int predicated = 0, scalar = 0;
+
+    CountStores(const std::string &name) : name(name) {}
+
+    Stmt mutate(const Stmt &s) override {
+        struct Counter : public IRVisitor {
+            const std::string &name;
+            int predicated = 0, scalar = 0;
+            using IRVisitor::visit;
+            void visit(const Store *op) override {
+                if (op->name == name) {
+                    if (op->value.type().is_scalar()) {
+                        scalar++;
+                    } else if (!is_one(op->predicate)) {
+                        predicated++;
+                    }
+                }
+                IRVisitor::visit(op);
+            }
+            Counter(const std::string &name) : name(name) {}
+        } counter(name);
+        s.accept(&counter);
+        predicated = counter.predicated;
+        scalar = counter.scalar;
+        return s;
+    }
+};
+
+int main(int argc, char **argv) {
+    // An odd width, which doesn't divide the vector width.
+    const int W = 129, H = 8;
+    Buffer<uint8_t> in(W, H);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            in(x, y) = (uint8_t)(x * 3 + y);
+        }
+    }
+
+    Var x, y;
+
+    // A pure definition. Like GuardWithIf, this shouldn't read the
+    // input past its end, and the tail should be predicated rather
+    // than scalarized.
+    {
+        Func f("f");
+        f(x, y) = in(x, y) * 2 + 1;
+        f.vectorize(x, 16, TailStrategy::Predicate);
+
+        CountStores *counter = new CountStores("f");
+        f.add_custom_lowering_pass(counter);
+        Buffer<uint8_t> out = f.realize(W, H);
+
+        if (counter->predicated == 0 || counter->scalar != 0) {
+            printf("Expected only vector stores, some of them predicated, but there were "
+                   "%d predicated and %d scalar stores\n", counter->predicated, counter->scalar);
+            return -1;
+        }
+
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                uint8_t correct = in(x, y) * 2 + 1;
+                if (out(x, y) != correct) {
+                    printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // It's also legal for RVars, where it must not change the meaning
+    // of the algorithm.
+    {
+        Func g("g");
+        RDom r(0, W);
+        g(x) = 0;
+        g(r) += cast<int>(in(r, 0)) * 3;
+        g.update().vectorize(r, 8, TailStrategy::Predicate);
+        Buffer<int> out = g.realize(W);
+        for (int x = 0; x < W; x++) {
+            if (out(x) != in(x, 0) * 3) {
+                printf("out(%d) = %d instead of %d\n", x, out(x), in(x, 0) * 3);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
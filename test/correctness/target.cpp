@@ -43,6 +43,34 @@ int main(int argc, char **argv) {
        return -1;
     }
 
+    // WebAssembly, with the single-threaded runtime.
+    t1 = Target(Target::WebAssemblyRuntime, Target::WebAssembly, 32);
+    ts = t1.to_string();
+    if (ts != "wasm-32-wasmrt") {
+       printf("to_string failure: %s\n", ts.c_str());
+       return -1;
+    }
+    if (!Target::validate_target_string(ts)) {
+       printf("validate_target_string failure: %s\n", ts.c_str());
+       return -1;
+    }
+    t2 = Target(ts);
+    if (t2 != t1) {
+       printf("roundtrip failure: %s\n", ts.c_str());
+       return -1;
+    }
+
+    t1 = Target(Target::Linux, Target::RISCV, 64);
+    ts = t1.to_string();
+    if (ts != "riscv-64-linux") {
+       printf("to_string failure: %s\n", ts.c_str());
+       return -1;
+    }
+    if (!Target::validate_target_string(ts)) {
+       printf("validate_target_string failure: %s\n", ts.c_str());
+       return -1;
+    }
+
     // Full specification round-trip, crazy features
     t1 = Target(Target::Android, Target::ARM, 32,
                 {Target::JIT, Target::SSE41, Target::AVX, Target::AVX2,
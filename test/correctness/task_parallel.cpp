@@ -0,0 +1,68 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Counts the parallel loops that run independent stages as tasks.
+class CountTaskLoops : public IRMutator2 {
+public:
+    int count = 0;
+
+    Stmt mutate(const Stmt &s) override {
+        struct Counter : public IRVisitor {
+            int count = 0;
+            using IRVisitor::visit;
+            void visit(const For *op) override {
+                if (op->for_type == ForType::Parallel && ends_with(op->name, ".__tasks")) {
+                    count++;
+                }
+                IRVisitor::visit(op);
+            }
+        } counter;
+        s.accept(&counter);
+        count = counter.count;
+        return s;
+    }
+};
+
+int main(int argc, char **argv) {
+    Var x, y;
+
+    // Two branches of the pipeline that don't depend on each other,
+    // followed by a stage that depends on the first branch, and an
+    // output that uses all of them.
+    Func a("a"), b("b"), c("c"), out("out");
+    a(x, y) = x + y;
+    b(x, y) = x * y;
+    c(x, y) = a(x, y) * 2 + 1;
+    out(x, y) = a(x, y) + b(x, y) + c(x, y);
+    a.compute_root().parallel(y);
+    b.compute_root().vectorize(x, 8);
+    c.compute_root();
+
+    CountTaskLoops *counter = new CountTaskLoops;
+    out.add_custom_lowering_pass(counter);
+
+    Target t = get_jit_target_from_environment().with_feature(Target::TaskParallel);
+    Buffer<int> result = out.realize(64, 32, t);
+
+    // a and b run concurrently, then c, which uses a, on its own.
+    if (counter->count != 1) {
+        printf("There were %d loops over independent stages instead of 1\n", counter->count);
+        return -1;
+    }
+
+    for (int y = 0; y < 32; y++) {
+        for (int x = 0; x < 64; x++) {
+            int correct = (x + y) + (x * y) + ((x + y) * 2 + 1);
+            if (result(x, y) != correct) {
+                printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
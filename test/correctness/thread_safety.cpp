@@ -1,4 +1,5 @@
 #include "Halide.h"
+#include <atomic>
 #include <stdio.h>
 #include <thread>
 
@@ -31,6 +32,43 @@ int main(int argc, char **argv) {
         t.join();
     }
 
+    // Now that the shared runtime exists, lower and compile pipelines
+    // that use more of the compiler at once, with no lock around the
+    // compilations.
+    threads.clear();
+    std::atomic<int> failures(0);
+    for (int i = 0; i < num_threads; i++) {
+        threads.emplace_back([=, &failures]{
+            for (int j = 0; j < 8; j++) {
+                Func f, g;
+                Var x, y;
+                RDom r(0, 8);
+                f(x, y) = x * y + i;
+                g(x, y) = sum(f(x + r, y)) + j;
+                f.compute_at(g, y).vectorize(x, 8);
+                g.parallel(y).vectorize(x, 4);
+                Buffer<int> out = g.realize(32, 4);
+                for (int yi = 0; yi < 4; yi++) {
+                    for (int xi = 0; xi < 32; xi++) {
+                        int correct = (8 * xi + 28) * yi + 8 * i + j;
+                        if (out(xi, yi) != correct) {
+                            failures++;
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    if (failures) {
+        printf("%d values were wrong\n", (int)failures);
+        return -1;
+    }
+
     printf("Success!\n");
 
     return 0;
@@ -0,0 +1,56 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    {
+        // A transpose of an intermediate stored in 8x8 tiles. The
+        // extents aren't multiples of the tile size.
+        Func f, g;
+        Var x, y;
+        f(x, y) = x * 1000 + y;
+        g(x, y) = f(y, x) + f(y + 1, x);
+
+        f.compute_root().tile_storage(x, 8).tile_storage(y, 8);
+
+        Buffer<int> out = g.realize(37, 100);
+        for (int y = 0; y < out.height(); y++) {
+            for (int x = 0; x < out.width(); x++) {
+                int correct = (y * 1000 + x) + ((y + 1) * 1000 + x);
+                if (out(x, y) != correct) {
+                    printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    {
+        // Tiles along one dimension only, combined with a reordered
+        // storage order and a Func computed per row of its consumer.
+        Func f, g;
+        Var x, y, c;
+        f(x, y, c) = x + y * 10 + c * 100;
+        g(x, y, c) = f(x, y, c) + f(x, y + 2, 2 - c);
+
+        f.compute_at(g, y).reorder_storage(c, x, y).tile_storage(x, 4);
+        g.vectorize(x, 8);
+
+        Buffer<int> out = g.realize(30, 20, 3);
+        for (int c = 0; c < 3; c++) {
+            for (int y = 0; y < out.height(); y++) {
+                for (int x = 0; x < out.width(); x++) {
+                    int correct = (x + y * 10 + c * 100) + (x + (y + 2) * 10 + (2 - c) * 100);
+                    if (out(x, y, c) != correct) {
+                        printf("out(%d, %d, %d) = %d instead of %d\n", x, y, c, out(x, y, c), correct);
+                        return -1;
+                    }
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include "Halide.h"
+#include "../../util/HalideTraceUtils.cpp"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+using namespace Halide;
+
+// Run the pipeline with binary tracing to a fresh file, and read back
+// every packet.
+std::vector<Internal::Packet> trace_to_file(Func g, bool compact) {
+    // The runtime reads HL_TRACE_FILE and HL_TRACE_COMPACT once, so set
+    // them before the shared runtime is (re)created.
+    static std::string trace_files[2], envs[2];
+    std::string &trace_file = trace_files[compact];
+    trace_file = Internal::file_make_temp(compact ? "trace_compact" : "trace", ".bin");
+    envs[compact] = "HL_TRACE_FILE=" + trace_file;
+    putenv(&envs[compact][0]);
+    if (compact) {
+        static char compact_env[] = "HL_TRACE_COMPACT=1";
+        putenv(compact_env);
+    }
+    Internal::JITSharedRuntime::release_all();
+
+    g.realize(32, 16);
+
+    std::vector<Internal::Packet> packets;
+    FILE *file = fopen(trace_file.c_str(), "rb");
+    if (!file) {
+        printf("Could not open %s\n", trace_file.c_str());
+        exit(-1);
+    }
+    Internal::Packet p;
+    while (p.read_from_filedesc(file)) {
+        packets.push_back(p);
+    }
+    fclose(file);
+    Internal::file_unlink(trace_file);
+    return packets;
+}
+
+int main(int argc, char **argv) {
+    // A serial pipeline, so that both runs produce the same packets in
+    // the same order. Include loads, vector stores, and more than one
+    // type, so that every field of the compact records gets used.
+    Var x, y;
+    Func f, g;
+    f(x, y) = cast<float>(x - y) / 3.0f;
+    g(x, y) = cast<uint8_t>(f(x, y) * 7 + f(x + 1, y));
+    f.compute_at(g, y).trace_stores().trace_loads().trace_realizations();
+    g.vectorize(x, 8).trace_stores();
+
+    std::vector<Internal::Packet> full = trace_to_file(g, false);
+    std::vector<Internal::Packet> compact = trace_to_file(g, true);
+
+    if (full.empty() || full.size() != compact.size()) {
+        printf("Expected the same number of packets in both formats, got %d and %d\n",
+               (int)full.size(), (int)compact.size());
+        return -1;
+    }
+
+    for (size_t i = 0; i < full.size(); i++) {
+        const Internal::Packet &a = full[i], &b = compact[i];
+        bool same = (a.size == b.size &&
+                     a.id == b.id &&
+                     a.parent_id == b.parent_id &&
+                     a.event == b.event &&
+                     a.type == b.type &&
+                     a.value_index == b.value_index &&
+                     a.dimensions == b.dimensions &&
+                     !strcmp(a.func(), b.func()) &&
+                     !memcmp(a.coordinates(), b.coordinates(), a.dimensions * sizeof(int32_t)));
+        // Only loads and stores carry a value.
+        if (same && (a.event == halide_trace_load || a.event == halide_trace_store)) {
+            same = !memcmp(a.value(), b.value(), a.type.lanes * a.type.bytes());
+        }
+        if (!same) {
+            printf("Packet %d differs between the full and compact formats: %s %d vs %s %d\n",
+                   (int)i, a.func(), a.id, b.func(), b.id);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
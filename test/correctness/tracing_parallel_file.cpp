@@ -0,0 +1,78 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    // Binary tracing is enabled by HL_TRACE_FILE, which the runtime
+    // reads once, so set it before the shared runtime is (re)created.
+    static std::string trace_file = Internal::file_make_temp("trace", ".bin");
+    static std::string env = "HL_TRACE_FILE=" + trace_file;
+    putenv(&env[0]);
+    Internal::JITSharedRuntime::release_all();
+
+    // Many threads write trace packets at once.
+    Var x, y, yo, yi;
+    Func f, g;
+    f(x, y) = x + y;
+    g(x, y) = f(x, y) * 2;
+    f.compute_at(g, yo).trace_stores().trace_realizations();
+    g.split(y, yo, yi, 4).parallel(yo).trace_stores();
+
+    const int W = 64, H = 256;
+    g.realize(W, H);
+
+    std::vector<uint8_t> data;
+    {
+        FILE *file = fopen(trace_file.c_str(), "rb");
+        if (!file) {
+            printf("Could not open %s\n", trace_file.c_str());
+            return -1;
+        }
+        uint8_t chunk[4096];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            data.insert(data.end(), chunk, chunk + n);
+        }
+        fclose(file);
+    }
+
+    // Every packet must be whole, have a unique id, and come after
+    // its parent.
+    std::set<int32_t> ids;
+    std::map<std::string, int> stores;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        const halide_trace_packet_t *p = (const halide_trace_packet_t *)(&data[pos]);
+        if (p->size < sizeof(halide_trace_packet_t) || pos + p->size > data.size()) {
+            printf("Bad packet at offset %d\n", (int)pos);
+            return -1;
+        }
+        if (!ids.insert(p->id).second) {
+            printf("Duplicate packet id %d\n", p->id);
+            return -1;
+        }
+        if (p->event != halide_trace_begin_pipeline && !ids.count(p->parent_id)) {
+            printf("Packet %d for %s appears before its parent %d\n", p->id, p->func(), p->parent_id);
+            return -1;
+        }
+        if (p->event == halide_trace_store) {
+            stores[p->func()]++;
+        }
+        pos += p->size;
+    }
+
+    if (stores[f.name()] != W * H || stores[g.name()] != W * H) {
+        printf("Expected %d stores to each Func, got %d and %d\n",
+               W * H, stores[f.name()], stores[g.name()]);
+        return -1;
+    }
+
+    Internal::file_unlink(trace_file);
+
+    printf("Success!\n");
+    return 0;
+}
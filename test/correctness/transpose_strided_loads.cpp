@@ -0,0 +1,95 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Counts the strided vector loads and the shuffles left in the
+// lowered code.
+class CountLoads : public IRMutator2 {
+public:
+    int strided = 0, shuffles = 0;
+
+    Stmt mutate(const Stmt &s) override {
+        struct Counter : public IRVisitor {
+            int strided = 0, shuffles = 0;
+            using IRVisitor::visit;
+            void visit(const Load *op) override {
+                const Ramp *r = op->index.as<Ramp>();
+                if (r && !is_one(r->stride)) {
+                    strided++;
+                }
+                IRVisitor::visit(op);
+            }
+            void visit(const Shuffle *op) override {
+                shuffles++;
+                IRVisitor::visit(op);
+            }
+        } counter;
+        s.accept(&counter);
+        strided = counter.strided;
+        shuffles = counter.shuffles;
+        return s;
+    }
+};
+
+int check(const char *name, Func f, int w, int h, std::function<int(int, int)> correct) {
+    CountLoads *counter = new CountLoads;
+    f.add_custom_lowering_pass(counter);
+    Buffer<int> out = f.realize(w, h);
+    if (counter->strided != 0 || counter->shuffles == 0) {
+        printf("%s: %d strided loads and %d shuffles remain\n", name, counter->strided, counter->shuffles);
+        return -1;
+    }
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            if (out(x, y) != correct(x, y)) {
+                printf("%s: out(%d, %d) = %d instead of %d\n", name, x, y, out(x, y), correct(x, y));
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Buffer<int> in(64, 64);
+    for (int y = 0; y < in.height(); y++) {
+        for (int x = 0; x < in.width(); x++) {
+            in(x, y) = x * 100 + y;
+        }
+    }
+
+    Var x, y, xi, yi;
+
+    {
+        Func transpose("transpose");
+        transpose(x, y) = in(y, x);
+        transpose.tile(x, y, xi, yi, 8, 8).vectorize(xi).unroll(yi);
+        if (check("transpose", transpose, 64, 64, [&](int x, int y) { return in(y, x); })) {
+            return -1;
+        }
+    }
+
+    {
+        Func rotate("rotate");
+        rotate(x, y) = in(y, 63 - x);
+        rotate.tile(x, y, xi, yi, 4, 4).vectorize(xi).unroll(yi);
+        if (check("rotate", rotate, 64, 64, [&](int x, int y) { return in(y, 63 - x); })) {
+            return -1;
+        }
+    }
+
+    {
+        // A column filter vectorized down the columns.
+        Func column("column");
+        column(x, y) = in(x, y) + 2 * in(x, y + 1) + in(x, y + 2);
+        column.tile(x, y, xi, yi, 4, 4).vectorize(yi).unroll(xi);
+        if (check("column", column, 64, 60, [&](int x, int y) { return in(x, y) + 2 * in(x, y + 1) + in(x, y + 2); })) {
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Finds the size of an allocation.
+class AllocationSize : public IRMutator2 {
+public:
+    std::string name;
+    int64_t size = -1;
+
+    AllocationSize(const std::string &name) : name(name) {}
+
+    Stmt mutate(const Stmt &s) override {
+        struct Finder : public IRVisitor {
+            const std::string &name;
+            Expr size;
+            using IRVisitor::visit;
+            void visit(const Allocate *op) override {
+                if (op->name == name) {
+                    size = 1;
+                    for (const Expr &e : op->extents) {
+                        size *= cast<int64_t>(e);
+                    }
+                    size = simplify(size);
+                }
+                IRVisitor::visit(op);
+            }
+            Finder(const std::string &name) : name(name) {}
+        } finder(name);
+        s.accept(&finder);
+        if (finder.size.defined() && as_const_int(finder.size)) {
+            size = *as_const_int(finder.size);
+        }
+        return s;
+    }
+};
+
+int main(int argc, char **argv) {
+    const int W = 64, H = 32;
+    Buffer<uint16_t> in(W, H);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            in(x, y) = (x * 7 + y * 13) % 256;
+        }
+    }
+
+    Var x, y, i;
+
+    // A lookup table indexed by the values of a uint16 image that we
+    // know are less than 256.
+    {
+        Func lut("lut"), f("f");
+        lut(i) = cast<uint8_t>(i * 3 + 1);
+        f(x, y) = lut(unsafe_promise_clamped(cast<int>(in(x, y)), 0, 255));
+        lut.compute_root();
+
+        AllocationSize *alloc = new AllocationSize("lut");
+        f.add_custom_lowering_pass(alloc);
+        Buffer<uint8_t> out = f.realize(W, H);
+
+        if (alloc->size != 256) {
+            printf("The lookup table has %lld entries instead of 256\n", (long long)alloc->size);
+            return -1;
+        }
+
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                uint8_t correct = in(x, y) * 3 + 1;
+                if (out(x, y) != correct) {
+                    printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // The promise only narrows the bounds, so a value that's already
+    // known to be in a smaller range keeps it.
+    {
+        Func lut("lut"), f("f");
+        lut(i) = cast<uint8_t>(i);
+        f(x, y) = lut(unsafe_promise_clamped(cast<int>(in(x, y)) & 15, 0, 255));
+        lut.compute_root();
+
+        AllocationSize *alloc = new AllocationSize("lut");
+        f.add_custom_lowering_pass(alloc);
+        Buffer<uint8_t> out = f.realize(W, H);
+
+        if (alloc->size != 16) {
+            printf("The lookup table has %lld entries instead of 16\n", (long long)alloc->size);
+            return -1;
+        }
+
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                if (out(x, y) != (in(x, y) & 15)) {
+                    printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), in(x, y) & 15);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
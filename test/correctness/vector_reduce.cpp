@@ -0,0 +1,122 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <math.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    const int N = 1024;
+
+    Buffer<int16_t> a16(N), b16(N);
+    Buffer<uint8_t> a8(N), b8(N);
+    Buffer<float> af(N);
+    for (int i = 0; i < N; i++) {
+        a16(i) = (int16_t)((i * 37) % 1001 - 500);
+        b16(i) = (int16_t)((i * 91) % 777 - 300);
+        a8(i) = (uint8_t)((i * 13) % 256);
+        b8(i) = (uint8_t)((i * 7 + 3) % 256);
+        af(i) = (float)((i * 17) % 100) / 8.0f;
+    }
+
+    RDom r(0, N);
+
+    {
+        // A dot product of 16-bit values.
+        Func f;
+        f() = 0;
+        f() += cast<int>(a16(r)) * b16(r);
+        f.update().atomic().vectorize(r, 16);
+
+        int correct = 0;
+        for (int i = 0; i < N; i++) {
+            correct += (int)a16(i) * b16(i);
+        }
+        Buffer<int> out = f.realize();
+        if (out() != correct) {
+            printf("Dot product was %d instead of %d\n", out(), correct);
+            return -1;
+        }
+    }
+
+    {
+        // A dot product of unsigned and signed 8-bit values, as in
+        // quantized convolutions (vpdpbusd with AVX512-VNNI).
+        Func f;
+        f() = 0;
+        f() += cast<int>(a8(r)) * cast<int8_t>(b8(r));
+        f.update().atomic().vectorize(r, 64);
+
+        int correct = 0;
+        for (int i = 0; i < N; i++) {
+            correct += (int)a8(i) * (int8_t)b8(i);
+        }
+        Buffer<int> out = f.realize();
+        if (out() != correct) {
+            printf("8-bit dot product was %d instead of %d\n", out(), correct);
+            return -1;
+        }
+    }
+
+    {
+        // A sum of absolute differences of 8-bit values.
+        Func f;
+        f() = cast<uint32_t>(0);
+        f() += cast<uint32_t>(absd(a8(r), b8(r)));
+        f.update().atomic().vectorize(r, 32);
+
+        uint32_t correct = 0;
+        for (int i = 0; i < N; i++) {
+            correct += a8(i) > b8(i) ? a8(i) - b8(i) : b8(i) - a8(i);
+        }
+        Buffer<uint32_t> out = f.realize();
+        if (out() != correct) {
+            printf("Sum of absolute differences was %u instead of %u\n", out(), correct);
+            return -1;
+        }
+    }
+
+    {
+        // A floating point sum. The values are exactly representable,
+        // so the order of summation doesn't matter.
+        Func f;
+        f() = 0.0f;
+        f() += af(r);
+        f.update().atomic().vectorize(r, 8);
+
+        float correct = 0.0f;
+        for (int i = 0; i < N; i++) {
+            correct += af(i);
+        }
+        Buffer<float> out = f.realize();
+        if (out() != correct) {
+            printf("Float sum was %f instead of %f\n", out(), correct);
+            return -1;
+        }
+    }
+
+    {
+        // A maximum over the rows of an image, computed in parallel
+        // over the rows.
+        Func g;
+        Var y;
+        RDom rx(0, 64);
+        g(y) = 0;
+        g(y) = max(g(y), cast<int>(a8(rx + y * 64)));
+        g.update().atomic().vectorize(rx, 16).parallel(y);
+
+        Buffer<int> out = g.realize(N / 64);
+        for (int j = 0; j < N / 64; j++) {
+            int correct = 0;
+            for (int i = 0; i < 64; i++) {
+                correct = std::max(correct, (int)a8(i + j * 64));
+            }
+            if (out(j) != correct) {
+                printf("Max of row %d was %d instead of %d\n", j, out(j), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,22 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Func f("f"), g("g");
+    Var x("x"), y("y");
+
+    f(x, y) = x + y;
+    g(x, y) = f(x, y) * 2;
+
+    // There's a parallel loop between the store_at and the compute_at,
+    // so the producer and consumer halves of the async fork would race.
+    g.parallel(y);
+    f.compute_at(g, x).store_root().async();
+
+    g.realize(16, 16);
+
+    printf("There should have been an error\n");
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include "c_simd_intrinsics.h"
+
+using namespace Halide::Runtime;
+
+const int kSize = 64;
+
+int main(int argc, char **argv) {
+    Buffer<uint8_t> input_u8(kSize);
+    Buffer<float> input_f32(kSize);
+    input_u8.for_each_element([&](int x) {
+        input_u8(x) = (uint8_t)(x * 37 + 11);
+    });
+    input_f32.for_each_element([&](int x) {
+        input_f32(x) = (x - kSize / 2) * 1.75f;
+    });
+
+    Buffer<uint8_t> output_u8(kSize);
+    Buffer<int16_t> output_i16(kSize);
+    Buffer<int32_t> output_i32(kSize);
+    Buffer<float> output_f32(kSize);
+
+    c_simd_intrinsics(input_u8, input_f32, output_u8, output_i16, output_i32, output_f32);
+
+    for (int x = 0; x < kSize; x++) {
+        uint8_t a = input_u8(x);
+        uint8_t b = (uint8_t)(x * 3);
+
+        uint8_t u8 = (uint8_t)((a > b ? a - b : b - a) + (a < 17 ? a : 17));
+        if (output_u8(x) != u8) {
+            printf("output_u8(%d) = %d instead of %d\n", x, output_u8(x), u8);
+            return -1;
+        }
+
+        int16_t i16 = (int16_t)((int16_t)(a * 3 - b * 5) >> 1);
+        if (i16 < -300) i16 = -300;
+        if (output_i16(x) != i16) {
+            printf("output_i16(%d) = %d instead of %d\n", x, output_i16(x), i16);
+            return -1;
+        }
+
+        int32_t i32 = x % 3 == 0 ? a * b : a - b;
+        if (output_i32(x) != i32) {
+            printf("output_i32(%d) = %d instead of %d\n", x, output_i32(x), i32);
+            return -1;
+        }
+
+        float f = input_f32(x);
+        float f32 = fmaxf(f * 0.5f + a, f / 3.0f);
+        if (fabsf(output_f32(x) - f32) > 1e-4f * fabsf(f32)) {
+            printf("output_f32(%d) = %f instead of %f\n", x, output_f32(x), f32);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
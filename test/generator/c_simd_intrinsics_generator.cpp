@@ -0,0 +1,50 @@
+#include "Halide.h"
+
+using namespace Halide;
+
+namespace {
+
+// Vectorized arithmetic on several types and vector widths, to
+// exercise the C backend's SIMD vector types when the target has the
+// c_simd_intrinsics feature.
+class CSimdIntrinsics : public Generator<CSimdIntrinsics> {
+public:
+    Input<Buffer<uint8_t>> input_u8{"input_u8", 1};
+    Input<Buffer<float>> input_f32{"input_f32", 1};
+
+    Output<Buffer<uint8_t>> output_u8{"output_u8", 1};
+    Output<Buffer<int16_t>> output_i16{"output_i16", 1};
+    Output<Buffer<int32_t>> output_i32{"output_i32", 1};
+    Output<Buffer<float>> output_f32{"output_f32", 1};
+
+    void generate() {
+        Expr a = input_u8(x);
+        Expr b = cast<uint8_t>(x * 3);
+        output_u8(x) = select(a > b, a - b, b - a) + min(a, 17);
+
+        Expr a16 = cast<int16_t>(a), b16 = cast<int16_t>(b);
+        output_i16(x) = max((a16 * 3 - b16 * 5) >> 1, -300);
+
+        Expr a32 = cast<int32_t>(a), b32 = cast<int32_t>(b);
+        output_i32(x) = select(x % 3 == 0, a32 * b32, a32 - b32);
+
+        Expr f = input_f32(x);
+        output_f32(x) = max(f * 0.5f + cast<float>(a), f / 3.0f);
+    }
+
+    void schedule() {
+        // Lane counts that fill one 16-byte register, and some that
+        // take two.
+        output_u8.vectorize(x, 16);
+        output_i16.vectorize(x, 8);
+        output_i32.vectorize(x, 8);
+        output_f32.vectorize(x, 4);
+    }
+
+private:
+    Var x{"x"};
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(CSimdIntrinsics, c_simd_intrinsics)
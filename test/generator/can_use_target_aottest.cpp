@@ -54,7 +54,7 @@ int main(int argc, char **argv) {
 
     // Now start subtracting features; we should still be usable.
     // Note that this always ends with testing features=0, which should always pass.
-    for (int i = 0; i < (int)(halide_target_feature_end); i++) {
+    for (int i = 0; i < 64; i++) {
         if (host_features & (1ULL << i)) {
             host_features &= ~(1ULL << i);
             printf("host_features are: %x %x\n", (unsigned)host_features, (unsigned)(host_features >> 32));
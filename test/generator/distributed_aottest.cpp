@@ -0,0 +1,80 @@
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+
+#include <stdio.h>
+
+#include "distributed.h"
+
+using namespace Halide::Runtime;
+
+const int W = 32, H = 30;
+
+// A transport that runs the ranks one after another in this process.
+int current_rank = 0, num_ranks = 1;
+
+int my_rank(void *user_context) {
+    return current_rank;
+}
+
+int my_num_ranks(void *user_context) {
+    return num_ranks;
+}
+
+const halide_distributed_transport_t transport = {my_rank, my_num_ranks};
+
+int clamped(const Buffer<int> &in, int x, int y) {
+    x = x < 0 ? 0 : (x >= W ? W - 1 : x);
+    y = y < 0 ? 0 : (y >= H ? H - 1 : y);
+    return in(x, y);
+}
+
+int main(int argc, char **argv) {
+    Buffer<int> input(W, H);
+    input.for_each_element([&](int x, int y) { input(x, y) = (x * 7 + y * 13) % 23; });
+
+    halide_set_custom_distributed_transport(&transport);
+
+    for (num_ranks = 1; num_ranks <= 4; num_ranks++) {
+        Buffer<int> output(W, H);
+        output.fill(-1);
+        int slice = (H + num_ranks - 1) / num_ranks;
+        for (current_rank = 0; current_rank < num_ranks; current_rank++) {
+            if (distributed(input, output) != 0) {
+                printf("Pipeline failed\n");
+                return -1;
+            }
+
+            // Only the rows up to the end of this rank's slice have
+            // been written so far.
+            int end = (current_rank + 1) * slice;
+            for (int y = end; y < H; y++) {
+                if (output(0, y) != -1) {
+                    printf("Rank %d of %d wrote row %d, which is outside its slice\n",
+                           current_rank, num_ranks, y);
+                    return -1;
+                }
+            }
+        }
+
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                int correct = 0;
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        correct += clamped(input, x + dx, y + dy);
+                    }
+                }
+                if (output(x, y) != correct) {
+                    printf("With %d ranks, output(%d, %d) = %d instead of %d\n",
+                           num_ranks, x, y, output(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    halide_set_custom_distributed_transport(NULL);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,27 @@
+#include "Halide.h"
+
+namespace {
+
+// A blur whose rows are distributed across the ranks. Each rank
+// needs a halo of the input rows around its slice.
+class Distributed : public Halide::Generator<Distributed> {
+public:
+    Input<Buffer<int>> input{"input", 2};
+    Output<Buffer<int>> output{"output", 2};
+
+    void generate() {
+        Var x, y;
+
+        Func clamped = Halide::BoundaryConditions::repeat_edge(input);
+        Func blur_y("blur_y");
+        blur_y(x, y) = clamped(x, y - 1) + clamped(x, y) + clamped(x, y + 1);
+        output(x, y) = blur_y(x - 1, y) + blur_y(x, y) + blur_y(x + 1, y);
+
+        blur_y.compute_root();
+        output.distribute(y);
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(Distributed, distributed)
@@ -0,0 +1,88 @@
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+
+#include <stdio.h>
+
+#include "memoize_stats.h"
+
+using namespace Halide::Runtime;
+
+const int W = 64, H = 64;
+// Each cache entry is one int per pixel.
+const int64_t entry_bytes = W * H * sizeof(int);
+
+bool run(int offset) {
+    Buffer<int> out(W, H);
+    if (memoize_stats(offset, out) != 0) {
+        printf("Pipeline failed\n");
+        return false;
+    }
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            if (out(x, y) != (x + y + offset) * 2) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), (x + y + offset) * 2);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool get_stats(const char *func_name, halide_memoization_cache_stats_t *stats) {
+    if (halide_memoization_cache_get_stats("memoize_stats", func_name, stats) != 0) {
+        printf("No statistics for %s\n", func_name ? func_name : "the pipeline");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    halide_memoization_cache_stats_t stats;
+    if (halide_memoization_cache_get_stats("memoize_stats", NULL, &stats) != -1) {
+        printf("Expected no statistics before the pipeline has run\n");
+        return -1;
+    }
+
+    // A miss then a hit.
+    if (!run(1) || !run(1)) return -1;
+    if (!get_stats("memoized", &stats)) return -1;
+    if (stats.hits != 1 || stats.misses != 1 || stats.stores != 1 ||
+        stats.evictions != 0 || stats.bytes != entry_bytes) {
+        printf("Unexpected statistics: %llu hits, %llu misses, %llu stores, %llu evictions, %lld bytes\n",
+               (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+               (unsigned long long)stats.stores, (unsigned long long)stats.evictions,
+               (long long)stats.bytes);
+        return -1;
+    }
+
+    // Allow room for only two entries for this pipeline, and check
+    // that it evicts its own entries to stay within that.
+    if (halide_memoization_cache_set_pipeline_quota("memoize_stats", 2 * entry_bytes) != 0) {
+        printf("Failed to set quota\n");
+        return -1;
+    }
+    for (int i = 2; i < 10; i++) {
+        if (!run(i)) return -1;
+    }
+    if (!get_stats(NULL, &stats)) return -1;
+    if (stats.bytes > 2 * entry_bytes) {
+        printf("Pipeline is using %lld bytes, over its quota of %lld\n",
+               (long long)stats.bytes, (long long)(2 * entry_bytes));
+        return -1;
+    }
+    if (stats.misses != 9 || stats.evictions != 7) {
+        printf("Expected 9 misses and 7 evictions but saw %llu and %llu\n",
+               (unsigned long long)stats.misses, (unsigned long long)stats.evictions);
+        return -1;
+    }
+
+    halide_memoization_cache_reset_stats();
+    if (!get_stats("memoized", &stats)) return -1;
+    if (stats.hits != 0 || stats.misses != 0 || stats.bytes != 2 * entry_bytes) {
+        printf("Reset didn't clear the counters\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
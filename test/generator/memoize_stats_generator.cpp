@@ -0,0 +1,23 @@
+#include "Halide.h"
+
+namespace {
+
+class MemoizeStats : public Halide::Generator<MemoizeStats> {
+public:
+    Input<int> offset{"offset"};
+    Output<Buffer<int>> output{"output", 2};
+
+    void generate() {
+        Var x, y;
+
+        Func memoized{"memoized"};
+        memoized(x, y) = x + y + offset;
+        memoized.compute_root().memoize();
+
+        output(x, y) = memoized(x, y) * 2;
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(MemoizeStats, memoize_stats)
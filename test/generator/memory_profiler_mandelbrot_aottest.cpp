@@ -44,6 +44,15 @@ void validate(halide_profiler_state *s) {
         assert(mandelbrot_heap_per_iter <= p->memory_peak);
         assert(p->memory_peak <= mandelbrot_heap_total);
 
+        // Every run lands in the latency histogram.
+        uint64_t runs = 0;
+        for (int b = 0; b < halide_profiler_latency_buckets; b++) {
+            runs += p->latency_histogram[b];
+        }
+        assert(runs == num_launcher_tasks);
+        assert(halide_profiler_latency_percentile(p->latency_histogram, 50) <=
+               halide_profiler_latency_percentile(p->latency_histogram, 99));
+
         for (int i = 0; i < p->num_funcs; i++) {
             halide_profiler_func_stats *fs = p->funcs + i;
             if (strncmp(fs->name, "argmin", 6) == 0) {
@@ -54,6 +63,13 @@ void validate(halide_profiler_state *s) {
 
                 assert(fs->num_allocs == mandelbrot_n_mallocs);
                 assert(fs->memory_total == mandelbrot_heap_total);
+
+                // It's computed inside the tiles of count, so it gets
+                // no latency histogram.
+                assert(halide_profiler_latency_percentile(fs->latency_histogram, 99) == 0);
+            } else if (strncmp(fs->name, "count", 5) == 0) {
+                // The output does.
+                assert(halide_profiler_latency_percentile(fs->latency_histogram, 99) > 0);
             }
         }
     }
@@ -0,0 +1,99 @@
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+
+#include "halide_pipeline_instance.h"
+#include "pipeline_instance.h"
+
+using namespace Halide::Runtime;
+using Halide::Tools::PipelineInstance;
+
+std::atomic<int> mallocs;
+
+void *my_malloc(void *user_context, size_t x) {
+    mallocs++;
+    void *orig = malloc(x + 64);
+    void *ptr = (void *)((((size_t)orig + 64) >> 6) << 6);
+    ((void **)ptr)[-1] = orig;
+    return ptr;
+}
+
+void my_free(void *user_context, void *ptr) {
+    free(((void **)ptr)[-1]);
+}
+
+bool check(const Buffer<float> &in, const Buffer<float> &out) {
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            float correct = 0;
+            for (int dy = 0; dy < 3; dy++) {
+                for (int dx = 0; dx < 3; dx++) {
+                    correct += in(x + dx, y + dy);
+                }
+            }
+            if (fabs(out(x, y) - correct) > 1e-3f) {
+                printf("out(%d, %d) = %f instead of %f\n", x, y, out(x, y), correct);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    halide_set_custom_malloc(my_malloc);
+    halide_set_custom_free(my_free);
+
+    Buffer<float> in(130, 130);
+    in.for_each_element([&](int x, int y) { in(x, y) = (float)((x * 7 + y * 13) % 17); });
+
+    // Two instances with pools of their own, used concurrently.
+    PipelineInstance a(PipelineInstance::Options().with_threads(2));
+    PipelineInstance b(PipelineInstance::Options().with_threads(3));
+    Buffer<float> out_a(128, 128), out_b(128, 128);
+
+    // The first call on each reserves its scratch.
+    if (a.run(pipeline_instance, in, out_a) || b.run(pipeline_instance, in, out_b)) {
+        printf("Warm-up call failed\n");
+        return -1;
+    }
+    if (!check(in, out_a) || !check(in, out_b)) {
+        return -1;
+    }
+
+    mallocs = 0;
+    int ret_a = 0, ret_b = 0;
+    std::thread t([&]() {
+        for (int i = 0; i < 50 && ret_b == 0; i++) {
+            ret_b = b.run(pipeline_instance, in, out_b);
+        }
+    });
+    for (int i = 0; i < 50 && ret_a == 0; i++) {
+        ret_a = a.run(pipeline_instance, in, out_a);
+    }
+    t.join();
+
+    if (ret_a || ret_b) {
+        printf("Non zero exit code: %d %d\n", ret_a, ret_b);
+        return -1;
+    }
+    if (!check(in, out_a) || !check(in, out_b)) {
+        return -1;
+    }
+    if (mallocs != 0) {
+        printf("%d allocations in the steady state\n", (int)mallocs);
+        return -1;
+    }
+
+    // Calls through other user_contexts use the global state.
+    if (pipeline_instance(nullptr, in, out_a) || !check(in, out_a)) {
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
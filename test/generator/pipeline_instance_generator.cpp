@@ -0,0 +1,27 @@
+#include "Halide.h"
+
+namespace {
+
+class PipelineInstance : public Halide::Generator<PipelineInstance> {
+public:
+    Input<Buffer<float>> input{"input", 2};
+    Output<Buffer<float>> output{"output", 2};
+
+    void generate() {
+        // A root-level intermediate, which lives in the scratch arena
+        // of the instance, and a parallel loop, which runs on its
+        // thread pool.
+        Var x, y;
+
+        Func blur_x("blur_x");
+        blur_x(x, y) = input(x, y) + input(x + 1, y) + input(x + 2, y);
+        output(x, y) = blur_x(x, y) + blur_x(x, y + 1) + blur_x(x, y + 2);
+
+        blur_x.compute_root().parallel(y);
+        output.parallel(y);
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(PipelineInstance, pipeline_instance)
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+#include "profiler_lightweight.h"
+
+using namespace Halide::Runtime;
+
+namespace {
+
+struct Scrape {
+    int pipelines;
+    uint64_t expensive_time;
+    uint64_t total_time;
+    int runs;
+};
+
+void visit(void *arg, const halide_profiler_pipeline_stats *p) {
+    Scrape *scrape = (Scrape *)arg;
+    if (strcmp(p->name, "profiler_lightweight") != 0) {
+        return;
+    }
+    scrape->pipelines++;
+    scrape->runs += p->runs;
+    scrape->total_time += p->time;
+    for (int i = 0; i < p->num_funcs; i++) {
+        if (strcmp(p->funcs[i].name, "expensive") == 0) {
+            scrape->expensive_time += p->funcs[i].time;
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Buffer<float> output(1024, 256);
+    const int runs = 20;
+    for (int i = 0; i < runs; i++) {
+        if (profiler_lightweight(output) != 0) {
+            printf("Pipeline failed\n");
+            return -1;
+        }
+    }
+
+    Scrape first = {0, 0, 0, 0};
+    halide_profiler_visit_pipelines(visit, &first, true);
+    if (first.pipelines != 1 || first.runs != runs) {
+        printf("Expected one pipeline with %d runs, got %d pipelines with %d runs\n",
+               runs, first.pipelines, first.runs);
+        return -1;
+    }
+    if (first.total_time == 0 || first.expensive_time * 2 < first.total_time) {
+        printf("Expected most of the time to be in the expensive stage: %llu of %llu ns\n",
+               (unsigned long long)first.expensive_time, (unsigned long long)first.total_time);
+        return -1;
+    }
+
+    // The scrape reset the totals.
+    Scrape second = {0, 0, 0, 0};
+    halide_profiler_visit_pipelines(visit, &second, false);
+    if (second.pipelines != 1 || second.runs != 0 || second.total_time != 0) {
+        printf("Totals weren't reset\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
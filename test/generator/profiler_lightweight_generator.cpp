@@ -0,0 +1,29 @@
+#include "Halide.h"
+
+namespace {
+
+class ProfilerLightweight : public Halide::Generator<ProfilerLightweight> {
+public:
+    Output<Buffer<float>> output{"output", 2};
+
+    void generate() {
+        Var x, y;
+
+        // An expensive stage and a cheap one, both computed in
+        // parallel.
+        Func expensive{"expensive"};
+        Expr e = cast<float>(x + y);
+        for (int i = 0; i < 50; i++) {
+            e = sin(e);
+        }
+        expensive(x, y) = e;
+        expensive.compute_root().parallel(y);
+
+        output(x, y) = expensive(x, y) + 1.0f;
+        output.parallel(y);
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(ProfilerLightweight, profiler_lightweight)
@@ -0,0 +1,65 @@
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include "halide_state_buffer.h"
+#include "temporal_state.h"
+
+using namespace Halide::Runtime;
+using namespace Halide::Tools;
+
+// Not a multiple of the vector size, to test the tail.
+const int W = 37, H = 16;
+const int frames = 10;
+const float alpha = 0.25f;
+
+float frame_value(int x, int y, int t) {
+    return (float)((x + 3 * y + 7 * t) % 11);
+}
+
+bool run(bool in_place) {
+    Buffer<float> initial(W, H);
+    initial.fill(0.0f);
+    StateBuffer<float, 2> state(initial, in_place);
+    if (state.in_place() != in_place) {
+        printf("in_place() = %d instead of %d\n", state.in_place(), in_place);
+        return false;
+    }
+
+    Buffer<float> frame(W, H);
+    for (int t = 0; t < frames; t++) {
+        frame.for_each_element([&](int x, int y) { frame(x, y) = frame_value(x, y, t); });
+        if (temporal_state(frame, state.prev(), alpha, state.next()) != 0) {
+            printf("Pipeline failed\n");
+            return false;
+        }
+        state.advance();
+    }
+
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            float correct = 0.0f;
+            for (int t = 0; t < frames; t++) {
+                correct += alpha * (frame_value(x, y, t) - correct);
+            }
+            float result = state.prev()(x, y);
+            if (fabs(result - correct) > 1e-5f) {
+                printf("in_place = %d: state(%d, %d) = %f instead of %f\n",
+                       in_place, x, y, result, correct);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (!run(false) || !run(true)) {
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,28 @@
+#include "Halide.h"
+
+namespace {
+
+// Recursive exponential smoothing of a sequence of frames. The state
+// is the running average, which is passed back in for the next frame.
+class TemporalState : public Halide::Generator<TemporalState> {
+public:
+    Input<Buffer<float>> frame{"frame", 2};
+    Input<Buffer<float>> prev_state{"prev_state", 2};
+    Input<float> alpha{"alpha"};
+    Output<Buffer<float>> state{"state", 2};
+
+    void generate() {
+        Var x, y;
+
+        state(x, y) = prev_state(x, y) + alpha * (frame(x, y) - prev_state(x, y));
+
+        // Write each point of the state once, so it can be updated in
+        // place.
+        state.vectorize(x, natural_vector_size<float>(), TailStrategy::GuardWithIf)
+            .parallel(y);
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(TemporalState, temporal_state)
@@ -0,0 +1,113 @@
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <atomic>
+
+#include "thread_pools.h"
+
+using namespace Halide::Runtime;
+
+struct Context {
+    halide_thread_pool *pool;
+    std::atomic<int> lookups;
+};
+
+halide_thread_pool *my_get_thread_pool(void *user_context) {
+    Context *ctx = (Context *)user_context;
+    ctx->lookups++;
+    return ctx->pool;
+}
+
+bool check(const Buffer<float> &out) {
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            float correct = sqrtf(sqrtf(x * y));
+            if (fabs(out(x, y) - correct) > 1e-5f) {
+                printf("out(%d, %d) = %f instead of %f\n", x, y, out(x, y), correct);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+struct Job {
+    Context *ctx;
+    Buffer<float> *out;
+    int ret;
+};
+
+void run_job(void *arg) {
+    Job *job = (Job *)arg;
+    for (int i = 0; i < 100 && job->ret == 0; i++) {
+        job->ret = thread_pools(job->ctx, *job->out);
+    }
+}
+
+int main(int argc, char **argv) {
+    halide_set_custom_get_thread_pool(&my_get_thread_pool);
+
+    // An "interactive" pool and a "batch" pool, used concurrently.
+    Context interactive, batch;
+    interactive.pool = halide_create_thread_pool(NULL, 2, 0);
+    interactive.lookups = 0;
+    batch.pool = halide_create_thread_pool(NULL, 3, 0);
+    batch.lookups = 0;
+    if (!interactive.pool || !batch.pool) {
+        printf("Failed to create thread pools\n");
+        return -1;
+    }
+
+    Buffer<float> out_a(64, 64), out_b(64, 64);
+    Job a = {&interactive, &out_a, 0};
+    Job b = {&batch, &out_b, 0};
+
+    halide_thread *t = halide_spawn_thread(&run_job, &b);
+    run_job(&a);
+    halide_join_thread(t);
+
+    if (a.ret || b.ret) {
+        printf("Non zero exit code: %d %d\n", a.ret, b.ret);
+        return -1;
+    }
+    if (!check(out_a) || !check(out_b)) {
+        return -1;
+    }
+    if (interactive.lookups == 0 || batch.lookups == 0) {
+        printf("The thread pool hook was never consulted\n");
+        return -1;
+    }
+
+    // Idle workers can be told to sleep right away instead of spinning.
+    halide_thread_pool_set_spin_count(interactive.pool, 0);
+    if (halide_thread_pool_set_spin_count(interactive.pool, 100) != 0) {
+        printf("halide_thread_pool_set_spin_count didn't return the old value\n");
+        return -1;
+    }
+    halide_thread_pool_set_spin_count(batch.pool, 0);
+    if (thread_pools(&interactive, out_a) || !check(out_a) ||
+        thread_pools(&batch, out_b) || !check(out_b)) {
+        return -1;
+    }
+
+    // Pools can be resized and destroyed independently of the default pool.
+    halide_thread_pool_set_num_threads(batch.pool, 1);
+    if (thread_pools(&batch, out_b) || !check(out_b)) {
+        return -1;
+    }
+    halide_destroy_thread_pool(NULL, interactive.pool);
+    halide_destroy_thread_pool(NULL, batch.pool);
+
+    // A NULL pool means the default one.
+    Context fallback;
+    fallback.pool = NULL;
+    fallback.lookups = 0;
+    if (thread_pools(&fallback, out_a) || !check(out_a)) {
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
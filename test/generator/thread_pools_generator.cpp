@@ -0,0 +1,21 @@
+#include "Halide.h"
+
+namespace {
+
+class ThreadPools : public Halide::Generator<ThreadPools> {
+public:
+    Output<Buffer<float>> output{"output", 2};
+
+    void generate() {
+        // A job with nested parallelism, so that both levels have to
+        // run on the pool bound to the user_context.
+        Var x, y;
+
+        output(x, y) = sqrt(sqrt(x*y));
+        output.parallel(x).parallel(y);
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(ThreadPools, thread_pools)
@@ -0,0 +1,41 @@
+#include "Halide.h"
+#include <stdio.h>
+
+#include "testing.h"
+
+using namespace Halide;
+
+int main() {
+
+    // This test must be run with an OpenGL target.
+    const Target target = get_jit_target_from_environment().with_feature(Target::OpenGL);
+
+    // A chain of GLSL stages, whose intermediate textures are freed
+    // and reallocated each time the pipeline runs.
+    Func f, g, h;
+    Var x, y, c;
+    Param<uint8_t> offset;
+    g(x, y, c) = cast<uint8_t>(x + offset);
+    h(x, y, c) = g(x, y, c) + cast<uint8_t>(y);
+    f(x, y, c) = h(x, y, c) + cast<uint8_t>(c);
+    f.bound(c, 0, 3).glsl(x, y, c);
+    h.bound(c, 0, 3).compute_root().glsl(x, y, c);
+    g.bound(c, 0, 3).compute_root().glsl(x, y, c);
+
+    // Run it with a mix of sizes, so that reused textures of the
+    // wrong size would give the wrong answer.
+    const int sizes[][2] = {{10, 10}, {10, 10}, {16, 8}, {10, 10}, {7, 13}, {16, 8}};
+    for (int i = 0; i < 6; i++) {
+        offset.set((uint8_t)i);
+        Buffer<uint8_t> result = f.realize(sizes[i][0], sizes[i][1], 3, target);
+        result.copy_to_host();
+        if (!Testing::check_result<uint8_t>(result, [&](int px, int py, int pc) { return px + i + py + pc; })) {
+            printf("Failed on iteration %d\n", i);
+            return 1;
+        }
+    }
+
+    printf("Success!\n");
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+// Fit the costs that the auto-scheduler's calibrated cost model uses for the
+// host machine, and print the MachineParams to pass to the auto-scheduler.
+// The costs are in picoseconds, in the units that RegionCosts counts:
+// arithmetic operations, and bytes loaded or stored.
+
+// The time of a realization of f into out, in picoseconds.
+double time_ps(Func f, Buffer<float> out) {
+    f.compile_jit();
+    double t = benchmark(10, 10, [&]() {
+        f.realize(out);
+    });
+    return t * 1e12;
+}
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.has_gpu_feature()) {
+        printf("Not running test because the calibration is for CPU targets\n");
+        return 0;
+    }
+
+    Var x;
+
+    // Arithmetic: a long chain of multiply-adds on values in registers.
+    const int arith_points = 1 << 14;
+    const int chain_length = 64;
+    Buffer<float> small_in(arith_points), small_out(arith_points);
+    small_in.fill(1.0f);
+    Expr e = small_in(x);
+    for (int i = 0; i < chain_length; i++) {
+        e = e * 1.0001f + 0.5f;
+    }
+    Func arith;
+    arith(x) = e;
+    arith.vectorize(x, 8);
+    double arith_cost = time_ps(arith, small_out) / (arith_points * 2.0 * chain_length);
+
+    // Loads: a copy of a buffer that fits in the last-level cache, and of
+    // one that is much larger than it. Each point loads and stores 4 bytes,
+    // and does 2 arithmetic operations.
+    auto copy_cost = [&](int points) {
+        Buffer<float> in(points), out(points);
+        in.fill(1.0f);
+        Func copy;
+        copy(x) = in(x);
+        copy.vectorize(x, 8);
+        double t = time_ps(copy, out) - points * 2.0 * arith_cost;
+        return std::max(t, 0.0) / (points * 8.0);
+    };
+    double cached_cost = copy_cost(1 << 18);
+    double dram_cost = copy_cost(1 << 25);
+
+    MachineParams generic = MachineParams::generic();
+    const int64_t *llc = Internal::as_const_int(generic.last_level_cache_size);
+    MachineParams params(std::max((int)std::thread::hardware_concurrency(), 1),
+                         llc ? (int)*llc : 16 * 1024 * 1024,
+                         std::max((int)(dram_cost / std::max(cached_cost, 1e-3) + 0.5), 1),
+                         std::max((int)(arith_cost + 0.5), 1),
+                         std::max((int)(cached_cost + 0.5), 1));
+
+    printf("arithmetic op: %.3f ps, cached byte: %.3f ps, uncached byte: %.3f ps\n",
+           arith_cost, cached_cost, dram_cost);
+    printf("machine_params=%s\n", params.to_string().c_str());
+
+    // The printed string must round-trip.
+    if (MachineParams(params.to_string()).to_string() != params.to_string()) {
+        printf("MachineParams didn't round-trip: %s\n", params.to_string().c_str());
+        return -1;
+    }
+
+    // Auto-schedule a blur with the calibrated model, and check the result.
+    const int W = 1024, H = 1024;
+    Buffer<float> input(W + 2, H + 2);
+    for (int y = 0; y < input.height(); y++) {
+        for (int x = 0; x < input.width(); x++) {
+            input(x, y) = rand() & 0xfff;
+        }
+    }
+
+    Var y;
+    Func blur_x, blur_y;
+    blur_x(x, y) = (input(x, y) + input(x + 1, y) + input(x + 2, y)) / 3;
+    blur_y(x, y) = (blur_x(x, y) + blur_x(x, y + 1) + blur_x(x, y + 2)) / 3;
+    blur_y.estimate(x, 0, W).estimate(y, 0, H);
+
+    Pipeline p(blur_y);
+    p.auto_schedule(target, params);
+
+    Buffer<float> out(W, H);
+    double t = benchmark(10, 10, [&]() {
+        p.realize(out);
+    });
+    printf("Calibrated auto-schedule of blur: %f ms\n", t * 1e3);
+
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            float bx[3];
+            for (int i = 0; i < 3; i++) {
+                bx[i] = (input(x, y + i) + input(x + 1, y + i) + input(x + 2, y + i)) / 3;
+            }
+            float correct = (bx[0] + bx[1] + bx[2]) / 3;
+            if (std::abs(out(x, y) - correct) > 0.01f) {
+                printf("out(%d, %d) = %f instead of %f\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
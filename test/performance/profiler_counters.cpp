@@ -0,0 +1,61 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Halide;
+
+int ipc_lines = 0;
+int bad_lines = 0;
+void my_print(void *, const char *msg) {
+    const char *ipc = strstr(msg, "ipc: ");
+    while (ipc) {
+        float val = 0;
+        if (sscanf(ipc, "ipc: %f", &val) == 1 && val > 0 && val < 100) {
+            ipc_lines++;
+        } else {
+            printf("Bad counter summary: %s", msg);
+            bad_lines++;
+        }
+        ipc = strstr(ipc + 1, "ipc: ");
+    }
+}
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment().with_feature(Target::Profile);
+    if (t.os != Target::Linux || t.arch != Target::X86) {
+        printf("Not running test because hardware counters are only read on x86 Linux\n");
+        return 0;
+    }
+
+    static char env[] = "HL_PROFILER_COUNTERS=1";
+    putenv(env);
+
+    // A compute-bound stage and a bandwidth-bound one.
+    Var x, y;
+    Func compute("compute"), copy("copy");
+    Expr e = cast<float>(x + y);
+    for (int i = 0; i < 100; i++) {
+        e = sin(e);
+    }
+    compute(x, y) = e;
+
+    Buffer<float> big(4096, 4096);
+    big.fill(1.0f);
+    copy(x, y) = big(x, y) + compute(x % 16, y % 16);
+    compute.compute_root();
+    copy.set_custom_print(&my_print);
+
+    copy.realize(4096, 4096, t);
+
+    if (bad_lines) {
+        return -1;
+    }
+    if (ipc_lines == 0) {
+        // The kernel may not allow opening counters, e.g. in a container.
+        printf("Hardware counters unavailable\n");
+    }
+
+    printf("Success!\n");
+    return 0;
+}
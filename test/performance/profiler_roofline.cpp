@@ -0,0 +1,72 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Halide;
+
+float compute_intensity = -1, copy_intensity = -1;
+bool compute_bound = false, copy_memory_bound = false;
+
+void my_print(void *, const char *msg) {
+    const char *roofline = strstr(msg, "ops/byte: ");
+    if (!roofline) {
+        return;
+    }
+    float intensity;
+    if (sscanf(roofline, "ops/byte: %f", &intensity) != 1) {
+        printf("Bad roofline summary: %s", msg);
+        return;
+    }
+    if (strstr(msg, " compute: ")) {
+        compute_intensity = intensity;
+        compute_bound = strstr(msg, "(compute-bound)") != nullptr;
+    } else if (strstr(msg, " copy: ")) {
+        copy_intensity = intensity;
+        copy_memory_bound = strstr(msg, "(memory-bound)") != nullptr;
+    }
+}
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment().with_feature(Target::Profile);
+
+    // A peak of 100 GOP/s and 10 GB/s puts the ridge point at 10 ops
+    // per byte.
+    static char peak_gops[] = "HL_PROFILER_PEAK_GOPS=100";
+    static char peak_gbps[] = "HL_PROFILER_PEAK_GBPS=10";
+    putenv(peak_gops);
+    putenv(peak_gbps);
+
+    // A compute-bound stage and a bandwidth-bound one.
+    Var x, y;
+    Func compute("compute"), copy("copy");
+    Expr e = cast<float>(x + y);
+    for (int i = 0; i < 100; i++) {
+        e = sin(e);
+    }
+    compute(x, y) = e;
+
+    Buffer<float> big(4096, 4096);
+    big.fill(1.0f);
+    copy(x, y) = big(x, y) + compute(x % 512, y % 512);
+    compute.compute_root().vectorize(x, 8);
+    copy.vectorize(x, 8).parallel(y);
+    copy.set_custom_print(&my_print);
+
+    copy.realize(4096, 4096, t);
+
+    // compute does about 100 ops per 4 byte store, while copy does
+    // two 4 byte loads and a store for each add, and a few ops of
+    // indexing.
+    if (compute_intensity < 10 || copy_intensity < 0 || copy_intensity > 2) {
+        printf("Unexpected intensities: compute %f, copy %f\n", compute_intensity, copy_intensity);
+        return -1;
+    }
+    if (!compute_bound || !copy_memory_bound) {
+        printf("Expected compute to be compute-bound and copy to be memory-bound\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,329 @@
+// A Python extension module that wraps a single AOT-compiled Halide
+// filter, so that it can be called from Python without the Halide
+// compiler (or LLVM) in the process. It uses only the Python C API and
+// the filter's metadata, so the module is just this file, the filter,
+// and the Halide runtime.
+//
+// Build it the same way as RunGenStubs.cpp, naming the filter's header
+// and the module:
+//
+//     g++ -std=c++11 -shared -fPIC $(python3-config --includes)
+//         -DHL_PYEXT_FILTER_HEADER=\"my_filter.h\" -DHL_PYEXT_MODULE=my_filter
+//         -I path/to/filter/header tools/PyExtStubs.cpp my_filter.a -ldl -lpthread
+//         -o my_filter$(python3-config --extension-suffix)
+//
+// The module has one function, named after the module, taking the
+// filter's arguments in the order listed in its 'arguments' attribute,
+// by position or by name. Buffers may be any object supporting the
+// buffer protocol (e.g. numpy arrays) with the type and dimensionality
+// of the argument; axis i of the array is dimension i of the buffer.
+// Their memory is used directly, so outputs must be writable. Scalar
+// arguments with a default value may be omitted. The GIL is released
+// while the filter runs. Errors from the filter raise RuntimeError.
+
+#include <Python.h>
+
+#include "HalideRuntime.h"
+
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define HALIDE_GET_STANDARD_ARGV_FUNCTION halide_pyext_argv_getter
+#define HALIDE_GET_STANDARD_METADATA_FUNCTION halide_pyext_metadata_getter
+
+// This is legal C, as long as the macro expands to a single quoted (or <>-enclosed) string literal
+#include HL_PYEXT_FILTER_HEADER
+
+#define HL_PYEXT_CONCAT_IMPL(a, b) a##b
+#define HL_PYEXT_CONCAT(a, b) HL_PYEXT_CONCAT_IMPL(a, b)
+#define HL_PYEXT_STRINGIFY_IMPL(x) #x
+#define HL_PYEXT_STRINGIFY(x) HL_PYEXT_STRINGIFY_IMPL(x)
+#define HL_PYEXT_MODULE_NAME HL_PYEXT_STRINGIFY(HL_PYEXT_MODULE)
+
+namespace {
+
+// The errors reported by the filter since the last call failed. They
+// may come from any of the threads running it.
+std::mutex errors_mutex;
+std::string errors;
+
+void pyext_halide_error(void *user_context, const char *message) {
+    std::lock_guard<std::mutex> lock(errors_mutex);
+    errors += message;
+}
+
+std::string take_errors() {
+    std::lock_guard<std::mutex> lock(errors_mutex);
+    std::string e;
+    e.swap(errors);
+    while (!e.empty() && e.back() == '\n') {
+        e.pop_back();
+    }
+    return e;
+}
+
+const char *type_name(const halide_type_t &t) {
+    switch (t.code) {
+    case halide_type_int:
+        return t.bits == 8 ? "int8" : t.bits == 16 ? "int16" : t.bits == 32 ? "int32" : "int64";
+    case halide_type_uint:
+        return t.bits == 1 ? "bool" : t.bits == 8 ? "uint8" : t.bits == 16 ? "uint16" : t.bits == 32 ? "uint32" : "uint64";
+    case halide_type_float:
+        return t.bits == 32 ? "float32" : "float64";
+    default:
+        return "handle";
+    }
+}
+
+// Does the struct module format of a Python buffer describe elements
+// of type t?
+bool format_matches(const char *format, Py_ssize_t itemsize, const halide_type_t &t) {
+    std::string f = format ? format : "B";
+    if (f.size() == 2 && (f[0] == '@' || f[0] == '=' || f[0] == '<')) {
+        f = f.substr(1);
+    }
+    if (f.size() != 1) {
+        return false;
+    }
+    if (t.code == halide_type_uint && t.bits == 1) {
+        return f[0] == '?' && itemsize == 1;
+    }
+    if (itemsize * 8 != t.bits) {
+        return false;
+    }
+    switch (t.code) {
+    case halide_type_int:
+        return strchr("bhilq", f[0]) != nullptr;
+    case halide_type_uint:
+        return strchr("BHILQ", f[0]) != nullptr;
+    case halide_type_float:
+        return strchr("efd", f[0]) != nullptr;
+    default:
+        return false;
+    }
+}
+
+// Convert a Python number to the scalar type of an argument.
+bool to_scalar(PyObject *obj, const halide_filter_argument_t &arg, halide_scalar_value_t *value) {
+    const halide_type_t &t = arg.type;
+    if (t.code == halide_type_handle) {
+        value->u.handle = (obj == Py_None) ? nullptr : PyLong_AsVoidPtr(obj);
+    } else if (t.code == halide_type_float) {
+        double d = PyFloat_AsDouble(obj);
+        if (t.bits == 32) {
+            value->u.f32 = (float)d;
+        } else {
+            value->u.f64 = d;
+        }
+    } else if (t.code == halide_type_uint && t.bits == 1) {
+        int b = PyObject_IsTrue(obj);
+        if (b < 0) {
+            return false;
+        }
+        value->u.b = b != 0;
+    } else if (t.code == halide_type_uint) {
+        unsigned long long u = PyLong_AsUnsignedLongLong(obj);
+        switch (t.bits) {
+        case 8: value->u.u8 = (uint8_t)u; break;
+        case 16: value->u.u16 = (uint16_t)u; break;
+        case 32: value->u.u32 = (uint32_t)u; break;
+        default: value->u.u64 = (uint64_t)u; break;
+        }
+    } else {
+        long long i = PyLong_AsLongLong(obj);
+        switch (t.bits) {
+        case 8: value->u.i8 = (int8_t)i; break;
+        case 16: value->u.i16 = (int16_t)i; break;
+        case 32: value->u.i32 = (int32_t)i; break;
+        default: value->u.i64 = (int64_t)i; break;
+        }
+    }
+    if (PyErr_Occurred()) {
+        PyErr_Format(PyExc_TypeError, "Argument %s should be a %s", arg.name, type_name(t));
+        return false;
+    }
+    return true;
+}
+
+// The storage for one argument of a call.
+struct ArgStorage {
+    halide_scalar_value_t scalar;
+    Py_buffer view;
+    bool have_view = false;
+    halide_buffer_t buffer;
+    std::vector<halide_dimension_t> shape;
+
+    ~ArgStorage() {
+        if (have_view) {
+            PyBuffer_Release(&view);
+        }
+    }
+};
+
+// Wrap the memory of a Python buffer in a halide_buffer_t for an argument.
+bool to_buffer(PyObject *obj, const halide_filter_argument_t &arg, ArgStorage *storage) {
+    int flags = PyBUF_STRIDES | PyBUF_FORMAT;
+    if (arg.kind == halide_argument_kind_output_buffer) {
+        flags |= PyBUF_WRITABLE;
+    }
+    if (PyObject_GetBuffer(obj, &storage->view, flags) != 0) {
+        return false;
+    }
+    storage->have_view = true;
+    const Py_buffer &view = storage->view;
+    if (!format_matches(view.format, view.itemsize, arg.type)) {
+        PyErr_Format(PyExc_TypeError, "Argument %s should be a buffer of %s", arg.name, type_name(arg.type));
+        return false;
+    }
+    if (view.ndim != arg.dimensions) {
+        PyErr_Format(PyExc_ValueError, "Argument %s should have %d dimensions, not %d",
+                     arg.name, (int)arg.dimensions, (int)view.ndim);
+        return false;
+    }
+    storage->shape.resize(view.ndim);
+    for (int i = 0; i < view.ndim; i++) {
+        if (view.strides[i] % view.itemsize != 0) {
+            PyErr_Format(PyExc_ValueError, "Argument %s has strides that aren't a multiple of its element size", arg.name);
+            return false;
+        }
+        storage->shape[i].min = 0;
+        storage->shape[i].extent = (int32_t)view.shape[i];
+        storage->shape[i].stride = (int32_t)(view.strides[i] / view.itemsize);
+        storage->shape[i].flags = 0;
+    }
+    halide_buffer_t &b = storage->buffer;
+    b.device = 0;
+    b.device_interface = nullptr;
+    b.host = (uint8_t *)view.buf;
+    b.flags = 0;
+    b.type = arg.type;
+    b.dimensions = view.ndim;
+    b.dim = storage->shape.data();
+    b.padding = nullptr;
+    return true;
+}
+
+PyObject *call_filter(PyObject *self, PyObject *args, PyObject *kwargs) {
+    const halide_filter_metadata_t *md = halide_pyext_metadata_getter()();
+    const int n = md->num_arguments;
+    const Py_ssize_t num_positional = PyTuple_Size(args);
+    if (num_positional > n) {
+        PyErr_Format(PyExc_TypeError, "%s takes %d arguments, not %d", md->name, n, (int)num_positional);
+        return nullptr;
+    }
+
+    std::vector<ArgStorage> storage(n);
+    std::vector<void *> argv(n);
+    Py_ssize_t num_keywords_used = 0;
+    for (int i = 0; i < n; i++) {
+        const halide_filter_argument_t &arg = md->arguments[i];
+        PyObject *obj = nullptr;
+        if (i < num_positional) {
+            obj = PyTuple_GetItem(args, i);
+        } else if (kwargs) {
+            obj = PyDict_GetItemString(kwargs, arg.name);
+            if (obj) {
+                num_keywords_used++;
+            }
+        }
+        if (arg.kind == halide_argument_kind_input_scalar) {
+            if (obj) {
+                if (!to_scalar(obj, arg, &storage[i].scalar)) {
+                    return nullptr;
+                }
+            } else if (arg.def) {
+                storage[i].scalar = *arg.def;
+            } else if (arg.type.code == halide_type_handle) {
+                storage[i].scalar.u.handle = nullptr;
+            } else {
+                PyErr_Format(PyExc_TypeError, "%s is missing argument %s", md->name, arg.name);
+                return nullptr;
+            }
+            argv[i] = &storage[i].scalar;
+        } else {
+            if (!obj) {
+                PyErr_Format(PyExc_TypeError, "%s is missing argument %s", md->name, arg.name);
+                return nullptr;
+            }
+            if (!to_buffer(obj, arg, &storage[i])) {
+                return nullptr;
+            }
+            argv[i] = &storage[i].buffer;
+        }
+    }
+    if (kwargs && PyDict_Size(kwargs) != num_keywords_used) {
+        PyErr_Format(PyExc_TypeError, "%s received an unknown or repeated keyword argument", md->name);
+        return nullptr;
+    }
+
+    int result;
+    Py_BEGIN_ALLOW_THREADS
+    result = halide_pyext_argv_getter()(argv.data());
+    Py_END_ALLOW_THREADS
+    if (result != 0) {
+        PyErr_Format(PyExc_RuntimeError, "%s failed with error code %d: %s",
+                     md->name, result, take_errors().c_str());
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+// A list describing each argument, in the order the function takes them.
+PyObject *describe_arguments(const halide_filter_metadata_t *md) {
+    PyObject *list = PyList_New(md->num_arguments);
+    for (int i = 0; i < md->num_arguments; i++) {
+        const halide_filter_argument_t &arg = md->arguments[i];
+        const char *kind = arg.kind == halide_argument_kind_input_scalar ? "input_scalar" :
+                           arg.kind == halide_argument_kind_input_buffer ? "input_buffer" : "output_buffer";
+        PyList_SetItem(list, i, Py_BuildValue("{s:s,s:s,s:s,s:i}",
+                                              "name", arg.name,
+                                              "kind", kind,
+                                              "type", type_name(arg.type),
+                                              "dimensions", (int)arg.dimensions));
+    }
+    return list;
+}
+
+PyMethodDef methods[] = {
+    {HL_PYEXT_MODULE_NAME, (PyCFunction)(void (*)(void))call_filter, METH_VARARGS | METH_KEYWORDS,
+     "Run the filter. Takes the arguments listed in 'arguments', by position or by name."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+void add_attributes(PyObject *module) {
+    const halide_filter_metadata_t *md = halide_pyext_metadata_getter()();
+    PyModule_AddObject(module, "arguments", describe_arguments(md));
+    PyModule_AddStringConstant(module, "target", md->target);
+    halide_set_error_handler(pyext_halide_error);
+}
+
+#if PY_MAJOR_VERSION >= 3
+PyModuleDef module_def = {
+    PyModuleDef_HEAD_INIT,
+    HL_PYEXT_MODULE_NAME,
+    "An AOT-compiled Halide filter.",
+    -1,
+    methods
+};
+#endif
+
+}  // namespace
+
+#if PY_MAJOR_VERSION >= 3
+PyMODINIT_FUNC HL_PYEXT_CONCAT(PyInit_, HL_PYEXT_MODULE)() {
+    PyObject *module = PyModule_Create(&module_def);
+    if (module) {
+        add_attributes(module);
+    }
+    return module;
+}
+#else
+PyMODINIT_FUNC HL_PYEXT_CONCAT(init, HL_PYEXT_MODULE)() {
+    PyObject *module = Py_InitModule(HL_PYEXT_MODULE_NAME, methods);
+    if (module) {
+        add_attributes(module);
+    }
+}
+#endif
@@ -3,8 +3,13 @@
 #include "halide_benchmark.h"
 #include "halide_image_io.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <map>
@@ -12,11 +17,18 @@
 #include <set>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 extern "C" int halide_rungen_redirect_argv(void **args);
 extern "C" const struct halide_filter_metadata_t *halide_rungen_redirect_metadata();
 
+// Hardware performance counters, from the profiler support in the
+// Halide runtime. The values are indexed by halide_profiler_counter_t.
+// They're only available on Linux x86; elsewhere no counters open.
+extern "C" int halide_perf_counters_open();
+extern "C" int halide_perf_counters_read(uint64_t *values);
+
 // Buffer<> uses "shape" to mean "array of halide_dimension_t", but doesn't
 // provide a typedef for it (and doesn't use a vector for it in any event).
 using Shape = std::vector<halide_dimension_t>;
@@ -48,6 +60,9 @@ std::ostream &operator<<(std::ostream &stream, const halide_type_t &type) {
         case halide_type_handle:
             stream << "handle";
             break;
+        case halide_type_bfloat:
+            stream << "bfloat";
+            break;
         default:
             stream << "#unknown";
             break;
@@ -745,7 +760,8 @@ Arguments:
         some_input_buffer=/path/to/existing/file.png
         some_output_buffer=/path/to/create/output/file.png
 
-    We currently support JPG, PGM, PNG, PPM format. If the type or dimensions
+    We currently support HTENSOR, JPG, PGM, PNG, PPM format. HTENSOR is a raw
+    format that holds any type and shape, and is memory-mapped when loaded. If the type or dimensions
     of the input or output file type can't support the data (e.g., your filter
     uses float32 input and output, and you load/save to PNG), we'll use the most
     robust approximation within the format and issue a warning to stdout.
@@ -806,10 +822,44 @@ Flags:
         Override the default maximum number of benchmarking iterations; ignored
         if --benchmarks is not also specified.
 
+    --benchmark_min_samples=NUM [default = 3]:
+        Take at least this many samples (within the time limit), for a more
+        reliable median and confidence interval; ignored if --benchmarks is
+        not also specified.
+
+    --benchmark_warmup_time=DURATION_SECONDS [default = 0]:
+        Run the filter for this long before taking any samples; ignored if
+        --benchmarks is not also specified.
+
+    --benchmark_flush_cache=NUM_BYTES [default = 0]:
+        If nonzero, dirty a buffer of this size before each sample, to
+        measure cold-cache runs. Use a size larger than the last level
+        cache. Ignored if --benchmarks is not also specified.
+
+    --benchmark_json=PATH:
+        After benchmarking, time a series of single runs of the filter, and
+        write a JSON report to PATH (or to stdout if PATH is '-') with the
+        best time from the benchmark, the min, median and p99 of the single
+        runs, and the hardware counters per run (cycles, instructions, IPC,
+        last level cache misses and the bytes they moved, branch misses)
+        where they can be read (Linux x86). If the filter was compiled with
+        -profile, the report also has the profiler's stats for each Func
+        over the same runs; set HL_PROFILER_COUNTERS=1 to bill the hardware
+        counters to each Func too. Implies --benchmarks=all.
+
+    --concurrency=NUM:
+        Measure throughput instead of latency: run the filter from NUM
+        caller threads at once, each with its own copies of the inputs and
+        outputs, for the --benchmark_min_time, and report the calls per
+        second over all callers and the min, median and p99 latency of each
+        call. This shows contention in the thread pool, caches and allocator
+        that a single caller doesn't see.
+
     --track_memory:
         Override Halide memory allocator to track high-water mark of memory
-        allocation during run; note that this may slow down execution, so
-        benchmarks may be inaccurate if you combine --benchmark with this.
+        allocation during run. When combined with --benchmarks, the memory
+        is tracked in a separate run after benchmarking, as tracking may
+        slow down execution.
 
 Known Issues:
 
@@ -866,6 +916,190 @@ FormatInfo best_save_format(const Buffer<> &b, const std::set<FormatInfo> &info)
     return best;
 }
 
+// The nearest-rank percentile, from 0 to 100, of a set of times.
+double percentile(std::vector<double> times, double p) {
+    if (times.empty()) {
+        return 0;
+    }
+    std::sort(times.begin(), times.end());
+    size_t rank = (size_t) std::ceil(p / 100.0 * times.size());
+    return times[std::min(std::max(rank, (size_t) 1), times.size()) - 1];
+}
+
+// Quote a string for JSON output.
+std::string json_string(const std::string &s) {
+    std::ostringstream o;
+    o << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            o << '\\' << c;
+        } else if ((unsigned char) c < 0x20) {
+            o << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int) c << std::dec;
+        } else {
+            o << c;
+        }
+    }
+    o << '"';
+    return o.str();
+}
+
+// The names of the hardware counters in the JSON output, indexed by
+// halide_profiler_counter_t.
+const char *const counter_names[halide_profiler_num_counters] = {
+    "cycles", "instructions", "llc_misses", "branch_misses"
+};
+
+// Cache misses are reported as bytes moved to and from memory
+// assuming lines of this size.
+const int cache_line_bytes = 64;
+
+// Write the per-iteration averages of a set of counter totals.
+void write_counters(std::ostream &o, const uint64_t *counters, double iterations) {
+    o << "{";
+    for (int i = 0; i < halide_profiler_num_counters; i++) {
+        o << json_string(counter_names[i]) << ": " << counters[i] / iterations << ", ";
+    }
+    double cycles = (double) counters[halide_profiler_counter_cycles];
+    double ipc = cycles > 0 ? counters[halide_profiler_counter_instructions] / cycles : 0;
+    o << "\"ipc\": " << ipc << ", "
+      << "\"bytes_moved\": " << counters[halide_profiler_counter_cache_misses] * (double) cache_line_bytes / iterations
+      << "}";
+}
+
+// Gather the stats of each Func of a pipeline compiled with -profile,
+// as recorded by the profiler since its totals were last reset, as a
+// JSON object.
+void write_stage_stats(void *arg, const halide_profiler_pipeline_stats *p) {
+    if (p->runs == 0) {
+        return;
+    }
+    std::ostringstream o;
+    o << "{\"pipeline\": " << json_string(p->name)
+      << ", \"runs\": " << p->runs
+      << ", \"time_ns_per_run\": " << p->time / (double) p->runs
+      << ", \"stages\": [";
+    bool need_comma = false;
+    for (int i = 0; i < p->num_funcs; i++) {
+        const halide_profiler_func_stats &f = p->funcs[i];
+        if (f.time == 0 && f.memory_total == 0) {
+            continue;
+        }
+        o << (need_comma ? ",\n" : "\n")
+          << "      {\"name\": " << json_string(f.name)
+          << ", \"time_ns_per_run\": " << f.time / (double) p->runs
+          << ", \"percent\": " << (p->time ? 100.0 * f.time / p->time : 0.0)
+          << ", \"p99_ns\": " << halide_profiler_latency_percentile(f.latency_histogram, 99)
+          << ", \"memory_peak\": " << f.memory_peak
+          << ", \"num_allocs\": " << f.num_allocs
+          << ", \"counters\": ";
+        write_counters(o, f.counters, p->runs);
+        o << "}";
+        need_comma = true;
+    }
+    o << "]}";
+    ((std::vector<std::string> *) arg)->push_back(o.str());
+}
+
+void ignore_stage_stats(void *arg, const halide_profiler_pipeline_stats *p) {
+}
+
+// Run the filter from several caller threads at once for about
+// 'duration' seconds, and report the aggregate throughput and the
+// distribution of the latency of each call. Each caller has its own
+// copies of the buffers, so that the callers only share what the
+// runtime shares (the thread pool, caches, and allocator). The
+// outputs of the first caller are copied back into 'args'.
+void benchmark_concurrently(std::map<std::string, ArgData> &args, int concurrency,
+                            double duration, double megapixels, const char *name) {
+    using BenchmarkClock = Halide::Tools::SteadyClock<>::type;
+
+    struct Caller {
+        // Keyed by argument index. The nodes of a map don't move, so
+        // the raw buffer pointers in argv stay valid.
+        std::map<size_t, Buffer<>> buffers;
+        std::vector<void *> argv;
+        std::vector<double> times;
+    };
+    std::vector<Caller> callers(concurrency);
+    for (Caller &c : callers) {
+        c.argv.resize(args.size(), nullptr);
+        for (auto &arg_pair : args) {
+            auto &arg = arg_pair.second;
+            if (arg.metadata->kind == halide_argument_kind_input_scalar) {
+                c.argv[arg.index] = &arg.scalar_value;
+                continue;
+            }
+            Buffer<> &b = c.buffers[arg.index];
+            b = allocate_buffer(arg.buffer_value.type(), get_shape(arg.buffer_value));
+            if (arg.metadata->kind == halide_argument_kind_input_buffer) {
+                b.copy_from(arg.buffer_value);
+            }
+            c.argv[arg.index] = b.raw_buffer();
+        }
+    }
+
+    const auto run = [&args](Caller &c) {
+        // Ignore result since our halide_error() should catch everything.
+        (void) halide_rungen_redirect_argv(&c.argv[0]);
+        for (auto &arg_pair : args) {
+            auto &arg = arg_pair.second;
+            if (arg.metadata->kind == halide_argument_kind_output_buffer) {
+                c.buffers[arg.index].device_sync();
+            }
+        }
+    };
+
+    // Each caller runs once to warm up, then they all start together.
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    BenchmarkClock::time_point deadline;
+    std::vector<std::thread> threads;
+    for (Caller &c : callers) {
+        threads.emplace_back([&]() {
+            run(c);
+            ready++;
+            while (!go) {
+                std::this_thread::yield();
+            }
+            do {
+                auto start = BenchmarkClock::now();
+                run(c);
+                auto end = BenchmarkClock::now();
+                c.times.push_back(std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count());
+            } while (BenchmarkClock::now() < deadline);
+        });
+    }
+    while (ready < concurrency) {
+        std::this_thread::yield();
+    }
+    auto start = BenchmarkClock::now();
+    deadline = start + std::chrono::duration_cast<BenchmarkClock::duration>(std::chrono::duration<double>(duration));
+    go = true;
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    double elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(BenchmarkClock::now() - start).count();
+
+    std::vector<double> times;
+    for (const Caller &c : callers) {
+        times.insert(times.end(), c.times.begin(), c.times.end());
+    }
+    const double calls_per_sec = times.size() / elapsed;
+    std::cout << "Throughput for " << name << " with " << concurrency << " concurrent callers is "
+              << calls_per_sec << " calls/sec (" << times.size() << " calls in " << elapsed << " sec), "
+              << (megapixels * calls_per_sec) << " mpix/sec.\n";
+    std::cout << "Latency per call is " << percentile(times, 0) << " sec min, "
+              << percentile(times, 50) << " sec median, "
+              << percentile(times, 99) << " sec p99.\n";
+
+    for (auto &arg_pair : args) {
+        auto &arg = arg_pair.second;
+        if (arg.metadata->kind == halide_argument_kind_output_buffer) {
+            arg.buffer_value.copy_from(callers[0].buffers[arg.index]);
+        }
+    }
+}
+
 }  // namespace
 
 int main(int argc, char **argv) {
@@ -898,11 +1132,16 @@ int main(int argc, char **argv) {
     Shape default_output_shape;
     std::vector<std::string> unknown_args;
     bool benchmark = false;
+    std::string benchmark_json;
+    int concurrency = 0;
     bool track_memory = false;
     bool describe = false;
     double benchmark_min_time = BenchmarkConfig().min_time;
     int benchmark_min_iters = BenchmarkConfig().min_iters;
     int benchmark_max_iters = BenchmarkConfig().max_iters;
+    int benchmark_min_samples = BenchmarkConfig().min_samples;
+    double benchmark_warmup_time = BenchmarkConfig().warmup_time;
+    uint64_t benchmark_flush_cache = BenchmarkConfig().flush_cache_bytes;
     for (int i = 1; i < argc; ++i) {
         if (argv[i][0] == '-') {
             const char *p = argv[i] + 1; // skip -
@@ -948,6 +1187,16 @@ int main(int argc, char **argv) {
                     fail() << "The only valid value for --benchmarks is 'all'";
                 }
                 benchmark = true;
+            } else if (flag_name == "benchmark_json") {
+                if (flag_value.empty()) {
+                    fail() << "Invalid value for flag: " << flag_name;
+                }
+                benchmark_json = flag_value;
+                benchmark = true;
+            } else if (flag_name == "concurrency") {
+                if (!parse_scalar(flag_value, &concurrency) || concurrency < 1) {
+                    fail() << "Invalid value for flag: " << flag_name;
+                }
             } else if (flag_name == "benchmark_min_time") {
                 if (!parse_scalar(flag_value, &benchmark_min_time)) {
                     fail() << "Invalid value for flag: " << flag_name;
@@ -960,6 +1209,18 @@ int main(int argc, char **argv) {
                 if (!parse_scalar(flag_value, &benchmark_max_iters)) {
                     fail() << "Invalid value for flag: " << flag_name;
                 }
+            } else if (flag_name == "benchmark_min_samples") {
+                if (!parse_scalar(flag_value, &benchmark_min_samples)) {
+                    fail() << "Invalid value for flag: " << flag_name;
+                }
+            } else if (flag_name == "benchmark_warmup_time") {
+                if (!parse_scalar(flag_value, &benchmark_warmup_time)) {
+                    fail() << "Invalid value for flag: " << flag_name;
+                }
+            } else if (flag_name == "benchmark_flush_cache") {
+                if (!parse_scalar(flag_value, &benchmark_flush_cache)) {
+                    fail() << "Invalid value for flag: " << flag_name;
+                }
             } else if (flag_name == "output_extents") {
                 default_output_shape = parse_extents(flag_value);
             } else {
@@ -1000,10 +1261,16 @@ int main(int argc, char **argv) {
     }
 
     // It's OK to omit output arguments when we are benchmarking or tracking memory.
-    bool ok_to_omit_outputs = (benchmark || track_memory);
+    bool ok_to_omit_outputs = (benchmark || concurrency > 0 || track_memory);
+
+    if (benchmark && concurrency > 0) {
+        fail() << "--concurrency can't be combined with --benchmarks.";
+    }
 
-    if (benchmark && track_memory) {
-        warn() << "Using --track_memory with --benchmarks will produce inaccurate benchmark results.";
+    if (!benchmark_json.empty()) {
+        // Open the counters before the first run of the filter, so that
+        // the thread pool it starts inherits them.
+        halide_perf_counters_open();
     }
 
     // Check to be sure that all required arguments are specified.
@@ -1087,9 +1354,10 @@ int main(int argc, char **argv) {
     uint64_t pixels_out = calc_pixels_out(args);
     double megapixels = (double) pixels_out / (1024.0 * 1024.0);
 
-    // If we're tracking memory, install the memory tracker *after* doing a bounds query.
+    // If we're tracking memory, install the memory tracker *after* doing a bounds query
+    // (or after benchmarking, if we're benchmarking).
     HalideMemoryTracker tracker;
-    if (track_memory) {
+    if (track_memory && !benchmark) {
         tracker.install();
     }
 
@@ -1108,7 +1376,10 @@ int main(int argc, char **argv) {
             }
         }
 
-        if (benchmark) {
+        if (concurrency > 0) {
+            info() << "Benchmarking filter with " << concurrency << " concurrent callers...";
+            benchmark_concurrently(args, concurrency, benchmark_min_time, megapixels, md->name);
+        } else if (benchmark) {
             const auto benchmark_inner = [&filter_argv, &args]() {
                 // Ignore result since our halide_error() should catch everything.
                 (void) halide_rungen_redirect_argv(&filter_argv[0]);
@@ -1130,14 +1401,98 @@ int main(int argc, char **argv) {
             config.max_time = benchmark_min_time * 4;
             config.min_iters = benchmark_min_iters;
             config.max_iters = benchmark_max_iters;
+            config.min_samples = benchmark_min_samples;
+            config.warmup_time = benchmark_warmup_time;
+            config.flush_cache_bytes = benchmark_flush_cache;
             auto result = Halide::Tools::benchmark(benchmark_inner, config);
 
             std::cout << "Benchmark for " << md->name << " produces best case of " << result.wall_time << " sec/iter (over "
                 << result.samples << " samples, "
                 << result.iterations << " iterations, "
                 << "accuracy " << std::setprecision(2) << (result.accuracy * 100.0) << "%).\n";
+            std::cout << "Median is " << std::setprecision(6) << result.median << " sec/iter (95% confidence interval "
+                << result.median_low << " to " << result.median_high << ", "
+                << result.outliers << " outliers).\n";
             std::cout << "Best output throughput is " << (megapixels / result.wall_time) << " mpix/sec.\n";
 
+            if (!benchmark_json.empty()) {
+                // Time single runs, for the distribution of run times,
+                // and read the counters and the profiler's stats over
+                // the same runs.
+                using BenchmarkClock = Halide::Tools::SteadyClock<>::type;
+                const int runs = (int) std::min(std::max(benchmark_min_time / result.wall_time, 10.0), 10000.0);
+                std::vector<double> times(runs);
+                uint64_t counters_before[halide_profiler_num_counters] = {0};
+                uint64_t counters[halide_profiler_num_counters] = {0};
+                halide_profiler_visit_pipelines(ignore_stage_stats, nullptr, true);
+                const bool have_counters = halide_perf_counters_read(counters_before) > 0;
+                for (int i = 0; i < runs; i++) {
+                    auto start = BenchmarkClock::now();
+                    benchmark_inner();
+                    auto end = BenchmarkClock::now();
+                    times[i] = std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
+                }
+                if (have_counters) {
+                    halide_perf_counters_read(counters);
+                    for (int i = 0; i < halide_profiler_num_counters; i++) {
+                        counters[i] -= counters_before[i];
+                    }
+                }
+                std::vector<std::string> pipelines;
+                halide_profiler_visit_pipelines(write_stage_stats, &pipelines, false);
+
+                if (track_memory) {
+                    // Track memory in a run of its own, so that tracking
+                    // doesn't slow down the runs timed above.
+                    tracker.install();
+                    benchmark_inner();
+                }
+
+                std::ofstream file;
+                if (benchmark_json != "-") {
+                    file.open(benchmark_json.c_str());
+                    if (!file) {
+                        fail() << "Unable to open " << benchmark_json;
+                    }
+                }
+                std::ostream &o = (benchmark_json == "-") ? std::cout : file;
+                o << std::setprecision(6)
+                  << "{\n"
+                  << "  \"name\": " << json_string(md->name) << ",\n"
+                  << "  \"target\": " << json_string(md->target) << ",\n"
+                  << "  \"best_time\": " << result.wall_time << ",\n"
+                  << "  \"benchmark_samples\": " << result.samples << ",\n"
+                  << "  \"benchmark_iterations\": " << result.iterations << ",\n"
+                  << "  \"accuracy\": " << result.accuracy << ",\n"
+                  << "  \"benchmark_median\": " << result.median << ",\n"
+                  << "  \"benchmark_median_low\": " << result.median_low << ",\n"
+                  << "  \"benchmark_median_high\": " << result.median_high << ",\n"
+                  << "  \"benchmark_outliers\": " << result.outliers << ",\n"
+                  << "  \"runs\": " << runs << ",\n"
+                  << "  \"min_time\": " << percentile(times, 0) << ",\n"
+                  << "  \"median_time\": " << percentile(times, 50) << ",\n"
+                  << "  \"p99_time\": " << percentile(times, 99) << ",\n"
+                  << "  \"megapixels_per_sec\": " << megapixels / result.wall_time << ",\n";
+                if (track_memory) {
+                    o << "  \"memory_highwater\": " << tracker.highwater() << ",\n";
+                }
+                o << "  \"counters\": ";
+                if (have_counters) {
+                    write_counters(o, counters, runs);
+                } else {
+                    o << "null";
+                }
+                o << ",\n"
+                  << "  \"pipelines\": [";
+                for (size_t i = 0; i < pipelines.size(); i++) {
+                    o << (i > 0 ? ",\n    " : "\n    ") << pipelines[i];
+                }
+                o << "]\n"
+                  << "}\n";
+            } else if (track_memory) {
+                tracker.install();
+                benchmark_inner();
+            }
         } else {
             info() << "Running filter...";
             // Ignore result since our halide_error() should catch everything.
@@ -0,0 +1,128 @@
+// Compare two files of benchmark results, as written by the functions in
+// halide_benchmark.h when HL_BENCHMARK_JSON is set (one JSON object per
+// line, with a "name" and a best "time" in seconds), and report the
+// benchmarks that got slower.
+//
+// Usage: compare_benchmarks baseline.json current.json [tolerance] [tolerances.txt]
+//
+// A benchmark regressed if its time grew by more than its tolerance, a
+// fraction of the baseline time (0.1 by default). The optional
+// tolerances file overrides it for some benchmarks, with one
+// "name tolerance" pair per line; lines starting with '#' are ignored.
+// Exits with a nonzero status if any benchmark regressed.
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+namespace {
+
+// Find the value of a field in one of the lines written by
+// record_benchmark. Returns an empty string if it's missing.
+std::string field(const std::string &line, const std::string &name) {
+    const std::string key = "\"" + name + "\": ";
+    size_t start = line.find(key);
+    if (start == std::string::npos) {
+        return "";
+    }
+    start += key.size();
+    if (line[start] == '"') {
+        size_t end = line.find('"', start + 1);
+        return end == std::string::npos ? "" : line.substr(start + 1, end - start - 1);
+    }
+    size_t end = line.find_first_of(",}", start);
+    return line.substr(start, end - start);
+}
+
+// Read the best time of each benchmark in a file. If a benchmark
+// appears more than once (e.g. the suite was run several times into
+// the same file), keep its best time.
+bool read_results(const char *filename, std::map<std::string, double> *results) {
+    std::ifstream f(filename);
+    if (!f) {
+        std::cerr << "Unable to open " << filename << "\n";
+        return false;
+    }
+    std::string line;
+    while (std::getline(f, line)) {
+        std::string name = field(line, "name");
+        std::string time = field(line, "time");
+        if (name.empty() || time.empty()) {
+            continue;
+        }
+        double t = atof(time.c_str());
+        auto it = results->find(name);
+        if (it == results->end() || t < it->second) {
+            (*results)[name] = t;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 3 || argc > 5) {
+        std::cerr << "Usage: " << argv[0] << " baseline.json current.json [tolerance] [tolerances.txt]\n";
+        return 1;
+    }
+
+    std::map<std::string, double> baseline, current;
+    if (!read_results(argv[1], &baseline) || !read_results(argv[2], &current)) {
+        return 1;
+    }
+
+    double default_tolerance = argc > 3 ? atof(argv[3]) : 0.1;
+    std::map<std::string, double> tolerances;
+    if (argc > 4) {
+        std::ifstream f(argv[4]);
+        if (!f) {
+            std::cerr << "Unable to open " << argv[4] << "\n";
+            return 1;
+        }
+        std::string line;
+        while (std::getline(f, line)) {
+            std::istringstream s(line);
+            std::string name;
+            double tolerance;
+            if (line.empty() || line[0] == '#' || !(s >> name >> tolerance)) {
+                continue;
+            }
+            tolerances[name] = tolerance;
+        }
+    }
+
+    int regressions = 0;
+    for (const auto &b : baseline) {
+        auto it = current.find(b.first);
+        if (it == current.end()) {
+            printf("%-48s %12.6g %12s\n", b.first.c_str(), b.second, "missing");
+            continue;
+        }
+        auto tol = tolerances.find(b.first);
+        double tolerance = tol == tolerances.end() ? default_tolerance : tol->second;
+        double ratio = it->second / b.second;
+        bool regressed = ratio > 1 + tolerance;
+        printf("%-48s %12.6g %12.6g %7.3fx%s\n", b.first.c_str(), b.second, it->second, ratio,
+               regressed ? "  REGRESSION" : "");
+        if (regressed) {
+            regressions++;
+        }
+    }
+    for (const auto &c : current) {
+        if (!baseline.count(c.first)) {
+            printf("%-48s %12s %12.6g\n", c.first.c_str(), "new", c.second);
+        }
+    }
+
+    if (regressions) {
+        printf("%d of %d benchmarks regressed.\n", regressions, (int)baseline.size());
+        return 1;
+    }
+    printf("No regressions in %d benchmarks.\n", (int)baseline.size());
+    return 0;
+}
@@ -0,0 +1,184 @@
+#ifndef HALIDE_AUTOTUNE_H
+#define HALIDE_AUTOTUNE_H
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Halide.h"
+#include "halide_benchmark.h"
+
+namespace Halide {
+namespace Tools {
+
+// An empirical search over the schedules the auto-scheduler generates
+// for a pipeline. The auto-scheduler is greedy: the grouping it picks
+// at each step depends on its cost model and the MachineParams it is
+// given, and it never revisits a choice. This instead runs an
+// evolutionary beam search over the MachineParams: each candidate is
+// auto-scheduled, JIT-compiled and benchmarked, and the fastest few
+// candidates of each generation are mutated to produce the next one.
+// Candidates that lead to a schedule that has already been measured
+// are not benchmarked again.
+//
+// This is meant for offline tuning; each candidate costs a compilation
+// and a benchmark. The resulting MachineParams can be passed to the
+// auto-scheduler (e.g. as the machine_params GeneratorParam) to get
+// the same schedule again.
+
+struct AutotuneConfig {
+    // Number of generations of the search.
+    int generations = 8;
+
+    // Number of new candidates in each generation.
+    int population = 8;
+
+    // Number of the fastest candidates that are kept, and mutated to
+    // produce the next generation.
+    int beam_width = 3;
+
+    // Mutations scale each of the MachineParams by a random factor of
+    // up to 2^max_log2_scale, up or down.
+    double max_log2_scale = 1.0;
+
+    // Seed of the random mutations.
+    uint32_t seed = 0;
+
+    // Print each candidate and its runtime.
+    bool verbose = false;
+
+    // How each candidate is benchmarked.
+    BenchmarkConfig benchmark_config;
+};
+
+struct AutotuneResult {
+    // The MachineParams for which the auto-scheduler produced the
+    // fastest schedule.
+    MachineParams params = MachineParams::generic();
+
+    // The fastest schedule, as returned by Pipeline::auto_schedule.
+    std::string schedule;
+
+    // The best runtime of the fastest schedule (seconds).
+    double wall_time = std::numeric_limits<double>::infinity();
+
+    // Number of distinct schedules that were benchmarked.
+    int schedules_measured = 0;
+};
+
+// Search for the fastest auto-schedule of the pipeline built by
+// 'make_pipeline', which must return a new pipeline with no schedules
+// (other than estimates) each time it is called, since scheduling a
+// pipeline modifies its Funcs. 'run' must realize the pipeline
+// into representative outputs; on GPU targets, it should also call
+// device_sync() (see the notes on benchmark()). The search starts
+// from 'initial'.
+inline AutotuneResult autotune(std::function<Pipeline()> make_pipeline,
+                               std::function<void(Pipeline)> run,
+                               const Target &target,
+                               const AutotuneConfig &config = AutotuneConfig(),
+                               const MachineParams &initial = MachineParams::generic()) {
+    struct Candidate {
+        MachineParams params;
+        std::string schedule;
+        double wall_time;
+    };
+
+    std::map<std::string, double> measured;
+    AutotuneResult result;
+
+    // The schedules are compared without the line that records the
+    // MachineParams they were generated with.
+    auto schedule_key = [](const std::string &schedule) {
+        const std::string header = "// MachineParams: ";
+        size_t start = schedule.find(header);
+        if (start == std::string::npos) {
+            return schedule;
+        }
+        size_t end = schedule.find('\n', start);
+        return schedule.substr(0, start) +
+               (end == std::string::npos ? "" : schedule.substr(end + 1));
+    };
+
+    auto evaluate = [&](const MachineParams &params) {
+        Pipeline p = make_pipeline();
+        Candidate c{params, p.auto_schedule(target, params), 0.0};
+        auto iter = measured.find(schedule_key(c.schedule));
+        if (iter != measured.end()) {
+            c.wall_time = iter->second;
+        } else {
+            p.compile_jit(target);
+            c.wall_time = benchmark([&]() { run(p); }, config.benchmark_config);
+            measured.emplace(schedule_key(c.schedule), c.wall_time);
+            if (config.verbose) {
+                printf("MachineParams %s: %f ms\n",
+                       params.to_string().c_str(), c.wall_time * 1e3);
+            }
+        }
+        return c;
+    };
+
+    std::mt19937 rng(config.seed);
+    std::uniform_real_distribution<double> log2_scale(-config.max_log2_scale,
+                                                      config.max_log2_scale);
+    auto mutate_field = [&](const Expr &e) {
+        const int64_t *value = Internal::as_const_int(e);
+        int64_t v = value ? *value : 1;
+        v = (int64_t)(v * std::exp2(log2_scale(rng)) + 0.5);
+        return (int32_t)std::min<int64_t>(std::max<int64_t>(v, 1), INT32_MAX);
+    };
+    auto mutate = [&](const MachineParams &params) {
+        MachineParams child(mutate_field(params.parallelism),
+                            mutate_field(params.last_level_cache_size),
+                            mutate_field(params.balance));
+        // The inner caches and the calibrated costs describe the machine,
+        // so they aren't tuned.
+        child.inner_cache_sizes = params.inner_cache_sizes;
+        child.arith_cost = params.arith_cost;
+        child.load_cost = params.load_cost;
+        return child;
+    };
+
+    std::vector<Candidate> beam = {evaluate(initial)};
+    for (int g = 0; g < config.generations; g++) {
+        std::vector<Candidate> next = beam;
+        for (int i = 0; i < config.population; i++) {
+            next.push_back(evaluate(mutate(beam[i % beam.size()].params)));
+        }
+
+        // Keep the fastest candidates, with one candidate per schedule.
+        std::stable_sort(next.begin(), next.end(), [](const Candidate &a, const Candidate &b) {
+            return a.wall_time < b.wall_time;
+        });
+        beam.clear();
+        for (const Candidate &c : next) {
+            if ((int)beam.size() == std::max(config.beam_width, 1)) {
+                break;
+            }
+            bool duplicate = std::any_of(beam.begin(), beam.end(), [&](const Candidate &b) {
+                return schedule_key(b.schedule) == schedule_key(c.schedule);
+            });
+            if (!duplicate) {
+                beam.push_back(c);
+            }
+        }
+    }
+
+    result.params = beam[0].params;
+    result.schedule = beam[0].schedule;
+    result.wall_time = beam[0].wall_time;
+    result.schedules_measured = (int)measured.size();
+    return result;
+}
+
+}  // namespace Tools
+}  // namespace Halide
+
+#endif
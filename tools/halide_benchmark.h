@@ -4,8 +4,13 @@
 #include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <functional>
 #include <limits>
+#include <vector>
 
 namespace Halide {
 namespace Tools {
@@ -22,6 +27,48 @@ struct SteadyClock<false> {
     using type = std::chrono::steady_clock;
 };
 
+// If the environment variable HL_BENCHMARK_JSON names a file, every
+// benchmark run by the functions below appends a line to it, holding a
+// JSON object with the benchmark's name, its best time per iteration,
+// and (for the adaptive benchmark) the median. The name is the value of
+// HL_BENCHMARK_NAME (or "benchmark") followed by the number of the
+// benchmark within the process, so that a harness running many
+// programs can tell their results apart. tools/compare_benchmarks.cpp
+// compares two such files.
+inline void record_benchmark(double best, double median) {
+    // One count for the whole program, as this function is inline.
+    static int count = 0;
+    const int index = count++;
+    const char *path = getenv("HL_BENCHMARK_JSON");
+    if (!path || !*path) {
+        return;
+    }
+    FILE *f = fopen(path, "a");
+    if (!f) {
+        return;
+    }
+    const char *name = getenv("HL_BENCHMARK_NAME");
+    fprintf(f, "{\"name\": \"%s/%d\", \"time\": %.9g", (name && *name) ? name : "benchmark", index, best);
+    if (median > 0) {
+        fprintf(f, ", \"median\": %.9g", median);
+    }
+    fprintf(f, "}\n");
+    fclose(f);
+}
+
+// The time in seconds per iteration of running 'op' 'iterations' times.
+inline double time_iterations(uint64_t iterations, const std::function<void()> &op) {
+    using BenchmarkClock = SteadyClock<>::type;
+    auto start = BenchmarkClock::now();
+    for (uint64_t j = 0; j < iterations; j++) {
+        op();
+    }
+    auto end = BenchmarkClock::now();
+    double elapsed_seconds =
+            std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
+    return elapsed_seconds / iterations;
+}
+
 // Benchmark the operation 'op'. The number of iterations refers to
 // how many times the operation is run for each time measurement, the
 // result is the minimum over a number of samples runs. The result is the
@@ -40,26 +87,23 @@ struct SteadyClock<false> {
 // code should measure with extreme caution.
 
 inline double benchmark(int samples, int iterations, std::function<void()> op) {
-    using BenchmarkClock = SteadyClock<>::type;
     double best = std::numeric_limits<double>::infinity();
     for (int i = 0; i < samples; i++) {
-        auto start = BenchmarkClock::now();
-        for (int j = 0; j < iterations; j++) {
-            op();
-        }
-        auto end = BenchmarkClock::now();
-        double elapsed_seconds =
-                std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
-        best = std::min(best, elapsed_seconds);
+        best = std::min(best, time_iterations(iterations, op));
     }
-    return best / iterations;
+    record_benchmark(best, 0);
+    return best;
 }
 
 // Benchmark the operation 'op': run the operation until at least min_time
 // has elapsed, with the constraint of at least min_iters and no more than
 // max_iters times; the number of iterations is expanded as we
 // progress (based on initial runs of 'op') to minimize overhead. The time
-// reported will be that of the best single iteration.
+// reported will be that of the best single iteration. The result also
+// describes the distribution of the samples taken (median, percentiles,
+// a confidence interval for the median, and outliers), which is a more
+// reliable basis for comparing two versions of a pipeline than the best
+// times alone.
 //
 // Most callers should be able to get good results without needing to specify
 // custom BenchmarkConfig values.
@@ -94,6 +138,23 @@ struct BenchmarkConfig {
     // this. Controls accuracy. The closer to zero this gets the more
     // reliable the answer, but the longer it may take to run.
     double accuracy{0.03};
+
+    // Take at least this many samples (within max_time and max_iters),
+    // so that the median, percentiles and confidence interval in the
+    // result are meaningful.
+    uint64_t min_samples{3};
+
+    // Run the operation for this long (in seconds) before taking any
+    // samples, e.g. to let the CPU reach a steady clock rate and to
+    // fault in any memory the operation touches.
+    double warmup_time{0};
+
+    // If nonzero, dirty a buffer of this many bytes before each sample
+    // to evict the operation's data from the caches, so that each
+    // sample measures a cold-cache run. Make it larger than the last
+    // level cache. Each sample is then a single iteration, and min_time
+    // and max_time include the time spent flushing.
+    size_t flush_cache_bytes{0};
 };
 
 struct BenchmarkResult {
@@ -114,10 +175,40 @@ struct BenchmarkResult {
     // Will be <= config.accuracy unless max_iters is exceeded.
     double accuracy;
 
+    // The time per iteration (seconds) of each sample used for
+    // measurement, in increasing order.
+    std::vector<double> sample_times;
+
+    // The median, mean and standard deviation of sample_times.
+    double median, mean, stddev;
+
+    // A 95% confidence interval for the median, from the order
+    // statistics of the samples (so it makes no assumption about
+    // their distribution). If the intervals of two configurations
+    // don't overlap, the difference between them is likely real.
+    double median_low, median_high;
+
+    // The number of samples outside of Tukey's fences (more than 1.5
+    // times the interquartile range beyond the quartiles), e.g. from
+    // interruptions by other processes.
+    uint64_t outliers;
+
+    // The time per iteration at a percentile, from 0 to 100, of the
+    // samples, by the nearest-rank method.
+    double percentile(double p) const {
+        if (sample_times.empty()) {
+            return 0;
+        }
+        const size_t n = sample_times.size();
+        size_t rank = (size_t)std::ceil(p / 100.0 * n);
+        return sample_times[std::min(std::max(rank, (size_t)1), n) - 1];
+    }
+
     operator double() const { return wall_time; }
 };
 
 inline BenchmarkResult benchmark(std::function<void()> op, const BenchmarkConfig& config = {}) {
+    using BenchmarkClock = SteadyClock<>::type;
     BenchmarkResult result{0, 0, 0};
 
     const double min_time = std::max(10 * 1e-6, config.min_time);
@@ -129,6 +220,20 @@ inline BenchmarkResult benchmark(std::function<void()> op, const BenchmarkConfig
             std::max(config.min_iters, config.max_iters), kBenchmarkMaxIterations);
     const double accuracy = 1.0 + std::min(std::max(0.001, config.accuracy), 0.1);
 
+    const auto seconds_since = [](BenchmarkClock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::duration<double>>(BenchmarkClock::now() - start).count();
+    };
+
+    if (config.warmup_time > 0) {
+        auto start = BenchmarkClock::now();
+        do {
+            op();
+        } while (seconds_since(start) < config.warmup_time);
+    }
+
+    const bool flush = config.flush_cache_bytes > 0;
+    std::vector<uint8_t> flush_buffer(config.flush_cache_bytes);
+
     // We will do (at least) kMinSamples samples; we will do additional
     // samples until the best the kMinSamples'th results are within the
     // accuracy tolerance (or we run out of iterations).
@@ -136,19 +241,36 @@ inline BenchmarkResult benchmark(std::function<void()> op, const BenchmarkConfig
     double times[kMinSamples + 1] = {0};
 
     double total_time = 0;
-    uint64_t iters_per_sample = min_iters;
+    const auto take_sample = [&](uint64_t iters) {
+        if (flush) {
+            auto start = BenchmarkClock::now();
+            // Dirty every cache line, so that whatever op left in the
+            // caches has to be evicted.
+            volatile uint8_t *p = flush_buffer.data();
+            for (size_t i = 0; i < flush_buffer.size(); i += 64) {
+                p[i] = p[i] + 1;
+            }
+            total_time += seconds_since(start);
+        }
+        double t = time_iterations(iters, op);
+        result.samples++;
+        result.iterations += iters;
+        total_time += t * iters;
+        result.sample_times.push_back(t);
+        return t;
+    };
+
+    uint64_t iters_per_sample = flush ? 1 : min_iters;
     while (result.iterations < max_iters) {
         result.samples = 0;
         result.iterations = 0;
+        result.sample_times.clear();
         total_time = 0;
         for (int i = 0; i < kMinSamples; i++) {
-            times[i] = benchmark(1, iters_per_sample, op);
-            result.samples++;
-            result.iterations += iters_per_sample;
-            total_time += times[i] * iters_per_sample;
+            times[i] = take_sample(iters_per_sample);
         }
         std::sort(times, times + kMinSamples);
-        if (times[0] * iters_per_sample * kMinSamples >= min_time) {
+        if (flush || times[0] * iters_per_sample * kMinSamples >= min_time) {
             break;
         }
         // Use an estimate based on initial times to converge faster.
@@ -162,18 +284,50 @@ inline BenchmarkResult benchmark(std::function<void()> op, const BenchmarkConfig
     // - No matter what, don't go over max_iters or max_time; this is important, in case
     // we happen to get faster results for the first samples, then happen to transition
     // to throttled-down CPU state.
-    while ((times[0] * accuracy < times[kMinSamples - 1] || total_time < min_time) &&
+    while ((times[0] * accuracy < times[kMinSamples - 1] ||
+            total_time < min_time ||
+            result.samples < config.min_samples) &&
                  total_time < max_time &&
                  result.iterations < max_iters) {
-        times[kMinSamples] = benchmark(1, iters_per_sample, op);
-        result.samples++;
-        result.iterations += iters_per_sample;
-        total_time += times[kMinSamples] * iters_per_sample;
+        times[kMinSamples] = take_sample(iters_per_sample);
         std::sort(times, times + kMinSamples + 1);
     }
     result.wall_time = times[0];
     result.accuracy = (times[kMinSamples - 1] / times[0]) - 1.0;
 
+    std::vector<double> &s = result.sample_times;
+    std::sort(s.begin(), s.end());
+    const double n = (double)s.size();
+    result.median = result.percentile(50);
+    double sum = 0, sum_sq = 0;
+    for (double t : s) {
+        sum += t;
+    }
+    result.mean = sum / n;
+    for (double t : s) {
+        sum_sq += (t - result.mean) * (t - result.mean);
+    }
+    result.stddev = s.size() > 1 ? std::sqrt(sum_sq / (n - 1)) : 0;
+
+    // The ranks n/2 -/+ 1.96 * sqrt(n) / 2 bound the median with 95%
+    // confidence, by the normal approximation to the binomial.
+    const double half_width = 0.98 * std::sqrt(n);
+    const int low_rank = (int)std::max(0.0, std::floor(n / 2 - half_width));
+    const int high_rank = (int)std::min(n - 1, std::ceil(n / 2 + half_width));
+    result.median_low = s[low_rank];
+    result.median_high = s[high_rank];
+
+    const double q1 = result.percentile(25), q3 = result.percentile(75);
+    const double iqr = q3 - q1;
+    result.outliers = 0;
+    for (double t : s) {
+        if (t < q1 - 1.5 * iqr || t > q3 + 1.5 * iqr) {
+            result.outliers++;
+        }
+    }
+
+    record_benchmark(result.wall_time, result.median);
+
     return result;
 }
 
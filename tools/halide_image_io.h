@@ -8,6 +8,7 @@
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <map>
 #include <set>
@@ -15,6 +16,11 @@
 #include <vector>
 #include <cctype>
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #ifndef HALIDE_NO_PNG
 #include "png.h"
 #endif
@@ -324,26 +330,52 @@ struct FileOpener {
     FILE * const f;
 };
 
+// The layout of a row of an image: a pointer to its first element,
+// the number of pixels and channels, and the strides between them.
+template<typename ElemType>
+struct ImageRow {
+    ElemType *data;
+    int width, x_stride;
+    int channels, c_stride;
+};
+
+template<typename ElemType, typename ImageType>
+ImageRow<ElemType> get_image_row(ImageType &im_typed, int y) {
+    ImageRow<ElemType> row;
+    row.width = im_typed.dim(0).extent();
+    row.x_stride = im_typed.dim(0).stride();
+    const int xmin = im_typed.dim(0).min();
+    if (im_typed.dimensions() > 2) {
+        row.channels = im_typed.dim(2).extent();
+        row.c_stride = im_typed.dim(2).stride();
+        row.data = &im_typed(xmin, y, im_typed.dim(2).min());
+    } else {
+        row.channels = 1;
+        row.c_stride = 0;
+        row.data = &im_typed(xmin, y);
+    }
+    return row;
+}
+
 // Read a row of ElemTypes from a byte buffer and copy them into a specific image row.
 // Multibyte elements are assumed to be big-endian.
 template<typename ElemType, typename ImageType>
 void read_big_endian_row(const uint8_t *src, int y, ImageType *im) {
     auto im_typed = im->template as<ElemType>();
-    const int xmin = im_typed.dim(0).min();
-    const int xmax = im_typed.dim(0).max();
-    if (im_typed.dimensions() > 2) {
-        const int cmin = im_typed.dim(2).min();
-        const int cmax = im_typed.dim(2).max();
-        for (int x = xmin; x <= xmax; x++) {
-            for (int c = cmin; c <= cmax; c++) {
-                im_typed(x, y, c+cmin) = read_big_endian<ElemType>(src);
-                src += sizeof(ElemType);
-            }
-        }
-    } else {
-        for (int x = xmin; x <= xmax; x++) {
-            im_typed(x, y) = read_big_endian<ElemType>(src);
-            src += sizeof(ElemType);
+    ImageRow<ElemType> row = get_image_row<ElemType>(im_typed, y);
+    if (sizeof(ElemType) == 1 && row.x_stride == row.channels && (row.channels == 1 || row.c_stride == 1)) {
+        // The image row has the same layout as the bytes.
+        memcpy(row.data, src, row.width * row.channels);
+        return;
+    }
+    // Deinterleave one channel at a time, so that the stores to a
+    // planar image are to consecutive addresses.
+    const int src_stride = row.channels * sizeof(ElemType);
+    for (int c = 0; c < row.channels; c++) {
+        ElemType *dst = row.data + c * row.c_stride;
+        const uint8_t *s = src + c * sizeof(ElemType);
+        for (int x = 0; x < row.width; x++) {
+            dst[x * row.x_stride] = read_big_endian<ElemType>(s + x * src_stride);
         }
     }
 }
@@ -352,22 +384,20 @@ void read_big_endian_row(const uint8_t *src, int y, ImageType *im) {
 // Multibyte elements are written in big-endian layout.
 template<typename ElemType, typename ImageType>
 void write_big_endian_row(const ImageType &im, int y, uint8_t *dst) {
-    auto im_typed = im.template as<ElemType>();
-    const int xmin = im_typed.dim(0).min();
-    const int xmax = im_typed.dim(0).max();
-    if (im_typed.dimensions() > 2) {
-        const int cmin = im_typed.dim(2).min();
-        const int cmax = im_typed.dim(2).max();
-        for (int x = xmin; x <= xmax; x++) {
-            for (int c = cmin; c <= cmax; c++) {
-                write_big_endian<ElemType>(im_typed(x, y, c), dst);
-                dst += sizeof(ElemType);
-            }
-        }
-    } else {
-        for (int x = xmin; x <= xmax; x++) {
-            write_big_endian<ElemType>(im_typed(x, y), dst);
-            dst += sizeof(ElemType);
+    const auto &im_typed = im.template as<ElemType>();
+    ImageRow<const ElemType> row = get_image_row<const ElemType>(im_typed, y);
+    if (sizeof(ElemType) == 1 && row.x_stride == row.channels && (row.channels == 1 || row.c_stride == 1)) {
+        memcpy(dst, row.data, row.width * row.channels);
+        return;
+    }
+    // Interleave one channel at a time, so that the loads from a
+    // planar image are from consecutive addresses.
+    const int dst_stride = row.channels * sizeof(ElemType);
+    for (int c = 0; c < row.channels; c++) {
+        const ElemType *s = row.data + c * row.c_stride;
+        uint8_t *d = dst + c * sizeof(ElemType);
+        for (int x = 0; x < row.width; x++) {
+            write_big_endian<ElemType>(s[x * row.x_stride], d + x * dst_stride);
         }
     }
 }
@@ -1301,6 +1331,207 @@ bool save_mat(ImageType &im, const std::string &filename) {
 }
 
 
+// ".htensor" is a raw container for images of any type and shape: a
+// header of int32s (a magic number, the version, the type code and
+// bits, the number of dimensions, and the offset of the values in the
+// file), then the min, extent and stride of each dimension, then the
+// values themselves, starting at a multiple of 128 bytes and laid out
+// with the strides in the header. Values are in the byte order of the
+// machine that wrote them. Where mmap is available, loading maps the
+// values into the Buffer instead of reading them, so large images load
+// without a copy.
+constexpr int32_t kHTensorMagic = 0x736e7468;  // "htns"
+constexpr int32_t kHTensorVersion = 1;
+constexpr int kHTensorHeaderInts = 6;
+constexpr int kHTensorMaxDimensions = 16;
+constexpr size_t kHTensorAlignment = 128;
+// Space left between the header and the values, for the bookkeeping
+// of a mapped image.
+constexpr size_t kHTensorReservedBytes = 64;
+
+#ifndef _WIN32
+struct HTensorMapping {
+    void *base;
+    size_t length;
+};
+
+// A Buffer allocation puts its AllocationHeader at the start of the
+// memory from the allocator, and the values at the next multiple of
+// 128 bytes. To wrap a mapped file, the allocator returns memory
+// just ahead of the values in the mapping, which is private, so
+// writing the AllocationHeader and HTensorMapping there doesn't touch
+// the file.
+constexpr size_t kHTensorAllocationHeaderBytes = 32;
+
+inline void *&htensor_pending_allocation() {
+    static thread_local void *pending = nullptr;
+    return pending;
+}
+
+inline void *htensor_allocate(size_t) {
+    void *result = htensor_pending_allocation();
+    htensor_pending_allocation() = nullptr;
+    return result;
+}
+
+inline void htensor_deallocate(void *ptr) {
+    const HTensorMapping *mapping = (const HTensorMapping *)ptr - 1;
+    munmap(mapping->base, mapping->length);
+}
+#endif
+
+template<typename ImageType, CheckFunc check = CheckReturn>
+bool load_htensor(const std::string &filename, ImageType *im) {
+    static_assert(!ImageType::has_static_halide_type, "");
+
+    FileOpener f(filename, "rb");
+    if (!check(f.f != nullptr, "File could not be opened for reading")) {
+        return false;
+    }
+
+    int32_t header[kHTensorHeaderInts];
+    if (!check(f.read_array(header), "Could not read .htensor header")) {
+        return false;
+    }
+    const int dimensions = header[4];
+    const int32_t data_offset = header[5];
+    if (!check(header[0] == kHTensorMagic && header[1] == kHTensorVersion &&
+               dimensions >= 0 && dimensions <= kHTensorMaxDimensions,
+               "Bad header on .htensor file")) {
+        return false;
+    }
+
+    std::vector<int32_t> dims(dimensions * 3);
+    if (!check(f.read_vector(&dims), "Could not read .htensor header")) {
+        return false;
+    }
+    std::vector<halide_dimension_t> shape(dimensions);
+    for (int i = 0; i < dimensions; i++) {
+        shape[i].min = dims[i * 3];
+        shape[i].extent = dims[i * 3 + 1];
+        shape[i].stride = dims[i * 3 + 2];
+        if (!check(shape[i].extent > 0 && shape[i].stride > 0, "Bad shape in .htensor file")) {
+            return false;
+        }
+    }
+    const size_t header_bytes = (kHTensorHeaderInts + dims.size()) * sizeof(int32_t);
+    if (!check(data_offset % kHTensorAlignment == 0 &&
+               (size_t)data_offset >= header_bytes + kHTensorReservedBytes,
+               "Bad data offset in .htensor file")) {
+        return false;
+    }
+
+    const halide_type_t im_type((halide_type_code_t)header[2], header[3]);
+    *im = ImageType(im_type, nullptr, dimensions, shape.data());
+    const size_t size = im->size_in_bytes();
+
+#ifndef _WIN32
+    struct stat st;
+    if (!check(fstat(fileno(f.f), &st) == 0 && (size_t)st.st_size >= data_offset + size,
+               "Could not read .htensor payload")) {
+        return false;
+    }
+    const size_t length = data_offset + size;
+    void *base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(f.f), 0);
+    if (base != MAP_FAILED) {
+        uint8_t *data = (uint8_t *)base + data_offset;
+        uint8_t *alloc = data - kHTensorAllocationHeaderBytes;
+        HTensorMapping *mapping = (HTensorMapping *)alloc - 1;
+        mapping->base = base;
+        mapping->length = length;
+        htensor_pending_allocation() = alloc;
+        im->allocate(htensor_allocate, htensor_deallocate);
+        // This should never fail unless the Buffer allocation behavior changes.
+        if (!check(im->data() == data, "Could not map .htensor payload into an image")) {
+            return false;
+        }
+        im->set_host_dirty();
+        return true;
+    }
+#endif
+
+    // Read the values instead.
+    im->allocate();
+    if (!check(fseek(f.f, data_offset, SEEK_SET) == 0 && f.read_bytes(im->data(), size),
+               "Could not read .htensor payload")) {
+        return false;
+    }
+    im->set_host_dirty();
+    return true;
+}
+
+inline const std::set<FormatInfo> &query_htensor() {
+    static std::set<FormatInfo> info = []() {
+        std::set<FormatInfo> s;
+        for (int i = 0; i <= kHTensorMaxDimensions; i++) {
+            s.insert({ halide_type_t(halide_type_float, 32), i });
+            s.insert({ halide_type_t(halide_type_float, 64), i });
+            s.insert({ halide_type_t(halide_type_uint, 1), i });
+            s.insert({ halide_type_t(halide_type_uint, 8), i });
+            s.insert({ halide_type_t(halide_type_int, 8), i });
+            s.insert({ halide_type_t(halide_type_uint, 16), i });
+            s.insert({ halide_type_t(halide_type_int, 16), i });
+            s.insert({ halide_type_t(halide_type_uint, 32), i });
+            s.insert({ halide_type_t(halide_type_int, 32), i });
+            s.insert({ halide_type_t(halide_type_uint, 64), i });
+            s.insert({ halide_type_t(halide_type_int, 64), i });
+        }
+        return s;
+    }();
+    return info;
+}
+
+template<typename ImageType, CheckFunc check = CheckReturn>
+bool save_htensor(ImageType &im, const std::string &filename) {
+    static_assert(!ImageType::has_static_halide_type, "");
+
+    im.copy_to_host();
+
+    if (!check(im.dimensions() <= kHTensorMaxDimensions, "Too many dimensions for .htensor file")) {
+        return false;
+    }
+
+    // Dense images are written as they are laid out in memory, with a
+    // single write. Anything else is written in planar order.
+    bool dense = im.number_of_elements() * im.type().bytes() == im.size_in_bytes();
+    for (int i = 0; i < im.dimensions(); i++) {
+        dense &= im.dim(i).stride() > 0;
+    }
+
+    std::vector<int32_t> header(kHTensorHeaderInts + im.dimensions() * 3);
+    const size_t header_bytes = header.size() * sizeof(int32_t);
+    const size_t data_offset =
+        (header_bytes + kHTensorReservedBytes + kHTensorAlignment - 1) & ~(kHTensorAlignment - 1);
+    header[0] = kHTensorMagic;
+    header[1] = kHTensorVersion;
+    const halide_type_t im_type = im.type();
+    header[2] = im_type.code;
+    header[3] = im_type.bits;
+    header[4] = im.dimensions();
+    header[5] = (int32_t)data_offset;
+    int32_t planar_stride = 1;
+    for (int i = 0; i < im.dimensions(); i++) {
+        header[kHTensorHeaderInts + i * 3] = im.dim(i).min();
+        header[kHTensorHeaderInts + i * 3 + 1] = im.dim(i).extent();
+        header[kHTensorHeaderInts + i * 3 + 2] = dense ? im.dim(i).stride() : planar_stride;
+        planar_stride *= im.dim(i).extent();
+    }
+    std::vector<uint8_t> padding(data_offset - header_bytes, 0);
+
+    FileOpener f(filename, "wb");
+    if (!check(f.f != nullptr, "File could not be opened for writing")) {
+        return false;
+    }
+    if (!check(f.write_vector(header) && f.write_vector(padding), "Could not write .htensor header")) {
+        return false;
+    }
+    if (dense) {
+        return check(f.write_bytes(im.begin(), im.size_in_bytes()), "Could not write .htensor payload");
+    } else {
+        return write_planar_payload<ImageType, check>(im, f);
+    }
+}
+
 template<typename ImageType, Internal::CheckFunc check>
 struct ImageIO {
     std::function<bool(const std::string &, ImageType *)> load;
@@ -1317,6 +1548,7 @@ bool find_imageio(const std::string &filename, ImageIO<ImageType, check> *result
         {"jpeg", {load_jpg<ImageType, check>, save_jpg<ImageType, check>, query_jpg}},
         {"jpg", {load_jpg<ImageType, check>, save_jpg<ImageType, check>, query_jpg}},
 #endif
+        {"htensor", {load_htensor<ImageType, check>, save_htensor<ImageType, check>, query_htensor}},
         {"pgm", {load_pgm<ImageType, check>, save_pgm<ImageType, check>, query_pgm}},
 #ifndef HALIDE_NO_PNG
         {"png", {load_png<ImageType, check>, save_png<ImageType, check>, query_png}},
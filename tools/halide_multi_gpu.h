@@ -0,0 +1,116 @@
+#ifndef HALIDE_MULTI_GPU_H
+#define HALIDE_MULTI_GPU_H
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "HalideBuffer.h"
+#include "HalideRuntime.h"
+
+namespace Halide {
+namespace Tools {
+
+// Run an ahead-of-time compiled GPU pipeline on several devices at
+// once by splitting its output into bands along the outermost
+// dimension, one band per device. Each band is realized by a separate
+// call to the pipeline, on its own thread, with its own user_context,
+// which the runtime maps to that device (see
+// halide_set_gpu_device_for_user_context). The runtime keeps a context
+// per device, so the bands run concurrently.
+//
+// A halide_buffer_t holds a single device allocation, so a buffer must
+// not be shared by the calls on different devices. Use shard_input()
+// to give each band its own view of the host memory of an input; each
+// device then copies the input, including any halo the band reads
+// around its region, from the host. The bands are copied back to the
+// host before this returns.
+//
+// The pipeline must be compiled with a user_context argument, and
+// 'run' must pass it through:
+//
+//     multi_gpu_realize(output, 2, [&](void *uc, int device, Runtime::Buffer<float> &band) {
+//         auto in = shard_input(input);
+//         return my_pipeline(uc, in, band);
+//     });
+//
+// Returns the first non-zero error code returned by 'run' or by the
+// runtime.
+
+// A user_context for each device. The runtime only compares
+// user_context pointers, so these are only needed for their addresses.
+struct MultiGpuContext {
+    int device;
+};
+
+// Make a buffer that shares the host memory of 'input', but not its
+// device allocation.
+template<typename T, int D>
+Runtime::Buffer<T, D> shard_input(Runtime::Buffer<T, D> &input) {
+    std::vector<halide_dimension_t> shape(input.raw_buffer()->dim,
+                                          input.raw_buffer()->dim + input.dimensions());
+    return Runtime::Buffer<T, D>(input.data(), input.dimensions(), shape.data());
+}
+
+template<typename T, int D, typename F>
+int multi_gpu_realize(Runtime::Buffer<T, D> &output, int num_devices, F run) {
+    if (num_devices <= 0 || output.dimensions() == 0) {
+        return -1;
+    }
+
+    const int d = output.dimensions() - 1;
+    const int min = output.dim(d).min();
+    const int extent = output.dim(d).extent();
+    if (num_devices > extent) {
+        num_devices = extent;
+    }
+
+    std::vector<MultiGpuContext> contexts(num_devices);
+    std::vector<int> results(num_devices, 0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_devices; i++) {
+        contexts[i].device = i;
+        int result = halide_set_gpu_device_for_user_context(&contexts[i], i);
+        if (result != 0) {
+            for (int j = 0; j < i; j++) {
+                halide_set_gpu_device_for_user_context(&contexts[j], -1);
+            }
+            return result;
+        }
+    }
+
+    for (int i = 0; i < num_devices; i++) {
+        threads.emplace_back([&, i]() {
+            int band_min = min + (int)((int64_t)extent * i / num_devices);
+            int band_max = min + (int)((int64_t)extent * (i + 1) / num_devices);
+            Runtime::Buffer<T, D> band = output.cropped(d, band_min, band_max - band_min);
+            void *user_context = &contexts[i];
+            int result = run(user_context, i, band);
+            if (result == 0) {
+                result = band.copy_to_host(user_context);
+            }
+            int free_result = band.device_free(user_context);
+            results[i] = result != 0 ? result : free_result;
+        });
+    }
+
+    for (std::thread &t : threads) {
+        t.join();
+    }
+
+    for (int i = 0; i < num_devices; i++) {
+        halide_set_gpu_device_for_user_context(&contexts[i], -1);
+    }
+
+    for (int result : results) {
+        if (result != 0) {
+            return result;
+        }
+    }
+    return 0;
+}
+
+}  // namespace Tools
+}  // namespace Halide
+
+#endif  // HALIDE_MULTI_GPU_H
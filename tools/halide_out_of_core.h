@@ -0,0 +1,117 @@
+#ifndef HALIDE_OUT_OF_CORE_H
+#define HALIDE_OUT_OF_CORE_H
+
+#include <algorithm>
+#include <vector>
+
+#include "HalideBuffer.h"
+#include "HalideRuntime.h"
+
+namespace Halide {
+namespace Tools {
+
+// Realize an ahead-of-time compiled pipeline whose inputs and output
+// are too large to hold in memory, such as gigapixel stitches, by
+// computing the output one tile at a time. For each tile, a bounds
+// query finds the region of each input the tile needs, 'load' reads
+// just that region, the pipeline computes the tile, and 'store'
+// writes it out. Only one tile of the output, and the regions of the
+// inputs that it needs, are in memory at once.
+//
+// 'inputs' describes each input, with its type and its full shape,
+// but no host memory. The pipeline sees the shape of the whole input
+// in the bounds queries, so boundary conditions on it behave as they
+// would if the whole input were in memory.
+//
+// 'run' calls the pipeline on the given inputs and output tile, and
+// returns its result:
+//
+//     realize_out_of_core(halide_type_of<float>(), {width, height}, {1024, 1024},
+//                         {Runtime::Buffer<>(halide_type_of<float>(), nullptr, width, height)},
+//                         [&](std::vector<Runtime::Buffer<>> &in, Runtime::Buffer<> &out) {
+//                             return my_pipeline(in[0], out);
+//                         },
+//                         [&](int i, Runtime::Buffer<> &region) { read_region(files[i], region); return 0; },
+//                         [&](Runtime::Buffer<> &tile) { write_tile(out_file, tile); return 0; });
+//
+// 'load' fills in the host memory of the region of input i, and
+// 'store' writes out a finished tile; both return zero on success.
+// The tiles at the edges of the output are cropped to fit it. The
+// pipeline must not be compiled with no_bounds_query. Returns the
+// first non-zero result of the pipeline or the callbacks.
+template<typename Run, typename Load, typename Store>
+int realize_out_of_core(halide_type_t output_type,
+                        const std::vector<int> &output_extents,
+                        const std::vector<int> &tile_extents,
+                        const std::vector<Runtime::Buffer<>> &inputs,
+                        Run run, Load load, Store store) {
+    const int dims = (int)output_extents.size();
+    if (dims == 0 || (int)tile_extents.size() != dims) {
+        return -1;
+    }
+    for (int d = 0; d < dims; d++) {
+        if (tile_extents[d] <= 0) {
+            return -1;
+        }
+    }
+
+    // The coordinates of the min corner of the current tile.
+    std::vector<int> tile_min(dims, 0);
+    while (true) {
+        std::vector<int> tile_shape(dims);
+        for (int d = 0; d < dims; d++) {
+            tile_shape[d] = std::min(tile_extents[d], output_extents[d] - tile_min[d]);
+        }
+        Runtime::Buffer<> tile(output_type, tile_shape);
+        for (int d = 0; d < dims; d++) {
+            tile.translate(d, tile_min[d]);
+        }
+
+        // Find the region of each input this tile needs.
+        std::vector<Runtime::Buffer<>> regions;
+        for (const Runtime::Buffer<> &in : inputs) {
+            std::vector<halide_dimension_t> in_shape(in.raw_buffer()->dim,
+                                                     in.raw_buffer()->dim + in.dimensions());
+            regions.emplace_back(in.type(), nullptr, in.dimensions(), in_shape.data());
+        }
+        int result = run(regions, tile);
+        if (result != 0) {
+            return result;
+        }
+
+        // Fetch those regions, and compute the tile.
+        for (size_t i = 0; i < regions.size(); i++) {
+            regions[i].allocate();
+            result = load((int)i, regions[i]);
+            if (result != 0) {
+                return result;
+            }
+        }
+        result = run(regions, tile);
+        if (result == 0) {
+            result = store(tile);
+        }
+        if (result != 0) {
+            return result;
+        }
+
+        // Move on to the next tile, with dimension 0 innermost.
+        int d = 0;
+        while (d < dims) {
+            tile_min[d] += tile_extents[d];
+            if (tile_min[d] < output_extents[d]) {
+                break;
+            }
+            tile_min[d] = 0;
+            d++;
+        }
+        if (d == dims) {
+            return 0;
+        }
+    }
+}
+
+}  // namespace Tools
+}  // namespace Halide
+
+#endif
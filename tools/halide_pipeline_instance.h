@@ -0,0 +1,190 @@
+#ifndef HALIDE_PIPELINE_INSTANCE_H
+#define HALIDE_PIPELINE_INSTANCE_H
+
+#include <atomic>
+#include <mutex>
+#include <utility>
+
+#include "HalideRuntime.h"
+
+namespace Halide {
+namespace Tools {
+
+// An instance of an ahead-of-time compiled pipeline, with its own
+// state. The entry points of a compiled pipeline are stateless, and
+// by default every call shares the runtime's global thread pool,
+// scratch arena and GPU device. The runtime decides which of these a
+// call uses from its user_context, so a PipelineInstance is a
+// user_context bound to state of its own:
+//
+// - a scratch arena, which keeps the heap allocations of root-level
+//   Funcs between calls, so that once the first call has reserved
+//   them, calls of the same size do no allocation;
+// - optionally, a thread pool of its own, so that instances running
+//   concurrently don't compete for workers;
+// - optionally, a GPU device (see halide_set_gpu_device_for_user_context).
+//
+// Separate instances are independent, and can run at the same time
+// on different threads. The pipeline must be compiled with the
+// user_context and persistent_scratch target features, and must be
+// linked with a runtime that has persistent_scratch. The instance
+// passes itself as the user_context:
+//
+//     PipelineInstance instance(PipelineInstance::Options().with_threads(4));
+//     for (auto &frame : frames) {
+//         instance.run(my_pipeline, frame, output);
+//     }
+//
+// Instances need the runtime's independent thread pools, so they
+// aren't available where the runtime uses Grand Central Dispatch (OS
+// X and iOS). An instance must not be destroyed while a call is
+// using it. The lookup of an instance from a user_context is
+// lock-free; up to max_instances may exist at once, and any beyond
+// that share the global state.
+class PipelineInstance {
+public:
+    struct Options {
+        // The number of threads in the instance's own pool, following
+        // the conventions of halide_set_num_threads, or -1 to use the
+        // global pool.
+        int num_threads = -1;
+        // The priority of the pool's workers. Zero is the OS default.
+        int priority = 0;
+        // The GPU device to use, or -1 for the default device.
+        int gpu_device = -1;
+
+        Options &with_threads(int n, int p = 0) {
+            num_threads = n;
+            priority = p;
+            return *this;
+        }
+        Options &with_gpu_device(int d) {
+            gpu_device = d;
+            return *this;
+        }
+    };
+
+    static constexpr int max_instances = 64;
+
+    PipelineInstance()
+        : PipelineInstance(Options()) {
+    }
+
+    explicit PipelineInstance(const Options &options) {
+        install_hooks();
+        arena = halide_create_scratch_arena(this);
+        if (options.num_threads >= 0) {
+            pool = halide_create_thread_pool(this, options.num_threads, options.priority);
+        }
+        if (options.gpu_device >= 0) {
+            gpu_device_bound = halide_set_gpu_device_for_user_context(this, options.gpu_device) == 0;
+        }
+        std::atomic<PipelineInstance *> *instances = registry();
+        for (int i = 0; i < max_instances; i++) {
+            PipelineInstance *expected = nullptr;
+            if (instances[i].compare_exchange_strong(expected, this)) {
+                registered = &instances[i];
+                break;
+            }
+        }
+    }
+
+    ~PipelineInstance() {
+        if (registered) {
+            registered->store(nullptr);
+        }
+        if (gpu_device_bound) {
+            halide_set_gpu_device_for_user_context(this, -1);
+        }
+        if (pool) {
+            halide_destroy_thread_pool(this, pool);
+        }
+        if (arena) {
+            halide_destroy_scratch_arena(this, arena);
+        }
+    }
+
+    PipelineInstance(const PipelineInstance &) = delete;
+    PipelineInstance &operator=(const PipelineInstance &) = delete;
+
+    void *user_context() {
+        return this;
+    }
+
+    // Call a pipeline with this instance as its user_context.
+    template<typename Fn, typename... Args>
+    int run(Fn &&fn, Args &&... args) {
+        return fn(user_context(), std::forward<Args>(args)...);
+    }
+
+    // Free the scratch blocks no call is using, e.g. after a call
+    // with an unusually large output.
+    void release_unused() {
+        if (arena) {
+            halide_scratch_arena_release_unused(this, arena);
+        }
+    }
+
+private:
+    halide_scratch_arena_t *arena = nullptr;
+    halide_thread_pool *pool = nullptr;
+    bool gpu_device_bound = false;
+    std::atomic<PipelineInstance *> *registered = nullptr;
+
+    static std::atomic<PipelineInstance *> *registry() {
+        static std::atomic<PipelineInstance *> instances[max_instances] = {};
+        return instances;
+    }
+
+    static PipelineInstance *find(void *user_context) {
+        if (user_context == nullptr) {
+            return nullptr;
+        }
+        std::atomic<PipelineInstance *> *instances = registry();
+        for (int i = 0; i < max_instances; i++) {
+            if (instances[i].load(std::memory_order_acquire) == user_context) {
+                return (PipelineInstance *)user_context;
+            }
+        }
+        return nullptr;
+    }
+
+    // The hooks that were installed before ours, which handle every
+    // user_context that isn't an instance.
+    static halide_get_scratch_arena_t &previous_get_scratch_arena() {
+        static halide_get_scratch_arena_t f = nullptr;
+        return f;
+    }
+    static halide_get_thread_pool_t &previous_get_thread_pool() {
+        static halide_get_thread_pool_t f = nullptr;
+        return f;
+    }
+
+    static halide_scratch_arena_t *get_scratch_arena(void *user_context) {
+        if (PipelineInstance *instance = find(user_context)) {
+            return instance->arena;
+        }
+        return previous_get_scratch_arena()(user_context);
+    }
+
+    static halide_thread_pool *get_thread_pool(void *user_context) {
+        PipelineInstance *instance = find(user_context);
+        if (instance && instance->pool) {
+            return instance->pool;
+        }
+        return previous_get_thread_pool()(user_context);
+    }
+
+    static void install_hooks() {
+        static std::once_flag once;
+        std::call_once(once, []() {
+            previous_get_scratch_arena() = halide_set_custom_get_scratch_arena(get_scratch_arena);
+            previous_get_thread_pool() = halide_set_custom_get_thread_pool(get_thread_pool);
+        });
+    }
+};
+
+}  // namespace Tools
+}  // namespace Halide
+
+#endif  // HALIDE_PIPELINE_INSTANCE_H
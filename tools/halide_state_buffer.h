@@ -0,0 +1,80 @@
+#ifndef HALIDE_STATE_BUFFER_H
+#define HALIDE_STATE_BUFFER_H
+
+#include <utility>
+
+#include "HalideBuffer.h"
+
+namespace Halide {
+namespace Tools {
+
+// State carried by a pipeline from one frame to the next, such as the
+// running average of a recursive temporal filter. Pipelines are pure
+// functions of their arguments, so a generator with state takes the
+// state from the last frame as an Input and produces the state for
+// this frame as an Output of the same shape:
+//
+//     Input<Buffer<float>> prev_state{"prev_state", 2};
+//     Output<Buffer<float>> state{"state", 2};
+//
+// A StateBuffer holds the buffers to pass to those arguments of each
+// call, and swaps them after each frame, so the state never needs to
+// be copied or recomputed:
+//
+//     StateBuffer<float> state(initial_state);
+//     for (auto &frame : frames) {
+//         smooth(frame, state.prev(), alpha, state.next());
+//         state.advance();
+//     }
+//
+// If each point of the state is only written once, after its last
+// read, the pipeline can update the state in place, and the state is
+// a single buffer passed as both arguments. This is the case if the
+// state is a pointwise function of the previous state, with no tail
+// strategy that recomputes points of the output (use GuardWithIf or
+// RoundUp rather than ShiftInwards when splitting it).
+template<typename T = void, int D = 4>
+class StateBuffer {
+    Runtime::Buffer<T, D> buffers[2];
+    int current = 0;
+
+public:
+    // Use 'initial' as the state before the first frame. Unless
+    // updating the state in place, this allocates a second buffer of
+    // the same shape for the pipeline to write the next state to.
+    explicit StateBuffer(Runtime::Buffer<T, D> initial, bool in_place = false) {
+        buffers[0] = initial;
+        if (in_place) {
+            buffers[1] = initial;
+        } else {
+            buffers[1] = Runtime::Buffer<T, D>::make_with_shape_of(initial);
+        }
+    }
+
+    // Whether the pipeline reads and writes the same buffer.
+    bool in_place() const {
+        return buffers[0].data() == buffers[1].data();
+    }
+
+    // The state from the last frame, which is the input to the
+    // pipeline for this frame.
+    Runtime::Buffer<T, D> &prev() {
+        return buffers[current];
+    }
+
+    // The buffer the pipeline writes the state for this frame to.
+    Runtime::Buffer<T, D> &next() {
+        return buffers[current ^ 1];
+    }
+
+    // Make the state written for this frame the state from the last
+    // frame, for the next call.
+    void advance() {
+        current ^= 1;
+    }
+};
+
+}  // namespace Tools
+}  // namespace Halide
+
+#endif
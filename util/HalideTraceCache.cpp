@@ -0,0 +1,507 @@
+#include "HalideTraceUtils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+/** \file
+ *
+ * A tool which replays the loads and stores in a binary Halide trace
+ * through a simulated cache hierarchy, and reports for each traced Func
+ * the miss rate at each level of the hierarchy, the distribution of
+ * its reuse distances, and the working set touched while each of its
+ * realizations is live, which is the working set of the loop level it
+ * is computed at. This makes it possible to evaluate the locality of a
+ * schedule without hardware counters, for any cache configuration.
+ *
+ * Traces don't record addresses, so the tool lays out each realization
+ * of a Func densely, with the innermost dimension first, at an address
+ * given out by a simple allocator that reuses the memory of freed
+ * realizations of the same size. Funcs without traced realizations,
+ * such as inputs, are laid out over the bounding box of their
+ * accesses. Storage folding and the layouts chosen by reorder_storage
+ * aren't modeled, and the elements of a Tuple share one layout.
+ */
+
+using namespace Halide;
+using namespace Internal;
+
+using std::map;
+using std::string;
+using std::vector;
+
+namespace {
+
+struct CacheLevelConfig {
+    string name;
+    uint64_t size, assoc, line;
+};
+
+// A set-associative cache with LRU replacement. A miss allocates the
+// line, for loads and stores alike.
+class CacheLevel {
+    CacheLevelConfig config;
+    uint64_t sets;
+    vector<uint64_t> tags, last_use;
+    uint64_t clock = 0;
+
+public:
+    CacheLevel(const CacheLevelConfig &c) : config(c) {
+        sets = std::max<uint64_t>(1, c.size / (c.assoc * c.line));
+        tags.resize(sets * c.assoc, ~(uint64_t)0);
+        last_use.resize(sets * c.assoc, 0);
+    }
+
+    // Returns true on a hit.
+    bool access(uint64_t addr) {
+        uint64_t line = addr / config.line;
+        uint64_t set = line % sets;
+        uint64_t *t = &tags[set * config.assoc];
+        uint64_t *u = &last_use[set * config.assoc];
+        clock++;
+        int victim = 0;
+        for (int i = 0; i < (int)config.assoc; i++) {
+            if (t[i] == line) {
+                u[i] = clock;
+                return true;
+            }
+            if (u[i] < u[victim]) {
+                victim = i;
+            }
+        }
+        t[victim] = line;
+        u[victim] = clock;
+        return false;
+    }
+};
+
+// Counts one entry per distinct cache line, at the time of its last
+// access, so that the number of distinct lines accessed since a time is
+// a suffix sum.
+class LastAccessCounts {
+    vector<int32_t> tree;
+
+public:
+    LastAccessCounts(size_t n) : tree(n + 1, 0) {}
+
+    void add(uint64_t t, int delta) {
+        for (uint64_t i = t + 1; i < tree.size(); i += i & (-i)) {
+            tree[i] += delta;
+        }
+    }
+
+    // The number of entries at times before t.
+    int64_t before(uint64_t t) const {
+        int64_t sum = 0;
+        for (uint64_t i = t; i > 0; i -= i & (-i)) {
+            sum += tree[i];
+        }
+        return sum;
+    }
+};
+
+// The reuse distances are counted in power-of-two buckets of distinct
+// cache lines.
+const int reuse_buckets = 48;
+
+struct FuncStats {
+    // The bounding box of the accesses, for Funcs without realizations.
+    vector<int> min_coords, max_coords;
+    int bytes = 0;
+    uint64_t bbox_base = 0;
+
+    uint64_t loads = 0, stores = 0;
+    vector<uint64_t> misses;
+    uint64_t cold = 0;
+    uint64_t reuse[reuse_buckets] = {0};
+
+    uint64_t realizations = 0;
+    uint64_t working_set_lines_total = 0, working_set_lines_max = 0;
+};
+
+struct Realization {
+    string func;
+    vector<int> min, extent;
+    uint64_t base, size;
+    uint64_t begin_time;
+};
+
+void usage(char * const *argv) {
+    const string usage =
+        "Usage: " + string(argv[0]) + " -i trace_file [-c name:size:assoc:line ...]\n"
+        "\n"
+        "Replays the loads and stores of a Halide trace through a simulated cache\n"
+        "hierarchy, and reports the miss rates, reuse distances and working set\n"
+        "sizes of each Func. Each -c adds a level to the hierarchy, in order from\n"
+        "the one closest to the core, with its size, associativity and line size\n"
+        "in bytes. Sizes may end in K or M. The default hierarchy is\n"
+        "  -c L1:32K:8:64 -c L2:256K:8:64 -c L3:8M:16:64\n"
+        "\n"
+        "Build the pipeline with the target features trace_loads, trace_stores and\n"
+        "trace_realizations, and run it with HL_TRACE_FILE=<filename>.\n";
+    fprintf(stderr, "%s", usage.c_str());
+    exit(1);
+}
+
+uint64_t parse_size(const string &s) {
+    char *end = nullptr;
+    uint64_t v = strtoull(s.c_str(), &end, 10);
+    if (*end == 'K' || *end == 'k') {
+        v *= 1024;
+    } else if (*end == 'M' || *end == 'm') {
+        v *= 1024 * 1024;
+    }
+    return v;
+}
+
+bool parse_level(const string &s, CacheLevelConfig *c) {
+    vector<string> parts;
+    size_t start = 0;
+    for (;;) {
+        size_t colon = s.find(':', start);
+        parts.push_back(s.substr(start, colon - start));
+        if (colon == string::npos) {
+            break;
+        }
+        start = colon + 1;
+    }
+    if (parts.size() != 4) {
+        return false;
+    }
+    c->name = parts[0];
+    c->size = parse_size(parts[1]);
+    c->assoc = parse_size(parts[2]);
+    c->line = parse_size(parts[3]);
+    return c->size > 0 && c->assoc > 0 && c->line > 0 && (c->line & (c->line - 1)) == 0;
+}
+
+bool is_access(const Packet &p) {
+    return p.event == halide_trace_load || p.event == halide_trace_store;
+}
+
+// Gives out addresses for realizations. Freed blocks are reused for
+// realizations of the same size, most recently freed first, much like
+// a malloc would.
+class Allocator {
+    uint64_t next = 4096;
+    map<uint64_t, vector<uint64_t>> free_blocks;
+
+public:
+    uint64_t allocate(uint64_t size) {
+        size = (size + 63) & ~(uint64_t)63;
+        vector<uint64_t> &blocks = free_blocks[size];
+        if (!blocks.empty()) {
+            uint64_t base = blocks.back();
+            blocks.pop_back();
+            return base;
+        }
+        uint64_t base = next;
+        next += (size + 4095) & ~(uint64_t)4095;
+        return base;
+    }
+
+    void release(uint64_t base, uint64_t size) {
+        size = (size + 63) & ~(uint64_t)63;
+        free_blocks[size].push_back(base);
+    }
+};
+
+}  // namespace
+
+int main(int argc, char * const *argv) {
+    const char *filename = nullptr;
+    vector<CacheLevelConfig> configs;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-i" && i + 1 < argc) {
+            filename = argv[++i];
+        } else if (arg == "-c" && i + 1 < argc) {
+            CacheLevelConfig c;
+            if (!parse_level(argv[++i], &c)) {
+                fprintf(stderr, "Bad cache level: %s\n", argv[i]);
+                usage(argv);
+            }
+            configs.push_back(c);
+        } else {
+            usage(argv);
+        }
+    }
+    if (filename == nullptr) {
+        usage(argv);
+    }
+    if (configs.empty()) {
+        configs.push_back({"L1", 32 * 1024, 8, 64});
+        configs.push_back({"L2", 256 * 1024, 8, 64});
+        configs.push_back({"L3", 8 * 1024 * 1024, 16, 64});
+    }
+
+    FILE *file = fopen(filename, "rb");
+    if (file == nullptr) {
+        fprintf(stderr, "Error opening file: %s\n", filename);
+        exit(1);
+    }
+
+    // The first pass counts the accesses, and finds the bounding box of
+    // the accesses to each Func.
+    map<string, FuncStats> funcs;
+    uint64_t num_accesses = 0;
+    for (;;) {
+        Packet p;
+        if (!p.read_from_filedesc(file)) {
+            break;
+        }
+        if (!is_access(p)) {
+            continue;
+        }
+        FuncStats &f = funcs[p.func()];
+        int lanes = p.type.lanes;
+        int dims = p.dimensions / lanes;
+        if (f.min_coords.empty()) {
+            f.min_coords.resize(dims, INT32_MAX);
+            f.max_coords.resize(dims, INT32_MIN);
+            f.bytes = p.type.bytes();
+        } else if ((int)f.min_coords.size() != dims) {
+            fprintf(stderr, "Error: packets of Func %s have different dimensionalities.\n", p.func());
+            exit(1);
+        }
+        for (int lane = 0; lane < lanes; lane++) {
+            for (int i = 0; i < dims; i++) {
+                int c = p.get_coord(lanes * i + lane);
+                f.min_coords[i] = std::min(f.min_coords[i], c);
+                f.max_coords[i] = std::max(f.max_coords[i], c);
+            }
+        }
+        num_accesses += lanes;
+    }
+
+    fseek(file, 0, SEEK_SET);
+    if (ferror(file)) {
+        fprintf(stderr, "Error: couldn't seek back to the beginning of the trace file.\n");
+        exit(1);
+    }
+
+    Allocator allocator;
+    for (auto &it : funcs) {
+        FuncStats &f = it.second;
+        f.misses.resize(configs.size(), 0);
+        uint64_t size = f.bytes;
+        for (size_t i = 0; i < f.min_coords.size(); i++) {
+            size *= (uint64_t)(f.max_coords[i] - f.min_coords[i] + 1);
+        }
+        if (!f.min_coords.empty()) {
+            f.bbox_base = allocator.allocate(size);
+        }
+    }
+
+    vector<CacheLevel> levels;
+    for (const CacheLevelConfig &c : configs) {
+        levels.emplace_back(c);
+    }
+    const uint64_t line_size = configs[0].line;
+
+    LastAccessCounts counts(num_accesses + 1);
+    map<uint64_t, uint64_t> last_access;
+    uint64_t time = 0;
+
+    // The live realizations, by the id of their begin_realization packet.
+    map<int32_t, Realization> live;
+
+    for (;;) {
+        Packet p;
+        if (!p.read_from_filedesc(file)) {
+            break;
+        }
+
+        if (p.event == halide_trace_begin_realization) {
+            FuncStats &f = funcs[p.func()];
+            Realization r;
+            r.func = p.func();
+            int dims = p.dimensions / 2;
+            uint64_t size = f.bytes ? f.bytes : p.type.bytes();
+            for (int i = 0; i < dims; i++) {
+                r.min.push_back(p.get_coord(2 * i));
+                r.extent.push_back(p.get_coord(2 * i + 1));
+                size *= (uint64_t)std::max(0, r.extent.back());
+            }
+            r.size = size;
+            r.base = allocator.allocate(size);
+            r.begin_time = time;
+            live[p.id] = r;
+            continue;
+        }
+
+        if (p.event == halide_trace_end_realization) {
+            auto it = live.find(p.parent_id);
+            if (it == live.end()) {
+                continue;
+            }
+            const Realization &r = it->second;
+            FuncStats &f = funcs[r.func];
+            // The distinct lines accessed since the realization began.
+            uint64_t lines = counts.before(time) - counts.before(r.begin_time);
+            f.realizations++;
+            f.working_set_lines_total += lines;
+            f.working_set_lines_max = std::max(f.working_set_lines_max, lines);
+            allocator.release(r.base, r.size);
+            live.erase(it);
+            continue;
+        }
+
+        if (!is_access(p)) {
+            continue;
+        }
+
+        FuncStats &f = funcs[p.func()];
+        int lanes = p.type.lanes;
+        int dims = p.dimensions / lanes;
+        int bytes = p.type.bytes();
+        bool store = p.event == halide_trace_store;
+        for (int lane = 0; lane < lanes; lane++) {
+            // Find the realization the site is in. The innermost one is
+            // the one that began last.
+            const Realization *r = nullptr;
+            for (auto it = live.rbegin(); it != live.rend(); it++) {
+                const Realization &c = it->second;
+                if (c.func != p.func() || (int)c.min.size() != dims) {
+                    continue;
+                }
+                bool inside = true;
+                for (int i = 0; inside && i < dims; i++) {
+                    int x = p.get_coord(lanes * i + lane);
+                    inside = x >= c.min[i] && x < c.min[i] + c.extent[i];
+                }
+                if (inside) {
+                    r = &c;
+                    break;
+                }
+            }
+
+            uint64_t offset = 0, stride = 1;
+            for (int i = 0; i < dims; i++) {
+                int x = p.get_coord(lanes * i + lane);
+                int min = r ? r->min[i] : f.min_coords[i];
+                int extent = r ? r->extent[i] : f.max_coords[i] - f.min_coords[i] + 1;
+                offset += (uint64_t)(x - min) * stride;
+                stride *= (uint64_t)extent;
+            }
+            uint64_t addr = (r ? r->base : f.bbox_base) + offset * bytes;
+
+            if (store) {
+                f.stores++;
+            } else {
+                f.loads++;
+            }
+
+            for (size_t i = 0; i < levels.size(); i++) {
+                if (levels[i].access(addr)) {
+                    break;
+                }
+                f.misses[i]++;
+            }
+
+            uint64_t line = addr / line_size;
+            auto last = last_access.find(line);
+            if (last == last_access.end()) {
+                f.cold++;
+                last_access[line] = time;
+            } else {
+                uint64_t distance = counts.before(time) - counts.before(last->second + 1);
+                int bucket = 0;
+                while (bucket < reuse_buckets - 1 && ((uint64_t)1 << bucket) <= distance) {
+                    bucket++;
+                }
+                f.reuse[bucket]++;
+                counts.add(last->second, -1);
+                last->second = time;
+            }
+            counts.add(time, 1);
+            time++;
+        }
+    }
+    fclose(file);
+
+    printf("Cache hierarchy:\n");
+    for (const CacheLevelConfig &c : configs) {
+        printf("  %s: %llu bytes, %llu-way, %llu byte lines\n", c.name.c_str(),
+               (unsigned long long)c.size, (unsigned long long)c.assoc, (unsigned long long)c.line);
+    }
+    printf("Distinct cache lines touched: %llu (%llu bytes)\n\n",
+           (unsigned long long)last_access.size(), (unsigned long long)(last_access.size() * line_size));
+
+    printf("%-32s %12s %12s", "Func", "loads", "stores");
+    for (const CacheLevelConfig &c : configs) {
+        printf(" %8s", (c.name + " miss").c_str());
+    }
+    printf(" %8s %14s\n", "cold", "median reuse");
+    for (const auto &it : funcs) {
+        const FuncStats &f = it.second;
+        uint64_t accesses = f.loads + f.stores;
+        if (accesses == 0) {
+            continue;
+        }
+        printf("%-32s %12llu %12llu", it.first.c_str(),
+               (unsigned long long)f.loads, (unsigned long long)f.stores);
+        for (size_t i = 0; i < configs.size(); i++) {
+            printf(" %7.2f%%", 100.0 * f.misses[i] / accesses);
+        }
+        printf(" %7.2f%%", 100.0 * f.cold / accesses);
+        // The median reuse distance, as the upper bound of its bucket, in bytes.
+        uint64_t reused = accesses - f.cold, seen = 0;
+        string median = "-";
+        for (int b = 0; reused && b < reuse_buckets; b++) {
+            seen += f.reuse[b];
+            if (2 * seen >= reused) {
+                median = "< " + std::to_string(((uint64_t)1 << b) * line_size);
+                break;
+            }
+        }
+        printf(" %14s\n", median.c_str());
+    }
+
+    printf("\nReuse distances, in distinct bytes accessed between uses of a line:\n");
+    printf("%-32s", "Func");
+    for (const CacheLevelConfig &c : configs) {
+        printf(" %10s", ("< " + c.name).c_str());
+    }
+    printf(" %10s\n", "beyond");
+    for (const auto &it : funcs) {
+        const FuncStats &f = it.second;
+        uint64_t reused = f.loads + f.stores - f.cold;
+        if (reused == 0) {
+            continue;
+        }
+        // The fraction of reuses that a fully associative cache of the
+        // size of each level would catch.
+        printf("%-32s", it.first.c_str());
+        uint64_t below = 0;
+        int b = 0;
+        for (const CacheLevelConfig &c : configs) {
+            uint64_t capacity = c.size / line_size;
+            for (; b < reuse_buckets && ((uint64_t)1 << b) <= capacity; b++) {
+                below += f.reuse[b];
+            }
+            printf(" %9.2f%%", 100.0 * below / reused);
+        }
+        printf(" %9.2f%%\n", 100.0 * (reused - below) / reused);
+    }
+
+    printf("\nWorking set while each realization is live:\n");
+    printf("%-32s %12s %14s %14s\n", "Func", "realizations", "mean bytes", "max bytes");
+    for (const auto &it : funcs) {
+        const FuncStats &f = it.second;
+        if (f.realizations == 0) {
+            continue;
+        }
+        printf("%-32s %12llu %14llu %14llu\n", it.first.c_str(),
+               (unsigned long long)f.realizations,
+               (unsigned long long)(f.working_set_lines_total / f.realizations * line_size),
+               (unsigned long long)(f.working_set_lines_max * line_size));
+    }
+
+    return 0;
+}
@@ -16,7 +16,9 @@
  * A tool which can read a binary Halide trace file, and dump files
  * containing the final pixel values recorded for each traced Func.
  *
- * Currently dumps into supported Halide image formats.
+ * Currently dumps into supported Halide image formats. Traces in the
+ * compact format (see halide_set_trace_compact) are read too, though
+ * sampled stores will leave gaps in the images.
  */
 
 using namespace Halide;
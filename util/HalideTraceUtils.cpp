@@ -3,17 +3,167 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
 
 namespace Halide {
 namespace Internal {
 
+namespace {
+
+// Decoding state for a block of compact trace records (see
+// halide_set_trace_compact). This mirrors the encoder in
+// src/runtime/tracing.cpp.
+struct CompactBlock {
+    std::vector<uint8_t> data;
+    size_t pos = 0;
+    int32_t prev_id = 0;
+    std::vector<std::string> funcs;
+    std::vector<int32_t> coords;
+
+    static const int max_funcs = 64;
+    static const int max_coords = 64;
+
+    bool done() const {
+        return pos >= data.size();
+    }
+
+    uint8_t byte() {
+        if (done()) {
+            fprintf(stderr, "Compact trace block ended mid-record\n");
+            exit(-1);
+        }
+        return data[pos++];
+    }
+
+    uint32_t varint() {
+        uint32_t x = 0;
+        for (int shift = 0; ; shift += 7) {
+            uint8_t b = byte();
+            x |= (uint32_t)(b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                return x;
+            }
+        }
+    }
+
+    int32_t signed_varint() {
+        uint32_t x = varint();
+        return (int32_t)(x >> 1) ^ -(int32_t)(x & 1);
+    }
+};
+
+std::map<FILE *, CompactBlock> compact_blocks;
+
+// The last file read from, and its block.
+FILE *last_file = nullptr;
+CompactBlock *last_block = nullptr;
+
+}  // namespace
+
+bool Packet::decode_compact(void *b) {
+    CompactBlock &block = *(CompactBlock *)b;
+    uint8_t h = block.byte();
+    event = (halide_trace_event_code_t)(h & 0xf);
+    bool has_value = (h & 0x10) != 0;
+
+    uint32_t f = block.varint();
+    std::string name;
+    if (f == block.funcs.size()) {
+        while (char c = (char)block.byte()) {
+            name += c;
+        }
+        if ((int)block.funcs.size() < block.max_funcs) {
+            block.funcs.push_back(name);
+        }
+    } else if (f < block.funcs.size()) {
+        name = block.funcs[f];
+    } else {
+        fprintf(stderr, "Bad Func index in compact trace block\n");
+        exit(-1);
+    }
+
+    id = block.prev_id + block.signed_varint();
+    block.prev_id = id;
+    parent_id = id - block.signed_varint();
+    value_index = block.varint();
+    type.code = (halide_type_code_t)block.byte();
+    type.bits = block.byte();
+    type.lanes = (uint16_t)block.varint();
+    dimensions = block.varint();
+
+    size_t header_bytes = sizeof(halide_trace_packet_t);
+    size_t coords_bytes = dimensions * sizeof(int32_t);
+    size_t value_bytes = type.lanes * type.bytes();
+    size_t name_bytes = name.size() + 1;
+    size = (uint32_t)((header_bytes + coords_bytes + value_bytes + name_bytes + 3) & ~3);
+    if (size - header_bytes > sizeof(payload)) {
+        fprintf(stderr, "Payload larger than %d bytes in trace stream (%d)\n", (int)sizeof(payload), (int)(size - header_bytes));
+        abort();
+    }
+
+    for (int i = 0; i < dimensions; i++) {
+        int32_t prev = i < (int)block.coords.size() ? block.coords[i] : 0;
+        int32_t c = prev + block.signed_varint();
+        coordinates()[i] = c;
+    }
+    block.coords.assign(coordinates(), coordinates() + std::min(dimensions, (int32_t)CompactBlock::max_coords));
+
+    if (has_value) {
+        for (size_t i = 0; i < value_bytes; i++) {
+            ((uint8_t *)value())[i] = block.byte();
+        }
+    } else {
+        memset(value(), 0, value_bytes);
+    }
+    memcpy(func(), name.c_str(), name_bytes);
+    return true;
+}
+
 bool Packet::read_from_stdin() {
     return read_from_filedesc(stdin);
 }
 
 bool Packet::read_from_filedesc(FILE *fdesc){
+    // A new block is read whenever the last one runs out, so a file
+    // can be read again after seeking back to the start once it has
+    // been read to the end.
+    if (fdesc != last_file) {
+        last_file = fdesc;
+        last_block = &compact_blocks[fdesc];
+    }
+    CompactBlock &block = *last_block;
+    while (block.done()) {
+        uint32_t word;
+        if (!Packet::read(&word, sizeof(word), fdesc)) {
+            return false;
+        }
+        if (word != HALIDE_TRACE_COMPACT_MAGIC) {
+            // It's the size field of a full packet.
+            size = word;
+            return read_rest_of_full_packet(fdesc);
+        }
+
+        uint32_t block_bytes;
+        if (!Packet::read(&block_bytes, sizeof(block_bytes), fdesc)) {
+            fprintf(stderr, "Unexpected EOF mid-block");
+            return false;
+        }
+        block = CompactBlock();
+        block.data.resize(block_bytes);
+        if (!Packet::read(block.data.data(), block_bytes, fdesc)) {
+            fprintf(stderr, "Unexpected EOF mid-block");
+            return false;
+        }
+    }
+    return decode_compact(&block);
+}
+
+bool Packet::read_rest_of_full_packet(FILE *fdesc) {
     size_t header_size = sizeof(halide_trace_packet_t);
-    if (!Packet::read(this, header_size, fdesc)) {
+    if (!Packet::read((uint8_t *)this + sizeof(size), header_size - sizeof(size), fdesc)) {
         return false;
     }
     size_t payload_size = size - header_size;
@@ -81,9 +81,19 @@ struct Packet : public halide_trace_packet_t {
     bool read_from_stdin();
 
     // Grab a packet from a particular fctl file descriptor. Returns false when end is reached.
+    // Understands both the full and the compact trace formats. Seeking
+    // the file is only supported between packets of the full format, or
+    // once the end has been reached.
     bool read_from_filedesc(FILE *fdesc);
 
 private:
+    // Read the remainder of a full-format packet whose size field
+    // has already been read.
+    bool read_rest_of_full_packet(FILE *fdesc);
+
+    // Decode the next record of a compact trace block.
+    bool decode_compact(void *block);
+
     // Do a blocking read of some number of bytes from a unistd file descriptor.
     bool read(void *d, size_t size, FILE *fdesc);
 };
@@ -11,6 +11,10 @@
 #include <queue>
 #include <iostream>
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #ifdef _MSC_VER
 #include <io.h>
 typedef int64_t ssize_t;
@@ -39,6 +43,9 @@ using std::pair;
 struct Label {
     const char *text;
     int x, y, n;
+    // The brightness it was last drawn with, so it's only redrawn
+    // when it changes.
+    int last_color;
 };
 
 // A struct specifying how a single Func will get visualized.
@@ -172,7 +179,7 @@ struct FuncInfo {
 };
 
 // Composite a single pixel of b over a single pixel of a, writing the result into dst
-void composite(uint8_t *a, uint8_t *b, uint8_t *dst) {
+inline void composite(uint8_t *a, uint8_t *b, uint8_t *dst) {
     uint8_t alpha = b[3];
     // alpha is almost always 0 or 255.
     if (alpha == 0) {
@@ -187,6 +194,159 @@ void composite(uint8_t *a, uint8_t *b, uint8_t *dst) {
     }
 }
 
+// Multiply the alpha of a pixel by a fixed point factor with 24
+// fractional bits.
+inline uint32_t decay(uint32_t color, uint32_t factor) {
+    uint32_t rgb = color & 0x00ffffff;
+    uint32_t alpha = (color >> 24);
+    alpha *= factor;
+    alpha &= 0xff000000;
+    return alpha | rgb;
+}
+
+// The layers that get composited into each frame. The image layer
+// holds the values of the Funcs, the anim layer highlights the loads
+// and stores since the last frame, anim_decay holds the fading
+// highlights of earlier frames, and text holds the labels.
+struct Layers {
+    uint32_t *image, *anim, *anim_decay, *text, *blend;
+    int width, height;
+    uint32_t anim_decay_factor, anim_factor;
+    bool decay_anim_decay;
+
+    // Composite text over anim over image for a range of rows, and
+    // then decay the highlights. Returns whether any highlights were
+    // visible in the frame.
+    bool render_rows(int y_begin, int y_end) {
+        bool visible = false;
+        for (int i = y_begin * width; i < y_end * width; i++) {
+            uint8_t *anim_decay_px  = (uint8_t *)(anim_decay + i);
+            uint8_t *anim_px  = (uint8_t *)(anim + i);
+            uint8_t *image_px = (uint8_t *)(image + i);
+            uint8_t *text_px  = (uint8_t *)(text + i);
+            uint8_t *blend_px = (uint8_t *)(blend + i);
+            // anim over anim_decay
+            composite(anim_decay_px, anim_px, anim_decay_px);
+            // anim_decay over image
+            composite(image_px, anim_decay_px, blend_px);
+            // text over image
+            composite(blend_px, text_px, blend_px);
+            visible |= anim_decay_px[3] != 0;
+
+            // The frame is written out only once every row has been
+            // composited, so it's safe to decay the pixel now.
+            if (decay_anim_decay) {
+                anim_decay[i] = decay(anim_decay[i], anim_decay_factor);
+            }
+            anim[i] = decay(anim[i], anim_factor);
+        }
+        return visible;
+    }
+
+    // Render a frame using a band of rows per thread.
+    bool render(int num_threads) {
+        if (num_threads <= 1) {
+            return render_rows(0, height);
+        }
+        vector<std::thread> threads;
+        vector<char> visible(num_threads);
+        int rows_per_thread = (height + num_threads - 1) / num_threads;
+        for (int t = 0; t < num_threads; t++) {
+            int y_begin = std::min(t * rows_per_thread, height);
+            int y_end = std::min(y_begin + rows_per_thread, height);
+            threads.emplace_back([=, &visible]() {
+                visible[t] = render_rows(y_begin, y_end);
+            });
+        }
+        bool any_visible = false;
+        for (int t = 0; t < num_threads; t++) {
+            threads[t].join();
+            any_visible |= visible[t] != 0;
+        }
+        return any_visible;
+    }
+};
+
+// Reads tracing packets from stdin on another thread, so that decoding
+// the trace overlaps with drawing it. Packets are handed over in
+// batches, packed end to end using only the bytes each one needs.
+class PacketReader {
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<vector<uint8_t>> batches;
+    bool done = false, stop = false;
+
+    // The batch being consumed, and the position of the next packet in it.
+    vector<uint8_t> current;
+    size_t pos = 0;
+
+    static const size_t batch_bytes = 1 << 20;
+    static const size_t max_batches = 16;
+
+    std::thread thread;
+
+    void read_all() {
+        vector<uint8_t> batch;
+        Packet p;
+        bool more;
+        do {
+            more = p.read_from_stdin();
+            if (more) {
+                batch.insert(batch.end(), (uint8_t *)&p, (uint8_t *)&p + p.size);
+            }
+            if (batch.size() >= batch_bytes || (!more && !batch.empty())) {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&]() { return batches.size() < max_batches || stop; });
+                if (stop) {
+                    break;
+                }
+                batches.push_back(std::move(batch));
+                batch.clear();
+                cond.notify_all();
+            }
+        } while (more);
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        cond.notify_all();
+    }
+
+public:
+    PacketReader() {
+        // Read the trace in large chunks.
+        setvbuf(stdin, nullptr, _IOFBF, batch_bytes);
+        thread = std::thread([this]() { read_all(); });
+    }
+
+    ~PacketReader() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+            cond.notify_all();
+        }
+        thread.join();
+    }
+
+    // Get the next packet. Returns false once stdin closes.
+    bool next(Packet &p) {
+        if (pos == current.size()) {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&]() { return !batches.empty() || done; });
+            if (batches.empty()) {
+                return false;
+            }
+            current = std::move(batches.front());
+            batches.pop_front();
+            pos = 0;
+            cond.notify_all();
+        }
+        uint32_t size;
+        memcpy(&size, current.data() + pos, sizeof(size));
+        memcpy((void *)&p, current.data() + pos, size);
+        pos += size;
+        return true;
+    }
+};
+
 #define FONT_W 12
 #define FONT_H 32
 void draw_text(const char *text, int x, int y, uint32_t color, uint32_t *dst, int dst_width, int dst_height) {
@@ -478,7 +638,7 @@ int run(int argc, char **argv) {
             char *func = argv[++i];
             char *text = argv[++i];
             int n = atoi(argv[++i]);
-            Label l = {text, config.x, config.y, n};
+            Label l = {text, config.x, config.y, n, -1};
             func_info[func].config.labels.push_back(l);
         } else if (next == "--timestep") {
             expect(i + 1 < argc, i);
@@ -524,6 +684,34 @@ int run(int argc, char **argv) {
     uint32_t *blend = new uint32_t[frame_width * frame_height];
     memset(blend, 0, 4 * frame_width * frame_height);
 
+    Layers layers;
+    layers.image = image;
+    layers.anim = anim;
+    layers.anim_decay = anim_decay;
+    layers.text = text;
+    layers.blend = blend;
+    layers.width = frame_width;
+    layers.height = frame_height;
+    layers.anim_factor = (1 << 24) / decay_factor[0];
+    layers.anim_decay_factor = (1 << 24) / decay_factor[1];
+    layers.decay_anim_decay = decay_factor[1] != 1;
+
+    // Render frames in bands of rows, if they're big enough to be
+    // worth the threads.
+    int num_threads = std::max(1, (int)std::thread::hardware_concurrency());
+    num_threads = std::min(num_threads, frame_height / 64 + 1);
+
+    // Whether any layer has been drawn to since the last frame was
+    // rendered, whether the anim layer might not be blank, and whether
+    // the last frame showed any highlights. When nothing has changed,
+    // and nothing is left to fade, the next frame is the same as the
+    // last one, so it's written out again without rendering it. This
+    // makes seeking through long stretches of the trace without any
+    // visible events fast.
+    bool layers_dirty = true, anim_visible = false, highlights_shown = false;
+
+    PacketReader reader;
+
     struct PipelineInfo {
         string name;
         int32_t id;
@@ -531,6 +719,11 @@ int run(int argc, char **argv) {
 
     map<uint32_t, PipelineInfo> pipeline_info;
 
+    // The Func of the last load or store, and its parent event.
+    FuncInfo *last_fi = nullptr;
+    int32_t last_parent_id = 0;
+    string last_func;
+
     size_t end_counter = 0;
     size_t packet_clock = 0;
     for (;;) {
@@ -546,19 +739,15 @@ int run(int argc, char **argv) {
             const ssize_t frame_bytes = 4 * frame_width * frame_height;
 
             while (halide_clock >= video_clock) {
-                // Composite text over anim over image
-                for (int i = 0; i < frame_width * frame_height; i++) {
-                    uint8_t *anim_decay_px  = (uint8_t *)(anim_decay + i);
-                    uint8_t *anim_px  = (uint8_t *)(anim + i);
-                    uint8_t *image_px = (uint8_t *)(image + i);
-                    uint8_t *text_px  = (uint8_t *)(text + i);
-                    uint8_t *blend_px = (uint8_t *)(blend + i);
-                    // anim over anim_decay
-                    composite(anim_decay_px, anim_px, anim_decay_px);
-                    // anim_decay over image
-                    composite(image_px, anim_decay_px, blend_px);
-                    // text over image
-                    composite(blend_px, text_px, blend_px);
+                // Composite text over anim over image, and decay the
+                // highlights for the next frame.
+                bool same_as_last = !layers_dirty && !anim_visible &&
+                    (!highlights_shown || !layers.decay_anim_decay);
+                if (!same_as_last) {
+                    highlights_shown = layers.render(num_threads);
+                    // The anim is only visible if some highlight was.
+                    anim_visible = highlights_shown;
+                    layers_dirty = false;
                 }
 
                 // Dump the frame
@@ -569,39 +758,16 @@ int run(int argc, char **argv) {
                 }
 
                 video_clock += timestep;
-
-                // Decay the anim_decay
-                if (decay_factor[1] != 1) {
-                    const uint32_t inv_d1 = (1 << 24) / decay_factor[1];
-                    for (int i = 0; i < frame_width * frame_height; i++) {
-                        uint32_t color = anim_decay[i];
-                        uint32_t rgb = color & 0x00ffffff;
-                        uint32_t alpha = (color >> 24);
-                        alpha *= inv_d1;
-                        alpha &= 0xff000000;
-                        anim_decay[i] = alpha | rgb;
-                    }
-                }
-
-                // Also decay the anim
-                const uint32_t inv_d0 = (1 << 24) / decay_factor[0];
-                for (int i = 0; i < frame_width * frame_height; i++) {
-                    uint32_t color = anim[i];
-                    uint32_t rgb = color & 0x00ffffff;
-                    uint32_t alpha = (color >> 24);
-                    alpha *= inv_d0;
-                    alpha &= 0xff000000;
-                    anim[i] = alpha | rgb;
-                }
             }
 
             // Blank anim
             memset(anim, 0, frame_bytes);
+            anim_visible = false;
         }
 
         // Read a tracing packet
         Packet p;
-        if (!p.read_from_stdin()) {
+        if (!reader.next(p)) {
             end_counter++;
             continue;
         }
@@ -616,32 +782,52 @@ int run(int argc, char **argv) {
             continue;
         }
 
-        PipelineInfo pipeline = pipeline_info[p.parent_id];
+        // Loads and stores usually come in long runs from the same
+        // Func, so remember the last one looked up.
+        bool is_access = p.event == halide_trace_load || p.event == halide_trace_store;
+        FuncInfo *fi_ptr;
+        if (is_access && last_fi &&
+            p.parent_id == last_parent_id &&
+            strcmp(p.func(), last_func.c_str()) == 0) {
+            fi_ptr = last_fi;
+        } else {
+            PipelineInfo pipeline = pipeline_info[p.parent_id];
+
+            if (p.event == halide_trace_begin_realization ||
+                p.event == halide_trace_produce ||
+                p.event == halide_trace_consume) {
+                pipeline_info[p.id] = pipeline;
+            } else if (p.event == halide_trace_end_realization ||
+                       p.event == halide_trace_end_produce ||
+                       p.event == halide_trace_end_consume) {
+                pipeline_info.erase(p.parent_id);
+            }
 
-        if (p.event == halide_trace_begin_realization ||
-            p.event == halide_trace_produce ||
-            p.event == halide_trace_consume) {
-            pipeline_info[p.id] = pipeline;
-        } else if (p.event == halide_trace_end_realization ||
-                   p.event == halide_trace_end_produce ||
-                   p.event == halide_trace_end_consume) {
-            pipeline_info.erase(p.parent_id);
-        }
+            string qualified_name = pipeline.name + ":" + p.func();
 
-        string qualified_name = pipeline.name + ":" + p.func();
+            if (func_info.find(qualified_name) == func_info.end()) {
+                if (func_info.find(p.func()) != func_info.end()) {
+                    func_info[qualified_name] = func_info[p.func()];
+                    func_info.erase(p.func());
+                } else {
+                    fprintf(stderr, "Warning: ignoring func %s event %d    \n", qualified_name.c_str(), p.event);
+                    fprintf(stderr, "Parent event %d %s\n", p.parent_id, pipeline.name.c_str());
+                }
+            }
 
-        if (func_info.find(qualified_name) == func_info.end()) {
-            if (func_info.find(p.func()) != func_info.end()) {
-                func_info[qualified_name] = func_info[p.func()];
-                func_info.erase(p.func());
-            } else {
-                fprintf(stderr, "Warning: ignoring func %s event %d    \n", qualified_name.c_str(), p.event);
-                fprintf(stderr, "Parent event %d %s\n", p.parent_id, pipeline.name.c_str());
+            fi_ptr = &func_info[qualified_name];
+            if (fi_ptr->configured && fi_ptr->stats.first_packet_idx == 0) {
+                fi_ptr->stats.qualified_name = qualified_name;
+            }
+            if (is_access) {
+                last_fi = fi_ptr;
+                last_parent_id = p.parent_id;
+                last_func = p.func();
             }
         }
 
         // Draw the event
-        FuncInfo &fi = func_info[qualified_name];
+        FuncInfo &fi = *fi_ptr;
         if (!fi.configured) continue;
 
         if (fi.stats.first_draw_time == 0) {
@@ -650,19 +836,21 @@ int run(int argc, char **argv) {
 
         if (fi.stats.first_packet_idx == 0) {
             fi.stats.first_packet_idx = packet_clock;
-            fi.stats.qualified_name = qualified_name;
         }
 
         int frames_since_first_draw = (halide_clock - fi.stats.first_draw_time) / timestep;
 
         for (size_t i = 0; i < fi.config.labels.size(); i++) {
-            const Label &label = fi.config.labels[i];
+            Label &label = fi.config.labels[i];
             if (frames_since_first_draw <= label.n) {
                 uint32_t color = ((1 + frames_since_first_draw) * 255) / label.n;
                 if (color > 255) color = 255;
+                if ((int)color == label.last_color) continue;
+                label.last_color = color;
                 color *= 0x10101;
 
                 draw_text(label.text, label.x, label.y, color, text, frame_width, frame_height);
+                layers_dirty = true;
             }
         }
 
@@ -753,6 +941,7 @@ int run(int argc, char **argv) {
                             }
                         }
                     }
+                    anim_visible = layers_dirty = true;
                 }
             }
             break;
@@ -760,10 +949,12 @@ int run(int argc, char **argv) {
         case halide_trace_begin_realization:
             fi.stats.num_realizations++;
             fill_realization(image, frame_width, frame_height, fi.config.uninitialized_memory_color, fi, p);
+            layers_dirty = true;
             break;
         case halide_trace_end_realization:
             if (fi.config.blank_on_end_realization) {
                 fill_realization(image, frame_width, frame_height, 0, fi, p);
+                layers_dirty = true;
             }
             break;
         case halide_trace_produce: